@@ -38,6 +38,7 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Run several commands on a drive in one go"},
 };
 
 static void Usage(void) {
@@ -53,10 +54,30 @@ static void Usage(void) {
   printf("\nFor more detailed usage, use %s COMMAND -h\n\n", progname);
 }
 
-int main(int argc, char *argv[]) {
+cgpt_command_fn FindCommand(const char *name) {
   int i;
   int match_count = 0;
   int match_index = 0;
+
+  for (i = 0; i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
+    // exact match?
+    if (0 == strcmp(cmds[i].name, name)) {
+      match_index = i;
+      match_count = 1;
+      break;
+    }
+    // unique match?
+    else if (0 == strncmp(cmds[i].name, name, strlen(name))) {
+      match_index = i;
+      match_count++;
+    }
+  }
+
+  return match_count == 1 ? cmds[match_index].fp : NULL;
+}
+
+int main(int argc, char *argv[]) {
+  cgpt_command_fn fp;
   char* command;
 
   progname = strrchr(argv[0], '/');
@@ -74,22 +95,9 @@ int main(int argc, char *argv[]) {
   command = argv[optind++];
 
   // Find the command to invoke.
-  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
-    // exact match?
-    if (0 == strcmp(cmds[i].name, command)) {
-      match_index = i;
-      match_count = 1;
-      break;
-    }
-    // unique match?
-    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
-      match_index = i;
-      match_count++;
-    }
-  }
-
-  if (match_count == 1)
-    return cmds[match_index].fp(argc, argv);
+  fp = command ? FindCommand(command) : NULL;
+  if (fp)
+    return fp(argc, argv);
 
   // Couldn't find a single matching command.
   Usage();
@@ -47,6 +47,9 @@ struct drive {
   GptData gpt;
   struct pmbr pmbr;
   int fd;       /* file descriptor */
+  uint32_t io_align;  /* bytes to align transfers to (physical block size) */
+  uint32_t io_opt;    /* optimal transfer size in bytes, or 0 if unknown */
+  int written;  /* whether anything has been written, so needs a sync */
 };
 
 // Opens a block device or file, loads raw GPT data from it.
@@ -61,6 +64,16 @@ struct drive {
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size);
 int DriveClose(struct drive *drive, int update_as_needed);
+
+// Opens 'drive_path' read-write for a batch of commands.  Until
+// DriveBatchEnd(), DriveOpen() of the same path hands out the GPT already in
+// memory and DriveClose() keeps any changes there, so the drive is only
+// loaded once and saved once no matter how many commands run.
+//
+// Returns CGPT_FAILED if the drive can't be opened or a batch is open.
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size);
+// Ends the batch, saving the accumulated changes if 'update_as_needed'.
+int DriveBatchEnd(int update_as_needed);
 int CheckValid(const struct drive *drive);
 
 /* Loads sectors from 'drive'.
@@ -132,6 +145,8 @@ int ResolveType(const Guid *type, char *buf);
 int SupportedType(const char *name, Guid *type);
 void PrintTypes(void);
 void EntryDetails(GptEntry *entry, uint32_t index, int raw);
+// Parse a comma-separated list of 'cgpt show -j' fields into a bitmask.
+int ParseShowFields(const char *list, uint32_t *fields);
 
 uint32_t GetNumberOfEntries(const struct drive *drive);
 GptEntry *GetEntry(GptData *gpt, int secondary, uint32_t entry_index);
@@ -191,6 +206,11 @@ int cmd_find(int argc, char *argv[]);
 int cmd_edit(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
+
+// Returns the command named, or uniquely abbreviated, by 'name', or NULL.
+typedef int (*cgpt_command_fn)(int argc, char *argv[]);
+cgpt_command_fn FindCommand(const char *name);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
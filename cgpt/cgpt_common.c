@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #ifndef HAVE_MACOS
+#include <linux/fs.h>
 #include <linux/major.h>
 #include <mtd/mtd-user.h>
 #endif
@@ -134,6 +135,8 @@ int WritePMBR(struct drive *drive) {
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
+  drive->written = 1;
+
   int nwrote = write(drive->fd, &drive->pmbr, sizeof(struct pmbr));
   if (nwrote != sizeof(struct pmbr))
     return CGPT_FAILED;
@@ -154,6 +157,7 @@ int Save(struct drive *drive, const uint8_t *buf,
   if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
     return CGPT_FAILED;
 
+  drive->written = 1;
   nwrote = write(drive->fd, buf, count);
   if (nwrote < count)
     return CGPT_FAILED;
@@ -161,7 +165,85 @@ int Save(struct drive *drive, const uint8_t *buf,
   return CGPT_OK;
 }
 
+// Largest read GptLoad() makes to take in a header and entries at once.
+#define MAX_SPAN_BYTES (1024 * 1024)
+
+// Sectors of the drive read in one transfer, so that a GPT header and the
+// entries next to it don't each need a read of their own.
+struct span {
+  uint8_t *buf;
+  uint64_t first;  /* first sector in buf */
+  uint64_t count;  /* number of sectors in buf */
+};
+
+// Reads at least 'count' sectors starting at 'first' into 'span', in one
+// transfer aligned to the drive's physical blocks.  This is only a hint for
+// SpanCopy(), so on error 'span' is just left empty.
+static void LoadSpan(struct drive *drive, struct span *span,
+                     uint64_t first, uint64_t count) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t align = drive->io_align / sector_bytes;
+  uint64_t end = first + count;
+  ssize_t nread;
+
+  memset(span, 0, sizeof(*span));
+  if (align < 1)
+    align = 1;
+  first -= first % align;
+  end = (end + align - 1) / align * align;
+  if (end > drive->gpt.gpt_drive_sectors)
+    end = drive->gpt.gpt_drive_sectors;
+  if (end <= first)
+    return;
+
+  span->buf = malloc((end - first) * sector_bytes);
+  if (!span->buf)
+    return;
+  nread = pread(drive->fd, span->buf, (end - first) * sector_bytes,
+                first * sector_bytes);
+  if (nread != (end - first) * sector_bytes) {
+    free(span->buf);
+    span->buf = NULL;
+    return;
+  }
+  span->first = first;
+  span->count = end - first;
+}
+
+// Like Load(), but copies the sectors from 'span' if they were read into it.
+static int SpanCopy(struct drive *drive, const struct span *span,
+                    uint8_t **buf, uint64_t sector, uint64_t sector_count) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+
+  if (!span->buf || sector < span->first ||
+      sector_count > span->count ||
+      sector - span->first > span->count - sector_count)
+    return Load(drive, buf, sector, sector_bytes, sector_count);
+
+  *buf = malloc(sector_count * sector_bytes);
+  require(*buf);
+  memcpy(*buf, span->buf + (sector - span->first) * sector_bytes,
+         sector_count * sector_bytes);
+  return CGPT_OK;
+}
+
+// Number of sectors to read at once for a header and the entries next to
+// it: enough for a default-sized entry array, or the drive's optimal
+// transfer size if that's bigger.
+static uint64_t SpanSectors(const struct drive *drive) {
+  uint64_t bytes = MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry);
+
+  if (drive->io_opt > bytes)
+    bytes = drive->io_opt < MAX_SPAN_BYTES ? drive->io_opt : MAX_SPAN_BYTES;
+  return GPT_HEADER_SECTORS +
+      (bytes + drive->gpt.sector_bytes - 1) / drive->gpt.sector_bytes;
+}
+
 static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
+  struct span span;
+  uint64_t span_sectors;
+  int rv = -1;
+
   drive->gpt.sector_bytes = sector_bytes;
   if (drive->size % drive->gpt.sector_bytes) {
     Error("Media size (%llu) is not a multiple of sector size(%d)\n",
@@ -175,85 +257,137 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
     drive->gpt.gpt_drive_sectors = drive->gpt.streaming_drive_sectors;
   } /* Else, we trust gpt.gpt_drive_sectors. */
 
-  // Read the data.
-  if (CGPT_OK != Load(drive, &drive->gpt.primary_header,
-                      GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+  // Read the data.  Each header is read along with the sectors where its
+  // entries usually are, which saves a second read when they're there.
+  span_sectors = SpanSectors(drive);
+  LoadSpan(drive, &span, GPT_PMBR_SECTORS, span_sectors);
+  if (CGPT_OK != SpanCopy(drive, &span, &drive->gpt.primary_header,
+                          GPT_PMBR_SECTORS, GPT_HEADER_SECTORS)) {
     Error("Cannot read primary GPT header\n");
-    return -1;
-  }
-  if (CGPT_OK != Load(drive, &drive->gpt.secondary_header,
-                      drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
-    Error("Cannot read secondary GPT header\n");
-    return -1;
+    goto out;
   }
   GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
   if (CheckHeader(primary_header, 0, drive->gpt.streaming_drive_sectors,
                   drive->gpt.gpt_drive_sectors,
                   drive->gpt.flags,
                   drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, &drive->gpt.primary_entries,
-                        primary_header->entries_lba,
-                        drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(primary_header,
-                          drive->gpt.sector_bytes))) {
+    if (CGPT_OK != SpanCopy(drive, &span, &drive->gpt.primary_entries,
+                            primary_header->entries_lba,
+                            CalculateEntriesSectors(primary_header,
+                              drive->gpt.sector_bytes))) {
       Error("Cannot read primary partition entry array\n");
-      return -1;
+      goto out;
     }
   } else {
     Warning("Primary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
              GPT_HEADER_SIGNATURE_SIZE) ? "invalid" : "being ignored");
-    drive->gpt.primary_entries = calloc(MAX_NUMBER_OF_ENTRIES,
+    drive->gpt.primary_entries = calloc(MAX_LARGE_NUMBER_OF_ENTRIES,
                                         sizeof(GptEntry));
   }
+  free(span.buf);
+
+  // The secondary entries are just before its header, at the end.
+  uint64_t secondary_lba = drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS;
+  if (span_sectors > secondary_lba)
+    span_sectors = secondary_lba;
+  LoadSpan(drive, &span,
+           secondary_lba + GPT_HEADER_SECTORS - span_sectors, span_sectors);
+  if (CGPT_OK != SpanCopy(drive, &span, &drive->gpt.secondary_header,
+                          secondary_lba, GPT_HEADER_SECTORS)) {
+    Error("Cannot read secondary GPT header\n");
+    goto out;
+  }
   GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
   if (CheckHeader(secondary_header, 1, drive->gpt.streaming_drive_sectors,
                   drive->gpt.gpt_drive_sectors,
                   drive->gpt.flags,
                   drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, &drive->gpt.secondary_entries,
-                        secondary_header->entries_lba,
-                        drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(secondary_header,
-                          drive->gpt.sector_bytes))) {
+    if (CGPT_OK != SpanCopy(drive, &span, &drive->gpt.secondary_entries,
+                            secondary_header->entries_lba,
+                            CalculateEntriesSectors(secondary_header,
+                              drive->gpt.sector_bytes))) {
       Error("Cannot read secondary partition entry array\n");
-      return -1;
+      goto out;
     }
   } else {
     Warning("Secondary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
              GPT_HEADER_SIGNATURE_SIZE) ? "invalid" : "being ignored");
-    drive->gpt.secondary_entries = calloc(MAX_NUMBER_OF_ENTRIES,
+    drive->gpt.secondary_entries = calloc(MAX_LARGE_NUMBER_OF_ENTRIES,
                                           sizeof(GptEntry));
   }
-  return 0;
+  rv = 0;
+
+out:
+  free(span.buf);
+  return rv;
 }
 
-static int GptSave(struct drive *drive) {
+// Writes a GPT header and/or its entries.  If both are written and they're
+// next to each other on the drive, they're written in one transfer.
+//
+// Returns the number of errors.
+static int SaveCopy(struct drive *drive, const char *name, uint8_t *header,
+                    uint64_t header_lba, int save_header,
+                    uint8_t *entries, int save_entries) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t entries_lba = ((GptHeader *)header)->entries_lba;
+  uint64_t entries_sectors = CalculateEntriesSectors((GptHeader *)header,
+                                                     sector_bytes);
+  uint64_t header_bytes = GPT_HEADER_SECTORS * sector_bytes;
+  uint64_t entries_bytes = entries_sectors * sector_bytes;
   int errors = 0;
 
-  if (!(drive->gpt.ignored & MASK_PRIMARY)) {
-    if (drive->gpt.modified & GPT_MODIFIED_HEADER1) {
-      if (CGPT_OK != Save(drive, drive->gpt.primary_header,
-                          GPT_PMBR_SECTORS,
-                          drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+  if (save_header && save_entries &&
+      (entries_lba == header_lba + GPT_HEADER_SECTORS ||
+       entries_lba + entries_sectors == header_lba)) {
+    int header_first = entries_lba > header_lba;
+    uint8_t *buf = malloc(header_bytes + entries_bytes);
+
+    if (buf) {
+      memcpy(buf + (header_first ? 0 : entries_bytes), header, header_bytes);
+      memcpy(buf + (header_first ? header_bytes : 0), entries, entries_bytes);
+      if (CGPT_OK != Save(drive, buf,
+                          header_first ? header_lba : entries_lba,
+                          sector_bytes,
+                          GPT_HEADER_SECTORS + entries_sectors)) {
         errors++;
-        Error("Cannot write primary header: %s\n", strerror(errno));
+        Error("Cannot write %s header and entries: %s\n", name,
+              strerror(errno));
       }
+      free(buf);
+      return errors;
     }
-    GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
-    if (drive->gpt.modified & GPT_MODIFIED_ENTRIES1) {
-      if (CGPT_OK != Save(drive, drive->gpt.primary_entries,
-                          primary_header->entries_lba,
-                          drive->gpt.sector_bytes,
-                          CalculateEntriesSectors(primary_header,
-                            drive->gpt.sector_bytes))) {
-        errors++;
-        Error("Cannot write primary entries: %s\n", strerror(errno));
-      }
+    // Otherwise, write them one at a time
+  }
+
+  if (save_header) {
+    if (CGPT_OK != Save(drive, header, header_lba, sector_bytes,
+                        GPT_HEADER_SECTORS)) {
+      errors++;
+      Error("Cannot write %s header: %s\n", name, strerror(errno));
     }
+  }
+  if (save_entries) {
+    if (CGPT_OK != Save(drive, entries, entries_lba, sector_bytes,
+                        entries_sectors)) {
+      errors++;
+      Error("Cannot write %s entries: %s\n", name, strerror(errno));
+    }
+  }
+  return errors;
+}
+
+static int GptSave(struct drive *drive) {
+  int errors = 0;
+
+  if (!(drive->gpt.ignored & MASK_PRIMARY)) {
+    errors += SaveCopy(drive, "primary", drive->gpt.primary_header,
+                       GPT_PMBR_SECTORS,
+                       drive->gpt.modified & GPT_MODIFIED_HEADER1,
+                       drive->gpt.primary_entries,
+                       drive->gpt.modified & GPT_MODIFIED_ENTRIES1);
 
     // Sync primary GPT before touching secondary so one is always valid.
     if (drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1))
@@ -265,25 +399,11 @@ static int GptSave(struct drive *drive) {
 
   // Only start writing secondary GPT if primary was written correctly.
   if (!errors && !(drive->gpt.ignored & MASK_SECONDARY)) {
-    if (drive->gpt.modified & GPT_MODIFIED_HEADER2) {
-      if(CGPT_OK != Save(drive, drive->gpt.secondary_header,
-                         drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
-                         drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
-        errors++;
-        Error("Cannot write secondary header: %s\n", strerror(errno));
-      }
-    }
-    GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
-    if (drive->gpt.modified & GPT_MODIFIED_ENTRIES2) {
-      if (CGPT_OK != Save(drive, drive->gpt.secondary_entries,
-                          secondary_header->entries_lba,
-                          drive->gpt.sector_bytes,
-                          CalculateEntriesSectors(secondary_header,
-                            drive->gpt.sector_bytes))) {
-        errors++;
-        Error("Cannot write secondary entries: %s\n", strerror(errno));
-      }
-    }
+    errors += SaveCopy(drive, "secondary", drive->gpt.secondary_header,
+                       drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
+                       drive->gpt.modified & GPT_MODIFIED_HEADER2,
+                       drive->gpt.secondary_entries,
+                       drive->gpt.modified & GPT_MODIFIED_ENTRIES2);
   }
 
   return errors ? -1 : 0;
@@ -317,6 +437,34 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
   return 0;
 }
 
+/*
+ * Query the physical block size and optimal transfer size of a drive, which
+ * are worth aligning reads to on 4Kn, 512e and NVMe drives.  Files and drives
+ * which don't say get the sector size and no optimal size.
+ */
+static void ObtainDriveIoSizes(int fd, uint32_t sector_bytes,
+                               uint32_t *io_align, uint32_t *io_opt) {
+  *io_align = sector_bytes;
+  *io_opt = 0;
+#ifndef HAVE_MACOS
+  unsigned int physical = 0, optimal = 0;
+  struct stat stat;
+
+  if (fstat(fd, &stat) == -1 || (stat.st_mode & S_IFMT) == S_IFREG)
+    return;
+  if (ioctl(fd, BLKPBSZGET, &physical) == 0 && physical > sector_bytes &&
+      physical % sector_bytes == 0)
+    *io_align = physical;
+  if (ioctl(fd, BLKIOOPT, &optimal) == 0)
+    *io_opt = optimal;
+#endif
+}
+
+// While a batch is open, commands on its drive share this copy of the GPT
+// instead of each loading and saving their own.
+static struct drive batch_drive;
+static const char *batch_path;
+
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size) {
   uint32_t sector_bytes;
@@ -327,6 +475,16 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   // Clear struct for proper error handling.
   memset(drive, 0, sizeof(struct drive));
 
+  if (batch_path) {
+    if (strcmp(drive_path, batch_path) ||
+        (drive_size && drive_size != batch_drive.size)) {
+      Error("Only %s can be used in this batch\n", batch_path);
+      return CGPT_FAILED;
+    }
+    *drive = batch_drive;
+    return CGPT_OK;
+  }
+
   drive->fd = open(drive_path, mode |
 #ifndef HAVE_MACOS
 		               O_LARGEFILE |
@@ -344,13 +502,16 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     goto error_close;
   }
 
+  ObtainDriveIoSizes(drive->fd, sector_bytes, &drive->io_align,
+                     &drive->io_opt);
+
   drive->gpt.gpt_drive_sectors = gpt_drive_size / sector_bytes;
   if (drive_size == 0) {
     drive->size = gpt_drive_size;
-    drive->gpt.flags = 0;
+    drive->gpt.flags = GPT_FLAG_LARGE_TABLE;
   } else {
     drive->size = drive_size;
-    drive->gpt.flags = GPT_FLAG_EXTERNAL;
+    drive->gpt.flags = GPT_FLAG_EXTERNAL | GPT_FLAG_LARGE_TABLE;
   }
 
 
@@ -370,6 +531,15 @@ error_close:
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
 
+  // Batch commands hand their changes back rather than saving them.
+  if (batch_path && drive->fd == batch_drive.fd) {
+    if (update_as_needed)
+      batch_drive = *drive;
+    else
+      batch_drive.written |= drive->written;
+    return CGPT_OK;
+  }
+
   if (update_as_needed) {
     if (GptSave(drive)) {
         errors++;
@@ -387,14 +557,31 @@ int DriveClose(struct drive *drive, int update_as_needed) {
 
   // Sync early! Only sync file descriptor here, and leave the whole system sync
   // outside cgpt because whole system sync would trigger tons of disk accesses
-  // and timeout tests.
-  fsync(drive->fd);
+  // and timeout tests.  Nothing to sync if nothing was written.
+  if (drive->written)
+    fsync(drive->fd);
 
   close(drive->fd);
 
   return errors ? CGPT_FAILED : CGPT_OK;
 }
 
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size) {
+  require(!batch_path);
+
+  if (CGPT_OK != DriveOpen(drive_path, &batch_drive, O_RDWR, drive_size))
+    return CGPT_FAILED;
+
+  batch_path = drive_path;
+  return CGPT_OK;
+}
+
+int DriveBatchEnd(int update_as_needed) {
+  require(batch_path);
+
+  batch_path = NULL;
+  return DriveClose(&batch_drive, update_as_needed);
+}
 
 /* GUID conversion functions. Accepted format:
  *
@@ -488,9 +675,30 @@ int UTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
 
   maxoutput--;                             /* plan for termination now */
 
-  for (s16idx = s8idx = 0;
-       s16idx < maxinput && utf16[s16idx] && maxoutput;
-       s16idx++) {
+  /*
+   * Labels are nearly always ASCII, so copy runs of four ASCII code units a
+   * word at a time.  Anything else, including the terminator, is left for
+   * the full decoder below.
+   */
+  for (s16idx = s8idx = 0; s16idx + 4 <= maxinput && maxoutput >= 4;
+       s16idx += 4) {
+    uint64_t units;
+
+    memcpy(&units, utf16 + s16idx, sizeof(units));
+    units = le64toh(units);
+    /* Stop at any unit above 0x7F, or equal to zero. */
+    if ((units & 0xFF80FF80FF80FF80ULL) ||
+        ((units + 0x7FFF7FFF7FFF7FFFULL) & 0x8000800080008000ULL) !=
+        0x8000800080008000ULL)
+      break;
+    utf8[s8idx++] = units;
+    utf8[s8idx++] = units >> 16;
+    utf8[s8idx++] = units >> 32;
+    utf8[s8idx++] = units >> 48;
+    maxoutput -= 4;
+  }
+
+  for (; s16idx < maxinput && utf16[s16idx] && maxoutput; s16idx++) {
     uint16_t codeunit = le16toh(utf16[s16idx]);
 
     if (code_point_ready) {
@@ -577,9 +785,18 @@ int UTF8ToUTF16(const uint8_t *utf8, uint16_t *utf16, unsigned int maxoutput)
 
   maxoutput--;                             /* plan for termination */
 
+  /*
+   * Copy the leading ASCII directly.  The string's length isn't known, so
+   * this goes a byte at a time rather than reading past the terminator.
+   */
   for (s8idx = s16idx = 0;
-       utf8[s8idx] && maxoutput;
+       utf8[s8idx] && utf8[s8idx] <= 0x7F && maxoutput;
        s8idx++) {
+    utf16[s16idx++] = utf8[s8idx];
+    maxoutput--;
+  }
+
+  for (; utf8[s8idx] && maxoutput; s8idx++) {
     uint8_t code_unit;
     code_unit = utf8[s8idx];
 
@@ -62,6 +62,17 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
     /* Calculate number of entries */
     h->size_of_entry = sizeof(GptEntry);
     h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+    if (params->num_entries) {
+      uint32_t min_entries = (drive->gpt.flags & GPT_FLAG_EXTERNAL) ?
+          MIN_NUMBER_OF_ENTRIES : MAX_NUMBER_OF_ENTRIES;
+      if (params->num_entries < min_entries ||
+          params->num_entries > MAX_LARGE_NUMBER_OF_ENTRIES) {
+        Error("Number of entries must be between %d and %d.\n",
+              min_entries, MAX_LARGE_NUMBER_OF_ENTRIES);
+        return -1;
+      }
+      h->number_of_entries = params->num_entries;
+    }
     if (drive->gpt.flags & GPT_FLAG_EXTERNAL) {
       // We might have smaller space for the GPT table. Scale accordingly.
       //
@@ -104,7 +115,9 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
       h->last_usable_lba = (drive->gpt.streaming_drive_sectors - 1);
     }
 
-    size_t entries_size = h->number_of_entries * h->size_of_entry;
+    /* Whole sectors, since that's how much of the arrays gets written */
+    size_t entries_size = CalculateEntriesSectors(h, drive->gpt.sector_bytes) *
+                          drive->gpt.sector_bytes;
     AllocAndClear(&drive->gpt.primary_entries, entries_size);
     AllocAndClear(&drive->gpt.secondary_entries, entries_size);
 
@@ -3,6 +3,9 @@
 // found in the LICENSE file.
 
 #include <ctype.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -15,30 +18,29 @@
 
 #define BUFSIZE 1024
 
-// fill comparebuf with the data to be examined, returning true on success.
-static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
-                       uint64_t count) {
-  uint8_t *bufptr = params->comparebuf;
-
-  if (-1 == lseek(fd, pos, SEEK_SET))
-    return 0;
+// fill buf with the data to be examined, returning true on success. This
+// doesn't move the file offset, so scan threads can share a drive.
+static int FillBuffer(uint8_t *buf, int fd, uint64_t pos, uint64_t count) {
+  uint8_t *bufptr = buf;
 
   // keep reading until done or error
   while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+    ssize_t bytes_read = pread(fd, bufptr, count, pos);
     // negative means error, 0 means (unexpected) EOF
     if (bytes_read <= 0)
       return 0;
     count -= bytes_read;
     bufptr += bytes_read;
+    pos += bytes_read;
   }
 
   return 1;
 }
 
-// check partition data content. return true for match, 0 for no match or error
+// check partition data content, reading it into comparebuf (which must hold
+// params->matchlen bytes). return true for match, 0 for no match or error
 static int match_content(CgptFindParams *params, struct drive *drive,
-                             GptEntry *entry) {
+                         GptEntry *entry, uint8_t *comparebuf) {
   uint64_t part_size;
 
   if (!params->matchlen)
@@ -52,7 +54,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Read the partition data.
-  if (!FillBuffer(params, drive->fd,
+  if (!FillBuffer(comparebuf, drive->fd,
     (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset,
                   params->matchlen)) {
     Error("unable to read partition data\n");
@@ -60,7 +62,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Compare it
-  if (0 == memcmp(params->matchbuf, params->comparebuf, params->matchlen)) {
+  if (0 == memcmp(params->matchbuf, comparebuf, params->matchlen)) {
     return 1;
   }
 
@@ -108,16 +110,40 @@ static void chromeos_mtd_show(CgptFindParams *params, const char *filename,
   }
 }
 
+// Returns 1 if the entry's GUIDs or label match the search criteria, 0 if
+// not, or -1 if the label can't be converted.
+static int match_entry(CgptFindParams *params, GptEntry *entry) {
+  char partlabel[GPT_PARTNAME_LEN];
+
+  if ((params->set_unique && GuidEqual(&params->unique_guid, &entry->unique))
+      || (params->set_type && GuidEqual(&params->type_guid, &entry->type)))
+    return 1;
+
+  if (params->set_label) {
+    if (CGPT_OK != UTF16ToUTF8(entry->name,
+                               sizeof(entry->name) / sizeof(entry->name[0]),
+                               (uint8_t *)partlabel, sizeof(partlabel))) {
+      Error("The label cannot be converted from UTF16, so abort.\n");
+      return -1;
+    }
+    if (!strncmp(params->label, partlabel, sizeof(partlabel)))
+      return 1;
+  }
+
+  return 0;
+}
+
 // This returns true if a GPT partition matches the search criteria. If a match
 // isn't found (or if the file doesn't contain a GPT), it returns false. The
 // filename and partition number that matched is left in a global, since we
-// could have multiple hits.
+// could have multiple hits. If 'content' isn't NULL, it holds the result of
+// match_content() for each entry that matches the other criteria, already
+// worked out by probe_content().
 static int gpt_search(CgptFindParams *params, struct drive *drive,
-                      const char *filename) {
+                      const char *filename, const uint8_t *content) {
   int i;
   GptEntry *entry;
   int retval = 0;
-  char partlabel[GPT_PARTNAME_LEN];
 
   if (GPT_SUCCESS != GptSanityCheck(&drive->gpt)) {
     return 0;
@@ -129,21 +155,11 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
     if (GuidIsZero(&entry->type))
       continue;
 
-    int found = 0;
-    if ((params->set_unique && GuidEqual(&params->unique_guid, &entry->unique))
-        || (params->set_type && GuidEqual(&params->type_guid, &entry->type))) {
-      found = 1;
-    } else if (params->set_label) {
-      if (CGPT_OK != UTF16ToUTF8(entry->name,
-                                 sizeof(entry->name) / sizeof(entry->name[0]),
-                                 (uint8_t *)partlabel, sizeof(partlabel))) {
-        Error("The label cannot be converted from UTF16, so abort.\n");
-        return 0;
-      }
-      if (!strncmp(params->label, partlabel, sizeof(partlabel)))
-        found = 1;
-    }
-    if (found && match_content(params, drive, entry)) {
+    int found = match_entry(params, entry);
+    if (found < 0)
+      return 0;
+    if (found && (content ? content[i] :
+                  match_content(params, drive, entry, params->comparebuf))) {
       params->hits++;
       retval++;
       showmatch(params, filename, i+1, entry);
@@ -155,14 +171,278 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
   return retval;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Index of partition tables for 'cgpt find -C FILE', so repeated lookups on the
+// same drives don't read them again. A drive's record is used while its path,
+// device and inode numbers, size and mtime, and the -D size, are unchanged.
+// The index only holds the entries, so content matching (-M) still reads the
+// drives.
+
+#define FIND_CACHE_MAGIC "CGPTFC01"
+
+struct find_cache_drive {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t rdev;
+  uint64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t drive_size;                  // -D size it was loaded with
+  uint32_t path_len;                    // including the terminator
+  uint32_t num_entries;
+  // Followed by the path, then num_entries of struct find_cache_entry.
+};
+
+struct find_cache_entry {
+  uint32_t index;
+  uint32_t reserved;
+  GptEntry entry;
+};
+
+struct find_cache_record {
+  struct find_cache_drive drive;
+  char *path;
+  struct find_cache_entry *entries;
+};
+
+struct find_cache {
+  struct find_cache_record *records;
+  int count;
+  int dirty;                            // needs to be saved
+};
+
+// Index in use by CgptFind(), if any.
+static struct find_cache *find_cache;
+
+static void FreeCache(struct find_cache *cache) {
+  int i;
+
+  for (i = 0; i < cache->count; i++) {
+    free(cache->records[i].path);
+    free(cache->records[i].entries);
+  }
+  free(cache->records);
+  free(cache);
+}
+
+static int ReadAll(FILE *fp, void *buf, size_t size) {
+  return size == 0 || fread(buf, size, 1, fp) == 1;
+}
+
+// Load the index from 'filename'. A missing or unreadable index is empty.
+static struct find_cache *LoadCache(const char *filename) {
+  struct find_cache *cache = calloc(1, sizeof(*cache));
+  struct find_cache_record rec;
+  char magic[sizeof(FIND_CACHE_MAGIC)];
+  FILE *fp;
+
+  require(cache);
+  fp = fopen(filename, "rbe");
+  if (!fp)
+    return cache;
+
+  if (!ReadAll(fp, magic, sizeof(magic)) ||
+      memcmp(magic, FIND_CACHE_MAGIC, sizeof(magic))) {
+    fclose(fp);
+    return cache;
+  }
+
+  while (ReadAll(fp, &rec.drive, sizeof(rec.drive))) {
+    struct find_cache_record *records;
+
+    if (!rec.drive.path_len || rec.drive.path_len > BUFSIZE ||
+        rec.drive.num_entries > MAX_LARGE_NUMBER_OF_ENTRIES)
+      break;
+    rec.path = malloc(rec.drive.path_len);
+    rec.entries = calloc(rec.drive.num_entries, sizeof(*rec.entries));
+    records = realloc(cache->records,
+                      (cache->count + 1) * sizeof(*cache->records));
+    if (records)
+      cache->records = records;
+    if (!rec.path || !rec.entries || !records ||
+        !ReadAll(fp, rec.path, rec.drive.path_len) ||
+        rec.path[rec.drive.path_len - 1] ||
+        !ReadAll(fp, rec.entries,
+                 rec.drive.num_entries * sizeof(*rec.entries))) {
+      free(rec.path);
+      free(rec.entries);
+      break;
+    }
+    cache->records[cache->count++] = rec;
+  }
+
+  fclose(fp);
+  return cache;
+}
+
+// Write the index to 'filename', through a temporary file so readers never
+// see half of it.
+static void SaveCache(struct find_cache *cache, const char *filename) {
+  char *tmpname;
+  FILE *fp;
+  int ok;
+  int i;
+
+  if (asprintf(&tmpname, "%s.tmp", filename) == -1)
+    return;
+
+  fp = fopen(tmpname, "wbe");
+  if (!fp) {
+    Warning("Can't write %s\n", tmpname);
+    free(tmpname);
+    return;
+  }
+  ok = fwrite(FIND_CACHE_MAGIC, sizeof(FIND_CACHE_MAGIC), 1, fp) == 1;
+  for (i = 0; ok && i < cache->count; i++) {
+    struct find_cache_record *rec = &cache->records[i];
+
+    ok = fwrite(&rec->drive, sizeof(rec->drive), 1, fp) == 1 &&
+        fwrite(rec->path, rec->drive.path_len, 1, fp) == 1 &&
+        (!rec->drive.num_entries ||
+         fwrite(rec->entries, sizeof(*rec->entries),
+                rec->drive.num_entries, fp) == rec->drive.num_entries);
+  }
+  if (fclose(fp) || !ok || rename(tmpname, filename)) {
+    Warning("Can't write %s\n", filename);
+    unlink(tmpname);
+  }
+  free(tmpname);
+}
+
+// Fill in the identity of the drive at 'path'. Returns 0 on success.
+static int CacheIdentity(CgptFindParams *params, const char *path,
+                         struct find_cache_drive *id) {
+  struct stat st;
+
+  if (stat(path, &st))
+    return -1;
+
+  memset(id, 0, sizeof(*id));
+  id->dev = st.st_dev;
+  id->ino = st.st_ino;
+  id->rdev = st.st_rdev;
+  id->size = st.st_size;
+#ifndef HAVE_MACOS
+  id->mtime_sec = st.st_mtim.tv_sec;
+  id->mtime_nsec = st.st_mtim.tv_nsec;
+#else
+  id->mtime_sec = st.st_mtimespec.tv_sec;
+  id->mtime_nsec = st.st_mtimespec.tv_nsec;
+#endif
+  id->drive_size = params->drive_size;
+  id->path_len = strlen(path) + 1;
+  return 0;
+}
+
+static struct find_cache_record *CacheFind(struct find_cache *cache,
+                                           const char *path) {
+  int i;
+
+  for (i = 0; i < cache->count; i++) {
+    if (!strcmp(cache->records[i].path, path))
+      return &cache->records[i];
+  }
+  return NULL;
+}
+
+// Record the used entries of a drive that was just loaded. A drive without a
+// valid GPT is recorded with no entries.
+static void CacheStore(struct find_cache *cache, CgptFindParams *params,
+                       const char *path, struct drive *drive) {
+  struct find_cache_record *rec;
+  struct find_cache_drive id;
+  uint32_t i;
+
+  if (CacheIdentity(params, path, &id))
+    return;
+
+  rec = CacheFind(cache, path);
+  if (!rec) {
+    struct find_cache_record *records =
+        realloc(cache->records, (cache->count + 1) * sizeof(*cache->records));
+    char *new_path = strdup(path);
+
+    if (!records || !new_path) {
+      if (records)
+        cache->records = records;
+      free(new_path);
+      return;
+    }
+    cache->records = records;
+    rec = &cache->records[cache->count++];
+    rec->path = new_path;
+  } else {
+    free(rec->entries);
+  }
+  rec->drive = id;
+  rec->entries = NULL;
+  cache->dirty = 1;
+
+  if (GPT_SUCCESS != GptSanityCheck(&drive->gpt))
+    return;
+
+  rec->entries = calloc(GetNumberOfEntries(drive), sizeof(*rec->entries));
+  if (!rec->entries)
+    return;
+  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, i);
+
+    if (GuidIsZero(&entry->type))
+      continue;
+    rec->entries[rec->drive.num_entries].index = i;
+    rec->entries[rec->drive.num_entries].entry = *entry;
+    rec->drive.num_entries++;
+  }
+}
+
+// Search a drive's record, like gpt_search() does for a loaded drive. Returns
+// -1 if there's no up to date record.
+static int cache_search(struct find_cache *cache, CgptFindParams *params,
+                        const char *filename) {
+  struct find_cache_record *rec = CacheFind(cache, filename);
+  struct find_cache_drive id;
+  int retval = 0;
+  uint32_t i;
+
+  if (!rec || CacheIdentity(params, filename, &id) ||
+      memcmp(&id, &rec->drive, offsetof(struct find_cache_drive, num_entries)))
+    return -1;
+
+  for (i = 0; i < rec->drive.num_entries; i++) {
+    GptEntry *entry = &rec->entries[i].entry;
+    int found = match_entry(params, entry);
+
+    if (found < 0)
+      return 0;
+    if (found) {
+      params->hits++;
+      retval++;
+      showmatch(params, filename, rec->entries[i].index + 1, entry);
+      if (!params->match_partnum)
+        params->match_partnum = rec->entries[i].index + 1;
+    }
+  }
+
+  return retval;
+}
+
 static int do_search(CgptFindParams *params, const char *fileName) {
   int retval;
   struct drive drive;
+  int use_cache = find_cache && !params->matchlen;
+
+  if (use_cache) {
+    retval = cache_search(find_cache, params, fileName);
+    if (retval >= 0)
+      return retval;
+  }
 
   if (CGPT_OK != DriveOpen(fileName, &drive, O_RDONLY, params->drive_size))
     return 0;
 
-  retval = gpt_search(params, &drive, fileName);
+  retval = gpt_search(params, &drive, fileName, NULL);
+  if (use_cache)
+    CacheStore(find_cache, params, fileName, &drive);
 
   (void) DriveClose(&drive, 0);
 
@@ -213,6 +493,154 @@ static char *is_wholedev(const char *basename) {
   return 0;
 }
 
+// A whole drive found by scan_real_devs().
+struct scan_dev {
+  char *pathname;
+  struct drive drive;
+  int loaded;                           // DriveOpen() succeeded
+  int done;                             // a worker has tried to load it
+  uint8_t *content;                     // probe_content() results, for -M
+};
+
+// Work shared between the threads of a parallel scan. Workers load drives in
+// order; the main thread searches them in the same order as they finish, so
+// the output is the same as for a serial scan.
+struct scan_pool {
+  CgptFindParams *params;
+  struct scan_dev *devs;
+  int count;
+  int next;                             // next drive for a worker to load
+  int searched;                         // drives the main thread is done with
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+// Work out match_content() for each entry of a loaded drive that matches the
+// other criteria, so the main thread doesn't wait on the reads one partition
+// at a time. Leaves dev->content NULL if that can't be done, in which case
+// gpt_search() reads the content itself.
+static void probe_content(CgptFindParams *params, struct scan_dev *dev,
+                          uint8_t *comparebuf) {
+  struct drive *drive = &dev->drive;
+  uint32_t i;
+
+  if (GPT_SUCCESS != GptSanityCheck(&drive->gpt))
+    return;
+
+  dev->content = calloc(GetNumberOfEntries(drive), sizeof(*dev->content));
+  if (!dev->content)
+    return;
+
+  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, i);
+
+    if (GuidIsZero(&entry->type))
+      continue;
+    if (match_entry(params, entry) > 0)
+      dev->content[i] = match_content(params, drive, entry, comparebuf);
+  }
+}
+
+static void *scan_worker(void *arg) {
+  struct scan_pool *pool = arg;
+  struct scan_dev *dev;
+  uint8_t *comparebuf = NULL;
+  int loaded;
+
+  // Each worker reads content into its own buffer.
+  if (pool->params->matchlen)
+    comparebuf = malloc(pool->params->matchlen);
+
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    // Don't hold more than params->jobs drives open at once.
+    while (pool->next < pool->count &&
+           pool->next - pool->searched >= pool->params->jobs)
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    if (pool->next >= pool->count) {
+      pthread_mutex_unlock(&pool->lock);
+      free(comparebuf);
+      return NULL;
+    }
+    dev = &pool->devs[pool->next++];
+    pthread_mutex_unlock(&pool->lock);
+
+    // This reads the PMBR, headers and entries.
+    loaded = (CGPT_OK == DriveOpen(dev->pathname, &dev->drive, O_RDONLY,
+                                   pool->params->drive_size));
+    if (loaded && comparebuf)
+      probe_content(pool->params, dev, comparebuf);
+
+    pthread_mutex_lock(&pool->lock);
+    dev->loaded = loaded;
+    dev->done = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+// Search the given drives, loading up to params->jobs of them (and reading
+// their -M content) in parallel.
+// Returns the number of drives with matches, or -1 if no threads could be
+// started, in which case nothing has been searched.
+static int scan_parallel(CgptFindParams *params, struct scan_dev *devs,
+                         int count) {
+  struct scan_pool pool;
+  pthread_t *threads;
+  int nthreads = params->jobs < count ? params->jobs : count;
+  int started = 0;
+  int found = 0;
+  int i;
+
+  threads = calloc(nthreads, sizeof(*threads));
+  if (!threads)
+    return -1;
+
+  memset(&pool, 0, sizeof(pool));
+  pool.params = params;
+  pool.devs = devs;
+  pool.count = count;
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.cond, NULL);
+
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[started], NULL, scan_worker, &pool))
+      break;
+    started++;
+  }
+
+  if (started) {
+    for (i = 0; i < count; i++) {
+      pthread_mutex_lock(&pool.lock);
+      while (!devs[i].done)
+        pthread_cond_wait(&pool.cond, &pool.lock);
+      pthread_mutex_unlock(&pool.lock);
+
+      if (devs[i].loaded) {
+        if (gpt_search(params, &devs[i].drive, devs[i].pathname,
+                       devs[i].content))
+          found++;
+        (void) DriveClose(&devs[i].drive, 0);
+        free(devs[i].content);
+      }
+
+      pthread_mutex_lock(&pool.lock);
+      pool.searched++;
+      pthread_cond_broadcast(&pool.cond);
+      pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (i = 0; i < started; i++)
+      pthread_join(threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool.cond);
+  pthread_mutex_destroy(&pool.lock);
+  free(threads);
+
+  return started ? found : -1;
+}
+
 // This scans all the physical devices it can find, looking for a match. It
 // returns true if any matches were found, false otherwise.
 static int scan_real_devs(CgptFindParams *params) {
@@ -221,6 +649,10 @@ static int scan_real_devs(CgptFindParams *params) {
   char partname_prev[MAX_PARTITION_NAME_LEN];
   FILE *fp;
   char *pathname;
+  struct scan_dev *devs = NULL;
+  int count = 0;
+  int parallel_found = -1;
+  int i;
 
   fp = fopen(PROC_PARTITIONS, "re");
   if (!fp) {
@@ -244,8 +676,14 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
+        // is_wholedev() returns a static buffer, so keep a copy.
+        struct scan_dev *newdevs = realloc(devs, (count + 1) * sizeof(*devs));
+        if (newdevs) {
+          devs = newdevs;
+          memset(&devs[count], 0, sizeof(*devs));
+          devs[count].pathname = strdup(pathname);
+          if (devs[count].pathname)
+            count++;
         }
       }
     }
@@ -255,6 +693,23 @@ static int scan_real_devs(CgptFindParams *params) {
 
   fclose(fp);
 
+  // With an index, most drives shouldn't need loading at all, unless their
+  // content is wanted.
+  if (params->jobs > 1 && count > 1 && (!find_cache || params->matchlen))
+    parallel_found = scan_parallel(params, devs, count);
+  if (parallel_found >= 0) {
+    found += parallel_found;
+  } else {
+    for (i = 0; i < count; i++) {
+      if (do_search(params, devs[i].pathname)) {
+        found++;
+      }
+    }
+  }
+  for (i = 0; i < count; i++)
+    free(devs[i].pathname);
+  free(devs);
+
   fp = fopen(PROC_MTD, "re");
   if (!fp) {
     free(line);
@@ -283,11 +738,16 @@ static int scan_real_devs(CgptFindParams *params) {
       }
       char nor_file[64];
       if (snprintf(nor_file, sizeof(nor_file), "%s/rw_gpt", temp_dir) > 0) {
+        // The temp file is new every time, so there's no point indexing it.
+        struct find_cache *cache = find_cache;
+
+        find_cache = NULL;
         params->show_fn = chromeos_mtd_show;
         if (do_search(params, nor_file)) {
           found++;
         }
         params->show_fn = NULL;
+        find_cache = cache;
       }
       RemoveDir(temp_dir);
       break;
@@ -304,8 +764,18 @@ void CgptFind(CgptFindParams *params) {
   if (params == NULL)
     return;
 
+  if (params->cache_file)
+    find_cache = LoadCache(params->cache_file);
+
   if (params->drive_name != NULL)
     do_search(params, params->drive_name);
   else
     scan_real_devs(params);
+
+  if (find_cache) {
+    if (find_cache->dirty)
+      SaveCache(find_cache, params->cache_file);
+    FreeCache(find_cache);
+    find_cache = NULL;
+  }
 }
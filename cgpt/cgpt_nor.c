@@ -22,6 +22,7 @@
 
 #include "cgpt.h"
 #include "cgpt_nor.h"
+#include "host_misc.h"
 
 static const char FLASHROM_PATH[] = "/usr/sbin/flashrom";
 
@@ -92,100 +93,6 @@ int ForkExecL(const char *cwd, const char *cmd, ...) {
   return ret;
 }
 
-static int read_write(int source_fd,
-                      uint64_t size,
-                      const char *src_name,
-                      int idx) {
-  int ret = 1;
-  const int bufsize = 4096;
-  char *buf = malloc(bufsize);
-  if (buf == NULL) {
-    goto clean_exit;
-  }
-
-  ret++;
-  char *dest;
-  if (asprintf(&dest, "%s_%d", src_name, idx) == -1) {
-    goto free_buf;
-  }
-
-  ret++;
-  int dest_fd = open(dest, O_WRONLY | O_CLOEXEC | O_CREAT, 0600);
-  if (dest_fd < 0) {
-    goto free_dest;
-  }
-
-  ret++;
-  uint64_t copied = 0;
-  ssize_t nr_read;
-  ssize_t nr_write;
-  while (copied < size) {
-    size_t to_read = size - copied;
-    if (to_read > bufsize) {
-      to_read = bufsize;
-    }
-    nr_read = read(source_fd, buf, to_read);
-    if (nr_read < 0) {
-      goto close_dest_fd;
-    }
-    nr_write = 0;
-    while (nr_write < nr_read) {
-      ssize_t s = write(dest_fd, buf + nr_write, nr_read - nr_write);
-      if (s < 0) {
-        goto close_dest_fd;
-      }
-      nr_write += s;
-    }
-    copied += nr_read;
-  }
-
-  ret = 0;
-
-close_dest_fd:
-  close(dest_fd);
-free_dest:
-  free(dest);
-free_buf:
-  free(buf);
-clean_exit:
-  return ret;
-}
-
-static int split_gpt(const char *dir_name, const char *file_name) {
-  int ret = 1;
-  char *source;
-  if (asprintf(&source, "%s/%s", dir_name, file_name) == -1) {
-    goto clean_exit;
-  }
-
-  ret++;
-  int fd = open(source, O_RDONLY | O_CLOEXEC);
-  if (fd < 0) {
-    goto free_source;
-  }
-
-  ret++;
-  struct stat stat;
-  if (fstat(fd, &stat) != 0 || (stat.st_size & 1) != 0) {
-    goto close_fd;
-  }
-  uint64_t half_size = stat.st_size / 2;
-
-  ret++;
-  if (read_write(fd, half_size, source, 1) != 0 ||
-      read_write(fd, half_size, source, 2) != 0) {
-    goto close_fd;
-  }
-
-  ret = 0;
-close_fd:
-  close(fd);
-free_source:
-  free(source);
-clean_exit:
-  return ret;
-}
-
 static int remove_file_or_dir(const char *fpath, const struct stat *sb,
                               int typeflag, struct FTW *ftwbuf) {
   return remove(fpath);
@@ -228,36 +135,69 @@ int ReadNorFlash(char *temp_dir_template) {
   return ret;
 }
 
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir) {
+// Write the halves of "rw_gpt" in |dir| that differ from |original| back to
+// NOR flash. Each half is written by itself, so one copy of the GPT is always
+// valid.
+int WriteNorFlash(const char *dir, const uint8_t *original,
+                  uint64_t original_size) {
+  static const char *const regions[] = {
+    "RW_GPT_PRIMARY:rw_gpt_1",
+    "RW_GPT_SECONDARY:rw_gpt_2",
+  };
   int ret = 0;
+  char *path;
+  uint8_t *data;
+  uint64_t size;
+  uint64_t half_size;
+  int nr_changed = 0;
+  int nr_fails = 0;
+  int i;
+
   ret++;
-  if (split_gpt(dir, "rw_gpt") != 0) {
+  if (asprintf(&path, "%s/rw_gpt", dir) == -1)
+    return ret;
+  data = ReadFile(path, &size);
+  free(path);
+  if (!data || size != original_size || (size & 1) != 0) {
     Error("Cannot split rw_gpt in two.\n");
+    free(data);
     return ret;
   }
+  half_size = size / 2;
+
   ret++;
-  int nr_fails = 0;
   int fd_flags = fcntl(1, F_GETFD);
   // Close stdout on exec so that flashrom does not muck up cgpt's output.
   if (0 != fcntl(1, F_SETFD, FD_CLOEXEC))
     Warning("Can't stop flashrom from mucking up our output\n");
-  if (ForkExecL(dir, FLASHROM_PATH, "-i", "RW_GPT_PRIMARY:rw_gpt_1",
-                "-w", "--fast-verify", NULL) != 0) {
-    Warning("Cannot write the 1st half of rw_gpt back with flashrom.\n");
-    nr_fails++;
-  }
-  if (ForkExecL(dir, FLASHROM_PATH, "-i", "RW_GPT_SECONDARY:rw_gpt_2",
-                "-w", "--fast-verify", NULL) != 0) {
-    Warning("Cannot write the 2nd half of rw_gpt back with flashrom.\n");
-    nr_fails++;
+  for (i = 0; i < 2; i++) {
+    const uint8_t *half = data + i * half_size;
+
+    // Leave the flash alone if this copy didn't change.
+    if (!memcmp(half, original + i * half_size, half_size))
+      continue;
+    nr_changed++;
+
+    if (asprintf(&path, "%s/rw_gpt_%d", dir, i + 1) == -1 ||
+        0 != WriteFile(path, half, half_size)) {
+      Warning("Cannot save half %d of rw_gpt.\n", i + 1);
+      nr_fails++;
+    } else if (ForkExecL(dir, FLASHROM_PATH, "-i", regions[i],
+                         "-w", "--fast-verify", NULL) != 0) {
+      Warning("Cannot write half %d of rw_gpt back with flashrom.\n", i + 1);
+      nr_fails++;
+    }
+    free(path);
   }
   if (0 != fcntl(1, F_SETFD, fd_flags))
     Warning("Can't restore stdout flags\n");
-  switch (nr_fails) {
-    case 0: ret = 0; break;
-    case 1: Warning("It might still be okay.\n"); break;
-    case 2: Error("Cannot write both parts back with flashrom.\n"); break;
-  }
+  free(data);
+
+  if (!nr_fails)
+    ret = 0;
+  else if (nr_fails < nr_changed)
+    Warning("It might still be okay.\n");
+  else
+    Error("Cannot write rw_gpt back with flashrom.\n");
   return ret;
 }
@@ -28,7 +28,10 @@ int RemoveDir(const char *dir);
 // requirements by mkdtemp().
 int ReadNorFlash(char *temp_dir_template);
 
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir);
+// Write the halves of "rw_gpt" in |dir| that differ from |original|, its
+// contents as read by ReadNorFlash(), back to NOR flash. Each half is written
+// by itself for safety. Returns 0 on success, including if nothing changed.
+int WriteNorFlash(const char *dir, const uint8_t *original,
+                  uint64_t original_size);
 
 #endif  // VBOOT_REFERCENCE_CGPT_CGPT_NOR_H_
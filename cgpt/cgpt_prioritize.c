@@ -9,86 +9,26 @@
 #include "vboot_host.h"
 
 //////////////////////////////////////////////////////////////////////////////
-// We need a sorted list of priority groups, where each element in the list
-// contains an unordered list of GPT partition numbers.
+// Kernels are grouped by priority and the groups keep their order, so the new
+// priorities come from which of the 16 possible priorities are in use, plus
+// one "higher" group for the partition being raised.  That's a counting sort,
+// done in two passes over the entries.
 
-#define MAX_GROUPS 17                   // 0-15, plus one "higher"
+#define RAISED_GROUP 16                 // above 0-15
+#define NUM_GROUPS 17
 
-typedef struct {
-  int priority;                         // priority of this group
-  int num_parts;                        // number of partitions in this group
-  uint32_t *part;                       // array of partitions in this group
-} group_t;
+// Returns the group for kernel partition 'index'.
+static int GetGroup(struct drive *drive, CgptPrioritizeParams *params,
+                    uint32_t index) {
+  int priority = GetPriority(drive, PRIMARY, index);
 
-typedef struct {
-  int max_parts;                       // max number of partitions in any group
-  int num_groups;                      // number of non-empty groups
-  group_t group[MAX_GROUPS];           // array of groups
-} group_list_t;
-
-
-static group_list_t *NewGroupList(int max_p) {
-  int i;
-  group_list_t *gl = (group_list_t *)malloc(sizeof(group_list_t));
-  require(gl);
-  gl->max_parts = max_p;
-  gl->num_groups = 0;
-  // reserve space for the maximum number of partitions in every group
-  for (i=0; i<MAX_GROUPS; i++) {
-    gl->group[i].priority = -1;
-    gl->group[i].num_parts = 0;
-    gl->group[i].part = (uint32_t *)malloc(sizeof(uint32_t) * max_p);
-    require(gl->group[i].part);
-  }
-
-  return gl;
-}
-
-static void FreeGroups(group_list_t *gl) {
-  int i;
-  for (i=0; i<MAX_GROUPS; i++)
-    free(gl->group[i].part);
-  free(gl);
-}
-
-static void AddToGroup(group_list_t *gl, int priority, int partition) {
-  int i;
-  // See if I've already got a group with this priority
-  for (i=0; i<gl->num_groups; i++)
-    if (gl->group[i].priority == priority)
-      break;
-  if (i == gl->num_groups) {
-    // no, add a group
-    require(i < MAX_GROUPS);
-    gl->num_groups++;
-    gl->group[i].priority = priority;
-  }
-  // add the partition to it
-  int j = gl->group[i].num_parts;
-  gl->group[i].part[j] = partition;
-  gl->group[i].num_parts++;
-}
-
-static void ChangeGroup(group_list_t *gl, int old_priority, int new_priority) {
-  int i;
-  for (i=0; i<gl->num_groups; i++)
-    if (gl->group[i].priority == old_priority) {
-      gl->group[i].priority = new_priority;
-      break;
-    }
-}
-
-static void SortGroups(group_list_t *gl) {
-  int i, j;
-  group_t tmp;
-
-  // straight insertion sort is fast enough
-  for (i=1; i<gl->num_groups; i++) {
-    tmp = gl->group[i];
-    for (j=i; j && (gl->group[j-1].priority < tmp.priority); j--)
-      gl->group[j] = gl->group[j-1];
-    gl->group[j] = tmp;
+  if (params->set_partition) {
+    if (index + 1 == params->set_partition)
+      return RAISED_GROUP;             // move this one
+    if (params->set_friends && priority == params->orig_priority)
+      return RAISED_GROUP;             // and its friends, if asked
   }
+  return priority;
 }
 
 int CgptPrioritize(CgptPrioritizeParams *params) {
@@ -99,9 +39,9 @@ int CgptPrioritize(CgptPrioritizeParams *params) {
   int gpt_retval;
   uint32_t index;
   uint32_t max_part;
-  int num_kernels;
-  int i,j;
-  group_list_t *groups;
+  int new_priority[NUM_GROUPS];
+  int num_groups;
+  int i;
 
   if (params == NULL)
     return CGPT_FAILED;
@@ -136,71 +76,45 @@ int CgptPrioritize(CgptPrioritizeParams *params) {
       Error("partition %d is not a ChromeOS kernel\n", params->set_partition);
       goto bad;
     }
+    params->orig_priority = GetPriority(&drive, PRIMARY, index);
   }
 
-  // How many kernel partitions do I have?
-  num_kernels = 0;
+  // Which groups are in use?
+  memset(new_priority, 0, sizeof(new_priority));
   for (i = 0; i < max_part; i++) {
     if (IsKernel(&drive, PRIMARY, i))
-      num_kernels++;
+      new_priority[GetGroup(&drive, params, i)] = 1;
   }
 
-  if (num_kernels) {
-    // Determine the current priority groups
-    groups = NewGroupList(num_kernels);
-    for (i = 0; i < max_part; i++) {
-      if (!IsKernel(&drive, PRIMARY, i))
-        continue;
-
-      priority = GetPriority(&drive, PRIMARY, i);
-
-      // Is this partition special?
-      if (params->set_partition && (i+1 == params->set_partition)) {
-        params->orig_priority = priority;  // remember the original priority
-        if (params->set_friends)
-          AddToGroup(groups, priority, i); // we'll move them all later
-        else
-          AddToGroup(groups, 99, i);       // move only this one
-      } else {
-        AddToGroup(groups, priority, i);   // just remember
-      }
-    }
-
-    // If we're including friends, then change the original group priority
-    if (params->set_partition && params->set_friends) {
-      ChangeGroup(groups, params->orig_priority, 99);
-    }
-
-    // Sorting gives the new order. Now we just need to reassign the
-    // priorities.
-    SortGroups(groups);
-
-    // We'll never lower anything to zero, so if the last group is priority zero
-    // we can ignore it.
-    i = groups->num_groups;
-    if (groups->group[i-1].priority == 0)
-      groups->num_groups--;
-
-    // Where do we start?
-    if (params->max_priority)
-      priority = params->max_priority;
-    else
-      priority = groups->num_groups > 15 ? 15 : groups->num_groups;
-
-    // Figure out what the new values should be
-    for (i=0; i<groups->num_groups; i++) {
-      groups->group[i].priority = priority;
-      if (priority > 1)
-        priority--;
-    }
+  // We'll never lower anything to zero, so priority zero is left alone.
+  num_groups = 0;
+  for (i = 1; i < NUM_GROUPS; i++)
+    num_groups += new_priority[i];
+
+  // Where do we start?
+  if (params->max_priority)
+    priority = params->max_priority;
+  else
+    priority = num_groups > 15 ? 15 : num_groups;
+
+  // Figure out what the new values should be, highest group first
+  for (i = NUM_GROUPS - 1; i > 0; i--) {
+    if (!new_priority[i])
+      continue;
+    new_priority[i] = priority;
+    if (priority > 1)
+      priority--;
+  }
 
-    // Now apply the ranking to the GPT
-    for (i=0; i<groups->num_groups; i++)
-      for (j=0; j<groups->group[i].num_parts; j++)
-        SetPriority(&drive, PRIMARY,
-                    groups->group[i].part[j], groups->group[i].priority);
+  // Now apply the ranking to the GPT
+  for (i = 0; i < max_part; i++) {
+    int group;
 
-    FreeGroups(groups);
+    if (!IsKernel(&drive, PRIMARY, i))
+      continue;
+    group = GetGroup(&drive, params, i);
+    if (group)
+      SetPriority(&drive, PRIMARY, i, new_priority[group]);
   }
 
   // Write it all out
@@ -4,6 +4,8 @@
 
 #define __STDC_FORMAT_MACROS
 
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "cgpt.h"
@@ -177,6 +179,160 @@ static void EntriesDetails(struct drive *drive, const int secondary, int raw) {
   }
 }
 
+/* Fields for JSON output, in output order */
+static const char *const json_fields[] = {
+  "start", "size", "type", "uuid", "label", "priority", "tries",
+  "successful", "required", "legacy_boot", "attr",
+};
+enum {
+  JSON_START, JSON_SIZE, JSON_TYPE, JSON_UUID, JSON_LABEL, JSON_PRIORITY,
+  JSON_TRIES, JSON_SUCCESSFUL, JSON_REQUIRED, JSON_LEGACY_BOOT, JSON_ATTR,
+};
+
+int ParseShowFields(const char *list, uint32_t *fields) {
+  *fields = 0;
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    int i;
+
+    for (i = 0; i < ARRAY_COUNT(json_fields); i++) {
+      if (strlen(json_fields[i]) == len &&
+          !strncmp(json_fields[i], list, len))
+        break;
+    }
+    if (i == ARRAY_COUNT(json_fields)) {
+      Error("unknown field: %.*s\n", (int)len, list);
+      return CGPT_FAILED;
+    }
+    *fields |= 1 << i;
+
+    list += len;
+    if (*list)
+      list++;
+  }
+  return CGPT_OK;
+}
+
+/* JSON output is collected here, so it goes out in a single write. */
+struct json_buf {
+  char *buf;
+  size_t len;
+  size_t size;
+};
+
+static void JsonPrintf(struct json_buf *out, const char *format, ...) {
+  va_list ap;
+  int len;
+
+  while (1) {
+    va_start(ap, format);
+    len = vsnprintf(out->buf + out->len, out->size - out->len, format, ap);
+    va_end(ap);
+    require(len >= 0);
+    if (out->len + len < out->size)
+      break;
+    out->size = (out->len + len + 1) * 2;
+    out->buf = realloc(out->buf, out->size);
+    require(out->buf);
+  }
+  out->len += len;
+}
+
+static void JsonString(struct json_buf *out, const char *str) {
+  JsonPrintf(out, "\"");
+  for (; *str; str++) {
+    unsigned char c = *str;
+    if (c == '"' || c == '\\')
+      JsonPrintf(out, "\\%c", c);
+    else if (c < 0x20)
+      JsonPrintf(out, "\\u%04x", c);
+    else
+      JsonPrintf(out, "%c", c);
+  }
+  JsonPrintf(out, "\"");
+}
+
+static void JsonEntry(struct json_buf *out, struct drive *drive,
+                      uint32_t index, uint32_t fields) {
+  GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
+  char buf[GPT_PARTNAME_LEN];
+  int i;
+
+  JsonPrintf(out, "{\"part\": %u", index + 1);
+  for (i = 0; i < ARRAY_COUNT(json_fields); i++) {
+    if (!(fields & (1 << i)))
+      continue;
+    JsonPrintf(out, ", \"%s\": ", json_fields[i]);
+    switch (i) {
+    case JSON_START:
+      JsonPrintf(out, "%" PRIu64, entry->starting_lba);
+      break;
+    case JSON_SIZE:
+      JsonPrintf(out, "%" PRIu64,
+                 entry->ending_lba || entry->starting_lba ?
+                 entry->ending_lba - entry->starting_lba + 1 : 0);
+      break;
+    case JSON_TYPE:
+      GuidToStr(&entry->type, buf, sizeof(buf));
+      JsonString(out, buf);
+      break;
+    case JSON_UUID:
+      GuidToStr(&entry->unique, buf, sizeof(buf));
+      JsonString(out, buf);
+      break;
+    case JSON_LABEL:
+      UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
+                  (uint8_t *)buf, sizeof(buf));
+      JsonString(out, buf);
+      break;
+    case JSON_PRIORITY:
+      JsonPrintf(out, "%d", GetPriority(drive, ANY_VALID, index));
+      break;
+    case JSON_TRIES:
+      JsonPrintf(out, "%d", GetTries(drive, ANY_VALID, index));
+      break;
+    case JSON_SUCCESSFUL:
+      JsonPrintf(out, "%d", GetSuccessful(drive, ANY_VALID, index));
+      break;
+    case JSON_REQUIRED:
+      JsonPrintf(out, "%d", GetRequired(drive, ANY_VALID, index));
+      break;
+    case JSON_LEGACY_BOOT:
+      JsonPrintf(out, "%d", GetLegacyBoot(drive, ANY_VALID, index));
+      break;
+    case JSON_ATTR:
+      JsonPrintf(out, "%u", entry->attrs.fields.gpt_att);
+      break;
+    }
+  }
+  JsonPrintf(out, "}");
+}
+
+/* Print the partitions as a JSON array, with one object per partition. */
+static void JsonShow(struct drive *drive, CgptShowParams *params) {
+  struct json_buf out = { NULL, 0, 0 };
+  uint32_t fields = params->json_fields ? params->json_fields : ~0;
+  const char *sep = "\n";
+  uint32_t i;
+
+  JsonPrintf(&out, "[");
+  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+    if (params->partition) {
+      if (i + 1 != params->partition)
+        continue;
+    } else if (GuidIsZero(&GetEntry(&drive->gpt, ANY_VALID, i)->type)) {
+      continue;
+    }
+    JsonPrintf(&out, "%s  ", sep);
+    JsonEntry(&out, drive, i, fields);
+    sep = ",\n";
+  }
+  JsonPrintf(&out, "\n]\n");
+
+  fwrite(out.buf, 1, out.len, stdout);
+  free(out.buf);
+}
+
 static int GptShow(struct drive *drive, CgptShowParams *params) {
   int gpt_retval;
   if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive->gpt))) {
@@ -185,12 +341,17 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
     return CGPT_FAILED;
   }
 
-  if (params->partition) {                      // show single partition
+  if (params->partition > GetNumberOfEntries(drive)) {
+    Error("invalid partition number: %d\n", params->partition);
+    return CGPT_FAILED;
+  }
 
-    if (params->partition > GetNumberOfEntries(drive)) {
-      Error("invalid partition number: %d\n", params->partition);
-      return CGPT_FAILED;
-    }
+  if (params->json) {                           // machine-readable
+    JsonShow(drive, params);
+    return CGPT_OK;
+  }
+
+  if (params->partition) {                      // show single partition
 
     uint32_t index = params->partition - 1;
     GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
@@ -25,10 +25,9 @@
 #include "2sysincludes.h"
 
 #include "2common.h"
-#include "2sha.h"
 #include "cgpt.h"
 #include "cgpt_nor.h"
-#include "file_keys.h"
+#include "host_misc.h"
 
 // Check if cmdline |argv| has "-D". "-D" signifies that GPT structs are stored
 // off device, and hence we should not wrap around cgpt.
@@ -71,8 +70,8 @@ static const char *find_mtd_device(int argc, const char *const argv[]) {
 static int wrap_cgpt(int argc,
                      const char *const argv[],
                      const char *mtd_device) {
-  uint8_t original_hash[VB2_SHA1_DIGEST_SIZE];
-  uint8_t modified_hash[VB2_SHA1_DIGEST_SIZE];
+  uint8_t *original = NULL;
+  uint64_t original_size;
   int ret = 0;
 
   // Create a temp dir to work in.
@@ -85,9 +84,10 @@ static int wrap_cgpt(int argc,
   if (snprintf(rw_gpt_path, sizeof(rw_gpt_path), "%s/rw_gpt", temp_dir) < 0) {
     goto cleanup;
   }
-  if (VB2_SUCCESS != DigestFile(rw_gpt_path, VB2_HASH_SHA1,
-				original_hash, sizeof(original_hash))) {
-    Error("Cannot compute original GPT digest.\n");
+  // Keep what was read, so only the parts cgpt changes are written back.
+  original = ReadFile(rw_gpt_path, &original_size);
+  if (!original) {
+    Error("Cannot read original GPT.\n");
     goto cleanup;
   }
 
@@ -132,18 +132,11 @@ static int wrap_cgpt(int argc,
     goto cleanup;
   }
 
-  // Write back "rw_gpt" to NOR flash in two chunks.
-  ret++;
-  if (VB2_SUCCESS == DigestFile(rw_gpt_path, VB2_HASH_SHA1,
-				modified_hash, sizeof(modified_hash))) {
-    if (memcmp(original_hash, modified_hash, VB2_SHA1_DIGEST_SIZE) != 0) {
-      ret = WriteNorFlash(temp_dir);
-    } else {
-      ret = 0;
-    }
-  }
+  // Write back the changed halves of "rw_gpt" to NOR flash.
+  ret = WriteNorFlash(temp_dir, original, original_size);
 
 cleanup:
+  free(original);
   RemoveDir(temp_dir);
   return ret;
 }
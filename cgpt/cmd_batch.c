@@ -0,0 +1,162 @@
+// Copyright 2019 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+// Most words a batch line can be split into, including the command name.
+#define MAX_BATCH_ARGS 64
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] DRIVE < SCRIPT\n\n"
+         "Run cgpt commands read from stdin, one per line, on DRIVE.\n"
+         "Each line is a command and its options, without the DRIVE:\n\n"
+         "    add -i 2 -t kernel -l \"KERN A\"\n"
+         "    prioritize -i 2\n\n"
+         "The GPT is loaded once, and only written once every command has\n"
+         "succeeded.  If any command fails, nothing is written.  Blank\n"
+         "lines and lines starting with '#' are ignored, and words can be\n"
+         "quoted with ' or \".  The 'boot' command still writes the PMBR\n"
+         "as soon as it runs.\n\n"
+         "Options:\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE\n"
+         "\n", progname);
+}
+
+// Split 'line' into words in place.  Returns the number of words, or -1 if
+// there are too many or a quote isn't closed.
+static int SplitLine(char *line, char *words[], int max_words) {
+  int count = 0;
+  char *in = line;
+  char *out;
+
+  while (1) {
+    while (*in == ' ' || *in == '\t' || *in == '\n' || *in == '\r')
+      in++;
+    if (!*in)
+      return count;
+    if (count == max_words)
+      return -1;
+
+    words[count++] = out = in;
+    while (*in && *in != ' ' && *in != '\t' && *in != '\n' && *in != '\r') {
+      if (*in == '"' || *in == '\'') {
+        char quote = *in++;
+        while (*in && *in != quote)
+          *out++ = *in++;
+        if (!*in)
+          return -1;
+        in++;
+      } else {
+        *out++ = *in++;
+      }
+    }
+    if (*in)
+      in++;
+    *out = '\0';
+  }
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  char *line = NULL;
+  size_t line_size = 0;
+  int line_number = 0;
+  uint64_t drive_size = 0;
+  char *drive_name;
+  int c;
+  char* e = 0;
+  int errorcnt = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hD:")) != -1)
+  {
+    switch (c)
+    {
+    case 'D':
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  drive_name = argv[optind];
+
+  if (CGPT_OK != DriveBatchBegin(drive_name, drive_size))
+    return CGPT_FAILED;
+
+  while (getline(&line, &line_size, stdin) != -1) {
+    char *words[MAX_BATCH_ARGS + 2];
+    cgpt_command_fn fp;
+    int count;
+
+    line_number++;
+    count = SplitLine(line, words, MAX_BATCH_ARGS);
+    if (count < 0) {
+      Error("line %d: can't parse command\n", line_number);
+      errorcnt++;
+      break;
+    }
+    if (!count || words[0][0] == '#')
+      continue;
+
+    fp = FindCommand(words[0]);
+    if (!fp || fp == cmd_batch) {
+      Error("line %d: unknown command '%s'\n", line_number, words[0]);
+      errorcnt++;
+      break;
+    }
+
+    // Commands take the drive as their last argument.
+    words[count++] = drive_name;
+    words[count] = NULL;
+
+    // Restart getopt() at words[1] for the command's own options.
+    optind = 0;
+    if (CGPT_OK != fp(count, words)) {
+      Error("line %d: %s failed\n", line_number, words[0]);
+      errorcnt++;
+      break;
+    }
+  }
+  free(line);
+
+  if (CGPT_OK != DriveBatchEnd(!errorcnt))
+    errorcnt++;
+
+  return errorcnt ? CGPT_FAILED : CGPT_OK;
+}
@@ -21,6 +21,7 @@ static void Usage(void)
          "  -z           Zero the sectors of the GPT table and entries\n"
          "  -p NUM       Size (in blocks) of the disk to pad between the\n"
          "                 primary GPT header and its entries, default 0\n"
+         "  -n NUM       Number of partition entries, default 128\n"
          "\n", progname);
 }
 
@@ -33,7 +34,7 @@ int cmd_create(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hzp:D:")) != -1)
+  while ((c=getopt(argc, argv, ":hzp:n:D:")) != -1)
   {
     switch (c)
     {
@@ -48,6 +49,10 @@ int cmd_create(int argc, char *argv[]) {
       params.padding = strtoull(optarg, &e, 0);
       errorcnt += check_int_parse(c, e);
       break;
+    case 'n':
+      params.num_entries = (uint32_t)strtoul(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
     case 'h':
       Usage();
       return CGPT_OK;
@@ -29,6 +29,13 @@ static void Usage(void)
          "      Matching partition data must also contain FILE content\n"
          "  -O NUM"
          "       Byte offset into partition to match content (default 0)\n"
+         "  -j NUM       When scanning all drives, read up to NUM of them,\n"
+         "                 and their -M content, in parallel (default 1)\n"
+         "  -C FILE      Keep an index of partition tables in FILE, and\n"
+         "                 answer from it for drives whose size and mtime\n"
+         "                 haven't changed, instead of reading them again.\n"
+         "                 Delete FILE if drives are changed behind cgpt's\n"
+         "                 back without touching their mtime.\n"
          "\n", progname);
   PrintTypes();
 }
@@ -80,7 +87,7 @@ int cmd_find(int argc, char *argv[]) {
   int c;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hv1nt:u:l:M:O:D:")) != -1)
+  while ((c=getopt(argc, argv, ":hv1nt:u:l:M:O:D:j:C:")) != -1)
   {
     switch (c)
     {
@@ -134,6 +141,14 @@ int cmd_find(int argc, char *argv[]) {
       params.matchoffset = strtoull(optarg, &e, 0);
       errorcnt += check_int_parse(c, e);
       break;
+    case 'j':
+      params.jobs = (int)strtol(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      errorcnt += check_int_limit(c, params.jobs, 1, 64);
+      break;
+    case 'C':
+      params.cache_file = optarg;
+      break;
 
     case 'h':
       Usage();
@@ -36,6 +36,11 @@ static void Usage(void)
          "               -B  Legacy Boot flag\n"
          "               -A  raw 16-bit attribute value (bits 48-63)\n"
          "  -d           Debug output (including invalid headers)\n"
+         "  -j           JSON output, one object per partition in use (or\n"
+         "                 just the one given with -i)\n"
+         "  -F LIST      Fields for -j, separated by commas (default all):\n"
+         "                 start, size, type, uuid, label, priority, tries,\n"
+         "                 successful, required, legacy_boot, attr\n"
          "\n", progname);
 }
 
@@ -48,7 +53,7 @@ int cmd_show(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPRBAdD:")) != -1)
+  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPRBAdD:jF:")) != -1)
   {
     switch (c)
     {
@@ -87,6 +92,14 @@ int cmd_show(int argc, char *argv[]) {
       params.debug = 1;
       break;
 
+    case 'j':
+      params.json = 1;
+      break;
+    case 'F':
+      if (CGPT_OK != ParseShowFields(optarg, &params.json_fields))
+        errorcnt++;
+      break;
+
     case 'h':
       Usage();
       return CGPT_OK;
@@ -29,6 +29,8 @@ int vb2api_fw_phase1(struct vb2_context *ctx)
 	int rv;
 	struct vb2_shared_data *sd;
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE1_START);
+
 	/* Initialize the vboot context if it hasn't been yet */
 	vb2_init_context(ctx);
 	sd = vb2_get_sd(ctx);
@@ -106,6 +108,8 @@ int vb2api_fw_phase1(struct vb2_context *ctx)
 	if (ctx->flags & VB2_CONTEXT_DISPLAY_INIT)
 		sd->flags |= VB2_SD_FLAG_DISPLAY_AVAILABLE;
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE1_END);
+
 	/* Return error if recovery is needed */
 	if (ctx->flags & VB2_CONTEXT_RECOVERY_MODE) {
 		/* Always clear RAM when entering recovery mode */
@@ -120,6 +124,8 @@ int vb2api_fw_phase2(struct vb2_context *ctx)
 {
 	int rv;
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE2_START);
+
 	/*
 	 * Use the slot from the last boot if this is a resume.  Do not set
 	 * VB2_SD_STATUS_CHOSE_SLOT so the try counter is not decremented on
@@ -135,6 +141,7 @@ int vb2api_fw_phase2(struct vb2_context *ctx)
 		if (sd->fw_slot)
 			ctx->flags |= VB2_CONTEXT_FW_SLOT_B;
 
+		vb2ex_timestamp(VB2_TS_FW_PHASE2_END);
 		return VB2_SUCCESS;
 	}
 
@@ -156,6 +163,77 @@ int vb2api_fw_phase2(struct vb2_context *ctx)
 		return rv;
 	}
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE2_END);
+	return VB2_SUCCESS;
+}
+
+/*
+ * Extend a hash which is checked one chunk at a time against a table of chunk
+ * digests, checking each chunk as soon as it is complete.
+ */
+static int extend_hash_chunks(struct vb2_context *ctx,
+			      struct vb2_digest_context *dc,
+			      const uint8_t *buf,
+			      uint32_t size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	uint32_t digest_size = vb2_digest_size(dc->hash_alg);
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	const uint8_t *expect;
+	uint32_t n;
+	int rv;
+
+	while (size) {
+		n = size;
+		if (n > sd->hash_chunk_remaining_size)
+			n = sd->hash_chunk_remaining_size;
+
+		if (dc->using_hwcrypto)
+			rv = vb2ex_hwcrypto_digest_extend(buf, n);
+		else
+			rv = vb2_digest_extend(dc, buf, n);
+		if (rv)
+			return rv;
+
+		buf += n;
+		size -= n;
+		sd->hash_remaining_size -= n;
+		sd->hash_chunk_remaining_size -= n;
+		if (sd->hash_chunk_remaining_size)
+			continue;
+
+		/* Finished a chunk, so check it */
+		if (dc->using_hwcrypto)
+			rv = vb2ex_hwcrypto_digest_finalize(digest,
+							    digest_size);
+		else
+			rv = vb2_digest_finalize(dc, digest, digest_size);
+		if (rv)
+			return rv;
+
+		expect = ctx->workbuf + sd->workbuf_hash_chunks_offset +
+			sd->hash_chunk_index * digest_size;
+		if (vb2_safe_memcmp(digest, expect, digest_size))
+			return VB2_ERROR_API_EXTEND_HASH_CHUNK;
+
+		/* Start the next chunk, if there is one */
+		if (!sd->hash_remaining_size)
+			break;
+
+		sd->hash_chunk_index++;
+		n = sd->hash_remaining_size;
+		if (n > sd->hash_chunk_size)
+			n = sd->hash_chunk_size;
+		sd->hash_chunk_remaining_size = n;
+
+		if (dc->using_hwcrypto)
+			rv = vb2ex_hwcrypto_digest_init(dc->hash_alg, n);
+		else
+			rv = vb2_digest_init(dc, dc->hash_alg);
+		if (rv)
+			return rv;
+	}
+
 	return VB2_SUCCESS;
 }
 
@@ -166,6 +244,8 @@ int vb2api_extend_hash(struct vb2_context *ctx,
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_digest_context *dc = (struct vb2_digest_context *)
 		(ctx->workbuf + sd->workbuf_hash_offset);
+	uint32_t start_us = vb2ex_utime();
+	int rv;
 
 	/* Must have initialized hash digest work area */
 	if (!sd->workbuf_hash_size)
@@ -175,12 +255,191 @@ int vb2api_extend_hash(struct vb2_context *ctx,
 	if (!size || size > sd->hash_remaining_size)
 		return VB2_ERROR_API_EXTEND_HASH_SIZE;
 
-	sd->hash_remaining_size -= size;
+	if (sd->hash_chunk_size) {
+		rv = extend_hash_chunks(ctx, dc, buf, size);
+	} else {
+		sd->hash_remaining_size -= size;
+
+		if (dc->using_hwcrypto)
+			rv = vb2ex_hwcrypto_digest_extend(buf, size);
+		else
+			rv = vb2_digest_extend(dc, buf, size);
+	}
+
+	vb2_cost_hash(ctx, VB2_COST_FW_BODY, start_us, size);
+	return rv;
+}
+
+/*
+ * Hash session backends, one per way of extending the hash.  The size has
+ * already been checked against what's left to hash.
+ */
+#if VB2_SUPPORT_SHA1
+static int session_extend_sha1(struct vb2_hash_session *hs,
+			       const uint8_t *buf,
+			       uint32_t size)
+{
+	hs->sd->hash_remaining_size -= size;
+	vb2_sha1_update(&hs->dc->sha1, buf, size);
+	return VB2_SUCCESS;
+}
+#endif
+
+#if VB2_SUPPORT_SHA256
+static int session_extend_sha256(struct vb2_hash_session *hs,
+				 const uint8_t *buf,
+				 uint32_t size)
+{
+	hs->sd->hash_remaining_size -= size;
+	vb2_sha256_update(&hs->dc->sha256, buf, size);
+	return VB2_SUCCESS;
+}
+#endif
+
+#if VB2_SUPPORT_SHA512
+static int session_extend_sha512(struct vb2_hash_session *hs,
+				 const uint8_t *buf,
+				 uint32_t size)
+{
+	hs->sd->hash_remaining_size -= size;
+	vb2_sha512_update(&hs->dc->sha512, buf, size);
+	return VB2_SUCCESS;
+}
+#endif
+
+static int session_extend_hwcrypto(struct vb2_hash_session *hs,
+				   const uint8_t *buf,
+				   uint32_t size)
+{
+	hs->sd->hash_remaining_size -= size;
+	return vb2ex_hwcrypto_digest_extend(buf, size);
+}
+
+static int session_extend_chunks(struct vb2_hash_session *hs,
+				 const uint8_t *buf,
+				 uint32_t size)
+{
+	return extend_hash_chunks(hs->ctx, hs->dc, buf, size);
+}
+
+int vb2api_init_hash_session(struct vb2_context *ctx,
+			     struct vb2_hash_session *hs)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_digest_context *dc = (struct vb2_digest_context *)
+		(ctx->workbuf + sd->workbuf_hash_offset);
+
+	/* Must have initialized hash digest work area */
+	if (!sd->workbuf_hash_size)
+		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
+
+	hs->ctx = ctx;
+	hs->dc = dc;
+	hs->sd = sd;
+
+	if (sd->hash_chunk_size) {
+		hs->extend = session_extend_chunks;
+		return VB2_SUCCESS;
+	}
+
+	if (dc->using_hwcrypto) {
+		hs->extend = session_extend_hwcrypto;
+		return VB2_SUCCESS;
+	}
+
+	switch (dc->hash_alg) {
+#if VB2_SUPPORT_SHA1
+	case VB2_HASH_SHA1:
+		hs->extend = session_extend_sha1;
+		return VB2_SUCCESS;
+#endif
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA256:
+		hs->extend = session_extend_sha256;
+		return VB2_SUCCESS;
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA512:
+		hs->extend = session_extend_sha512;
+		return VB2_SUCCESS;
+#endif
+	default:
+		return VB2_ERROR_SHA_EXTEND_ALGORITHM;
+	}
+}
+
+int vb2api_extend_hash_session(struct vb2_hash_session *hs,
+			       const void *buf,
+			       uint32_t size)
+{
+	uint32_t start_us = vb2ex_utime();
+	int rv;
+
+	/* Don't extend past the data we expect to hash */
+	if (!size || size > hs->sd->hash_remaining_size)
+		return VB2_ERROR_API_EXTEND_HASH_SIZE;
+
+	rv = hs->extend(hs, buf, size);
+	vb2_cost_hash(hs->ctx, VB2_COST_FW_BODY, start_us, size);
+	return rv;
+}
+
+/*
+ * vb2api_hash_mapped_region() hashes this much at a time, with the next
+ * window prefetched a cache line at a time before the current one is hashed.
+ */
+#define MAPPED_WINDOW_SIZE 4096
+#define MAPPED_PREFETCH_STRIDE 64
+
+static void prefetch_window(const uint8_t *p, uint32_t size)
+{
+#ifdef __GNUC__
+	uint32_t i;
+
+	for (i = 0; i < size; i += MAPPED_PREFETCH_STRIDE)
+		__builtin_prefetch(p + i);
+#endif
+}
+
+int vb2api_hash_mapped_region(struct vb2_context *ctx,
+			      const void *ptr,
+			      uint32_t size)
+{
+	struct vb2_hash_session hs;
+	const uint8_t *p = ptr;
+	uint32_t start_us = vb2ex_utime();
+	uint32_t hashed = 0;
+	uint32_t n, next;
+	int rv;
+
+	rv = vb2api_init_hash_session(ctx, &hs);
+	if (rv)
+		return rv;
+
+	/* Check the whole region up front, so a bad size hashes nothing */
+	if (!size || size > hs.sd->hash_remaining_size)
+		return VB2_ERROR_API_EXTEND_HASH_SIZE;
+
+	n = size < MAPPED_WINDOW_SIZE ? size : MAPPED_WINDOW_SIZE;
+	prefetch_window(p, n);
+	while (size) {
+		next = size - n < MAPPED_WINDOW_SIZE ?
+			size - n : MAPPED_WINDOW_SIZE;
+		prefetch_window(p + n, next);
+
+		rv = hs.extend(&hs, p, n);
+		hashed += n;
+		if (rv)
+			break;
+
+		p += n;
+		size -= n;
+		n = next;
+	}
 
-	if (dc->using_hwcrypto)
-		return vb2ex_hwcrypto_digest_extend(buf, size);
-	else
-		return vb2_digest_extend(dc, buf, size);
+	/* Flash reads stall the hashing, so they count as hashing time */
+	vb2_cost_hash(ctx, VB2_COST_FW_BODY, start_us, hashed);
+	return rv;
 }
 
 int vb2api_get_pcr_digest(struct vb2_context *ctx,
@@ -11,11 +11,20 @@
 #include "2rsa.h"
 #include "2sha.h"
 
+/* Machine word; may_alias so it can be used to read any buffer */
+typedef uintptr_t __attribute__((may_alias)) vb2_word_t;
+
+#if VB2_SAFE_MEMCMP_VECTOR
+/* 16-byte vector which may be loaded from any address */
+typedef uint64_t __attribute__((vector_size(16), aligned(1), may_alias))
+	vb2_vec_t;
+#endif
+
 int vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
 {
 	const unsigned char *us1 = s1;
 	const unsigned char *us2 = s2;
-	int result = 0;
+	uintptr_t result = 0;
 
 	if (0 == size)
 		return 0;
@@ -23,7 +32,38 @@ int vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
 	/*
 	 * Code snippet without data-dependent branch due to Nate Lawson
 	 * (nate@root.org) of Root Labs.
+	 *
+	 * Which loops run depends only on the buffer addresses and size, never
+	 * on the contents, so the comparison stays constant-time.
 	 */
+#if VB2_SAFE_MEMCMP_VECTOR
+	if (size >= sizeof(vb2_vec_t)) {
+		vb2_vec_t acc = {0, 0};
+
+		for (; size >= sizeof(vb2_vec_t); size -= sizeof(vb2_vec_t)) {
+			acc |= *(const vb2_vec_t *)us1 ^
+				*(const vb2_vec_t *)us2;
+			us1 += sizeof(vb2_vec_t);
+			us2 += sizeof(vb2_vec_t);
+		}
+		result = (acc[0] | acc[1]) != 0;
+	}
+#else
+	/* If the buffers are aligned the same way, compare whole words */
+	if (!(((uintptr_t)us1 ^ (uintptr_t)us2) & (sizeof(vb2_word_t) - 1))) {
+		while (size && ((uintptr_t)us1 & (sizeof(vb2_word_t) - 1))) {
+			result |= *us1++ ^ *us2++;
+			size--;
+		}
+		for (; size >= sizeof(vb2_word_t); size -= sizeof(vb2_word_t)) {
+			result |= *(const vb2_word_t *)us1 ^
+				*(const vb2_word_t *)us2;
+			us1 += sizeof(vb2_word_t);
+			us2 += sizeof(vb2_word_t);
+		}
+	}
+#endif
+
 	while (size--)
 		result |= *us1++ ^ *us2++;
 
@@ -55,12 +95,25 @@ void vb2_workbuf_init(struct vb2_workbuf *wb, uint8_t *buf, uint32_t size)
 {
 	wb->buf = buf;
 	wb->size = size;
+	wb->base = NULL;
+	wb->stats = NULL;
 
 	/* Align the buffer so allocations will be aligned */
 	if (vb2_align(&wb->buf, &wb->size, VB2_WORKBUF_ALIGN, 0))
 		wb->size = 0;
 }
 
+void vb2_workbuf_note_used(struct vb2_workbuf_stats *stats, uint32_t used)
+{
+	if (stats->phase >= VB2_WORKBUF_PHASE_COUNT)
+		stats->phase = VB2_WORKBUF_PHASE_OTHER;
+
+	if (used > stats->peak)
+		stats->peak = used;
+	if (used > stats->phase_peak[stats->phase])
+		stats->phase_peak[stats->phase] = used;
+}
+
 void *vb2_workbuf_alloc(struct vb2_workbuf *wb, uint32_t size)
 {
 	uint8_t *ptr = wb->buf;
@@ -74,6 +127,9 @@ void *vb2_workbuf_alloc(struct vb2_workbuf *wb, uint32_t size)
 	wb->buf += size;
 	wb->size -= size;
 
+	if (wb->stats)
+		vb2_workbuf_note_used(wb->stats, wb->buf - wb->base);
+
 	return ptr;
 }
 
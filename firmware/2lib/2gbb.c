@@ -15,6 +15,7 @@ static int vb2_gbb_read_key(struct vb2_context *ctx,
 			    struct vb2_workbuf *wb)
 {
 	struct vb2_workbuf wblocal = *wb;
+	uint32_t read_size;
 	int rv;
 
 	/* Check offset and size. */
@@ -23,13 +24,20 @@ static int vb2_gbb_read_key(struct vb2_context *ctx,
 	if (*size < sizeof(**keyp))
 		return VB2_ERROR_GBB_INVALID;
 
-	/* GBB header might be padded.  Retrieve the vb2_packed_key
-	   header so we can find out what the real size is. */
-	*keyp = vb2_workbuf_alloc(&wblocal, sizeof(**keyp));
+	/*
+	 * GBB header might be padded.  If the whole padded key fits in the
+	 * workbuf, read it in one go; otherwise only retrieve the
+	 * vb2_packed_key header so we can find out what the real size is.
+	 */
+	read_size = *size;
+	*keyp = vb2_workbuf_alloc(&wblocal, read_size);
+	if (!*keyp) {
+		read_size = sizeof(**keyp);
+		*keyp = vb2_workbuf_alloc(&wblocal, read_size);
+	}
 	if (!*keyp)
 		return VB2_ERROR_GBB_WORKBUF;
-	rv = vb2ex_read_resource(ctx, VB2_RES_GBB, offset, *keyp,
-				 sizeof(**keyp));
+	rv = vb2ex_read_resource(ctx, VB2_RES_GBB, offset, *keyp, read_size);
 	if (rv)
 		return rv;
 
@@ -42,19 +50,23 @@ static int vb2_gbb_read_key(struct vb2_context *ctx,
 	if (*size < sizeof(**keyp))
 		*size = sizeof(**keyp);
 
-	/* Now that we know the real size of the key, retrieve the key
-	   data, and write it on the workbuf, directly after vb2_packed_key. */
-	*keyp = vb2_workbuf_realloc(&wblocal, sizeof(**keyp), *size);
+	/* Now that we know the real size of the key, trim the padding or
+	   make room for the rest of the key directly after vb2_packed_key. */
+	*keyp = vb2_workbuf_realloc(&wblocal, read_size, *size);
 	if (!*keyp)
 		return VB2_ERROR_GBB_WORKBUF;
 
-	rv = vb2ex_read_resource(ctx, VB2_RES_GBB,
-				 offset + sizeof(**keyp),
-				 (void *)*keyp + sizeof(**keyp),
-				 *size - sizeof(**keyp));
-	if (!rv)
-		*wb = wblocal;
-	return rv;
+	if (read_size < *size) {
+		rv = vb2ex_read_resource(ctx, VB2_RES_GBB,
+					 offset + read_size,
+					 (void *)*keyp + read_size,
+					 *size - read_size);
+		if (rv)
+			return rv;
+	}
+
+	*wb = wblocal;
+	return VB2_SUCCESS;
 }
 
 int vb2_gbb_read_root_key(struct vb2_context *ctx,
@@ -7,21 +7,17 @@
 #include "2sha.h"
 #include "2hmac.h"
 
-int hmac(enum vb2_hash_algorithm alg,
-	 const void *key, uint32_t key_size,
-	 const void *msg, uint32_t msg_size,
-	 uint8_t *mac, uint32_t mac_size)
+int vb2_hmac_init(struct vb2_hmac_context *hc, enum vb2_hash_algorithm alg,
+		  const void *key, uint32_t key_size)
 {
 	uint32_t block_size;
 	uint32_t digest_size;
 	uint8_t k[VB2_MAX_BLOCK_SIZE];
 	uint8_t o_pad[VB2_MAX_BLOCK_SIZE];
 	uint8_t i_pad[VB2_MAX_BLOCK_SIZE];
-	uint8_t b[VB2_MAX_DIGEST_SIZE];
-	struct vb2_digest_context dc;
 	int i;
 
-	if (!key | !msg | !mac)
+	if (!hc || !key)
 		return -1;
 
 	digest_size = vb2_digest_size(alg);
@@ -29,9 +25,6 @@ int hmac(enum vb2_hash_algorithm alg,
 	if (!digest_size || !block_size)
 		return -1;
 
-	if (mac_size < digest_size)
-		return -1;
-
 	if (key_size > block_size) {
 		vb2_digest_buffer((uint8_t *)key, key_size, alg, k, block_size);
 		key_size = digest_size;
@@ -46,15 +39,52 @@ int hmac(enum vb2_hash_algorithm alg,
 		i_pad[i] = 0x36 ^ k[i];
 	}
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, i_pad, block_size);
+	/* Hash each pad now, so each MAC only needs to hash the message */
+	vb2_digest_init(&hc->inner, alg);
+	vb2_digest_extend(&hc->inner, i_pad, block_size);
+	vb2_digest_init(&hc->outer, alg);
+	vb2_digest_extend(&hc->outer, o_pad, block_size);
+	hc->digest_size = digest_size;
+
+	return 0;
+}
+
+int vb2_hmac_calculate(const struct vb2_hmac_context *hc,
+		       const void *msg, uint32_t msg_size,
+		       uint8_t *mac, uint32_t mac_size)
+{
+	uint8_t b[VB2_MAX_DIGEST_SIZE];
+	struct vb2_digest_context dc;
+
+	if (!hc || !msg || !mac)
+		return -1;
+
+	if (mac_size < hc->digest_size)
+		return -1;
+
+	dc = hc->inner;
 	vb2_digest_extend(&dc, msg, msg_size);
-	vb2_digest_finalize(&dc, b, digest_size);
+	vb2_digest_finalize(&dc, b, hc->digest_size);
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, o_pad, block_size);
-	vb2_digest_extend(&dc, b, digest_size);
+	dc = hc->outer;
+	vb2_digest_extend(&dc, b, hc->digest_size);
 	vb2_digest_finalize(&dc, mac, mac_size);
 
 	return 0;
 }
+
+int hmac(enum vb2_hash_algorithm alg,
+	 const void *key, uint32_t key_size,
+	 const void *msg, uint32_t msg_size,
+	 uint8_t *mac, uint32_t mac_size)
+{
+	struct vb2_hmac_context hc;
+
+	if (!key | !msg | !mac)
+		return -1;
+
+	if (vb2_hmac_init(&hc, alg, key, key_size))
+		return -1;
+
+	return vb2_hmac_calculate(&hc, msg, msg_size, mac, mac_size);
+}
@@ -0,0 +1,189 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Streaming LZ4 decompression.
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2lz4.h"
+
+/*
+ * Each LZ4 sequence is a token byte, with the literal size in its high nibble
+ * and the match size - 4 in its low nibble; more literal size bytes if the
+ * nibble is 15; the literals; a 16-bit little-endian match offset; and more
+ * match size bytes if that nibble is 15.  The last sequence stops after its
+ * literals.
+ */
+enum lz4_state {
+	LZ4_TOKEN = 0,
+	LZ4_LITERAL_SIZE,
+	LZ4_LITERALS,
+	LZ4_OFFSET_LOW,
+	LZ4_OFFSET_HIGH,
+	LZ4_MATCH_SIZE,
+};
+
+/*
+ * Check there is room to write size more bytes of output, without writing over
+ * the input at next if it is in the output buffer.  Literals are copied from
+ * next itself, so only the used bytes are overwritten, but a match needs its
+ * whole size before next.
+ */
+static int check_room(const struct vb2_lz4_context *lc, const uint8_t *next,
+		      uint32_t size, int literals)
+{
+	uintptr_t out = (uintptr_t)lc->out + lc->out_used;
+	uintptr_t end = (uintptr_t)lc->out + lc->out_size;
+	uintptr_t in = (uintptr_t)next;
+
+	if (size > lc->out_size - lc->out_used)
+		return VB2_ERROR_LZ4_OUTPUT_SIZE;
+
+	/* Decompressing in place stays behind the input */
+	if (in >= (uintptr_t)lc->out && in < end &&
+	    out + (literals ? 0 : size) > in)
+		return VB2_ERROR_LZ4_OVERLAP;
+
+	return VB2_SUCCESS;
+}
+
+/* Copy the match for the current sequence */
+static int copy_match(struct vb2_lz4_context *lc, const uint8_t *next)
+{
+	uint8_t *dest = lc->out + lc->out_used;
+	const uint8_t *src = dest - lc->offset;
+	uint32_t i;
+	int rv;
+
+	rv = check_room(lc, next, lc->match_size, 0);
+	if (rv)
+		return rv;
+
+	/* Matches may overlap themselves, to repeat a pattern */
+	if (lc->offset >= lc->match_size) {
+		memcpy(dest, src, lc->match_size);
+	} else {
+		for (i = 0; i < lc->match_size; i++)
+			dest[i] = src[i];
+	}
+	lc->out_used += lc->match_size;
+	lc->state = LZ4_TOKEN;
+	return VB2_SUCCESS;
+}
+
+void vb2_lz4_init(struct vb2_lz4_context *lc, void *out, uint32_t out_size)
+{
+	memset(lc, 0, sizeof(*lc));
+	lc->out = out;
+	lc->out_size = out_size;
+	lc->state = LZ4_TOKEN;
+}
+
+int vb2_lz4_extend(struct vb2_lz4_context *lc, const void *buf,
+		   uint32_t size)
+{
+	const uint8_t *in = buf;
+	const uint8_t *end = in + size;
+	uint32_t n;
+	int rv;
+
+	while (in < end) {
+		switch (lc->state) {
+		case LZ4_TOKEN:
+			lc->token = *in++;
+			lc->literal_size = lc->token >> 4;
+			lc->match_size = (lc->token & 0xf) + 4;
+			if (lc->literal_size == 0xf)
+				lc->state = LZ4_LITERAL_SIZE;
+			else if (lc->literal_size)
+				lc->state = LZ4_LITERALS;
+			else
+				lc->state = LZ4_OFFSET_LOW;
+			break;
+
+		case LZ4_LITERAL_SIZE:
+			if (lc->literal_size + (uint64_t)*in >
+			    lc->out_size - lc->out_used)
+				return VB2_ERROR_LZ4_OUTPUT_SIZE;
+			lc->literal_size += *in;
+			if (*in++ != 0xff)
+				lc->state = LZ4_LITERALS;
+			break;
+
+		case LZ4_LITERALS:
+			n = end - in;
+			if (n > lc->literal_size)
+				n = lc->literal_size;
+			rv = check_room(lc, in, n, 1);
+			if (rv)
+				return rv;
+			memmove(lc->out + lc->out_used, in, n);
+			lc->out_used += n;
+			lc->literal_size -= n;
+			in += n;
+			if (!lc->literal_size)
+				lc->state = LZ4_OFFSET_LOW;
+			break;
+
+		case LZ4_OFFSET_LOW:
+			lc->offset = *in++;
+			lc->state = LZ4_OFFSET_HIGH;
+			break;
+
+		case LZ4_OFFSET_HIGH:
+			lc->offset |= *in++ << 8;
+			if (!lc->offset || lc->offset > lc->out_used)
+				return VB2_ERROR_LZ4_OFFSET;
+			if ((lc->token & 0xf) == 0xf) {
+				lc->state = LZ4_MATCH_SIZE;
+				break;
+			}
+			rv = copy_match(lc, in);
+			if (rv)
+				return rv;
+			break;
+
+		case LZ4_MATCH_SIZE:
+			if (lc->match_size + (uint64_t)*in >
+			    lc->out_size - lc->out_used)
+				return VB2_ERROR_LZ4_OUTPUT_SIZE;
+			lc->match_size += *in;
+			if (*in++ != 0xff) {
+				rv = copy_match(lc, in);
+				if (rv)
+					return rv;
+			}
+			break;
+		}
+	}
+
+	return VB2_SUCCESS;
+}
+
+int vb2_lz4_finalize(struct vb2_lz4_context *lc)
+{
+	/* The last sequence has literals but no match */
+	if (lc->state != LZ4_OFFSET_LOW)
+		return VB2_ERROR_LZ4_TRUNCATED;
+
+	if (lc->out_used != lc->out_size)
+		return VB2_ERROR_LZ4_SIZE;
+
+	return VB2_SUCCESS;
+}
+
+int vb2_lz4_decompress(const void *in, uint32_t in_size,
+		       void *out, uint32_t out_size)
+{
+	struct vb2_lz4_context lc;
+	int rv;
+
+	vb2_lz4_init(&lc, out, out_size);
+	rv = vb2_lz4_extend(&lc, in, in_size);
+	if (rv)
+		return rv;
+
+	return vb2_lz4_finalize(&lc);
+}
@@ -37,11 +37,35 @@ void vb2_workbuf_from_ctx(struct vb2_context *ctx, struct vb2_workbuf *wb)
 {
 	vb2_workbuf_init(wb, ctx->workbuf + ctx->workbuf_used,
 			 ctx->workbuf_size - ctx->workbuf_used);
+
+	/* Shared data only exists once the context has been initialized */
+	if (ctx->workbuf_used) {
+		wb->base = ctx->workbuf;
+		wb->stats = &vb2_get_sd(ctx)->workbuf_stats;
+	}
 }
 
 void vb2_set_workbuf_used(struct vb2_context *ctx, uint32_t used)
 {
 	ctx->workbuf_used = vb2_wb_round_up(used);
+	vb2_workbuf_note_used(&vb2_get_sd(ctx)->workbuf_stats,
+			      ctx->workbuf_used);
+}
+
+void vb2_set_workbuf_phase(struct vb2_context *ctx,
+			   enum vb2_workbuf_phase phase)
+{
+	struct vb2_workbuf_stats *stats;
+
+	/* No shared data to keep stats in, as for a vblock prefetch job */
+	if (!ctx->workbuf_used)
+		return;
+
+	stats = &vb2_get_sd(ctx)->workbuf_stats;
+	stats->phase = phase;
+
+	/* Data kept from earlier phases counts against this one too */
+	vb2_workbuf_note_used(stats, ctx->workbuf_used);
 }
 
 int vb2_read_gbb_header(struct vb2_context *ctx, struct vb2_gbb_header *gbb)
@@ -161,12 +185,64 @@ int vb2_init_context(struct vb2_context *ctx)
 	sd->struct_version_major = VB2_SHARED_DATA_VERSION_MAJOR;
 	sd->struct_version_minor = VB2_SHARED_DATA_VERSION_MINOR;
 	ctx->workbuf_used = vb2_wb_round_up(sizeof(*sd));
+	vb2_workbuf_note_used(&sd->workbuf_stats, ctx->workbuf_used);
 	return VB2_SUCCESS;
 }
 #pragma GCC diagnostic pop
 
+void vb2_trace(struct vb2_context *ctx, enum vb2_trace_event event,
+	       enum vb2_trace_type type)
+{
+#if VB2_BOOT_TRACE
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_trace_entry *entry;
+
+	if (!ctx->workbuf_used || sd->magic != VB2_SHARED_DATA_MAGIC)
+		return;
+
+	entry = &sd->trace[sd->trace_count++ & (VB2_TRACE_ENTRIES - 1)];
+	entry->time_us = vb2ex_utime();
+	entry->event = event;
+	entry->type = type;
+#endif
+}
+
+void vb2_cost_hash(struct vb2_context *ctx, enum vb2_cost_step step,
+		   uint32_t crypto_start_us, uint32_t hashed_bytes)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_cost *cost = &sd->costs[step];
+
+	if (!ctx->workbuf_used || sd->magic != VB2_SHARED_DATA_MAGIC)
+		return;
+
+	cost->crypto_us += vb2ex_utime() - crypto_start_us;
+	cost->hashed_bytes += hashed_bytes;
+}
+
+void vb2_cost_add(struct vb2_context *ctx, enum vb2_cost_step step,
+		  uint32_t start_us, uint32_t crypto_start_us,
+		  uint32_t hashed_bytes)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_cost *cost = &sd->costs[step];
+	uint32_t now = vb2ex_utime();
+
+	if (!ctx->workbuf_used || sd->magic != VB2_SHARED_DATA_MAGIC)
+		return;
+
+	cost->count++;
+	cost->total_us += now - start_us;
+	cost->crypto_us += now - crypto_start_us;
+	cost->hashed_bytes += hashed_bytes;
+}
+
 void vb2_check_recovery(struct vb2_context *ctx)
 {
+	static const struct vb2_nv_setting clear_recovery[] = {
+		{VB2_NV_RECOVERY_REQUEST, VB2_RECOVERY_NOT_REQUESTED},
+		{VB2_NV_RECOVERY_SUBCODE, VB2_RECOVERY_NOT_REQUESTED},
+	};
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	uint32_t reason = vb2_nv_get(ctx, VB2_NV_RECOVERY_REQUEST);
 	uint32_t subcode = vb2_nv_get(ctx, VB2_NV_RECOVERY_SUBCODE);
@@ -182,8 +258,7 @@ void vb2_check_recovery(struct vb2_context *ctx)
 		sd->recovery_reason = reason;
 
 	/* Clear request and subcode so we don't get stuck in recovery mode */
-	vb2_nv_set(ctx, VB2_NV_RECOVERY_REQUEST, VB2_RECOVERY_NOT_REQUESTED);
-	vb2_nv_set(ctx, VB2_NV_RECOVERY_SUBCODE, VB2_RECOVERY_NOT_REQUESTED);
+	vb2_nv_set_many(ctx, clear_recovery, ARRAY_SIZE(clear_recovery));
 
 	if (ctx->flags & VB2_CONTEXT_FORCE_RECOVERY_MODE) {
 		VB2_DEBUG("Recovery was requested manually\n");
@@ -222,7 +297,9 @@ int vb2_fw_parse_gbb(struct vb2_context *ctx)
 	if (!gbb)
 		return VB2_ERROR_GBB_WORKBUF;
 
+	vb2_trace(ctx, VB2_TRACE_GBB_READ, VB2_TRACE_BEGIN);
 	rv = vb2_read_gbb_header(ctx, gbb);
+	vb2_trace(ctx, VB2_TRACE_GBB_READ, VB2_TRACE_END);
 	if (rv)
 		return rv;
 
@@ -293,6 +370,15 @@ int vb2_check_dev_switch(struct vb2_context *ctx)
 
 		flags |= VB2_SECDATA_FLAG_LAST_BOOT_DEVELOPER;
 	} else {
+		static const struct vb2_nv_setting dev_boot_off[] = {
+			{VB2_NV_DEV_BOOT_USB, 0},
+			{VB2_NV_DEV_BOOT_LEGACY, 0},
+			{VB2_NV_DEV_BOOT_SIGNED_ONLY, 0},
+			{VB2_NV_DEV_BOOT_FASTBOOT_FULL_CAP, 0},
+			{VB2_NV_DEV_DEFAULT_BOOT, 0},
+			{VB2_NV_FASTBOOT_UNLOCK_IN_FW, 0},
+		};
+
 		/* Normal mode */
 		flags &= ~VB2_SECDATA_FLAG_LAST_BOOT_DEVELOPER;
 
@@ -301,12 +387,7 @@ int vb2_check_dev_switch(struct vb2_context *ctx)
 		 * initially disabled if the user later transitions back into
 		 * developer mode.
 		 */
-		vb2_nv_set(ctx, VB2_NV_DEV_BOOT_USB, 0);
-		vb2_nv_set(ctx, VB2_NV_DEV_BOOT_LEGACY, 0);
-		vb2_nv_set(ctx, VB2_NV_DEV_BOOT_SIGNED_ONLY, 0);
-		vb2_nv_set(ctx, VB2_NV_DEV_BOOT_FASTBOOT_FULL_CAP, 0);
-		vb2_nv_set(ctx, VB2_NV_DEV_DEFAULT_BOOT, 0);
-		vb2_nv_set(ctx, VB2_NV_FASTBOOT_UNLOCK_IN_FW, 0);
+		vb2_nv_set_many(ctx, dev_boot_off, ARRAY_SIZE(dev_boot_off));
 	}
 
 	if (ctx->flags & VB2_CONTEXT_FORCE_WIPEOUT_MODE)
@@ -96,361 +96,288 @@ void vb2_nv_init(struct vb2_context *ctx)
 		sd->status |= VB2_SD_STATUS_NV_INIT;
 }
 
-/* Macro for vb2_nv_get() single-bit settings to reduce duplicate code. */
-#define GETBIT(offs, mask) (p[offs] & mask ? 1 : 0)
-
-uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param)
-{
-	const uint8_t *p = ctx->nvdata;
-
+/* How vb2_nv_set() stores values too large for a field */
+enum vb2_nv_range {
+	/* Keep the low bits of the value */
+	NV_RANGE_TRUNCATE = 0,
+	/* Single-bit flag; any non-zero value sets it */
+	NV_RANGE_BIT,
+	/* Store the largest value which fits */
+	NV_RANGE_CLIP,
+	/* Store the field's default value */
+	NV_RANGE_DEFAULT,
+};
+
+/* Where and how a parameter is stored in the non-volatile data */
+struct vb2_nv_field {
+	/* Offsets of the bytes holding the field, least significant first */
+	uint8_t offs[4];
+	/* Number of bytes in offs[]; 0 if the param is not stored */
+	uint8_t bytes;
+	/* Bits of offs[0] used by a one-byte field, and the lowest one */
+	uint8_t mask;
+	uint8_t shift;
+	/* How to store out of range values (enum vb2_nv_range) */
+	uint8_t range;
+	/* Non-zero if the field is only present in V2 */
+	uint8_t v2_only;
 	/*
-	 * TODO: We could reduce the binary size for this code by #ifdef'ing
-	 * out the params not used by firmware verification.
+	 * Value stored in place of out of range values, or returned from a V1
+	 * record for a field only present in V2
 	 */
-	switch (param) {
-	case VB2_NV_FIRMWARE_SETTINGS_RESET:
-		return GETBIT(VB2_NV_OFFS_HEADER,
-			      VB2_NV_HEADER_FW_SETTINGS_RESET);
-
-	case VB2_NV_KERNEL_SETTINGS_RESET:
-		return GETBIT(VB2_NV_OFFS_HEADER,
-			      VB2_NV_HEADER_KERNEL_SETTINGS_RESET);
-
-	case VB2_NV_DEBUG_RESET_MODE:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET);
-
-	case VB2_NV_TRY_NEXT:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT);
-
-	case VB2_NV_TRY_COUNT:
-		return p[VB2_NV_OFFS_BOOT] & VB2_NV_BOOT_TRY_COUNT_MASK;
-
-	case VB2_NV_FW_TRIED:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED);
-
-	case VB2_NV_FW_RESULT:
-		return p[VB2_NV_OFFS_BOOT2] & VB2_NV_BOOT2_RESULT_MASK;
-
-	case VB2_NV_FW_PREV_TRIED:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED);
-
-	case VB2_NV_FW_PREV_RESULT:
-		return (p[VB2_NV_OFFS_BOOT2] & VB2_NV_BOOT2_PREV_RESULT_MASK)
-			>> VB2_NV_BOOT2_PREV_RESULT_SHIFT;
-
-	case VB2_NV_RECOVERY_REQUEST:
-		return p[VB2_NV_OFFS_RECOVERY];
-
-	case VB2_NV_DIAG_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG);
-
-	case VB2_NV_RECOVERY_SUBCODE:
-		return p[VB2_NV_OFFS_RECOVERY_SUBCODE];
-
-	case VB2_NV_LOCALIZATION_INDEX:
-		return p[VB2_NV_OFFS_LOCALIZATION];
-
-	case VB2_NV_KERNEL_FIELD:
-		return p[VB2_NV_OFFS_KERNEL1] | (p[VB2_NV_OFFS_KERNEL2] << 8);
-
-	case VB2_NV_DEV_BOOT_USB:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB);
-
-	case VB2_NV_DEV_BOOT_LEGACY:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY);
-
-	case VB2_NV_DEV_BOOT_SIGNED_ONLY:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY);
-
-	case VB2_NV_DEV_BOOT_FASTBOOT_FULL_CAP:
-		return GETBIT(VB2_NV_OFFS_DEV,
-			      VB2_NV_DEV_FLAG_FASTBOOT_FULL_CAP);
-
-	case VB2_NV_DEV_DEFAULT_BOOT:
-		return (p[VB2_NV_OFFS_DEV] & VB2_NV_DEV_FLAG_DEFAULT_BOOT)
-			>> VB2_NV_DEV_DEFAULT_BOOT_SHIFT;
-
-	case VB2_NV_DEV_ENABLE_UDC:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC);
-
-	case VB2_NV_DISABLE_DEV_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV);
-
-	case VB2_NV_DISPLAY_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST);
-
-	case VB2_NV_BACKUP_NVRAM_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM);
-
-	case VB2_NV_CLEAR_TPM_OWNER_REQUEST:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST);
-
-	case VB2_NV_CLEAR_TPM_OWNER_DONE:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE);
-
-	case VB2_NV_TPM_REQUESTED_REBOOT:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED);
+	uint32_t dflt;
+};
+
+/* Position of the lowest bit set in a one-byte mask */
+#define NV_SHIFT(mask) ((mask) & 0x01 ? 0 : (mask) & 0x02 ? 1 :	\
+			(mask) & 0x04 ? 2 : (mask) & 0x08 ? 3 :		\
+			(mask) & 0x10 ? 4 : (mask) & 0x20 ? 5 :		\
+			(mask) & 0x40 ? 6 : 7)
+
+/* Field descriptors, to reduce duplicate code in the table below */
+#define NV_BITS(offs, mask, range, dflt) \
+	{ {offs}, 1, mask, NV_SHIFT(mask), range, 0, dflt }
+#define NV_BIT(offs, mask) NV_BITS(offs, mask, NV_RANGE_BIT, 0)
+#define NV_BYTE(offs, range, dflt) NV_BITS(offs, 0xff, range, dflt)
+#define NV_WORD(offs1, offs2) \
+	{ {offs1, offs2}, 2, 0xff, 0, NV_RANGE_TRUNCATE, 0, 0 }
+#define NV_DWORD(offs1, offs2, offs3, offs4, v2_only, dflt)		\
+	{ {offs1, offs2, offs3, offs4}, 4, 0xff, 0, NV_RANGE_TRUNCATE,	\
+	  v2_only, dflt }
+
+/*
+ * Layout of each param.  Params with no entry (bytes == 0) read as 0 and
+ * ignore writes; new params must be added here.
+ *
+ * TODO: We could reduce the binary size for this table by #ifdef'ing out the
+ * params not used by firmware verification.
+ */
+static const struct vb2_nv_field vb2_nv_fields[] = {
+	[VB2_NV_FIRMWARE_SETTINGS_RESET] =
+		NV_BIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_FW_SETTINGS_RESET),
+	[VB2_NV_KERNEL_SETTINGS_RESET] =
+		NV_BIT(VB2_NV_OFFS_HEADER,
+		       VB2_NV_HEADER_KERNEL_SETTINGS_RESET),
+	[VB2_NV_DEBUG_RESET_MODE] =
+		NV_BIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET),
+	[VB2_NV_TRY_NEXT] =
+		NV_BIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT),
+	[VB2_NV_TRY_COUNT] =
+		NV_BITS(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_TRY_COUNT_MASK,
+			NV_RANGE_CLIP, 0),
+	[VB2_NV_FW_TRIED] =
+		NV_BIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED),
+	/* Map out of range values to unknown */
+	[VB2_NV_FW_RESULT] =
+		NV_BITS(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_RESULT_MASK,
+			NV_RANGE_DEFAULT, VB2_FW_RESULT_UNKNOWN),
+	[VB2_NV_FW_PREV_TRIED] =
+		NV_BIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED),
+	[VB2_NV_FW_PREV_RESULT] =
+		NV_BITS(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_RESULT_MASK,
+			NV_RANGE_DEFAULT, VB2_FW_RESULT_UNKNOWN),
+	/*
+	 * Map values outside the valid range to the legacy reason, since we
+	 * can't determine if we're called from kernel or user mode.
+	 */
+	[VB2_NV_RECOVERY_REQUEST] =
+		NV_BYTE(VB2_NV_OFFS_RECOVERY, NV_RANGE_DEFAULT,
+			VB2_RECOVERY_LEGACY),
+	[VB2_NV_DIAG_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG),
+	[VB2_NV_RECOVERY_SUBCODE] =
+		NV_BYTE(VB2_NV_OFFS_RECOVERY_SUBCODE, NV_RANGE_TRUNCATE, 0),
+	/* Map values outside the valid range to the default index. */
+	[VB2_NV_LOCALIZATION_INDEX] =
+		NV_BYTE(VB2_NV_OFFS_LOCALIZATION, NV_RANGE_DEFAULT, 0),
+	[VB2_NV_KERNEL_FIELD] =
+		NV_WORD(VB2_NV_OFFS_KERNEL1, VB2_NV_OFFS_KERNEL2),
+	[VB2_NV_DEV_BOOT_USB] =
+		NV_BIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB),
+	[VB2_NV_DEV_BOOT_LEGACY] =
+		NV_BIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY),
+	[VB2_NV_DEV_BOOT_SIGNED_ONLY] =
+		NV_BIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY),
+	[VB2_NV_DEV_BOOT_FASTBOOT_FULL_CAP] =
+		NV_BIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_FASTBOOT_FULL_CAP),
+	/* Map out of range values to disk */
+	[VB2_NV_DEV_DEFAULT_BOOT] =
+		NV_BITS(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_DEFAULT_BOOT,
+			NV_RANGE_DEFAULT, VB2_DEV_DEFAULT_BOOT_DISK),
+	[VB2_NV_DEV_ENABLE_UDC] =
+		NV_BIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC),
+	[VB2_NV_DISABLE_DEV_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV),
+	[VB2_NV_DISPLAY_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST),
+	[VB2_NV_BACKUP_NVRAM_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM),
+	[VB2_NV_CLEAR_TPM_OWNER_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST),
+	[VB2_NV_CLEAR_TPM_OWNER_DONE] =
+		NV_BIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE),
+	[VB2_NV_TPM_REQUESTED_REBOOT] =
+		NV_BIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED),
+	[VB2_NV_REQ_WIPEOUT] =
+		NV_BIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_WIPEOUT),
+	[VB2_NV_FASTBOOT_UNLOCK_IN_FW] =
+		NV_BIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_UNLOCK_FASTBOOT),
+	[VB2_NV_BOOT_ON_AC_DETECT] =
+		NV_BIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT),
+	[VB2_NV_TRY_RO_SYNC] =
+		NV_BIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC),
+	[VB2_NV_BATTERY_CUTOFF_REQUEST] =
+		NV_BIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF),
+	[VB2_NV_KERNEL_MAX_ROLLFORWARD] =
+		NV_DWORD(VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD1,
+			 VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD2,
+			 VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD3,
+			 VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD4, 0, 0),
+	[VB2_NV_FW_MAX_ROLLFORWARD] =
+		NV_DWORD(VB2_NV_OFFS_FW_MAX_ROLLFORWARD1,
+			 VB2_NV_OFFS_FW_MAX_ROLLFORWARD2,
+			 VB2_NV_OFFS_FW_MAX_ROLLFORWARD3,
+			 VB2_NV_OFFS_FW_MAX_ROLLFORWARD4, 1,
+			 VB2_FW_MAX_ROLLFORWARD_V1_DEFAULT),
+	[VB2_NV_POST_EC_SYNC_DELAY] =
+		NV_BIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_POST_EC_SYNC_DELAY),
+	[VB2_NV_EC_SYNC_NONCE] =
+		NV_DWORD(VB2_NV_OFFS_EC_SYNC_NONCE1,
+			 VB2_NV_OFFS_EC_SYNC_NONCE2,
+			 VB2_NV_OFFS_EC_SYNC_NONCE3,
+			 VB2_NV_OFFS_EC_SYNC_NONCE4, 1, 0),
+	[VB2_NV_EC_SYNC_HASH] =
+		NV_DWORD(VB2_NV_OFFS_EC_SYNC_HASH1,
+			 VB2_NV_OFFS_EC_SYNC_HASH2,
+			 VB2_NV_OFFS_EC_SYNC_HASH3,
+			 VB2_NV_OFFS_EC_SYNC_HASH4, 1, 0),
+	/* VB2_NV_DEPRECATED_*_ALT_OS_REQUEST are no longer stored */
+};
+
+#undef NV_DWORD
+#undef NV_WORD
+#undef NV_BYTE
+#undef NV_BIT
+#undef NV_BITS
+#undef NV_SHIFT
 
-	case VB2_NV_REQ_WIPEOUT:
-		return GETBIT(VB2_NV_OFFS_HEADER , VB2_NV_HEADER_WIPEOUT);
+/**
+ * Look up the layout of a param.
+ *
+ * @param ctx		Context pointer
+ * @param param		Parameter to look up
+ * @return The field, or NULL if the param isn't stored in this record.
+ */
+static const struct vb2_nv_field *vb2_nv_field(const struct vb2_context *ctx,
+					       enum vb2_nv_param param)
+{
+	const struct vb2_nv_field *f;
 
-	case VB2_NV_FASTBOOT_UNLOCK_IN_FW:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_UNLOCK_FASTBOOT);
+	if ((unsigned int)param >= ARRAY_SIZE(vb2_nv_fields))
+		return NULL;
 
-	case VB2_NV_BOOT_ON_AC_DETECT:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT);
+	f = &vb2_nv_fields[param];
+	if (!f->bytes)
+		return NULL;
+	if (f->v2_only && !(ctx->flags & VB2_CONTEXT_NVDATA_V2))
+		return NULL;
 
-	case VB2_NV_TRY_RO_SYNC:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC);
+	return f;
+}
 
-	case VB2_NV_BATTERY_CUTOFF_REQUEST:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF);
+uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param)
+{
+	const struct vb2_nv_field *f = vb2_nv_field(ctx, param);
+	const uint8_t *p = ctx->nvdata;
+	uint32_t value = 0;
+	int i;
 
-	case VB2_NV_KERNEL_MAX_ROLLFORWARD:
-		return (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD1]
-			| (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD2] << 8)
-			| (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD3] << 16)
-			| (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD4] << 24));
+	if (!f) {
+		/* Fields only present in V2 have a default for V1 */
+		if ((unsigned int)param < ARRAY_SIZE(vb2_nv_fields))
+			return vb2_nv_fields[param].dflt;
+		return 0;
+	}
 
-	case VB2_NV_FW_MAX_ROLLFORWARD:
-		/* Field only present in V2 */
-		if (!(ctx->flags & VB2_CONTEXT_NVDATA_V2))
-			return VB2_FW_MAX_ROLLFORWARD_V1_DEFAULT;
+	if (f->bytes == 1)
+		return (p[f->offs[0]] & f->mask) >> f->shift;
 
-		return (p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD1]
-			| (p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD2] << 8)
-			| (p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD3] << 16)
-			| (p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD4] << 24));
+	for (i = f->bytes - 1; i >= 0; i--)
+		value = (value << 8) | p[f->offs[i]];
+	return value;
+}
 
-	case VB2_NV_POST_EC_SYNC_DELAY:
-		return GETBIT(VB2_NV_OFFS_MISC,
-			      VB2_NV_MISC_POST_EC_SYNC_DELAY);
+/**
+ * Write a non-volatile value without regenerating the CRC.
+ *
+ * @param ctx		Context pointer
+ * @param param		Parameter to write
+ * @param value		New value
+ * @return 1 if ctx->nvdata[] changed, 0 if not.
+ */
+static int vb2_nv_store(struct vb2_context *ctx,
+			enum vb2_nv_param param,
+			uint32_t value)
+{
+	const struct vb2_nv_field *f = vb2_nv_field(ctx, param);
+	uint8_t *p = ctx->nvdata;
+	int changed = 0;
+	int i;
 
-	case VB2_NV_DEPRECATED_ENABLE_ALT_OS_REQUEST:
-	case VB2_NV_DEPRECATED_DISABLE_ALT_OS_REQUEST:
+	if (!f)
 		return 0;
+
+	if (f->bytes == 1) {
+		const uint32_t max = f->mask >> f->shift;
+		uint8_t byte;
+
+		if (f->range == NV_RANGE_BIT)
+			value = value ? 1 : 0;
+		else if (value > max && f->range == NV_RANGE_CLIP)
+			value = max;
+		else if (value > max && f->range == NV_RANGE_DEFAULT)
+			value = f->dflt;
+
+		byte = (p[f->offs[0]] & ~f->mask) |
+			((value << f->shift) & f->mask);
+		if (p[f->offs[0]] == byte)
+			return 0;
+		p[f->offs[0]] = byte;
+		return 1;
 	}
 
-	/*
-	 * Put default return outside the switch() instead of in default:, so
-	 * that adding a new param will cause a compiler warning.
-	 */
-	return 0;
+	for (i = 0; i < f->bytes; i++, value >>= 8) {
+		if (p[f->offs[i]] != (uint8_t)value) {
+			p[f->offs[i]] = (uint8_t)value;
+			changed = 1;
+		}
+	}
+	return changed;
 }
 
-#undef GETBIT
-
-/* Macro for vb2_nv_set() single-bit settings to reduce duplicate code. */
-#define SETBIT(offs, mask)					\
-	{ if (value) p[offs] |= mask; else p[offs] &= ~mask; }
-
 void vb2_nv_set(struct vb2_context *ctx,
 		enum vb2_nv_param param,
 		uint32_t value)
 {
-	uint8_t *p = ctx->nvdata;
-
 	/* If not changing the value, don't regenerate the CRC. */
-	if (vb2_nv_get(ctx, param) == value)
-		return;
+	if (vb2_nv_store(ctx, param, value))
+		vb2_nv_regen_crc(ctx);
+}
 
-	/*
-	 * TODO: We could reduce the binary size for this code by #ifdef'ing
-	 * out the params not used by firmware verification.
-	 */
-	switch (param) {
-	case VB2_NV_FIRMWARE_SETTINGS_RESET:
-		SETBIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_FW_SETTINGS_RESET);
-		break;
-
-	case VB2_NV_KERNEL_SETTINGS_RESET:
-		SETBIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_KERNEL_SETTINGS_RESET);
-		break;
-
-	case VB2_NV_DEBUG_RESET_MODE:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET);
-		break;
-
-	case VB2_NV_TRY_NEXT:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT);
-		break;
-
-	case VB2_NV_TRY_COUNT:
-		/* Clip to valid range. */
-		if (value > VB2_NV_BOOT_TRY_COUNT_MASK)
-			value = VB2_NV_BOOT_TRY_COUNT_MASK;
-
-		p[VB2_NV_OFFS_BOOT] &= ~VB2_NV_BOOT_TRY_COUNT_MASK;
-		p[VB2_NV_OFFS_BOOT] |= (uint8_t)value;
-		break;
-
-	case VB2_NV_FW_TRIED:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED);
-		break;
-
-	case VB2_NV_FW_RESULT:
-		/* Map out of range values to unknown */
-		if (value > VB2_NV_BOOT2_RESULT_MASK)
-			value = VB2_FW_RESULT_UNKNOWN;
-
-		p[VB2_NV_OFFS_BOOT2] &= ~VB2_NV_BOOT2_RESULT_MASK;
-		p[VB2_NV_OFFS_BOOT2] |= (uint8_t)value;
-		break;
-
-	case VB2_NV_FW_PREV_TRIED:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED);
-		break;
-
-	case VB2_NV_FW_PREV_RESULT:
-		/* Map out of range values to unknown */
-		if (value > VB2_NV_BOOT2_RESULT_MASK)
-			value = VB2_FW_RESULT_UNKNOWN;
-
-		p[VB2_NV_OFFS_BOOT2] &= ~VB2_NV_BOOT2_PREV_RESULT_MASK;
-		p[VB2_NV_OFFS_BOOT2] |=
-			(uint8_t)(value << VB2_NV_BOOT2_PREV_RESULT_SHIFT);
-		break;
-
-	case VB2_NV_RECOVERY_REQUEST:
-		/*
-		 * Map values outside the valid range to the legacy reason,
-		 * since we can't determine if we're called from kernel or user
-		 * mode.
-		 */
-		if (value > 0xff)
-			value = VB2_RECOVERY_LEGACY;
-		p[VB2_NV_OFFS_RECOVERY] = (uint8_t)value;
-		break;
-
-	case VB2_NV_DIAG_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG);
-		break;
-
-	case VB2_NV_RECOVERY_SUBCODE:
-		p[VB2_NV_OFFS_RECOVERY_SUBCODE] = (uint8_t)value;
-		break;
-
-	case VB2_NV_LOCALIZATION_INDEX:
-		/* Map values outside the valid range to the default index. */
-		if (value > 0xFF)
-			value = 0;
-		p[VB2_NV_OFFS_LOCALIZATION] = (uint8_t)value;
-		break;
-
-	case VB2_NV_KERNEL_FIELD:
-		p[VB2_NV_OFFS_KERNEL1] = (uint8_t)(value);
-		p[VB2_NV_OFFS_KERNEL2] = (uint8_t)(value >> 8);
-		break;
-
-	case VB2_NV_DEV_BOOT_USB:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB);
-		break;
-
-	case VB2_NV_DEV_BOOT_LEGACY:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY);
-		break;
-
-	case VB2_NV_DEV_BOOT_SIGNED_ONLY:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY);
-		break;
-
-	case VB2_NV_DEV_BOOT_FASTBOOT_FULL_CAP:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_FASTBOOT_FULL_CAP);
-		break;
-
-	case VB2_NV_DEV_DEFAULT_BOOT:
-		/* Map out of range values to disk */
-		if (value > (VB2_NV_DEV_FLAG_DEFAULT_BOOT >>
-			     VB2_NV_DEV_DEFAULT_BOOT_SHIFT))
-			value = VB2_DEV_DEFAULT_BOOT_DISK;
-
-		p[VB2_NV_OFFS_DEV] &= ~VB2_NV_DEV_FLAG_DEFAULT_BOOT;
-		p[VB2_NV_OFFS_DEV] |=
-			(uint8_t)(value << VB2_NV_DEV_DEFAULT_BOOT_SHIFT);
-		break;
-
-	case VB2_NV_DEV_ENABLE_UDC:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC);
-		break;
-
-	case VB2_NV_DISABLE_DEV_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV);
-		break;
-
-	case VB2_NV_DISPLAY_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST);
-		break;
-
-	case VB2_NV_BACKUP_NVRAM_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM);
-		break;
-
-	case VB2_NV_CLEAR_TPM_OWNER_REQUEST:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST);
-		break;
-
-	case VB2_NV_CLEAR_TPM_OWNER_DONE:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE);
-		break;
-
-	case VB2_NV_TPM_REQUESTED_REBOOT:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED);
-		break;
-
-	case VB2_NV_REQ_WIPEOUT:
-		SETBIT(VB2_NV_OFFS_HEADER , VB2_NV_HEADER_WIPEOUT);
-		break;
-
-	case VB2_NV_FASTBOOT_UNLOCK_IN_FW:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_UNLOCK_FASTBOOT);
-		break;
-
-	case VB2_NV_BOOT_ON_AC_DETECT:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT);
-		break;
-
-	case VB2_NV_TRY_RO_SYNC:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC);
-		break;
-
-	case VB2_NV_BATTERY_CUTOFF_REQUEST:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF);
-		break;
-
-	case VB2_NV_KERNEL_MAX_ROLLFORWARD:
-		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD1] = (uint8_t)(value);
-		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD2] = (uint8_t)(value >> 8);
-		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD3] = (uint8_t)(value >> 16);
-		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD4] = (uint8_t)(value >> 24);
-		break;
-
-	case VB2_NV_FW_MAX_ROLLFORWARD:
-		/* Field only present in V2 */
-		if (!(ctx->flags & VB2_CONTEXT_NVDATA_V2))
-			return;
-
-		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD1] = (uint8_t)(value);
-		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD2] = (uint8_t)(value >> 8);
-		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD3] = (uint8_t)(value >> 16);
-		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD4] = (uint8_t)(value >> 24);
-		break;
-
-	case VB2_NV_POST_EC_SYNC_DELAY:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_POST_EC_SYNC_DELAY);
-		break;
-
-	case VB2_NV_DEPRECATED_ENABLE_ALT_OS_REQUEST:
-	case VB2_NV_DEPRECATED_DISABLE_ALT_OS_REQUEST:
-		return;
-	}
+int vb2_nv_set_many(struct vb2_context *ctx,
+		    const struct vb2_nv_setting *settings,
+		    int count)
+{
+	int changed = 0;
+	int i;
 
-	/*
-	 * Note there is no default case.  This causes a compiler warning if
-	 * a new param is added to the enum without adding support here.
-	 */
+	for (i = 0; i < count; i++)
+		changed |= vb2_nv_store(ctx, settings[i].param,
+					settings[i].value);
 
-	/* Need to regenerate CRC, since the value changed. */
-	vb2_nv_regen_crc(ctx);
-}
+	/* Regenerate the CRC once for the whole batch */
+	if (changed)
+		vb2_nv_regen_crc(ctx);
 
-#undef SETBIT
+	return changed;
+}
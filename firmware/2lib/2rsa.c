@@ -15,6 +15,16 @@
 #include "2sha.h"
 #include "vboot_test.h"
 
+/*
+ * Number of words in the modulus.  This is a constant in builds for a single
+ * RSA key size, so every loop over the words has a fixed trip count.
+ */
+#if VB2_RSA_FIXED_BITS
+#define ARRSIZE(key) ((uint32_t)(VB2_RSA_FIXED_BITS / 32))
+#else
+#define ARRSIZE(key) ((key)->arrsize)
+#endif
+
 /**
  * a[] -= mod
  */
@@ -22,7 +32,7 @@ static void subM(const struct vb2_public_key *key, uint32_t *a)
 {
 	int64_t A = 0;
 	uint32_t i;
-	for (i = 0; i < key->arrsize; ++i) {
+	for (i = 0; i < ARRSIZE(key); ++i) {
 		A += (uint64_t)a[i] - key->n[i];
 		a[i] = (uint32_t)A;
 		A >>= 32;
@@ -35,7 +45,7 @@ static void subM(const struct vb2_public_key *key, uint32_t *a)
 int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a)
 {
 	uint32_t i;
-	for (i = key->arrsize; i;) {
+	for (i = ARRSIZE(key); i;) {
 		--i;
 		if (a[i] < key->n[i])
 			return 0;
@@ -58,7 +68,7 @@ static void montMulAdd(const struct vb2_public_key *key,
 	uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
 	uint32_t i;
 
-	for (i = 1; i < key->arrsize; ++i) {
+	for (i = 1; i < ARRSIZE(key); ++i) {
 		A = (A >> 32) + (uint64_t)a * b[i] + c[i];
 		B = (B >> 32) + (uint64_t)d0 * key->n[i] + (uint32_t)A;
 		c[i - 1] = (uint32_t)B;
@@ -84,7 +94,7 @@ static void montMulAdd0(const struct vb2_public_key *key,
 	uint64_t B = (uint64_t)d0 * key->n[0] + c[0];
 	uint32_t i;
 
-	for (i = 1; i < key->arrsize; ++i) {
+	for (i = 1; i < ARRSIZE(key); ++i) {
 		B = (B >> 32) + (uint64_t)d0 * key->n[i] + c[i];
 		c[i - 1] = (uint32_t)B;
 	}
@@ -101,10 +111,10 @@ static void montMul(const struct vb2_public_key *key,
 		    const uint32_t *b)
 {
 	uint32_t i;
-	for (i = 0; i < key->arrsize; ++i) {
+	for (i = 0; i < ARRSIZE(key); ++i) {
 		c[i] = 0;
 	}
-	for (i = 0; i < key->arrsize; ++i) {
+	for (i = 0; i < ARRSIZE(key); ++i) {
 		montMulAdd(key, c, a[i], b);
 	}
 }
@@ -116,14 +126,317 @@ static void montMul1(const struct vb2_public_key *key,
 {
 	int i;
 
-	for (i = 0; i < key->arrsize; ++i)
+	for (i = 0; i < ARRSIZE(key); ++i)
 		c[i] = 0;
 
 	montMulAdd(key, c, 1, a);
-	for (i = 1; i < key->arrsize; ++i)
+	for (i = 1; i < ARRSIZE(key); ++i)
 		montMulAdd0(key, c, a);
 }
 
+/**
+ * Montgomery c[] = a[] * a[] / R % mod
+ *
+ * Same result as montMul(key, c, a, a), but each product a[i] * a[j] with
+ * i != j is computed once and doubled, saving about a quarter of the
+ * multiplications.  The square is built a column of the product at a time,
+ * with the Montgomery reduction folded into the same columns.  The
+ * reduction factors are kept in c[] until their last column has been
+ * summed, and then replaced by the result.  c must not overlap a.
+ */
+static void montSqr(const struct vb2_public_key *key,
+		    uint32_t *c,
+		    const uint32_t *a)
+{
+	const uint32_t s = ARRSIZE(key);
+	uint64_t lo = 0, xlo, p;	/* Low two words of column sums */
+	uint32_t hi = 0, xhi;		/* and their top words */
+	uint32_t i, j, jmin;
+
+	for (i = 0; i < 2 * s - 1; ++i) {
+		jmin = i < s ? 0 : i - s + 1;
+
+		/* Products of two different words, doubled */
+		xlo = 0;
+		xhi = 0;
+		for (j = jmin; j < i - j; ++j) {
+			p = (uint64_t)a[j] * a[i - j];
+			xlo += p;
+			xhi += xlo < p;
+		}
+		xhi = xhi << 1 | (uint32_t)(xlo >> 63);
+		xlo <<= 1;
+		lo += xlo;
+		hi += xhi + (lo < xlo);
+
+		/* The square of a word, in even columns */
+		if (!(i & 1)) {
+			p = (uint64_t)a[i / 2] * a[i / 2];
+			lo += p;
+			hi += lo < p;
+		}
+
+		/* Multiples of the modulus added by the reduction */
+		for (j = jmin; j < i && j < s; ++j) {
+			p = (uint64_t)c[j] * key->n[i - j];
+			lo += p;
+			hi += lo < p;
+		}
+
+		if (i < s) {
+			/* Pick the multiple that clears this column */
+			c[i] = (uint32_t)lo * key->n0inv;
+			p = (uint64_t)c[i] * key->n[0];
+			lo += p;
+			hi += lo < p;
+		} else {
+			c[i - s] = (uint32_t)lo;
+		}
+		lo = lo >> 32 | (uint64_t)hi << 32;
+		hi = 0;
+	}
+
+	c[s - 1] = (uint32_t)lo;
+
+	if (lo >> 32) {
+		subM(key, c);
+	}
+}
+
+#if VB2_RSA_64BIT_LIMBS
+/*
+ * 64-bit limb versions of the above.  The key still stores n[] and rr[] as
+ * little endian 32-bit words, so each limb is built from a pair of words.
+ * Every supported key size has an even arrsize, so R = 2^(32 * arrsize) is
+ * the same as with 32-bit limbs and rr[] can be used unchanged; only n0inv
+ * needs extending to 64 bits.
+ */
+typedef unsigned __int128 uint128_t;
+
+/* 64-bit limb i of a little endian 32-bit word array */
+#define LIMB64(a, i) (((uint64_t)(a)[2 * (i) + 1] << 32) | (a)[2 * (i)])
+
+/**
+ * Return -1 / n[0] mod 2^64, given key->n0inv = -1 / n[0] mod 2^32
+ */
+static uint64_t n0inv64(const struct vb2_public_key *key)
+{
+	uint64_t n0 = LIMB64(key->n, 0);
+	uint64_t inv = (uint32_t)-key->n0inv;  /* 1 / n[0] mod 2^32 */
+
+	/* One Newton step doubles the number of correct bits */
+	inv *= 2 - n0 * inv;
+	return -inv;
+}
+
+/**
+ * a[] -= mod
+ */
+static void subM64(const struct vb2_public_key *key, uint64_t *a)
+{
+	uint128_t A = 0;
+	uint32_t i;
+	for (i = 0; i < ARRSIZE(key) / 2; ++i) {
+		A = (uint128_t)a[i] - LIMB64(key->n, i) - (uint64_t)(A >> 127);
+		a[i] = (uint64_t)A;
+	}
+}
+
+/**
+ * Return a[] >= mod
+ */
+static int mont_ge64(const struct vb2_public_key *key, const uint64_t *a)
+{
+	uint32_t i;
+	for (i = ARRSIZE(key) / 2; i;) {
+		uint64_t n;
+		--i;
+		n = LIMB64(key->n, i);
+		if (a[i] < n)
+			return 0;
+		if (a[i] > n)
+			return 1;
+	}
+	return 1;  /* equal */
+}
+
+/**
+ * Montgomery c[] += a * b[] / R % mod
+ */
+static void montMulAdd64(const struct vb2_public_key *key,
+			 uint64_t n0inv,
+			 uint64_t *c,
+			 const uint64_t a,
+			 const uint64_t *b)
+{
+	uint128_t A = (uint128_t)a * b[0] + c[0];
+	uint64_t d0 = (uint64_t)A * n0inv;
+	uint128_t B = (uint128_t)d0 * LIMB64(key->n, 0) + (uint64_t)A;
+	uint32_t i;
+
+	for (i = 1; i < ARRSIZE(key) / 2; ++i) {
+		A = (A >> 64) + (uint128_t)a * b[i] + c[i];
+		B = (B >> 64) + (uint128_t)d0 * LIMB64(key->n, i) +
+			(uint64_t)A;
+		c[i - 1] = (uint64_t)B;
+	}
+
+	A = (A >> 64) + (B >> 64);
+
+	c[i - 1] = (uint64_t)A;
+
+	if (A >> 64) {
+		subM64(key, c);
+	}
+}
+
+/**
+ * Montgomery c[] = a[] * b[] / R % mod
+ */
+static void montMul64(const struct vb2_public_key *key,
+		      uint64_t n0inv,
+		      uint64_t *c,
+		      const uint64_t *a,
+		      const uint64_t *b)
+{
+	uint32_t i;
+	for (i = 0; i < ARRSIZE(key) / 2; ++i) {
+		c[i] = 0;
+	}
+	for (i = 0; i < ARRSIZE(key) / 2; ++i) {
+		montMulAdd64(key, n0inv, c, a[i], b);
+	}
+}
+
+/**
+ * Montgomery c[] = a[] * a[] / R % mod
+ *
+ * Same as montSqr(), on 64-bit limbs.  c must not overlap a.
+ */
+static void montSqr64(const struct vb2_public_key *key,
+		      uint64_t n0inv,
+		      uint64_t *c,
+		      const uint64_t *a)
+{
+	const uint32_t s = ARRSIZE(key) / 2;
+	uint128_t lo = 0, xlo, p;	/* Low two limbs of column sums */
+	uint64_t hi = 0, xhi;		/* and their top limbs */
+	uint32_t i, j, jmin;
+
+	for (i = 0; i < 2 * s - 1; ++i) {
+		jmin = i < s ? 0 : i - s + 1;
+
+		/* Products of two different limbs, doubled */
+		xlo = 0;
+		xhi = 0;
+		for (j = jmin; j < i - j; ++j) {
+			p = (uint128_t)a[j] * a[i - j];
+			xlo += p;
+			xhi += xlo < p;
+		}
+		xhi = xhi << 1 | (uint64_t)(xlo >> 127);
+		xlo <<= 1;
+		lo += xlo;
+		hi += xhi + (lo < xlo);
+
+		/* The square of a limb, in even columns */
+		if (!(i & 1)) {
+			p = (uint128_t)a[i / 2] * a[i / 2];
+			lo += p;
+			hi += lo < p;
+		}
+
+		/* Multiples of the modulus added by the reduction */
+		for (j = jmin; j < i && j < s; ++j) {
+			p = (uint128_t)c[j] * LIMB64(key->n, i - j);
+			lo += p;
+			hi += lo < p;
+		}
+
+		if (i < s) {
+			/* Pick the multiple that clears this column */
+			c[i] = (uint64_t)lo * n0inv;
+			p = (uint128_t)c[i] * LIMB64(key->n, 0);
+			lo += p;
+			hi += lo < p;
+		} else {
+			c[i - s] = (uint64_t)lo;
+		}
+		lo = lo >> 64 | (uint128_t)hi << 64;
+		hi = 0;
+	}
+
+	c[s - 1] = (uint64_t)lo;
+
+	if (lo >> 64) {
+		subM64(key, c);
+	}
+}
+
+/**
+ * In-place public exponentiation on 64-bit limbs.
+ *
+ * Same as modpow(), but key->arrsize must be even.  The work buffer is the
+ * same size and must be 64-bit aligned.
+ */
+static void modpow64(const struct vb2_public_key *key, uint8_t *inout,
+		     uint32_t *workbuf32, int exp)
+{
+	const uint32_t limbs = ARRSIZE(key) / 2;
+	const uint64_t n0inv = n0inv64(key);
+	uint64_t *a = (uint64_t *)workbuf32;
+	uint64_t *aR = a + limbs;
+	uint64_t *aaR = aR + limbs;
+	uint64_t *aaa = aaR;  /* Re-use location. */
+	int i, j;
+
+	/* Convert from big endian byte array to little endian limb array. */
+	for (i = 0; i < (int)limbs; ++i) {
+		const uint8_t *p = inout + (limbs - 1 - i) * 8;
+		uint64_t tmp = 0;
+		for (j = 0; j < 8; ++j)
+			tmp = (tmp << 8) | p[j];
+		a[i] = tmp;
+	}
+
+	/* Convert RR to limbs in aaR; it's not needed again after this. */
+	for (i = 0; i < (int)limbs; ++i)
+		aaR[i] = LIMB64(key->rr, i);
+
+	montMul64(key, n0inv, aR, a, aaR);  /* aR = a * RR / R mod M */
+	if (exp == 3) {
+		montSqr64(key, n0inv, aaR, aR); /* aaR = aR * aR / R mod M */
+		montMul64(key, n0inv, a, aaR, aR); /* a = aaR * aR / R mod M */
+		/* aaa = a * 1 / R mod M */
+		for (i = 0; i < (int)limbs; ++i)
+			aR[i] = 0;
+		aR[0] = 1;
+		montMul64(key, n0inv, aaa, a, aR);
+	} else {
+		/* Exponent 65537 */
+		for (i = 0; i < 16; i+=2) {
+			/* aaR = aR * aR / R mod M */
+			montSqr64(key, n0inv, aaR, aR);
+			/* aR = aaR * aaR / R mod M */
+			montSqr64(key, n0inv, aR, aaR);
+		}
+		montMul64(key, n0inv, aaa, aR, a);  /* aaa = aR * a / R mod M */
+	}
+
+	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
+	if (mont_ge64(key, aaa)) {
+		subM64(key, aaa);
+	}
+
+	/* Convert to bigendian byte array */
+	for (i = (int)limbs - 1; i >= 0; --i) {
+		uint64_t tmp = aaa[i];
+		for (j = 56; j >= 0; j -= 8)
+			*inout++ = (uint8_t)(tmp >> j);
+	}
+}
+#endif  /* VB2_RSA_64BIT_LIMBS */
+
 /**
  * In-place public exponentiation.
  *
@@ -137,31 +450,38 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 		uint32_t *workbuf32, int exp)
 {
 	uint32_t *a = workbuf32;
-	uint32_t *aR = a + key->arrsize;
-	uint32_t *aaR = aR + key->arrsize;
+	uint32_t *aR = a + ARRSIZE(key);
+	uint32_t *aaR = aR + ARRSIZE(key);
 	uint32_t *aaa = aaR;  /* Re-use location. */
 	int i;
 
+#if VB2_RSA_64BIT_LIMBS
+	if (!(ARRSIZE(key) & 1)) {
+		modpow64(key, inout, workbuf32, exp);
+		return;
+	}
+#endif
+
 	/* Convert from big endian byte array to little endian word array. */
-	for (i = 0; i < (int)key->arrsize; ++i) {
+	for (i = 0; i < (int)ARRSIZE(key); ++i) {
 		uint32_t tmp =
-			(inout[((key->arrsize - 1 - i) * 4) + 0] << 24) |
-			(inout[((key->arrsize - 1 - i) * 4) + 1] << 16) |
-			(inout[((key->arrsize - 1 - i) * 4) + 2] << 8) |
-			(inout[((key->arrsize - 1 - i) * 4) + 3] << 0);
+			(inout[((ARRSIZE(key) - 1 - i) * 4) + 0] << 24) |
+			(inout[((ARRSIZE(key) - 1 - i) * 4) + 1] << 16) |
+			(inout[((ARRSIZE(key) - 1 - i) * 4) + 2] << 8) |
+			(inout[((ARRSIZE(key) - 1 - i) * 4) + 3] << 0);
 		a[i] = tmp;
 	}
 
 	montMul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
 	if (exp == 3) {
-		montMul(key, aaR, aR, aR); /* aaR = aR * aR / R mod M */
+		montSqr(key, aaR, aR); /* aaR = aR * aR / R mod M */
 		montMul(key, a, aaR, aR); /* a = aaR * aR / R mod M */
 		montMul1(key, aaa, a); /* aaa = a * 1 / R mod M */
 	} else {
 		/* Exponent 65537 */
 		for (i = 0; i < 16; i+=2) {
-			montMul(key, aaR, aR, aR);  /* aaR = aR * aR / R mod M */
-			montMul(key, aR, aaR, aaR);  /* aR = aaR * aaR / R mod M */
+			montSqr(key, aaR, aR);  /* aaR = aR * aR / R mod M */
+			montSqr(key, aR, aaR);  /* aR = aaR * aaR / R mod M */
 		}
 		montMul(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
 	}
@@ -172,7 +492,7 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 	}
 
 	/* Convert to bigendian byte array */
-	for (i = (int)key->arrsize - 1; i >= 0; --i) {
+	for (i = (int)ARRSIZE(key) - 1; i >= 0; --i) {
 		uint32_t tmp = aaa[i];
 		*inout++ = (uint8_t)(tmp >> 24);
 		*inout++ = (uint8_t)(tmp >> 16);
@@ -391,6 +711,16 @@ int vb2_rsa_verify_digest(const struct vb2_public_key *key,
 		return VB2_ERROR_RSA_VERIFY_ALGORITHM;
 	}
 
+	/* Builds for a single key type can't verify any other type */
+	if (VB2_RSA_FIXED_BITS) {
+		if (sig_size != VB2_RSA_FIXED_BITS / 8 ||
+		    exp != VB2_RSA_FIXED_EXP) {
+			VB2_DEBUG("Signature type not supported by build!\n");
+			return VB2_ERROR_RSA_VERIFY_ALGORITHM;
+		}
+		exp = VB2_RSA_FIXED_EXP;
+	}
+
 	/* Signature length should be same as key length */
 	key_bytes = key->arrsize * sizeof(uint32_t);
 	if (key_bytes != sig_size) {
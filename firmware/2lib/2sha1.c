@@ -9,6 +9,52 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
+
+#if VB2_SHA_ACCEL
+/*
+ * Hash data with the accelerated block transform, if there is one.  Whole
+ * blocks are hashed straight from data; only a partial block at either end
+ * goes through ctx->buf.
+ *
+ * Returns 1 if the data was hashed, or 0 if the caller should use the
+ * portable code.
+ */
+static int sha1_accel_update(struct vb2_sha1_context *ctx,
+			     const uint8_t *data,
+			     uint32_t size)
+{
+	vb2_sha1_transform_fn accel = vb2_sha1_accel_transform();
+	uint8_t *buf = (uint8_t *)&ctx->buf;
+	uint32_t i = ctx->count % VB2_SHA1_BLOCK_SIZE;
+	uint32_t n;
+
+	if (!accel)
+		return 0;
+
+	ctx->count += size;
+
+	if (i) {
+		n = VB2_SHA1_BLOCK_SIZE - i;
+		if (n > size)
+			n = size;
+		memcpy(buf + i, data, n);
+		data += n;
+		size -= n;
+		if (i + n < VB2_SHA1_BLOCK_SIZE)
+			return 1;
+		accel(ctx->state, buf, 1);
+	}
+
+	n = size / VB2_SHA1_BLOCK_SIZE;
+	if (n)
+		accel(ctx->state, data, n);
+	n *= VB2_SHA1_BLOCK_SIZE;
+	memcpy(buf, data + n, size - n);
+
+	return 1;
+}
+#endif
 
 /*
  * Some machines lack byteswap.h and endian.h. These have to use the
@@ -141,6 +187,11 @@ void vb2_sha1_update(struct vb2_sha1_context *ctx,
 	int i = ctx->count % sizeof(ctx->buf);
 	const uint8_t *p = (const uint8_t*)data;
 
+#if VB2_SHA_ACCEL
+	if (sha1_accel_update(ctx, data, size))
+		return;
+#endif
+
 	ctx->count += size;
 
 	while (size > sizeof(ctx->buf) - i) {
@@ -245,6 +296,11 @@ void vb2_sha1_update(struct vb2_sha1_context *ctx,
 	int i = (int)(ctx->count % sizeof(ctx->buf));
 	const uint8_t* p = (const uint8_t*) data;
 
+#if VB2_SHA_ACCEL
+	if (sha1_accel_update(ctx, data, size))
+		return;
+#endif
+
 	ctx->count += size;
 
 	while (size--) {
@@ -38,6 +38,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #define SHFR(x, n)    (x >> n)
 #define ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -77,7 +78,7 @@
 #define SHA256_EXP(a, b, c, d, e, f, g, h, j)				\
 	{								\
 		t1 = wv[h] + SHA256_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha256_k[j] + w[j];				\
+			+ vb2_sha256_k[j] + w[j];			\
 		t2 = SHA256_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -88,7 +89,7 @@ static const uint32_t sha256_h0[8] = {
 	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
 };
 
-static const uint32_t sha256_k[64] = {
+const uint32_t vb2_sha256_k[64] = {
 	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
 	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -130,6 +131,15 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 				 const uint8_t *message,
 				 unsigned int block_nb)
 {
+#if VB2_SHA_ACCEL
+	vb2_sha256_transform_fn accel = vb2_sha256_accel_transform();
+
+	if (accel) {
+		accel(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+
 	/* Note that these arrays use 72*4=288 bytes of stack */
 	uint32_t w[64];
 	uint32_t wv[8];
@@ -159,7 +169,7 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 
 		for (j = 0; j < 64; j++) {
 			t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha256_k[j] + w[j];
+				+ vb2_sha256_k[j] + w[j];
 			t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -243,39 +253,37 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 	}
 }
 
-void vb2_sha256_update(struct vb2_sha256_context *ctx,
-		       const uint8_t *data,
+void vb2_sha256_update(struct vb2_sha256_context *restrict ctx,
+		       const uint8_t *restrict data,
 		       uint32_t size)
 {
-	unsigned int block_nb;
-	unsigned int new_size, rem_size, tmp_size;
-	const uint8_t *shifted_data;
-
-	tmp_size = VB2_SHA256_BLOCK_SIZE - ctx->size;
-	rem_size = size < tmp_size ? size : tmp_size;
-
-	memcpy(&ctx->block[ctx->size], data, rem_size);
-
-	if (ctx->size + size < VB2_SHA256_BLOCK_SIZE) {
-		ctx->size += size;
-		return;
+	unsigned int block_nb, fill;
+
+	/* Top up a partial block left over from the last call */
+	if (ctx->size) {
+		fill = VB2_SHA256_BLOCK_SIZE - ctx->size;
+		if (size < fill) {
+			memcpy(&ctx->block[ctx->size], data, size);
+			ctx->size += size;
+			return;
+		}
+		memcpy(&ctx->block[ctx->size], data, fill);
+		vb2_sha256_transform(ctx, ctx->block, 1);
+		ctx->total_size += VB2_SHA256_BLOCK_SIZE;
+		data += fill;
+		size -= fill;
 	}
 
-	new_size = size - rem_size;
-	block_nb = new_size / VB2_SHA256_BLOCK_SIZE;
-
-	shifted_data = data + rem_size;
-
-	vb2_sha256_transform(ctx, ctx->block, 1);
-	vb2_sha256_transform(ctx, shifted_data, block_nb);
-
-	rem_size = new_size % VB2_SHA256_BLOCK_SIZE;
-
-	memcpy(ctx->block, &shifted_data[block_nb << 6],
-	       rem_size);
+	/* Whole blocks are hashed where they are, without staging */
+	block_nb = size / VB2_SHA256_BLOCK_SIZE;
+	if (block_nb) {
+		vb2_sha256_transform(ctx, data, block_nb);
+		ctx->total_size += block_nb << 6;
+	}
 
-	ctx->size = rem_size;
-	ctx->total_size += (block_nb + 1) << 6;
+	/* Keep the rest for next time */
+	ctx->size = size % VB2_SHA256_BLOCK_SIZE;
+	memcpy(ctx->block, &data[block_nb << 6], ctx->size);
 }
 
 void vb2_sha256_finalize(struct vb2_sha256_context *ctx, uint8_t *digest)
@@ -38,6 +38,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #define SHFR(x, n)    (x >> n)
 #define ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -93,7 +94,7 @@
 #define SHA512_EXP(a, b, c, d, e, f, g ,h, j)				\
 	{								\
 		t1 = wv[h] + SHA512_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha512_k[j] + w[j];				\
+			+ vb2_sha512_k[j] + w[j];			\
 		t2 = SHA512_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -106,7 +107,7 @@ static const uint64_t sha512_h0[8] = {
 	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
 };
 
-static const uint64_t sha512_k[80] = {
+const uint64_t vb2_sha512_k[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
 	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
 	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -180,6 +181,15 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 	const uint8_t *sub_block;
 	int i, j;
 
+#if VB2_SHA_ACCEL
+	vb2_sha512_transform_fn accel = vb2_sha512_accel_transform();
+
+	if (accel) {
+		accel(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+
 	for (i = 0; i < (int) block_nb; i++) {
 		sub_block = message + (i << 7);
 
@@ -255,7 +265,7 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 
 		for (j = 0; j < 80; j++) {
 			t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha512_k[j] + w[j];
+				+ vb2_sha512_k[j] + w[j];
 			t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -273,39 +283,37 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 	}
 }
 
-void vb2_sha512_update(struct vb2_sha512_context *ctx,
-		       const uint8_t *data,
+void vb2_sha512_update(struct vb2_sha512_context *restrict ctx,
+		       const uint8_t *restrict data,
 		       uint32_t size)
 {
-	unsigned int block_nb;
-	unsigned int new_size, rem_size, tmp_size;
-	const uint8_t *shifted_data;
-
-	tmp_size = VB2_SHA512_BLOCK_SIZE - ctx->size;
-	rem_size = size < tmp_size ? size : tmp_size;
-
-	memcpy(&ctx->block[ctx->size], data, rem_size);
-
-	if (ctx->size + size < VB2_SHA512_BLOCK_SIZE) {
-		ctx->size += size;
-		return;
+	unsigned int block_nb, fill;
+
+	/* Top up a partial block left over from the last call */
+	if (ctx->size) {
+		fill = VB2_SHA512_BLOCK_SIZE - ctx->size;
+		if (size < fill) {
+			memcpy(&ctx->block[ctx->size], data, size);
+			ctx->size += size;
+			return;
+		}
+		memcpy(&ctx->block[ctx->size], data, fill);
+		vb2_sha512_transform(ctx, ctx->block, 1);
+		ctx->total_size += VB2_SHA512_BLOCK_SIZE;
+		data += fill;
+		size -= fill;
 	}
 
-	new_size = size - rem_size;
-	block_nb = new_size / VB2_SHA512_BLOCK_SIZE;
-
-	shifted_data = data + rem_size;
-
-	vb2_sha512_transform(ctx, ctx->block, 1);
-	vb2_sha512_transform(ctx, shifted_data, block_nb);
-
-	rem_size = new_size % VB2_SHA512_BLOCK_SIZE;
-
-	memcpy(ctx->block, &shifted_data[block_nb << 7],
-	       rem_size);
+	/* Whole blocks are hashed where they are, without staging */
+	block_nb = size / VB2_SHA512_BLOCK_SIZE;
+	if (block_nb) {
+		vb2_sha512_transform(ctx, data, block_nb);
+		ctx->total_size += block_nb << 7;
+	}
 
-	ctx->size = rem_size;
-	ctx->total_size += (block_nb + 1) << 7;
+	/* Keep the rest for next time */
+	ctx->size = size % VB2_SHA512_BLOCK_SIZE;
+	memcpy(ctx->block, &data[block_nb << 7], ctx->size);
 }
 
 void vb2_sha512_finalize(struct vb2_sha512_context *ctx, uint8_t *digest)
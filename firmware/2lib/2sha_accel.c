@@ -0,0 +1,1192 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CPU-accelerated SHA block transforms for host builds.  Each algorithm has a
+ * table of implementations, fastest first; the first one supported by the
+ * CPU we're running on is used.  Every table ends with the portable code in
+ * 2sha1.c / 2sha256.c / 2sha512.c, which is always supported.
+ *
+ * This file is only built for the host, so it may include system headers
+ * directly.
+ *
+ * SHA-256 also has multi-buffer code for vb2_digest_buffers(), which hashes
+ * independent buffers side by side in the lanes of a vector register.
+ *
+ * The aarch64 code hasn't been run on hardware yet, so it is only built when
+ * asked for (make USE_ARMV8_ACCEL=1); otherwise aarch64 uses the portable
+ * code.
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA_X86 1
+#ifdef __x86_64__
+/* Multi-buffer gathers address lanes with 64-bit offsets */
+#define SHA_MULTI_X86 1
+#endif
+#elif defined(__aarch64__) && defined(__linux__) && VB2_SHA_ACCEL_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define SHA_ARMV8 1
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+#define PORTABLE_NAME "portable"
+
+struct sha1_impl {
+	const char *name;
+	int (*supported)(void);
+	/* NULL for the portable code */
+	vb2_sha1_transform_fn transform;
+};
+
+struct sha256_impl {
+	const char *name;
+	int (*supported)(void);
+	/* NULL for the portable code */
+	vb2_sha256_transform_fn transform;
+};
+
+struct sha512_impl {
+	const char *name;
+	int (*supported)(void);
+	/* NULL for the portable code */
+	vb2_sha512_transform_fn transform;
+};
+
+/* Set by vb2_sha_accel_enable() */
+static int accel_enabled = 1;
+
+/* Implementations in use; NULL until the CPU has been probed */
+static const struct sha1_impl *sha1_cur;
+static const struct sha256_impl *sha256_cur;
+static const struct sha512_impl *sha512_cur;
+
+static int always_supported(void)
+{
+	return 1;
+}
+
+#ifdef SHA_X86
+
+static uint64_t read_xcr0(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * Check CPUID.1:ECX and CPUID.(EAX=7,ECX=0):EBX feature bits.  If xcr0_mask
+ * is non-zero, also check that the OS saves those register states.
+ */
+static int cpu_has(uint32_t ecx1_bits, uint32_t ebx7_bits, uint64_t xcr0_mask)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	if ((ecx & ecx1_bits) != ecx1_bits)
+		return 0;
+
+	if (xcr0_mask) {
+		if (!(ecx & bit_OSXSAVE))
+			return 0;
+		if ((read_xcr0() & xcr0_mask) != xcr0_mask)
+			return 0;
+	}
+
+	if (!ebx7_bits)
+		return 1;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & ebx7_bits) == ebx7_bits;
+}
+
+/* CPUID.(EAX=7,ECX=0):EBX bits; older cpuid.h doesn't name all of them */
+#define CPUID7_AVX2	(1U << 5)
+#define CPUID7_AVX512F	(1U << 16)
+#define CPUID7_SHA	(1U << 29)
+#define CPUID7_AVX512BW	(1U << 30)
+#define CPUID7_AVX512VL	(1U << 31)
+
+/* XCR0 bits: SSE, AVX, and AVX-512 opmask/ZMM state */
+#define XCR0_AVX	0x06
+#define XCR0_AVX512	0xe6
+
+/*
+ * Four rounds of SHA-256 using the SHA extensions.  cur holds message words
+ * for these rounds.  For rounds 12-55 this also computes the message words
+ * four groups ahead: prev is the group before cur (and is updated with
+ * sha256msg1), and next is the group after cur (finished with sha256msg2).
+ */
+#define SHANI_QROUND(g, cur, next, prev)				\
+	do {								\
+		msg = _mm_add_epi32(cur, _mm_loadu_si128(		\
+			(const __m128i *)&vb2_sha256_k[4 * (g)]));	\
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);	\
+		if ((g) >= 3 && (g) <= 14) {				\
+			tmp = _mm_alignr_epi8(cur, prev, 4);		\
+			next = _mm_add_epi32(next, tmp);		\
+			next = _mm_sha256msg2_epu32(next, cur);		\
+		}							\
+		msg = _mm_shuffle_epi32(msg, 0x0e);			\
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);	\
+		if ((g) >= 1 && (g) <= 12)				\
+			prev = _mm_sha256msg1_epu32(prev, cur);		\
+	} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_transform_shani(uint32_t *h,
+				   const uint8_t *data,
+				   uint32_t block_nb)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh;
+	__m128i msg, tmp, m0, m1, m2, m3;
+
+	/* The SHA instructions want the state as ABEF and CDGH */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xb1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]),
+				   0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	for (; block_nb; block_nb--, data += VB2_SHA256_BLOCK_SIZE) {
+		abef = state0;
+		cdgh = state1;
+
+		m0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 0)), bswap);
+		m1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 16)), bswap);
+		m2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 32)), bswap);
+		m3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 48)), bswap);
+
+		SHANI_QROUND(0, m0, m1, m3);
+		SHANI_QROUND(1, m1, m2, m0);
+		SHANI_QROUND(2, m2, m3, m1);
+		SHANI_QROUND(3, m3, m0, m2);
+		SHANI_QROUND(4, m0, m1, m3);
+		SHANI_QROUND(5, m1, m2, m0);
+		SHANI_QROUND(6, m2, m3, m1);
+		SHANI_QROUND(7, m3, m0, m2);
+		SHANI_QROUND(8, m0, m1, m3);
+		SHANI_QROUND(9, m1, m2, m0);
+		SHANI_QROUND(10, m2, m3, m1);
+		SHANI_QROUND(11, m3, m0, m2);
+		SHANI_QROUND(12, m0, m1, m3);
+		SHANI_QROUND(13, m1, m2, m0);
+		SHANI_QROUND(14, m2, m3, m1);
+		SHANI_QROUND(15, m3, m0, m2);
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	/* Back to ABCD and EFGH */
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)&h[0], state0);
+	_mm_storeu_si128((__m128i *)&h[4], state1);
+}
+
+/*
+ * Four rounds of SHA-1 using the SHA extensions.  cur holds message words
+ * for these rounds, and e_cur the E value they start from (which is updated
+ * from the previous rounds with sha1nexte); e_next is left with the state
+ * the next rounds need E from.  The message words four groups ahead are
+ * computed along the way: prev and prev2 are the groups one and two before
+ * cur, and next is the group after it.
+ */
+#define SHANI_SHA1_QROUND(g, e_cur, e_next, cur, next, prev, prev2)	\
+	do {								\
+		if ((g) == 0)						\
+			e_cur = _mm_add_epi32(e_cur, cur);		\
+		else							\
+			e_cur = _mm_sha1nexte_epu32(e_cur, cur);	\
+		e_next = abcd;						\
+		if ((g) >= 3 && (g) <= 18)				\
+			next = _mm_sha1msg2_epu32(next, cur);		\
+		abcd = _mm_sha1rnds4_epu32(abcd, e_cur, (g) / 5);	\
+		if ((g) >= 1 && (g) <= 16)				\
+			prev = _mm_sha1msg1_epu32(prev, cur);		\
+		if ((g) >= 2 && (g) <= 17)				\
+			prev2 = _mm_xor_si128(prev2, cur);		\
+	} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_transform_shani(uint32_t *h,
+				 const uint8_t *data,
+				 uint32_t block_nb)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+					     0x08090a0b0c0d0e0fULL);
+	__m128i abcd, e0, e1, abcd_save, e_save, m0, m1, m2, m3;
+
+	/* The SHA instructions want A in the top lane, and E above D */
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0x1b);
+	e0 = _mm_set_epi32(h[4], 0, 0, 0);
+
+	for (; block_nb; block_nb--, data += VB2_SHA1_BLOCK_SIZE) {
+		abcd_save = abcd;
+		e_save = e0;
+
+		m0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 0)), bswap);
+		m1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 16)), bswap);
+		m2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 32)), bswap);
+		m3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 48)), bswap);
+
+		SHANI_SHA1_QROUND(0, e0, e1, m0, m1, m3, m2);
+		SHANI_SHA1_QROUND(1, e1, e0, m1, m2, m0, m3);
+		SHANI_SHA1_QROUND(2, e0, e1, m2, m3, m1, m0);
+		SHANI_SHA1_QROUND(3, e1, e0, m3, m0, m2, m1);
+		SHANI_SHA1_QROUND(4, e0, e1, m0, m1, m3, m2);
+		SHANI_SHA1_QROUND(5, e1, e0, m1, m2, m0, m3);
+		SHANI_SHA1_QROUND(6, e0, e1, m2, m3, m1, m0);
+		SHANI_SHA1_QROUND(7, e1, e0, m3, m0, m2, m1);
+		SHANI_SHA1_QROUND(8, e0, e1, m0, m1, m3, m2);
+		SHANI_SHA1_QROUND(9, e1, e0, m1, m2, m0, m3);
+		SHANI_SHA1_QROUND(10, e0, e1, m2, m3, m1, m0);
+		SHANI_SHA1_QROUND(11, e1, e0, m3, m0, m2, m1);
+		SHANI_SHA1_QROUND(12, e0, e1, m0, m1, m3, m2);
+		SHANI_SHA1_QROUND(13, e1, e0, m1, m2, m0, m3);
+		SHANI_SHA1_QROUND(14, e0, e1, m2, m3, m1, m0);
+		SHANI_SHA1_QROUND(15, e1, e0, m3, m0, m2, m1);
+		SHANI_SHA1_QROUND(16, e0, e1, m0, m1, m3, m2);
+		SHANI_SHA1_QROUND(17, e1, e0, m1, m2, m0, m3);
+		SHANI_SHA1_QROUND(18, e0, e1, m2, m3, m1, m0);
+		SHANI_SHA1_QROUND(19, e1, e0, m3, m0, m2, m1);
+
+		e0 = _mm_sha1nexte_epu32(e0, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)h, _mm_shuffle_epi32(abcd, 0x1b));
+	h[4] = _mm_extract_epi32(e0, 3);
+}
+
+static int cpu_has_shani(void)
+{
+	return cpu_has(bit_SSSE3 | bit_SSE4_1, CPUID7_SHA, 0);
+}
+
+static int cpu_has_avx2(void)
+{
+	return cpu_has(bit_AVX, CPUID7_AVX2, XCR0_AVX);
+}
+
+static int cpu_has_avx512(void)
+{
+	return cpu_has(bit_AVX, CPUID7_AVX2 | CPUID7_AVX512F | CPUID7_AVX512VL,
+		       XCR0_AVX512);
+}
+
+static int cpu_has_avx512bw(void)
+{
+	return cpu_has(bit_AVX, CPUID7_AVX2 | CPUID7_AVX512F | CPUID7_AVX512BW,
+		       XCR0_AVX512);
+}
+
+#endif  /* SHA_X86 */
+
+#ifdef SHA_ARMV8
+
+/*
+ * Four rounds of SHA-256 using the ARMv8 crypto extensions.  For rounds 0-47
+ * this also replaces cur with the message words four groups ahead, computed
+ * from cur and the three groups following it (w1, w2, w3).
+ */
+#define ARMV8_QROUND(g, cur, w1, w2, w3)				\
+	do {								\
+		wk = vaddq_u32(cur, vld1q_u32(&vb2_sha256_k[4 * (g)]));	\
+		if ((g) < 12)						\
+			cur = vsha256su1q_u32(vsha256su0q_u32(cur, w1),	\
+					      w2, w3);			\
+		tmp = state0;						\
+		state0 = vsha256hq_u32(state0, state1, wk);		\
+		state1 = vsha256h2q_u32(state1, tmp, wk);		\
+	} while (0)
+
+__attribute__((target("arch=armv8-a+crypto")))
+static void sha256_transform_armv8(uint32_t *h,
+				   const uint8_t *data,
+				   uint32_t block_nb)
+{
+	uint32x4_t state0 = vld1q_u32(&h[0]);
+	uint32x4_t state1 = vld1q_u32(&h[4]);
+	uint32x4_t abcd, efgh, wk, tmp, m0, m1, m2, m3;
+
+	for (; block_nb; block_nb--, data += VB2_SHA256_BLOCK_SIZE) {
+		abcd = state0;
+		efgh = state1;
+
+		m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0)));
+		m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+		m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+		m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+		ARMV8_QROUND(0, m0, m1, m2, m3);
+		ARMV8_QROUND(1, m1, m2, m3, m0);
+		ARMV8_QROUND(2, m2, m3, m0, m1);
+		ARMV8_QROUND(3, m3, m0, m1, m2);
+		ARMV8_QROUND(4, m0, m1, m2, m3);
+		ARMV8_QROUND(5, m1, m2, m3, m0);
+		ARMV8_QROUND(6, m2, m3, m0, m1);
+		ARMV8_QROUND(7, m3, m0, m1, m2);
+		ARMV8_QROUND(8, m0, m1, m2, m3);
+		ARMV8_QROUND(9, m1, m2, m3, m0);
+		ARMV8_QROUND(10, m2, m3, m0, m1);
+		ARMV8_QROUND(11, m3, m0, m1, m2);
+		ARMV8_QROUND(12, m0, m1, m2, m3);
+		ARMV8_QROUND(13, m1, m2, m3, m0);
+		ARMV8_QROUND(14, m2, m3, m0, m1);
+		ARMV8_QROUND(15, m3, m0, m1, m2);
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+	}
+
+	vst1q_u32(&h[0], state0);
+	vst1q_u32(&h[4], state1);
+}
+
+static int cpu_has_armv8_sha2(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+
+static const uint32_t sha1_k[4] = {
+	0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+};
+
+/*
+ * Four rounds of SHA-1 using the ARMv8 crypto extensions, with round
+ * function f.  For rounds 0-63 this also replaces cur with the message words
+ * four groups ahead, like ARMV8_QROUND().
+ */
+#define ARMV8_SHA1_QROUND(g, f, cur, w1, w2, w3)			\
+	do {								\
+		wk = vaddq_u32(cur, vdupq_n_u32(sha1_k[(g) / 5]));	\
+		if ((g) < 16)						\
+			cur = vsha1su1q_u32(vsha1su0q_u32(cur, w1, w2),	\
+					    w3);			\
+		e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));		\
+		abcd = f(abcd, e, wk);					\
+		e = e_next;						\
+	} while (0)
+
+__attribute__((target("arch=armv8-a+crypto")))
+static void sha1_transform_armv8(uint32_t *h,
+				 const uint8_t *data,
+				 uint32_t block_nb)
+{
+	uint32x4_t abcd = vld1q_u32(&h[0]);
+	uint32_t e = h[4];
+	uint32x4_t abcd_save, wk, m0, m1, m2, m3;
+	uint32_t e_save, e_next;
+
+	for (; block_nb; block_nb--, data += VB2_SHA1_BLOCK_SIZE) {
+		abcd_save = abcd;
+		e_save = e;
+
+		m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0)));
+		m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+		m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+		m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+		ARMV8_SHA1_QROUND(0, vsha1cq_u32, m0, m1, m2, m3);
+		ARMV8_SHA1_QROUND(1, vsha1cq_u32, m1, m2, m3, m0);
+		ARMV8_SHA1_QROUND(2, vsha1cq_u32, m2, m3, m0, m1);
+		ARMV8_SHA1_QROUND(3, vsha1cq_u32, m3, m0, m1, m2);
+		ARMV8_SHA1_QROUND(4, vsha1cq_u32, m0, m1, m2, m3);
+		ARMV8_SHA1_QROUND(5, vsha1pq_u32, m1, m2, m3, m0);
+		ARMV8_SHA1_QROUND(6, vsha1pq_u32, m2, m3, m0, m1);
+		ARMV8_SHA1_QROUND(7, vsha1pq_u32, m3, m0, m1, m2);
+		ARMV8_SHA1_QROUND(8, vsha1pq_u32, m0, m1, m2, m3);
+		ARMV8_SHA1_QROUND(9, vsha1pq_u32, m1, m2, m3, m0);
+		ARMV8_SHA1_QROUND(10, vsha1mq_u32, m2, m3, m0, m1);
+		ARMV8_SHA1_QROUND(11, vsha1mq_u32, m3, m0, m1, m2);
+		ARMV8_SHA1_QROUND(12, vsha1mq_u32, m0, m1, m2, m3);
+		ARMV8_SHA1_QROUND(13, vsha1mq_u32, m1, m2, m3, m0);
+		ARMV8_SHA1_QROUND(14, vsha1mq_u32, m2, m3, m0, m1);
+		ARMV8_SHA1_QROUND(15, vsha1pq_u32, m3, m0, m1, m2);
+		ARMV8_SHA1_QROUND(16, vsha1pq_u32, m0, m1, m2, m3);
+		ARMV8_SHA1_QROUND(17, vsha1pq_u32, m1, m2, m3, m0);
+		ARMV8_SHA1_QROUND(18, vsha1pq_u32, m2, m3, m0, m1);
+		ARMV8_SHA1_QROUND(19, vsha1pq_u32, m3, m0, m1, m2);
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		e += e_save;
+	}
+
+	vst1q_u32(&h[0], abcd);
+	h[4] = e;
+}
+
+static int cpu_has_armv8_sha1(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA1);
+}
+
+#endif  /* SHA_ARMV8 */
+
+/*
+ * SHA-512 with a vectorized message schedule.  The rounds themselves are
+ * inherently serial, so they share the scalar code below; what the vector
+ * units buy us is computing W[16..79] (and adding the round constants) several
+ * words at a time.
+ */
+
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, j)				\
+	do {								\
+		t1 = wv[h] + (ROR64(wv[e], 14) ^ ROR64(wv[e], 18) ^	\
+			      ROR64(wv[e], 41)) +			\
+			((wv[e] & wv[f]) ^ (~wv[e] & wv[g])) + wk[j];	\
+		t2 = (ROR64(wv[a], 28) ^ ROR64(wv[a], 34) ^		\
+		      ROR64(wv[a], 39)) +				\
+			((wv[a] & wv[b]) ^ (wv[a] & wv[c]) ^		\
+			 (wv[b] & wv[c]));				\
+		wv[d] += t1;						\
+		wv[h] = t1 + t2;					\
+	} while (0)
+
+/* 80 rounds of SHA-512, given message words with round constants added */
+static void sha512_rounds(uint64_t *h, const uint64_t *wk)
+{
+	uint64_t wv[8];
+	uint64_t t1, t2;
+	int j;
+
+	memcpy(wv, h, sizeof(wv));
+
+	for (j = 0; j < 80; j += 8) {
+		SHA512_ROUND(0, 1, 2, 3, 4, 5, 6, 7, j + 0);
+		SHA512_ROUND(7, 0, 1, 2, 3, 4, 5, 6, j + 1);
+		SHA512_ROUND(6, 7, 0, 1, 2, 3, 4, 5, j + 2);
+		SHA512_ROUND(5, 6, 7, 0, 1, 2, 3, 4, j + 3);
+		SHA512_ROUND(4, 5, 6, 7, 0, 1, 2, 3, j + 4);
+		SHA512_ROUND(3, 4, 5, 6, 7, 0, 1, 2, j + 5);
+		SHA512_ROUND(2, 3, 4, 5, 6, 7, 0, 1, j + 6);
+		SHA512_ROUND(1, 2, 3, 4, 5, 6, 7, 0, j + 7);
+	}
+
+	for (j = 0; j < 8; j++)
+		h[j] += wv[j];
+}
+
+#ifdef SHA_X86
+
+#define ROR128_SSE(x, n) \
+	_mm_or_si128(_mm_srli_epi64(x, n), _mm_slli_epi64(x, 64 - (n)))
+#define ROR256_AVX2(x, n) \
+	_mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define ROR128_AVX512(x, n) _mm_ror_epi64(x, n)
+#define ROR256_AVX512(x, n) _mm256_ror_epi64(x, n)
+
+/*
+ * Define an x86 SHA-512 transform.  Each step produces W[t..t+3]: the
+ * sigma0, W[t-7] and W[t-16] terms only depend on older words, so they're
+ * done 4 at a time.  sigma1 depends on W[t-2], so it's done for W[t..t+1]
+ * first and then for W[t+2..t+3].
+ */
+#define DEFINE_SHA512_X86(name, target_features, ROR128, ROR256)		\
+__attribute__((target(target_features)))					\
+static void name(uint64_t *h, const uint8_t *data, uint32_t block_nb)		\
+{										\
+	const __m256i bswap = _mm256_set_epi64x(				\
+		0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL,			\
+		0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL);			\
+	uint64_t w[80] __attribute__((aligned(32)));				\
+	uint64_t wk[80] __attribute__((aligned(32)));				\
+	__m256i x, s0;								\
+	__m128i lo, hi;								\
+	int t;									\
+										\
+	for (; block_nb; block_nb--, data += VB2_SHA512_BLOCK_SIZE) {		\
+		for (t = 0; t < 16; t += 4) {					\
+			x = _mm256_loadu_si256((const __m256i *)(data + 8 * t));\
+			x = _mm256_shuffle_epi8(x, bswap);			\
+			_mm256_store_si256((__m256i *)&w[t], x);		\
+		}								\
+										\
+		for (t = 16; t < 80; t += 4) {					\
+			x = _mm256_loadu_si256((const __m256i *)&w[t - 15]);	\
+			s0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(x, 1),	\
+							       ROR256(x, 8)),	\
+					      _mm256_srli_epi64(x, 7));		\
+			x = _mm256_add_epi64(					\
+				_mm256_load_si256((const __m256i *)&w[t - 16]),	\
+				_mm256_loadu_si256(				\
+					(const __m256i *)&w[t - 7]));		\
+			x = _mm256_add_epi64(x, s0);				\
+										\
+			lo = _mm_load_si128((const __m128i *)&w[t - 2]);	\
+			lo = _mm_xor_si128(_mm_xor_si128(ROR128(lo, 19),	\
+							 ROR128(lo, 61)),	\
+					   _mm_srli_epi64(lo, 6));		\
+			lo = _mm_add_epi64(lo, _mm256_castsi256_si128(x));	\
+			_mm_store_si128((__m128i *)&w[t], lo);			\
+										\
+			hi = _mm_xor_si128(_mm_xor_si128(ROR128(lo, 19),	\
+							 ROR128(lo, 61)),	\
+					   _mm_srli_epi64(lo, 6));		\
+			hi = _mm_add_epi64(hi, _mm256_extracti128_si256(x, 1));	\
+			_mm_store_si128((__m128i *)&w[t + 2], hi);		\
+		}								\
+										\
+		for (t = 0; t < 80; t += 4) {					\
+			x = _mm256_add_epi64(					\
+				_mm256_load_si256((const __m256i *)&w[t]),	\
+				_mm256_loadu_si256(				\
+					(const __m256i *)&vb2_sha512_k[t]));	\
+			_mm256_store_si256((__m256i *)&wk[t], x);		\
+		}								\
+										\
+		sha512_rounds(h, wk);						\
+	}									\
+}
+
+DEFINE_SHA512_X86(sha512_transform_avx2, "avx2", ROR128_SSE, ROR256_AVX2)
+DEFINE_SHA512_X86(sha512_transform_avx512, "avx2,avx512f,avx512vl",
+		  ROR128_AVX512, ROR256_AVX512)
+
+#endif  /* SHA_X86 */
+
+#ifdef SHA_ARMV8
+
+#define ROR128_NEON(x, n) vsriq_n_u64(vshlq_n_u64(x, 64 - (n)), x, n)
+
+/*
+ * NEON is always present on aarch64.  The schedule produces W[t..t+1] per
+ * step, since sigma1 of W[t-2] is needed for W[t].
+ */
+static void sha512_transform_neon(uint64_t *h,
+				  const uint8_t *data,
+				  uint32_t block_nb)
+{
+	uint64_t w[80];
+	uint64_t wk[80];
+	uint64x2_t x, s0, s1;
+	int t;
+
+	for (; block_nb; block_nb--, data += VB2_SHA512_BLOCK_SIZE) {
+		for (t = 0; t < 16; t += 2) {
+			x = vreinterpretq_u64_u8(vrev64q_u8(
+					vld1q_u8(data + 8 * t)));
+			vst1q_u64(&w[t], x);
+		}
+
+		for (t = 16; t < 80; t += 2) {
+			x = vld1q_u64(&w[t - 15]);
+			s0 = veorq_u64(veorq_u64(ROR128_NEON(x, 1),
+						 ROR128_NEON(x, 8)),
+				       vshrq_n_u64(x, 7));
+			x = vld1q_u64(&w[t - 2]);
+			s1 = veorq_u64(veorq_u64(ROR128_NEON(x, 19),
+						 ROR128_NEON(x, 61)),
+				       vshrq_n_u64(x, 6));
+			x = vaddq_u64(vld1q_u64(&w[t - 16]),
+				      vld1q_u64(&w[t - 7]));
+			x = vaddq_u64(x, vaddq_u64(s0, s1));
+			vst1q_u64(&w[t], x);
+		}
+
+		for (t = 0; t < 80; t += 2)
+			vst1q_u64(&wk[t], vaddq_u64(vld1q_u64(&w[t]),
+						    vld1q_u64(&vb2_sha512_k[t])));
+
+		sha512_rounds(h, wk);
+	}
+}
+
+#endif  /* SHA_ARMV8 */
+
+/*
+ * Multi-buffer SHA-256.  One SHA-256 stream can't be split up, but
+ * independent buffers can be hashed side by side, one per 32-bit lane of a
+ * vector register.  The state is kept transposed, h[word][lane], so word i of
+ * every lane loads as one vector.
+ */
+
+#define SHA256_MULTI_MAX_LANES 16
+
+/*
+ * Hash block_nb blocks in every lane; data[lane] points to that lane's
+ * blocks.  Lanes which aren't in use must still point to readable blocks.
+ */
+typedef void (*sha256_multi_fn)(uint32_t h[8][SHA256_MULTI_MAX_LANES],
+				const uint8_t *const *data,
+				uint32_t block_nb);
+
+struct sha256_multi_impl {
+	const char *name;
+	int (*supported)(void);
+	/* Buffers hashed side by side */
+	int lanes;
+	/* Faster than the SHA extensions, so worth using when they're there */
+	int beats_sha_ext;
+	/* NULL for the portable code, which hashes one buffer at a time */
+	sha256_multi_fn transform;
+};
+
+/* Multi-buffer implementation in use; NULL until the CPU has been probed */
+static const struct sha256_multi_impl *sha256_multi_cur;
+
+#ifdef SHA_MULTI_X86
+
+/*
+ * 64 rounds of SHA-256 on the working variables a..hh, computing the message
+ * schedule in w[16] as it goes, with the vector operations given.
+ */
+#define SHA256_MULTI_ROUNDS(ADD, XOR3, ROR, SHR, CH, MAJ, SET1)		\
+	for (t = 0; t < 64; t++) {					\
+		if (t >= 16) {						\
+			x = w[(t - 15) & 15];				\
+			y = w[(t - 2) & 15];				\
+			x = XOR3(ROR(x, 7), ROR(x, 18), SHR(x, 3));	\
+			y = XOR3(ROR(y, 17), ROR(y, 19), SHR(y, 10));	\
+			w[t & 15] = ADD(ADD(w[t & 15], w[(t - 7) & 15]),\
+					ADD(x, y));			\
+		}							\
+		t1 = ADD(ADD(hh, XOR3(ROR(e, 6), ROR(e, 11),		\
+				      ROR(e, 25))),			\
+			 ADD(CH(e, f, g),				\
+			     ADD(SET1(vb2_sha256_k[t]), w[t & 15])));	\
+		t2 = ADD(XOR3(ROR(a, 2), ROR(a, 13), ROR(a, 22)),	\
+			 MAJ(a, b, c));					\
+		hh = g;							\
+		g = f;							\
+		f = e;							\
+		e = ADD(d, t1);						\
+		d = c;							\
+		c = b;							\
+		b = a;							\
+		a = ADD(t1, t2);					\
+	}
+
+#define ADD_AVX2(x, y) _mm256_add_epi32(x, y)
+#define XOR3_AVX2(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define ROR_AVX2(x, n) \
+	_mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define CH_AVX2(x, y, z) \
+	_mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+#define MAJ_AVX2(x, y, z) _mm256_xor_si256(_mm256_and_si256(x, y),	\
+	_mm256_and_si256(z, _mm256_xor_si256(x, y)))
+
+__attribute__((target("avx2")))
+static void sha256_multi_avx2(uint32_t h[8][SHA256_MULTI_MAX_LANES],
+			      const uint8_t *const *data,
+			      uint32_t block_nb)
+{
+	const __m256i bswap = _mm256_set_epi64x(
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	const uint8_t *base = data[0];
+	__m256i off_lo, off_hi;
+	__m256i s[8], w[16];
+	__m256i a, b, c, d, e, f, g, hh, t1, t2, x, y;
+	int i, t;
+
+	/* Each gather fetches a word from 4 lanes, relative to lane 0 */
+	off_lo = _mm256_set_epi64x(data[3] - base, data[2] - base,
+				   data[1] - base, 0);
+	off_hi = _mm256_set_epi64x(data[7] - base, data[6] - base,
+				   data[5] - base, data[4] - base);
+
+	for (i = 0; i < 8; i++)
+		s[i] = _mm256_loadu_si256((const __m256i *)h[i]);
+
+	for (; block_nb; block_nb--, base += VB2_SHA256_BLOCK_SIZE) {
+		for (t = 0; t < 16; t++) {
+			const int *p = (const int *)(base + 4 * t);
+
+			w[t] = _mm256_shuffle_epi8(_mm256_set_m128i(
+				_mm256_i64gather_epi32(p, off_hi, 1),
+				_mm256_i64gather_epi32(p, off_lo, 1)), bswap);
+		}
+
+		a = s[0];
+		b = s[1];
+		c = s[2];
+		d = s[3];
+		e = s[4];
+		f = s[5];
+		g = s[6];
+		hh = s[7];
+
+		SHA256_MULTI_ROUNDS(ADD_AVX2, XOR3_AVX2, ROR_AVX2,
+				    _mm256_srli_epi32, CH_AVX2, MAJ_AVX2,
+				    _mm256_set1_epi32);
+
+		s[0] = _mm256_add_epi32(s[0], a);
+		s[1] = _mm256_add_epi32(s[1], b);
+		s[2] = _mm256_add_epi32(s[2], c);
+		s[3] = _mm256_add_epi32(s[3], d);
+		s[4] = _mm256_add_epi32(s[4], e);
+		s[5] = _mm256_add_epi32(s[5], f);
+		s[6] = _mm256_add_epi32(s[6], g);
+		s[7] = _mm256_add_epi32(s[7], hh);
+	}
+
+	for (i = 0; i < 8; i++)
+		_mm256_storeu_si256((__m256i *)h[i], s[i]);
+}
+
+#define XOR3_AVX512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+#define CH_AVX512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xca)
+#define MAJ_AVX512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xe8)
+
+__attribute__((target("avx2,avx512f,avx512bw")))
+static void sha256_multi_avx512(uint32_t h[8][SHA256_MULTI_MAX_LANES],
+				const uint8_t *const *data,
+				uint32_t block_nb)
+{
+	const __m512i bswap = _mm512_set_epi64(
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+		0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	const uint8_t *base = data[0];
+	__m512i off_lo, off_hi;
+	__m512i s[8], w[16];
+	__m512i a, b, c, d, e, f, g, hh, t1, t2, x, y;
+	int i, t;
+
+	/* Each gather fetches a word from 8 lanes, relative to lane 0 */
+	off_lo = _mm512_set_epi64(data[7] - base, data[6] - base,
+				  data[5] - base, data[4] - base,
+				  data[3] - base, data[2] - base,
+				  data[1] - base, 0);
+	off_hi = _mm512_set_epi64(data[15] - base, data[14] - base,
+				  data[13] - base, data[12] - base,
+				  data[11] - base, data[10] - base,
+				  data[9] - base, data[8] - base);
+
+	for (i = 0; i < 8; i++)
+		s[i] = _mm512_loadu_si512(h[i]);
+
+	for (; block_nb; block_nb--, base += VB2_SHA256_BLOCK_SIZE) {
+		for (t = 0; t < 16; t++) {
+			const void *p = base + 4 * t;
+
+			w[t] = _mm512_shuffle_epi8(_mm512_inserti64x4(
+				_mm512_castsi256_si512(
+					_mm512_i64gather_epi32(off_lo, p, 1)),
+				_mm512_i64gather_epi32(off_hi, p, 1), 1),
+				bswap);
+		}
+
+		a = s[0];
+		b = s[1];
+		c = s[2];
+		d = s[3];
+		e = s[4];
+		f = s[5];
+		g = s[6];
+		hh = s[7];
+
+		SHA256_MULTI_ROUNDS(_mm512_add_epi32, XOR3_AVX512,
+				    _mm512_ror_epi32, _mm512_srli_epi32,
+				    CH_AVX512, MAJ_AVX512, _mm512_set1_epi32);
+
+		s[0] = _mm512_add_epi32(s[0], a);
+		s[1] = _mm512_add_epi32(s[1], b);
+		s[2] = _mm512_add_epi32(s[2], c);
+		s[3] = _mm512_add_epi32(s[3], d);
+		s[4] = _mm512_add_epi32(s[4], e);
+		s[5] = _mm512_add_epi32(s[5], f);
+		s[6] = _mm512_add_epi32(s[6], g);
+		s[7] = _mm512_add_epi32(s[7], hh);
+	}
+
+	for (i = 0; i < 8; i++)
+		_mm512_storeu_si512(h[i], s[i]);
+}
+
+#endif  /* SHA_MULTI_X86 */
+
+/* Implementation tables, fastest first */
+
+static const struct sha1_impl sha1_impls[] = {
+#ifdef SHA_X86
+	{ "SHA-NI", cpu_has_shani, sha1_transform_shani },
+#endif
+#ifdef SHA_ARMV8
+	{ "ARMv8-CE", cpu_has_armv8_sha1, sha1_transform_armv8 },
+#endif
+	{ PORTABLE_NAME, always_supported, NULL },
+};
+
+static const struct sha256_impl sha256_impls[] = {
+#ifdef SHA_X86
+	{ "SHA-NI", cpu_has_shani, sha256_transform_shani },
+#endif
+#ifdef SHA_ARMV8
+	{ "ARMv8-CE", cpu_has_armv8_sha2, sha256_transform_armv8 },
+#endif
+	{ PORTABLE_NAME, always_supported, NULL },
+};
+
+static const struct sha512_impl sha512_impls[] = {
+#ifdef SHA_X86
+	{ "AVX-512", cpu_has_avx512, sha512_transform_avx512 },
+	{ "AVX2", cpu_has_avx2, sha512_transform_avx2 },
+#endif
+#ifdef SHA_ARMV8
+	{ "NEON", always_supported, sha512_transform_neon },
+#endif
+	{ PORTABLE_NAME, always_supported, NULL },
+};
+
+static const struct sha256_multi_impl sha256_multi_impls[] = {
+#ifdef SHA_MULTI_X86
+	{ "AVX-512", cpu_has_avx512bw, 16, 1, sha256_multi_avx512 },
+	{ "AVX2", cpu_has_avx2, 8, 0, sha256_multi_avx2 },
+#endif
+	{ PORTABLE_NAME, always_supported, 1, 1, NULL },
+};
+
+/*
+ * Find an implementation in a table.  If name is NULL, return the first one
+ * the CPU supports; otherwise return the named one if the CPU supports it.
+ * Tables always end with the portable code, which is supported everywhere.
+ */
+static const struct sha1_impl *find_sha1_impl(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha1_impls); i++) {
+		if (name && strcmp(name, sha1_impls[i].name))
+			continue;
+		if (sha1_impls[i].supported())
+			return &sha1_impls[i];
+		if (name)
+			break;
+	}
+
+	return NULL;
+}
+
+static const struct sha256_impl *find_sha256_impl(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha256_impls); i++) {
+		if (name && strcmp(name, sha256_impls[i].name))
+			continue;
+		if (sha256_impls[i].supported())
+			return &sha256_impls[i];
+		if (name)
+			break;
+	}
+
+	return NULL;
+}
+
+static const struct sha512_impl *find_sha512_impl(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha512_impls); i++) {
+		if (name && strcmp(name, sha512_impls[i].name))
+			continue;
+		if (sha512_impls[i].supported())
+			return &sha512_impls[i];
+		if (name)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Like find_sha256_impl().  When choosing automatically on a CPU with SHA
+ * extensions, skip the multi-buffer code they beat one buffer at a time.
+ */
+static const struct sha256_multi_impl *find_sha256_multi_impl(
+	const char *name)
+{
+	int sha_ext = !name && find_sha256_impl(NULL)->transform;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha256_multi_impls); i++) {
+		if (name && strcmp(name, sha256_multi_impls[i].name))
+			continue;
+		if (sha_ext && !sha256_multi_impls[i].beats_sha_ext)
+			continue;
+		if (sha256_multi_impls[i].supported())
+			return &sha256_multi_impls[i];
+		if (name)
+			break;
+	}
+
+	return NULL;
+}
+
+vb2_sha1_transform_fn vb2_sha1_accel_transform(void)
+{
+	if (!accel_enabled)
+		return NULL;
+
+	if (!sha1_cur)
+		sha1_cur = find_sha1_impl(NULL);
+
+	return sha1_cur->transform;
+}
+
+vb2_sha256_transform_fn vb2_sha256_accel_transform(void)
+{
+	if (!accel_enabled)
+		return NULL;
+
+	if (!sha256_cur)
+		sha256_cur = find_sha256_impl(NULL);
+
+	return sha256_cur->transform;
+}
+
+vb2_sha512_transform_fn vb2_sha512_accel_transform(void)
+{
+	if (!accel_enabled)
+		return NULL;
+
+	if (!sha512_cur)
+		sha512_cur = find_sha512_impl(NULL);
+
+	return sha512_cur->transform;
+}
+
+/* Return the multi-buffer code to use, or NULL to hash one at a time */
+static const struct sha256_multi_impl *sha256_multi_accel(void)
+{
+	if (!accel_enabled)
+		return NULL;
+
+	if (!sha256_multi_cur)
+		sha256_multi_cur = find_sha256_multi_impl(NULL);
+
+	return sha256_multi_cur->transform ? sha256_multi_cur : NULL;
+}
+
+/*
+ * Finish a buffer from where its lane left off: hash what's left of it,
+ * starting after done blocks, with the one-buffer code.
+ */
+static void sha256_multi_finish(uint32_t h[8][SHA256_MULTI_MAX_LANES],
+				int lane, uint32_t done,
+				const uint8_t *data, uint32_t size,
+				uint8_t *digest)
+{
+	struct vb2_sha256_context ctx;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		ctx.h[i] = h[i][lane];
+	ctx.total_size = done * VB2_SHA256_BLOCK_SIZE;
+	ctx.size = 0;
+	vb2_sha256_update(&ctx, data, size);
+	vb2_sha256_finalize(&ctx, digest);
+}
+
+int vb2_sha256_accel_buffers(uint32_t count,
+			     const uint8_t *const bufs[],
+			     const uint32_t sizes[],
+			     uint8_t *const digests[])
+{
+	const struct sha256_multi_impl *impl = sha256_multi_accel();
+	uint32_t h[8][SHA256_MULTI_MAX_LANES];
+	const uint8_t *data[SHA256_MULTI_MAX_LANES];
+	/* Blocks hashed so far, and whole blocks left, in each lane */
+	uint32_t done[SHA256_MULTI_MAX_LANES];
+	uint32_t left[SHA256_MULTI_MAX_LANES];
+	/* Buffer in each lane, or -1 if the lane is idle */
+	int64_t item[SHA256_MULTI_MAX_LANES];
+	struct vb2_sha256_context init;
+	uint32_t next = 0, n;
+	int lanes, active = 0, first, lane, i;
+
+	if (!impl)
+		return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+	lanes = impl->lanes;
+	vb2_sha256_init(&init);
+	for (lane = 0; lane < lanes; lane++)
+		item[lane] = -1;
+
+	for (;;) {
+		/* Start new buffers in idle lanes */
+		for (lane = 0; lane < lanes && next < count; lane++) {
+			if (item[lane] >= 0)
+				continue;
+			item[lane] = next;
+			data[lane] = bufs[next];
+			done[lane] = 0;
+			left[lane] = sizes[next] / VB2_SHA256_BLOCK_SIZE;
+			for (i = 0; i < 8; i++)
+				h[i][lane] = init.h[i];
+			active++;
+			next++;
+		}
+
+		/*
+		 * Once there aren't enough buffers left to keep half the
+		 * lanes busy, the one-buffer code is faster.  This also
+		 * finishes buffers with no whole blocks left in them.
+		 */
+		first = -1;
+		n = UINT32_MAX;
+		for (lane = 0; lane < lanes; lane++) {
+			if (item[lane] < 0)
+				continue;
+			if (!left[lane] ||
+			    (next == count && active * 2 < lanes)) {
+				sha256_multi_finish(
+					h, lane, done[lane], data[lane],
+					sizes[item[lane]] - done[lane] *
+					VB2_SHA256_BLOCK_SIZE,
+					digests[item[lane]]);
+				item[lane] = -1;
+				active--;
+				continue;
+			}
+			if (first < 0)
+				first = lane;
+			if (left[lane] < n)
+				n = left[lane];
+		}
+		if (first < 0) {
+			if (next == count)
+				break;
+			continue;
+		}
+
+		/* Idle lanes hash a copy of a busy one, and are ignored */
+		for (lane = 0; lane < lanes; lane++)
+			if (item[lane] < 0)
+				data[lane] = data[first];
+
+		impl->transform(h, data, n);
+
+		for (lane = 0; lane < lanes; lane++) {
+			if (item[lane] < 0)
+				continue;
+			data[lane] += n * VB2_SHA256_BLOCK_SIZE;
+			done[lane] += n;
+			left[lane] -= n;
+		}
+	}
+
+	return VB2_SUCCESS;
+}
+
+void vb2_sha_accel_enable(int enable)
+{
+	accel_enabled = enable;
+}
+
+const char *vb2_sha_impl_name(enum vb2_hash_algorithm hash_alg)
+{
+	switch (hash_alg) {
+	case VB2_HASH_SHA1:
+		if (vb2_sha1_accel_transform())
+			return sha1_cur->name;
+		break;
+	case VB2_HASH_SHA256:
+		if (vb2_sha256_accel_transform())
+			return sha256_cur->name;
+		break;
+	case VB2_HASH_SHA512:
+		if (vb2_sha512_accel_transform())
+			return sha512_cur->name;
+		break;
+	default:
+		break;
+	}
+
+	return PORTABLE_NAME;
+}
+
+int vb2_sha_impl_select(enum vb2_hash_algorithm hash_alg, const char *name)
+{
+	const struct sha1_impl *impl1;
+	const struct sha256_impl *impl256;
+	const struct sha512_impl *impl512;
+
+	switch (hash_alg) {
+	case VB2_HASH_SHA1:
+		impl1 = find_sha1_impl(name);
+		if (!impl1)
+			return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+		sha1_cur = impl1;
+		return VB2_SUCCESS;
+	case VB2_HASH_SHA256:
+		impl256 = find_sha256_impl(name);
+		if (!impl256)
+			return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+		sha256_cur = impl256;
+		return VB2_SUCCESS;
+	case VB2_HASH_SHA512:
+		impl512 = find_sha512_impl(name);
+		if (!impl512)
+			return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+		sha512_cur = impl512;
+		return VB2_SUCCESS;
+	default:
+		/* Other algorithms only have portable code */
+		if (!name || !strcmp(name, PORTABLE_NAME))
+			return VB2_SUCCESS;
+		return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+	}
+}
+
+const char *vb2_sha_multi_impl_name(enum vb2_hash_algorithm hash_alg)
+{
+	if (hash_alg == VB2_HASH_SHA256 && sha256_multi_accel())
+		return sha256_multi_cur->name;
+
+	return PORTABLE_NAME;
+}
+
+int vb2_sha_multi_impl_select(enum vb2_hash_algorithm hash_alg,
+			      const char *name)
+{
+	const struct sha256_multi_impl *impl;
+
+	if (hash_alg == VB2_HASH_SHA256) {
+		impl = find_sha256_multi_impl(name);
+		if (!impl)
+			return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+		sha256_multi_cur = impl;
+		return VB2_SUCCESS;
+	}
+
+	/* Other algorithms are always hashed one buffer at a time */
+	if (!name || !strcmp(name, PORTABLE_NAME))
+		return VB2_SUCCESS;
+	return VB2_ERROR_SHA_IMPL_UNSUPPORTED;
+}
@@ -8,6 +8,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #if VB2_SUPPORT_SHA1
 #define CTH_SHA1 VB2_HASH_SHA1
@@ -116,6 +117,31 @@ const char *vb2_get_hash_algorithm_name(enum vb2_hash_algorithm alg)
 	}
 }
 
+uint32_t vb2_digest_context_size(enum vb2_hash_algorithm hash_alg)
+{
+	switch (hash_alg) {
+#if VB2_SUPPORT_SHA1
+	case VB2_HASH_SHA1:
+		return offsetof(struct vb2_digest_context, sha1) +
+			sizeof(struct vb2_sha1_context);
+#endif
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA256:
+		return offsetof(struct vb2_digest_context, sha256) +
+			sizeof(struct vb2_sha256_context);
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA512:
+		return offsetof(struct vb2_digest_context, sha512) +
+			sizeof(struct vb2_sha512_context);
+#endif
+	default:
+		/* Just the fields before the union */
+		return offsetof(struct vb2_digest_context, using_hwcrypto) +
+			sizeof(int);
+	}
+}
+
 int vb2_digest_init(struct vb2_digest_context *dc,
 		    enum vb2_hash_algorithm hash_alg)
 {
@@ -215,3 +241,32 @@ int vb2_digest_buffer(const uint8_t *buf,
 
 	return vb2_digest_finalize(&dc, digest, digest_size);
 }
+
+int vb2_digest_buffers(uint32_t count,
+		       const uint8_t *const bufs[],
+		       const uint32_t sizes[],
+		       enum vb2_hash_algorithm hash_alg,
+		       uint8_t *const digests[],
+		       uint32_t digest_size)
+{
+	uint32_t i;
+	int rv;
+
+#if VB2_SHA_ACCEL && VB2_SUPPORT_SHA256
+	/* A single buffer is faster through the one-at-a-time transform */
+	if (hash_alg == VB2_HASH_SHA256 && count > 1 &&
+	    digest_size >= VB2_SHA256_DIGEST_SIZE &&
+	    vb2_sha256_accel_buffers(count, bufs, sizes, digests) ==
+	    VB2_SUCCESS)
+		return VB2_SUCCESS;
+#endif
+
+	for (i = 0; i < count; i++) {
+		rv = vb2_digest_buffer(bufs[i], sizes[i], hash_alg,
+				       digests[i], digest_size);
+		if (rv)
+			return rv;
+	}
+
+	return VB2_SUCCESS;
+}
@@ -7,6 +7,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "2sysincludes.h"
 #include "2api.h"
@@ -42,6 +43,16 @@ int vb2ex_read_resource(struct vb2_context *ctx,
 	return VB2_ERROR_EX_UNIMPLEMENTED;
 }
 
+__attribute__((weak))
+int vb2ex_map_resource(struct vb2_context *ctx,
+		       enum vb2_resource_index index,
+		       uint32_t offset,
+		       uint32_t size,
+		       const void **buf)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 __attribute__((weak))
 int vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
 			       uint32_t data_size)
@@ -63,9 +74,61 @@ int vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
 	return VB2_ERROR_SHA_FINALIZE_ALGORITHM;  /* Should not be called. */
 }
 
+__attribute__((weak))
+int vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+				     const uint8_t *sig,
+				     const uint8_t *digest)
+{
+	return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+}
+
 __attribute__((weak))
 int vb2ex_tpm_set_mode(enum vb2_tpm_mode mode_val)
 {
 	fprintf(stderr, "%s: function not implemented\n", __func__);
 	return VB2_ERROR_EX_UNIMPLEMENTED;
 }
+
+__attribute__((weak))
+uint32_t vb2ex_utime(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+__attribute__((weak))
+void vb2ex_timestamp(enum vb2_timestamp_id id)
+{
+}
+
+__attribute__((weak))
+int vb2ex_parallel_start(void (*func)(void *arg), void *arg, void **job)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+void vb2ex_parallel_wait(void *job)
+{
+}
+
+__attribute__((weak))
+int vb2ex_warm_boot_state(uint8_t *nonce, uint32_t *flash_write_count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+int vb2ex_warm_boot_record_read(struct vb2_warm_boot_record *rec)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+int vb2ex_warm_boot_record_write(const struct vb2_warm_boot_record *rec)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
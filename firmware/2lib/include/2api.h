@@ -28,6 +28,10 @@
 #include "2id.h"
 #include "2recovery_reasons.h"
 #include "2return_codes.h"
+#include "2trace.h"
+
+struct vb2_public_key;
+struct vb2_shared_data;
 
 /* Modes for vb2ex_tpm_set_mode. */
 enum vb2_tpm_mode {
@@ -174,6 +178,14 @@ enum vb2_context_flags {
 	 * support.
 	 */
 	VB2_CONTEXT_DISPLAY_INIT = (1 << 20),
+
+	/*
+	 * Caller may set this before calling vb2api_fw_phase3() to trust the
+	 * RW firmware signatures checked earlier in this power cycle; see
+	 * struct vb2_warm_boot_record.  Leave it clear unless the platform
+	 * implements the vb2ex_warm_boot_...() functions.
+	 */
+	VB2_CONTEXT_WARM_BOOT_RECORD = (1 << 21),
 };
 
 /*
@@ -274,6 +286,50 @@ enum vb2_resource_index {
 	VB2_RES_KERNEL_VBLOCK,
 };
 
+/* Size of the boot nonce in a warm boot record */
+#define VB2_WARM_BOOT_NONCE_SIZE 32
+
+/* "WBRC" = vb2_warm_boot_record.magic */
+#define VB2_WARM_BOOT_RECORD_MAGIC 0x43524257
+
+/*
+ * What RO verstage remembers about the RW firmware it verified, so that the
+ * next boot in the same power cycle can skip the keyblock, preamble and body
+ * signature checks if none of it has changed.  The keyblock, preamble and
+ * body are still read and hashed each boot, and the version and rollback
+ * checks still run; only the RSA verification is skipped, and only if the
+ * digests match.
+ *
+ * The record is only as trustworthy as where it is kept.  The platform must
+ * store it somewhere RW firmware and the OS can't write: for example a TPM
+ * NV space write-locked by RO once verstage is done, or RAM which only RO
+ * can reach.  Anyone who can write a record can get any RW firmware booted
+ * with the signature checks skipped.
+ *
+ * The boot nonce and flash write count limit a record to the boot state it
+ * was made in.  The nonce must change on every cold boot (for example a
+ * random value kept in memory which survives warm reset, or the TPM's reset
+ * count); the flash write count must change whenever the flash is written.
+ */
+struct vb2_warm_boot_record {
+	/* Magic number (VB2_WARM_BOOT_RECORD_MAGIC) */
+	uint32_t magic;
+
+	/* Firmware slot verified (0=A, 1=B) */
+	uint32_t fw_slot;
+
+	/* Boot state when the record was made; see vb2ex_warm_boot_state() */
+	uint32_t flash_write_count;
+	uint8_t boot_nonce[VB2_WARM_BOOT_NONCE_SIZE];
+
+	/* SHA-256 digests of the root key and keyblock, and of the preamble */
+	uint8_t keyblock_digest[32];
+	uint8_t preamble_digest[32];
+
+	/* Body digest checked against the body signature, zero-padded */
+	uint8_t body_digest[64];
+} __attribute__((packed));
+
 /* Digest ID for vbapi_get_pcr_digest() */
 enum vb2_pcr_digest {
 	/* Digest based on current developer and recovery mode flags */
@@ -542,6 +598,73 @@ int vb2api_extend_hash(struct vb2_context *ctx,
 		       const void *buf,
 		       uint32_t size);
 
+/*
+ * A hash started by vb2api_init_hash(), with the work of finding where it is
+ * and how to extend it done once up front.  Filled in by
+ * vb2api_init_hash_session(); the fields are private to vboot.
+ */
+struct vb2_hash_session {
+	int (*extend)(struct vb2_hash_session *hs,
+		      const uint8_t *buf,
+		      uint32_t size);
+	struct vb2_context *ctx;
+	struct vb2_digest_context *dc;
+	struct vb2_shared_data *sd;
+};
+
+/**
+ * Set up a session for extending the hash started by vb2api_init_hash().
+ *
+ * Callers which hash the body in many small reads may extend the hash
+ * through the session with vb2api_extend_hash_session() instead of calling
+ * vb2api_extend_hash(), which looks everything up again each time.  The two
+ * may be mixed.  The session is only good until the hash is checked or
+ * started again.
+ *
+ * @param ctx		Vboot context
+ * @param hs		Session to fill in
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2api_init_hash_session(struct vb2_context *ctx,
+			     struct vb2_hash_session *hs);
+
+/**
+ * Extend a hash through a session from vb2api_init_hash_session().
+ *
+ * @param hs		Hash session
+ * @param buf		Data to hash
+ * @param size		Size of data in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2api_extend_hash_session(struct vb2_hash_session *hs,
+			       const void *buf,
+			       uint32_t size);
+
+/**
+ * Extend the hash started by vb2api_init_hash() straight from memory-mapped
+ * storage.
+ *
+ * For firmware which can see the body through a memory-mapped window (for
+ * example coreboot verstage on x86, where the boot SPI flash is mapped below
+ * 4 GB), pass the mapped FW_MAIN region here instead of reading it into a RAM
+ * buffer and calling vb2api_extend_hash().  The region is hashed in place,
+ * with the next part of it prefetched while the current one is hashed, so the
+ * slow flash reads overlap with the hashing.  It may be mixed with
+ * vb2api_extend_hash() calls, and is limited to the same size.
+ *
+ * Verifying data in place only helps if the verified bytes are the ones which
+ * get used.  If the caller will read the body from flash again afterwards,
+ * the flash must not be able to change in between.
+ *
+ * @param ctx		Vboot context
+ * @param ptr		Start of the mapped region
+ * @param size		Size of the region in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2api_hash_mapped_region(struct vb2_context *ctx,
+			      const void *ptr,
+			      uint32_t size);
+
 /**
  * Check the hash value started by vb2api_init_hash().
  *
@@ -567,6 +690,44 @@ int vb21api_check_hash(struct vb2_context *ctx);
 int vb2api_check_hash_get_digest(struct vb2_context *ctx, void *digest_out,
 				 uint32_t digest_out_size);
 
+/**
+ * Get how the firmware body is split into chunks.
+ *
+ * If the firmware preamble has a table of chunk digests, each chunk of the
+ * body can be checked on its own with vb2api_check_body_chunk(), instead of
+ * hashing the whole body with vb2api_init_hash().  Must be called after
+ * vb2api_fw_phase3().
+ *
+ * @param ctx		Vboot context
+ * @param chunk_size	Destination for the size of each chunk in bytes; the
+ *			last chunk may be shorter.
+ * @param count		Destination for the number of chunks
+ * @return VB2_SUCCESS, VB2_ERROR_API_BODY_NOT_CHUNKED if the body can only
+ * be hashed as a whole, or another error code on error.
+ */
+int vb2api_get_body_chunks(struct vb2_context *ctx,
+			   uint32_t *chunk_size,
+			   uint32_t *count);
+
+/**
+ * Check one chunk of the firmware body against its digest.
+ *
+ * The table of chunk digests is covered by the preamble signature, so a chunk
+ * which passes can be used without checking the rest of the body.  This does
+ * not change the context, so chunks may be checked in any order, on several
+ * cores at once, or only when the code in them is needed.
+ *
+ * @param ctx		Vboot context
+ * @param index		Index of the chunk in the body
+ * @param buf		Chunk data
+ * @param size		Size of chunk data in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2api_check_body_chunk(struct vb2_context *ctx,
+			    uint32_t index,
+			    const void *buf,
+			    uint32_t size);
+
 /**
  * Get a PCR digest
  *
@@ -627,6 +788,10 @@ int vb2api_get_kernel_size(struct vb2_context *ctx,
  * the caller to load or map the kernel data, as appropriate, and pass the
  * pointer to the kernel data into vboot.
  *
+ * The kernel data is verified as it is stored.  If the preamble says it is
+ * compressed (see vb2_kernel_get_body_compression()), the caller decompresses
+ * it after it verifies, for example with vb2_lz4_decompress().
+ *
  * @param ctx		Vboot context
  * @param buf		Pointer to kernel data
  * @param size		Size of kernel data in bytes
@@ -636,6 +801,44 @@ int vb2api_verify_kernel_data(struct vb2_context *ctx,
 			      const void *buf,
 			      uint32_t size);
 
+/**
+ * Get how the kernel data is split into chunks.
+ *
+ * Valid after a successful call to vb2api_load_kernel_vblock().  If the
+ * kernel preamble has a table of chunk digests, each chunk of the kernel data
+ * can be checked on its own with vb2api_check_kernel_body_chunk(), instead of
+ * passing all of it to vb2api_verify_kernel_data().
+ *
+ * @param ctx		Vboot context
+ * @param chunk_size	Destination for the size of each chunk in bytes; the
+ *			last chunk may be shorter.
+ * @param count		Destination for the number of chunks
+ * @return VB2_SUCCESS, VB2_ERROR_API_BODY_NOT_CHUNKED if the kernel data can
+ * only be verified as a whole, or another error code on error.
+ */
+int vb2api_get_kernel_body_chunks(struct vb2_context *ctx,
+				  uint32_t *chunk_size,
+				  uint32_t *count);
+
+/**
+ * Check one chunk of the kernel data against its digest.
+ *
+ * The table of chunk digests is covered by the kernel preamble signature, so
+ * once every chunk has passed, the kernel data is verified.  This does not
+ * change the context, so chunks may be checked in any order, on several cores
+ * at once, or as each one arrives from storage.
+ *
+ * @param ctx		Vboot context
+ * @param index		Index of the chunk in the kernel data
+ * @param buf		Chunk data
+ * @param size		Size of chunk data in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2api_check_kernel_body_chunk(struct vb2_context *ctx,
+				   uint32_t index,
+				   const void *buf,
+				   uint32_t size);
+
 /**
  * Clean up after kernel verification.
  *
@@ -702,6 +905,36 @@ int vb2ex_read_resource(struct vb2_context *ctx,
 			void *buf,
 			uint32_t size);
 
+/**
+ * Map a verified boot resource in place.
+ *
+ * Optional.  Where a resource is memory-mapped (for example the boot SPI
+ * flash on x86), this lets vboot parse and verify it where it is instead of
+ * reading it into the work buffer with vb2ex_read_resource().  Currently used
+ * for VB2_RES_FW_VBLOCK.
+ *
+ * The mapping may be read-only; vboot never writes to it.
+ *
+ * Only map a region which can't change until vboot is done with it; for the
+ * firmware vblock, lock it for the rest of verstage.  vboot uses every field
+ * from the same mapping it checked the signature over, but doesn't copy the
+ * whole region first, so flash which could be rewritten in between would
+ * defeat the check.
+ *
+ * @param ctx		Vboot context
+ * @param index		Resource index to map
+ * @param offset	Byte offset within resource to start at
+ * @param size		Amount of data to map
+ * @param buf		On success, points to the mapped data
+ * @return VB2_SUCCESS, or non-zero to have vboot read the resource with
+ * vb2ex_read_resource() instead.
+ */
+int vb2ex_map_resource(struct vb2_context *ctx,
+		       enum vb2_resource_index index,
+		       uint32_t offset,
+		       uint32_t size,
+		       const void **buf);
+
 /**
  * Print debug output
  *
@@ -744,6 +977,22 @@ int vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size);
  */
 int vb2ex_hwcrypto_digest_finalize(uint8_t *digest, uint32_t digest_size);
 
+/**
+ * Verify a RSA signature of a digest with the hardware crypto engine.
+ *
+ * Only called for keys with allow_hwcrypto set, which vboot does for body
+ * signatures whose preamble doesn't disallow hardware crypto.
+ *
+ * @param key		Public key to verify with
+ * @param sig		Signature, vb2_rsa_sig_size(key->sig_alg) bytes
+ * @param digest	Digest of the signed data, using key->hash_alg
+ * @return VB2_SUCCESS, or non-zero error code (HWCRYPTO_UNSUPPORTED not fatal;
+ * vboot verifies the signature in software instead).
+ */
+int vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+				     const uint8_t *sig,
+				     const uint8_t *digest);
+
 /*
  * Set the current TPM mode value, and validate that it was changed.  If one
  * of the following occurs, the function call fails:
@@ -759,4 +1008,85 @@ int vb2ex_hwcrypto_digest_finalize(uint8_t *digest, uint32_t digest_size);
  */
 int vb2ex_tpm_set_mode(enum vb2_tpm_mode mode_val);
 
+/**
+ * Read a microsecond timer, for the boot trace.
+ *
+ * Only differences between values are used, so this may start anywhere, but
+ * it should count up without going backwards for the whole boot.
+ *
+ * @return The current time in microseconds.
+ */
+uint32_t vb2ex_utime(void);
+
+/**
+ * Record that the boot has reached a phase boundary.
+ *
+ * Platforms which keep a boot timestamp table (such as coreboot's) should add
+ * an entry for id at the current time.  Others may do nothing.  This may be
+ * called before the vboot context is set up, so it must not depend on it.
+ *
+ * @param id		Which boundary (enum vb2_timestamp_id)
+ */
+void vb2ex_timestamp(enum vb2_timestamp_id id);
+
+/**
+ * Start running a function on another CPU core.
+ *
+ * This lets LoadKernel() verify the vblock of a fallback kernel partition
+ * while the body of the primary kernel is being read.  Platforms which can't
+ * run func concurrently should return an error rather than calling it, since
+ * the caller would then do work it may turn out not to need.  The job needs
+ * about another 72 KB of work buffer on top of
+ * VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE; it is skipped if that isn't
+ * available.
+ *
+ * @param func		Function to run
+ * @param arg		Argument to pass to func
+ * @param job		Destination for a handle to pass to
+ *			vb2ex_parallel_wait()
+ * @return VB2_SUCCESS if func has been started, or non-zero error code if it
+ * will not be called.
+ */
+int vb2ex_parallel_start(void (*func)(void *arg), void *arg, void **job);
+
+/**
+ * Wait for a function started by vb2ex_parallel_start() to return.
+ *
+ * @param job		Handle from vb2ex_parallel_start()
+ */
+void vb2ex_parallel_wait(void *job);
+
+/**
+ * Get the state a warm boot record is tied to.
+ *
+ * Only called if the caller set VB2_CONTEXT_WARM_BOOT_RECORD.
+ *
+ * @param nonce		Destination for the boot nonce, which must change on
+ *			every cold boot (VB2_WARM_BOOT_NONCE_SIZE bytes)
+ * @param flash_write_count	Destination for a count which must change
+ *			whenever the firmware flash is written
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2ex_warm_boot_state(uint8_t *nonce, uint32_t *flash_write_count);
+
+/**
+ * Read the warm boot record saved by vb2ex_warm_boot_record_write().
+ *
+ * @param rec		Destination for the record
+ * @return VB2_SUCCESS, or error code if there is no record.
+ */
+int vb2ex_warm_boot_record_read(struct vb2_warm_boot_record *rec);
+
+/**
+ * Save a warm boot record for later boots in this power cycle.
+ *
+ * Called by vb2api_check_hash() once the RW firmware has been fully verified.
+ * This must fail, rather than store the record somewhere RW firmware or the
+ * OS could change it; see struct vb2_warm_boot_record.
+ *
+ * @param rec		Record to save
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2ex_warm_boot_record_write(const struct vb2_warm_boot_record *rec);
+
 #endif  /* VBOOT_2_API_H_ */
@@ -46,6 +46,15 @@ struct vb2_public_key;
 #endif
 #endif
 
+/*
+ * Host builds may compare buffers in vb2_safe_memcmp() with vector types,
+ * which can use unaligned loads and SIMD registers.  Firmware builds compare
+ * in machine words, and only when the buffers are aligned the same way.
+ */
+#ifndef VB2_SAFE_MEMCMP_VECTOR
+#define VB2_SAFE_MEMCMP_VECTOR 0
+#endif
+
 /**
  * Round up a number to a multiple of VB2_WORKBUF_ALIGN
  *
@@ -61,6 +70,14 @@ static __inline uint32_t vb2_wb_round_up(uint32_t v)
 struct vb2_workbuf {
 	uint8_t *buf;
 	uint32_t size;
+
+	/*
+	 * For work buffers from vb2_workbuf_from_ctx(), the start of the
+	 * context work buffer and where to record how much of it has been
+	 * used.  Stats are NULL for other work buffers.
+	 */
+	uint8_t *base;
+	struct vb2_workbuf_stats *stats;
 };
 
 /**
@@ -72,6 +89,14 @@ struct vb2_workbuf {
  */
 void vb2_workbuf_init(struct vb2_workbuf *wb, uint8_t *buf, uint32_t size);
 
+/**
+ * Record work buffer use in the high-water marks.
+ *
+ * @param stats		Work buffer stats to update
+ * @param used		Bytes in use, from the start of the work buffer
+ */
+void vb2_workbuf_note_used(struct vb2_workbuf_stats *stats, uint32_t used);
+
 /**
  * Allocate space in a work buffer.
  *
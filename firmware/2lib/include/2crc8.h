@@ -8,6 +8,15 @@
 #ifndef VBOOT_REFERENCE_2_CRC8_H_
 #define VBOOT_REFERENCE_2_CRC8_H_
 
+/*
+ * Number of entries in the lookup table vb2_crc8() uses: 0 to compute the CRC
+ * a bit at a time with no table, 16 for a half-byte table, or 256 for a whole
+ * byte table.  Firmware builds default to no table to save code size.
+ */
+#ifndef VB2_CRC8_TABLE
+#define VB2_CRC8_TABLE 0
+#endif
+
 /**
  * Calculate CRC-8 of the data, using x^8 + x^2 + x + 1 polynomial.
  *
@@ -8,6 +8,46 @@
 
 #include <stdint.h>
 #include "2crypto.h"
+#include "2sha.h"
+
+/*
+ * HMAC key schedule.  Hashing the padded key takes a full block per pad, so
+ * callers computing several MACs with the same key can do it once with
+ * vb2_hmac_init() and then call vb2_hmac_calculate() for each message.
+ */
+struct vb2_hmac_context {
+	/* Hash states after the inner and outer padded keys */
+	struct vb2_digest_context inner;
+	struct vb2_digest_context outer;
+	uint32_t digest_size;
+};
+
+/**
+ * Precompute the HMAC key schedule
+ *
+ * @param hc		HMAC context to init
+ * @param alg		Hash algorithm ID
+ * @param key		HMAC key
+ * @param key_size	HMAC key size
+ * @return 0 if success, non-zero if error.
+ */
+int vb2_hmac_init(struct vb2_hmac_context *hc, enum vb2_hash_algorithm alg,
+		  const void *key, uint32_t key_size);
+
+/**
+ * Compute HMAC with a precomputed key schedule.  The context isn't changed,
+ * so it can be used for any number of messages.
+ *
+ * @param hc		HMAC context from vb2_hmac_init()
+ * @param msg		Message to compute HMAC for
+ * @param msg_size	Message size
+ * @param mac		Computed message authentication code
+ * @param mac_size	Size of the buffer pointed by <mac>
+ * @return 0 if success, non-zero if error.
+ */
+int vb2_hmac_calculate(const struct vb2_hmac_context *hc,
+		       const void *msg, uint32_t msg_size,
+		       uint8_t *mac, uint32_t mac_size);
 
 /**
  * Compute HMAC
@@ -0,0 +1,85 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Streaming LZ4 decompression.
+ *
+ * The compressed data is a single LZ4 block, as produced by
+ * LZ4_compress_default(), without the frame the lz4 command line tool puts
+ * around it.  Matches may reach back to the start of the output, so it must
+ * be one flat buffer, but the input can be passed in pieces of any size as it
+ * arrives.
+ */
+
+#ifndef VBOOT_REFERENCE_2_LZ4_H_
+#define VBOOT_REFERENCE_2_LZ4_H_
+
+/*
+ * Bytes a buffer needs past the decompressed size, so that this many bytes of
+ * compressed data stored at the end of it can be decompressed in place to its
+ * start.  Matches LZ4_DECOMPRESS_INPLACE_MARGIN() in lz4.h.
+ */
+#define VB2_LZ4_INPLACE_MARGIN(compressed_size) \
+	(((compressed_size) >> 8) + 32)
+
+/* Decompression context */
+struct vb2_lz4_context {
+	/* Output buffer, and bytes of it written so far */
+	uint8_t *out;
+	uint32_t out_size;
+	uint32_t out_used;
+
+	/* Position in the current sequence */
+	uint32_t state;
+	uint8_t token;
+	uint32_t literal_size;
+	uint32_t match_size;
+	uint32_t offset;
+};
+
+/**
+ * Start decompressing LZ4 data.
+ *
+ * The input may be in the same buffer as the output, at or after the end of
+ * the output written so far; decompression then fails with
+ * VB2_ERROR_LZ4_OVERLAP instead of overwriting input it hasn't used yet.
+ *
+ * @param lc		Context to initialize
+ * @param out		Buffer for the decompressed data
+ * @param out_size	Size of the data when decompressed, in bytes
+ */
+void vb2_lz4_init(struct vb2_lz4_context *lc, void *out, uint32_t out_size);
+
+/**
+ * Decompress the next piece of LZ4 data.
+ *
+ * @param lc		Context from vb2_lz4_init()
+ * @param buf		Compressed data
+ * @param size		Size of compressed data in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_lz4_extend(struct vb2_lz4_context *lc, const void *buf,
+		   uint32_t size);
+
+/**
+ * Finish decompressing LZ4 data.
+ *
+ * @param lc		Context from vb2_lz4_init()
+ * @return VB2_SUCCESS if the data ended after a whole block which filled the
+ * output buffer, or non-zero error code.
+ */
+int vb2_lz4_finalize(struct vb2_lz4_context *lc);
+
+/**
+ * Decompress a whole block of LZ4 data in one call.
+ *
+ * @param in		Compressed data
+ * @param in_size	Size of compressed data in bytes
+ * @param out		Buffer for the decompressed data
+ * @param out_size	Size of the data when decompressed, in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_lz4_decompress(const void *in, uint32_t in_size,
+		       void *out, uint32_t out_size);
+
+#endif  /* VBOOT_REFERENCE_2_LZ4_H_ */
@@ -62,6 +62,21 @@ void vb2_workbuf_from_ctx(struct vb2_context *ctx, struct vb2_workbuf *wb);
  */
 void vb2_set_workbuf_used(struct vb2_context *ctx, uint32_t used);
 
+/**
+ * Set the phase which later work buffer use is counted against.
+ *
+ * Work buffer allocated from vb2_workbuf_from_ctx() and data kept with
+ * vb2_set_workbuf_used() update the high-water marks in vb2_shared_data, for
+ * the boot as a whole and for the current phase.  A phase lasts until the
+ * next call to this function.  Does nothing for a context without shared
+ * data (workbuf_used 0).
+ *
+ * @param ctx		Vboot context
+ * @param phase		Phase now running
+ */
+void vb2_set_workbuf_phase(struct vb2_context *ctx,
+			   enum vb2_workbuf_phase phase);
+
 /**
  * Read the GBB header.
  *
@@ -85,6 +100,49 @@ int vb2_read_gbb_header(struct vb2_context *ctx, struct vb2_gbb_header *gbb);
  */
 void vb2_fail(struct vb2_context *ctx, uint8_t reason, uint8_t subcode);
 
+/**
+ * Record a boot trace event.
+ *
+ * Adds the event to the trace ring in the shared data, timestamped with
+ * vb2ex_utime().  Does nothing if the shared data has not been set up yet,
+ * or if built without VB2_BOOT_TRACE.
+ *
+ * @param ctx		Vboot context
+ * @param event		What is happening (enum vb2_trace_event)
+ * @param type		VB2_TRACE_BEGIN or VB2_TRACE_END
+ */
+void vb2_trace(struct vb2_context *ctx, enum vb2_trace_event event,
+	       enum vb2_trace_type type);
+
+/**
+ * Add hashing done as part of a verification step to its cost.
+ *
+ * Does nothing if the shared data has not been set up yet.
+ *
+ * @param ctx		Vboot context
+ * @param step		Verification step (enum vb2_cost_step)
+ * @param crypto_start_us	When the hashing started, from vb2ex_utime()
+ * @param hashed_bytes	Bytes hashed
+ */
+void vb2_cost_hash(struct vb2_context *ctx, enum vb2_cost_step step,
+		   uint32_t crypto_start_us, uint32_t hashed_bytes);
+
+/**
+ * Add one run of a verification step to its cost.
+ *
+ * Same as vb2_cost_hash(), but also counts the run and the time since the
+ * step started.
+ *
+ * @param ctx		Vboot context
+ * @param step		Verification step (enum vb2_cost_step)
+ * @param start_us	When the step started, from vb2ex_utime()
+ * @param crypto_start_us	When its hashing and signature checks started
+ * @param hashed_bytes	Bytes hashed
+ */
+void vb2_cost_add(struct vb2_context *ctx, enum vb2_cost_step step,
+		  uint32_t start_us, uint32_t crypto_start_us,
+		  uint32_t hashed_bytes);
+
 /**
  * Set up the verified boot context data, if not already set up.
  *
@@ -164,6 +222,43 @@ int vb21_load_fw_keyblock(struct vb2_context *ctx);
 int vb2_load_fw_preamble(struct vb2_context *ctx);
 int vb21_load_fw_preamble(struct vb2_context *ctx);
 
+/**
+ * Read this power cycle's warm boot record for the current firmware slot.
+ *
+ * @param ctx		Vboot context
+ * @param rec		Destination for the record
+ * @return VB2_SUCCESS, or error code if there is no such record.
+ */
+int vb2_get_warm_boot_record(struct vb2_context *ctx,
+			     struct vb2_warm_boot_record *rec);
+
+/**
+ * Check a firmware body digest against the warm boot record.
+ *
+ * @param ctx		Vboot context
+ * @param digest	Body digest
+ * @param digest_size	Size of digest in bytes
+ * @return VB2_SUCCESS if the body is the one in the record, or error code.
+ */
+int vb2_check_warm_boot_body(struct vb2_context *ctx,
+			     const uint8_t *digest,
+			     uint32_t digest_size);
+
+/**
+ * Save a warm boot record for the firmware verified this boot.
+ *
+ * Must only be called once the keyblock, preamble and body have all had
+ * their signatures checked.
+ *
+ * @param ctx		Vboot context
+ * @param digest	Body digest
+ * @param digest_size	Size of digest in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+int vb2_save_warm_boot_record(struct vb2_context *ctx,
+			      const uint8_t *digest,
+			      uint32_t digest_size);
+
 /**
  * Verify the kernel keyblock using the previously-loaded kernel key.
  *
@@ -127,6 +127,13 @@ enum vb2_nv_param {
 	VB2_NV_POST_EC_SYNC_DELAY,
 	/* Request booting of diagnostic rom.  0=no, 1=yes. */
 	VB2_NV_DIAG_REQUEST,
+	/*
+	 * EC sync nonce (from VbExEcGetSyncNonce()) as of the last time EC-RW
+	 * was found to match, or 0 if none.  V2 only.
+	 */
+	VB2_NV_EC_SYNC_NONCE,
+	/* First 4 bytes of the expected EC-RW hash it matched.  V2 only. */
+	VB2_NV_EC_SYNC_HASH,
 };
 
 /* Set default boot in developer mode */
@@ -232,4 +239,25 @@ void vb2_nv_set(struct vb2_context *ctx,
 		enum vb2_nv_param param,
 		uint32_t value);
 
+/* One value to write with vb2_nv_set_many() */
+struct vb2_nv_setting {
+	enum vb2_nv_param param;
+	uint32_t value;
+};
+
+/**
+ * Write several non-volatile values.
+ *
+ * Same as calling vb2_nv_set() for each setting in order, but the CRC is only
+ * regenerated once, after all of them have been written.
+ *
+ * @param ctx		Context pointer
+ * @param settings	Values to write
+ * @param count		Number of entries in settings[]
+ * @return 1 if this changed ctx->nvdata[], 0 if not.
+ */
+int vb2_nv_set_many(struct vb2_context *ctx,
+		    const struct vb2_nv_setting *settings,
+		    int count);
+
 #endif  /* VBOOT_REFERENCE_VBOOT_2NVSTORAGE_H_ */
@@ -49,6 +49,14 @@ enum vb2_nv_offset {
 	VB2_NV_OFFS_FW_MAX_ROLLFORWARD2 = 17, /* bits 8-15 of 32 */
 	VB2_NV_OFFS_FW_MAX_ROLLFORWARD3 = 18, /* bits 16-23 of 32 */
 	VB2_NV_OFFS_FW_MAX_ROLLFORWARD4 = 19, /* bits 24-31 of 32 */
+	VB2_NV_OFFS_EC_SYNC_NONCE1 = 20, /* bits 0-7 of 32 */
+	VB2_NV_OFFS_EC_SYNC_NONCE2 = 21, /* bits 8-15 of 32 */
+	VB2_NV_OFFS_EC_SYNC_NONCE3 = 22, /* bits 16-23 of 32 */
+	VB2_NV_OFFS_EC_SYNC_NONCE4 = 23, /* bits 24-31 of 32 */
+	VB2_NV_OFFS_EC_SYNC_HASH1 = 24, /* bits 0-7 of 32 */
+	VB2_NV_OFFS_EC_SYNC_HASH2 = 25, /* bits 8-15 of 32 */
+	VB2_NV_OFFS_EC_SYNC_HASH3 = 26, /* bits 16-23 of 32 */
+	VB2_NV_OFFS_EC_SYNC_HASH4 = 27, /* bits 24-31 of 32 */
 
 	/* CRC must be last field */
 	VB2_NV_OFFS_CRC_V2 = 63,
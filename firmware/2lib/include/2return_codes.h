@@ -45,6 +45,9 @@ enum vb2_return_code {
 	/* Digest size buffer too small in vb2_digest_finalize() */
 	VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
 
+	/* Unknown or unsupported implementation in vb2_sha_impl_select() */
+	VB2_ERROR_SHA_IMPL_UNSUPPORTED,
+
 	/**********************************************************************
 	 * RSA errors
 	 */
@@ -303,6 +306,9 @@ enum vb2_return_code {
 	/* No signature matching key ID */
 	VB2_ERROR_KEYBLOCK_SIG_ID,
 
+	/* Work buffer too small for a copy of the keyblock signature */
+	VB2_ERROR_KEYBLOCK_WORKBUF_SIG,
+
 	/**********************************************************************
 	 * Preamble verification errors (all in vb2_verify_preamble())
 	 */
@@ -350,6 +356,15 @@ enum vb2_return_code {
 	/* Vmlinuz header outside signed portion of body */
 	VB2_ERROR_PREAMBLE_VMLINUZ_HEADER_OUTSIDE,
 
+	/* Table of body chunk digests outside signed data */
+	VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE,
+
+	/* Table of kernel body chunk digests is the wrong size */
+	VB2_ERROR_PREAMBLE_BODY_CHUNKS_SIZE,
+
+	/* Unknown kernel body compression */
+	VB2_ERROR_PREAMBLE_BODY_COMPRESSION,
+
 	/**********************************************************************
 	 * Misc higher-level code errors
 	 */
@@ -509,6 +524,12 @@ enum vb2_return_code {
 	/* Invalid parameter */
 	VB2_ERROR_INVALID_PARAMETER,
 
+	/* Warm boot record is from another boot or slot */
+	VB2_ERROR_FW_WARM_BOOT_STALE,
+
+	/* Firmware doesn't match the warm boot record */
+	VB2_ERROR_FW_WARM_BOOT_MISMATCH,
+
 	/**********************************************************************
 	 * API-level errors
 	 */
@@ -592,6 +613,27 @@ enum vb2_return_code {
 	/* Digest buffer passed into vb2api_check_hash incorrect. */
 	VB2_ERROR_API_CHECK_DIGEST_SIZE,
 
+	/* Table of body chunk digests is the wrong size in vb2api_init_hash() */
+	VB2_ERROR_API_INIT_HASH_CHUNKS,
+
+	/* Body chunk doesn't match its digest in vb2api_extend_hash() */
+	VB2_ERROR_API_EXTEND_HASH_CHUNK,
+
+	/*
+	 * Body isn't hashed in chunks, in vb2api_get_body_chunks() or
+	 * vb2api_get_kernel_body_chunks()
+	 */
+	VB2_ERROR_API_BODY_NOT_CHUNKED,
+
+	/* Chunk index too big in vb2api_check_[kernel_]body_chunk() */
+	VB2_ERROR_API_BODY_CHUNK_INDEX,
+
+	/* Chunk is the wrong size in vb2api_check_[kernel_]body_chunk() */
+	VB2_ERROR_API_BODY_CHUNK_SIZE,
+
+	/* Chunk doesn't match its digest in vb2api_check_[kernel_]body_chunk() */
+	VB2_ERROR_API_BODY_CHUNK_DIGEST,
+
 	/**********************************************************************
 	 * Errors which may be generated by implementations of vb2ex functions.
 	 * Implementation may also return its own specific errors, which should
@@ -626,6 +668,26 @@ enum vb2_return_code {
 	/* vb2ex function is unimplemented (stubbed in 2lib/2stub.c) */
 	VB2_ERROR_EX_UNIMPLEMENTED,
 
+	/**********************************************************************
+	 * LZ4 decompression errors
+	 */
+	VB2_ERROR_LZ4 = VB2_ERROR_BASE + 0x0b0000,
+
+	/* Decompressed data doesn't fit in the output buffer */
+	VB2_ERROR_LZ4_OUTPUT_SIZE,
+
+	/* Decompressing in place would overwrite input not yet decompressed */
+	VB2_ERROR_LZ4_OVERLAP,
+
+	/* Match offset is zero or before the start of the output */
+	VB2_ERROR_LZ4_OFFSET,
+
+	/* Compressed data ends in the middle of a sequence */
+	VB2_ERROR_LZ4_TRUNCATED,
+
+	/* Decompressed data is smaller than the output buffer */
+	VB2_ERROR_LZ4_SIZE,
+
 	/**********************************************************************
 	 * Errors generated by host library (non-firmware) start here.
 	 */
@@ -657,6 +719,18 @@ enum vb2_return_code {
 	/* Unable to convert string to struct vb_id */
 	VB2_ERROR_STR_TO_ID,
 
+	/* Unable to open file in vb2_map_file() */
+	VB2_ERROR_MAP_FILE_OPEN,
+
+	/* Bad size in vb2_map_file() */
+	VB2_ERROR_MAP_FILE_SIZE,
+
+	/* Unable to map data in vb2_map_file() */
+	VB2_ERROR_MAP_FILE_DATA,
+
+	/* Buffer too small for a slab in vb2_arena_init() */
+	VB2_ERROR_ARENA_INIT_SIZE,
+
 	/**********************************************************************
 	 * Errors generated by host library key functions
 	 */
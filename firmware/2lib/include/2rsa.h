@@ -11,6 +11,37 @@
 
 struct vb2_workbuf;
 
+/*
+ * Do the modular exponentiation in vb2_rsa_verify_digest() on 64-bit limbs
+ * with 128-bit intermediate products.  This needs a quarter as many inner
+ * loop multiplies as the 32-bit code, but requires compiler support for
+ * unsigned __int128, so it defaults to on only for 64-bit targets.  The key
+ * format is the same either way.
+ */
+#ifndef VB2_RSA_64BIT_LIMBS
+#ifdef __SIZEOF_INT128__
+#define VB2_RSA_64BIT_LIMBS 1
+#else
+#define VB2_RSA_64BIT_LIMBS 0
+#endif
+#endif
+
+/*
+ * Firmware which only ever verifies one kind of RSA key can set
+ * VB2_RSA_FIXED_BITS (e.g. 4096) and VB2_RSA_FIXED_EXP (65537 or 3).  The
+ * modular exponentiation is then built for that key size and exponent only,
+ * with constant loop bounds the compiler can unroll, and
+ * vb2_rsa_verify_digest() rejects any other key.  Together with the
+ * VB2_SUPPORT_SHA* knobs in 2sha.h, this leaves just the one verification
+ * path in the build.
+ */
+#ifndef VB2_RSA_FIXED_BITS
+#define VB2_RSA_FIXED_BITS 0
+#endif
+#ifndef VB2_RSA_FIXED_EXP
+#define VB2_RSA_FIXED_EXP 65537
+#endif
+
 /* Public key structure in RAM */
 struct vb2_public_key {
 	uint32_t arrsize;    /* Length of n[] and rr[] in number of uint32_t */
@@ -22,6 +53,8 @@ struct vb2_public_key {
 	const char *desc;			/* Description */
 	uint32_t version;			/* Key version */
 	const struct vb2_id *id;		/* Key ID */
+	/* Try vb2ex_hwcrypto_rsa_verify_digest() first; unpacking clears it */
+	int allow_hwcrypto;
 };
 
 /**
@@ -27,6 +27,14 @@
 #define VB2_SUPPORT_SHA512 1
 #endif
 
+/*
+ * Host builds may use CPU-specific instructions (chosen at runtime) for the
+ * SHA block transforms.  Firmware builds always use the portable code.
+ */
+#ifndef VB2_SHA_ACCEL
+#define VB2_SHA_ACCEL 0
+#endif
+
 /* These are set to the biggest values among the supported hash algorithms.
  * They have to be updated as we add new hash algorithms */
 #define VB2_MAX_DIGEST_SIZE	VB2_SHA512_DIGEST_SIZE
@@ -56,26 +64,47 @@ struct vb2_sha1_context {
 #define VB2_SHA256_BLOCK_SIZE 64
 #define VB2_SHA256_ALG_NAME	"SHA256"
 
+/*
+ * The block buffer comes first, so it's as aligned as the context is; a
+ * context at the start of a workbuf allocation has it 64-byte aligned on
+ * hosts whose biggest alignment is that much.  Whole blocks of input are
+ * hashed straight from the caller's buffer, so it only ever holds a
+ * partial block, or the padding.
+ */
 struct vb2_sha256_context {
+	uint8_t block[2 * VB2_SHA256_BLOCK_SIZE];
 	uint32_t h[8];
 	uint32_t total_size;
 	uint32_t size;
-	uint8_t block[2 * VB2_SHA256_BLOCK_SIZE];
 };
 
 #define VB2_SHA512_DIGEST_SIZE 64
 #define VB2_SHA512_BLOCK_SIZE 128
 #define VB2_SHA512_ALG_NAME	"SHA512"
 
+/* Laid out like struct vb2_sha256_context */
 struct vb2_sha512_context {
+	uint8_t block[2 * VB2_SHA512_BLOCK_SIZE];
 	uint64_t h[8];
 	uint32_t total_size;
 	uint32_t size;
-	uint8_t block[2 * VB2_SHA512_BLOCK_SIZE];
 };
 
-/* Hash algorithm independent digest context; includes all of the above. */
+/*
+ * Hash algorithm independent digest context; includes all of the above.
+ *
+ * The context for the algorithm comes last, so a digest context for an
+ * algorithm with a smaller context can be allocated smaller; see
+ * vb2_digest_context_size().  That leaves the block buffers 8-byte aligned,
+ * which is plenty for the byte-at-a-time loads the transforms do.
+ */
 struct vb2_digest_context {
+	/* Current hash algorithm */
+	enum vb2_hash_algorithm hash_alg;
+
+	/* 1 if digest is computed with vb2ex_hwcrypto routines, else 0 */
+	int using_hwcrypto;
+
 	/* Context union for all algorithms */
 	union {
 #if VB2_SUPPORT_SHA1
@@ -88,12 +117,6 @@ struct vb2_digest_context {
 		struct vb2_sha512_context sha512;
 #endif
 	};
-
-	/* Current hash algorithm */
-	enum vb2_hash_algorithm hash_alg;
-
-	/* 1 if digest is computed with vb2ex_hwcrypto routines, else 0 */
-	int using_hwcrypto;
 };
 
 /**
@@ -177,6 +200,21 @@ int vb2_hash_block_size(enum vb2_hash_algorithm alg);
  */
 const char *vb2_get_hash_algorithm_name(enum vb2_hash_algorithm alg);
 
+/**
+ * Return the size of a digest context for a hash algorithm.
+ *
+ * A digest context only has to be this big to be used with this algorithm,
+ * which may be much less than sizeof(struct vb2_digest_context); SHA-256 needs
+ * less than half the room SHA-512 does.  Callers which know the algorithm
+ * before allocating the context from a work buffer should allocate this much.
+ * For an algorithm this build doesn't support, it is only big enough for
+ * vb2_digest_init() to fail, or for the vb2ex_hwcrypto routines to be used.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return The size of the context in bytes.
+ */
+uint32_t vb2_digest_context_size(enum vb2_hash_algorithm hash_alg);
+
 /**
  * Initialize a digest context for doing block-style digesting.
  *
@@ -229,4 +267,86 @@ int vb2_digest_buffer(const uint8_t *buf,
 		      uint8_t *digest,
 		      uint32_t digest_size);
 
+/**
+ * Calculate the digests of several independent buffers.
+ *
+ * The result is the same as calling vb2_digest_buffer() on each buffer in
+ * turn, but host builds may hash several buffers at once in the lanes of the
+ * CPU's vector unit, which is much faster for many small or medium buffers.
+ *
+ * @param count		Number of buffers
+ * @param bufs		Data to hash, one pointer per buffer
+ * @param sizes		Length of each buffer in bytes
+ * @param hash_alg	Hash algorithm
+ * @param digests	Destination for each buffer's digest
+ * @param digest_size	Length of each digest buffer in bytes.
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+int vb2_digest_buffers(uint32_t count,
+		       const uint8_t *const bufs[],
+		       const uint32_t sizes[],
+		       enum vb2_hash_algorithm hash_alg,
+		       uint8_t *const digests[],
+		       uint32_t digest_size);
+
+#if VB2_SHA_ACCEL
+/**
+ * Enable or disable CPU-accelerated SHA transforms.
+ *
+ * Acceleration is enabled by default whenever the CPU supports it.  This is
+ * mostly useful for testing and benchmarking the portable implementation.
+ *
+ * @param enable	Non-zero to use accelerated transforms when available
+ */
+void vb2_sha_accel_enable(int enable);
+
+/**
+ * Return the name of the block transform currently used for a hash algorithm.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return A short implementation name, such as "SHA-NI" or "AVX2", or
+ * "portable" if the generic C code is used.
+ */
+const char *vb2_sha_impl_name(enum vb2_hash_algorithm hash_alg);
+
+/**
+ * Force a specific block transform for a hash algorithm.
+ *
+ * This overrides the automatic choice made for the CPU, so that tests can
+ * check every implementation the CPU supports.
+ *
+ * @param hash_alg	Hash algorithm
+ * @param name		Implementation name, as returned by
+ *			vb2_sha_impl_name(), or NULL to go back to the
+ *			automatic choice.
+ * @return VB2_SUCCESS, or non-zero if the implementation is unknown or not
+ * supported by this CPU.
+ */
+int vb2_sha_impl_select(enum vb2_hash_algorithm hash_alg, const char *name);
+
+/**
+ * Return the name of the multi-buffer code vb2_digest_buffers() uses.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return A short implementation name, such as "AVX2", or "portable" if the
+ * buffers are hashed one at a time.
+ */
+const char *vb2_sha_multi_impl_name(enum vb2_hash_algorithm hash_alg);
+
+/**
+ * Force a specific multi-buffer implementation for a hash algorithm.
+ *
+ * Like vb2_sha_impl_select(), for the code vb2_digest_buffers() uses.
+ *
+ * @param hash_alg	Hash algorithm
+ * @param name		Implementation name, as returned by
+ *			vb2_sha_multi_impl_name(), or NULL to go back to the
+ *			automatic choice.
+ * @return VB2_SUCCESS, or non-zero if the implementation is unknown or not
+ * supported by this CPU.
+ */
+int vb2_sha_multi_impl_select(enum vb2_hash_algorithm hash_alg,
+			      const char *name);
+#endif
+
 #endif  /* VBOOT_REFERENCE_2SHA_H_ */
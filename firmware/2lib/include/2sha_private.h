@@ -0,0 +1,88 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Private declarations shared between the portable SHA implementations and
+ * the CPU-accelerated transforms used by host builds.  Not for use outside
+ * firmware/2lib.
+ */
+
+#ifndef VBOOT_REFERENCE_2SHA_PRIVATE_H_
+#define VBOOT_REFERENCE_2SHA_PRIVATE_H_
+
+#include "2sha.h"
+
+/* Round constants */
+extern const uint32_t vb2_sha256_k[64];
+extern const uint64_t vb2_sha512_k[80];
+
+/**
+ * Block transform for SHA-1.
+ *
+ * @param h		Hash state (5 words), updated in place
+ * @param data		Data to hash; must be block_nb * VB2_SHA1_BLOCK_SIZE
+ *			bytes long.
+ * @param block_nb	Number of blocks to hash
+ */
+typedef void (*vb2_sha1_transform_fn)(uint32_t *h,
+				      const uint8_t *data,
+				      uint32_t block_nb);
+
+/**
+ * Block transform for SHA-256.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param data		Data to hash; must be block_nb * VB2_SHA256_BLOCK_SIZE
+ *			bytes long.
+ * @param block_nb	Number of blocks to hash
+ */
+typedef void (*vb2_sha256_transform_fn)(uint32_t *h,
+					const uint8_t *data,
+					uint32_t block_nb);
+
+/**
+ * Block transform for SHA-512.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param data		Data to hash; must be block_nb * VB2_SHA512_BLOCK_SIZE
+ *			bytes long.
+ * @param block_nb	Number of blocks to hash
+ */
+typedef void (*vb2_sha512_transform_fn)(uint64_t *h,
+					const uint8_t *data,
+					uint32_t block_nb);
+
+#if VB2_SHA_ACCEL
+/**
+ * Return the accelerated block transform for this CPU.
+ *
+ * The CPU is probed on the first call and the fastest supported
+ * implementation is cached, unless one was picked with vb2_sha_impl_select().
+ *
+ * @return The transform, or NULL if no accelerated implementation is
+ * available (or acceleration has been disabled with vb2_sha_accel_enable()),
+ * in which case the caller should use the portable implementation.
+ */
+vb2_sha1_transform_fn vb2_sha1_accel_transform(void);
+vb2_sha256_transform_fn vb2_sha256_accel_transform(void);
+vb2_sha512_transform_fn vb2_sha512_accel_transform(void);
+
+/**
+ * Calculate the SHA-256 digests of several buffers in vector lanes.
+ *
+ * @param count		Number of buffers
+ * @param bufs		Data to hash, one pointer per buffer
+ * @param sizes		Length of each buffer in bytes
+ * @param digests	Destination for each digest; each must be at least
+ *			VB2_SHA256_DIGEST_SIZE bytes.
+ * @return VB2_SUCCESS, or VB2_ERROR_SHA_IMPL_UNSUPPORTED if there is no
+ * multi-buffer code for this CPU (or acceleration has been disabled), in
+ * which case the caller should hash the buffers one at a time.
+ */
+int vb2_sha256_accel_buffers(uint32_t count,
+			     const uint8_t *const bufs[],
+			     const uint32_t sizes[],
+			     uint8_t *const digests[]);
+#endif
+
+#endif  /* VBOOT_REFERENCE_2SHA_PRIVATE_H_ */
@@ -18,6 +18,7 @@
 #include "2constants.h"
 #include "2crypto.h"
 #include "2sysincludes.h"
+#include "2trace.h"
 
 /*
  * Key block flags.
@@ -78,14 +79,56 @@ enum vb2_shared_data_status {
 
 	/* Secure data kernel version space initialized */
 	VB2_SD_STATUS_SECDATAK_INIT = (1 << 4),
+
+	/*
+	 * Firmware keyblock (and preamble, once loaded) match this power
+	 * cycle's warm boot record, so their signatures weren't checked.
+	 */
+	VB2_SD_STATUS_WARM_BOOT_MATCH = (1 << 5),
+};
+
+/* Parts of verification whose work buffer use is tracked separately */
+enum vb2_workbuf_phase {
+	/* Anything not in one of the phases below */
+	VB2_WORKBUF_PHASE_OTHER = 0,
+
+	/* Loading and verifying the firmware keyblock */
+	VB2_WORKBUF_PHASE_FW_KEYBLOCK = 1,
+
+	/* Loading and verifying the firmware preamble */
+	VB2_WORKBUF_PHASE_FW_PREAMBLE = 2,
+
+	/* Hashing the firmware body */
+	VB2_WORKBUF_PHASE_FW_HASH = 3,
+
+	/* Loading and verifying a kernel keyblock and preamble */
+	VB2_WORKBUF_PHASE_KERNEL_VBLOCK = 4,
+
+	/* Number of phases */
+	VB2_WORKBUF_PHASE_COUNT
 };
 
+/*
+ * Most of the work buffer in use at once, in bytes from the start of the
+ * work buffer.  See vb2_set_workbuf_phase().
+ */
+struct vb2_workbuf_stats {
+	/* Since the context was initialized */
+	uint32_t peak;
+
+	/* Phase currently running (enum vb2_workbuf_phase) */
+	uint32_t phase;
+
+	/* While each phase was running */
+	uint32_t phase_peak[VB2_WORKBUF_PHASE_COUNT];
+} __attribute__((packed));
+
 /* "V2SD" = vb2_shared_data.magic */
 #define VB2_SHARED_DATA_MAGIC 0x44533256
 
 /* Current version of vb2_shared_data struct */
 #define VB2_SHARED_DATA_VERSION_MAJOR 1
-#define VB2_SHARED_DATA_VERSION_MINOR 0
+#define VB2_SHARED_DATA_VERSION_MINOR 5
 
 /*
  * Data shared between vboot API calls.  Stored at the start of the work
@@ -224,6 +267,66 @@ struct vb2_shared_data {
 	 */
 	uint32_t workbuf_kernel_key_offset;
 	uint32_t workbuf_kernel_key_size;
+
+	/**********************************************************************
+	 * Fields added in version 1.1.
+	 */
+
+#if VB2_BOOT_TRACE
+	/*
+	 * Boot trace; see vb2_trace().  Entry N is stored at trace[N %
+	 * VB2_TRACE_ENTRIES], so once trace_count is larger than the ring,
+	 * the oldest entries have been overwritten.  Only there if the
+	 * firmware is built with VB2_BOOT_TRACE.
+	 */
+	uint32_t trace_count;
+	struct vb2_trace_entry trace[VB2_TRACE_ENTRIES];
+#endif
+
+	/**********************************************************************
+	 * Fields added in version 1.2.
+	 */
+
+	/* Work buffer high-water marks */
+	struct vb2_workbuf_stats workbuf_stats;
+
+	/**********************************************************************
+	 * Fields added in version 1.3.
+	 */
+
+	/*
+	 * Chunk size if the data being hashed is checked one chunk at a time
+	 * against a table of chunk digests, or 0 if it is hashed as a whole.
+	 */
+	uint32_t hash_chunk_size;
+
+	/* Offset of the table of chunk digests in the work buffer */
+	uint32_t workbuf_hash_chunks_offset;
+
+	/* Index of the chunk being hashed, and how much of it is left */
+	uint32_t hash_chunk_index;
+	uint32_t hash_chunk_remaining_size;
+
+	/**********************************************************************
+	 * Fields added in version 1.4.
+	 */
+
+	/*
+	 * Digests of the firmware vblock for the warm boot record, if the
+	 * caller set VB2_CONTEXT_WARM_BOOT_RECORD.
+	 */
+	uint8_t warm_boot_keyblock_digest[32];
+	uint8_t warm_boot_preamble_digest[32];
+
+	/**********************************************************************
+	 * Fields added in version 1.5.
+	 */
+
+	/* Cost of each verification step; see vb2_cost_add() */
+	struct vb2_cost costs[VB2_COST_ENTRIES];
+
+	/* When vb2api_init_hash() started the current hash, from vb2ex_utime() */
+	uint32_t hash_start_us;
 } __attribute__((packed));
 
 /****************************************************************************/
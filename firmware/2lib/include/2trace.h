@@ -0,0 +1,255 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Boot-time trace events for verified boot
+ */
+
+#ifndef VBOOT_REFERENCE_VBOOT_2TRACE_H_
+#define VBOOT_REFERENCE_VBOOT_2TRACE_H_
+#include <stdint.h>
+
+/*
+ * Things timed by the boot trace.  Each one is recorded as a begin and an end
+ * event; see vb2_trace().
+ *
+ * These are passed up to the OS in VbSharedDataHeader, so only add new events
+ * at the end, and never renumber existing ones.
+ */
+enum vb2_trace_event {
+	/* Invalid event; never recorded */
+	VB2_TRACE_INVALID = 0,
+
+	/* Reading the GBB header */
+	VB2_TRACE_GBB_READ = 1,
+
+	/* Verifying a firmware or kernel keyblock */
+	VB2_TRACE_KEYBLOCK_VERIFY = 2,
+
+	/* Verifying a firmware or kernel preamble */
+	VB2_TRACE_PREAMBLE_VERIFY = 3,
+
+	/* Hashing a firmware or kernel body */
+	VB2_TRACE_BODY_HASH = 4,
+
+	/* Checking a body signature against its digest */
+	VB2_TRACE_RSA = 5,
+
+	/* Reading, writing or locking a TPM space */
+	VB2_TRACE_TPM_COMMAND = 6,
+
+	/* Reading from the boot disk */
+	VB2_TRACE_DISK_READ = 7,
+
+	/* Checking a kernel keyblock hash, for a self-signed kernel */
+	VB2_TRACE_KEYBLOCK_HASH = 8,
+
+	/* Checking a kernel vblock for cheap reasons to reject it */
+	VB2_TRACE_VBLOCK_EARLY_CHECK = 9,
+
+	/* Number of events; not an event itself */
+	VB2_TRACE_EVENT_COUNT
+};
+
+/* Values for vb2_trace_entry.type */
+enum vb2_trace_type {
+	VB2_TRACE_BEGIN = 1,
+	VB2_TRACE_END = 2,
+};
+
+/* One entry in the trace ring */
+struct vb2_trace_entry {
+	/* Time of the event, from vb2ex_utime() */
+	uint32_t time_us;
+
+	/* What happened (enum vb2_trace_event) */
+	uint16_t event;
+
+	/* Whether it began or ended (enum vb2_trace_type) */
+	uint16_t type;
+} __attribute__((packed));
+
+/*
+ * Set to 1 to keep the trace ring in vb2_shared_data.  It adds over 500 bytes
+ * to the shared data, so it is left out unless asked for, and vb2_trace()
+ * does nothing.
+ */
+#ifndef VB2_BOOT_TRACE
+#define VB2_BOOT_TRACE 0
+#endif
+
+/*
+ * Number of entries in the trace ring.  Must be a power of 2.  This is enough
+ * for firmware verification plus loading a couple of kernel partitions; after
+ * that the oldest entries are overwritten.
+ */
+#define VB2_TRACE_ENTRIES 64
+
+/*
+ * Verification steps whose cost is added up in vb2_shared_data.costs[], by
+ * index.  These are passed up to the OS in VbSharedDataHeader, so only add new
+ * steps at the end, and never renumber existing ones.
+ */
+enum vb2_cost_step {
+	/* vb2_load_fw_keyblock() */
+	VB2_COST_FW_KEYBLOCK = 0,
+
+	/* vb2_load_fw_preamble() */
+	VB2_COST_FW_PREAMBLE = 1,
+
+	/* vb2api_init_hash() through vb2api_check_hash() */
+	VB2_COST_FW_BODY = 2,
+
+	/* vb2_load_kernel_keyblock() */
+	VB2_COST_KERNEL_KEYBLOCK = 3,
+
+	/* vb2_load_kernel_preamble() */
+	VB2_COST_KERNEL_PREAMBLE = 4,
+
+	/* Number of steps; not a step itself */
+	VB2_COST_STEP_COUNT
+};
+
+/*
+ * What one verification step has cost this boot, over every time it was done.
+ * Time not spent hashing or checking signatures is mostly spent reading from
+ * storage.
+ */
+struct vb2_cost {
+	/* Number of times the step was done */
+	uint32_t count;
+
+	/* Time taken, and how much of it went on hashing and signatures */
+	uint32_t total_us;
+	uint32_t crypto_us;
+
+	/* Bytes hashed */
+	uint32_t hashed_bytes;
+} __attribute__((packed));
+
+/* Number of entries in the cost table; room for more steps later */
+#define VB2_COST_ENTRIES 8
+
+/*
+ * Boundaries between boot phases, passed to vb2ex_timestamp().  The name after
+ * each ID is what a platform should show for it, for example in coreboot's
+ * "cbmem -t" table.
+ *
+ * IDs start at VB2_TIMESTAMP_BASE, above the ones coreboot and depthcharge
+ * define for themselves, so platforms can record them in the same table
+ * unchanged.  Only add new IDs at the end, and never renumber existing ones.
+ */
+#define VB2_TIMESTAMP_BASE 5000
+
+enum vb2_timestamp_id {
+	/* "vb2 phase1 start" / "vb2 phase1 end" */
+	VB2_TS_FW_PHASE1_START = VB2_TIMESTAMP_BASE,
+	VB2_TS_FW_PHASE1_END = VB2_TIMESTAMP_BASE + 1,
+
+	/* "vb2 phase2 start" / "vb2 phase2 end" */
+	VB2_TS_FW_PHASE2_START = VB2_TIMESTAMP_BASE + 2,
+	VB2_TS_FW_PHASE2_END = VB2_TIMESTAMP_BASE + 3,
+
+	/* "vb2 phase3 start" / "vb2 phase3 end" */
+	VB2_TS_FW_PHASE3_START = VB2_TIMESTAMP_BASE + 4,
+	VB2_TS_FW_PHASE3_END = VB2_TIMESTAMP_BASE + 5,
+
+	/* "fw keyblock verified" */
+	VB2_TS_FW_KEYBLOCK_VERIFIED = VB2_TIMESTAMP_BASE + 6,
+
+	/* "fw preamble verified" */
+	VB2_TS_FW_PREAMBLE_VERIFIED = VB2_TIMESTAMP_BASE + 7,
+
+	/* "fw body hash start" / "fw body hashed" */
+	VB2_TS_FW_BODY_HASH_START = VB2_TIMESTAMP_BASE + 8,
+	VB2_TS_FW_BODY_HASHED = VB2_TIMESTAMP_BASE + 9,
+
+	/* "fw body verified" */
+	VB2_TS_FW_BODY_VERIFIED = VB2_TIMESTAMP_BASE + 10,
+
+	/* "vb2 kernel phase1 start" / "vb2 kernel phase1 end" */
+	VB2_TS_KERNEL_PHASE1_START = VB2_TIMESTAMP_BASE + 11,
+	VB2_TS_KERNEL_PHASE1_END = VB2_TIMESTAMP_BASE + 12,
+
+	/* "select and load kernel start" / "select and load kernel end" */
+	VB2_TS_SELECT_AND_LOAD_KERNEL_START = VB2_TIMESTAMP_BASE + 13,
+	VB2_TS_SELECT_AND_LOAD_KERNEL_END = VB2_TIMESTAMP_BASE + 14,
+
+	/* "ec sync done" */
+	VB2_TS_EC_SYNC_DONE = VB2_TIMESTAMP_BASE + 15,
+
+	/* "kernel vblock verified"; once per kernel partition loaded */
+	VB2_TS_KERNEL_VBLOCK_VERIFIED = VB2_TIMESTAMP_BASE + 16,
+
+	/* "kernel body hashed"; once per kernel partition loaded */
+	VB2_TS_KERNEL_BODY_HASHED = VB2_TIMESTAMP_BASE + 17,
+
+	/* "kernel body verified"; once per kernel partition loaded */
+	VB2_TS_KERNEL_BODY_VERIFIED = VB2_TIMESTAMP_BASE + 18,
+};
+
+/*
+ * Commands sent to the TPM with one command code.  The library keeps a table
+ * of these; see TlclGetStats().
+ */
+struct vb2_tpm_stat {
+	/* TPM command code (ordinal) */
+	uint32_t command_code;
+
+	/* Number of commands sent, and how many of those failed */
+	uint16_t count;
+	uint16_t errors;
+
+	/* Total and longest time taken, in VbExGetTimer() units */
+	uint64_t total_time;
+	uint64_t max_time;
+} __attribute__((packed));
+
+/*
+ * Number of command codes in the table.  Firmware only sends a handful;
+ * commands with codes beyond that are not counted.
+ */
+#define VB2_TPM_STAT_ENTRIES 12
+
+/*
+ * What a disk read was for, in vb2_disk_read.purpose.  These are passed up to
+ * the OS in VbSharedDataHeader, so never renumber existing ones.
+ */
+enum vb2_disk_read_purpose {
+	VB2_DISK_READ_OTHER = 0,
+	/* Primary GPT header or entries */
+	VB2_DISK_READ_GPT_PRIMARY = 1,
+	/* Secondary GPT header or entries */
+	VB2_DISK_READ_GPT_SECONDARY = 2,
+	/* Start of a kernel partition, holding its vblock */
+	VB2_DISK_READ_VBLOCK = 3,
+	/* Rest of a kernel body */
+	VB2_DISK_READ_BODY = 4,
+};
+
+/*
+ * Disk reads made by LoadKernel().  Reads which carry on where the previous
+ * one stopped, for the same purpose, are merged into one entry.
+ */
+struct vb2_disk_read {
+	/* First sector read, and number of sectors */
+	uint64_t lba_start;
+	uint32_t lba_count;
+
+	/* LoadKernel() call, as an index into VbSharedDataHeader.lk_calls */
+	uint8_t lk_call;
+
+	/* What the read was for (enum vb2_disk_read_purpose) */
+	uint8_t purpose;
+
+	/* Number of read requests merged into this entry */
+	uint16_t requests;
+} __attribute__((packed));
+
+/*
+ * Number of entries in the disk read trace.  One LoadKernel() call usually
+ * takes four or five after merging.
+ */
+#define VB2_DISK_READ_ENTRIES 16
+
+#endif /* VBOOT_REFERENCE_VBOOT_2TRACE_H_ */
@@ -327,9 +327,9 @@ const struct bdb_sig *bdb_get_data_sig(const void *buf)
 
 /*****************************************************************************/
 
-static int bdb_verify_sig(const struct bdb_key *key,
-			  const struct bdb_sig *sig,
-			  const uint8_t *digest)
+int bdb_verify_sig(const struct bdb_key *key,
+		   const struct bdb_sig *sig,
+		   const uint8_t *digest)
 {
 	/* Key and signature algorithms must match */
 	if (key->sig_alg != sig->sig_alg)
@@ -363,9 +363,17 @@ int bdb_verify(const void *buf, size_t size, const uint8_t *bdb_key_digest)
 	const struct bdb_sig *sig;
 	const struct bdb_data *data;
 	const void *oem;
+	struct vb2_sha256_context sha;
 	uint8_t digest[BDB_SHA256_DIGEST_SIZE];
 	int bdb_digest_mismatch = -1;
 
+	/*
+	 * Everything below is done in a single pass from the start of the
+	 * buffer to the end.  Each struct is checked just before it's hashed,
+	 * so each byte is read from (possibly slow, XIP) flash once and then
+	 * hashed while it's still in cache.
+	 */
+
 	/* Make sure buffer doesn't wrap around address space */
 	if (end < (const uint8_t *)buf)
 		return BDB_ERROR_BUF_SIZE;
@@ -384,19 +392,22 @@ int bdb_verify(const void *buf, size_t size, const uint8_t *bdb_key_digest)
 		return BDB_ERROR_BDBKEY;
 
 	/* Calculate BDB key digest and compare with expected */
-	if (vb2_digest_buffer((uint8_t *)bdbkey, bdbkey->struct_size,
-			      VB2_HASH_SHA256, digest, BDB_SHA256_DIGEST_SIZE))
-		return BDB_ERROR_DIGEST;
+	vb2_sha256_init(&sha);
+	vb2_sha256_update(&sha, (const uint8_t *)bdbkey, bdbkey->struct_size);
+	vb2_sha256_finalize(&sha, digest);
 
 	if (bdb_key_digest)
 		bdb_digest_mismatch = memcmp(digest,
 					     bdb_key_digest, sizeof(digest));
 
-	/* Make sure OEM area 0 fits */
+	/* Make sure OEM area 0 fits, then start the header digest with it */
 	oem = bdb_get_oem_area_0(buf);
 	if (h->oem_area_0_size > end - (const uint8_t *)oem)
 		return BDB_ERROR_OEM_AREA_0;
 
+	vb2_sha256_init(&sha);
+	vb2_sha256_update(&sha, oem, h->oem_area_0_size);
+
 	/* Sanity-check datakey */
 	datakey = bdb_get_datakey(buf);
 	if (bdb_check_key(datakey, end - (const uint8_t *)datakey))
@@ -407,7 +418,12 @@ int bdb_verify(const void *buf, size_t size, const uint8_t *bdb_key_digest)
 	    h->signed_size > end - (const uint8_t *)oem)
 		return BDB_ERROR_BDB_SIGNED_SIZE;
 
-	/* Sanity-check header signature */
+	/* Finish the header digest with the datakey and the rest */
+	vb2_sha256_update(&sha, (const uint8_t *)datakey,
+			  h->signed_size - h->oem_area_0_size);
+	vb2_sha256_finalize(&sha, digest);
+
+	/* Sanity-check header signature, which follows the signed data */
 	sig = bdb_get_header_sig(buf);
 	if (bdb_check_sig(sig, end - (const uint8_t *)sig))
 		return BDB_ERROR_HEADER_SIG;
@@ -416,10 +432,6 @@ int bdb_verify(const void *buf, size_t size, const uint8_t *bdb_key_digest)
 	if (sig->signed_size != h->signed_size)
 		return BDB_ERROR_HEADER_SIG;
 
-	/* Calculate header digest and compare with expected signature */
-	if (vb2_digest_buffer((uint8_t *)oem, h->signed_size,
-			      VB2_HASH_SHA256, digest, BDB_SHA256_DIGEST_SIZE))
-		return BDB_ERROR_DIGEST;
 	if (bdb_verify_sig(bdbkey, sig, digest))
 		return BDB_ERROR_HEADER_SIG;
 
@@ -431,17 +443,18 @@ int bdb_verify(const void *buf, size_t size, const uint8_t *bdb_key_digest)
 	if (bdb_check_data(data, end - (const uint8_t *)data))
 		return BDB_ERROR_DATA;
 
-	/* Sanity-check data signature */
+	/* Calculate data digest */
+	vb2_sha256_init(&sha);
+	vb2_sha256_update(&sha, (const uint8_t *)data, data->signed_size);
+	vb2_sha256_finalize(&sha, digest);
+
+	/* Sanity-check data signature, which follows the signed data */
 	sig = bdb_get_data_sig(buf);
 	if (bdb_check_sig(sig, end - (const uint8_t *)sig))
 		return BDB_ERROR_DATA_CHECK_SIG;
 	if (sig->signed_size != data->signed_size)
 		return BDB_ERROR_DATA_SIGNED_SIZE;
 
-	/* Calculate data digest and compare with expected signature */
-	if (vb2_digest_buffer((uint8_t *)data, data->signed_size,
-			      VB2_HASH_SHA256, digest, BDB_SHA256_DIGEST_SIZE))
-		return BDB_ERROR_DIGEST;
 	if (bdb_verify_sig(datakey, sig, digest))
 		return BDB_ERROR_DATA_SIG;
 
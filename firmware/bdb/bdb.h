@@ -121,6 +121,19 @@ int bdb_check_key(const struct bdb_key *p, size_t size);
 int bdb_check_sig(const struct bdb_sig *p, size_t size);
 int bdb_check_data(const struct bdb_data *p, size_t size);
 
+/**
+ * Verify a signature against the digest of the data it signed
+ *
+ * @param key		Key to verify with, already sanity-checked
+ * @param sig		Signature to verify, already sanity-checked
+ * @param digest	SHA-256 digest of the signed data.  Must be
+ *			BDB_SHA256_DIGEST_SIZE bytes long.
+ * @return 0 if success, non-zero error code if error.
+ */
+int bdb_verify_sig(const struct bdb_key *key,
+		   const struct bdb_sig *sig,
+		   const uint8_t *digest);
+
 /**
  * Verify the entire BDB
  *
@@ -218,6 +231,9 @@ int bdb_rsa3072b_verify(const uint8_t *key_data,
 /**
  * Verify a ECDSA-521 signed digest
  *
+ * Key data is the public point as x then y, and the signature is r then s.
+ * Each is a big endian number of BDB_ECDSA521_SIG_SIZE / 2 bytes.
+ *
  * @param key_data	Key data to use (BDB_ECDSA521_KEY_DATA_SIZE bytes)
  * @param sig_data	Signature to verify (BDB_ECDSA521_SIG_SIZE bytes)
  * @param digest	Digest of signed data (BDB_SHA256_DIGEST bytes)
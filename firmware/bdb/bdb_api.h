@@ -40,6 +40,9 @@ int vba_bdb_init(struct vba_context *ctx);
 /**
  * Finalize vboot process
  *
+ * Marks the current slot good, and writes the NVM-RW updates made since
+ * vba_bdb_init (see nvmrw_flush).
+ *
  * @param ctx
  * @return	enum bdb_return_code
  */
@@ -59,7 +62,9 @@ void vba_bdb_fail(struct vba_context *ctx);
  * from an AP-RW after successful verification of a kernel.
  *
  * It checks whether the version in NVM-RW is older than the reported version
- * or not. If so, it updates the version in NVM-RW.
+ * or not. If so, it updates the version in NVM-RW. NVM-RW is read and
+ * verified on the first update of a boot, and the updates are written
+ * together by vba_bdb_finalize.
  *
  * @param ctx
  * @param kernel_data_key_version
@@ -73,6 +78,8 @@ int vba_update_kernel_version(struct vba_context *ctx,
 /**
  * Write new boot unlock code to NVM-RW
  *
+ * Like vba_update_kernel_version, this is written by vba_bdb_finalize.
+ *
  * @param ctx
  * @param new_buc	New BUC to be written
  * @return		BDB_SUCCESS or BDB_ERROR_*
@@ -12,4 +12,10 @@
 /* Indicate whether kernel data key is verified */
 #define VBA_CONTEXT_FLAG_KERNEL_DATA_KEY_VERIFIED	(1 << 1)
 
+/* Indicate whether NVM-RW has been read and verified into the context */
+#define VBA_CONTEXT_FLAG_NVMRW_VERIFIED			(1 << 2)
+
+/* Indicate whether NVM-RW in the context needs writing by nvmrw_flush() */
+#define VBA_CONTEXT_FLAG_NVMRW_DIRTY			(1 << 3)
+
 #endif
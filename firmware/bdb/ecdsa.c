@@ -1,17 +1,862 @@
-/* Copyright (c) 2015 The Chromium OS Authors. All rights reserved.
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  *
- * Boot descriptor block firmware ECDSA stub
+ * Boot descriptor block firmware ECDSA-521
+ *
+ * Verification only, so nothing here needs to be constant time; all the
+ * inputs are public.  Numbers are little endian arrays of 32-bit words, and
+ * points use Jacobian coordinates (x / z^2, y / z^3), with z = 0 for the
+ * point at infinity.  Everything lives on the stack, so this doesn't need a
+ * work buffer.
  */
 
-#include <string.h>
+#include "2sysincludes.h"
+#include "2common.h"
 #include "bdb.h"
 
+/* Words in a number mod p or n, and bytes in each half of a key or sig */
+#define EC_WORDS 17
+#define EC_BYTES 66
+
+/* Bits of each scalar used per addition */
+#define WINDOW_BITS 4
+#define WINDOW_SIZE (1 << WINDOW_BITS)
+
+/* Point in affine coordinates */
+struct ec_affine {
+	uint32_t x[EC_WORDS];
+	uint32_t y[EC_WORDS];
+};
+
+/* Point in Jacobian coordinates */
+struct ec_point {
+	uint32_t x[EC_WORDS];
+	uint32_t y[EC_WORDS];
+	uint32_t z[EC_WORDS];
+};
+
+/* Field prime p = 2^521 - 1 */
+static const uint32_t ec_p[EC_WORDS] = {
+	0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	0x000001ff,
+};
+
+/* Group order */
+static const uint32_t ec_n[EC_WORDS] = {
+	0x91386409, 0xbb6fb71e, 0x899c47ae, 0x3bb5c9b8,
+	0xf709a5d0, 0x7fcc0148, 0xbf2f966b, 0x51868783,
+	0xfffffffa, 0xffffffff, 0xffffffff, 0xffffffff,
+	0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	0x000001ff,
+};
+
+/* Curve is y^2 = x^3 - 3x + b */
+static const uint32_t ec_b[EC_WORDS] = {
+	0x6b503f00, 0xef451fd4, 0x3d2c34f1, 0x3573df88,
+	0x3bb1bf07, 0x1652c0bd, 0xec7e937b, 0x56193951,
+	0x8ef109e1, 0xb8b48991, 0x99b315f3, 0xa2da725b,
+	0xb68540ee, 0x929a21a0, 0x8e1c9a1f, 0x953eb961,
+	0x00000051,
+};
+
+/*
+ * 1 * G through 15 * G, for the base point G.  Kept as affine points in
+ * read-only data, so additions of G multiples are cheaper mixed additions and
+ * don't need a table built at runtime.
+ */
+static const struct ec_affine g_table[WINDOW_SIZE - 1] = {
+	{	/* 1 * G */
+		{
+			0xc2e5bd66, 0xf97e7e31, 0x856a429b, 0x3348b3c1,
+			0xa2ffa8de, 0xfe1dc127, 0xefe75928, 0xa14b5e77,
+			0x6b4d3dba, 0xf828af60, 0x053fb521, 0x9c648139,
+			0x2395b442, 0x9e3ecb66, 0x0404e9cd, 0x858e06b7,
+			0x000000c6,
+		},
+		{
+			0x9fd16650, 0x88be9476, 0xa272c240, 0x353c7086,
+			0x3fad0761, 0xc550b901, 0x5ef42640, 0x97ee7299,
+			0x273e662c, 0x17afbd17, 0x579b4468, 0x98f54449,
+			0x2c7d1bd9, 0x5c8a5fb4, 0x9a3bc004, 0x39296a78,
+			0x00000118,
+		},
+	},
+	{	/* 2 * G */
+		{
+			0xba6d783d, 0xf43e3933, 0xd60fd967, 0xcf2fa364,
+			0x35c5af41, 0xaa104a3a, 0x6ef55507, 0xb3b204da,
+			0xd769be97, 0x2c6e5505, 0x1ccc0635, 0x7403279b,
+			0x48c28274, 0x2fcb2881, 0x277e7e68, 0x3c219024,
+			0x00000043,
+		},
+		{
+			0x61f41b02, 0x1be356d6, 0xedc0f4f7, 0xeafcbe95,
+			0x9a3248f4, 0x93937fa9, 0x9f251f6b, 0xb3e377de,
+			0x06c42dbb, 0xab21a299, 0x4da97740, 0xc6b5107c,
+			0xeed3f0b5, 0xa7f3ecee, 0x6db26700, 0xbb8cc7f8,
+			0x000000f4,
+		},
+	},
+	{	/* 3 * G */
+		{
+			0xde37ad7d, 0xa5919d2e, 0x2c32ea05, 0xaeb49086,
+			0xb59fe21b, 0x1da6bd16, 0x3a483205, 0xad3f164a,
+			0x2d7a8dd1, 0xe5ad7a11, 0x123d9ab9, 0xb52a6e5b,
+			0xb5959479, 0xd91d6a64, 0xde29195d, 0x3d352443,
+			0x000001a7,
+		},
+		{
+			0xee86c0e5, 0x5f588ca1, 0x93a59042, 0xf105c9bc,
+			0xdec3c70c, 0x2d5aced1, 0x8dc575b0, 0x2e2dd4cf,
+			0xa355ceec, 0xd2f8ab1f, 0x2a9d0317, 0xf1557fa8,
+			0xcab814f2, 0x979f86c6, 0xfa62ddd9, 0x9b03b97d,
+			0x0000013e,
+		},
+	},
+	{	/* 4 * G */
+		{
+			0x871902f3, 0xfbc87412, 0x08e5a5e2, 0xa1d5025b,
+			0x078af066, 0xe8b88e9f, 0xfe3d0750, 0x8659e24a,
+			0x41d3ceac, 0x06c5d555, 0x5ff39afc, 0xc61c891c,
+			0x7c9070cd, 0x54b48348, 0x2ac204c3, 0xb5df64ae,
+			0x00000035,
+		},
+		{
+			0x346e4d0d, 0xe21f47fc, 0x4699d1d9, 0xbb7faef0,
+			0xa95b85ee, 0x5224f750, 0x4ba38540, 0x79f283e5,
+			0xf19907f2, 0x5ae63fe2, 0xe6e32e1b, 0x5521aef6,
+			0xb0b4abb6, 0x73e0178e, 0x1279d2b6, 0x096f8426,
+			0x00000082,
+		},
+	},
+	{	/* 5 * G */
+		{
+			0xec8f3078, 0xd5ab5096, 0xd8931738, 0x29d7e1e6,
+			0x137e79a3, 0x7112feaf, 0x5e301423, 0x383c0c6d,
+			0xf177ace4, 0xcf03dab8, 0xb53f0d24, 0x7a596efd,
+			0xc04eb0bf, 0x3dbc3391, 0x27a432c7, 0x2bf3c529,
+			0x00000065,
+		},
+		{
+			0xdeb090cb, 0x173cc3e8, 0x7354f7f8, 0xd1f00725,
+			0x1cf5ff79, 0x31154021, 0x072cf374, 0xbb6897c9,
+			0xa0347087, 0xedd817c9, 0x872e0051, 0x1cd8fe8e,
+			0x4a811291, 0x8a2b7311, 0x6601d6ec, 0xe6ef1bdd,
+			0x0000015b,
+		},
+	},
+	{	/* 6 * G */
+		{
+			0xf79206b9, 0x23731bed, 0x57f380ae, 0x2f66e956,
+			0x9531be8c, 0xe0727a23, 0x153f7394, 0x5fbcca16,
+			0xe4ab0152, 0x981506ad, 0x7fd71cf3, 0x623d3097,
+			0x4480d195, 0x2eff34f9, 0xb5921953, 0x4569d6cd,
+			0x000001ee,
+		},
+		{
+			0x58d44f17, 0x1eaccd78, 0x5ca0dade, 0x3dc7b8b5,
+			0xe274f220, 0xf96c984d, 0x56648c9d, 0xcab72d0e,
+			0x201a8a96, 0x7240a926, 0xda5a808e, 0x2aabbb73,
+			0x46e3b111, 0xe2dd2705, 0xc64f586a, 0x0255ad0c,
+			0x000001de,
+		},
+	},
+	{	/* 7 * G */
+		{
+			0x2816ecd4, 0x01cead88, 0xfdc2619a, 0x6f953f50,
+			0xdce3bbc4, 0xc9a6df30, 0xbfc698d8, 0x8c308d0a,
+			0xf7114c5d, 0xf018d2c2, 0xf5483228, 0x5f22e0e8,
+			0x0b073a0c, 0xeeb65fda, 0x5b7f6346, 0xd5d1d99d,
+			0x00000056,
+		},
+		{
+			0x0525251b, 0x5c6b8bc9, 0x5ddefc7b, 0x9e76712a,
+			0x91ce1a5f, 0x9523a345, 0xcdec9e2b, 0x6bd0f293,
+			0x26cbde55, 0x71dbd98a, 0x2824f0dd, 0xb5c582d0,
+			0x39d68478, 0xd1d8317a, 0xaaa2a110, 0x2d1b7d9b,
+			0x0000003d,
+		},
+	},
+	{	/* 8 * G */
+		{
+			0xaa78ce68, 0x86f9ea54, 0xa6f40405, 0xb56289b5,
+			0xc8d79e1a, 0x8b598c1b, 0x579f49f0, 0x5bfea5b8,
+			0xf826298f, 0x8b8a3b05, 0x9b003e0a, 0xd4e29d8a,
+			0xb010e25b, 0xa8348396, 0x301f7262, 0x22c40fb6,
+			0x00000008,
+		},
+		{
+			0x1f17801c, 0x8ad642f1, 0x09471353, 0x9f3ba940,
+			0x65c57869, 0xf0ba0df0, 0x5911b4bf, 0x89e9c0aa,
+			0x0677a8f1, 0x5083de61, 0xe2c0715b, 0x44f8ede9,
+			0x78853b9a, 0x48fdab6e, 0x42fc4820, 0x31911d55,
+			0x00000163,
+		},
+	},
+	{	/* 9 * G */
+		{
+			0x67cbe207, 0x1f456279, 0x85cd2866, 0x4f50babd,
+			0x725a318f, 0xf3c556df, 0x6134da35, 0x7429e139,
+			0xb8c6b665, 0x2c4ab145, 0x98874699, 0xed34541b,
+			0x7156d488, 0xa2f5bf15, 0xe1e21826, 0x5389e359,
+			0x00000158,
+		},
+		{
+			0xb9ad2a4e, 0x3aa0ea86, 0x28880f34, 0x736c2ae9,
+			0x4abfd87d, 0x0ff56ecf, 0x6057ac84, 0x0d69e575,
+			0x3ddb446e, 0xc825ba26, 0xee1cebb6, 0x3088a654,
+			0x27ae938e, 0x0b55557a, 0x8aedf39f, 0x2e618c9a,
+			0x0000002a,
+		},
+	},
+	{	/* 10 * G */
+		{
+			0x4f2f3320, 0x87ff09a0, 0x1a8e819a, 0x7c2e411f,
+			0x842093f3, 0x9daa4da9, 0xfcc26329, 0xa2c7c178,
+			0x1ada8910, 0x4a9246b1, 0xc09ac7c3, 0x901d879a,
+			0x721ec4cd, 0xfcfe7bb6, 0xa61f281d, 0xeb8f22bd,
+			0x00000190,
+		},
+		{
+			0x135ec759, 0x2954bc98, 0x739faa17, 0xf3689639,
+			0xdc57ebef, 0x536f6163, 0x4d9864bb, 0xbf5349d4,
+			0x62ef62d2, 0xa97fd78a, 0x4251b20b, 0xc2eeb214,
+			0xca2ba760, 0xbaeab3b0, 0x1614ba9d, 0x5d96b849,
+			0x000001eb,
+		},
+	},
+	{	/* 11 * G */
+		{
+			0xda0cdb9a, 0xecc0e02d, 0xa4c9a902, 0x015c024f,
+			0xe3191085, 0xd19b1aeb, 0x2663da1b, 0xf3dbc533,
+			0xf2991652, 0x43ef2c54, 0x7c178495, 0xed5dc7ed,
+			0x3b4315cf, 0x6f1a3957, 0xfdedff54, 0x75841259,
+			0x0000008a,
+		},
+		{
+			0xce48c808, 0x58874f92, 0xf4819b5d, 0xdcac80e3,
+			0x14a95336, 0x38923319, 0x8b42a4ab, 0x1bc8a90e,
+			0xe0b9b82b, 0xed2e95d4, 0x10bd0493, 0x3add5662,
+			0x054fb229, 0x9d0ca877, 0xba212984, 0xfb303fcb,
+			0x00000096,
+		},
+	},
+	{	/* 12 * G */
+		{
+			0xbf842d8c, 0x7be69571, 0x530928b1, 0x3774c75c,
+			0x60e93801, 0x477fee9a, 0x3fb81b31, 0x44e90b7c,
+			0x967713a6, 0x107cf7a5, 0x958457b6, 0x81874157,
+			0x9c7fde1e, 0xe4fae974, 0xf8221c5d, 0xd9dcec93,
+			0x000001c0,
+		},
+		{
+			0x281b17f0, 0x79e7b1a3, 0x24f5ae6c, 0x884ba722,
+			0x51b9b630, 0xcc10a6f9, 0xd86fcdb6, 0xd6d18843,
+			0x6a17c097, 0x5e404abf, 0x71494da4, 0x63fe65ab,
+			0xa682ca47, 0x3ce1d103, 0x4927c0fe, 0x48b5946a,
+			0x00000140,
+		},
+	},
+	{	/* 13 * G */
+		{
+			0x32fbcda7, 0x1887848d, 0xab38eff8, 0x4bec3b00,
+			0x9ab88ee9, 0x3550a5e7, 0xe03c996a, 0x32c45908,
+			0xaf5b8661, 0x4eedd2be, 0xe1b4c238, 0x93f736cd,
+			0x4924861a, 0xd7865d2b, 0xc396ad9c, 0x3e98f984,
+			0x0000007e,
+		},
+		{
+			0x022a71c9, 0x291a01fb, 0x9117e9f7, 0x6199eaaf,
+			0x1cbfbbc3, 0x26dfdd35, 0x38bc763f, 0xc1bd5d58,
+			0x5c1e212a, 0x9c7a67ae, 0x6d5421c6, 0xced50a38,
+			0xa3ed5a08, 0x1a1926da, 0x781feda9, 0xee58eb6d,
+			0x00000108,
+		},
+	},
+	{	/* 14 * G */
+		{
+			0xd3432d74, 0x2c9e682d, 0x12efbf5d, 0x6767f6b8,
+			0x7bc744aa, 0x79df3e4b, 0xb897222d, 0x74fc06c8,
+			0xe0b31999, 0xd4fb0bab, 0x94116a2f, 0x958b4014,
+			0xaf84ded1, 0xe1b8ccfa, 0x1b1b65a9, 0x5bc7dc55,
+			0x00000187,
+		},
+		{
+			0x2700d54a, 0x41669f85, 0xa87c84be, 0x5b690f53,
+			0xd133dc0d, 0x11e89bf1, 0xb4f3584c, 0xd07781b1,
+			0x86d7ed62, 0x0847ce9b, 0x8e51826a, 0x8470122b,
+			0xabb4bdfb, 0xd66290bb, 0xdacb5bd2, 0xa4923575,
+			0x0000005c,
+		},
+	},
+	{	/* 15 * G */
+		{
+			0xbcb8db55, 0xe9afe337, 0x1e3f92bd, 0x9b8d9698,
+			0x8fc0331d, 0x7875bd1c, 0xdbd00ffe, 0xb91cce27,
+			0xdf128e11, 0xd697b532, 0xb40a0852, 0xb8fbcc30,
+			0x46d4300f, 0x41558fc5, 0xb92465f0, 0x6ad89abc,
+			0x0000006b,
+		},
+		{
+			0xa1475465, 0x56343480, 0x446abdd9, 0x46fd90cc,
+			0x2c96c992, 0x2148e223, 0x99470a80, 0x7e9062c8,
+			0x97485ed5, 0x4b621069, 0xbad20cba, 0xdf0496a9,
+			0x33edbf63, 0x7ce64d23, 0x71391d6a, 0x68da2715,
+			0x000001b4,
+		},
+	},
+};
+
+/**
+ * Read a big endian byte array into words.
+ *
+ * @param r		Destination; EC_WORDS words
+ * @param in		Bytes to read
+ * @param size		Number of bytes; at most EC_BYTES
+ */
+static void from_bytes(uint32_t *r, const uint8_t *in, int size)
+{
+	int i;
+
+	memset(r, 0, EC_WORDS * sizeof(uint32_t));
+	for (i = 0; i < size; i++)
+		r[i / 4] |= (uint32_t)in[size - 1 - i] << (8 * (i % 4));
+}
+
+static int is_zero(const uint32_t *a)
+{
+	uint32_t acc = 0;
+	int i;
+
+	for (i = 0; i < EC_WORDS; i++)
+		acc |= a[i];
+	return !acc;
+}
+
+/**
+ * Return a[] < b[]
+ */
+static int less_than(const uint32_t *a, const uint32_t *b)
+{
+	int i;
+
+	for (i = EC_WORDS - 1; i >= 0; i--) {
+		if (a[i] != b[i])
+			return a[i] < b[i];
+	}
+	return 0;  /* equal */
+}
+
+/**
+ * a[] -= b[]; returns the borrow
+ */
+static uint32_t sub_words(uint32_t *a, const uint32_t *b)
+{
+	int64_t c = 0;
+	int i;
+
+	for (i = 0; i < EC_WORDS; i++) {
+		c += (uint64_t)a[i] - b[i];
+		a[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	return (uint32_t)-c;
+}
+
+/*
+ * Arithmetic mod p.  Inputs and outputs are always fully reduced.  Outputs
+ * may be the same as inputs.
+ */
+
+/**
+ * Reduce a[] < 2^522 mod p.  Since 2^521 = 1 mod p, the bits above 521 are
+ * just added back in at the bottom.
+ */
+static void fe_reduce(uint32_t *a)
+{
+	uint64_t c;
+	int i, j;
+
+	/* The first pass leaves at most 2^521, the second less than that */
+	for (j = 0; j < 2; j++) {
+		c = a[EC_WORDS - 1] >> 9;
+		a[EC_WORDS - 1] &= 0x1ff;
+		for (i = 0; i < EC_WORDS; i++) {
+			c += a[i];
+			a[i] = (uint32_t)c;
+			c >>= 32;
+		}
+	}
+
+	/* Which leaves p itself as the only other value to handle */
+	if (!less_than(a, ec_p))
+		sub_words(a, ec_p);
+}
+
+static void fe_add(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint64_t c = 0;
+	int i;
+
+	for (i = 0; i < EC_WORDS; i++) {
+		c += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	fe_reduce(r);
+}
+
+static void fe_sub(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t nb[EC_WORDS];
+	int i;
+
+	/* p - b is just b with all 521 bits flipped */
+	for (i = 0; i < EC_WORDS; i++)
+		nb[i] = b[i] ^ ec_p[i];
+	fe_add(r, a, nb);
+}
+
+static void fe_mul(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t t[2 * EC_WORDS];
+	uint64_t c;
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+	for (i = 0; i < EC_WORDS; i++) {
+		c = 0;
+		for (j = 0; j < EC_WORDS; j++) {
+			c += (uint64_t)a[i] * b[j] + t[i + j];
+			t[i + j] = (uint32_t)c;
+			c >>= 32;
+		}
+		t[i + EC_WORDS] = (uint32_t)c;
+	}
+
+	/* t = lo + hi * 2^521, which is lo + hi mod p; each is < 2^521 */
+	c = 0;
+	for (i = 0; i < EC_WORDS; i++) {
+		c += (uint64_t)(i == EC_WORDS - 1 ? t[i] & 0x1ff : t[i]) +
+			((t[EC_WORDS - 1 + i] >> 9) | (t[EC_WORDS + i] << 23));
+		r[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	fe_reduce(r);
+}
+
+/**
+ * r = 1 / a mod p, computed as a^(p - 2) mod p
+ */
+static void fe_inv(uint32_t *r, const uint32_t *a)
+{
+	uint32_t t[EC_WORDS];
+	int i;
+
+	/* p - 2 = 2^521 - 3 has every bit but bit 1 set */
+	memcpy(t, a, sizeof(t));
+	for (i = 519; i >= 0; i--) {
+		fe_mul(t, t, t);
+		if (i != 1)
+			fe_mul(t, t, a);
+	}
+	memcpy(r, t, sizeof(t));
+}
+
+/*
+ * Arithmetic mod n, in Montgomery form with R = 2^(32 * EC_WORDS).  The
+ * order has no special form, so this is the same word-by-word Montgomery
+ * multiply as the RSA code.
+ */
+
+/**
+ * Montgomery r[] = a[] * b[] / R mod n
+ */
+static void sc_mont_mul(uint32_t *r, const uint32_t *a, const uint32_t *b,
+			uint32_t n0inv)
+{
+	uint32_t t[EC_WORDS + 2];
+	uint64_t c;
+	uint32_t m;
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+	for (i = 0; i < EC_WORDS; i++) {
+		c = 0;
+		for (j = 0; j < EC_WORDS; j++) {
+			c += (uint64_t)a[j] * b[i] + t[j];
+			t[j] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[EC_WORDS];
+		t[EC_WORDS] = (uint32_t)c;
+		t[EC_WORDS + 1] = (uint32_t)(c >> 32);
+
+		m = t[0] * n0inv;
+		c = ((uint64_t)m * ec_n[0] + t[0]) >> 32;
+		for (j = 1; j < EC_WORDS; j++) {
+			c += (uint64_t)m * ec_n[j] + t[j];
+			t[j - 1] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[EC_WORDS];
+		t[EC_WORDS - 1] = (uint32_t)c;
+		t[EC_WORDS] = t[EC_WORDS + 1] + (uint32_t)(c >> 32);
+	}
+
+	/* Result is less than 2n */
+	if (t[EC_WORDS] || !less_than(t, ec_n))
+		sub_words(t, ec_n);
+	memcpy(r, t, EC_WORDS * sizeof(uint32_t));
+}
+
+/**
+ * a[] = 2 * a[] mod n
+ */
+static void sc_double(uint32_t *a)
+{
+	int i;
+
+	/* a < n < 2^521, so this can't overflow the top word */
+	for (i = EC_WORDS - 1; i > 0; i--)
+		a[i] = (a[i] << 1) | (a[i - 1] >> 31);
+	a[0] <<= 1;
+
+	if (!less_than(a, ec_n))
+		sub_words(a, ec_n);
+}
+
+/**
+ * r = 1 / a * R mod n, computed as a^(n - 2) in Montgomery form
+ *
+ * @param r		Result, in Montgomery form
+ * @param a		Number to invert; 0 < a < n, not in Montgomery form
+ * @param n0inv		-1 / n[0] mod 2^32
+ */
+static void sc_inv(uint32_t *r, const uint32_t *a, uint32_t n0inv)
+{
+	uint32_t rr[EC_WORDS], am[EC_WORDS], e[EC_WORDS];
+	int i;
+
+	/* R^2 mod n, by doubling 1 once for each bit of R^2 */
+	memset(rr, 0, sizeof(rr));
+	rr[0] = 1;
+	for (i = 0; i < 2 * 32 * EC_WORDS; i++)
+		sc_double(rr);
+
+	/* am = a * R mod n */
+	sc_mont_mul(am, a, rr, n0inv);
+
+	/* n - 2; n[0] is odd and more than 2, so there's no borrow */
+	memcpy(e, ec_n, sizeof(e));
+	e[0] -= 2;
+
+	/* Bit 520 of n - 2 is its top bit */
+	memcpy(r, am, sizeof(am));
+	for (i = 519; i >= 0; i--) {
+		sc_mont_mul(r, r, r, n0inv);
+		if ((e[i / 32] >> (i % 32)) & 1)
+			sc_mont_mul(r, r, am, n0inv);
+	}
+}
+
+/*
+ * Point arithmetic.  The formulas are the a = -3 Jacobian ones from the
+ * Explicit-Formulas Database (dbl-2001-b, madd-2007-bl, add-2007-bl).
+ * Outputs may be the same as inputs.
+ */
+
+static void ec_set_infinity(struct ec_point *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+static void ec_from_affine(struct ec_point *r, const struct ec_affine *a)
+{
+	memcpy(r->x, a->x, sizeof(r->x));
+	memcpy(r->y, a->y, sizeof(r->y));
+	memset(r->z, 0, sizeof(r->z));
+	r->z[0] = 1;
+}
+
+/**
+ * r = 2 * a.  Doubling the point at infinity leaves it at infinity.
+ */
+static void ec_double(struct ec_point *r, const struct ec_point *a)
+{
+	uint32_t delta[EC_WORDS], gamma[EC_WORDS], beta[EC_WORDS];
+	uint32_t alpha[EC_WORDS], t[EC_WORDS];
+
+	fe_mul(delta, a->z, a->z);
+	fe_mul(gamma, a->y, a->y);
+	fe_mul(beta, a->x, gamma);
+
+	/* alpha = 3 * (x - delta) * (x + delta) */
+	fe_sub(t, a->x, delta);
+	fe_add(alpha, a->x, delta);
+	fe_mul(alpha, alpha, t);
+	fe_add(t, alpha, alpha);
+	fe_add(alpha, alpha, t);
+
+	/* z3 = (y + z)^2 - gamma - delta */
+	fe_add(t, a->y, a->z);
+	fe_mul(t, t, t);
+	fe_sub(t, t, gamma);
+	fe_sub(r->z, t, delta);
+
+	/* x3 = alpha^2 - 8 * beta */
+	fe_add(beta, beta, beta);
+	fe_add(beta, beta, beta);
+	fe_mul(t, alpha, alpha);
+	fe_sub(t, t, beta);
+	fe_sub(r->x, t, beta);
+
+	/* y3 = alpha * (4 * beta - x3) - 8 * gamma^2 */
+	fe_sub(t, beta, r->x);
+	fe_mul(t, alpha, t);
+	fe_mul(gamma, gamma, gamma);
+	fe_add(gamma, gamma, gamma);
+	fe_add(gamma, gamma, gamma);
+	fe_add(gamma, gamma, gamma);
+	fe_sub(r->y, t, gamma);
+}
+
+/**
+ * Finish an addition, given u1 = x1 * z2^2, s1 = y1 * z2^3, and the
+ * differences h = u2 - u1 and rd = s2 - s1 from the other point.
+ *
+ * @param r		Result
+ * @param z		z1 * z2, or z1 when adding an affine point
+ */
+static void ec_add_finish(struct ec_point *r, const uint32_t *u1,
+			  const uint32_t *s1, const uint32_t *h,
+			  const uint32_t *rd, const uint32_t *z)
+{
+	uint32_t i[EC_WORDS], j[EC_WORDS], v[EC_WORDS], rr[EC_WORDS];
+	uint32_t t[EC_WORDS];
+
+	/* i = (2 * h)^2, j = h * i, rr = 2 * rd, v = u1 * i */
+	fe_add(i, h, h);
+	fe_mul(i, i, i);
+	fe_mul(j, h, i);
+	fe_add(rr, rd, rd);
+	fe_mul(v, u1, i);
+
+	/* z3 = 2 * z * h */
+	fe_mul(t, z, h);
+	fe_add(r->z, t, t);
+
+	/* x3 = rr^2 - j - 2 * v */
+	fe_mul(t, rr, rr);
+	fe_sub(t, t, j);
+	fe_sub(t, t, v);
+	fe_sub(r->x, t, v);
+
+	/* y3 = rr * (v - x3) - 2 * s1 * j */
+	fe_sub(t, v, r->x);
+	fe_mul(t, rr, t);
+	fe_mul(j, s1, j);
+	fe_sub(t, t, j);
+	fe_sub(r->y, t, j);
+}
+
+/**
+ * r = a + b, for an affine point b
+ */
+static void ec_add_affine(struct ec_point *r, const struct ec_point *a,
+			  const struct ec_affine *b)
+{
+	uint32_t z1z1[EC_WORDS], u1[EC_WORDS], s1[EC_WORDS], z1[EC_WORDS];
+	uint32_t h[EC_WORDS], rd[EC_WORDS];
+
+	if (is_zero(a->z)) {
+		ec_from_affine(r, b);
+		return;
+	}
+
+	/* b has z = 1, so u1 and s1 are just a's x and y */
+	fe_mul(z1z1, a->z, a->z);
+	fe_mul(h, b->x, z1z1);
+	fe_sub(h, h, a->x);
+	fe_mul(rd, b->y, a->z);
+	fe_mul(rd, rd, z1z1);
+	fe_sub(rd, rd, a->y);
+
+	if (is_zero(h)) {
+		if (is_zero(rd))
+			ec_double(r, a);
+		else
+			ec_set_infinity(r);
+		return;
+	}
+
+	memcpy(u1, a->x, sizeof(u1));
+	memcpy(s1, a->y, sizeof(s1));
+	memcpy(z1, a->z, sizeof(z1));
+	ec_add_finish(r, u1, s1, h, rd, z1);
+}
+
+/**
+ * r = a + b
+ */
+static void ec_add(struct ec_point *r, const struct ec_point *a,
+		   const struct ec_point *b)
+{
+	uint32_t z1z1[EC_WORDS], z2z2[EC_WORDS], u1[EC_WORDS], s1[EC_WORDS];
+	uint32_t h[EC_WORDS], rd[EC_WORDS], z[EC_WORDS];
+
+	if (is_zero(a->z)) {
+		*r = *b;
+		return;
+	}
+	if (is_zero(b->z)) {
+		*r = *a;
+		return;
+	}
+
+	fe_mul(z1z1, a->z, a->z);
+	fe_mul(z2z2, b->z, b->z);
+	fe_mul(u1, a->x, z2z2);
+	fe_mul(h, b->x, z1z1);
+	fe_sub(h, h, u1);
+	fe_mul(s1, a->y, b->z);
+	fe_mul(s1, s1, z2z2);
+	fe_mul(rd, b->y, a->z);
+	fe_mul(rd, rd, z1z1);
+	fe_sub(rd, rd, s1);
+
+	if (is_zero(h)) {
+		if (is_zero(rd))
+			ec_double(r, a);
+		else
+			ec_set_infinity(r);
+		return;
+	}
+
+	fe_mul(z, a->z, b->z);
+	ec_add_finish(r, u1, s1, h, rd, z);
+}
+
+/**
+ * Return non-zero if a is a point on the curve
+ */
+static int ec_on_curve(const struct ec_affine *a)
+{
+	uint32_t lhs[EC_WORDS], rhs[EC_WORDS], t[EC_WORDS];
+
+	if (!less_than(a->x, ec_p) || !less_than(a->y, ec_p))
+		return 0;
+
+	/* y^2 = x^3 - 3x + b */
+	fe_mul(lhs, a->y, a->y);
+	fe_mul(rhs, a->x, a->x);
+	fe_mul(rhs, rhs, a->x);
+	fe_add(t, a->x, a->x);
+	fe_add(t, t, a->x);
+	fe_sub(rhs, rhs, t);
+	fe_add(rhs, rhs, ec_b);
+
+	return !memcmp(lhs, rhs, sizeof(lhs));
+}
+
+/* Window i of a scalar, counting from the least significant */
+static uint32_t get_window(const uint32_t *k, int i)
+{
+	return (k[i / (32 / WINDOW_BITS)] >>
+		(WINDOW_BITS * (i % (32 / WINDOW_BITS)))) & (WINDOW_SIZE - 1);
+}
+
+/**
+ * r = u1 * G + u2 * Q, sharing the doublings between both scalars
+ *
+ * @param r		Result
+ * @param u1		Scalar for the base point, < n
+ * @param u2		Scalar for the public key, < n
+ * @param q		Public key
+ */
+static void ec_mul2(struct ec_point *r, const uint32_t *u1,
+		    const uint32_t *u2, const struct ec_affine *q)
+{
+	struct ec_point q_table[WINDOW_SIZE - 1];
+	uint32_t d;
+	int i, j;
+
+	/* q_table[i] = (i + 1) * Q */
+	ec_from_affine(&q_table[0], q);
+	ec_double(&q_table[1], &q_table[0]);
+	for (i = 2; i < WINDOW_SIZE - 1; i++)
+		ec_add_affine(&q_table[i], &q_table[i - 1], q);
+
+	/* Scalars are below 2^521, so start at the window holding bit 520 */
+	ec_set_infinity(r);
+	for (i = 520 / WINDOW_BITS; i >= 0; i--) {
+		for (j = 0; j < WINDOW_BITS; j++)
+			ec_double(r, r);
+
+		d = get_window(u1, i);
+		if (d)
+			ec_add_affine(r, r, &g_table[d - 1]);
+		d = get_window(u2, i);
+		if (d)
+			ec_add(r, r, &q_table[d - 1]);
+	}
+}
+
 int bdb_ecdsa521_verify(const uint8_t *key_data,
 			const uint8_t *sig,
 			const uint8_t *digest)
 {
-	/* This is just a stub */
-	return BDB_ERROR_DIGEST;
+	struct ec_affine q;
+	struct ec_point p;
+	uint32_t r[EC_WORDS], s[EC_WORDS], e[EC_WORDS], w[EC_WORDS];
+	uint32_t u1[EC_WORDS], u2[EC_WORDS], zinv[EC_WORDS];
+	uint32_t n0inv;
+	int i;
+
+	/* Key is the x and y of the public point Q; both must be on the curve */
+	from_bytes(q.x, key_data, EC_BYTES);
+	from_bytes(q.y, key_data + EC_BYTES, EC_BYTES);
+	if (!ec_on_curve(&q))
+		return BDB_ERROR_DIGEST;
+
+	/* Signature is r and s, both in [1, n - 1] */
+	from_bytes(r, sig, EC_BYTES);
+	from_bytes(s, sig + EC_BYTES, EC_BYTES);
+	if (is_zero(r) || !less_than(r, ec_n) ||
+	    is_zero(s) || !less_than(s, ec_n))
+		return BDB_ERROR_DIGEST;
+
+	/* SHA-256 is shorter than n, so the whole digest is used */
+	from_bytes(e, digest, BDB_SHA256_DIGEST_SIZE);
+
+	/* -1 / n[0] mod 2^32; each Newton step doubles the correct bits */
+	n0inv = ec_n[0];
+	for (i = 0; i < 4; i++)
+		n0inv *= 2 - ec_n[0] * n0inv;
+	n0inv = -n0inv;
+
+	/* w = 1 / s; u1 = e * w; u2 = r * w.  w * R cancels the 1 / R. */
+	sc_inv(w, s, n0inv);
+	sc_mont_mul(u1, e, w, n0inv);
+	sc_mont_mul(u2, r, w, n0inv);
+
+	ec_mul2(&p, u1, u2, &q);
+	if (is_zero(p.z))
+		return BDB_ERROR_DIGEST;
+
+	/* Affine x = x / z^2, which must be r mod n.  p < 2n, so x < 2n. */
+	fe_inv(zinv, p.z);
+	fe_mul(zinv, zinv, zinv);
+	fe_mul(p.x, p.x, zinv);
+	if (!less_than(p.x, ec_n))
+		sub_words(p.x, ec_n);
+
+	if (memcmp(p.x, r, sizeof(r)))
+		return BDB_ERROR_DIGEST;
+
+	return BDB_SUCCESS;
 }
@@ -159,6 +159,24 @@ struct bdb_sig *bdb_create_sig(const void *data,
 			       struct rsa_st *key,
 			       uint32_t sig_alg,
 			       const char *desc)
+{
+	uint8_t digest[BDB_SHA256_DIGEST_SIZE];
+
+	if (size >= UINT32_MAX)
+		return NULL;
+
+	if (vb2_digest_buffer((uint8_t *)data, size, VB2_HASH_SHA256,
+			      digest, sizeof(digest)))
+		return NULL;
+
+	return bdb_create_sig_digest(digest, size, key, sig_alg, desc);
+}
+
+struct bdb_sig *bdb_create_sig_digest(const uint8_t *data_digest,
+				      size_t size,
+				      struct rsa_st *key,
+				      uint32_t sig_alg,
+				      const char *desc)
 {
 	static const uint8_t info[] = {
 		0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86,
@@ -203,14 +221,9 @@ struct bdb_sig *bdb_create_sig(const void *data,
 	if (desc)
 		strzcpy(sig->description, desc, sizeof(sig->description));
 
-	/* Calculate info-padded digest */
+	/* Info-pad the digest */
 	memcpy(digest, info, sizeof(info));
-	if (vb2_digest_buffer((uint8_t *)data, size,
-			      VB2_HASH_SHA256,
-			      digest + sizeof(info), BDB_SHA256_DIGEST_SIZE)) {
-		free(sig);
-		return NULL;
-	}
+	memcpy(digest + sizeof(info), data_digest, BDB_SHA256_DIGEST_SIZE);
 
 	/* RSA-encrypt the signature */
 	if (RSA_private_encrypt(sizeof(digest),
@@ -124,6 +124,25 @@ struct bdb_sig *bdb_create_sig(const void *data,
 			       uint32_t sig_alg,
 			       const char *desc);
 
+/**
+ * Create a BDB signature object from the digest of the data.
+ *
+ * Like bdb_create_sig(), for a caller which has already hashed the data.
+ *
+ * @param data_digest	SHA-256 digest of the data to sign
+ *			(BDB_SHA256_DIGEST_SIZE bytes)
+ * @param size		Size of the data in bytes
+ * @param key		PEM key
+ * @param sig_alg	Signature algorithm
+ * @param desc		Description.  Optional; may be NULL.
+ * @return A newly allocated signature, or NULL if error.
+ */
+struct bdb_sig *bdb_create_sig_digest(const uint8_t *data_digest,
+				      size_t size,
+				      struct rsa_st *key,
+				      uint32_t sig_alg,
+				      const char *desc);
+
 struct bdb_create_params
 {
 	/* Load address */
@@ -82,6 +82,10 @@ static void unset_current_slot_failed(struct vba_context *ctx)
 
 int vba_bdb_init(struct vba_context *ctx)
 {
+	/* NVM-RW is read on first use this boot */
+	ctx->flags &= ~(VBA_CONTEXT_FLAG_NVMRW_VERIFIED |
+			VBA_CONTEXT_FLAG_NVMRW_DIRTY);
+
 	/* Get current slot */
 	get_current_slot(ctx);
 
@@ -106,12 +110,17 @@ int vba_bdb_init(struct vba_context *ctx)
 
 int vba_bdb_finalize(struct vba_context *ctx)
 {
+	int rv;
+
 	/* Mark the current slot good */
 	unset_current_slot_failed(ctx);
 
+	/* Write all the NVM-RW updates of this boot at once */
+	rv = nvmrw_flush(ctx);
+
 	/* Disable NVM bus */
 
-	return BDB_SUCCESS;
+	return rv ? BDB_ERROR_RECOVERY_REQUEST : BDB_SUCCESS;
 }
 
 void vba_bdb_fail(struct vba_context *ctx)
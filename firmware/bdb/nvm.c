@@ -39,13 +39,30 @@ static int nvmrw_validate(const void *buf, uint32_t size)
 	return BDB_SUCCESS;
 }
 
-static int nvmrw_verify(const struct bdb_secrets *secrets,
+/**
+ * Precompute the NVM-RW HMAC key schedule
+ *
+ * @param secrets	Secrets holding the NVM-RW key
+ * @param hc		HMAC context to init
+ * @return The context, or NULL if there are no secrets.
+ */
+static const struct vb2_hmac_context *nvmrw_hmac_init(
+		const struct bdb_secrets *secrets, struct vb2_hmac_context *hc)
+{
+	if (!secrets || vb2_hmac_init(hc, VB2_HASH_SHA256, secrets->nvm_rw,
+				      BDB_SECRET_SIZE))
+		return NULL;
+
+	return hc;
+}
+
+static int nvmrw_verify(const struct vb2_hmac_context *hc,
 			const struct nvmrw *nvm, uint32_t size)
 {
 	uint8_t mac[NVM_HMAC_SIZE];
 	int rv;
 
-	if (!secrets || !nvm)
+	if (!hc || !nvm)
 		return BDB_ERROR_NVM_INVALID_PARAMETER;
 
 	rv = nvmrw_validate(nvm, size);
@@ -53,8 +70,8 @@ static int nvmrw_verify(const struct bdb_secrets *secrets,
 		return rv;
 
 	/* Compute and verify HMAC */
-	if (hmac(VB2_HASH_SHA256, secrets->nvm_rw, BDB_SECRET_SIZE,
-		 nvm, nvm->struct_size - sizeof(mac), mac, sizeof(mac)))
+	if (vb2_hmac_calculate(hc, nvm, nvm->struct_size - sizeof(mac),
+			       mac, sizeof(mac)))
 		return BDB_ERROR_NVM_RW_HMAC;
 	/* TODO: Use safe_memcmp */
 	if (memcmp(mac, nvm->hmac, sizeof(mac)))
@@ -63,26 +80,35 @@ static int nvmrw_verify(const struct bdb_secrets *secrets,
 	return BDB_SUCCESS;
 }
 
-int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
+/**
+ * Validate NVM-RW in the context and update its HMAC, ready for writing
+ */
+static int sign_nvmrw(struct vba_context *ctx,
+		      const struct vb2_hmac_context *hc)
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
-	int retry = NVM_MAX_WRITE_RETRY;
 	int rv;
 
-	if (!ctx)
-		return BDB_ERROR_NVM_INVALID_PARAMETER;
-
-	if (!ctx->secrets)
+	if (!hc)
 		return BDB_ERROR_NVM_INVALID_SECRET;
 
 	rv = nvmrw_validate(nvm, sizeof(*nvm));
 	if (rv)
 		return rv;
 
-	/* Update HMAC */
-	hmac(VB2_HASH_SHA256, ctx->secrets->nvm_rw, BDB_SECRET_SIZE,
-	     nvm, nvm->struct_size - sizeof(nvm->hmac),
-	     nvm->hmac, sizeof(nvm->hmac));
+	vb2_hmac_calculate(hc, nvm, nvm->struct_size - sizeof(nvm->hmac),
+			   nvm->hmac, sizeof(nvm->hmac));
+
+	return BDB_SUCCESS;
+}
+
+/**
+ * Write one copy of NVM-RW, already signed by sign_nvmrw()
+ */
+static int write_nvmrw_copy(struct vba_context *ctx, enum nvm_type type)
+{
+	struct nvmrw *nvm = &ctx->nvmrw;
+	int retry = NVM_MAX_WRITE_RETRY;
 
 	while (retry--) {
 		uint8_t buf[sizeof(struct nvmrw)];
@@ -100,8 +126,41 @@ int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
 	return BDB_ERROR_NVM_WRITE;
 }
 
+/**
+ * Sign and write both copies of NVM-RW, computing the HMAC only once
+ */
+static int write_nvmrw_both(struct vba_context *ctx,
+			    const struct vb2_hmac_context *hc)
+{
+	int rv1, rv2;
+
+	rv1 = sign_nvmrw(ctx, hc);
+	if (rv1)
+		return rv1;
+
+	rv1 = write_nvmrw_copy(ctx, NVM_TYPE_RW_PRIMARY);
+	rv2 = write_nvmrw_copy(ctx, NVM_TYPE_RW_SECONDARY);
+
+	return rv1 ? rv1 : rv2;
+}
+
+int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
+{
+	struct vb2_hmac_context hc;
+	int rv;
+
+	if (!ctx)
+		return BDB_ERROR_NVM_INVALID_PARAMETER;
+
+	rv = sign_nvmrw(ctx, nvmrw_hmac_init(ctx->secrets, &hc));
+	if (rv)
+		return rv;
+
+	return write_nvmrw_copy(ctx, type);
+}
+
 static int read_verify_nvmrw(enum nvm_type type,
-			     const struct bdb_secrets *secrets,
+			     const struct vb2_hmac_context *hc,
 			     uint8_t *buf, uint32_t buf_size)
 {
 	struct nvmrw *nvm = (struct nvmrw *)buf;
@@ -121,7 +180,7 @@ static int read_verify_nvmrw(enum nvm_type type,
 		return BDB_ERROR_NVM_VBE_READ;
 
 	/* Verify the content */
-	rv = nvmrw_verify(secrets, nvm, sizeof(*nvm));
+	rv = nvmrw_verify(hc, nvm, sizeof(*nvm));
 		return rv;
 
 	return BDB_SUCCESS;
@@ -133,15 +192,18 @@ int nvmrw_read(struct vba_context *ctx)
 	uint8_t buf2[NVM_RW_MAX_STRUCT_SIZE];
 	struct nvmrw *nvm1 = (struct nvmrw *)buf1;
 	struct nvmrw *nvm2 = (struct nvmrw *)buf2;
+	struct vb2_hmac_context hmac_ctx;
+	const struct vb2_hmac_context *hc;
 	int rv1, rv2;
 
+	/* Every copy read or written below uses the same key */
+	hc = nvmrw_hmac_init(ctx->secrets, &hmac_ctx);
+
 	/* Read and verify the 1st copy */
-	rv1 = read_verify_nvmrw(NVM_TYPE_RW_PRIMARY, ctx->secrets,
-				buf1, sizeof(buf1));
+	rv1 = read_verify_nvmrw(NVM_TYPE_RW_PRIMARY, hc, buf1, sizeof(buf1));
 
 	/* Read and verify the 2nd copy */
-	rv2 = read_verify_nvmrw(NVM_TYPE_RW_SECONDARY, ctx->secrets,
-				buf2, sizeof(buf2));
+	rv2 = read_verify_nvmrw(NVM_TYPE_RW_SECONDARY, hc, buf2, sizeof(buf2));
 
 	if (rv1 == BDB_SUCCESS && rv2 == BDB_SUCCESS) {
 		/* Sync primary and secondary based on update_count. */
@@ -169,16 +231,18 @@ int nvmrw_read(struct vba_context *ctx)
 		 */
 		ctx->nvmrw.struct_minor_version = NVM_HEADER_VERSION_MINOR;
 		ctx->nvmrw.struct_size = sizeof(ctx->nvmrw);
-		/* We don't worry about calculating hmac twice because
-		 * this is a corner case. */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+		rv1 = write_nvmrw_both(ctx, hc);
+		rv2 = BDB_SUCCESS;
 	} else if (rv1 != BDB_SUCCESS) {
 		/* primary copy is bad. sync it with secondary copy */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
+		rv1 = sign_nvmrw(ctx, hc);
+		if (!rv1)
+			rv1 = write_nvmrw_copy(ctx, NVM_TYPE_RW_PRIMARY);
 	} else if (rv2 != BDB_SUCCESS){
 		/* secondary copy is bad. sync it with primary copy */
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+		rv2 = sign_nvmrw(ctx, hc);
+		if (!rv2)
+			rv2 = write_nvmrw_copy(ctx, NVM_TYPE_RW_SECONDARY);
 	} else {
 		/* Both copies are good and versions are same as the reader.
 		 * Skip writing. This should be the common case. */
@@ -187,11 +251,43 @@ int nvmrw_read(struct vba_context *ctx)
 	if (rv1 || rv2)
 		return rv1 ? rv1 : rv2;
 
+	/* Later updates this boot work on this copy, until nvmrw_flush() */
+	ctx->flags |= VBA_CONTEXT_FLAG_NVMRW_VERIFIED;
+	ctx->flags &= ~VBA_CONTEXT_FLAG_NVMRW_DIRTY;
+
+	return BDB_SUCCESS;
+}
+
+int nvmrw_flush(struct vba_context *ctx)
+{
+	struct vb2_hmac_context hmac_ctx;
+	int rv;
+
+	if (!(ctx->flags & VBA_CONTEXT_FLAG_NVMRW_DIRTY))
+		return BDB_SUCCESS;
+
+	/* All the changes made this boot count as one update */
+	ctx->nvmrw.update_count++;
+
+	rv = write_nvmrw_both(ctx, nvmrw_hmac_init(ctx->secrets, &hmac_ctx));
+	if (rv)
+		return rv;
+
+	ctx->flags &= ~VBA_CONTEXT_FLAG_NVMRW_DIRTY;
 	return BDB_SUCCESS;
 }
 
+/**
+ * Make sure ctx->nvmrw holds verified NVM-RW contents
+ *
+ * NVM-RW is only read and verified the first time; after that, the copy in
+ * the context (with any changes made to it) is used.
+ */
 static int nvmrw_init(struct vba_context *ctx)
 {
+	if (ctx->flags & VBA_CONTEXT_FLAG_NVMRW_VERIFIED)
+		return BDB_SUCCESS;
+
 	if (nvmrw_read(ctx))
 		return BDB_ERROR_NVM_INIT;
 
@@ -204,27 +300,15 @@ int vba_update_kernel_version(struct vba_context *ctx,
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
 
-	if (nvmrw_verify(ctx->secrets, nvm, sizeof(*nvm))) {
-		if (nvmrw_init(ctx))
-			return BDB_ERROR_NVM_INIT;
-	}
+	if (nvmrw_init(ctx))
+		return BDB_ERROR_NVM_INIT;
 
 	if (nvm->min_kernel_data_key_version < kernel_data_key_version ||
 			nvm->min_kernel_version < kernel_version) {
-		int rv1, rv2;
-
-		/* Roll forward versions */
+		/* Roll forward versions. Written by vba_bdb_finalize. */
 		nvm->min_kernel_data_key_version = kernel_data_key_version;
 		nvm->min_kernel_version = kernel_version;
-
-		/* Increment update counter */
-		nvm->update_count++;
-
-		/* Update both copies */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
-		if (rv1 || rv2)
-			return BDB_ERROR_RECOVERY_REQUEST;
+		ctx->flags |= VBA_CONTEXT_FLAG_NVMRW_DIRTY;
 	}
 
 	return BDB_SUCCESS;
@@ -234,12 +318,9 @@ int vba_update_buc(struct vba_context *ctx, uint8_t *new_buc)
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
 	uint8_t buc[BUC_ENC_DIGEST_SIZE];
-	int rv1, rv2;
 
-	if (nvmrw_verify(ctx->secrets, nvm, sizeof(*nvm))) {
-		if (nvmrw_init(ctx))
-			return BDB_ERROR_NVM_INIT;
-	}
+	if (nvmrw_init(ctx))
+		return BDB_ERROR_NVM_INIT;
 
 	/* Encrypt new BUC
 	 * Note that we do not need to decide whether we should use hardware
@@ -252,16 +333,9 @@ int vba_update_buc(struct vba_context *ctx, uint8_t *new_buc)
 	if (!memcmp(buc, nvm->buc_enc_digest, sizeof(buc)))
 		return BDB_SUCCESS;
 
+	/* Written by vba_bdb_finalize */
 	memcpy(nvm->buc_enc_digest, buc, sizeof(buc));
-
-	/* Increment update counter */
-	nvm->update_count++;
-
-	/* Write new BUC */
-	rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-	rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
-	if (rv1 || rv2)
-		return BDB_ERROR_WRITE_BUC;
+	ctx->flags |= VBA_CONTEXT_FLAG_NVMRW_DIRTY;
 
 	return BDB_SUCCESS;
 }
@@ -342,5 +416,6 @@ int nvmrw_set(struct vba_context *ctx, enum nvmrw_var var, uint32_t val)
 		return BDB_ERROR_NVM_INVALID_PARAMETER;
 	}
 
+	ctx->flags |= VBA_CONTEXT_FLAG_NVMRW_DIRTY;
 	return BDB_SUCCESS;
 }
@@ -92,7 +92,7 @@ enum nvmrw_var {
 /* 4 Kbit EEPROM divided by 4 regions (RO,RW) x (1st,2nd) = 128 KB */
 #define NVM_RW_MAX_STRUCT_SIZE		128
 
-/* For nvm_rw_read and nvm_write */
+/* For nvm_rw_read, nvm_write and nvmrw_flush */
 struct vba_context;
 
 /**
@@ -112,6 +112,18 @@ int nvmrw_read(struct vba_context *ctx);
  */
 int nvmrw_write(struct vba_context *ctx, enum nvm_type type);
 
+/**
+ * Write NVM-RW changes made this boot
+ *
+ * If anything changed ctx->nvmrw since it was read, this increments its
+ * update count, computes its HMAC once and writes both copies.  Otherwise it
+ * does nothing.
+ *
+ * @param ctx	struct vba_context
+ * @return	BDB_SUCCESS or BDB_ERROR_NVM_*
+ */
+int nvmrw_flush(struct vba_context *ctx);
+
 /**
  * Get a value of NVM-RW variable
  *
@@ -127,7 +139,8 @@ int nvmrw_get(struct vba_context *ctx, enum nvmrw_var var, uint32_t *val);
 /**
  * Set a value in NVM-RW variable
  *
- * Callers are responsible for init and verify of ctx->nvmrw.
+ * Callers are responsible for init and verify of ctx->nvmrw.  The change is
+ * written by the next nvmrw_flush() (or nvmrw_write()).
  *
  * @param ctx	struct vba_context
  * @param var	Index of the variable
@@ -66,8 +66,23 @@ enum {
 	GPT_UPDATE_ENTRY_INVALID = 4,
 };
 
+/* Most kernel entries GptNextKernelEntry() considers, one per GPT entry */
+#define GPT_MAX_KERNEL_CANDIDATES 128
+
+/* A kernel entry GptNextKernelEntry() has yet to return */
+typedef struct {
+	uint16_t index;
+	uint8_t priority;
+} GptKernelCandidate;
+
 /* If this bit is 1, the GPT is stored in another from the streaming data */
 #define GPT_FLAG_EXTERNAL	0x1
+/*
+ * If this bit is 1, the GPT may have up to MAX_LARGE_NUMBER_OF_ENTRIES
+ * entries, instead of the ChromeOS limit of MAX_NUMBER_OF_ENTRIES.  Only for
+ * host tools; firmware allocates entry arrays for the usual limit.
+ */
+#define GPT_FLAG_LARGE_TABLE	0x2
 
 /*
  * A note about stored_on_device and gpt_drive_sectors:
@@ -114,6 +129,26 @@ typedef struct {
 	/* Internal variables */
 	uint8_t valid_headers, valid_entries, ignored;
 	int current_priority;
+	/*
+	 * Set by AllocAndReadGptData() if the secondary GPT wasn't read from
+	 * the drive, but copied from the primary.
+	 */
+	uint8_t secondary_copied;
+	/*
+	 * Bitmask of the entry array sectors changed by
+	 * GptUpdateKernelWithEntry(), so only those need writing back.  0
+	 * means the whole entry arrays must be written, if they're modified.
+	 */
+	uint32_t dirty_entry_sectors;
+	/*
+	 * Bootable kernel entries after current_kernel, highest priority
+	 * first, built by the first GptNextKernelEntry() after GptInit().  If
+	 * there were more than fit, kernel_candidates_truncated is set and the
+	 * list is built again once they've all been returned.
+	 */
+	GptKernelCandidate kernel_candidates[GPT_MAX_KERNEL_CANDIDATES];
+	uint8_t num_kernel_candidates, next_kernel_candidate;
+	uint8_t kernel_candidates_built, kernel_candidates_truncated;
 } GptData;
 
 /**
@@ -153,7 +188,8 @@ GptEntry *GptFindNthEntry(GptData *gpt, const Guid *guid, unsigned int n);
 /**
  * Allocate and read GPT data from the drive.  The sector_bytes and
  * drive_sectors fields should be filled on input.  The primary and secondary
- * header and entries are filled on output.
+ * header and entries are filled on output.  If the primary GPT is valid, the
+ * secondary is copied from it instead of being read.
  *
  * Returns 0 if successful, 1 if error.
  */
@@ -164,6 +200,45 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
  */
 int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
 
+/* Disk read trace, implemented in disk_read_trace.c */
+struct vb2_disk_read;
+
+/**
+ * Record a disk read made while looking for a kernel, for the disk read
+ * trace; see struct vb2_disk_read.
+ *
+ * @param lba_start	First sector read
+ * @param lba_count	Number of sectors read
+ * @param purpose	What the read was for (enum vb2_disk_read_purpose)
+ */
+void VbDiskReadRecord(uint64_t lba_start, uint64_t lba_count,
+		      uint32_t purpose);
+
+/**
+ * Start recording reads for a LoadKernel() call.  Reads recorded before for a
+ * call with the same lk_call index are forgotten, since VbSharedDataHeader
+ * has reused its entry.
+ *
+ * @param lk_call	Index of the call in VbSharedDataHeader.lk_calls
+ */
+void VbDiskReadStartCall(uint32_t lk_call);
+
+/**
+ * Return the disk read trace.
+ *
+ * @param count		Number of entries is stored here
+ * @param dropped	Number of reads not recorded because the trace was
+ *			full is stored here
+ * @return The trace entries, oldest first.
+ */
+const struct vb2_disk_read *VbDiskReadGetTrace(uint32_t *count,
+					       uint32_t *dropped);
+
+/**
+ * Clear the disk read trace.
+ */
+void VbDiskReadReset(void);
+
 /**
  * Return 1 if the entry is unused, 0 if it is used.
  */
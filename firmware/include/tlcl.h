@@ -13,6 +13,7 @@
 #define TPM_LITE_TLCL_H_
 #include <stdint.h>
 
+#include "2trace.h"
 #include "tss_constants.h"
 
 #ifdef __cplusplus
@@ -45,6 +46,32 @@ uint32_t TlclSendReceive(const uint8_t *request, uint8_t *response,
  */
 int TlclPacketSize(const uint8_t *packet);
 
+/* Statistics, implemented in tlcl_stats.c */
+
+/**
+ * Count a command with code [command_code] which returned [result] after
+ * taking [time] VbExGetTimer() units.  The library calls this for every
+ * command it sends.
+ */
+void TlclStatsRecord(uint32_t command_code, uint32_t result, uint64_t time);
+
+/**
+ * Return the table of commands sent since startup or the last
+ * TlclStatsReset(), with one entry per command code in the order they were
+ * first sent.  [count] is set to the number of entries used.
+ */
+const struct vb2_tpm_stat *TlclGetStats(uint32_t *count);
+
+/**
+ * Clear the statistics table.
+ */
+void TlclStatsReset(void);
+
+/**
+ * Print the statistics table with VB2_DEBUG().
+ */
+void TlclStatsDump(void);
+
 /* Commands */
 
 /**
@@ -119,6 +146,24 @@ uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length);
  */
 uint32_t TlclRead(uint32_t index, void *data, uint32_t length);
 
+/* One space for TlclReadMultiple() to read. */
+struct tlcl_nv_read {
+	uint32_t index;
+	void *data;
+	uint32_t length;
+
+	/* Set to the TPM error code TlclRead() would have returned */
+	uint32_t result;
+};
+
+/**
+ * Read [count] spaces, as if calling TlclRead() for each of [reads] in turn.
+ * On TPM2.0 the commands are all marshaled up front, so the transport can
+ * send each one as soon as the previous response arrives.  Returns the first
+ * non-zero result, or TPM_SUCCESS if every read succeeded.
+ */
+uint32_t TlclReadMultiple(struct tlcl_nv_read *reads, int count);
+
 /**
  * Read PCR at [index] into [data].  [length] must be TPM_PCR_DIGEST or
  * larger. The TPM error code is returned.
@@ -286,6 +331,16 @@ uint32_t TlclUndefineSpaceEx(const uint8_t* owner_auth,
 
 #ifndef TPM2_MODE
 
+/**
+ * Keep the owner OSAP session open between owner-authorized commands such as
+ * TlclDefineSpaceEx(), so a run of them only starts one session.  Off by
+ * default, so each command closes its session.  A caller which turns this on
+ * must call TlclLibClose() when done; otherwise the session holds one of the
+ * TPM's auth session slots until the next TPM_Startup.  Turning it off closes
+ * any open session.
+ */
+void TlclKeepOwnerSession(int keep);
+
 /**
  * Read the public half of the EK.
  */
@@ -87,6 +87,8 @@ typedef uint32_t TPM_FAMILY_FLAGS;
 
 #define TPM_ET_OWNER ((uint32_t) 0x02)
 
+#define TPM_RT_AUTH ((uint32_t) 0x00000002)
+
 #define TPM_FAMILY_CREATE ((uint32_t) 0x00000001)
 
 #define TPM_ST_CLEAR       ((uint16_t) 0x0001)
@@ -236,6 +238,7 @@ typedef struct tdTPM_NV_AUTH_POLICY
 #define TPM_ORD_Delegate_ReadTable      ((uint32_t) 0x000000DB)
 #define TPM_ORD_Extend                  ((uint32_t) 0x00000014)
 #define TPM_ORD_FieldUpgrade            ((uint32_t) 0x000000AA)
+#define TPM_ORD_FlushSpecific           ((uint32_t) 0x000000BA)
 #define TPM_ORD_ForceClear              ((uint32_t) 0x0000005D)
 #define TPM_ORD_GetCapability           ((uint32_t) 0x00000065)
 #define TPM_ORD_GetRandom               ((uint32_t) 0x00000046)
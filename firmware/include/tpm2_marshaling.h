@@ -50,6 +50,30 @@ int tpm_unmarshal_response(TPM_CC command,
 			   int response_size,
 			   struct tpm2_response *response);
 
+/* Bytes of an NV_Read response before the data: header, parameterSize and
+ * the size of the data. */
+#define TPM2_NV_READ_HEAD_SIZE (sizeof(struct tpm_header) + \
+				sizeof(uint32_t) + sizeof(uint16_t))
+
+/**
+ * tpm_unmarshal_nv_read
+ *
+ * Same as tpm_unmarshal_response() for an NV_Read response which was received
+ * in pieces: its first TPM2_NV_READ_HEAD_SIZE bytes into one buffer, then the
+ * data straight into its destination, then the authorization section
+ * anywhere.  The data is not copied; on success, response->nvr.buffer points
+ * to it.
+ *
+ * @head: buffer containing the start of the response
+ * @data: buffer the data was received into
+ * @response_size: total number of bytes received
+ * @response: structure to be filled with deserialized response
+ *
+ * Returns 0 on success, or -1 on error.
+ */
+int tpm_unmarshal_nv_read(void *head, void *data, int response_size,
+			  struct tpm2_response *response);
+
 /**
  * tpm_get_packet_size
  *
@@ -41,6 +41,7 @@
 #define TPM_E_OWNER_SET             ((uint32_t) 0x00000014)
 #define TPM_E_BADTAG                ((uint32_t) 0x0000001e)
 #define TPM_E_IOERROR               ((uint32_t) 0x0000001f)
+#define TPM_E_INVALID_AUTHHANDLE    ((uint32_t) 0x00000022)
 #define TPM_E_INVALID_POSTINIT      ((uint32_t) 0x00000026)
 #define TPM_E_BAD_PRESENCE          ((uint32_t) 0x0000002d)
 #define TPM_E_AREA_LOCKED           ((uint32_t) 0x0000003c)
@@ -149,6 +149,10 @@ enum VbErrorPredefined_t {
 	/* Compute expected RW hash from the EC image; BIOS doesn't have it */
 	VBERROR_EC_GET_EXPECTED_HASH_FROM_IMAGE = 0x20000,
 
+	/* VbExEcGetBlockHashes() may return the following codes */
+	/* EC can't hash blocks; update the whole image instead */
+	VBERROR_EC_BLOCK_HASHES_UNSUPPORTED   = 0x20001,
+
 	/* Detachable UI internal functions may return the following codes */
 	/* No error; return to UI loop */
 	VBERROR_KEEP_LOOPING			= 0x30000,
@@ -164,7 +168,7 @@ enum VbErrorPredefined_t {
  * the OS.  Minimum size is enough to hold all required data for verified boot
  * but may not be able to hold debug output.
  */
-#define VB_SHARED_DATA_MIN_SIZE 3072
+#define VB_SHARED_DATA_MIN_SIZE 4352
 #define VB_SHARED_DATA_REC_SIZE 16384
 
 /*
@@ -300,6 +304,12 @@ typedef struct VbSelectAndLoadKernelParams {
  */
 #define VB_SALK_INFLAGS_VENDOR_DATA_SETTABLE (1 << 1)
 
+/* Flag to allow reading the kernel vblock into the start of kernel_buffer,
+ * so the body doesn't need to be copied.  The body is then returned in
+ * kernel_buffer at an offset, so the kernel_buffer output must be used.
+ */
+#define VB_SALK_INFLAGS_VBLOCK_IN_KERNEL_BUFFER (1 << 2)
+
 /**
  * Select and loads the kernel.
  *
@@ -331,6 +341,59 @@ VbError_t VbVerifyMemoryBootImage(struct vb2_context *ctx,
 				  void *boot_image,
 				  size_t image_size);
 
+/**
+ * Start verifying a kernel image as it is loaded into memory.
+ *
+ * This is VbVerifyMemoryBootImage() for an image which arrives a piece at a
+ * time, such as from fastboot over USB or the network.  The vblock is
+ * verified as soon as it is in memory, and the body is hashed as the rest
+ * arrives, so verification is done when the transfer is.
+ *
+ * The image must arrive in order from the start of boot_image.  Call
+ * VbVerifyMemoryBootImageExtend() as more of it arrives, and then
+ * VbVerifyMemoryBootImageFinish().  Only one image can be verified this way
+ * at a time.
+ *
+ * @param ctx		Vboot context
+ * @param shared 	Vboot1 VBSD struct
+ * @param kparams	kernel params
+ * @param boot_image	Memory the image is being loaded into
+ * @param image_size	Size of the whole image
+ * @param received	Bytes of the image in memory so far; must include the
+ *			keyblock and preamble (usually the first 64 KB)
+ * @return VBERROR_... error, VBERROR_SUCCESS if the vblock is good.  After an
+ * error, the image is not being verified any more.
+ */
+VbError_t VbVerifyMemoryBootImageStart(struct vb2_context *ctx,
+				       VbSharedDataHeader *shared,
+				       VbSelectAndLoadKernelParams *kparams,
+				       void *boot_image,
+				       size_t image_size,
+				       size_t received);
+
+/**
+ * Hash more of a kernel image being verified as it arrives.
+ *
+ * @param ctx		Vboot context
+ * @param received	Bytes of the image in memory so far, in all
+ * @return VBERROR_... error, VBERROR_SUCCESS on success.  After an error,
+ * VbVerifyMemoryBootImageFinish() still has to be called.
+ */
+VbError_t VbVerifyMemoryBootImageExtend(struct vb2_context *ctx,
+					size_t received);
+
+/**
+ * Finish verifying a kernel image which has arrived in memory.
+ *
+ * Fills in kparams the same way VbVerifyMemoryBootImage() does.
+ *
+ * @param ctx		Vboot context
+ * @param kparams	kernel params
+ * @return VBERROR_... error, VBERROR_SUCCESS if the whole image is good.
+ */
+VbError_t VbVerifyMemoryBootImageFinish(struct vb2_context *ctx,
+					VbSelectAndLoadKernelParams *kparams);
+
 /**
  * Fastboot API to enter dev mode.
  *
@@ -404,6 +467,27 @@ void VbExSleepMs(uint32_t msec);
  */
 VbError_t VbExBeep(uint32_t msec, uint32_t frequency);
 
+/**
+ * Start a beep tone of the specified frequency in Hz, and return without
+ * waiting for it.  The firmware ends the tone by itself after msec, for
+ * example from a timer, unless VbExBeepStop() ends it sooner.
+ *
+ * This lets the UI loops keep reading keys while a tone plays.  It is
+ * optional; the default implementation returns VBERROR_NO_BACKGROUND_SOUND,
+ * and vboot plays the tone with VbExBeep() instead.
+ *
+ * @return VBERROR_SUCCESS if the tone is playing, or
+ * VBERROR_NO_BACKGROUND_SOUND if it can't be played in the background.
+ */
+VbError_t VbExBeepStart(uint32_t msec, uint32_t frequency);
+
+/**
+ * End a tone started by VbExBeepStart(), if it is still playing.
+ *
+ * This is optional; the default implementation does nothing.
+ */
+void VbExBeepStop(void);
+
 /*****************************************************************************/
 /* TPM (from tlcl_stub.h) */
 
@@ -427,6 +511,39 @@ VbError_t VbExTpmOpen(void);
 VbError_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
 			     uint8_t *response, uint32_t *response_length);
 
+/**
+ * Send count independent requests to the TPM and receive their responses, as
+ * if VbExTpmSendReceive() were called for each in turn.  Only the TPM2.0
+ * library uses this.  A platform whose transport can start on the next
+ * request while the TPM is still busy with this one may provide it; the
+ * default just calls VbExTpmSendReceive() for each request.  A response
+ * buffer may be the same as its request buffer.
+ */
+VbError_t VbExTpmSendReceiveMultiple(const uint8_t * const *requests,
+				     const uint32_t *request_lengths,
+				     uint8_t * const *responses,
+				     uint32_t *response_lengths,
+				     int count);
+
+/**
+ * Same as VbExTpmSendReceive(), but receive the response into count buffers
+ * in turn: the first response_sizes[0] bytes into responses[0], the next
+ * response_sizes[1] bytes into responses[1], and so on.  On exit,
+ * response_length is set to the total received response length in bytes.
+ * Only the TPM2.0 library uses this, so that the data from an NV_Read lands
+ * straight in the caller's buffer.  A platform whose driver reads responses
+ * out of a FIFO may provide it and put each byte where it belongs; the
+ * default receives into a buffer of its own with VbExTpmSendReceive() and
+ * copies the pieces out.  A response buffer may be the same as the request
+ * buffer.
+ */
+VbError_t VbExTpmSendReceiveScatter(const uint8_t *request,
+				    uint32_t request_length,
+				    uint8_t * const *responses,
+				    const uint32_t *response_sizes,
+				    int count,
+				    uint32_t *response_length);
+
 #ifdef CHROMEOS_ENVIRONMENT
 
 /**
@@ -555,6 +672,19 @@ VbError_t VbExDiskGetInfo(VbDiskInfo **infos_ptr, uint32_t *count,
 VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
 			   VbExDiskHandle_t preserve_handle);
 
+/**
+ * Return non-zero if the firmware reports removable disks coming and going.
+ *
+ * If so, VbExWaitForEvent() must return VB_EVENT_DISK (at the latest on the
+ * next call) whenever a removable disk is inserted or removed, and a disk
+ * which is removed and inserted again must get a new handle.  Vboot then only
+ * rescans removable disks after such an event, instead of every second, and
+ * doesn't read a disk LoadKernel() has already turned down again.
+ *
+ * This is optional; the default implementation returns 0.
+ */
+int VbExDiskHasHotplugEvents(void);
+
 /**
  * Read lba_count LBA sectors, starting at sector lba_start, from the disk,
  * into the buffer.
@@ -569,6 +699,26 @@ VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 		       uint64_t lba_count, void *buffer);
 
+/**
+ * Start reading lba_count LBA sectors, starting at sector lba_start, from the
+ * disk in the background.
+ *
+ * Before VbTryLoadKernel() tries any disk, it calls this for the GPT of each
+ * disk it may try, so firmware which can read several disks at once can start
+ * on all of them and return straight away.  Slow USB sticks and SD cards are
+ * then read at the same time, instead of one after another, and VbExDiskRead()
+ * of those sectors only has to wait for what is still left to read.  The
+ * disks are still tried, and picked, in the order VbExDiskGetInfo() lists
+ * them.
+ *
+ * This is only a hint: the sectors may not all be read, and the disk may be
+ * gone by the time they are.  It must not crash for an invalid handle.
+ *
+ * This is optional; the default implementation does nothing.
+ */
+void VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+		      uint64_t lba_count);
+
 /**
  * Write lba_count LBA sectors, starting at sector lba_start, to the disk, from
  * the buffer.
@@ -618,10 +768,44 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
  */
 VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer);
 
+/**
+ * Start an asynchronous read from a stream on a disk
+ *
+ * @param stream	Stream to read from
+ * @param bytes		Number of bytes to read
+ * @param buffer	Destination to read into
+ *
+ * @return Error code, or VBERROR_SUCCESS if the read was started.
+ *
+ * Like VbExStreamRead(), but may return before the data has arrived, so the
+ * caller can process a previous buffer while the read is in progress.  The
+ * caller must call VbExStreamWait() before touching buffer or starting
+ * another read on the stream; only one read may be outstanding at a time.
+ *
+ * Platforms which cannot read asynchronously need not implement this; the
+ * default does a synchronous VbExStreamRead().
+ */
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer);
+
+/**
+ * Wait for a read started by VbExStreamReadAsync() to complete
+ *
+ * @param stream	Stream to wait on
+ *
+ * @return Error code from the read, or VBERROR_SUCCESS.
+ *
+ * The default implementation returns VBERROR_SUCCESS, since the default
+ * VbExStreamReadAsync() has already finished the read.
+ */
+VbError_t VbExStreamWait(VbExStream_t stream);
+
 /**
  * Close a stream
  *
  * @param stream	Stream to close
+ *
+ * Waits for any read started by VbExStreamReadAsync() to complete first.
  */
 void VbExStreamClose(VbExStream_t stream);
 
@@ -716,7 +900,10 @@ VbError_t VbExDisplayScreen(uint32_t screen_type, uint32_t locale,
  * @param selected_index    Index of menu item that is currently selected.
  * @param disabled_idx_mask Bitmap for enabling/disabling certain menu items.
  *                          each bit corresponds to the menu item's index.
- * @param redraw_base       Setting 1 will force a full redraw of the screen
+ * @param redraw_base       Setting 1 will force a full redraw of the screen.
+ *                          0 means only the selection or disabled items
+ *                          changed since the last call, and the rest of the
+ *                          screen can be left as it is.
  *
  * @return VBERROR_SUCCESS or error code on error.
  */
@@ -826,6 +1013,33 @@ uint32_t VbExKeyboardRead(void);
  */
 uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr);
 
+/* Events for VbExWaitForEvent() */
+/* Key or button press, to be read with VbExKeyboardRead() */
+#define VB_EVENT_KEY		(1 << 0)
+/* Shutdown request, as reported by VbExIsShutdownRequested() */
+#define VB_EVENT_SHUTDOWN	(1 << 1)
+/* Removable disk inserted or removed */
+#define VB_EVENT_DISK		(1 << 2)
+
+/**
+ * Wait up to timeout_ms for one of the VB_EVENT_* events in event_mask.
+ *
+ * The UI loops call this between polls instead of VbExSleepMs(), so firmware
+ * which gets interrupts for keys, the power button or USB can idle until
+ * something happens.  Returning early is always safe, since vboot polls the
+ * usual functions (VbExKeyboardRead() and so on) before acting.  The timeout
+ * also drives vboot's timers and beeps, so it should not be exceeded by much.
+ *
+ * This is optional; the default implementation just calls VbExSleepMs().
+ *
+ * @param timeout_ms	Longest time to wait, in milliseconds
+ * @param event_mask	Events which should end the wait (VB_EVENT_*)
+ *
+ * @return The events in event_mask which happened, or 0 on timeout or if
+ * unknown.
+ */
+uint32_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t event_mask);
+
 /**
  * Return the current state of the switches specified in request_mask
  */
@@ -881,6 +1095,36 @@ VbError_t VbExEcDisableJump(int devidx);
 VbError_t VbExEcHashImage(int devidx, enum VbSelectFirmware_t select,
 			  const uint8_t **hash, int *hash_size);
 
+/**
+ * Ask the EC to start hashing the selected image, without waiting for the
+ * result.  Software sync starts the hashes on every device before collecting
+ * any of them with VbExEcHashImage(), so the EC and PD can hash at the same
+ * time.  Optional; the default does nothing, and VbExEcHashImage() computes
+ * the hash as before.
+ *
+ * @param devidx    Device index. 0: EC, 1: PD.
+ * @param select    Image to hash. RO or RW.
+ * @return          VBERROR_... error, VBERROR_SUCCESS on success.  Errors
+ *		    are not fatal; VbExEcHashImage() is still called.
+ */
+VbError_t VbExEcHashImageStart(int devidx, enum VbSelectFirmware_t select);
+
+/**
+ * Read the EC's software sync nonce, so software sync can skip hashing EC-RW
+ * when it hasn't changed since it last matched.  Optional; the default returns
+ * an error, and EC-RW is hashed on every boot.
+ *
+ * EC-RO must pick a new nonce on every EC reset and every time RW is written
+ * or erased, and must never use 0.  The EC must refuse to report the nonce
+ * after VbExEcDisableJump() until it is reset, so that the OS can't use it to
+ * forge the cached result in nvstorage.
+ *
+ * @param devidx	Device index. 0: EC, 1: PD.
+ * @param nonce		Set to the current nonce
+ * @return VBERROR_... error, VBERROR_SUCCESS on success.
+ */
+VbError_t VbExEcGetSyncNonce(int devidx, uint32_t *nonce);
+
 /**
  * Get the expected contents of the EC image associated with the main firmware
  * specified by the "select" argument.
@@ -901,6 +1145,35 @@ VbError_t VbExEcGetExpectedImageHash(int devidx, enum VbSelectFirmware_t select,
 VbError_t VbExEcUpdateImage(int devidx, enum VbSelectFirmware_t select,
 			    const uint8_t *image, int image_size);
 
+/**
+ * Read SHA-256 hashes of each block of the selected EC image, so that
+ * software sync can rewrite only the blocks which differ from the expected
+ * image.  Optional; the default returns VBERROR_EC_BLOCK_HASHES_UNSUPPORTED,
+ * and the whole image is written with VbExEcUpdateImage().
+ *
+ * @param devidx     Device index. 0: EC, 1: PD.
+ * @param select     Image to hash. RO or RW.
+ * @param block_size Set to the size of each block in bytes
+ * @param hashes     Set to the hashes, block 0 first, one
+ *		     VB2_SHA256_DIGEST_SIZE hash per block
+ * @param count      Set to the number of blocks.  The last one may be
+ *		     shorter than block_size.
+ * @return VBERROR_... error, VBERROR_SUCCESS on success.  Any error makes
+ *	   software sync fall back to VbExEcUpdateImage().
+ */
+VbError_t VbExEcGetBlockHashes(int devidx, enum VbSelectFirmware_t select,
+			       uint32_t *block_size, const uint8_t **hashes,
+			       int *count);
+
+/**
+ * Rewrite part of the selected EC image.  Only called after
+ * VbExEcGetBlockHashes() succeeded for the same image; offset and size are
+ * always on block boundaries, except at the end of the image.
+ */
+VbError_t VbExEcUpdateImageBlocks(int devidx, enum VbSelectFirmware_t select,
+				  uint32_t offset, const uint8_t *data,
+				  uint32_t size);
+
 /**
  * Lock the selected EC code to prevent updates until the EC is rebooted.
  * Subsequent calls to VbExEcUpdateImage() with the same region this boot will
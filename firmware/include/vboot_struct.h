@@ -10,6 +10,8 @@
 #define VBOOT_REFERENCE_VBOOT_STRUCT_H_
 #include <stdint.h>
 
+#include "2trace.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif  /* __cplusplus */
@@ -96,7 +98,7 @@ typedef struct VbKeyBlockHeader {
 /****************************************************************************/
 
 #define KERNEL_PREAMBLE_HEADER_VERSION_MAJOR 2
-#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 2
+#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 4
 
 /* Preamble block for kernel, version 2.0
  *
@@ -185,10 +187,33 @@ typedef struct VbKernelPreambleHeader {
 	 *                             0b10 - multiboot)
 	 */
 	uint32_t flags;
+	/*
+	 * Fields added in header version 2.3.  You must verify the header
+	 * version before reading these fields!
+	 */
+	/* Size of the chunks the body is hashed in, or 0 if the body
+	   signature signs the whole body.  Readers should return 0 for header
+	   version < 2.3 */
+	uint32_t body_chunk_size;
+	/* Offset from the start of the preamble and size of the table of
+	   chunk digests */
+	uint32_t body_chunk_digests_offset;
+	uint32_t body_chunk_digests_size;
+	/*
+	 * Fields added in header version 2.4.  You must verify the header
+	 * version before reading these fields!
+	 */
+	/* How the body is compressed on disk.  Readers should return 0 (not
+	   compressed) for header version < 2.4 */
+	uint32_t body_compression;
+	/* Size of the body after it is decompressed */
+	uint32_t body_uncompressed_size;
 } __attribute__((packed)) VbKernelPreambleHeader;
 
 #define EXPECTED_VBKERNELPREAMBLEHEADER2_1_SIZE 112
 #define EXPECTED_VBKERNELPREAMBLEHEADER2_2_SIZE 116
+#define EXPECTED_VBKERNELPREAMBLEHEADER2_3_SIZE 128
+#define EXPECTED_VBKERNELPREAMBLEHEADER2_4_SIZE 136
 
 /****************************************************************************/
 
@@ -198,7 +223,7 @@ typedef struct VbKernelPreambleHeader {
 #define VB_SHARED_DATA_MAGIC 0x44536256
 
 /* Minimum and recommended size of shared_data_blob in bytes. */
-#define VB_SHARED_DATA_MIN_SIZE 3072
+#define VB_SHARED_DATA_MIN_SIZE 4352
 #define VB_SHARED_DATA_REC_SIZE 16384
 
 /* Flags for VbSharedDataHeader */
@@ -295,6 +320,10 @@ typedef struct VbKernelPreambleHeader {
 
 /* Flags for VbSharedDataKernelPart.flags */
 #define VBSD_LKP_FLAG_KEY_BLOCK_VALID   0x01
+/* Key block was checked by its hash alone, without trying its signature */
+#define VBSD_LKP_FLAG_KEY_BLOCK_HASH_ONLY 0x02
+/* Vblock was rejected before checking any of its hashes or signatures */
+#define VBSD_LKP_FLAG_EARLY_REJECT      0x04
 
 /* Result codes for VbSharedDataKernelPart.check_result */
 #define VBSD_LKP_CHECK_NOT_DONE           0
@@ -480,10 +509,56 @@ typedef struct VbSharedDataHeader {
 	uint32_t kernel_version_lowest;
 
 	/*
-	 * After read-only firmware which uses version 2 is released, any
+	 * Fields added in version 3.  Before accessing, make sure that
+	 * struct_version >= 3
+	 */
+	/* Number of boot trace events, including ones no longer in trace[] */
+	uint32_t trace_count;
+	/* Reserved for padding */
+	uint32_t reserved3;
+	/*
+	 * Boot trace, copied from vb2_shared_data when the kernel is chosen.
+	 * Event N is at trace[N % VB2_TRACE_ENTRIES].
+	 */
+	struct vb2_trace_entry trace[VB2_TRACE_ENTRIES];
+
+	/*
+	 * Fields added in version 4.  Before accessing, make sure that
+	 * struct_version >= 4
+	 */
+	/* Number of entries used in tpm_stats[] */
+	uint32_t tpm_stats_count;
+	/* Reserved for padding */
+	uint32_t reserved4;
+	/* TPM commands sent by firmware, copied when the kernel is chosen */
+	struct vb2_tpm_stat tpm_stats[VB2_TPM_STAT_ENTRIES];
+
+	/*
+	 * Fields added in version 5.  Before accessing, make sure that
+	 * struct_version >= 5
+	 */
+	/* Number of entries used in disk_reads[] */
+	uint32_t disk_reads_count;
+	/* Number of reads not in disk_reads[] because it was full */
+	uint32_t disk_reads_dropped;
+	/* Disk reads made by LoadKernel(), copied when the kernel is chosen */
+	struct vb2_disk_read disk_reads[VB2_DISK_READ_ENTRIES];
+
+	/*
+	 * Fields added in version 6.  Before accessing, make sure that
+	 * struct_version >= 6
+	 */
+	/*
+	 * Cost of each verification step (enum vb2_cost_step), copied from
+	 * vb2_shared_data when the kernel is chosen
+	 */
+	struct vb2_cost costs[VB2_COST_ENTRIES];
+
+	/*
+	 * After read-only firmware which uses version 6 is released, any
 	 * additional fields must be added below, and the struct version must
 	 * be increased.  Before reading/writing those fields, make sure that
-	 * the struct being accessed is at least version 3.
+	 * the struct being accessed is at least version 7.
 	 *
 	 * It's always ok for an older firmware to access a newer struct, since
 	 * all the fields it knows about are present.  Newer firmware needs to
@@ -499,8 +574,19 @@ typedef struct VbSharedDataHeader {
  */
 #define VB_SHARED_DATA_HEADER_SIZE_V1 1072
 #define VB_SHARED_DATA_HEADER_SIZE_V2 1096
+#define VB_SHARED_DATA_HEADER_SIZE_V3 1616
+#define VB_SHARED_DATA_HEADER_SIZE_V4 1912
+#define VB_SHARED_DATA_HEADER_SIZE_V5 2176
+#define VB_SHARED_DATA_HEADER_SIZE_V6 2304
+
+/*
+ * Room a minimum-size buffer must leave after the header, for the kernel
+ * subkey and the rest of the data.  This is what it left after the version 2
+ * header; VB_SHARED_DATA_MIN_SIZE grows with the header to keep it.
+ */
+#define VB_SHARED_DATA_MIN_ROOM 1976
 
-#define VB_SHARED_DATA_VERSION 2      /* Version for struct_version */
+#define VB_SHARED_DATA_VERSION 6      /* Version for struct_version */
 
 #ifdef __cplusplus
 }
@@ -19,8 +19,10 @@ int GptInit(GptData *gpt)
 	int retval;
 
 	gpt->modified = 0;
+	gpt->dirty_entry_sectors = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	gpt->current_priority = 999;
+	gpt->kernel_candidates_built = 0;
 
 	retval = GptSanityCheck(gpt);
 	if (GPT_SUCCESS != retval) {
@@ -32,88 +34,122 @@ int GptInit(GptData *gpt)
 	return GPT_SUCCESS;
 }
 
-int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
+/*
+ * Finds the bootable kernel entries which GptNextKernelEntry() has yet to
+ * return, and sorts them by priority.  Kernels with the same priority stay in
+ * table order.
+ */
+static void GptBuildKernelCandidates(GptData *gpt)
 {
 	GptHeader *header = (GptHeader *)gpt->primary_header;
 	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	GptKernelCandidate *c = gpt->kernel_candidates;
 	GptEntry *e;
-	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	int new_prio = 0;
+	int n = 0, j;
+	int truncated = 0;
 	uint32_t i;
 
-	/*
-	 * If we already found a kernel, continue the scan at the current
-	 * kernel's priority, in case there is another kernel with the same
-	 * priority.
-	 */
-	if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-		for (i = gpt->current_kernel + 1;
-		     i < header->number_of_entries; i++) {
-			e = entries + i;
-			if (!IsKernelEntry(e))
-				continue;
-			VB2_DEBUG("GptNextKernelEntry looking at same prio "
-				  "partition %d\n", i+1);
-			VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-				  GetEntrySuccessful(e), GetEntryTries(e),
-				  GetEntryPriority(e));
-			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-				continue;
-			if (GetEntryPriority(e) == gpt->current_priority) {
-				gpt->current_kernel = i;
-				*start_sector = e->starting_lba;
-				*size = e->ending_lba - e->starting_lba + 1;
-				VB2_DEBUG("GptNextKernelEntry likes it\n");
-				return GPT_SUCCESS;
-			}
-		}
-	}
-
-	/*
-	 * We're still here, so scan for the remaining kernel with the highest
-	 * priority less than the previous attempt.
-	 */
 	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
-		int current_prio = GetEntryPriority(e);
+		int prio;
+
 		if (!IsKernelEntry(e))
 			continue;
-		VB2_DEBUG("GptNextKernelEntry looking at new prio "
-			  "partition %d\n", i+1);
+		prio = GetEntryPriority(e);
+		VB2_DEBUG("GptNextKernelEntry looking at partition %d\n", i+1);
 		VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-			  GetEntrySuccessful(e), GetEntryTries(e),
-			  GetEntryPriority(e));
-		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+			  GetEntrySuccessful(e), GetEntryTries(e), prio);
+		if (!(GetEntrySuccessful(e) || GetEntryTries(e)) || !prio)
 			continue;
-		if (current_prio >= gpt->current_priority) {
-			/* Already returned this kernel in a previous call */
+
+		/* Skip kernels already returned in a previous call */
+		if (prio > gpt->current_priority ||
+		    (prio == gpt->current_priority &&
+		     (int)i <= gpt->current_kernel))
 			continue;
+
+		/*
+		 * With more kernels than fit, keep the ones to try first.
+		 * The rest are found again when these run out.
+		 */
+		if (n == GPT_MAX_KERNEL_CANDIDATES) {
+			truncated = 1;
+			if (c[n - 1].priority >= prio)
+				continue;
+			n--;
 		}
-		if (current_prio > new_prio) {
-			new_kernel = i;
-			new_prio = current_prio;
-		}
+
+		for (j = n; j > 0 && c[j - 1].priority < prio; j--)
+			c[j] = c[j - 1];
+		c[j].index = i;
+		c[j].priority = prio;
+		n++;
 	}
 
+	gpt->num_kernel_candidates = n;
+	gpt->next_kernel_candidate = 0;
+	gpt->kernel_candidates_built = 1;
+	gpt->kernel_candidates_truncated = truncated;
+}
+
+int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
+{
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	GptKernelCandidate *c;
+	GptEntry *e;
+
+	if (!gpt->kernel_candidates_built ||
+	    (gpt->next_kernel_candidate >= gpt->num_kernel_candidates &&
+	     gpt->kernel_candidates_truncated))
+		GptBuildKernelCandidates(gpt);
+
 	/*
-	 * Save what we found.  Note that if we didn't find a new kernel,
-	 * new_prio will still be -1, so future calls to this function will
-	 * also fail.
+	 * If we run out of kernels, future calls to this function will also
+	 * fail.
 	 */
-	gpt->current_kernel = new_kernel;
-	gpt->current_priority = new_prio;
-
-	if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
+	if (gpt->next_kernel_candidate >= gpt->num_kernel_candidates) {
+		gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		gpt->current_priority = 0;
 		VB2_DEBUG("GptNextKernelEntry no more kernels\n");
 		return GPT_ERROR_NO_VALID_KERNEL;
 	}
 
-	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", new_kernel + 1);
-	e = entries + new_kernel;
+	c = gpt->kernel_candidates + gpt->next_kernel_candidate++;
+	gpt->current_kernel = c->index;
+	gpt->current_priority = c->priority;
+
+	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", c->index + 1);
+	e = entries + c->index;
 	*start_sector = e->starting_lba;
 	*size = e->ending_lba - e->starting_lba + 1;
 	return GPT_SUCCESS;
 }
 
+/*
+ * Updates the GPT after entry e was changed, and notes which sector of the
+ * entry array it is in, so that WriteAndFreeGptData() only needs to write that
+ * sector.  If the whole array was already going to be written, it still is.
+ */
+static void GptModifiedEntry(GptData *gpt, GptEntry *e)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	uint32_t entries_bytes = header->number_of_entries *
+		header->size_of_entry;
+	uint32_t offset = (uint8_t *)e - gpt->primary_entries;
+	uint32_t sector = offset / gpt->sector_bytes;
+	uint32_t dirty = gpt->dirty_entry_sectors;
+	int whole = (gpt->modified &
+		     (GPT_MODIFIED_ENTRIES1 | GPT_MODIFIED_ENTRIES2)) && !dirty;
+
+	GptModified(gpt);
+
+	/* Otherwise the whole array still needs writing */
+	if (whole || (uint8_t *)e < gpt->primary_entries ||
+	    offset >= entries_bytes || sector >= 32)
+		return;
+
+	gpt->dirty_entry_sectors = dirty | (1U << sector);
+}
+
 /*
  * Func: GptUpdateKernelWithEntry
  * Desc: This function updates the given kernel entry according to the provided
@@ -186,7 +222,14 @@ int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 	}
 
 	if (modified) {
-		GptModified(gpt);
+		GptModifiedEntry(gpt, e);
+
+		/*
+		 * A kernel which hasn't been returned yet may need to move in
+		 * the list, so rebuild it next time.
+		 */
+		if (e != (GptEntry *)gpt->primary_entries + gpt->current_kernel)
+			gpt->kernel_candidates_built = 0;
 	}
 
 	return GPT_SUCCESS;
@@ -103,11 +103,19 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	 */
 	if (h->size_of_entry != sizeof(GptEntry))
 		return 1;
-	if ((h->number_of_entries < MIN_NUMBER_OF_ENTRIES) ||
-	    (h->number_of_entries > MAX_NUMBER_OF_ENTRIES) ||
-	    (!(flags & GPT_FLAG_EXTERNAL) &&
-	    h->number_of_entries != MAX_NUMBER_OF_ENTRIES))
+	if (flags & GPT_FLAG_LARGE_TABLE) {
+		/* Internal drives still need at least the usual table */
+		if ((h->number_of_entries < MIN_NUMBER_OF_ENTRIES) ||
+		    (h->number_of_entries > MAX_LARGE_NUMBER_OF_ENTRIES) ||
+		    (!(flags & GPT_FLAG_EXTERNAL) &&
+		    h->number_of_entries < MAX_NUMBER_OF_ENTRIES))
+			return 1;
+	} else if ((h->number_of_entries < MIN_NUMBER_OF_ENTRIES) ||
+		   (h->number_of_entries > MAX_NUMBER_OF_ENTRIES) ||
+		   (!(flags & GPT_FLAG_EXTERNAL) &&
+		   h->number_of_entries != MAX_NUMBER_OF_ENTRIES)) {
 		return 1;
+	}
 
 	/*
 	 * Check locations for the header and its entries.  The primary
@@ -161,21 +169,15 @@ int IsKernelEntry(const GptEntry *e)
 	return !memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
-int CheckEntries(GptEntry *entries, GptHeader *h)
+/*
+ * Check each entry against every other one.  This is O(n^2), so it's only
+ * used to find out which error a table has.
+ */
+static int CheckEntriesPairwise(GptEntry *entries, GptHeader *h)
 {
-	if (!entries)
-		return GPT_ERROR_INVALID_ENTRIES;
 	GptEntry *entry;
-	uint32_t crc32;
 	uint32_t i;
 
-	/* Check CRC before examining entries. */
-	crc32 = Crc32((const uint8_t *)entries,
-		      h->size_of_entry * h->number_of_entries);
-	if (crc32 != h->entries_crc32)
-		return GPT_ERROR_CRC_CORRUPTED;
-
-	/* Check all entries. */
 	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
 		GptEntry *e2;
 		uint32_t i2;
@@ -209,10 +211,143 @@ int CheckEntries(GptEntry *entries, GptHeader *h)
 		}
 	}
 
-	/* Success */
 	return 0;
 }
 
+typedef int (*EntryCompare)(const GptEntry *a, const GptEntry *b);
+
+static int CompareStartingLba(const GptEntry *a, const GptEntry *b)
+{
+	return a->starting_lba < b->starting_lba ? -1 :
+		a->starting_lba > b->starting_lba;
+}
+
+static int CompareUniqueGuid(const GptEntry *a, const GptEntry *b)
+{
+	return memcmp(&a->unique, &b->unique, sizeof(Guid));
+}
+
+/* Heapsort a list of entry indices, so it needs no extra memory. */
+static void SortEntries(const GptEntry *entries, uint16_t *order,
+			uint32_t count, EntryCompare compare)
+{
+	uint32_t start, end, root, child;
+	uint16_t swap;
+
+	if (count < 2)
+		return;
+
+	for (start = count / 2, end = count; end > 1;) {
+		if (start > 0) {
+			/* Still building the heap */
+			start--;
+		} else {
+			/* Move the biggest entry to the end */
+			end--;
+			swap = order[end];
+			order[end] = order[0];
+			order[0] = swap;
+		}
+
+		for (root = start; (child = 2 * root + 1) < end; root = child) {
+			if (child + 1 < end &&
+			    compare(entries + order[child],
+				    entries + order[child + 1]) < 0)
+				child++;
+			if (compare(entries + order[root],
+				    entries + order[child]) >= 0)
+				break;
+			swap = order[root];
+			order[root] = order[child];
+			order[child] = swap;
+		}
+	}
+}
+
+/*
+ * Return non-zero if the used entries are all in the usable region, don't
+ * overlap, and have different unique GUIDs.  This sorts them instead of
+ * comparing each pair, so it's O(n log n).  Zero doesn't say what's wrong;
+ * it can also mean there are too many entries to sort.
+ */
+static int EntriesAllGood(GptEntry *entries, GptHeader *h)
+{
+	uint16_t order_buf[MAX_NUMBER_OF_ENTRIES];
+	uint16_t *order = order_buf;
+	uint32_t count = 0;
+	uint32_t i;
+	int good = 0;
+
+	if (h->number_of_entries > MAX_LARGE_NUMBER_OF_ENTRIES)
+		return 0;
+
+	/* Only large tables, which firmware never sees, need the heap */
+	if (h->number_of_entries > MAX_NUMBER_OF_ENTRIES) {
+		order = malloc(h->number_of_entries * sizeof(*order));
+		if (!order)
+			return 0;
+	}
+
+	for (i = 0; i < h->number_of_entries; i++) {
+		GptEntry *entry = entries + i;
+
+		if (IsUnusedEntry(entry))
+			continue;
+		if ((entry->starting_lba < h->first_usable_lba) ||
+		    (entry->ending_lba > h->last_usable_lba) ||
+		    (entry->ending_lba < entry->starting_lba))
+			goto out;
+		order[count++] = i;
+	}
+
+	/*
+	 * In order of starting LBA, the entries don't overlap if each starts
+	 * after the previous one ends.
+	 */
+	SortEntries(entries, order, count, CompareStartingLba);
+	for (i = 1; i < count; i++) {
+		if (entries[order[i]].starting_lba <=
+		    entries[order[i - 1]].ending_lba)
+			goto out;
+	}
+
+	SortEntries(entries, order, count, CompareUniqueGuid);
+	for (i = 1; i < count; i++) {
+		if (0 == CompareUniqueGuid(entries + order[i],
+					   entries + order[i - 1]))
+			goto out;
+	}
+
+	good = 1;
+ out:
+	if (order != order_buf)
+		free(order);
+	return good;
+}
+
+int CheckEntries(GptEntry *entries, GptHeader *h)
+{
+	if (!entries)
+		return GPT_ERROR_INVALID_ENTRIES;
+	uint32_t crc32;
+
+	/* Check CRC before examining entries. */
+	crc32 = Crc32((const uint8_t *)entries,
+		      h->size_of_entry * h->number_of_entries);
+	if (crc32 != h->entries_crc32)
+		return GPT_ERROR_CRC_CORRUPTED;
+
+	/*
+	 * Good tables are the common case, so check for that quickly.  If
+	 * anything is wrong, compare each pair of entries to report the same
+	 * error as always.
+	 */
+	if (EntriesAllGood(entries, h))
+		return 0;
+
+	return CheckEntriesPairwise(entries, h);
+}
+
 int HeaderFieldsSame(GptHeader *h1, GptHeader *h2)
 {
 	if (memcmp(h1->signature, h2->signature, sizeof(h1->signature)))
@@ -478,6 +613,9 @@ void GptModified(GptData *gpt) {
 	gpt->valid_headers = MASK_PRIMARY;
 	gpt->valid_entries = MASK_PRIMARY;
 	GptRepair(gpt);
+
+	/* Any of the entries may have changed */
+	gpt->dirty_entry_sectors = 0;
 }
 
 
@@ -0,0 +1,198 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CPU-accelerated CRC32 for host builds.  Crc32() hands each buffer to
+ * Crc32Accel() first, which consumes as much of it as the CPU can do quickly
+ * and leaves the rest to the portable slicing-by-8 code.
+ *
+ * This file is only built for the host, so it may include system headers
+ * directly.
+ *
+ * The aarch64 code hasn't been run on hardware yet, so it is only built when
+ * asked for (make USE_ARMV8_ACCEL=1); otherwise aarch64 uses the portable
+ * code.
+ */
+
+#include "crc32.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CRC32_X86 1
+#elif defined(__aarch64__) && defined(__linux__) && CRC32_ACCEL_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define CRC32_ARMV8 1
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+/* Set by Crc32AccelEnable() */
+static int accel_enabled = 1;
+
+/* -1 until the CPU has been probed, then 0 or 1 */
+static int accel_supported = -1;
+
+#ifdef CRC32_X86
+
+/* CPUID.1:ECX bits */
+#define CPUID_SSE41	(1 << 19)
+#define CPUID_PCLMUL	(1 << 1)
+
+static int cpu_supported(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (ecx & (CPUID_SSE41 | CPUID_PCLMUL)) ==
+		(CPUID_SSE41 | CPUID_PCLMUL);
+}
+
+/* Fold one 128-bit lane forward by the distance encoded in k, then add in. */
+#define FOLD(x, k, data) \
+	_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), \
+				    _mm_clmulepi64_si128(x, k, 0x11)), \
+		      (data))
+
+/*
+ * Carry-less multiply folding, from Gopal et al., "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), using the
+ * bit-reflected constants for the 0xedb88320 polynomial.  Handles buffers of
+ * at least 64 bytes, in 16-byte multiples.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	/* x^(4*128+32) mod P, x^(4*128-32) mod P */
+	const __m128i k1k2 = _mm_set_epi64x(0x00000001c6e41596ULL,
+					    0x0000000154442bd4ULL);
+	/* x^(128+32) mod P, x^(128-32) mod P */
+	const __m128i k3k4 = _mm_set_epi64x(0x00000000ccaa009eULL,
+					    0x00000001751997d0ULL);
+	/* x^64 mod P */
+	const __m128i k5 = _mm_set_epi64x(0, 0x0000000163cd6124ULL);
+	/* Barrett constants: floor(x^64 / P) and P, both reflected */
+	const __m128i poly = _mm_set_epi64x(0x00000001f7011641ULL,
+					    0x00000001db710641ULL);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, ~0);
+	__m128i x0, x1, x2, x3, t;
+
+	x0 = _mm_loadu_si128((const __m128i *)(buf + 0));
+	x1 = _mm_loadu_si128((const __m128i *)(buf + 16));
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 32));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 48));
+	x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128(crc));
+	buf += 64;
+	len -= 64;
+
+	/* Fold four lanes at a time, 64 bytes per step */
+	for (; len >= 64; len -= 64, buf += 64) {
+		x0 = FOLD(x0, k1k2,
+			  _mm_loadu_si128((const __m128i *)(buf + 0)));
+		x1 = FOLD(x1, k1k2,
+			  _mm_loadu_si128((const __m128i *)(buf + 16)));
+		x2 = FOLD(x2, k1k2,
+			  _mm_loadu_si128((const __m128i *)(buf + 32)));
+		x3 = FOLD(x3, k1k2,
+			  _mm_loadu_si128((const __m128i *)(buf + 48)));
+	}
+
+	/* Fold the four lanes into one */
+	x0 = FOLD(x0, k3k4, x1);
+	x0 = FOLD(x0, k3k4, x2);
+	x0 = FOLD(x0, k3k4, x3);
+
+	/* Then any remaining 16-byte blocks */
+	for (; len >= 16; len -= 16, buf += 16)
+		x0 = FOLD(x0, k3k4, _mm_loadu_si128((const __m128i *)buf));
+
+	/* 128 -> 64 bits; this also appends the 32 zero bits the CRC needs */
+	t = _mm_clmulepi64_si128(k3k4, x0, 0x01);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), t);
+
+	/* 64 -> 32 bits */
+	t = _mm_srli_si128(x0, 4);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00);
+	x0 = _mm_xor_si128(x0, t);
+
+	/* Barrett reduction down to the final 32-bit CRC */
+	t = x0;
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x10);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x00);
+	x0 = _mm_xor_si128(x0, t);
+
+	return (uint32_t)_mm_extract_epi32(x0, 1);
+}
+
+uint32_t Crc32Accel(uint32_t *value, const uint8_t *buf, uint32_t len)
+{
+	uint32_t n = len & ~15U;
+
+	/* Not worth the setup for less than 64 bytes */
+	if (n < 64 || !accel_enabled)
+		return 0;
+
+	if (accel_supported < 0)
+		accel_supported = cpu_supported();
+	if (!accel_supported)
+		return 0;
+
+	*value = crc32_pclmul(*value, buf, n);
+	return n;
+}
+
+#elif defined(CRC32_ARMV8)
+
+static int cpu_supported(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+}
+
+/*
+ * ARMv8 has CRC32 instructions for exactly this polynomial, which are simpler
+ * and at least as fast as PMULL folding for the buffer sizes GPT uses.
+ */
+__attribute__((target("+crc")))
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	for (; len >= 8; len -= 8, buf += 8) {
+		uint64_t v;
+
+		memcpy(&v, buf, sizeof(v));
+		crc = __crc32d(crc, v);
+	}
+	return crc;
+}
+
+uint32_t Crc32Accel(uint32_t *value, const uint8_t *buf, uint32_t len)
+{
+	uint32_t n = len & ~7U;
+
+	if (!n || !accel_enabled)
+		return 0;
+
+	if (accel_supported < 0)
+		accel_supported = cpu_supported();
+	if (!accel_supported)
+		return 0;
+
+	*value = crc32_armv8(*value, buf, n);
+	return n;
+}
+
+#else
+
+uint32_t Crc32Accel(uint32_t *value, const uint8_t *buf, uint32_t len)
+{
+	return 0;
+}
+
+#endif
+
+void Crc32AccelEnable(int enable)
+{
+	accel_enabled = enable;
+}
@@ -59,6 +59,8 @@
 #define SIZE_OF_ENTRY_MULTIPLE 8
 #define MIN_NUMBER_OF_ENTRIES 16
 #define MAX_NUMBER_OF_ENTRIES 128
+/* Most entries a GPT may have with GPT_FLAG_LARGE_TABLE */
+#define MAX_LARGE_NUMBER_OF_ENTRIES 4096
 
 /* Defines GPT sizes */
 #define GPT_PMBR_SECTORS 1  /* size (in sectors) of PMBR */
@@ -7,6 +7,40 @@
 
 #include "sysincludes.h"
 
+/* Use CPU-accelerated CRC32 where available; only supported for host builds */
+#ifndef CRC32_ACCEL
+#define CRC32_ACCEL 0
+#endif
+
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Add more data to a CRC32.
+ *
+ * @param crc		CRC32 of the data before buffer, or 0 to start
+ * @param buffer	Data to add
+ * @param len		Length of data in bytes
+ * @return The CRC32 of all the data so far, as Crc32() would give for it.
+ */
+uint32_t Crc32Update(uint32_t crc, const void *buffer, uint32_t len);
+
+#if CRC32_ACCEL
+/**
+ * Run the CPU-accelerated CRC32 over a prefix of a buffer.
+ *
+ * @param value		Running (non-inverted) CRC; updated in place
+ * @param buf		Data to checksum
+ * @param len		Length of data in bytes
+ * @return The number of bytes consumed, which may be anywhere from 0 to len.
+ * The caller must handle the rest of the buffer itself.
+ */
+uint32_t Crc32Accel(uint32_t *value, const uint8_t *buf, uint32_t len);
+
+/**
+ * Enable or disable the accelerated path.  Enabled by default; tests disable
+ * it to compare against the portable code.
+ */
+void Crc32AccelEnable(int enable);
+#endif
+
 #endif  /* VBOOT_REFERENCE_GPT_CRC32_H_ */
@@ -0,0 +1,75 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Trace of the disk reads made while looking for a kernel.
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+
+#include "gpt_misc.h"
+
+static struct vb2_disk_read reads[VB2_DISK_READ_ENTRIES];
+static uint32_t reads_count;
+static uint32_t reads_dropped;
+static uint8_t current_call;
+
+void VbDiskReadRecord(uint64_t lba_start, uint64_t lba_count,
+		      uint32_t purpose)
+{
+	struct vb2_disk_read *r;
+
+	if (reads_count) {
+		r = reads + reads_count - 1;
+		if (r->lk_call == current_call && r->purpose == purpose &&
+		    r->lba_start + r->lba_count == lba_start &&
+		    r->lba_count + lba_count <= UINT32_MAX &&
+		    r->requests < UINT16_MAX) {
+			r->lba_count += lba_count;
+			r->requests++;
+			return;
+		}
+	}
+
+	if (reads_count == VB2_DISK_READ_ENTRIES ||
+	    lba_count > UINT32_MAX) {
+		reads_dropped++;
+		return;
+	}
+
+	r = reads + reads_count++;
+	r->lba_start = lba_start;
+	r->lba_count = lba_count;
+	r->lk_call = current_call;
+	r->purpose = purpose;
+	r->requests = 1;
+}
+
+void VbDiskReadStartCall(uint32_t lk_call)
+{
+	uint32_t i, kept = 0;
+
+	current_call = lk_call;
+	for (i = 0; i < reads_count; i++) {
+		if (reads[i].lk_call != current_call)
+			reads[kept++] = reads[i];
+	}
+	reads_count = kept;
+}
+
+const struct vb2_disk_read *VbDiskReadGetTrace(uint32_t *count,
+					       uint32_t *dropped)
+{
+	*count = reads_count;
+	*dropped = reads_dropped;
+	return reads;
+}
+
+void VbDiskReadReset(void)
+{
+	memset(reads, 0, sizeof(reads));
+	reads_count = 0;
+	reads_dropped = 0;
+	current_call = 0;
+}
@@ -9,6 +9,7 @@
 #include "2common.h"
 #include "2misc.h"
 #include "2nvstorage.h"
+#include "2sha.h"
 
 #include "sysincludes.h"
 #include "ec_sync.h"
@@ -89,6 +90,31 @@ static const char *image_name_to_string(enum VbSelectFirmware_t select)
 	}
 }
 
+/*
+ * Default for ECs which can't hash in the background; VbExEcHashImage() then
+ * does all the work.
+ */
+__attribute__((weak))
+VbError_t VbExEcHashImageStart(int devidx, enum VbSelectFirmware_t select)
+{
+	return VBERROR_SUCCESS;
+}
+
+/**
+ * Start hashing an EC image, so check_ec_hash() can collect it later.
+ *
+ * @param devidx	Index of EC device to hash
+ * @param select	Which firmware image to hash
+ */
+static void start_ec_hash(int devidx, enum VbSelectFirmware_t select)
+{
+	int rv = VbExEcHashImageStart(devidx, select);
+
+	/* Not fatal; check_ec_hash() will wait for the hash instead */
+	if (rv)
+		VB2_DEBUG("VbExEcHashImageStart() returned %d\n", rv);
+}
+
 /**
  * Check if the hash of the EC code matches the expected hash.
  *
@@ -137,6 +163,164 @@ static int check_ec_hash(struct vb2_context *ctx, int devidx,
 	return VB2_SUCCESS;
 }
 
+/* Default for ECs which can't tell when RW last changed */
+__attribute__((weak))
+VbError_t VbExEcGetSyncNonce(int devidx, uint32_t *nonce)
+{
+	return VBERROR_UNKNOWN;
+}
+
+/* First 4 bytes of a hash, in the form stored in VB2_NV_EC_SYNC_HASH */
+static uint32_t hash_prefix(const uint8_t *hash)
+{
+	return hash[0] | (hash[1] << 8) | (hash[2] << 16) |
+		((uint32_t)hash[3] << 24);
+}
+
+/**
+ * Check if EC-RW is known to match from an earlier boot, without hashing it.
+ *
+ * Nvstorage holds the EC's sync nonce and the start of the expected hash as
+ * of the last time EC-RW matched.  The EC changes its nonce whenever it
+ * resets or RW is written, so if the nonce is the same and the AP firmware
+ * still expects the same image, EC-RW can't have changed.
+ *
+ * @param ctx		Vboot2 context
+ * @param nonce		Set to the EC's current nonce, or 0 if it has none
+ * @return 1 if EC-RW is known to match, 0 if it needs to be hashed.
+ */
+static int ec_rw_hash_cached(struct vb2_context *ctx, uint32_t *nonce)
+{
+	const uint8_t *hash = NULL;
+	int hash_size;
+
+	if (VbExEcGetSyncNonce(0, nonce))
+		*nonce = 0;
+	if (!*nonce || *nonce != vb2_nv_get(ctx, VB2_NV_EC_SYNC_NONCE))
+		return 0;
+
+	if (VbExEcGetExpectedImageHash(0, VB_SELECT_FIRMWARE_EC_ACTIVE,
+				       &hash, &hash_size) ||
+	    hash_size < sizeof(uint32_t) ||
+	    hash_prefix(hash) != vb2_nv_get(ctx, VB2_NV_EC_SYNC_HASH))
+		return 0;
+
+	VB2_DEBUG("EC-RW unchanged since nonce 0x%x\n", *nonce);
+	return 1;
+}
+
+/**
+ * Remember whether EC-RW matched, so the next boot can skip hashing it.
+ *
+ * @param ctx		Vboot2 context
+ * @param nonce		EC's current nonce, or 0 if it has none
+ */
+static void save_ec_rw_hash(struct vb2_context *ctx, uint32_t nonce)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	const uint8_t *hash = NULL;
+	int hash_size;
+
+	/* check_ec_hash() already got the expected hash, so this can't fail */
+	if (nonce && !(sd->flags & VB2_SD_FLAG_ECSYNC_EC_RW) &&
+	    !VbExEcGetExpectedImageHash(0, VB_SELECT_FIRMWARE_EC_ACTIVE,
+					&hash, &hash_size) &&
+	    hash_size >= sizeof(uint32_t)) {
+		vb2_nv_set(ctx, VB2_NV_EC_SYNC_NONCE, nonce);
+		vb2_nv_set(ctx, VB2_NV_EC_SYNC_HASH, hash_prefix(hash));
+	} else {
+		vb2_nv_set(ctx, VB2_NV_EC_SYNC_NONCE, 0);
+	}
+}
+
+/* Defaults for ECs which can only be updated all at once */
+__attribute__((weak))
+VbError_t VbExEcGetBlockHashes(int devidx, enum VbSelectFirmware_t select,
+			       uint32_t *block_size, const uint8_t **hashes,
+			       int *count)
+{
+	return VBERROR_EC_BLOCK_HASHES_UNSUPPORTED;
+}
+
+__attribute__((weak))
+VbError_t VbExEcUpdateImageBlocks(int devidx, enum VbSelectFirmware_t select,
+				  uint32_t offset, const uint8_t *data,
+				  uint32_t size)
+{
+	return VBERROR_UNKNOWN;
+}
+
+/**
+ * Rewrite only the blocks of an EC image which differ from the expected one
+ *
+ * @param devidx	Index of EC device to update
+ * @param select	Which firmware image to update
+ * @param want		Expected image
+ * @param want_size	Size of expected image in bytes
+ * @return VBERROR_SUCCESS, VBERROR_EC_BLOCK_HASHES_UNSUPPORTED if the whole
+ * image needs to be written instead, or other non-zero error code.
+ */
+static VbError_t update_ec_blocks(int devidx, enum VbSelectFirmware_t select,
+				  const uint8_t *want, int want_size)
+{
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	const uint8_t *hashes;
+	uint32_t block_size, offset, size, run_start = 0, run_size = 0;
+	int count, i, written = 0;
+	VbError_t rv;
+
+	rv = VbExEcGetBlockHashes(devidx, select, &block_size, &hashes,
+				  &count);
+	if (rv) {
+		VB2_DEBUG("VbExEcGetBlockHashes() returned %d\n", rv);
+		return VBERROR_EC_BLOCK_HASHES_UNSUPPORTED;
+	}
+
+	/* The blocks must cover exactly the expected image */
+	if (!block_size || count <= 0 || want_size <= 0 ||
+	    (uint64_t)(count - 1) * block_size >= want_size ||
+	    (uint64_t)count * block_size < want_size) {
+		VB2_DEBUG("%d blocks of %d bytes don't fit %d-byte image\n",
+			  count, block_size, want_size);
+		return VBERROR_EC_BLOCK_HASHES_UNSUPPORTED;
+	}
+
+	/* Write each run of differing blocks at once */
+	for (i = 0; i <= count; i++) {
+		offset = i * block_size;
+
+		if (i < count) {
+			size = want_size - offset;
+			if (size > block_size)
+				size = block_size;
+			if (vb2_digest_buffer(want + offset, size,
+					      VB2_HASH_SHA256, digest,
+					      sizeof(digest)))
+				return VBERROR_EC_BLOCK_HASHES_UNSUPPORTED;
+			if (vb2_safe_memcmp(digest, hashes + i * sizeof(digest),
+					    sizeof(digest))) {
+				if (!run_size)
+					run_start = offset;
+				run_size += size;
+				continue;
+			}
+		}
+
+		if (!run_size)
+			continue;
+
+		rv = VbExEcUpdateImageBlocks(devidx, select, run_start,
+					     want + run_start, run_size);
+		if (rv)
+			return rv;
+		written += run_size;
+		run_size = 0;
+	}
+
+	VB2_DEBUG("Rewrote %d of %d bytes\n", written, want_size);
+	return VBERROR_SUCCESS;
+}
+
 /**
  * Update the specified EC and verify the update succeeded
  *
@@ -163,9 +347,12 @@ static VbError_t update_ec(struct vb2_context *ctx, int devidx,
 	}
 	VB2_DEBUG("image len = %d\n", want_size);
 
-	rv = VbExEcUpdateImage(devidx, select, want, want_size);
+	/* Only send the blocks which changed, if the EC can tell us */
+	rv = update_ec_blocks(devidx, select, want, want_size);
+	if (rv == VBERROR_EC_BLOCK_HASHES_UNSUPPORTED)
+		rv = VbExEcUpdateImage(devidx, select, want, want_size);
 	if (rv != VBERROR_SUCCESS) {
-		VB2_DEBUG("VbExEcUpdateImage() returned %d\n", rv);
+		VB2_DEBUG("EC image update returned %d\n", rv);
 
 		/*
 		 * The EC may know it needs a reboot.  It may need to
@@ -359,22 +546,44 @@ VbError_t ec_sync_phase1(struct vb2_context *ctx)
 	if (do_pd_sync && check_ec_active(ctx, 1))
 		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
 
+	/* Skip hashing EC-RW if it hasn't changed since it last matched */
+	uint32_t nonce;
+	const int ec_rw_cached = ec_rw_hash_cached(ctx, &nonce);
+
+	/*
+	 * Start hashing RW on every device before waiting for any of them,
+	 * so sync time doesn't grow with the number of devices.
+	 */
+	if (!ec_rw_cached)
+		start_ec_hash(0, VB_SELECT_FIRMWARE_EC_ACTIVE);
+	if (do_pd_sync)
+		start_ec_hash(1, VB_SELECT_FIRMWARE_EC_ACTIVE);
+
 	/* Check if we need to update RW.  Failures trigger recovery mode. */
-	if (check_ec_hash(ctx, 0, VB_SELECT_FIRMWARE_EC_ACTIVE))
-		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
-	if (do_pd_sync && check_ec_hash(ctx, 1, VB_SELECT_FIRMWARE_EC_ACTIVE))
-		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
+	if (!ec_rw_cached) {
+		if (check_ec_hash(ctx, 0, VB_SELECT_FIRMWARE_EC_ACTIVE)) {
+			vb2_nv_set(ctx, VB2_NV_EC_SYNC_NONCE, 0);
+			return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
+		}
+		save_ec_rw_hash(ctx, nonce);
+	}
+
 	/*
-	 * See if we need to update EC-RO (devidx=0).
+	 * See if we need to update EC-RO (devidx=0).  The EC can start on
+	 * that while the PD is still busy with RW.
 	 *
 	 * If we want to extend this in the future to update PD-RO, we'll use a
 	 * different NV flag so we can track EC-RO and PD-RO updates
 	 * separately.
 	 */
-	if (vb2_nv_get(ctx, VB2_NV_TRY_RO_SYNC) &&
-	    check_ec_hash(ctx, 0, VB_SELECT_FIRMWARE_READONLY)) {
+	const int try_ro_sync = vb2_nv_get(ctx, VB2_NV_TRY_RO_SYNC);
+	if (try_ro_sync)
+		start_ec_hash(0, VB_SELECT_FIRMWARE_READONLY);
+
+	if (do_pd_sync && check_ec_hash(ctx, 1, VB_SELECT_FIRMWARE_EC_ACTIVE))
+		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
+	if (try_ro_sync && check_ec_hash(ctx, 0, VB_SELECT_FIRMWARE_READONLY))
 		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
-	}
 
 	/*
 	 * If we're in RW, we need to reboot back to RO because RW can't be
@@ -5,6 +5,7 @@
 
 #include "2sysincludes.h"
 #include "2common.h"
+#include "2trace.h"
 
 #include "sysincludes.h"
 #include "cgptlib.h"
@@ -21,6 +22,11 @@
  * The sector_bytes and gpt_drive_sectors fields should be filled on input.  The
  * primary and secondary header and entries are filled on output.
  *
+ * The secondary GPT is at the far end of the drive, so if the primary is
+ * valid it isn't read; the secondary is filled in as a copy of the primary
+ * instead.  That is what it should contain anyway, and if the GPT is modified,
+ * GptModified() rewrites the secondary from the primary regardless.
+ *
  * Returns 0 if successful, 1 if error.
  */
 int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
@@ -32,6 +38,8 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	gptdata->modified = 0;
 	/* This should get overwritten by GptInit() */
 	gptdata->ignored = 0;
+	gptdata->secondary_copied = 0;
+	gptdata->dirty_entry_sectors = 0;
 
 	/* Allocate all buffers */
 	gptdata->primary_header = (uint8_t *)malloc(gptdata->sector_bytes);
@@ -47,6 +55,7 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 		return 1;
 
 	/* Read primary header from the drive, skipping the protective MBR */
+	VbDiskReadRecord(1, 1, VB2_DISK_READ_GPT_PRIMARY);
 	if (0 != VbExDiskRead(disk_handle, 1, 1, gptdata->primary_header)) {
 		VB2_DEBUG("Read error in primary GPT header\n");
 		memset(gptdata->primary_header, 0, gptdata->sector_bytes);
@@ -65,6 +74,8 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 				* primary_header->size_of_entry;
 		uint64_t entries_sectors = entries_bytes
 					/ gptdata->sector_bytes;
+		VbDiskReadRecord(primary_header->entries_lba, entries_sectors,
+				 VB2_DISK_READ_GPT_PRIMARY);
 		if (0 != VbExDiskRead(disk_handle,
 				      primary_header->entries_lba,
 				      entries_sectors,
@@ -80,7 +91,22 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			  ? "invalid" : "being ignored");
 	}
 
+	/* Skip reading the secondary GPT if the primary is all we need */
+	if (primary_valid &&
+	    0 == CheckEntries((GptEntry *)gptdata->primary_entries,
+			      primary_header)) {
+		VB2_DEBUG("Primary GPT is valid; not reading secondary\n");
+		gptdata->valid_headers = MASK_PRIMARY;
+		gptdata->valid_entries = MASK_PRIMARY;
+		GptRepair(gptdata);
+		gptdata->modified = 0;
+		gptdata->secondary_copied = 1;
+		return 0;
+	}
+
 	/* Read secondary header from the end of the drive */
+	VbDiskReadRecord(gptdata->gpt_drive_sectors - 1, 1,
+			 VB2_DISK_READ_GPT_SECONDARY);
 	if (0 != VbExDiskRead(disk_handle, gptdata->gpt_drive_sectors - 1, 1,
 			      gptdata->secondary_header)) {
 		VB2_DEBUG("Read error in secondary GPT header\n");
@@ -100,6 +126,8 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 				* secondary_header->size_of_entry;
 		uint64_t entries_sectors = entries_bytes
 				/ gptdata->sector_bytes;
+		VbDiskReadRecord(secondary_header->entries_lba,
+				 entries_sectors, VB2_DISK_READ_GPT_SECONDARY);
 		if (0 != VbExDiskRead(disk_handle,
 				      secondary_header->entries_lba,
 				      entries_sectors,
@@ -119,9 +147,41 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	return (primary_valid || secondary_valid) ? 0 : 1;
 }
 
+/*
+ * Write a GPT entry array starting at lba.  If dirty is non-zero, only the
+ * sectors it marks are written, with one write per contiguous run of them.
+ *
+ * Returns 0 if successful, non-zero if error.
+ */
+static int WriteGptEntries(VbExDiskHandle_t disk_handle, uint64_t lba,
+			   uint64_t sectors, uint32_t sector_bytes,
+			   uint8_t *entries, uint32_t dirty)
+{
+	uint64_t start, end;
+
+	if (!dirty)
+		return VbExDiskWrite(disk_handle, lba, sectors, entries);
+
+	for (start = 0; start < sectors && start < 32; start = end) {
+		end = start + 1;
+		if (!(dirty & (1U << start)))
+			continue;
+		while (end < sectors && end < 32 && (dirty & (1U << end)))
+			end++;
+		if (0 != VbExDiskWrite(disk_handle, lba + start, end - start,
+				       entries + start * sector_bytes))
+			return 1;
+	}
+
+	return 0;
+}
+
 /**
  * Write any changes for the GPT data back to the drive, then free the buffers.
  *
+ * If only the kernel entries updated by GptUpdateKernelWithEntry() have
+ * changed, only the entry sectors holding them are written.
+ *
  * Returns 0 if successful, 1 if error.
  */
 int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
@@ -172,13 +232,39 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (gptdata->primary_entries && !skip_primary) {
 		if (gptdata->modified & GPT_MODIFIED_ENTRIES1) {
 			VB2_DEBUG("Updating GPT entries 1\n");
-			if (0 != VbExDiskWrite(disk_handle, entries_lba,
-					       entries_sectors,
-					       gptdata->primary_entries))
+			if (0 != WriteGptEntries(disk_handle, entries_lba,
+						 entries_sectors,
+						 gptdata->sector_bytes,
+						 gptdata->primary_entries,
+						 gptdata->dirty_entry_sectors))
 				goto fail;
 		}
 	}
 
+	/*
+	 * If the secondary GPT was never read, check that it isn't marked to
+	 * be ignored before writing over it.
+	 */
+	if (gptdata->secondary_copied && gptdata->secondary_header &&
+	    (gptdata->modified &
+	     (GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2))) {
+		GptHeader *h = (GptHeader *)malloc(gptdata->sector_bytes);
+
+		if (!h || 0 != VbExDiskRead(disk_handle,
+					    gptdata->gpt_drive_sectors - 1, 1,
+					    h)) {
+			VB2_DEBUG("Read error in secondary GPT header\n");
+			gptdata->ignored |= MASK_SECONDARY;
+		} else if (!memcmp(h->signature, GPT_HEADER_SIGNATURE_IGNORED,
+				   GPT_HEADER_SIGNATURE_SIZE)) {
+			VB2_DEBUG("Not updating secondary GPT: "
+				  "marked to be ignored.\n");
+			gptdata->ignored |= MASK_SECONDARY;
+		}
+		if (h)
+			free(h);
+	}
+
 	entries_lba = (gptdata->gpt_drive_sectors - entries_sectors -
 		GPT_HEADER_SECTORS);
 	if (gptdata->secondary_header && !(gptdata->ignored & MASK_SECONDARY)) {
@@ -195,10 +281,17 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 
 	if (gptdata->secondary_entries && !(gptdata->ignored & MASK_SECONDARY)){
 		if (gptdata->modified & GPT_MODIFIED_ENTRIES2) {
+			/*
+			 * A secondary copied from the primary may not match
+			 * what is on the drive, so write all of it.
+			 */
 			VB2_DEBUG("Updating GPT entries 2\n");
-			if (0 != VbExDiskWrite(disk_handle,
-					       entries_lba, entries_sectors,
-					       gptdata->secondary_entries))
+			if (0 != WriteGptEntries(disk_handle, entries_lba,
+						 entries_sectors,
+						 gptdata->sector_bytes,
+						 gptdata->secondary_entries,
+						 gptdata->secondary_copied ? 0 :
+						 gptdata->dirty_entry_sectors))
 				goto fail;
 		}
 	}
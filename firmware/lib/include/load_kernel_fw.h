@@ -18,9 +18,32 @@ struct vb2_context;
 /* Boot flags for LoadKernel().boot_flags */
 /* GPT is external */
 #define BOOT_FLAG_EXTERNAL_GPT (0x04ULL)
+/*
+ * Read the vblock into the start of kernel_buffer, so the body can be used in
+ * place instead of copied.  kernel_buffer then points past the vblock on
+ * return.
+ */
+#define BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER (0x08ULL)
 
 struct RollbackSpaceFwmp;
 
+/*
+ * Default LoadKernelParams.body_chunk_size.  Reading the kernel body in chunks
+ * and hashing each chunk as soon as it arrives saves a second pass over the
+ * whole body.  Should be a multiple of the sector size.
+ */
+#ifndef VB2_KERNEL_BODY_CHUNK_SIZE
+#define VB2_KERNEL_BODY_CHUNK_SIZE (256 * 1024)
+#endif
+
+/*
+ * Default LoadKernelParams.vblock_read_size.  Signers pad kernel vblocks to
+ * 64 KB, so this normally covers the vblock and the start of the body.
+ */
+#ifndef VB2_KERNEL_VBLOCK_READ_SIZE
+#define VB2_KERNEL_VBLOCK_READ_SIZE (64 * 1024)
+#endif
+
 typedef struct LoadKernelParams {
 	/* Inputs to LoadKernel() */
 	/* Disk handle for current device */
@@ -31,14 +54,30 @@ typedef struct LoadKernelParams {
 	uint64_t streaming_lba_count;
 	/* Random-access GPT size */
 	uint64_t gpt_lba_count;
-	/* Destination buffer for kernel (normally at 0x100000) */
+	/*
+	 * Destination buffer for kernel (normally at 0x100000).  On return,
+	 * points to the kernel body, which is only somewhere else if
+	 * BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER is set or this was NULL.
+	 */
 	void *kernel_buffer;
-	/* Size of kernel buffer in bytes */
+	/* Size of kernel buffer in bytes; on return, the size from the body */
 	uint64_t kernel_buffer_size;
 	/* Boot flags */
 	uint64_t boot_flags;
 	/* Firmware management parameters; may be NULL if not present. */
 	const struct RollbackSpaceFwmp *fwmp;
+	/*
+	 * Bytes of kernel body to read and hash at a time, rounded down to a
+	 * multiple of bytes_per_lba.  If 0, the whole body is read before
+	 * being hashed.
+	 */
+	uint32_t body_chunk_size;
+	/*
+	 * Bytes to read at the start of each kernel partition, which must
+	 * hold the whole vblock, rounded down to a multiple of bytes_per_lba.
+	 * If 0, VB2_KERNEL_VBLOCK_READ_SIZE is used.
+	 */
+	uint32_t vblock_read_size;
 
 	/*
 	 * Outputs from LoadKernel(); valid only if LoadKernel() returns
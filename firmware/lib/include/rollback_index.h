@@ -117,6 +117,14 @@ enum fwmp_flags {
  * global variables.
  */
 
+/**
+ * Read the kernel space and, if [read_fwmp] is non-zero, the FWMP space with
+ * one TlclReadMultiple() call.  The next RollbackKernelRead() and
+ * RollbackFwmpRead() use what was read instead of reading the spaces again,
+ * and report any errors from it.
+ */
+void RollbackReadAhead(int read_fwmp);
+
 /**
  * Read stored kernel version.
  */
@@ -20,5 +20,10 @@ void vb2_audio_start(struct vb2_context *ctx);
  */
 int vb2_audio_looping(void);
 
+/**
+ * End any beep still playing in the background.
+ */
+void vb2_audio_stop(void);
+
 #endif /* VBOOT_REFERENCE_VBOOT_AUDIO_H_ */
 
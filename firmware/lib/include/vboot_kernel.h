@@ -87,9 +87,15 @@ uint32_t vb2_get_fwmp_flags(void);
 /**
  * Commit NvStorage.
  *
- * This may be called by UI functions which need to save settings before they
- * sit in an infinite loop waiting for shutdown (this is, by a UI state which
- * will never return).
+ * Changes to ctx->nvdata[] are held in memory and written back once, when
+ * VbSelectAndLoadKernel() or VbVerifyMemoryBootImage() returns.  This may
+ * also be called by UI functions which need to save settings before they sit
+ * in an infinite loop waiting for shutdown (this is, by a UI state which will
+ * never return), or before handing control to something which may not return
+ * or may cut power.
+ *
+ * Nothing is written if the data matches what was last read from or written
+ * to storage.
  */
 void vb2_nv_commit(struct vb2_context *ctx);
 
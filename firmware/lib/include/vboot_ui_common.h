@@ -8,6 +8,9 @@
 #ifndef VBOOT_REFERENCE_VBOOT_UI_COMMON_H_
 #define VBOOT_REFERENCE_VBOOT_UI_COMMON_H_
 
+/* Events which end a wait between polls of the keyboard, for the UI loops */
+#define VB_UI_EVENTS (VB_EVENT_KEY | VB_EVENT_SHUTDOWN)
+
 enum vb2_beep_type {
 	VB_BEEP_FAILED,		/* Permitted but the operation failed */
 	VB_BEEP_NOT_ALLOWED,	/* Operation disabled by user setting */
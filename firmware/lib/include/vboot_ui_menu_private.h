@@ -20,7 +20,8 @@ struct vb2_menu {
 	const char *name;
 	uint16_t size;
 	uint16_t screen;
-	struct vb2_menu_item *items;
+	uint32_t disabled_mask;	/* Items which are always disabled */
+	const struct vb2_menu_item *items;
 };
 
 typedef enum _VB_MENU {
@@ -24,6 +24,10 @@ uint32_t TPMClearAndReenable(void)
 	return TPM_SUCCESS;
 }
 
+void RollbackReadAhead(int read_fwmp)
+{
+}
+
 uint32_t RollbackKernelRead(uint32_t *version)
 {
 	*version = 0;
@@ -50,6 +50,36 @@ uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk);
 	} while (0)
 
 
+/*
+ * Spaces read by RollbackReadAhead(), for the next ReadSpace() of each to
+ * use instead of reading it again.
+ */
+static struct {
+	uint32_t index;
+	uint32_t result;
+	int valid;
+	union {
+		RollbackSpaceKernel rsk;
+		struct RollbackSpaceFwmp fwmp;
+	} data;
+} read_ahead[2];
+
+/* Reads a space, or takes it from RollbackReadAhead() if it was read there. */
+static uint32_t ReadSpace(uint32_t index, void *data, uint32_t length)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(read_ahead); i++) {
+		if (read_ahead[i].valid && read_ahead[i].index == index &&
+		    length <= sizeof(read_ahead[i].data)) {
+			read_ahead[i].valid = 0;
+			memcpy(data, &read_ahead[i].data, length);
+			return read_ahead[i].result;
+		}
+	}
+	return TlclRead(index, data, length);
+}
+
 uint32_t TPMClearAndReenable(void)
 {
 	VB2_DEBUG("TPM: Clear and re-enable\n");
@@ -62,7 +92,16 @@ uint32_t TPMClearAndReenable(void)
 
 uint32_t SafeWrite(uint32_t index, const void *data, uint32_t length)
 {
-	uint32_t result = TlclWrite(index, data, length);
+	uint32_t result;
+	int i;
+
+	/* What was read ahead is out of date once the space is written. */
+	for (i = 0; i < ARRAY_SIZE(read_ahead); i++) {
+		if (read_ahead[i].index == index)
+			read_ahead[i].valid = 0;
+	}
+
+	result = TlclWrite(index, data, length);
 	if (result == TPM_E_MAXNVWRITES) {
 		RETURN_ON_FAILURE(TPMClearAndReenable());
 		return TlclWrite(index, data, length);
@@ -175,7 +214,8 @@ uint32_t ReadSpaceKernel(RollbackSpaceKernel *rsk)
 	int attempts = 3;
 
 	while (attempts--) {
-		r = TlclRead(KERNEL_NV_INDEX, rsk, sizeof(RollbackSpaceKernel));
+		r = ReadSpace(KERNEL_NV_INDEX, rsk,
+			      sizeof(RollbackSpaceKernel));
 		if (r != TPM_SUCCESS)
 			return r;
 
@@ -242,6 +282,10 @@ uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk)
 #ifdef DISABLE_ROLLBACK_TPM
 /* Dummy implementations which don't support TPM rollback protection */
 
+void RollbackReadAhead(int read_fwmp)
+{
+}
+
 uint32_t RollbackKernelRead(uint32_t* version)
 {
 	*version = 0;
@@ -266,10 +310,44 @@ uint32_t RollbackFwmpRead(struct RollbackSpaceFwmp *fwmp)
 
 #else
 
+/*
+ * Kernel space as last read from or written to the TPM this boot, so that
+ * RollbackKernelWrite() doesn't need to read it again first.
+ */
+static RollbackSpaceKernel rsk_cache;
+static int rsk_cached = 0;
+
+void RollbackReadAhead(int read_fwmp)
+{
+	struct tlcl_nv_read reads[ARRAY_SIZE(read_ahead)] = {
+		{
+			.index = KERNEL_NV_INDEX,
+			.data = &read_ahead[0].data,
+			.length = sizeof(RollbackSpaceKernel),
+		},
+		{
+			.index = FWMP_NV_INDEX,
+			.data = &read_ahead[1].data,
+			.length = sizeof(struct RollbackSpaceFwmp),
+		},
+	};
+	int count = read_fwmp ? 2 : 1;
+	int i;
+
+	TlclReadMultiple(reads, count);
+	for (i = 0; i < count; i++) {
+		read_ahead[i].index = reads[i].index;
+		read_ahead[i].result = reads[i].result;
+		read_ahead[i].valid = 1;
+	}
+}
+
 uint32_t RollbackKernelRead(uint32_t* version)
 {
 	RollbackSpaceKernel rsk;
 
+	rsk_cached = 0;
+
 	/*
 	 * Read the kernel space and verify its permissions.  If the kernel
 	 * space has the wrong permission, or it doesn't contain the right
@@ -296,6 +374,8 @@ uint32_t RollbackKernelRead(uint32_t* version)
 #endif
 	memcpy(version, &rsk.kernel_versions, sizeof(*version));
 	VB2_DEBUG("TPM: RollbackKernelRead %x\n", (int)*version);
+	memcpy(&rsk_cache, &rsk, sizeof(rsk));
+	rsk_cached = 1;
 	return TPM_SUCCESS;
 }
 
@@ -303,12 +383,25 @@ uint32_t RollbackKernelWrite(uint32_t version)
 {
 	RollbackSpaceKernel rsk;
 	uint32_t old_version;
-	RETURN_ON_FAILURE(ReadSpaceKernel(&rsk));
+	uint32_t r;
+
+	if (rsk_cached)
+		memcpy(&rsk, &rsk_cache, sizeof(rsk));
+	else
+		RETURN_ON_FAILURE(ReadSpaceKernel(&rsk));
 	memcpy(&old_version, &rsk.kernel_versions, sizeof(old_version));
 	VB2_DEBUG("TPM: RollbackKernelWrite %x --> %x\n",
 		  (int)old_version, (int)version);
 	memcpy(&rsk.kernel_versions, &version, sizeof(version));
-	return WriteSpaceKernel(&rsk);
+
+	/* If the write fails, we no longer know what's in the TPM */
+	rsk_cached = 0;
+	r = WriteSpaceKernel(&rsk);
+	if (r == TPM_SUCCESS) {
+		memcpy(&rsk_cache, &rsk, sizeof(rsk));
+		rsk_cached = 1;
+	}
+	return r;
 }
 
 uint32_t RollbackKernelLock(int recovery_mode)
@@ -344,7 +437,7 @@ uint32_t RollbackFwmpRead(struct RollbackSpaceFwmp *fwmp)
 
 	while (attempts--) {
 		/* Try to read entire 1.0 struct */
-		r = TlclRead(FWMP_NV_INDEX, u.buf, sizeof(u.bf));
+		r = ReadSpace(FWMP_NV_INDEX, u.buf, sizeof(u.bf));
 		if (r == TPM_E_BADINDEX) {
 			/* Missing space is not an error; use defaults */
 			VB2_DEBUG("TPM: no FWMP space\n");
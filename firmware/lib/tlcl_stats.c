@@ -0,0 +1,65 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Per-command TPM statistics, shared by the TPM1.2 and TPM2.0 libraries.
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+
+#include "tlcl.h"
+
+static struct vb2_tpm_stat stats[VB2_TPM_STAT_ENTRIES];
+static uint32_t stats_count;
+
+void TlclStatsRecord(uint32_t command_code, uint32_t result, uint64_t time)
+{
+	struct vb2_tpm_stat *s;
+	uint32_t i;
+
+	for (i = 0; i < stats_count; i++) {
+		if (stats[i].command_code == command_code)
+			break;
+	}
+
+	if (i == stats_count) {
+		if (stats_count == VB2_TPM_STAT_ENTRIES)
+			return;
+		stats_count++;
+		stats[i].command_code = command_code;
+	}
+
+	s = stats + i;
+	if (s->count < UINT16_MAX)
+		s->count++;
+	if (result != TPM_SUCCESS && s->errors < UINT16_MAX)
+		s->errors++;
+	s->total_time += time;
+	if (time > s->max_time)
+		s->max_time = time;
+}
+
+const struct vb2_tpm_stat *TlclGetStats(uint32_t *count)
+{
+	*count = stats_count;
+	return stats;
+}
+
+void TlclStatsReset(void)
+{
+	memset(stats, 0, sizeof(stats));
+	stats_count = 0;
+}
+
+void TlclStatsDump(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < stats_count; i++)
+		VB2_DEBUG("TPM: command 0x%x: %u sent, %u failed, "
+			  "total %" PRIu64 ", max %" PRIu64 "\n",
+			  stats[i].command_code, stats[i].count,
+			  stats[i].errors, stats[i].total_time,
+			  stats[i].max_time);
+}
@@ -850,6 +850,59 @@ int tpm_unmarshal_response(TPM_CC command,
 	return 0;
 }
 
+int tpm_unmarshal_nv_read(void *head, void *data, int response_size,
+			  struct tpm2_response *response)
+{
+	struct nv_read_response *nvr = &response->nvr;
+	int size, rest;
+
+	if (response_size < sizeof(struct tpm_header))
+		return -1;
+
+	size = response_size < TPM2_NV_READ_HEAD_SIZE ?
+		response_size : TPM2_NV_READ_HEAD_SIZE;
+	rest = response_size - size;
+
+	response->hdr.tpm_tag = unmarshal_u16(&head, &size);
+	response->hdr.tpm_size = unmarshal_u32(&head, &size);
+	response->hdr.tpm_code = unmarshal_u32(&head, &size);
+
+	if (!size && !rest) {
+		if (response->hdr.tpm_size != sizeof(response->hdr))
+			VB2_DEBUG("size mismatch in response to NV_Read\n");
+		return 0;
+	}
+
+	nvr->params_size = unmarshal_u32(&head, &size);
+	nvr->buffer.t.size = unmarshal_u16(&head, &size);
+	if (size) {
+		VB2_DEBUG("NV_Read response too short (%d)\n", response_size);
+		return -1;
+	}
+
+	if (nvr->buffer.t.size > rest) {
+		VB2_DEBUG("size mismatch: expected %d, remaining %d\n",
+			  nvr->buffer.t.size, rest);
+		return -1;
+	}
+	nvr->buffer.t.buffer = data;
+	rest -= nvr->buffer.t.size;
+
+	if (nvr->params_size !=
+	    (nvr->buffer.t.size + sizeof(nvr->buffer.t.size))) {
+		VB2_DEBUG("parameter/buffer %d/%d size mismatch",
+			  nvr->params_size, nvr->buffer.t.size);
+		return -1;
+	}
+
+	/* The authorization section is ignored, as in unmarshal_nv_read() */
+	if (rest != 5)
+		VB2_DEBUG("unexpected authorisation section size %d for %s\n",
+			  rest, "NV_Read");
+
+	return 0;
+}
+
 uint32_t tpm_get_packet_size(const uint8_t *packet)
 {
 	/* 0: tag (16 bit)
@@ -40,6 +40,7 @@ static uint32_t tpm_get_response(TPM_CC command,
 	static uint8_t cr_buffer[TPM_BUFFER_SIZE];
 	int out_size, res;
 	uint32_t in_size;
+	uint64_t start;
 
 	out_size = tpm_marshal_command(command, command_body,
 				       cr_buffer, sizeof(cr_buffer));
@@ -49,24 +50,191 @@ static uint32_t tpm_get_response(TPM_CC command,
 	}
 
 	in_size = sizeof(cr_buffer);
+	start = VbExGetTimer();
 	res = VbExTpmSendReceive(cr_buffer, out_size, cr_buffer, &in_size);
 	if (res != TPM_SUCCESS) {
 		VB2_DEBUG("tpm transaction failed for %#x with error %#x\n",
 			  command, res);
+		TlclStatsRecord(command, res, VbExGetTimer() - start);
 		return res;
 	}
 
 	if (tpm_unmarshal_response(command, cr_buffer, in_size, response) < 0) {
 		VB2_DEBUG("command %#x, failed to parse response\n", command);
+		TlclStatsRecord(command, TPM_E_READ_FAILURE,
+				VbExGetTimer() - start);
 		return TPM_E_READ_FAILURE;
 	}
 
+	TlclStatsRecord(command, response->hdr.tpm_code,
+			VbExGetTimer() - start);
+
 	VB2_DEBUG("command %#x, return code %#x\n", command,
 		  response->hdr.tpm_code);
 
 	return TPM_SUCCESS;
 }
 
+/* Most commands tpm_get_responses() will marshal ahead of sending */
+#define TPM2_MAX_QUEUED_COMMANDS 4
+
+/* A command for tpm_get_responses() */
+struct tpm2_queued_command {
+	TPM_CC command;
+	void *command_body;
+	struct tpm2_response *response;
+
+	/* Set to what tpm_get_response() would have returned */
+	uint32_t rv;
+};
+
+/*
+ * Default for platforms which can't overlap TPM transactions: just send the
+ * requests one at a time.
+ */
+__attribute__((weak))
+VbError_t VbExTpmSendReceiveMultiple(const uint8_t * const *requests,
+				     const uint32_t *request_lengths,
+				     uint8_t * const *responses,
+				     uint32_t *response_lengths,
+				     int count)
+{
+	VbError_t rv;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		rv = VbExTpmSendReceive(requests[i], request_lengths[i],
+					responses[i], &response_lengths[i]);
+		if (rv != TPM_SUCCESS)
+			return rv;
+	}
+
+	return TPM_SUCCESS;
+}
+
+/*
+ * Default for platforms which can't scatter a response: receive it into one
+ * buffer and copy the pieces out.
+ */
+__attribute__((weak))
+VbError_t VbExTpmSendReceiveScatter(const uint8_t *request,
+				    uint32_t request_length,
+				    uint8_t * const *responses,
+				    const uint32_t *response_sizes,
+				    int count,
+				    uint32_t *response_length)
+{
+	static uint8_t buffer[TPM_BUFFER_SIZE];
+	uint32_t size = 0, offset, n;
+	VbError_t rv;
+	int i;
+
+	for (i = 0; i < count; i++)
+		size += response_sizes[i];
+	if (size > sizeof(buffer))
+		size = sizeof(buffer);
+
+	rv = VbExTpmSendReceive(request, request_length, buffer, &size);
+	if (rv != TPM_SUCCESS)
+		return rv;
+
+	for (i = 0, offset = 0; i < count && offset < size; i++) {
+		n = size - offset;
+		if (n > response_sizes[i])
+			n = response_sizes[i];
+		memcpy(responses[i], buffer + offset, n);
+		offset += n;
+	}
+	*response_length = size;
+
+	return TPM_SUCCESS;
+}
+
+/*
+ * Same as tpm_get_response() for up to TPM2_MAX_QUEUED_COMMANDS commands.
+ * All of them are marshaled into their own buffers before the first is sent,
+ * so the transport can move straight from one to the next.  The commands must
+ * not depend on each other's results.
+ *
+ * Returns the error code if the transport failed, in which case none of the
+ * responses should be used.  Otherwise returns success, and the result for
+ * each command is in its rv field.
+ */
+static uint32_t tpm_get_responses(struct tpm2_queued_command *queue,
+				  int count)
+{
+	/* Command/response buffers, so nothing is marshaled while sending */
+	static uint8_t cr_buffers[TPM2_MAX_QUEUED_COMMANDS][TPM_BUFFER_SIZE];
+	const uint8_t *requests[TPM2_MAX_QUEUED_COMMANDS];
+	uint8_t *responses[TPM2_MAX_QUEUED_COMMANDS];
+	uint32_t out_sizes[TPM2_MAX_QUEUED_COMMANDS];
+	uint32_t in_sizes[TPM2_MAX_QUEUED_COMMANDS];
+	int sent[TPM2_MAX_QUEUED_COMMANDS];
+	int i, n = 0, out_size;
+	uint32_t res;
+	uint64_t start, time;
+
+	if (count > TPM2_MAX_QUEUED_COMMANDS)
+		return TPM_E_WRITE_FAILURE;
+
+	for (i = 0; i < count; i++) {
+		out_size = tpm_marshal_command(queue[i].command,
+					       queue[i].command_body,
+					       cr_buffers[n],
+					       sizeof(cr_buffers[n]));
+		if (out_size < 0) {
+			VB2_DEBUG("command %#x, failed to serialize\n",
+				  queue[i].command);
+			queue[i].rv = TPM_E_WRITE_FAILURE;
+			continue;
+		}
+
+		requests[n] = cr_buffers[n];
+		responses[n] = cr_buffers[n];
+		out_sizes[n] = out_size;
+		in_sizes[n] = sizeof(cr_buffers[n]);
+		sent[n++] = i;
+	}
+
+	if (!n)
+		return TPM_SUCCESS;
+
+	start = VbExGetTimer();
+	res = VbExTpmSendReceiveMultiple(requests, out_sizes, responses,
+					 in_sizes, n);
+
+	/* Only the whole batch is timed, so split it evenly */
+	time = (VbExGetTimer() - start) / n;
+
+	if (res != TPM_SUCCESS) {
+		VB2_DEBUG("tpm transactions failed with error %#x\n", res);
+		for (i = 0; i < n; i++)
+			TlclStatsRecord(queue[sent[i]].command, res, time);
+		return res;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct tpm2_queued_command *q = queue + sent[i];
+
+		if (tpm_unmarshal_response(q->command, cr_buffers[i],
+					   in_sizes[i], q->response) < 0) {
+			VB2_DEBUG("command %#x, failed to parse response\n",
+				  q->command);
+			q->rv = TPM_E_READ_FAILURE;
+			TlclStatsRecord(q->command, q->rv, time);
+			continue;
+		}
+
+		TlclStatsRecord(q->command, q->response->hdr.tpm_code, time);
+
+		VB2_DEBUG("command %#x, return code %#x\n", q->command,
+			  q->response->hdr.tpm_code);
+		q->rv = TPM_SUCCESS;
+	}
+
+	return TPM_SUCCESS;
+}
+
 /*
  * Same as tpm_get_response() but, if the response was successfully received,
  * returns the received response code. The set of errors returned by the
@@ -131,12 +299,19 @@ uint32_t TlclSendReceive(const uint8_t *request, uint8_t *response,
 			 int max_length)
 {
 	uint32_t rv, resp_size;
+	uint64_t start;
 
 	resp_size = max_length;
+	start = VbExGetTimer();
 	rv = VbExTpmSendReceive(request, tpm_get_packet_size(request),
 				response, &resp_size);
+	rv = rv ? rv : tpm_get_packet_response_code(response);
 
-	return rv ? rv : tpm_get_packet_response_code(response);
+	/* The command code is in the same place as a response code */
+	TlclStatsRecord(tpm_get_packet_response_code(request), rv,
+			VbExGetTimer() - start);
+
+	return rv;
 }
 
 int TlclPacketSize(const uint8_t *packet)
@@ -494,19 +669,19 @@ uint32_t TlclLockPhysicalPresence(void)
 	return tlcl_disable_platform_hierarchy();
 }
 
-uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
-{
-	struct tpm2_nv_read_cmd nv_readc;
-	struct tpm2_response *response = &tpm2_resp;
-	uint32_t rv;
-
-	memset(&nv_readc, 0, sizeof(nv_readc));
-
-	nv_readc.nvIndex = HR_NV_INDEX + index;
-	nv_readc.size = length;
-
-	rv = tpm_send_receive(TPM2_NV_Read, &nv_readc, response);
+/*
+ * Most data one NV_Read response can return into TPM_BUFFER_SIZE: the
+ * header, parameterSize, the size of the data, then the session response
+ * (empty nonce, attributes and empty hmac) follow the data.
+ */
+#define TPM2_MAX_NV_READ_CHUNK (TPM_BUFFER_SIZE - TPM2_NV_READ_HEAD_SIZE - \
+				(sizeof(uint16_t) + 1 + sizeof(uint16_t)))
 
+/* Turns an NV_Read response into a TlclRead() result. */
+static uint32_t tlcl_nv_read_result(uint32_t rv,
+				    struct tpm2_response *response,
+				    void *data, uint32_t length)
+{
 	/* Need to map tpm error codes into internal values. */
 	switch (rv) {
 	case TPM_SUCCESS:
@@ -525,8 +700,150 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	if (length < response->nvr.buffer.t.size)
 		return TPM_E_READ_EMPTY;
 
-	memcpy(data, response->nvr.buffer.t.buffer, length);
+	/* Data from tpm_nv_read_into() is already where it belongs */
+	if (data != response->nvr.buffer.t.buffer)
+		memcpy(data, response->nvr.buffer.t.buffer, length);
+
+	return TPM_SUCCESS;
+}
+
+/*
+ * Same as tpm_send_receive() for an NV_Read of at most
+ * TPM2_MAX_NV_READ_CHUNK bytes, but receives the data straight into data,
+ * which must have room for all of it, instead of into a response buffer.
+ * If the read fails, data may have been overwritten anyway.
+ */
+static uint32_t tpm_nv_read_into(struct tpm2_nv_read_cmd *nv_readc,
+				 void *data,
+				 struct tpm2_response *response)
+{
+	/* Command buffer, and the response around the data */
+	static uint8_t cr_buffer[TPM_BUFFER_SIZE];
+	uint8_t *responses[3];
+	uint32_t sizes[3];
+	uint32_t in_size = 0;
+	int out_size, res;
+	uint64_t start;
+
+	out_size = tpm_marshal_command(TPM2_NV_Read, nv_readc,
+				       cr_buffer, sizeof(cr_buffer));
+	if (out_size < 0) {
+		VB2_DEBUG("command %#x, failed to serialize\n", TPM2_NV_Read);
+		return TPM_E_WRITE_FAILURE;
+	}
+
+	responses[0] = cr_buffer;
+	sizes[0] = TPM2_NV_READ_HEAD_SIZE;
+	responses[1] = data;
+	sizes[1] = nv_readc->size;
+	responses[2] = cr_buffer + TPM2_NV_READ_HEAD_SIZE;
+	sizes[2] = sizeof(cr_buffer) - TPM2_NV_READ_HEAD_SIZE - nv_readc->size;
+
+	start = VbExGetTimer();
+	res = VbExTpmSendReceiveScatter(cr_buffer, out_size, responses, sizes,
+					ARRAY_SIZE(responses), &in_size);
+	if (res != TPM_SUCCESS) {
+		VB2_DEBUG("tpm transaction failed for %#x with error %#x\n",
+			  TPM2_NV_Read, res);
+		TlclStatsRecord(TPM2_NV_Read, res, VbExGetTimer() - start);
+		return res;
+	}
 
+	if (tpm_unmarshal_nv_read(cr_buffer, data, in_size, response) < 0) {
+		VB2_DEBUG("command %#x, failed to parse response\n",
+			  TPM2_NV_Read);
+		TlclStatsRecord(TPM2_NV_Read, TPM_E_READ_FAILURE,
+				VbExGetTimer() - start);
+		return TPM_E_READ_FAILURE;
+	}
+
+	TlclStatsRecord(TPM2_NV_Read, response->hdr.tpm_code,
+			VbExGetTimer() - start);
+
+	VB2_DEBUG("command %#x, return code %#x\n", TPM2_NV_Read,
+		  response->hdr.tpm_code);
+
+	return response->hdr.tpm_code;
+}
+
+uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
+{
+	struct tpm2_nv_read_cmd nv_readc;
+	uint8_t *dest = data;
+	uint32_t offset = 0;
+	uint32_t rv;
+
+	memset(&nv_readc, 0, sizeof(nv_readc));
+
+	nv_readc.nvIndex = HR_NV_INDEX + index;
+
+	/* Reads too big for one response are split into several. */
+	do {
+		uint32_t chunk = length - offset;
+		if (chunk > TPM2_MAX_NV_READ_CHUNK)
+			chunk = TPM2_MAX_NV_READ_CHUNK;
+		nv_readc.size = chunk;
+		nv_readc.offset = offset;
+
+		rv = tpm_nv_read_into(&nv_readc, dest + offset, &tpm2_resp);
+		rv = tlcl_nv_read_result(rv, &tpm2_resp, dest + offset, chunk);
+		if (rv != TPM_SUCCESS)
+			return rv;
+		offset += chunk;
+	} while (offset < length);
+
+	return TPM_SUCCESS;
+}
+
+uint32_t TlclReadMultiple(struct tlcl_nv_read *reads, int count)
+{
+	static struct tpm2_response responses[TPM2_MAX_QUEUED_COMMANDS];
+	struct tpm2_nv_read_cmd cmds[TPM2_MAX_QUEUED_COMMANDS];
+	struct tpm2_queued_command queue[TPM2_MAX_QUEUED_COMMANDS];
+	struct tlcl_nv_read *queued[TPM2_MAX_QUEUED_COMMANDS];
+	uint32_t rv;
+	int i = 0, j, n;
+
+	while (i < count) {
+		memset(cmds, 0, sizeof(cmds));
+		for (n = 0; i < count && n < TPM2_MAX_QUEUED_COMMANDS; i++) {
+			struct tlcl_nv_read *r = reads + i;
+
+			/* Too big for one NV_Read, so read it on its own */
+			if (r->length > TPM2_MAX_NV_READ_CHUNK) {
+				r->result = TlclRead(r->index, r->data,
+						     r->length);
+				continue;
+			}
+
+			cmds[n].nvIndex = HR_NV_INDEX + r->index;
+			cmds[n].size = r->length;
+			queue[n].command = TPM2_NV_Read;
+			queue[n].command_body = &cmds[n];
+			queue[n].response = &responses[n];
+			queued[n++] = r;
+		}
+		if (!n)
+			continue;
+
+		rv = tpm_get_responses(queue, n);
+
+		for (j = 0; j < n; j++) {
+			struct tlcl_nv_read *r = queued[j];
+
+			if (rv == TPM_SUCCESS && queue[j].rv == TPM_SUCCESS)
+				r->result = tlcl_nv_read_result(
+					responses[j].hdr.tpm_code,
+					&responses[j], r->data, r->length);
+			else
+				r->result = rv ? rv : queue[j].rv;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (reads[i].result != TPM_SUCCESS)
+			return reads[i].result;
+	}
 	return TPM_SUCCESS;
 }
 
@@ -13,6 +13,7 @@
 #define kTpmRequestHeaderLength 10
 #define kTpmResponseHeaderLength 10
 #define kTpmReadInfoLength 12
+#define kTpmWriteInfoLength 12
 #define kEncAuthLength 20
 #define kPcrDigestLength 20
 #define kTpmRequestAuthBlockLength \
@@ -24,7 +25,8 @@
  * Conversion functions.  ToTpmTYPE puts a value of type TYPE into a TPM
  * command buffer.  FromTpmTYPE gets a value of type TYPE from a TPM command
  * buffer into a variable. ReadTpmTYPE reads a value of type TYPE from a buffer
- * and advances the buffer pointer to after the field.
+ * and advances the buffer pointer to after the field.  WriteTpmTYPE does the
+ * same for putting a value into a buffer.
  */
 __attribute__((unused))
 static inline void ToTpmUint32(uint8_t *buffer, uint32_t x) {
@@ -56,6 +58,15 @@ static inline uint32_t ReadTpmUint32(const uint8_t **buffer) {
 	return value;
 }
 
+/*
+ * See comment for above function.
+ */
+__attribute__((unused))
+static inline void WriteTpmUint32(uint8_t **buffer, uint32_t x) {
+	ToTpmUint32(*buffer, x);
+	*buffer += sizeof(x);
+}
+
 /*
  * See comment for above function.
  */
@@ -84,4 +95,13 @@ static inline uint16_t ReadTpmUint16(const uint8_t **buffer) {
 	return value;
 }
 
+/*
+ * See comment for above function.
+ */
+__attribute__((unused))
+static inline void WriteTpmUint16(uint8_t **buffer, uint16_t x) {
+	ToTpmUint16(*buffer, x);
+	*buffer += sizeof(x);
+}
+
 #endif  /* TPM_LITE_TLCL_INTERNAL_H_ */
@@ -1,181 +1,232 @@
-/* This file is automatically generated */
-
-const struct s_tpm_delegate_read_table_cmd{
-	uint8_t buffer[10];
-} tpm_delegate_read_table_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0xdb, },
-};
-
-const struct s_tpm_create_delegation_family_cmd{
-	uint8_t buffer[23];
-	uint16_t familyLabel;
-} tpm_create_delegation_family_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x17, 0x0, 0x0, 0x0, 0xd2, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1, 0x0, 0x0, 0x0, 0x1, },
-22, };
-
-const struct s_tpm_takeownership_cmd{
-	uint8_t buffer[624];
-	uint16_t encOwnerAuth;
-	uint16_t encSrkAuth;
-} tpm_takeownership_cmd = {{0x0, 0xc2, 0x0, 0x0, 0x2, 0x70, 0x0, 0x0, 0x0, 0xd, 0x0, 0x5, 0x0, 0x0, 0x1, 0x0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x0, 0x1, 0x0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x28, 0x0, 0x0, 0x0, 0x11, 0x0, 0x0, 0x0, 0x0, 0x1, 0x0, 0x0, 0x0, 0x1, 0x0, 0x3, 0x0, 0x1, 0x0, 0x0, 0x0, 0xc, 0x0, 0x0, 0x8, 0x0, 0x0, 0x0, 0x0, 0x2, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, },
-16, 276, };
-
-const struct s_tpm_osap_cmd{
-	uint8_t buffer[36];
-	uint16_t entityType;
-	uint16_t entityValue;
-	uint16_t nonceOddOSAP;
-} tpm_osap_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x24, 0x0, 0x0, 0x0, 0xb, },
-10, 12, 16, };
-
-const struct s_tpm_oiap_cmd{
-	uint8_t buffer[10];
-} tpm_oiap_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0xa, },
-};
-
-const struct s_tpm_ifx_fieldupgradeinforequest2_cmd{
-	uint8_t buffer[13];
-} tpm_ifx_fieldupgradeinforequest2_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xd, 0x0, 0x0, 0x0, 0xaa, 0x11, 0x0, 0x0, },
-};
-
-const struct s_tpm_getversionval_cmd{
-	uint8_t buffer[18];
-} tpm_getversionval_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x12, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0x1a, 0x0, 0x0, 0x0, 0x0, },
-};
-
-const struct s_tpm_extend_cmd{
-	uint8_t buffer[34];
-	uint16_t pcrNum;
-	uint16_t inDigest;
-} tpm_extend_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x22, 0x0, 0x0, 0x0, 0x14, },
-10, 14, };
-
-const struct s_tpm_get_random_cmd{
-	uint8_t buffer[14];
-	uint16_t bytesRequested;
-} tpm_get_random_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xe, 0x0, 0x0, 0x0, 0x46, },
-10, };
-
-const struct s_tpm_getownership_cmd{
-	uint8_t buffer[22];
-} tpm_getownership_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x16, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0x5, 0x0, 0x0, 0x0, 0x4, 0x0, 0x0, 0x1, 0x11, },
-};
-
-const struct s_tpm_getspaceinfo_cmd{
-	uint8_t buffer[22];
-	uint16_t index;
-} tpm_getspaceinfo_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x16, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0x11, 0x0, 0x0, 0x0, 0x4, },
-18, };
-
-const struct s_tpm_getstclearflags_cmd{
-	uint8_t buffer[22];
-} tpm_getstclearflags_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x16, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0x4, 0x0, 0x0, 0x0, 0x4, 0x0, 0x0, 0x1, 0x9, },
-};
-
-const struct s_tpm_getflags_cmd{
-	uint8_t buffer[22];
-} tpm_getflags_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x16, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0x4, 0x0, 0x0, 0x0, 0x4, 0x0, 0x0, 0x1, 0x8, },
-};
-
-const struct s_tpm_physicalsetdeactivated_cmd{
-	uint8_t buffer[11];
-	uint16_t deactivated;
-} tpm_physicalsetdeactivated_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xb, 0x0, 0x0, 0x0, 0x72, },
-10, };
-
-const struct s_tpm_physicalenable_cmd{
-	uint8_t buffer[10];
-} tpm_physicalenable_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x6f, },
-};
-
-const struct s_tpm_physicaldisable_cmd{
-	uint8_t buffer[10];
-} tpm_physicaldisable_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x70, },
-};
-
-const struct s_tpm_forceclear_cmd{
-	uint8_t buffer[10];
-} tpm_forceclear_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x5d, },
-};
-
-const struct s_tpm_readpubek_cmd{
-	uint8_t buffer[30];
-	uint16_t antiReplay;
-} tpm_readpubek_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x1e, 0x0, 0x0, 0x0, 0x7c, },
-10, };
-
-const struct s_tpm_continueselftest_cmd{
-	uint8_t buffer[10];
-} tpm_continueselftest_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x53, },
-};
-
-const struct s_tpm_selftestfull_cmd{
-	uint8_t buffer[10];
-} tpm_selftestfull_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x50, },
-};
-
-const struct s_tpm_resume_cmd{
-	uint8_t buffer[12];
-} tpm_resume_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x0, 0x0, 0x0, 0x99, 0x0, 0x2, },
-};
-
-const struct s_tpm_savestate_cmd{
-	uint8_t buffer[10];
-} tpm_savestate_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x98, },
-};
-
-const struct s_tpm_startup_cmd{
-	uint8_t buffer[12];
-} tpm_startup_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x0, 0x0, 0x0, 0x99, 0x0, 0x1, },
-};
-
-const struct s_tpm_finalizepp_cmd{
-	uint8_t buffer[12];
-} tpm_finalizepp_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x40, 0x0, 0x0, 0xa, 0x2, 0xa0, },
-};
-
-const struct s_tpm_pplock_cmd{
-	uint8_t buffer[12];
-} tpm_pplock_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x40, 0x0, 0x0, 0xa, 0x0, 0x4, },
-};
-
-const struct s_tpm_ppenable_cmd{
-	uint8_t buffer[12];
-} tpm_ppenable_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x40, 0x0, 0x0, 0xa, 0x0, 0x20, },
-};
-
-const struct s_tpm_ppassert_cmd{
-	uint8_t buffer[12];
-} tpm_ppassert_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xc, 0x40, 0x0, 0x0, 0xa, 0x0, 0x8, },
-};
-
-const struct s_tpm_pcr_read_cmd{
-	uint8_t buffer[14];
-	uint16_t pcrNum;
-} tpm_pcr_read_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0xe, 0x0, 0x0, 0x0, 0x15, },
-10, };
-
-const struct s_tpm_nv_read_cmd{
-	uint8_t buffer[22];
-	uint16_t index;
-	uint16_t length;
-} tpm_nv_read_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x16, 0x0, 0x0, 0x0, 0xcf, },
-10, 18, };
-
-const struct s_tpm_nv_write_cmd{
-	uint8_t buffer[256];
-	uint16_t index;
-	uint16_t length;
-	uint16_t data;
-} tpm_nv_write_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xcd, },
-10, 18, 22, };
-
-const struct s_tpm_nv_definespace_cmd{
-	uint8_t buffer[101];
-	uint16_t index;
-	uint16_t pcr_info_read;
-	uint16_t pcr_info_write;
-	uint16_t perm;
-	uint16_t size;
-} tpm_nv_definespace_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0xcc, 0x0, 0x18, 0, 0, 0, 0, 0x0, 0x3, 0, 0, 0, 0x1f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x3, 0, 0, 0, 0x1f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x17, },
-12, 16, 42, 70, 77, };
-
-const int kWriteInfoLength = 12;
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Layouts of the TPM 1.2 commands sent by tlcl.c.
+ *
+ * Commands which never change are complete byte arrays, sent as they are.
+ * For commands with run-time fields, only the command size and the offsets
+ * of its fields are given here; tlcl.c stores the header and every field
+ * directly into a buffer on its stack.  The static assertions check each
+ * layout against the TPM structure sizes, so a wrong offset fails the build.
+ */
+
+#ifndef TPM_LITE_TLCL_STRUCTURES_H_
+#define TPM_LITE_TLCL_STRUCTURES_H_
+
+/* Big-endian initializers for the fields of a constant command. */
+#define TPM_CMD_U8(x) (uint8_t)(x)
+#define TPM_CMD_U16(x) (uint8_t)((x) >> 8), (uint8_t)(x)
+#define TPM_CMD_U32(x) (uint8_t)((x) >> 24), (uint8_t)((x) >> 16), \
+		       (uint8_t)((x) >> 8), (uint8_t)(x)
+#define TPM_CMD_HEADER(tag, size, ordinal) \
+	TPM_CMD_U16(tag), TPM_CMD_U32(size), TPM_CMD_U32(ordinal)
+
+/*
+ * Defines a constant command of type |ordinal| whose parameters follow the
+ * header, and checks that it is |size| bytes long.
+ */
+#define TPM_CONST_COMMAND(name, size, ordinal, ...)			\
+	static const uint8_t name[] = {					\
+		TPM_CMD_HEADER(TPM_TAG_RQU_COMMAND, size, ordinal),	\
+		__VA_ARGS__						\
+	};								\
+	_Static_assert(sizeof(name) == (size), #name " size")
+
+/* Size of a TPM_GetCapability command with a 32-bit sub-capability. */
+#define kGetCapabilityLength (kTpmRequestHeaderLength + \
+			      sizeof(TPM_CAPABILITY_AREA) + \
+			      sizeof(uint32_t) + sizeof(uint32_t))
+
+/* Commands sent as they are */
+
+TPM_CONST_COMMAND(tpm_startup_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_STARTUP_TYPE),
+		  TPM_ORD_Startup, TPM_CMD_U16(TPM_ST_CLEAR));
+
+TPM_CONST_COMMAND(tpm_resume_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_STARTUP_TYPE),
+		  TPM_ORD_Startup, TPM_CMD_U16(TPM_ST_STATE));
+
+TPM_CONST_COMMAND(tpm_savestate_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_SaveState);
+
+TPM_CONST_COMMAND(tpm_selftestfull_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_SelfTestFull);
+
+TPM_CONST_COMMAND(tpm_continueselftest_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_ContinueSelfTest);
+
+TPM_CONST_COMMAND(tpm_ppassert_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_PHYSICAL_PRESENCE),
+		  TSC_ORD_PhysicalPresence,
+		  TPM_CMD_U16(TPM_PHYSICAL_PRESENCE_PRESENT));
+
+TPM_CONST_COMMAND(tpm_ppenable_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_PHYSICAL_PRESENCE),
+		  TSC_ORD_PhysicalPresence,
+		  TPM_CMD_U16(TPM_PHYSICAL_PRESENCE_CMD_ENABLE));
+
+TPM_CONST_COMMAND(tpm_pplock_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_PHYSICAL_PRESENCE),
+		  TSC_ORD_PhysicalPresence,
+		  TPM_CMD_U16(TPM_PHYSICAL_PRESENCE_LOCK));
+
+TPM_CONST_COMMAND(tpm_finalizepp_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_PHYSICAL_PRESENCE),
+		  TSC_ORD_PhysicalPresence,
+		  TPM_CMD_U16(TPM_PHYSICAL_PRESENCE_CMD_ENABLE |
+			      TPM_PHYSICAL_PRESENCE_HW_DISABLE |
+			      TPM_PHYSICAL_PRESENCE_LIFETIME_LOCK));
+
+TPM_CONST_COMMAND(tpm_forceclear_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_ForceClear);
+
+TPM_CONST_COMMAND(tpm_physicalenable_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_PhysicalEnable);
+
+TPM_CONST_COMMAND(tpm_physicaldisable_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_PhysicalDisable);
+
+TPM_CONST_COMMAND(tpm_getflags_cmd, kGetCapabilityLength,
+		  TPM_ORD_GetCapability,
+		  TPM_CMD_U32(TPM_CAP_FLAG),
+		  TPM_CMD_U32(sizeof(uint32_t)),
+		  TPM_CMD_U32(TPM_CAP_FLAG_PERMANENT));
+
+TPM_CONST_COMMAND(tpm_getstclearflags_cmd, kGetCapabilityLength,
+		  TPM_ORD_GetCapability,
+		  TPM_CMD_U32(TPM_CAP_FLAG),
+		  TPM_CMD_U32(sizeof(uint32_t)),
+		  TPM_CMD_U32(TPM_CAP_FLAG_VOLATILE));
+
+TPM_CONST_COMMAND(tpm_getownership_cmd, kGetCapabilityLength,
+		  TPM_ORD_GetCapability,
+		  TPM_CMD_U32(TPM_CAP_PROPERTY),
+		  TPM_CMD_U32(sizeof(uint32_t)),
+		  TPM_CMD_U32(TPM_CAP_PROP_OWNER));
+
+TPM_CONST_COMMAND(tpm_getversionval_cmd,
+		  kTpmRequestHeaderLength + sizeof(TPM_CAPABILITY_AREA) +
+		  sizeof(uint32_t),
+		  TPM_ORD_GetCapability,
+		  TPM_CMD_U32(TPM_CAP_GET_VERSION_VAL),
+		  TPM_CMD_U32(0));
+
+TPM_CONST_COMMAND(tpm_ifx_fieldupgradeinforequest2_cmd,
+		  kTpmRequestHeaderLength +
+		  sizeof(TPM_IFX_FieldUpgradeInfoRequest2) + sizeof(uint16_t),
+		  TPM_ORD_FieldUpgrade,
+		  TPM_CMD_U8(TPM_IFX_FieldUpgradeInfoRequest2),
+		  TPM_CMD_U16(0));
+
+TPM_CONST_COMMAND(tpm_oiap_cmd, kTpmRequestHeaderLength, TPM_ORD_OIAP);
+
+TPM_CONST_COMMAND(tpm_delegate_read_table_cmd, kTpmRequestHeaderLength,
+		  TPM_ORD_Delegate_ReadTable);
+
+/* Commands built at run time; offsets are from the start of the command */
+
+/* TPM_NV_DefineSpace: TPM_NV_DATA_PUBLIC, then the encrypted auth */
+#define kNvDefineSpaceTag kTpmRequestHeaderLength
+#define kNvDefineSpaceIndex (kNvDefineSpaceTag + sizeof(TPM_STRUCTURE_TAG))
+#define kNvDefineSpacePcrInfoRead (kNvDefineSpaceIndex + sizeof(TPM_NV_INDEX))
+#define kNvDefineSpacePcrInfoWrite \
+	(kNvDefineSpacePcrInfoRead + sizeof(TPM_PCR_INFO_SHORT))
+#define kNvDefineSpacePermission \
+	(kNvDefineSpacePcrInfoWrite + sizeof(TPM_PCR_INFO_SHORT))
+#define kNvDefineSpacePerm \
+	(kNvDefineSpacePermission + offsetof(TPM_NV_ATTRIBUTES, attributes))
+/* bReadSTClear, bWriteSTClear and bWriteDefine are always 0 */
+#define kNvDefineSpaceDataSize (kNvDefineSpacePermission + \
+			    sizeof(TPM_NV_ATTRIBUTES) + 3 * sizeof(TPM_BOOL))
+#define kNvDefineSpaceLength \
+	(kNvDefineSpaceDataSize + sizeof(uint32_t) + kEncAuthLength)
+_Static_assert(kNvDefineSpaceLength == 101, "TPM_NV_DefineSpace size");
+_Static_assert(offsetof(TPM_PCR_INFO_SHORT, localityAtRelease) == 5,
+	       "TPM_PCR_INFO_SHORT layout");
+
+/* TPM_NV_WriteValue: TPM_WRITE_INFO, then the data */
+#define kNvWriteIndex kTpmRequestHeaderLength
+#define kNvWriteOffset (kNvWriteIndex + sizeof(uint32_t))
+#define kNvWriteLength (kNvWriteOffset + sizeof(uint32_t))
+#define kNvWriteData (kNvWriteLength + sizeof(uint32_t))
+_Static_assert(kNvWriteData == kTpmRequestHeaderLength + kTpmWriteInfoLength,
+	       "TPM_NV_WriteValue layout");
+
+/* TPM_NV_ReadValue: index, offset, length */
+#define kNvReadIndex kTpmRequestHeaderLength
+#define kNvReadOffset (kNvReadIndex + sizeof(uint32_t))
+#define kNvReadLength (kNvReadOffset + sizeof(uint32_t))
+#define kNvReadCmdLength (kNvReadLength + sizeof(uint32_t))
+_Static_assert(kNvReadCmdLength ==
+	       kTpmRequestHeaderLength + kTpmReadInfoLength,
+	       "TPM_NV_ReadValue size");
+/* Most data one TPM_NV_ReadValue response can return into our buffer */
+#define kNvReadMaxChunk (TPM_LARGE_ENOUGH_COMMAND_SIZE - \
+			 kTpmResponseHeaderLength - sizeof(uint32_t))
+
+/* TPM_PCRRead: pcrNum */
+#define kPcrReadLength (kTpmRequestHeaderLength + sizeof(uint32_t))
+
+/* TPM_Extend: pcrNum, inDigest */
+#define kExtendDigest (kTpmRequestHeaderLength + sizeof(uint32_t))
+#define kExtendLength (kExtendDigest + kPcrDigestLength)
+
+/* TPM_PhysicalSetDeactivated: state */
+#define kSetDeactivatedLength (kTpmRequestHeaderLength + sizeof(uint8_t))
+
+/* TPM_ReadPubek: antiReplay */
+#define kReadPubekAntiReplay kTpmRequestHeaderLength
+#define kReadPubekLength (kReadPubekAntiReplay + sizeof(TPM_NONCE))
+
+/* TPM_GetCapability for TPM_CAP_NV_INDEX: capArea, subCapSize, index */
+#define kGetSpaceInfoIndex \
+	(kTpmRequestHeaderLength + sizeof(TPM_CAPABILITY_AREA) + \
+	 sizeof(uint32_t))
+_Static_assert(kGetSpaceInfoIndex + sizeof(uint32_t) == kGetCapabilityLength,
+	       "TPM_GetCapability layout");
+
+/* TPM_GetRandom: bytesRequested */
+#define kGetRandomLength (kTpmRequestHeaderLength + sizeof(uint32_t))
+
+/* TPM_OSAP: entityType, entityValue, nonceOddOSAP */
+#define kOsapEntityType kTpmRequestHeaderLength
+#define kOsapEntityValue (kOsapEntityType + sizeof(uint16_t))
+#define kOsapNonceOdd (kOsapEntityValue + sizeof(uint32_t))
+#define kOsapLength (kOsapNonceOdd + sizeof(TPM_NONCE))
+
+/* TPM_FlushSpecific: handle, resourceType */
+#define kFlushSpecificHandle kTpmRequestHeaderLength
+#define kFlushSpecificResourceType (kFlushSpecificHandle + sizeof(uint32_t))
+#define kFlushSpecificLength (kFlushSpecificResourceType + sizeof(uint32_t))
+
+/*
+ * TPM_TakeOwnership: protocolID, encOwnerAuth, encSrkAuth, the srkParams
+ * TPM_KEY12, then the auth block.
+ */
+#define kTakeOwnershipProtocolId kTpmRequestHeaderLength
+#define kTakeOwnershipOwnerAuthSize \
+	(kTakeOwnershipProtocolId + sizeof(uint16_t))
+#define kTakeOwnershipOwnerAuth (kTakeOwnershipOwnerAuthSize + sizeof(uint32_t))
+#define kTakeOwnershipSrkAuthSize (kTakeOwnershipOwnerAuth + TPM_RSA_2048_LEN)
+#define kTakeOwnershipSrkAuth (kTakeOwnershipSrkAuthSize + sizeof(uint32_t))
+#define kTakeOwnershipSrkParams (kTakeOwnershipSrkAuth + TPM_RSA_2048_LEN)
+/*
+ * tag, fill, keyUsage, keyFlags, authDataUsage, algorithmID, encScheme,
+ * sigScheme, parmSize, keyLength, numPrimes, exponentSize, PCRInfoSize,
+ * pubKey.keyLength, encDataSize
+ */
+#define kTakeOwnershipSrkParamsLength \
+	(3 * sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint8_t) + \
+	 sizeof(uint32_t) + 2 * sizeof(uint16_t) + 7 * sizeof(uint32_t))
+#define kTakeOwnershipLength (kTakeOwnershipSrkParams + \
+			      kTakeOwnershipSrkParamsLength + \
+			      kTpmRequestAuthBlockLength)
+_Static_assert(kTakeOwnershipLength == 624, "TPM_TakeOwnership size");
+
+/* TPM_Delegate_Manage for TPM_FAMILY_CREATE: familyID, opCode, opData */
+#define kCreateFamilyLabel (kTpmRequestHeaderLength + 3 * sizeof(uint32_t))
+#define kCreateFamilyLength (kCreateFamilyLabel + sizeof(uint8_t))
+
+#endif  /* TPM_LITE_TLCL_STRUCTURES_H_ */
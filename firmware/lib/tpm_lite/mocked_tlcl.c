@@ -61,6 +61,16 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	return TPM_SUCCESS;
 }
 
+uint32_t TlclReadMultiple(struct tlcl_nv_read *reads, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		reads[i].result = TlclRead(reads[i].index, reads[i].data,
+					   reads[i].length);
+	return TPM_SUCCESS;
+}
+
 uint32_t TlclPCRRead(uint32_t index, void* data, uint32_t length)
 {
 	memset(data, '\0', length);
@@ -6,12 +6,10 @@
 /* A lightweight TPM command library.
  *
  * The general idea is that TPM commands are array of bytes whose
- * fields are mostly compile-time constant.  The goal is to build much
- * of the commands at compile time (or build time) and change some of
- * the fields at run time as needed.  The code in
- * utility/tlcl_generator.c builds structures containing the commands,
- * as well as the offsets of the fields that need to be set at run
- * time.
+ * fields are mostly compile-time constant.  Commands which never change
+ * are built at compile time and sent as they are.  The others are built
+ * on the stack at run time, storing each field at the offsets given in
+ * tlcl_structures.h.
  */
 
 #include "2sysincludes.h"
@@ -26,10 +24,13 @@
 #include "utility.h"
 #include "vboot_api.h"
 
-/* Sets the size field of a TPM command. */
-static inline void SetTpmCommandSize(uint8_t* buffer, uint32_t size)
+/* Sets the tag, size and command code fields of a TPM command. */
+static inline void SetTpmCommandHeader(uint8_t* buffer, uint16_t tag,
+				       uint32_t size, uint32_t code)
 {
+	ToTpmUint16(buffer, tag);
 	ToTpmUint32(buffer + sizeof(uint16_t), size);
+	ToTpmUint32(buffer + sizeof(uint16_t) + sizeof(uint32_t), code);
 }
 
 /* Gets the size field of a TPM command. */
@@ -70,6 +71,7 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 
 	uint32_t response_length = max_length;
 	uint32_t result;
+	uint64_t start;
 
 #ifdef EXTRA_LOGGING
 	VB2_DEBUG("TPM: command: %x%x %x%x%x%x %x%x%x%x\n",
@@ -78,16 +80,21 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 		  request[6], request[7], request[8], request[9]);
 #endif
 
+	start = VbExGetTimer();
 	result = VbExTpmSendReceive(request, TpmCommandSize(request),
 				    response, &response_length);
 	if (0 != result) {
 		/* Communication with TPM failed, so response is garbage */
 		VB2_DEBUG("TPM: command 0x%x send/receive failed: 0x%x\n",
 			  TpmCommandCode(request), result);
+		TlclStatsRecord(TpmCommandCode(request), result,
+				VbExGetTimer() - start);
 		return result;
 	}
 	/* Otherwise, use the result code from the response */
 	result = TpmReturnCode(response);
+	TlclStatsRecord(TpmCommandCode(request), result,
+			VbExGetTimer() - start);
 
 	/* TODO: add paranoia about returned response_length vs. max_length
 	 * (and possibly expected length from the response header).  See
@@ -167,7 +174,7 @@ static uint32_t StartOIAPSession(struct auth_session* session,
 	session->valid = 0;
 
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	uint32_t result = TlclSendReceive(tpm_oiap_cmd.buffer, response,
+	uint32_t result = TlclSendReceive(tpm_oiap_cmd, response,
 					  sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
@@ -201,19 +208,19 @@ static uint32_t StartOSAPSession(
 	session->valid = 0;
 
 	/* Build OSAP command. */
-	struct s_tpm_osap_cmd cmd;
-	memcpy(&cmd, &tpm_osap_cmd, sizeof(cmd));
-	ToTpmUint16(cmd.buffer + cmd.entityType, entity_type);
-	ToTpmUint32(cmd.buffer + cmd.entityValue, entity_value);
-	if (VbExTpmGetRandom(cmd.buffer + cmd.nonceOddOSAP,
+	uint8_t cmd[kOsapLength];
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_OSAP);
+	ToTpmUint16(cmd + kOsapEntityType, entity_type);
+	ToTpmUint32(cmd + kOsapEntityValue, entity_value);
+	if (VbExTpmGetRandom(cmd + kOsapNonceOdd,
 			     sizeof(TPM_NONCE)) != VB2_SUCCESS) {
 		return TPM_E_INTERNAL_ERROR;
 	}
 
 	/* Send OSAP command. */
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	uint32_t result = TlclSendReceive(cmd.buffer, response,
-					  sizeof(response));
+	uint32_t result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
 	}
@@ -237,7 +244,7 @@ static uint32_t StartOSAPSession(
 	/* Compute shared secret */
 	uint8_t hmac_input[2 * sizeof(TPM_NONCE)];
 	memcpy(hmac_input, nonce_even_osap, sizeof(TPM_NONCE));
-	memcpy(hmac_input + sizeof(TPM_NONCE), cmd.buffer + cmd.nonceOddOSAP,
+	memcpy(hmac_input + sizeof(TPM_NONCE), cmd + kOsapNonceOdd,
 	       sizeof(TPM_NONCE));
 	if (hmac(VB2_HASH_SHA1, entity_usage_auth, TPM_AUTH_DATA_LEN,
 		 hmac_input, sizeof(hmac_input), session->shared_secret,
@@ -386,42 +393,165 @@ static uint32_t CheckResponseAuthBlock(struct auth_session* auth_session,
 	return TPM_SUCCESS;
 }
 
+/*
+ * Owner OSAP session.  With |keep_owner_session| set by TlclKeepOwnerSession(),
+ * it's kept open across owner-authorized commands so that a run of them (as
+ * when provisioning NV spaces) needs one TPM_OSAP instead of one per command.
+ * Otherwise each command closes it.  |owner_session_auth| is the owner auth it
+ * was started with.
+ */
+static struct auth_session owner_session;
+static uint8_t owner_session_auth[TPM_AUTH_DATA_LEN];
+static int keep_owner_session;
+
+/* Closes an auth session on the TPM, if it is still open. */
+static void FlushAuthSession(struct auth_session* session)
+{
+	if (session->valid) {
+		uint8_t cmd[kFlushSpecificLength];
+		SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+				    TPM_ORD_FlushSpecific);
+		ToTpmUint32(cmd + kFlushSpecificHandle, session->handle);
+		ToTpmUint32(cmd + kFlushSpecificResourceType, TPM_RT_AUTH);
+		/* If this fails, the TPM drops the session at TPM_Startup. */
+		Send(cmd);
+	}
+	memset(session, 0, sizeof(*session));
+}
+
+/*
+ * Makes sure the owner session is open for |owner_auth|, starting a new one if
+ * need be.  Sets *reused to 1 if it was already open.
+ */
+static uint32_t GetOwnerSession(const uint8_t owner_auth[TPM_AUTH_DATA_LEN],
+				int* reused)
+{
+	*reused = 0;
+	if (owner_session.valid) {
+		if (!vb2_safe_memcmp(owner_session_auth, owner_auth,
+				     TPM_AUTH_DATA_LEN)) {
+			*reused = 1;
+			return TPM_SUCCESS;
+		}
+		FlushAuthSession(&owner_session);
+	}
+
+	memcpy(owner_session_auth, owner_auth, TPM_AUTH_DATA_LEN);
+	return StartOSAPSession(&owner_session, TPM_ET_OWNER, 0, owner_auth);
+}
+
+/*
+ * Sends a command authorized by the owner through the owner session, and
+ * checks the response.  The command size in |cmd| must already include the
+ * auth block, which gets filled in here.
+ */
+static uint32_t SendOwnerAuthorized(const uint8_t owner_auth[TPM_AUTH_DATA_LEN],
+				    TPM_COMMAND_CODE ordinal,
+				    uint8_t* cmd, uint32_t cmd_size)
+{
+	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+	uint32_t result;
+	int reused;
+
+	result = GetOwnerSession(owner_auth, &reused);
+	if (result != TPM_SUCCESS) {
+		return result;
+	}
+
+	/* Ask the TPM to keep the session open for the next command, or not. */
+	result = AddRequestAuthBlock(&owner_session, cmd, cmd_size,
+				     keep_owner_session ? 1 : 0);
+	if (result != TPM_SUCCESS) {
+		return result;
+	}
+
+	result = TlclSendReceive(cmd, response, sizeof(response));
+
+	/*
+	 * The TPM may have dropped a session we kept open (it went through
+	 * TPM_Startup, or another client flushed it), so start a new one and
+	 * try once more.  Don't retry anything else; an auth failure counts
+	 * towards the TPM's dictionary attack lockout.
+	 */
+	if (result == TPM_E_INVALID_AUTHHANDLE && reused) {
+		VB2_DEBUG("TPM: Owner session closed, starting a new one\n");
+		memset(&owner_session, 0, sizeof(owner_session));
+		return SendOwnerAuthorized(owner_auth, ordinal, cmd, cmd_size);
+	}
+
+	if (result == TPM_SUCCESS) {
+		/* This also notes whether the TPM kept the session open. */
+		result = CheckResponseAuthBlock(&owner_session, ordinal,
+						response, sizeof(response));
+	}
+
+	/* Error responses don't say whether the session is still open. */
+	if (result != TPM_SUCCESS) {
+		FlushAuthSession(&owner_session);
+	}
+
+	return result;
+}
+
+void TlclKeepOwnerSession(int keep)
+{
+	keep_owner_session = keep;
+	if (!keep)
+		FlushAuthSession(&owner_session);
+}
+
 #endif  /* CHROMEOS_ENVIRONMENT */
 
+/* Forgets the owner session, which the TPM closes at TPM_Startup. */
+static void ForgetOwnerSession(void)
+{
+#ifdef CHROMEOS_ENVIRONMENT
+	memset(&owner_session, 0, sizeof(owner_session));
+	memset(owner_session_auth, 0, sizeof(owner_session_auth));
+#endif
+}
+
 /* Exported functions. */
 
 uint32_t TlclLibInit(void)
 {
+	ForgetOwnerSession();
 	return VbExTpmInit();
 }
 
 uint32_t TlclLibClose(void)
 {
+#ifdef CHROMEOS_ENVIRONMENT
+	FlushAuthSession(&owner_session);
+#endif
+	ForgetOwnerSession();
 	return VbExTpmClose();
 }
 
 uint32_t TlclStartup(void)
 {
 	VB2_DEBUG("TPM: Startup\n");
-	return Send(tpm_startup_cmd.buffer);
+	ForgetOwnerSession();
+	return Send(tpm_startup_cmd);
 }
 
 uint32_t TlclSaveState(void)
 {
 	VB2_DEBUG("TPM: SaveState\n");
-	return Send(tpm_savestate_cmd.buffer);
+	return Send(tpm_savestate_cmd);
 }
 
 uint32_t TlclResume(void)
 {
 	VB2_DEBUG("TPM: Resume\n");
-	return Send(tpm_resume_cmd.buffer);
+	ForgetOwnerSession();
+	return Send(tpm_resume_cmd);
 }
 
 uint32_t TlclSelfTestFull(void)
 {
 	VB2_DEBUG("TPM: Self test full\n");
-	return Send(tpm_selftestfull_cmd.buffer);
+	return Send(tpm_selftestfull_cmd);
 }
 
 uint32_t TlclContinueSelfTest(void)
@@ -429,7 +559,7 @@ uint32_t TlclContinueSelfTest(void)
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	VB2_DEBUG("TPM: Continue self test\n");
 	/* Call the No Retry version of SendReceive to avoid recursion. */
-	return TlclSendReceiveNoRetry(tpm_continueselftest_cmd.buffer,
+	return TlclSendReceiveNoRetry(tpm_continueselftest_cmd,
 				      response, sizeof(response));
 }
 
@@ -462,66 +592,56 @@ uint32_t TlclDefineSpaceEx(const uint8_t* owner_auth, uint32_t owner_auth_size,
 			   uint32_t index, uint32_t perm, uint32_t size,
 			   const void* auth_policy, uint32_t auth_policy_size)
 {
-	uint32_t result;
-
 	/* Build the request data. */
-	uint8_t cmd[sizeof(tpm_nv_definespace_cmd.buffer) +
-			kTpmRequestAuthBlockLength];
-	memcpy(cmd, &tpm_nv_definespace_cmd, sizeof(tpm_nv_definespace_cmd));
-	ToTpmUint32(cmd + tpm_nv_definespace_cmd.index, index);
-	ToTpmUint32(cmd + tpm_nv_definespace_cmd.perm, perm);
-	ToTpmUint32(cmd + tpm_nv_definespace_cmd.size, size);
+	uint8_t cmd[kNvDefineSpaceLength + kTpmRequestAuthBlockLength];
+	memset(cmd, 0, kNvDefineSpaceLength);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, kNvDefineSpaceLength,
+			    TPM_ORD_NV_DefineSpace);
+	ToTpmUint16(cmd + kNvDefineSpaceTag, TPM_TAG_NV_DATA_PUBLIC);
+	ToTpmUint32(cmd + kNvDefineSpaceIndex, index);
 	if (auth_policy != NULL) {
 		if (auth_policy_size != sizeof(TPM_NV_AUTH_POLICY)) {
 			return TPM_E_BUFFER_SIZE;
 		}
 
 		const TPM_NV_AUTH_POLICY* policy = auth_policy;
-		memcpy(cmd + tpm_nv_definespace_cmd.pcr_info_read,
+		memcpy(cmd + kNvDefineSpacePcrInfoRead,
 		       &policy->pcr_info_read, sizeof(policy->pcr_info_read));
-		memcpy(cmd + tpm_nv_definespace_cmd.pcr_info_write,
+		memcpy(cmd + kNvDefineSpacePcrInfoWrite,
 		       &policy->pcr_info_write, sizeof(policy->pcr_info_write));
-	}
+	} else {
+		/* No PCRs selected, any locality */
+		ToTpmUint16(cmd + kNvDefineSpacePcrInfoRead,
+			    sizeof(((TPM_PCR_SELECTION*)0)->pcrSelect));
+		cmd[kNvDefineSpacePcrInfoRead +
+		    offsetof(TPM_PCR_INFO_SHORT, localityAtRelease)] =
+			TPM_ALL_LOCALITIES;
+		ToTpmUint16(cmd + kNvDefineSpacePcrInfoWrite,
+			    sizeof(((TPM_PCR_SELECTION*)0)->pcrSelect));
+		cmd[kNvDefineSpacePcrInfoWrite +
+		    offsetof(TPM_PCR_INFO_SHORT, localityAtRelease)] =
+			TPM_ALL_LOCALITIES;
+	}
+	ToTpmUint16(cmd + kNvDefineSpacePermission, TPM_TAG_NV_ATTRIBUTES);
+	ToTpmUint32(cmd + kNvDefineSpacePerm, perm);
+	ToTpmUint32(cmd + kNvDefineSpaceDataSize, size);
 
 #ifdef CHROMEOS_ENVIRONMENT
-	struct auth_session auth_session;
 	if (owner_auth) {
 		if (owner_auth_size != TPM_AUTH_DATA_LEN) {
 			return TPM_E_AUTHFAIL;
 		}
 
-		result = StartOSAPSession(&auth_session, TPM_ET_OWNER, 0,
-					  owner_auth);
-		if (result != TPM_SUCCESS) {
-			return result;
-		}
-
 		ToTpmUint32(cmd + sizeof(uint16_t), sizeof(cmd));
 		ToTpmUint16(cmd, TPM_TAG_RQU_AUTH1_COMMAND);
-		result = AddRequestAuthBlock(&auth_session, cmd, sizeof(cmd),
-					     0);
-		if (result != TPM_SUCCESS) {
-			return result;
-		}
+		return SendOwnerAuthorized(owner_auth, TPM_ORD_NV_DefineSpace,
+					   cmd, sizeof(cmd));
 	}
 #endif
 
 	/* Send the command. */
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	result = TlclSendReceive(cmd, response, sizeof(response));
-	if (result != TPM_SUCCESS) {
-		return result;
-	}
-
-#ifdef CHROMEOS_ENVIRONMENT
-	if (owner_auth) {
-		result = CheckResponseAuthBlock(&auth_session,
-						TPM_ORD_NV_DefineSpace,
-						response, sizeof(response));
-	}
-#endif
-
-	return result;
+	return TlclSendReceive(cmd, response, sizeof(response));
 }
 
 uint32_t TlclInitNvAuthPolicy(uint32_t pcr_selection_bitmap,
@@ -618,42 +738,72 @@ uint32_t TlclInitNvAuthPolicy(uint32_t pcr_selection_bitmap,
 
 uint32_t TlclWrite(uint32_t index, const void* data, uint32_t length)
 {
-	struct s_tpm_nv_write_cmd cmd;
+	uint8_t cmd[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	const int total_length =
-			kTpmRequestHeaderLength + kWriteInfoLength + length;
+	const int total_length = kNvWriteData + length;
 
 	VB2_DEBUG("TPM: TlclWrite(0x%x, %d)\n", index, length);
-	memcpy(&cmd, &tpm_nv_write_cmd, sizeof(cmd));
 	VbAssert(total_length <= TPM_LARGE_ENOUGH_COMMAND_SIZE);
-	SetTpmCommandSize(cmd.buffer, total_length);
-
-	ToTpmUint32(cmd.buffer + tpm_nv_write_cmd.index, index);
-	ToTpmUint32(cmd.buffer + tpm_nv_write_cmd.length, length);
-	memcpy(cmd.buffer + tpm_nv_write_cmd.data, data, length);
-
-	return TlclSendReceive(cmd.buffer, response, sizeof(response));
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, total_length,
+			    TPM_ORD_NV_WriteValue);
+	ToTpmUint32(cmd + kNvWriteIndex, index);
+	ToTpmUint32(cmd + kNvWriteOffset, 0);
+	ToTpmUint32(cmd + kNvWriteLength, length);
+	memcpy(cmd + kNvWriteData, data, length);
+
+	return TlclSendReceive(cmd, response, sizeof(response));
 }
 
 uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 {
-	struct s_tpm_nv_read_cmd cmd;
+	uint8_t cmd[kNvReadCmdLength];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+	uint8_t* dest = data;
+	uint32_t offset = 0;
 	uint32_t result;
 
 	VB2_DEBUG("TPM: TlclRead(0x%x, %d)\n", index, length);
-	memcpy(&cmd, &tpm_nv_read_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_nv_read_cmd.index, index);
-	ToTpmUint32(cmd.buffer + tpm_nv_read_cmd.length, length);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_NV_ReadValue);
+	ToTpmUint32(cmd + kNvReadIndex, index);
+
+	/* Reads too big for one response are split into several. */
+	do {
+		uint32_t chunk = length - offset;
+		if (chunk > kNvReadMaxChunk)
+			chunk = kNvReadMaxChunk;
+		ToTpmUint32(cmd + kNvReadOffset, offset);
+		ToTpmUint32(cmd + kNvReadLength, chunk);
+
+		result = TlclSendReceive(cmd, response, sizeof(response));
+		if (result != TPM_SUCCESS || chunk == 0)
+			break;
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
-	if (result == TPM_SUCCESS && length > 0) {
 		const uint8_t* nv_read_cursor =
 				response + kTpmResponseHeaderLength;
 		uint32_t result_length = ReadTpmUint32(&nv_read_cursor);
-		if (result_length > length)
-			result_length = length;  /* Truncate to fit buffer */
-		memcpy(data, nv_read_cursor, result_length);
+		if (result_length > chunk)
+			result_length = chunk;  /* Truncate to fit buffer */
+		memcpy(dest + offset, nv_read_cursor, result_length);
+		if (result_length < chunk)
+			break;  /* Nothing more to read */
+		offset += chunk;
+	} while (offset < length);
+
+	return result;
+}
+
+uint32_t TlclReadMultiple(struct tlcl_nv_read *reads, int count)
+{
+	uint32_t result = TPM_SUCCESS;
+	int i;
+
+	/* TPM1.2 commands are only ever sent one at a time */
+	for (i = 0; i < count; i++) {
+		reads[i].result = TlclRead(reads[i].index, reads[i].data,
+					   reads[i].length);
+		if (result == TPM_SUCCESS)
+			result = reads[i].result;
 	}
 
 	return result;
@@ -661,7 +811,7 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 
 uint32_t TlclPCRRead(uint32_t index, void* data, uint32_t length)
 {
-	struct s_tpm_pcr_read_cmd cmd;
+	uint8_t cmd[kPcrReadLength];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t result;
 
@@ -669,10 +819,11 @@ uint32_t TlclPCRRead(uint32_t index, void* data, uint32_t length)
 	if (length < kPcrDigestLength) {
 		return TPM_E_IOERROR;
 	}
-	memcpy(&cmd, &tpm_pcr_read_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_pcr_read_cmd.pcrNum, index);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_PcrRead);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength, index);
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result == TPM_SUCCESS) {
 		const uint8_t* pcr_read_cursor =
 				response + kTpmResponseHeaderLength;
@@ -697,32 +848,32 @@ uint32_t TlclReadLock(uint32_t index)
 uint32_t TlclAssertPhysicalPresence(void)
 {
 	VB2_DEBUG("TPM: Asserting physical presence\n");
-	return Send(tpm_ppassert_cmd.buffer);
+	return Send(tpm_ppassert_cmd);
 }
 
 uint32_t TlclPhysicalPresenceCMDEnable(void)
 {
 	VB2_DEBUG("TPM: Enable the physical presence command\n");
-	return Send(tpm_ppenable_cmd.buffer);
+	return Send(tpm_ppenable_cmd);
 }
 
 uint32_t TlclFinalizePhysicalPresence(void)
 {
 	VB2_DEBUG("TPM: Enable PP cmd, disable HW pp, and set lifetime lock\n");
-	return Send(tpm_finalizepp_cmd.buffer);
+	return Send(tpm_finalizepp_cmd);
 }
 
 uint32_t TlclAssertPhysicalPresenceResult(void)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	return TlclSendReceive(tpm_ppassert_cmd.buffer, response,
+	return TlclSendReceive(tpm_ppassert_cmd, response,
 			       sizeof(response));
 }
 
 uint32_t TlclLockPhysicalPresence(void)
 {
 	VB2_DEBUG("TPM: Lock physical presence\n");
-	return Send(tpm_pplock_cmd.buffer);
+	return Send(tpm_pplock_cmd);
 }
 
 uint32_t TlclSetNvLocked(void)
@@ -733,45 +884,51 @@ uint32_t TlclSetNvLocked(void)
 
 int TlclIsOwned(void)
 {
+	uint8_t cmd[kReadPubekLength];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE + TPM_PUBEK_SIZE];
 	uint32_t result;
-	result = TlclSendReceive(tpm_readpubek_cmd.buffer,
-				 response, sizeof(response));
+
+	/* The anti-replay nonce doesn't matter, since the key isn't used. */
+	memset(cmd, 0, sizeof(cmd));
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_ReadPubek);
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	return (result != TPM_SUCCESS);
 }
 
 uint32_t TlclForceClear(void)
 {
 	VB2_DEBUG("TPM: Force clear\n");
-	return Send(tpm_forceclear_cmd.buffer);
+	return Send(tpm_forceclear_cmd);
 }
 
 uint32_t TlclSetEnable(void)
 {
 	VB2_DEBUG("TPM: Enabling TPM\n");
-	return Send(tpm_physicalenable_cmd.buffer);
+	return Send(tpm_physicalenable_cmd);
 }
 
 uint32_t TlclClearEnable(void)
 {
 	VB2_DEBUG("TPM: Disabling TPM\n");
-	return Send(tpm_physicaldisable_cmd.buffer);
+	return Send(tpm_physicaldisable_cmd);
 }
 
 uint32_t TlclSetDeactivated(uint8_t flag)
 {
-	struct s_tpm_physicalsetdeactivated_cmd cmd;
+	uint8_t cmd[kSetDeactivatedLength];
 	VB2_DEBUG("TPM: SetDeactivated(%d)\n", flag);
-	memcpy(&cmd, &tpm_physicalsetdeactivated_cmd, sizeof(cmd));
-	*(cmd.buffer + cmd.deactivated) = flag;
-	return Send(cmd.buffer);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_PhysicalSetDeactivated);
+	cmd[kTpmRequestHeaderLength] = flag;
+	return Send(cmd);
 }
 
 uint32_t TlclGetPermanentFlags(TPM_PERMANENT_FLAGS* pflags)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getflags_cmd.buffer, response,
+	uint32_t result = TlclSendReceive(tpm_getflags_cmd, response,
 					  sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
@@ -789,7 +946,7 @@ uint32_t TlclGetSTClearFlags(TPM_STCLEAR_FLAGS* vflags)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getstclearflags_cmd.buffer,
+	uint32_t result = TlclSendReceive(tpm_getstclearflags_cmd,
 					  response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
@@ -834,15 +991,16 @@ uint32_t TlclSetGlobalLock(void)
 uint32_t TlclExtend(int pcr_num, const uint8_t* in_digest,
 		    uint8_t* out_digest)
 {
-	struct s_tpm_extend_cmd cmd;
+	uint8_t cmd[kExtendLength];
 	uint8_t response[kTpmResponseHeaderLength + kPcrDigestLength];
 	uint32_t result;
 
-	memcpy(&cmd, &tpm_extend_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_extend_cmd.pcrNum, pcr_num);
-	memcpy(cmd.buffer + cmd.inDigest, in_digest, kPcrDigestLength);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_Extend);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength, pcr_num);
+	memcpy(cmd + kExtendDigest, in_digest, kPcrDigestLength);
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
 
@@ -908,12 +1066,15 @@ uint32_t TlclGetSpaceInfo(uint32_t index, uint32_t *attributes, uint32_t *size,
 	}
 	policy = auth_policy;
 
-	struct s_tpm_getspaceinfo_cmd cmd;
-	memcpy(&cmd, &tpm_getspaceinfo_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_getspaceinfo_cmd.index, index);
+	uint8_t cmd[kGetCapabilityLength];
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_GetCapability);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength, TPM_CAP_NV_INDEX);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength +
+		    sizeof(TPM_CAPABILITY_AREA), sizeof(uint32_t));
+	ToTpmUint32(cmd + kGetSpaceInfoIndex, index);
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	uint32_t result = TlclSendReceive(cmd.buffer, response,
-					  sizeof(response));
+	uint32_t result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
 	}
@@ -963,7 +1124,7 @@ uint32_t TlclGetOwnership(uint8_t* owned)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getownership_cmd.buffer,
+	uint32_t result = TlclSendReceive(tpm_getownership_cmd,
 					  response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
@@ -979,20 +1140,21 @@ uint32_t TlclGetOwnership(uint8_t* owned)
 
 uint32_t TlclGetRandom(uint8_t* data, uint32_t length, uint32_t *size)
 {
-	struct s_tpm_get_random_cmd cmd;
+	uint8_t cmd[kGetRandomLength];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t result;
 
 	VB2_DEBUG("TPM: TlclGetRandom(%d)\n", length);
-	memcpy(&cmd, &tpm_get_random_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_get_random_cmd.bytesRequested, length);
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_GetRandom);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength, length);
 	/* There must be room in the response buffer for the bytes. */
 	if (length > TPM_LARGE_ENOUGH_COMMAND_SIZE - kTpmResponseHeaderLength
 	    - sizeof(uint32_t)) {
 		return TPM_E_IOERROR;
 	}
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result == TPM_SUCCESS) {
 		const uint8_t* get_random_cursor =
 				response + kTpmResponseHeaderLength;
@@ -1013,7 +1175,7 @@ uint32_t TlclGetVersion(uint32_t* vendor, uint64_t* firmware_version,
 			size_t* vendor_specific_buf_size)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	uint32_t result = TlclSendReceive(tpm_getversionval_cmd.buffer,
+	uint32_t result = TlclSendReceive(tpm_getversionval_cmd,
 					  response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
@@ -1082,7 +1244,7 @@ uint32_t TlclIFXFieldUpgradeInfo(TPM_IFX_FIELDUPGRADEINFO* info)
 	}
 
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	result = TlclSendReceive(tpm_ifx_fieldupgradeinforequest2_cmd.buffer,
+	result = TlclSendReceive(tpm_ifx_fieldupgradeinforequest2_cmd,
 				 response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
@@ -1217,9 +1379,10 @@ uint32_t TlclReadPubek(uint32_t* public_exponent,
 		       uint8_t* modulus,
 		       uint32_t* modulus_size)
 {
-	struct s_tpm_readpubek_cmd cmd;
-	memcpy(&cmd, &tpm_readpubek_cmd, sizeof(cmd));
-	if (VbExTpmGetRandom(cmd.buffer + tpm_readpubek_cmd.antiReplay,
+	uint8_t cmd[kReadPubekLength];
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_ReadPubek);
+	if (VbExTpmGetRandom(cmd + kReadPubekAntiReplay,
 			     sizeof(TPM_NONCE)) != VB2_SUCCESS) {
 		return TPM_E_INTERNAL_ERROR;
 	}
@@ -1227,8 +1390,7 @@ uint32_t TlclReadPubek(uint32_t* public_exponent,
 	/* The response contains the public endorsement key, so use a large
 	 * response buffer. */
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE + TPM_RSA_2048_LEN];
-	uint32_t result = TlclSendReceive(cmd.buffer, response,
-					  sizeof(response));
+	uint32_t result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
 	}
@@ -1261,7 +1423,7 @@ uint32_t TlclReadPubek(uint32_t* public_exponent,
 	vb2_sha1_init(&sha1_ctx);
 	vb2_sha1_update(&sha1_ctx, response + kTpmResponseHeaderLength,
 			checksum - (response + kTpmResponseHeaderLength));
-	vb2_sha1_update(&sha1_ctx, cmd.buffer + tpm_readpubek_cmd.antiReplay,
+	vb2_sha1_update(&sha1_ctx, cmd + kReadPubekAntiReplay,
 			sizeof(TPM_NONCE));
 	uint8_t digest[TPM_SHA1_160_HASH_LEN];
 	vb2_sha1_finalize(&sha1_ctx, digest);
@@ -1293,14 +1455,37 @@ uint32_t TlclTakeOwnership(uint8_t enc_owner_auth[TPM_RSA_2048_LEN],
 	}
 
 	/* Build the TakeOwnership command. */
-	struct s_tpm_takeownership_cmd cmd;
-	memcpy(&cmd, &tpm_takeownership_cmd, sizeof(cmd));
-	memcpy(cmd.buffer + tpm_takeownership_cmd.encOwnerAuth, enc_owner_auth,
-	       TPM_RSA_2048_LEN);
-	memcpy(cmd.buffer + tpm_takeownership_cmd.encSrkAuth, enc_srk_auth,
+	uint8_t cmd[kTakeOwnershipLength];
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_AUTH1_COMMAND, sizeof(cmd),
+			    TPM_ORD_TakeOwnership);
+	ToTpmUint16(cmd + kTakeOwnershipProtocolId, TPM_PID_OWNER);
+	ToTpmUint32(cmd + kTakeOwnershipOwnerAuthSize, TPM_RSA_2048_LEN);
+	memcpy(cmd + kTakeOwnershipOwnerAuth, enc_owner_auth,
 	       TPM_RSA_2048_LEN);
-	result = AddRequestAuthBlock(&auth_session, cmd.buffer,
-				     sizeof(cmd.buffer), 0);
+	ToTpmUint32(cmd + kTakeOwnershipSrkAuthSize, TPM_RSA_2048_LEN);
+	memcpy(cmd + kTakeOwnershipSrkAuth, enc_srk_auth, TPM_RSA_2048_LEN);
+
+	/* The srkParams TPM_KEY12, for a 2048-bit RSA storage key. */
+	uint8_t* cursor = cmd + kTakeOwnershipSrkParams;
+	WriteTpmUint16(&cursor, TPM_TAG_KEY12);
+	WriteTpmUint16(&cursor, 0);  /* fill */
+	WriteTpmUint16(&cursor, TPM_KEY_USAGE_STORAGE);
+	WriteTpmUint32(&cursor, 0);  /* keyFlags */
+	*cursor++ = TPM_AUTH_ALWAYS;
+	WriteTpmUint32(&cursor, TPM_ALG_RSA);
+	WriteTpmUint16(&cursor, TPM_ES_RSAESOAEP_SHA1_MGF1);
+	WriteTpmUint16(&cursor, TPM_SS_NONE);
+	WriteTpmUint32(&cursor, 3 * sizeof(uint32_t));  /* parmSize */
+	WriteTpmUint32(&cursor, 2048);  /* keyLength */
+	WriteTpmUint32(&cursor, 2);  /* numPrimes */
+	WriteTpmUint32(&cursor, 0);  /* exponentSize */
+	WriteTpmUint32(&cursor, 0);  /* PCRInfoSize */
+	WriteTpmUint32(&cursor, 0);  /* pubKey.keyLength */
+	WriteTpmUint32(&cursor, 0);  /* encDataSize */
+	VbAssert(cursor - cmd == kTakeOwnershipSrkParams +
+		 kTakeOwnershipSrkParamsLength);
+
+	result = AddRequestAuthBlock(&auth_session, cmd, sizeof(cmd), 0);
 	if (result != TPM_SUCCESS) {
 		return result;
 	}
@@ -1308,7 +1493,7 @@ uint32_t TlclTakeOwnership(uint8_t enc_owner_auth[TPM_RSA_2048_LEN],
 	/* The response buffer needs to be large to hold the public half of the
 	 * generated SRK. */
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE + TPM_RSA_2048_LEN];
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
 	}
@@ -1325,17 +1510,23 @@ uint32_t TlclTakeOwnership(uint8_t enc_owner_auth[TPM_RSA_2048_LEN],
 
 uint32_t TlclCreateDelegationFamily(uint8_t family_label)
 {
-	struct s_tpm_create_delegation_family_cmd cmd;
-	memcpy(&cmd, &tpm_create_delegation_family_cmd, sizeof(cmd));
-	cmd.buffer[tpm_create_delegation_family_cmd.familyLabel] = family_label;
-	return Send(cmd.buffer);
+	uint8_t cmd[kCreateFamilyLength];
+	SetTpmCommandHeader(cmd, TPM_TAG_RQU_COMMAND, sizeof(cmd),
+			    TPM_ORD_Delegate_Manage);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength, 0);  /* familyID */
+	ToTpmUint32(cmd + kTpmRequestHeaderLength + sizeof(uint32_t),
+		    TPM_FAMILY_CREATE);
+	ToTpmUint32(cmd + kTpmRequestHeaderLength + 2 * sizeof(uint32_t),
+		    sizeof(uint8_t));  /* opDataSize */
+	cmd[kCreateFamilyLabel] = family_label;
+	return Send(cmd);
 }
 
 uint32_t TlclReadDelegationFamilyTable(TPM_FAMILY_TABLE_ENTRY *table,
 				       uint32_t* table_size)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
-	uint32_t result = TlclSendReceive(tpm_delegate_read_table_cmd.buffer,
+	uint32_t result = TlclSendReceive(tpm_delegate_read_table_cmd,
 					  response, sizeof(response));
 	if (result != TPM_SUCCESS) {
 		return result;
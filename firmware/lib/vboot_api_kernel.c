@@ -12,9 +12,12 @@
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "2rsa.h"
+#include "cgptlib_internal.h"
 #include "ec_sync.h"
+#include "gpt.h"
 #include "load_kernel_fw.h"
 #include "rollback_index.h"
+#include "tlcl.h"
 #include "utility.h"
 #include "vb2_common.h"
 #include "vboot_api.h"
@@ -26,6 +29,22 @@
 static struct RollbackSpaceFwmp fwmp;
 static LoadKernelParams lkp;
 
+/* Non-volatile data as last read from or written to storage */
+static uint8_t nvdata_stored[VB2_NVDATA_SIZE_V2];
+static int nvdata_stored_valid;
+
+/* Memory boot image being verified as it arrives */
+static struct {
+	uint8_t *image;		/* NULL if none */
+	size_t image_size;
+	uint32_t body_offset;
+	uint32_t body_hashed;	/* Bytes of body hashed (or checked) so far */
+	VbError_t retval;	/* First error found in the body */
+	struct vb2_kernel_preamble *preamble;
+	struct vb2_public_key data_key;
+	struct vb2_digest_context dc;
+} mem_boot;
+
 #ifdef CHROMEOS_ENVIRONMENT
 /* Global variable accessors for unit tests */
 
@@ -58,7 +77,19 @@ void vb2_nv_commit(struct vb2_context *ctx)
 		return;
 
 	ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+
+	/*
+	 * Changes which were undone since the last commit, such as a
+	 * setting toggled back and forth in a UI loop, leave storage as it
+	 * is.  On flash-backed storage each write can cost an erase.
+	 */
+	if (nvdata_stored_valid &&
+	    !memcmp(nvdata_stored, ctx->nvdata, vb2_nv_get_size(ctx)))
+		return;
+
 	VbExNvStorageWrite(ctx->nvdata);
+	memcpy(nvdata_stored, ctx->nvdata, sizeof(nvdata_stored));
+	nvdata_stored_valid = 1;
 }
 
 uint32_t vb2_get_fwmp_flags(void)
@@ -66,11 +97,129 @@ uint32_t vb2_get_fwmp_flags(void)
 	return fwmp.flags;
 }
 
+__attribute__((weak))
+int VbExDiskHasHotplugEvents(void)
+{
+	return 0;
+}
+
+__attribute__((weak))
+void VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+		      uint64_t lba_count)
+{
+}
+
+/*
+ * Removable disks LoadKernel() has turned down, so scanning again after
+ * another disk is inserted doesn't read known-bad media again.  Only kept
+ * when the firmware reports hotplug events, since only then is a handle
+ * known not to be reused for a different disk.
+ */
+#define MAX_REJECTED_DISKS 8
+static struct {
+	VbExDiskHandle_t handle;
+	uint64_t lba_count;
+	VbError_t retval;
+} rejected_disks[MAX_REJECTED_DISKS];
+static uint32_t rejected_disk_count;
+
+/* Return the index of a rejected disk in rejected_disks, or -1 if none. */
+static int find_rejected_disk(const VbDiskInfo *info)
+{
+	uint32_t i;
+
+	for (i = 0; i < rejected_disk_count; i++) {
+		if (rejected_disks[i].handle == info->handle &&
+		    rejected_disks[i].lba_count == info->lba_count)
+			return i;
+	}
+	return -1;
+}
+
+/* Remember a disk which LoadKernel() turned down with retval. */
+static void add_rejected_disk(const VbDiskInfo *info, VbError_t retval)
+{
+	if (rejected_disk_count == MAX_REJECTED_DISKS)
+		return;
+
+	rejected_disks[rejected_disk_count].handle = info->handle;
+	rejected_disks[rejected_disk_count].lba_count = info->lba_count;
+	rejected_disks[rejected_disk_count].retval = retval;
+	rejected_disk_count++;
+}
+
+/* Forget rejected disks which are no longer in a fresh list of disks. */
+static void prune_rejected_disks(const VbDiskInfo *disk_info,
+				 uint32_t disk_count)
+{
+	uint32_t i, j, kept = 0;
+
+	for (i = 0; i < rejected_disk_count; i++) {
+		for (j = 0; j < disk_count; j++) {
+			if (disk_info[j].handle == rejected_disks[i].handle &&
+			    disk_info[j].lba_count ==
+			    rejected_disks[i].lba_count) {
+				rejected_disks[kept++] = rejected_disks[i];
+				break;
+			}
+		}
+	}
+	rejected_disk_count = kept;
+}
+
+/*
+ * Check what we can about a disk. FWIW, VbTryLoadKernel() is always called
+ * with only a single bit set in get_info_flags.
+ *
+ * Ensure that we got a partition with only the flags we asked for.
+ */
+static int is_usable_disk(const VbDiskInfo *info, uint32_t get_info_flags)
+{
+	return info->bytes_per_lba >= 512 &&
+		(info->bytes_per_lba & (info->bytes_per_lba - 1)) == 0 &&
+		info->lba_count >= 16 &&
+		get_info_flags == (info->flags & ~VB_DISK_FLAG_EXTERNAL_GPT);
+}
+
+/*
+ * Let the firmware start reading the primary and secondary GPT of every disk
+ * LoadKernel() may look at, before it looks at the first one.  Disks already
+ * turned down aren't read again if rejections are being remembered.
+ */
+static void prefetch_gpts(const VbDiskInfo *disk_info, uint32_t disk_count,
+			  uint32_t get_info_flags, int remember)
+{
+	uint64_t gpt_sectors;
+	uint32_t i;
+
+	for (i = 0; i < disk_count; i++) {
+		const VbDiskInfo *info = &disk_info[i];
+
+		if (!is_usable_disk(info, get_info_flags) ||
+		    (info->flags & VB_DISK_FLAG_EXTERNAL_GPT) ||
+		    (remember && find_rejected_disk(info) >= 0))
+			continue;
+
+		/* Header and a full table of entries */
+		gpt_sectors = GPT_HEADER_SECTORS +
+			(MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry) +
+			 info->bytes_per_lba - 1) / info->bytes_per_lba;
+		if (info->lba_count <= GPT_PMBR_SECTORS + 2 * gpt_sectors)
+			continue;
+		VbExDiskPrefetch(info->handle, 0,
+				 GPT_PMBR_SECTORS + gpt_sectors);
+		VbExDiskPrefetch(info->handle, info->lba_count - gpt_sectors,
+				 gpt_sectors);
+	}
+}
+
 uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 {
 	VbError_t retval = VBERROR_UNKNOWN;
 	VbDiskInfo* disk_info = NULL;
 	uint32_t disk_count = 0;
+	int remember = 0;
+	int rejected;
 	uint32_t i;
 
 	VB2_DEBUG("VbTryLoadKernel() start, get_info_flags=0x%x\n",
@@ -85,27 +234,21 @@ uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 		disk_count = 0;
 
 	VB2_DEBUG("VbTryLoadKernel() found %d disks\n", (int)disk_count);
+	if (get_info_flags == VB_DISK_FLAG_REMOVABLE) {
+		remember = VbExDiskHasHotplugEvents();
+		prune_rejected_disks(disk_info, remember ? disk_count : 0);
+	}
 	if (0 == disk_count) {
 		VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_NO_DISK);
 		return VBERROR_NO_DISK_FOUND;
 	}
 
+	prefetch_gpts(disk_info, disk_count, get_info_flags, remember);
+
 	/* Loop over disks */
 	for (i = 0; i < disk_count; i++) {
 		VB2_DEBUG("VbTryLoadKernel() trying disk %d\n", (int)i);
-		/*
-		 * Sanity-check what we can. FWIW, VbTryLoadKernel() is always
-		 * called with only a single bit set in get_info_flags.
-		 *
-		 * Ensure that we got a partition with only the flags we asked
-		 * for.
-		 */
-		if (disk_info[i].bytes_per_lba < 512 ||
-			(disk_info[i].bytes_per_lba &
-				(disk_info[i].bytes_per_lba  - 1)) != 0 ||
-					16 > disk_info[i].lba_count ||
-					get_info_flags != (disk_info[i].flags &
-					~VB_DISK_FLAG_EXTERNAL_GPT)) {
+		if (!is_usable_disk(&disk_info[i], get_info_flags)) {
 			VB2_DEBUG("  skipping: bytes_per_lba=%" PRIu64
 				  " lba_count=%" PRIu64 " flags=0x%x\n",
 				  disk_info[i].bytes_per_lba,
@@ -113,6 +256,12 @@ uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 				  disk_info[i].flags);
 			continue;
 		}
+		rejected = remember ? find_rejected_disk(&disk_info[i]) : -1;
+		if (rejected >= 0) {
+			VB2_DEBUG("  skipping: already rejected\n");
+			retval = rejected_disks[rejected].retval;
+			continue;
+		}
 		lkp.disk_handle = disk_info[i].handle;
 		lkp.bytes_per_lba = disk_info[i].bytes_per_lba;
 		lkp.gpt_lba_count = disk_info[i].lba_count;
@@ -133,6 +282,9 @@ uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 		 */
 		if (VBERROR_SUCCESS == retval)
 			break;
+
+		if (remember)
+			add_rejected_disk(&disk_info[i], retval);
 	}
 
 	/* If we didn't find any good kernels, don't return a disk handle. */
@@ -158,21 +310,18 @@ uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
  */
 static int vb2_reset_nv_requests(struct vb2_context *ctx)
 {
-	int need_reboot = 0;
+	static const struct vb2_nv_setting requests[] = {
+		{VB2_NV_DISPLAY_REQUEST, 0},
+		{VB2_NV_DIAG_REQUEST, 0},
+	};
 
-	if (vb2_nv_get(ctx, VB2_NV_DISPLAY_REQUEST)) {
+	if (vb2_nv_get(ctx, VB2_NV_DISPLAY_REQUEST))
 		VB2_DEBUG("Unset display request (undo display init)\n");
-		vb2_nv_set(ctx, VB2_NV_DISPLAY_REQUEST, 0);
-		need_reboot = 1;
-	}
 
-	if (vb2_nv_get(ctx, VB2_NV_DIAG_REQUEST)) {
+	if (vb2_nv_get(ctx, VB2_NV_DIAG_REQUEST))
 		VB2_DEBUG("Unset diagnostic request (undo display init)\n");
-		vb2_nv_set(ctx, VB2_NV_DIAG_REQUEST, 0);
-		need_reboot = 1;
-	}
 
-	return need_reboot;
+	return vb2_nv_set_many(ctx, requests, ARRAY_SIZE(requests));
 }
 
 VbError_t VbBootNormal(struct vb2_context *ctx)
@@ -238,11 +387,17 @@ VbError_t VbBootNormal(struct vb2_context *ctx)
 		shared->kernel_version_tpm = max_rollforward;
 	}
 
-	if ((shared->kernel_version_tpm > shared->kernel_version_tpm_start) &&
-	    RollbackKernelWrite(shared->kernel_version_tpm)) {
-		VB2_DEBUG("Error writing kernel versions to TPM.\n");
-		VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_W_ERROR);
-		return VBERROR_TPM_WRITE_KERNEL;
+	if (shared->kernel_version_tpm > shared->kernel_version_tpm_start) {
+		uint32_t tpm_rv;
+
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_BEGIN);
+		tpm_rv = RollbackKernelWrite(shared->kernel_version_tpm);
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_END);
+		if (tpm_rv) {
+			VB2_DEBUG("Error writing kernel versions to TPM.\n");
+			VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_W_ERROR);
+			return VBERROR_TPM_WRITE_KERNEL;
+		}
 	}
 
 	return rv;
@@ -252,6 +407,8 @@ static VbError_t vb2_kernel_setup(struct vb2_context *ctx,
 				  VbSharedDataHeader *shared,
 				  VbSelectAndLoadKernelParams *kparams)
 {
+	uint32_t tpm_rv;
+
 	if (VB2_SUCCESS != vb2_init_context(ctx)) {
 		VB2_DEBUG("Can't init vb2_context\n");
 		VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_SHARED_DATA);
@@ -284,6 +441,8 @@ static VbError_t vb2_kernel_setup(struct vb2_context *ctx,
 		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
 
 	VbExNvStorageRead(ctx->nvdata);
+	memcpy(nvdata_stored, ctx->nvdata, sizeof(nvdata_stored));
+	nvdata_stored_valid = 1;
 	vb2_nv_init(ctx);
 
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -312,6 +471,9 @@ static VbError_t vb2_kernel_setup(struct vb2_context *ctx,
 	memset(&lkp, 0, sizeof(lkp));
 	lkp.kernel_buffer = kparams->kernel_buffer;
 	lkp.kernel_buffer_size = kparams->kernel_buffer_size;
+	lkp.body_chunk_size = VB2_KERNEL_BODY_CHUNK_SIZE;
+	if (kparams->inflags & VB_SALK_INFLAGS_VBLOCK_IN_KERNEL_BUFFER)
+		lkp.boot_flags |= BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER;
 
 	/* Clear output params in case we fail */
 	kparams->disk_handle = NULL;
@@ -321,8 +483,15 @@ static VbError_t vb2_kernel_setup(struct vb2_context *ctx,
 	kparams->flags = 0;
 	memset(kparams->partition_guid, 0, sizeof(kparams->partition_guid));
 
-	/* Read kernel version from the TPM.  Ignore errors in recovery mode. */
-	if (RollbackKernelRead(&shared->kernel_version_tpm)) {
+	/*
+	 * Read kernel version from the TPM.  Ignore errors in recovery mode.
+	 * The FWMP is read along with it, unless it is going to be ignored.
+	 */
+	vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_BEGIN);
+	RollbackReadAhead(!(gbb->flags & VB2_GBB_FLAG_DISABLE_FWMP));
+	tpm_rv = RollbackKernelRead(&shared->kernel_version_tpm);
+	vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_END);
+	if (tpm_rv) {
 		VB2_DEBUG("Unable to get kernel versions from TPM\n");
 		if (!(ctx->flags & VB2_CONTEXT_RECOVERY_MODE)) {
 			VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_R_ERROR);
@@ -335,11 +504,17 @@ static VbError_t vb2_kernel_setup(struct vb2_context *ctx,
 	/* Read FWMP.  Ignore errors in recovery mode. */
 	if (gbb->flags & VB2_GBB_FLAG_DISABLE_FWMP) {
 		memset(&fwmp, 0, sizeof(fwmp));
-	} else if (RollbackFwmpRead(&fwmp)) {
-		VB2_DEBUG("Unable to get FWMP from TPM\n");
-		if (!(ctx->flags & VB2_CONTEXT_RECOVERY_MODE)) {
-			VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_R_ERROR);
-			return VBERROR_TPM_READ_FWMP;
+	} else {
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_BEGIN);
+		tpm_rv = RollbackFwmpRead(&fwmp);
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_END);
+		if (tpm_rv) {
+			VB2_DEBUG("Unable to get FWMP from TPM\n");
+			if (!(ctx->flags & VB2_CONTEXT_RECOVERY_MODE)) {
+				VbSetRecoveryRequest(
+					ctx, VB2_RECOVERY_RW_TPM_R_ERROR);
+				return VBERROR_TPM_READ_FWMP;
+			}
 		}
 	}
 
@@ -363,11 +538,17 @@ static VbError_t vb2_kernel_phase4(struct vb2_context *ctx,
 	       sizeof(kparams->partition_guid));
 
 	/* Lock the kernel versions if not in recovery mode */
-	if (!(ctx->flags & VB2_CONTEXT_RECOVERY_MODE) &&
-	    RollbackKernelLock(sd->recovery_reason)) {
-		VB2_DEBUG("Error locking kernel versions.\n");
-		VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_L_ERROR);
-		return VBERROR_TPM_LOCK_KERNEL;
+	if (!(ctx->flags & VB2_CONTEXT_RECOVERY_MODE)) {
+		uint32_t tpm_rv;
+
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_BEGIN);
+		tpm_rv = RollbackKernelLock(sd->recovery_reason);
+		vb2_trace(ctx, VB2_TRACE_TPM_COMMAND, VB2_TRACE_END);
+		if (tpm_rv) {
+			VB2_DEBUG("Error locking kernel versions.\n");
+			VbSetRecoveryRequest(ctx, VB2_RECOVERY_RW_TPM_L_ERROR);
+			return VBERROR_TPM_LOCK_KERNEL;
+		}
 	}
 
 	return VBERROR_SUCCESS;
@@ -380,9 +561,47 @@ static void vb2_kernel_cleanup(struct vb2_context *ctx)
 	/* vb2_shared_data may not have been initialized, and we may not have a
 	   proper vbsd value. */
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
-	if (sd->vbsd)
-		/* Stop timer */
-		sd->vbsd->timer_vb_select_and_load_kernel_exit = VbExGetTimer();
+	if (!sd->vbsd)
+		return;
+
+	/* Stop timer */
+	sd->vbsd->timer_vb_select_and_load_kernel_exit = VbExGetTimer();
+
+#if VB2_BOOT_TRACE
+	/* Pass the boot trace up to the OS, if the header has room for it */
+	if (sd->vbsd->struct_version >= 3 &&
+	    sd->vbsd->struct_size >= VB_SHARED_DATA_HEADER_SIZE_V3) {
+		sd->vbsd->trace_count = sd->trace_count;
+		memcpy(sd->vbsd->trace, sd->trace, sizeof(sd->trace));
+	}
+#endif
+
+	/* And the TPM command statistics */
+	if (sd->vbsd->struct_version >= 4 &&
+	    sd->vbsd->struct_size >= VB_SHARED_DATA_HEADER_SIZE_V4) {
+		uint32_t count;
+		const struct vb2_tpm_stat *stats = TlclGetStats(&count);
+
+		sd->vbsd->tpm_stats_count = count;
+		memcpy(sd->vbsd->tpm_stats, stats, count * sizeof(*stats));
+	}
+
+	/* And the disk reads LoadKernel() made */
+	if (sd->vbsd->struct_version >= 5 &&
+	    sd->vbsd->struct_size >= VB_SHARED_DATA_HEADER_SIZE_V5) {
+		uint32_t count, dropped;
+		const struct vb2_disk_read *reads =
+			VbDiskReadGetTrace(&count, &dropped);
+
+		sd->vbsd->disk_reads_count = count;
+		sd->vbsd->disk_reads_dropped = dropped;
+		memcpy(sd->vbsd->disk_reads, reads, count * sizeof(*reads));
+	}
+
+	/* And what each verification step cost */
+	if (sd->vbsd->struct_version >= 6 &&
+	    sd->vbsd->struct_size >= VB_SHARED_DATA_HEADER_SIZE_V6)
+		memcpy(sd->vbsd->costs, sd->costs, sizeof(sd->costs));
 }
 
 VbError_t VbSelectAndLoadKernel(
@@ -390,6 +609,8 @@ VbError_t VbSelectAndLoadKernel(
 	VbSharedDataHeader *shared,
 	VbSelectAndLoadKernelParams *kparams)
 {
+	vb2ex_timestamp(VB2_TS_SELECT_AND_LOAD_KERNEL_START);
+
 	VbError_t retval = vb2_kernel_setup(ctx, shared, kparams);
 	if (retval)
 		goto VbSelectAndLoadKernel_exit;
@@ -402,6 +623,7 @@ VbError_t VbSelectAndLoadKernel(
 		retval = ec_sync_all(ctx);
 		if (retval)
 			goto VbSelectAndLoadKernel_exit;
+		vb2ex_timestamp(VB2_TS_EC_SYNC_DONE);
 	}
 
 	/* Select boot path */
@@ -452,15 +674,17 @@ VbError_t VbSelectAndLoadKernel(
 
 	vb2_kernel_cleanup(ctx);
 
+	vb2ex_timestamp(VB2_TS_SELECT_AND_LOAD_KERNEL_END);
+
 	/* Pass through return value from boot path */
 	VB2_DEBUG("Returning %d\n", (int)retval);
 	return retval;
 }
 
-VbError_t VbVerifyMemoryBootImage(
+VbError_t VbVerifyMemoryBootImageStart(
 	struct vb2_context *ctx, VbSharedDataHeader *shared,
 	VbSelectAndLoadKernelParams *kparams, void *boot_image,
-	size_t image_size)
+	size_t image_size, size_t received)
 {
 	struct vb2_packed_key *kernel_subkey = NULL;
 	uint8_t *kbuf;
@@ -474,6 +698,8 @@ VbError_t VbVerifyMemoryBootImage(
 	VbError_t retval;
 	int rv;
 
+	memset(&mem_boot, 0, sizeof(mem_boot));
+
 	/* Allocate work buffer */
 	vb2_workbuf_from_ctx(ctx, &wb);
 
@@ -483,7 +709,8 @@ VbError_t VbVerifyMemoryBootImage(
 
 	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
 
-	if ((boot_image == NULL) || (image_size == 0)) {
+	if ((boot_image == NULL) || (image_size == 0) ||
+	    (received > image_size)) {
 		retval = VBERROR_INVALID_PARAMETER;
 		goto fail;
 	}
@@ -528,7 +755,7 @@ VbError_t VbVerifyMemoryBootImage(
 	struct vb2_keyblock *keyblock2 = (struct vb2_keyblock *)kbuf;
 	rv = VB2_SUCCESS;
 	if (hash_only) {
-		rv = vb2_verify_keyblock_hash(keyblock2, image_size, &wb);
+		rv = vb2_verify_keyblock_hash(keyblock2, received, &wb);
 	} else {
 		/* Unpack kernel subkey */
 		struct vb2_public_key kernel_subkey2;
@@ -537,7 +764,7 @@ VbError_t VbVerifyMemoryBootImage(
 			VB2_DEBUG("Unable to unpack kernel subkey\n");
 			goto fail;
 		}
-		rv = vb2_verify_keyblock(keyblock2, image_size,
+		rv = vb2_verify_keyblock(keyblock2, received,
 					 &kernel_subkey2, &wb);
 	}
 
@@ -562,8 +789,8 @@ VbError_t VbVerifyMemoryBootImage(
 	}
 
 	/* Get key for preamble/data verification from the key block. */
-	struct vb2_public_key data_key2;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key2, &keyblock2->data_key)) {
+	struct vb2_public_key *data_key2 = &mem_boot.data_key;
+	if (VB2_SUCCESS != vb2_unpack_key(data_key2, &keyblock2->data_key)) {
 		VB2_DEBUG("Unable to unpack kernel data key\n");
 		goto fail;
 	}
@@ -576,43 +803,192 @@ VbError_t VbVerifyMemoryBootImage(
 
 	if (VB2_SUCCESS != vb2_verify_kernel_preamble(
 			preamble2,
-			image_size - key_block->key_block_size,
-			&data_key2,
+			received - key_block->key_block_size,
+			data_key2,
 			&wb)) {
 		VB2_DEBUG("Preamble verification failed.\n");
 		goto fail;
 	}
 
 	VB2_DEBUG("Kernel preamble is good.\n");
+	data_key2->allow_hwcrypto = !(vb2_kernel_get_flags(preamble2) &
+				      VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO);
 
-	/* Verify kernel data */
+	/*
+	 * The body is booted where it is in the image, so there's nowhere to
+	 * decompress it to.
+	 */
+	if (vb2_kernel_get_body_compression(preamble2) !=
+	    VB2_KERNEL_COMPRESSION_NONE) {
+		VB2_DEBUG("Can't boot a compressed kernel from memory.\n");
+		goto fail;
+	}
+
+	/* The body has to fit in the image, after the vblock */
 	body_offset = key_block->key_block_size + preamble->preamble_size;
-	if (VB2_SUCCESS != vb2_verify_data(
-			(const uint8_t *)(kbuf + body_offset),
-			image_size - body_offset,
-			(struct vb2_signature *)&preamble->body_signature,
-			&data_key2, &wb)) {
-		VB2_DEBUG("Kernel data verification failed.\n");
+	if (body_offset > received ||
+	    preamble2->body_signature.data_size > image_size - body_offset) {
+		VB2_DEBUG("Kernel body doesn't fit in the image.\n");
 		goto fail;
 	}
 
-	VB2_DEBUG("Kernel is good.\n");
+	if (!vb2_kernel_get_body_chunk_size(preamble2) &&
+	    VB2_SUCCESS != vb2_digest_init(&mem_boot.dc,
+					   data_key2->hash_alg)) {
+		VB2_DEBUG("Can't hash kernel data.\n");
+		goto fail;
+	}
 
-	/* Fill in output parameters. */
-	kparams->kernel_buffer = kbuf + body_offset;
-	kparams->kernel_buffer_size = image_size - body_offset;
-	kparams->bootloader_address = preamble->bootloader_address;
-	kparams->bootloader_size = preamble->bootloader_size;
-	if (VbKernelHasFlags(preamble) == VBOOT_SUCCESS)
-		kparams->flags = preamble->flags;
+	mem_boot.image = kbuf;
+	mem_boot.image_size = image_size;
+	mem_boot.body_offset = body_offset;
+	mem_boot.preamble = preamble2;
 
-	retval = VBERROR_SUCCESS;
+	/*
+	 * Hash as much of the body as has arrived.  Anything wrong with it is
+	 * kept for VbVerifyMemoryBootImageFinish() to return.
+	 */
+	VbVerifyMemoryBootImageExtend(ctx, received);
+	return VBERROR_SUCCESS;
 
  fail:
+	memset(&mem_boot, 0, sizeof(mem_boot));
+	vb2_kernel_cleanup(ctx);
+	return retval;
+}
+
+VbError_t VbVerifyMemoryBootImageExtend(struct vb2_context *ctx,
+					size_t received)
+{
+	struct vb2_kernel_preamble *preamble = mem_boot.preamble;
+	uint32_t chunk_size, body_size, avail, n;
+	const uint8_t *body;
+
+	if (!mem_boot.image || received > mem_boot.image_size)
+		return VBERROR_INVALID_PARAMETER;
+	if (mem_boot.retval)
+		return mem_boot.retval;
+	if (received <= mem_boot.body_offset)
+		return VBERROR_SUCCESS;
+
+	body = mem_boot.image + mem_boot.body_offset;
+	body_size = preamble->body_signature.data_size;
+	avail = received - mem_boot.body_offset;
+	if (avail > body_size)
+		avail = body_size;
+
+	chunk_size = vb2_kernel_get_body_chunk_size(preamble);
+	if (!chunk_size) {
+		if (avail > mem_boot.body_hashed &&
+		    VB2_SUCCESS != vb2_digest_extend(
+				&mem_boot.dc, body + mem_boot.body_hashed,
+				avail - mem_boot.body_hashed)) {
+			mem_boot.retval = VBERROR_INVALID_KERNEL_FOUND;
+			return mem_boot.retval;
+		}
+		mem_boot.body_hashed = avail;
+		return VBERROR_SUCCESS;
+	}
+
+	/* Check each chunk once all of it is here */
+	while (mem_boot.body_hashed < avail) {
+		n = body_size - mem_boot.body_hashed;
+		if (n > chunk_size)
+			n = chunk_size;
+		if (avail - mem_boot.body_hashed < n)
+			break;
+		if (VB2_SUCCESS != vb2_kernel_check_body_chunk(
+				preamble, mem_boot.data_key.hash_alg,
+				mem_boot.body_hashed / chunk_size,
+				body + mem_boot.body_hashed, n)) {
+			VB2_DEBUG("Kernel data chunk %u is bad.\n",
+				  mem_boot.body_hashed / chunk_size);
+			mem_boot.retval = VBERROR_INVALID_KERNEL_FOUND;
+			return mem_boot.retval;
+		}
+		mem_boot.body_hashed += n;
+	}
+
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbVerifyMemoryBootImageFinish(struct vb2_context *ctx,
+					VbSelectAndLoadKernelParams *kparams)
+{
+	struct vb2_kernel_preamble *preamble2 = mem_boot.preamble;
+	VbKernelPreambleHeader *preamble =
+		(VbKernelPreambleHeader *)mem_boot.preamble;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	struct vb2_workbuf wb;
+	VbError_t retval = mem_boot.retval;
+	int rv;
+
+	if (!mem_boot.image)
+		return VBERROR_INVALID_PARAMETER;
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+
+	if (!retval &&
+	    mem_boot.body_hashed < preamble2->body_signature.data_size) {
+		VB2_DEBUG("Kernel data is incomplete.\n");
+		retval = VBERROR_INVALID_KERNEL_FOUND;
+	}
+
+	/* Verify kernel data */
+	if (!retval) {
+		if (vb2_kernel_get_body_chunk_size(preamble2)) {
+			rv = vb2_kernel_verify_body_chunks(
+				preamble2, &mem_boot.data_key, &wb);
+		} else {
+			rv = vb2_digest_finalize(
+				&mem_boot.dc, digest,
+				vb2_digest_size(mem_boot.data_key.hash_alg));
+			if (!rv)
+				rv = vb2_verify_digest(
+					&mem_boot.data_key,
+					&preamble2->body_signature,
+					digest, &wb);
+		}
+		if (VB2_SUCCESS != rv) {
+			VB2_DEBUG("Kernel data verification failed.\n");
+			retval = VBERROR_INVALID_KERNEL_FOUND;
+		}
+	}
+
+	if (!retval) {
+		VB2_DEBUG("Kernel is good.\n");
+
+		/* Fill in output parameters. */
+		kparams->kernel_buffer = mem_boot.image + mem_boot.body_offset;
+		kparams->kernel_buffer_size =
+			mem_boot.image_size - mem_boot.body_offset;
+		kparams->bootloader_address = preamble->bootloader_address;
+		kparams->bootloader_size = preamble->bootloader_size;
+		if (VbKernelHasFlags(preamble) == VBOOT_SUCCESS)
+			kparams->flags = preamble->flags;
+	}
+
+	memset(&mem_boot, 0, sizeof(mem_boot));
 	vb2_kernel_cleanup(ctx);
 	return retval;
 }
 
+VbError_t VbVerifyMemoryBootImage(
+	struct vb2_context *ctx, VbSharedDataHeader *shared,
+	VbSelectAndLoadKernelParams *kparams, void *boot_image,
+	size_t image_size)
+{
+	VbError_t retval;
+
+	retval = VbVerifyMemoryBootImageStart(ctx, shared, kparams,
+					      boot_image, image_size,
+					      image_size);
+	if (retval)
+		return retval;
+
+	return VbVerifyMemoryBootImageFinish(ctx, kparams);
+}
+
 VbError_t VbUnlockDevice(void)
 {
 	VB2_DEBUG("Enabling dev-mode...\n");
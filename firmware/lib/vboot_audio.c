@@ -19,6 +19,30 @@ int audio_open_count = 0;	/* Times audio has been opened */
 static int audio_use_short;	/* Use short delay? */
 static uint64_t open_time;	/* Time of last open */
 static int beep_count;		/* Number of beeps so far */
+static int beep_playing;	/* Beep started by VbExBeepStart()? */
+
+__attribute__((weak))
+VbError_t VbExBeepStart(uint32_t msec, uint32_t frequency)
+{
+	return VBERROR_NO_BACKGROUND_SOUND;
+}
+
+__attribute__((weak))
+void VbExBeepStop(void)
+{
+}
+
+/**
+ * Beep in the background if the firmware can, so the caller's loop keeps
+ * reading keys, or else wait for the beep to finish.
+ */
+static void vb2_audio_beep(uint32_t msec, uint32_t frequency)
+{
+	if (VBERROR_SUCCESS == VbExBeepStart(msec, frequency))
+		beep_playing = 1;
+	else
+		VbExBeep(msec, frequency);
+}
 
 /**
  * Initialization function.
@@ -27,6 +51,7 @@ void vb2_audio_start(struct vb2_context *ctx)
 {
 	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
 
+	vb2_audio_stop();
 	open_time = VbExGetTimer(); /* "zero" starts now */
 	beep_count = 0;
 
@@ -57,10 +82,18 @@ int vb2_audio_looping(void)
 	/* Otherwise, beep at 20 and 20.5 seconds */
 	if ((beep_count == 0 && now > 20000 * VB_MSEC_PER_SEC) ||
 	    (beep_count == 1 && now > 20500 * VB_MSEC_PER_SEC)) {
-		VbExBeep(250, 400);
+		vb2_audio_beep(250, 400);
 		beep_count++;
 	}
 
 	/* Stop after 30 seconds */
 	return (now < 30 * VB_USEC_PER_SEC);
 }
+
+void vb2_audio_stop(void)
+{
+	if (beep_playing) {
+		VbExBeepStop();
+		beep_playing = 0;
+	}
+}
@@ -14,6 +14,9 @@
 #include "vboot_common.h"
 #include "utility.h"
 
+BUILD_ASSERT(sizeof(VbSharedDataHeader) + VB_SHARED_DATA_MIN_ROOM <=
+	     VB_SHARED_DATA_MIN_SIZE);
+
 int VbSharedDataInit(VbSharedDataHeader *header, uint64_t size)
 {
 	VB2_DEBUG("VbSharedDataInit, %d bytes, header %d bytes\n", (int)size,
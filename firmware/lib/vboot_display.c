@@ -16,10 +16,12 @@
 #include "vboot_api.h"
 #include "vboot_common.h"
 #include "vboot_display.h"
+#include "vboot_kernel.h"
 
 static uint32_t disp_current_screen = VB_SCREEN_BLANK;
 static uint32_t disp_current_index = 0;
 static uint32_t disp_disabled_idx_mask = 0;
+static uint32_t disp_current_locale = 0;
 
 __attribute__((weak))
 VbError_t VbExGetLocalizationCount(uint32_t *count) {
@@ -56,32 +58,34 @@ VbError_t VbDisplayMenu(struct vb2_context *ctx, uint32_t screen, int force,
 	uint32_t locale;
 	uint32_t redraw_base_screen = 0;
 
-	/*
-	 * If requested screen/selected_index is the same as the current one,
-	 * we're done.
-	 */
+	/* Read the locale last saved */
+	locale = vb2_nv_get(ctx, VB2_NV_LOCALIZATION_INDEX);
+
+	/* If nothing that the menu shows has changed, we're done. */
 	if (disp_current_screen == screen &&
 	    disp_current_index == selected_index &&
+	    disp_disabled_idx_mask == disabled_idx_mask &&
+	    disp_current_locale == locale &&
 	    !force)
 		return VBERROR_SUCCESS;
 
 	/*
-	 * If current screen is not the same, make sure we redraw the base
-	 * screen as well to avoid having artifacts from the menu.
+	 * If current screen or language is not the same, make sure we redraw
+	 * the base screen as well to avoid having artifacts from the menu.
+	 * Moving the selection only needs the menu items redrawn.
 	 */
-	if (disp_current_screen != screen || force)
+	if (disp_current_screen != screen || disp_current_locale != locale ||
+	    force)
 		redraw_base_screen = 1;
 
 	/*
-	 * Keep track of the currently displayed screen and
-	 * selected_index
+	 * Keep track of the currently displayed screen,
+	 * selected_index and language
 	 */
 	disp_current_screen = screen;
 	disp_current_index = selected_index;
 	disp_disabled_idx_mask = disabled_idx_mask;
-
-	/* Read the locale last saved */
-	locale = vb2_nv_get(ctx, VB2_NV_LOCALIZATION_INDEX);
+	disp_current_locale = locale;
 
 	return VbExDisplayMenu(screen, locale, selected_index,
 			       disabled_idx_mask, redraw_base_screen);
@@ -269,32 +273,92 @@ const char *RecoveryReasonString(uint8_t code)
 
 #define DEBUG_INFO_SIZE 512
 
-VbError_t VbDisplayDebugInfo(struct vb2_context *ctx)
+/*
+ * Parts of the debug info which don't change until reboot: the HWID, and the
+ * key digests, which take reading the keys from the GBB and hashing them.
+ * They're filled in the first time the debug info is shown for a context.
+ */
+static struct {
+	const struct vb2_context *ctx;
+	char hwid[VB2_GBB_HWID_MAX_SIZE];
+	char keys[sizeof("\ngbb.rootkey: \ngbb.recovery_key: \nkernel_subkey: ")
+		  + 3 * VB2_SHA1_DIGEST_SIZE * 2];
+} debug_info_cache;
+
+static void FillInDebugInfoCache(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
-	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
-	struct vb2_workbuf wb;
 	VbSharedDataHeader *shared = sd->vbsd;
-	char buf[DEBUG_INFO_SIZE] = "";
+	char *keys = debug_info_cache.keys;
+	const uint32_t keys_size = sizeof(debug_info_cache.keys);
 	char sha1sum[VB2_SHA1_DIGEST_SIZE * 2 + 1];
+	struct vb2_workbuf wb;
 	uint32_t used = 0;
+	uint32_t size = sizeof(debug_info_cache.hwid);
 	int ret;
-	uint32_t i;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
 
-	/* Add hardware ID */
+	ret = vb2api_gbb_read_hwid(ctx, debug_info_cache.hwid, &size);
+	if (ret)
+		strcpy(debug_info_cache.hwid, "{INVALID}");
+
+	/* Add sha1sum for Root & Recovery keys */
+	*keys = '\0';
+	{
+		struct vb2_packed_key *key;
+		struct vb2_workbuf wblocal = wb;
+		ret = vb2_gbb_read_root_key(ctx, &key, NULL, &wblocal);
+		if (!ret) {
+			FillInSha1Sum(sha1sum, (VbPublicKey *)key);
+			used += StrnAppend(keys + used, "\ngbb.rootkey: ",
+					   keys_size - used);
+			used += StrnAppend(keys + used, sha1sum,
+					   keys_size - used);
+		}
+	}
+
 	{
-		char hwid[VB2_GBB_HWID_MAX_SIZE];
-		uint32_t size = sizeof(hwid);
-		ret = vb2api_gbb_read_hwid(ctx, hwid, &size);
-		if (ret)
-			strcpy(hwid, "{INVALID}");
-		used += StrnAppend(buf + used, "HWID: ",
-				   DEBUG_INFO_SIZE - used);
-		used += StrnAppend(buf + used, hwid, DEBUG_INFO_SIZE - used);
+		struct vb2_packed_key *key;
+		struct vb2_workbuf wblocal = wb;
+		ret = vb2_gbb_read_recovery_key(ctx, &key, NULL, &wblocal);
+		if (!ret) {
+			FillInSha1Sum(sha1sum, (VbPublicKey *)key);
+			used += StrnAppend(keys + used, "\ngbb.recovery_key: ",
+					   keys_size - used);
+			used += StrnAppend(keys + used, sha1sum,
+					   keys_size - used);
+		}
+	}
+
+	/* If we're in dev-mode, show the kernel subkey that we expect, too. */
+	if (0 == shared->recovery_reason) {
+		FillInSha1Sum(sha1sum, &shared->kernel_subkey);
+		used += StrnAppend(keys + used,
+				"\nkernel_subkey: ", keys_size - used);
+		used += StrnAppend(keys + used, sha1sum, keys_size - used);
 	}
 
+	debug_info_cache.ctx = ctx;
+}
+
+VbError_t VbDisplayDebugInfo(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
+	VbSharedDataHeader *shared = sd->vbsd;
+	char buf[DEBUG_INFO_SIZE] = "";
+	uint32_t used = 0;
+	uint32_t i;
+
+	if (debug_info_cache.ctx != ctx)
+		FillInDebugInfoCache(ctx);
+
+	/* Add hardware ID */
+	used += StrnAppend(buf + used, "HWID: ", DEBUG_INFO_SIZE - used);
+	used += StrnAppend(buf + used, debug_info_cache.hwid,
+			   DEBUG_INFO_SIZE - used);
+
 	/* Add recovery reason and subcode */
 	i = vb2_nv_get(ctx, VB2_NV_RECOVERY_SUBCODE);
 	used += StrnAppend(buf + used,
@@ -365,40 +429,9 @@ VbError_t VbDisplayDebugInfo(struct vb2_context *ctx)
 	used += Uint64ToString(buf + used, DEBUG_INFO_SIZE - used,
 			       gbb->flags, 16, 8);
 
-	/* Add sha1sum for Root & Recovery keys */
-	{
-		struct vb2_packed_key *key;
-		struct vb2_workbuf wblocal = wb;
-		ret = vb2_gbb_read_root_key(ctx, &key, NULL, &wblocal);
-		if (!ret) {
-			FillInSha1Sum(sha1sum, (VbPublicKey *)key);
-			used += StrnAppend(buf + used, "\ngbb.rootkey: ",
-					   DEBUG_INFO_SIZE - used);
-			used += StrnAppend(buf + used, sha1sum,
-					   DEBUG_INFO_SIZE - used);
-		}
-	}
-
-	{
-		struct vb2_packed_key *key;
-		struct vb2_workbuf wblocal = wb;
-		ret = vb2_gbb_read_recovery_key(ctx, &key, NULL, &wblocal);
-		if (!ret) {
-			FillInSha1Sum(sha1sum, (VbPublicKey *)key);
-			used += StrnAppend(buf + used, "\ngbb.recovery_key: ",
-					   DEBUG_INFO_SIZE - used);
-			used += StrnAppend(buf + used, sha1sum,
-					   DEBUG_INFO_SIZE - used);
-		}
-	}
-
-	/* If we're in dev-mode, show the kernel subkey that we expect, too. */
-	if (0 == shared->recovery_reason) {
-		FillInSha1Sum(sha1sum, &shared->kernel_subkey);
-		used += StrnAppend(buf + used,
-				"\nkernel_subkey: ", DEBUG_INFO_SIZE - used);
-		used += StrnAppend(buf + used, sha1sum, DEBUG_INFO_SIZE - used);
-	}
+	/* Add sha1sums of the keys */
+	used += StrnAppend(buf + used, debug_info_cache.keys,
+			   DEBUG_INFO_SIZE - used);
 
 	/* Make sure we finish with a newline */
 	used += StrnAppend(buf + used, "\n", DEBUG_INFO_SIZE - used);
@@ -436,6 +469,9 @@ VbError_t VbCheckDisplayKey(struct vb2_context *ctx, uint32_t key,
 			loc = (loc < count - 1 ? loc + 1 : 0);
 		else
 			loc = (loc > 0 ? loc - 1 : count - 1);
+		/* With one language there's nothing to change or redraw */
+		if (loc == vb2_nv_get(ctx, VB2_NV_LOCALIZATION_INDEX))
+			return VBERROR_SUCCESS;
 		VB2_DEBUG("VbCheckDisplayKey() - change localization to %d\n",
 			  (int)loc);
 		vb2_nv_set(ctx, VB2_NV_LOCALIZATION_INDEX, loc);
@@ -448,10 +484,7 @@ VbError_t VbCheckDisplayKey(struct vb2_context *ctx, uint32_t key,
 		 * This is not an example of the Right Way to do things.  See
 		 * chrome-os-partner:7689.
 		 */
-		if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
-			VbExNvStorageWrite(ctx.nvdata);
-			ctx.flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
-		}
+		vb2_nv_commit(ctx);
 #endif
 
 		/* Force redraw of current screen */
@@ -10,10 +10,12 @@
 #include "2sysincludes.h"
 
 #include "2common.h"
+#include "2lz4.h"
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "2trace.h"
 #include "cgptlib.h"
 #include "cgptlib_internal.h"
 #include "gpt_misc.h"
@@ -33,6 +35,59 @@ enum vboot_mode {
 	kBootDev = 2        /* Developer boot - self-signed kernel ok */
 };
 
+__attribute__((weak))
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer)
+{
+	return VbExStreamRead(stream, bytes, buffer);
+}
+
+__attribute__((weak))
+VbError_t VbExStreamWait(VbExStream_t stream)
+{
+	return VBERROR_SUCCESS;
+}
+
+/* Position of the partition stream being read, for the disk read trace */
+static uint64_t trace_next_lba;
+static uint64_t trace_sector_bytes;
+
+/**
+ * Note that a partition stream has been opened, for the disk read trace.
+ *
+ * @param params	Load kernel parameters
+ * @param part_start	First sector of the partition
+ */
+static void trace_stream_open(const LoadKernelParams *params,
+			      uint64_t part_start)
+{
+	trace_next_lba = part_start;
+	trace_sector_bytes = params->bytes_per_lba;
+}
+
+/**
+ * Record a read from the partition stream in the disk read trace.
+ *
+ * Reads made on another core, where the context has no work buffer of its
+ * own, aren't recorded, so the trace is only ever touched from one core.
+ *
+ * @param ctx		Vboot context
+ * @param bytes		Number of bytes read from the stream
+ * @param purpose	What the read was for (enum vb2_disk_read_purpose)
+ */
+static void trace_stream_read(const struct vb2_context *ctx, uint32_t bytes,
+			      uint32_t purpose)
+{
+	uint64_t sectors;
+
+	if (!ctx->workbuf_used || !trace_sector_bytes)
+		return;
+
+	sectors = (bytes + trace_sector_bytes - 1) / trace_sector_bytes;
+	VbDiskReadRecord(trace_next_lba, sectors, purpose);
+	trace_next_lba += sectors;
+}
+
 /**
  * Return the boot mode based on the parameters.
  *
@@ -113,15 +168,203 @@ static uint32_t get_body_offset(uint8_t *kbuf)
 		get_preamble(kbuf)->preamble_size);
 }
 
+/* Number of verified vblocks remembered during one LoadKernel() call */
+#define VBLOCK_CACHE_ENTRIES 4
+
+/*
+ * SHA-256 digests of vblocks whose keyblock and preamble signatures have
+ * already been verified with the kernel subkey.  A/B kernel partitions usually
+ * carry byte-identical vblocks, so this lets the second one skip the RSA
+ * operations.
+ */
+struct vblock_cache {
+	uint32_t count;
+	uint8_t digest[VBLOCK_CACHE_ENTRIES][VB2_SHA256_DIGEST_SIZE];
+};
+
+/**
+ * Calculate the digest of the keyblock and preamble in a vblock.
+ *
+ * This is called before the vblock is verified, since verification destroys
+ * the signatures, so the sizes in the headers are only checked against kbuf.
+ *
+ * @param kbuf		Buffer containing vblock
+ * @param kbuf_size	Size of the buffer in bytes
+ * @param digest	Destination for the SHA-256 digest
+ * @return VB2_SUCCESS, or non-zero if the vblock doesn't fit in kbuf.
+ */
+static int calc_vblock_digest(const uint8_t *kbuf, uint32_t kbuf_size,
+			      uint8_t *digest)
+{
+	const struct vb2_keyblock *keyblock =
+			(const struct vb2_keyblock *)kbuf;
+	const struct vb2_kernel_preamble *preamble;
+	uint32_t keyblock_size = keyblock->keyblock_size;
+	struct vb2_digest_context dc;
+	int rv;
+
+	if (keyblock_size < sizeof(*keyblock) ||
+	    keyblock_size > kbuf_size - sizeof(*preamble))
+		return VB2_ERROR_UNKNOWN;
+
+	preamble = (const struct vb2_kernel_preamble *)(kbuf + keyblock_size);
+	if (preamble->preamble_size < sizeof(*preamble) ||
+	    preamble->preamble_size > kbuf_size - keyblock_size)
+		return VB2_ERROR_UNKNOWN;
+
+	rv = vb2_digest_init(&dc, VB2_HASH_SHA256);
+	if (!rv)
+		rv = vb2_digest_extend(&dc, kbuf, keyblock_size);
+	if (!rv)
+		rv = vb2_digest_extend(&dc, (const uint8_t *)preamble,
+				       preamble->preamble_size);
+	if (!rv)
+		rv = vb2_digest_finalize(&dc, digest, VB2_SHA256_DIGEST_SIZE);
+	return rv;
+}
+
+/**
+ * Check if a vblock digest is in the cache.
+ *
+ * @return 1 if the vblock has already been verified, 0 if not.
+ */
+static int vblock_cache_find(const struct vblock_cache *cache,
+			     const uint8_t *digest)
+{
+	uint32_t i, count;
+
+	count = cache->count < VBLOCK_CACHE_ENTRIES ?
+			cache->count : VBLOCK_CACHE_ENTRIES;
+	for (i = 0; i < count; i++) {
+		if (!vb2_safe_memcmp(cache->digest[i], digest,
+				     VB2_SHA256_DIGEST_SIZE))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Add a verified vblock digest to the cache, replacing the oldest entry if
+ * the cache is full.
+ */
+static void vblock_cache_add(struct vblock_cache *cache, const uint8_t *digest)
+{
+	memcpy(cache->digest[cache->count++ % VBLOCK_CACHE_ENTRIES], digest,
+	       VB2_SHA256_DIGEST_SIZE);
+}
+
+/**
+ * Check a keyblock's flags and key version against the boot mode, without
+ * looking at its signature.
+ *
+ * @return The VBSD_LKP_CHECK_* reason the keyblock can't be valid, or
+ * VBSD_LKP_CHECK_NOT_DONE if it may be.
+ */
+static uint8_t keyblock_unusable(struct vb2_context *ctx,
+				 const struct vb2_keyblock *keyblock,
+				 uint32_t min_version)
+{
+	uint32_t key_version = keyblock->data_key.key_version;
+
+	if (!(keyblock->keyblock_flags &
+	      ((ctx->flags & VB2_CONTEXT_DEVELOPER_MODE) ?
+	       KEY_BLOCK_FLAG_DEVELOPER_1 : KEY_BLOCK_FLAG_DEVELOPER_0)))
+		return VBSD_LKP_CHECK_DEV_MISMATCH;
+	if (!(keyblock->keyblock_flags &
+	      ((ctx->flags & VB2_CONTEXT_RECOVERY_MODE) ?
+	       KEY_BLOCK_FLAG_RECOVERY_1 : KEY_BLOCK_FLAG_RECOVERY_0)))
+		return VBSD_LKP_CHECK_REC_MISMATCH;
+	if (kBootRecovery != get_kernel_boot_mode(ctx) &&
+	    (key_version < (min_version >> 16) || key_version > 0xFFFF))
+		return VBSD_LKP_CHECK_KEY_ROLLBACK;
+
+	return VBSD_LKP_CHECK_NOT_DONE;
+}
+
+/**
+ * Reject a vblock which can't be used in this boot mode, before spending any
+ * time on its hashes and signatures.
+ *
+ * Nothing in the vblock has been verified yet.  That's fine for rejecting it,
+ * since a vblock with good signatures has the same bytes and would be
+ * rejected by vb2_verify_kernel_vblock() later anyway.  Checks which only make
+ * the keyblock invalid in developer mode are left for later, since the kernel
+ * can still be booted.
+ *
+ * @param kbuf		Buffer containing the vblock
+ * @param kbuf_size	Size of the buffer in bytes
+ * @param min_version	Minimum kernel version
+ * @param shpart	Destination for the reason the vblock was rejected
+ * @return VB2_SUCCESS if the vblock needs verifying, or non-zero error code.
+ */
+static int vblock_early_reject(struct vb2_context *ctx,
+			       const uint8_t *kbuf,
+			       uint32_t kbuf_size,
+			       uint32_t min_version,
+			       VbSharedDataKernelPart *shpart)
+{
+	const struct vb2_keyblock *keyblock =
+			(const struct vb2_keyblock *)kbuf;
+	const struct vb2_kernel_preamble *preamble;
+	enum vboot_mode boot_mode = get_kernel_boot_mode(ctx);
+	uint32_t algorithm, combined_version;
+	uint8_t reason;
+
+	/* Leave anything too small to vb2_verify_keyblock() */
+	if (kbuf_size < sizeof(*keyblock))
+		return VB2_SUCCESS;
+
+	/* The data key is unpacked in every boot mode */
+	algorithm = keyblock->data_key.algorithm;
+	if (vb2_crypto_to_signature(algorithm) == VB2_SIG_INVALID ||
+	    vb2_crypto_to_hash(algorithm) == VB2_HASH_INVALID) {
+		VB2_DEBUG("Unsupported kernel data key algorithm.\n");
+		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	if (kBootDev == boot_mode)
+		return VB2_SUCCESS;
+
+	reason = keyblock_unusable(ctx, keyblock, min_version);
+	if (reason != VBSD_LKP_CHECK_NOT_DONE) {
+		VB2_DEBUG("Key block can't be valid in this boot mode.\n");
+		shpart->check_result = reason;
+		return VB2_ERROR_VBLOCK_KEYBLOCK;
+	}
+
+	if (kBootRecovery == boot_mode ||
+	    keyblock->keyblock_size < sizeof(*keyblock) ||
+	    keyblock->keyblock_size > kbuf_size - sizeof(*preamble))
+		return VB2_SUCCESS;
+
+	preamble = (const struct vb2_kernel_preamble *)
+			(kbuf + keyblock->keyblock_size);
+	combined_version = (keyblock->data_key.key_version << 16) |
+			(preamble->kernel_version & 0xFFFF);
+	if (combined_version < min_version) {
+		VB2_DEBUG("Kernel version too low.\n");
+		shpart->check_result = VBSD_LKP_CHECK_KERNEL_ROLLBACK;
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	return VB2_SUCCESS;
+}
+
 /**
  * Verify a kernel vblock.
  *
  * @param kbuf		Buffer containing the vblock
  * @param kbuf_size	Size of the buffer in bytes
- * @param kernel_subkey	Packed kernel subkey to use in validating keyblock
+ * @param kernel_subkey	Unpacked kernel subkey to use in validating keyblock,
+ *			or NULL if the packed key could not be unpacked
  * @param params	Load kernel parameters
  * @param min_version	Minimum kernel version
  * @param shpart	Destination for verification results
+ * @param data_key	Destination for the unpacked data key from the
+ *			keyblock, which points into kbuf
+ * @param cache		Vblocks already verified with kernel_subkey; updated
+ *			if this one is newly verified
  * @param wb		Work buffer.  Must be at least
  *			VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES bytes.
  * @return VB2_SUCCESS, or non-zero error code.
@@ -129,27 +372,83 @@ static uint32_t get_body_offset(uint8_t *kbuf)
 static int vb2_verify_kernel_vblock(struct vb2_context *ctx,
 				    uint8_t *kbuf,
 				    uint32_t kbuf_size,
-				    const struct vb2_packed_key *kernel_subkey,
+				    const struct vb2_public_key *kernel_subkey,
 				    const LoadKernelParams *params,
 				    uint32_t min_version,
 				    VbSharedDataKernelPart *shpart,
+				    struct vb2_public_key *data_key,
+				    struct vblock_cache *cache,
 				    struct vb2_workbuf *wb)
 {
-	/* Unpack kernel subkey */
-	struct vb2_public_key kernel_subkey2;
-	if (VB2_SUCCESS != vb2_unpack_key(&kernel_subkey2, kernel_subkey)) {
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_KERNEL_VBLOCK);
+
+	if (!kernel_subkey) {
 		VB2_DEBUG("Unable to unpack kernel subkey\n");
 		return VB2_ERROR_VBLOCK_KERNEL_SUBKEY;
 	}
 
+	/* Get stale and corrupt vblocks out of the way cheaply */
+	vb2_trace(ctx, VB2_TRACE_VBLOCK_EARLY_CHECK, VB2_TRACE_BEGIN);
+	int rv = vblock_early_reject(ctx, kbuf, kbuf_size, min_version,
+				     shpart);
+	vb2_trace(ctx, VB2_TRACE_VBLOCK_EARLY_CHECK, VB2_TRACE_END);
+	if (VB2_SUCCESS != rv) {
+		shpart->flags |= VBSD_LKP_FLAG_EARLY_REJECT;
+		return rv;
+	}
+
+	/*
+	 * If an identical vblock has already been verified, its signatures
+	 * don't need to be checked again.  Everything else still is, since
+	 * that depends on the boot mode and versions rather than the bytes.
+	 */
+	uint8_t vblock_digest[VB2_SHA256_DIGEST_SIZE];
+	int have_digest = (VB2_SUCCESS ==
+			   calc_vblock_digest(kbuf, kbuf_size, vblock_digest));
+	int cached = have_digest && vblock_cache_find(cache, vblock_digest);
+	if (cached)
+		VB2_DEBUG("Vblock signatures already verified.\n");
+
 	/* Verify the key block. */
 	int keyblock_valid = 1;  /* Assume valid */
+	int keyblock_signed = 1;
 	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
-	if (VB2_SUCCESS != vb2_verify_keyblock(keyblock, kbuf_size,
-					       &kernel_subkey2, wb)) {
+
+	/*
+	 * If self-signed kernels are allowed and the key block can't be valid
+	 * anyway, its signature makes no difference, so check its hash first
+	 * and skip the RSA verification.  The signature is still checked if
+	 * the hash doesn't match, so the same key blocks are accepted.
+	 */
+	int hash_only = !cached && kbuf_size >= sizeof(*keyblock) &&
+		!require_official_os(ctx, params) &&
+		keyblock_unusable(ctx, keyblock, min_version) !=
+		VBSD_LKP_CHECK_NOT_DONE;
+	if (hash_only) {
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_HASH, VB2_TRACE_BEGIN);
+		rv = vb2_verify_keyblock_hash(keyblock, kbuf_size, wb);
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_HASH, VB2_TRACE_END);
+		if (VB2_SUCCESS == rv) {
+			VB2_DEBUG("Key block checked by hash only.\n");
+			shpart->flags |= VBSD_LKP_FLAG_KEY_BLOCK_HASH_ONLY;
+			keyblock_valid = 0;
+			keyblock_signed = 0;
+		} else {
+			hash_only = 0;
+		}
+	}
+
+	if (!cached && !hash_only) {
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_BEGIN);
+		rv = vb2_verify_keyblock(keyblock, kbuf_size, kernel_subkey,
+					 wb);
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_END);
+	}
+	if (VB2_SUCCESS != rv) {
 		VB2_DEBUG("Verifying key block signature failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_KEY_BLOCK_SIG;
 		keyblock_valid = 0;
+		keyblock_signed = 0;
 
 		/* Check if we must have an officially signed kernel */
 		if (require_official_os(ctx, params)) {
@@ -159,8 +458,10 @@ static int vb2_verify_kernel_vblock(struct vb2_context *ctx,
 		}
 
 		/* Otherwise, allow the kernel if the key block hash is valid */
-		if (VB2_SUCCESS !=
-		    vb2_verify_keyblock_hash(keyblock, kbuf_size, wb)) {
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_HASH, VB2_TRACE_BEGIN);
+		rv = vb2_verify_keyblock_hash(keyblock, kbuf_size, wb);
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_HASH, VB2_TRACE_END);
+		if (VB2_SUCCESS != rv) {
 			VB2_DEBUG("Verifying key block hash failed.\n");
 			shpart->check_result = VBSD_LKP_CHECK_KEY_BLOCK_HASH;
 			return VB2_ERROR_VBLOCK_KEYBLOCK_HASH;
@@ -239,9 +540,11 @@ static int vb2_verify_kernel_vblock(struct vb2_context *ctx,
 		}
 	}
 
-	/* Get key for preamble verification from the key block. */
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
+	/*
+	 * Get key for preamble verification from the key block.  The caller
+	 * uses the same key for the body.
+	 */
+	if (VB2_SUCCESS != vb2_unpack_key(data_key, &keyblock->data_key)) {
 		VB2_DEBUG("Unable to unpack kernel data key\n");
 		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
 		return VB2_ERROR_UNKNOWN;
@@ -249,16 +552,27 @@ static int vb2_verify_kernel_vblock(struct vb2_context *ctx,
 
 	/* Verify the preamble, which follows the key block */
 	struct vb2_kernel_preamble *preamble = get_preamble(kbuf);
-	if (VB2_SUCCESS !=
-	    vb2_verify_kernel_preamble(preamble,
-				       kbuf_size - keyblock->keyblock_size,
-				       &data_key,
-				       wb)) {
-		VB2_DEBUG("Preamble verification failed.\n");
-		shpart->check_result = VBSD_LKP_CHECK_VERIFY_PREAMBLE;
-		return VB2_ERROR_UNKNOWN;
+	if (!cached) {
+		vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_BEGIN);
+		rv = vb2_verify_kernel_preamble(
+				preamble, kbuf_size - keyblock->keyblock_size,
+				data_key, wb);
+		vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_END);
+		if (VB2_SUCCESS != rv) {
+			VB2_DEBUG("Preamble verification failed.\n");
+			shpart->check_result = VBSD_LKP_CHECK_VERIFY_PREAMBLE;
+			return VB2_ERROR_UNKNOWN;
+		}
+
+		/* Only remember vblocks signed by the kernel subkey */
+		if (have_digest && keyblock_signed)
+			vblock_cache_add(cache, vblock_digest);
 	}
 
+	/* The preamble is trusted now, so it can allow HW crypto for the body */
+	data_key->allow_hwcrypto = !(vb2_kernel_get_flags(preamble) &
+				     VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO);
+
 	/*
 	 * If the key block is valid and we're not in recovery mode, check for
 	 * rollback of the kernel version.
@@ -292,44 +606,402 @@ enum vb2_load_partition_flags {
 	VB2_LOAD_PARTITION_VBLOCK_ONLY = (1 << 0),
 };
 
-#define KBUF_SIZE 65536  /* Bytes to read at start of kernel partition */
+/**
+ * Return the number of bytes to read at the start of a kernel partition.
+ *
+ * @param params	Load kernel parameters
+ * @return The size of the vblock buffer in bytes.
+ */
+static uint32_t get_kbuf_size(const LoadKernelParams *params)
+{
+	uint32_t size = params->vblock_read_size;
+
+	if (params->bytes_per_lba)
+		size -= size % params->bytes_per_lba;
+	return size ? size : VB2_KERNEL_VBLOCK_READ_SIZE;
+}
 
 /* Minimum context work buffer size needed for vb2_load_partition() */
-#define VB2_LOAD_PARTITION_WORKBUF_BYTES	\
-	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + KBUF_SIZE)
+#define VB2_LOAD_PARTITION_WORKBUF_BYTES(kbuf_size)	\
+	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + (kbuf_size))
+
+/*
+ * Verification of the next candidate partition's vblock, run on another core
+ * by vb2ex_parallel_start() while the current kernel body loads.  The job only
+ * writes to this struct and its own workbuf, and the results are picked up
+ * when LoadKernel() gets to that partition, so the order partitions are
+ * considered in is unchanged.
+ */
+struct vblock_prefetch {
+	/* Inputs, set once by LoadKernel() */
+	const struct vb2_public_key *kernel_subkey;
+	LoadKernelParams *params;
+	uint32_t min_version;
+	const GptData *gpt;
+
+	/* Next partition after the one being loaded; shpart gets results */
+	uint64_t part_start;
+	uint64_t part_size;
+	VbSharedDataKernelPart shpart;
+
+	/* Private copies of the caller's state, for the job */
+	struct vb2_context ctx;
+	struct vblock_cache cache;
+	struct vb2_workbuf wb;
+
+	/* Job handle, or NULL if not running */
+	void *job;
+	int rv;
+};
+
+static int vb2_load_partition(struct vb2_context *ctx,
+			      VbExStream_t stream,
+			      const struct vb2_public_key *kernel_subkey,
+			      uint32_t flags,
+			      LoadKernelParams *params,
+			      uint32_t min_version,
+			      VbSharedDataKernelPart *shpart,
+			      struct vblock_cache *cache,
+			      struct vblock_prefetch *prefetch,
+			      struct vb2_workbuf *wb);
+
+static void vblock_prefetch_job(void *arg)
+{
+	struct vblock_prefetch *p = arg;
+	VbExStream_t stream = NULL;
+
+	if (VbExStreamOpen(p->params->disk_handle, p->part_start,
+			   p->part_size, &stream)) {
+		VB2_DEBUG("Partition error getting stream.\n");
+		p->shpart.check_result = VBSD_LKP_CHECK_TOO_SMALL;
+		p->rv = VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
+		return;
+	}
+
+	p->rv = vb2_load_partition(&p->ctx, stream, p->kernel_subkey,
+				   VB2_LOAD_PARTITION_VBLOCK_ONLY, p->params,
+				   p->min_version, &p->shpart, &p->cache, NULL,
+				   &p->wb);
+	VbExStreamClose(stream);
+}
+
+/**
+ * Start verifying the vblock of the partition after the current one in the
+ * GPT on another core, if the platform supports it and there is enough work
+ * buffer.
+ *
+ * @param ctx		Vboot context
+ * @param p		Prefetch state
+ * @param cache		Vblocks already verified
+ * @param wb		Work buffer to allocate the job's buffer from.  It
+ *			must stay allocated until vblock_prefetch_wait().
+ */
+static void vblock_prefetch_start(struct vb2_context *ctx,
+				  struct vblock_prefetch *p,
+				  const struct vblock_cache *cache,
+				  struct vb2_workbuf *wb)
+{
+	uint32_t buf_size =
+		VB2_LOAD_PARTITION_WORKBUF_BYTES(get_kbuf_size(p->params));
+	uint8_t *buf = vb2_workbuf_alloc(wb, buf_size);
+	if (!buf) {
+		VB2_DEBUG("No workbuf to verify next vblock in parallel.\n");
+		return;
+	}
+
+	/* Look ahead on a copy, so LoadKernel()'s iteration is unchanged */
+	GptData next = *p->gpt;
+	if (GPT_SUCCESS !=
+	    GptNextKernelEntry(&next, &p->part_start, &p->part_size)) {
+		vb2_workbuf_free(wb, buf_size);
+		return;
+	}
+	memset(&p->shpart, 0, sizeof(p->shpart));
+	p->shpart.sector_start = p->part_start;
+	p->shpart.sector_count = p->part_size;
+	p->shpart.gpt_index = (uint8_t)(next.current_kernel + 1);
+
+	/*
+	 * The boot trace isn't safe to write from two cores, so the job's
+	 * context has no shared data to trace into.
+	 */
+	p->ctx = *ctx;
+	p->ctx.workbuf_used = 0;
+	p->cache = *cache;
+	vb2_workbuf_init(&p->wb, buf, buf_size);
+
+	if (VB2_SUCCESS !=
+	    vb2ex_parallel_start(vblock_prefetch_job, p, &p->job)) {
+		p->job = NULL;
+		vb2_workbuf_free(wb, buf_size);
+	}
+}
+
+/**
+ * Wait for a prefetch job, if one is running.
+ *
+ * @param p		Prefetch state
+ * @return 1 if a job finished, 0 if none was running.
+ */
+static int vblock_prefetch_wait(struct vblock_prefetch *p)
+{
+	if (!p->job)
+		return 0;
+
+	vb2ex_parallel_wait(p->job);
+	p->job = NULL;
+	return 1;
+}
+
+/**
+ * Check the chunks of a kernel body hashed in chunks which have fully arrived.
+ *
+ * @param preamble	Kernel preamble with a table of body chunk digests
+ * @param hash_alg	Hash algorithm of the data key
+ * @param body		Kernel body buffer
+ * @param checked	Bytes at the start of body already checked; updated
+ * @param done		Bytes at the start of body which have been read
+ * @return VB2_SUCCESS, or non-zero error code if a chunk did not verify.
+ */
+static int vb2_check_body_chunks(const struct vb2_kernel_preamble *preamble,
+				 enum vb2_hash_algorithm hash_alg,
+				 const uint8_t *body,
+				 uint32_t *checked,
+				 uint32_t done)
+{
+	uint32_t chunk_size = vb2_kernel_get_body_chunk_size(preamble);
+	uint32_t n;
+	int rv;
+
+	while (*checked < done) {
+		n = done - *checked;
+		if (n > chunk_size)
+			n = chunk_size;
+		else if (n < chunk_size &&
+			 done < preamble->body_signature.data_size)
+			break;  /* Rest of this chunk hasn't arrived */
+
+		rv = vb2_kernel_check_body_chunk(preamble, hash_alg,
+						 *checked / chunk_size,
+						 body + *checked, n);
+		if (rv)
+			return rv;
+		*checked += n;
+	}
+
+	return VB2_SUCCESS;
+}
+
+/**
+ * Read the rest of the kernel body in chunks, hashing each one as it arrives.
+ *
+ * The body is double-buffered in place: the read of each chunk is queued with
+ * VbExStreamReadAsync() before the previous chunk is added to the digest, so
+ * on platforms with asynchronous reads the storage transfer and the hashing
+ * overlap.  The body signature is then checked against the final digest,
+ * without a second pass over the whole body.  If the whole body has already
+ * been read, this just hashes and verifies it.
+ *
+ * The hardware crypto engine is used for the digest if the platform has one,
+ * unless the preamble disallows it.  If the preamble has a table of body
+ * chunk digests, each body chunk is instead checked against the table as soon
+ * as all of it has arrived, and the body signature is checked against the
+ * table.
+ *
+ * If the body is compressed, each piece is decompressed as soon as it has
+ * been hashed, or checked against its chunk digest, so the body is only
+ * passed over once.  Decompression stays behind the compressed data still to
+ * be read, so the compressed body can be read into the end of the buffer it is
+ * decompressed into.  Without a table of chunk digests, the data is
+ * decompressed before the signature over it is checked; the decompressor
+ * never writes outside its buffer, and nothing uses the result if the body
+ * does not verify.
+ *
+ * @param ctx		Vboot context
+ * @param stream	Stream to read the body from
+ * @param body		Kernel body buffer
+ * @param size		Bytes to read into body; at least the size the body
+ *			signature covers
+ * @param done		Bytes at the start of body which have already been read
+ * @param chunk_size	Bytes to read at a time
+ * @param lz4		Context to decompress the body with, or NULL if the
+ *			body is not compressed
+ * @param preamble	Kernel preamble; the body signature is destroyed
+ * @param key		Key to verify the body signature with
+ * @param read_us	Time spent waiting for reads is added to this
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, VB2_ERROR_LOAD_PARTITION_READ_BODY if a read failed,
+ * or another non-zero error code if the body did not verify.
+ */
+static int vb2_load_body(struct vb2_context *ctx,
+			 VbExStream_t stream,
+			 uint8_t *body,
+			 uint32_t size,
+			 uint32_t done,
+			 uint32_t chunk_size,
+			 struct vb2_lz4_context *lz4,
+			 struct vb2_kernel_preamble *preamble,
+			 const struct vb2_public_key *key,
+			 uint64_t *read_us,
+			 const struct vb2_workbuf *wb)
+{
+	struct vb2_signature *sig = &preamble->body_signature;
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_digest_context *dc;
+	uint32_t dc_size;
+	uint8_t *digest;
+	uint32_t digest_size;
+	uint32_t hashed = 0;
+	uint32_t decompressed = 0;
+	uint32_t reading, avail;
+	uint64_t start_ts;
+	int chunked = !!vb2_kernel_get_body_chunk_size(preamble);
+	int rv = VB2_SUCCESS;
+
+	digest_size = vb2_digest_size(key->hash_alg);
+	if (!digest_size)
+		return VB2_ERROR_VDATA_DIGEST_SIZE;
+
+	digest = vb2_workbuf_alloc(&wblocal, digest_size);
+	if (!digest)
+		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
+
+	dc_size = vb2_digest_context_size(key->hash_alg);
+	dc = vb2_workbuf_alloc(&wblocal, dc_size);
+	if (!dc)
+		return VB2_ERROR_VDATA_WORKBUF_HASHING;
+
+	if (!chunked)
+		rv = vb2_kernel_digest_init(dc, preamble, key->hash_alg);
+	if (rv)
+		return rv;
+
+	/* Waiting for reads which did not overlap the hashing counts here */
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_BEGIN);
+
+	while (hashed < sig->data_size) {
+		/* Queue the next chunk, if any, then hash what we have */
+		reading = size - done;
+		if (reading > chunk_size)
+			reading = chunk_size;
+		if (reading) {
+			trace_stream_read(ctx, reading, VB2_DISK_READ_BODY);
+			if (VbExStreamReadAsync(stream, reading, body + done))
+				return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		}
+
+		/* Whatever was read past the signed data is ignored */
+		avail = done < sig->data_size ? done : sig->data_size;
+		if (chunked) {
+			rv = vb2_check_body_chunks(preamble, key->hash_alg,
+						   body, &hashed, avail);
+		} else {
+			rv = vb2_kernel_digest_extend(dc, body + hashed,
+						      avail - hashed);
+			hashed = avail;
+		}
+
+		/* Only decompress what has been hashed or checked */
+		if (!rv && lz4 && decompressed < hashed) {
+			rv = vb2_lz4_extend(lz4, body + decompressed,
+					    hashed - decompressed);
+			decompressed = hashed;
+		}
+
+		if (reading) {
+			start_ts = VbExGetTimer();
+			if (VbExStreamWait(stream)) {
+				vb2_trace(ctx, VB2_TRACE_BODY_HASH,
+					  VB2_TRACE_END);
+				return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+			}
+			*read_us += VbExGetTimer() - start_ts;
+			done += reading;
+		}
+
+		if (rv)
+			break;
+	}
+
+	if (!rv && !chunked)
+		rv = vb2_kernel_digest_finalize(dc, digest, digest_size);
+	if (!rv && lz4)
+		rv = vb2_lz4_finalize(lz4);
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_END);
+	if (rv)
+		return rv;
+	vb2ex_timestamp(VB2_TS_KERNEL_BODY_HASHED);
+
+	vb2_workbuf_free(&wblocal, dc_size);
+
+	vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_BEGIN);
+	if (chunked)
+		rv = vb2_kernel_verify_body_chunks(preamble, key, &wblocal);
+	else
+		rv = vb2_verify_digest(key, sig, digest, &wblocal);
+	vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_END);
+	return rv;
+}
 
 /**
  * Load and verify a partition from the stream.
  *
  * @param ctx		Vboot context
  * @param stream	Stream to load kernel from
- * @param kernel_subkey	Key to use to verify vblock
+ * @param kernel_subkey	Unpacked key to use to verify vblock, or NULL if the
+ *			packed key could not be unpacked
  * @param flags		Flags (one or more of vb2_load_partition_flags)
  * @param params	Load-kernel parameters
  * @param min_version	Minimum kernel version from TPM
  * @param shpart	Destination for verification results
+ * @param cache		Vblocks already verified with kernel_subkey
+ * @param prefetch	If not NULL, partition whose vblock to verify on
+ *			another core while the body is read
  * @param wb            Workbuf for data storage
  * @return VB2_SUCCESS, or non-zero error code.
  */
 static int vb2_load_partition(struct vb2_context *ctx,
 			      VbExStream_t stream,
-			      const struct vb2_packed_key *kernel_subkey,
+			      const struct vb2_public_key *kernel_subkey,
 			      uint32_t flags,
 			      LoadKernelParams *params,
 			      uint32_t min_version,
 			      VbSharedDataKernelPart *shpart,
+			      struct vblock_cache *cache,
+			      struct vblock_prefetch *prefetch,
 			      struct vb2_workbuf *wb)
 {
 	uint64_t read_us = 0, start_ts;
 	struct vb2_workbuf wblocal = *wb;
+	struct vb2_public_key data_key;
+	uint32_t kbuf_size = get_kbuf_size(params);
+	uint8_t *kbuf;
+	int in_place = 0;
 
-	/* Allocate kernel header buffer in workbuf */
-	uint8_t *kbuf = vb2_workbuf_alloc(&wblocal, KBUF_SIZE);
-	if (!kbuf)
-		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
+	/*
+	 * If the platform allows it, read the vblock straight into the kernel
+	 * buffer, so the start of the body is already where it belongs.  Never
+	 * do that just to check a vblock, since the buffer may already hold
+	 * the kernel which is going to be booted.
+	 */
+	if ((params->boot_flags & BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER) &&
+	    !(flags & VB2_LOAD_PARTITION_VBLOCK_ONLY) &&
+	    params->kernel_buffer && params->kernel_buffer_size >= kbuf_size) {
+		kbuf = params->kernel_buffer;
+		in_place = 1;
+	} else {
+		/* Allocate kernel header buffer in workbuf */
+		kbuf = vb2_workbuf_alloc(&wblocal, kbuf_size);
+		if (!kbuf)
+			return VB2_ERROR_LOAD_PARTITION_WORKBUF;
+	}
 
 	start_ts = VbExGetTimer();
-	if (VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
+	trace_stream_read(ctx, kbuf_size, VB2_DISK_READ_VBLOCK);
+	vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_BEGIN);
+	int rv = VbExStreamRead(stream, kbuf_size, kbuf);
+	vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_END);
+	if (rv) {
 		VB2_DEBUG("Unable to read start of partition.\n");
 		shpart->check_result = VBSD_LKP_CHECK_READ_START;
 		return VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
@@ -337,15 +1009,18 @@ static int vb2_load_partition(struct vb2_context *ctx,
 	read_us += VbExGetTimer() - start_ts;
 
 	if (VB2_SUCCESS !=
-	    vb2_verify_kernel_vblock(ctx, kbuf, KBUF_SIZE, kernel_subkey,
-				     params, min_version, shpart, &wblocal)) {
+	    vb2_verify_kernel_vblock(ctx, kbuf, kbuf_size, kernel_subkey,
+				     params, min_version, shpart, &data_key,
+				     cache, &wblocal)) {
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_VBLOCK;
 	}
 
 	if (flags & VB2_LOAD_PARTITION_VBLOCK_ONLY)
 		return VB2_SUCCESS;
 
-	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
+	/* Not recorded for vblock-only checks, which may run on another core */
+	vb2ex_timestamp(VB2_TS_KERNEL_VBLOCK_VERIFIED);
+
 	struct vb2_kernel_preamble *preamble = get_preamble(kbuf);
 
 	/*
@@ -356,69 +1031,134 @@ static int vb2_load_partition(struct vb2_context *ctx,
 	 * data in between the vblock and the kernel data.
 	 */
 	uint32_t body_offset = get_body_offset(kbuf);
-	if (body_offset > KBUF_SIZE) {
+	if (body_offset > kbuf_size) {
 		shpart->check_result = VBSD_LKP_CHECK_BODY_OFFSET;
-		VB2_DEBUG("Kernel body offset is %u > 64KB.\n", body_offset);
+		VB2_DEBUG("Kernel body offset is %u > %u.\n", body_offset,
+			  kbuf_size);
 		return VB2_ERROR_LOAD_PARTITION_BODY_OFFSET;
 	}
 
 	uint8_t *kernbuf = params->kernel_buffer;
 	uint32_t kernbuf_size = params->kernel_buffer_size;
+	if (in_place) {
+		/* The body follows the vblock in the kernel buffer */
+		kernbuf += body_offset;
+		kernbuf_size -= body_offset;
+	}
+
+	/*
+	 * A compressed body is read into the end of the kernel buffer and
+	 * decompressed to its start, which needs a little room past the end of
+	 * the decompressed body.
+	 */
+	int compressed = vb2_kernel_get_body_compression(preamble) !=
+		VB2_KERNEL_COMPRESSION_NONE;
+	uint32_t body_size = preamble->body_signature.data_size;
+
+	/*
+	 * A compressed body usually doesn't fill its last sector.  It is read
+	 * with the rest of that sector into the end of the kernel buffer, so
+	 * its reads stay whole sectors as they would be for an uncompressed
+	 * body.  Only body_size bytes are hashed.
+	 */
+	uint64_t body_read_size = body_size;
+	if (compressed && params->bytes_per_lba &&
+	    body_size % params->bytes_per_lba)
+		body_read_size += params->bytes_per_lba -
+			body_size % params->bytes_per_lba;
+
+	uint64_t body_mem_size = body_read_size;
+	if (compressed) {
+		uint64_t inplace_size = (uint64_t)vb2_kernel_get_body_size(
+				preamble) + VB2_LZ4_INPLACE_MARGIN(body_size) +
+			body_read_size - body_size;
+		if (inplace_size > body_mem_size)
+			body_mem_size = inplace_size;
+	}
+
 	if (!kernbuf) {
 		/* Get kernel load address and size from the header. */
 		kernbuf = (uint8_t *)((long)preamble->body_load_address);
-		kernbuf_size = preamble->body_signature.data_size;
-	} else if (preamble->body_signature.data_size > kernbuf_size) {
+		kernbuf_size = body_mem_size > UINT32_MAX ? UINT32_MAX :
+			body_mem_size;
+	}
+	if (body_mem_size > kernbuf_size) {
 		VB2_DEBUG("Kernel body doesn't fit in memory.\n");
 		shpart->check_result = VBSD_LKP_CHECK_BODY_EXCEEDS_MEM;
 		return 	VB2_ERROR_LOAD_PARTITION_BODY_SIZE;
 	}
 
-	uint32_t body_toread = preamble->body_signature.data_size;
-	uint8_t *body_readptr = kernbuf;
+	uint32_t body_toread = body_read_size;
+	uint8_t *body = kernbuf;
+	struct vb2_lz4_context lz4;
+	if (compressed) {
+		body = kernbuf + kernbuf_size - body_toread;
+		vb2_lz4_init(&lz4, kernbuf, vb2_kernel_get_body_size(preamble));
+	}
+	uint8_t *body_readptr = body;
 
 	/*
-	 * If we've already read part of the kernel, copy that to the beginning
-	 * of the kernel buffer.
+	 * If we've already read part of the kernel, copy that to where the body
+	 * goes, unless it was read there in the first place.  If it was read
+	 * into the kernel buffer and the body is compressed, the two may
+	 * overlap.
 	 */
-	uint32_t body_copied = KBUF_SIZE - body_offset;
+	uint32_t body_copied = kbuf_size - body_offset;
 	if (body_copied > body_toread)
 		body_copied = body_toread;  /* Don't over-copy tiny kernel */
-	memcpy(body_readptr, kbuf + body_offset, body_copied);
+	if (!in_place || compressed)
+		memmove(body_readptr, kbuf + body_offset, body_copied);
 	body_toread -= body_copied;
 	body_readptr += body_copied;
 
-	/* Read the kernel data */
-	start_ts = VbExGetTimer();
-	if (body_toread && VbExStreamRead(stream, body_toread, body_readptr)) {
+	if (prefetch)
+		vblock_prefetch_start(ctx, prefetch, cache, &wblocal);
+
+	/* Read and verify the kernel data, a chunk at a time if possible */
+	uint32_t chunk_size = params->body_chunk_size;
+	if (params->bytes_per_lba)
+		chunk_size -= chunk_size % params->bytes_per_lba;
+
+	if (!chunk_size) {
+		/* Read the whole body before hashing it */
+		if (body_toread)
+			trace_stream_read(ctx, body_toread,
+					  VB2_DISK_READ_BODY);
+		start_ts = VbExGetTimer();
+		vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_BEGIN);
+		if (body_toread &&
+		    VbExStreamRead(stream, body_toread, body_readptr))
+			rv = VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_END);
+		read_us += VbExGetTimer() - start_ts;
+		body_copied += body_toread;
+	}
+
+	if (!rv)
+		rv = vb2_load_body(ctx, stream, body, body_read_size,
+				   body_copied, chunk_size,
+				   compressed ? &lz4 : NULL, preamble,
+				   &data_key, &read_us, &wblocal);
+
+	if (rv == VB2_ERROR_LOAD_PARTITION_READ_BODY) {
 		VB2_DEBUG("Unable to read kernel data.\n");
 		shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
-		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		return rv;
 	}
-	read_us += VbExGetTimer() - start_ts;
+
 	VB2_DEBUG("read %" PRIu32 " KB in %" PRIu64 " ms at %" PRIu64 " KB/s.\n",
-		  (body_toread + KBUF_SIZE) / 1024, read_us / 1000,
-		  ((uint64_t)(body_toread + KBUF_SIZE) * 1000 * 1000) /
+		  (body_toread + kbuf_size) / 1024, read_us / 1000,
+		  ((uint64_t)(body_toread + kbuf_size) * 1000 * 1000) /
 			  (read_us * 1024));
 
-	/* Get key for preamble/data verification from the key block. */
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
-		VB2_DEBUG("Unable to unpack kernel data key\n");
-		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
-		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
-	}
-
-	/* Verify kernel data */
-	if (VB2_SUCCESS != vb2_verify_data(kernbuf, kernbuf_size,
-					   &preamble->body_signature,
-					   &data_key, &wblocal)) {
+	if (rv) {
 		VB2_DEBUG("Kernel data verification failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
 	}
 
 	/* If we're still here, the kernel is valid */
+	vb2ex_timestamp(VB2_TS_KERNEL_BODY_VERIFIED);
 	VB2_DEBUG("Partition is good.\n");
 	shpart->check_result = VBSD_LKP_CHECK_KERNEL_GOOD;
 
@@ -426,7 +1166,7 @@ static int vb2_load_partition(struct vb2_context *ctx,
 	params->bootloader_address = preamble->bootloader_address;
 	params->bootloader_size = preamble->bootloader_size;
 	params->flags = vb2_kernel_get_flags(preamble);
-	if (!params->kernel_buffer) {
+	if (!params->kernel_buffer || in_place) {
 		params->kernel_buffer = kernbuf;
 		params->kernel_buffer_size = kernbuf_size;
 	}
@@ -461,6 +1201,8 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	shcall = shared->lk_calls +
 			(shared->lk_call_count & (VBSD_MAX_KERNEL_CALLS - 1));
 	memset(shcall, 0, sizeof(*shcall));
+	VbDiskReadStartCall(shared->lk_call_count &
+			    (VBSD_MAX_KERNEL_CALLS - 1));
 	shcall->boot_flags = (uint32_t)params->boot_flags;
 	shcall->boot_mode = get_kernel_boot_mode(ctx);
 	shcall->sector_size = (uint32_t)params->bytes_per_lba;
@@ -482,14 +1224,33 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 		kernel_subkey = (struct vb2_packed_key *)&shared->kernel_subkey;
 	}
 
+	/*
+	 * Unpack it once for all the partitions.  If that fails, every
+	 * partition fails to verify, as if it had been signed wrong.
+	 */
+	struct vb2_public_key kernel_key;
+	const struct vb2_public_key *kernel_key_ptr = NULL;
+	if (VB2_SUCCESS == vb2_unpack_key(&kernel_key, kernel_subkey))
+		kernel_key_ptr = &kernel_key;
+	struct vblock_cache cache = { .count = 0 };
+
 	/* Read GPT data */
 	GptData gpt;
+	struct vblock_prefetch prefetch = {
+		.kernel_subkey = kernel_key_ptr,
+		.params = params,
+		.min_version = shared->kernel_version_tpm,
+		.gpt = &gpt,
+	};
 	gpt.sector_bytes = (uint32_t)params->bytes_per_lba;
 	gpt.streaming_drive_sectors = params->streaming_lba_count;
 	gpt.gpt_drive_sectors = params->gpt_lba_count;
 	gpt.flags = params->boot_flags & BOOT_FLAG_EXTERNAL_GPT
 			? GPT_FLAG_EXTERNAL : 0;
-	if (0 != AllocAndReadGptData(params->disk_handle, &gpt)) {
+	vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_BEGIN);
+	rv = AllocAndReadGptData(params->disk_handle, &gpt);
+	vb2_trace(ctx, VB2_TRACE_DISK_READ, VB2_TRACE_END);
+	if (0 != rv) {
 		VB2_DEBUG("Unable to read GPT data\n");
 		shcall->check_result = VBSD_LKC_CHECK_GPT_READ_ERROR;
 		goto gpt_done;
@@ -532,17 +1293,6 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 		/* Found at least one kernel partition. */
 		found_partitions++;
 
-		/* Set up the stream */
-		VbExStream_t stream = NULL;
-		if (VbExStreamOpen(params->disk_handle,
-				   part_start, part_size, &stream)) {
-			VB2_DEBUG("Partition error getting stream.\n");
-			shpart->check_result = VBSD_LKP_CHECK_TOO_SMALL;
-			VB2_DEBUG("Marking kernel as invalid.\n");
-			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
-			continue;
-		}
-
 		uint32_t lpflags = 0;
 		if (params->partition_number > 0) {
 			/*
@@ -552,15 +1302,48 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 			lpflags |= VB2_LOAD_PARTITION_VBLOCK_ONLY;
 		}
 
-		rv = vb2_load_partition(ctx,
-					stream,
-					kernel_subkey,
-					lpflags,
-					params,
-					shared->kernel_version_tpm,
-					shpart,
-					&wb);
-		VbExStreamClose(stream);
+		/*
+		 * If this partition's vblock was verified on another core,
+		 * use that.  If it turns out the whole kernel is needed, it
+		 * has to be loaded here anyway.
+		 */
+		if (vblock_prefetch_wait(&prefetch) &&
+		    (lpflags & VB2_LOAD_PARTITION_VBLOCK_ONLY) &&
+		    prefetch.part_start == part_start &&
+		    prefetch.part_size == part_size) {
+			VB2_DEBUG("Using vblock verified in parallel.\n");
+			/* Record the read the other core made */
+			trace_stream_open(params, part_start);
+			trace_stream_read(ctx, get_kbuf_size(params),
+					  VB2_DISK_READ_VBLOCK);
+			*shpart = prefetch.shpart;
+			cache = prefetch.cache;
+			rv = prefetch.rv;
+		} else {
+			/* Set up the stream */
+			VbExStream_t stream = NULL;
+			if (VbExStreamOpen(params->disk_handle,
+					   part_start, part_size, &stream)) {
+				VB2_DEBUG("Partition error getting stream.\n");
+				shpart->check_result = VBSD_LKP_CHECK_TOO_SMALL;
+				VB2_DEBUG("Marking kernel as invalid.\n");
+				GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
+				continue;
+			}
+			trace_stream_open(params, part_start);
+
+			rv = vb2_load_partition(ctx,
+						stream,
+						kernel_key_ptr,
+						lpflags,
+						params,
+						shared->kernel_version_tpm,
+						shpart,
+						&cache,
+						lpflags ? NULL : &prefetch,
+						&wb);
+			VbExStreamClose(stream);
+		}
 
 		if (rv != VB2_SUCCESS) {
 			VB2_DEBUG("Marking kernel as invalid.\n");
@@ -632,6 +1415,9 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	} /* while(GptNextKernelEntry) */
 
 gpt_done:
+	/* Don't touch the disk again until any parallel read is done */
+	vblock_prefetch_wait(&prefetch);
+
 	/* Write and free GPT data */
 	WriteAndFreeGptData(params->disk_handle, &gpt);
 
@@ -170,7 +170,7 @@ int VbUserConfirms(struct vb2_context *ctx, uint32_t confirm_flags)
 			}
 			VbCheckDisplayKey(ctx, key, NULL);
 		}
-		VbExSleepMs(CONFIRM_KEY_DELAY);
+		VbExWaitForEvent(CONFIRM_KEY_DELAY, VB_UI_EVENTS);
 	} while (!shutdown_requested);
 
 	return -1;
@@ -226,7 +226,7 @@ static VbError_t vb2_altfw_ui(struct vb2_context *ctx)
 			VbCheckDisplayKey(ctx, key, NULL);
 			break;
 		}
-		VbExSleepMs(DEV_KEY_DELAY);
+		VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 	} while (active);
 
 	/* Back to developer screen */
@@ -314,7 +314,7 @@ static VbError_t vb2_enter_vendor_data_ui(struct vb2_context *ctx,
 			VbCheckDisplayKey(ctx, key, &data);
 			break;
 		}
-		VbExSleepMs(DEV_KEY_DELAY);
+		VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 	} while (1);
 
 	return VBERROR_SUCCESS;
@@ -381,7 +381,7 @@ static VbError_t vb2_vendor_data_ui(struct vb2_context *ctx)
 			VbCheckDisplayKey(ctx, key, &data);
 			break;
 		}
-		VbExSleepMs(DEV_KEY_DELAY);
+		VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 	} while (1);
 
 	return VBERROR_SUCCESS;
@@ -471,7 +471,7 @@ static VbError_t vb2_diagnostics_ui(struct vb2_context *ctx)
 			break;
 		}
 		if (active) {
-			VbExSleepMs(DEV_KEY_DELAY);
+			VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 		}
 	} while (active);
 
@@ -760,7 +760,7 @@ static VbError_t vb2_developer_ui(struct vb2_context *ctx)
 			break;
 		}
 
-		VbExSleepMs(DEV_KEY_DELAY);
+		VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 	} while(vb2_audio_looping());
 
  fallout:
@@ -786,6 +786,7 @@ VbError_t VbBootDeveloper(struct vb2_context *ctx)
 {
 	vb2_init_ui();
 	VbError_t retval = vb2_developer_ui(ctx);
+	vb2_audio_stop();
 	VbDisplayScreen(ctx, VB_SCREEN_BLANK, 0, NULL);
 	return retval;
 }
@@ -809,6 +810,7 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 	VbSharedDataHeader *shared = sd->vbsd;
 	uint32_t retval;
 	uint32_t key;
+	int hotplug;
 	int i;
 	const char release_button_msg[] =
 		"Release the recovery button and try again\n";
@@ -847,7 +849,7 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 				  vb2_check_diagnostic_key(ctx, key)) !=
 				  VBERROR_SUCCESS)
 				return retval;
-			VbExSleepMs(REC_KEY_DELAY);
+			VbExWaitForEvent(REC_KEY_DELAY, VB_UI_EVENTS);
 		}
 	}
 
@@ -876,9 +878,12 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 
 		/*
 		 * Scan keyboard more frequently than media, since x86
-		 * platforms don't like to scan USB too rapidly.
+		 * platforms don't like to scan USB too rapidly.  If the
+		 * firmware tells us about new disks, only scan them then.
 		 */
-		for (i = 0; i < REC_DISK_DELAY; i += REC_KEY_DELAY) {
+		hotplug = VbExDiskHasHotplugEvents();
+		for (i = 0; i < REC_DISK_DELAY;
+		     i += hotplug ? 0 : REC_KEY_DELAY) {
 			key = VbExKeyboardRead();
 			/*
 			 * We might want to enter dev-mode from the Insert
@@ -946,7 +951,11 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 			}
 			if (VbWantShutdown(ctx, key))
 				return VBERROR_SHUTDOWN_REQUESTED;
-			VbExSleepMs(REC_KEY_DELAY);
+			/* Look at a newly inserted disk straight away */
+			if (VbExWaitForEvent(REC_KEY_DELAY,
+					     VB_UI_EVENTS | VB_EVENT_DISK) &
+			    VB_EVENT_DISK)
+				break;
 		}
 	}
 
@@ -15,6 +15,13 @@
 #include "vboot_kernel.h"
 #include "vboot_ui_common.h"
 
+__attribute__((weak))
+uint32_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t event_mask)
+{
+	VbExSleepMs(timeout_ms);
+	return 0;
+}
+
 /* One or two beeps to notify that attempted action was disallowed. */
 void vb2_error_beep(enum vb2_beep_type beep)
 {
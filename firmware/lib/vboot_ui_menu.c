@@ -33,7 +33,8 @@ static int current_menu_idx, disabled_idx_mask, usb_nogood, force_redraw;
 static uint32_t default_boot;
 static uint32_t disable_dev_boot;
 static uint32_t altfw_allowed;
-static struct vb2_menu menus[];
+static uint32_t language_count;
+static const struct vb2_menu menus[];
 static const char no_legacy[] = "Legacy boot failed. Missing BIOS?\n";
 
 /**
@@ -60,6 +61,25 @@ static int VbWantShutdownMenu(struct vb2_context *ctx)
 	return !!shutdown_request;
 }
 
+/* Number of items in a menu, or 0 for a menuless screen. */
+static int vb2_menu_size(VB_MENU menu)
+{
+	if (menu == VB_MENU_LANGUAGES)
+		return language_count;
+	return menus[menu].size;
+}
+
+/*
+ * Item idx of a menu.  The language entries all look the same (the actual
+ * language is drawn by the bootloader), so they share a single item.
+ */
+static const struct vb2_menu_item *vb2_menu_item(VB_MENU menu, int idx)
+{
+	if (menu == VB_MENU_LANGUAGES)
+		idx = 0;
+	return &menus[menu].items[idx];
+}
+
 /* (Re-)Draw the menu identified by current_menu[_idx] to the screen. */
 static VbError_t vb2_draw_current_screen(struct vb2_context *ctx) {
 	VbError_t ret = VbDisplayMenu(ctx, menus[current_menu].screen,
@@ -78,10 +98,10 @@ static void vb2_flash_screen(struct vb2_context *ctx)
 
 static void vb2_log_menu_change(void)
 {
-	if (menus[current_menu].size)
+	if (vb2_menu_size(current_menu))
 		VB2_DEBUG("================ %s Menu ================ [ %s ]\n",
 			  menus[current_menu].name,
-			  menus[current_menu].items[current_menu_idx].text);
+			  vb2_menu_item(current_menu, current_menu_idx)->text);
 	else
 		VB2_DEBUG("=============== %s Screen ===============\n",
 			  menus[current_menu].name);
@@ -100,10 +120,7 @@ static void vb2_change_menu(VB_MENU new_current_menu,
 	current_menu = new_current_menu;
 
 	/* Reconfigure disabled_idx_mask for the new menu */
-	disabled_idx_mask = 0;
-	/* Disable Network Boot Option */
-	if (current_menu == VB_MENU_DEV)
-		disabled_idx_mask |= 1 << VB_DEV_NETWORK;
+	disabled_idx_mask = menus[current_menu].disabled_mask;
 	/* Disable cancel option if enterprise disabled dev mode */
 	if (current_menu == VB_MENU_TO_NORM &&
 	    disable_dev_boot == 1)
@@ -119,7 +136,7 @@ static void vb2_change_menu(VB_MENU new_current_menu,
 	/* We assume that there is at least one enabled item */
 	while ((1 << new_current_menu_idx) & disabled_idx_mask)
 		new_current_menu_idx++;
-	if (new_current_menu_idx < menus[current_menu].size)
+	if (new_current_menu_idx < vb2_menu_size(current_menu))
 		current_menu_idx = new_current_menu_idx;
 
 	vb2_log_menu_change();
@@ -427,11 +444,11 @@ static void vb2_update_selection(uint32_t key) {
 	case VB_BUTTON_VOL_DOWN_SHORT_PRESS:
 	case VB_KEY_DOWN:
 		idx = current_menu_idx + 1;
-		while (idx < menus[current_menu].size &&
+		while (idx < vb2_menu_size(current_menu) &&
 		       ((1 << idx) & disabled_idx_mask))
 		  idx++;
 		/* Only update if idx is valid */
-		if (idx < menus[current_menu].size)
+		if (idx < vb2_menu_size(current_menu))
 			current_menu_idx = idx;
 		break;
 	default:
@@ -473,7 +490,7 @@ static VbError_t vb2_handle_menu_input(struct vb2_context *ctx,
 		}
 
 		/* Menuless screens enter OPTIONS on volume button press. */
-		if (!menus[current_menu].size) {
+		if (!vb2_menu_size(current_menu)) {
 			enter_options_menu(ctx);
 			break;
 		}
@@ -484,10 +501,11 @@ static VbError_t vb2_handle_menu_input(struct vb2_context *ctx,
 	case VB_BUTTON_POWER_SHORT_PRESS:
 	case VB_KEY_ENTER:
 		/* Menuless screens shut down on power button press. */
-		if (!menus[current_menu].size)
+		if (!vb2_menu_size(current_menu))
 			return VBERROR_SHUTDOWN_REQUESTED;
 
-		return menus[current_menu].items[current_menu_idx].action(ctx);
+		return vb2_menu_item(current_menu,
+				     current_menu_idx)->action(ctx);
 	default:
 		VB2_DEBUG("pressed key 0x%x\n", key);
 		break;
@@ -504,13 +522,16 @@ static VbError_t vb2_handle_menu_input(struct vb2_context *ctx,
 /* Delay in developer menu */
 #define DEV_KEY_DELAY        20       /* Check keys every 20ms */
 
-/* Master table of all menus. Menus with size == 0 count as menuless screens. */
-static struct vb2_menu menus[VB_MENU_COUNT] = {
+/*
+ * Master table of all menus. Menus with size == 0 count as menuless screens.
+ * It's constant, so it stays in read-only memory.
+ */
+static const struct vb2_menu menus[VB_MENU_COUNT] = {
 	[VB_MENU_DEV_WARNING] = {
 		.name = "Developer Warning",
 		.size = VB_WARN_COUNT,
 		.screen = VB_SCREEN_DEVELOPER_WARNING_MENU,
-		.items = (struct vb2_menu_item[]){
+		.items = (const struct vb2_menu_item[]){
 			[VB_WARN_OPTIONS] = {
 				.text = "Developer Options",
 				.action = enter_developer_menu,
@@ -537,7 +558,9 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 		.name = "Developer Boot Options",
 		.size = VB_DEV_COUNT,
 		.screen = VB_SCREEN_DEVELOPER_MENU,
-		.items = (struct vb2_menu_item[]){
+		/* Network boot is not implemented */
+		.disabled_mask = 1 << VB_DEV_NETWORK,
+		.items = (const struct vb2_menu_item[]){
 			[VB_DEV_NETWORK] = {
 				.text = "Boot From Network",
 				.action = NULL,	/* unimplemented */
@@ -572,7 +595,7 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 		.name = "TO_NORM Confirmation",
 		.size = VB_TO_NORM_COUNT,
 		.screen = VB_SCREEN_DEVELOPER_TO_NORM_MENU,
-		.items = (struct vb2_menu_item[]){
+		.items = (const struct vb2_menu_item[]){
 			[VB_TO_NORM_CONFIRM] = {
 				.text = "Confirm Enabling OS Verification",
 				.action = to_norm_action,
@@ -595,7 +618,7 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 		.name = "TO_DEV Confirmation",
 		.size = VB_TO_DEV_COUNT,
 		.screen = VB_SCREEN_RECOVERY_TO_DEV_MENU,
-		.items = (struct vb2_menu_item[]){
+		.items = (const struct vb2_menu_item[]){
 			[VB_TO_DEV_CONFIRM] = {
 				.text = "Confirm Disabling OS Verification",
 				.action = to_dev_action,
@@ -617,13 +640,18 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 	[VB_MENU_LANGUAGES] = {
 		.name = "Language Selection",
 		.screen = VB_SCREEN_LANGUAGES_MENU,
-		/* Rest is filled out dynamically by vb2_init_menus() */
+		/* Size is the number of languages; see vb2_menu_size() */
+		.items = (const struct vb2_menu_item[]){{
+				.text = "Some Language",
+				.action = language_action,
+			},
+		},
 	},
 	[VB_MENU_OPTIONS] = {
 		.name = "Options",
 		.size = VB_OPTIONS_COUNT,
 		.screen = VB_SCREEN_OPTIONS_MENU,
-		.items = (struct vb2_menu_item[]){
+		.items = (const struct vb2_menu_item[]){
 			[VB_OPTIONS_DBG_INFO] = {
 				.text = "Show Debug Info",
 				.action = debug_info_action,
@@ -670,7 +698,7 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 		.name = "Alternative Firmware Selection",
 		.screen = VB_SCREEN_ALT_FW_MENU,
 		.size = VB_ALTFW_COUNT + 1,
-		.items = (struct vb2_menu_item[]) {{
+		.items = (const struct vb2_menu_item[]) {{
 				.text = "Bootloader 1",
 				.action = altfw_action,
 			}, {
@@ -708,26 +736,10 @@ static struct vb2_menu menus[VB_MENU_COUNT] = {
 /* Initialize menu state. Must be called once before displaying any menus. */
 static VbError_t vb2_init_menus(struct vb2_context *ctx)
 {
-	struct vb2_menu_item *items;
-	uint32_t count;
-	int i;
-
-	/* Initialize language menu with the correct amount of entries. */
-	VbExGetLocalizationCount(&count);
-	if (!count)
-		count = 1;	/* Always need at least one language entry. */
-
-	items = malloc(count * sizeof(struct vb2_menu_item));
-	if (!items)
-		return VBERROR_UNKNOWN;
-
-	for (i = 0; i < count; i++) {
-		/* The actual language is drawn by the bootloader */
-		items[i].text = "Some Language";
-		items[i].action = language_action;
-	}
-	menus[VB_MENU_LANGUAGES].size = count;
-	menus[VB_MENU_LANGUAGES].items = items;
+	/* Size the language menu to the number of languages. */
+	VbExGetLocalizationCount(&language_count);
+	if (!language_count)
+		language_count = 1;	/* Always need at least one entry. */
 
 	return VBERROR_SUCCESS;
 }
@@ -817,7 +829,7 @@ static VbError_t vb2_developer_menu(struct vb2_context *ctx)
 		if (key != 0)
 			vb2_audio_start(ctx);
 
-		VbExSleepMs(DEV_KEY_DELAY);
+		VbExWaitForEvent(DEV_KEY_DELAY, VB_UI_EVENTS);
 
 		/* If dev mode was disabled, loop forever (never timeout) */
 	} while (disable_dev_boot ? 1 : vb2_audio_looping());
@@ -839,6 +851,7 @@ VbError_t VbBootDeveloperMenu(struct vb2_context *ctx)
 	if (VBERROR_SUCCESS != retval)
 		return retval;
 	retval = vb2_developer_menu(ctx);
+	vb2_audio_stop();
 	VbDisplayScreen(ctx, VB_SCREEN_BLANK, 0, NULL);
 	return retval;
 }
@@ -885,6 +898,7 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 	uint32_t key;
 	uint32_t key_flags;
 	VbError_t ret;
+	int hotplug;
 	int i;
 
 	/* Loop and wait for a recovery image */
@@ -914,9 +928,12 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 
 		/*
 		 * Scan keyboard more frequently than media, since x86
-		 * platforms don't like to scan USB too rapidly.
+		 * platforms don't like to scan USB too rapidly.  If the
+		 * firmware tells us about new disks, only scan them then.
 		 */
-		for (i = 0; i < REC_DISK_DELAY; i += REC_KEY_DELAY) {
+		hotplug = VbExDiskHasHotplugEvents();
+		for (i = 0; i < REC_DISK_DELAY;
+		     i += hotplug ? 0 : REC_KEY_DELAY) {
 			key = VbExKeyboardReadWithFlags(&key_flags);
 			if (key == VB_BUTTON_VOL_UP_DOWN_COMBO_PRESS) {
 				if (key_flags & VB_KEY_FLAG_TRUSTED_KEYBOARD)
@@ -929,7 +946,11 @@ static VbError_t recovery_ui(struct vb2_context *ctx)
 				if (ret != VBERROR_KEEP_LOOPING)
 					return ret;
 			}
-			VbExSleepMs(REC_KEY_DELAY);
+			/* Look at a newly inserted disk straight away */
+			if (VbExWaitForEvent(REC_KEY_DELAY,
+					     VB_UI_EVENTS | VB_EVENT_DISK) &
+			    VB_EVENT_DISK)
+				break;
 		}
 	}
 }
@@ -19,6 +19,8 @@ int vb2api_fw_phase3(struct vb2_context *ctx)
 {
 	int rv;
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE3_START);
+
 	/* Verify firmware keyblock */
 	rv = vb2_load_fw_keyblock(ctx);
 	if (rv) {
@@ -33,6 +35,52 @@ int vb2api_fw_phase3(struct vb2_context *ctx)
 		return rv;
 	}
 
+	vb2ex_timestamp(VB2_TS_FW_PHASE3_END);
+	return VB2_SUCCESS;
+}
+
+/*
+ * Get the preamble, hash algorithm and number of chunks for checking the
+ * firmware body a chunk at a time, and check the table of chunk digests is
+ * the right size for them.
+ */
+static int get_body_chunks(struct vb2_context *ctx,
+			   const struct vb2_fw_preamble **pre_out,
+			   enum vb2_hash_algorithm *hash_alg,
+			   uint32_t *count)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	const struct vb2_fw_preamble *pre;
+	struct vb2_public_key key;
+	uint32_t chunk_size, body_size;
+	int rv;
+
+	if (!sd->workbuf_preamble_size)
+		return VB2_ERROR_API_INIT_HASH_PREAMBLE;
+	pre = (const struct vb2_fw_preamble *)
+		(ctx->workbuf + sd->workbuf_preamble_offset);
+
+	chunk_size = vb2_fw_get_body_chunk_size(pre);
+	if (!chunk_size)
+		return VB2_ERROR_API_BODY_NOT_CHUNKED;
+
+	if (!sd->workbuf_data_key_size)
+		return VB2_ERROR_API_INIT_HASH_DATA_KEY;
+
+	rv = vb2_unpack_key_buffer(&key,
+			    ctx->workbuf + sd->workbuf_data_key_offset,
+			    sd->workbuf_data_key_size);
+	if (rv)
+		return rv;
+
+	body_size = pre->body_signature.data_size;
+	*count = body_size / chunk_size + (body_size % chunk_size ? 1 : 0);
+	if ((uint64_t)*count * vb2_digest_size(key.hash_alg) !=
+	    pre->body_chunk_digests_size)
+		return VB2_ERROR_API_INIT_HASH_CHUNKS;
+
+	*pre_out = pre;
+	*hash_alg = key.hash_alg;
 	return VB2_SUCCESS;
 }
 
@@ -43,8 +91,12 @@ int vb2api_init_hash(struct vb2_context *ctx, uint32_t tag, uint32_t *size)
 	struct vb2_digest_context *dc;
 	struct vb2_public_key key;
 	struct vb2_workbuf wb;
+	uint32_t first_size;
+	uint32_t dig_size;
 	int rv;
 
+	sd->hash_start_us = vb2ex_utime();
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_HASH);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	if (tag == VB2_HASH_TAG_INVALID)
@@ -60,13 +112,34 @@ int vb2api_init_hash(struct vb2_context *ctx, uint32_t tag, uint32_t *size)
 	if (tag != VB2_HASH_TAG_FW_BODY)
 		return VB2_ERROR_API_INIT_HASH_TAG;
 
-	/* Allocate workbuf space for the hash */
-	if (sd->workbuf_hash_size) {
+	/*
+	 * Unpack the firmware data key to see which hashing algorithm we
+	 * should use.
+	 *
+	 * TODO: really, the firmware body should be hashed, and not signed,
+	 * because the signature we're checking is already signed as part of
+	 * the firmware preamble.  But until we can change the signing scripts,
+	 * we're stuck with a signature here instead of a hash.
+	 */
+	if (!sd->workbuf_data_key_size)
+		return VB2_ERROR_API_INIT_HASH_DATA_KEY;
+
+	rv = vb2_unpack_key_buffer(&key,
+			    ctx->workbuf + sd->workbuf_data_key_offset,
+			    sd->workbuf_data_key_size);
+	if (rv)
+		return rv;
+
+	/*
+	 * Allocate workbuf space for the hash, only as big as its algorithm
+	 * needs.  A context from an earlier call is reused if it is big
+	 * enough.
+	 */
+	dig_size = vb2_digest_context_size(key.hash_alg);
+	if (sd->workbuf_hash_size >= dig_size) {
 		dc = (struct vb2_digest_context *)
 			(ctx->workbuf + sd->workbuf_hash_offset);
 	} else {
-		uint32_t dig_size = sizeof(*dc);
-
 		dc = vb2_workbuf_alloc(&wb, dig_size);
 		if (!dc)
 			return VB2_ERROR_API_INIT_HASH_WORKBUF;
@@ -84,33 +157,40 @@ int vb2api_init_hash(struct vb2_context *ctx, uint32_t tag, uint32_t *size)
 	 *   - hash data
 	 */
 
-	/*
-	 * Unpack the firmware data key to see which hashing algorithm we
-	 * should use.
-	 *
-	 * TODO: really, the firmware body should be hashed, and not signed,
-	 * because the signature we're checking is already signed as part of
-	 * the firmware preamble.  But until we can change the signing scripts,
-	 * we're stuck with a signature here instead of a hash.
-	 */
-	if (!sd->workbuf_data_key_size)
-		return VB2_ERROR_API_INIT_HASH_DATA_KEY;
-
-	rv = vb2_unpack_key_buffer(&key,
-			    ctx->workbuf + sd->workbuf_data_key_offset,
-			    sd->workbuf_data_key_size);
-	if (rv)
-		return rv;
-
 	sd->hash_tag = tag;
 	sd->hash_remaining_size = pre->body_signature.data_size;
+	first_size = pre->body_signature.data_size;
 
 	if (size)
 		*size = pre->body_signature.data_size;
 
+	/*
+	 * If the body signature signs a table of chunk digests, check each
+	 * chunk against the table as it is hashed.
+	 */
+	sd->hash_chunk_size = vb2_fw_get_body_chunk_size(pre);
+	if (sd->hash_chunk_size) {
+		enum vb2_hash_algorithm hash_alg;
+		uint32_t count;
+
+		rv = get_body_chunks(ctx, &pre, &hash_alg, &count);
+		if (rv)
+			return rv;
+
+		sd->workbuf_hash_chunks_offset = sd->workbuf_preamble_offset +
+			pre->body_chunk_digests_offset;
+		sd->hash_chunk_index = 0;
+		if (first_size > sd->hash_chunk_size)
+			first_size = sd->hash_chunk_size;
+		sd->hash_chunk_remaining_size = first_size;
+	}
+
+	/* Ends in vb2api_check_hash_get_digest() */
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_BEGIN);
+	vb2ex_timestamp(VB2_TS_FW_BODY_HASH_START);
+
 	if (!(pre->flags & VB2_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO)) {
-		rv = vb2ex_hwcrypto_digest_init(key.hash_alg,
-						pre->body_signature.data_size);
+		rv = vb2ex_hwcrypto_digest_init(key.hash_alg, first_size);
 		if (!rv) {
 			VB2_DEBUG("Using HW crypto engine for hash_alg %d\n",
 				  key.hash_alg);
@@ -142,6 +222,7 @@ int vb2api_check_hash_get_digest(struct vb2_context *ctx, void *digest_out,
 
 	struct vb2_fw_preamble *pre;
 	struct vb2_public_key key;
+	uint32_t crypto_start_us = vb2ex_utime();
 	int rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
@@ -165,40 +246,79 @@ int vb2api_check_hash_get_digest(struct vb2_context *ctx, void *digest_out,
 	if (!digest)
 		return VB2_ERROR_API_CHECK_HASH_WORKBUF_DIGEST;
 
-	/* Finalize the digest */
-	if (dc->using_hwcrypto)
+	/*
+	 * Finalize the digest.  If the body was hashed in chunks, each chunk
+	 * has already been checked, and the body signature signs the table of
+	 * chunk digests.
+	 */
+	if (sd->hash_chunk_size)
+		rv = vb2_digest_buffer(ctx->workbuf +
+				       sd->workbuf_hash_chunks_offset,
+				       pre->body_chunk_digests_size,
+				       dc->hash_alg, digest, digest_size);
+	else if (dc->using_hwcrypto)
 		rv = vb2ex_hwcrypto_digest_finalize(digest, digest_size);
 	else
 		rv = vb2_digest_finalize(dc, digest, digest_size);
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_END);
 	if (rv)
 		return rv;
+	vb2ex_timestamp(VB2_TS_FW_BODY_HASHED);
 
 	/* The code below is specific to the body signature */
 	if (sd->hash_tag != VB2_HASH_TAG_FW_BODY)
 		return VB2_ERROR_API_CHECK_HASH_TAG;
 
-	/*
-	 * The body signature is currently a *signature* of the body data, not
-	 * just its hash.  So we need to verify the signature.
-	 */
-
-	/* Unpack the data key */
-	if (!sd->workbuf_data_key_size)
-		return VB2_ERROR_API_CHECK_HASH_DATA_KEY;
-
-	rv = vb2_unpack_key_buffer(&key,
-			    ctx->workbuf + sd->workbuf_data_key_offset,
-			    sd->workbuf_data_key_size);
-	if (rv)
-		return rv;
+	if ((sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH) &&
+	    vb2_check_warm_boot_body(ctx, digest, digest_size) ==
+	    VB2_SUCCESS) {
+		/* Same firmware as verified earlier this power cycle */
+		VB2_DEBUG("Body matches warm boot record\n");
+		vb2ex_timestamp(VB2_TS_FW_BODY_VERIFIED);
+		rv = VB2_SUCCESS;
+	} else {
+		/*
+		 * The body signature is currently a *signature* of the body
+		 * data, not just its hash.  So we need to verify the
+		 * signature.
+		 */
+
+		/* Unpack the data key */
+		if (!sd->workbuf_data_key_size)
+			return VB2_ERROR_API_CHECK_HASH_DATA_KEY;
+
+		rv = vb2_unpack_key_buffer(&key,
+				ctx->workbuf + sd->workbuf_data_key_offset,
+				sd->workbuf_data_key_size);
+		if (rv)
+			return rv;
 
-	/*
-	 * Check digest vs. signature.  Note that this destroys the signature.
-	 * That's ok, because we only check each signature once per boot.
-	 */
-	rv = vb2_verify_digest(&key, &pre->body_signature, digest, &wb);
-	if (rv)
-		vb2_fail(ctx, VB2_RECOVERY_FW_BODY, rv);
+		key.allow_hwcrypto = !(pre->flags &
+				       VB2_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO);
+
+		/*
+		 * Check digest vs. signature.  Note that this destroys the
+		 * signature.  That's ok, because we only check each signature
+		 * once per boot.
+		 */
+		vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_BEGIN);
+		rv = vb2_verify_digest(&key, &pre->body_signature, digest,
+				       &wb);
+		vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_END);
+		if (rv) {
+			vb2_fail(ctx, VB2_RECOVERY_FW_BODY, rv);
+		} else {
+			vb2ex_timestamp(VB2_TS_FW_BODY_VERIFIED);
+
+			/* Let later boots this power cycle skip all that */
+			if ((ctx->flags & VB2_CONTEXT_WARM_BOOT_RECORD) &&
+			    vb2_save_warm_boot_record(ctx, digest,
+						      digest_size))
+				VB2_DEBUG("Can't save warm boot record\n");
+		}
+	}
+	vb2_cost_add(ctx, VB2_COST_FW_BODY, sd->hash_start_us,
+		     crypto_start_us, 0);
 
 	if (digest_out != NULL) {
 		if (digest_out_size < digest_size)
@@ -213,3 +333,60 @@ int vb2api_check_hash(struct vb2_context *ctx)
 {
 	return vb2api_check_hash_get_digest(ctx, NULL, 0);
 }
+
+int vb2api_get_body_chunks(struct vb2_context *ctx,
+			   uint32_t *chunk_size,
+			   uint32_t *count)
+{
+	const struct vb2_fw_preamble *pre;
+	enum vb2_hash_algorithm hash_alg;
+	int rv;
+
+	rv = get_body_chunks(ctx, &pre, &hash_alg, count);
+	if (rv)
+		return rv;
+
+	*chunk_size = pre->body_chunk_size;
+	return VB2_SUCCESS;
+}
+
+int vb2api_check_body_chunk(struct vb2_context *ctx,
+			    uint32_t index,
+			    const void *buf,
+			    uint32_t size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	const struct vb2_fw_preamble *pre;
+	enum vb2_hash_algorithm hash_alg;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size, offset, expect_size, count;
+	const uint8_t *expect;
+	int rv;
+
+	rv = get_body_chunks(ctx, &pre, &hash_alg, &count);
+	if (rv)
+		return rv;
+
+	if (index >= count)
+		return VB2_ERROR_API_BODY_CHUNK_INDEX;
+
+	/* The last chunk has whatever is left of the body */
+	offset = index * pre->body_chunk_size;
+	expect_size = pre->body_signature.data_size - offset;
+	if (expect_size > pre->body_chunk_size)
+		expect_size = pre->body_chunk_size;
+	if (size != expect_size)
+		return VB2_ERROR_API_BODY_CHUNK_SIZE;
+
+	digest_size = vb2_digest_size(hash_alg);
+	rv = vb2_digest_buffer(buf, size, hash_alg, digest, digest_size);
+	if (rv)
+		return rv;
+
+	expect = ctx->workbuf + sd->workbuf_preamble_offset +
+		pre->body_chunk_digests_offset + index * digest_size;
+	if (vb2_safe_memcmp(digest, expect, digest_size))
+		return VB2_ERROR_API_BODY_CHUNK_DIGEST;
+
+	return VB2_SUCCESS;
+}
@@ -23,6 +23,8 @@ int vb2api_kernel_phase1(struct vb2_context *ctx)
 	uint32_t key_size;
 	int rv;
 
+	vb2ex_timestamp(VB2_TS_KERNEL_PHASE1_START);
+
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Initialize secure kernel data and read version */
@@ -122,6 +124,7 @@ int vb2api_kernel_phase1(struct vb2_context *ctx)
 	vb2_set_workbuf_used(ctx, sd->workbuf_kernel_key_offset +
 			     sd->workbuf_kernel_key_size);
 
+	vb2ex_timestamp(VB2_TS_KERNEL_PHASE1_END);
 	return VB2_SUCCESS;
 }
 
@@ -139,6 +142,7 @@ int vb2api_load_kernel_vblock(struct vb2_context *ctx)
 	if (rv)
 		return rv;
 
+	vb2ex_timestamp(VB2_TS_KERNEL_VBLOCK_VERIFIED);
 	return VB2_SUCCESS;
 }
 
@@ -198,11 +202,6 @@ int vb2api_verify_kernel_data(struct vb2_context *ctx,
 	if (size != pre->body_signature.data_size)
 		return VB2_ERROR_API_VERIFY_KDATA_SIZE;
 
-	/* Allocate workbuf space for the hash */
-	dc = vb2_workbuf_alloc(&wb, sizeof(*dc));
-	if (!dc)
-		return VB2_ERROR_API_VERIFY_KDATA_WORKBUF;
-
 	/*
 	 * Unpack the kernel data key to see which hashing algorithm we
 	 * should use.
@@ -221,11 +220,32 @@ int vb2api_verify_kernel_data(struct vb2_context *ctx,
 	if (rv)
 		return rv;
 
-	rv = vb2_digest_init(dc, key.hash_alg);
+	key.allow_hwcrypto = !(vb2_kernel_get_flags(pre) &
+			       VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO);
+
+	/*
+	 * If the body signature signs a table of chunk digests, check each
+	 * chunk against the table, then the signature of the table.
+	 */
+	if (vb2_kernel_get_body_chunk_size(pre)) {
+		rv = vb2_verify_kernel_body(buf, size, pre, &key, &wb);
+		if (!rv) {
+			vb2ex_timestamp(VB2_TS_KERNEL_BODY_HASHED);
+			vb2ex_timestamp(VB2_TS_KERNEL_BODY_VERIFIED);
+		}
+		return rv;
+	}
+
+	/* Allocate workbuf space for the hash, as big as its algorithm needs */
+	dc = vb2_workbuf_alloc(&wb, vb2_digest_context_size(key.hash_alg));
+	if (!dc)
+		return VB2_ERROR_API_VERIFY_KDATA_WORKBUF;
+
+	rv = vb2_kernel_digest_init(dc, pre, key.hash_alg);
 	if (rv)
 		return rv;
 
-	rv = vb2_digest_extend(dc, buf, size);
+	rv = vb2_kernel_digest_extend(dc, buf, size);
 	if (rv)
 		return rv;
 
@@ -234,9 +254,10 @@ int vb2api_verify_kernel_data(struct vb2_context *ctx,
 	if (!digest)
 		return VB2_ERROR_API_CHECK_HASH_WORKBUF_DIGEST;
 
-	rv = vb2_digest_finalize(dc, digest, digest_size);
+	rv = vb2_kernel_digest_finalize(dc, digest, digest_size);
 	if (rv)
 		return rv;
+	vb2ex_timestamp(VB2_TS_KERNEL_BODY_HASHED);
 
 	/*
 	 * The body signature is currently a *signature* of the body data, not
@@ -247,7 +268,80 @@ int vb2api_verify_kernel_data(struct vb2_context *ctx,
 	 * Check digest vs. signature.  Note that this destroys the signature.
 	 * That's ok, because we only check each signature once per boot.
 	 */
-	return vb2_verify_digest(&key, &pre->body_signature, digest, &wb);
+	vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_BEGIN);
+	rv = vb2_verify_digest(&key, &pre->body_signature, digest, &wb);
+	vb2_trace(ctx, VB2_TRACE_RSA, VB2_TRACE_END);
+	if (!rv)
+		vb2ex_timestamp(VB2_TS_KERNEL_BODY_VERIFIED);
+	return rv;
+}
+
+/*
+ * Get the kernel preamble and data key for checking the kernel body a chunk
+ * at a time.
+ */
+static int get_kernel_body_chunks(struct vb2_context *ctx,
+				  const struct vb2_kernel_preamble **pre_out,
+				  enum vb2_hash_algorithm *hash_alg)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	const struct vb2_kernel_preamble *pre;
+	struct vb2_public_key key;
+	int rv;
+
+	if (!sd->workbuf_preamble_size)
+		return VB2_ERROR_API_VERIFY_KDATA_PREAMBLE;
+	pre = (const struct vb2_kernel_preamble *)
+		(ctx->workbuf + sd->workbuf_preamble_offset);
+
+	if (!vb2_kernel_get_body_chunk_size(pre))
+		return VB2_ERROR_API_BODY_NOT_CHUNKED;
+
+	if (!sd->workbuf_data_key_size)
+		return VB2_ERROR_API_VERIFY_KDATA_KEY;
+
+	rv = vb2_unpack_key_buffer(&key,
+			    ctx->workbuf + sd->workbuf_data_key_offset,
+			    sd->workbuf_data_key_size);
+	if (rv)
+		return rv;
+
+	*pre_out = pre;
+	*hash_alg = key.hash_alg;
+	return VB2_SUCCESS;
+}
+
+int vb2api_get_kernel_body_chunks(struct vb2_context *ctx,
+				  uint32_t *chunk_size,
+				  uint32_t *count)
+{
+	const struct vb2_kernel_preamble *pre;
+	enum vb2_hash_algorithm hash_alg;
+	int rv;
+
+	rv = get_kernel_body_chunks(ctx, &pre, &hash_alg);
+	if (rv)
+		return rv;
+
+	*chunk_size = vb2_kernel_get_body_chunk_size(pre);
+	*count = vb2_kernel_get_body_chunk_count(pre);
+	return VB2_SUCCESS;
+}
+
+int vb2api_check_kernel_body_chunk(struct vb2_context *ctx,
+				   uint32_t index,
+				   const void *buf,
+				   uint32_t size)
+{
+	const struct vb2_kernel_preamble *pre;
+	enum vb2_hash_algorithm hash_alg;
+	int rv;
+
+	rv = get_kernel_body_chunks(ctx, &pre, &hash_alg);
+	if (rv)
+		return rv;
+
+	return vb2_kernel_check_body_chunk(pre, hash_alg, index, buf, size);
 }
 
 int vb2api_kernel_phase3(struct vb2_context *ctx)
@@ -40,6 +40,18 @@ int vb2_verify_digest(const struct vb2_public_key *key,
 		return VB2_ERROR_VDATA_SIG_SIZE;
 	}
 
+	if (key->allow_hwcrypto) {
+		int rv = vb2ex_hwcrypto_rsa_verify_digest(key, sig_data,
+							  digest);
+		if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED) {
+			VB2_DEBUG("Using HW RSA engine for sig_alg %d\n",
+				  key->sig_alg);
+			return rv;
+		}
+		VB2_DEBUG("HW RSA for sig_alg %d not supported, using SW\n",
+			  key->sig_alg);
+	}
+
 	return vb2_rsa_verify_digest(key, sig_data, digest, wb);
 }
 
@@ -53,6 +65,7 @@ int vb2_verify_data(const uint8_t *data,
 	struct vb2_digest_context *dc;
 	uint8_t *digest;
 	uint32_t digest_size;
+	uint32_t dc_size;
 	int rv;
 
 	if (sig->data_size > size) {
@@ -70,7 +83,8 @@ int vb2_verify_data(const uint8_t *data,
 		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
 
 	/* Hashing requires temp space for the context */
-	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	dc_size = vb2_digest_context_size(key->hash_alg);
+	dc = vb2_workbuf_alloc(&wblocal, dc_size);
 	if (!dc)
 		return VB2_ERROR_VDATA_WORKBUF_HASHING;
 
@@ -86,7 +100,7 @@ int vb2_verify_data(const uint8_t *data,
 	if (rv)
 		return rv;
 
-	vb2_workbuf_free(&wblocal, sizeof(*dc));
+	vb2_workbuf_free(&wblocal, dc_size);
 
 	return vb2_verify_digest(key, sig, digest, &wblocal);
 }
@@ -171,17 +185,63 @@ int vb2_verify_keyblock(struct vb2_keyblock *block,
 	return VB2_SUCCESS;
 }
 
+int vb2_verify_mapped_keyblock(const struct vb2_keyblock *block,
+			       uint32_t size,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb)
+{
+	const struct vb2_signature *sig = &block->keyblock_signature;
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_signature *sig_copy;
+	int rv;
+
+	/* This also makes sure the signature data is inside the block */
+	rv = vb2_check_keyblock(block, size, sig);
+	if (rv)
+		return rv;
+
+	/* Checking the signature destroys it, so check a copy */
+	sig_copy = vb2_workbuf_alloc(&wblocal, sizeof(*sig) + sig->sig_size);
+	if (!sig_copy)
+		return VB2_ERROR_KEYBLOCK_WORKBUF_SIG;
+
+	memcpy(sig_copy, sig, sizeof(*sig));
+	sig_copy->sig_offset = sizeof(*sig);
+	memcpy(vb2_signature_data(sig_copy),
+	       (const uint8_t *)sig + sig->sig_offset, sig->sig_size);
+
+	VB2_DEBUG("Checking key block signature...\n");
+	rv = vb2_verify_data((const uint8_t *)block, size, sig_copy, key,
+			     &wblocal);
+	if (rv) {
+		VB2_DEBUG("Invalid key block signature.\n");
+		return VB2_ERROR_KEYBLOCK_SIG_INVALID;
+	}
+
+	/* Success */
+	return VB2_SUCCESS;
+}
+
+uint32_t vb2_fw_get_body_chunk_size(const struct vb2_fw_preamble *preamble)
+{
+	if (preamble->header_version_minor < 2)
+		return 0;
+
+	return preamble->body_chunk_size;
+}
+
 int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 			   uint32_t size,
 			   const struct vb2_public_key *key,
 			   const struct vb2_workbuf *wb)
 {
 	struct vb2_signature *sig = &preamble->preamble_signature;
+	uint32_t min_size = EXPECTED_VB2_FW_PREAMBLE_2_1_SIZE;
 
 	VB2_DEBUG("Verifying preamble.\n");
 
 	/* Sanity checks before attempting signature of data */
-	if(size < sizeof(*preamble)) {
+	if(size < min_size) {
 		VB2_DEBUG("Not enough data for preamble header\n");
 		return VB2_ERROR_PREAMBLE_TOO_SMALL_FOR_HEADER;
 	}
@@ -196,6 +256,12 @@ int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_HEADER_OLD;
 	}
 
+	if (preamble->header_version_minor >= 2)
+		min_size = EXPECTED_VB2_FW_PREAMBLE_SIZE;
+	if (preamble->preamble_size < min_size) {
+		VB2_DEBUG("Preamble size too small for header.\n");
+		return VB2_ERROR_PREAMBLE_TOO_SMALL_FOR_HEADER;
+	}
 	if (size < preamble->preamble_size) {
 		VB2_DEBUG("Not enough data for preamble.\n");
 		return VB2_ERROR_PREAMBLE_SIZE;
@@ -220,7 +286,7 @@ int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 	}
 
 	/* Verify we signed enough data */
-	if (sig->data_size < sizeof(struct vb2_fw_preamble)) {
+	if (sig->data_size < min_size) {
 		VB2_DEBUG("Didn't sign enough data\n");
 		return VB2_ERROR_PREAMBLE_SIGNED_TOO_LITTLE;
 	}
@@ -239,6 +305,16 @@ int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_KERNEL_SUBKEY_OUTSIDE;
 	}
 
+	/* Verify the table of body chunk digests is inside the signed data */
+	if (vb2_fw_get_body_chunk_size(preamble) &&
+	    vb2_verify_member_inside(preamble, sig->data_size,
+				     preamble, sizeof(*preamble),
+				     preamble->body_chunk_digests_offset,
+				     preamble->body_chunk_digests_size)) {
+		VB2_DEBUG("Body chunk digests off end of preamble\n");
+		return VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE;
+	}
+
 	/* Success */
 	return VB2_SUCCESS;
 }
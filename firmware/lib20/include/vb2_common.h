@@ -129,6 +129,33 @@ int vb2_verify_keyblock(struct vb2_keyblock *block,
 			const struct vb2_public_key *key,
 			const struct vb2_workbuf *wb);
 
+/**
+ * Verify a key block using a public key, without modifying it.
+ *
+ * Like vb2_verify_keyblock(), but checks a copy of the signature in the work
+ * buffer, so the key block may be in read-only memory such as memory-mapped
+ * flash.
+ *
+ * @param block		Key block to verify
+ * @param size		Size of key block buffer
+ * @param key		Key to use to verify block
+ * @param wb		Work buffer.  Must be at least
+ *			VB2_MAPPED_KEY_BLOCK_VERIFY_WORKBUF_BYTES bytes.
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+int vb2_verify_mapped_keyblock(const struct vb2_keyblock *block,
+			       uint32_t size,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb);
+
+/*
+ * Size of work buffer sufficient for vb2_verify_mapped_keyblock() worst case:
+ * a copy of an RSA-8192 signature, then vb2_verify_keyblock()'s needs.
+ */
+#define VB2_MAPPED_KEY_BLOCK_VERIFY_WORKBUF_BYTES			\
+	(VB2_KEY_BLOCK_VERIFY_WORKBUF_BYTES +				\
+	 sizeof(struct vb2_signature) + 1024 + VB2_WORKBUF_ALIGN)
+
 /**
  * Verify a key block using its hash.
  *
@@ -177,6 +204,17 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 			       const struct vb2_public_key *key,
 			       const struct vb2_workbuf *wb);
 
+/**
+ * Get the size of the chunks the firmware body is hashed in.
+ *
+ * If non-zero, body_signature signs the table of chunk digests in the
+ * preamble, instead of the body.  Old preamble versions (<2.2) return 0.
+ *
+ * @param preamble	Preamble to check
+ * @return Chunk size in bytes, or 0 if the body is hashed as a whole.
+ */
+uint32_t vb2_fw_get_body_chunk_size(const struct vb2_fw_preamble *preamble);
+
 /**
  * Retrieve the 16-bit vmlinuz header address and size from the preamble.
  *
@@ -199,4 +237,147 @@ void vb2_kernel_get_vmlinuz_header(const struct vb2_kernel_preamble *preamble,
  */
 uint32_t vb2_kernel_get_flags(const struct vb2_kernel_preamble *preamble);
 
+/**
+ * Get the size of the chunks the kernel body is hashed in.
+ *
+ * If non-zero, body_signature signs the table of chunk digests in the
+ * preamble, instead of the body.
+ *
+ * @param preamble	Preamble to check
+ * @return Chunk size in bytes, or 0 if the body is hashed as a whole.  Old
+ * preamble versions (<2.3) return 0.
+ */
+uint32_t vb2_kernel_get_body_chunk_size(
+		const struct vb2_kernel_preamble *preamble);
+
+/**
+ * Get the number of chunks the kernel body is hashed in.
+ *
+ * @param preamble	Preamble to check
+ * @return Number of chunks, or 0 if the body is hashed as a whole.
+ */
+uint32_t vb2_kernel_get_body_chunk_count(
+		const struct vb2_kernel_preamble *preamble);
+
+/**
+ * Get how the kernel body is compressed.
+ *
+ * Signatures and chunk digests always cover the body as stored, so a
+ * compressed body is verified before it is decompressed.
+ *
+ * @param preamble	Preamble to check
+ * @return The enum vb2_kernel_compression of the body.  Old preamble versions
+ * (<2.4) return VB2_KERNEL_COMPRESSION_NONE.
+ */
+uint32_t vb2_kernel_get_body_compression(
+		const struct vb2_kernel_preamble *preamble);
+
+/**
+ * Get the size of the kernel body once it is decompressed.
+ *
+ * @param preamble	Preamble to check
+ * @return Size in bytes of the body as loaded, which is the signed size if
+ * the body isn't compressed.
+ */
+uint32_t vb2_kernel_get_body_size(const struct vb2_kernel_preamble *preamble);
+
+/**
+ * Check one chunk of a kernel body against its digest in the preamble.
+ *
+ * The preamble must have been verified by vb2_verify_kernel_preamble(), which
+ * checks the table of chunk digests is signed.  Chunks are hashed in
+ * software, and the preamble isn't changed, so chunks may be checked in any
+ * order, or on several cores at once.
+ *
+ * @param preamble	Verified kernel preamble
+ * @param hash_alg	Hash algorithm of the data key
+ * @param index		Index of the chunk in the body
+ * @param buf		Chunk data
+ * @param size		Size of chunk data in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_kernel_check_body_chunk(const struct vb2_kernel_preamble *preamble,
+				enum vb2_hash_algorithm hash_alg,
+				uint32_t index,
+				const uint8_t *buf,
+				uint32_t size);
+
+/**
+ * Verify the body signature of a kernel body hashed in chunks.
+ *
+ * The body signature signs the table of chunk digests; each chunk must still
+ * be checked with vb2_kernel_check_body_chunk().  Note that this destroys the
+ * body signature.
+ *
+ * @param preamble	Verified kernel preamble
+ * @param key		Key to use to verify the signature
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_kernel_verify_body_chunks(struct vb2_kernel_preamble *preamble,
+				  const struct vb2_public_key *key,
+				  const struct vb2_workbuf *wb);
+
+/**
+ * Verify a kernel body in memory against its preamble.
+ *
+ * Handles both bodies signed as a whole and bodies hashed in chunks.  Note
+ * that this destroys the body signature.
+ *
+ * @param body		Kernel body
+ * @param size		Size of body in bytes; may be more than the size the
+ *			preamble signs.
+ * @param preamble	Verified kernel preamble
+ * @param key		Key to use to verify the body
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_verify_kernel_body(const uint8_t *body,
+			   uint32_t size,
+			   struct vb2_kernel_preamble *preamble,
+			   const struct vb2_public_key *key,
+			   const struct vb2_workbuf *wb);
+
+/**
+ * Initialize a digest context for hashing a kernel body.
+ *
+ * Uses the vb2ex_hwcrypto_digest_*() hooks if the platform supports them for
+ * the hash algorithm, unless the preamble has the
+ * VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO flag; otherwise, falls back to
+ * vb2_digest_init().  Use vb2_kernel_digest_extend() and
+ * vb2_kernel_digest_finalize() with the returned context.
+ *
+ * @param dc		Digest context to initialize
+ * @param preamble	Kernel preamble for the body
+ * @param hash_alg	Hash algorithm to use
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_kernel_digest_init(struct vb2_digest_context *dc,
+			   const struct vb2_kernel_preamble *preamble,
+			   enum vb2_hash_algorithm hash_alg);
+
+/**
+ * Extend a digest started by vb2_kernel_digest_init().
+ *
+ * @param dc		Digest context
+ * @param buf		Data to hash
+ * @param size		Length of data in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_kernel_digest_extend(struct vb2_digest_context *dc,
+			     const uint8_t *buf,
+			     uint32_t size);
+
+/**
+ * Finalize a digest started by vb2_kernel_digest_init().
+ *
+ * @param dc		Digest context
+ * @param digest	Destination for digest
+ * @param digest_size	Length of digest buffer in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+int vb2_kernel_digest_finalize(struct vb2_digest_context *dc,
+			       uint8_t *digest,
+			       uint32_t digest_size);
+
 #endif  /* VBOOT_REFERENCE_VB2_COMMON_H_ */
@@ -103,7 +103,7 @@ struct vb2_keyblock {
 
 /* Firmware preamble header */
 #define FIRMWARE_PREAMBLE_HEADER_VERSION_MAJOR 2
-#define FIRMWARE_PREAMBLE_HEADER_VERSION_MINOR 1
+#define FIRMWARE_PREAMBLE_HEADER_VERSION_MINOR 2
 
 /* Flags for vb2_fw_preamble.flags */
 /* Use RO-normal firmware (deprecated; do not use) */
@@ -111,14 +111,16 @@ struct vb2_keyblock {
 /* Do not allow use of any hardware crypto accelerators. */
 #define VB2_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO 0x00000002
 
-/* Premable block for rewritable firmware, vboot1 version 2.1.
+/* Premable block for rewritable firmware, vboot1 version 2.2.
  *
  * The firmware preamble header should be followed by:
  *   1) The kernel_subkey key data, pointed to by kernel_subkey.key_offset.
  *   2) The signature data for the firmware body, pointed to by
  *      body_signature.sig_offset.
- *   3) The signature data for (header + kernel_subkey data + body signature
- *      data), pointed to by preamble_signature.sig_offset.
+ *   3) If the body is hashed in chunks, the table of chunk digests, pointed
+ *      to by body_chunk_digests_offset.
+ *   4) The signature data for (header + kernel_subkey data + body signature
+ *      data + chunk digests), pointed to by preamble_signature.sig_offset.
  */
 struct vb2_fw_preamble {
 	/*
@@ -158,13 +160,35 @@ struct vb2_fw_preamble {
 	 * header version < 2.1.
 	 */
 	uint32_t flags;
+
+	/*
+	 * Fields added in header version 2.2.  You must verify the header
+	 * version before reading these fields!
+	 */
+
+	/*
+	 * If non-zero, the firmware body is hashed in chunks of this many
+	 * bytes (the last chunk may be shorter), and body_signature signs the
+	 * table of chunk digests instead of the body itself.  That lets the
+	 * chunks be hashed in parallel, or checked only when they are used.
+	 * Readers should return 0 for header version < 2.2.
+	 */
+	uint32_t body_chunk_size;
+
+	/*
+	 * Offset from the start of the preamble and size of the table of chunk
+	 * digests, using the hash algorithm of the data key.
+	 */
+	uint32_t body_chunk_digests_offset;
+	uint32_t body_chunk_digests_size;
 } __attribute__((packed));
 
-#define EXPECTED_VB2_FW_PREAMBLE_SIZE 108
+#define EXPECTED_VB2_FW_PREAMBLE_2_1_SIZE 108
+#define EXPECTED_VB2_FW_PREAMBLE_SIZE 120
 
 /* Kernel preamble header */
 #define KERNEL_PREAMBLE_HEADER_VERSION_MAJOR 2
-#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 2
+#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 4
 
 /* Flags for vb2_kernel_preamble.flags */
 /* Kernel image type = bits 1:0 */
@@ -172,17 +196,30 @@ struct vb2_fw_preamble {
 #define VB2_KERNEL_PREAMBLE_KERNEL_TYPE_CROS      0
 #define VB2_KERNEL_PREAMBLE_KERNEL_TYPE_BOOTIMG   1
 #define VB2_KERNEL_PREAMBLE_KERNEL_TYPE_MULTIBOOT 2
+/* Do not allow use of any hardware crypto accelerators for the body. */
+#define VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO 0x00000004
 /* Kernel type 3 is reserved for future use */
 
+/* Values for vb2_kernel_preamble.body_compression */
+enum vb2_kernel_compression {
+	/* Body is stored as it is loaded */
+	VB2_KERNEL_COMPRESSION_NONE = 0,
+
+	/* Body is stored as a single LZ4 block (see 2lz4.h) */
+	VB2_KERNEL_COMPRESSION_LZ4 = 1,
+};
+
 /*
- * Preamble block for kernel, version 2.2
+ * Preamble block for kernel, version 2.4
  *
  * This should be followed by:
  *   1) The signature data for the kernel body, pointed to by
  *      body_signature.sig_offset.
- *   2) The signature data for (vb2_kernel_preamble + body signature data),
- *       pointed to by preamble_signature.sig_offset.
- *   3) The 16-bit vmlinuz header, which is used for reconstruction of
+ *   2) If the body is hashed in chunks, the table of chunk digests, pointed
+ *      to by body_chunk_digests_offset.
+ *   3) The signature data for (vb2_kernel_preamble + body signature data +
+ *      chunk digests), pointed to by preamble_signature.sig_offset.
+ *   4) The 16-bit vmlinuz header, which is used for reconstruction of
  *      vmlinuz image.
  */
 struct vb2_kernel_preamble {
@@ -253,10 +290,50 @@ struct vb2_kernel_preamble {
 	 * header version < 2.2.
 	 */
 	uint32_t flags;
+
+	/*
+	 * Fields added in header version 2.3.  You must verify the header
+	 * version before reading these fields!
+	 */
+
+	/*
+	 * If non-zero, the kernel body is hashed in chunks of this many bytes
+	 * (the last chunk may be shorter), and body_signature signs the table
+	 * of chunk digests instead of the body itself.  That lets the chunks
+	 * be hashed in parallel, or as they arrive from storage.  Readers
+	 * should return 0 for header version < 2.3.
+	 */
+	uint32_t body_chunk_size;
+
+	/*
+	 * Offset from the start of the preamble and size of the table of chunk
+	 * digests, using the hash algorithm of the data key.
+	 */
+	uint32_t body_chunk_digests_offset;
+	uint32_t body_chunk_digests_size;
+
+	/*
+	 * Fields added in header version 2.4.  You must verify the header
+	 * version before reading these fields!
+	 */
+
+	/*
+	 * How the kernel body is compressed on disk (enum
+	 * vb2_kernel_compression).  If it is compressed, body_signature and
+	 * any chunk digests are of the body_signature.data_size compressed
+	 * bytes, which are decompressed to body_uncompressed_size bytes at
+	 * body_load_address.  The bootloader and vmlinuz header addresses are
+	 * in the decompressed body.  Readers should return
+	 * VB2_KERNEL_COMPRESSION_NONE for header version < 2.4.
+	 */
+	uint32_t body_compression;
+	uint32_t body_uncompressed_size;
 } __attribute__((packed));
 
 #define EXPECTED_VB2_KERNEL_PREAMBLE_2_0_SIZE 96
 #define EXPECTED_VB2_KERNEL_PREAMBLE_2_1_SIZE 112
 #define EXPECTED_VB2_KERNEL_PREAMBLE_2_2_SIZE 116
+#define EXPECTED_VB2_KERNEL_PREAMBLE_2_3_SIZE 128
+#define EXPECTED_VB2_KERNEL_PREAMBLE_2_4_SIZE 136
 
 #endif  /* VBOOT_REFERENCE_VB2_STRUCT_H_ */
@@ -7,6 +7,7 @@
 
 #include "2common.h"
 #include "2sysincludes.h"
+#include "2api.h"
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "2rsa.h"
@@ -65,7 +66,8 @@ int vb2_verify_keyblock_hash(const struct vb2_keyblock *block,
 		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
 
 	/* Hashing requires temp space for the context */
-	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	dc = vb2_workbuf_alloc(&wblocal,
+			       vb2_digest_context_size(VB2_HASH_SHA512));
 	if (!dc)
 		return VB2_ERROR_VDATA_WORKBUF_HASHING;
 
@@ -109,8 +111,11 @@ int vb2_load_kernel_keyblock(struct vb2_context *ctx)
 	int need_keyblock_valid = vb2_need_signed_kernel(ctx);
 	int keyblock_is_valid = 1;
 
+	uint32_t start_us = vb2ex_utime();
+	uint32_t crypto_start_us, hashed;
 	int rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_KERNEL_VBLOCK);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/*
@@ -154,17 +159,24 @@ int vb2_load_kernel_keyblock(struct vb2_context *ctx)
 		return rv;
 
 	/* Verify the keyblock */
+	crypto_start_us = vb2ex_utime();
+	hashed = kb->keyblock_signature.data_size;
+	vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_BEGIN);
 	rv = vb2_verify_keyblock(kb, block_size, &kernel_key, &wb);
+	vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_END);
 	if (rv) {
 		keyblock_is_valid = 0;
-		if (need_keyblock_valid)
-			return rv;
 
 		/* Signature is invalid, but hash may be fine */
-		rv = vb2_verify_keyblock_hash(kb, block_size, &wb);
-		if (rv)
-			return rv;
+		if (!need_keyblock_valid) {
+			hashed += kb->keyblock_hash.data_size;
+			rv = vb2_verify_keyblock_hash(kb, block_size, &wb);
+		}
 	}
+	vb2_cost_add(ctx, VB2_COST_KERNEL_KEYBLOCK, start_us, crypto_start_us,
+		     hashed);
+	if (rv)
+		return rv;
 
 	/* Check the key block flags against the current boot mode */
 	if (!(kb->keyblock_flags &
@@ -265,7 +277,11 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_HEADER_VERSION;
 	}
 
-	if (preamble->header_version_minor >= 2)
+	if (preamble->header_version_minor >= 4)
+		min_size = EXPECTED_VB2_KERNEL_PREAMBLE_2_4_SIZE;
+	else if (preamble->header_version_minor == 3)
+		min_size = EXPECTED_VB2_KERNEL_PREAMBLE_2_3_SIZE;
+	else if (preamble->header_version_minor == 2)
 		min_size = EXPECTED_VB2_KERNEL_PREAMBLE_2_2_SIZE;
 	else if (preamble->header_version_minor == 1)
 		min_size = EXPECTED_VB2_KERNEL_PREAMBLE_2_1_SIZE;
@@ -309,9 +325,19 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_BODY_SIG_OUTSIDE;
 	}
 
+	/* Make sure we know how to decompress the body */
+	switch (vb2_kernel_get_body_compression(preamble)) {
+	case VB2_KERNEL_COMPRESSION_NONE:
+	case VB2_KERNEL_COMPRESSION_LZ4:
+		break;
+	default:
+		VB2_DEBUG("Unknown kernel body compression\n");
+		return VB2_ERROR_PREAMBLE_BODY_COMPRESSION;
+	}
+
 	/*
 	 * If bootloader is present, verify it's covered by the body
-	 * signature.
+	 * signature.  Its address is in the body once decompressed.
 	 */
 	if (preamble->bootloader_size) {
 		const void *body_ptr =
@@ -319,7 +345,7 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 		const void *bootloader_ptr =
 			(const void *)(uintptr_t)preamble->bootloader_address;
 		if (vb2_verify_member_inside(body_ptr,
-					     preamble->body_signature.data_size,
+					     vb2_kernel_get_body_size(preamble),
 					     bootloader_ptr,
 					     preamble->bootloader_size,
 					     0, 0)) {
@@ -339,7 +365,7 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 		const void *vmlinuz_header_ptr = (const void *)
 			(uintptr_t)preamble->vmlinuz_header_address;
 		if (vb2_verify_member_inside(body_ptr,
-					     preamble->body_signature.data_size,
+					     vb2_kernel_get_body_size(preamble),
 					     vmlinuz_header_ptr,
 					     preamble->vmlinuz_header_size,
 					     0, 0)) {
@@ -348,6 +374,31 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 		}
 	}
 
+	/*
+	 * If the body is hashed in chunks, verify the table of chunk digests
+	 * is signed, and has one digest per chunk.
+	 */
+	if (vb2_kernel_get_body_chunk_size(preamble)) {
+		uint32_t chunk_size = preamble->body_chunk_size;
+		uint32_t body_size = preamble->body_signature.data_size;
+		uint64_t count = body_size / chunk_size +
+			(body_size % chunk_size ? 1 : 0);
+
+		if (vb2_verify_member_inside(preamble, sig->data_size,
+					     preamble, sizeof(*preamble),
+					     preamble->body_chunk_digests_offset,
+					     preamble->body_chunk_digests_size)) {
+			VB2_DEBUG("Body chunk digests off end of preamble\n");
+			return VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE;
+		}
+
+		if (count * vb2_digest_size(key->hash_alg) !=
+		    preamble->body_chunk_digests_size) {
+			VB2_DEBUG("Wrong size table of body chunk digests\n");
+			return VB2_ERROR_PREAMBLE_BODY_CHUNKS_SIZE;
+		}
+	}
+
 	/* Success */
 	return VB2_SUCCESS;
 }
@@ -367,6 +418,8 @@ int vb2_load_kernel_preamble(struct vb2_context *ctx)
 	struct vb2_kernel_preamble *pre;
 	uint32_t pre_size;
 
+	uint32_t start_us = vb2ex_utime();
+	uint32_t crypto_start_us;
 	int rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
@@ -412,7 +465,12 @@ int vb2_load_kernel_preamble(struct vb2_context *ctx)
 	 */
 
 	/* Verify the preamble */
+	crypto_start_us = vb2ex_utime();
+	vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_BEGIN);
 	rv = vb2_verify_kernel_preamble(pre, pre_size, &data_key, &wb);
+	vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_END);
+	vb2_cost_add(ctx, VB2_COST_KERNEL_PREAMBLE, start_us, crypto_start_us,
+		     pre->preamble_signature.data_size);
 	if (rv)
 		return rv;
 
@@ -478,3 +536,178 @@ uint32_t vb2_kernel_get_flags(const struct vb2_kernel_preamble *preamble)
 
 	return preamble->flags;
 }
+
+uint32_t vb2_kernel_get_body_chunk_size(
+		const struct vb2_kernel_preamble *preamble)
+{
+	if (preamble->header_version_minor < 3)
+		return 0;
+
+	return preamble->body_chunk_size;
+}
+
+uint32_t vb2_kernel_get_body_compression(
+		const struct vb2_kernel_preamble *preamble)
+{
+	if (preamble->header_version_minor < 4)
+		return VB2_KERNEL_COMPRESSION_NONE;
+
+	return preamble->body_compression;
+}
+
+uint32_t vb2_kernel_get_body_size(const struct vb2_kernel_preamble *preamble)
+{
+	if (vb2_kernel_get_body_compression(preamble) ==
+	    VB2_KERNEL_COMPRESSION_NONE)
+		return preamble->body_signature.data_size;
+
+	return preamble->body_uncompressed_size;
+}
+
+uint32_t vb2_kernel_get_body_chunk_count(
+		const struct vb2_kernel_preamble *preamble)
+{
+	uint32_t chunk_size = vb2_kernel_get_body_chunk_size(preamble);
+	uint32_t body_size = preamble->body_signature.data_size;
+
+	if (!chunk_size)
+		return 0;
+
+	return body_size / chunk_size + (body_size % chunk_size ? 1 : 0);
+}
+
+int vb2_kernel_check_body_chunk(const struct vb2_kernel_preamble *preamble,
+				enum vb2_hash_algorithm hash_alg,
+				uint32_t index,
+				const uint8_t *buf,
+				uint32_t size)
+{
+	uint32_t chunk_size = vb2_kernel_get_body_chunk_size(preamble);
+	uint32_t digest_size = vb2_digest_size(hash_alg);
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t expect_size;
+	const uint8_t *expect;
+	int rv;
+
+	if (!chunk_size)
+		return VB2_ERROR_API_BODY_NOT_CHUNKED;
+
+	if (index >= vb2_kernel_get_body_chunk_count(preamble))
+		return VB2_ERROR_API_BODY_CHUNK_INDEX;
+
+	/* The last chunk has whatever is left of the body */
+	expect_size = preamble->body_signature.data_size - index * chunk_size;
+	if (expect_size > chunk_size)
+		expect_size = chunk_size;
+	if (size != expect_size)
+		return VB2_ERROR_API_BODY_CHUNK_SIZE;
+
+	rv = vb2_digest_buffer(buf, size, hash_alg, digest, digest_size);
+	if (rv)
+		return rv;
+
+	expect = (const uint8_t *)preamble +
+		preamble->body_chunk_digests_offset + index * digest_size;
+	if (vb2_safe_memcmp(digest, expect, digest_size))
+		return VB2_ERROR_API_BODY_CHUNK_DIGEST;
+
+	return VB2_SUCCESS;
+}
+
+int vb2_kernel_verify_body_chunks(struct vb2_kernel_preamble *preamble,
+				  const struct vb2_public_key *key,
+				  const struct vb2_workbuf *wb)
+{
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	int rv;
+
+	rv = vb2_digest_buffer((const uint8_t *)preamble +
+			       preamble->body_chunk_digests_offset,
+			       preamble->body_chunk_digests_size,
+			       key->hash_alg, digest, digest_size);
+	if (rv)
+		return rv;
+
+	return vb2_verify_digest(key, &preamble->body_signature, digest, wb);
+}
+
+int vb2_verify_kernel_body(const uint8_t *body,
+			   uint32_t size,
+			   struct vb2_kernel_preamble *preamble,
+			   const struct vb2_public_key *key,
+			   const struct vb2_workbuf *wb)
+{
+	uint32_t chunk_size = vb2_kernel_get_body_chunk_size(preamble);
+	uint32_t count = vb2_kernel_get_body_chunk_count(preamble);
+	uint32_t body_size = preamble->body_signature.data_size;
+	uint32_t i, n;
+	int rv;
+
+	if (!chunk_size)
+		return vb2_verify_data(body, size, &preamble->body_signature,
+				       key, wb);
+
+	if (body_size > size)
+		return VB2_ERROR_VDATA_NOT_ENOUGH_DATA;
+
+	for (i = 0; i < count; i++) {
+		n = body_size - i * chunk_size;
+		if (n > chunk_size)
+			n = chunk_size;
+		rv = vb2_kernel_check_body_chunk(preamble, key->hash_alg, i,
+						 body + i * chunk_size, n);
+		if (rv)
+			return rv;
+	}
+
+	return vb2_kernel_verify_body_chunks(preamble, key, wb);
+}
+
+int vb2_kernel_digest_init(struct vb2_digest_context *dc,
+			   const struct vb2_kernel_preamble *preamble,
+			   enum vb2_hash_algorithm hash_alg)
+{
+	int rv;
+
+	if (!(vb2_kernel_get_flags(preamble) &
+	      VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO)) {
+		rv = vb2ex_hwcrypto_digest_init(
+				hash_alg, preamble->body_signature.data_size);
+		if (!rv) {
+			VB2_DEBUG("Using HW crypto engine for hash_alg %d\n",
+				  hash_alg);
+			dc->hash_alg = hash_alg;
+			dc->using_hwcrypto = 1;
+			return VB2_SUCCESS;
+		}
+		if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED)
+			return rv;
+		VB2_DEBUG("HW crypto for hash_alg %d not supported, using SW\n",
+			  hash_alg);
+	} else {
+		VB2_DEBUG("HW crypto forbidden by preamble, using SW\n");
+	}
+
+	return vb2_digest_init(dc, hash_alg);
+}
+
+int vb2_kernel_digest_extend(struct vb2_digest_context *dc,
+			     const uint8_t *buf,
+			     uint32_t size)
+{
+	if (dc->using_hwcrypto)
+		return vb2ex_hwcrypto_digest_extend(buf, size);
+	else
+		return vb2_digest_extend(dc, buf, size);
+}
+
+int vb2_kernel_digest_finalize(struct vb2_digest_context *dc,
+			       uint8_t *digest,
+			       uint32_t digest_size)
+{
+	if (dc->using_hwcrypto)
+		return vb2ex_hwcrypto_digest_finalize(digest, digest_size);
+	else
+		return vb2_digest_finalize(dc, digest, digest_size);
+}
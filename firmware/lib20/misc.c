@@ -65,6 +65,147 @@ static void vb2_report_dev_firmware(struct vb2_public_key *root)
 		VB2_DEBUG("This is developer signed firmware\n");
 }
 
+/*
+ * SHA-256 of one or two pieces of the firmware vblock, for the warm boot
+ * record.
+ */
+static int warm_boot_digest(const void *buf1, uint32_t size1,
+			    const void *buf2, uint32_t size2,
+			    uint8_t *digest)
+{
+	struct vb2_digest_context dc;
+	int rv;
+
+	rv = vb2_digest_init(&dc, VB2_HASH_SHA256);
+	if (!rv)
+		rv = vb2_digest_extend(&dc, buf1, size1);
+	if (!rv && size2)
+		rv = vb2_digest_extend(&dc, buf2, size2);
+	if (!rv)
+		rv = vb2_digest_finalize(&dc, digest, VB2_SHA256_DIGEST_SIZE);
+	return rv;
+}
+
+int vb2_get_warm_boot_record(struct vb2_context *ctx,
+			     struct vb2_warm_boot_record *rec)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	uint8_t nonce[VB2_WARM_BOOT_NONCE_SIZE];
+	uint32_t count;
+	int rv;
+
+	rv = vb2ex_warm_boot_state(nonce, &count);
+	if (rv)
+		return rv;
+
+	rv = vb2ex_warm_boot_record_read(rec);
+	if (rv)
+		return rv;
+
+	if (rec->magic != VB2_WARM_BOOT_RECORD_MAGIC ||
+	    rec->fw_slot != sd->fw_slot ||
+	    rec->flash_write_count != count ||
+	    vb2_safe_memcmp(rec->boot_nonce, nonce, sizeof(nonce)))
+		return VB2_ERROR_FW_WARM_BOOT_STALE;
+
+	return VB2_SUCCESS;
+}
+
+int vb2_check_warm_boot_body(struct vb2_context *ctx,
+			     const uint8_t *digest,
+			     uint32_t digest_size)
+{
+	struct vb2_warm_boot_record rec;
+	int rv;
+
+	if (digest_size > sizeof(rec.body_digest))
+		return VB2_ERROR_FW_WARM_BOOT_MISMATCH;
+
+	rv = vb2_get_warm_boot_record(ctx, &rec);
+	if (rv)
+		return rv;
+
+	if (vb2_safe_memcmp(rec.body_digest, digest, digest_size))
+		return VB2_ERROR_FW_WARM_BOOT_MISMATCH;
+
+	return VB2_SUCCESS;
+}
+
+int vb2_save_warm_boot_record(struct vb2_context *ctx,
+			      const uint8_t *digest,
+			      uint32_t digest_size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_warm_boot_record rec;
+	uint32_t flash_write_count;
+	int rv;
+
+	if (digest_size > sizeof(rec.body_digest))
+		return VB2_ERROR_FW_WARM_BOOT_MISMATCH;
+
+	memset(&rec, 0, sizeof(rec));
+	rv = vb2ex_warm_boot_state(rec.boot_nonce, &flash_write_count);
+	if (rv)
+		return rv;
+
+	rec.magic = VB2_WARM_BOOT_RECORD_MAGIC;
+	rec.flash_write_count = flash_write_count;
+	rec.fw_slot = sd->fw_slot;
+	memcpy(rec.keyblock_digest, sd->warm_boot_keyblock_digest,
+	       sizeof(rec.keyblock_digest));
+	memcpy(rec.preamble_digest, sd->warm_boot_preamble_digest,
+	       sizeof(rec.preamble_digest));
+	memcpy(rec.body_digest, digest, digest_size);
+
+	return vb2ex_warm_boot_record_write(&rec);
+}
+
+/*
+ * Hash the root key and keyblock for the warm boot record, and note whether
+ * they're the ones verified earlier this power cycle.
+ */
+static void warm_boot_keyblock(struct vb2_context *ctx,
+			       const uint8_t *key_data, uint32_t key_size,
+			       const struct vb2_keyblock *kb,
+			       uint32_t block_size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_warm_boot_record rec;
+
+	if (warm_boot_digest(key_data, key_size, kb, block_size,
+			     sd->warm_boot_keyblock_digest))
+		return;
+
+	if (vb2_get_warm_boot_record(ctx, &rec))
+		return;
+
+	if (!vb2_safe_memcmp(rec.keyblock_digest,
+			     sd->warm_boot_keyblock_digest,
+			     sizeof(rec.keyblock_digest)))
+		sd->status |= VB2_SD_STATUS_WARM_BOOT_MATCH;
+}
+
+/*
+ * Likewise for the preamble.  Only a preamble under a matching keyblock can
+ * match.
+ */
+static void warm_boot_preamble(struct vb2_context *ctx,
+			       const struct vb2_fw_preamble *pre,
+			       uint32_t pre_size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_warm_boot_record rec;
+
+	if (warm_boot_digest(pre, pre_size, NULL, 0,
+			     sd->warm_boot_preamble_digest) ||
+	    !(sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH) ||
+	    vb2_get_warm_boot_record(ctx, &rec) ||
+	    vb2_safe_memcmp(rec.preamble_digest,
+			    sd->warm_boot_preamble_digest,
+			    sizeof(rec.preamble_digest)))
+		sd->status &= ~VB2_SD_STATUS_WARM_BOOT_MATCH;
+}
+
 int vb2_load_fw_keyblock(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -76,11 +217,16 @@ int vb2_load_fw_keyblock(struct vb2_context *ctx)
 	struct vb2_packed_key *packed_key;
 	struct vb2_public_key root_key;
 
-	struct vb2_keyblock *kb;
+	const struct vb2_keyblock *kb;
+	struct vb2_keyblock *kb_buf;
 	uint32_t block_size;
+	const void *map;
 
+	uint32_t start_us = vb2ex_utime();
+	uint32_t crypto_start_us, hashed = 0;
 	int rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_KEYBLOCK);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Read the root key */
@@ -102,37 +248,87 @@ int vb2_load_fw_keyblock(struct vb2_context *ctx)
 	/* If that's the checked-in root key, this is dev-signed firmware */
 	vb2_report_dev_firmware(&root_key);
 
-	/* Load the firmware keyblock header after the root key */
-	kb = vb2_workbuf_alloc(&wb, sizeof(*kb));
-	if (!kb)
-		return VB2_ERROR_FW_KEYBLOCK_WORKBUF_HEADER;
+	/*
+	 * If the platform can map the vblock, use the keyblock where it is.
+	 * Since the platform keeps it from changing, the signature checked
+	 * below covers every field used after it.  The mapping may be
+	 * read-only flash, so it's never written to.
+	 */
+	kb = NULL;
+	kb_buf = NULL;
+	map = NULL;
+	if (!vb2ex_map_resource(ctx, VB2_RES_FW_VBLOCK, 0, sizeof(*kb),
+				&map)) {
+		block_size = ((const struct vb2_keyblock *)map)->keyblock_size;
+		if (!vb2ex_map_resource(ctx, VB2_RES_FW_VBLOCK, 0, block_size,
+					&map))
+			kb = map;
+	}
 
-	rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK, 0, kb, sizeof(*kb));
-	if (rv)
-		return rv;
+	if (!kb) {
+		/* Load the firmware keyblock header after the root key */
+		kb_buf = vb2_workbuf_alloc(&wb, sizeof(*kb_buf));
+		if (!kb_buf)
+			return VB2_ERROR_FW_KEYBLOCK_WORKBUF_HEADER;
+
+		rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK, 0, kb_buf,
+					 sizeof(*kb_buf));
+		if (rv)
+			return rv;
 
-	block_size = kb->keyblock_size;
+		block_size = kb_buf->keyblock_size;
+
+		/*
+		 * Load the entire keyblock, now that we know how big it is.
+		 * Note that we're loading the entire keyblock instead of just
+		 * the piece after the header.  That means we re-read the
+		 * header.  But that's a tiny amount of data, and it makes the
+		 * code much more straightforward.
+		 */
+		kb_buf = vb2_workbuf_realloc(&wb, sizeof(*kb_buf), block_size);
+		if (!kb_buf)
+			return VB2_ERROR_FW_KEYBLOCK_WORKBUF;
+
+		rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK, 0, kb_buf,
+					 block_size);
+		if (rv)
+			return rv;
+
+		kb = kb_buf;
+	}
 
 	/*
-	 * Load the entire keyblock, now that we know how big it is.  Note that
-	 * we're loading the entire keyblock instead of just the piece after
-	 * the header.  That means we re-read the header.  But that's a tiny
-	 * amount of data, and it makes the code much more straightforward.
+	 * A keyblock already verified this power cycle doesn't need its
+	 * signature checked again.
 	 */
-	kb = vb2_workbuf_realloc(&wb, sizeof(*kb), block_size);
-	if (!kb)
-		return VB2_ERROR_FW_KEYBLOCK_WORKBUF;
-
-	rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK, 0, kb, block_size);
-	if (rv)
-		return rv;
+	crypto_start_us = vb2ex_utime();
+	sd->status &= ~VB2_SD_STATUS_WARM_BOOT_MATCH;
+	if (ctx->flags & VB2_CONTEXT_WARM_BOOT_RECORD) {
+		warm_boot_keyblock(ctx, key_data, key_size, kb, block_size);
+		hashed += key_size + block_size;
+	}
 
-	/* Verify the keyblock */
-	rv = vb2_verify_keyblock(kb, block_size, &root_key, &wb);
+	if (sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH) {
+		VB2_DEBUG("Keyblock matches warm boot record\n");
+	} else {
+		/* Verify the keyblock */
+		hashed += kb->keyblock_signature.data_size;
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_BEGIN);
+		if (kb_buf)
+			rv = vb2_verify_keyblock(kb_buf, block_size,
+						 &root_key, &wb);
+		else
+			rv = vb2_verify_mapped_keyblock(kb, block_size,
+							&root_key, &wb);
+		vb2_trace(ctx, VB2_TRACE_KEYBLOCK_VERIFY, VB2_TRACE_END);
+	}
+	vb2_cost_add(ctx, VB2_COST_FW_KEYBLOCK, start_us, crypto_start_us,
+		     hashed);
 	if (rv) {
 		vb2_fail(ctx, VB2_RECOVERY_FW_KEYBLOCK, rv);
 		return rv;
 	}
+	vb2ex_timestamp(VB2_TS_FW_KEYBLOCK_VERIFIED);
 
 	/* Key version is the upper 16 bits of the composite firmware version */
 	if (kb->data_key.key_version > VB2_MAX_KEY_VERSION)
@@ -157,6 +353,16 @@ int vb2_load_fw_keyblock(struct vb2_context *ctx)
 	 */
 	packed_key = (struct vb2_packed_key *)key_data;
 
+	/*
+	 * A keyblock read into the work buffer follows the root key, so the
+	 * data key always has room to spread into it.  A mapped one doesn't,
+	 * so make sure the root key's space is big enough.
+	 */
+	if (kb == map &&
+	    !vb2_workbuf_realloc(&wb, key_size, packed_key->key_offset +
+				 kb->data_key.key_size))
+		return VB2_ERROR_FW_KEYBLOCK_WORKBUF;
+
 	packed_key->algorithm = kb->data_key.algorithm;
 	packed_key->key_version = kb->data_key.key_version;
 	packed_key->key_size = kb->data_key.key_size;
@@ -168,7 +374,7 @@ int vb2_load_fw_keyblock(struct vb2_context *ctx)
 	 * being paranoid.
 	 */
 	memmove(key_data + packed_key->key_offset,
-		(uint8_t*)&kb->data_key + kb->data_key.key_offset,
+		(const uint8_t *)&kb->data_key + kb->data_key.key_offset,
 		packed_key->key_size);
 
 	/* Save the packed key offset and size */
@@ -205,9 +411,13 @@ int vb2_load_fw_preamble(struct vb2_context *ctx)
 	/* Preamble goes in the next unused chunk of work buffer */
 	struct vb2_fw_preamble *pre;
 	uint32_t pre_size;
+	const void *map;
 
+	uint32_t start_us = vb2ex_utime();
+	uint32_t crypto_start_us, hashed = 0;
 	int rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_PREAMBLE);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Unpack the firmware data key */
@@ -218,38 +428,79 @@ int vb2_load_fw_preamble(struct vb2_context *ctx)
 	if (rv)
 		return rv;
 
-	/* Load the firmware preamble header */
-	pre = vb2_workbuf_alloc(&wb, sizeof(*pre));
-	if (!pre)
-		return VB2_ERROR_FW_PREAMBLE2_WORKBUF_HEADER;
-
-	rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
-				 sd->vblock_preamble_offset,
-				 pre, sizeof(*pre));
-	if (rv)
-		return rv;
+	/*
+	 * If the platform can map the vblock, copy the preamble into the work
+	 * buffer straight from it.  The preamble stays in the work buffer, so
+	 * it's verified from there either way.
+	 */
+	pre_size = 0;
+	if (!vb2ex_map_resource(ctx, VB2_RES_FW_VBLOCK,
+				sd->vblock_preamble_offset, sizeof(*pre), &map))
+		pre_size = ((const struct vb2_fw_preamble *)map)->preamble_size;
+
+	if (pre_size && !vb2ex_map_resource(ctx, VB2_RES_FW_VBLOCK,
+					    sd->vblock_preamble_offset,
+					    pre_size, &map)) {
+		pre = vb2_workbuf_alloc(&wb, pre_size);
+		if (!pre)
+			return VB2_ERROR_FW_PREAMBLE2_WORKBUF;
+
+		memcpy(pre, map, pre_size);
+	} else {
+		/* Load the firmware preamble header */
+		pre = vb2_workbuf_alloc(&wb, sizeof(*pre));
+		if (!pre)
+			return VB2_ERROR_FW_PREAMBLE2_WORKBUF_HEADER;
+
+		rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
+					 sd->vblock_preamble_offset,
+					 pre, sizeof(*pre));
+		if (rv)
+			return rv;
 
-	pre_size = pre->preamble_size;
+		pre_size = pre->preamble_size;
 
-	/* Load the entire firmware preamble, now that we know how big it is */
-	pre = vb2_workbuf_realloc(&wb, sizeof(*pre), pre_size);
-	if (!pre)
-		return VB2_ERROR_FW_PREAMBLE2_WORKBUF;
+		/*
+		 * Load the entire firmware preamble, now that we know how big
+		 * it is.
+		 */
+		pre = vb2_workbuf_realloc(&wb, sizeof(*pre), pre_size);
+		if (!pre)
+			return VB2_ERROR_FW_PREAMBLE2_WORKBUF;
 
-	rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
-				 sd->vblock_preamble_offset,
-				 pre, pre_size);
-	if (rv)
-		return rv;
+		rv = vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
+					 sd->vblock_preamble_offset,
+					 pre, pre_size);
+		if (rv)
+			return rv;
+	}
 
 	/* Work buffer now contains the data subkey data and the preamble */
 
-	/* Verify the preamble */
-	rv = vb2_verify_fw_preamble(pre, pre_size, &data_key, &wb);
+	crypto_start_us = vb2ex_utime();
+	if (ctx->flags & VB2_CONTEXT_WARM_BOOT_RECORD) {
+		warm_boot_preamble(ctx, pre, pre_size);
+		hashed += pre_size;
+	} else {
+		sd->status &= ~VB2_SD_STATUS_WARM_BOOT_MATCH;
+	}
+
+	if (sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH) {
+		VB2_DEBUG("Preamble matches warm boot record\n");
+	} else {
+		/* Verify the preamble */
+		hashed += pre->preamble_signature.data_size;
+		vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_BEGIN);
+		rv = vb2_verify_fw_preamble(pre, pre_size, &data_key, &wb);
+		vb2_trace(ctx, VB2_TRACE_PREAMBLE_VERIFY, VB2_TRACE_END);
+	}
+	vb2_cost_add(ctx, VB2_COST_FW_PREAMBLE, start_us, crypto_start_us,
+		     hashed);
 	if (rv) {
 		vb2_fail(ctx, VB2_RECOVERY_FW_PREAMBLE, rv);
 		return rv;
 	}
+	vb2ex_timestamp(VB2_TS_FW_PREAMBLE_VERIFIED);
 
 	/*
 	 * Firmware version is the lower 16 bits of the composite firmware
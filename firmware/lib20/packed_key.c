@@ -26,6 +26,9 @@ int vb2_unpack_key_buffer(struct vb2_public_key *key,
 	if (rv)
 		return rv;
 
+	/* Only the caller knows if the preamble allows hardware crypto */
+	key->allow_hwcrypto = 0;
+
 	/* Unpack key algorithm */
 	key->sig_alg = vb2_crypto_to_signature(packed_key->algorithm);
 	if (key->sig_alg == VB2_SIG_INVALID) {
@@ -47,8 +47,10 @@ int vb21api_init_hash(struct vb2_context *ctx,
 	struct vb2_digest_context *dc;
 	struct vb2_workbuf wb;
 	uint32_t hash_offset;
+	uint32_t dig_size;
 	int i, rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_HASH);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Get preamble pointer */
@@ -71,13 +73,16 @@ int vb21api_init_hash(struct vb2_context *ctx,
 	if (i >= pre->hash_count)
 		return VB2_ERROR_API_INIT_HASH_ID;  /* No match */
 
-	/* Allocate workbuf space for the hash */
-	if (sd->workbuf_hash_size) {
+	/*
+	 * Allocate workbuf space for the hash, only as big as its algorithm
+	 * needs.  A context from an earlier call is reused if it is big
+	 * enough.
+	 */
+	dig_size = vb2_digest_context_size(sig->hash_alg);
+	if (sd->workbuf_hash_size >= dig_size) {
 		dc = (struct vb2_digest_context *)
 			(ctx->workbuf + sd->workbuf_hash_offset);
 	} else {
-		uint32_t dig_size = sizeof(*dc);
-
 		dc = vb2_workbuf_alloc(&wb, dig_size);
 		if (!dc)
 			return VB2_ERROR_API_INIT_HASH_WORKBUF;
@@ -89,10 +94,15 @@ int vb21api_init_hash(struct vb2_context *ctx,
 
 	sd->hash_tag = vb2_offset_of(ctx->workbuf, sig);
 	sd->hash_remaining_size = sig->data_size;
+	sd->hash_chunk_size = 0;
 
 	if (size)
 		*size = sig->data_size;
 
+	/* Ends in vb21api_check_hash() */
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_BEGIN);
+	vb2ex_timestamp(VB2_TS_FW_BODY_HASH_START);
+
 	if (!(pre->flags & VB21_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO)) {
 		rv = vb2ex_hwcrypto_digest_init(sig->hash_alg, sig->data_size);
 		if (!rv) {
@@ -152,14 +162,18 @@ int vb21api_check_hash(struct vb2_context *ctx)
 		rv = vb2ex_hwcrypto_digest_finalize(digest, digest_size);
 	else
 		rv = vb2_digest_finalize(dc, digest, digest_size);
+	vb2_trace(ctx, VB2_TRACE_BODY_HASH, VB2_TRACE_END);
 	if (rv)
 		return rv;
+	vb2ex_timestamp(VB2_TS_FW_BODY_HASHED);
 
 	/* Compare with the signature */
 	if (vb2_safe_memcmp(digest, (const uint8_t *)sig + sig->sig_offset,
 			    digest_size))
 		return VB2_ERROR_API_CHECK_HASH_SIG;
 
+	vb2ex_timestamp(VB2_TS_FW_BODY_VERIFIED);
+
 	/* TODO: the old check-hash function called vb2_fail() on any mismatch.
 	 * I don't think it should do that; the caller should. */
 
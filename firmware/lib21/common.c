@@ -249,6 +249,17 @@ int vb21_verify_digest(const struct vb2_public_key *key,
 		return VB2_SUCCESS;
 	} else {
 		/* RSA-signed digest */
+		if (key->allow_hwcrypto) {
+			int rv = vb2ex_hwcrypto_rsa_verify_digest(
+					key, vb21_signature_data(sig), digest);
+			if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED) {
+				VB2_DEBUG("Using HW RSA engine for "
+					  "sig_alg %d\n", key->sig_alg);
+				return rv;
+			}
+			VB2_DEBUG("HW RSA for sig_alg %d not supported, "
+				  "using SW\n", key->sig_alg);
+		}
 		return vb2_rsa_verify_digest(key,
 					     vb21_signature_data(sig),
 					     digest, wb);
@@ -265,6 +276,7 @@ int vb21_verify_data(const void *data,
 	struct vb2_digest_context *dc;
 	uint8_t *digest;
 	uint32_t digest_size;
+	uint32_t dc_size;
 	int rv;
 
 	if (sig->data_size != size) {
@@ -282,7 +294,8 @@ int vb21_verify_data(const void *data,
 		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
 
 	/* Hashing requires temp space for the context */
-	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	dc_size = vb2_digest_context_size(key->hash_alg);
+	dc = vb2_workbuf_alloc(&wblocal, dc_size);
 	if (!dc)
 		return VB2_ERROR_VDATA_WORKBUF_HASHING;
 
@@ -298,11 +311,29 @@ int vb21_verify_data(const void *data,
 	if (rv)
 		return rv;
 
-	vb2_workbuf_free(&wblocal, sizeof(*dc));
+	vb2_workbuf_free(&wblocal, dc_size);
 
 	return vb21_verify_digest(key, sig, digest, &wblocal);
 }
 
+int vb21_verify_data_list(struct vb21_signed_data *list,
+			  uint32_t count,
+			  const struct vb2_public_key *key,
+			  const struct vb2_workbuf *wb)
+{
+	int rv = VB2_SUCCESS;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		list[i].result = vb21_verify_data(list[i].data, list[i].size,
+						  list[i].sig, key, wb);
+		if (list[i].result && !rv)
+			rv = list[i].result;
+	}
+
+	return rv;
+}
+
 int vb21_verify_keyblock(struct vb21_keyblock *block,
 			 uint32_t size,
 			 const struct vb2_public_key *key,
@@ -148,6 +148,38 @@ int vb21_verify_data(const void *data,
 		     const struct vb2_public_key *key,
 		     const struct vb2_workbuf *wb);
 
+/* One data buffer and its signature, for vb21_verify_data_list() */
+struct vb21_signed_data {
+	/* Data to verify, and size of data buffer */
+	const void *data;
+	uint32_t size;
+
+	/* Signature of data (destroyed in process) */
+	struct vb21_signature *sig;
+
+	/* Result of verifying this entry */
+	int result;
+};
+
+/**
+ * Verify a list of data buffers, all signed with the same key.
+ *
+ * Each entry is checked as by vb21_verify_data(), and its result stored in
+ * the entry.  The key only needs to be unpacked once for the whole list, and
+ * every entry reuses the same work buffer.
+ *
+ * @param list		Entries to verify
+ * @param count		Number of entries
+ * @param key		Key to use to validate signatures
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS if every entry verified, or the error code of the
+ * first entry which did not.
+ */
+int vb21_verify_data_list(struct vb21_signed_data *list,
+			  uint32_t count,
+			  const struct vb2_public_key *key,
+			  const struct vb2_workbuf *wb);
+
 /**
  * Check the sanity of a key block using a public key.
  *
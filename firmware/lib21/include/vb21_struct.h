@@ -117,6 +117,12 @@ struct vb21_struct_common {
  *     1) vb21_packed_key header struct h
  *     2) Key description (pointed to by h.c.fixed_size)
  *     3) Key data key (pointed to by h.key_offset)
+ *
+ * For RSA keys, the key data is arrsize, n0inv, n[] and rr[] (R^2 mod N), as
+ * unpacked by vb2_unpack_key_data().  That is all the precomputation the
+ * verifier can use: the public exponent is 3 or 65537, so there are no
+ * exponent bits for a window table to save work on, and rr[] read as pairs
+ * of words is already R^2 mod N in 64-bit limbs (see modpow64()).
  */
 struct vb21_packed_key {
 	/* Common header fields */
@@ -34,31 +34,41 @@ static int vb21_read_resource_object(struct vb2_context *ctx,
 				     struct vb2_workbuf *wb,
 				     void **buf_ptr)
 {
-	struct vb21_struct_common c;
-	void *buf;
+	struct vb21_struct_common *c;
+	uint32_t total_size;
 	int rv;
 
 	*buf_ptr = NULL;
 
-	/* Read the common header */
-	rv = vb2ex_read_resource(ctx, index, offset, &c, sizeof(c));
-	if (rv)
-		return rv;
-
-	/* Allocate a buffer for the object, now that we know how big it is */
-	buf = vb2_workbuf_alloc(wb, c.total_size);
-	if (!buf)
+	/* Read the common header straight into the start of the object */
+	c = vb2_workbuf_alloc(wb, sizeof(*c));
+	if (!c)
 		return VB2_ERROR_READ_RESOURCE_OBJECT_BUF;
 
-	/* Read the object */
-	rv = vb2ex_read_resource(ctx, index, offset, buf, c.total_size);
+	rv = vb2ex_read_resource(ctx, index, offset, c, sizeof(*c));
 	if (rv) {
-		vb2_workbuf_free(wb, c.total_size);
+		vb2_workbuf_free(wb, sizeof(*c));
 		return rv;
 	}
 
+	/* Grow the buffer, now that we know how big the object is */
+	total_size = c->total_size;
+	if (!vb2_workbuf_realloc(wb, sizeof(*c), total_size))
+		return VB2_ERROR_READ_RESOURCE_OBJECT_BUF;
+
+	/* Read the rest of the object after the header */
+	if (total_size > sizeof(*c)) {
+		rv = vb2ex_read_resource(ctx, index, offset + sizeof(*c),
+					 (uint8_t *)c + sizeof(*c),
+					 total_size - sizeof(*c));
+		if (rv) {
+			vb2_workbuf_free(wb, total_size);
+			return rv;
+		}
+	}
+
 	/* Save the pointer */
-	*buf_ptr = buf;
+	*buf_ptr = c;
 	return VB2_SUCCESS;
 }
 
@@ -76,6 +86,7 @@ int vb21_load_fw_keyblock(struct vb2_context *ctx)
 
 	int rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_KEYBLOCK);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Read the root key */
@@ -170,6 +181,7 @@ int vb21_load_fw_preamble(struct vb2_context *ctx)
 
 	int rv;
 
+	vb2_set_workbuf_phase(ctx, VB2_WORKBUF_PHASE_FW_PREAMBLE);
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Unpack the firmware data key */
@@ -74,6 +74,9 @@ int vb21_unpack_key(struct vb2_public_key *key,
 	if (pkey->c.struct_version_major != VB21_PACKED_KEY_VERSION_MAJOR)
 		return VB2_ERROR_UNPACK_KEY_STRUCT_VERSION;
 
+	/* Only the caller knows if the preamble allows hardware crypto */
+	key->allow_hwcrypto = 0;
+
 	/* Copy key algorithms */
 	key->hash_alg = pkey->hash_alg;
 	if (!vb2_digest_size(key->hash_alg))
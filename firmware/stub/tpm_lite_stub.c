@@ -18,6 +18,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,10 +31,18 @@
 
 
 #define TPM_DEVICE_PATH "/dev/tpm0"
+/* The kernel's resource manager, which lets TPM clients share the TPM */
+#define TPM_RM_DEVICE_PATH "/dev/tpmrm0"
 /* Retry failed open()s for 5 seconds in 10ms polling intervals. */
 #define OPEN_RETRY_DELAY_NS (10 * 1000 * 1000)
 #define OPEN_RETRY_MAX_NUM  500
 #define COMM_RETRY_MAX_NUM  3
+/*
+ * Give up on a command which hasn't been answered in this long.  Some TPM1
+ * commands (such as TakeOwnership, which makes an RSA key) can take tens of
+ * seconds, so this is generous; set TPM_TIMEOUT_MS to override it.
+ */
+#define COMM_TIMEOUT_MS (2 * 60 * 1000)
 
 /* TODO: these functions should pass errors back rather than returning void */
 /* TODO: if the only callers to these are just wrappers, should just
@@ -46,6 +55,9 @@ static int tpm_fd = -1;
 /* If the library should exit during an OS-level TPM failure.
  */
 static int exit_on_failure = 1;
+/* How long to wait for the TPM, in milliseconds.
+ */
+static int comm_timeout_ms = COMM_TIMEOUT_MS;
 
 /* Similar to VbExError, only handle the non-exit case.
  */
@@ -76,6 +88,57 @@ __attribute__((unused)) static void DbgPrintBytes(const uint8_t* a, int n)
 }
 
 
+/* Returns the current time on the monotonic clock, in milliseconds.
+ */
+static int64_t NowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Waits for the TPM device to be ready for |events|, until |deadline_ms|.
+ * Returns 0 if it is, or -1 with errno set (ETIMEDOUT if time ran out).
+ */
+static int TpmWait(short events, int64_t deadline_ms)
+{
+	struct pollfd pfd = { .fd = tpm_fd, .events = events };
+	int64_t left;
+	int n;
+
+	for (;;) {
+		left = deadline_ms - NowMs();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		n = poll(&pfd, 1, left > INT32_MAX ? INT32_MAX : (int)left);
+		if (n > 0)
+			return 0;
+		if (n < 0 && errno != EINTR)
+			return -1;
+	}
+}
+
+/* Does one write() or read() of the TPM device, waiting for it to be ready
+ * until |deadline_ms|.  Returns the number of bytes transferred, or -1 with
+ * errno set.
+ */
+static ssize_t TpmTransfer(int writing, void *buf, size_t len,
+			   int64_t deadline_ms)
+{
+	ssize_t n;
+
+	for (;;) {
+		if (TpmWait(writing ? POLLOUT : POLLIN, deadline_ms))
+			return -1;
+		n = writing ? write(tpm_fd, buf, len) : read(tpm_fd, buf, len);
+		if (n >= 0 || (errno != EAGAIN && errno != EINTR))
+			return n;
+	}
+}
+
 /* Executes a command on the TPM.
  */
 static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
@@ -91,15 +154,20 @@ static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
 			       "the TPM device was not opened.  " \
 			       "Forgot to call TlclLibInit?\n");
 	} else {
-		int n;
+		int64_t deadline_ms = NowMs() + comm_timeout_ms;
+		/* A buffer big enough for any response can take it directly */
+		int direct = *pout_len >= sizeof(response);
+		uint8_t *buf = direct ? out : response;
+		ssize_t n;
 		int retries = 0;
 		int first_errno = 0;
 
-		/* Write command. Retry in case of communication errors.
+		/* Write command. Retry in case of communication errors,
+		 * but not once the deadline has passed.
 		 */
 		for ( ; retries < COMM_RETRY_MAX_NUM; ++retries) {
-			n = write(tpm_fd, in, in_len);
-			if (n >= 0) {
+			n = TpmTransfer(1, (void *)in, in_len, deadline_ms);
+			if (n >= 0 || errno == ETIMEDOUT) {
 				break;
 			}
 			if (retries == 0) {
@@ -117,15 +185,17 @@ static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
 			return DoError(TPM_E_WRITE_FAILURE,
 				       "bad write size to TPM device: %d vs %u "
 				       "(%d retries, first error %d)\n",
-				       n, in_len, retries, first_errno);
+				       (int)n, in_len, retries, first_errno);
 		}
 
-		/* Read response. Retry in case of communication errors.
+		/* Read response. Retry in case of communication errors,
+		 * but not once the deadline has passed.
 		 */
 		for (retries = 0, first_errno = 0;
 		     retries < COMM_RETRY_MAX_NUM; ++retries) {
-			n = read(tpm_fd, response, sizeof(response));
-			if (n >= 0) {
+			n = TpmTransfer(0, buf, direct ? *pout_len :
+					sizeof(response), deadline_ms);
+			if (n >= 0 || errno == ETIMEDOUT) {
 				break;
 			}
 			if (retries == 0) {
@@ -149,7 +219,8 @@ static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
 					       "output buffer\n");
 			} else {
 				*pout_len = n;
-				memcpy(out, response, n);
+				if (!direct)
+					memcpy(out, response, n);
 			}
 		}
 	}
@@ -179,8 +250,11 @@ static inline int TpmResponseSize(const uint8_t* buffer)
 VbError_t VbExTpmInit(void)
 {
 	char *no_exit = getenv("TPM_NO_EXIT");
+	char *timeout = getenv("TPM_TIMEOUT_MS");
 	if (no_exit)
 		exit_on_failure = !atoi(no_exit);
+	if (timeout && atoi(timeout) > 0)
+		comm_timeout_ms = atoi(timeout);
 	return VbExTpmOpen();
 }
 
@@ -205,12 +279,18 @@ VbError_t VbExTpmOpen(void)
 	device_path = getenv("TPM_DEVICE_PATH");
 	if (device_path == NULL) {
 		device_path = TPM_DEVICE_PATH;
+		/* Share the TPM through the resource manager, if asked to
+		 * and the kernel has one. */
+		if (getenv("TPM_USE_RM") && atoi(getenv("TPM_USE_RM")) &&
+		    access(TPM_RM_DEVICE_PATH, F_OK) == 0)
+			device_path = TPM_RM_DEVICE_PATH;
 	}
 
-	/* Retry TPM opens on EBUSY failures. */
+	/* Retry TPM opens on EBUSY failures.  The device is non-blocking,
+	 * so that TpmExecute() can give up on a TPM which doesn't answer. */
 	for (retries = 0; retries < OPEN_RETRY_MAX_NUM; ++ retries) {
 		errno = 0;
-		tpm_fd = open(device_path, O_RDWR | O_CLOEXEC);
+		tpm_fd = open(device_path, O_RDWR | O_CLOEXEC | O_NONBLOCK);
 		saved_errno = errno;
 		if (tpm_fd >= 0)
 			return VBERROR_SUCCESS;
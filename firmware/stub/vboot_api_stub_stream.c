@@ -5,6 +5,7 @@
  * Stub implementations of stream APIs.
  */
 
+#include <pthread.h>
 #include <stdint.h>
 
 #include "vboot_api.h"
@@ -22,6 +23,15 @@ struct disk_stream {
 
 	/* Number of sectors left in partition */
 	uint64_t sectors_left;
+
+	/* Worker thread for VbExStreamReadAsync(), if a read is outstanding */
+	pthread_t worker;
+	int async_pending;
+
+	/* Outstanding asynchronous read */
+	uint32_t async_bytes;
+	void *async_buffer;
+	VbError_t async_rv;
 };
 
 VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
@@ -38,6 +48,7 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
 	s->handle = handle;
 	s->sector = lba_start;
 	s->sectors_left = lba_count;
+	s->async_pending = 0;
 
 	*stream = (void *)s;
 
@@ -72,6 +83,47 @@ VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
 	return VBERROR_SUCCESS;
 }
 
+static void *stream_worker(void *arg)
+{
+	struct disk_stream *s = (struct disk_stream *)arg;
+
+	s->async_rv = VbExStreamRead(s, s->async_bytes, s->async_buffer);
+	return NULL;
+}
+
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer)
+{
+	struct disk_stream *s = (struct disk_stream *)stream;
+
+	if (!s || s->async_pending)
+		return VBERROR_UNKNOWN;
+
+	s->async_bytes = bytes;
+	s->async_buffer = buffer;
+	if (pthread_create(&s->worker, NULL, stream_worker, s))
+		return VbExStreamRead(stream, bytes, buffer);
+
+	s->async_pending = 1;
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExStreamWait(VbExStream_t stream)
+{
+	struct disk_stream *s = (struct disk_stream *)stream;
+
+	if (!s)
+		return VBERROR_UNKNOWN;
+
+	/* Nothing outstanding; the read was done synchronously */
+	if (!s->async_pending)
+		return VBERROR_SUCCESS;
+
+	pthread_join(s->worker, NULL);
+	s->async_pending = 0;
+	return s->async_rv;
+}
+
 void VbExStreamClose(VbExStream_t stream)
 {
 	struct disk_stream *s = (struct disk_stream *)stream;
@@ -80,6 +132,8 @@ void VbExStreamClose(VbExStream_t stream)
 	if (!s)
 		return;
 
+	VbExStreamWait(stream);
+
 	free(s);
 	return;
 }
@@ -11,6 +11,7 @@
 
 #include "2sysincludes.h"
 #include "2common.h"
+#include "2sha.h"
 #include "bdb.h"
 #include "bdb_struct.h"
 #include "futility.h"
@@ -218,103 +219,69 @@ exit:
 	return rv;
 }
 
-static int install_bdbkey(uint8_t **bdb, const struct bdb_key *new_key)
+/*
+ * Finds the parts of a BDB which resigning copies, checking that each fits in
+ * the buffer.  The data signature isn't needed, so it may be missing or bad,
+ * as "bdb --add" leaves it.  Returns 0 if success.
+ */
+static int check_resign_input(const uint8_t *bdb, uint32_t size)
 {
-	struct bdb_header *header;
+	const uint8_t *end = bdb + size;
+	const struct bdb_header *h = bdb_get_header(bdb);
 	const struct bdb_key *key;
-	uint8_t *p, *q;
-	uint8_t *new_bdb;
-	size_t new_size;
-	size_t l;
-
-	header = (struct bdb_header *)bdb_get_header(*bdb);
-	key = bdb_get_bdbkey(*bdb);
-	new_size = bdb_size_of(*bdb) + new_key->struct_size - key->struct_size;
-	new_bdb = calloc(1, new_size);
-	if (!new_bdb) {
-		fprintf(stderr, "Unable to allocate memory\n");
-		return -1;
-	}
-
-	/* copy BDB header */
-	p = *bdb;
-	q = new_bdb;
-	l = header->struct_size;
-	memcpy(q, p, l);
-
-	/* copy new BDB key */
-	p += l;
-	q += l;
-	memcpy(q, new_key, new_key->struct_size);
-
-	/* copy the rest */
-	p += key->struct_size;
-	q += new_key->struct_size;
-	l = bdb_size_of(*bdb) - vb2_offset_of(*bdb, p);
-	memcpy(q, p, l);
-
-	/* update size */
-	header = (struct bdb_header *)bdb_get_header(new_bdb);
-	header->bdb_size = new_size;
-
-	free(*bdb);
-	*bdb = new_bdb;
+	const struct bdb_sig *sig;
+	const struct bdb_data *data;
+	const uint8_t *oem;
 
+	if (bdb_check_header(h, size) || h->bdb_size > size)
+		return -1;
+	key = bdb_get_bdbkey(bdb);
+	if (bdb_check_key(key, end - (const uint8_t *)key))
+		return -1;
+	oem = bdb_get_oem_area_0(bdb);
+	if (h->oem_area_0_size > end - oem)
+		return -1;
+	key = bdb_get_datakey(bdb);
+	if (bdb_check_key(key, end - (const uint8_t *)key) ||
+	    h->oem_area_0_size + key->struct_size > h->signed_size ||
+	    h->signed_size > end - oem)
+		return -1;
+	sig = bdb_get_header_sig(bdb);
+	if (bdb_check_sig(sig, end - (const uint8_t *)sig))
+		return -1;
+	data = bdb_get_data(bdb);
+	if (bdb_check_data(data, end - (const uint8_t *)data))
+		return -1;
 	return 0;
 }
 
-static int install_datakey(uint8_t **bdb, const struct bdb_key *new_key)
+/*
+ * Returns the existing signature at sig if it still signs the data with the
+ * given digest and size, or NULL if it has to be resigned.
+ */
+static const struct bdb_sig *reusable_sig(const struct bdb_sig *sig,
+					  const uint8_t *end,
+					  const struct bdb_key *key,
+					  uint32_t signed_size,
+					  const uint8_t *digest)
 {
-	struct bdb_header *header;
-	struct bdb_key *key;
-	uint8_t *p, *q;
-	uint8_t *new_bdb;
-	size_t new_size;
-	uint32_t l;
-
-	key = (struct bdb_key *)bdb_get_datakey(*bdb);
-	new_size = bdb_size_of(*bdb) + new_key->struct_size - key->struct_size;
-	new_bdb = calloc(1, new_size);
-	if (!new_bdb) {
-		fprintf(stderr, "Unable to allocate memory\n");
-		return -1;
-	}
-
-	/* copy the stuff up to datakey */
-	p = *bdb;
-	q = new_bdb;
-	l = bdb_offset_of_datakey(*bdb);
-	memcpy(q, p, l);
-
-	/* copy new data key */
-	p += l;
-	q += l;
-	memcpy(q, new_key, new_key->struct_size);
-
-	/* copy the rest */
-	p += key->struct_size;
-	q += new_key->struct_size;
-	l = bdb_size_of(*bdb) - vb2_offset_of(*bdb, p);
-	memcpy(q, p, l);
-
-	/* update size */
-	header = (struct bdb_header *)bdb_get_header(new_bdb);
-	header->bdb_size = new_size;
-	header->signed_size = header->oem_area_0_size + new_key->struct_size;
-
-	free(*bdb);
-	*bdb = new_bdb;
-
-	return 0;
+	if ((const uint8_t *)sig > end ||
+	    bdb_check_sig(sig, end - (const uint8_t *)sig) ||
+	    sig->signed_size != signed_size ||
+	    bdb_verify_sig(key, sig, digest))
+		return NULL;
+	return sig;
 }
+
 /**
  * Resign a BDB using new keys
  *
- * It first installs given public keys to the BDB, then, runs verification.
- * If verification fails due to an invalid signature, it tries to 'fix' it
- * by resigning it using a given private key, then runs verification again.
- * Whether a key is required or not depends on which signature is invalid.
- * If a private key is required but not provided, it returns an error.
+ * It works out which keys go in the new BDB, then checks each existing
+ * signature against them.  A signature which no longer verifies is made again
+ * from the same digest, using a given private key; whether a key is required
+ * depends on which signature is invalid.  If a private key is required but not
+ * provided, it returns an error.  Once every size is known the new BDB is
+ * put together in a single buffer, and verified one last time.
  */
 static int do_resign(const char *bdb_filename,
 		     const char *bdbkey_pri_filename,
@@ -325,10 +292,21 @@ static int do_resign(const char *bdb_filename,
 		     uint32_t datakey_version,
 		     uint32_t data_version)
 {
-	uint8_t *bdb = NULL;
+	uint8_t *bdb = NULL, *new_bdb = NULL, *p;
+	struct bdb_key *new_bdbkey = NULL, *new_datakey = NULL;
+	const struct bdb_key *bdbkey, *datakey;
+	const struct bdb_header *header;
+	const struct bdb_sig *header_sig, *data_sig;
+	struct bdb_sig *new_header_sig = NULL, *new_data_sig = NULL;
+	struct bdb_header *new_header;
+	struct bdb_data *data;
 	struct rsa_st *bdbkey_pri = NULL;
 	struct rsa_st *datakey_pri = NULL;
-	uint32_t bdb_size;
+	struct vb2_sha256_context sha;
+	uint8_t header_digest[BDB_SHA256_DIGEST_SIZE];
+	uint8_t data_digest[BDB_SHA256_DIGEST_SIZE];
+	const uint8_t *end;
+	uint32_t bdb_size, signed_size, new_size;
 	int resigned = 0;
 	int rv = -1;
 
@@ -342,43 +320,56 @@ static int do_resign(const char *bdb_filename,
 		fprintf(stderr, "Unable to read %s\n", bdb_filename);
 		goto exit;
 	}
+	if (check_resign_input(bdb, bdb_size)) {
+		fprintf(stderr, "Unable to parse %s\n", bdb_filename);
+		goto exit;
+	}
+	end = bdb + bdb_size;
+	header = bdb_get_header(bdb);
+	data = (struct bdb_data *)bdb_get_data(bdb);
 
-	if (data_version != -1) {
-		struct bdb_data *data = (struct bdb_data *)bdb_get_data(bdb);
+	if (data_version != -1)
 		data->data_version = data_version;
-	}
 
+	/* Work out which keys go in the new BDB */
+	bdbkey = bdb_get_bdbkey(bdb);
 	if (bdbkey_pub_filename) {
-		struct bdb_key *key = bdb_create_key(bdbkey_pub_filename,
-						     bdbkey_version, NULL);
-		if (!key) {
+		new_bdbkey = bdb_create_key(bdbkey_pub_filename,
+					    bdbkey_version, NULL);
+		if (!new_bdbkey) {
 			fprintf(stderr, "Unable to read BDB key\n");
 			goto exit;
 		}
-		if (install_bdbkey(&bdb, key)) {
-			fprintf(stderr, "Unable to install new BDB key\n");
-			goto exit;
-		}
+		bdbkey = new_bdbkey;
 	}
 
+	datakey = bdb_get_datakey(bdb);
 	if (datakey_pub_filename) {
-		struct bdb_key *key = bdb_create_key(datakey_pub_filename,
-						     datakey_version, NULL);
-		if (!key) {
+		new_datakey = bdb_create_key(datakey_pub_filename,
+					     datakey_version, NULL);
+		if (!new_datakey) {
 			fprintf(stderr, "Unable to read data key\n");
 			goto exit;
 		}
-		if (install_datakey(&bdb, key)) {
-			fprintf(stderr, "Unable to install new data key\n");
-			goto exit;
-		}
+		datakey = new_datakey;
 	}
 
-	/* Check validity for the new bdb key */
-	rv = bdb_verify(bdb, bdb_size_of(bdb), NULL);
-	if (rv == BDB_ERROR_HEADER_SIG) {
-		/* This is expected failure if we installed a new BDB key.
-		 * Let's resign to fix it. */
+	/*
+	 * Hash what the header signature will sign, OEM area 0 and the data
+	 * key, where they are now.  Keep the old signature if it still
+	 * matches the BDB key; otherwise sign the same digest.
+	 */
+	signed_size = header->oem_area_0_size + datakey->struct_size;
+	vb2_sha256_init(&sha);
+	vb2_sha256_update(&sha, bdb_get_oem_area_0(bdb),
+			  header->oem_area_0_size);
+	vb2_sha256_update(&sha, (const uint8_t *)datakey,
+			  datakey->struct_size);
+	vb2_sha256_finalize(&sha, header_digest);
+
+	header_sig = reusable_sig(bdb_get_header_sig(bdb), end, bdbkey,
+				  signed_size, header_digest);
+	if (!header_sig) {
 		resigned = 1;
 		fprintf(stderr, "Data key signature is invalid. Need to resign "
 			"the key.\n");
@@ -388,24 +379,33 @@ static int do_resign(const char *bdb_filename,
 			goto exit;
 		}
 		bdbkey_pri = read_pem(bdbkey_pri_filename);
-		rv = bdb_sign_datakey(&bdb, bdbkey_pri);
-		if (rv) {
-			fprintf(stderr, "Failed to resign data key: %d\n", rv);
+		if (bdbkey_pri)
+			new_header_sig = bdb_create_sig_digest(
+				header_digest, signed_size, bdbkey_pri,
+				bdbkey->sig_alg, NULL);
+		if (!new_header_sig) {
+			fprintf(stderr, "Failed to resign data key\n");
 			goto exit;
 		}
+		header_sig = new_header_sig;
 		fprintf(stderr, "Data key is resigned.\n");
 	} else {
 		fprintf(stderr, "Resigning data key is not required.\n");
 	}
 
-	/* Check validity for the new data key */
-	rv = bdb_verify(bdb, bdb_size_of(bdb), NULL);
-	switch (rv) {
-	case BDB_ERROR_DATA_SIG:
-	case BDB_ERROR_DATA_CHECK_SIG:
-		/* This is expected failure if we installed a new data key
-		 * or sig is corrupted, which happens when a new hash is added
-		 * by 'add' sub-command. Let's resign the data */
+	/* Same for the data, which stays as it is apart from its version */
+	vb2_sha256_init(&sha);
+	vb2_sha256_update(&sha, (const uint8_t *)data, data->signed_size);
+	vb2_sha256_finalize(&sha, data_digest);
+
+	data_sig = reusable_sig(bdb_get_data_sig(bdb), end, datakey,
+				data->signed_size, data_digest);
+	if (!data_sig) {
+		/*
+		 * This is expected if we installed a new data key or the sig
+		 * is corrupted, which happens when a new hash is added by
+		 * 'add' sub-command.
+		 */
 		resigned = 1;
 		fprintf(stderr,
 			"Data signature is invalid. Need to resign data.\n");
@@ -414,28 +414,58 @@ static int do_resign(const char *bdb_filename,
 				"provided.\n");
 			goto exit;
 		}
-			datakey_pri = read_pem(datakey_pri_filename);
-			rv = bdb_sign_data(&bdb, datakey_pri);
-			if (rv) {
-			fprintf(stderr, "Failed to resign hashes: %d\n", rv);
-				goto exit;
-			}
+		datakey_pri = read_pem(datakey_pri_filename);
+		if (datakey_pri)
+			new_data_sig = bdb_create_sig_digest(
+				data_digest, data->signed_size, datakey_pri,
+				datakey->sig_alg, NULL);
+		if (!new_data_sig) {
+			fprintf(stderr, "Failed to resign hashes\n");
+			goto exit;
+		}
+		data_sig = new_data_sig;
 		fprintf(stderr, "Data is resigned.\n");
-		break;
-	case BDB_GOOD_OTHER_THAN_KEY:
-	case BDB_SUCCESS:
+	} else {
 		fprintf(stderr, "Resigning the data is not required.\n");
-		break;
-	default:
-		fprintf(stderr, "Verifying BDB failed unexpectedly: %d\n", rv);
-			goto exit;
 	}
 
-	if (!resigned)
+	if (!resigned) {
+		rv = 0;
 		goto exit;
+	}
+
+	/* Now that every size is known, put each part in its final place */
+	new_size = header->struct_size + bdbkey->struct_size +
+		header->oem_area_0_size + datakey->struct_size +
+		header_sig->struct_size + data->signed_size +
+		data_sig->struct_size;
+	new_bdb = calloc(1, new_size);
+	if (!new_bdb) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		goto exit;
+	}
+
+	p = new_bdb;
+	memcpy(p, header, header->struct_size);
+	p += header->struct_size;
+	memcpy(p, bdbkey, bdbkey->struct_size);
+	p += bdbkey->struct_size;
+	memcpy(p, bdb_get_oem_area_0(bdb), header->oem_area_0_size);
+	p += header->oem_area_0_size;
+	memcpy(p, datakey, datakey->struct_size);
+	p += datakey->struct_size;
+	memcpy(p, header_sig, header_sig->struct_size);
+	p += header_sig->struct_size;
+	memcpy(p, data, data->signed_size);
+	p += data->signed_size;
+	memcpy(p, data_sig, data_sig->struct_size);
+
+	new_header = (struct bdb_header *)bdb_get_header(new_bdb);
+	new_header->bdb_size = new_size;
+	new_header->signed_size = signed_size;
 
 	/* Check validity one last time */
-	rv = bdb_verify(bdb, bdb_size_of(bdb), NULL);
+	rv = bdb_verify(new_bdb, new_size, NULL);
 	if (rv && rv != BDB_GOOD_OTHER_THAN_KEY) {
 		/* This is not expected. We installed new keys and resigned
 		 * BDB but it's still invalid. */
@@ -443,7 +473,7 @@ static int do_resign(const char *bdb_filename,
 		goto exit;
 	}
 
-	rv = write_file(bdb_filename, bdb, bdb_size_of(bdb));
+	rv = write_file(bdb_filename, new_bdb, new_size);
 	if (rv) {
 		fprintf(stderr, "Unable to write BDB.\n");
 		goto exit;
@@ -453,6 +483,11 @@ static int do_resign(const char *bdb_filename,
 
 exit:
 	free(bdb);
+	free(new_bdb);
+	free(new_bdbkey);
+	free(new_datakey);
+	free(new_header_sig);
+	free(new_data_sig);
 	RSA_free(bdbkey_pri);
 	RSA_free(datakey_pri);
 
@@ -3,7 +3,9 @@
  * found in the LICENSE file.
  */
 
+#include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -33,24 +35,46 @@ enum {
 	OPT_DESC,
 	OPT_ID,
 	OPT_HASH_ALG,
+	OPT_BATCH,
 	OPT_HELP,
 };
 
 #define DEFAULT_VERSION 1
 #define DEFAULT_HASH VB2_HASH_SHA256;
 
-static char *infile, *outfile, *outext;
+/* Upper bound for --jobs */
+#define MAX_JOBS 64
+
 static uint32_t opt_version = DEFAULT_VERSION;
 enum vb2_hash_algorithm opt_hash_alg = DEFAULT_HASH;
 static char *opt_desc;
 static struct vb2_id opt_id;
 static int force_id;
+static int opt_jobs;
+
+/* One keypair to create, from one .pem file */
+struct keypair_job {
+	const char *infile;
+	char *outfile;			/* with room for the extensions */
+	char *outext;			/* where they go in outfile */
+	int quiet;			/* don't say which files were written */
+	struct vb2_packed_key *pubkey;	/* for the batch summary */
+	int rv;
+};
+
+/* Jobs shared by the worker threads */
+static struct keypair_job *keypair_jobs;
+static int keypair_jobs_count;
+static int keypair_jobs_next;
+static pthread_mutex_t keypair_jobs_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static const struct option long_opts[] = {
 	{"version",  1, 0, OPT_VERSION},
 	{"desc",     1, 0, OPT_DESC},
 	{"id",       1, 0, OPT_ID},
 	{"hash_alg", 1, 0, OPT_HASH_ALG},
+	{"batch",    1, 0, OPT_BATCH},
+	{"jobs",     1, 0, 'j'},
 	{"help",     0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
@@ -60,10 +84,16 @@ static void print_help(int argc, char *argv[])
 	const struct vb2_text_vs_enum *entry;
 
 	printf("\n"
-"Usage:  " MYNAME " %s [options] <INFILE> [<BASENAME>]\n", argv[0]);
+"Usage:  " MYNAME " %s [options] <INFILE> [<BASENAME>]\n"
+"        " MYNAME " %s [options] --batch <MANIFEST>\n", argv[0], argv[0]);
 	printf("\n"
 "Create a keypair from an RSA key (.pem file).\n"
 "\n"
+"With --batch, create one keypair for each line of the manifest, which\n"
+"gives an INFILE and optionally a BASENAME, separated by whitespace.\n"
+"Blank lines and lines starting with '#' are skipped.  The keys are\n"
+"created in parallel, and their sha1sums listed when all are done.\n"
+"\n"
 "Options:\n"
 "\n"
 "  --version <number>          Key version (default %d)\n"
@@ -76,12 +106,15 @@ static void print_help(int argc, char *argv[])
 	printf(
 "  --id <id>                   Identifier for this keypair (vb21 only)\n"
 "  --desc <text>               Human-readable description (vb21 only)\n"
+"  -j|--jobs <number>          Keys to create at once with --batch\n"
+"                                (default: one per CPU)\n"
 "\n");
 
 }
 
-static int vb1_make_keypair(void)
+static int vb1_make_keypair(struct keypair_job *job)
 {
+	const char *infile = job->infile;
 	struct vb2_private_key *privkey = NULL;
 	struct vb2_packed_key *pubkey = NULL;
 	struct rsa_st *rsa_key = NULL;
@@ -124,12 +157,13 @@ static int vb1_make_keypair(void)
 	privkey->hash_alg = opt_hash_alg;
 
 	/* Write it out */
-	strcpy(outext, ".vbprivk");
-	if (0 != vb2_write_private_key(outfile, privkey)) {
+	strcpy(job->outext, ".vbprivk");
+	if (0 != vb2_write_private_key(job->outfile, privkey)) {
 		fprintf(stderr, "unable to write private key\n");
 		goto done;
 	}
-	printf("wrote %s\n", outfile);
+	if (!job->quiet)
+		printf("wrote %s\n", job->outfile);
 
 	/* Create the public key */
 	ret = vb_keyb_from_rsa(rsa_key, &keyb_data, &keyb_size);
@@ -144,13 +178,16 @@ static int vb1_make_keypair(void)
 	memcpy((uint8_t *)vb2_packed_key_data(pubkey), keyb_data, keyb_size);
 
 	/* Write it out */
-	strcpy(outext, ".vbpubk");
-	if (VB2_SUCCESS != vb2_write_packed_key(outfile, pubkey)) {
+	strcpy(job->outext, ".vbpubk");
+	if (VB2_SUCCESS != vb2_write_packed_key(job->outfile, pubkey)) {
 		fprintf(stderr, "unable to write public key\n");
 		goto done;
 	}
-	printf("wrote %s\n", outfile);
+	if (!job->quiet)
+		printf("wrote %s\n", job->outfile);
 
+	job->pubkey = pubkey;
+	pubkey = NULL;
 	ret = 0;
 
 done:
@@ -161,8 +198,9 @@ done:
 	return ret;
 }
 
-static int vb2_make_keypair(void)
+static int vb2_make_keypair(struct keypair_job *job)
 {
+	const char *infile = job->infile;
 	struct vb2_private_key *privkey = 0;
 	struct vb2_public_key *pubkey = 0;
 	RSA *rsa_key = 0;
@@ -170,6 +208,7 @@ static int vb2_make_keypair(void)
 	uint32_t keyb_size;
 	enum vb2_signature_algorithm sig_alg;
 	uint8_t *pubkey_buf = 0;
+	struct vb2_id id = opt_id;
 	int has_priv = 0;
 	const BIGNUM *rsa_d;
 
@@ -262,28 +301,41 @@ static int vb2_make_keypair(void)
 	/* Update the IDs */
 	if (!force_id) {
 		vb2_digest_buffer(keyb_data, keyb_size, VB2_HASH_SHA1,
-				  opt_id.raw, sizeof(opt_id.raw));
+				  id.raw, sizeof(id.raw));
 	}
 
-	memcpy((struct vb2_id *)pubkey->id, &opt_id, sizeof(opt_id));
+	memcpy((struct vb2_id *)pubkey->id, &id, sizeof(id));
 
 	/* Write them out */
 	if (has_priv) {
-		privkey->id = opt_id;
-		strcpy(outext, ".vbprik2");
-		if (vb21_private_key_write(privkey, outfile)) {
+		privkey->id = id;
+		strcpy(job->outext, ".vbprik2");
+		if (vb21_private_key_write(privkey, job->outfile)) {
 			fprintf(stderr, "unable to write private key\n");
 			goto done;
 		}
-		printf("wrote %s\n", outfile);
+		if (!job->quiet)
+			printf("wrote %s\n", job->outfile);
 	}
 
-	strcpy(outext, ".vbpubk2");
-	if (vb21_public_key_write(pubkey, outfile)) {
+	strcpy(job->outext, ".vbpubk2");
+	if (vb21_public_key_write(pubkey, job->outfile)) {
 		fprintf(stderr, "unable to write public key\n");
 		goto done;
 	}
-	printf("wrote %s\n", outfile);
+	if (!job->quiet)
+		printf("wrote %s\n", job->outfile);
+
+	/* The summary only needs the keyb blob, which the ID is a hash of */
+	if (job->quiet) {
+		job->pubkey = vb2_alloc_packed_key(
+			keyb_size, vb2_get_crypto_algorithm(opt_hash_alg, sig_alg),
+			opt_version);
+		if (!job->pubkey)
+			goto done;
+		memcpy((uint8_t *)vb2_packed_key_data(job->pubkey), keyb_data,
+		       keyb_size);
+	}
 
 	ret = 0;
 
@@ -297,13 +349,187 @@ done:
 	return ret;
 }
 
+/*
+ * Sets up a job to create a keypair from infile.  The output files are named
+ * for basename, or if that's NULL, for infile without its extension.
+ */
+static int init_job(struct keypair_job *job, const char *infile,
+		    const char *basename)
+{
+	const char *s = basename ? basename : infile;
+	char *e;
+
+	memset(job, 0, sizeof(*job));
+	job->infile = infile;
+
+	/* Make an extra-large copy to leave room for filename extensions */
+	job->outfile = (char *)malloc(strlen(s) + 20);
+	if (!job->outfile) {
+		fprintf(stderr, "ERROR: malloc() failed\n");
+		return 1;
+	}
+	strcpy(job->outfile, s);
+
+	if (!basename) {
+		/* Find the last '/' if any, then the last '.' before that. */
+		e = strrchr(job->outfile, '/');
+		if (!e)
+			e = job->outfile;
+		e = strrchr(e, '.');
+		/* Cut off the extension */
+		if (e)
+			*e = '\0';
+	}
+	/* Remember that spot for later */
+	job->outext = job->outfile + strlen(job->outfile);
+	return 0;
+}
+
+static void do_keypair_job(struct keypair_job *job)
+{
+	if (vboot_version == VBOOT_VERSION_1_0)
+		job->rv = vb1_make_keypair(job);
+	else
+		job->rv = vb2_make_keypair(job);
+}
+
+static void *keypair_worker(void *arg)
+{
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&keypair_jobs_lock);
+		i = keypair_jobs_next++;
+		pthread_mutex_unlock(&keypair_jobs_lock);
+		if (i >= keypair_jobs_count)
+			return NULL;
+		do_keypair_job(keypair_jobs + i);
+	}
+}
+
+/* Does all the jobs, up to opt_jobs at a time. */
+static void run_keypair_jobs(struct keypair_job *jobs, int count)
+{
+	pthread_t threads[MAX_JOBS];
+	int i, started = 0;
+
+	keypair_jobs = jobs;
+	keypair_jobs_count = count;
+	keypair_jobs_next = 0;
+
+	/* This thread is one of the workers, too */
+	for (i = 1; i < opt_jobs && i < count; i++) {
+		if (pthread_create(&threads[started], NULL, keypair_worker,
+				   NULL))
+			break;
+		started++;
+	}
+	keypair_worker(NULL);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
+/*
+ * Creates every keypair listed in the manifest, then lists their sha1sums in
+ * the manifest's order.  Returns the number of failures.
+ */
+static int do_batch(const char *manifest)
+{
+	struct keypair_job *jobs = NULL, *new_jobs, *job;
+	char *line = NULL, *tok, *save, *infile;
+	size_t line_size = 0;
+	int count = 0, lineno = 0, failed = 0, errors = 0;
+	int i;
+	FILE *fp;
+
+	fp = fopen(manifest, "r");
+	if (!fp) {
+		fprintf(stderr, "Can't open %s: %s\n", manifest,
+			strerror(errno));
+		return 1;
+	}
+
+	while (getline(&line, &line_size, fp) != -1) {
+		lineno++;
+		tok = strtok_r(line, " \t\r\n", &save);
+		if (!tok || *tok == '#')
+			continue;
+
+		new_jobs = realloc(jobs, (count + 1) * sizeof(*jobs));
+		if (!new_jobs) {
+			fprintf(stderr, "Out of memory\n");
+			failed++;
+			break;
+		}
+		jobs = new_jobs;
+		infile = strdup(tok);
+		if (!infile) {
+			fprintf(stderr, "Out of memory\n");
+			failed++;
+			break;
+		}
+		job = jobs + count++;
+		if (init_job(job, infile, strtok_r(NULL, " \t\r\n", &save))) {
+			failed++;
+			break;
+		}
+		job->quiet = 1;
+		if (strtok_r(NULL, " \t\r\n", &save)) {
+			fprintf(stderr, "%s:%d: too many file names\n",
+				manifest, lineno);
+			failed++;
+			break;
+		}
+	}
+	free(line);
+	fclose(fp);
+
+	if (!failed)
+		run_keypair_jobs(jobs, count);
+
+	for (i = 0; i < count; i++) {
+		job = jobs + i;
+		if (!failed && job->outext) {
+			*job->outext = '\0';
+			if (job->rv)
+				printf("FAILED  %s\n", job->outfile);
+			else
+				printf("%s  %s\n",
+				       packed_key_sha1_string(job->pubkey),
+				       job->outfile);
+		}
+		errors += !!job->rv;
+		free(job->pubkey);
+		free(job->outfile);
+		free((char *)job->infile);
+	}
+	free(jobs);
+
+	if (!failed)
+		printf("created %d of %d keypairs\n", count - errors, count);
+	return failed + errors;
+}
+
 static int do_create(int argc, char *argv[])
 {
+	struct keypair_job job;
+	char *infile = NULL, *batch = NULL;
 	int errorcnt = 0;
-	char *e, *s;
-	int i, r, len, remove_ext = 0;
-
-	while ((i = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+	char *e;
+	int i, r;
+
+	opt_version = DEFAULT_VERSION;
+	opt_hash_alg = DEFAULT_HASH;
+	opt_desc = NULL;
+	memset(&opt_id, 0, sizeof(opt_id));
+	force_id = 0;
+	opt_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (opt_jobs < 1)
+		opt_jobs = 1;
+	if (opt_jobs > MAX_JOBS)
+		opt_jobs = MAX_JOBS;
+
+	while ((i = getopt_long(argc, argv, ":j:", long_opts, NULL)) != -1) {
 		switch (i) {
 
 		case OPT_VERSION:
@@ -336,6 +562,21 @@ static int do_create(int argc, char *argv[])
 			}
 			break;
 
+		case OPT_BATCH:
+			batch = optarg;
+			break;
+
+		case 'j':
+			opt_jobs = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || opt_jobs < 1 ||
+			    opt_jobs > MAX_JOBS) {
+				fprintf(stderr,
+					"invalid jobs \"%s\" (1-%d)\n",
+					optarg, MAX_JOBS);
+				errorcnt++;
+			}
+			break;
+
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -359,14 +600,23 @@ static int do_create(int argc, char *argv[])
 		}
 	}
 
-	/* If we don't have an input file already, we need one */
-	if (!infile) {
-		if (argc - optind <= 0) {
-			fprintf(stderr, "ERROR: missing input filename\n");
+	if (batch) {
+		if (argc > optind) {
+			fprintf(stderr,
+				"ERROR: no filenames go with --batch\n");
+			errorcnt++;
+		}
+		/* Every key would end up with the same ID */
+		if (force_id) {
+			fprintf(stderr, "ERROR: --id can't go with --batch\n");
 			errorcnt++;
-		} else {
-			infile = argv[optind++];
 		}
+	} else if (argc - optind <= 0) {
+		/* If we don't have an input file already, we need one */
+		fprintf(stderr, "ERROR: missing input filename\n");
+		errorcnt++;
+	} else {
+		infile = argv[optind++];
 	}
 
 	if (errorcnt) {
@@ -374,43 +624,19 @@ static int do_create(int argc, char *argv[])
 		return 1;
 	}
 
-	/* Decide how to determine the output filenames. */
-	if (argc > optind) {
-		s = argv[optind++];		/* just use this */
-	} else {
-		s = infile;			/* based on pem file name */
-		remove_ext = 1;
-	}
+	if (batch)
+		return !!do_batch(batch);
 
-	/* Make an extra-large copy to leave room for filename extensions */
-	len = strlen(s) + 20;
-	outfile = (char *)malloc(len);
-	if (!outfile) {
-		fprintf(stderr, "ERROR: malloc() failed\n");
+	/* Name the output files for the next arg, or for the pem file */
+	if (init_job(&job, infile, argc > optind ? argv[optind++] : NULL))
 		return 1;
-	}
-	strcpy(outfile, s);
-
-	if (remove_ext) {
-		/* Find the last '/' if any, then the last '.' before that. */
-		s = strrchr(outfile, '/');
-		if (!s)
-			s = outfile;
-		s = strrchr(s, '.');
-		/* Cut off the extension */
-		if (s)
-			*s = '\0';
-	}
-	/* Remember that spot for later */
-	outext = outfile + strlen(outfile);
 
 	/* Okay, do it */
-	if (vboot_version == VBOOT_VERSION_1_0)
-		r = vb1_make_keypair();
-	else
-		r = vb2_make_keypair();
+	do_keypair_job(&job);
+	r = job.rv;
 
-	free(outfile);
+	free(job.pubkey);
+	free(job.outfile);
 	return r;
 }
 
@@ -7,6 +7,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,19 +17,164 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
 #include "fmap.h"
 #include "futility.h"
 
 enum { FMT_NORMAL, FMT_PRETTY, FMT_FLASHROM, FMT_HUMAN };
 
+/* Upper bound for --jobs */
+#define MAX_JOBS 64
+
 /* global variables */
 static int opt_extract;
 static int opt_format = FMT_NORMAL;
 static int opt_overlap;
+static int opt_sha256;
+static int opt_jobs;
+static int rom_fd = -1;
 static void *base_of_rom;
 static size_t size_of_rom;
 static int opt_gaps;
 
+/* One area to extract and/or hash, before any of them are shown */
+struct area_job {
+	const FmapAreaHeader *ah;
+	char name[FMAP_NAMELEN + 1];
+	const char *outname;		/* where to extract it, or NULL */
+	char default_outname[FMAP_NAMELEN + 1];
+	enum {
+		AREA_OK,
+		AREA_ZERO_SIZE,
+		AREA_TOO_BIG,
+		AREA_OPEN_FAILED,
+		AREA_WRITE_FAILED,
+	} status;
+	int err;			/* errno, for the failures */
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+};
+
+/* Jobs shared by the worker threads */
+static struct area_job *area_jobs;
+static int area_jobs_count;
+static int area_jobs_next;
+static pthread_mutex_t area_jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Copies size bytes at offset in the image to out_fd.  The kernel does it if
+ * it can, without the data coming through here; otherwise, it's written from
+ * the map.
+ */
+static int copy_area(int out_fd, uint32_t offset, uint32_t size)
+{
+	loff_t in_off = offset;
+	ssize_t n;
+
+	while (size) {
+		n = copy_file_range(rom_fd, &in_off, out_fd, NULL, size, 0);
+		if (n <= 0)
+			break;
+		size -= n;
+	}
+
+	while (size) {
+		n = write(out_fd, (uint8_t *)base_of_rom + in_off, size);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		in_off += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+static void do_area_job(struct area_job *job)
+{
+	const FmapAreaHeader *ah = job->ah;
+	int in_range = (uint64_t)ah->area_offset + ah->area_size <=
+		size_of_rom;
+	int fd;
+
+	if (opt_sha256 && in_range)
+		vb2_digest_buffer((uint8_t *)base_of_rom + ah->area_offset,
+				  ah->area_size, VB2_HASH_SHA256,
+				  job->digest, sizeof(job->digest));
+
+	if (!job->outname) {
+		if (!in_range)
+			job->status = AREA_TOO_BIG;
+		return;
+	}
+
+	fd = open(job->outname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		job->status = AREA_OPEN_FAILED;
+		job->err = errno;
+		return;
+	}
+
+	if (!ah->area_size) {
+		job->status = AREA_ZERO_SIZE;
+	} else if (!in_range) {
+		job->status = AREA_TOO_BIG;
+	} else if (copy_area(fd, ah->area_offset, ah->area_size)) {
+		job->status = AREA_WRITE_FAILED;
+		job->err = errno;
+	}
+
+	if (close(fd) && job->status == AREA_OK) {
+		job->status = AREA_WRITE_FAILED;
+		job->err = errno;
+	}
+}
+
+static void *area_worker(void *arg)
+{
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&area_jobs_lock);
+		i = area_jobs_next++;
+		pthread_mutex_unlock(&area_jobs_lock);
+		if (i >= area_jobs_count)
+			return NULL;
+		do_area_job(area_jobs + i);
+	}
+}
+
+/* Does all the jobs, up to opt_jobs at a time. */
+static void run_area_jobs(struct area_job *jobs, int count)
+{
+	pthread_t threads[MAX_JOBS];
+	int i, j, started = 0, max = opt_jobs;
+
+	/* Areas going to the same file are written in order, as before */
+	for (i = 0; i < count && max > 1; i++)
+		for (j = i + 1; j < count && max > 1; j++)
+			if (jobs[i].outname && jobs[j].outname &&
+			    !strcmp(jobs[i].outname, jobs[j].outname))
+				max = 1;
+
+	area_jobs = jobs;
+	area_jobs_count = count;
+	area_jobs_next = 0;
+
+	/* This thread is one of the workers, too */
+	for (i = 1; i < max && i < count; i++) {
+		if (pthread_create(&threads[started], NULL, area_worker, NULL))
+			break;
+		started++;
+	}
+	area_worker(NULL);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
 /* Return 0 if successful */
 static int normal_fmap(const FmapHeader *fmh, int argc, char *argv[])
 {
@@ -38,6 +184,8 @@ static int normal_fmap(const FmapHeader *fmh, int argc, char *argv[])
 	ah = (const FmapAreaHeader *) (fmh + 1);
 	char *extract_names[argc];
 	char *outname = 0;
+	struct area_job *jobs = NULL, *job = NULL;
+	int njobs = 0;
 
 	memset(extract_names, 0, sizeof(extract_names));
 
@@ -61,6 +209,52 @@ static int normal_fmap(const FmapHeader *fmh, int argc, char *argv[])
 			return retval;
 	}
 
+	/*
+	 * Extract and hash the areas first, alongside each other, so the
+	 * output below comes out in order.
+	 */
+	if (opt_extract || opt_sha256) {
+		jobs = calloc(fmh->fmap_nareas + 1, sizeof(*jobs));
+		if (!jobs) {
+			perror("calloc failed");
+			exit(1);
+		}
+	}
+
+	for (i = 0; jobs && i < fmh->fmap_nareas; i++) {
+		snprintf(buf, FMAP_NAMELEN + 1, "%s", ah[i].area_name);
+		outname = NULL;
+
+		if (argc) {
+			int j, found = 0;
+			for (j = 0; j < argc; j++)
+				if (!strcmp(argv[j], buf)) {
+					found = 1;
+					outname = extract_names[j];
+					break;
+				}
+			if (!found)
+				continue;
+		}
+
+		job = jobs + njobs++;
+		job->ah = ah + i;
+		strcpy(job->name, buf);
+		if (opt_extract) {
+			char *s;
+			if (!outname) {
+				for (s = buf; *s; s++)
+					if (*s == ' ')
+						*s = '_';
+				strcpy(job->default_outname, buf);
+				outname = job->default_outname;
+			}
+			job->outname = outname;
+		}
+	}
+	run_area_jobs(jobs, njobs);
+	job = jobs;
+
 	if (FMT_NORMAL == opt_format) {
 		snprintf(buf, FMAP_SIGNATURE_SIZE + 1, "%s",
 			 fmh->fmap_signature);
@@ -76,25 +270,34 @@ static int normal_fmap(const FmapHeader *fmh, int argc, char *argv[])
 	}
 
 	for (i = 0; i < fmh->fmap_nareas; i++, ah++) {
-		snprintf(buf, FMAP_NAMELEN + 1, "%s", ah->area_name);
-
-		if (argc) {
-			int j, found = 0;
-			outname = NULL;
+		char digest[2 * VB2_SHA256_DIGEST_SIZE + 1] = "";
+		int j;
+
+		/* The jobs are in the same order, for the areas we want */
+		if (jobs && (job == jobs + njobs || job->ah != ah))
+			continue;
+		if (!jobs && argc) {
+			snprintf(buf, FMAP_NAMELEN + 1, "%s", ah->area_name);
 			for (j = 0; j < argc; j++)
-				if (!strcmp(argv[j], buf)) {
-					found = 1;
-					outname = extract_names[j];
+				if (!strcmp(argv[j], buf))
 					break;
-				}
-			if (!found)
+			if (j == argc)
 				continue;
 		}
+		snprintf(buf, FMAP_NAMELEN + 1, "%s", ah->area_name);
+
+		if (opt_sha256 && job->status != AREA_TOO_BIG)
+			for (j = 0; j < VB2_SHA256_DIGEST_SIZE; j++)
+				sprintf(digest + 2 * j, "%02x",
+					job->digest[j]);
 
 		switch (opt_format) {
 		case FMT_PRETTY:
-			printf("%s %d %d\n", buf, ah->area_offset,
+			printf("%s %d %d", buf, ah->area_offset,
 			       ah->area_size);
+			if (*digest)
+				printf(" %s", digest);
+			printf("\n");
 			break;
 		case FMT_FLASHROM:
 			if (ah->area_size)
@@ -108,44 +311,41 @@ static int normal_fmap(const FmapHeader *fmh, int argc, char *argv[])
 			printf("area_size:       0x%08x (%d)\n", ah->area_size,
 			       ah->area_size);
 			printf("area_name:       %s\n", buf);
+			if (*digest)
+				printf("area_sha256:     %s\n", digest);
 		}
 
-		if (opt_extract) {
-			char *s;
-			if (!outname) {
-				for (s = buf; *s; s++)
-					if (*s == ' ')
-						*s = '_';
-				outname = buf;
-			}
-			FILE *fp = fopen(outname, "wb");
-			if (!fp) {
-				fprintf(stderr, "%s: can't open %s: %s\n",
-					argv[0], outname, strerror(errno));
-				retval = 1;
-			} else if (!ah->area_size) {
-				fprintf(stderr,
-					"%s: section %s has zero size\n",
-					argv[0], buf);
-			} else if (ah->area_offset + ah->area_size >
-				   size_of_rom) {
-				fprintf(stderr, "%s: section %s is larger"
-					" than the image\n", argv[0], buf);
-				retval = 1;
-			} else if (1 != fwrite(base_of_rom + ah->area_offset,
-					       ah->area_size, 1, fp)) {
-				fprintf(stderr, "%s: can't write %s: %s\n",
-					argv[0], buf, strerror(errno));
-				retval = 1;
-			} else {
-				if (FMT_NORMAL == opt_format)
-					printf("saved as \"%s\"\n", outname);
-			}
-			if (fp)
-				fclose(fp);
+		if (!jobs)
+			continue;
+
+		switch (job->status) {
+		case AREA_OPEN_FAILED:
+			fprintf(stderr, "%s: can't open %s: %s\n",
+				argv[0], job->outname, strerror(job->err));
+			retval = 1;
+			break;
+		case AREA_ZERO_SIZE:
+			fprintf(stderr, "%s: section %s has zero size\n",
+				argv[0], buf);
+			break;
+		case AREA_TOO_BIG:
+			fprintf(stderr, "%s: section %s is larger"
+				" than the image\n", argv[0], buf);
+			retval = 1;
+			break;
+		case AREA_WRITE_FAILED:
+			fprintf(stderr, "%s: can't write %s: %s\n",
+				argv[0], buf, strerror(job->err));
+			retval = 1;
+			break;
+		default:
+			if (job->outname && FMT_NORMAL == opt_format)
+				printf("saved as \"%s\"\n", job->outname);
 		}
+		job++;
 	}
 
+	free(jobs);
 	return retval;
 }
 
@@ -405,6 +605,9 @@ static const char usage[] =
 	"  -H             With -h, display any gaps\n"
 	"  -p             Use a format easy to parse by scripts\n"
 	"  -F             Use the format expected by flashrom\n"
+	"  -s|--sha256    Show the SHA-256 digest of each section\n"
+	"  -j|--jobs NUM  Extract and hash NUM sections at a time\n"
+	"                   (default: one per CPU)\n"
 	"\n"
 	"Specify one or more NAMEs to dump only those sections.\n"
 	"\n";
@@ -419,6 +622,8 @@ enum {
 };
 static const struct option long_opts[] = {
 	{"help",     0, 0, OPT_HELP},
+	{"sha256",   0, 0, 's'},
+	{"jobs",     1, 0, 'j'},
 	{NULL, 0, 0, 0}
 };
 static int do_dump_fmap(int argc, char *argv[])
@@ -429,13 +634,39 @@ static int do_dump_fmap(int argc, char *argv[])
 	int fd;
 	const FmapHeader *fmap;
 	int retval = 1;
+	char *e;
+
+	opt_extract = 0;
+	opt_format = FMT_NORMAL;
+	opt_overlap = 0;
+	opt_gaps = 0;
+	gapcount = 0;
+	opt_sha256 = 0;
+	opt_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (opt_jobs < 1)
+		opt_jobs = 1;
+	if (opt_jobs > MAX_JOBS)
+		opt_jobs = MAX_JOBS;
 
 	opterr = 0;		/* quiet, you */
-	while ((c = getopt_long(argc, argv, ":xpFhH", long_opts, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, ":xpFhHsj:", long_opts, 0)) != -1) {
 		switch (c) {
 		case 'x':
 			opt_extract = 1;
 			break;
+		case 's':
+			opt_sha256 = 1;
+			break;
+		case 'j':
+			opt_jobs = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || opt_jobs < 1 ||
+			    opt_jobs > MAX_JOBS) {
+				fprintf(stderr,
+					"%s: invalid --jobs \"%s\" (1-%d)\n",
+					argv[0], optarg, MAX_JOBS);
+				errorcnt++;
+			}
+			break;
 		case 'p':
 			opt_format = FMT_PRETTY;
 			break;
@@ -495,7 +726,7 @@ static int do_dump_fmap(int argc, char *argv[])
 		close(fd);
 		return 1;
 	}
-	close(fd);		/* done with this now */
+	rom_fd = fd;		/* kept to copy areas from */
 	size_of_rom = sb.st_size;
 
 	fmap = fmap_find(base_of_rom, size_of_rom);
@@ -515,6 +746,9 @@ static int do_dump_fmap(int argc, char *argv[])
 		}
 	}
 
+	close(rom_fd);
+	rom_fd = -1;
+
 	if (0 != munmap(base_of_rom, sb.st_size)) {
 		fprintf(stderr, "%s: can't munmap %s: %s\n",
 			argv[0], argv[optind], strerror(errno));
@@ -28,15 +28,19 @@ static const struct option long_opts[] = {
 static void print_help(int argc, char *argv[])
 {
 	printf("\nUsage:  " MYNAME " %s [--kloadaddr ADDRESS] "
-	       "KERNEL_PARTITION\n\n", argv[0]);
+	       "KERNEL_PARTITION [...]\n\n"
+	       "With more than one partition, each command line is printed on\n"
+	       "its own line, prefixed with the partition name.\n\n",
+	       argv[0]);
 }
 
 static int do_dump_kern_cfg(int argc, char *argv[])
 {
-	char *infile = NULL;
-	char *config = NULL;
+	char *infile;
+	char *config;
 	uint64_t kernel_body_load_address = USE_PREAMBLE_LOAD_ADDR;
 	int parse_error = 0;
+	int batch, errors = 0;
 	char *e;
 	int i;
 
@@ -70,27 +74,39 @@ static int do_dump_kern_cfg(int argc, char *argv[])
 	if (optind >= argc) {
 		fprintf(stderr, "Expected argument after options\n");
 		parse_error = 1;
-	} else
-		infile = argv[optind];
+	}
 
 	if (parse_error) {
 		print_help(argc, argv);
 		return 1;
 	}
 
-	if (!infile || !*infile) {
-		fprintf(stderr, "Must specify filename\n");
-		return 1;
-	}
+	batch = argc - optind > 1;
+	for (i = optind; i < argc; i++) {
+		infile = argv[i];
+		if (!*infile) {
+			fprintf(stderr, "Must specify filename\n");
+			errors++;
+			continue;
+		}
 
-	config = FindKernelConfig(infile, kernel_body_load_address);
-	if (!config)
-		return 1;
+		config = FindKernelConfig(infile, kernel_body_load_address);
+		if (!config) {
+			if (batch)
+				fprintf(stderr, "%s: no kernel config\n", infile);
+			errors++;
+			continue;
+		}
 
-	printf("%s", config);
+		if (batch)
+			printf("%s: %s\n", infile, config);
+		else
+			printf("%s", config);
+
+		free(config);
+	}
 
-	free(config);
-	return 0;
+	return !!errors;
 }
 
 DECLARE_FUTIL_COMMAND(dump_kernel_config, do_dump_kern_cfg, VBOOT_VERSION_ALL,
@@ -4,6 +4,7 @@
  * found in the LICENSE file.
  */
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <stddef.h>
@@ -201,59 +202,107 @@ static uint8_t *create_gbb(const char *desc, off_t *sizeptr)
 	return buf;
 }
 
-static uint8_t *read_entire_file(const char *filename, off_t *sizeptr)
+/*
+ * Maps all of 'filename' privately, so the GBB can be read and changed
+ * without reading or copying the rest of the image.  Changes are never
+ * written to the file; see write_gbb_in_place().
+ */
+static uint8_t *map_entire_file(const char *filename, uint32_t *sizeptr)
 {
-	FILE *fp = NULL;
-	uint8_t *buf = NULL;
-	struct stat sb;
+	uint8_t *buf;
+	int fd;
 
-	fp = fopen(filename, "rb");
-	if (!fp) {
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
 		fprintf(stderr, "ERROR: Unable to open %s for reading: %s\n",
 			filename, strerror(errno));
-		goto fail;
+		errorcnt++;
+		return NULL;
 	}
 
-	if (0 != fstat(fileno(fp), &sb)) {
-		fprintf(stderr, "ERROR: can't fstat %s: %s\n",
+	if (FILE_ERR_NONE != futil_map_file(fd, 0, &buf, sizeptr))
+		buf = NULL;
+
+	/* The mapping stays valid after the file is closed. */
+	if (0 != close(fd)) {
+		fprintf(stderr, "ERROR: Unable to close %s: %s\n",
 			filename, strerror(errno));
-		goto fail;
+		if (buf)
+			futil_unmap_file(-1, 0, buf, *sizeptr);
+		buf = NULL;
 	}
-	if (sizeptr)
-		*sizeptr = sb.st_size;
 
-	buf = (uint8_t *) malloc(sb.st_size);
-	if (!buf) {
-		fprintf(stderr, "ERROR: can't malloc %" PRIi64 " bytes: %s\n",
-			sb.st_size, strerror(errno));
-		goto fail;
+	if (!buf)
+		errorcnt++;
+	return buf;
+}
+
+/* Returns non-zero if 'a' and 'b' name the same file or device. */
+static int same_file(const char *a, const char *b)
+{
+	struct stat sa, sb;
+
+	if (!strcmp(a, b))
+		return 1;
+	if (stat(a, &sa) || stat(b, &sb))
+		return 0;
+	return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+/* Returns the size of the GBB, from its header to the end of its last area. */
+static uint32_t gbb_extent(const struct vb2_gbb_header *gbb)
+{
+	uint32_t size = gbb->header_size;
+
+#define GBB_AREA_END(area) \
+	if (gbb->area##_offset + gbb->area##_size > size) \
+		size = gbb->area##_offset + gbb->area##_size
+	GBB_AREA_END(hwid);
+	GBB_AREA_END(rootkey);
+	GBB_AREA_END(bmpfv);
+	GBB_AREA_END(recovery_key);
+#undef GBB_AREA_END
+
+	return size;
+}
+
+/*
+ * Writes 'size' bytes from 'start' to 'offset' in the existing file (or
+ * device) 'filename', without truncating it or touching the rest of it.
+ */
+static int write_in_place(const char *msg, const char *filename,
+			  const uint8_t *start, uint32_t size, off_t offset)
+{
+	int fd;
+	int r = 0;
+
+	fd = open(filename, O_WRONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Unable to open %s for writing: %s\n",
+			filename, strerror(errno));
+		errorcnt++;
+		return errno;
 	}
 
-	if (1 != fread(buf, sb.st_size, 1, fp)) {
-		fprintf(stderr, "ERROR: Unable to read from %s: %s\n",
+	if ((ssize_t)size != pwrite(fd, start, size, offset)) {
+		fprintf(stderr, "ERROR: Unable to write to %s: %s\n",
 			filename, strerror(errno));
-		goto fail;
+		errorcnt++;
+		r = errno ? errno : EIO;
 	}
 
-	if (0 != fclose(fp)) {
+	if (0 != close(fd)) {
 		fprintf(stderr, "ERROR: Unable to close %s: %s\n",
 			filename, strerror(errno));
-		fp = NULL;  /* Don't try to close it again */
-		goto fail;
+		errorcnt++;
+		if (!r)
+			r = errno;
 	}
 
-	return buf;
-
-fail:
-	errorcnt++;
-
-	if (buf)
-		free(buf);
+	if (!r && msg)
+		printf("%s %s\n", msg, filename);
 
-	if (fp && 0 != fclose(fp))
-		fprintf(stderr, "ERROR: Unable to close %s: %s\n",
-			filename, strerror(errno));
-	return NULL;
+	return r;
 }
 
 static int write_to_file(const char *msg, const char *filename,
@@ -369,6 +418,7 @@ static int do_gbb(int argc, char *argv[])
 	int sel_flags = 0;
 	int sel_roothash = 0;
 	uint8_t *inbuf = NULL;
+	uint32_t insize = 0;
 	off_t filesize;
 	uint8_t *outbuf = NULL;
 	struct vb2_gbb_header *gbb;
@@ -478,11 +528,11 @@ static int do_gbb(int argc, char *argv[])
 		    && !sel_flags && !sel_digest)
 			sel_hwid = 1;
 
-		inbuf = read_entire_file(infile, &filesize);
+		inbuf = map_entire_file(infile, &insize);
 		if (!inbuf)
 			break;
 
-		gbb = FindGbbHeader(inbuf, filesize);
+		gbb = FindGbbHeader(inbuf, insize);
 		if (!gbb) {
 			fprintf(stderr, "ERROR: No GBB found in %s\n", infile);
 			break;
@@ -499,7 +549,7 @@ static int do_gbb(int argc, char *argv[])
 			print_hwid_digest(gbb, "digest: ", "\n");
 
 		if (sel_roothash)
-			verify_ryu_root_header(inbuf, filesize, gbb);
+			verify_ryu_root_header(inbuf, insize, gbb);
 
 		if (sel_flags)
 			printf("flags: 0x%08x\n", gbb->flags);
@@ -540,37 +590,22 @@ static int do_gbb(int argc, char *argv[])
 			return 1;
 		}
 
-		/* With no args, we'll either copy it unchanged or do nothing */
-		inbuf = read_entire_file(infile, &filesize);
+		/*
+		 * With no args, we'll either copy it unchanged or do nothing.
+		 * Changes are made to a private mapping of the image, so
+		 * nothing is written if anything goes wrong.
+		 */
+		inbuf = map_entire_file(infile, &insize);
 		if (!inbuf)
 			break;
 
-		gbb = FindGbbHeader(inbuf, filesize);
+		gbb = FindGbbHeader(inbuf, insize);
 		if (!gbb) {
 			fprintf(stderr, "ERROR: No GBB found in %s\n", infile);
 			break;
 		}
 		gbb_base = (uint8_t *) gbb;
 
-		outbuf = (uint8_t *) malloc(filesize);
-		if (!outbuf) {
-			errorcnt++;
-			fprintf(stderr,
-				"ERROR: can't malloc %" PRIi64 " bytes: %s\n",
-				filesize, strerror(errno));
-			break;
-		}
-
-		/* Switch pointers to outbuf */
-		memcpy(outbuf, inbuf, filesize);
-		gbb = FindGbbHeader(outbuf, filesize);
-		if (!gbb) {
-			fprintf(stderr,
-				"INTERNAL ERROR: No GBB found in outbuf\n");
-			exit(1);
-		}
-		gbb_base = (uint8_t *) gbb;
-
 		if (opt_hwid) {
 			if (strlen(opt_hwid) + 1 > gbb->hwid_size) {
 				fprintf(stderr,
@@ -607,7 +642,7 @@ static int do_gbb(int argc, char *argv[])
 				       gbb_base + gbb->rootkey_offset,
 				       gbb->rootkey_size);
 
-			if (fill_ryu_root_header(outbuf, filesize, gbb))
+			if (fill_ryu_root_header(inbuf, insize, gbb))
 				errorcnt++;
 		}
 		if (opt_bmpfv)
@@ -619,10 +654,24 @@ static int do_gbb(int argc, char *argv[])
 				       gbb_base + gbb->recovery_key_offset,
 				       gbb->recovery_key_size);
 
-		/* Write it out if there are no problems. */
-		if (!errorcnt)
+		/*
+		 * Write it out if there are no problems.  Updating the image
+		 * in place only needs the GBB written, unless a new root key
+		 * may also have changed the ryu root header elsewhere.  The
+		 * input is still mapped, so it mustn't be truncated.
+		 */
+		if (errorcnt)
+			break;
+		if (!same_file(infile, outfile))
 			write_to_file("successfully saved new image to:",
-				      outfile, outbuf, filesize);
+				      outfile, inbuf, insize);
+		else if (opt_rootkey)
+			write_in_place("successfully saved new image to:",
+				       outfile, inbuf, insize, 0);
+		else
+			write_in_place("successfully saved new image to:",
+				       outfile, gbb_base, gbb_extent(gbb),
+				       gbb_base - inbuf);
 
 		break;
 
@@ -652,7 +701,7 @@ static int do_gbb(int argc, char *argv[])
 	}
 
 	if (inbuf)
-		free(inbuf);
+		futil_unmap_file(-1, 0, inbuf, insize);
 	if (outbuf)
 		free(outbuf);
 	return !!errorcnt;
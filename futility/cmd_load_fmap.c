@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -55,42 +56,134 @@ static const struct option long_opts[] = {
 static const char *short_opts = ":o:";
 
 
-static int copy_to_area(char *file, uint8_t *buf, uint32_t len, char *area)
+/* One AREA:file argument, read in before anything in the image changes */
+struct area_edit {
+	const char *area;
+	const char *file;
+	uint32_t offset;
+	uint32_t size;
+	uint8_t *data;		/* what was read, up to size bytes */
+	uint32_t data_len;
+};
+
+static int read_for_area(struct area_edit *edit)
 {
 	FILE *fp;
 	int retval = 0;
 	int n;
 
-	fp = fopen(file, "r");
+	edit->data = malloc(edit->size ? edit->size : 1);
+	if (!edit->data) {
+		fprintf(stderr, "area %s: out of memory\n", edit->area);
+		return 1;
+	}
+
+	fp = fopen(edit->file, "r");
 	if (!fp) {
 		fprintf(stderr, "area %s: can't open %s for reading: %s\n",
-			area, file, strerror(errno));
+			edit->area, edit->file, strerror(errno));
 		return 1;
 	}
 
-	n = fread(buf, 1, len, fp);
+	n = fread(edit->data, 1, edit->size, fp);
 	if (n == 0) {
 		if (feof(fp))
 			fprintf(stderr, "area %s: unexpected EOF on %s\n",
-				area, file);
+				edit->area, edit->file);
 		if (ferror(fp))
 			fprintf(stderr, "area %s: can't read from %s: %s\n",
-				area, file, strerror(errno));
+				edit->area, edit->file, strerror(errno));
 		retval = 1;
-	} else if (n < len) {
+	} else if (n < edit->size) {
 		fprintf(stderr, "Warning on area %s: only read %d "
-			"(not %d) from %s\n", area, n, len, file);
+			"(not %d) from %s\n", edit->area, n, edit->size,
+			edit->file);
 	}
+	edit->data_len = n;
 
 	if (0 != fclose(fp)) {
 		fprintf(stderr, "area %s: error closing %s: %s\n",
-			area, file, strerror(errno));
+			edit->area, edit->file, strerror(errno));
 		retval = 1;
 	}
 
 	return retval;
 }
 
+/*
+ * Finds each area in the FMAP of the image in buf, and reads in what goes
+ * there.  Returns non-zero if any of that fails, so nothing gets changed.
+ */
+static int prepare_edits(uint8_t *buf, uint32_t len, const char *infile,
+			 struct area_edit *edits, int count, char *argv[])
+{
+	FmapHeader *fmap;
+	FmapAreaHeader *ah;
+	int i;
+
+	fmap = fmap_find(buf, len);
+	if (!fmap) {
+		fprintf(stderr, "Can't find an FMAP in %s\n", infile);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct area_edit *edit = edits + i;
+		char *a = argv[i];
+		char *f = strchr(a, ':');
+
+		if (!f || a == f || *(f+1) == '\0') {
+			fprintf(stderr, "argument \"%s\" is bogus\n", a);
+			return 1;
+		}
+		*f++ = '\0';
+		edit->area = a;
+		edit->file = f;
+
+		if (!fmap_find_by_name(buf, len, fmap, a, &ah)) {
+			fprintf(stderr, "Can't find area \"%s\" in FMAP\n", a);
+			return 1;
+		}
+		if ((uint64_t)ah->area_offset + ah->area_size > len) {
+			fprintf(stderr, "Area \"%s\" is outside of %s\n",
+				a, infile);
+			return 1;
+		}
+		edit->offset = ah->area_offset;
+		edit->size = ah->area_size;
+
+		if (0 != read_for_area(edit))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Writes the edits through the map, and flushes just the pages they touch. */
+static int apply_edits(uint8_t *buf, const struct area_edit *edits,
+		       int count)
+{
+	uintptr_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+	uintptr_t start, end;
+	int i, retval = 0;
+
+	for (i = 0; i < count; i++)
+		memcpy(buf + edits[i].offset, edits[i].data,
+		       edits[i].data_len);
+
+	for (i = 0; i < count; i++) {
+		if (!edits[i].data_len)
+			continue;
+		start = (uintptr_t)(buf + edits[i].offset) & ~page_mask;
+		end = (uintptr_t)(buf + edits[i].offset + edits[i].data_len);
+		if (0 != msync((void *)start, end - start, MS_SYNC)) {
+			fprintf(stderr, "msync failed: %s\n", strerror(errno));
+			retval = 1;
+		}
+	}
+
+	return retval;
+}
 
 static int do_load_fmap(int argc, char *argv[])
 {
@@ -98,8 +191,8 @@ static int do_load_fmap(int argc, char *argv[])
 	char *outfile = 0;
 	uint8_t *buf;
 	uint32_t len;
-	FmapHeader *fmap;
-	FmapAreaHeader *ah;
+	struct area_edit *edits = NULL;
+	int count = 0;
 	int errorcnt = 0;
 	int fd, i;
 
@@ -143,6 +236,32 @@ static int do_load_fmap(int argc, char *argv[])
 	}
 
 	infile = argv[optind++];
+	count = argc - optind;
+	edits = calloc(count, sizeof(*edits));
+	if (!edits) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	/* Check all the areas and read in their contents first */
+	fd = open(infile, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n",
+			infile, strerror(errno));
+		errorcnt++;
+		goto done;
+	}
+	if (futil_map_file(fd, MAP_RO, &buf, &len)) {
+		close(fd);
+		errorcnt++;
+		goto done;
+	}
+	errorcnt += prepare_edits(buf, len, infile, edits, count,
+				  argv + optind);
+	errorcnt += futil_unmap_file(fd, MAP_RO, buf, len);
+	close(fd);
+	if (errorcnt)
+		goto done;
 
 	/* okay, let's do it ... */
 	if (outfile)
@@ -154,54 +273,39 @@ static int do_load_fmap(int argc, char *argv[])
 	if (fd < 0) {
 		fprintf(stderr, "Can't open %s: %s\n",
 			outfile, strerror(errno));
-		return 1;
+		errorcnt++;
+		goto done;
 	}
 
 	errorcnt |= futil_map_file(fd, MAP_RW, &buf, &len);
 	if (errorcnt)
 		goto done_file;
 
-	fmap = fmap_find(buf, len);
-	if (!fmap) {
-		fprintf(stderr, "Can't find an FMAP in %s\n", infile);
-		errorcnt++;
-		goto done_map;
-	}
-
-	for (i = optind; i < argc; i++) {
-		char *a = argv[i];
-		char *f = strchr(a, ':');
-
-		if (!f || a == f || *(f+1) == '\0') {
-			fprintf(stderr, "argument \"%s\" is bogus\n", a);
-			errorcnt++;
-			break;
-		}
-		*f++ = '\0';
-		uint8_t *area_buf = fmap_find_by_name(buf, len, fmap, a, &ah);
-		if (!area_buf) {
-			fprintf(stderr, "Can't find area \"%s\" in FMAP\n", a);
+	/* It's the file we checked (or a copy), unless it changed since */
+	for (i = 0; i < count; i++)
+		if ((uint64_t)edits[i].offset + edits[i].size > len) {
+			fprintf(stderr, "%s changed size\n", outfile);
 			errorcnt++;
 			break;
 		}
+	if (!errorcnt)
+		errorcnt |= apply_edits(buf, edits, count);
 
-		if (0 != copy_to_area(f, area_buf, ah->area_size, a)) {
-			errorcnt++;
-			break;
-		}
-	}
-
-done_map:
-	errorcnt |= futil_unmap_file(fd, 1, buf, len);
+	/* Only the areas changed, and they're already written */
+	errorcnt |= futil_unmap_file(fd, MAP_RO, buf, len);
 
 done_file:
-
 	if (0 != close(fd)) {
 		fprintf(stderr, "Error closing %s: %s\n",
 			outfile, strerror(errno));
 		errorcnt++;
 	}
 
+done:
+	for (i = 0; i < count; i++)
+		free(edits[i].data);
+	free(edits);
+
 	return !!errorcnt;
 }
 
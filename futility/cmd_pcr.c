@@ -5,9 +5,11 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "2sysincludes.h"
@@ -17,6 +19,7 @@
 
 static const char usage[] = "\n"
 	"Usage:  " MYNAME " %s [OPTIONS] DIGEST [...]\n"
+	"        " MYNAME " %s [OPTIONS] -f LOGFILE [...]\n"
 	"\n"
 	"This simulates a TPM PCR extension, to determine the expected output\n"
 	"\n"
@@ -24,21 +27,30 @@ static const char usage[] = "\n"
 	"appropriate length. The PCR is extended with each digest in turn\n"
 	"and the new value displayed.\n"
 	"\n"
+	"With -f, each LOGFILE (or \"-\" for stdin) holds the digests to\n"
+	"extend, one per line.  Blank lines and lines starting with '#' are\n"
+	"ignored.  Each log is replayed on its own, from a PCR of all zeros,\n"
+	"and only the final value is displayed.\n"
+	"\n"
 	"Options:\n"
 	"  -i      Initialize the PCR with the first DIGEST argument\n"
 	"            (the default is to start with all zeros)\n"
 	"  -2      Use sha256 DIGESTS (the default is sha1)\n"
+	"  -f      Read the digests from LOGFILEs\n"
+	"  -b      With -f, the LOGFILEs hold raw binary digests, back to\n"
+	"            back, instead of hex text\n"
 	"\n"
 	"Examples:\n"
 	"\n"
 	"  " MYNAME " %s b52791126f96a21a8ba4d511c6f25a1c1eb6dc9e\n"
 	"  " MYNAME " %s "
 	"'b5 27 91 12 6f 96 a2 1a 8b a4 d5 11 c6 f2 5a 1c 1e b6 dc 9e'\n"
+	"  " MYNAME " %s -2 -f device1.log device2.log\n"
 	"\n";
 
 static void print_help(int argc, char *argv[])
 {
-	printf(usage, argv[0], argv[0], argv[0]);
+	printf(usage, argv[0], argv[0], argv[0], argv[0], argv[0]);
 }
 
 static int parse_hex(uint8_t *val, const char *str)
@@ -67,7 +79,11 @@ static int parse_hex(uint8_t *val, const char *str)
 	return 1;
 }
 
-static void parse_digest_or_die(uint8_t *buf, int len, const char *str)
+/*
+ * Parses a hex string of exactly 'len' bytes (spaces optional) into 'buf'.
+ * Returns 1 on success, 0 on failure.
+ */
+static int parse_digest(uint8_t *buf, int len, const char *str)
 {
 	const char *s = str;
 	int i;
@@ -86,12 +102,102 @@ static void parse_digest_or_die(uint8_t *buf, int len, const char *str)
 		buf++;
 	}
 
-	if (i != len) {
+	return i == len;
+}
+
+static void parse_digest_or_die(uint8_t *buf, int len, const char *str)
+{
+	if (!parse_digest(buf, len, str)) {
 		fprintf(stderr, "Invalid DIGEST \"%s\"\n", str);
 		exit(1);
 	}
 }
 
+/* Extends 'pcr' with 'digest'.  Returns 0 on success, non-zero on error. */
+static int extend_pcr(uint8_t *pcr, const uint8_t *digest, int digest_size,
+		      enum vb2_hash_algorithm digest_alg)
+{
+	uint8_t accum[VB2_MAX_DIGEST_SIZE * 2];
+
+	memcpy(accum, pcr, digest_size);
+	memcpy(accum + digest_size, digest, digest_size);
+	if (VB2_SUCCESS != vb2_digest_buffer(accum, digest_size * 2,
+					     digest_alg, pcr, digest_size)) {
+		fprintf(stderr, "Error computing digest!\n");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Replays the log in 'filename' into a zeroed 'pcr', reading it as it goes
+ * so logs of any length only need one digest in memory.
+ * Returns 0 on success, non-zero on error.
+ */
+static int replay_log(uint8_t *pcr, const char *filename, int binary,
+		      int digest_size, enum vb2_hash_algorithm digest_alg)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	FILE *fp = stdin;
+	char *line = NULL;
+	size_t line_size = 0;
+	int line_number = 0;
+	int rv = 0;
+
+	if (strcmp(filename, "-")) {
+		fp = fopen(filename, binary ? "rb" : "r");
+		if (!fp) {
+			fprintf(stderr, "Can't open %s: %s\n", filename,
+				strerror(errno));
+			return 1;
+		}
+	}
+
+	memset(pcr, 0, VB2_MAX_DIGEST_SIZE);
+
+	if (binary) {
+		size_t got;
+
+		while ((got = fread(digest, 1, digest_size, fp)) ==
+		       digest_size) {
+			rv = extend_pcr(pcr, digest, digest_size, digest_alg);
+			if (rv)
+				break;
+		}
+		if (!rv && got) {
+			fprintf(stderr, "%s: partial digest at the end\n",
+				filename);
+			rv = 1;
+		}
+	} else {
+		while (!rv && getline(&line, &line_size, fp) != -1) {
+			const char *s = line;
+
+			line_number++;
+			while (*s && isspace(*s))
+				s++;
+			if (!*s || *s == '#')
+				continue;
+			if (!parse_digest(digest, digest_size, s)) {
+				fprintf(stderr, "%s:%d: invalid DIGEST\n",
+					filename, line_number);
+				rv = 1;
+				break;
+			}
+			rv = extend_pcr(pcr, digest, digest_size, digest_alg);
+		}
+		free(line);
+	}
+
+	if (!rv && ferror(fp)) {
+		fprintf(stderr, "Error reading %s\n", filename);
+		rv = 1;
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return rv;
+}
+
 static void print_digest(const uint8_t *buf, int len)
 {
 	int i;
@@ -108,16 +214,18 @@ static const struct option long_opts[] = {
 };
 static int do_pcr(int argc, char *argv[])
 {
-	uint8_t accum[VB2_MAX_DIGEST_SIZE * 2];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint8_t pcr[VB2_MAX_DIGEST_SIZE];
 	int digest_alg = VB2_HASH_SHA1;
 	int digest_size;
 	int opt_init = 0;
+	int opt_file = 0;
+	int opt_binary = 0;
 	int errorcnt = 0;
 	int i;
 
 	opterr = 0;		/* quiet, you */
-	while ((i = getopt_long(argc, argv, ":i2", long_opts, NULL)) != -1) {
+	while ((i = getopt_long(argc, argv, ":i2fb", long_opts, NULL)) != -1) {
 		switch (i) {
 		case 'i':
 			opt_init = 1;
@@ -125,6 +233,12 @@ static int do_pcr(int argc, char *argv[])
 		case '2':
 			digest_alg = VB2_HASH_SHA256;
 			break;
+		case 'f':
+			opt_file = 1;
+			break;
+		case 'b':
+			opt_binary = 1;
+			break;
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -145,6 +259,15 @@ static int do_pcr(int argc, char *argv[])
 		}
 	}
 
+	if (opt_file && opt_init) {
+		fprintf(stderr, "-i can't be used with -f\n");
+		errorcnt++;
+	}
+	if (opt_binary && !opt_file) {
+		fprintf(stderr, "-b needs -f\n");
+		errorcnt++;
+	}
+
 	if (errorcnt) {
 		print_help(argc, argv);
 		return 1;
@@ -164,6 +287,20 @@ static int do_pcr(int argc, char *argv[])
 		return 1;
 	}
 
+	if (opt_file) {
+		for (i = optind; i < argc; i++) {
+			if (replay_log(pcr, argv[i], opt_binary, digest_size,
+				       digest_alg)) {
+				errorcnt++;
+				continue;
+			}
+			printf("%s: ", argv[i]);
+			print_digest(pcr, digest_size);
+			printf("\n");
+		}
+		return !!errorcnt;
+	}
+
 	if (opt_init) {
 		parse_digest_or_die(pcr, digest_size, argv[optind]);
 		optind++;
@@ -174,19 +311,14 @@ static int do_pcr(int argc, char *argv[])
 	printf("\n");
 
 	for (i = optind; i < argc; i++) {
-		memcpy(accum, pcr, sizeof(pcr));
-		parse_digest_or_die(accum + digest_size, digest_size, argv[i]);
+		parse_digest_or_die(digest, digest_size, argv[i]);
 
 		printf("   + ");
-		print_digest(accum + digest_size, digest_size);
+		print_digest(digest, digest_size);
 		printf("\n");
 
-		if (VB2_SUCCESS != vb2_digest_buffer(accum, digest_size * 2,
-						     digest_alg,
-						     pcr, digest_size)) {
-			fprintf(stderr, "Error computing digest!\n");
+		if (extend_pcr(pcr, digest, digest_size, digest_alg))
 			return 1;
-		}
 
 		printf("PCR: ");
 		print_digest(pcr, digest_size);
@@ -8,8 +8,10 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <fts.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -17,6 +19,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
@@ -35,10 +38,16 @@
 #include "vb2_common.h"
 
 /* Options */
-struct show_option_s show_option = {
+static const struct show_option_s show_option_defaults = {
 	.padding = 65536,
 	.type = FILE_TYPE_UNKNOWN,
 };
+struct show_option_s show_option;
+
+void show_option_reset(void)
+{
+	show_option = show_option_defaults;
+}
 
 /* Shared work buffer */
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
@@ -148,6 +157,104 @@ int ft_show_keyblock(const char *name, uint8_t *buf, uint32_t len, void *data)
 	return retval;
 }
 
+/*
+ * With --cache-dir, the result of verifying a firmware vblock is kept in a
+ * file named for a SHA-256 digest of everything the verification looked at:
+ * the key it was checked against, the vblock and the firmware body.  Only
+ * vblocks which verified are recorded, so finding the file means the same
+ * bytes have been verified before, and needn't be again.  Anyone who can
+ * write to the directory can make anything verify, so it must be trusted.
+ */
+#define CACHE_FW_PREAMBLE_TAG "fw_preamble 1"
+
+static void cache_extend(struct vb2_digest_context *dc,
+			 const void *data, uint32_t size)
+{
+	uint8_t size_buf[sizeof(size)];
+
+	/* Each piece is prefixed with its size, so they can't run together */
+	memcpy(size_buf, &size, sizeof(size));
+	vb2_digest_extend(dc, size_buf, sizeof(size_buf));
+	if (size)
+		vb2_digest_extend(dc, data, size);
+}
+
+static int cache_fw_preamble_path(char *path, size_t path_size,
+				  const struct vb2_public_key *sign_key,
+				  const uint8_t *vblock, uint32_t vblock_size,
+				  const uint8_t *fv_data, uint32_t fv_size)
+{
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	struct vb2_digest_context dc;
+	uint32_t key_info[4];
+	int i, n;
+
+	vb2_digest_init(&dc, VB2_HASH_SHA256);
+	cache_extend(&dc, CACHE_FW_PREAMBLE_TAG,
+		     sizeof(CACHE_FW_PREAMBLE_TAG));
+	if (sign_key) {
+		key_info[0] = sign_key->sig_alg;
+		key_info[1] = sign_key->hash_alg;
+		key_info[2] = sign_key->arrsize;
+		key_info[3] = sign_key->n0inv;
+		cache_extend(&dc, key_info, sizeof(key_info));
+		cache_extend(&dc, sign_key->n,
+			     sign_key->arrsize * sizeof(uint32_t));
+		cache_extend(&dc, sign_key->rr,
+			     sign_key->arrsize * sizeof(uint32_t));
+	} else {
+		cache_extend(&dc, NULL, 0);
+	}
+	cache_extend(&dc, vblock, vblock_size);
+	cache_extend(&dc, fv_data, fv_data ? fv_size : 0);
+	if (VB2_SUCCESS != vb2_digest_finalize(&dc, digest, sizeof(digest)))
+		return 1;
+
+	n = snprintf(path, path_size, "%s/", show_option.cache_dir);
+	for (i = 0; i < sizeof(digest) && n < path_size; i++)
+		n += snprintf(path + n, path_size - n, "%02x", digest[i]);
+
+	return n >= path_size;
+}
+
+/* Returns 1 and sets *good_sig if path records an earlier verification. */
+static int cache_lookup(const char *path, int *good_sig)
+{
+	FILE *fp = fopen(path, "r");
+	int c;
+
+	if (!fp)
+		return 0;
+	c = fgetc(fp);
+	fclose(fp);
+	if (c != '0' && c != '1')
+		return 0;
+
+	VB2_DEBUG("Using cached result %s\n", path);
+	*good_sig = c == '1';
+	return 1;
+}
+
+/* Records a verification in path, replacing it all at once. */
+static void cache_store(const char *path, int good_sig)
+{
+	char tmp[PATH_MAX];
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp))
+		return;
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		VB2_DEBUG("Can't create %s: %s\n", tmp, strerror(errno));
+		return;
+	}
+	if (write(fd, good_sig ? "1\n" : "0\n", 2) != 2 || close(fd) ||
+	    rename(tmp, path)) {
+		VB2_DEBUG("Can't write %s: %s\n", path, strerror(errno));
+		unlink(tmp);
+	}
+}
+
 int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 			void *data)
 {
@@ -157,15 +264,11 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	uint8_t *fv_data = show_option.fv;
 	uint64_t fv_size = show_option.fv_size;
 	struct bios_area_s *fw_body_area = 0;
+	char cache_path[PATH_MAX] = "";
+	int cached = 0;
 	int good_sig = 0;
 	int retval = 0;
 
-	/* Check the hash... */
-	if (VB2_SUCCESS != vb2_verify_keyblock_hash(keyblock, len, &wb)) {
-		printf("%s keyblock component is invalid\n", name);
-		return 1;
-	}
-
 	/*
 	 * If we're being invoked while poking through a BIOS, we should
 	 * be given the keys and data to verify as part of the state. If we
@@ -190,8 +293,27 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 		fw_body_area = &state->area[body_c];
 	}
 
+	/* We'll need to get the firmware body from somewhere... */
+	if (fw_body_area && fw_body_area->is_valid) {
+		fv_data = fw_body_area->buf;
+		fv_size = fw_body_area->len;
+	}
+
+	/* Have we verified all this before? */
+	if (show_option.cache_dir &&
+	    !cache_fw_preamble_path(cache_path, sizeof(cache_path), sign_key,
+				    buf, len, fv_data, fv_size))
+		cached = cache_lookup(cache_path, &good_sig);
+
+	/* Check the hash... */
+	if (!cached &&
+	    VB2_SUCCESS != vb2_verify_keyblock_hash(keyblock, len, &wb)) {
+		printf("%s keyblock component is invalid\n", name);
+		return 1;
+	}
+
 	/* If we have a key, check the signature too */
-	if (sign_key && VB2_SUCCESS ==
+	if (!cached && sign_key && VB2_SUCCESS ==
 	    vb2_verify_keyblock(keyblock, len, sign_key, &wb))
 		good_sig = 1;
 
@@ -208,8 +330,8 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 
 	uint32_t more = keyblock->keyblock_size;
 	struct vb2_fw_preamble *pre2 = (struct vb2_fw_preamble *)(buf + more);
-	if (VB2_SUCCESS != vb2_verify_fw_preamble(pre2, len - more,
-						  &data_key, &wb)) {
+	if (!cached && VB2_SUCCESS != vb2_verify_fw_preamble(pre2, len - more,
+							     &data_key, &wb)) {
 		printf("%s is invalid\n", name);
 		return 1;
 	}
@@ -235,6 +357,9 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	       packed_key_sha1_string(kernel_subkey));
 	printf("  Firmware body size:    %d\n", pre2->body_signature.data_size);
 	printf("  Preamble flags:        %d\n", flags);
+	if (vb2_fw_get_body_chunk_size(pre2))
+		printf("  Body chunk size:       %d\n",
+		       vb2_fw_get_body_chunk_size(pre2));
 
 	if (flags & VB2_FIRMWARE_PREAMBLE_USE_RO_NORMAL) {
 		printf("Preamble requests USE_RO_NORMAL;"
@@ -242,12 +367,6 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 		goto done;
 	}
 
-	/* We'll need to get the firmware body from somewhere... */
-	if (fw_body_area && fw_body_area->is_valid) {
-		fv_data = fw_body_area->buf;
-		fv_size = fw_body_area->len;
-	}
-
 	if (!fv_data) {
 		printf("No firmware body available to verify.\n");
 		if (show_option.strict)
@@ -255,14 +374,16 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 		return 0;
 	}
 
-	if (VB2_SUCCESS !=
-	    vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
-			    &data_key, &wb)) {
+	if (!cached && VB2_SUCCESS !=
+	    vb2_verify_fw_body(fv_data, fv_size, pre2, &data_key, &wb)) {
 		fprintf(stderr, "Error verifying firmware body.\n");
 		return 1;
 	}
 
 done:
+	if (*cache_path && !cached)
+		cache_store(cache_path, good_sig);
+
 	/* Can't trust the BIOS unless everything is signed (in which case
 	 * we've already returned), but standalone files are okay. */
 	if (state || (sign_key && good_sig)) {
@@ -347,6 +468,15 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 	}
 
 	printf("  Flags:                 0x%x\n", vb2_kernel_get_flags(pre2));
+	if (vb2_kernel_get_body_chunk_size(pre2))
+		printf("  Body chunk size:       0x%x (%u chunks)\n",
+		       vb2_kernel_get_body_chunk_size(pre2),
+		       vb2_kernel_get_body_chunk_count(pre2));
+	uint32_t compression = vb2_kernel_get_body_compression(pre2);
+	if (compression != VB2_KERNEL_COMPRESSION_NONE)
+		printf("  Body compression:      %s (0x%x bytes decompressed)\n",
+		       kernel_compression_name(compression),
+		       vb2_kernel_get_body_size(pre2));
 
 	/* Verify kernel body */
 	uint8_t *kernel_blob = 0;
@@ -368,14 +498,25 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 	}
 
 	if (VB2_SUCCESS !=
-	    vb2_verify_data(kernel_blob, kernel_size, &pre2->body_signature,
-			    &data_key, &wb)) {
+	    vb2_verify_kernel_body(kernel_blob, kernel_size, pre2,
+				   &data_key, &wb)) {
 		fprintf(stderr, "Error verifying kernel body.\n");
 		return 1;
 	}
 
 	printf("Body verification succeeded.\n");
 
+	/* The config is in the decompressed body */
+	if (compression != VB2_KERNEL_COMPRESSION_NONE) {
+		uint8_t *blob = DecompressKernelBlob(pre2, kernel_blob,
+						     kernel_size);
+		if (!blob)
+			return 1;
+		printf("Config:\n%s\n", blob + kernel_cmd_line_offset(pre2));
+		free(blob);
+		return retval;
+	}
+
 	printf("Config:\n%s\n", kernel_blob + kernel_cmd_line_offset(pre2));
 
 	return retval;
@@ -385,9 +526,13 @@ enum no_short_opts {
 	OPT_PADDING = 1000,
 	OPT_TYPE,
 	OPT_PUBKEY,
+	OPT_CACHE_DIR,
 	OPT_HELP,
 };
 
+/* Upper bound for --jobs */
+#define MAX_JOBS 64
+
 static const char usage[] = "\n"
 	"Usage:  " MYNAME " %s [OPTIONS] FILE [...]\n"
 	"\n"
@@ -403,6 +548,10 @@ static const char usage[] = "\n"
 	"\n"
 	"Options:\n"
 	"  -t                               Just show the type of each file\n"
+	"  -r|--recursive                   Summarize all files in the given\n"
+	"                                     directories as JSON\n"
+	"  -j|--jobs        NUM             With --recursive, examine NUM\n"
+	"                                     files at a time (default 1)\n"
 	"  --type           TYPE            Override the detected file type\n"
 	"                                     Use \"--type help\" for a list\n"
 	"Type-specific options:\n"
@@ -410,8 +559,13 @@ static const char usage[] = "\n"
 	"  --pubkey         FILE.vpubk2     Public key in vb2 format\n"
 	"  -f|--fv          FILE            Verify this payload (FW_MAIN_A/B)\n"
 	"  --pad            NUM             Kernel vblock padding size\n"
+	"  --direct                         Read kernel partitions with"
+	" O_DIRECT\n"
 	"  --strict                         "
 	"Fail unless all signatures are valid\n"
+	"  --cache-dir      DIR             Remember firmware vblocks which\n"
+	"                                     verify in DIR, and don't check\n"
+	"                                     them again\n"
 	"\n";
 
 static void print_help(int argc, char *argv[])
@@ -432,11 +586,15 @@ static const struct option long_opts[] = {
 	{"pad",         1, NULL, OPT_PADDING},
 	{"type",        1, NULL, OPT_TYPE},
 	{"strict",      0, &show_option.strict, 1},
+	{"direct",      0, &show_option.direct, 1},
 	{"pubkey",      1, NULL, OPT_PUBKEY},
+	{"recursive",   0, NULL, 'r'},
+	{"jobs",        1, NULL, 'j'},
+	{"cache-dir",   1, NULL, OPT_CACHE_DIR},
 	{"help",        0, NULL, OPT_HELP},
 	{NULL, 0, NULL, 0},
 };
-static const char *short_opts = ":f:k:t";
+static const char *short_opts = ":f:j:k:rt";
 
 
 static int show_type(char *filename)
@@ -468,6 +626,317 @@ static int show_type(char *filename)
 	return 1;
 }
 
+/* One file found by --recursive, and the child summarizing it. */
+struct summary_entry {
+	char *path;
+	FILE *out;		/* JSON record written by the child */
+	pid_t pid;
+	int status;		/* Exit status of the child, or -1 */
+};
+
+/* Prints s as a JSON string, with quotes. */
+static void json_string(FILE *fp, const char *s, size_t max)
+{
+	size_t i;
+
+	fputc('"', fp);
+	for (i = 0; i < max && s[i]; i++) {
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+/* Prints a version string from an FMAP area of a BIOS image, if present. */
+static void json_bios_version(FILE *fp, uint8_t *buf, uint32_t len,
+			      const char *key, const char *area_name)
+{
+	FmapAreaHeader *ah;
+	uint8_t *area = fmap_find_by_name(buf, len, NULL, area_name, &ah);
+	size_t size;
+
+	if (!area || ah->area_offset > len || ah->area_size >
+	    len - ah->area_offset)
+		return;
+	/* Version strings are padded with NUL or 0xff. */
+	for (size = 0; size < ah->area_size && area[size] != 0xff; size++);
+	fprintf(fp, ", \"%s\": ", key);
+	json_string(fp, (const char *)area, size);
+}
+
+/* Prints the data key of a keyblock already recognized by its type. */
+static void json_keyblock(FILE *fp, const struct vb2_keyblock *block)
+{
+	fprintf(fp, ", \"keyblock_flags\": %u", block->keyblock_flags);
+	fprintf(fp, ", \"data_key_version\": %u",
+		block->data_key.key_version);
+	fprintf(fp, ", \"data_key_sha1\": \"%s\"",
+		packed_key_sha1_string(&block->data_key));
+}
+
+/*
+ * Writes the JSON summary of one file to fp.  Called in a child process, so
+ * it is free to change show_option and stdout.
+ * Returns 0 if the file verified, 1 if not, or 2 if it could not be read.
+ */
+static int summarize_file(const char *path, FILE *fp, int type_override)
+{
+	uint8_t digest[VB2_SHA1_DIGEST_SIZE];
+	enum futil_file_type type;
+	uint8_t *buf = NULL;
+	uint32_t len = 0;
+	int ifd, devnull, retval, i;
+
+	ifd = open(path, O_RDONLY);
+	if (ifd < 0 || futil_map_file(ifd, MAP_RO, &buf, &len)) {
+		fprintf(fp, "{ \"file\": ");
+		json_string(fp, path, SIZE_MAX);
+		fprintf(fp, ", \"error\": ");
+		json_string(fp, strerror(errno), SIZE_MAX);
+		fprintf(fp, " }");
+		return 2;
+	}
+
+	type = type_override ? show_option.type : futil_file_type_buf(buf, len);
+
+	fprintf(fp, "{ \"file\": ");
+	json_string(fp, path, SIZE_MAX);
+	fprintf(fp, ", \"type\": \"%s\", \"size\": %u",
+		futil_file_type_name(type), len);
+	vb2_digest_buffer(buf, len, VB2_HASH_SHA1, digest, sizeof(digest));
+	fprintf(fp, ", \"sha1\": \"");
+	for (i = 0; i < sizeof(digest); i++)
+		fprintf(fp, "%02x", digest[i]);
+	fprintf(fp, "\"");
+
+	/* Only trust the structure of types that were recognized. */
+	if (!type_override) {
+		struct vb2_keyblock *block = (struct vb2_keyblock *)buf;
+		struct vb2_packed_key *key = (struct vb2_packed_key *)buf;
+
+		switch (type) {
+		case FILE_TYPE_PUBKEY:
+			fprintf(fp, ", \"key_version\": %u", key->key_version);
+			fprintf(fp, ", \"key_sha1\": \"%s\"",
+				packed_key_sha1_string(key));
+			break;
+		case FILE_TYPE_KEYBLOCK:
+			json_keyblock(fp, block);
+			break;
+		case FILE_TYPE_FW_PREAMBLE: {
+			struct vb2_fw_preamble *pre = (struct vb2_fw_preamble *)
+				(buf + block->keyblock_size);
+			json_keyblock(fp, block);
+			fprintf(fp, ", \"firmware_version\": %u",
+				pre->firmware_version);
+			fprintf(fp, ", \"kernel_key_sha1\": \"%s\"",
+				packed_key_sha1_string(&pre->kernel_subkey));
+			break;
+		}
+		case FILE_TYPE_KERN_PREAMBLE: {
+			struct vb2_kernel_preamble *pre =
+				(struct vb2_kernel_preamble *)
+				(buf + block->keyblock_size);
+			json_keyblock(fp, block);
+			fprintf(fp, ", \"kernel_version\": %u",
+				pre->kernel_version);
+			break;
+		}
+		case FILE_TYPE_BIOS_IMAGE:
+			json_bios_version(fp, buf, len, "ro_version", "RO_FRID");
+			json_bios_version(fp, buf, len, "rw_version_a",
+					  "RW_FWID_A");
+			json_bios_version(fp, buf, len, "rw_version_b",
+					  "RW_FWID_B");
+			break;
+		default:
+			break;
+		}
+	}
+
+	/*
+	 * The verification status is what "futility verify" would say.  The
+	 * show functions write their usual report, which is not wanted here.
+	 * They may also modify buf (in our private mapping), so this has to
+	 * come after everything above.
+	 */
+	retval = 1;
+	if (type != FILE_TYPE_UNKNOWN) {
+		fflush(stdout);
+		devnull = open("/dev/null", O_WRONLY);
+		if (devnull >= 0) {
+			dup2(devnull, STDOUT_FILENO);
+			close(devnull);
+		}
+		show_option.strict = 1;
+		retval = !!futil_file_type_show(type, path, buf, len);
+	}
+	fprintf(fp, ", \"verified\": %s }", retval ? "false" : "true");
+
+	futil_unmap_file(ifd, MAP_RO, buf, len);
+	close(ifd);
+	return retval;
+}
+
+/* Callback for fts_open, so the output is in a stable order. */
+static int compare_fts_names(const FTSENT **a, const FTSENT **b)
+{
+	return strcmp((*a)->fts_name, (*b)->fts_name);
+}
+
+/*
+ * Collects all regular files in the given files and directories.
+ * Returns the number of errors.
+ */
+static int collect_files(char *const *paths, struct summary_entry **entries,
+			 int *count)
+{
+	struct summary_entry *list = NULL, *new_list;
+	int num = 0, errorcnt = 0;
+	FTS *fts;
+	FTSENT *ent;
+
+	fts = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, compare_fts_names);
+	if (!fts) {
+		fprintf(stderr, "Can't walk: %s\n", strerror(errno));
+		return 1;
+	}
+	while ((ent = fts_read(fts)) != NULL) {
+		switch (ent->fts_info) {
+		case FTS_F:
+			break;
+		case FTS_DNR:
+		case FTS_ERR:
+		case FTS_NS:
+			fprintf(stderr, "Can't read %s: %s\n", ent->fts_path,
+				strerror(ent->fts_errno));
+			errorcnt++;
+			continue;
+		default:
+			continue;
+		}
+		new_list = realloc(list, (num + 1) * sizeof(*list));
+		if (!new_list) {
+			fprintf(stderr, "Out of memory\n");
+			errorcnt++;
+			break;
+		}
+		list = new_list;
+		memset(&list[num], 0, sizeof(list[num]));
+		list[num].path = strdup(ent->fts_path);
+		list[num].status = -1;
+		num++;
+	}
+	fts_close(fts);
+	*entries = list;
+	*count = num;
+	return errorcnt;
+}
+
+/*
+ * Starts summarizing one file in a child process.
+ * Returns zero on success.
+ */
+static int start_summary_entry(struct summary_entry *entry, int type_override)
+{
+	entry->out = tmpfile();
+	if (!entry->out) {
+		fprintf(stderr, "Can't create temporary file: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	/* Don't let the child repeat anything still buffered. */
+	fflush(NULL);
+
+	entry->pid = fork();
+	if (entry->pid < 0) {
+		fprintf(stderr, "Can't fork to show %s: %s\n", entry->path,
+			strerror(errno));
+		return 1;
+	}
+	if (entry->pid == 0) {
+		int r = summarize_file(entry->path, entry->out, type_override);
+		exit(fflush(entry->out) ? 2 : r);
+	}
+	return 0;
+}
+
+/*
+ * Shows a JSON summary of all files in the given files and directories,
+ * using up to jobs processes at a time.
+ * Returns the number of errors.
+ */
+static int show_recursive(char *const *paths, int jobs, int type_override)
+{
+	struct summary_entry *entries = NULL;
+	int count = 0, next = 0, running = 0;
+	int errorcnt;
+	int i, c, status;
+	pid_t pid;
+
+	errorcnt = collect_files(paths, &entries, &count);
+
+	while (next < count || running) {
+		while (next < count && running < jobs) {
+			if (!start_summary_entry(&entries[next],
+						 type_override))
+				running++;
+			next++;
+		}
+		if (!running)
+			continue;
+
+		pid = wait(&status);
+		if (pid < 0) {
+			fprintf(stderr, "Error waiting for workers: %s\n",
+				strerror(errno));
+			errorcnt++;
+			break;
+		}
+		for (i = 0; i < count; i++) {
+			if (entries[i].pid != pid)
+				continue;
+			entries[i].status = WIFEXITED(status) ?
+				WEXITSTATUS(status) : -1;
+			running--;
+			break;
+		}
+	}
+
+	printf("[");
+	for (i = 0; i < count; i++) {
+		printf("%s\n  ", i ? "," : "");
+		if (entries[i].status < 0 || entries[i].status > 2 ||
+		    !entries[i].out) {
+			printf("{ \"file\": ");
+			json_string(stdout, entries[i].path, SIZE_MAX);
+			printf(", \"error\": \"failed to examine\" }");
+			errorcnt++;
+		} else {
+			rewind(entries[i].out);
+			while ((c = getc(entries[i].out)) != EOF)
+				putchar(c);
+			/* Unverified files only count with --strict. */
+			if (entries[i].status == 2 ||
+			    (entries[i].status && show_option.strict))
+				errorcnt++;
+		}
+		if (entries[i].out)
+			fclose(entries[i].out);
+		free(entries[i].path);
+	}
+	printf("\n]\n");
+
+	free(entries);
+	return errorcnt;
+}
+
 static int do_show(int argc, char *argv[])
 {
 	uint8_t *pubkbuf = NULL;
@@ -479,6 +948,7 @@ static int do_show(int argc, char *argv[])
 	uint32_t len;
 	char *e = 0;
 	int type_override = 0;
+	int recursive = 0, jobs = 1;
 	enum futil_file_type type;
 
 	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
@@ -515,6 +985,19 @@ static int do_show(int argc, char *argv[])
 		case 't':
 			show_option.t_flag = 1;
 			break;
+		case 'r':
+			recursive = 1;
+			break;
+		case 'j':
+			jobs = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || jobs < 1 ||
+			    jobs > MAX_JOBS) {
+				fprintf(stderr,
+					"Invalid --jobs \"%s\" (1-%d)\n",
+					optarg, MAX_JOBS);
+				errorcnt++;
+			}
+			break;
 		case OPT_PADDING:
 			show_option.padding = strtoul(optarg, &e, 0);
 			if (!*optarg || (e && *e)) {
@@ -540,6 +1023,9 @@ static int do_show(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_CACHE_DIR:
+			show_option.cache_dir = optarg;
+			break;
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -574,6 +1060,11 @@ static int do_show(int argc, char *argv[])
 		return 1;
 	}
 
+	if (recursive) {
+		errorcnt += show_recursive(argv + optind, jobs, type_override);
+		goto done;
+	}
+
 	if (show_option.t_flag) {
 		for (i = optind; i < argc; i++)
 			errorcnt += show_type(argv[i]);
@@ -582,6 +1073,21 @@ static int do_show(int argc, char *argv[])
 
 	for (i = optind; i < argc; i++) {
 		infile = argv[i];
+
+		/* A kernel partition only needs its vblock and signed body */
+		if (!show_option.fv && (!type_override || show_option.type ==
+					FILE_TYPE_KERN_PREAMBLE)) {
+			buf = ReadKernelPartition(infile, show_option.padding,
+						  show_option.direct, &len);
+			if (buf) {
+				errorcnt += futil_file_type_show(
+					FILE_TYPE_KERN_PREAMBLE, infile,
+					buf, len);
+				free(buf);
+				continue;
+			}
+		}
+
 		ifd = open(infile, O_RDONLY);
 		if (ifd < 0) {
 			errorcnt++;
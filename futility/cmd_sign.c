@@ -15,9 +15,12 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "2common.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
 #include "file_type.h"
 #include "file_type_bios.h"
 #include "fmap.h"
@@ -34,7 +37,7 @@
 #include "vboot_common.h"
 
 /* Options */
-struct sign_option_s sign_option = {
+static const struct sign_option_s sign_option_defaults = {
 	.version = 1,
 	.arch = ARCH_UNSPECIFIED,
 	.kloadaddr = CROS_32BIT_ENTRY_ADDR,
@@ -47,6 +50,12 @@ struct sign_option_s sign_option = {
 	.rw_offset = 0xffffffff,
 	.sig_size = 1024,
 };
+struct sign_option_s sign_option;
+
+void sign_option_reset(void)
+{
+	sign_option = sign_option_defaults;
+}
 
 /* Helper to complain about invalid args. Returns num errors discovered */
 static int no_opt_if(int expr, const char *optname)
@@ -79,7 +88,7 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 				sign_option.flags,
 				sign_option.pem_external);
 		} else {
-			sign_option.signprivate = vb2_read_private_key_pem(
+			sign_option.signprivate = vb2_get_private_key_pem(
 				sign_option.pem_signpriv,
 				sign_option.pem_algo);
 			if (!sign_option.signprivate) {
@@ -104,11 +113,93 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 			      NULL, 0);
 }
 
+/*
+ * Signs a kernel body with --signprivate and keyblock, and with the keys of
+ * each --keyset, hashing the body only once for all of them.  The vblock for
+ * each --keyset is written to its own OUTFILE, followed by the body unless
+ * --vblockonly.  Returns the vblock for --signprivate, or NULL if error.
+ * Caller must free() it.
+ */
+static uint8_t *sign_kernel_body(uint8_t *body_data, uint32_t body_size,
+				 uint32_t body_write_size,
+				 uint32_t uncompressed_size,
+				 struct vb2_keyblock *keyblock,
+				 uint32_t *vblock_size_ptr)
+{
+	int count = sign_option.keyset_count + 1;
+	struct kernel_signer *signers;
+	struct sign_keyset *keyset;
+	uint8_t *vblock;
+	int i, errorcnt = 0;
+
+	if (!sign_option.keyset_count)
+		return SignKernelBlob(body_data, body_size,
+				      sign_option.padding,
+				      sign_option.version,
+				      sign_option.kloadaddr,
+				      keyblock,
+				      sign_option.signprivate,
+				      sign_option.flags,
+				      sign_option.chunk_size,
+				      sign_option.compression,
+				      uncompressed_size,
+				      vblock_size_ptr);
+
+	signers = calloc(count, sizeof(*signers));
+	if (!signers)
+		return NULL;
+	signers[0].keyblock = keyblock;
+	signers[0].signpriv_key = sign_option.signprivate;
+	for (i = 1; i < count; i++) {
+		signers[i].keyblock = sign_option.keysets[i - 1].keyblock;
+		signers[i].signpriv_key = sign_option.keysets[i - 1].signprivate;
+	}
+
+	if (SignKernelBlobMultiple(body_data, body_size,
+				   sign_option.padding,
+				   sign_option.version,
+				   sign_option.kloadaddr,
+				   sign_option.flags,
+				   sign_option.chunk_size,
+				   sign_option.compression,
+				   uncompressed_size,
+				   signers, count)) {
+		free(signers);
+		return NULL;
+	}
+
+	for (i = 1; i < count; i++) {
+		keyset = &sign_option.keysets[i - 1];
+		if (sign_option.vblockonly)
+			errorcnt += !!WriteSomeParts(keyset->outfile,
+						     signers[i].vblock,
+						     signers[i].vblock_size,
+						     NULL, 0);
+		else
+			errorcnt += !!WriteSomeParts(keyset->outfile,
+						     signers[i].vblock,
+						     signers[i].vblock_size,
+						     body_data,
+						     body_write_size);
+		free(signers[i].vblock);
+	}
+
+	vblock = signers[0].vblock;
+	*vblock_size_ptr = signers[0].vblock_size;
+	free(signers);
+	if (errorcnt) {
+		free(vblock);
+		return NULL;
+	}
+	return vblock;
+}
+
 int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 		       void *data)
 {
-	uint8_t *vmlinuz_data, *kblob_data, *vblock_data;
+	uint8_t *vmlinuz_data, *kblob_data, *vblock_data, *body_data;
 	uint32_t vmlinuz_size, kblob_size, vblock_size;
+	uint32_t body_size, body_write_size;
 	int rv;
 
 	vmlinuz_data = buf;
@@ -126,15 +217,25 @@ int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 	}
 	VB2_DEBUG("kblob_size = 0x%x\n", kblob_size);
 
-	vblock_data = SignKernelBlob(kblob_data, kblob_size,
-				     sign_option.padding,
-				     sign_option.version,
-				     sign_option.kloadaddr,
-				     sign_option.keyblock,
-				     sign_option.signprivate,
-				     sign_option.flags, &vblock_size);
+	/* The blob is signed and written as it is stored */
+	body_data = kblob_data;
+	body_size = body_write_size = kblob_size;
+	if (sign_option.compression != VB2_KERNEL_COMPRESSION_NONE) {
+		body_data = CompressKernelBlob(kblob_data, kblob_size,
+					       &body_size, &body_write_size);
+		if (!body_data) {
+			free(kblob_data);
+			return 1;
+		}
+	}
+
+	vblock_data = sign_kernel_body(body_data, body_size, body_write_size,
+				       kblob_size, sign_option.keyblock,
+				       &vblock_size);
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
+		if (body_data != kblob_data)
+			free(body_data);
 		free(kblob_data);
 		return 1;
 	}
@@ -152,9 +253,11 @@ int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 	else
 		rv = WriteSomeParts(sign_option.outfile,
 				    vblock_data, vblock_size,
-				    kblob_data, kblob_size);
+				    body_data, body_write_size);
 
 	free(vblock_data);
+	if (body_data != kblob_data)
+		free(body_data);
 	free(kblob_data);
 	return rv;
 }
@@ -162,8 +265,9 @@ int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 			  void *data)
 {
-	uint8_t *kpart_data, *kblob_data, *vblock_data;
+	uint8_t *kpart_data, *kblob_data, *vblock_data, *body_data;
 	uint32_t kpart_size, kblob_size, vblock_size;
+	uint32_t body_size, body_write_size;
 	struct vb2_keyblock *keyblock = NULL;
 	struct vb2_kernel_preamble *preamble = NULL;
 	int rv = 0;
@@ -171,7 +275,10 @@ int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 	kpart_data = buf;
 	kpart_size = len;
 
-	/* Note: This just sets some static pointers. It doesn't malloc. */
+	/*
+	 * Note: This just sets some static pointers. It doesn't malloc, unless
+	 * the blob is compressed.
+	 */
 	kblob_data = unpack_kernel_partition(kpart_data, kpart_size,
 					     sign_option.padding,
 					     &keyblock, &preamble, &kblob_size);
@@ -208,22 +315,39 @@ int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 	if (sign_option.flags_specified == 0)
 		sign_option.flags = kernel_flags;
 
+	/* Preserve the body chunk size if not specified */
+	if (!sign_option.chunk_size_specified)
+		sign_option.chunk_size =
+			vb2_kernel_get_body_chunk_size(preamble);
+
+	/* Preserve the body compression if not specified */
+	int was_compressed = vb2_kernel_get_body_compression(preamble) !=
+		VB2_KERNEL_COMPRESSION_NONE;
+	if (!sign_option.compression_specified)
+		sign_option.compression =
+			vb2_kernel_get_body_compression(preamble);
+
 	/* Replace the keyblock if asked */
 	if (sign_option.keyblock)
 		keyblock = sign_option.keyblock;
 
+	/* The blob is signed and written as it is stored */
+	body_data = kblob_data;
+	body_size = body_write_size = kblob_size;
+	if (sign_option.compression != VB2_KERNEL_COMPRESSION_NONE) {
+		body_data = CompressKernelBlob(kblob_data, kblob_size,
+					       &body_size, &body_write_size);
+		if (!body_data)
+			return 1;
+	}
+
 	/* Compute the new signature */
-	vblock_data = SignKernelBlob(kblob_data, kblob_size,
-				     sign_option.padding,
-				     sign_option.version,
-				     sign_option.kloadaddr,
-				     keyblock,
-				     sign_option.signprivate,
-				     sign_option.flags,
-				     &vblock_size);
+	vblock_data = sign_kernel_body(body_data, body_size, body_write_size,
+				       kblob_size, keyblock, &vblock_size);
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
-		return 1;
+		rv = 1;
+		goto done;
 	}
 	VB2_DEBUG("vblock_size = 0x%" PRIx64 "\n", vblock_size);
 
@@ -236,7 +360,24 @@ int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 		else
 			rv = WriteSomeParts(sign_option.outfile,
 					    vblock_data, vblock_size,
-					    kblob_data, kblob_size);
+					    body_data, body_write_size);
+	} else if (body_data != kblob_data || was_compressed) {
+		/*
+		 * The blob in the file isn't what was signed, so it has to be
+		 * rewritten too, in whatever space the partition has.
+		 */
+		if (vblock_size > kpart_size ||
+		    body_write_size > kpart_size - vblock_size) {
+			fprintf(stderr, "Kernel blob doesn't fit in %s\n",
+				name);
+			rv = 1;
+		} else {
+			memcpy(kpart_data, vblock_data, vblock_size);
+			memcpy(kpart_data + vblock_size, body_data,
+			       body_write_size);
+			memset(kpart_data + vblock_size + body_write_size, 0,
+			       kpart_size - vblock_size - body_write_size);
+		}
 	} else {
 		/* If we're modifying an existing file, it's mmap'ed so that
 		 * all our modifications to the buffer will get flushed to
@@ -245,46 +386,321 @@ int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 	}
 
 	free(vblock_data);
+ done:
+	if (body_data != kblob_data)
+		free(body_data);
 	return rv;
 }
 
 
-int ft_sign_raw_firmware(const char *name, uint8_t *buf, uint32_t len,
-			 void *data)
+/* Sector size of the disk images ft_sign_disk_image() handles */
+#define DISK_SECTOR_SIZE 512
+
+/* A kernel partition of a disk image, signed by a child process */
+struct disk_kernel {
+	uint32_t number;	/* Partition number, from 1 */
+	uint8_t *buf;
+	uint32_t len;
+	pid_t pid;
+	int failed;
+};
+
+/*
+ * Copies size bytes from sector lba of a disk image to a new buffer, which is
+ * left zeroed if they aren't all in the image.
+ * Returns NULL if out of memory.
+ */
+static uint8_t *copy_disk_sectors(const uint8_t *buf, uint32_t len,
+				  uint64_t lba, uint32_t size)
 {
-	struct vb2_signature *body_sig;
-	struct vb2_fw_preamble *preamble;
-	int rv;
+	uint8_t *copy = calloc(1, size);
+
+	if (copy && lba <= len / DISK_SECTOR_SIZE &&
+	    size <= len - lba * DISK_SECTOR_SIZE)
+		memcpy(copy, buf + lba * DISK_SECTOR_SIZE, size);
+	return copy;
+}
+
+/*
+ * Finds the kernel partitions of a disk image which hold a kernel, using a
+ * copy of its GPT so that nothing in the image is changed even if the GPT
+ * needs repairing.
+ * Returns the number of errors.
+ */
+static int find_disk_kernels(const char *name, uint8_t *buf, uint32_t len,
+			     struct disk_kernel **kernels, int *count)
+{
+	const uint32_t entries_size = MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry);
+	struct disk_kernel *list = NULL;
+	GptHeader *header;
+	GptEntry *e;
+	GptData gpt;
+	uint64_t start, size;
+	int num = 0, errorcnt = 0;
+	uint32_t i;
+
+	memset(&gpt, 0, sizeof(gpt));
+	gpt.sector_bytes = DISK_SECTOR_SIZE;
+	gpt.streaming_drive_sectors = len / DISK_SECTOR_SIZE;
+	gpt.gpt_drive_sectors = gpt.streaming_drive_sectors;
+	gpt.primary_header = copy_disk_sectors(buf, len, 1, DISK_SECTOR_SIZE);
+	gpt.secondary_header = copy_disk_sectors(buf, len,
+						 gpt.gpt_drive_sectors - 1,
+						 DISK_SECTOR_SIZE);
+	if (gpt.primary_header && gpt.secondary_header) {
+		header = (GptHeader *)gpt.primary_header;
+		gpt.primary_entries = copy_disk_sectors(
+			buf, len, header->entries_lba, entries_size);
+		header = (GptHeader *)gpt.secondary_header;
+		gpt.secondary_entries = copy_disk_sectors(
+			buf, len, header->entries_lba, entries_size);
+	}
+	if (!gpt.primary_entries || !gpt.secondary_entries) {
+		fprintf(stderr, "Out of memory\n");
+		errorcnt++;
+		goto done;
+	}
+
+	if (GptInit(&gpt) != GPT_SUCCESS) {
+		fprintf(stderr, "No valid GPT in %s\n", name);
+		errorcnt++;
+		goto done;
+	}
+
+	header = (GptHeader *)gpt.primary_header;
+	list = calloc(header->number_of_entries, sizeof(*list));
+	if (!list) {
+		fprintf(stderr, "Out of memory\n");
+		errorcnt++;
+		goto done;
+	}
+
+	/*
+	 * Unlike GptNextKernelEntry(), take every kernel partition, not just
+	 * the bootable ones; but skip those with no kernel in them yet.
+	 */
+	for (i = 0; i < header->number_of_entries; i++) {
+		e = (GptEntry *)gpt.primary_entries + i;
+		if (!IsKernelEntry(e))
+			continue;
+
+		start = e->starting_lba * DISK_SECTOR_SIZE;
+		size = (e->ending_lba - e->starting_lba + 1) *
+			DISK_SECTOR_SIZE;
+		if (start > len || size > len - start) {
+			fprintf(stderr, "Partition %u is outside %s\n",
+				i + 1, name);
+			errorcnt++;
+			continue;
+		}
+		if (size < KEY_BLOCK_MAGIC_SIZE ||
+		    memcmp(buf + start, KEY_BLOCK_MAGIC,
+			   KEY_BLOCK_MAGIC_SIZE)) {
+			VB2_DEBUG("Skipping partition %u: no kernel\n", i + 1);
+			continue;
+		}
+
+		list[num].number = i + 1;
+		list[num].buf = buf + start;
+		list[num].len = size;
+		num++;
+	}
+
+done:
+	free(gpt.primary_header);
+	free(gpt.secondary_header);
+	free(gpt.primary_entries);
+	free(gpt.secondary_entries);
+	*kernels = list;
+	*count = num;
+	return errorcnt;
+}
+
+/*
+ * Starts signing one kernel partition in a child process.  The image is
+ * mapped shared, so the child's changes go straight to the file, and the
+ * options each kernel keeps from its old preamble stay in the child.
+ * Returns zero on success.
+ */
+static int start_disk_kernel(const char *name, struct disk_kernel *k)
+{
+	char part_name[PATH_MAX];
+
+	snprintf(part_name, sizeof(part_name), "%s partition %u", name,
+		 k->number);
+
+	/* Don't let the child repeat anything still buffered. */
+	fflush(NULL);
 
-	body_sig = vb2_calculate_signature(buf, len, sign_option.signprivate);
-	if (!body_sig) {
-		fprintf(stderr, "Error calculating body signature\n");
+	k->pid = fork();
+	if (k->pid < 0) {
+		fprintf(stderr, "Can't fork to sign %s: %s\n", part_name,
+			strerror(errno));
 		return 1;
 	}
+	if (k->pid == 0)
+		exit(!!ft_sign_kern_preamble(part_name, k->buf, k->len, NULL));
+	return 0;
+}
+
+/*
+ * Signs every kernel partition of a disk image in place, up to
+ * sign_option.jobs at a time (default one per CPU), as if each were signed
+ * on its own.  Nothing else in the image is changed.
+ */
+int ft_sign_disk_image(const char *name, uint8_t *buf, uint32_t len,
+		       void *data)
+{
+	struct disk_kernel *kernels = NULL;
+	int count = 0, next = 0, running = 0, failed = 0;
+	int jobs = sign_option.jobs;
+	int errorcnt;
+	int i, status;
+	pid_t pid;
+
+	if (!jobs)
+		jobs = VB2_MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+
+	errorcnt = find_disk_kernels(name, buf, len, &kernels, &count);
+	if (!errorcnt && !count) {
+		fprintf(stderr, "No kernel partitions to sign in %s\n", name);
+		errorcnt++;
+	}
+
+	while (!errorcnt && (next < count || running)) {
+		while (next < count && running < jobs) {
+			if (start_disk_kernel(name, &kernels[next]))
+				kernels[next].failed = 1;
+			else
+				running++;
+			next++;
+		}
+		if (!running)
+			continue;
+
+		pid = wait(&status);
+		if (pid < 0) {
+			fprintf(stderr, "Error waiting for signers: %s\n",
+				strerror(errno));
+			errorcnt++;
+			break;
+		}
+		for (i = 0; i < count; i++) {
+			if (kernels[i].pid != pid)
+				continue;
+			kernels[i].failed = !WIFEXITED(status) ||
+					    WEXITSTATUS(status);
+			running--;
+			break;
+		}
+	}
+
+	if (!errorcnt) {
+		for (i = 0; i < count; i++) {
+			printf("%-7s %s partition %u\n",
+			       kernels[i].failed ? "FAILED" : "OK", name,
+			       kernels[i].number);
+			failed += kernels[i].failed;
+		}
+		printf("Signed %d of %d kernel partitions\n",
+		       count - failed, count);
+		errorcnt += failed;
+	}
+
+	free(kernels);
+	return errorcnt;
+}
+
+
+/* Writes one firmware vblock for a body signature. Returns non-zero if error. */
+static int write_fw_vblock(const char *outfile,
+			   const struct vb2_signature *body_sig,
+			   struct vb2_keyblock *keyblock,
+			   const struct vb2_private_key *signprivate)
+{
+	struct vb2_fw_preamble *preamble;
+	int rv;
 
 	preamble = vb2_create_fw_preamble(
 			sign_option.version,
 			(struct vb2_packed_key *)sign_option.kernel_subkey,
 			body_sig,
-			sign_option.signprivate,
+			signprivate,
 			sign_option.flags);
 	if (!preamble) {
 		fprintf(stderr, "Error creating firmware preamble.\n");
-		free(body_sig);
 		return 1;
 	}
 
-	rv = WriteSomeParts(sign_option.outfile,
-			    sign_option.keyblock,
-			    sign_option.keyblock->keyblock_size,
+	rv = WriteSomeParts(outfile,
+			    keyblock, keyblock->keyblock_size,
 			    preamble, preamble->preamble_size);
 
 	free(preamble);
-	free(body_sig);
 
 	return rv;
 }
 
+int ft_sign_raw_firmware(const char *name, uint8_t *buf, uint32_t len,
+			 void *data)
+{
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_signature *body_sig;
+	struct vb2_signature **body_sigs;
+	const struct vb2_private_key **keys;
+	struct sign_keyset *keyset;
+	int count = sign_option.keyset_count + 1;
+	int i, rv = 0;
+
+	if (!sign_option.keyset_count) {
+		vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+		body_sig = vb2_calculate_signature_wb(buf, len,
+						      sign_option.signprivate,
+						      &wb);
+		if (!body_sig) {
+			fprintf(stderr, "Error calculating body signature\n");
+			return 1;
+		}
+
+		return write_fw_vblock(sign_option.outfile, body_sig,
+				       sign_option.keyblock,
+				       sign_option.signprivate);
+	}
+
+	/* Hash the body once for every --keyset */
+	body_sigs = calloc(count, sizeof(*body_sigs));
+	keys = calloc(count, sizeof(*keys));
+	if (!body_sigs || !keys) {
+		rv = 1;
+		goto done;
+	}
+	keys[0] = sign_option.signprivate;
+	for (i = 1; i < count; i++)
+		keys[i] = sign_option.keysets[i - 1].signprivate;
+
+	if (vb2_calculate_signatures(body_sigs, buf, len, keys, count)) {
+		fprintf(stderr, "Error calculating body signatures\n");
+		rv = 1;
+		goto done;
+	}
+
+	rv = write_fw_vblock(sign_option.outfile, body_sigs[0],
+			     sign_option.keyblock, sign_option.signprivate);
+	for (i = 1; i < count && !rv; i++) {
+		keyset = &sign_option.keysets[i - 1];
+		rv = write_fw_vblock(keyset->outfile, body_sigs[i],
+				     keyset->keyblock, keyset->signprivate);
+	}
+
+ done:
+	for (i = 0; body_sigs && i < count; i++)
+		free(body_sigs[i]);
+	free(body_sigs);
+	free(keys);
+	return rv;
+}
+
 static const char usage_pubkey[] = "\n"
 	"To sign a public key / create a new keyblock:\n"
 	"\n"
@@ -329,6 +745,10 @@ static const char usage_fw_main[] = "\n"
 	"Optional PARAMS:\n"
 	"  -f|--flags       NUM             The preamble flags value"
 	" (default is 0)\n"
+	"  --keyset KEYBLOCK:SIGNPRIVATE:OUTFILE\n"
+	"                                   Also sign with these keys, into\n"
+	"                                     OUTFILE; may be repeated, and\n"
+	"                                     the blob is hashed only once\n"
 	"\n";
 static void print_help_raw_firmware(int argc, char *argv[])
 {
@@ -391,6 +811,17 @@ static const char usage_new_kpart[] = "\n"
 	" --vblockonly                      Emit just the vblock (requires a\n"
 	"                                     distinct outfile)\n"
 	"  -f|--flags       NUM             The preamble flags value\n"
+	"  --chunk_size     NUM             Hash the kernel blob in chunks of\n"
+	"                                     this many bytes, so they can be\n"
+	"                                     checked in parallel (default 0,\n"
+	"                                     for the whole blob)\n"
+	"  --compress       none|lz4        Compress the kernel blob, so less\n"
+	"                                     of it is read at boot (default\n"
+	"                                     none)\n"
+	"  --keyset KEYBLOCK:SIGNPRIVATE:OUTFILE\n"
+	"                                   Also sign with these keys, into\n"
+	"                                     OUTFILE; may be repeated, and\n"
+	"                                     the blob is hashed only once\n"
 	"\n";
 static void print_help_raw_kernel(int argc, char *argv[])
 {
@@ -417,12 +848,42 @@ static const char usage_old_kpart[] = "\n"
 	"  --vblockonly                     Emit just the vblock (requires a\n"
 	"                                     distinct OUTFILE)\n"
 	"  -f|--flags       NUM             The preamble flags value\n"
+	"  --chunk_size     NUM             Hash the kernel blob in chunks of\n"
+	"                                     this many bytes (default: keep\n"
+	"                                     the old chunk size; 0 for the\n"
+	"                                     whole blob)\n"
+	"  --compress       none|lz4        Compress the kernel blob (default:\n"
+	"                                     keep the old compression)\n"
+	"  --keyset KEYBLOCK:SIGNPRIVATE:OUTFILE\n"
+	"                                   Also sign with these keys, into\n"
+	"                                     OUTFILE; may be repeated, and\n"
+	"                                     the blob is hashed only once\n"
 	"\n";
 static void print_help_kern_preamble(int argc, char *argv[])
 {
 	printf(usage_old_kpart, sign_option.padding);
 }
 
+static const char usage_disk_image[] = "\n"
+	"Usage:  " MYNAME " %s --type %s [PARAMS] INFILE [OUTFILE]\n"
+	"\n"
+	"To resign every kernel partition of a disk image (recovery, test):\n"
+	"\n"
+	"The kernel partitions are found through the GPT, and each one that\n"
+	"holds a kernel is resigned in place, in OUTFILE if given, exactly as\n"
+	"with --type %s.  Nothing else in the image is changed.  The same\n"
+	"PARAMS apply to every kernel, plus:\n"
+	"\n"
+	"  --jobs           NUM             Sign this many kernels at a time\n"
+	"                                     (default: one per CPU)\n";
+static void print_help_disk_image(int argc, char *argv[])
+{
+	printf(usage_disk_image, argv[0],
+	       futil_file_type_name(FILE_TYPE_CHROMIUMOS_DISK),
+	       futil_file_type_name(FILE_TYPE_KERN_PREAMBLE));
+	printf(usage_old_kpart, sign_option.padding);
+}
+
 static void print_help_usbpd1(int argc, char *argv[])
 {
 	const struct vb2_text_vs_enum *entry;
@@ -523,6 +984,7 @@ static void (*help_type[NUM_FILE_TYPES])(int argc, char *argv[]) = {
 	[FILE_TYPE_BIOS_IMAGE] = &print_help_bios_image,
 	[FILE_TYPE_RAW_KERNEL] = &print_help_raw_kernel,
 	[FILE_TYPE_KERN_PREAMBLE] = &print_help_kern_preamble,
+	[FILE_TYPE_CHROMIUMOS_DISK] = &print_help_disk_image,
 	[FILE_TYPE_USBPD1] = &print_help_usbpd1,
 	[FILE_TYPE_RWSIG] = &print_help_rwsig,
 };
@@ -538,16 +1000,24 @@ static const char usage_default[] = "\n"
 	"  full firmware image (bios.bin)      same, or signed in-place\n"
 	"  raw linux kernel (vmlinuz)          kernel partition image\n"
 	"  kernel partition (/dev/sda2)        same, or signed in-place\n"
+	"  chromiumos disk image               same, or signed in-place\n"
 	"  usbpd1 firmware image               same, or signed in-place\n"
 	"  RW device image                     same, or signed in-place\n"
 	"\n"
+	"To sign many files with the same keys, use\n"
+	"\n"
+	"  " MYNAME " %s [PARAMS] --batch FILE [--jobs NUM]\n"
+	"\n"
+	"where each line of FILE is \"INFILE [OUTFILE]\" for one file to sign.\n"
+	"The keys are read once, and up to NUM files are signed at a time.\n"
+	"\n"
 	"For more information, use \"" MYNAME " help %s TYPE\", where\n"
 	"TYPE is one of:\n\n";
 static void print_help_default(int argc, char *argv[])
 {
 	enum futil_file_type type;
 
-	printf(usage_default, argv[0], argv[0]);
+	printf(usage_default, argv[0], argv[0], argv[0]);
 	for (type = 0; type < NUM_FILE_TYPES; type++)
 		if (help_type[type])
 			printf("  %s", futil_file_type_name(type));
@@ -576,6 +1046,8 @@ enum no_short_opts {
 	OPT_ARCH,
 	OPT_KLOADADDR,
 	OPT_PADDING,
+	OPT_CHUNK_SIZE,
+	OPT_COMPRESS,
 	OPT_PEM_SIGNPRIV,
 	OPT_PEM_ALGO,
 	OPT_PEM_EXTERNAL,
@@ -588,6 +1060,9 @@ enum no_short_opts {
 	OPT_DATA_SIZE,
 	OPT_SIG_SIZE,
 	OPT_PRIKEY,
+	OPT_BATCH,
+	OPT_JOBS,
+	OPT_KEYSET,
 	OPT_HELP,
 };
 
@@ -612,6 +1087,8 @@ static const struct option long_opts[] = {
 	{"arch",         1, NULL, OPT_ARCH},
 	{"kloadaddr",    1, NULL, OPT_KLOADADDR},
 	{"pad",          1, NULL, OPT_PADDING},
+	{"chunk_size",   1, NULL, OPT_CHUNK_SIZE},
+	{"compress",     1, NULL, OPT_COMPRESS},
 	{"pem_signpriv", 1, NULL, OPT_PEM_SIGNPRIV},
 	{"pem",          1, NULL, OPT_PEM_SIGNPRIV}, /* alias */
 	{"pem_algo",     1, NULL, OPT_PEM_ALGO},
@@ -627,6 +1104,9 @@ static const struct option long_opts[] = {
 	{"sig_size",     1, NULL, OPT_SIG_SIZE},
 	{"prikey",       1, NULL, OPT_PRIKEY},
 	{"privkey",      1, NULL, OPT_PRIKEY},	/* alias */
+	{"batch",        1, NULL, OPT_BATCH},
+	{"jobs",         1, NULL, OPT_JOBS},
+	{"keyset",       1, NULL, OPT_KEYSET},
 	{"help",         0, NULL, OPT_HELP},
 	{NULL,           0, NULL, 0},
 };
@@ -645,111 +1125,536 @@ static int parse_number_opt(const char *arg, const char *name, uint32_t *dest)
 	return 0;
 }
 
-static int do_sign(int argc, char *argv[])
+/*
+ * Adds a --keyset, given as "KEYBLOCK:SIGNPRIVATE:OUTFILE".
+ * Returns the number of errors.
+ */
+static int add_keyset(char *arg)
+{
+	struct sign_keyset *keysets, *keyset;
+	char *keyblock_file, *signprivate_file, *outfile, *save;
+
+	keyblock_file = strtok_r(arg, ":", &save);
+	signprivate_file = strtok_r(NULL, ":", &save);
+	outfile = strtok_r(NULL, "", &save);
+	if (!keyblock_file || !signprivate_file || !outfile) {
+		fprintf(stderr, "Invalid --keyset; expected "
+			"KEYBLOCK:SIGNPRIVATE:OUTFILE\n");
+		return 1;
+	}
+
+	keysets = realloc(sign_option.keysets,
+			  (sign_option.keyset_count + 1) * sizeof(*keysets));
+	if (!keysets) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	sign_option.keysets = keysets;
+	keyset = &keysets[sign_option.keyset_count++];
+	keyset->outfile = outfile;
+	keyset->keyblock = vb2_read_keyblock(keyblock_file);
+	keyset->signprivate = vb2_get_private_key(signprivate_file);
+	if (!keyset->keyblock) {
+		fprintf(stderr, "Error reading %s\n", keyblock_file);
+		return 1;
+	}
+	if (!keyset->signprivate) {
+		fprintf(stderr, "Error reading %s\n", signprivate_file);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Signs one file, given by name and the options in sign_option.
+ * Returns the number of errors.
+ */
+static int sign_file(char *infile)
 {
-	char *infile = 0;
-	int i;
 	int ifd = -1;
 	int errorcnt = 0;
 	uint8_t *buf;
 	uint32_t buf_len;
-	char *e = 0;
 	int mapping;
-	int helpind = 0;
-	int longindex;
+	struct stat sb;
+	uint8_t *stream_buf = NULL;
+	uint32_t stream_len = 0;
 
-	opterr = 0;		/* quiet, you */
-	while ((i = getopt_long(argc, argv, short_opts, long_opts,
-				&longindex)) != -1) {
-		switch (i) {
-		case 's':
-			sign_option.signprivate = vb2_read_private_key(optarg);
-			if (!sign_option.signprivate) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
-			break;
-		case 'b':
-			sign_option.keyblock = vb2_read_keyblock(optarg);
-			if (!sign_option.keyblock) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
-			break;
-		case 'k':
-			sign_option.kernel_subkey = vb2_read_packed_key(optarg);
-			if (!sign_option.kernel_subkey) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
-			break;
-		case 'S':
-			sign_option.devsignprivate =
-				vb2_read_private_key(optarg);
-			if (!sign_option.devsignprivate) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
-			break;
-		case 'B':
-			sign_option.devkeyblock = vb2_read_keyblock(optarg);
-			if (!sign_option.devkeyblock) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
-			break;
-		case 'v':
-			sign_option.version_specified = 1;
-			sign_option.version = strtoul(optarg, &e, 0);
-			if (!*optarg || (e && *e)) {
-				fprintf(stderr,
-					"Invalid --version \"%s\"\n", optarg);
-				errorcnt++;
-			}
-			break;
+	/*
+	 * A pipe (or other stream) can only be read once, so read all of it
+	 * now and sign what was read.
+	 */
+	if (!stat(infile, &sb) && !S_ISREG(sb.st_mode) &&
+	    !S_ISBLK(sb.st_mode) && !S_ISDIR(sb.st_mode)) {
+		ifd = open(infile, O_RDONLY);
+		if (ifd < 0) {
+			fprintf(stderr, "Can't open %s for reading: %s\n",
+				infile, strerror(errno));
+			return 1;
+		}
+		if (futil_map_file(ifd, MAP_RO, &stream_buf, &stream_len)) {
+			close(ifd);
+			return 1;
+		}
+		close(ifd);
+		ifd = -1;
+		if (sign_option.type == FILE_TYPE_UNKNOWN)
+			sign_option.type = futil_file_type_buf(stream_buf,
+							       stream_len);
+	}
 
-		case 'f':
-			sign_option.flags_specified = 1;
-			errorcnt += parse_number_opt(optarg, "flags",
-						     &sign_option.flags);
-			break;
-		case 'd':
-			sign_option.loemdir = optarg;
-			break;
-		case 'l':
-			sign_option.loemid = optarg;
-			break;
-		case OPT_FV:
-			sign_option.fv_specified = 1;
-			/* fallthrough */
-		case OPT_INFILE:
-			sign_option.inout_file_count++;
-			infile = optarg;
-			break;
-		case OPT_OUTFILE:
-			sign_option.inout_file_count++;
-			sign_option.outfile = optarg;
-			break;
-		case OPT_BOOTLOADER:
-			sign_option.bootloader_data = ReadFile(
-				optarg, &sign_option.bootloader_size);
-			if (!sign_option.bootloader_data) {
-				fprintf(stderr,
-					"Error reading bootloader file: %s\n",
-					strerror(errno));
-				errorcnt++;
-			}
-			VB2_DEBUG("bootloader file size=0x%" PRIx64 "\n",
-			      sign_option.bootloader_size);
-			break;
-		case OPT_CONFIG:
-			sign_option.config_data = ReadConfigFile(
-				optarg, &sign_option.config_size);
-			if (!sign_option.config_data) {
-				fprintf(stderr,
-					"Error reading config file: %s\n",
-					strerror(errno));
-				errorcnt++;
+	/* What are we looking at? */
+	if (sign_option.type == FILE_TYPE_UNKNOWN && !stream_buf &&
+	    futil_file_type(infile, &sign_option.type))
+		return 1;
+
+	/* We may be able to infer the type based on the other args */
+	if (sign_option.type == FILE_TYPE_UNKNOWN) {
+		if (sign_option.bootloader_data || sign_option.config_data
+		    || sign_option.arch != ARCH_UNSPECIFIED)
+			sign_option.type = FILE_TYPE_RAW_KERNEL;
+		else if (sign_option.kernel_subkey || sign_option.fv_specified)
+			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
+	}
+
+	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
+
+	/* Check the arguments for the type of thing we want to sign */
+	switch (sign_option.type) {
+	case FILE_TYPE_PUBKEY:
+		sign_option.create_new_outfile = 1;
+		if (sign_option.signprivate && sign_option.pem_signpriv) {
+			fprintf(stderr,
+				"Only one of --signprivate and --pem_signpriv"
+				" can be specified\n");
+			errorcnt++;
+		}
+		if ((sign_option.signprivate &&
+		     sign_option.pem_algo_specified) ||
+		    (sign_option.pem_signpriv &&
+		     !sign_option.pem_algo_specified)) {
+			fprintf(stderr, "--pem_algo must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		if (sign_option.pem_external && !sign_option.pem_signpriv) {
+			fprintf(stderr, "--pem_external must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		/* We'll wait to read the PEM file, since the external signer
+		 * may want to read it instead. */
+		break;
+	case FILE_TYPE_BIOS_IMAGE:
+	case FILE_TYPE_OLD_BIOS_IMAGE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		break;
+	case FILE_TYPE_KERN_PREAMBLE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
+			sign_option.create_new_outfile = 1;
+		break;
+	case FILE_TYPE_CHROMIUMOS_DISK:
+		/* The kernels are signed in place, in OUTFILE if given */
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		if (sign_option.vblockonly) {
+			fprintf(stderr, "--vblockonly can't be used to sign "
+				"%s\n", futil_file_type_name(sign_option.type));
+			errorcnt++;
+		}
+		break;
+	case FILE_TYPE_RAW_FIRMWARE:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		break;
+	case FILE_TYPE_RAW_KERNEL:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		errorcnt += no_opt_if(!sign_option.bootloader_data,
+				      "bootloader");
+		errorcnt += no_opt_if(!sign_option.config_data, "config");
+		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
+				      "arch");
+		break;
+	case FILE_TYPE_USBPD1:
+		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
+		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
+				      "hash_alg");
+		break;
+	case FILE_TYPE_RWSIG:
+		if (sign_option.inout_file_count > 1)
+			/* Signing raw data. No signature pre-exists. */
+			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
+		break;
+	default:
+		/* Anything else we don't care */
+		break;
+	}
+
+	if (sign_option.keyset_count &&
+	    sign_option.type != FILE_TYPE_RAW_FIRMWARE &&
+	    sign_option.type != FILE_TYPE_RAW_KERNEL &&
+	    sign_option.type != FILE_TYPE_KERN_PREAMBLE) {
+		fprintf(stderr, "--keyset can't be used to sign %s\n",
+			futil_file_type_name(sign_option.type));
+		errorcnt++;
+	}
+
+	VB2_DEBUG("infile=%s\n", infile);
+	VB2_DEBUG("sign_option.inout_file_count=%d\n",
+		  sign_option.inout_file_count);
+	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
+		  sign_option.create_new_outfile);
+
+	/* Make sure we have an output file if one is needed */
+	if (!sign_option.outfile) {
+		if (sign_option.create_new_outfile) {
+			fprintf(stderr, "Missing output filename\n");
+			errorcnt++;
+			goto out;
+		} else if (stream_buf) {
+			fprintf(stderr, "Can't sign %s in place\n", infile);
+			errorcnt++;
+			goto out;
+		} else {
+			sign_option.outfile = infile;
+		}
+	}
+
+	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
+
+	if (errorcnt)
+		goto out;
+
+	if (sign_option.create_new_outfile) {
+		/* The input is read-only, the output is write-only. */
+		mapping = MAP_RO;
+		if (stream_buf) {
+			buf = stream_buf;
+			buf_len = stream_len;
+			stream_buf = NULL;
+			goto sign;
+		}
+		VB2_DEBUG("open RO %s\n", infile);
+		ifd = open(infile, O_RDONLY);
+		if (ifd < 0) {
+			fprintf(stderr, "Can't open %s for reading: %s\n",
+				infile, strerror(errno));
+			return 1;
+		}
+	} else {
+		/* We'll read-modify-write the output file */
+		mapping = MAP_RW;
+		if (stream_buf) {
+			if (vb2_write_file(sign_option.outfile, stream_buf,
+					   stream_len)) {
+				fprintf(stderr, "Can't write %s\n",
+					sign_option.outfile);
+				errorcnt++;
+				goto out;
+			}
+		} else if (sign_option.inout_file_count > 1) {
+			futil_copy_file_or_die(infile, sign_option.outfile);
+		}
+		VB2_DEBUG("open RW %s\n", sign_option.outfile);
+		infile = sign_option.outfile;
+		ifd = open(sign_option.outfile, O_RDWR);
+		if (ifd < 0) {
+			fprintf(stderr, "Can't open %s for writing: %s\n",
+				sign_option.outfile, strerror(errno));
+			errorcnt++;
+			goto out;
+		}
+	}
+
+	if (0 != futil_map_file(ifd, mapping, &buf, &buf_len)) {
+		errorcnt++;
+		goto out;
+	}
+
+sign:
+	errorcnt += futil_file_type_sign(sign_option.type, infile,
+					 buf, buf_len);
+
+	errorcnt += futil_unmap_file(ifd, mapping, buf, buf_len);
+
+out:
+	if (stream_buf)
+		futil_unmap_file(-1, MAP_RO, stream_buf, stream_len);
+	if (ifd >= 0 && close(ifd)) {
+		errorcnt++;
+		fprintf(stderr, "Error when closing ifd: %s\n",
+			strerror(errno));
+	}
+	return errorcnt;
+}
+
+/* One file to sign from a --batch manifest. */
+struct batch_entry {
+	char *infile;
+	char *outfile;		/* NULL to sign in place */
+	pid_t pid;
+	int failed;
+};
+
+/*
+ * Reads a --batch manifest. Each line is "INFILE [OUTFILE]". Blank lines and
+ * lines starting with '#' are skipped.
+ * Returns the number of errors.
+ */
+static int read_batch(const char *filename, struct batch_entry **entries,
+		      int *count)
+{
+	struct batch_entry *list = NULL, *new_list;
+	char *line = NULL, *tok, *save;
+	size_t line_size = 0;
+	int num = 0, lineno = 0;
+	int errorcnt = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "Can't open %s: %s\n", filename,
+			strerror(errno));
+		return 1;
+	}
+
+	while (getline(&line, &line_size, fp) != -1) {
+		lineno++;
+		tok = strtok_r(line, " \t\r\n", &save);
+		if (!tok || *tok == '#')
+			continue;
+
+		new_list = realloc(list, (num + 1) * sizeof(*list));
+		if (!new_list) {
+			fprintf(stderr, "Out of memory\n");
+			errorcnt++;
+			break;
+		}
+		list = new_list;
+		memset(&list[num], 0, sizeof(list[num]));
+		list[num].infile = strdup(tok);
+		tok = strtok_r(NULL, " \t\r\n", &save);
+		if (tok)
+			list[num].outfile = strdup(tok);
+		num++;
+		if (tok && strtok_r(NULL, " \t\r\n", &save)) {
+			fprintf(stderr, "%s:%d: too many file names\n",
+				filename, lineno);
+			errorcnt++;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	*entries = list;
+	*count = num;
+	return errorcnt;
+}
+
+/*
+ * Starts signing one entry of a batch in a child process, which begins with
+ * the options (and keys) already parsed, exactly like a separate invocation.
+ * Returns zero on success.
+ */
+static int start_batch_entry(struct batch_entry *entry)
+{
+	/* Don't let the child repeat anything still buffered. */
+	fflush(NULL);
+
+	entry->pid = fork();
+	if (entry->pid < 0) {
+		fprintf(stderr, "Can't fork to sign %s: %s\n", entry->infile,
+			strerror(errno));
+		return 1;
+	}
+	if (entry->pid == 0) {
+		sign_option.inout_file_count = entry->outfile ? 2 : 1;
+		sign_option.outfile = entry->outfile;
+		exit(!!sign_file(entry->infile));
+	}
+	return 0;
+}
+
+/*
+ * Signs all files listed in a --batch manifest, up to jobs at a time, then
+ * prints the status of each one.
+ * Returns the number of errors.
+ */
+static int sign_batch(const char *filename, int jobs)
+{
+	struct batch_entry *entries = NULL;
+	int count = 0, next = 0, running = 0, failed = 0;
+	int errorcnt;
+	int i, status;
+	pid_t pid;
+
+	errorcnt = read_batch(filename, &entries, &count);
+	if (!errorcnt && !count) {
+		fprintf(stderr, "No files to sign in %s\n", filename);
+		errorcnt++;
+	}
+
+	while (!errorcnt && (next < count || running)) {
+		while (next < count && running < jobs) {
+			if (start_batch_entry(&entries[next]))
+				entries[next].failed = 1;
+			else
+				running++;
+			next++;
+		}
+		if (!running)
+			continue;
+
+		pid = wait(&status);
+		if (pid < 0) {
+			fprintf(stderr, "Error waiting for signers: %s\n",
+				strerror(errno));
+			errorcnt++;
+			break;
+		}
+		for (i = 0; i < count; i++) {
+			if (entries[i].pid != pid)
+				continue;
+			entries[i].failed = !WIFEXITED(status) ||
+					    WEXITSTATUS(status);
+			running--;
+			break;
+		}
+	}
+
+	if (!errorcnt) {
+		for (i = 0; i < count; i++) {
+			printf("%-7s %s%s%s\n",
+			       entries[i].failed ? "FAILED" : "OK",
+			       entries[i].infile,
+			       entries[i].outfile ? " -> " : "",
+			       entries[i].outfile ? entries[i].outfile : "");
+			failed += entries[i].failed;
+		}
+		printf("Signed %d of %d files\n", count - failed, count);
+		errorcnt += failed;
+	}
+
+	for (i = 0; i < count; i++) {
+		free(entries[i].infile);
+		free(entries[i].outfile);
+	}
+	free(entries);
+	return errorcnt;
+}
+
+static int do_sign(int argc, char *argv[])
+{
+	char *infile = 0;
+	int i;
+	int errorcnt = 0;
+	char *e = 0;
+	int helpind = 0;
+	int longindex;
+	char *batch = NULL;
+
+	opterr = 0;		/* quiet, you */
+	while ((i = getopt_long(argc, argv, short_opts, long_opts,
+				&longindex)) != -1) {
+		switch (i) {
+		case 's':
+			sign_option.signprivate = vb2_get_private_key(optarg);
+			if (!sign_option.signprivate) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'b':
+			sign_option.keyblock = vb2_read_keyblock(optarg);
+			if (!sign_option.keyblock) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'k':
+			sign_option.kernel_subkey = vb2_read_packed_key(optarg);
+			if (!sign_option.kernel_subkey) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'S':
+			sign_option.devsignprivate =
+				vb2_get_private_key(optarg);
+			if (!sign_option.devsignprivate) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'B':
+			sign_option.devkeyblock = vb2_read_keyblock(optarg);
+			if (!sign_option.devkeyblock) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'v':
+			sign_option.version_specified = 1;
+			sign_option.version = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e)) {
+				fprintf(stderr,
+					"Invalid --version \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
+
+		case 'f':
+			sign_option.flags_specified = 1;
+			errorcnt += parse_number_opt(optarg, "flags",
+						     &sign_option.flags);
+			break;
+		case 'd':
+			sign_option.loemdir = optarg;
+			break;
+		case 'l':
+			sign_option.loemid = optarg;
+			break;
+		case OPT_FV:
+			sign_option.fv_specified = 1;
+			/* fallthrough */
+		case OPT_INFILE:
+			sign_option.inout_file_count++;
+			infile = optarg;
+			break;
+		case OPT_OUTFILE:
+			sign_option.inout_file_count++;
+			sign_option.outfile = optarg;
+			break;
+		case OPT_BOOTLOADER:
+			sign_option.bootloader_data = ReadFile(
+				optarg, &sign_option.bootloader_size);
+			if (!sign_option.bootloader_data) {
+				fprintf(stderr,
+					"Error reading bootloader file: %s\n",
+					strerror(errno));
+				errorcnt++;
+			}
+			VB2_DEBUG("bootloader file size=0x%" PRIx64 "\n",
+			      sign_option.bootloader_size);
+			break;
+		case OPT_CONFIG:
+			sign_option.config_data = ReadConfigFile(
+				optarg, &sign_option.config_size);
+			if (!sign_option.config_data) {
+				fprintf(stderr,
+					"Error reading config file: %s\n",
+					strerror(errno));
+				errorcnt++;
 			}
 			break;
 		case OPT_ARCH:
@@ -777,6 +1682,26 @@ static int do_sign(int argc, char *argv[])
 			errorcnt += parse_number_opt(optarg, "padding",
 						     &sign_option.padding);
 			break;
+		case OPT_CHUNK_SIZE:
+			errorcnt += parse_number_opt(optarg, "chunk_size",
+						     &sign_option.chunk_size);
+			sign_option.chunk_size_specified = 1;
+			break;
+		case OPT_COMPRESS:
+			if (!strcasecmp(optarg, "none"))
+				sign_option.compression =
+					VB2_KERNEL_COMPRESSION_NONE;
+			else if (!strcasecmp(optarg, "lz4"))
+				sign_option.compression =
+					VB2_KERNEL_COMPRESSION_LZ4;
+			else {
+				fprintf(stderr,
+					"Unknown compression: \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			sign_option.compression_specified = 1;
+			break;
 		case OPT_RO_SIZE:
 			errorcnt += parse_number_opt(optarg, "ro_size",
 						     &sign_option.ro_size);
@@ -842,6 +1767,21 @@ static int do_sign(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_BATCH:
+			batch = optarg;
+			break;
+		case OPT_KEYSET:
+			errorcnt += add_keyset(optarg);
+			break;
+		case OPT_JOBS:
+			errorcnt += parse_number_opt(optarg, "jobs",
+						     &sign_option.jobs);
+			if (!sign_option.jobs) {
+				fprintf(stderr, "Invalid --jobs \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
 		case OPT_HELP:
 			helpind = optind - 1;
 			break;
@@ -877,6 +1817,22 @@ static int do_sign(int argc, char *argv[])
 		return !!errorcnt;
 	}
 
+	if (batch) {
+		if (infile || sign_option.outfile || argc - optind > 0) {
+			fprintf(stderr, "ERROR: --batch takes the file names "
+				"from the manifest\n");
+			errorcnt++;
+		} else if (sign_option.keyset_count) {
+			fprintf(stderr, "ERROR: --keyset can't be used with "
+				"--batch\n");
+			errorcnt++;
+		} else if (!errorcnt) {
+			errorcnt += sign_batch(batch, sign_option.jobs ?
+					       sign_option.jobs : 1);
+		}
+		goto done;
+	}
+
 	/* If we don't have an input file already, we need one */
 	if (!infile) {
 		if (argc - optind <= 0) {
@@ -895,175 +1851,28 @@ static int do_sign(int argc, char *argv[])
 		sign_option.outfile = argv[optind++];
 	}
 
-	/* What are we looking at? */
-	if (sign_option.type == FILE_TYPE_UNKNOWN &&
-	    futil_file_type(infile, &sign_option.type)) {
-		errorcnt++;
-		goto done;
-	}
-
-	/* We may be able to infer the type based on the other args */
-	if (sign_option.type == FILE_TYPE_UNKNOWN) {
-		if (sign_option.bootloader_data || sign_option.config_data
-		    || sign_option.arch != ARCH_UNSPECIFIED)
-			sign_option.type = FILE_TYPE_RAW_KERNEL;
-		else if (sign_option.kernel_subkey || sign_option.fv_specified)
-			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
-	}
-
-	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
-
-	/* Check the arguments for the type of thing we want to sign */
-	switch (sign_option.type) {
-	case FILE_TYPE_PUBKEY:
-		sign_option.create_new_outfile = 1;
-		if (sign_option.signprivate && sign_option.pem_signpriv) {
-			fprintf(stderr,
-				"Only one of --signprivate and --pem_signpriv"
-				" can be specified\n");
-			errorcnt++;
-		}
-		if ((sign_option.signprivate &&
-		     sign_option.pem_algo_specified) ||
-		    (sign_option.pem_signpriv &&
-		     !sign_option.pem_algo_specified)) {
-			fprintf(stderr, "--pem_algo must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		if (sign_option.pem_external && !sign_option.pem_signpriv) {
-			fprintf(stderr, "--pem_external must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		/* We'll wait to read the PEM file, since the external signer
-		 * may want to read it instead. */
-		break;
-	case FILE_TYPE_BIOS_IMAGE:
-	case FILE_TYPE_OLD_BIOS_IMAGE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		break;
-	case FILE_TYPE_KERN_PREAMBLE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
-			sign_option.create_new_outfile = 1;
-		break;
-	case FILE_TYPE_RAW_FIRMWARE:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		break;
-	case FILE_TYPE_RAW_KERNEL:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		errorcnt += no_opt_if(!sign_option.bootloader_data,
-				      "bootloader");
-		errorcnt += no_opt_if(!sign_option.config_data, "config");
-		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
-				      "arch");
-		break;
-	case FILE_TYPE_USBPD1:
-		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
-		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
-				      "hash_alg");
-		break;
-	case FILE_TYPE_RWSIG:
-		if (sign_option.inout_file_count > 1)
-			/* Signing raw data. No signature pre-exists. */
-			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
-		break;
-	default:
-		/* Anything else we don't care */
-		break;
-	}
-
-	VB2_DEBUG("infile=%s\n", infile);
-	VB2_DEBUG("sign_option.inout_file_count=%d\n",
-		  sign_option.inout_file_count);
-	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
-		  sign_option.create_new_outfile);
-
-	/* Make sure we have an output file if one is needed */
-	if (!sign_option.outfile) {
-		if (sign_option.create_new_outfile) {
-			errorcnt++;
-			fprintf(stderr, "Missing output filename\n");
-			goto done;
-		} else {
-			sign_option.outfile = infile;
-		}
-	}
-
-	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
-
 	if (argc - optind > 0) {
 		errorcnt++;
 		fprintf(stderr, "ERROR: too many arguments left over\n");
 	}
 
-	if (errorcnt)
-		goto done;
-
-	if (sign_option.create_new_outfile) {
-		/* The input is read-only, the output is write-only. */
-		mapping = MAP_RO;
-		VB2_DEBUG("open RO %s\n", infile);
-		ifd = open(infile, O_RDONLY);
-		if (ifd < 0) {
-			errorcnt++;
-			fprintf(stderr, "Can't open %s for reading: %s\n",
-				infile, strerror(errno));
-			goto done;
-		}
-	} else {
-		/* We'll read-modify-write the output file */
-		mapping = MAP_RW;
-		if (sign_option.inout_file_count > 1)
-			futil_copy_file_or_die(infile, sign_option.outfile);
-		VB2_DEBUG("open RW %s\n", sign_option.outfile);
-		infile = sign_option.outfile;
-		ifd = open(sign_option.outfile, O_RDWR);
-		if (ifd < 0) {
-			errorcnt++;
-			fprintf(stderr, "Can't open %s for writing: %s\n",
-				sign_option.outfile, strerror(errno));
-			goto done;
-		}
-	}
-
-	if (0 != futil_map_file(ifd, mapping, &buf, &buf_len)) {
-		errorcnt++;
-		goto done;
-	}
-
-	errorcnt += futil_file_type_sign(sign_option.type, infile,
-					 buf, buf_len);
-
-	errorcnt += futil_unmap_file(ifd, mapping, buf, buf_len);
+	if (!errorcnt)
+		errorcnt += sign_file(infile);
 
 done:
-	if (ifd >= 0 && close(ifd)) {
-		errorcnt++;
-		fprintf(stderr, "Error when closing ifd: %s\n",
-			strerror(errno));
-	}
-
-	if (sign_option.signprivate)
-		free(sign_option.signprivate);
+	vb2_put_private_key(sign_option.signprivate);
+	vb2_put_private_key(sign_option.devsignprivate);
 	if (sign_option.keyblock)
 		free(sign_option.keyblock);
 	if (sign_option.kernel_subkey)
 		free(sign_option.kernel_subkey);
 	if (sign_option.prikey)
 		vb2_private_key_free(sign_option.prikey);
+	for (i = 0; i < sign_option.keyset_count; i++) {
+		vb2_put_private_key(sign_option.keysets[i].signprivate);
+		free(sign_option.keysets[i].keyblock);
+	}
+	free(sign_option.keysets);
 
 	if (errorcnt)
 		fprintf(stderr, "Use --help for usage instructions\n");
@@ -18,9 +18,11 @@ enum {
 	OPT_DUMMY = 0x100,
 
 	OPT_CCD,
+	OPT_DRY_RUN,
 	OPT_EMULATE,
 	OPT_FACTORY,
 	OPT_FAST,
+	OPT_FLASH_CACHE,
 	OPT_FORCE,
 	OPT_HOST_ONLY,
 	OPT_MANIFEST,
@@ -51,9 +53,11 @@ static struct option const long_opts[] = {
 	{"mode", 1, NULL, 'm'},
 
 	{"ccd", 0, NULL, OPT_CCD},
+	{"dry_run", 0, NULL, OPT_DRY_RUN},
 	{"emulate", 1, NULL, OPT_EMULATE},
 	{"factory", 0, NULL, OPT_FACTORY},
 	{"fast", 0, NULL, OPT_FAST},
+	{"flash_cache", 1, NULL, OPT_FLASH_CACHE},
 	{"force", 0, NULL, OPT_FORCE},
 	{"host_only", 0, NULL, OPT_HOST_ONLY},
 	{"list-quirks", 0, NULL, OPT_QUIRKS_LIST},
@@ -97,6 +101,9 @@ static void print_help(int argc, char *argv[])
 		"    --unpack=DIR    \tExtracts archive to DIR\n"
 		"-p, --programmer=PRG\tChange AP (host) flashrom programmer\n"
 		"    --fast          \tReduce read cycles and do not verify\n"
+		"    --flash_cache=F \tWith --try, skip reading the whole flash\n"
+		"                    \tif F shows it needed no update last time\n"
+		"    --dry_run       \tReport bytes to write, but do not write\n"
 		"    --quirks=LIST   \tSpecify the quirks to apply\n"
 		"    --list-quirks   \tPrint all available quirks\n"
 		"\n"
@@ -209,6 +216,12 @@ static int do_update(int argc, char *argv[])
 		case OPT_FAST:
 			args.fast_update = 1;
 			break;
+		case OPT_FLASH_CACHE:
+			args.flash_cache = optarg;
+			break;
+		case OPT_DRY_RUN:
+			args.dry_run = 1;
+			break;
 		case OPT_CCD:
 			args.fast_update = 1;
 			args.force_update = 1;
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,36 +50,46 @@ struct mrc_metadata {
 #define REGF_METADATA_BLOCK_SIZE	REGF_BLOCK_GRANULARITY
 #define REGF_UNALLOCATED_BLOCK		0xffff
 
+/*
+ * Computes an IP style checksum: the one's complement of the one's complement
+ * sum of the data as little-endian 16-bit words.
+ *
+ * That sum doesn't depend on byte order (RFC 1071), so add up the data as
+ * native 32-bit words into a 64-bit total which can't overflow, fold it down
+ * to 16 bits at the end, and swap its bytes if need be.
+ */
 static unsigned long compute_ip_checksum(const void *addr, unsigned long length)
 {
-	const uint8_t *ptr;
-	volatile union {
-		uint8_t  byte[2];
-		uint16_t word;
-	} value;
-	unsigned long sum;
-	unsigned long i;
-	/* In the most straight forward way possible,
-	 * compute an ip style checksum.
-	 */
-	sum = 0;
-	ptr = addr;
-	for(i = 0; i < length; i++) {
-		unsigned long v;
-		v = ptr[i];
-		if (i & 1) {
-			v <<= 8;
-		}
-		/* Add the new value */
-		sum += v;
-		/* Wrap around the carry */
-		if (sum > 0xFFFF) {
-			sum = (sum + (sum >> 16)) & 0xFFFF;
-		}
+	const uint8_t *ptr = addr;
+	uint64_t sum = 0;
+	uint32_t word;
+	uint16_t half;
+
+	for (; length >= sizeof(word); length -= sizeof(word)) {
+		memcpy(&word, ptr, sizeof(word));
+		sum += word;
+		ptr += sizeof(word);
 	}
-	value.byte[0] = sum & 0xff;
-	value.byte[1] = (sum >> 8) & 0xff;
-	return (~value.word) & 0xFFFF;
+	if (length >= sizeof(half)) {
+		memcpy(&half, ptr, sizeof(half));
+		sum += half;
+		ptr += sizeof(half);
+		length -= sizeof(half);
+	}
+	if (length) {
+		/* A last odd byte is the low byte of a word, wherever it is */
+		uint8_t last[2] = {*ptr, 0};
+		memcpy(&half, last, sizeof(half));
+		sum += half;
+	}
+
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	sum = ((sum & 0xff) << 8) | (sum >> 8);
+#endif
+	return ~sum & 0xffff;
 }
 
 static int verify_mrc_slot(struct mrc_metadata *md, unsigned long slot_len)
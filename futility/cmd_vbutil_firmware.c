@@ -36,6 +36,7 @@ enum {
 	OPT_FV,
 	OPT_KERNELKEY,
 	OPT_FLAGS,
+	OPT_CHUNK_SIZE,
 	OPT_HELP,
 };
 
@@ -49,6 +50,7 @@ static const struct option long_opts[] = {
 	{"fv", 1, 0, OPT_FV},
 	{"kernelkey", 1, 0, OPT_KERNELKEY},
 	{"flags", 1, 0, OPT_FLAGS},
+	{"chunk_size", 1, 0, OPT_CHUNK_SIZE},
 	{"help", 0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
@@ -69,6 +71,11 @@ static void print_help(int argc, char *argv[])
 	       "\n"
 	       "optional OPTIONS are:\n"
 	       "  --flags <number>            Preamble flags (defaults to 0)\n"
+	       "  --chunk_size <number>       Hash the body in chunks of this\n"
+	       "                                many bytes, so firmware can\n"
+	       "                                check each chunk on its own\n"
+	       "                                (defaults to 0, for the whole\n"
+	       "                                body)\n"
 	       "\n"
 	       "For '--verify <file>', required OPTIONS are:\n"
 	       "\n"
@@ -86,7 +93,7 @@ static void print_help(int argc, char *argv[])
 static int do_vblock(const char *outfile, const char *keyblock_file,
 		     const char *signprivate, uint32_t version,
 		     const char *fv_file, const char *kernelkey_file,
-		     uint32_t preamble_flags)
+		     uint32_t preamble_flags, uint32_t chunk_size)
 {
 	struct vb2_keyblock *keyblock = NULL;
 	struct vb2_private_key *signing_key = NULL;
@@ -116,7 +123,7 @@ static int do_vblock(const char *outfile, const char *keyblock_file,
 		goto vblock_cleanup;
 	}
 
-	signing_key = vb2_read_private_key(signprivate);
+	signing_key = vb2_get_private_key(signprivate);
 	if (!signing_key) {
 		VbExError("Error reading signing key.\n");
 		goto vblock_cleanup;
@@ -136,15 +143,23 @@ static int do_vblock(const char *outfile, const char *keyblock_file,
 		VbExError("Empty firmware volume file\n");
 		goto vblock_cleanup;
 	}
-	body_sig = vb2_calculate_signature(fv_data, fv_size, signing_key);
-	if (!body_sig) {
-		VbExError("Error calculating body signature\n");
-		goto vblock_cleanup;
-	}
 
 	/* Create preamble */
-	preamble = vb2_create_fw_preamble(version, kernel_subkey, body_sig,
-					  signing_key, preamble_flags);
+	if (chunk_size) {
+		preamble = vb2_create_fw_preamble_chunked(
+			version, kernel_subkey, fv_data, fv_size, chunk_size,
+			signing_key, preamble_flags);
+	} else {
+		body_sig = vb2_calculate_signature(fv_data, fv_size,
+						   signing_key);
+		if (!body_sig) {
+			VbExError("Error calculating body signature\n");
+			goto vblock_cleanup;
+		}
+		preamble = vb2_create_fw_preamble(version, kernel_subkey,
+						  body_sig, signing_key,
+						  preamble_flags);
+	}
 	if (!preamble) {
 		VbExError("Error creating preamble.\n");
 		goto vblock_cleanup;
@@ -171,8 +186,7 @@ static int do_vblock(const char *outfile, const char *keyblock_file,
 vblock_cleanup:
 	if (keyblock)
 		free(keyblock);
-	if (signing_key)
-		free(signing_key);
+	vb2_put_private_key(signing_key);
 	if (kernel_subkey)
 		free(kernel_subkey);
 	if (fv_data)
@@ -286,6 +300,9 @@ static int do_verify(const char *infile, const char *signpubkey,
 	       packed_key_sha1_string(kernel_subkey));
 	printf("  Firmware body size:    %d\n", pre2->body_signature.data_size);
 	printf("  Preamble flags:        %d\n", flags);
+	if (vb2_fw_get_body_chunk_size(pre2))
+		printf("  Body chunk size:       %d\n",
+		       vb2_fw_get_body_chunk_size(pre2));
 
 	/* TODO: verify body size same as signature size */
 
@@ -294,8 +311,8 @@ static int do_verify(const char *infile, const char *signpubkey,
 		printf("Preamble requests USE_RO_NORMAL;"
 		       " skipping body verification.\n");
 	} else if (VB2_SUCCESS ==
-		   vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
-				   &data_key, &wb)) {
+		   vb2_verify_fw_body(fv_data, fv_size, pre2, &data_key,
+				      &wb)) {
 		printf("Body verification succeeded.\n");
 	} else {
 		VbExError("Error verifying firmware body.\n");
@@ -334,6 +351,7 @@ static int do_vbutil_firmware(int argc, char *argv[])
 	char *fv_file = NULL;
 	char *kernelkey_file = NULL;
 	uint32_t preamble_flags = 0;
+	uint32_t chunk_size = 0;
 	int mode = 0;
 	int parse_error = 0;
 	char *e;
@@ -391,6 +409,14 @@ static int do_vbutil_firmware(int argc, char *argv[])
 				parse_error = 1;
 			}
 			break;
+
+		case OPT_CHUNK_SIZE:
+			chunk_size = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e)) {
+				printf("Invalid --chunk_size\n");
+				parse_error = 1;
+			}
+			break;
 		}
 	}
 
@@ -402,7 +428,8 @@ static int do_vbutil_firmware(int argc, char *argv[])
 	switch (mode) {
 	case OPT_MODE_VBLOCK:
 		return do_vblock(filename, key_block_file, signprivate, version,
-				 fv_file, kernelkey_file, preamble_flags);
+				 fv_file, kernelkey_file, preamble_flags,
+				 chunk_size);
 	case OPT_MODE_VERIFY:
 		return do_verify(filename, signpubkey, fv_file, kernelkey_file);
 	default:
@@ -67,6 +67,7 @@ enum {
 	OPT_MINVERSION,
 	OPT_VMLINUZ_OUT,
 	OPT_FLAGS,
+	OPT_HASHCACHE,
 	OPT_HELP,
 };
 
@@ -91,6 +92,7 @@ static const struct option long_opts[] = {
 	{"verbose", 0, &opt_verbose, 1},
 	{"vmlinuz-out", 1, 0, OPT_VMLINUZ_OUT},
 	{"flags", 1, 0, OPT_FLAGS},
+	{"hashcache", 1, 0, OPT_HASHCACHE},
 	{"help", 0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
@@ -132,6 +134,9 @@ static const char usage[] =
 	"    --kloadaddr <address>     Assign kernel body load address\n"
 	"    --pad <number>            Verification blob size in bytes\n"
 	"    --vblockonly              Emit just the verification blob\n"
+	"    --hashcache <file>        Save the kernel hash up to the config\n"
+	"                                here, so repacking the same blob\n"
+	"                                with another config is faster\n"
 	"\nOR\n\n"
 	"Usage:  " MYNAME " %s --verify <file> [PARAMETERS]\n"
 	"\n"
@@ -172,13 +177,10 @@ static const char *error_fread(FILE *fp)
 }
 
 
-/* This reads a complete kernel partition into a buffer */
-static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
-					 uint32_t *size_ptr)
+/* Returns the size of a kernel partition file or block device */
+static uint32_t KPartSizeOrDie(const char *filename)
 {
-	FILE *fp = NULL;
 	struct stat statbuf;
-	uint8_t *buf;
 	uint32_t file_size = 0;
 
 	if (0 != stat(filename, &statbuf))
@@ -199,6 +201,17 @@ static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
 	if (file_size < opt_pad)
 		Fatal("%s is too small to be a valid kernel blob\n", filename);
 
+	return file_size;
+}
+
+/* This reads a complete kernel partition into a buffer */
+static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
+					 uint32_t *size_ptr)
+{
+	FILE *fp = NULL;
+	uint8_t *buf;
+	uint32_t file_size = KPartSizeOrDie(filename);
+
 	VB2_DEBUG("Reading %s\n", filename);
 	fp = fopen(filename, "rb");
 	if (!fp)
@@ -217,6 +230,32 @@ static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
 	return buf;
 }
 
+/*
+ * This reads just the vblock at the start of a kernel partition, which must
+ * fit in the padding, into a buffer.  The partition is left open, so the rest
+ * of it can be read as needed.
+ */
+static uint8_t *ReadOldVblockFromFileOrDie(const char *filename, int *fd_ptr)
+{
+	uint8_t *buf;
+	int fd;
+
+	KPartSizeOrDie(filename);
+
+	VB2_DEBUG("Reading vblock from %s\n", filename);
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		Fatal("Unable to open file %s: %s\n", filename,
+		      strerror(errno));
+
+	buf = malloc(opt_pad);
+	if (!buf || pread(fd, buf, opt_pad, 0) != opt_pad)
+		Fatal("Unable to read vblock from %s\n", filename);
+
+	*fd_ptr = fd;
+	return buf;
+}
+
 /****************************************************************************/
 
 static int do_vbutil_kernel(int argc, char *argv[])
@@ -231,6 +270,7 @@ static int do_vbutil_kernel(int argc, char *argv[])
 	char *vmlinuz_file = NULL;
 	char *bootloader_file = NULL;
 	char *config_file = NULL;
+	char *hash_cache_file = NULL;
 	char *vmlinuz_out_file = NULL;
 	enum arch_t arch = ARCH_X86;
 	uint64_t kernel_body_load_address = CROS_32BIT_ENTRY_ADDR;
@@ -247,6 +287,7 @@ static int do_vbutil_kernel(int argc, char *argv[])
 	struct vb2_packed_key *signpub_key = NULL;
 	uint8_t *kpart_data = NULL;
 	uint32_t kpart_size = 0;
+	int kpart_fd = -1;
 	uint8_t *vmlinuz_buf = NULL;
 	uint32_t vmlinuz_size = 0;
 	uint8_t *t_config_data;
@@ -361,6 +402,10 @@ static int do_vbutil_kernel(int argc, char *argv[])
 			opt_vblockonly = 1;
 			break;
 
+		case OPT_HASHCACHE:
+			hash_cache_file = optarg;
+			break;
+
 		case OPT_VERSION:
 			version_str = optarg;
 			version = strtoul(optarg, &e, 0);
@@ -408,7 +453,7 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		if (!signprivkey_file)
 			Fatal("Missing required signprivate file.\n");
 
-		signpriv_key = vb2_read_private_key(signprivkey_file);
+		signpriv_key = vb2_get_private_key(signprivkey_file);
 		if (!signpriv_key)
 			Fatal("Error reading signing key.\n");
 
@@ -458,6 +503,7 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		vblock_data = SignKernelBlob(kblob_data, kblob_size, opt_pad,
 					     version, kernel_body_load_address,
 					     t_keyblock, signpriv_key, flags,
+					     0, VB2_KERNEL_COMPRESSION_NONE, 0,
 					     &vblock_size);
 		if (!vblock_data)
 			Fatal("Unable to sign kernel blob\n");
@@ -477,7 +523,7 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		free(t_config_data);
 		free(t_bootloader_data);
 		free(vblock_data);
-		vb2_free_private_key(signpriv_key);
+		vb2_put_private_key(signpriv_key);
 		return rv;
 
 	case OPT_MODE_REPACK:
@@ -487,41 +533,38 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		if (!signprivkey_file)
 			Fatal("Missing required signprivate file.\n");
 
-		signpriv_key = vb2_read_private_key(signprivkey_file);
+		signpriv_key = vb2_get_private_key(signprivkey_file);
 		if (!signpriv_key)
 			Fatal("Error reading signing key.\n");
 
 		if (!oldfile)
 			Fatal("Missing previously packed blob.\n");
 
-		/* Load the kernel partition */
-		kpart_data = ReadOldKPartFromFileOrDie(oldfile, &kpart_size);
+		/*
+		 * Load just the vblock.  The kernel blob is streamed through
+		 * when it is re-signed, so it never has to fit in memory.
+		 */
+		kpart_data = ReadOldVblockFromFileOrDie(oldfile, &kpart_fd);
+		kpart_size = opt_pad;
 
 		/* Make sure we have a kernel partition */
 		if (FILE_TYPE_KERN_PREAMBLE !=
 		    futil_file_type_buf(kpart_data, kpart_size))
 			Fatal("%s is not a kernel blob\n", oldfile);
 
-		kblob_data = unpack_kernel_partition(kpart_data, kpart_size,
-						     opt_pad, &keyblock,
-						     &preamble, &kblob_size);
-
-		if (!kblob_data)
+		if (!unpack_kernel_partition(kpart_data, kpart_size, opt_pad,
+					     &keyblock, &preamble, NULL))
 			Fatal("Unable to unpack kernel partition\n");
 
-		kernel_body_load_address = preamble->body_load_address;
-
 		/* Update the config if asked */
+		t_config_data = NULL;
+		t_config_size = 0;
 		if (config_file) {
 			VB2_DEBUG("Reading %s\n", config_file);
 			t_config_data =
 				ReadConfigFile(config_file, &t_config_size);
 			if (!t_config_data)
 				Fatal("Error reading config file.\n");
-			if (0 != UpdateKernelBlobConfig(
-				    kblob_data, kblob_size,
-				    t_config_data, t_config_size))
-				Fatal("Unable to update config\n");
 		}
 
 		if (!version_str)
@@ -537,22 +580,17 @@ static int do_vbutil_kernel(int argc, char *argv[])
 				Fatal("Error reading key block.\n");
 		}
 
-		/* Reuse previous body size */
-		vblock_data = SignKernelBlob(kblob_data, kblob_size, opt_pad,
-					     version, kernel_body_load_address,
-					     t_keyblock ? t_keyblock : keyblock,
-					     signpriv_key, flags, &vblock_size);
-		if (!vblock_data)
+		/* Reuse previous body size and load address */
+		rv = RepackKernelPartition(kpart_fd, filename, opt_pad,
+					   version,
+					   t_keyblock ? t_keyblock : keyblock,
+					   signpriv_key, flags,
+					   t_config_data, t_config_size,
+					   opt_vblockonly, hash_cache_file);
+		vb2_put_private_key(signpriv_key);
+		close(kpart_fd);
+		if (rv)
 			Fatal("Unable to sign kernel blob\n");
-
-		if (opt_vblockonly)
-			rv = WriteSomeParts(filename,
-					    vblock_data, vblock_size,
-					    NULL, 0);
-		else
-			rv = WriteSomeParts(filename,
-					    vblock_data, vblock_size,
-					    kblob_data, kblob_size);
 		return rv;
 
 	case OPT_MODE_VERIFY:
@@ -567,8 +605,12 @@ static int do_vbutil_kernel(int argc, char *argv[])
 
 		/* Do it */
 
-		/* Load the kernel partition */
-		kpart_data = ReadOldKPartFromFileOrDie(filename, &kpart_size);
+		/* Load the vblock and signed body of the kernel partition */
+		kpart_data = ReadKernelPartition(filename, opt_pad, 0,
+						 &kpart_size);
+		if (!kpart_data)
+			kpart_data = ReadOldKPartFromFileOrDie(filename,
+							       &kpart_size);
 
 		kblob_data = unpack_kernel_partition(kpart_data, kpart_size,
 						     opt_pad, 0, 0,
@@ -5,11 +5,13 @@
  * Verified boot key block utility
  */
 
+#include <errno.h>
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "2sysincludes.h"
 #include "2common.h"
@@ -26,6 +28,7 @@
 enum {
 	OPT_MODE_PACK = 1000,
 	OPT_MODE_UNPACK,
+	OPT_MODE_BATCH,
 	OPT_DATAPUBKEY,
 	OPT_SIGNPUBKEY,
 	OPT_SIGNPRIVATE,
@@ -33,12 +36,14 @@ enum {
 	OPT_PEM_ALGORITHM,
 	OPT_EXTERNAL_SIGNER,
 	OPT_FLAGS,
+	OPT_JOBS,
 	OPT_HELP,
 };
 
 static const struct option long_opts[] = {
 	{"pack", 1, 0, OPT_MODE_PACK},
 	{"unpack", 1, 0, OPT_MODE_UNPACK},
+	{"batch", 1, 0, OPT_MODE_BATCH},
 	{"datapubkey", 1, 0, OPT_DATAPUBKEY},
 	{"signpubkey", 1, 0, OPT_SIGNPUBKEY},
 	{"signprivate", 1, 0, OPT_SIGNPRIVATE},
@@ -46,13 +51,14 @@ static const struct option long_opts[] = {
 	{"pem_algorithm", 1, 0, OPT_PEM_ALGORITHM},
 	{"externalsigner", 1, 0, OPT_EXTERNAL_SIGNER},
 	{"flags", 1, 0, OPT_FLAGS},
+	{"jobs", 1, 0, OPT_JOBS},
 	{"help", 0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
 
 static const char usage[] =
 	"\n"
-	"Usage:  " MYNAME " %s <--pack|--unpack> <file> [OPTIONS]\n"
+	"Usage:  " MYNAME " %s <--pack|--unpack|--batch> <file> [OPTIONS]\n"
 	"\n"
 	"For '--pack <file>', required OPTIONS are:\n"
 	"  --datapubkey <file>         Data public key in .vbpubk format\n"
@@ -71,6 +77,14 @@ static const char usage[] =
 	"  --externalsigner \"cmd\""
 	"        Use an external program cmd to calculate the signatures.\n"
 	"\n"
+	"For '--batch <file>', the file lists one keyblock to pack per line,\n"
+	"as \"<datapubkey> <outfile>\".  Blank lines and lines starting\n"
+	"with '#' are skipped.  The OPTIONS are the same as for '--pack',\n"
+	"without --datapubkey, and apply to every keyblock.  Also:\n"
+	"  --jobs <number>             Keyblocks to sign at once "
+	"(default: one per CPU;\n"
+	"                                always 1 with --externalsigner)\n"
+	"\n"
 	"For '--unpack <file>', optional OPTIONS are:\n"
 	"  --signpubkey <file>"
 	"        Signing public key in .vbpubk format. This is required to\n"
@@ -125,7 +139,7 @@ static int Pack(const char *outfile, const char *datapubkey,
 							     external_signer);
 		} else {
 			signing_key =
-				vb2_read_private_key_pem(signprivate_pem,
+				vb2_get_private_key_pem(signprivate_pem,
 							 pem_algorithm);
 			if (!signing_key) {
 				fprintf(stderr, "vbutil_keyblock:"
@@ -137,7 +151,7 @@ static int Pack(const char *outfile, const char *datapubkey,
 		}
 	} else {
 		if (signprivate) {
-			signing_key = vb2_read_private_key(signprivate);
+			signing_key = vb2_get_private_key(signprivate);
 			if (!signing_key) {
 				fprintf(stderr, "vbutil_keyblock:"
 					" Error reading signing key.\n");
@@ -148,8 +162,7 @@ static int Pack(const char *outfile, const char *datapubkey,
 	}
 
 	free(data_key);
-	if (signing_key)
-		free(signing_key);
+	vb2_put_private_key(signing_key);
 
 	if (VB2_SUCCESS != vb2_write_keyblock(outfile, block)) {
 		fprintf(stderr, "vbutil_keyblock: Error writing key block.\n");
@@ -159,6 +172,161 @@ static int Pack(const char *outfile, const char *datapubkey,
 	return 0;
 }
 
+/* One keyblock to pack from a --batch manifest */
+struct batch_entry {
+	char *datapubkey;
+	char *outfile;
+};
+
+/*
+ * Reads a --batch manifest. Each line is "DATAPUBKEY OUTFILE". Blank lines
+ * and lines starting with '#' are skipped.
+ * Returns the number of errors.
+ */
+static int read_batch(const char *filename, struct batch_entry **entries,
+		      uint32_t *count)
+{
+	struct batch_entry *list = NULL, *new_list;
+	char *line = NULL, *tok, *save;
+	size_t line_size = 0;
+	uint32_t num = 0;
+	int lineno = 0;
+	int errorcnt = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "vbutil_keyblock: Can't open %s: %s\n",
+			filename, strerror(errno));
+		return 1;
+	}
+
+	while (getline(&line, &line_size, fp) != -1) {
+		lineno++;
+		tok = strtok_r(line, " \t\r\n", &save);
+		if (!tok || *tok == '#')
+			continue;
+
+		new_list = realloc(list, (num + 1) * sizeof(*list));
+		if (!new_list) {
+			fprintf(stderr, "vbutil_keyblock: Out of memory\n");
+			errorcnt++;
+			break;
+		}
+		list = new_list;
+		list[num].datapubkey = strdup(tok);
+		tok = strtok_r(NULL, " \t\r\n", &save);
+		list[num].outfile = tok ? strdup(tok) : NULL;
+		num++;
+		if (!tok || strtok_r(NULL, " \t\r\n", &save)) {
+			fprintf(stderr, "%s:%d: need a data key and an "
+				"output file\n", filename, lineno);
+			errorcnt++;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	*entries = list;
+	*count = num;
+	return errorcnt;
+}
+
+/* Pack every .keyblock listed in a manifest, with the same signing key */
+static int PackBatch(const char *manifest, const char *signprivate,
+		     const char *signprivate_pem, uint64_t pem_algorithm,
+		     uint64_t flags, const char *external_signer, int jobs)
+{
+	struct vb2_private_key *signing_key = NULL;
+	struct batch_entry *entries = NULL;
+	struct vb2_packed_key **data_keys = NULL;
+	struct vb2_keyblock **blocks = NULL;
+	uint32_t count = 0, i;
+	int errorcnt;
+
+	errorcnt = read_batch(manifest, &entries, &count);
+	if (errorcnt)
+		goto done;
+
+	data_keys = calloc(count + 1, sizeof(*data_keys));
+	blocks = calloc(count + 1, sizeof(*blocks));
+	if (!data_keys || !blocks) {
+		fprintf(stderr, "vbutil_keyblock: Out of memory\n");
+		errorcnt++;
+		goto done;
+	}
+
+	for (i = 0; i < count; i++) {
+		data_keys[i] = vb2_read_packed_key(entries[i].datapubkey);
+		if (!data_keys[i]) {
+			fprintf(stderr, "vbutil_keyblock: Error reading data "
+				"key %s.\n", entries[i].datapubkey);
+			errorcnt++;
+		}
+	}
+	if (errorcnt)
+		goto done;
+
+	/* Every keyblock is signed with the one copy of the key */
+	if (signprivate_pem) {
+		if (pem_algorithm >= VB2_ALG_COUNT) {
+			fprintf(stderr,
+				"vbutil_keyblock: Invalid --pem_algorithm %"
+				PRIu64 "\n", pem_algorithm);
+			errorcnt++;
+			goto done;
+		}
+		/* External signing uses the PEM file directly. */
+		if (!external_signer)
+			signing_key = vb2_get_private_key_pem(signprivate_pem,
+							       pem_algorithm);
+	} else if (signprivate) {
+		signing_key = vb2_get_private_key(signprivate);
+	}
+	if (!signing_key && !external_signer &&
+	    (signprivate || signprivate_pem)) {
+		fprintf(stderr,
+			"vbutil_keyblock: Error reading signing key.\n");
+		errorcnt++;
+		goto done;
+	}
+
+	if (external_signer)
+		vb2_create_keyblocks_external(
+			(const struct vb2_packed_key *const *)data_keys,
+			count, signprivate_pem, pem_algorithm, flags,
+			external_signer, blocks);
+	else
+		vb2_create_keyblocks(
+			(const struct vb2_packed_key *const *)data_keys,
+			count, signing_key, flags, jobs, blocks);
+
+	for (i = 0; i < count; i++) {
+		if (!blocks[i] ||
+		    VB2_SUCCESS != vb2_write_keyblock(entries[i].outfile,
+						      blocks[i])) {
+			fprintf(stderr, "vbutil_keyblock: Error writing key "
+				"block %s.\n", entries[i].outfile);
+			errorcnt++;
+		}
+	}
+
+done:
+	for (i = 0; i < count; i++) {
+		if (data_keys)
+			free(data_keys[i]);
+		if (blocks)
+			free(blocks[i]);
+		free(entries[i].datapubkey);
+		free(entries[i].outfile);
+	}
+	free(data_keys);
+	free(blocks);
+	free(entries);
+	vb2_put_private_key(signing_key);
+	return !!errorcnt;
+}
+
 static int Unpack(const char *infile, const char *datapubkey,
 		  const char *signpubkey)
 {
@@ -254,6 +422,7 @@ static int do_vbutil_keyblock(int argc, char *argv[])
 	uint64_t flags = 0;
 	uint64_t pem_algorithm = 0;
 	int is_pem_algorithm = 0;
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN);
 	int mode = 0;
 	int parse_error = 0;
 	char *e;
@@ -272,6 +441,7 @@ static int do_vbutil_keyblock(int argc, char *argv[])
 
 		case OPT_MODE_PACK:
 		case OPT_MODE_UNPACK:
+		case OPT_MODE_BATCH:
 			mode = i;
 			filename = optarg;
 			break;
@@ -313,6 +483,14 @@ static int do_vbutil_keyblock(int argc, char *argv[])
 				parse_error = 1;
 			}
 			break;
+
+		case OPT_JOBS:
+			jobs = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || jobs < 1) {
+				fprintf(stderr, "Invalid --jobs\n");
+				parse_error = 1;
+			}
+			break;
 		}
 	}
 
@@ -349,6 +527,14 @@ static int do_vbutil_keyblock(int argc, char *argv[])
 			    flags, external_signer);
 	case OPT_MODE_UNPACK:
 		return Unpack(filename, datapubkey, signpubkey);
+	case OPT_MODE_BATCH:
+		if (datapubkey) {
+			fprintf(stderr, "vbutil_keyblock: --batch takes the "
+				"data keys from the manifest\n");
+			return 1;
+		}
+		return PackBatch(filename, signprivate, signprivate_pem,
+				 pem_algorithm, flags, external_signer, jobs);
 	default:
 		printf("Must specify a mode.\n");
 		print_help(argc, argv);
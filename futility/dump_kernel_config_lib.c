@@ -28,6 +28,9 @@
 
 typedef ssize_t (*ReadFullyFn)(void *ctx, void *buf, size_t count);
 
+/* Skip count bytes of the stream.  Return 0 on success. */
+typedef int (*SkipFn)(void *ctx, ReadFullyFn read_fn, size_t count);
+
 static ssize_t ReadFullyWithRead(void *ctx, void *buf, size_t count)
 {
 	ssize_t nr_read = 0;
@@ -45,6 +48,40 @@ static ssize_t ReadFullyWithRead(void *ctx, void *buf, size_t count)
 	return nr_read;
 }
 
+/*
+ * Seekable files (including block devices) are read with pread(), so skipping
+ * is free and only the headers and the config are actually read.
+ */
+struct pread_ctx {
+	int fd;
+	off_t offset;
+};
+
+static ssize_t ReadFullyWithPread(void *ctx, void *buf, size_t count)
+{
+	struct pread_ctx *p = ctx;
+	ssize_t nr_read = 0;
+	while (nr_read < count) {
+		ssize_t chunk = pread(p->fd, buf + nr_read, count - nr_read,
+				      p->offset + nr_read);
+		if (chunk < 0) {
+			return -1;
+		} else if (chunk == 0) {
+			break;
+		}
+		nr_read += chunk;
+	}
+	p->offset += nr_read;
+	return nr_read;
+}
+
+static int SkipWithPread(void *ctx, ReadFullyFn read_fn, size_t count)
+{
+	struct pread_ctx *p = ctx;
+	p->offset += count;
+	return 0;
+}
+
 #ifdef USE_MTD
 static ssize_t ReadFullyWithMtdRead(void *ctx, void *buf, size_t count)
 {
@@ -72,6 +109,7 @@ static int SkipWithRead(void *ctx, ReadFullyFn read_fn, size_t count)
 }
 
 static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
+					SkipFn skip_fn,
 					uint64_t kernel_body_load_address)
 {
 	struct vb2_keyblock keyblock;
@@ -85,7 +123,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 		return NULL;
 	}
 	ssize_t to_skip = keyblock.keyblock_size - sizeof(keyblock);
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		VbExError("keyblock_size advances past the end of the blob\n");
 		return NULL;
 	}
@@ -97,7 +135,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 		return NULL;
 	}
 	to_skip = preamble.preamble_size - sizeof(preamble);
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		VbExError("preamble_size advances past the end of the blob\n");
 		return NULL;
 	}
@@ -115,7 +153,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 	    (kernel_body_load_address + CROS_PARAMS_SIZE +
 	     CROS_CONFIG_SIZE) + now;
 	to_skip = offset - now;
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		VbExError("params are outside of the memory blob: %x\n",
 			  offset);
 		return NULL;
@@ -145,6 +183,14 @@ char *FindKernelConfig(const char *infile, uint64_t kernel_body_load_address)
 
 	void *ctx = &fd;
 	ReadFullyFn read_fn = ReadFullyWithRead;
+	SkipFn skip_fn = SkipWithRead;
+	struct pread_ctx pctx = { .fd = fd, .offset = 0 };
+
+	if (lseek(fd, 0, SEEK_CUR) != (off_t)-1) {
+		ctx = &pctx;
+		read_fn = ReadFullyWithPread;
+		skip_fn = SkipWithPread;
+	}
 
 #ifdef USE_MTD
 	struct stat stat_buf;
@@ -161,10 +207,11 @@ char *FindKernelConfig(const char *infile, uint64_t kernel_body_load_address)
 			return NULL;
 		}
 		read_fn = ReadFullyWithMtdRead;
+		skip_fn = SkipWithRead;
 	}
 #endif
 
-	newstr = FindKernelConfigFromStream(ctx, read_fn,
+	newstr = FindKernelConfigFromStream(ctx, read_fn, skip_fn,
 					    kernel_body_load_address);
 
 #ifdef USE_MTD
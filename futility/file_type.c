@@ -16,6 +16,7 @@
 
 #include "file_type.h"
 #include "futility.h"
+#include "vboot_futility.h"
 
 /* Description and functions to handle each file type */
 struct futil_file_type_s {
@@ -80,18 +81,31 @@ void print_file_types_and_exit(int retval)
 	exit(retval);
 }
 
-/* Try to figure out what we're looking at */
+/*
+ * Try to figure out what we're looking at.
+ *
+ * Several types share one recognizer, which returns whichever of its types it
+ * found.  Each recognizer is therefore only tried once, at the position of
+ * its first type; they are all expected to reject a buffer cheaply (by magic
+ * bytes or signatures at known offsets) before doing any real parsing.
+ */
 enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len)
 {
 	enum futil_file_type type;
-	int i;
+	int i, j;
 
 	for (i = 0; i < NUM_FILE_TYPES; i++) {
-		if (futil_file_types[i].recognize) {
-			type = futil_file_types[i].recognize(buf, len);
-			if (type != FILE_TYPE_UNKNOWN)
-				return type;
-		}
+		if (!futil_file_types[i].recognize)
+			continue;
+		for (j = 0; j < i; j++)
+			if (futil_file_types[j].recognize ==
+			    futil_file_types[i].recognize)
+				break;
+		if (j < i)
+			continue;
+		type = futil_file_types[i].recognize(buf, len);
+		if (type != FILE_TYPE_UNKNOWN)
+			return type;
 	}
 
 	return FILE_TYPE_UNKNOWN;
@@ -122,7 +136,25 @@ enum futil_file_err futil_file_type(const char *filename,
 		return FILE_ERR_STAT;
 	}
 
-	if (S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode)) {
+	/*
+	 * Streams are read into memory, as a type can't be told from less
+	 * than all of a file (a BIOS image's FMAP may be anywhere in it).
+	 * Anything unreasonably big or unreadable, like /dev/zero, is still
+	 * reported as what kind of file it is.
+	 */
+	if (S_ISCHR(sb.st_mode) || S_ISFIFO(sb.st_mode) ||
+	    S_ISSOCK(sb.st_mode)) {
+		if (!futil_map_file(ifd, MAP_RO, &buf, &buf_len)) {
+			*type = futil_file_type_buf(buf, buf_len);
+			futil_unmap_file(ifd, MAP_RO, buf, buf_len);
+		} else if (S_ISCHR(sb.st_mode)) {
+			err = FILE_ERR_CHR;
+		} else if (S_ISFIFO(sb.st_mode)) {
+			err = FILE_ERR_FIFO;
+		} else {
+			err = FILE_ERR_SOCK;
+		}
+	} else if (S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode)) {
 		err = futil_map_file(ifd, MAP_RO, &buf, &buf_len);
 		if (err) {
 			close(ifd);
@@ -138,12 +170,6 @@ enum futil_file_err futil_file_type(const char *filename,
 		}
 	} else if (S_ISDIR(sb.st_mode)) {
 		err = FILE_ERR_DIR;
-	} else if (S_ISCHR(sb.st_mode)) {
-		err = FILE_ERR_CHR;
-	} else if (S_ISFIFO(sb.st_mode)) {
-		err = FILE_ERR_FIFO;
-	} else if (S_ISSOCK(sb.st_mode)) {
-		err = FILE_ERR_SOCK;
 	}
 
 	if (close(ifd)) {
@@ -155,6 +181,16 @@ enum futil_file_err futil_file_type(const char *filename,
 	return err;
 }
 
+const char *FutilityFileType(const char *filename)
+{
+	enum futil_file_type type;
+
+	if (futil_file_type(filename, &type) != FILE_ERR_NONE)
+		return NULL;
+
+	return futil_file_type_name(type);
+}
+
 int futil_file_type_show(enum futil_file_type type,
 			 const char *filename,
 			 uint8_t *buf, uint32_t len)
@@ -34,7 +34,9 @@ enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len);
 
 /*
  * This opens a file and tries to match it to one of the known file types.
- * It's not an error if it returns FILE_TYPE_UKNOWN.
+ * It's not an error if it returns FILE_TYPE_UKNOWN.  A pipe or other stream
+ * is read to its end, so it can't be read again afterwards; use
+ * futil_map_file() and futil_file_type_buf() to both type and use one.
  */
 enum futil_file_err futil_file_type(const char *filename,
 				    enum futil_file_type *type);
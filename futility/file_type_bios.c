@@ -5,6 +5,7 @@
  */
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -303,15 +304,25 @@ whatever:
 	return 0;
 }
 
+/*
+ * Signs fw_body and writes the keyblock and new preamble to vblock, and to
+ * vblock_copy too if it's not NULL.
+ */
 static int write_new_preamble(struct bios_area_s *vblock,
+			      struct bios_area_s *vblock_copy,
 			      struct bios_area_s *fw_body,
 			      struct vb2_private_key *signkey,
 			      struct vb2_keyblock *keyblock)
 {
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
 	struct vb2_signature *body_sig;
 	struct vb2_fw_preamble *preamble;
+	uint32_t more, size;
 
-	body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len, signkey);
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	body_sig = vb2_calculate_signature_wb(fw_body->buf, fw_body->len,
+					      signkey, &wb);
 	if (!body_sig) {
 		fprintf(stderr, "Error calculating body signature\n");
 		return 1;
@@ -324,22 +335,50 @@ static int write_new_preamble(struct bios_area_s *vblock,
 			sign_option.flags);
 	if (!preamble) {
 		fprintf(stderr, "Error creating firmware preamble.\n");
-		free(body_sig);
+		return 1;
+	}
+
+	more = keyblock->keyblock_size;
+	size = more + preamble->preamble_size;
+	if (size > vblock->len || (vblock_copy && size > vblock_copy->len)) {
+		fprintf(stderr, "New vblock doesn't fit in its FMAP area.\n");
+		free(preamble);
 		return 1;
 	}
 
 	/* Write the new keyblock */
-	uint32_t more = keyblock->keyblock_size;
 	memcpy(vblock->buf, keyblock, more);
 	/* and the new preamble */
 	memcpy(vblock->buf + more, preamble, preamble->preamble_size);
 
+	if (vblock_copy)
+		memcpy(vblock_copy->buf, vblock->buf, size);
+
 	free(preamble);
-	free(body_sig);
 
 	return 0;
 }
 
+/* Signing of FW B, done on a second thread while FW A is signed. */
+struct preamble_job {
+	struct bios_area_s *vblock;
+	struct bios_area_s *fw_body;
+	struct vb2_private_key *signkey;
+	struct vb2_keyblock *keyblock;
+	pthread_t thread;
+	int started;
+	int rv;
+};
+
+static void *preamble_worker(void *arg)
+{
+	struct preamble_job *job = arg;
+
+	job->rv = write_new_preamble(job->vblock, NULL, job->fw_body,
+				     job->signkey, job->keyblock);
+	return NULL;
+}
+
 static int write_loem(const char *ab, struct bios_area_s *vblock)
 {
 	char filename[PATH_MAX];
@@ -381,6 +420,7 @@ static int sign_bios_at_end(struct bios_state_s *state)
 	struct bios_area_s *vblock_b = &state->area[BIOS_FMAP_VBLOCK_B];
 	struct bios_area_s *fw_a = &state->area[BIOS_FMAP_FW_MAIN_A];
 	struct bios_area_s *fw_b = &state->area[BIOS_FMAP_FW_MAIN_B];
+	struct preamble_job job_b;
 	int retval = 0;
 
 	if (!vblock_a->is_valid || !vblock_b->is_valid ||
@@ -398,23 +438,34 @@ static int sign_bios_at_end(struct bios_state_s *state)
 				"FW A & B differ. DEV keys are required.\n");
 			return 1;
 		}
-		retval |= write_new_preamble(vblock_a, fw_a,
+
+		/* FW B is always normal keys; sign it alongside A. */
+		job_b.vblock = vblock_b;
+		job_b.fw_body = fw_b;
+		job_b.signkey = sign_option.signprivate;
+		job_b.keyblock = sign_option.keyblock;
+		job_b.started = !pthread_create(&job_b.thread, NULL,
+						preamble_worker, &job_b);
+		if (!job_b.started)
+			preamble_worker(&job_b);
+
+		retval |= write_new_preamble(vblock_a, NULL, fw_a,
 					     sign_option.devsignprivate,
 					     sign_option.devkeyblock);
+
+		if (job_b.started)
+			pthread_join(job_b.thread, NULL);
+		retval |= job_b.rv;
 	} else {
-		retval |= write_new_preamble(vblock_a, fw_a,
+		/*
+		 * No, so both are signed with the normal keys and get the same
+		 * vblock.  Sign A and copy it to B.
+		 */
+		retval |= write_new_preamble(vblock_a, vblock_b, fw_a,
 					     sign_option.signprivate,
 					     sign_option.keyblock);
 	}
 
-	/* FW B is always normal keys */
-	retval |= write_new_preamble(vblock_b, fw_b,
-				     sign_option.signprivate,
-				     sign_option.keyblock);
-
-
-
-
 	if (sign_option.loemid) {
 		retval |= write_loem("A", vblock_a);
 		retval |= write_loem("B", vblock_b);
@@ -13,6 +13,7 @@
  * This file provides the basic implementation for that approach.
  */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -61,6 +62,31 @@ static void show_sig(const char *name, const struct vb21_signature *sig)
 	       sig->data_size);
 }
 
+/* Check of the region padding, done on a second thread while verifying. */
+struct padding_job {
+	const uint8_t *data;
+	uint32_t start;
+	uint32_t end;
+	pthread_t thread;
+	int started;
+	int rv;
+};
+
+static void *padding_worker(void *arg)
+{
+	struct padding_job *job = arg;
+	uint32_t i;
+
+	job->rv = 0;
+	for (i = job->start; i < job->end; i++) {
+		if (job->data[i] != 0xff) {
+			job->rv = 1;
+			break;
+		}
+	}
+	return NULL;
+}
+
 int ft_show_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 {
 	const struct vb21_signature *sig = 0;
@@ -71,9 +97,10 @@ int ft_show_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 	struct vb2_workbuf wb;
 	uint32_t data_size, sig_size = SIGNATURE_RSVD_SIZE;
 	uint32_t total_data_size = 0;
+	struct padding_job padding;
 	uint8_t *data;
 	FmapHeader *fmap;
-	int i;
+	int rv;
 
 	VB2_DEBUG("name %s len 0x%08x (%d)\n", name, len, len);
 
@@ -176,6 +203,18 @@ int ft_show_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 		return 1;
 	}
 
+	/*
+	 * Check that the rest of region is padded with 0xff.  That doesn't
+	 * depend on the signature, so do it alongside hashing the data.
+	 */
+	padding.data = data;
+	padding.start = data_size;
+	padding.end = total_data_size;
+	padding.started = !pthread_create(&padding.thread, NULL,
+					  padding_worker, &padding);
+	if (!padding.started)
+		padding_worker(&padding);
+
 	/* The sig is destroyed by the verify operation, so make a copy */
 	{
 		uint8_t sigbuf[sig->c.total_size];
@@ -183,34 +222,96 @@ int ft_show_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 
 		vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 
-		if (vb21_verify_data(data, data_size,
-				     (struct vb21_signature *)sigbuf,
-				     (const struct vb2_public_key *)&key,
-				     &wb)) {
-			fprintf(stderr, "Signature verification failed\n");
-			return 1;
-		}
+		rv = vb21_verify_data(data, data_size,
+				      (struct vb21_signature *)sigbuf,
+				      (const struct vb2_public_key *)&key,
+				      &wb);
 	}
 
-	/* Check that the rest of region is padded with 0xff. */
-	for (i = data_size; i < total_data_size; i++) {
-		if (data[i] != 0xff) {
-			fprintf(stderr, "Padding verification failed\n");
-			return 1;
-		}
+	if (padding.started)
+		pthread_join(padding.thread, NULL);
+
+	if (rv) {
+		fprintf(stderr, "Signature verification failed\n");
+		return 1;
+	}
+	if (padding.rv) {
+		fprintf(stderr, "Padding verification failed\n");
+		return 1;
 	}
 
 	printf("Signature verification succeeded.\n");
 	return 0;
 }
 
-int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
+/* New public key for KEY_RO, packed on a second thread while signing. */
+struct pubkey_job {
+	const struct vb2_private_key *prikey;
+	struct vb21_packed_key *packedkey;
+	pthread_t thread;
+	int started;
+};
+
+static void *pubkey_worker(void *arg)
 {
-	struct vb21_signature *tmp_sig = 0;
+	struct pubkey_job *job = arg;
+	const struct vb2_private_key *prikey = job->prikey;
 	struct vb2_public_key *pubkey = 0;
-	struct vb21_packed_key *packedkey = 0;
 	uint8_t *keyb_data = 0;
 	uint32_t keyb_size;
+	uint8_t *pubkey_buf;
+
+	job->packedkey = 0;
+
+	/* Create the public key */
+	if (vb2_public_key_alloc(&pubkey, prikey->sig_alg)) {
+		fprintf(stderr, "Unable to allocate the public key\n");
+		goto done;
+	}
+
+	/* Extract the keyb blob */
+	if (vb_keyb_from_rsa(prikey->rsa_private_key,
+				&keyb_data, &keyb_size)) {
+		fprintf(stderr, "Couldn't extract the public key\n");
+		goto done;
+	}
+
+	/*
+	 * Copy the keyb blob to the public key's buffer, because that's
+	 * where vb2_unpack_key_data() and vb2_public_key_pack() expect
+	 * to find it.
+	 */
+	pubkey_buf = vb2_public_key_packed_data(pubkey);
+	memcpy(pubkey_buf, keyb_data, keyb_size);
+
+	/* Fill in the internal struct pointers */
+	if (vb2_unpack_key_data(pubkey, pubkey_buf, keyb_size)) {
+		fprintf(stderr, "Unable to unpack the public key blob\n");
+		goto done;
+	}
+
+	pubkey->hash_alg = prikey->hash_alg;
+	pubkey->version = sign_option.version_specified ?
+		sign_option.version : 1;
+	vb2_public_key_set_desc(pubkey, prikey->desc);
+
+	memcpy((struct vb2_id *)pubkey->id, &prikey->id,
+		sizeof(*(pubkey->id)));
+
+	if (vb21_public_key_pack(&job->packedkey, pubkey))
+		job->packedkey = 0;
+done:
+	if (pubkey)
+		vb2_public_key_free(pubkey);
+	if (keyb_data)
+		free(keyb_data);
+	return NULL;
+}
+
+int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
+{
+	struct vb21_signature *tmp_sig = 0;
+	struct pubkey_job pubkey_job = {0};
 	uint8_t* data = buf; /* data to be signed */
 	uint32_t r, data_size = len, sig_size = SIGNATURE_RSVD_SIZE;
 	int retval = 1;
@@ -282,6 +383,19 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 	if (sign_option.data_size)
 		data_size = sign_option.data_size;
 
+	/*
+	 * For full images, the public key in RO gets replaced too.  Making it
+	 * doesn't depend on the data, so do it alongside signing.
+	 */
+	if (fmap && sign_option.prikey) {
+		pubkey_job.prikey = sign_option.prikey;
+		pubkey_job.started = !pthread_create(&pubkey_job.thread, NULL,
+						     pubkey_worker,
+						     &pubkey_job);
+		if (!pubkey_job.started)
+			pubkey_worker(&pubkey_job);
+	}
+
 	/* Sign the blob */
 	if (sign_option.prikey) {
 		r = vb21_sign_data(&tmp_sig,
@@ -335,48 +449,15 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 	/* For full images, let's replace the public key in RO. If prikey is
 	 * not provided, skip it. */
 	if (fmap && sign_option.prikey) {
+		struct vb21_packed_key *packedkey;
 		uint8_t *new_pubkey;
-		uint8_t *pubkey_buf = 0;
-
-		/* Create the public key */
-		if (vb2_public_key_alloc(&pubkey,
-						sign_option.prikey->sig_alg)) {
-			fprintf(stderr, "Unable to allocate the public key\n");
-			goto done;
-		}
-
-		/* Extract the keyb blob */
-		if (vb_keyb_from_rsa(sign_option.prikey->rsa_private_key,
-					&keyb_data, &keyb_size)) {
-			fprintf(stderr, "Couldn't extract the public key\n");
-			goto done;
-		}
-
-		/*
-		 * Copy the keyb blob to the public key's buffer, because that's
-		 * where vb2_unpack_key_data() and vb2_public_key_pack() expect
-		 * to find it.
-		 */
-		pubkey_buf = vb2_public_key_packed_data(pubkey);
-		memcpy(pubkey_buf, keyb_data, keyb_size);
 
-		/* Fill in the internal struct pointers */
-		if (vb2_unpack_key_data(pubkey, pubkey_buf, keyb_size)) {
-			fprintf(stderr, "Unable to unpack the public key blob\n");
+		if (pubkey_job.started)
+			pthread_join(pubkey_job.thread, NULL);
+		pubkey_job.started = 0;
+		packedkey = pubkey_job.packedkey;
+		if (!packedkey)
 			goto done;
-		}
-
-		pubkey->hash_alg = sign_option.prikey->hash_alg;
-		pubkey->version = sign_option.version_specified ?
-			sign_option.version : 1;
-		vb2_public_key_set_desc(pubkey, sign_option.prikey->desc);
-
-		memcpy((struct vb2_id *)pubkey->id, &sign_option.prikey->id,
-			sizeof(*(pubkey->id)));
-
-		if (vb21_public_key_pack(&packedkey, pubkey)) {
-			goto done;
-		}
 
 		new_pubkey = fmap_find_by_name(buf, len, fmap, "KEY_RO",
 					&fmaparea);
@@ -398,14 +479,12 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 	/* Finally */
 	retval = 0;
 done:
+	if (pubkey_job.started)
+		pthread_join(pubkey_job.thread, NULL);
 	if (tmp_sig)
 		free(tmp_sig);
-	if (pubkey)
-		vb2_public_key_free(pubkey);
-	if (packedkey)
-		free(packedkey);
-	if (keyb_data)
-		free(keyb_data);
+	if (pubkey_job.packedkey)
+		free(pubkey_job.packedkey);
 
 	return retval;
 }
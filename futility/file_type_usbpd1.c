@@ -302,6 +302,7 @@ static void vb2_pubkey_from_usbpd1(struct vb2_public_key *key,
 	key->desc = 0;
 	key->version = 0;
 	key->id = vb2_hash_id(hash_alg);
+	key->allow_hwcrypto = 0;
 }
 
 static int vb21_sig_from_usbpd1(struct vb21_signature **sig,
@@ -410,12 +411,22 @@ static int check_self_consistency(const uint8_t *buf,
 	uint32_t sig_offset = rw_offset + rw_size - sig_size;
 	uint32_t pubkey_size = usbpd1_packed_key_size(sig_alg);
 	uint32_t pubkey_offset = ro_offset + ro_size - pubkey_size;
+	uint32_t n0, n0inv;
 	int rv;
 
 	/* Skip stuff that obviously doesn't work */
 	if (sig_size > rw_size || pubkey_size > ro_size)
 		return VB2_ERROR_UNKNOWN;
 
+	/*
+	 * A real key has n0inv = -1 / n[0] mod 2^32, so check that before
+	 * hashing the whole RW image.
+	 */
+	memcpy(&n0, buf + pubkey_offset, sizeof(n0));
+	memcpy(&n0inv, buf + pubkey_offset + 2 * sig_size, sizeof(n0inv));
+	if (n0 * n0inv != UINT32_MAX)
+		return VB2_ERROR_UNKNOWN;
+
 	rv = try_our_own(sig_alg, hash_alg,		   /* algs */
 			 buf + pubkey_offset, pubkey_size, /* pubkey blob */
 			 buf + sig_offset, sig_size,	   /* sig blob */
@@ -428,11 +439,68 @@ static int check_self_consistency(const uint8_t *buf,
 	return rv;
 }
 
+/*
+ * The algorithms which last validated an image, and which image that was.
+ * Showing a file right after recognizing it then only needs one full
+ * verification.  This only changes which algorithms are tried first, so an
+ * image which merely looks like the last one is still fully verified.
+ */
+#define LAST_MATCH_HEAD_SIZE 64
+static struct {
+	int valid;
+	uint32_t len, ro_size, rw_size, ro_offset, rw_offset;
+	uint8_t head[LAST_MATCH_HEAD_SIZE];
+	enum vb2_signature_algorithm sig_alg;
+	enum vb2_hash_algorithm hash_alg;
+} last_match;
+
+/* Returns VB2_SUCCESS if the image validates with any of our algorithms */
+static int find_algorithms(const uint8_t *buf, uint32_t len, const char *name,
+			   uint32_t ro_size, uint32_t rw_size,
+			   uint32_t ro_offset, uint32_t rw_offset)
+{
+	uint32_t head_size = len < LAST_MATCH_HEAD_SIZE ?
+		len : LAST_MATCH_HEAD_SIZE;
+	int s, h;
+
+	if (last_match.valid && last_match.len == len &&
+	    last_match.ro_size == ro_size && last_match.rw_size == rw_size &&
+	    last_match.ro_offset == ro_offset &&
+	    last_match.rw_offset == rw_offset &&
+	    !memcmp(last_match.head, buf, head_size)) {
+		VB2_DEBUG("Trying algorithms of the last image first\n");
+		if (!check_self_consistency(buf, name,
+					    ro_size, rw_size,
+					    ro_offset, rw_offset,
+					    last_match.sig_alg,
+					    last_match.hash_alg))
+			return VB2_SUCCESS;
+	}
+
+	for (s = 0; s < ARRAY_SIZE(sigs); s++)
+		for (h = 0; h < ARRAY_SIZE(hashes); h++)
+			if (!check_self_consistency(buf, name,
+						    ro_size, rw_size,
+						    ro_offset, rw_offset,
+						    sigs[s], hashes[h])) {
+				last_match.valid = 1;
+				last_match.len = len;
+				last_match.ro_size = ro_size;
+				last_match.rw_size = rw_size;
+				last_match.ro_offset = ro_offset;
+				last_match.rw_offset = rw_offset;
+				memcpy(last_match.head, buf, head_size);
+				last_match.sig_alg = sigs[s];
+				last_match.hash_alg = hashes[h];
+				return VB2_SUCCESS;
+			}
+
+	return VB2_ERROR_UNKNOWN;
+}
 
 int ft_show_usbpd1(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
 	uint32_t ro_size, rw_size, ro_offset, rw_offset;
-	int s, h;
 
 	VB2_DEBUG("name %s len  0x%08x (%d)\n", name, len, len);
 
@@ -448,13 +516,9 @@ int ft_show_usbpd1(const char *name, uint8_t *buf, uint32_t len, void *data)
 	}
 
 	/* TODO: Only loop through the numbers we haven't been given */
-	for (s = 0; s < ARRAY_SIZE(sigs); s++)
-		for (h = 0; h < ARRAY_SIZE(hashes); h++)
-			if (!check_self_consistency(buf, name,
-						    ro_size, rw_size,
-						    ro_offset, rw_offset,
-						    sigs[s], hashes[h]))
-				return 0;
+	if (!find_algorithms(buf, len, name,
+			     ro_size, rw_size, ro_offset, rw_offset))
+		return 0;
 
 	printf("This doesn't appear to be a complete usbpd1 image\n");
 	return 1;
@@ -463,7 +527,6 @@ int ft_show_usbpd1(const char *name, uint8_t *buf, uint32_t len, void *data)
 enum futil_file_type ft_recognize_usbpd1(uint8_t *buf, uint32_t len)
 {
 	uint32_t ro_size, rw_size, ro_offset, rw_offset;
-	int s, h;
 
 	/*
 	 * Since we don't use any headers to identify or locate the pubkey and
@@ -475,13 +538,9 @@ enum futil_file_type ft_recognize_usbpd1(uint8_t *buf, uint32_t len)
 	ro_offset = 0;
 	ro_size = rw_size = rw_offset = len / 2;
 
-	for (s = 0; s < ARRAY_SIZE(sigs); s++)
-		for (h = 0; h < ARRAY_SIZE(hashes); h++)
-			if (!check_self_consistency(buf, 0,
-						    ro_size, rw_size,
-						    ro_offset, rw_offset,
-						    sigs[s], hashes[h]))
-				return FILE_TYPE_USBPD1;
+	if (!find_algorithms(buf, len, 0,
+			     ro_size, rw_size, ro_offset, rw_offset))
+		return FILE_TYPE_USBPD1;
 
 	return FILE_TYPE_UNKNOWN;
 }
@@ -4,176 +4,15 @@
  * found in the LICENSE file.
  */
 
-#include <errno.h>
-#include <fcntl.h>
 #include <getopt.h>
-#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <unistd.h>
 
 #include "futility.h"
-
-/******************************************************************************/
-/* Logging stuff */
-
-/* File to use for logging, if present */
-#define LOGFILE "/tmp/futility.log"
-
-/* Normally logging will only happen if the logfile already exists. Uncomment
- * this to force log file creation (and thus logging) always. */
-
-/* #define FORCE_LOGGING_ON */
-
-static int log_fd = -1;
-
-/* Write the string and a newline. Silently give up on errors */
-static void log_str(const char *prefix, const char *str)
-{
-	int len, done, n;
-
-	if (log_fd < 0)
-		return;
-
-	if (!str)
-		str = "(NULL)";
-
-	if (prefix && *prefix) {
-		len = strlen(prefix);
-		for (done = 0; done < len; done += n) {
-			n = write(log_fd, prefix + done, len - done);
-			if (n < 0)
-				return;
-		}
-	}
-
-	len = strlen(str);
-	if (len == 0) {
-		str = "(EMPTY)";
-		len = strlen(str);
-	}
-
-	for (done = 0; done < len; done += n) {
-		n = write(log_fd, str + done, len - done);
-		if (n < 0)
-			return;
-	}
-
-	if (write(log_fd, "\n", 1) < 0)
-		return;
-}
-
-static void log_close(void)
-{
-	struct flock lock;
-
-	if (log_fd >= 0) {
-		memset(&lock, 0, sizeof(lock));
-		lock.l_type = F_UNLCK;
-		lock.l_whence = SEEK_SET;
-		if (fcntl(log_fd, F_SETLKW, &lock))
-			perror("Unable to unlock log file");
-
-		close(log_fd);
-		log_fd = -1;
-	}
-}
-
-static void log_open(void)
-{
-	struct flock lock;
-	int ret;
-
-#ifdef FORCE_LOGGING_ON
-	log_fd = open(LOGFILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
-#else
-	log_fd = open(LOGFILE, O_WRONLY | O_APPEND);
-#endif
-	if (log_fd < 0) {
-
-		if (errno != EACCES)
-			return;
-
-		/* Permission problems should improve shortly ... */
-		sleep(1);
-		log_fd = open(LOGFILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
-		if (log_fd < 0)	/* Nope, they didn't */
-			return;
-	}
-
-	/* Let anyone have a turn */
-	fchmod(log_fd, 0666);
-
-	/* But only one at a time */
-	memset(&lock, 0, sizeof(lock));
-	lock.l_type = F_WRLCK;
-	lock.l_whence = SEEK_END;
-
-	ret = fcntl(log_fd, F_SETLKW, &lock);	/* this blocks */
-	if (ret < 0)
-		log_close();
-}
-
-static void log_args(int argc, char *argv[])
-{
-	int i;
-	ssize_t r;
-	pid_t parent;
-	char buf[80];
-	FILE *fp;
-	char caller_buf[PATH_MAX];
-
-	log_open();
-
-	/* delimiter */
-	log_str(NULL, "##### LOG #####");
-
-	/* Can we tell who called us? */
-	parent = getppid();
-	snprintf(buf, sizeof(buf), "/proc/%d/exe", parent);
-	r = readlink(buf, caller_buf, sizeof(caller_buf) - 1);
-	if (r >= 0) {
-		caller_buf[r] = '\0';
-		log_str("CALLER:", caller_buf);
-	}
-
-	/* From where? */
-	snprintf(buf, sizeof(buf), "/proc/%d/cwd", parent);
-	r = readlink(buf, caller_buf, sizeof(caller_buf) - 1);
-	if (r >= 0) {
-		caller_buf[r] = '\0';
-		log_str("DIR:", caller_buf);
-	}
-
-	/* And maybe the args? */
-	snprintf(buf, sizeof(buf), "/proc/%d/cmdline", parent);
-	fp = fopen(buf, "r");
-	if (fp) {
-		memset(caller_buf, 0, sizeof(caller_buf));
-		r = fread(caller_buf, 1, sizeof(caller_buf) - 1, fp);
-		if (r > 0) {
-			char *s = caller_buf;
-			for (i = 0; i < r && *s; ) {
-				log_str("CMDLINE:", s);
-				while (i < r && *s)
-					i++, s++;
-				i++, s++;
-			}
-		}
-		fclose(fp);
-	}
-
-	/* Now log the stuff about ourselves */
-	for (i = 0; i < argc; i++)
-		log_str(NULL, argv[i]);
-
-	log_close();
-}
-
-/******************************************************************************/
+#include "futility_options.h"
+#include "vboot_futility.h"
 
 static const char *const usage = "\n"
 "Usage: " MYNAME " [options] COMMAND [args...]\n"
@@ -293,9 +132,8 @@ static char *simple_basename(char *str)
 	return s;
 }
 
-/* Here we go */
 #define OPT_HELP 1000
-int main(int argc, char *argv[], char *envp[])
+int FutilityRun(int argc, char *argv[])
 {
 	char *progname;
 	const struct futil_cmd_t *cmd;
@@ -310,7 +148,12 @@ int main(int argc, char *argv[], char *envp[])
 		{ 0, 0, 0, 0},
 	};
 
-	log_args(argc, argv);
+	/* Start over, in case we've been called before */
+	debugging_enabled = 0;
+	vboot_version = VBOOT_VERSION_ALL;
+	sign_option_reset();
+	show_option_reset();
+	optind = 0;
 
 	/* How were we invoked? */
 	progname = simple_basename(argv[0]);
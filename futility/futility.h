@@ -151,9 +151,15 @@ enum futil_file_err {
 	FILE_ERR_SOCK,
 };
 
-/* Wrapper for mmap/munmap. Skips stupidly large files. */
+/*
+ * Wrapper for mmap/munmap. Skips stupidly large files.  Pipes, sockets and
+ * character devices can be mapped MAP_RO: they are read into memory, up to
+ * FUTIL_MAX_STREAM_SIZE bytes.
+ */
 #define MAP_RO 0
 #define MAP_RW 1
+#define FUTIL_MAX_STREAM_SIZE (64 * 1024 * 1024)
+#define FUTIL_STREAM_CHUNK_SIZE (64 * 1024)
 enum futil_file_err futil_map_file(int fd, int writeable,
 				   uint8_t **buf, uint32_t *len);
 enum futil_file_err futil_unmap_file(int fd, int writeable,
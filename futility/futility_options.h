@@ -25,13 +25,25 @@ struct show_option_s {
 	uint64_t fv_size;
 	uint32_t padding;
 	int strict;
+	int direct;
 	int t_flag;
 	enum futil_file_type type;
 	struct vb21_packed_key *pkey;
 	uint32_t sig_size;
+	const char *cache_dir;
 };
 extern struct show_option_s show_option;
 
+/* Set show_option back to its defaults */
+void show_option_reset(void);
+
+/* Another set of keys to sign the same body with, from --keyset */
+struct sign_keyset {
+	struct vb2_keyblock *keyblock;
+	struct vb2_private_key *signprivate;
+	char *outfile;
+};
+
 struct sign_option_s {
 	struct vb2_private_key *signprivate;
 	struct vb2_keyblock *keyblock;
@@ -52,6 +64,10 @@ struct sign_option_s {
 	int fv_specified;
 	uint32_t kloadaddr;
 	uint32_t padding;
+	uint32_t chunk_size;
+	int chunk_size_specified;
+	uint32_t compression;
+	int compression_specified;
 	int vblockonly;
 	char *outfile;
 	int create_new_outfile;
@@ -66,9 +82,15 @@ struct sign_option_s {
 	uint32_t ro_offset, rw_offset;
 	uint32_t data_size, sig_size;
 	struct vb2_private_key *prikey;
+	struct sign_keyset *keysets;
+	int keyset_count;
+	uint32_t jobs;		/* From --jobs; 0 if not given */
 };
 extern struct sign_option_s sign_option;
 
+/* Set sign_option back to its defaults */
+void sign_option_reset(void);
+
 /* Return true if hash_alg was identified, either by name or number */
 int vb2_lookup_hash_alg(const char *str, enum vb2_hash_algorithm *alg);
 
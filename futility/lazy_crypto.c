@@ -0,0 +1,143 @@
+/*
+ * Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Loads libcrypto the first time futility calls into it, instead of at
+ * startup.
+ *
+ * Most futility commands, and all of the ones scripts run over and over
+ * (dump_fmap, gbb_utility, load_fmap, show), never touch OpenSSL; vboot does
+ * its own hashing.  Linking libcrypto normally makes every one of them pay to
+ * map and relocate it anyway, which is most of the time futility takes to
+ * start.  With LAZY_CRYPTO=1, futility is linked against this file instead:
+ * each OpenSSL function futility uses is defined here, and looks up the real
+ * one in libcrypto (loaded with dlopen() on the first call) before calling
+ * it.  OpenSSL itself already sets up its providers and config on first use.
+ *
+ * When futility starts using a new OpenSSL function, the LAZY_CRYPTO link
+ * fails until it is added to the list below.
+ */
+
+/* The functions have to be defined whether or not they are deprecated */
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#ifndef CRYPTO_SONAME
+#error "CRYPTO_SONAME must be defined to the soname of libcrypto"
+#endif
+
+static void *crypto_handle;
+static pthread_once_t crypto_once = PTHREAD_ONCE_INIT;
+
+static void load_crypto(void)
+{
+	crypto_handle = dlopen(CRYPTO_SONAME, RTLD_NOW | RTLD_LOCAL);
+}
+
+/* Returns the real function, or exits if libcrypto can't provide it */
+static void *crypto_sym(const char *name)
+{
+	void *sym = NULL;
+
+	pthread_once(&crypto_once, load_crypto);
+	if (crypto_handle)
+		sym = dlsym(crypto_handle, name);
+	if (!sym) {
+		fprintf(stderr, "ERROR: Can't load %s from %s: %s\n",
+			name, CRYPTO_SONAME, dlerror());
+		exit(1);
+	}
+	return sym;
+}
+
+/* Defines an OpenSSL function which calls the real one */
+#define LAZY_CRYPTO_FN(ret, name, params, args)				\
+	ret name params							\
+	{								\
+		static ret (*fn) params;				\
+		if (!fn)						\
+			fn = (ret (*) params)crypto_sym(#name);		\
+		return fn args;						\
+	}
+
+/* Same for a function which doesn't return anything */
+#define LAZY_CRYPTO_VOID_FN(name, params, args)				\
+	void name params						\
+	{								\
+		static void (*fn) params;				\
+		if (!fn)						\
+			fn = (void (*) params)crypto_sym(#name);	\
+		fn args;						\
+	}
+
+LAZY_CRYPTO_FN(long, BIO_ctrl,
+	       (BIO *bp, int cmd, long larg, void *parg),
+	       (bp, cmd, larg, parg))
+LAZY_CRYPTO_FN(int, BIO_free, (BIO *a), (a))
+LAZY_CRYPTO_FN(BIO *, BIO_new_mem_buf, (const void *buf, int len),
+	       (buf, len))
+
+LAZY_CRYPTO_FN(BN_CTX *, BN_CTX_new, (void), ())
+LAZY_CRYPTO_FN(BIGNUM *, BN_copy, (BIGNUM *a, const BIGNUM *b), (a, b))
+LAZY_CRYPTO_FN(int, BN_div,
+	       (BIGNUM *dv, BIGNUM *rem, const BIGNUM *m, const BIGNUM *d,
+		BN_CTX *ctx),
+	       (dv, rem, m, d, ctx))
+LAZY_CRYPTO_FN(int, BN_exp,
+	       (BIGNUM *r, const BIGNUM *a, const BIGNUM *p, BN_CTX *ctx),
+	       (r, a, p, ctx))
+LAZY_CRYPTO_VOID_FN(BN_free, (BIGNUM *a), (a))
+LAZY_CRYPTO_FN(BN_ULONG, BN_get_word, (const BIGNUM *a), (a))
+LAZY_CRYPTO_FN(BIGNUM *, BN_mod_inverse,
+	       (BIGNUM *ret, const BIGNUM *a, const BIGNUM *n, BN_CTX *ctx),
+	       (ret, a, n, ctx))
+LAZY_CRYPTO_FN(int, BN_mul,
+	       (BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx),
+	       (r, a, b, ctx))
+LAZY_CRYPTO_FN(BIGNUM *, BN_new, (void), ())
+LAZY_CRYPTO_FN(int, BN_num_bits, (const BIGNUM *a), (a))
+LAZY_CRYPTO_FN(int, BN_rshift, (BIGNUM *r, const BIGNUM *a, int n),
+	       (r, a, n))
+LAZY_CRYPTO_FN(int, BN_set_word, (BIGNUM *a, BN_ULONG w), (a, w))
+LAZY_CRYPTO_FN(int, BN_sub, (BIGNUM *r, const BIGNUM *a, const BIGNUM *b),
+	       (r, a, b))
+
+LAZY_CRYPTO_FN(RSA *, PEM_read_RSAPrivateKey,
+	       (FILE *fp, RSA **x, pem_password_cb *cb, void *u),
+	       (fp, x, cb, u))
+LAZY_CRYPTO_FN(RSA *, PEM_read_RSA_PUBKEY,
+	       (FILE *fp, RSA **x, pem_password_cb *cb, void *u),
+	       (fp, x, cb, u))
+LAZY_CRYPTO_FN(RSA *, PEM_read_bio_RSAPrivateKey,
+	       (BIO *bp, RSA **x, pem_password_cb *cb, void *u),
+	       (bp, x, cb, u))
+LAZY_CRYPTO_FN(RSA *, PEM_read_bio_RSA_PUBKEY,
+	       (BIO *bp, RSA **x, pem_password_cb *cb, void *u),
+	       (bp, x, cb, u))
+
+LAZY_CRYPTO_VOID_FN(RSA_free, (RSA *r), (r))
+LAZY_CRYPTO_VOID_FN(RSA_get0_key,
+		    (const RSA *r, const BIGNUM **n, const BIGNUM **e,
+		     const BIGNUM **d),
+		    (r, n, e, d))
+LAZY_CRYPTO_FN(int, RSA_private_encrypt,
+	       (int flen, const unsigned char *from, unsigned char *to,
+		RSA *rsa, int padding),
+	       (flen, from, to, rsa, padding))
+LAZY_CRYPTO_FN(int, RSA_size, (const RSA *rsa), (rsa))
+LAZY_CRYPTO_FN(RSA *, d2i_RSAPrivateKey,
+	       (RSA **a, const unsigned char **in, long len),
+	       (a, in, len))
+LAZY_CRYPTO_FN(int, i2d_RSAPrivateKey, (const RSA *a, unsigned char **out),
+	       (a, out))
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * The futility program.  The commands themselves are in libvboot_futility.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "futility.h"
+#include "vboot_futility.h"
+
+/******************************************************************************/
+/* Logging stuff */
+
+/* File to use for logging, if present */
+#define LOGFILE "/tmp/futility.log"
+
+/* Normally logging will only happen if the logfile already exists. Uncomment
+ * this to force log file creation (and thus logging) always. */
+
+/* #define FORCE_LOGGING_ON */
+
+static int log_fd = -1;
+
+/*
+ * Each record is built up here and written with a single O_APPEND write, so
+ * records from futility processes running at the same time don't get mixed
+ * up and nobody has to wait for a lock.
+ */
+static char *log_buf;
+static size_t log_len, log_size;
+
+/* Append to the record. Silently give up on errors */
+static void log_add(const char *str, size_t len)
+{
+	size_t size;
+	char *buf;
+
+	if (log_fd < 0)
+		return;
+
+	if (log_len + len > log_size) {
+		for (size = log_size ? log_size : 1024; size < log_len + len; )
+			size *= 2;
+		buf = realloc(log_buf, size);
+		if (!buf) {
+			/* Better no record than half of one */
+			close(log_fd);
+			log_fd = -1;
+			return;
+		}
+		log_buf = buf;
+		log_size = size;
+	}
+
+	memcpy(log_buf + log_len, str, len);
+	log_len += len;
+}
+
+/* Add the string and a newline to the record */
+static void log_str(const char *prefix, const char *str)
+{
+	if (log_fd < 0)
+		return;
+
+	if (!str)
+		str = "(NULL)";
+
+	if (prefix && *prefix)
+		log_add(prefix, strlen(prefix));
+
+	if (!*str)
+		str = "(EMPTY)";
+
+	log_add(str, strlen(str));
+	log_add("\n", 1);
+}
+
+/* Write out the record in one piece and close the log */
+static void log_close(void)
+{
+	if (log_fd >= 0) {
+		if (log_len && write(log_fd, log_buf, log_len) < 0)
+			perror("Unable to write log file");
+
+		close(log_fd);
+		log_fd = -1;
+	}
+
+	free(log_buf);
+	log_buf = NULL;
+	log_len = log_size = 0;
+}
+
+static void log_open(void)
+{
+#ifdef FORCE_LOGGING_ON
+	log_fd = open(LOGFILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
+#else
+	log_fd = open(LOGFILE, O_WRONLY | O_APPEND);
+#endif
+	if (log_fd < 0) {
+
+		if (errno != EACCES)
+			return;
+
+		/* Permission problems should improve shortly ... */
+		sleep(1);
+		log_fd = open(LOGFILE, O_WRONLY | O_APPEND | O_CREAT, 0666);
+		if (log_fd < 0)	/* Nope, they didn't */
+			return;
+	}
+
+	/* Let anyone have a turn */
+	fchmod(log_fd, 0666);
+}
+
+static void log_args(int argc, char *argv[])
+{
+	int i;
+	ssize_t r;
+	pid_t parent;
+	char buf[80];
+	FILE *fp;
+	char caller_buf[PATH_MAX];
+
+	log_open();
+
+	/* delimiter */
+	log_str(NULL, "##### LOG #####");
+
+	/* Can we tell who called us? */
+	parent = getppid();
+	snprintf(buf, sizeof(buf), "/proc/%d/exe", parent);
+	r = readlink(buf, caller_buf, sizeof(caller_buf) - 1);
+	if (r >= 0) {
+		caller_buf[r] = '\0';
+		log_str("CALLER:", caller_buf);
+	}
+
+	/* From where? */
+	snprintf(buf, sizeof(buf), "/proc/%d/cwd", parent);
+	r = readlink(buf, caller_buf, sizeof(caller_buf) - 1);
+	if (r >= 0) {
+		caller_buf[r] = '\0';
+		log_str("DIR:", caller_buf);
+	}
+
+	/* And maybe the args? */
+	snprintf(buf, sizeof(buf), "/proc/%d/cmdline", parent);
+	fp = fopen(buf, "r");
+	if (fp) {
+		memset(caller_buf, 0, sizeof(caller_buf));
+		r = fread(caller_buf, 1, sizeof(caller_buf) - 1, fp);
+		if (r > 0) {
+			char *s = caller_buf;
+			for (i = 0; i < r && *s; ) {
+				log_str("CMDLINE:", s);
+				while (i < r && *s)
+					i++, s++;
+				i++, s++;
+			}
+		}
+		fclose(fp);
+	}
+
+	/* Now log the stuff about ourselves */
+	for (i = 0; i < argc; i++)
+		log_str(NULL, argv[i]);
+
+	log_close();
+}
+
+/* Here we go */
+int main(int argc, char *argv[], char *envp[])
+{
+	log_args(argc, argv);
+
+	return FutilityRun(argc, argv);
+}
@@ -261,6 +261,90 @@ void futil_copy_file_or_die(const char *infile, const char *outfile)
 }
 
 
+/* Error for a file that can't be mapped, by the kind of file it is. */
+static enum futil_file_err stream_file_err(const struct stat *sb)
+{
+	if (S_ISDIR(sb->st_mode))
+		return FILE_ERR_DIR;
+	if (S_ISFIFO(sb->st_mode))
+		return FILE_ERR_FIFO;
+	if (S_ISSOCK(sb->st_mode))
+		return FILE_ERR_SOCK;
+	return FILE_ERR_CHR;
+}
+
+/*
+ * Reads all of a pipe, socket or character device into anonymous memory, so
+ * it can be used (and released by futil_unmap_file) like a mapped file.
+ */
+static enum futil_file_err read_stream(int fd, uint8_t **buf, uint32_t *len)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t size = 0, capacity = 0, used;
+	uint8_t *data = NULL;
+	ssize_t n;
+
+	for (;;) {
+		if (size == capacity) {
+			size_t new_capacity = capacity ? capacity * 2 :
+				FUTIL_STREAM_CHUNK_SIZE;
+			uint8_t *bigger;
+
+			/* Room for one more page tells us it's too big. */
+			if (new_capacity > FUTIL_MAX_STREAM_SIZE)
+				new_capacity = FUTIL_MAX_STREAM_SIZE +
+					page_size;
+			bigger = mmap(0, new_capacity, PROT_READ|PROT_WRITE,
+				      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if (bigger == MAP_FAILED) {
+				fprintf(stderr, "Can't map input stream: %s\n",
+					strerror(errno));
+				if (data)
+					munmap(data, capacity);
+				return FILE_ERR_MMAP;
+			}
+			if (data) {
+				memcpy(bigger, data, size);
+				munmap(data, capacity);
+			}
+			data = bigger;
+			capacity = new_capacity;
+		}
+		n = read(fd, data + size, capacity - size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			fprintf(stderr, "Can't read input stream: %s\n",
+				strerror(errno));
+			munmap(data, capacity);
+			return FILE_ERR_STAT;
+		}
+		if (!n)
+			break;
+		size += n;
+		if (size > FUTIL_MAX_STREAM_SIZE) {
+			fprintf(stderr, "Input stream is too big\n");
+			munmap(data, capacity);
+			return FILE_ERR_SIZE;
+		}
+	}
+
+	if (!size) {
+		fprintf(stderr, "Input stream is empty\n");
+		munmap(data, capacity);
+		return FILE_ERR_SIZE;
+	}
+
+	/* Give back the pages past the end, as munmap(buf, len) won't. */
+	used = (size + page_size - 1) & ~(page_size - 1);
+	if (used < capacity)
+		munmap(data + used, capacity - used);
+
+	*buf = data;
+	*len = size;
+	return FILE_ERR_NONE;
+}
+
 enum futil_file_err futil_map_file(int fd, int writeable,
 				   uint8_t **buf, uint32_t *len)
 {
@@ -274,6 +358,16 @@ enum futil_file_err futil_map_file(int fd, int writeable,
 		return FILE_ERR_STAT;
 	}
 
+	/* Streams can be read, but there's nothing to write back to. */
+	if (!S_ISREG(sb.st_mode) && !S_ISBLK(sb.st_mode)) {
+		if (writeable || S_ISDIR(sb.st_mode)) {
+			fprintf(stderr, "Can't map %s file: not a regular "
+				"file\n", writeable ? "output" : "input");
+			return stream_file_err(&sb);
+		}
+		return read_stream(fd, buf, len);
+	}
+
 #ifndef HAVE_MACOS
 	if (S_ISBLK(sb.st_mode))
 		ioctl(fd, BLKGETSIZE64, &sb.st_size);
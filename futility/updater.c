@@ -8,9 +8,14 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2rsa.h"
@@ -26,18 +31,19 @@
 #include "vb2_struct.h"
 
 #define COMMAND_BUFFER_SIZE 256
+/* Granularity for finding changed blocks; the usual SPI flash sector size. */
+#define FLASH_ERASE_BLOCK_SIZE 4096
+/* Above this, write_firmware() writes the whole section instead. */
+#define FLASH_MAX_WRITE_RANGES 32
+/* preserve_firmware_section() only copies blocks of this size that differ. */
+#define PRESERVE_BLOCK_SIZE 4096
 #define RETURN_ON_FAILURE(x) do {int r = (x); if (r) return r;} while (0);
-#define FLASHROM_OUTPUT_WP_PATTERN "write protect is "
 #define REMOVE_WP_URL "https://goo.gl/ces83U"
 
 /* System environment values. */
 static const char * const FWACT_A = "A",
 		  * const FWACT_B = "B",
-		  * const STR_REV = "rev",
-		  * const FLASHROM_OUTPUT_WP_ENABLED =
-			  FLASHROM_OUTPUT_WP_PATTERN "enabled",
-		  * const FLASHROM_OUTPUT_WP_DISABLED =
-			  FLASHROM_OUTPUT_WP_PATTERN "disabled";
+		  * const STR_REV = "rev";
 
 /* flashrom programmers. */
 static const char * const PROG_HOST = "host",
@@ -47,11 +53,6 @@ static const char * const PROG_HOST = "host",
 static const char ROOTKEY_HASH_DEV[] =
 		"b11d74edd286c144e1135b49e7f0bc20cf041f10";
 
-enum wp_state {
-	WP_DISABLED,
-	WP_ENABLED,
-};
-
 enum target_type {
 	TARGET_SELF,
 	TARGET_UPDATE,
@@ -63,12 +64,6 @@ enum active_slot {
 	SLOT_B,
 };
 
-enum flashrom_ops {
-	FLASHROM_READ,
-	FLASHROM_WRITE,
-	FLASHROM_WP_STATUS,
-};
-
 enum rootkey_compat_result {
 	ROOTKEY_COMPAT_OK,
 	ROOTKEY_COMPAT_ERROR,
@@ -77,34 +72,85 @@ enum rootkey_compat_result {
 };
 
 /*
- * Helper function to create a new temporary file.
+ * Free memory needed to keep temporary files in memory. Images are up to
+ * 32MB, and a few of them may be around at once.
+ */
+#define TEMP_MEMFD_MIN_FREE (128 * 1024 * 1024)
+
+/* Protects cfg->tempfiles, for writes running in the background. */
+static pthread_mutex_t tempfiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Creates an anonymous file in memory, so temporary images don't have to go
+ * through a slow (or wearing) /tmp. The file is reached by its /proc path,
+ * which works for other programs too while this one keeps it open.
+ * Returns the file descriptor and fills path, or -1 if memory is short or
+ * memfd is not supported.
+ */
+static int create_temp_memfd(char *path, size_t path_size)
+{
+#ifdef MFD_CLOEXEC
+	long pages = sysconf(_SC_AVPHYS_PAGES);
+	long page_size = sysconf(_SC_PAGESIZE);
+	int fd;
+
+	if (pages < 0 || page_size < 0 ||
+	    (uint64_t)pages * page_size < TEMP_MEMFD_MIN_FREE)
+		return -1;
+	fd = memfd_create("fwupdater", MFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	snprintf(path, path_size, "/proc/%d/fd/%d", (int)getpid(), fd);
+	if (access(path, R_OK | W_OK)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Helper function to create a new temporary file, in memory if there's
+ * enough, otherwise in P_tmpdir.
  * All files created will be removed by updater_remove_all_temp_files().
  * Returns the path of new file, or NULL on failure.
  */
 const char *updater_create_temp_file(struct updater_config *cfg)
 {
 	struct tempfile *new_temp;
-	char new_path[] = P_tmpdir "/fwupdater.XXXXXX";
-	int fd;
-
-	fd = mkstemp(new_path);
-	if (fd < 0) {
-		ERROR("Failed to create new temp file in %s\n", new_path);
-		return NULL;
+	char new_path[PATH_MAX] = P_tmpdir "/fwupdater.XXXXXX";
+	int fd, memfd;
+
+	memfd = create_temp_memfd(new_path, sizeof(new_path));
+	if (memfd < 0) {
+		fd = mkstemp(new_path);
+		if (fd < 0) {
+			ERROR("Failed to create new temp file in %s\n",
+			      new_path);
+			return NULL;
+		}
+		close(fd);
 	}
-	close(fd);
 	new_temp = (struct tempfile *)malloc(sizeof(*new_temp));
 	if (new_temp)
 		new_temp->filepath = strdup(new_path);
 	if (!new_temp || !new_temp->filepath) {
-		remove(new_path);
+		if (memfd < 0)
+			remove(new_path);
+		else
+			close(memfd);
 		free(new_temp);
 		ERROR("Failed to allocate buffer for new temp file.\n");
 		return NULL;
 	}
 	VB2_DEBUG("Created new temporary file: %s.\n", new_path);
+	new_temp->fd = memfd;
+	pthread_mutex_lock(&tempfiles_lock);
 	new_temp->next = cfg->tempfiles;
 	cfg->tempfiles = new_temp;
+	pthread_mutex_unlock(&tempfiles_lock);
 	return new_temp->filepath;
 }
 
@@ -118,7 +164,10 @@ static void updater_remove_all_temp_files(struct updater_config *cfg)
 	while (tempfiles != NULL) {
 		struct tempfile *target = tempfiles;
 		VB2_DEBUG("Remove temporary file: %s.\n", target->filepath);
-		remove(target->filepath);
+		if (target->fd < 0)
+			remove(target->filepath);
+		else
+			close(target->fd);
 		free(target->filepath);
 		tempfiles = target->next;
 		free(target);
@@ -185,12 +234,90 @@ char *host_shell(const char *command)
 }
 
 
+/*
+ * crossystem keeps global state (the snapshot and cached NV storage), so
+ * updater configs in different threads take turns using it.
+ */
+static pthread_mutex_t crossystem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Configs using the snapshot, which the first of them took. */
+static int crossystem_snapshot_users;
+
+/*
+ * Takes a crossystem snapshot for cfg, or shares the one other configs use.
+ * The properties all come from the same firmware data, so this reads it
+ * once for all of them.
+ */
+static void crossystem_snapshot(struct updater_config *cfg)
+{
+	if (cfg->crossystem_snapshot)
+		return;
+	pthread_mutex_lock(&crossystem_lock);
+	if (!crossystem_snapshot_users++)
+		VbSnapshotSystemProperties();
+	pthread_mutex_unlock(&crossystem_lock);
+	cfg->crossystem_snapshot = 1;
+}
+
+/* Stops using the snapshot, releasing it after the last config. */
+static void crossystem_release(struct updater_config *cfg)
+{
+	if (!cfg->crossystem_snapshot)
+		return;
+	pthread_mutex_lock(&crossystem_lock);
+	if (!--crossystem_snapshot_users)
+		VbReleaseSystemPropertySnapshot();
+	pthread_mutex_unlock(&crossystem_lock);
+	cfg->crossystem_snapshot = 0;
+}
+
+static int crossystem_get_int(const char *name)
+{
+	int r;
+
+	pthread_mutex_lock(&crossystem_lock);
+	r = VbGetSystemPropertyInt(name);
+	pthread_mutex_unlock(&crossystem_lock);
+	return r;
+}
+
+/* Returns 0 on success, or non-zero if the property can't be read. */
+static int crossystem_get_string(const char *name, char *buf, size_t size)
+{
+	const char *r;
+
+	pthread_mutex_lock(&crossystem_lock);
+	r = VbGetSystemPropertyString(name, buf, size);
+	pthread_mutex_unlock(&crossystem_lock);
+	return !r;
+}
+
+static int crossystem_set_int(const char *name, int value)
+{
+	int r;
+
+	pthread_mutex_lock(&crossystem_lock);
+	r = VbSetSystemPropertyInt(name, value);
+	pthread_mutex_unlock(&crossystem_lock);
+	return r;
+}
+
+static int crossystem_set_string(const char *name, const char *value)
+{
+	int r;
+
+	pthread_mutex_lock(&crossystem_lock);
+	r = VbSetSystemPropertyString(name, value);
+	pthread_mutex_unlock(&crossystem_lock);
+	return r;
+}
+
 /* An helper function to return "mainfw_act" system property.  */
-static int host_get_mainfw_act(void)
+static int host_get_mainfw_act(struct updater_config *cfg)
 {
 	char buf[VB_MAX_STRING_PROPERTY];
 
-	if (!VbGetSystemPropertyString("mainfw_act", buf, sizeof(buf)))
+	if (crossystem_get_string("mainfw_act", buf, sizeof(buf)))
 		return SLOT_UNKNOWN;
 
 	if (strcmp(buf, FWACT_A) == 0)
@@ -202,149 +329,93 @@ static int host_get_mainfw_act(void)
 }
 
 /* A helper function to return the "tpm_fwver" system property. */
-static int host_get_tpm_fwver(void)
+static int host_get_tpm_fwver(struct updater_config *cfg)
 {
-	return VbGetSystemPropertyInt("tpm_fwver");
+	return crossystem_get_int("tpm_fwver");
 }
 
 /* A helper function to return the "hardware write protection" status. */
-static int host_get_wp_hw(void)
+static int host_get_wp_hw(struct updater_config *cfg)
 {
 	/* wpsw refers to write protection 'switch', not 'software'. */
-	int v = VbGetSystemPropertyInt("wpsw_cur");
+	int v = crossystem_get_int("wpsw_cur");
 
 	/* wpsw_cur may be not available, especially in recovery mode. */
 	if (v < 0)
-		v = VbGetSystemPropertyInt("wpsw_boot");
+		v = crossystem_get_int("wpsw_boot");
 
 	return v;
 }
 
 /* A helper function to return "fw_vboot2" system property. */
-static int host_get_fw_vboot2(void)
+static int host_get_fw_vboot2(struct updater_config *cfg)
 {
-	return VbGetSystemPropertyInt("fw_vboot2");
+	return crossystem_get_int("fw_vboot2");
 }
 
-/* A help function to get $(mosys platform version). */
-static int host_get_platform_version(void)
-{
-	char *result = host_shell("mosys platform version");
-	int rev = -1;
-
-	/* Result should be 'revN' */
-	if (strncmp(result, STR_REV, strlen(STR_REV)) == 0)
-		rev = strtol(result + strlen(STR_REV), NULL, 0);
-	VB2_DEBUG("Raw data = [%s], parsed version is %d\n", result, rev);
-
-	free(result);
-	return rev;
-}
+/* Where the kernel exposes what mosys reads for the platform version. */
+static const char * const DMI_PRODUCT_VERSION =
+		"/sys/class/dmi/id/product_version",
+		  * const DT_COREBOOT_BOARD_ID =
+		"/proc/device-tree/firmware/coreboot/board-id";
 
-/*
- * A helper function to invoke flashrom(8) command.
- * Returns 0 if success, non-zero if error.
- */
-static int host_flashrom(enum flashrom_ops op, const char *image_path,
-			 const char *programmer, int verbose,
-			 const char *section_name, const char *extra)
+char *host_read_platform_version(void)
 {
-	char *command, *result;
-	const char *op_cmd, *dash_i = "-i", *postfix = "";
-	int r;
+	char buf[COMMAND_BUFFER_SIZE] = "";
+	uint8_t id[4];
+	char *version = NULL;
+	FILE *fp;
 
-	switch (verbose) {
-	case 0:
-		postfix = " >/dev/null 2>&1";
-		break;
-	case 1:
-		break;
-	case 2:
-		postfix = "-V";
-		break;
-	case 3:
-		postfix = "-V -V";
-		break;
-	default:
-		postfix = "-V -V -V";
-		break;
-	}
-
-	if (!section_name || !*section_name) {
-		dash_i = "";
-		section_name = "";
+	/* x86: the SMBIOS system version. */
+	fp = fopen(DMI_PRODUCT_VERSION, "r");
+	if (fp) {
+		if (fgets(buf, sizeof(buf), fp))
+			strip(buf, NULL);
+		fclose(fp);
+		if (*buf)
+			return strdup(buf);
 	}
 
-	switch (op) {
-	case FLASHROM_READ:
-		op_cmd = "-r";
-		assert(image_path);
-		break;
-
-	case FLASHROM_WRITE:
-		op_cmd = "-w";
-		assert(image_path);
-		break;
-
-	case FLASHROM_WP_STATUS:
-		op_cmd = "--wp-status";
-		assert(image_path == NULL);
-		image_path = "";
-		/* grep is needed because host_shell only returns 1 line. */
-		postfix = " 2>/dev/null | grep \"" \
-			   FLASHROM_OUTPUT_WP_PATTERN "\"";
-		break;
-
-	default:
-		assert(0);
-		return -1;
+	/* ARM with coreboot: the board ID, as a big endian integer. */
+	fp = fopen(DT_COREBOOT_BOARD_ID, "rb");
+	if (fp) {
+		if (fread(id, sizeof(id), 1, fp) == 1)
+			ASPRINTF(&version, "%s%u", STR_REV,
+				 (uint32_t)id[0] << 24 | id[1] << 16 |
+				 id[2] << 8 | id[3]);
+		fclose(fp);
+		if (version)
+			return version;
 	}
 
-	if (!extra)
-		extra = "";
-
-	/* TODO(hungte) In future we should link with flashrom directly. */
-	ASPRINTF(&command, "flashrom %s %s -p %s %s %s %s %s", op_cmd,
-		 image_path, programmer, dash_i, section_name, extra,
-		 postfix);
-
-	if (verbose)
-		INFO("Executing: %s\n", command);
+	return host_shell("mosys platform version");
+}
 
-	if (op != FLASHROM_WP_STATUS) {
-		r = system(command);
-		free(command);
-		if (r)
-			ERROR("Error code: %d\n", r);
-		return r;
-	}
+/* A help function to get $(mosys platform version). */
+static int host_get_platform_version(struct updater_config *cfg)
+{
+	char *result = host_read_platform_version();
+	int rev = -1;
 
-	result = host_shell(command);
-	strip(result, NULL);
-	free(command);
-	VB2_DEBUG("wp-status: %s\n", result);
+	/* Result should be 'revN' */
+	if (strncmp(result, STR_REV, strlen(STR_REV)) == 0)
+		rev = strtol(result + strlen(STR_REV), NULL, 0);
+	VB2_DEBUG("Raw data = [%s], parsed version is %d\n", result, rev);
 
-	if (strstr(result, FLASHROM_OUTPUT_WP_ENABLED))
-		r = WP_ENABLED;
-	else if (strstr(result, FLASHROM_OUTPUT_WP_DISABLED))
-		r = WP_DISABLED;
-	else
-		r = -1;
 	free(result);
-	return r;
+	return rev;
 }
 
 /* Helper function to return write protection status via given programmer. */
-static int host_get_wp(const char *programmer)
+static int host_get_wp(struct updater_config *cfg, const char *programmer)
 {
-	return host_flashrom(FLASHROM_WP_STATUS, NULL, programmer, 0, NULL,
-			     NULL);
+	return updater_flashrom_wp_status(cfg, programmer);
 }
 
 /* Helper function to return host software write protection status. */
-static int host_get_wp_sw(void)
+static int host_get_wp_sw(struct updater_config *cfg)
 {
-	return host_get_wp(PROG_HOST);
+	return host_get_wp(cfg, PROG_HOST);
 }
 
 /*
@@ -362,11 +433,51 @@ int get_system_property(enum system_property_type property_type,
 	prop = &cfg->system_properties[property_type];
 	if (!prop->initialized) {
 		prop->initialized = 1;
-		prop->value = prop->getter();
+		prop->value = prop->getter(cfg);
 	}
 	return prop->value;
 }
 
+/* A system property being fetched in the background. */
+struct property_prefetch {
+	struct updater_config *cfg;
+	enum system_property_type type;
+	pthread_t thread;
+	int started;
+};
+
+static void *prefetch_worker(void *arg)
+{
+	struct property_prefetch *prefetch = arg;
+
+	get_system_property(prefetch->type, prefetch->cfg);
+	return NULL;
+}
+
+/*
+ * Starts fetching a system property (for example from crossystem), so it is
+ * ready by the time the caller has done something else, like verifying keys.
+ * Until finish_prefetch(), the caller must not get the same property.
+ */
+static void start_prefetch(struct property_prefetch *prefetch,
+			   struct updater_config *cfg,
+			   enum system_property_type type)
+{
+	prefetch->cfg = cfg;
+	prefetch->type = type;
+	prefetch->started = !cfg->system_properties[type].initialized &&
+		!pthread_create(&prefetch->thread, NULL, prefetch_worker,
+				prefetch);
+}
+
+/* Waits for a property started by start_prefetch(). */
+static void finish_prefetch(struct property_prefetch *prefetch)
+{
+	if (prefetch->started)
+		pthread_join(prefetch->thread, NULL);
+	prefetch->started = 0;
+}
+
 static void print_system_properties(struct updater_config *cfg)
 {
 	int i;
@@ -501,10 +612,10 @@ static int setup_config_quirks(const char *quirks, struct updater_config *cfg)
 	 */
 	int r = 0;
 	char *buf = strdup(quirks);
-	char *token;
+	char *token, *saveptr;
 
-	token = strtok(buf, ", ");
-	for (; token; token = strtok(NULL, ", ")) {
+	token = strtok_r(buf, ", ", &saveptr);
+	for (; token; token = strtok_r(NULL, ", ", &saveptr)) {
 		const char *name = token;
 		char *equ = strchr(token, '=');
 		int i, value = 1;
@@ -611,26 +722,12 @@ static int load_firmware_version(struct firmware_image *image,
 }
 
 /*
- * Loads a firmware image from file.
- * If archive is provided and file_name is a relative path, read the file from
- * archive.
- * Returns 0 on success, otherwise failure.
+ * Finds the FMAP and versions of a firmware image, after its data is loaded.
+ * Returns 0 if success, non-zero if error.
  */
-int load_firmware_image(struct firmware_image *image, const char *file_name,
-			struct archive *archive)
+static int parse_firmware_image(struct firmware_image *image,
+				const char *file_name)
 {
-	VB2_DEBUG("Load image file from %s...\n", file_name);
-
-	if (!archive_has_entry(archive, file_name)) {
-		ERROR("Does not exist: %s\n", file_name);
-		return -1;
-	}
-	if (archive_read_file(archive, file_name, &image->data, &image->size) !=
-	    VB2_SUCCESS) {
-		ERROR("Failed to load %s\n", file_name);
-		return -1;
-	}
-
 	VB2_DEBUG("Image size: %d\n", image->size);
 	assert(image->data);
 	image->file_name = strdup(file_name);
@@ -662,6 +759,114 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 	return 0;
 }
 
+/*
+ * Loads a firmware image from file.
+ * If archive is provided and file_name is a relative path, read the file from
+ * archive.
+ * Files on a real file system are mapped copy-on-write instead of read, so
+ * sections are views into the page cache and only the pages we modify (for
+ * example by preserve_firmware_section) take up memory of their own.
+ * Returns 0 on success, otherwise failure.
+ */
+int load_firmware_image(struct firmware_image *image, const char *file_name,
+			struct archive *archive)
+{
+	VB2_DEBUG("Load image file from %s...\n", file_name);
+
+	if (!archive_has_entry(archive, file_name)) {
+		ERROR("Does not exist: %s\n", file_name);
+		return -1;
+	}
+	if (archive_map_file(archive, file_name, &image->data,
+			     &image->size) == 0) {
+		image->is_mapped = 1;
+	} else if (archive_read_file(archive, file_name, &image->data,
+				     &image->size) != VB2_SUCCESS) {
+		ERROR("Failed to load %s\n", file_name);
+		return -1;
+	}
+	return parse_firmware_image(image, file_name);
+}
+
+/*
+ * Maps a whole file, shared with the file, so changes to the data are
+ * changes to the file.  Must be released with munmap(*data, *size).
+ * Returns 0 if success, non-zero if error.
+ */
+static int map_file_shared(const char *file_name, uint8_t **data,
+			   uint32_t *size)
+{
+	struct stat st;
+	void *ptr = MAP_FAILED;
+	int fd;
+
+	fd = open(file_name, O_RDWR);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    st.st_size <= UINT32_MAX)
+		ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+	/* The mapping holds its own reference to the file. */
+	close(fd);
+	if (ptr == MAP_FAILED)
+		return -1;
+
+	*data = ptr;
+	*size = st.st_size;
+	return 0;
+}
+
+/*
+ * Loads a firmware image from a temp file, as a shared mapping of it, so
+ * the temp file always holds the image as it is (see data_file).
+ * file_name is the name to show for the image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int load_temp_firmware_image(struct firmware_image *image,
+				    const char *temp_file,
+				    const char *file_name)
+{
+	if (map_file_shared(temp_file, &image->data, &image->size)) {
+		ERROR("Failed to load %s\n", file_name);
+		return -1;
+	}
+	image->is_mapped = 1;
+	image->data_file = temp_file;
+	return parse_firmware_image(image, file_name);
+}
+
+/*
+ * Loads a firmware image for the updater to write.  Files that are not on
+ * a real file system (for example in a ZIP archive) are extracted straight
+ * into a temp file, in memory when possible, without another buffer; the
+ * image is then the temp file, which flashrom can use as it is.
+ * Returns 0 if success, non-zero if error.
+ */
+static int load_updater_image(struct updater_config *cfg,
+			      struct firmware_image *image,
+			      const char *file_name)
+{
+	struct archive *ar = cfg->archive;
+	const char *temp_file;
+
+	if (archive_is_mappable(ar, file_name))
+		return load_firmware_image(image, file_name, ar);
+
+	VB2_DEBUG("Extract image file from %s...\n", file_name);
+	if (!archive_has_entry(ar, file_name)) {
+		ERROR("Does not exist: %s\n", file_name);
+		return -1;
+	}
+	temp_file = updater_create_temp_file(cfg);
+	if (!temp_file || archive_extract_file(ar, file_name, temp_file)) {
+		/* Maybe there is still memory to read it into. */
+		return load_firmware_image(image, file_name, ar);
+	}
+	return load_temp_firmware_image(image, temp_file, file_name);
+}
+
+
 /*
  * Loads the active system firmware image (usually from SPI flash chip).
  * Returns 0 if success, non-zero if error.
@@ -670,12 +875,20 @@ int load_system_firmware(struct updater_config *cfg,
 			 struct firmware_image *image)
 {
 	const char *tmp_file = updater_create_temp_file(cfg);
+	uint8_t *data;
+	uint32_t size;
+	int written;
 
 	if (!tmp_file)
 		return -1;
-	RETURN_ON_FAILURE(host_flashrom(
-			FLASHROM_READ, tmp_file, image->programmer,
-			cfg->verbosity, NULL, NULL));
+	RETURN_ON_FAILURE(updater_flashrom_read(cfg, image->programmer,
+						&data, &size));
+	written = (vb2_write_file(tmp_file, data, size) == VB2_SUCCESS);
+	free(data);
+	if (!written) {
+		ERROR("Cannot write temporary file: %s\n", tmp_file);
+		return -1;
+	}
 	return load_firmware_image(image, tmp_file, NULL);
 }
 
@@ -690,15 +903,48 @@ void free_firmware_image(struct firmware_image *image)
 	 */
 	const char *programmer = image->programmer;
 
-	free(image->data);
+	if (image->is_mapped)
+		munmap(image->data, image->size);
+	else
+		free(image->data);
 	free(image->file_name);
 	free(image->ro_version);
 	free(image->rw_version_a);
 	free(image->rw_version_b);
+	updater_cbfs_forget(image);
+	updater_vpd_forget(image);
 	memset(image, 0, sizeof(*image));
 	image->programmer = programmer;
 }
 
+/*
+ * Replaces the mapping of a loaded image with a copy in memory. Emulated
+ * writes change the emulation file in place, and the unchanged pages of a
+ * private mapping of it would change with them.
+ * Returns 0 if success, non-zero if error.
+ */
+static int unmap_firmware_image(struct firmware_image *image)
+{
+	uint8_t *data;
+
+	if (!image->is_mapped)
+		return 0;
+	data = malloc(image->size);
+	if (!data)
+		return -1;
+	memcpy(data, image->data, image->size);
+	if (image->fmap_header)
+		image->fmap_header = (FmapHeader *)(data +
+			((uint8_t *)image->fmap_header - image->data));
+	updater_cbfs_forget(image);
+	updater_vpd_forget(image);
+	munmap(image->data, image->size);
+	image->data = data;
+	image->is_mapped = 0;
+	image->data_file = NULL;
+	return 0;
+}
+
 /*
  * Decides which target in RW firmware to manipulate.
  * The `target` argument specifies if we want to know "the section to be
@@ -753,17 +999,17 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 		return -1;
 	}
 
-	if (cfg->emulation) {
-		INFO("(emulation) Setting try_next to %s, try_count to %d.\n",
-		     slot, tries);
+	if (cfg->emulation || cfg->dry_run) {
+		INFO("(%s) Setting try_next to %s, try_count to %d.\n",
+		     cfg->emulation ? "emulation" : "dry run", slot, tries);
 		return 0;
 	}
 
-	if (is_vboot2 && VbSetSystemPropertyString("fw_try_next", slot)) {
+	if (is_vboot2 && crossystem_set_string("fw_try_next", slot)) {
 		ERROR("Failed to set fw_try_next to %s.\n", slot);
 		return -1;
 	}
-	if (VbSetSystemPropertyInt("fw_try_count", tries)) {
+	if (crossystem_set_int("fw_try_count", tries)) {
 		ERROR("Failed to set fw_try_count to %d.\n", tries);
 		return -1;
 	}
@@ -771,26 +1017,132 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 }
 
 /*
- * Emulates writing to firmware.
+ * Writes data to a file by writing a new file and renaming it over the old
+ * one.  Truncating a file in place would break any image still mapped from
+ * it (see load_firmware_image), while renaming leaves such mappings on the
+ * old copy.
+ * Returns 0 on success, otherwise failure.
+ */
+static int write_image_file(const char *file_name, const uint8_t *data,
+			    uint32_t size)
+{
+	char *temp_name;
+	struct stat st;
+	mode_t mode;
+	int fd, r = 0;
+
+	if (stat(file_name, &st) == 0) {
+		mode = st.st_mode & 07777;
+	} else {
+		mode = umask(0);
+		umask(mode);
+		mode = 0666 & ~mode;
+	}
+
+	ASPRINTF(&temp_name, "%s.XXXXXX", file_name);
+	fd = mkstemp(temp_name);
+	if (fd < 0) {
+		free(temp_name);
+		/* Probably no write access to the folder; try the file. */
+		return vb2_write_file(file_name, data, size) != VB2_SUCCESS;
+	}
+	if (fchmod(fd, mode) != 0)
+		r = -1;
+	while (!r && size) {
+		ssize_t n = write(fd, data, size);
+		if (n <= 0) {
+			r = -1;
+			break;
+		}
+		data += n;
+		size -= n;
+	}
+	if (close(fd) != 0)
+		r = -1;
+	if (!r && rename(temp_name, file_name) != 0)
+		r = -1;
+	if (r)
+		unlink(temp_name);
+	free(temp_name);
+	return r;
+}
+
+/*
+ * Maps the emulation file, so emulated writes change it in place instead of
+ * rewriting the whole file each time. The mapping is shared with the file,
+ * and synced once by finish_emulation().
  * Returns 0 if success, non-zero if error.
  */
-static int emulate_write_firmware(const char *filename,
+static int map_emulation(struct updater_config *cfg)
+{
+	if (cfg->emulation_data)
+		return 0;
+	return map_file_shared(cfg->emulation, &cfg->emulation_data,
+			       &cfg->emulation_size);
+}
+
+/*
+ * Writes back and unmaps the emulation file, if emulated writes mapped it.
+ * Returns 0 if success, non-zero if error.
+ */
+static int finish_emulation(struct updater_config *cfg)
+{
+	int r = 0;
+
+	if (!cfg->emulation_data)
+		return 0;
+	if (msync(cfg->emulation_data, cfg->emulation_size, MS_SYNC)) {
+		ERROR("Failed writing to file: %s\n", cfg->emulation);
+		r = -1;
+	}
+	munmap(cfg->emulation_data, cfg->emulation_size);
+	cfg->emulation_data = NULL;
+	cfg->emulation_size = 0;
+	return r;
+}
+
+/*
+ * Emulates writing to firmware, on the mapped emulation file.
+ * Returns 0 if success, non-zero if error.
+ */
+static int emulate_write_firmware(struct updater_config *cfg,
 				  const struct firmware_image *image,
-				  const char *section_name)
+				  const char *section_name,
+				  const struct flash_range *ranges,
+				  int num_ranges)
 {
+	const char *filename = cfg->emulation;
 	struct firmware_image to_image = {0};
 	struct firmware_section from, to;
 	int errorcnt = 0;
+	int i;
 
 	from.data = image->data;
 	from.size = image->size;
 
-	if (load_firmware_image(&to_image, filename, NULL)) {
+	if (map_emulation(cfg)) {
 		ERROR("Cannot load image from %s.\n", filename);
 		return -1;
 	}
+	to_image.data = cfg->emulation_data;
+	to_image.size = cfg->emulation_size;
+	/* Writing a whole image may have moved the FMAP. */
+	to_image.fmap_header = fmap_find(to_image.data, to_image.size);
 
-	if (section_name) {
+	if (num_ranges) {
+		if (image->size != to_image.size) {
+			ERROR("Image size is different (%s:%d != %s:%d)\n",
+			      image->file_name, image->size,
+			      filename, to_image.size);
+			errorcnt++;
+		}
+		for (i = 0; !errorcnt && i < num_ranges; i++) {
+			VB2_DEBUG("Writing %u bytes at %#x\n",
+				  ranges[i].size, ranges[i].offset);
+			memcpy(to_image.data + ranges[i].offset,
+			       image->data + ranges[i].offset, ranges[i].size);
+		}
+	} else if (section_name) {
 		find_firmware_section(&from, image, section_name);
 		if (!from.data) {
 			ERROR("No section %s in source image %s.\n",
@@ -805,7 +1157,7 @@ static int emulate_write_firmware(const char *filename,
 		}
 	} else if (image->size != to_image.size) {
 		ERROR("Image size is different (%s:%d != %s:%d)\n",
-		      image->file_name, image->size, to_image.file_name,
+		      image->file_name, image->size, filename,
 		      to_image.size);
 		errorcnt++;
 	} else {
@@ -813,68 +1165,132 @@ static int emulate_write_firmware(const char *filename,
 		to.size = to_image.size;
 	}
 
-	if (!errorcnt) {
+	if (!errorcnt && !num_ranges) {
 		size_t to_write = Min(to.size, from.size);
 
 		assert(from.data && to.data);
 		VB2_DEBUG("Writing %zu bytes\n", to_write);
 		memcpy(to.data, from.data, to_write);
 	}
+	return errorcnt;
+}
 
-	if (!errorcnt && vb2_write_file(
-			filename, to_image.data, to_image.size)) {
-		ERROR("Failed writing to file: %s\n", filename);
-		errorcnt++;
-	}
+/*
+ * Finds the erase blocks in [offset, offset + size) that differ between the
+ * current and new contents, merging adjacent blocks into one range.  Ranges
+ * are clipped to the given area.
+ * Returns the number of ranges, or -1 if there would be more than max_ranges.
+ */
+static int find_changed_ranges(const uint8_t *current, const uint8_t *data,
+			       uint32_t offset, uint32_t size,
+			       struct flash_range *ranges, int max_ranges)
+{
+	uint32_t end = offset + size, start, next;
+	int num_ranges = 0;
+
+	for (start = offset; start < end; start = next) {
+		next = (start / FLASH_ERASE_BLOCK_SIZE + 1) *
+			FLASH_ERASE_BLOCK_SIZE;
+		if (next > end)
+			next = end;
+		if (!memcmp(current + start, data + start, next - start))
+			continue;
 
-	free_firmware_image(&to_image);
-	return errorcnt;
+		if (num_ranges && ranges[num_ranges - 1].offset +
+		    ranges[num_ranges - 1].size == start) {
+			ranges[num_ranges - 1].size += next - start;
+			continue;
+		}
+		if (num_ranges == max_ranges)
+			return -1;
+		ranges[num_ranges].offset = start;
+		ranges[num_ranges].size = next - start;
+		num_ranges++;
+	}
+	return num_ranges;
 }
 
 /*
  * Writes a section from given firmware image to system firmware.
  * If section_name is NULL, write whole image.
+ * When the current contents of the AP firmware are known, only the erase
+ * blocks that changed are written.
  * Returns 0 if success, non-zero if error.
  */
 static int write_firmware(struct updater_config *cfg,
 			  const struct firmware_image *image,
 			  const char *section_name)
 {
-	const char *tmp_file = updater_create_temp_file(cfg);
-	const char *tmp_diff_file = NULL;
 	const char *programmer = image->programmer;
-	char *extra = NULL;
-	int r;
+	const char *name = section_name ? section_name : "whole image";
+	struct firmware_image *current = &cfg->image_current;
+	struct flash_range ranges[FLASH_MAX_WRITE_RANGES];
+	const uint8_t *diff = NULL;
+	uint32_t offset = 0, size = image->size, changed = 0;
+	int num_ranges = -1;
+	int i, r;
 
-	if (!tmp_file)
-		return -1;
+	if (section_name) {
+		struct firmware_section section;
 
-	if (cfg->emulation) {
-		INFO("(emulation) Writing %s from %s to %s (emu=%s).\n",
-		     section_name ? section_name : "whole image",
-		     image->file_name, programmer, cfg->emulation);
+		find_firmware_section(&section, image, section_name);
+		if (!section.data) {
+			ERROR("No section %s in image %s.\n", section_name,
+			      image->file_name);
+			return -1;
+		}
+		offset = section.data - image->data;
+		size = section.size;
+	}
 
-		return emulate_write_firmware(
-				cfg->emulation, image, section_name);
+	/* --force means not to trust the current contents. */
+	if (image == &cfg->image && !cfg->force_update && current->data &&
+	    current->size == image->size) {
+		num_ranges = find_changed_ranges(current->data, image->data,
+						 offset, size, ranges,
+						 ARRAY_SIZE(ranges));
+		if (cfg->fast_update)
+			diff = current->data;
+	}
 
+	if (num_ranges >= 0) {
+		for (i = 0; i < num_ranges; i++)
+			changed += ranges[i].size;
+		INFO("%s: %u of %u bytes changed, in %d range(s).\n", name,
+		     changed, size, num_ranges);
+	} else {
+		changed = size;
 	}
-	if (vb2_write_file(tmp_file, image->data, image->size) != VB2_SUCCESS) {
-		ERROR("Cannot write temporary file for output: %s\n", tmp_file);
-		return -1;
+
+	if (cfg->dry_run) {
+		STATUS("(dry run) Would write %u bytes of %s from %s to %s.\n",
+		       changed, name, image->file_name, programmer);
+		return 0;
 	}
-	if (cfg->fast_update && image == &cfg->image && cfg->image_current.data)
-	{
-		tmp_diff_file = updater_create_temp_file(cfg);
-		if (vb2_write_file(tmp_diff_file, cfg->image_current.data,
-				   cfg->image_current.size) != VB2_SUCCESS) {
-			ERROR("Cannot write temporary file for diff image\n");
-			return -1;
-		}
-		ASPRINTF(&extra, "--noverify --diff=%s", tmp_diff_file);
+	if (num_ranges == 0) {
+		INFO("No changes in %s, skip writing.\n", name);
+		return 0;
+	}
+
+	if (cfg->emulation) {
+		INFO("(emulation) Writing %s from %s to %s (emu=%s).\n",
+		     name, image->file_name, programmer, cfg->emulation);
+
+		r = emulate_write_firmware(cfg, image, section_name, ranges,
+					   num_ranges > 0 ? num_ranges : 0);
+	} else if (num_ranges > 0) {
+		r = updater_flashrom_write_ranges(cfg, programmer, image->data,
+						  image->size, ranges,
+						  num_ranges, diff);
+	} else {
+		r = updater_flashrom_write(cfg, programmer, image->data,
+					   image->size, section_name, diff);
 	}
-	r = host_flashrom(FLASHROM_WRITE, tmp_file, programmer,
-			  cfg->verbosity + 1, section_name, extra);
-	free(extra);
+
+	/* Keep the current image in sync, for any later writes. */
+	if (!r && image == &cfg->image && current->data &&
+	    current->size == image->size)
+		memcpy(current->data + offset, image->data + offset, size);
 	return r;
 }
 
@@ -905,7 +1321,7 @@ static int write_optional_firmware(struct updater_config *cfg,
 	 */
 	if (check_programmer_wp &&
 	    get_system_property(SYS_PROP_WP_HW, cfg) == WP_ENABLED &&
-	    host_get_wp(image->programmer) == WP_ENABLED) {
+	    host_get_wp(cfg, image->programmer) == WP_ENABLED) {
 		ERROR("Target %s is write protected, skip updating.\n",
 		      image->programmer);
 		return 0;
@@ -914,6 +1330,76 @@ static int write_optional_firmware(struct updater_config *cfg,
 	return write_firmware(cfg, image, section_name);
 }
 
+/*
+ * Writes the EC and PD images, if there are any. The PD is reached through
+ * the EC, so they are written one after the other.
+ * Returns NULL if success, otherwise the programmer that failed.
+ */
+static const char *write_ec_pd_firmware(struct updater_config *cfg)
+{
+	if (write_optional_firmware(cfg, &cfg->ec_image, NULL, 1))
+		return cfg->ec_image.programmer;
+	if (write_optional_firmware(cfg, &cfg->pd_image, NULL, 1))
+		return cfg->pd_image.programmer;
+	return NULL;
+}
+
+/* EC and PD images being written in the background. */
+struct ec_pd_write {
+	struct updater_config *cfg;
+	pthread_t thread;
+	int started;
+	const char *failed;
+};
+
+static void *ec_pd_write_worker(void *arg)
+{
+	struct ec_pd_write *job = arg;
+
+	job->failed = write_ec_pd_firmware(job->cfg);
+	return NULL;
+}
+
+/*
+ * Starts writing the EC and PD images, so they are written while the caller
+ * writes the host image; they are on different buses. Emulation and dry runs
+ * are left to finish_ec_pd_write(): emulated writes all go to one file.
+ * Until finish_ec_pd_write(), the caller must not write the EC or PD, or get
+ * any system property.
+ */
+static void start_ec_pd_write(struct ec_pd_write *job,
+			      struct updater_config *cfg)
+{
+	job->cfg = cfg;
+	job->failed = NULL;
+	job->started = 0;
+	if (cfg->emulation || cfg->dry_run ||
+	    (!cfg->ec_image.data && !cfg->pd_image.data))
+		return;
+
+	/* Get properties the writes need here, not in both threads. */
+	get_system_property(SYS_PROP_WP_HW, cfg);
+	job->started = !pthread_create(&job->thread, NULL, ec_pd_write_worker,
+				       job);
+}
+
+/*
+ * Finishes writing the EC and PD images. If the writes didn't start in the
+ * background, does them now unless write_now is zero (for example because
+ * writing the host image failed).
+ * Returns NULL if success, otherwise the programmer that failed.
+ */
+static const char *finish_ec_pd_write(struct ec_pd_write *job, int write_now)
+{
+	if (job->started) {
+		pthread_join(job->thread, NULL);
+		job->started = 0;
+	} else if (write_now) {
+		job->failed = write_ec_pd_firmware(job->cfg);
+	}
+	return job->failed;
+}
+
 /*
  * Preserves (copies) the given section (by name) from image_from to image_to.
  * The offset may be different, and the section data will be directly copied.
@@ -927,6 +1413,7 @@ int preserve_firmware_section(const struct firmware_image *image_from,
 			      const char *section_name)
 {
 	struct firmware_section from, to;
+	size_t offset, size, block;
 
 	find_firmware_section(&from, image_from, section_name);
 	find_firmware_section(&to, image_to, section_name);
@@ -939,8 +1426,24 @@ int preserve_firmware_section(const struct firmware_image *image_from,
 		WARN("Section %.*s is truncated after updated.\n",
 		     FMAP_NAMELEN, section_name);
 	}
-	/* Use memmove in case if we need to deal with sections that overlap. */
-	memmove(to.data, from.data, Min(from.size, to.size));
+	/* The section may have held CBFS files or VPD. */
+	updater_cbfs_forget(image_to);
+	updater_vpd_forget(image_to);
+	if (image_from == image_to) {
+		/* Use memmove in case we need to deal with overlap. */
+		memmove(to.data, from.data, Min(from.size, to.size));
+		return 0;
+	}
+	/*
+	 * Only copy blocks that differ, so unchanged pages of a mapped image
+	 * stay shared with the page cache.
+	 */
+	for (offset = 0, size = Min(from.size, to.size); size;
+	     offset += block, size -= block) {
+		block = size < PRESERVE_BLOCK_SIZE ? size : PRESERVE_BLOCK_SIZE;
+		if (memcmp(to.data + offset, from.data + offset, block))
+			memcpy(to.data + offset, from.data + offset, block);
+	}
 	return 0;
 }
 
@@ -1229,6 +1732,50 @@ static struct vb2_keyblock *dupe_keyblock(const struct vb2_keyblock *block)
 	return new_block;
 }
 
+/*
+ * The last keyblock and key checked by verify_keyblock(), and the result.
+ * Updates usually check the same VBLOCK_A against the same root key more
+ * than once (the target's own and the current system's), and this saves
+ * repeating the RSA verification.
+ */
+static struct {
+	uint8_t *block, *key;
+	uint32_t block_size, key_size;
+	int result;
+} last_verified;
+
+static int is_last_verified(const struct vb2_keyblock *block,
+			    const struct vb2_packed_key *sign_key,
+			    uint32_t key_size)
+{
+	return last_verified.block &&
+		last_verified.block_size == block->keyblock_size &&
+		last_verified.key_size == key_size &&
+		!memcmp(last_verified.block, block, block->keyblock_size) &&
+		!memcmp(last_verified.key, sign_key, key_size);
+}
+
+static void save_last_verified(const struct vb2_keyblock *block,
+			       const struct vb2_packed_key *sign_key,
+			       uint32_t key_size, int result)
+{
+	free(last_verified.block);
+	free(last_verified.key);
+	last_verified.block = malloc(block->keyblock_size);
+	last_verified.key = malloc(key_size);
+	if (!last_verified.block || !last_verified.key) {
+		free(last_verified.block);
+		free(last_verified.key);
+		last_verified.block = last_verified.key = NULL;
+		return;
+	}
+	memcpy(last_verified.block, block, block->keyblock_size);
+	memcpy(last_verified.key, sign_key, key_size);
+	last_verified.block_size = block->keyblock_size;
+	last_verified.key_size = key_size;
+	last_verified.result = result;
+}
+
 /*
  * Verifies if keyblock is signed with given key.
  * Returns 0 on success, otherwise failure.
@@ -1240,11 +1787,17 @@ static int verify_keyblock(const struct vb2_keyblock *block,
 	struct vb2_workbuf wb;
 	struct vb2_public_key key;
 	struct vb2_keyblock *new_block;
+	uint32_t key_size = sign_key->key_offset + sign_key->key_size;
 
 	if (block->keyblock_signature.sig_size == 0) {
 		ERROR("Keyblock is not signed.\n");
 		return -1;
 	}
+	if (is_last_verified(block, sign_key, key_size)) {
+		VB2_DEBUG("Same keyblock and key as last time.\n");
+		r = last_verified.result;
+		goto done;
+	}
 	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 	if (VB2_SUCCESS != vb2_unpack_key(&key, sign_key)) {
 		ERROR("Invalid signing key.\n");
@@ -1258,7 +1811,9 @@ static int verify_keyblock(const struct vb2_keyblock *block,
 	new_block = dupe_keyblock(block);
 	r = vb2_verify_keyblock(new_block, new_block->keyblock_size, &key, &wb);
 	free(new_block);
+	save_last_verified(block, sign_key, key_size, r);
 
+done:
 	if (r != VB2_SUCCESS) {
 		ERROR("Failed verifying key block.\n");
 		return -1;
@@ -1353,24 +1908,8 @@ static enum rootkey_compat_result check_compatible_root_key(
 	return ROOTKEY_COMPAT_OK;
 }
 
-/*
- * Returns 1 if a given file (cbfs_entry_name) exists inside a particular CBFS
- * section of an image file, otherwise 0.
- */
-static int cbfs_file_exists(const char *image_file,
-			    const char *section_name,
-			    const char *cbfs_entry_name)
-{
-	char *cmd;
-	int r;
-
-	ASPRINTF(&cmd,
-		 "cbfstool '%s' print -r %s 2>/dev/null | grep -q '^%s '",
-		 image_file, section_name, cbfs_entry_name);
-	r = system(cmd);
-	free(cmd);
-	return !r;
-}
+/* RW_LEGACY is only updated if both images have this file in its CBFS. */
+#define LEGACY_UPDATE_TAG "cros_allow_auto_update"
 
 /*
  * Returns non-zero if the RW_LEGACY needs to be updated, otherwise 0.
@@ -1378,19 +1917,12 @@ static int cbfs_file_exists(const char *image_file,
 static int legacy_needs_update(struct updater_config *cfg)
 {
 	int has_from, has_to;
-	const char * const tag = "cros_allow_auto_update";
+	const char * const tag = LEGACY_UPDATE_TAG;
 	const char *section = FMAP_RW_LEGACY;
-	const char *tmp_path = updater_create_temp_file(cfg);
 
 	VB2_DEBUG("Checking %s contents...\n", FMAP_RW_LEGACY);
-	if (!tmp_path ||
-	    vb2_write_file(tmp_path, cfg->image.data, cfg->image.size)) {
-		ERROR("Failed to create temporary file for image contents.\n");
-		return 0;
-	}
-
-	has_to = cbfs_file_exists(tmp_path, section, tag);
-	has_from = cbfs_file_exists(tmp_path, section, tag);
+	has_to = !!updater_cbfs_find(&cfg->image, section, tag);
+	has_from = !!updater_cbfs_find(&cfg->image_current, section, tag);
 
 	if (!has_from || !has_to) {
 		VB2_DEBUG("Current legacy firmware has%s updater tag (%s) and "
@@ -1464,6 +1996,235 @@ static int check_compatible_tpm_keys(struct updater_config *cfg,
 	return 0;
 }
 
+/*
+ * With --flash_cache, a try-RW update that found nothing to do records
+ * hashes of the flash sections that decided it. When the next run has the
+ * same target image, active slot and write protection, and those sections
+ * still match, it stops without reading the rest of the flash.
+ */
+struct flash_cache_entry {
+	char name[FMAP_NAMELEN + 1];
+	struct flash_range range;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+};
+
+/* Sections checked by --flash_cache, when they exist in the target image. */
+static const char * const flash_cache_sections[] = {
+	"FMAP", "GBB", "RO_FRID", "VBLOCK_A", "VBLOCK_B",
+	"RW_FWID_A", "RW_FWID_B", "RW_FWID",
+};
+
+/* Room for flash_cache_sections and RW_LEGACY. */
+#define FLASH_CACHE_MAX_ENTRIES (ARRAY_SIZE(flash_cache_sections) + 1)
+
+/*
+ * Finds the sections of the target image that --flash_cache checks.
+ * Returns the number of entries filled in.
+ */
+static int get_flash_cache_entries(struct updater_config *cfg,
+				   struct flash_cache_entry *entries)
+{
+	struct firmware_section section;
+	int i, count = 0;
+
+	for (i = 0; i <= ARRAY_SIZE(flash_cache_sections); i++) {
+		const char *name;
+
+		if (i < ARRAY_SIZE(flash_cache_sections))
+			name = flash_cache_sections[i];
+		else if (updater_cbfs_find(&cfg->image, FMAP_RW_LEGACY,
+					   LEGACY_UPDATE_TAG))
+			/* legacy_needs_update() compares all of it. */
+			name = FMAP_RW_LEGACY;
+		else
+			break;
+
+		find_firmware_section(&section, &cfg->image, name);
+		if (!section.data)
+			continue;
+		memset(&entries[count], 0, sizeof(entries[count]));
+		strncpy(entries[count].name, name, FMAP_NAMELEN);
+		entries[count].range.offset = section.data - cfg->image.data;
+		entries[count].range.size = section.size;
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Computes the digest of each entry's range in data.
+ * Returns 0 on success, or -1 if a range is outside of data.
+ */
+static int digest_flash_cache_entries(struct flash_cache_entry *entries,
+				      int count, const uint8_t *data,
+				      uint32_t size, int compare)
+{
+	uint8_t digests[FLASH_CACHE_MAX_ENTRIES][VB2_SHA256_DIGEST_SIZE];
+	const uint8_t *bufs[FLASH_CACHE_MAX_ENTRIES];
+	uint32_t sizes[FLASH_CACHE_MAX_ENTRIES];
+	uint8_t *outs[FLASH_CACHE_MAX_ENTRIES];
+	int i;
+
+	if (count > FLASH_CACHE_MAX_ENTRIES)
+		return -1;
+	for (i = 0; i < count; i++) {
+		const struct flash_range *range = &entries[i].range;
+
+		if (range->offset > size || range->size > size - range->offset)
+			return -1;
+		bufs[i] = data + range->offset;
+		sizes[i] = range->size;
+		outs[i] = compare ? digests[i] : entries[i].digest;
+	}
+
+	/* The sections are independent, so they're hashed side by side */
+	if (vb2_digest_buffers(count, bufs, sizes, VB2_HASH_SHA256, outs,
+			       VB2_SHA256_DIGEST_SIZE))
+		return -1;
+
+	for (i = 0; compare && i < count; i++) {
+		if (memcmp(entries[i].digest, digests[i],
+			   VB2_SHA256_DIGEST_SIZE)) {
+			VB2_DEBUG("Section %s has changed.\n", entries[i].name);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void print_digest(FILE *fp, const uint8_t *digest)
+{
+	int i;
+
+	for (i = 0; i < VB2_SHA256_DIGEST_SIZE; i++)
+		fprintf(fp, "%02x", digest[i]);
+}
+
+/* Returns 0 if hex is exactly one digest, otherwise -1. */
+static int parse_digest(const char *hex, uint8_t *digest)
+{
+	int i;
+
+	if (strlen(hex) != VB2_SHA256_DIGEST_SIZE * 2)
+		return -1;
+	for (i = 0; i < VB2_SHA256_DIGEST_SIZE; i++) {
+		unsigned int byte;
+
+		if (!isxdigit(hex[2 * i]) || !isxdigit(hex[2 * i + 1]) ||
+		    sscanf(hex + 2 * i, "%2x", &byte) != 1)
+			return -1;
+		digest[i] = byte;
+	}
+	return 0;
+}
+
+/*
+ * Records that the current system firmware needs no try-RW update to the
+ * target image.
+ */
+static void save_flash_cache(struct updater_config *cfg, int wp_enabled)
+{
+	struct flash_cache_entry entries[FLASH_CACHE_MAX_ENTRIES];
+	const struct firmware_image *image = &cfg->image_current;
+	int count = get_flash_cache_entries(cfg, entries);
+	FILE *fp;
+	int i;
+
+	if (digest_flash_cache_entries(entries, count, image->data,
+				       image->size, 0)) {
+		VB2_DEBUG("Target layout doesn't fit current firmware.\n");
+		return;
+	}
+
+	fp = fopen(cfg->flash_cache, "w");
+	if (!fp) {
+		WARN("Cannot write flash cache: %s\n", cfg->flash_cache);
+		return;
+	}
+	fprintf(fp, "image ");
+	print_digest(fp, cfg->image_digest);
+	fprintf(fp, "\nmainfw_act %d\nwp %d\n",
+		get_system_property(SYS_PROP_MAINFW_ACT, cfg), wp_enabled);
+	for (i = 0; i < count; i++) {
+		fprintf(fp, "section %s %#x %#x ", entries[i].name,
+			entries[i].range.offset, entries[i].range.size);
+		print_digest(fp, entries[i].digest);
+		fprintf(fp, "\n");
+	}
+	if (fclose(fp))
+		WARN("Cannot write flash cache: %s\n", cfg->flash_cache);
+}
+
+/*
+ * Checks if the flash cache says the system needs no try-RW update to the
+ * target image, reading only the sections it lists from flash.
+ * Returns 1 if so, otherwise 0.
+ */
+static int flash_cache_matches(struct updater_config *cfg)
+{
+	struct flash_cache_entry entries[FLASH_CACHE_MAX_ENTRIES];
+	struct flash_range ranges[FLASH_CACHE_MAX_ENTRIES];
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	char line[256], name[FMAP_NAMELEN + 1], hex[80];
+	int mainfw_act = -1, wp = -1, count = 0, has_image = 0, r;
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FILE *fp;
+
+	fp = fopen(cfg->flash_cache, "r");
+	if (!fp)
+		return 0;
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned int offset, length;
+
+		if (sscanf(line, "image %79s", hex) == 1) {
+			has_image = !parse_digest(hex, digest) &&
+				!memcmp(digest, cfg->image_digest,
+					sizeof(digest));
+		} else if (sscanf(line, "mainfw_act %d", &mainfw_act) == 1 ||
+			   sscanf(line, "wp %d", &wp) == 1) {
+			continue;
+		} else if (sscanf(line, "section %32s %x %x %79s", name,
+				  &offset, &length, hex) == 4 &&
+			   count < FLASH_CACHE_MAX_ENTRIES &&
+			   !parse_digest(hex, entries[count].digest)) {
+			strcpy(entries[count].name, name);
+			entries[count].range.offset = offset;
+			entries[count].range.size = length;
+			ranges[count] = entries[count].range;
+			count++;
+		} else {
+			has_image = 0;
+			break;
+		}
+	}
+	fclose(fp);
+
+	if (!has_image || !count ||
+	    mainfw_act != get_system_property(SYS_PROP_MAINFW_ACT, cfg) ||
+	    wp != is_write_protection_enabled(cfg)) {
+		VB2_DEBUG("Flash cache %s is for another update.\n",
+			  cfg->flash_cache);
+		return 0;
+	}
+
+	if (cfg->emulation) {
+		if (!cfg->image_current.data)
+			return 0;
+		data = cfg->image_current.data;
+		size = cfg->image_current.size;
+	} else if (updater_flashrom_read_ranges(cfg,
+						cfg->image_current.programmer,
+						ranges, count, &data, &size)) {
+		return 0;
+	}
+
+	r = !digest_flash_cache_entries(entries, count, data, size, 1);
+	if (!cfg->emulation)
+		free(data);
+	return r;
+}
+
 const char * const updater_error_messages[] = {
 	[UPDATE_ERR_DONE] = "Done (no error)",
 	[UPDATE_ERR_NEED_RO_UPDATE] = "RO changed and no WP. Need full update.",
@@ -1495,6 +2256,8 @@ static enum updater_error_codes update_try_rw_firmware(
 	const char *target;
 	int has_update = 1;
 	int is_vboot2 = get_system_property(SYS_PROP_FW_VBOOT2, cfg);
+	struct property_prefetch tpm_fwver;
+	enum rootkey_compat_result rootkey_compat;
 
 	preserve_gbb(image_from, image_to, 1);
 	if (!wp_enabled && section_needs_update(
@@ -1502,7 +2265,10 @@ static enum updater_error_codes update_try_rw_firmware(
 		return UPDATE_ERR_NEED_RO_UPDATE;
 
 	INFO("Checking compatibility...\n");
-	if (check_compatible_root_key(image_from, image_to))
+	start_prefetch(&tpm_fwver, cfg, SYS_PROP_TPM_FWVER);
+	rootkey_compat = check_compatible_root_key(image_from, image_to);
+	finish_prefetch(&tpm_fwver);
+	if (rootkey_compat)
 		return UPDATE_ERR_ROOT_KEY;
 	if (check_compatible_tpm_keys(cfg, image_to))
 		return UPDATE_ERR_TPM_ROLLBACK;
@@ -1534,8 +2300,8 @@ static enum updater_error_codes update_try_rw_firmware(
 			return UPDATE_ERR_SET_COOKIES;
 	} else {
 		/* Clear trial cookies for vboot1. */
-		if (!is_vboot2 && !cfg->emulation)
-			VbSetSystemPropertyInt("fwb_tries", 0);
+		if (!is_vboot2 && !cfg->emulation && !cfg->dry_run)
+			crossystem_set_int("fwb_tries", 0);
 	}
 
 	/* Do not fail on updating legacy. */
@@ -1545,8 +2311,11 @@ static enum updater_error_codes update_try_rw_firmware(
 		write_firmware(cfg, image_to, FMAP_RW_LEGACY);
 	}
 
-	if (!has_update)
+	if (!has_update) {
 		STATUS("NO UPDATE: No need to update.\n");
+		if (cfg->flash_cache && !cfg->dry_run)
+			save_flash_cache(cfg, wp_enabled);
+	}
 
 	return UPDATE_ERR_DONE;
 }
@@ -1561,12 +2330,18 @@ static enum updater_error_codes update_rw_firmware(
 		struct firmware_image *image_from,
 		struct firmware_image *image_to)
 {
+	struct property_prefetch tpm_fwver;
+	enum rootkey_compat_result rootkey_compat;
+
 	STATUS("RW UPDATE: Updating RW sections (%s, %s, %s, and %s).\n",
 	       FMAP_RW_SECTION_A, FMAP_RW_SECTION_B, FMAP_RW_SHARED,
 	       FMAP_RW_LEGACY);
 
 	INFO("Checking compatibility...\n");
-	if (check_compatible_root_key(image_from, image_to))
+	start_prefetch(&tpm_fwver, cfg, SYS_PROP_TPM_FWVER);
+	rootkey_compat = check_compatible_root_key(image_from, image_to);
+	finish_prefetch(&tpm_fwver);
+	if (rootkey_compat)
 		return UPDATE_ERR_ROOT_KEY;
 	if (check_compatible_tpm_keys(cfg, image_to))
 		return UPDATE_ERR_TPM_ROLLBACK;
@@ -1600,6 +2375,42 @@ static enum updater_error_codes update_legacy_firmware(
 	return UPDATE_ERR_DONE;
 }
 
+/*
+ * Checks if the target image of a full update is signed by its own root key,
+ * and that it doesn't re-key the system to DEV keys.
+ * Returns 0 if the target can be used, otherwise failure.
+ */
+static int check_full_update_root_keys(struct updater_config *cfg,
+				       struct firmware_image *image_to)
+{
+	/* Check if the image_to itself is broken */
+	enum rootkey_compat_result r = check_compatible_root_key(
+			image_to, image_to);
+	if (r != ROOTKEY_COMPAT_OK) {
+		ERROR("Target image does not look valid. \n"
+		      "Add --force if you really want to use it.");
+		return -1;
+	}
+
+	/* Check if the system is going to re-key. */
+	r = check_compatible_root_key(&cfg->image_current, image_to);
+	/* We only allow re-key to non-dev keys. */
+	switch (r) {
+	case ROOTKEY_COMPAT_OK:
+		break;
+	case ROOTKEY_COMPAT_REKEY:
+		INFO("Will change firmware signing key.\n");
+		break;
+	case ROOTKEY_COMPAT_REKEY_TO_DEV:
+		ERROR("Re-key to DEV is not allowed. \n"
+		      "Add --force if you really want to do that.");
+		return -1;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
 /*
  * The main updater for "Full update".
  * This was also known as "--mode=factory" or "--mode=recovery, --wp=0" in
@@ -1610,6 +2421,10 @@ static enum updater_error_codes update_whole_firmware(
 		struct updater_config *cfg,
 		struct firmware_image *image_to)
 {
+	struct ec_pd_write ec_pd;
+	const char *ec_pd_failed;
+	int host_failed;
+
 	STATUS("FULL UPDATE: Updating whole firmware image(s), RO+RW.\n");
 
 	if (preserve_images(cfg))
@@ -1617,39 +2432,28 @@ static enum updater_error_codes update_whole_firmware(
 
 	INFO("Checking compatibility...\n");
 	if (!cfg->force_update) {
-		/* Check if the image_to itself is broken */
-		enum rootkey_compat_result r = check_compatible_root_key(
-				image_to, image_to);
-		if (r != ROOTKEY_COMPAT_OK) {
-			ERROR("Target image does not look valid. \n"
-			      "Add --force if you really want to use it.");
-			return UPDATE_ERR_ROOT_KEY;
-		}
+		struct property_prefetch tpm_fwver;
+		int r;
 
-		/* Check if the system is going to re-key. */
-		r = check_compatible_root_key(&cfg->image_current, image_to);
-		/* We only allow re-key to non-dev keys. */
-		switch (r) {
-		case ROOTKEY_COMPAT_OK:
-			break;
-		case ROOTKEY_COMPAT_REKEY:
-			INFO("Will change firmware signing key.\n");
-			break;
-		case ROOTKEY_COMPAT_REKEY_TO_DEV:
-			ERROR("Re-key to DEV is not allowed. \n"
-			      "Add --force if you really want to do that.");
-			return UPDATE_ERR_ROOT_KEY;
-		default:
+		start_prefetch(&tpm_fwver, cfg, SYS_PROP_TPM_FWVER);
+		r = check_full_update_root_keys(cfg, image_to);
+		finish_prefetch(&tpm_fwver);
+		if (r)
 			return UPDATE_ERR_ROOT_KEY;
-		}
 	}
 	if (check_compatible_tpm_keys(cfg, image_to))
 		return UPDATE_ERR_TPM_ROLLBACK;
 
 	/* FMAP may be different so we should just update all. */
-	if (write_firmware(cfg, image_to, NULL) ||
-	    write_optional_firmware(cfg, &cfg->ec_image, NULL, 1) ||
-	    write_optional_firmware(cfg, &cfg->pd_image, NULL, 1))
+	start_ec_pd_write(&ec_pd, cfg);
+	host_failed = write_firmware(cfg, image_to, NULL);
+	ec_pd_failed = finish_ec_pd_write(&ec_pd, !host_failed);
+	if (host_failed)
+		ERROR("Failed to write firmware to %s.\n",
+		      image_to->programmer);
+	if (ec_pd_failed)
+		ERROR("Failed to write firmware to %s.\n", ec_pd_failed);
+	if (host_failed || ec_pd_failed)
 		return UPDATE_ERR_WRITE_FIRMWARE;
 
 	return UPDATE_ERR_DONE;
@@ -1669,6 +2473,12 @@ enum updater_error_codes update_firmware(struct updater_config *cfg)
 	if (!image_to->data)
 		return UPDATE_ERR_NO_IMAGE;
 
+	/* Before any quirk or preserved section changes the target. */
+	if (cfg->flash_cache &&
+	    vb2_digest_buffer(image_to->data, image_to->size, VB2_HASH_SHA256,
+			      cfg->image_digest, sizeof(cfg->image_digest)))
+		return UPDATE_ERR_INVALID_IMAGE;
+
 	if (try_apply_quirk(QUIRK_DAISY_SNOW_DUAL_MODEL, cfg))
 		return UPDATE_ERR_PLATFORM;
 
@@ -1679,6 +2489,13 @@ enum updater_error_codes update_firmware(struct updater_config *cfg)
 	if (try_apply_quirk(QUIRK_MIN_PLATFORM_VERSION, cfg))
 		return UPDATE_ERR_PLATFORM;
 
+	if (cfg->flash_cache && cfg->try_update && !cfg->force_update &&
+	    !cfg->legacy_update && flash_cache_matches(cfg)) {
+		STATUS("NO UPDATE: Firmware still matches %s.\n",
+		       cfg->flash_cache);
+		return UPDATE_ERR_DONE;
+	}
+
 	if (!image_from->data) {
 		/*
 		 * TODO(hungte) Read only RO_SECTION, VBLOCK_A, VBLOCK_B,
@@ -1732,6 +2549,8 @@ enum updater_error_codes update_firmware(struct updater_config *cfg)
 		ERROR("To change keys in RO area, you must first remove \n"
 		      "write protection ( " REMOVE_WP_URL " ).");
 
+	if (finish_emulation(cfg) && r == UPDATE_ERR_DONE)
+		r = UPDATE_ERR_WRITE_FIRMWARE;
 	return r;
 }
 
@@ -1820,16 +2639,18 @@ static int updater_load_images(struct updater_config *cfg,
 			       const char *pd_image)
 {
 	int errorcnt = 0;
-	struct archive *ar = cfg->archive;
 
 	if (!cfg->image.data && image) {
 		if (image && strcmp(image, "-") == 0) {
 			INFO("Reading image from stdin...\n");
 			image = updater_create_temp_file(cfg);
-			if (image)
-				errorcnt += !!save_from_stdin(image);
+			if (!image || save_from_stdin(image) ||
+			    load_temp_firmware_image(&cfg->image, image, image))
+				errorcnt++;
+		} else {
+			errorcnt += !!load_updater_image(cfg, &cfg->image,
+							 image);
 		}
-		errorcnt += !!load_firmware_image(&cfg->image, image, ar);
 		if (!errorcnt)
 			errorcnt += updater_setup_quirks(cfg, arg);
 	}
@@ -1837,9 +2658,9 @@ static int updater_load_images(struct updater_config *cfg,
 		return errorcnt;
 
 	if (!cfg->ec_image.data && ec_image)
-		errorcnt += !!load_firmware_image(&cfg->ec_image, ec_image, ar);
+		errorcnt += !!load_updater_image(cfg, &cfg->ec_image, ec_image);
 	if (!cfg->pd_image.data && pd_image)
-		errorcnt += !!load_firmware_image(&cfg->pd_image, pd_image, ar);
+		errorcnt += !!load_updater_image(cfg, &cfg->pd_image, pd_image);
 	return errorcnt;
 }
 
@@ -1857,7 +2678,7 @@ static int updater_output_image(const struct firmware_image *image,
 		return 0;
 
 	ASPRINTF(&fpath, "%s/%s", root, fname);
-	r = vb2_write_file(fpath, image->data, image->size);
+	r = write_image_file(fpath, image->data, image->size);
 	if (r)
 		ERROR("Failed writing firmware image to: %s\n", fpath);
 	else
@@ -1875,46 +2696,48 @@ static int updater_apply_white_label(struct updater_config *cfg,
 				     struct model_config *model,
 				     const char *signature_id)
 {
-	const char *tmp_image = NULL;
-
 	assert(model->is_white_label);
-	if (!signature_id) {
-		if (cfg->image_current.data) {
-			tmp_image = updater_create_temp_file(cfg);
-			if (!tmp_image)
-				return 1;
-			if (vb2_write_file(tmp_image, cfg->image_current.data,
-					    cfg->image_current.size)) {
-				ERROR("Failed writing temporary image file.\n");
-				return 1;
-			}
-		} else {
-			INFO("Loading system firmware for white label...\n");
-			load_system_firmware(cfg, &cfg->image_current);
-			tmp_image = cfg->image_current.file_name;
-		}
-		if (!tmp_image) {
+	if (!signature_id && !cfg->image_current.data) {
+		INFO("Loading system firmware for white label...\n");
+		load_system_firmware(cfg, &cfg->image_current);
+		if (!cfg->image_current.data) {
 			ERROR("Failed to get system current firmware\n");
 			return 1;
 		}
 	}
 	return !!model_apply_white_label(
-			model, cfg->archive, signature_id, tmp_image);
+			model, cfg->archive, signature_id, &cfg->image_current);
 }
 
 /*
  * Setup what the updater has to do against an archive.
  * Returns number of failures, or 0 on success.
  */
+/*
+ * Frees the patches that white label found for a copy of a model, leaving
+ * the ones it shares with the original.
+ */
+static void free_white_label_patches(struct model_config *model,
+				     const struct model_config *original)
+{
+	if (model->patches.rootkey != original->patches.rootkey)
+		free(model->patches.rootkey);
+	if (model->patches.vblock_a != original->patches.vblock_a)
+		free(model->patches.vblock_a);
+	if (model->patches.vblock_b != original->patches.vblock_b)
+		free(model->patches.vblock_b);
+}
+
 static int updater_setup_archive(
 		struct updater_config *cfg,
 		const struct updater_config_arguments *arg,
-		struct manifest *manifest,
+		const struct manifest *manifest,
 		int is_factory)
 {
 	int errorcnt = 0;
 	struct archive *ar = cfg->archive;
-	const struct model_config *model;
+	const struct model_config *found;
+	struct model_config model;
 
 	if (arg->do_manifest) {
 		assert(!arg->image);
@@ -1923,42 +2746,48 @@ static int updater_setup_archive(
 		return errorcnt;
 	}
 
-	model = manifest_find_model(manifest, arg->model);
-	if (!model)
+	found = manifest_find_model(manifest, arg->model);
+	if (!found)
 		return ++errorcnt;
+	/*
+	 * White label patches depend on the device, and the manifest may be
+	 * shared with other configs, so they go on a copy of the model.
+	 */
+	model = *found;
 
 	/* Load images now so we can get quirks in WL checks. */
 	errorcnt += updater_load_images(
-			cfg, arg, model->image, model->ec_image,
-			model->pd_image);
+			cfg, arg, model.image, model.ec_image,
+			model.pd_image);
 
-	if (model->is_white_label && !manifest->has_keyset) {
+	if (model.is_white_label && !manifest->has_keyset) {
 		/*
 		 * Developers running unsigned updaters (usually local build)
 		 * won't be able match any white label tags.
 		 */
 		WARN("No keysets found - this is probably a local build of \n"
 		     "unsigned firmware updater. Skip applying white label.");
-	} else if (model->is_white_label) {
+	} else if (model.is_white_label) {
 		/*
 		 * It is fine to fail in updater_apply_white_label for factory
 		 * mode so we are not checking the return value; instead we
 		 * verify if the patches do contain new root key.
 		 */
-		updater_apply_white_label(cfg, (struct model_config *)model,
-					  arg->signature_id);
-		if (!model->patches.rootkey) {
+		updater_apply_white_label(cfg, &model, arg->signature_id);
+		if (!model.patches.rootkey) {
 			if (is_factory ||
 			    is_write_protection_enabled(cfg) ||
 			    get_config_quirk(QUIRK_ALLOW_EMPTY_WLTAG, cfg)) {
 				WARN("No VPD for white label.\n");
 			} else {
 				ERROR("Need VPD set for white label.\n");
+				free_white_label_patches(&model, found);
 				return ++errorcnt;
 			}
 		}
 	}
-	errorcnt += patch_image_by_model(&cfg->image, model, ar);
+	errorcnt += patch_image_by_model(&cfg->image, &model, ar);
+	free_white_label_patches(&model, found);
 	return errorcnt;
 }
 
@@ -1975,9 +2804,13 @@ int updater_setup_config(struct updater_config *cfg,
 	int do_output = 0;
 	const char *archive_path = arg->archive;
 
+	crossystem_snapshot(cfg);
+
 	/* Setup values that may change output or decision of other argument. */
 	cfg->verbosity = arg->verbosity;
 	cfg->fast_update = arg->fast_update;
+	cfg->flash_cache = arg->flash_cache;
+	cfg->dry_run = arg->dry_run;
 	cfg->factory_update = arg->is_factory;
 	if (arg->force_update)
 		cfg->force_update = 1;
@@ -2054,6 +2887,7 @@ int updater_setup_config(struct updater_config *cfg,
 		VB2_DEBUG("Using file %s for emulation.\n", arg->emulation);
 		errorcnt += !!load_firmware_image(
 				&cfg->image_current, arg->emulation, NULL);
+		errorcnt += !!unmap_firmware_image(&cfg->image_current);
 	}
 
 	/* Always load images specified from command line directly. */
@@ -2062,7 +2896,9 @@ int updater_setup_config(struct updater_config *cfg,
 
 	if (!archive_path)
 		archive_path = ".";
-	cfg->archive = archive_open(archive_path);
+	/* The archive may be shared from another config already. */
+	if (!cfg->archive)
+		cfg->archive = archive_open(archive_path);
 	if (!cfg->archive) {
 		ERROR("Failed to open archive: %s\n", archive_path);
 		return ++errorcnt;
@@ -2093,11 +2929,10 @@ int updater_setup_config(struct updater_config *cfg,
 
 	/* Load images from archive. */
 	if (arg->archive) {
-		struct manifest *m = new_manifest_from_archive(cfg->archive);
+		const struct manifest *m = archive_get_manifest(cfg->archive);
 		if (m) {
 			errorcnt += updater_setup_archive(
 					cfg, arg, m, cfg->factory_update);
-			delete_manifest(m);
 		} else {
 			ERROR("Failure in archive: %s\n", arg->archive);
 			++errorcnt;
@@ -2150,6 +2985,15 @@ int updater_setup_config(struct updater_config *cfg,
 	return errorcnt;
 }
 
+int updater_share_archive(struct updater_config *cfg,
+			  const struct updater_config *from)
+{
+	if (!from->archive || cfg->archive)
+		return -1;
+	cfg->archive = archive_share(from->archive);
+	return 0;
+}
+
 /*
  * Releases all resources in an updater configuration object.
  */
@@ -2160,7 +3004,10 @@ void updater_delete_config(struct updater_config *cfg)
 	free_firmware_image(&cfg->image_current);
 	free_firmware_image(&cfg->ec_image);
 	free_firmware_image(&cfg->pd_image);
+	finish_emulation(cfg);
+	updater_flashrom_close_all(cfg);
 	updater_remove_all_temp_files(cfg);
+	crossystem_release(cfg);
 	if (cfg->archive)
 		archive_close(cfg->archive);
 	free(cfg);
@@ -12,6 +12,7 @@
 
 #include "fmap.h"
 #include "futility.h"
+#include "vboot_futility.h"
 
 #define ASPRINTF(strp, ...) do { if (asprintf(strp, __VA_ARGS__) >= 0) break; \
 	ERROR("Failed to allocate memory, abort.\n"); exit(1); } while (0)
@@ -20,6 +21,7 @@
 static const char * const FMAP_RO_FRID = "RO_FRID",
 		  * const FMAP_RO_SECTION = "RO_SECTION",
 		  * const FMAP_RO_GBB = "GBB",
+		  * const FMAP_RO_VPD = "RO_VPD",
 		  * const FMAP_RW_VBLOCK_A = "VBLOCK_A",
 		  * const FMAP_RW_VBLOCK_B = "VBLOCK_B",
 		  * const FMAP_RW_SECTION_A = "RW_SECTION_A",
@@ -36,9 +38,20 @@ struct firmware_image {
 	const char *programmer;
 	uint32_t size;
 	uint8_t *data;
+	/*
+	 * Non-zero if data is a mapping of a file: a private (copy-on-write)
+	 * one of the image file, or a shared one of data_file.
+	 */
+	int is_mapped;
+	/* Temp file whose contents are data, if data maps it shared */
+	const char *data_file;
 	char *file_name;
 	char *ro_version, *rw_version_a, *rw_version_b;
 	FmapHeader *fmap_header;
+	/* CBFS sections read by updater_cbfs_find() */
+	struct cbfs_directory *cbfs_dirs;
+	/* VPD sections read by updater_vpd_find() */
+	struct vpd_table *vpd_tables;
 };
 
 struct firmware_section {
@@ -46,8 +59,19 @@ struct firmware_section {
 	size_t size;
 };
 
+/* A file in a CBFS section of a firmware image. */
+struct cbfs_file_info {
+	const char *name;
+	uint32_t type;
+	uint8_t *data;		/* Contents, in the image */
+	uint32_t offset;	/* Of the contents, from the section start */
+	uint32_t size;
+	int is_encoded;		/* Compressed or hashed, so not raw bytes */
+};
+
+struct updater_config;
 struct system_property {
-	int (*getter)(void);
+	int (*getter)(struct updater_config *cfg);
 	int value;
 	int initialized;
 };
@@ -62,7 +86,6 @@ enum system_property_type {
 	SYS_PROP_MAX
 };
 
-struct updater_config;
 struct quirk_entry {
 	const char *name;
 	const char *help;
@@ -81,12 +104,25 @@ enum quirk_types {
 	QUIRK_MAX,
 };
 
+enum wp_state {
+	WP_DISABLED,
+	WP_ENABLED,
+};
+
+/* A range of bytes on a flash chip. */
+struct flash_range {
+	uint32_t offset;
+	uint32_t size;
+};
+
 struct tempfile {
 	char *filepath;
+	int fd;		/* memfd behind filepath, or -1 for a file on disk */
 	struct tempfile *next;
 };
 
 struct archive;
+struct flashrom_session;
 struct updater_config {
 	struct firmware_image image, image_current;
 	struct firmware_image ec_image, pd_image;
@@ -94,27 +130,23 @@ struct updater_config {
 	struct quirk_entry quirks[QUIRK_MAX];
 	struct archive *archive;
 	struct tempfile *tempfiles;
+	struct flashrom_session *flashrom_sessions;
 	int try_update;
 	int force_update;
 	int legacy_update;
 	int factory_update;
 	int check_platform;
 	int fast_update;
+	int dry_run;
 	int verbosity;
+	int crossystem_snapshot;
 	const char *emulation;
-};
-
-struct updater_config_arguments {
-	char *image, *ec_image, *pd_image;
-	char *archive, *quirks, *mode;
-	const char *programmer;
-	char *model, *signature_id;
-	char *emulation, *sys_props, *write_protection;
-	char *output_dir;
-	char *repack, *unpack;
-	int is_factory, try_update, force_update, do_manifest, host_only;
-	int fast_update;
-	int verbosity;
+	/* The emulation file, mapped by the first emulated write. */
+	uint8_t *emulation_data;
+	uint32_t emulation_size;
+	const char *flash_cache;
+	/* SHA-256 of the target image as loaded, for flash_cache. */
+	uint8_t image_digest[VB2_SHA256_DIGEST_SIZE];
 };
 
 struct patch_config {
@@ -137,53 +169,11 @@ struct manifest {
 	struct archive *archive;
 	int default_model;
 	int has_keyset;
+	/* Hash table of model indexes + 1 (0 for empty), by model name */
+	int *name_table;
+	int name_table_size;
 };
 
-enum updater_error_codes {
-	UPDATE_ERR_DONE,
-	UPDATE_ERR_NEED_RO_UPDATE,
-	UPDATE_ERR_NO_IMAGE,
-	UPDATE_ERR_SYSTEM_IMAGE,
-	UPDATE_ERR_INVALID_IMAGE,
-	UPDATE_ERR_SET_COOKIES,
-	UPDATE_ERR_WRITE_FIRMWARE,
-	UPDATE_ERR_PLATFORM,
-	UPDATE_ERR_TARGET,
-	UPDATE_ERR_ROOT_KEY,
-	UPDATE_ERR_TPM_ROLLBACK,
-	UPDATE_ERR_UNKNOWN,
-};
-
-/* Messages explaining enum updater_error_codes. */
-extern const char * const updater_error_messages[];
-
-struct updater_config;
-
-/*
- * The main updater to update system firmware using the configuration parameter.
- * Returns UPDATE_ERR_DONE if success, otherwise failure.
- */
-enum updater_error_codes update_firmware(struct updater_config *cfg);
-
-/*
- * Allocates and initializes a updater_config object with default values.
- * Returns the newly allocated object, or NULL on error.
- */
-struct updater_config *updater_new_config(void);
-
-/*
- * Releases all resources in an updater configuration object.
- */
-void updater_delete_config(struct updater_config *cfg);
-
-/*
- * Helper function to setup an allocated updater_config object.
- * Returns number of failures, or 0 on success.
- */
-int updater_setup_config(struct updater_config *cfg,
-			 const struct updater_config_arguments *arg,
-			 int *do_update);
-
 /* Prints the name and description from all supported quirks. */
 void updater_list_config_quirks(const struct updater_config *cfg);
 
@@ -264,6 +254,103 @@ const struct vb2_gbb_header *find_gbb(const struct firmware_image *image);
  */
 char *host_shell(const char *command);
 
+/*
+ * Returns the platform version, as 'mosys platform version' prints it (for
+ * example "rev2"). It is read from SMBIOS or the device tree when the kernel
+ * has them, and from mosys otherwise.
+ * The caller is responsible for releasing the returned string.
+ */
+char *host_read_platform_version(void);
+
+/* Functions from updater_flashrom.c */
+
+/*
+ * Reads the whole flash chip behind a programmer into a new buffer, which the
+ * caller must free.  The programmer is probed on first use only.
+ * Returns 0 on success, otherwise failure.
+ */
+int updater_flashrom_read(struct updater_config *cfg, const char *programmer,
+			  uint8_t **data, uint32_t *size);
+
+/*
+ * Reads only the given byte ranges of the flash chip behind a programmer, into
+ * a new buffer the size of the chip, which the caller must free.  Bytes
+ * outside the ranges are undefined.  There must be at least one range.
+ * Returns 0 on success, otherwise failure.
+ */
+int updater_flashrom_read_ranges(struct updater_config *cfg,
+				 const char *programmer,
+				 const struct flash_range *ranges,
+				 int num_ranges, uint8_t **data,
+				 uint32_t *size);
+
+/*
+ * Writes a region (by FMAP name), or the whole image if region is NULL, to the
+ * flash chip behind a programmer.  If diff is not NULL, it must be the current
+ * contents of the chip (same size as data), and only changed blocks are
+ * written.
+ * Returns 0 on success, otherwise failure.
+ */
+int updater_flashrom_write(struct updater_config *cfg, const char *programmer,
+			   const uint8_t *data, uint32_t size,
+			   const char *region, const uint8_t *diff);
+
+/*
+ * Same as updater_flashrom_write(), but writes only the given byte ranges of
+ * data.  There must be at least one range.  Instead of flashrom verifying
+ * the chip, only the ranges are read back and compared with data afterwards.
+ * Returns 0 on success, otherwise failure.
+ */
+int updater_flashrom_write_ranges(struct updater_config *cfg,
+				  const char *programmer,
+				  const uint8_t *data, uint32_t size,
+				  const struct flash_range *ranges,
+				  int num_ranges, const uint8_t *diff);
+
+/*
+ * Gets the software write protection status of the flash chip behind a
+ * programmer.
+ * Returns WP_ENABLED, WP_DISABLED, or -1 on error.
+ */
+int updater_flashrom_wp_status(struct updater_config *cfg,
+			       const char *programmer);
+
+/* Closes all programmers opened by the functions above. */
+void updater_flashrom_close_all(struct updater_config *cfg);
+
+/* Functions from updater_cbfs.c */
+
+/*
+ * Finds a file in the CBFS on given section of an image. The section's
+ * files are read on first use and kept with the image, so anything that
+ * changes the CBFS headers afterwards must call updater_cbfs_forget().
+ * Returns the file (valid until the image is changed or freed), or NULL if
+ * the section or file doesn't exist.
+ */
+const struct cbfs_file_info *updater_cbfs_find(struct firmware_image *image,
+					       const char *section_name,
+					       const char *file_name);
+
+/* Drops the CBFS files kept by updater_cbfs_find(). */
+void updater_cbfs_forget(struct firmware_image *image);
+
+/* Functions from updater_vpd.c */
+
+/*
+ * Finds the value of a key in the VPD on given section of an image, for
+ * example RO_VPD. The section is decoded on first use and kept with the
+ * image, so anything that changes the section afterwards must call
+ * updater_vpd_forget().
+ * Returns the value (valid until the image is changed or freed), or NULL if
+ * the section or key doesn't exist.
+ */
+const char *updater_vpd_find(struct firmware_image *image,
+			     const char *section_name,
+			     const char *key);
+
+/* Drops the VPD values kept by updater_vpd_find(). */
+void updater_vpd_forget(struct firmware_image *image);
+
 /* Functions from updater_archive.c */
 
 /*
@@ -275,7 +362,14 @@ char *host_shell(const char *command);
 struct archive *archive_open(const char *path);
 
 /*
- * Closes an archive reference.
+ * Adds a reference to an opened archive, for example to share it with
+ * another updater_config. Archive functions may be used from several threads.
+ * Returns the archive, to be released by archive_close when not used.
+ */
+struct archive *archive_share(struct archive *ar);
+
+/*
+ * Closes an archive reference. The archive is closed with its last reference.
  * Returns 0 on success, otherwise non-zero as failure.
  */
 int archive_close(struct archive *ar);
@@ -294,6 +388,30 @@ int archive_has_entry(struct archive *ar, const char *name);
 int archive_read_file(struct archive *ar, const char *fname,
 		      uint8_t **data, uint32_t *size);
 
+/*
+ * Checks if a file in archive lives on a real file system, so that
+ * archive_map_file can map it.
+ * Returns 1 if it does, otherwise 0.
+ */
+int archive_is_mappable(struct archive *ar, const char *fname);
+
+/*
+ * Maps a file from archive into memory as a private, writable mapping.
+ * Only works for files on a real file system; the mapping must be released
+ * with munmap(*data, *size).
+ * Returns 0 on success, otherwise non-zero if archive_read_file should be
+ * used instead.
+ */
+int archive_map_file(struct archive *ar, const char *fname,
+		     uint8_t **data, uint32_t *size);
+
+/*
+ * Extracts a file from archive into the file at path, a chunk at a time.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+int archive_extract_file(struct archive *ar, const char *fname,
+			 const char *path);
+
 /*
  * Writes a file into archive.
  * If entry name (fname) is an absolute path (/file), always write into real
@@ -318,6 +436,13 @@ struct manifest *new_manifest_from_archive(struct archive *archive);
 /* Releases all resources allocated by given manifest object. */
 void delete_manifest(struct manifest *manifest);
 
+/*
+ * Gets the manifest of an archive, created by new_manifest_from_archive on
+ * the first call and kept until the archive is closed.
+ * Returns the manifest on success, otherwise NULL for failure.
+ */
+const struct manifest *archive_get_manifest(struct archive *archive);
+
 /* Prints the information of objects in manifest (models and images) in JSON. */
 void print_json_manifest(const struct manifest *manifest);
 
@@ -340,13 +465,13 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
 /*
  * Applies white label information to an existing model configuration.
  * Collects signature ID information from either parameter signature_id or
- * image file (via VPD) and updates model.patches for key files.
+ * the RO VPD of image and updates model.patches for key files.
  * Returns 0 on success, otherwise failure.
  */
 int model_apply_white_label(
 		struct model_config *model,
 		struct archive *archive,
 		const char *signature_id,
-		const char *image);
+		struct firmware_image *image);
 
 #endif  /* VBOOT_REFERENCE_FUTILITY_UPDATER_H_ */
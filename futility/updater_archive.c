@@ -8,10 +8,13 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>
 #include <fts.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -84,12 +87,47 @@ struct archive {
 			 uint8_t **data, uint32_t *size);
 	int (*write_file)(void *handle, const char *fname,
 			  uint8_t *data, uint32_t size);
+	int (*extract_file)(void *handle, const char *fname, int fd);
+
+	/*
+	 * Sorted names of all files, built by the first archive_walk so
+	 * archive_has_entry does not have to ask the driver again.
+	 */
+	char **index;
+	size_t index_size;
+
+	/*
+	 * An archive may be shared by updater configs in several threads;
+	 * the last archive_close() closes it. The lock is recursive, since
+	 * archive_walk() callbacks may use the archive again.
+	 */
+	int refs;
+	pthread_mutex_t lock;
+	/* Manifest read by the first archive_get_manifest(), if any. */
+	struct manifest *manifest;
 };
 
 /*
  * -- Begin of archive implementations --
  */
 
+/* Size of the chunks archive_extract_file copies at a time. */
+#define ARCHIVE_EXTRACT_CHUNK_SIZE (64 * 1024)
+
+/* Writes all of data to fd. Returns 0 on success, otherwise failure. */
+static int write_all(int fd, const uint8_t *data, size_t size)
+{
+	while (size) {
+		ssize_t n = write(fd, data, size);
+
+		if (n < 0)
+			return -1;
+		data += n;
+		size -= n;
+	}
+	return 0;
+}
+
 /* Callback for archive_open on a general file system. */
 static void *archive_fallback_open(const char *name)
 {
@@ -205,6 +243,31 @@ static int archive_fallback_write_file(void *handle, const char *fname,
 	return r;
 }
 
+/* Callback for archive_extract_file on a general file system. */
+static int archive_fallback_extract_file(void *handle, const char *fname,
+					 int fd)
+{
+	char *temp_path = NULL;
+	const char *path = archive_fallback_get_path(handle, fname, &temp_path);
+	uint8_t *buf = malloc(ARCHIVE_EXTRACT_CHUNK_SIZE);
+	int in = open(path, O_RDONLY);
+	ssize_t n = -1;
+
+	VB2_DEBUG("Extracting %s\n", path);
+	while (buf && in >= 0 &&
+	       (n = read(in, buf, ARCHIVE_EXTRACT_CHUNK_SIZE)) > 0) {
+		if (write_all(fd, buf, n)) {
+			n = -1;
+			break;
+		}
+	}
+	if (in >= 0)
+		close(in);
+	free(buf);
+	free(temp_path);
+	return n != 0;
+}
+
 #ifdef HAVE_LIBZIP
 
 /* Callback for archive_open on a ZIP file. */
@@ -288,6 +351,37 @@ static int archive_zip_read_file(void *handle, const char *fname,
 	return *data == NULL;
 }
 
+/*
+ * Callback for archive_extract_file on a ZIP file. The entry is decompressed
+ * a chunk at a time, so it is never all in memory.
+ */
+static int archive_zip_extract_file(void *handle, const char *fname, int fd)
+{
+	struct zip *zip = (struct zip *)handle;
+	struct zip_file *fp;
+	uint8_t *buf;
+	zip_int64_t n = -1;
+
+	assert(zip);
+	fp = zip_fopen(zip, fname, 0);
+	if (!fp) {
+		ERROR("Failed to open entry in ZIP: %s\n", fname);
+		return 1;
+	}
+	buf = malloc(ARCHIVE_EXTRACT_CHUNK_SIZE);
+	while (buf && (n = zip_fread(fp, buf, ARCHIVE_EXTRACT_CHUNK_SIZE)) > 0) {
+		if (write_all(fd, buf, n)) {
+			n = -1;
+			break;
+		}
+	}
+	if (n)
+		ERROR("Failed to extract entry in zip: %s\n", fname);
+	free(buf);
+	zip_fclose(fp);
+	return n != 0;
+}
+
 /* Callback for archive_zip_write_file on a ZIP file. */
 static int archive_zip_write_file(void *handle, const char *fname,
 				  uint8_t *data, uint32_t size)
@@ -316,6 +410,109 @@ static int archive_zip_write_file(void *handle, const char *fname,
 }
 #endif
 
+/* Releases the entry index, if any. */
+static void archive_drop_index(struct archive *ar)
+{
+	size_t i;
+
+	for (i = 0; i < ar->index_size; i++)
+		free(ar->index[i]);
+	free(ar->index);
+	ar->index = NULL;
+	ar->index_size = 0;
+}
+
+/* Callback for archive_build_index. */
+static int archive_index_callback(const char *path, void *arg)
+{
+	struct archive *ar = (struct archive *)arg;
+	char **index;
+
+	index = (char **)realloc(ar->index,
+				 (ar->index_size + 1) * sizeof(*index));
+	if (index) {
+		ar->index = index;
+		ar->index[ar->index_size] = strdup(path);
+	}
+	if (!index || !ar->index[ar->index_size]) {
+		/* Leave an empty index so archive_build_index gives up. */
+		archive_drop_index(ar);
+		return 1;
+	}
+	ar->index_size++;
+	return 0;
+}
+
+static int archive_index_compare(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * Builds the sorted index of all files in archive.
+ * Returns 0 on success, otherwise non-zero (and no index) as failure.
+ */
+static int archive_build_index(struct archive *ar)
+{
+	if (ar->walk(ar->handle, ar, archive_index_callback) ||
+	    !ar->index_size) {
+		VB2_DEBUG("Failed to index archive.\n");
+		archive_drop_index(ar);
+		return -1;
+	}
+	qsort(ar->index, ar->index_size, sizeof(*ar->index),
+	      archive_index_compare);
+	VB2_DEBUG("Indexed %zu entries.\n", ar->index_size);
+	return 0;
+}
+
+/*
+ * Looks up name in the index, as a file or as a directory containing files.
+ * Returns 1 if found, 0 if not, or -1 if there is no index.
+ */
+static int archive_index_lookup(const struct archive *ar, const char *name)
+{
+	size_t lo = 0, hi = ar->index_size, len = strlen(name);
+
+	if (!ar->index)
+		return -1;
+
+	/* Find the first entry not less than name. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcmp(ar->index[mid], name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	/*
+	 * An exact match is a file.  Otherwise, files in a directory "name"
+	 * sort after "name" but may be preceded by siblings like "name.bin"
+	 * or "name-b/"; scan past those to the first "name/" candidate.
+	 */
+	for (; lo < ar->index_size; lo++) {
+		const char *entry = ar->index[lo];
+
+		if (strncmp(entry, name, len))
+			break;
+		if (entry[len] == '\0' || entry[len] == '/')
+			return 1;
+		if ((unsigned char)entry[len] > '/')
+			break;
+	}
+	return 0;
+}
+
+static void init_archive_lock(struct archive *ar)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&ar->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
 /*
  * Opens an archive from given path.
  * The type of archive will be determined automatically.
@@ -332,7 +529,7 @@ struct archive *archive_open(const char *path)
 		return NULL;
 	}
 
-	ar = (struct archive *)malloc(sizeof(*ar));
+	ar = (struct archive *)calloc(1, sizeof(*ar));
 	if (!ar) {
 		ERROR("Internal error: allocation failure.\n");
 		return NULL;
@@ -348,6 +545,7 @@ struct archive *archive_open(const char *path)
 		ar->has_entry = archive_fallback_has_entry;
 		ar->read_file = archive_fallback_read_file;
 		ar->write_file = archive_fallback_write_file;
+		ar->extract_file = archive_fallback_extract_file;
 	} else {
 #ifdef HAVE_LIBZIP
 		VB2_DEBUG("Found file, use ZIP driver: %s\n", path);
@@ -357,6 +555,7 @@ struct archive *archive_open(const char *path)
 		ar->has_entry = archive_zip_has_entry;
 		ar->read_file = archive_zip_read_file;
 		ar->write_file = archive_zip_write_file;
+		ar->extract_file = archive_zip_extract_file;
 #else
 		ERROR("Found file, but no drivers were enabled: %s\n", path);
 		free(ar);
@@ -369,6 +568,20 @@ struct archive *archive_open(const char *path)
 		free(ar);
 		return NULL;
 	}
+	init_archive_lock(ar);
+	ar->refs = 1;
+	return ar;
+}
+
+/*
+ * Adds a reference to an opened archive.
+ * Returns the archive, to be released by archive_close like the first one.
+ */
+struct archive *archive_share(struct archive *ar)
+{
+	pthread_mutex_lock(&ar->lock);
+	ar->refs++;
+	pthread_mutex_unlock(&ar->lock);
 	return ar;
 }
 
@@ -378,7 +591,19 @@ struct archive *archive_open(const char *path)
  */
 int archive_close(struct archive *ar)
 {
-	int r = ar->close(ar->handle);
+	int r;
+
+	pthread_mutex_lock(&ar->lock);
+	r = --ar->refs;
+	pthread_mutex_unlock(&ar->lock);
+	if (r)
+		return 0;
+
+	if (ar->manifest)
+		delete_manifest(ar->manifest);
+	r = ar->close(ar->handle);
+	archive_drop_index(ar);
+	pthread_mutex_destroy(&ar->lock);
 	free(ar);
 	return r;
 }
@@ -391,9 +616,16 @@ int archive_close(struct archive *ar)
  */
 int archive_has_entry(struct archive *ar, const char *name)
 {
+	int r;
+
 	if (!ar || *name == '/')
 		return archive_fallback_has_entry(NULL, name);
-	return ar->has_entry(ar->handle, name);
+	pthread_mutex_lock(&ar->lock);
+	r = archive_index_lookup(ar, name);
+	if (r < 0)
+		r = ar->has_entry(ar->handle, name);
+	pthread_mutex_unlock(&ar->lock);
+	return r;
 }
 
 /*
@@ -401,14 +633,29 @@ int archive_has_entry(struct archive *ar, const char *name)
  * For every entry, the path (relative the archive root) will be passed to
  * callback function, until the callback returns non-zero.
  * The arg argument will also be passed to callback.
+ * The first walk indexes the archive, and entries are then visited in sorted
+ * order from the index.
  * Returns 0 on success otherwise non-zero as failure.
  */
 static int archive_walk(struct archive *ar, void *arg,
 			int (*callback)(const char *path, void *arg))
 {
+	size_t i;
+	int r = 0;
+
 	if (!ar)
 		return archive_fallback_walk(NULL, arg, callback);
-	return ar->walk(ar->handle, arg, callback);
+	pthread_mutex_lock(&ar->lock);
+	if (!ar->index && archive_build_index(ar)) {
+		r = ar->walk(ar->handle, arg, callback);
+	} else {
+		for (i = 0; i < ar->index_size; i++) {
+			if (callback(ar->index[i], arg))
+				break;
+		}
+	}
+	pthread_mutex_unlock(&ar->lock);
+	return r;
 }
 
 /*
@@ -421,9 +668,95 @@ static int archive_walk(struct archive *ar, void *arg,
 int archive_read_file(struct archive *ar, const char *fname,
 		      uint8_t **data, uint32_t *size)
 {
+	int r;
+
 	if (!ar || *fname == '/')
 		return archive_fallback_read_file(NULL, fname, data, size);
-	return ar->read_file(ar->handle, fname, data, size);
+	pthread_mutex_lock(&ar->lock);
+	r = ar->read_file(ar->handle, fname, data, size);
+	pthread_mutex_unlock(&ar->lock);
+	return r;
+}
+
+/*
+ * Checks if a file in archive lives on a real file system, so that
+ * archive_map_file can map it.
+ * Returns 1 if it does, otherwise 0.
+ */
+int archive_is_mappable(struct archive *ar, const char *fname)
+{
+	return !ar || *fname == '/' ||
+		ar->read_file == archive_fallback_read_file;
+}
+
+/*
+ * Maps a file from archive into memory, if it lives on a real file system.
+ * The mapping is private and writable: pages are shared with the page cache
+ * until they are modified, and modifications are never written back to the
+ * file.  The caller must release it with munmap(*data, *size).
+ * Returns 0 on success, otherwise non-zero if the file cannot be mapped (for
+ * example, it is inside a ZIP archive) and archive_read_file should be used.
+ */
+int archive_map_file(struct archive *ar, const char *fname,
+		     uint8_t **data, uint32_t *size)
+{
+	char *temp_path = NULL;
+	const char *path;
+	struct stat st;
+	void *ptr = MAP_FAILED;
+	int fd;
+
+	if (!archive_is_mappable(ar, fname))
+		return -1;
+
+	path = archive_fallback_get_path(ar ? ar->handle : NULL, fname,
+					 &temp_path);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+		    st.st_size > 0 && st.st_size <= UINT32_MAX)
+			ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE, fd, 0);
+		/* The mapping holds its own reference to the file. */
+		close(fd);
+	}
+	free(temp_path);
+	if (ptr == MAP_FAILED)
+		return -1;
+
+	VB2_DEBUG("Mapped %s\n", path);
+	*data = ptr;
+	*size = st.st_size;
+	return 0;
+}
+
+/*
+ * Extracts a file from archive into the file at path, without reading it
+ * all into memory first.
+ * If entry name (fname) is an absolute path (/file), always read from real
+ * file system.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+int archive_extract_file(struct archive *ar, const char *fname,
+			 const char *path)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	int r;
+
+	if (fd < 0) {
+		ERROR("Cannot open %s\n", path);
+		return -1;
+	}
+	if (!ar || *fname == '/') {
+		r = archive_fallback_extract_file(NULL, fname, fd);
+	} else {
+		pthread_mutex_lock(&ar->lock);
+		r = ar->extract_file(ar->handle, fname, fd);
+		pthread_mutex_unlock(&ar->lock);
+	}
+	if (close(fd))
+		r = -1;
+	return r;
 }
 
 /*
@@ -435,9 +768,16 @@ int archive_read_file(struct archive *ar, const char *fname,
 int archive_write_file(struct archive *ar, const char *fname,
 		       uint8_t *data, uint32_t size)
 {
+	int r;
+
 	if (!ar || *fname == '/')
 		return archive_fallback_write_file(NULL, fname, data, size);
-	return ar->write_file(ar->handle, fname, data, size);
+	pthread_mutex_lock(&ar->lock);
+	/* Rather than keeping it up to date, index again when needed. */
+	archive_drop_index(ar);
+	r = ar->write_file(ar->handle, fname, data, size);
+	pthread_mutex_unlock(&ar->lock);
+	return r;
 }
 
 struct _copy_arg {
@@ -505,21 +845,19 @@ static int str_startswith(const char *name, const char *pattern)
 	return strncmp(name, pattern, strlen(pattern)) == 0;
 }
 
-/* Returns the VPD value by given key name, or NULL on error (or no value). */
-static char *vpd_get_value(const char *fpath, const char *key)
+/*
+ * Returns a copy of the RO VPD value by given key name, or NULL on error (or
+ * no value).
+ */
+static char *vpd_get_value(struct firmware_image *image, const char *key)
 {
-	char *command, *result;
+	const char *value;
 
-	assert(fpath);
-	ASPRINTF(&command, "vpd -g %s -f %s 2>/dev/null", key, fpath);
-	result = host_shell(command);
-	free(command);
-
-	if (result && !*result) {
-		free(result);
-		result = NULL;
-	}
-	return result;
+	assert(image);
+	value = updater_vpd_find(image, FMAP_RO_VPD, key);
+	if (!value || !*value)
+		return NULL;
+	return strdup(value);
 }
 
 /*
@@ -787,6 +1125,76 @@ static int manifest_scan_entries(const char *name, void *arg)
 	return !manifest_add_model(manifest, &model);
 }
 
+/* Returns the FNV-1a hash of a model name. */
+static uint32_t model_name_hash(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	for (; *name; name++)
+		h = (h ^ (uint8_t)*name) * 16777619U;
+	return h;
+}
+
+/*
+ * Builds the hash table of model names, for manifest_find_model.
+ * Returns 0 on success, otherwise non-zero (and no table) as failure.
+ */
+static int manifest_build_name_table(struct manifest *manifest)
+{
+	int i, size = 16;
+
+	/* Keep the load factor at or below 1/2. */
+	while (size < manifest->num * 2)
+		size *= 2;
+	manifest->name_table = (int *)calloc(size, sizeof(int));
+	if (!manifest->name_table)
+		return -1;
+	manifest->name_table_size = size;
+
+	for (i = 0; i < manifest->num; i++) {
+		const char *name = manifest->models[i].name;
+		uint32_t slot = model_name_hash(name) & (size - 1);
+		int *entry;
+
+		while (*(entry = &manifest->name_table[slot])) {
+			/* Like the linear search, the first model wins. */
+			if (!strcmp(manifest->models[*entry - 1].name, name))
+				break;
+			slot = (slot + 1) & (size - 1);
+		}
+		if (!*entry)
+			*entry = i + 1;
+	}
+	return 0;
+}
+
+/*
+ * Looks up a model by name.
+ * Returns the model_config, or NULL if not found.
+ */
+static const struct model_config *manifest_lookup_model(
+		const struct manifest *manifest, const char *name)
+{
+	uint32_t mask, slot;
+	int i;
+
+	if (!manifest->name_table) {
+		for (i = 0; i < manifest->num; i++) {
+			if (strcmp(name, manifest->models[i].name) == 0)
+				return &manifest->models[i];
+		}
+		return NULL;
+	}
+
+	mask = manifest->name_table_size - 1;
+	for (slot = model_name_hash(name) & mask;
+	     (i = manifest->name_table[slot]); slot = (slot + 1) & mask) {
+		if (strcmp(name, manifest->models[i - 1].name) == 0)
+			return &manifest->models[i - 1];
+	}
+	return NULL;
+}
+
 /*
  * Finds the existing model_config from manifest that best matches current
  * system (as defined by model_name).
@@ -813,10 +1221,7 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
 		model_name = sys_model_name;
 	}
 
-	for (i = 0; !model && i < manifest->num; i++) {
-		if (strcmp(model_name, manifest->models[i].name) == 0)
-			model = &manifest->models[i];
-	}
+	model = manifest_lookup_model(manifest, model_name);
 	if (!model) {
 		if (!*model_name)
 			ERROR("Cannot get model name.\n");
@@ -847,7 +1252,8 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
  * Returns the signature ID for looking up rootkey and vblock files.
  * Caller must free the returned string.
  */
-static char *resolve_signature_id(struct model_config *model, const char *image)
+static char *resolve_signature_id(struct model_config *model,
+				  struct firmware_image *image)
 {
 	int is_unibuild = model->signature_id ? 1 : 0;
 	char *wl_tag = vpd_get_value(image, VPD_WHITELABEL_TAG);
@@ -893,7 +1299,7 @@ int model_apply_white_label(
 		struct model_config *model,
 		struct archive *archive,
 		const char *signature_id,
-		const char *image)
+		struct firmware_image *image)
 {
 	char *sig_id = NULL;
 	int r = 0;
@@ -957,9 +1363,9 @@ struct manifest *new_manifest_from_archive(struct archive *archive)
 			model.pd_image = strdup(pd_name);
 		/* Extract model name from FWID: $Vendor_$Platform.$Version */
 		if (!load_firmware_image(&image, image_name, archive)) {
-			char *token = NULL;
-			if (strtok(image.ro_version, "_"))
-				token = strtok(NULL, ".");
+			char *token = NULL, *saveptr;
+			if (strtok_r(image.ro_version, "_", &saveptr))
+				token = strtok_r(NULL, ".", &saveptr);
 			if (token && *token) {
 				str_convert(token, tolower);
 				model.name = strdup(token);
@@ -978,6 +1384,9 @@ struct manifest *new_manifest_from_archive(struct archive *archive)
 		ERROR("No valid configurations found from archive.\n");
 		return NULL;
 	}
+	/* Without the table, lookups fall back to a linear search. */
+	if (manifest_build_name_table(&manifest))
+		WARN("Cannot allocate model name table.\n");
 
 	new_manifest = (struct manifest *)malloc(sizeof(manifest));
 	if (!new_manifest) {
@@ -1005,68 +1414,258 @@ void delete_manifest(struct manifest *manifest)
 		free(model->patches.vblock_b);
 	}
 	free(manifest->models);
+	free(manifest->name_table);
 	free(manifest);
 }
 
-static const char *get_gbb_key_hash(const struct vb2_gbb_header *gbb,
-				    int32_t offset, int32_t size)
+/*
+ * Gets the manifest of an archive, reading it on the first call.
+ * Returns the manifest (owned by the archive), or NULL for failure.
+ */
+const struct manifest *archive_get_manifest(struct archive *archive)
+{
+	struct manifest *manifest;
+
+	pthread_mutex_lock(&archive->lock);
+	if (!archive->manifest)
+		archive->manifest = new_manifest_from_archive(archive);
+	manifest = archive->manifest;
+	pthread_mutex_unlock(&archive->lock);
+	return manifest;
+}
+
+/* Longest key hash text: a SHA-1 digest in hex, or one of the errors below. */
+#define KEY_HASH_LEN (VB2_SHA1_DIGEST_SIZE * 2 + 1)
+
+/* Most threads print_json_manifest() reads images with. */
+#define MAX_JSON_JOBS 16
+
+/*
+ * Writes the SHA-1 string of a key in the GBB into hash, which must have room
+ * for KEY_HASH_LEN characters.  It is computed here rather than by
+ * packed_key_sha1_string(), which returns a static buffer and so can't be
+ * used by more than one thread at a time.
+ */
+static void get_gbb_key_hash(const struct vb2_gbb_header *gbb,
+			     int32_t offset, int32_t size, char *hash)
 {
 	struct vb2_packed_key *key;
+	uint8_t digest[VB2_SHA1_DIGEST_SIZE];
+	int i;
 
-	if (!gbb)
-		return "<No GBB>";
+	if (!gbb) {
+		strcpy(hash, "<No GBB>");
+		return;
+	}
 	key = (struct vb2_packed_key *)((uint8_t *)gbb + offset);
-	if (!packed_key_looks_ok(key, size))
-	    return "<Invalid key>";
-	return packed_key_sha1_string(key);
+	if (!packed_key_looks_ok(key, size)) {
+		strcpy(hash, "<Invalid key>");
+		return;
+	}
+	vb2_digest_buffer((uint8_t *)key + key->key_offset, key->key_size,
+			  VB2_HASH_SHA1, digest, sizeof(digest));
+	for (i = 0; i < sizeof(digest); i++)
+		sprintf(hash + i * 2, "%02x", digest[i]);
 }
 
-/* Prints the information of given image file in JSON format. */
-static void print_json_image(
-		const char *name, const char *fpath, struct model_config *m,
-		struct archive *archive, int indent, int is_host)
+/*
+ * What print_json_image() shows of one image file.  Models often share
+ * images, so each distinct image is read only once for the whole manifest.
+ * Host images are patched by the model's keys before their keys are hashed,
+ * so those are only shared by models with the same patch files.
+ */
+struct json_image {
+	const char *fpath;
+	const struct model_config *model;
+	int is_host;
+	struct archive *archive;
+
+	/* Results */
+	char *ro_version, *rw_version;
+	int patch_failed;
+	int has_keys;
+	char root_key[KEY_HASH_LEN], recovery_key[KEY_HASH_LEN];
+};
+
+/* The images print_json_manifest() is reading, for its workers. */
+static struct json_image *json_images;
+static int json_images_count, json_images_next;
+static pthread_mutex_t json_images_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int same_path(const char *a, const char *b)
+{
+	return a == b || (a && b && !strcmp(a, b));
+}
+
+/* Returns non-zero if model a and b would patch an image the same way. */
+static int same_patches(const struct model_config *a,
+			const struct model_config *b)
+{
+	return same_path(a->patches.rootkey, b->patches.rootkey) &&
+	       same_path(a->patches.vblock_a, b->patches.vblock_a) &&
+	       same_path(a->patches.vblock_b, b->patches.vblock_b);
+}
+
+/*
+ * Finds the entry in images for fpath as used by model m, adding one if
+ * add is set and there is none yet.
+ * Returns the entry, or NULL if not found (or fpath is NULL).
+ */
+static struct json_image *find_json_image(
+		struct json_image *images, int *count, const char *fpath,
+		const struct model_config *m, struct archive *archive,
+		int is_host, int add)
+{
+	struct json_image *image;
+	int i;
+
+	if (!fpath)
+		return NULL;
+	for (i = 0; i < *count; i++) {
+		image = &images[i];
+		if (image->is_host == is_host && !strcmp(image->fpath, fpath) &&
+		    (!is_host || same_patches(image->model, m)))
+			return image;
+	}
+	if (!add)
+		return NULL;
+	image = &images[(*count)++];
+	memset(image, 0, sizeof(*image));
+	image->fpath = fpath;
+	image->model = m;
+	image->is_host = is_host;
+	image->archive = archive;
+	return image;
+}
+
+/* Reads an image file, and keeps what print_json_image() needs of it. */
+static void read_json_image(struct json_image *entry)
 {
 	struct firmware_image image = {0};
 	const struct vb2_gbb_header *gbb = NULL;
-	if (!fpath)
-		return;
-	load_firmware_image(&image, fpath, archive);
-	if (is_host)
+
+	load_firmware_image(&image, entry->fpath, entry->archive);
+	if (image.ro_version)
+		entry->ro_version = strdup(image.ro_version);
+	if (image.rw_version_a)
+		entry->rw_version = strdup(image.rw_version_a);
+	if (entry->is_host) {
 		gbb = find_gbb(&image);
-	else
+		if (patch_image_by_model(&image, entry->model,
+					 entry->archive) != 0) {
+			entry->patch_failed = 1;
+		} else {
+			entry->has_keys = 1;
+			get_gbb_key_hash(gbb, gbb ? gbb->rootkey_offset : 0,
+					 gbb ? gbb->rootkey_size : 0,
+					 entry->root_key);
+			get_gbb_key_hash(gbb, gbb ? gbb->recovery_key_offset : 0,
+					 gbb ? gbb->recovery_key_size : 0,
+					 entry->recovery_key);
+		}
+	}
+	free_firmware_image(&image);
+}
+
+static void *json_image_worker(void *arg)
+{
+	for (;;) {
+		int i;
+
+		pthread_mutex_lock(&json_images_lock);
+		i = json_images_next++;
+		pthread_mutex_unlock(&json_images_lock);
+		if (i >= json_images_count)
+			break;
+		read_json_image(&json_images[i]);
+	}
+	return NULL;
+}
+
+/* Reads all the images, a few at a time. */
+static void read_json_images(struct json_image *images, int count)
+{
+	pthread_t threads[MAX_JSON_JOBS];
+	long max = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, started = 0;
+
+	if (max > MAX_JSON_JOBS)
+		max = MAX_JSON_JOBS;
+
+	json_images = images;
+	json_images_count = count;
+	json_images_next = 0;
+
+	/* This thread is one of the workers, too */
+	for (i = 1; i < max && i < count; i++) {
+		if (pthread_create(&threads[started], NULL, json_image_worker,
+				   NULL))
+			break;
+		started++;
+	}
+	json_image_worker(NULL);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
+/* Prints the information of given image file in JSON format. */
+static void print_json_image(const char *name, const struct json_image *image,
+			     const struct model_config *m, int indent)
+{
+	if (!image)
+		return;
+	if (!image->is_host)
 		printf(",\n");
 	printf("%*s\"%s\": { \"versions\": { \"ro\": \"%s\", \"rw\": \"%s\" },",
-	       indent, "", name, image.ro_version, image.rw_version_a);
+	       indent, "", name, image->ro_version, image->rw_version);
 	indent += 2;
-	if (is_host && patch_image_by_model(&image, m, archive) != 0) {
+	if (image->patch_failed) {
 		ERROR("Failed to patch images by model: %s\n", m->name);
-	} else if (gbb) {
+	} else if (image->has_keys) {
 		printf("\n%*s\"keys\": { \"root\": \"%s\", ",
-		       indent, "",
-		       get_gbb_key_hash(gbb, gbb->rootkey_offset,
-					gbb->rootkey_size));
-		printf("\"recovery\": \"%s\" },",
-		       get_gbb_key_hash(gbb, gbb->recovery_key_offset,
-					gbb->recovery_key_size));
-	}
-	printf("\n%*s\"image\": \"%s\" }", indent, "", fpath);
-	free_firmware_image(&image);
+		       indent, "", image->root_key);
+		printf("\"recovery\": \"%s\" },", image->recovery_key);
+	}
+	printf("\n%*s\"image\": \"%s\" }", indent, "", image->fpath);
 }
 
 /* Prints the information of objects in manifest (models and images) in JSON. */
 void print_json_manifest(const struct manifest *manifest)
 {
-	int i, indent;
+	int i, indent, count = 0;
 	struct archive *ar = manifest->archive;
+	struct json_image *images;
+
+	/* Read each distinct image once, before printing anything */
+	images = calloc(manifest->num * 3, sizeof(*images));
+	if (!images) {
+		ERROR("Internal error: memory allocation error.\n");
+		return;
+	}
+	for (i = 0; i < manifest->num; i++) {
+		struct model_config *m = &manifest->models[i];
+		find_json_image(images, &count, m->image, m, ar, 1, 1);
+		find_json_image(images, &count, m->ec_image, m, ar, 0, 1);
+		find_json_image(images, &count, m->pd_image, m, ar, 0, 1);
+	}
+	VB2_DEBUG("%d distinct image(s) for %d model(s).\n", count,
+		  manifest->num);
+	read_json_images(images, count);
 
 	printf("{\n");
 	for (i = 0, indent = 2; i < manifest->num; i++) {
 		struct model_config *m = &manifest->models[i];
 		printf("%s%*s\"%s\": {\n", i ? ",\n" : "", indent, "", m->name);
 		indent += 2;
-		print_json_image("host", m->image, m, ar, indent, 1);
-		print_json_image("ec", m->ec_image, m, ar, indent, 0);
-		print_json_image("pd", m->pd_image, m, ar, indent, 0);
+		print_json_image("host", find_json_image(
+				images, &count, m->image, m, ar, 1, 0),
+				m, indent);
+		print_json_image("ec", find_json_image(
+				images, &count, m->ec_image, m, ar, 0, 0),
+				m, indent);
+		print_json_image("pd", find_json_image(
+				images, &count, m->pd_image, m, ar, 0, 0),
+				m, indent);
 		if (m->patches.rootkey) {
 			struct patch_config *p = &m->patches;
 			printf(",\n%*s\"patches\": { \"rootkey\": \"%s\", "
@@ -1082,4 +1681,10 @@ void print_json_manifest(const struct manifest *manifest)
 		assert(indent == 2);
 	}
 	printf("\n}\n");
+
+	for (i = 0; i < count; i++) {
+		free(images[i].ro_version);
+		free(images[i].rw_version);
+	}
+	free(images);
 }
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * A reader for CBFS (coreboot file system) sections of firmware images, so
+ * the updater can look up files without running cbfstool on a temp file.
+ *
+ * The first lookup in a section walks it once and keeps the list of files
+ * with the image; later lookups in the same section only search that list.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "updater.h"
+
+#define CBFS_FILE_MAGIC "LARCHIVE"
+#define CBFS_ALIGNMENT 64
+#define CBFS_FILE_ATTR_TAG_COMPRESSION 0x42435a4c
+#define CBFS_FILE_ATTR_TAG_HASH 0x68736148
+
+/* Header of a file in CBFS; all fields are big endian. */
+struct cbfs_file {
+	char magic[8];
+	uint32_t len;
+	uint32_t type;
+	uint32_t attributes_offset;
+	uint32_t offset;
+	char filename[];
+};
+
+/* Files of one CBFS section, as found by read_cbfs_directory(). */
+struct cbfs_directory {
+	struct cbfs_directory *next;
+	char section_name[FMAP_NAMELEN + 1];
+	const uint8_t *base;	/* Section the files were read from */
+	size_t size;
+	int num_files;
+	struct cbfs_file_info *files;
+};
+
+static uint32_t read_be32(const void *p)
+{
+	const uint8_t *b = p;
+	return (uint32_t)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+}
+
+/*
+ * Returns non-zero if the CBFS file at 'file' (with header size 'offset')
+ * has attributes that stop its contents from being used or changed as raw
+ * bytes, for example compression or a hash.
+ */
+static int cbfs_file_is_encoded(const uint8_t *file, uint32_t offset)
+{
+	uint32_t pos = read_be32(file + offsetof(struct cbfs_file,
+						 attributes_offset));
+
+	if (!pos)
+		return 0;
+	while (pos + 8 <= offset) {
+		uint32_t tag = read_be32(file + pos),
+			 len = read_be32(file + pos + 4);
+
+		if (tag == CBFS_FILE_ATTR_TAG_HASH)
+			return 1;
+		if (tag == CBFS_FILE_ATTR_TAG_COMPRESSION &&
+		    (len < 12 || read_be32(file + pos + 8)))
+			return 1;
+		if (len < 8)
+			break;
+		pos += len;
+	}
+	return 0;
+}
+
+/*
+ * Walks the files in a CBFS section. A section without CBFS gives an empty
+ * directory.
+ * Returns a new directory, or NULL if out of memory.
+ */
+static struct cbfs_directory *read_cbfs_directory(
+		const struct firmware_section *section,
+		const char *section_name)
+{
+	struct cbfs_directory *dir = calloc(1, sizeof(*dir));
+	int max_files = 0;
+	size_t pos = 0;
+
+	if (!dir)
+		return NULL;
+	strncpy(dir->section_name, section_name, FMAP_NAMELEN);
+	dir->base = section->data;
+	dir->size = section->size;
+
+	while (pos + sizeof(struct cbfs_file) <= section->size) {
+		uint8_t *file = section->data + pos;
+		const struct cbfs_file *hdr = (const struct cbfs_file *)file;
+		struct cbfs_file_info *info;
+		uint32_t len, start;
+
+		if (memcmp(hdr->magic, CBFS_FILE_MAGIC, sizeof(hdr->magic))) {
+			pos += CBFS_ALIGNMENT;
+			continue;
+		}
+		len = read_be32(file + offsetof(struct cbfs_file, len));
+		start = read_be32(file + offsetof(struct cbfs_file, offset));
+		if (start < sizeof(*hdr) || start > section->size - pos ||
+		    len > section->size - pos - start)
+			break;
+
+		/* A name that isn't terminated can't be looked up. */
+		if (strnlen(hdr->filename, start - sizeof(*hdr)) <
+		    start - sizeof(*hdr)) {
+			if (dir->num_files == max_files) {
+				int new_max = max_files ? max_files * 2 : 16;
+				struct cbfs_file_info *files = realloc(
+					dir->files, new_max * sizeof(*files));
+				if (!files) {
+					free(dir->files);
+					free(dir);
+					return NULL;
+				}
+				dir->files = files;
+				max_files = new_max;
+			}
+			info = &dir->files[dir->num_files++];
+			info->name = hdr->filename;
+			info->type = read_be32(
+				file + offsetof(struct cbfs_file, type));
+			info->data = file + start;
+			info->offset = pos + start;
+			info->size = len;
+			info->is_encoded = cbfs_file_is_encoded(file, start);
+		}
+		pos += ((size_t)start + len + CBFS_ALIGNMENT - 1) &
+			~(CBFS_ALIGNMENT - 1);
+	}
+
+	VB2_DEBUG("Found %d files in CBFS %s.\n", dir->num_files,
+		  section_name);
+	return dir;
+}
+
+const struct cbfs_file_info *updater_cbfs_find(struct firmware_image *image,
+					       const char *section_name,
+					       const char *file_name)
+{
+	struct firmware_section section;
+	struct cbfs_directory *dir;
+	int i;
+
+	find_firmware_section(&section, image, section_name);
+	if (!section.data)
+		return NULL;
+
+	for (dir = image->cbfs_dirs; dir; dir = dir->next) {
+		if (dir->base == section.data && dir->size == section.size &&
+		    !strncmp(dir->section_name, section_name, FMAP_NAMELEN))
+			break;
+	}
+	if (!dir) {
+		dir = read_cbfs_directory(&section, section_name);
+		if (!dir)
+			return NULL;
+		dir->next = image->cbfs_dirs;
+		image->cbfs_dirs = dir;
+	}
+
+	for (i = 0; i < dir->num_files; i++) {
+		if (!strcmp(dir->files[i].name, file_name))
+			return &dir->files[i];
+	}
+	return NULL;
+}
+
+void updater_cbfs_forget(struct firmware_image *image)
+{
+	while (image->cbfs_dirs) {
+		struct cbfs_directory *dir = image->cbfs_dirs;
+
+		image->cbfs_dirs = dir->next;
+		free(dir->files);
+		free(dir);
+	}
+}
@@ -0,0 +1,803 @@
+/*
+ * Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Access to the flash chips through flashrom for the firmware updater.
+ *
+ * Each programmer gets one session, opened on first use and kept until
+ * updater_flashrom_close_all(). When futility is linked with libflashrom
+ * (make USE_LIBFLASHROM=1) the session holds the probed chip open, so reads,
+ * writes and WP queries are plain function calls. Otherwise every operation
+ * runs the flashrom(8) command, and the session only saves repeated reads and
+ * WP queries.
+ *
+ * Sessions may be used from several threads, one thread per programmer, and
+ * several updater configs may have sessions at once. Commands run
+ * concurrently; calls into libflashrom, which has global state, take turns.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBFLASHROM
+#include <libflashrom.h>
+#endif
+
+#include "2common.h"
+#include "futility.h"
+#include "host_misc.h"
+#include "updater.h"
+
+#define FLASHROM_OUTPUT_WP_PATTERN "write protect is "
+
+static const char * const FLASHROM_OUTPUT_WP_ENABLED =
+			  FLASHROM_OUTPUT_WP_PATTERN "enabled",
+		  * const FLASHROM_OUTPUT_WP_DISABLED =
+			  FLASHROM_OUTPUT_WP_PATTERN "disabled";
+
+struct flashrom_session;
+
+struct flashrom_backend {
+	const char *name;
+	/* Whether operations may run at the same time as others. */
+	int concurrent;
+	/* Returns 0 on success, otherwise failure. */
+	int (*open)(struct flashrom_session *session);
+	/* Reads the whole chip to a new buffer. Returns 0 on success. */
+	int (*read)(struct flashrom_session *session,
+		    uint8_t **data, uint32_t *size);
+	/*
+	 * Reads only the given byte ranges, into a new buffer the size of
+	 * the chip. Returns 0 on success.
+	 */
+	int (*read_ranges)(struct flashrom_session *session,
+			   const struct flash_range *ranges, int num_ranges,
+			   uint8_t **data, uint32_t *size);
+	/*
+	 * Writes the given FMAP region, or the given byte ranges, or the
+	 * whole chip if there is neither.
+	 * If diff is not NULL, it is the current chip contents (same size as
+	 * data) and only the changed blocks need to be written.
+	 * Byte ranges and diff writes aren't verified by flashrom; ranges are
+	 * read back by updater_flashrom_write_ranges() instead.
+	 * Returns 0 on success.
+	 */
+	int (*write)(struct flashrom_session *session,
+		     const uint8_t *data, uint32_t size,
+		     const char *region, const struct flash_range *ranges,
+		     int num_ranges, const uint8_t *diff);
+	/* Returns WP_ENABLED, WP_DISABLED or -1 on error. */
+	int (*wp_status)(struct flashrom_session *session);
+	void (*close)(struct flashrom_session *session);
+};
+
+struct flashrom_session {
+	const struct flashrom_backend *backend;
+	struct updater_config *cfg;
+	char *programmer;
+	void *priv;
+	/* Contents from the last read, until the next write. */
+	uint8_t *image;
+	uint32_t image_size;
+	/* Cached WP status; -1 if not queried yet (or failed). */
+	int wp_status;
+	struct flashrom_session *next;
+};
+
+/* Appends the flashrom verbosity flags to a command. */
+static const char *verbosity_postfix(int verbose)
+{
+	switch (verbose) {
+	case 0:
+		return " >/dev/null 2>&1";
+	case 1:
+		return "";
+	case 2:
+		return "-V";
+	case 3:
+		return "-V -V";
+	default:
+		return "-V -V -V";
+	}
+}
+
+/*
+ * Runs a flashrom(8) command for an operation on image_path.
+ * Returns 0 if success, non-zero if error.
+ */
+static int flashrom_command(struct flashrom_session *session,
+			    const char *op_cmd, const char *image_path,
+			    int verbose, const char *region, const char *extra)
+{
+	char *command;
+	const char *dash_i = "-i";
+	int r;
+
+	if (!region || !*region) {
+		dash_i = "";
+		region = "";
+	}
+	if (!extra)
+		extra = "";
+
+	ASPRINTF(&command, "flashrom %s %s -p %s %s %s %s %s", op_cmd,
+		 image_path, session->programmer, dash_i, region, extra,
+		 verbosity_postfix(verbose));
+
+	if (verbose)
+		INFO("Executing: %s\n", command);
+
+	r = system(command);
+	free(command);
+	if (r)
+		ERROR("Error code: %d\n", r);
+	return r;
+}
+
+static int command_open(struct flashrom_session *session)
+{
+	return 0;
+}
+
+static int command_read(struct flashrom_session *session,
+			uint8_t **data, uint32_t *size)
+{
+	const char *tmp_file = updater_create_temp_file(session->cfg);
+
+	if (!tmp_file)
+		return -1;
+	if (flashrom_command(session, "-r", tmp_file, session->cfg->verbosity,
+			     NULL, NULL))
+		return -1;
+	if (vb2_read_file(tmp_file, data, size) != VB2_SUCCESS) {
+		ERROR("Cannot read flashrom output: %s\n", tmp_file);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Writes a flashrom layout file with one region per range, named
+ * "range0", "range1", ... and returns the "-l FILE -i range0 ..." arguments
+ * to use it. The caller must free the returned string.
+ * Returns NULL on failure.
+ */
+static char *command_write_layout(struct updater_config *cfg,
+				  const struct flash_range *ranges,
+				  int num_ranges)
+{
+	const char *layout_file = updater_create_temp_file(cfg);
+	char *args, *new_args;
+	FILE *fp;
+	int i;
+
+	if (!layout_file)
+		return NULL;
+	fp = fopen(layout_file, "w");
+	if (!fp) {
+		ERROR("Cannot write layout file: %s\n", layout_file);
+		return NULL;
+	}
+	ASPRINTF(&args, "-l %s", layout_file);
+	for (i = 0; i < num_ranges; i++) {
+		fprintf(fp, "%08x:%08x range%d\n", ranges[i].offset,
+			ranges[i].offset + ranges[i].size - 1, i);
+		ASPRINTF(&new_args, "%s -i range%d", args, i);
+		free(args);
+		args = new_args;
+	}
+	if (fclose(fp)) {
+		ERROR("Cannot write layout file: %s\n", layout_file);
+		free(args);
+		return NULL;
+	}
+	return args;
+}
+
+static int command_read_ranges(struct flashrom_session *session,
+			       const struct flash_range *ranges,
+			       int num_ranges, uint8_t **data, uint32_t *size)
+{
+	const char *tmp_file = updater_create_temp_file(session->cfg);
+	char *layout;
+	int r;
+
+	if (!tmp_file)
+		return -1;
+	layout = command_write_layout(session->cfg, ranges, num_ranges);
+	if (!layout)
+		return -1;
+	r = flashrom_command(session, "-r", tmp_file, session->cfg->verbosity,
+			     NULL, layout);
+	free(layout);
+	if (r)
+		return -1;
+	if (vb2_read_file(tmp_file, data, size) != VB2_SUCCESS) {
+		ERROR("Cannot read flashrom output: %s\n", tmp_file);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Finds the temp file an image to write already lives in (see data_file), so
+ * it doesn't have to be copied to another one.
+ * Returns the file, or NULL if there is none.
+ */
+static const char *find_data_file(struct updater_config *cfg,
+				  const uint8_t *data, uint32_t size)
+{
+	const struct firmware_image *images[] = {
+		&cfg->image, &cfg->ec_image, &cfg->pd_image,
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(images); i++) {
+		if (images[i]->data_file && images[i]->data == data &&
+		    images[i]->size == size)
+			return images[i]->data_file;
+	}
+	return NULL;
+}
+
+static int command_write(struct flashrom_session *session,
+			 const uint8_t *data, uint32_t size,
+			 const char *region, const struct flash_range *ranges,
+			 int num_ranges, const uint8_t *diff)
+{
+	struct updater_config *cfg = session->cfg;
+	const char *tmp_file = find_data_file(cfg, data, size);
+	const char *tmp_diff_file = NULL;
+	char *layout = NULL, *extra = NULL;
+	int noverify = diff || num_ranges;
+	int r;
+
+	if (tmp_file) {
+		VB2_DEBUG("Writing %s as it is.\n", tmp_file);
+	} else {
+		tmp_file = updater_create_temp_file(cfg);
+		if (!tmp_file)
+			return -1;
+		if (vb2_write_file(tmp_file, data, size) != VB2_SUCCESS) {
+			ERROR("Cannot write temporary file for output: %s\n",
+			      tmp_file);
+			return -1;
+		}
+	}
+	if (num_ranges) {
+		layout = command_write_layout(cfg, ranges, num_ranges);
+		if (!layout)
+			return -1;
+	}
+	if (diff) {
+		tmp_diff_file = updater_create_temp_file(cfg);
+		if (!tmp_diff_file ||
+		    vb2_write_file(tmp_diff_file, diff, size) != VB2_SUCCESS) {
+			ERROR("Cannot write temporary file for diff image\n");
+			free(layout);
+			return -1;
+		}
+	}
+	ASPRINTF(&extra, "%s%s%s%s%s", layout ? layout : "",
+		 layout && noverify ? " " : "", noverify ? "--noverify" : "",
+		 diff ? " --diff=" : "", diff ? tmp_diff_file : "");
+	r = flashrom_command(session, "-w", tmp_file, cfg->verbosity + 1,
+			     region, extra);
+	free(layout);
+	free(extra);
+	return r;
+}
+
+static int command_wp_status(struct flashrom_session *session)
+{
+	char *command, *result;
+	int r;
+
+	/* grep is needed because host_shell only returns 1 line. */
+	ASPRINTF(&command, "flashrom --wp-status -p %s 2>/dev/null | "
+		 "grep \"" FLASHROM_OUTPUT_WP_PATTERN "\"",
+		 session->programmer);
+	result = host_shell(command);
+	free(command);
+	VB2_DEBUG("wp-status: %s\n", result);
+
+	if (strstr(result, FLASHROM_OUTPUT_WP_ENABLED))
+		r = WP_ENABLED;
+	else if (strstr(result, FLASHROM_OUTPUT_WP_DISABLED))
+		r = WP_DISABLED;
+	else
+		r = -1;
+	free(result);
+	return r;
+}
+
+static void command_close(struct flashrom_session *session)
+{
+}
+
+static const struct flashrom_backend command_backend = {
+	.name = "flashrom(8)",
+	.concurrent = 1,
+	.open = command_open,
+	.read = command_read,
+	.read_ranges = command_read_ranges,
+	.write = command_write,
+	.wp_status = command_wp_status,
+	.close = command_close,
+};
+
+#ifdef HAVE_LIBFLASHROM
+
+struct libflashrom_priv {
+	struct flashrom_programmer *prog;
+	struct flashrom_flashctx *flash;
+};
+
+/* libflashrom has global state, so only initialize it once. */
+static int libflashrom_users;
+
+/* Verbosity of the session doing the current operation. */
+static int libflashrom_verbosity;
+
+static int libflashrom_log(enum flashrom_log_level level, const char *format,
+			   va_list args)
+{
+	/* Quiet at verbosity 0, like the command; more for each level. */
+	int max_level = libflashrom_verbosity ?
+			FLASHROM_MSG_INFO + libflashrom_verbosity - 1 :
+			FLASHROM_MSG_ERROR;
+
+	if ((int)level > max_level)
+		return 0;
+	return vfprintf(stderr, format, args);
+}
+
+static int libflashrom_open(struct flashrom_session *session)
+{
+	struct libflashrom_priv *priv;
+	char *name, *params;
+
+	priv = calloc(1, sizeof(*priv));
+	name = strdup(session->programmer);
+	if (!priv || !name) {
+		free(priv);
+		free(name);
+		return -1;
+	}
+
+	/* "name:params" as for flashrom -p. */
+	params = strchr(name, ':');
+	if (params)
+		*params++ = '\0';
+
+	libflashrom_verbosity = session->cfg->verbosity;
+	if (!libflashrom_users++) {
+		flashrom_set_log_callback(libflashrom_log);
+		if (flashrom_init(1)) {
+			ERROR("Failed to initialize libflashrom.\n");
+			goto fail;
+		}
+	}
+	if (flashrom_programmer_init(&priv->prog, name, params)) {
+		ERROR("Failed to initialize programmer %s.\n",
+		      session->programmer);
+		goto fail;
+	}
+	if (flashrom_flash_probe(&priv->flash, priv->prog, NULL)) {
+		ERROR("No flash chip found on %s.\n", session->programmer);
+		flashrom_programmer_shutdown(priv->prog);
+		goto fail;
+	}
+
+	free(name);
+	session->priv = priv;
+	return 0;
+
+fail:
+	if (!--libflashrom_users)
+		flashrom_shutdown();
+	free(name);
+	free(priv);
+	return -1;
+}
+
+static int libflashrom_read(struct flashrom_session *session,
+			    uint8_t **data, uint32_t *size)
+{
+	struct libflashrom_priv *priv = session->priv;
+	size_t len = flashrom_flash_getsize(priv->flash);
+
+	*data = malloc(len);
+	if (!*data)
+		return -1;
+
+	libflashrom_verbosity = session->cfg->verbosity;
+	if (flashrom_image_read(priv->flash, *data, len)) {
+		ERROR("Failed to read flash from %s.\n", session->programmer);
+		free(*data);
+		*data = NULL;
+		return -1;
+	}
+	*size = len;
+	return 0;
+}
+
+/*
+ * Creates a layout with the given ranges included.
+ * Returns 0 on success, otherwise failure.
+ */
+static int libflashrom_ranges_layout(struct flashrom_layout **layout,
+				     const struct flash_range *ranges,
+				     int num_ranges)
+{
+	char name[32];
+	int i;
+
+	if (flashrom_layout_new(layout))
+		return -1;
+	for (i = 0; i < num_ranges; i++) {
+		snprintf(name, sizeof(name), "range%d", i);
+		if (flashrom_layout_add_region(
+				*layout, ranges[i].offset,
+				ranges[i].offset + ranges[i].size - 1, name) ||
+		    flashrom_layout_include_region(*layout, name))
+			return -1;
+	}
+	return 0;
+}
+
+static int libflashrom_read_ranges(struct flashrom_session *session,
+				   const struct flash_range *ranges,
+				   int num_ranges, uint8_t **data,
+				   uint32_t *size)
+{
+	struct libflashrom_priv *priv = session->priv;
+	struct flashrom_layout *layout = NULL;
+	int r;
+
+	if (libflashrom_ranges_layout(&layout, ranges, num_ranges)) {
+		ERROR("Cannot create flash layout.\n");
+		flashrom_layout_release(layout);
+		return -1;
+	}
+	flashrom_layout_set(priv->flash, layout);
+	r = libflashrom_read(session, data, size);
+	flashrom_layout_set(priv->flash, NULL);
+	flashrom_layout_release(layout);
+	return r;
+}
+
+static int libflashrom_write(struct flashrom_session *session,
+			     const uint8_t *data, uint32_t size,
+			     const char *region,
+			     const struct flash_range *ranges, int num_ranges,
+			     const uint8_t *diff)
+{
+	struct libflashrom_priv *priv = session->priv;
+	struct flashrom_layout *layout = NULL;
+	int r;
+
+	libflashrom_verbosity = session->cfg->verbosity + 1;
+	if (region) {
+		if (flashrom_layout_read_fmap_from_buffer(
+				&layout, priv->flash, data, size) ||
+		    flashrom_layout_include_region(layout, region)) {
+			ERROR("Cannot find region %s in image.\n", region);
+			flashrom_layout_release(layout);
+			return -1;
+		}
+		flashrom_layout_set(priv->flash, layout);
+	} else if (num_ranges) {
+		if (libflashrom_ranges_layout(&layout, ranges, num_ranges)) {
+			ERROR("Cannot create flash layout.\n");
+			flashrom_layout_release(layout);
+			return -1;
+		}
+		flashrom_layout_set(priv->flash, layout);
+	}
+
+	/* Like --noverify for the command. */
+	flashrom_flag_set(priv->flash, FLASHROM_FLAG_VERIFY_AFTER_WRITE,
+			  !diff && !num_ranges);
+	r = flashrom_image_write(priv->flash, (void *)data, size, diff);
+	if (r)
+		ERROR("Failed to write %s to %s (%d).\n",
+		      region ? region : "image", session->programmer, r);
+
+	flashrom_layout_set(priv->flash, NULL);
+	flashrom_layout_release(layout);
+	return r;
+}
+
+static int libflashrom_wp_status(struct flashrom_session *session)
+{
+	struct libflashrom_priv *priv = session->priv;
+	struct flashrom_wp_cfg *wp_cfg;
+	int r = -1;
+
+	if (flashrom_wp_cfg_new(&wp_cfg) != FLASHROM_WP_OK)
+		return -1;
+	if (flashrom_wp_read_cfg(wp_cfg, priv->flash) == FLASHROM_WP_OK)
+		r = flashrom_wp_get_mode(wp_cfg) == FLASHROM_WP_MODE_DISABLED ?
+			WP_DISABLED : WP_ENABLED;
+	flashrom_wp_cfg_release(wp_cfg);
+	return r;
+}
+
+static void libflashrom_close(struct flashrom_session *session)
+{
+	struct libflashrom_priv *priv = session->priv;
+
+	flashrom_flash_release(priv->flash);
+	flashrom_programmer_shutdown(priv->prog);
+	if (!--libflashrom_users)
+		flashrom_shutdown();
+	free(priv);
+	session->priv = NULL;
+}
+
+static const struct flashrom_backend libflashrom_backend = {
+	.name = "libflashrom",
+	.open = libflashrom_open,
+	.read = libflashrom_read,
+	.read_ranges = libflashrom_read_ranges,
+	.write = libflashrom_write,
+	.wp_status = libflashrom_wp_status,
+	.close = libflashrom_close,
+};
+
+#endif  /* HAVE_LIBFLASHROM */
+
+/* Protects cfg->flashrom_sessions. */
+static pthread_mutex_t sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Held by operations on backends that can't run concurrently. */
+static pthread_mutex_t backend_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void lock_backend(const struct flashrom_backend *backend)
+{
+	if (!backend->concurrent)
+		pthread_mutex_lock(&backend_lock);
+}
+
+static void unlock_backend(const struct flashrom_backend *backend)
+{
+	if (!backend->concurrent)
+		pthread_mutex_unlock(&backend_lock);
+}
+
+/* Opens a session with a backend. Returns 0 on success. */
+static int open_session(struct flashrom_session *session,
+			const struct flashrom_backend *backend)
+{
+	int r;
+
+	session->backend = backend;
+	VB2_DEBUG("Opening %s with %s.\n", session->programmer, backend->name);
+	lock_backend(backend);
+	r = backend->open(session);
+	unlock_backend(backend);
+	return r;
+}
+
+/*
+ * Finds the session for a programmer, opening a new one if needed.
+ * Returns the session, or NULL on failure.
+ */
+static struct flashrom_session *get_session(struct updater_config *cfg,
+					    const char *programmer)
+{
+	struct flashrom_session *session;
+
+	pthread_mutex_lock(&sessions_lock);
+	for (session = cfg->flashrom_sessions; session;
+	     session = session->next) {
+		if (!strcmp(session->programmer, programmer))
+			goto done;
+	}
+
+	session = calloc(1, sizeof(*session));
+	if (!session)
+		goto done;
+	session->programmer = strdup(programmer);
+	if (!session->programmer) {
+		free(session);
+		session = NULL;
+		goto done;
+	}
+	session->cfg = cfg;
+	session->wp_status = -1;
+
+#ifdef HAVE_LIBFLASHROM
+	/*
+	 * The installed flashrom(8) may support programmers that the
+	 * library doesn't, so fall back to it.
+	 */
+	if (open_session(session, &libflashrom_backend))
+#endif
+	{
+		if (open_session(session, &command_backend)) {
+			free(session->programmer);
+			free(session);
+			session = NULL;
+			goto done;
+		}
+	}
+	session->next = cfg->flashrom_sessions;
+	cfg->flashrom_sessions = session;
+done:
+	pthread_mutex_unlock(&sessions_lock);
+	return session;
+}
+
+int updater_flashrom_read(struct updater_config *cfg, const char *programmer,
+			  uint8_t **data, uint32_t *size)
+{
+	struct flashrom_session *session = get_session(cfg, programmer);
+
+	if (!session)
+		return -1;
+
+	if (!session->image) {
+		int r;
+
+		lock_backend(session->backend);
+		r = session->backend->read(session, &session->image,
+					   &session->image_size);
+		unlock_backend(session->backend);
+		if (r)
+			return -1;
+	} else {
+		VB2_DEBUG("Reusing contents of %s.\n", programmer);
+	}
+
+	*data = malloc(session->image_size);
+	if (!*data)
+		return -1;
+	memcpy(*data, session->image, session->image_size);
+	*size = session->image_size;
+	return 0;
+}
+
+int updater_flashrom_read_ranges(struct updater_config *cfg,
+				 const char *programmer,
+				 const struct flash_range *ranges,
+				 int num_ranges, uint8_t **data,
+				 uint32_t *size)
+{
+	struct flashrom_session *session = get_session(cfg, programmer);
+	int r;
+
+	assert(num_ranges > 0);
+	if (!session)
+		return -1;
+
+	/* Whole contents from an earlier read do just as well. */
+	if (session->image)
+		return updater_flashrom_read(cfg, programmer, data, size);
+
+	lock_backend(session->backend);
+	r = session->backend->read_ranges(session, ranges, num_ranges, data,
+					  size);
+	unlock_backend(session->backend);
+	return r;
+}
+
+static int session_write(struct updater_config *cfg, const char *programmer,
+			 const uint8_t *data, uint32_t size,
+			 const char *region, const struct flash_range *ranges,
+			 int num_ranges, const uint8_t *diff)
+{
+	struct flashrom_session *session = get_session(cfg, programmer);
+	int r;
+
+	if (!session)
+		return -1;
+
+	/* Whatever happens, the chip may not match the last read now. */
+	free(session->image);
+	session->image = NULL;
+	session->image_size = 0;
+
+	lock_backend(session->backend);
+	r = session->backend->write(session, data, size, region, ranges,
+				    num_ranges, diff);
+	unlock_backend(session->backend);
+	return r;
+}
+
+int updater_flashrom_write(struct updater_config *cfg, const char *programmer,
+			   const uint8_t *data, uint32_t size,
+			   const char *region, const uint8_t *diff)
+{
+	return session_write(cfg, programmer, data, size, region, NULL, 0,
+			     diff);
+}
+
+/*
+ * Reads back the given ranges after they were written, and compares them with
+ * data, instead of having flashrom verify the whole chip.
+ * Returns 0 if they all match, otherwise failure.
+ */
+static int verify_ranges(struct updater_config *cfg, const char *programmer,
+			 const uint8_t *data, uint32_t size,
+			 const struct flash_range *ranges, int num_ranges)
+{
+	uint8_t *readback;
+	uint32_t readback_size;
+	int i, r = 0;
+
+	if (updater_flashrom_read_ranges(cfg, programmer, ranges, num_ranges,
+					 &readback, &readback_size)) {
+		ERROR("Cannot read back %s to verify.\n", programmer);
+		return -1;
+	}
+	if (readback_size != size) {
+		ERROR("Read back %u bytes from %s, expected %u.\n",
+		      readback_size, programmer, size);
+		r = -1;
+	}
+	for (i = 0; !r && i < num_ranges; i++) {
+		if (!memcmp(readback + ranges[i].offset,
+			    data + ranges[i].offset, ranges[i].size))
+			continue;
+		ERROR("Verifying %u bytes at %#x on %s failed.\n",
+		      ranges[i].size, ranges[i].offset, programmer);
+		r = -1;
+	}
+	free(readback);
+	return r;
+}
+
+int updater_flashrom_write_ranges(struct updater_config *cfg,
+				  const char *programmer,
+				  const uint8_t *data, uint32_t size,
+				  const struct flash_range *ranges,
+				  int num_ranges, const uint8_t *diff)
+{
+	assert(num_ranges > 0);
+	if (session_write(cfg, programmer, data, size, NULL, ranges,
+			  num_ranges, diff))
+		return -1;
+	return verify_ranges(cfg, programmer, data, size, ranges, num_ranges);
+}
+
+int updater_flashrom_wp_status(struct updater_config *cfg,
+			       const char *programmer)
+{
+	struct flashrom_session *session = get_session(cfg, programmer);
+
+	if (!session)
+		return -1;
+
+	if (session->wp_status < 0) {
+		lock_backend(session->backend);
+		session->wp_status = session->backend->wp_status(session);
+		unlock_backend(session->backend);
+	}
+	return session->wp_status;
+}
+
+void updater_flashrom_close_all(struct updater_config *cfg)
+{
+	struct flashrom_session *session = cfg->flashrom_sessions;
+
+	while (session) {
+		struct flashrom_session *next = session->next;
+
+		VB2_DEBUG("Closing %s.\n", session->programmer);
+		lock_backend(session->backend);
+		session->backend->close(session);
+		unlock_backend(session->backend);
+		free(session->image);
+		free(session->programmer);
+		free(session);
+		session = next;
+	}
+	cfg->flashrom_sessions = NULL;
+}
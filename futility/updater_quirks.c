@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -86,30 +87,36 @@ static int quirk_enlarge_image(struct updater_config *cfg)
 {
 	struct firmware_image *image_from = &cfg->image_current,
 			      *image_to = &cfg->image;
-	const char *tmp_path;
-	size_t to_write;
-	FILE *fp;
+	size_t fmap_offset;
+	uint8_t *data;
 
 	if (image_from->size <= image_to->size)
 		return 0;
 
-	tmp_path = updater_create_temp_file(cfg);
-	if (!tmp_path)
-		return -1;
-
 	VB2_DEBUG("Resize image from %u to %u.\n",
 		  image_to->size, image_from->size);
-	to_write = image_from->size - image_to->size;
-	write_image(tmp_path, image_to);
-	fp = fopen(tmp_path, "ab");
-	if (!fp) {
-		ERROR("Cannot open temporary file %s.\n", tmp_path);
+	data = malloc(image_from->size);
+	if (!data) {
+		ERROR("Cannot allocate %u bytes.\n", image_from->size);
 		return -1;
 	}
-	while (to_write-- > 0)
-		fputc('\xff', fp);
-	fclose(fp);
-	return reload_firmware_image(tmp_path, image_to);
+	memcpy(data, image_to->data, image_to->size);
+	memset(data + image_to->size, 0xff, image_from->size - image_to->size);
+
+	/* The versions stay the same; only the FMAP moves with the data. */
+	fmap_offset = (uint8_t *)image_to->fmap_header - image_to->data;
+	if (image_to->is_mapped)
+		munmap(image_to->data, image_to->size);
+	else
+		free(image_to->data);
+	updater_cbfs_forget(image_to);
+	updater_vpd_forget(image_to);
+	image_to->data = data;
+	image_to->size = image_from->size;
+	image_to->is_mapped = 0;
+	image_to->data_file = NULL;
+	image_to->fmap_header = (FmapHeader *)(data + fmap_offset);
+	return 0;
 }
 
 /*
@@ -218,7 +225,7 @@ static int quirk_daisy_snow_dual_model(struct updater_config *cfg)
 		"MPx16",  /* Rev 4 */
 		"MP2",  /* Rev 5 */
 	};
-	char *platform_version = host_shell("mosys platform version");
+	char *platform_version = host_read_platform_version();
 
 	for (i = 0; i < ARRAY_SIZE(x8_versions) && !is_x8; i++) {
 		if (strcmp(x8_versions[i], platform_version) == 0)
@@ -275,70 +282,56 @@ static int quirk_daisy_snow_dual_model(struct updater_config *cfg)
 	return 0;
 }
 
-/*
- * Extracts files from a CBFS on given region (section) of image_file.
- * Returns the path to a temporary file on success, otherwise NULL.
- */
-static const char *extract_cbfs_file(struct updater_config *cfg,
-				     const char *image_file,
-				     const char *cbfs_region,
-				     const char *cbfs_name)
-{
-	const char *output = updater_create_temp_file(cfg);
-	char *command, *result;
-
-	ASPRINTF(&command, "cbfstool \"%s\" extract -r %s -n \"%s\" "
-		 "-f \"%s\" 2>&1", image_file, cbfs_region,
-		 cbfs_name, output);
-
-	result = host_shell(command);
-	free(command);
-
-	if (!*result)
-		output = NULL;
-
-	free(result);
-	return output;
-}
-
 /*
  * Quirk to help preserving SMM store on devices without a dedicated "SMMSTORE"
  * FMAP section. These devices will store "smm_store" file in same CBFS where
  * the legacy boot loader lives (i.e, FMAP RW_LEGACY).
- * Note this currently has dependency on external program "cbstool".
+ * The store is copied in place when the target image already has one of the
+ * same size at the fixed offset; otherwise this has dependency on external
+ * program "cbstool".
  * Returns 0 if the SMM store is properly preserved, or if the system is not
  * available to do that (problem in cbfstool, or no "smm_store" in current
  * system firmware). Otherwise non-zero as failure.
  */
 static int quirk_eve_smm_store(struct updater_config *cfg)
 {
+	/* crosreview.com/1165109: The offset is fixed at 0x1bf000. */
+	const uint32_t smm_store_offset = 0x1bf000;
 	const char *smm_store_name = "smm_store";
-	const char *temp_image = updater_create_temp_file(cfg);
-	const char *old_store;
+	const struct cbfs_file_info *old_store, *new_store;
+	const char *temp_image, *old_store_file;
 	char *command;
 
-	if (write_image(temp_image, &cfg->image_current) != VBERROR_SUCCESS)
-		return -1;
+	old_store = updater_cbfs_find(&cfg->image_current, FMAP_RW_LEGACY,
+				      smm_store_name);
+	if (!old_store || old_store->is_encoded) {
+		VB2_DEBUG("SMM store not available. Don't preserve.\n");
+		return 0;
+	}
 
-	old_store = extract_cbfs_file(cfg, temp_image, FMAP_RW_LEGACY,
+	new_store = updater_cbfs_find(&cfg->image, FMAP_RW_LEGACY,
 				      smm_store_name);
-	if (!old_store) {
-		VB2_DEBUG("cbfstool failure or SMM store not available. "
-			  "Don't preserve.\n");
+	if (new_store && !new_store->is_encoded &&
+	    new_store->offset == smm_store_offset &&
+	    new_store->size == old_store->size) {
+		VB2_DEBUG("Copying SMM store in place.\n");
+		memcpy(new_store->data, old_store->data, old_store->size);
 		return 0;
 	}
 
-	/* Reuse temp_image. */
-	if (write_image(temp_image, &cfg->image) != VBERROR_SUCCESS)
+	temp_image = updater_create_temp_file(cfg);
+	old_store_file = updater_create_temp_file(cfg);
+	if (!temp_image || !old_store_file ||
+	    vb2_write_file(old_store_file, old_store->data, old_store->size) ||
+	    write_image(temp_image, &cfg->image) != VBERROR_SUCCESS)
 		return -1;
 
-	/* crosreview.com/1165109: The offset is fixed at 0x1bf000. */
 	ASPRINTF(&command,
 		 "cbfstool \"%s\" remove -r %s -n \"%s\" 2>/dev/null; "
 		 "cbfstool \"%s\" add -r %s -n \"%s\" -f \"%s\" "
-		 " -t raw -b 0x1bf000", temp_image, FMAP_RW_LEGACY,
+		 " -t raw -b %#x", temp_image, FMAP_RW_LEGACY,
 		 smm_store_name, temp_image, FMAP_RW_LEGACY,
-		 smm_store_name, old_store);
+		 smm_store_name, old_store_file, smm_store_offset);
 	host_shell(command);
 	free(command);
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * A reader for VPD (Google VPD 2.0) sections of firmware images, so the
+ * updater can look up keys without running the vpd tool on a temp file.
+ *
+ * The first lookup in a section decodes it once and keeps its key/value
+ * strings with the image; later lookups in the same section only search
+ * that table.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "updater.h"
+
+/* Binary blob header some VPD sections start with. */
+#define VPD_INFO_SIGNATURE "gVpdInfo"
+#define VPD_INFO_HEADER_SIZE 16
+
+/* Older VPD sections start with SMBIOS tables, and keep VPD 2.0 later on. */
+#define VPD_SMBIOS_SIGNATURE "_SM_"
+#define VPD_SMBIOS_DATA_OFFSET 0x600
+
+enum vpd_type {
+	VPD_TYPE_TERMINATOR = 0x00,
+	VPD_TYPE_STRING = 0x01,
+	VPD_TYPE_INFO = 0xfe,
+	VPD_TYPE_IMPLICIT_TERMINATOR = 0xff,
+};
+
+struct vpd_entry {
+	char *key, *value;
+};
+
+/* Strings of one VPD section, as found by read_vpd_table(). */
+struct vpd_table {
+	struct vpd_table *next;
+	char section_name[FMAP_NAMELEN + 1];
+	const uint8_t *base;	/* Section the strings were read from */
+	size_t size;
+	int num_entries;
+	struct vpd_entry *entries;
+};
+
+static uint32_t read_le32(const void *p)
+{
+	const uint8_t *b = p;
+	return (uint32_t)b[3] << 24 | b[2] << 16 | b[1] << 8 | b[0];
+}
+
+/*
+ * Decodes a length, stored as big endian 7-bit groups with the top bit set
+ * on all but the last byte.
+ * Returns 0 on success, or -1 if it runs past the data or is too big.
+ */
+static int decode_length(const uint8_t *data, size_t size, size_t *pos,
+			 uint32_t *len)
+{
+	uint32_t value = 0;
+	int i;
+
+	for (i = 0; i < 4 && *pos < size; i++) {
+		uint8_t b = data[(*pos)++];
+
+		value = value << 7 | (b & 0x7f);
+		if (!(b & 0x80)) {
+			*len = value;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Decodes a length and the string after it.
+ * Returns a new ASCIIZ copy of the string, or NULL if it runs past the data
+ * or out of memory.
+ */
+static char *decode_string(const uint8_t *data, size_t size, size_t *pos)
+{
+	uint32_t len;
+	char *s;
+
+	if (decode_length(data, size, pos, &len) || len > size - *pos)
+		return NULL;
+	s = malloc(len + 1);
+	if (!s)
+		return NULL;
+	memcpy(s, data + *pos, len);
+	s[len] = '\0';
+	*pos += len;
+	return s;
+}
+
+static void free_vpd_table(struct vpd_table *table)
+{
+	int i;
+
+	for (i = 0; i < table->num_entries; i++) {
+		free(table->entries[i].key);
+		free(table->entries[i].value);
+	}
+	free(table->entries);
+	free(table);
+}
+
+/*
+ * Decodes the strings in a VPD section. Decoding stops at a terminator, or
+ * at anything that isn't VPD 2.0; the strings before it are kept.
+ * Returns a new table, or NULL if out of memory.
+ */
+static struct vpd_table *read_vpd_table(const struct firmware_section *section,
+					const char *section_name)
+{
+	struct vpd_table *table = calloc(1, sizeof(*table));
+	const uint8_t *data = section->data;
+	size_t size = section->size, pos = 0;
+	int max_entries = 0;
+
+	if (!table)
+		return NULL;
+	strncpy(table->section_name, section_name, FMAP_NAMELEN);
+	table->base = section->data;
+	table->size = section->size;
+
+	if (size >= VPD_INFO_HEADER_SIZE &&
+	    !memcmp(data, VPD_INFO_SIGNATURE, strlen(VPD_INFO_SIGNATURE))) {
+		uint32_t info_size = read_le32(data + VPD_INFO_HEADER_SIZE - 4);
+
+		data += VPD_INFO_HEADER_SIZE;
+		size -= VPD_INFO_HEADER_SIZE;
+		if (info_size < size)
+			size = info_size;
+	} else if (size > VPD_SMBIOS_DATA_OFFSET &&
+		   !memcmp(data, VPD_SMBIOS_SIGNATURE,
+			   strlen(VPD_SMBIOS_SIGNATURE))) {
+		data += VPD_SMBIOS_DATA_OFFSET;
+		size -= VPD_SMBIOS_DATA_OFFSET;
+	}
+
+	while (pos < size) {
+		uint8_t type = data[pos++];
+		struct vpd_entry entry;
+
+		if (type != VPD_TYPE_STRING && type != VPD_TYPE_INFO) {
+			if (type != VPD_TYPE_TERMINATOR &&
+			    type != VPD_TYPE_IMPLICIT_TERMINATOR)
+				WARN("Unknown type %#x in %s.\n", type,
+				     section_name);
+			break;
+		}
+		entry.key = decode_string(data, size, &pos);
+		entry.value = entry.key ? decode_string(data, size, &pos) :
+			NULL;
+		if (!entry.value) {
+			free(entry.key);
+			WARN("Corrupted %s.\n", section_name);
+			break;
+		}
+		/* Info entries describe the VPD itself; they aren't keys. */
+		if (type == VPD_TYPE_INFO) {
+			free(entry.key);
+			free(entry.value);
+			continue;
+		}
+		if (table->num_entries == max_entries) {
+			int new_max = max_entries ? max_entries * 2 : 16;
+			struct vpd_entry *entries = realloc(
+				table->entries, new_max * sizeof(*entries));
+			if (!entries) {
+				free(entry.key);
+				free(entry.value);
+				free_vpd_table(table);
+				return NULL;
+			}
+			table->entries = entries;
+			max_entries = new_max;
+		}
+		table->entries[table->num_entries++] = entry;
+	}
+
+	VB2_DEBUG("Found %d keys in VPD %s.\n", table->num_entries,
+		  section_name);
+	return table;
+}
+
+const char *updater_vpd_find(struct firmware_image *image,
+			     const char *section_name,
+			     const char *key)
+{
+	struct firmware_section section;
+	struct vpd_table *table;
+	int i;
+
+	find_firmware_section(&section, image, section_name);
+	if (!section.data)
+		return NULL;
+
+	for (table = image->vpd_tables; table; table = table->next) {
+		if (table->base == section.data &&
+		    table->size == section.size &&
+		    !strncmp(table->section_name, section_name, FMAP_NAMELEN))
+			break;
+	}
+	if (!table) {
+		table = read_vpd_table(&section, section_name);
+		if (!table)
+			return NULL;
+		table->next = image->vpd_tables;
+		image->vpd_tables = table;
+	}
+
+	for (i = 0; i < table->num_entries; i++) {
+		if (!strcmp(table->entries[i].key, key))
+			return table->entries[i].value;
+	}
+	return NULL;
+}
+
+void updater_vpd_forget(struct firmware_image *image)
+{
+	while (image->vpd_tables) {
+		struct vpd_table *table = image->vpd_tables;
+
+		image->vpd_tables = table->next;
+		free_vpd_table(table);
+	}
+}
@@ -5,20 +5,31 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>		/* For PRIu64 */
+#ifndef HAVE_MACOS
+#include <linux/fs.h>		/* For BLKGETSIZE64 */
+#endif
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <openssl/rsa.h>
 
 #include "2sysincludes.h"
 #include "2api.h"
 #include "2common.h"
+#include "2lz4.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "crc32.h"
 #include "file_type.h"
 #include "futility.h"
 #include "host_common.h"
+#include "host_lz4.h"
 #include "kernel_blob.h"
 #include "util_misc.h"
 #include "vb1_helper.h"
@@ -53,6 +64,14 @@ static uint32_t g_bootloader_size;
 static uint8_t *g_vmlinuz_header_data;
 static uint32_t g_vmlinuz_header_size;
 
+/*
+ * If the kernel blob is compressed, g_kernel_blob_data is a decompressed copy
+ * of it, and these refer to the blob as it is stored.
+ */
+static uint8_t *g_ondisk_blob_data;
+static uint32_t g_ondisk_blob_size;
+static uint8_t *g_decompressed_blob;
+
 static uint64_t g_ondisk_bootloader_addr;
 static uint64_t g_ondisk_vmlinuz_header_addr;
 
@@ -390,6 +409,24 @@ uint8_t *unpack_kernel_partition(uint8_t *kpart_data,
 			"Warning: kernel file only has 0x%x bytes\n",
 			g_kernel_blob_size);
 
+	/* The parts of a compressed blob are found in a decompressed copy */
+	g_ondisk_blob_data = g_kernel_blob_data;
+	g_ondisk_blob_size = g_kernel_blob_size;
+	if (vb2_kernel_get_body_compression(preamble) !=
+	    VB2_KERNEL_COMPRESSION_NONE) {
+		if (kpart_size - now < g_kernel_blob_size) {
+			fprintf(stderr, "Compressed kernel blob is truncated\n");
+			return NULL;
+		}
+		free(g_decompressed_blob);
+		g_decompressed_blob = DecompressKernelBlob(
+			preamble, g_kernel_blob_data, g_kernel_blob_size);
+		if (!g_decompressed_blob)
+			return NULL;
+		g_kernel_blob_data = g_decompressed_blob;
+		g_kernel_blob_size = vb2_kernel_get_body_size(preamble);
+	}
+
 	/* Update the blob pointers */
 	UnpackKernelBlob(g_kernel_blob_data);
 
@@ -403,32 +440,50 @@ uint8_t *unpack_kernel_partition(uint8_t *kpart_data,
 	return g_kernel_blob_data;
 }
 
-uint8_t *SignKernelBlob(uint8_t *kernel_blob,
-			uint32_t kernel_size,
-			uint32_t padding,
-			int version,
-			uint64_t kernel_body_load_address,
-			struct vb2_keyblock *keyblock,
-			struct vb2_private_key *signpriv_key,
-			uint32_t flags,
-			uint32_t *vblock_size_ptr)
+/*
+ * Build a kernel vblock around a body signature, or if chunk_size or
+ * compression is non-zero, around a signature of the kernel blob or a table of
+ * the digests of each chunk of it.  Caller must free() it.
+ */
+static uint8_t *create_kernel_vblock(const struct vb2_signature *body_sig,
+				     const uint8_t *kernel_blob,
+				     uint32_t kernel_size,
+				     uint32_t chunk_size,
+				     uint32_t compression,
+				     uint32_t uncompressed_size,
+				     uint32_t padding,
+				     int version,
+				     uint64_t kernel_body_load_address,
+				     struct vb2_keyblock *keyblock,
+				     struct vb2_private_key *signpriv_key,
+				     uint32_t flags,
+				     uint32_t *vblock_size_ptr)
 {
 	/* Make sure the preamble fills up the rest of the required padding */
 	uint32_t min_size = padding > keyblock->keyblock_size
 		? padding - keyblock->keyblock_size : 0;
 
-	/* Sign the kernel data */
-	struct vb2_signature *body_sig = vb2_calculate_signature(kernel_blob,
-								 kernel_size,
-								 signpriv_key);
-	if (!body_sig) {
-		fprintf(stderr, "Error calculating body signature\n");
-		return NULL;
-	}
-
 	/* Create preamble */
-	struct vb2_kernel_preamble *preamble =
-		vb2_create_kernel_preamble(version,
+	struct vb2_kernel_preamble *preamble;
+	if (chunk_size || compression)
+		preamble = vb2_create_kernel_preamble_compressed(
+					   version,
+					   kernel_body_load_address,
+					   g_ondisk_bootloader_addr,
+					   g_bootloader_size,
+					   kernel_blob,
+					   kernel_size,
+					   chunk_size,
+					   compression,
+					   uncompressed_size,
+					   g_ondisk_vmlinuz_header_addr,
+					   g_vmlinuz_header_size,
+					   flags,
+					   min_size,
+					   signpriv_key);
+	else
+		preamble = vb2_create_kernel_preamble(
+					   version,
 					   kernel_body_load_address,
 					   g_ondisk_bootloader_addr,
 					   g_bootloader_size,
@@ -443,17 +498,549 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob,
 		return 0;
 	}
 
+	/* The digest table mustn't push the kernel blob past the padding */
+	if (chunk_size && padding &&
+	    keyblock->keyblock_size + preamble->preamble_size > padding) {
+		fprintf(stderr, "Chunk digests don't fit in the vblock padding;"
+			" use a bigger chunk size.\n");
+		free(preamble);
+		return 0;
+	}
+
 	uint32_t outsize = keyblock->keyblock_size + preamble->preamble_size;
 	void *outbuf = calloc(outsize, 1);
 	memcpy(outbuf, keyblock, keyblock->keyblock_size);
 	memcpy(outbuf + keyblock->keyblock_size,
 	       preamble, preamble->preamble_size);
+	free(preamble);
 
 	if (vblock_size_ptr)
 		*vblock_size_ptr = outsize;
 	return outbuf;
 }
 
+uint8_t *SignKernelBlob(uint8_t *kernel_blob,
+			uint32_t kernel_size,
+			uint32_t padding,
+			int version,
+			uint64_t kernel_body_load_address,
+			struct vb2_keyblock *keyblock,
+			struct vb2_private_key *signpriv_key,
+			uint32_t flags,
+			uint32_t chunk_size,
+			uint32_t compression,
+			uint32_t uncompressed_size,
+			uint32_t *vblock_size_ptr)
+{
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_signature *body_sig = NULL;
+
+	/* Sign the kernel data, unless the preamble is created around it */
+	if (!chunk_size && !compression) {
+		vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+		body_sig = vb2_calculate_signature_wb(kernel_blob, kernel_size,
+						      signpriv_key, &wb);
+		if (!body_sig) {
+			fprintf(stderr, "Error calculating body signature\n");
+			return NULL;
+		}
+	}
+
+	return create_kernel_vblock(body_sig, kernel_blob, kernel_size,
+				    chunk_size, compression,
+				    uncompressed_size, padding, version,
+				    kernel_body_load_address, keyblock,
+				    signpriv_key, flags, vblock_size_ptr);
+}
+
+int SignKernelBlobMultiple(uint8_t *kernel_blob,
+			   uint32_t kernel_size,
+			   uint32_t padding,
+			   int version,
+			   uint64_t kernel_body_load_address,
+			   uint32_t flags,
+			   uint32_t chunk_size,
+			   uint32_t compression,
+			   uint32_t uncompressed_size,
+			   struct kernel_signer *signers,
+			   int count)
+{
+	struct vb2_signature **body_sigs;
+	const struct vb2_private_key **keys;
+	int i, rv = 1;
+
+	body_sigs = calloc(count, sizeof(*body_sigs));
+	keys = calloc(count, sizeof(*keys));
+	if (!body_sigs || !keys)
+		goto done;
+
+	for (i = 0; i < count; i++) {
+		signers[i].vblock = NULL;
+		keys[i] = signers[i].signpriv_key;
+	}
+
+	/*
+	 * Hash the kernel data once for all the keys, unless the preamble is
+	 * created around it.
+	 */
+	if (!chunk_size && !compression &&
+	    vb2_calculate_signatures(body_sigs, kernel_blob, kernel_size,
+				     keys, count)) {
+		fprintf(stderr, "Error calculating body signatures\n");
+		goto done;
+	}
+
+	for (i = 0; i < count; i++) {
+		signers[i].vblock = create_kernel_vblock(
+				body_sigs[i], kernel_blob, kernel_size,
+				chunk_size, compression, uncompressed_size,
+				padding, version, kernel_body_load_address,
+				signers[i].keyblock, signers[i].signpriv_key,
+				flags, &signers[i].vblock_size);
+		if (!signers[i].vblock) {
+			while (i--) {
+				free(signers[i].vblock);
+				signers[i].vblock = NULL;
+			}
+			goto done;
+		}
+	}
+	rv = 0;
+
+ done:
+	if (body_sigs) {
+		for (i = 0; i < count; i++)
+			free(body_sigs[i]);
+	}
+	free(body_sigs);
+	free(keys);
+	return rv;
+}
+
+const char *kernel_compression_name(uint32_t compression)
+{
+	switch (compression) {
+	case VB2_KERNEL_COMPRESSION_NONE:
+		return "none";
+	case VB2_KERNEL_COMPRESSION_LZ4:
+		return "lz4";
+	default:
+		return "unknown";
+	}
+}
+
+uint8_t *CompressKernelBlob(const uint8_t *kernel_blob, uint32_t kernel_size,
+			    uint32_t *compressed_size_ptr,
+			    uint32_t *padded_size_ptr)
+{
+	uint8_t *compressed, *buf;
+	uint32_t compressed_size, padded_size, buf_size;
+	int rv;
+
+	compressed = vb2_lz4_compress(kernel_blob, kernel_size,
+				      &compressed_size);
+	if (!compressed) {
+		fprintf(stderr, "Unable to compress kernel blob\n");
+		return NULL;
+	}
+
+	/*
+	 * Firmware reads the compressed blob into the end of the buffer it
+	 * decompresses it into, so make sure that works.
+	 */
+	buf_size = kernel_size + VB2_LZ4_INPLACE_MARGIN(compressed_size);
+	if (buf_size < compressed_size)
+		buf_size = compressed_size;
+	buf = malloc(buf_size);
+	if (!buf) {
+		free(compressed);
+		return NULL;
+	}
+	memcpy(buf + buf_size - compressed_size, compressed, compressed_size);
+	rv = vb2_lz4_decompress(buf + buf_size - compressed_size,
+				compressed_size, buf, kernel_size);
+	if (!rv && memcmp(buf, kernel_blob, kernel_size))
+		rv = -1;
+	free(buf);
+	if (rv) {
+		fprintf(stderr, "Compressed kernel blob doesn't decompress "
+			"in place (error 0x%x)\n", rv);
+		free(compressed);
+		return NULL;
+	}
+
+	VB2_DEBUG("Compressed kernel blob from 0x%x to 0x%x bytes\n",
+		  kernel_size, compressed_size);
+
+	/* Pad it to whole sectors, like CreateKernelBlob() does */
+	padded_size = roundup(compressed_size, CROS_ALIGN);
+	buf = realloc(compressed, padded_size ? padded_size : 1);
+	if (!buf) {
+		free(compressed);
+		return NULL;
+	}
+	memset(buf + compressed_size, 0, padded_size - compressed_size);
+
+	*compressed_size_ptr = compressed_size;
+	*padded_size_ptr = padded_size;
+	return buf;
+}
+
+uint8_t *DecompressKernelBlob(const struct vb2_kernel_preamble *preamble,
+			      const uint8_t *body, uint32_t body_size)
+{
+	uint32_t compression = vb2_kernel_get_body_compression(preamble);
+	uint32_t size = vb2_kernel_get_body_size(preamble);
+	uint8_t *blob;
+	int rv;
+
+	if (compression != VB2_KERNEL_COMPRESSION_LZ4) {
+		fprintf(stderr, "Unknown kernel blob compression %u\n",
+			compression);
+		return NULL;
+	}
+
+	if (body_size > preamble->body_signature.data_size)
+		body_size = preamble->body_signature.data_size;
+
+	blob = malloc(size ? size : 1);
+	if (!blob)
+		return NULL;
+
+	rv = vb2_lz4_decompress(body, body_size, blob, size);
+	if (rv) {
+		fprintf(stderr, "Unable to decompress kernel blob "
+			"(error 0x%x)\n", rv);
+		free(blob);
+		return NULL;
+	}
+
+	return blob;
+}
+
+/* Bytes of kernel blob to read at a time when repacking */
+#define REPACK_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * Copy size bytes of kernel blob from in_fd at in_offset, a chunk at a time.
+ * If config isn't NULL, it replaces the CROS_CONFIG_SIZE bytes at
+ * config_offset in the blob.  Each chunk is added to sc if that isn't NULL,
+ * added to the CRC32 in crc if that isn't NULL, and written to out_fd at
+ * out_offset if that isn't negative.
+ *
+ * Returns zero on success.
+ */
+static int stream_kernel_blob(int in_fd, uint64_t in_offset, uint32_t size,
+			      const uint8_t *config, uint32_t config_offset,
+			      int out_fd, uint64_t out_offset,
+			      struct vb2_signature_context *sc, uint32_t *crc)
+{
+	uint8_t *buf = malloc(REPACK_CHUNK_SIZE);
+	uint32_t done, len, start, end;
+	int rv = -1;
+
+	if (!buf)
+		return -1;
+
+	for (done = 0; done < size; done += len) {
+		len = size - done;
+		if (len > REPACK_CHUNK_SIZE)
+			len = REPACK_CHUNK_SIZE;
+
+		if (pread(in_fd, buf, len, in_offset + done) != len) {
+			fprintf(stderr, "Unable to read kernel blob\n");
+			goto out;
+		}
+
+		/* Patch in the part of the new config in this chunk */
+		if (config && config_offset < done + len &&
+		    config_offset + CROS_CONFIG_SIZE > done) {
+			start = config_offset > done ? config_offset : done;
+			end = config_offset + CROS_CONFIG_SIZE;
+			if (end > done + len)
+				end = done + len;
+			memcpy(buf + start - done,
+			       config + start - config_offset, end - start);
+		}
+
+		if (sc && vb2_signature_update(sc, buf, len)) {
+			fprintf(stderr, "Error calculating body signature\n");
+			goto out;
+		}
+		if (crc)
+			*crc = Crc32Update(*crc, buf, len);
+
+		if (out_fd >= 0 &&
+		    pwrite(out_fd, buf, len, out_offset + done) != len) {
+			fprintf(stderr, "Unable to write kernel blob: %s\n",
+				strerror(errno));
+			goto out;
+		}
+	}
+	rv = 0;
+
+ out:
+	free(buf);
+	return rv;
+}
+
+/*
+ * Saved hash of the kernel blob up to the config, so a later repack of the
+ * same partition with another command line only has to hash from there on.
+ * The vblock digest ties it to the partition it came from.  The blob can
+ * still be changed under the same vblock, so the prefix is also checked
+ * against a CRC32 of it, which costs far less than hashing it again.
+ *
+ * The raw digest context is saved, so the header also records its size and
+ * hash algorithm; a cache written by a futility built another way is not
+ * used.
+ */
+#define HASH_CACHE_MAGIC "VBHASH02"
+
+struct kernel_hash_cache {
+	char magic[8];
+	uint32_t context_size;	/* sizeof(struct vb2_digest_context) */
+	uint32_t hash_alg;	/* enum vb2_hash_algorithm of dc */
+	uint8_t vblock_digest[VB2_SHA256_DIGEST_SIZE];
+	uint32_t blob_size;
+	uint32_t prefix_size;
+	uint32_t prefix_crc32;	/* Crc32() of the prefix_size bytes */
+	struct vb2_digest_context dc;
+};
+
+/* Fill in the header of a hash cache entry for the partition in in_fd */
+static int init_hash_cache(struct kernel_hash_cache *hc,
+			   enum vb2_hash_algorithm hash_alg,
+			   uint32_t blob_size, uint32_t prefix_size)
+{
+	uint32_t vblock_size = g_keyblock->keyblock_size +
+		g_preamble->preamble_size;
+
+	memset(hc, 0, sizeof(*hc));
+	memcpy(hc->magic, HASH_CACHE_MAGIC, sizeof(hc->magic));
+	hc->context_size = sizeof(hc->dc);
+	hc->hash_alg = hash_alg;
+	hc->blob_size = blob_size;
+	hc->prefix_size = prefix_size;
+	return vb2_digest_buffer((const uint8_t *)g_keyblock, vblock_size,
+				 VB2_HASH_SHA256, hc->vblock_digest,
+				 sizeof(hc->vblock_digest));
+}
+
+/*
+ * Load the cache file into cached if its header matches want.  The caller
+ * must still check the prefix against cached->prefix_crc32 before using
+ * cached->dc.
+ *
+ * Returns 1 if it was loaded, 0 if not.
+ */
+static int load_hash_cache(const char *filename,
+			   const struct kernel_hash_cache *want,
+			   struct kernel_hash_cache *cached)
+{
+	struct kernel_hash_cache *hc;
+	uint64_t size;
+	int ok;
+
+	/* Nothing saved yet */
+	if (access(filename, F_OK))
+		return 0;
+
+	hc = (struct kernel_hash_cache *)ReadFile(filename, &size);
+	if (!hc)
+		return 0;
+
+	ok = size == sizeof(*hc) &&
+		!memcmp(hc, want,
+			offsetof(struct kernel_hash_cache, prefix_crc32)) &&
+		hc->dc.hash_alg == want->hash_alg && !hc->dc.using_hwcrypto;
+	if (ok) {
+		*cached = *hc;
+	} else {
+		VB2_DEBUG("%s doesn't match; hashing the whole blob\n",
+			  filename);
+	}
+
+	free(hc);
+	return ok;
+}
+
+int RepackKernelPartition(int in_fd, const char *outfile, uint32_t padding,
+			  int version, struct vb2_keyblock *keyblock,
+			  struct vb2_private_key *signpriv_key, uint32_t flags,
+			  const uint8_t *config_data, uint32_t config_size,
+			  int vblock_only, const char *hash_cache_file)
+{
+	uint32_t blob_offset = g_keyblock->keyblock_size +
+		g_preamble->preamble_size;
+	uint32_t blob_size = g_preamble->body_signature.data_size;
+	uint64_t load_address = g_preamble->body_load_address;
+	uint8_t *config = NULL;
+	uint32_t config_offset = 0;
+	uint32_t prefix_size = 0;
+	struct kernel_hash_cache hc, cached;
+	struct vb2_signature_context sc;
+	struct vb2_signature *body_sig = NULL;
+	uint8_t *vblock = NULL;
+	uint32_t vblock_size = 0;
+	struct stat in_st, out_st;
+	int in_place;
+	int use_cache = 0;
+	int out_fd = -1;
+	int blob_fd;
+	int rv = -1;
+
+	/* Same place UnpackKernelBlob() finds it */
+	if (config_data || hash_cache_file) {
+		config_offset = g_preamble->bootloader_address -
+			load_address - CROS_PARAMS_SIZE - CROS_CONFIG_SIZE;
+		if (config_size > CROS_CONFIG_SIZE ||
+		    config_offset > blob_size ||
+		    blob_size - config_offset < CROS_CONFIG_SIZE) {
+			fprintf(stderr, "Unable to find config\n");
+			return -1;
+		}
+	}
+	if (hash_cache_file) {
+		prefix_size = config_offset;
+		if (init_hash_cache(&hc, signpriv_key->hash_alg, blob_size,
+				    prefix_size))
+			return -1;
+	}
+	if (config_data) {
+		config = calloc(CROS_CONFIG_SIZE, 1);
+		if (!config)
+			return -1;
+		memcpy(config, config_data, config_size);
+	}
+
+	/*
+	 * If the output is the partition being repacked, only the vblock and
+	 * config need to be written.  Otherwise, copy the blob to where it
+	 * will almost certainly end up, since the preamble is padded to fill
+	 * the padding, while hashing it.
+	 */
+	in_place = !fstat(in_fd, &in_st) && !stat(outfile, &out_st) &&
+		in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino;
+	if (in_place && vblock_only) {
+		fprintf(stderr, "Can't write only the vblock over %s\n",
+			outfile);
+		goto out;
+	}
+	if (in_place)
+		out_fd = open(outfile, O_WRONLY);
+	else
+		out_fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out_fd < 0) {
+		fprintf(stderr, "Can't open output file %s: %s\n",
+			outfile, strerror(errno));
+		goto out;
+	}
+
+	if (vb2_signature_begin(&sc, signpriv_key)) {
+		fprintf(stderr, "Error calculating body signature\n");
+		goto out;
+	}
+
+	/*
+	 * Everything before the config is the same whatever the command line,
+	 * so with a hash cache it only needs hashing once.  If the cache is
+	 * used, the prefix is still read to check its CRC32, and copied to a
+	 * separate output.
+	 */
+	blob_fd = in_place || vblock_only ? -1 : out_fd;
+	if (hash_cache_file &&
+	    load_hash_cache(hash_cache_file, &hc, &cached)) {
+		hc.prefix_crc32 = 0;
+		if (stream_kernel_blob(in_fd, blob_offset, prefix_size,
+				       NULL, 0, blob_fd, padding, NULL,
+				       &hc.prefix_crc32))
+			goto out;
+		use_cache = hc.prefix_crc32 == cached.prefix_crc32;
+		if (use_cache) {
+			sc.dc = cached.dc;
+			sc.data_size = prefix_size;
+		} else {
+			VB2_DEBUG("%s is for another blob; hashing the whole "
+				  "blob\n", hash_cache_file);
+		}
+	}
+	if (!use_cache) {
+		hc.prefix_crc32 = 0;
+		if (stream_kernel_blob(in_fd, blob_offset, prefix_size,
+				       NULL, 0, blob_fd, padding, &sc,
+				       hash_cache_file ? &hc.prefix_crc32 :
+				       NULL))
+			goto out;
+		if (hash_cache_file) {
+			hc.dc = sc.dc;
+			if (WriteFile(hash_cache_file, &hc, sizeof(hc)))
+				fprintf(stderr, "Warning: unable to write %s\n",
+					hash_cache_file);
+		}
+	}
+	if (stream_kernel_blob(in_fd, blob_offset + prefix_size,
+			       blob_size - prefix_size,
+			       config, config_offset - prefix_size,
+			       blob_fd, padding + prefix_size, &sc, NULL))
+		goto out;
+	body_sig = vb2_signature_finish(&sc);
+	if (!body_sig) {
+		fprintf(stderr, "Error calculating body signature\n");
+		goto out;
+	}
+
+	vblock = create_kernel_vblock(body_sig, NULL, 0, 0,
+				      VB2_KERNEL_COMPRESSION_NONE, 0,
+				      padding, version,
+				      load_address, keyblock, signpriv_key,
+				      flags, &vblock_size);
+	if (!vblock)
+		goto out;
+
+	if (in_place) {
+		if (vblock_size != blob_offset) {
+			fprintf(stderr, "New vblock is 0x%x bytes, but the "
+				"kernel blob starts at 0x%x\n",
+				vblock_size, blob_offset);
+			goto out;
+		}
+		if (config && pwrite(out_fd, config, CROS_CONFIG_SIZE,
+				     blob_offset + config_offset) !=
+		    CROS_CONFIG_SIZE)
+			goto write_error;
+	} else if (!vblock_only && vblock_size != padding) {
+		/* The vblock didn't fit in the padding; move the blob */
+		if (stream_kernel_blob(in_fd, blob_offset, blob_size,
+				       config, config_offset,
+				       out_fd, vblock_size, NULL, NULL))
+			goto out;
+	}
+
+	if (pwrite(out_fd, vblock, vblock_size, 0) != vblock_size)
+		goto write_error;
+
+	rv = 0;
+	goto out;
+
+ write_error:
+	fprintf(stderr, "Can't write output file %s: %s\n",
+		outfile, strerror(errno));
+ out:
+	if (out_fd >= 0 && close(out_fd) && !rv) {
+		fprintf(stderr, "Can't write output file %s: %s\n",
+			outfile, strerror(errno));
+		rv = -1;
+	}
+	if (rv && out_fd >= 0 && !in_place)
+		unlink(outfile);
+	free(vblock);
+	free(body_sig);
+	free(config);
+	return rv;
+}
+
 /* Returns zero on success */
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint32_t part1_size,
@@ -498,6 +1085,126 @@ int WriteSomeParts(const char *outfile,
 	return 0;
 }
 
+/* Alignment direct I/O needs for the buffer, offset and size */
+#define KPART_READ_ALIGN 4096
+
+/*
+ * Read size bytes from fd into buf, a chunk at a time, stopping early only at
+ * the end of the file.  size must be a multiple of KPART_READ_ALIGN if
+ * *direct is set; if the file turns out to refuse direct I/O, it's turned off
+ * and *direct is cleared.  The number of bytes read is stored in *got.
+ *
+ * Returns zero on success.
+ */
+static int read_kpart_chunks(int fd, uint8_t *buf, uint32_t size,
+			     int *direct, uint32_t *got)
+{
+	uint32_t chunk;
+	ssize_t len;
+
+	*got = 0;
+	while (*got < size) {
+		chunk = size - *got;
+		if (chunk > REPACK_CHUNK_SIZE)
+			chunk = REPACK_CHUNK_SIZE;
+		len = read(fd, buf + *got, chunk);
+		if (len == 0)
+			break;
+		if (len > 0) {
+			*got += len;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+#ifdef O_DIRECT
+		/* Some filesystems only refuse direct I/O once it's read */
+		if (*direct && errno == EINVAL) {
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			*direct = 0;
+			continue;
+		}
+#endif
+		return -1;
+	}
+	return 0;
+}
+
+uint8_t *ReadKernelPartition(const char *filename, uint32_t padding,
+			     int direct, uint32_t *size_ptr)
+{
+	struct vb2_kernel_preamble *preamble;
+	struct stat sb;
+	uint8_t *head = NULL, *buf = NULL;
+	uint64_t file_size, size;
+	uint32_t head_size, alloc_size, got, more;
+	int fd = -1;
+
+#ifdef O_DIRECT
+	if (direct)
+		fd = open(filename, O_RDONLY | O_DIRECT);
+#endif
+	/* Not every filesystem can do direct I/O, so fall back to reads */
+	direct = (fd != -1);
+	if (fd == -1)
+		fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	/* Pipes and such can't be read again if this isn't a partition */
+	if (fstat(fd, &sb) || !(S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode)))
+		goto done;
+	file_size = sb.st_size;
+#ifndef HAVE_MACOS
+	if (S_ISBLK(sb.st_mode) && ioctl(fd, BLKGETSIZE64, &file_size))
+		goto done;
+#endif
+	if (!padding || padding > UINT32_MAX - KPART_READ_ALIGN ||
+	    file_size <= padding)
+		goto done;
+	if (!direct)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* The vblock says how much of the rest is worth reading */
+	head_size = roundup(padding, KPART_READ_ALIGN);
+	if (posix_memalign((void **)&head, KPART_READ_ALIGN, head_size) ||
+	    read_kpart_chunks(fd, head, head_size, &direct, &got) ||
+	    got < padding)
+		goto done;
+	if (FILE_TYPE_KERN_PREAMBLE != futil_file_type_buf(head, padding))
+		goto done;
+	preamble = (struct vb2_kernel_preamble *)
+		(head + ((struct vb2_keyblock *)head)->keyblock_size);
+	size = (uint64_t)padding + preamble->body_signature.data_size;
+	if (size > file_size || size > UINT32_MAX - KPART_READ_ALIGN)
+		goto done;
+
+	if (size <= got) {
+		buf = head;
+		head = NULL;
+	} else {
+		alloc_size = roundup(size, KPART_READ_ALIGN);
+		if (posix_memalign((void **)&buf, KPART_READ_ALIGN,
+				   alloc_size))
+			goto done;
+		memcpy(buf, head, got);
+		if (read_kpart_chunks(fd, buf + got, alloc_size - got,
+				      &direct, &more) ||
+		    got + more < size) {
+			free(buf);
+			buf = NULL;
+			goto done;
+		}
+	}
+	VB2_DEBUG("Read 0x%x bytes of %s, which is 0x%" PRIx64 " bytes\n",
+		  (uint32_t)size, filename, file_size);
+	*size_ptr = size;
+
+done:
+	free(head);
+	close(fd);
+	return buf;
+}
+
 /* Returns 0 on success */
 int VerifyKernelBlob(uint8_t *kernel_blob,
 		     uint32_t kernel_size,
@@ -617,6 +1324,15 @@ int VerifyKernelBlob(uint8_t *kernel_blob,
 
 	printf("  Flags          :       0x%x\n",
 	       vb2_kernel_get_flags(g_preamble));
+	if (vb2_kernel_get_body_chunk_size(g_preamble))
+		printf("  Body chunk size:     0x%x\n",
+		       vb2_kernel_get_body_chunk_size(g_preamble));
+	if (vb2_kernel_get_body_compression(g_preamble) !=
+	    VB2_KERNEL_COMPRESSION_NONE)
+		printf("  Body compression:    %s (0x%x bytes decompressed)\n",
+		       kernel_compression_name(
+			       vb2_kernel_get_body_compression(g_preamble)),
+		       vb2_kernel_get_body_size(g_preamble));
 
 	if (g_preamble->kernel_version < (min_version & 0xFFFF)) {
 		fprintf(stderr,
@@ -625,11 +1341,21 @@ int VerifyKernelBlob(uint8_t *kernel_blob,
 		goto done;
 	}
 
-	/* Verify body */
+	/*
+	 * Verify body.  A compressed body is signed as it is stored, so check
+	 * that instead of the decompressed copy unpack_kernel_partition()
+	 * returned.
+	 */
+	const uint8_t *body = kernel_blob;
+	uint32_t body_size = kernel_size;
+	if (vb2_kernel_get_body_compression(g_preamble) !=
+	    VB2_KERNEL_COMPRESSION_NONE) {
+		body = g_ondisk_blob_data;
+		body_size = g_ondisk_blob_size;
+	}
 	if (VB2_SUCCESS !=
-	    vb2_verify_data(kernel_blob, kernel_size,
-			    &g_preamble->body_signature,
-			    &pubkey, &wb)) {
+	    vb2_verify_kernel_body(body, body_size, g_preamble,
+				   &pubkey, &wb)) {
 		fprintf(stderr, "Error verifying kernel body.\n");
 		goto done;
 	}
@@ -745,6 +1471,11 @@ enum futil_file_type ft_recognize_vblock1(uint8_t *buf, uint32_t len)
 	struct vb2_workbuf wb;
 	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 
+	/* Don't bother copying anything that isn't even a keyblock */
+	if (len < sizeof(struct vb2_keyblock) ||
+	    memcmp(buf, KEY_BLOCK_MAGIC, KEY_BLOCK_MAGIC_SIZE))
+		return FILE_TYPE_UNKNOWN;
+
 	/* Vboot 2.0 signature checks destroy the buffer, so make a copy */
 	uint8_t *buf2 = malloc(len);
 	memcpy(buf2, buf, len);
@@ -31,8 +31,115 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob,
 			struct vb2_keyblock *keyblock,
 			struct vb2_private_key *signpriv_key,
 			uint32_t flags,
+			uint32_t chunk_size,
+			uint32_t compression,
+			uint32_t uncompressed_size,
 			uint32_t *vblock_size_ptr);
 
+/* One set of keys to sign a kernel blob with, for SignKernelBlobMultiple() */
+struct kernel_signer {
+	struct vb2_keyblock *keyblock;
+	struct vb2_private_key *signpriv_key;
+	uint8_t *vblock;		/* Signed vblock, set on exit */
+	uint32_t vblock_size;		/* Size of vblock, set on exit */
+};
+
+/**
+ * Sign a kernel blob with several sets of keys.
+ *
+ * Like SignKernelBlob(), called once for each of signers, but hashes the blob
+ * only once for all of them when it is signed as a whole.
+ *
+ * @return 0 if success, and each signer's vblock is set; caller must free()
+ * them.  Non-zero if error, and none are set.
+ */
+int SignKernelBlobMultiple(uint8_t *kernel_blob,
+			   uint32_t kernel_size,
+			   uint32_t padding,
+			   int version,
+			   uint64_t kernel_body_load_address,
+			   uint32_t flags,
+			   uint32_t chunk_size,
+			   uint32_t compression,
+			   uint32_t uncompressed_size,
+			   struct kernel_signer *signers,
+			   int count);
+
+/* Name of an enum vb2_kernel_compression, for display */
+const char *kernel_compression_name(uint32_t compression);
+
+/**
+ * Compress a kernel blob with LZ4.
+ *
+ * Also checks firmware can decompress the result in place, the way it loads
+ * it.  Pass the result and its compressed size to SignKernelBlob() with
+ * VB2_KERNEL_COMPRESSION_LZ4 and the size of the uncompressed blob.  It is
+ * padded with zeros to a multiple of CROS_ALIGN bytes, which are written out
+ * but not signed.
+ *
+ * @param kernel_blob		Kernel blob to compress
+ * @param kernel_size		Size of kernel blob in bytes
+ * @param compressed_size_ptr	Size of compressed blob stored here on exit
+ * @param padded_size_ptr	Size of compressed blob with its padding
+ *				stored here on exit
+ *
+ * @return The compressed blob, or NULL if error.  Caller must free() it.
+ */
+uint8_t *CompressKernelBlob(const uint8_t *kernel_blob, uint32_t kernel_size,
+			    uint32_t *compressed_size_ptr,
+			    uint32_t *padded_size_ptr);
+
+/**
+ * Decompress a kernel blob, as described by its preamble.
+ *
+ * @param preamble	Kernel preamble of a compressed blob
+ * @param body		Compressed kernel blob
+ * @param body_size	Size of compressed kernel blob in bytes
+ *
+ * @return The decompressed blob, or NULL if error.  Caller must free() it.
+ */
+uint8_t *DecompressKernelBlob(const struct vb2_kernel_preamble *preamble,
+			      const uint8_t *body, uint32_t body_size);
+
+/**
+ * Re-sign a kernel partition without reading all of it into memory.
+ *
+ * Call unpack_kernel_partition() on the vblock at the start of the partition
+ * first.  The kernel blob which follows it is then read from in_fd a chunk at
+ * a time and hashed as it goes, so memory use doesn't depend on its size.
+ *
+ * If outfile is the partition being repacked, only the vblock and config are
+ * rewritten, in place; the new vblock must be the same size as the old one.
+ * Otherwise the new vblock and the blob are written to outfile.
+ *
+ * If hash_cache_file is not NULL, the hash of the blob up to the config is
+ * saved there, or loaded from there if it was saved for this same partition,
+ * so repacking the partition again with another config only hashes the config
+ * and what follows it.  The saved hash is only used if a CRC32 of the blob up
+ * to the config still matches, so the blob is still read, but not hashed.  A
+ * CRC32 only catches accidental changes, and the cache decides what is
+ * signed, so it must be protected as well as the partition itself.
+ *
+ * @param in_fd		Partition to repack, open for reading
+ * @param outfile	File to write
+ * @param padding	Size to pad the vblock to
+ * @param version	Kernel version for the new preamble
+ * @param keyblock	Keyblock for the new vblock
+ * @param signpriv_key	Key to sign the blob and preamble with
+ * @param flags		Flags for the new preamble
+ * @param config_data	New kernel command line, or NULL to keep the old one
+ * @param config_size	Size of config_data in bytes
+ * @param vblock_only	Write only the new vblock to outfile
+ * @param hash_cache_file	File to save the blob prefix hash in, or NULL
+ *
+ * @return 0 on success, non-zero if error.
+ */
+int RepackKernelPartition(int in_fd, const char *outfile, uint32_t padding,
+			  int version, struct vb2_keyblock *keyblock,
+			  struct vb2_private_key *signpriv_key, uint32_t flags,
+			  const uint8_t *config_data, uint32_t config_size,
+			  int vblock_only, const char *hash_cache_file);
+
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint32_t part1_size,
 		   void *part2_data, uint32_t part2_size);
@@ -47,6 +154,10 @@ int WriteSomeParts(const char *outfile,
  * @param preamble_ptr	Pointer to premable stored here on exit
  * @param blob_size_ptr	Size of kernel data blob stored here on exit
  *
+ * If the kernel data blob is compressed, the whole of it must be in kpart_data,
+ * and what is returned is a decompressed copy, which lasts until the next
+ * call.
+ *
  * @return A pointer to the kernel data blob, or NULL if error.
  */
 uint8_t *unpack_kernel_partition(uint8_t *kpart_data,
@@ -59,6 +170,24 @@ uint8_t *unpack_kernel_partition(uint8_t *kpart_data,
 int UpdateKernelBlobConfig(uint8_t *kblob_data, uint32_t kblob_size,
 			   uint8_t *config_data, uint32_t config_size);
 
+/**
+ * Read just the parts of a kernel partition that verifying it needs.
+ *
+ * This reads the vblock in the first [padding] bytes, and then only as much
+ * of the body after it as the kernel preamble signs, instead of the whole
+ * partition.  The partition is read sequentially from the start.
+ *
+ * @param filename	Kernel partition file or block device
+ * @param padding	Size of the vblock padding at the start of it
+ * @param direct	Non-zero to read with O_DIRECT, if the file allows it
+ * @param size_ptr	Size of the data read stored here on exit
+ *
+ * @return The vblock and body, or NULL if the file doesn't start with a
+ * kernel vblock, or its body can't be read.  Caller must free() it.
+ */
+uint8_t *ReadKernelPartition(const char *filename, uint32_t padding,
+			     int direct, uint32_t *size_ptr);
+
 int VerifyKernelBlob(uint8_t *kernel_blob,
 		     uint32_t kernel_size,
 		     struct vb2_packed_key *signpub_key,
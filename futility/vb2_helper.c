@@ -192,7 +192,14 @@ static RSA *rsa_from_buffer(uint8_t *buf, uint32_t len)
 
 enum futil_file_type ft_recognize_pem(uint8_t *buf, uint32_t len)
 {
-	RSA *rsa_key = rsa_from_buffer(buf, len);
+	static const char pem_begin[] = "-----BEGIN ";
+	RSA *rsa_key;
+
+	/* The PEM reader goes line by line, which is slow on big binaries */
+	if (!memmem(buf, len, pem_begin, sizeof(pem_begin) - 1))
+		return FILE_TYPE_UNKNOWN;
+
+	rsa_key = rsa_from_buffer(buf, len);
 
 	if (rsa_key) {
 		RSA_free(rsa_key);
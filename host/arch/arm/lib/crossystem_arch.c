@@ -44,6 +44,8 @@
 #define GPIO_EXPORT_PATH GPIO_BASE_PATH "/export"
 /* Name of NvStorage type property */
 #define FDT_NVSTORAGE_TYPE_PROP "nonvolatile-context-storage"
+/* Device for talking to the EC which holds NvStorage */
+#define CROS_EC_DEV_PATH "/dev/cros_ec"
 /* Errors */
 #define E_FAIL      -1
 #define E_FILEOP    -2
@@ -486,6 +488,78 @@ static int vb2_write_nv_storage_disk(struct vb2_context *ctx)
 	return rv;
 }
 
+/*
+ * Just enough of the kernel's cros_ec_dev.h and the EC's ec_commands.h to
+ * access NvStorage held by the EC.
+ */
+struct cros_ec_command_v2 {
+	uint32_t version;
+	uint32_t command;
+	uint32_t outsize;
+	uint32_t insize;
+	uint32_t result;
+	uint8_t data[0];
+};
+
+#define CROS_EC_DEV_IOCXCMD_V2 _IOWR(0xEC, 0, struct cros_ec_command_v2)
+
+#define EC_CMD_VBNV_CONTEXT 0x0017
+#define EC_VER_VBNV_CONTEXT 1
+#define EC_VBNV_BLOCK_SIZE 16
+
+enum ec_vbnvcontext_op {
+	EC_VBNV_CONTEXT_OP_READ,
+	EC_VBNV_CONTEXT_OP_WRITE,
+};
+
+struct __attribute__((packed)) ec_params_vbnvcontext {
+	uint32_t op;
+	uint8_t block[EC_VBNV_BLOCK_SIZE];
+};
+
+/*
+ * Read or write NvStorage through the EC driver, which is far quicker than
+ * running mosys to do it.
+ *
+ * Returns 0 if success, non-zero if error.
+ */
+static int vb2_access_nv_storage_ec(struct vb2_context *ctx, uint32_t op)
+{
+	struct {
+		struct cros_ec_command_v2 cmd;
+		struct ec_params_vbnvcontext params;
+	} __attribute__((packed)) buf;
+	int fd, rv;
+
+	/* The EC only holds 16-byte records */
+	if (vb2_nv_get_size(ctx) != EC_VBNV_BLOCK_SIZE)
+		return E_FAIL;
+
+	fd = open(CROS_EC_DEV_PATH, O_RDWR);
+	if (fd < 0)
+		return E_FILEOP;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.version = EC_VER_VBNV_CONTEXT;
+	buf.cmd.command = EC_CMD_VBNV_CONTEXT;
+	buf.cmd.outsize = sizeof(buf.params);
+	buf.cmd.insize = op == EC_VBNV_CONTEXT_OP_READ ?
+		EC_VBNV_BLOCK_SIZE : 0;
+	buf.params.op = op;
+	if (op == EC_VBNV_CONTEXT_OP_WRITE)
+		memcpy(buf.params.block, ctx->nvdata, EC_VBNV_BLOCK_SIZE);
+
+	rv = ioctl(fd, CROS_EC_DEV_IOCXCMD_V2, &buf);
+	close(fd);
+	if (rv < 0 || buf.cmd.result || rv < buf.cmd.insize)
+		return E_FAIL;
+
+	/* The response replaces the params */
+	if (op == EC_VBNV_CONTEXT_OP_READ)
+		memcpy(ctx->nvdata, buf.cmd.data, EC_VBNV_BLOCK_SIZE);
+	return 0;
+}
+
 int vb2_read_nv_storage(struct vb2_context *ctx)
 {
 	/* Default to disk for older firmware which does not provide storage
@@ -496,8 +570,13 @@ int vb2_read_nv_storage(struct vb2_context *ctx)
 	media = ReadFdtString(FDT_NVSTORAGE_TYPE_PROP);
 	if (!strcmp(media, "disk"))
 		return vb2_read_nv_storage_disk(ctx);
-	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp") ||
-	    !strcmp(media, "flash"))
+	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp")) {
+		/* Fall back to mosys for kernels without the EC driver */
+		if (!vb2_access_nv_storage_ec(ctx, EC_VBNV_CONTEXT_OP_READ))
+			return 0;
+		return vb2_read_nv_storage_mosys(ctx);
+	}
+	if (!strcmp(media, "flash"))
 		return vb2_read_nv_storage_mosys(ctx);
 	return -1;
 }
@@ -512,12 +591,38 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 	media = ReadFdtString(FDT_NVSTORAGE_TYPE_PROP);
 	if (!strcmp(media, "disk"))
 		return vb2_write_nv_storage_disk(ctx);
-	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp") ||
-	    !strcmp(media, "flash"))
+	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp")) {
+		if (!vb2_access_nv_storage_ec(ctx, EC_VBNV_CONTEXT_OP_WRITE))
+			return 0;
+		return vb2_write_nv_storage_mosys(ctx);
+	}
+	if (!strcmp(media, "flash"))
 		return vb2_write_nv_storage_mosys(ctx);
 	return -1;
 }
 
+int vb2_get_nv_storage_path(char *dest, size_t size)
+{
+	int emmc_dev;
+
+	/* Only the disk is a file; the EC and flash are reached by ioctl or
+	 * mosys */
+	if (FdtPropertyExist(FDT_NVSTORAGE_TYPE_PROP)) {
+		char *media = ReadFdtString(FDT_NVSTORAGE_TYPE_PROP);
+		int is_disk = media && !strcmp(media, "disk");
+
+		free(media);
+		if (!is_disk)
+			return -1;
+	}
+
+	emmc_dev = FindEmmcDev();
+	if (emmc_dev < 0)
+		return -1;
+	snprintf(dest, size, NVCTX_PATH, emmc_dev);
+	return 0;
+}
+
 VbSharedDataHeader *VbSharedDataRead(void)
 {
 	void *block = NULL;
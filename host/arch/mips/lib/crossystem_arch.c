@@ -24,6 +24,11 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 	return -1;
 }
 
+int vb2_get_nv_storage_path(char *dest, size_t size)
+{
+	return -1;
+}
+
 VbSharedDataHeader *VbSharedDataRead(void)
 {
 	return NULL;
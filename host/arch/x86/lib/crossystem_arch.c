@@ -6,6 +6,7 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/nvram.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -83,6 +84,10 @@
 #define GPIO_BASE_PATH "/sys/class/gpio"
 #define GPIO_EXPORT_PATH GPIO_BASE_PATH "/export"
 
+/* Where GPIOs found in the ACPI table are remembered until reboot */
+#define GPIO_CACHE_DIR "/run/crossystem"
+#define GPIO_CACHE_PATH GPIO_CACHE_DIR "/gpio"
+
 /* Filename for NVRAM file */
 #define NVRAM_PATH "/dev/nvram"
 
@@ -98,60 +103,79 @@ typedef struct {
 	unsigned int uid;
 } Basemapping;
 
-static void VbFixCmosChecksum(FILE* file)
+/*
+ * Read or write the vboot block in CMOS through an open /dev/nvram, as one
+ * transfer.  If the CMOS checksum is bad, fixes it and tries once more.
+ *
+ * Returns 0 if success, -1 if error.
+ */
+static int VbCmosTransfer(int fd, unsigned offs, size_t size, void *ptr,
+			  int write)
 {
-	int fd = fileno(file);
-	ioctl(fd, NVRAM_SETCKS);
+	ssize_t res;
+	int tries;
+
+	for (tries = 0; tries < 2; tries++) {
+		res = write ? pwrite(fd, ptr, size, offs) :
+			pread(fd, ptr, size, offs);
+		if (res == size)
+			return 0;
+		if (res >= 0 || errno != EIO)
+			break;
+		ioctl(fd, NVRAM_SETCKS);
+	}
+	return -1;
 }
 
 
 static int VbCmosRead(unsigned offs, size_t size, void *ptr)
 {
-	size_t res;
-	FILE* f;
-
-	f = fopen(NVRAM_PATH, "rb");
-	if (!f)
-		return -1;
+	int fd = open(NVRAM_PATH, O_RDONLY | O_CLOEXEC);
+	int rv;
 
-	if (0 != fseek(f, offs, SEEK_SET)) {
-		fclose(f);
+	if (fd < 0)
 		return -1;
-	}
-
-	res = fread(ptr, size, 1, f);
-	if (1 != res && errno == EIO && ferror(f)) {
-		VbFixCmosChecksum(f);
-		res = fread(ptr, size, 1, f);
-	}
-
-	fclose(f);
-	return (1 == res) ? 0 : -1;
+	rv = VbCmosTransfer(fd, offs, size, ptr, 0);
+	close(fd);
+	return rv;
 }
 
 
 static int VbCmosWrite(unsigned offs, size_t size, const void *ptr)
 {
-	size_t res;
-	FILE* f;
+	/* Only one writer may have /dev/nvram open, so don't hold it */
+	int fd = open(NVRAM_PATH, O_WRONLY | O_CLOEXEC);
+	int rv;
 
-	f = fopen(NVRAM_PATH, "w+b");
-	if (!f)
+	if (fd < 0)
 		return -1;
+	rv = VbCmosTransfer(fd, offs, size, (void *)ptr, 1);
+	close(fd);
+	return rv;
+}
 
-	if (0 != fseek(f, offs, SEEK_SET)) {
-		fclose(f);
-		return -1;
-	}
 
-	res = fwrite(ptr, size, 1, f);
-	if (1 != res && errno == EIO && ferror(f)) {
-		VbFixCmosChecksum(f);
-		res = fwrite(ptr, size, 1, f);
-	}
+/*
+ * Get the byte offset and size of the NV storage block in CMOS from VBNV.
+ * These don't change until reboot, so they're only read once.
+ *
+ * Returns 0 if success, -1 if error.
+ */
+static int VbGetCmosBlock(unsigned *offs, unsigned *blksz)
+{
+	static unsigned cached_offs, cached_blksz;
+	static int cached;
 
-	fclose(f);
-	return (1 == res) ? 0 : -1;
+	if (!cached) {
+		if (ReadFileInt(ACPI_VBNV_PATH ".0", &cached_offs) < 0)
+			return -1;
+		if (ReadFileInt(ACPI_VBNV_PATH ".1", &cached_blksz) < 0)
+			return -1;
+		cached = 1;
+	}
+	*offs = cached_offs;
+	*blksz = cached_blksz;
+	return 0;
 }
 
 
@@ -160,10 +184,7 @@ int vb2_read_nv_storage(struct vb2_context *ctx)
 	unsigned offs, blksz;
 	unsigned expectsz = vb2_nv_get_size(ctx);
 
-	/* Get the byte offset from VBNV */
-	if (ReadFileInt(ACPI_VBNV_PATH ".0", &offs) < 0)
-		return -1;
-	if (ReadFileInt(ACPI_VBNV_PATH ".1", &blksz) < 0)
+	if (VbGetCmosBlock(&offs, &blksz))
 		return -1;
 	if (expectsz > blksz)
 		return -1;  /* NV storage block is too small */
@@ -183,10 +204,7 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 	if (!(ctx->flags & VB2_CONTEXT_NVDATA_CHANGED))
 		return 0;  /* Nothing changed, so no need to write */
 
-	/* Get the byte offset from VBNV */
-	if (ReadFileInt(ACPI_VBNV_PATH ".0", &offs) < 0)
-		return -1;
-	if (ReadFileInt(ACPI_VBNV_PATH ".1", &blksz) < 0)
+	if (VbGetCmosBlock(&offs, &blksz))
 		return -1;
 	if (expectsz > blksz)
 		return -1;  /* NV storage block is too small */
@@ -308,6 +326,13 @@ static uint8_t* VbGetBuffer(const char* filename, int* buffer_size)
 }
 
 
+int vb2_get_nv_storage_path(char *dest, size_t size)
+{
+	StrCopy(dest, NVRAM_PATH, size);
+	return 0;
+}
+
+
 VbSharedDataHeader* VbSharedDataRead(void)
 {
 	VbSharedDataHeader* sh;
@@ -322,6 +347,14 @@ VbSharedDataHeader* VbSharedDataRead(void)
 	 * Check supported old versions first. */
 	if (1 == sh->struct_version)
 		expect_size = VB_SHARED_DATA_HEADER_SIZE_V1;
+	else if (2 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V2;
+	else if (3 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V3;
+	else if (4 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V4;
+	else if (5 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V5;
 	else {
 		/* There'd better be enough data for the current header size. */
 		expect_size = sizeof(VbSharedDataHeader);
@@ -475,6 +508,44 @@ static int VbGetRecoveryReason(void)
 	}
 }
 
+/* GPIO chip offsets already found by the FindGpioChipOffset*() functions.
+ * Several signals are usually on the same chip, so this saves scanning
+ * /sys/class/gpio again for each of them. */
+#define GPIO_CHIP_CACHE_SIZE 8
+static struct GpioChipCacheEntry {
+	char key[32];		/* Chip label, or "uid <N>" */
+	unsigned offset;
+	int found;
+} gpio_chip_cache[GPIO_CHIP_CACHE_SIZE];
+static int gpio_chip_cache_count;
+
+/* Look up 'key' in the chip cache.  Returns the entry, or NULL if the chip
+ * hasn't been looked for yet. */
+static const struct GpioChipCacheEntry *GetCachedGpioChip(const char *key)
+{
+	int i;
+
+	for (i = 0; i < gpio_chip_cache_count; i++) {
+		if (!strcmp(gpio_chip_cache[i].key, key))
+			return &gpio_chip_cache[i];
+	}
+	return NULL;
+}
+
+/* Remember the result of looking for the chip named 'key'. */
+static void CacheGpioChip(const char *key, unsigned offset, int found)
+{
+	struct GpioChipCacheEntry *entry;
+
+	if (gpio_chip_cache_count == GPIO_CHIP_CACHE_SIZE ||
+	    strlen(key) >= sizeof(entry->key))
+		return;
+	entry = &gpio_chip_cache[gpio_chip_cache_count++];
+	StrCopy(entry->key, key, sizeof(entry->key));
+	entry->offset = offset;
+	entry->found = found;
+}
+
 /* Physical GPIO number <N> may be accessed through /sys/class/gpio/gpio<M>/,
  * but <N> and <M> may differ by some offset <O>. To determine that constant,
  * we look for a directory named /sys/class/gpio/gpiochip<O>/. If there's not
@@ -483,10 +554,18 @@ static int VbGetRecoveryReason(void)
 static int FindGpioChipOffset(unsigned *gpio_num, unsigned *offset,
 			      const char *name)
 {
+	const struct GpioChipCacheEntry *cached;
 	DIR *dir;
 	struct dirent *ent;
 	int match = 0;
 
+	/* The answer doesn't depend on the name, so cache it as "" */
+	cached = GetCachedGpioChip("");
+	if (cached) {
+		*offset = cached->offset;
+		return cached->found;
+	}
+
 	dir = opendir(GPIO_BASE_PATH);
 	if (!dir) {
 		return 0;
@@ -499,6 +578,7 @@ static int FindGpioChipOffset(unsigned *gpio_num, unsigned *offset,
 	}
 
 	closedir(dir);
+	CacheGpioChip("", *offset, 1 == match);
 	return (1 == match);
 }
 
@@ -516,6 +596,13 @@ static int FindGpioChipOffsetByLabel(unsigned *gpio_num, unsigned *offset,
 	char chiplabel[128];
 	int match = 0;
 	unsigned controller_offset = 0;
+	const struct GpioChipCacheEntry *cached;
+
+	cached = GetCachedGpioChip(name);
+	if (cached) {
+		*offset = cached->offset;
+		return cached->found;
+	}
 
 	dir = opendir(GPIO_BASE_PATH);
 	if (!dir) {
@@ -548,6 +635,7 @@ static int FindGpioChipOffsetByLabel(unsigned *gpio_num, unsigned *offset,
 	}
 
 	closedir(dir);
+	CacheGpioChip(name, *offset, 1 == match);
 	return (1 == match);
 }
 
@@ -557,6 +645,8 @@ static int FindGpioChipOffsetByNumber(unsigned *gpio_num, unsigned *offset,
 	DIR *dir;
 	struct dirent *ent;
 	int match = 0;
+	char key[32];
+	const struct GpioChipCacheEntry *cached;
 
 	/* Obtain relative GPIO number.
 	 * The assumption here is the Basemapping
@@ -578,6 +668,13 @@ static int FindGpioChipOffsetByNumber(unsigned *gpio_num, unsigned *offset,
 		return 0;
 	}
 
+	snprintf(key, sizeof(key), "uid %u", data->uid);
+	cached = GetCachedGpioChip(key);
+	if (cached) {
+		*offset = cached->offset;
+		return cached->found;
+	}
+
 	dir = opendir(GPIO_BASE_PATH);
 	if (!dir) {
 		return 0;
@@ -601,6 +698,7 @@ static int FindGpioChipOffsetByNumber(unsigned *gpio_num, unsigned *offset,
 	}
 
 	closedir(dir);
+	CacheGpioChip(key, *offset, 1 == match);
 	return (1 == match);
 }
 
@@ -697,10 +795,18 @@ static const struct GpioChipset *FindChipset(const char *name)
 	return NULL;
 }
 
-/* Read a GPIO of the specified signal type (see ACPI GPIO SignalType).
+/* Where to read a GPIO of one signal type, found by FindGpio(). */
+struct GpioInfo {
+	int found;		/* 1 if found, -1 if not, 0 if not looked up */
+	unsigned active_high;
+	unsigned controller_offset;
+};
+
+/* Find the sysfs GPIO number and polarity of the specified signal type (see
+ * ACPI GPIO SignalType) from the ACPI GPIO table.
  *
- * Returns 1 if the signal is asserted, 0 if not asserted, or -1 if error. */
-static int ReadGpio(unsigned signal_type)
+ * Returns 0 if success, or -1 if error. */
+static int FindGpio(unsigned signal_type, struct GpioInfo *info)
 {
 	char name[128];
 	int index = 0;
@@ -709,7 +815,6 @@ static int ReadGpio(unsigned signal_type)
 	unsigned controller_num;
 	unsigned controller_offset = 0;
 	char controller_name[128];
-	unsigned value;
 	const struct GpioChipset *chipset;
 
 	/* Scan GPIO.* to find a matching signal type */
@@ -748,20 +853,105 @@ static int ReadGpio(unsigned signal_type)
 		return -1;
 	controller_offset += controller_num;
 
-	/* Try reading the GPIO value */
-	snprintf(name, sizeof(name), "%s/gpio%d/value",
-		 GPIO_BASE_PATH, controller_offset);
-	if (ReadFileInt(name, &value) < 0) {
-		/* Try exporting the GPIO */
-		FILE* f = fopen(GPIO_EXPORT_PATH, "wt");
-		if (!f)
+	info->active_high = active_high;
+	info->controller_offset = controller_offset;
+	return 0;
+}
+
+/* Read where to find the GPIO of the specified signal type from the file
+ * saved by SaveGpioCache() since boot.
+ *
+ * Returns 0 if success, or -1 if error. */
+static int LoadGpioCache(unsigned signal_type, struct GpioInfo *info)
+{
+	char name[128];
+	char buf[64];
+
+	snprintf(name, sizeof(name), "%s.%u", GPIO_CACHE_PATH, signal_type);
+	if (!ReadFileString(buf, sizeof(buf), name))
+		return -1;
+	if (2 != sscanf(buf, "%u %u", &info->controller_offset,
+			&info->active_high))
+		return -1;
+	return 0;
+}
+
+/* Save where to find the GPIO of the specified signal type, so that later
+ * runs of crossystem don't need to scan the ACPI GPIO table again.  /run is
+ * cleared each boot, so the file is never out of date.  This is only a
+ * shortcut, so failing to write the file is fine. */
+static void SaveGpioCache(unsigned signal_type, const struct GpioInfo *info)
+{
+	char name[128];
+	char buf[64];
+	int len;
+
+	mkdir(GPIO_CACHE_DIR, 0755);
+	snprintf(name, sizeof(name), "%s.%u", GPIO_CACHE_PATH, signal_type);
+	len = snprintf(buf, sizeof(buf), "%u %u\n", info->controller_offset,
+		       info->active_high);
+	WriteFile(name, buf, len);
+}
+
+/* Read a GPIO of the specified signal type (see ACPI GPIO SignalType).
+ *
+ * The ACPI GPIO table doesn't change while the system is up, so where to find
+ * each signal is only looked up once per boot.  The GPIO value itself is
+ * read every time.
+ *
+ * Returns 1 if the signal is asserted, 0 if not asserted, or -1 if error. */
+static int ReadGpio(unsigned signal_type)
+{
+	static struct GpioInfo gpio_info[GPIO_SIGNAL_TYPE_PHASE_ENFORCEMENT + 1];
+	struct GpioInfo *info;
+	char name[128];
+	unsigned value;
+	int from_file = 0;
+	FILE *f;
+
+	if (signal_type >= sizeof(gpio_info) / sizeof(gpio_info[0]))
+		return -1;
+	info = &gpio_info[signal_type];
+	if (!info->found && 0 == LoadGpioCache(signal_type, info)) {
+		info->found = 1;
+		from_file = 1;
+	}
+
+	while (1) {
+		if (!info->found) {
+			info->found = FindGpio(signal_type, info) ? -1 : 1;
+			if (info->found > 0)
+				SaveGpioCache(signal_type, info);
+		}
+		if (info->found < 0)
 			return -1;
-		fprintf(f, "%u", controller_offset);
-		fclose(f);
 
-		/* Try re-reading the GPIO value */
-		if (ReadFileInt(name, &value) < 0)
+		/* Try reading the GPIO value */
+		snprintf(name, sizeof(name), "%s/gpio%d/value",
+			 GPIO_BASE_PATH, info->controller_offset);
+		if (ReadFileInt(name, &value) == 0)
+			break;
+
+		/* Try exporting the GPIO */
+		f = fopen(GPIO_EXPORT_PATH, "wt");
+		if (f) {
+			fprintf(f, "%u", info->controller_offset);
+			fclose(f);
+
+			/* Try re-reading the GPIO value */
+			if (ReadFileInt(name, &value) == 0)
+				break;
+		}
+
+		/* Don't trust a saved GPIO which can't be read; look it up
+		 * again instead. */
+		if (!from_file)
 			return -1;
+		from_file = 0;
+		info->found = 0;
+		snprintf(name, sizeof(name), "%s.%u", GPIO_CACHE_PATH,
+			 signal_type);
+		unlink(name);
 	}
 
 	/* Normalize the value read from the kernel in case it is not always
@@ -770,7 +960,7 @@ static int ReadGpio(unsigned signal_type)
 
 	/* Compare the GPIO value with the active value and return 1 if
 	 * match. */
-	return (value == active_high ? 1 : 0);
+	return (value == info->active_high ? 1 : 0);
 }
 
 
@@ -24,6 +24,7 @@ typedef struct CgptCreateParams {
 	uint64_t drive_size;
 	int zap;
 	uint64_t padding;
+	uint32_t num_entries;	/* 0 means MAX_NUMBER_OF_ENTRIES */
 } CgptCreateParams;
 
 typedef struct CgptAddParams {
@@ -70,6 +71,8 @@ typedef struct CgptShowParams {
 	int single_item;
 	int debug;
 	int num_partitions;
+	int json;
+	uint32_t json_fields;  /* Bitmask of fields for json; 0 for all */
 } CgptShowParams;
 
 typedef struct CgptRepairParams {
@@ -117,6 +120,12 @@ typedef struct CgptFindParams {
 	const char *label;
 	int hits;
 	int match_partnum;           /* 1-based; 0 means no match */
+	/* When scanning all drives, load up to this many at once; 0 or 1
+	 * means one at a time. */
+	int jobs;
+	/* If not NULL, index of partition tables to answer from, for drives
+	 * that haven't changed, and to update for the others. */
+	const char *cache_file;
 	/* when working with MTD, we actually work on a temp file, but we still
 	 * need to print the device name. so this parameter is here to properly
 	 * show the correct device name in that special case. */
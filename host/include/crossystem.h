@@ -32,6 +32,39 @@ int VbGetSystemPropertyInt(const char* name);
 const char* VbGetSystemPropertyString(const char* name, char* dest,
 				      size_t size);
 
+/* Take a snapshot of the firmware data behind the system properties
+ * (VbSharedData and NV storage).  Until VbReleaseSystemPropertySnapshot(),
+ * properties are answered from the snapshot instead of reading that data
+ * again for each one, which helps when reading many properties at once.
+ *
+ * If the data can't be read, properties are read as usual. */
+void VbSnapshotSystemProperties(void);
+
+/* Release the snapshot taken by VbSnapshotSystemProperties(). */
+void VbReleaseSystemPropertySnapshot(void);
+
+/* Hold writes to NV storage until VbCommitSystemPropertyWrites(), which
+ * reads NV storage once, applies all of them, and writes it once, instead of
+ * once per property.  Properties read meanwhile include the held writes. */
+void VbBeginSystemPropertyWrites(void);
+
+/* Write NV storage changes held since VbBeginSystemPropertyWrites().
+ *
+ * Returns 0 if success, -1 if error. */
+int VbCommitSystemPropertyWrites(void);
+
+/* Wait up to timeout_ms milliseconds for system properties to change.
+ *
+ * Where the NV storage is a file, this returns as soon as something writes
+ * it; otherwise it waits the whole timeout.  Either way, NV storage is read
+ * again the next time a property needs it.  VbSharedData in a snapshot is
+ * kept, since it doesn't change until the next boot.  Properties read from
+ * elsewhere (such as switch positions) can change without a wakeup, so
+ * callers should check them again after every return.
+ *
+ * Returns 1 if NV storage was written, 0 if the timeout passed. */
+int VbWaitForSystemPropertyChange(int timeout_ms);
+
 /* Sets a system property integer.
  *
  * Returns 0 if success, -1 if error. */
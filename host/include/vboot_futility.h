@@ -0,0 +1,133 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * futility functions exported for use by userspace programs, in
+ * libvboot_futility.  For GPT editing, see the cgpt functions in
+ * vboot_host.h.
+ */
+
+#ifndef VBOOT_FUTILITY_H_
+#define VBOOT_FUTILITY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/****************************************************************************/
+/* Commands */
+
+/*
+ * Runs a futility command in this process, as if argv[] were the arguments of
+ * the futility program: argv[0] is either "futility", followed by any global
+ * options and the command, or the name of the command itself.  For example,
+ * {"futility", "sign", "--signprivate", "key.vbprivk", "in", "out", NULL}
+ * or {"verify", "--publickey", "key.vbpubk", "image.bin", NULL}.
+ *
+ * Each call starts over with the command's default options.  Output goes to
+ * stdout and stderr, as from the program.  The command may rearrange argv[],
+ * but not the strings it points to.  A few unrecoverable errors (such as
+ * running out of memory) still exit the process, as they would the program.
+ * This is not thread safe.
+ *
+ * Returns the exit status the program would have had; zero on success.
+ */
+int FutilityRun(int argc, char *argv[]);
+
+/*
+ * Identifies a file as one of the things futility knows how to handle.
+ *
+ * Returns the short name of its type, as "futility show --type" takes; for
+ * example "keyblock", "fw_pre", "bios" or "unknown".  Returns NULL if the file
+ * can't be read.
+ */
+const char *FutilityFileType(const char *filename);
+
+/****************************************************************************/
+/* Firmware updater */
+
+/* Options for updater_setup_config(), as "futility update" takes them */
+struct updater_config_arguments {
+	char *image, *ec_image, *pd_image;
+	char *archive, *quirks, *mode;
+	const char *programmer;
+	char *model, *signature_id;
+	char *emulation, *sys_props, *write_protection;
+	char *output_dir;
+	char *repack, *unpack;
+	char *flash_cache;
+	int is_factory, try_update, force_update, do_manifest, host_only;
+	int fast_update;
+	int dry_run;
+	int verbosity;
+};
+
+enum updater_error_codes {
+	UPDATE_ERR_DONE,
+	UPDATE_ERR_NEED_RO_UPDATE,
+	UPDATE_ERR_NO_IMAGE,
+	UPDATE_ERR_SYSTEM_IMAGE,
+	UPDATE_ERR_INVALID_IMAGE,
+	UPDATE_ERR_SET_COOKIES,
+	UPDATE_ERR_WRITE_FIRMWARE,
+	UPDATE_ERR_PLATFORM,
+	UPDATE_ERR_TARGET,
+	UPDATE_ERR_ROOT_KEY,
+	UPDATE_ERR_TPM_ROLLBACK,
+	UPDATE_ERR_UNKNOWN,
+};
+
+/* Messages explaining enum updater_error_codes. */
+extern const char * const updater_error_messages[];
+
+/*
+ * Opaque to callers outside futility.  Each updater_config holds everything
+ * about one device being updated, so several devices (for example, ones
+ * reached through different servo programmers) can be updated at once, one
+ * thread per config.
+ */
+struct updater_config;
+
+/*
+ * Allocates and initializes a updater_config object with default values.
+ * Returns the newly allocated object, or NULL on error.
+ */
+struct updater_config *updater_new_config(void);
+
+/*
+ * Helper function to setup an allocated updater_config object.  Sets
+ * *do_update to zero if the arguments asked for something other than an
+ * update, which has then been done (for example, unpacking an archive).
+ * Returns number of failures, or 0 on success.
+ */
+int updater_setup_config(struct updater_config *cfg,
+			 const struct updater_config_arguments *arg,
+			 int *do_update);
+
+/*
+ * Makes cfg use the archive that updater_setup_config() opened for another
+ * config, and the manifest read from it, instead of opening the archive
+ * again.  Call before updater_setup_config(cfg, ...), with the same archive
+ * in its arguments.  The archive stays open until both configs are deleted.
+ * Returns 0 on success, or non-zero if from has no archive or cfg already has
+ * one.
+ */
+int updater_share_archive(struct updater_config *cfg,
+			  const struct updater_config *from);
+
+/*
+ * The main updater to update system firmware using the configuration parameter.
+ * Returns UPDATE_ERR_DONE if success, otherwise failure.
+ */
+enum updater_error_codes update_firmware(struct updater_config *cfg);
+
+/*
+ * Releases all resources in an updater configuration object.
+ */
+void updater_delete_config(struct updater_config *cfg);
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#endif  /* VBOOT_FUTILITY_H_ */
@@ -10,6 +10,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 
 /****************************************************************************/
 /* EFI GPT manipulation */
@@ -72,6 +73,17 @@ char *FindKernelConfig(const char *filename,
 int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 		   void **vmlinuz_out, size_t *vmlinuz_size);
 
+/* Number of pieces ExtractVmlinuzSegments() splits a vmlinuz into */
+#define VMLINUZ_SEGMENTS 2
+
+/* Like ExtractVmlinuz(), but without the copy.  Fills segments[] with the
+ * vmlinuz header and the kernel body, both pointing into kpart_data, so the
+ * caller can hash them or write them out with writev().  Success is
+ * indicated by a zero return value.
+ */
+int ExtractVmlinuzSegments(void *kpart_data, size_t kpart_size,
+			   struct iovec segments[VMLINUZ_SEGMENTS]);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
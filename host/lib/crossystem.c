@@ -10,11 +10,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
+#ifndef HAVE_MACOS
+#include <sys/inotify.h>
+#endif
 
 #include "2sysincludes.h"
 #include "2api.h"
@@ -40,7 +45,11 @@ typedef enum VdatStringField {
 	VDAT_STRING_TIMERS = 0,           /* Timer values */
 	VDAT_STRING_LOAD_FIRMWARE_DEBUG,  /* LoadFirmware() debug information */
 	VDAT_STRING_LOAD_KERNEL_DEBUG,    /* LoadKernel() debug information */
-	VDAT_STRING_MAINFW_ACT            /* Active main firmware */
+	VDAT_STRING_MAINFW_ACT,           /* Active main firmware */
+	VDAT_STRING_TRACE,                /* Boot trace */
+	VDAT_STRING_TPM_STATS,            /* TPM command statistics */
+	VDAT_STRING_DISK_READS,           /* LoadKernel() disk reads */
+	VDAT_STRING_COSTS                 /* Verification step costs */
 } VdatStringField;
 
 
@@ -96,18 +105,118 @@ int FwidStartsWith(const char *start)
 	return 0 == strncmp(fwid, start, strlen(start));
 }
 
+/* VbSharedData saved by VbSnapshotSystemProperties(), or NULL if none */
+static VbSharedDataHeader *vdat_snapshot;
+
+/* Return VbSharedData, from the snapshot if there is one.  Free with
+ * PutVdat(). */
+static VbSharedDataHeader *GetVdat(void)
+{
+	return vdat_snapshot ? vdat_snapshot : VbSharedDataRead();
+}
+
+static void PutVdat(VbSharedDataHeader *sh)
+{
+	if (sh && sh != vdat_snapshot)
+		free(sh);
+}
+
 static int vnc_read;
 
+void VbSnapshotSystemProperties(void)
+{
+	VbReleaseSystemPropertySnapshot();
+	vdat_snapshot = VbSharedDataRead();
+
+	/* Re-read NV storage the next time it's needed, then keep it */
+	vnc_read = 0;
+}
+
+void VbReleaseSystemPropertySnapshot(void)
+{
+	VbSharedDataHeader *sh = vdat_snapshot;
+
+	vdat_snapshot = NULL;
+	free(sh);
+}
+
+/* Returns an inotify descriptor watching writes to NV storage, or -1 if it
+ * can't be watched. */
+static int GetNvStorageWatch(void)
+{
+#ifndef HAVE_MACOS
+	static int watch_fd = -2;
+	char path[PATH_MAX];
+
+	if (watch_fd != -2)
+		return watch_fd;
+
+	watch_fd = -1;
+	if (vb2_get_nv_storage_path(path, sizeof(path)))
+		return -1;
+	watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch_fd < 0)
+		return -1;
+	if (inotify_add_watch(watch_fd, path, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+		close(watch_fd);
+		watch_fd = -1;
+	}
+	return watch_fd;
+#else
+	return -1;
+#endif
+}
+
+int VbWaitForSystemPropertyChange(int timeout_ms)
+{
+	struct pollfd pfd = {
+		.fd = GetNvStorageWatch(),
+		.events = POLLIN,
+	};
+	char events[4096];
+	int changed = 0;
+
+	if (pfd.fd >= 0 && poll(&pfd, 1, timeout_ms) > 0) {
+		/* Writers usually write several times; take them all */
+		while (read(pfd.fd, events, sizeof(events)) > 0)
+			;
+		changed = 1;
+	} else if (pfd.fd < 0) {
+		poll(NULL, 0, timeout_ms);
+	}
+
+	vnc_read = 0;
+	return changed;
+}
+
+/* Max NV storage writes held between VbBeginSystemPropertyWrites() and
+ * VbCommitSystemPropertyWrites(); more than that are written early. */
+#define MAX_PENDING_NV_WRITES 64
+
+/* Held NV storage writes, each param only once; count is -1 if not
+ * holding writes. */
+static struct vb2_nv_setting pending_nv[MAX_PENDING_NV_WRITES];
+static int pending_nv_count = -1;
+
 int vb2_get_nv_storage(enum vb2_nv_param param)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
 	static struct vb2_context cached_ctx;
+	int i;
+
+	/* Writes not yet committed win */
+	for (i = 0; i < pending_nv_count; i++) {
+		if (pending_nv[i].param == param)
+			return (int)pending_nv[i].value;
+	}
 
 	/* TODO: locking around NV access */
 	if (!vnc_read) {
+		VbSharedDataHeader *sh = GetVdat();
+
 		memset(&cached_ctx, 0, sizeof(cached_ctx));
 		if (sh && sh->flags & VBSD_NVDATA_V2)
 			cached_ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+		PutVdat(sh);
 		if (0 != vb2_read_nv_storage(&cached_ctx))
 			return -1;
 		vb2_nv_init(&cached_ctx);
@@ -121,19 +230,24 @@ int vb2_get_nv_storage(enum vb2_nv_param param)
 	return (int)vb2_nv_get(&cached_ctx, param);
 }
 
-int vb2_set_nv_storage(enum vb2_nv_param param, int value)
+/* Write settings to NV storage, with one read and at most one write.
+ *
+ * Returns 0 if success, -1 if error. */
+static int vb2_set_nv_storage_many(const struct vb2_nv_setting *settings,
+				   int count)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader* sh = GetVdat();
 	struct vb2_context ctx;
 
 	/* TODO: locking around NV access */
 	memset(&ctx, 0, sizeof(ctx));
 	if (sh && sh->flags & VBSD_NVDATA_V2)
 		ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	PutVdat(sh);
 	if (0 != vb2_read_nv_storage(&ctx))
 		return -1;
 	vb2_nv_init(&ctx);
-	vb2_nv_set(&ctx, param, (uint32_t)value);
+	vb2_nv_set_many(&ctx, settings, count);
 
 	if (ctx.flags & VB2_CONTEXT_NVDATA_CHANGED) {
 		vnc_read = 0;
@@ -145,6 +259,48 @@ int vb2_set_nv_storage(enum vb2_nv_param param, int value)
 	return 0;
 }
 
+int vb2_set_nv_storage(enum vb2_nv_param param, int value)
+{
+	struct vb2_nv_setting setting = {
+		.param = param,
+		.value = (uint32_t)value,
+	};
+	int i;
+
+	if (pending_nv_count < 0)
+		return vb2_set_nv_storage_many(&setting, 1);
+
+	for (i = 0; i < pending_nv_count; i++) {
+		if (pending_nv[i].param == param) {
+			pending_nv[i].value = setting.value;
+			return 0;
+		}
+	}
+	if (pending_nv_count == MAX_PENDING_NV_WRITES) {
+		if (vb2_set_nv_storage_many(pending_nv, pending_nv_count))
+			return -1;
+		pending_nv_count = 0;
+	}
+	pending_nv[pending_nv_count++] = setting;
+	return 0;
+}
+
+void VbBeginSystemPropertyWrites(void)
+{
+	if (pending_nv_count < 0)
+		pending_nv_count = 0;
+}
+
+int VbCommitSystemPropertyWrites(void)
+{
+	int count = pending_nv_count;
+
+	pending_nv_count = -1;
+	if (count <= 0)
+		return 0;
+	return vb2_set_nv_storage_many(pending_nv, count);
+}
+
 /*
  * Set a param value, and try to flag it for persistent backup.  It's okay if
  * backup isn't supported (which it isn't, in current designs). It's
@@ -325,9 +481,237 @@ LoadKernelDebugExit:
 	return dest;
 }
 
+/* Names for enum vb2_trace_event */
+static const char *const trace_event_names[VB2_TRACE_EVENT_COUNT] = {
+	[VB2_TRACE_GBB_READ] = "gbb_read",
+	[VB2_TRACE_KEYBLOCK_VERIFY] = "keyblock_verify",
+	[VB2_TRACE_PREAMBLE_VERIFY] = "preamble_verify",
+	[VB2_TRACE_BODY_HASH] = "body_hash",
+	[VB2_TRACE_RSA] = "rsa",
+	[VB2_TRACE_TPM_COMMAND] = "tpm_command",
+	[VB2_TRACE_DISK_READ] = "disk_read",
+	[VB2_TRACE_KEYBLOCK_HASH] = "keyblock_hash",
+	[VB2_TRACE_VBLOCK_EARLY_CHECK] = "vblock_early_check",
+};
+
+static char *GetVdatTrace(char *dest, int size, const VbSharedDataHeader *sh)
+{
+	const struct vb2_trace_entry *entry, *begin;
+	uint32_t first = 0, i, j;
+	int used = 0;
+
+	/* Older firmware doesn't record a trace */
+	if (sh->struct_version < 3)
+		return NULL;
+
+	/* Make sure we have space for truncation warning */
+	if (size < strlen(TRUNCATED) + 1)
+		return NULL;
+	size -= strlen(TRUNCATED) + 1;
+	*dest = '\0';
+
+	if (sh->trace_count > VB2_TRACE_ENTRIES)
+		first = sh->trace_count - VB2_TRACE_ENTRIES;
+	for (i = first; i < sh->trace_count; i++) {
+		entry = sh->trace + (i & (VB2_TRACE_ENTRIES - 1));
+
+		used += snprintf(dest + used, size - used, "%10u ",
+				 entry->time_us);
+		if (entry->event < VB2_TRACE_EVENT_COUNT &&
+		    trace_event_names[entry->event])
+			used += snprintf(dest + used, size - used, "%-16s",
+					 trace_event_names[entry->event]);
+		else
+			used += snprintf(dest + used, size - used,
+					 "event_%-10u", entry->event);
+		if (used > size)
+			goto TraceExit;
+
+		if (entry->type == VB2_TRACE_BEGIN) {
+			used += snprintf(dest + used, size - used, " begin\n");
+		} else if (entry->type == VB2_TRACE_END) {
+			/* Find the most recent begin, for the duration */
+			begin = NULL;
+			for (j = i; j-- > first; ) {
+				begin = sh->trace + (j &
+						     (VB2_TRACE_ENTRIES - 1));
+				if (begin->event == entry->event)
+					break;
+				begin = NULL;
+			}
+			if (begin && begin->type == VB2_TRACE_BEGIN)
+				used += snprintf(dest + used, size - used,
+						 " end (%u us)\n",
+						 entry->time_us -
+						 begin->time_us);
+			else
+				used += snprintf(dest + used, size - used,
+						 " end\n");
+		} else {
+			used += snprintf(dest + used, size - used, " type %u\n",
+					 entry->type);
+		}
+		if (used > size)
+			goto TraceExit;
+	}
+
+TraceExit:
+
+	/* Warn if data was truncated; we left space for this above. */
+	if (used > size)
+		strcat(dest, TRUNCATED);
+
+	return dest;
+}
+
+static char *GetVdatTpmStats(char *dest, int size,
+			     const VbSharedDataHeader *sh)
+{
+	const struct vb2_tpm_stat *s;
+	uint32_t count, i;
+	int used = 0;
+
+	/* Older firmware doesn't count TPM commands */
+	if (sh->struct_version < 4)
+		return NULL;
+
+	/* Make sure we have space for truncation warning */
+	if (size < strlen(TRUNCATED) + 1)
+		return NULL;
+	size -= strlen(TRUNCATED) + 1;
+	*dest = '\0';
+
+	count = sh->tpm_stats_count;
+	if (count > VB2_TPM_STAT_ENTRIES)
+		count = VB2_TPM_STAT_ENTRIES;
+
+	used += snprintf(dest + used, size - used,
+			 "%-10s %6s %6s %12s %12s %12s\n", "command",
+			 "count", "errors", "total", "average", "max");
+	for (i = 0; i < count && used <= size; i++) {
+		s = sh->tpm_stats + i;
+		used += snprintf(dest + used, size - used,
+				 "0x%08x %6u %6u %12" PRIu64 " %12" PRIu64
+				 " %12" PRIu64 "\n",
+				 s->command_code, s->count, s->errors,
+				 s->total_time,
+				 s->count ? s->total_time / s->count : 0,
+				 s->max_time);
+	}
+
+	/* Warn if data was truncated; we left space for this above. */
+	if (used > size)
+		strcat(dest, TRUNCATED);
+
+	return dest;
+}
+
+static char *GetVdatDiskReads(char *dest, int size,
+			      const VbSharedDataHeader *sh)
+{
+	static const char * const purposes[] = {
+		[VB2_DISK_READ_OTHER] = "other",
+		[VB2_DISK_READ_GPT_PRIMARY] = "gpt1",
+		[VB2_DISK_READ_GPT_SECONDARY] = "gpt2",
+		[VB2_DISK_READ_VBLOCK] = "vblock",
+		[VB2_DISK_READ_BODY] = "body",
+	};
+	const struct vb2_disk_read *r;
+	uint32_t count, i;
+	int used = 0;
+
+	/* Older firmware doesn't trace disk reads */
+	if (sh->struct_version < 5)
+		return NULL;
+
+	/* Make sure we have space for truncation warning */
+	if (size < strlen(TRUNCATED) + 1)
+		return NULL;
+	size -= strlen(TRUNCATED) + 1;
+	*dest = '\0';
+
+	count = sh->disk_reads_count;
+	if (count > VB2_DISK_READ_ENTRIES)
+		count = VB2_DISK_READ_ENTRIES;
+
+	used += snprintf(dest + used, size - used,
+			 "%-4s %-7s %12s %10s %6s\n", "call", "purpose",
+			 "lba", "sectors", "reads");
+	for (i = 0; i < count && used <= size; i++) {
+		r = sh->disk_reads + i;
+		used += snprintf(dest + used, size - used,
+				 "%-4u %-7s %12" PRIu64 " %10u %6u\n",
+				 r->lk_call,
+				 r->purpose < ARRAY_SIZE(purposes) ?
+				 purposes[r->purpose] : "?",
+				 r->lba_start, r->lba_count, r->requests);
+	}
+	if (sh->disk_reads_dropped && used <= size)
+		used += snprintf(dest + used, size - used,
+				 "%u reads not recorded\n",
+				 sh->disk_reads_dropped);
+
+	/* Warn if data was truncated; we left space for this above. */
+	if (used > size)
+		strcat(dest, TRUNCATED);
+
+	return dest;
+}
+
+static char *GetVdatCosts(char *dest, int size,
+			  const VbSharedDataHeader *sh)
+{
+	static const char * const steps[VB2_COST_STEP_COUNT] = {
+		[VB2_COST_FW_KEYBLOCK] = "fw_keyblock",
+		[VB2_COST_FW_PREAMBLE] = "fw_preamble",
+		[VB2_COST_FW_BODY] = "fw_body",
+		[VB2_COST_KERNEL_KEYBLOCK] = "kernel_keyblock",
+		[VB2_COST_KERNEL_PREAMBLE] = "kernel_preamble",
+	};
+	const struct vb2_cost *c;
+	uint32_t i;
+	int used = 0;
+
+	/* Older firmware doesn't add up costs */
+	if (sh->struct_version < 6)
+		return NULL;
+
+	/* Make sure we have space for truncation warning */
+	if (size < strlen(TRUNCATED) + 1)
+		return NULL;
+	size -= strlen(TRUNCATED) + 1;
+	*dest = '\0';
+
+	used += snprintf(dest + used, size - used,
+			 "%-16s %6s %10s %10s %12s\n", "step", "count",
+			 "total_us", "crypto_us", "hashed");
+	for (i = 0; i < VB2_COST_ENTRIES && used <= size; i++) {
+		c = sh->costs + i;
+		if (!c->count)
+			continue;
+		if (i < VB2_COST_STEP_COUNT && steps[i])
+			used += snprintf(dest + used, size - used, "%-16s ",
+					 steps[i]);
+		else
+			used += snprintf(dest + used, size - used,
+					 "step_%-11u ", i);
+		if (used > size)
+			break;
+		used += snprintf(dest + used, size - used,
+				 "%6u %10u %10u %12u\n", c->count,
+				 c->total_us, c->crypto_us, c->hashed_bytes);
+	}
+
+	/* Warn if data was truncated; we left space for this above. */
+	if (used > size)
+		strcat(dest, TRUNCATED);
+
+	return dest;
+}
+
 static char *GetVdatString(char *dest, int size, VdatStringField field)
 {
-	VbSharedDataHeader *sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = GetVdat();
 	char *value = dest;
 
 	if (!sh)
@@ -355,6 +739,22 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			value = GetVdatLoadKernelDebug(dest, size, sh);
 			break;
 
+		case VDAT_STRING_TRACE:
+			value = GetVdatTrace(dest, size, sh);
+			break;
+
+		case VDAT_STRING_TPM_STATS:
+			value = GetVdatTpmStats(dest, size, sh);
+			break;
+
+		case VDAT_STRING_DISK_READS:
+			value = GetVdatDiskReads(dest, size, sh);
+			break;
+
+		case VDAT_STRING_COSTS:
+			value = GetVdatCosts(dest, size, sh);
+			break;
+
 		case VDAT_STRING_MAINFW_ACT:
 			switch(sh->firmware_index) {
 				case 0:
@@ -376,13 +776,13 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			break;
 	}
 
-	free(sh);
+	PutVdat(sh);
 	return value;
 }
 
 static int GetVdatInt(VdatIntField field)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader* sh = GetVdat();
 	int value = -1;
 
 	if (!sh)
@@ -441,7 +841,7 @@ static int GetVdatInt(VdatIntField field)
 		}
 	}
 
-	free(sh);
+	PutVdat(sh);
 	return value;
 }
 
@@ -602,6 +1002,14 @@ const char *VbGetSystemPropertyString(const char *name, char *dest,
 				     VDAT_STRING_LOAD_FIRMWARE_DEBUG);
 	} else if (!strcasecmp(name, "vdat_lkdebug")) {
 		return GetVdatString(dest, size, VDAT_STRING_LOAD_KERNEL_DEBUG);
+	} else if (!strcasecmp(name, "vboot_trace")) {
+		return GetVdatString(dest, size, VDAT_STRING_TRACE);
+	} else if (!strcasecmp(name, "vboot_costs")) {
+		return GetVdatString(dest, size, VDAT_STRING_COSTS);
+	} else if (!strcasecmp(name, "vboot_disk_reads")) {
+		return GetVdatString(dest, size, VDAT_STRING_DISK_READS);
+	} else if (!strcasecmp(name, "vboot_tpm_stats")) {
+		return GetVdatString(dest, size, VDAT_STRING_TPM_STATS);
 	} else if (!strcasecmp(name, "fw_try_next")) {
 		return vb2_get_nv_storage(VB2_NV_TRY_NEXT) ? "B" : "A";
 	} else if (!strcasecmp(name, "fw_tried")) {
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include "2common.h"
 #include "2struct.h"
@@ -15,8 +16,9 @@
 #include "vboot_struct.h"
 
 
-int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
-		   void **vmlinuz_out, size_t *vmlinuz_size) {
+int ExtractVmlinuzSegments(void *kpart_data, size_t kpart_size,
+			   struct iovec segments[VMLINUZ_SEGMENTS])
+{
 	size_t now = 0;
 	struct vb2_kernel_preamble *preamble = NULL;
 	uint8_t *kblob_data = NULL;
@@ -24,11 +26,12 @@ int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 	uint32_t vmlinuz_header_size = 0;
 	uint64_t vmlinuz_header_address = 0;
 	uint64_t vmlinuz_header_offset = 0;
-	void *vmlinuz = NULL;
 
 	struct vb2_keyblock *keyblock = (struct vb2_keyblock *)kpart_data;
+	if (kpart_size < sizeof(*keyblock))
+		return 1;
 	now += keyblock->keyblock_size;
-	if (now > kpart_size)
+	if (now > kpart_size || kpart_size - now < sizeof(*preamble))
 		return 1;
 
 	preamble = (struct vb2_kernel_preamble *)(kpart_data + now);
@@ -39,7 +42,7 @@ int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 	kblob_data = kpart_data + now;
 	kblob_size = preamble->body_signature.data_size;
 
-	if (!kblob_data || (now + kblob_size) > kpart_size)
+	if (kblob_size > kpart_size - now)
 		return 1;
 
 	if (preamble->header_version_minor > 0) {
@@ -48,10 +51,8 @@ int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 	}
 
 	if (!vmlinuz_header_size ||
-	    kpart_data + vmlinuz_header_offset + vmlinuz_header_size >
-	    kpart_data) {
+	    vmlinuz_header_address < preamble->body_load_address)
 		return 1;
-	}
 
 	// calculate the vmlinuz_header offset from
 	// the beginning of the kpart_data.  The kblob doesn't
@@ -62,17 +63,36 @@ int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 		keyblock->keyblock_size +
 		preamble->preamble_size;
 
-	vmlinuz = malloc(vmlinuz_header_size + kblob_size);
-	if (vmlinuz == NULL)
+	if (vmlinuz_header_offset > kpart_size ||
+	    vmlinuz_header_size > kpart_size - vmlinuz_header_offset)
 		return 1;
 
-	memcpy(vmlinuz, kpart_data + vmlinuz_header_offset,
-	       vmlinuz_header_size);
+	segments[0].iov_base = kpart_data + vmlinuz_header_offset;
+	segments[0].iov_len = vmlinuz_header_size;
+	segments[1].iov_base = kblob_data;
+	segments[1].iov_len = kblob_size;
+
+	return 0;
+}
+
+int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
+		   void **vmlinuz_out, size_t *vmlinuz_size) {
+	struct iovec segments[VMLINUZ_SEGMENTS];
+	uint8_t *vmlinuz;
+
+	if (ExtractVmlinuzSegments(kpart_data, kpart_size, segments))
+		return 1;
+
+	vmlinuz = malloc(segments[0].iov_len + segments[1].iov_len);
+	if (vmlinuz == NULL)
+		return 1;
 
-	memcpy(vmlinuz + vmlinuz_header_size, kblob_data, kblob_size);
+	memcpy(vmlinuz, segments[0].iov_base, segments[0].iov_len);
+	memcpy(vmlinuz + segments[0].iov_len, segments[1].iov_base,
+	       segments[1].iov_len);
 
 	*vmlinuz_out = vmlinuz;
-	*vmlinuz_size = vmlinuz_header_size + kblob_size;
+	*vmlinuz_size = segments[0].iov_len + segments[1].iov_len;
 
 	return 0;
 }
@@ -5,6 +5,7 @@
  * Utility functions for file and key handling.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,23 +22,76 @@
 #include "host_common.h"
 #include "signature_digest.h"
 
-int DigestFile(char *input_file, enum vb2_hash_algorithm alg,
-	       uint8_t *digest, uint32_t digest_size)
+/* Input is hashed this much at a time, so memory use doesn't grow with it */
+#define DIGEST_FILE_BUF_SIZE (1024 * 1024)
+/* Alignment direct I/O needs for the buffer, offset and size */
+#define DIGEST_FILE_ALIGN 4096
+
+int DigestFileFlags(const char *input_file, enum vb2_hash_algorithm alg,
+		    uint8_t *digest, uint32_t digest_size, uint32_t flags)
 {
-	int input_fd, len;
-	uint8_t data[VB2_SHA1_BLOCK_SIZE];
 	struct vb2_digest_context ctx;
+	uint8_t *buf = NULL;
+	int direct = 0;
+	int input_fd = -1;
+	ssize_t len;
+	int rv;
 
-	if( (input_fd = open(input_file, O_RDONLY)) == -1 ) {
+#ifdef O_DIRECT
+	if (flags & DIGEST_FILE_DIRECT) {
+		input_fd = open(input_file, O_RDONLY | O_DIRECT);
+		direct = (input_fd != -1);
+	}
+#endif
+	/* Not every filesystem can do direct I/O, so fall back to reads */
+	if (input_fd == -1)
+		input_fd = open(input_file, O_RDONLY);
+	if (input_fd == -1) {
 		fprintf(stderr, "Couldn't open %s\n", input_file);
 		return VB2_ERROR_UNKNOWN;
 	}
-	vb2_digest_init(&ctx, alg);
-	while ((len = read(input_fd, data, sizeof(data))) == sizeof(data))
-		vb2_digest_extend(&ctx, data, len);
-	if (len != -1)
-		vb2_digest_extend(&ctx, data, len);
+	if (!direct)
+		posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (posix_memalign((void **)&buf, DIGEST_FILE_ALIGN,
+			   DIGEST_FILE_BUF_SIZE)) {
+		close(input_fd);
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	rv = vb2_digest_init(&ctx, alg);
+	while (rv == VB2_SUCCESS) {
+		len = read(input_fd, buf, DIGEST_FILE_BUF_SIZE);
+		if (len == 0)
+			break;
+		if (len > 0) {
+			rv = vb2_digest_extend(&ctx, buf, len);
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+#ifdef O_DIRECT
+		/* Some filesystems only refuse direct I/O once it's read */
+		if (direct && errno == EINVAL) {
+			fcntl(input_fd, F_SETFL,
+			      fcntl(input_fd, F_GETFL) & ~O_DIRECT);
+			direct = 0;
+			continue;
+		}
+#endif
+		fprintf(stderr, "Couldn't read %s\n", input_file);
+		rv = VB2_ERROR_UNKNOWN;
+	}
+	if (rv == VB2_SUCCESS)
+		rv = vb2_digest_finalize(&ctx, digest, digest_size);
+
+	free(buf);
 	close(input_fd);
+	return rv;
+}
 
-	return vb2_digest_finalize(&ctx, digest, digest_size);
+int DigestFile(const char *input_file, enum vb2_hash_algorithm alg,
+	       uint8_t *digest, uint32_t digest_size)
+{
+	return DigestFileFlags(input_file, alg, digest, digest_size, 0);
 }
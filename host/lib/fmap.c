@@ -4,44 +4,109 @@
  * found in the LICENSE file.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 
 #include "fmap.h"
 
-static int is_fmap(uint8_t *ptr)
+/* Returns 1 if ptr has a FMAP signature and a version we understand. */
+static int is_fmap_quiet(const uint8_t *ptr)
 {
-	FmapHeader *fmap_header = (FmapHeader *)ptr;
+	const FmapHeader *fmap_header = (const FmapHeader *)ptr;
 
-	if (0 != memcmp(ptr, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
-		return 0;
+	return !memcmp(ptr, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE) &&
+		fmap_header->fmap_ver_major == FMAP_VER_MAJOR;
+}
 
-	if (fmap_header->fmap_ver_major == FMAP_VER_MAJOR)
-		return 1;
+static void warn_fmap_version(const uint8_t *ptr)
+{
+	const FmapHeader *fmap_header = (const FmapHeader *)ptr;
 
 	fprintf(stderr, "Found FMAP, but major version is %u instead of %u\n",
 		fmap_header->fmap_ver_major, FMAP_VER_MAJOR);
-	return 0;
 }
 
-/* Find and point to the FMAP header within the buffer */
+/* The last FMAP found, so repeated lookups on one buffer are free. */
+struct fmap_cache_entry {
+	const uint8_t *ptr;
+	size_t size;
+	size_t offset;
+};
+static struct fmap_cache_entry fmap_cache;
+static pthread_mutex_t fmap_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Find and point to the FMAP header within the buffer.
+ *
+ * The FMAP may be at any FMAP_SEARCH_STRIDE-aligned offset.  To find the
+ * "right" one when there are several, offset 0 wins, then the candidate with
+ * the largest power-of-two alignment, then the lowest offset.  Rather than
+ * stepping through every aligned offset, we let memmem() find the signatures
+ * and rank them.
+ */
 FmapHeader *fmap_find(uint8_t *ptr, size_t size)
 {
-	ssize_t offset, align;
-	ssize_t lim = size - sizeof(FmapHeader);
+	const uint8_t *p, *end, *bad = NULL;
+	size_t offset, best = 0, best_align = 0;
+	struct fmap_cache_entry cached;
+	int found = 0;
+
+	if (size < sizeof(FmapHeader))
+		return NULL;
 
-	if (lim >= 0 && is_fmap(ptr))
+	if (is_fmap_quiet(ptr))
 		return (FmapHeader *)ptr;
+	if (!memcmp(ptr, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
+		bad = ptr;
 
-	/* Search large alignments before small ones to find "right" FMAP. */
-	for (align = FMAP_SEARCH_STRIDE; align <= lim; align *= 2);
-	for (; align >= FMAP_SEARCH_STRIDE; align /= 2)
-		for (offset = align; offset <= lim; offset += align * 2)
-			if (is_fmap(ptr + offset))
-				return (FmapHeader *)(ptr + offset);
+	/*
+	 * Nobody writes a second FMAP into an image they are working on, so
+	 * if the one we found last time is still there, it is still the one.
+	 */
+	pthread_mutex_lock(&fmap_cache_lock);
+	cached = fmap_cache;
+	pthread_mutex_unlock(&fmap_cache_lock);
+	if (cached.ptr == ptr && cached.size == size &&
+	    is_fmap_quiet(ptr + cached.offset))
+		return (FmapHeader *)(ptr + cached.offset);
 
-	return NULL;
+	end = ptr + size - sizeof(FmapHeader) + FMAP_SIGNATURE_SIZE;
+	for (p = ptr + 1; p < end; p++) {
+		size_t align;
+
+		p = memmem(p, end - p, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+		if (!p)
+			break;
+		offset = p - ptr;
+		if (offset % FMAP_SEARCH_STRIDE)
+			continue;
+		if (!is_fmap_quiet(p)) {
+			if (!bad)
+				bad = p;
+			continue;
+		}
+		align = offset & -offset;
+		if (!found || align > best_align) {
+			best = offset;
+			best_align = align;
+			found = 1;
+		}
+	}
+
+	if (!found) {
+		if (bad)
+			warn_fmap_version(bad);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&fmap_cache_lock);
+	fmap_cache.ptr = ptr;
+	fmap_cache.size = size;
+	fmap_cache.offset = best;
+	pthread_mutex_unlock(&fmap_cache_lock);
+	return (FmapHeader *)(ptr + best);
 }
 
 /* Search for an area by name, return pointer to its beginning */
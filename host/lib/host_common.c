@@ -16,16 +16,24 @@
 #include "vb2_common.h"
 #include "vboot_common.h"
 
-struct vb2_fw_preamble *vb2_create_fw_preamble(
+/*
+ * Create a firmware preamble, with a table of chunk_digests_size bytes of body
+ * chunk digests if chunk_size is non-zero.
+ */
+static struct vb2_fw_preamble *create_fw_preamble(
 	uint32_t firmware_version,
 	const struct vb2_packed_key *kernel_subkey,
 	const struct vb2_signature *body_signature,
+	uint32_t chunk_size,
+	const uint8_t *chunk_digests,
+	uint32_t chunk_digests_size,
 	const struct vb2_private_key *signing_key,
 	uint32_t flags)
 {
 	uint32_t signed_size = (sizeof(struct vb2_fw_preamble) +
 				kernel_subkey->key_size +
-				body_signature->sig_size);
+				body_signature->sig_size +
+				chunk_digests_size);
 	uint32_t block_size = signed_size +
 		vb2_rsa_sig_size(signing_key->sig_alg);
 
@@ -37,7 +45,8 @@ struct vb2_fw_preamble *vb2_create_fw_preamble(
 
 	uint8_t *kernel_subkey_dest = (uint8_t *)(h + 1);
 	uint8_t *body_sig_dest = kernel_subkey_dest + kernel_subkey->key_size;
-	uint8_t *block_sig_dest = body_sig_dest + body_signature->sig_size;
+	uint8_t *chunk_digests_dest = body_sig_dest + body_signature->sig_size;
+	uint8_t *block_sig_dest = chunk_digests_dest + chunk_digests_size;
 
 	h->header_version_major = FIRMWARE_PREAMBLE_HEADER_VERSION_MAJOR;
 	h->header_version_minor = FIRMWARE_PREAMBLE_HEADER_VERSION_MINOR;
@@ -63,26 +72,203 @@ struct vb2_fw_preamble *vb2_create_fw_preamble(
 		return NULL;
 	}
 
+	/* Copy body chunk digests */
+	if (chunk_size) {
+		h->body_chunk_size = chunk_size;
+		h->body_chunk_digests_offset = chunk_digests_dest - (uint8_t *)h;
+		h->body_chunk_digests_size = chunk_digests_size;
+		memcpy(chunk_digests_dest, chunk_digests, chunk_digests_size);
+	}
+
 	/* Set up signature struct so we can calculate the signature */
 	vb2_init_signature(&h->preamble_signature, block_sig_dest,
 			   vb2_rsa_sig_size(signing_key->sig_alg), signed_size);
 
-	/* Calculate signature */
+	/* Calculate signature, in a work buffer instead of the heap */
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 	struct vb2_signature *sig =
-		vb2_calculate_signature((uint8_t *)h, signed_size, signing_key);
+		vb2_calculate_signature_wb((uint8_t *)h, signed_size,
+					   signing_key, &wb);
+	if (!sig) {
+		free(h);
+		return NULL;
+	}
 	vb2_copy_signature(&h->preamble_signature, sig);
-	free(sig);
 
 	/* Return the header */
 	return h;
 }
 
-struct vb2_kernel_preamble *vb2_create_kernel_preamble(
+struct vb2_fw_preamble *vb2_create_fw_preamble(
+	uint32_t firmware_version,
+	const struct vb2_packed_key *kernel_subkey,
+	const struct vb2_signature *body_signature,
+	const struct vb2_private_key *signing_key,
+	uint32_t flags)
+{
+	return create_fw_preamble(firmware_version, kernel_subkey,
+				  body_signature, 0, NULL, 0, signing_key,
+				  flags);
+}
+
+/*
+ * Calculate the digest of each chunk_size bytes of the body into a new table.
+ * Returns the table, which the caller must free(), or NULL if error.
+ */
+static uint8_t *calculate_chunk_digests(const uint8_t *body,
+					uint32_t body_size,
+					uint32_t chunk_size,
+					enum vb2_hash_algorithm hash_alg,
+					uint32_t *table_size)
+{
+	uint32_t digest_size = vb2_digest_size(hash_alg);
+	uint32_t count = body_size / chunk_size +
+		(body_size % chunk_size ? 1 : 0);
+	const uint8_t **bufs = NULL;
+	uint32_t *sizes = NULL;
+	uint8_t **digests = NULL;
+	uint32_t offset, i;
+	uint8_t *table;
+
+	if (!digest_size)
+		return NULL;
+
+	*table_size = count * digest_size;
+	table = malloc(*table_size ? *table_size : 1);
+	bufs = malloc((count ? count : 1) * sizeof(*bufs));
+	sizes = malloc((count ? count : 1) * sizeof(*sizes));
+	digests = malloc((count ? count : 1) * sizeof(*digests));
+	if (!table || !bufs || !sizes || !digests)
+		goto fail;
+
+	for (i = 0, offset = 0; i < count; i++) {
+		bufs[i] = body + offset;
+		sizes[i] = body_size - offset;
+		if (sizes[i] > chunk_size)
+			sizes[i] = chunk_size;
+		digests[i] = table + i * digest_size;
+		offset += sizes[i];
+	}
+
+	/* The chunks are independent, so they're hashed side by side */
+	if (VB2_SUCCESS != vb2_digest_buffers(count, bufs, sizes, hash_alg,
+					      digests, digest_size))
+		goto fail;
+
+	free(bufs);
+	free(sizes);
+	free(digests);
+	return table;
+
+fail:
+	free(table);
+	free(bufs);
+	free(sizes);
+	free(digests);
+	return NULL;
+}
+
+struct vb2_fw_preamble *vb2_create_fw_preamble_chunked(
+	uint32_t firmware_version,
+	const struct vb2_packed_key *kernel_subkey,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	const struct vb2_private_key *signing_key,
+	uint32_t flags)
+{
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_fw_preamble *h;
+	struct vb2_signature *body_sig;
+	uint32_t table_size;
+	uint8_t *table;
+
+	if (!chunk_size)
+		return NULL;
+
+	table = calculate_chunk_digests(body, body_size, chunk_size,
+					signing_key->hash_alg, &table_size);
+	if (!table)
+		return NULL;
+
+	/* The body signature signs the table, but says how big the body is */
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	body_sig = vb2_calculate_signature_wb(table, table_size, signing_key,
+					      &wb);
+	if (!body_sig) {
+		free(table);
+		return NULL;
+	}
+	body_sig->data_size = body_size;
+
+	h = create_fw_preamble(firmware_version, kernel_subkey, body_sig,
+			       chunk_size, table, table_size, signing_key,
+			       flags);
+	free(table);
+	return h;
+}
+
+int vb2_verify_fw_body(const uint8_t *body,
+		       uint32_t size,
+		       struct vb2_fw_preamble *preamble,
+		       const struct vb2_public_key *key,
+		       const struct vb2_workbuf *wb)
+{
+	struct vb2_signature *sig = &preamble->body_signature;
+	uint32_t chunk_size = vb2_fw_get_body_chunk_size(preamble);
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+	uint32_t table_size;
+	uint8_t *table;
+	int rv;
+
+	if (!chunk_size)
+		return vb2_verify_data(body, size, sig, key, wb);
+
+	if (sig->data_size > size)
+		return VB2_ERROR_VDATA_SIZE;
+
+	/* Check the table in the preamble matches the body */
+	table = calculate_chunk_digests(body, sig->data_size, chunk_size,
+					key->hash_alg, &table_size);
+	if (!table)
+		return VB2_ERROR_VDATA_DIGEST_SIZE;
+	if (table_size != preamble->body_chunk_digests_size ||
+	    memcmp(table, (uint8_t *)preamble +
+		   preamble->body_chunk_digests_offset, table_size)) {
+		free(table);
+		return VB2_ERROR_API_BODY_CHUNK_DIGEST;
+	}
+
+	/* Then check the body signature over the table */
+	rv = vb2_digest_buffer(table, table_size, key->hash_alg,
+			       digest, digest_size);
+	free(table);
+	if (rv)
+		return rv;
+
+	return vb2_verify_digest(key, sig, digest, wb);
+}
+
+/*
+ * Create a kernel preamble, with a table of chunk_digests_size bytes of body
+ * chunk digests if chunk_size is non-zero, for a body compressed with
+ * compression to uncompressed_size bytes.
+ */
+static struct vb2_kernel_preamble *create_kernel_preamble(
 	uint32_t kernel_version,
 	uint64_t body_load_address,
 	uint64_t bootloader_address,
 	uint32_t bootloader_size,
 	const struct vb2_signature *body_signature,
+	uint32_t chunk_size,
+	const uint8_t *chunk_digests,
+	uint32_t chunk_digests_size,
+	uint32_t compression,
+	uint32_t uncompressed_size,
 	uint64_t vmlinuz_header_address,
 	uint32_t vmlinuz_header_size,
 	uint32_t flags,
@@ -90,7 +276,8 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	const struct vb2_private_key *signing_key)
 {
 	uint64_t signed_size = (sizeof(struct vb2_kernel_preamble) +
-				body_signature->sig_size);
+				body_signature->sig_size +
+				chunk_digests_size);
 	uint32_t sig_size = vb2_rsa_sig_size(signing_key->sig_alg);
 	uint32_t block_size = signed_size + sig_size;
 
@@ -105,7 +292,8 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 		return NULL;
 
 	uint8_t *body_sig_dest = (uint8_t *)(h + 1);
-	uint8_t *block_sig_dest = body_sig_dest + body_signature->sig_size;
+	uint8_t *chunk_digests_dest = body_sig_dest + body_signature->sig_size;
+	uint8_t *block_sig_dest = chunk_digests_dest + chunk_digests_size;
 
 	h->header_version_major = KERNEL_PREAMBLE_HEADER_VERSION_MAJOR;
 	h->header_version_minor = KERNEL_PREAMBLE_HEADER_VERSION_MINOR;
@@ -117,22 +305,145 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	h->vmlinuz_header_address = vmlinuz_header_address;
 	h->vmlinuz_header_size = vmlinuz_header_size;
 	h->flags = flags;
+	if (compression != VB2_KERNEL_COMPRESSION_NONE) {
+		h->body_compression = compression;
+		h->body_uncompressed_size = uncompressed_size;
+	}
 
 	/* Copy body signature */
 	vb2_init_signature(&h->body_signature, body_sig_dest,
 			   body_signature->sig_size, 0);
 	vb2_copy_signature(&h->body_signature, body_signature);
 
+	/* Copy body chunk digests */
+	if (chunk_size) {
+		h->body_chunk_size = chunk_size;
+		h->body_chunk_digests_offset = chunk_digests_dest - (uint8_t *)h;
+		h->body_chunk_digests_size = chunk_digests_size;
+		memcpy(chunk_digests_dest, chunk_digests, chunk_digests_size);
+	}
+
 	/* Set up signature struct so we can calculate the signature */
 	vb2_init_signature(&h->preamble_signature, block_sig_dest,
 			   sig_size, signed_size);
 
-	/* Calculate signature */
+	/* Calculate signature, in a work buffer instead of the heap */
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 	struct vb2_signature *sigtmp =
-		vb2_calculate_signature((uint8_t *)h, signed_size, signing_key);
+		vb2_calculate_signature_wb((uint8_t *)h, signed_size,
+					   signing_key, &wb);
+	if (!sigtmp) {
+		free(h);
+		return NULL;
+	}
 	vb2_copy_signature(&h->preamble_signature, sigtmp);
-	free(sigtmp);
 
 	/* Return the header */
 	return h;
 }
+
+struct vb2_kernel_preamble *vb2_create_kernel_preamble(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const struct vb2_signature *body_signature,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key)
+{
+	return create_kernel_preamble(kernel_version, body_load_address,
+				      bootloader_address, bootloader_size,
+				      body_signature, 0, NULL, 0,
+				      VB2_KERNEL_COMPRESSION_NONE, 0,
+				      vmlinuz_header_address,
+				      vmlinuz_header_size, flags,
+				      desired_size, signing_key);
+}
+
+struct vb2_kernel_preamble *vb2_create_kernel_preamble_chunked(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key)
+{
+	if (!chunk_size)
+		return NULL;
+
+	return vb2_create_kernel_preamble_compressed(
+			kernel_version, body_load_address, bootloader_address,
+			bootloader_size, body, body_size, chunk_size,
+			VB2_KERNEL_COMPRESSION_NONE, 0, vmlinuz_header_address,
+			vmlinuz_header_size, flags, desired_size, signing_key);
+}
+
+struct vb2_kernel_preamble *vb2_create_kernel_preamble_compressed(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	uint32_t compression,
+	uint32_t uncompressed_size,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key)
+{
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_kernel_preamble *h;
+	struct vb2_signature *body_sig;
+	uint32_t table_size = 0;
+	uint8_t *table = NULL;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	if (!chunk_size) {
+		body_sig = vb2_calculate_signature_wb(body, body_size,
+						      signing_key, &wb);
+		if (!body_sig)
+			return NULL;
+	} else {
+		table = calculate_chunk_digests(body, body_size, chunk_size,
+						signing_key->hash_alg,
+						&table_size);
+		if (!table)
+			return NULL;
+
+		/*
+		 * The body signature signs the table, but says how big the
+		 * body is.
+		 */
+		body_sig = vb2_calculate_signature_wb(table, table_size,
+						      signing_key, &wb);
+		if (!body_sig) {
+			free(table);
+			return NULL;
+		}
+		body_sig->data_size = body_size;
+	}
+
+	h = create_kernel_preamble(kernel_version, body_load_address,
+				   bootloader_address, bootloader_size,
+				   body_sig, chunk_size, table, table_size,
+				   compression, uncompressed_size,
+				   vmlinuz_header_address, vmlinuz_header_size,
+				   flags, desired_size, signing_key);
+	free(table);
+	return h;
+}
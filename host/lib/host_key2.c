@@ -9,8 +9,10 @@
 
 #include <openssl/pem.h>
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
@@ -124,6 +126,171 @@ void vb2_free_private_key(struct vb2_private_key *key)
 	free(key);
 }
 
+/*
+ * A private key shared by everyone who got it from the same unchanged file.
+ * Entries stay cached after their last reference is put, so loading the key
+ * again later doesn't parse it again; only an entry whose file has changed is
+ * freed then.
+ */
+struct key_cache_entry {
+	char *filename;
+	uint32_t algorithm;		/* for .pem; KEY_CACHE_VBPRIVK if not */
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct vb2_private_key *key;
+	int refcount;
+	int stale;			/* the file has changed since */
+	struct key_cache_entry *next;
+};
+
+#define KEY_CACHE_VBPRIVK UINT32_MAX
+
+static struct key_cache_entry *key_cache;
+static pthread_mutex_t key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int key_cache_same_file(const struct key_cache_entry *e,
+			       const struct stat *st)
+{
+	return e->dev == st->st_dev && e->ino == st->st_ino &&
+		e->size == st->st_size &&
+		e->mtime.tv_sec == st->st_mtim.tv_sec &&
+		e->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/*
+ * Finds the current entry for the file and takes a reference to its key.
+ * Entries for older versions of the file are marked stale, and dropped if
+ * nobody holds them.  Call with key_cache_lock held.
+ */
+static struct vb2_private_key *key_cache_find(const char *filename,
+					      uint32_t algorithm,
+					      const struct stat *st)
+{
+	struct key_cache_entry *e, **prev = &key_cache;
+	struct vb2_private_key *key = NULL;
+
+	while ((e = *prev)) {
+		if (e->stale || e->algorithm != algorithm ||
+		    strcmp(e->filename, filename)) {
+			prev = &e->next;
+		} else if (key_cache_same_file(e, st)) {
+			e->refcount++;
+			key = e->key;
+			prev = &e->next;
+		} else if (e->refcount) {
+			e->stale = 1;
+			prev = &e->next;
+		} else {
+			*prev = e->next;
+			vb2_free_private_key(e->key);
+			free(e->filename);
+			free(e);
+		}
+	}
+	return key;
+}
+
+static struct vb2_private_key *key_cache_get(const char *filename,
+					     uint32_t algorithm)
+{
+	struct key_cache_entry *e;
+	struct vb2_private_key *key, *cached;
+	struct stat st;
+	int cacheable = !stat(filename, &st);
+
+	if (cacheable) {
+		pthread_mutex_lock(&key_cache_lock);
+		key = key_cache_find(filename, algorithm, &st);
+		pthread_mutex_unlock(&key_cache_lock);
+		if (key)
+			return key;
+	}
+
+	/* Parse it without holding up other threads */
+	if (algorithm == KEY_CACHE_VBPRIVK)
+		key = vb2_read_private_key(filename);
+	else
+		key = vb2_read_private_key_pem(filename, algorithm);
+	if (!key || !cacheable)
+		return key;
+
+	e = calloc(1, sizeof(*e));
+	if (!e || !(e->filename = strdup(filename))) {
+		/* Still usable, just not shared; put will free it */
+		free(e);
+		return key;
+	}
+	e->algorithm = algorithm;
+	e->dev = st.st_dev;
+	e->ino = st.st_ino;
+	e->size = st.st_size;
+	e->mtime = st.st_mtim;
+	e->key = key;
+	e->refcount = 1;
+
+	/* Another thread may have loaded it meanwhile; if so, use theirs */
+	pthread_mutex_lock(&key_cache_lock);
+	cached = key_cache_find(filename, algorithm, &st);
+	if (!cached) {
+		e->next = key_cache;
+		key_cache = e;
+	}
+	pthread_mutex_unlock(&key_cache_lock);
+
+	if (cached) {
+		vb2_free_private_key(key);
+		free(e->filename);
+		free(e);
+		key = cached;
+	}
+	return key;
+}
+
+struct vb2_private_key *vb2_get_private_key(const char *filename)
+{
+	return key_cache_get(filename, KEY_CACHE_VBPRIVK);
+}
+
+struct vb2_private_key *vb2_get_private_key_pem(
+		const char *filename,
+		enum vb2_crypto_algorithm algorithm)
+{
+	if (algorithm >= VB2_ALG_COUNT) {
+		VB2_DEBUG("%s() called with invalid algorithm!\n",
+			  __FUNCTION__);
+		return NULL;
+	}
+	return key_cache_get(filename, algorithm);
+}
+
+void vb2_put_private_key(struct vb2_private_key *key)
+{
+	struct key_cache_entry *e, **prev;
+
+	if (!key)
+		return;
+
+	pthread_mutex_lock(&key_cache_lock);
+	for (prev = &key_cache; (e = *prev); prev = &e->next) {
+		if (e->key != key)
+			continue;
+		if (!--e->refcount && e->stale) {
+			*prev = e->next;
+			free(e->filename);
+			free(e);
+		} else {
+			key = NULL;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&key_cache_lock);
+
+	/* A stale key nobody holds any more, or one that was never shared */
+	vb2_free_private_key(key);
+}
+
 int vb2_write_private_key(const char *filename,
 			  const struct vb2_private_key *key)
 {
@@ -5,6 +5,7 @@
  * Host functions for verified boot.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 
 #include "2sysincludes.h"
@@ -21,6 +22,9 @@
 #include "vb2_struct.h"
 #include "vboot_common.h"
 
+/* Most worker threads vb2_create_keyblocks() will start */
+#define CREATE_MAX_THREADS 16
+
 struct vb2_keyblock *vb2_create_keyblock(
 		const struct vb2_packed_key *data_key,
 		const struct vb2_private_key *signing_key,
@@ -61,20 +65,28 @@ struct vb2_keyblock *vb2_create_keyblock(
 		       sizeof(h->keyblock_signature));
 	}
 
-	/* Calculate hash */
-	struct vb2_signature *chk =
-		vb2_sha512_signature((uint8_t*)h, signed_size);
-	vb2_copy_signature(&h->keyblock_hash, chk);
-	free(chk);
+	/* Calculate the hash and signature in a work buffer, not the heap */
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_signature *sigtmp;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	sigtmp = vb2_sha512_signature_wb((uint8_t*)h, signed_size, &wb);
+	if (!sigtmp) {
+		free(h);
+		return NULL;
+	}
+	vb2_copy_signature(&h->keyblock_hash, sigtmp);
 
-	/* Calculate signature */
 	if (signing_key) {
-		struct vb2_signature *sigtmp =
-			vb2_calculate_signature((uint8_t*)h,
-						signed_size,
-						signing_key);
+		vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+		sigtmp = vb2_calculate_signature_wb((uint8_t*)h, signed_size,
+						    signing_key, &wb);
+		if (!sigtmp) {
+			free(h);
+			return NULL;
+		}
 		vb2_copy_signature(&h->keyblock_signature, sigtmp);
-		free(sigtmp);
 	}
 
 	/* Return the header */
@@ -125,10 +137,17 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 			   sig_data_size, signed_size);
 
 	/* Calculate checksum */
-	struct vb2_signature *chk =
-		vb2_sha512_signature((uint8_t*)h, signed_size);
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_signature *chk;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	chk = vb2_sha512_signature_wb((uint8_t*)h, signed_size, &wb);
+	if (!chk) {
+		free(h);
+		return NULL;
+	}
 	vb2_copy_signature(&h->keyblock_hash, chk);
-	free(chk);
 
 	/* Calculate signature */
 	struct vb2_signature *sigtmp =
@@ -142,6 +161,107 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 	return h;
 }
 
+/* A run of keyblocks created by one thread */
+struct create_job {
+	const struct vb2_packed_key *const *data_keys;
+	struct vb2_keyblock **keyblocks;
+	uint32_t count;
+	const struct vb2_private_key *signing_key;
+	uint32_t flags;
+	pthread_t thread;
+	int started;
+	int failed;
+};
+
+static void *create_worker(void *arg)
+{
+	struct create_job *job = arg;
+	uint32_t i;
+
+	for (i = 0; i < job->count; i++) {
+		job->keyblocks[i] = vb2_create_keyblock(job->data_keys[i],
+							job->signing_key,
+							job->flags);
+		if (!job->keyblocks[i])
+			job->failed++;
+	}
+	return NULL;
+}
+
+int vb2_create_keyblocks(const struct vb2_packed_key *const *data_keys,
+			 uint32_t count,
+			 const struct vb2_private_key *signing_key,
+			 uint32_t flags,
+			 int threads,
+			 struct vb2_keyblock **keyblocks)
+{
+	struct create_job jobs[CREATE_MAX_THREADS];
+	uint32_t per_job, start = 0;
+	int failed = 0;
+	int i;
+
+	if (threads > CREATE_MAX_THREADS)
+		threads = CREATE_MAX_THREADS;
+	if (threads > count)
+		threads = count;
+	if (threads < 1)
+		threads = 1;
+	per_job = (count + threads - 1) / threads;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].data_keys = data_keys + start;
+		jobs[i].keyblocks = keyblocks + start;
+		jobs[i].count = count - start < per_job ? count - start :
+			per_job;
+		jobs[i].signing_key = signing_key;
+		jobs[i].flags = flags;
+		jobs[i].failed = 0;
+		start += jobs[i].count;
+
+		/* The last run goes on this thread, as does any we can't start */
+		jobs[i].started = i + 1 < threads &&
+			!pthread_create(&jobs[i].thread, NULL, create_worker,
+					&jobs[i]);
+		if (!jobs[i].started)
+			create_worker(&jobs[i]);
+	}
+
+	for (i = 0; i < threads; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		failed += jobs[i].failed;
+	}
+
+	return failed;
+}
+
+int vb2_create_keyblocks_external(
+		const struct vb2_packed_key *const *data_keys,
+		uint32_t count,
+		const char *signing_key_pem_file,
+		uint32_t algorithm,
+		uint32_t flags,
+		const char *external_signer,
+		struct vb2_keyblock **keyblocks)
+{
+	int failed = 0;
+	uint32_t i;
+
+	/*
+	 * In order, on this thread: requests on a persistent connection to
+	 * the signer can't be interleaved, and it stays open between them.
+	 */
+	for (i = 0; i < count; i++) {
+		keyblocks[i] = vb2_create_keyblock_external(
+			data_keys[i], signing_key_pem_file, algorithm, flags,
+			external_signer);
+		if (!keyblocks[i])
+			failed++;
+	}
+
+	return failed;
+}
+
 struct vb2_keyblock *vb2_read_keyblock(const char *filename)
 {
 	uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE];
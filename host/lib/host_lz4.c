@@ -0,0 +1,120 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * LZ4 compression.
+ *
+ * This is a simple greedy compressor: each position is looked up in a hash
+ * table of the last position with the same 4 bytes, and the first match found
+ * is taken.  It compresses less than the reference lz4 library at its higher
+ * levels, but kernel bodies are only compressed when they are signed.
+ */
+
+#include "2sysincludes.h"
+
+#include "host_lz4.h"
+
+/* Block format limits from the LZ4 block format description */
+#define MIN_MATCH 4
+#define LAST_LITERALS 5  /* Last bytes of the block are always literals */
+#define MATCH_LIMIT 12  /* Last match starts this far from the end at least */
+#define MAX_OFFSET 0xffff
+
+#define HASH_BITS 16
+
+static uint32_t read32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t hash32(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Write the extra size bytes for a token nibble of 15 */
+static uint8_t *put_size(uint8_t *out, uint32_t size)
+{
+	for (size -= 0xf; size >= 0xff; size -= 0xff)
+		*out++ = 0xff;
+	*out++ = size;
+	return out;
+}
+
+/* Write a sequence; match_size is 0 for the last one, which has no match */
+static uint8_t *put_sequence(uint8_t *out, const uint8_t *literals,
+			     uint32_t literal_size, uint32_t offset,
+			     uint32_t match_size)
+{
+	uint8_t *token = out++;
+	uint32_t m = match_size ? match_size - MIN_MATCH : 0;
+
+	*token = ((literal_size < 0xf ? literal_size : 0xf) << 4) |
+		(m < 0xf ? m : 0xf);
+	if (literal_size >= 0xf)
+		out = put_size(out, literal_size);
+	memcpy(out, literals, literal_size);
+	out += literal_size;
+
+	if (!match_size)
+		return out;
+
+	*out++ = offset & 0xff;
+	*out++ = offset >> 8;
+	if (m >= 0xf)
+		out = put_size(out, m);
+	return out;
+}
+
+uint8_t *vb2_lz4_compress(const uint8_t *data, uint32_t size,
+			  uint32_t *compressed_size)
+{
+	/* Worst case is all literals */
+	uint64_t max_size = (uint64_t)size + size / 0xff + 16;
+	uint32_t *table;
+	uint8_t *buf, *out;
+	uint32_t pos = 0, anchor = 0;
+	uint32_t cand, h, len;
+
+	if (max_size > UINT32_MAX)
+		return NULL;
+
+	buf = malloc(max_size);
+	table = calloc(1 << HASH_BITS, sizeof(*table));
+	if (!buf || !table) {
+		free(buf);
+		free(table);
+		return NULL;
+	}
+	out = buf;
+
+	while (size >= MATCH_LIMIT && pos <= size - MATCH_LIMIT) {
+		/* Table holds position + 1, so 0 means empty */
+		h = hash32(read32(data + pos));
+		cand = table[h];
+		table[h] = pos + 1;
+
+		if (!cand || pos - (cand - 1) > MAX_OFFSET ||
+		    read32(data + cand - 1) != read32(data + pos)) {
+			pos++;
+			continue;
+		}
+		cand--;
+
+		len = MIN_MATCH;
+		while (pos + len < size - LAST_LITERALS &&
+		       data[cand + len] == data[pos + len])
+			len++;
+
+		out = put_sequence(out, data + anchor, pos - anchor,
+				   pos - cand, len);
+		pos += len;
+		anchor = pos;
+	}
+
+	out = put_sequence(out, data + anchor, size - anchor, 0, 0);
+
+	free(table);
+	*compressed_size = out - buf;
+	return buf;
+}
@@ -9,9 +9,16 @@
 
 #include <openssl/rsa.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -113,14 +120,319 @@ static int sign_external(uint32_t size,
 	return rv;
 }
 
-struct vb2_signature *vb2_external_signature(const uint8_t *data,
-					     uint32_t size,
-					     const char *key_file,
-					     uint32_t key_algorithm,
-					     const char *external_signer)
+/*
+ * Persistent external signers.
+ *
+ * Starting the external signer for every signature means an HSM-backed signer
+ * pays its key-load and session setup cost once per keyblock and preamble.  A
+ * signer can instead be kept open for the life of the process:
+ *
+ *  - If the external signer path is a UNIX socket, we connect to it.  The
+ *    daemon behind it may serve any number of futility processes, so this
+ *    also shares one signer session across batch jobs.
+ *
+ *  - If VB2_EXTERNAL_SIGNER_PERSISTENT is set in the environment, the signer
+ *    program is started once as "PROGRAM --persistent" and kept running as a
+ *    co-process.
+ *
+ * Both speak the same protocol.  Each request is
+ *
+ *	u32 key_len, key_len bytes of key file name,
+ *	u32 data_len, data_len bytes of data to sign
+ *
+ * and each response is
+ *
+ *	u32 status (0 on success), u32 sig_len, sig_len bytes of signature
+ *
+ * with all integers big-endian.  The key file name multiplexes requests for
+ * different keys over the same connection.
+ */
+
+#define SIGNER_PERSISTENT_ENV "VB2_EXTERNAL_SIGNER_PERSISTENT"
+
+/* Upper bound on a signature we are willing to read back */
+#define SIGNER_MAX_SIG_SIZE (64 * 1024)
+
+struct signer_conn {
+	char *path;		/* External signer this connects to */
+	int rfd;		/* Read responses from here */
+	int wfd;		/* Write requests here (== rfd for sockets) */
+	pid_t pid;		/* Co-process, or 0 for a socket */
+	pid_t owner;		/* Process which opened the connection */
+	struct signer_conn *next;
+};
+
+static struct signer_conn *signer_conns;
+
+static int signer_write_all(int fd, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+static int signer_read_all(int fd, void *buf, size_t size)
+{
+	uint8_t *p = buf;
+
+	while (size) {
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+static int signer_write_u32(int fd, uint32_t v)
+{
+	uint8_t buf[4] = {v >> 24, v >> 16, v >> 8, v};
+
+	return signer_write_all(fd, buf, sizeof(buf));
+}
+
+static int signer_read_u32(int fd, uint32_t *v)
+{
+	uint8_t buf[4];
+
+	if (signer_read_all(fd, buf, sizeof(buf)))
+		return -1;
+	*v = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+	     ((uint32_t)buf[2] << 8) | buf[3];
+	return 0;
+}
+
+static void signer_conn_free(struct signer_conn *conn)
+{
+	if (conn->wfd != conn->rfd)
+		close(conn->wfd);
+	close(conn->rfd);
+	/*
+	 * Closing its stdin tells a co-process to exit.  Only the process
+	 * which started it may reap it; a forked child just lets go.
+	 */
+	if (conn->pid > 0 && conn->owner == getpid())
+		waitpid(conn->pid, NULL, 0);
+	free(conn->path);
+	free(conn);
+}
+
+void vb2_external_signer_close_all(void)
+{
+	while (signer_conns) {
+		struct signer_conn *conn = signer_conns;
+		signer_conns = conn->next;
+		signer_conn_free(conn);
+	}
+}
+
+static int signer_connect_socket(struct signer_conn *conn)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	int fd;
+
+	if (strlen(conn->path) >= sizeof(addr.sun_path)) {
+		VB2_DEBUG("Socket path too long: %s\n", conn->path);
+		return -1;
+	}
+	strcpy(addr.sun_path, conn->path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		VB2_DEBUG("socket() error\n");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		VB2_DEBUG("Cannot connect to %s\n", conn->path);
+		close(fd);
+		return -1;
+	}
+	conn->rfd = conn->wfd = fd;
+	return 0;
+}
+
+static int signer_start_coprocess(struct signer_conn *conn)
+{
+	int p_to_c[2], c_to_p[2];
+	pid_t pid;
+
+	if (pipe2(p_to_c, O_CLOEXEC) < 0)
+		return -1;
+	if (pipe2(c_to_p, O_CLOEXEC) < 0) {
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		return -1;
+	}
+	if ((pid = fork()) < 0) {
+		VB2_DEBUG("fork() error\n");
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		close(c_to_p[0]);
+		close(c_to_p[1]);
+		return -1;
+	}
+	if (pid == 0) {
+		/* dup2() clears close-on-exec on the new descriptors */
+		if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) < 0 ||
+		    dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) < 0)
+			_exit(1);
+		execl(conn->path, conn->path, "--persistent", (char *)0);
+		VB2_DEBUG("execl() of external signer failed\n");
+		_exit(1);
+	}
+	close(p_to_c[STDIN_FILENO]);
+	close(c_to_p[STDOUT_FILENO]);
+	conn->wfd = p_to_c[STDOUT_FILENO];
+	conn->rfd = c_to_p[STDIN_FILENO];
+	conn->pid = pid;
+	return 0;
+}
+
+/*
+ * Return the persistent connection for [external_signer], opening it if
+ * needed.  Returns NULL if the signer should be run once per signature
+ * instead, or if the connection could not be opened (in which case *error is
+ * set).
+ */
+static struct signer_conn *signer_get_conn(const char *external_signer,
+					   int *error)
+{
+	struct signer_conn *conn, **prev;
+	struct stat st;
+	int is_socket;
+
+	*error = 0;
+	for (prev = &signer_conns; (conn = *prev); prev = &conn->next) {
+		if (strcmp(conn->path, external_signer))
+			continue;
+		if (conn->owner == getpid())
+			return conn;
+		/*
+		 * Inherited across fork().  Sharing it with the parent would
+		 * interleave requests, so drop it and open our own.
+		 */
+		*prev = conn->next;
+		signer_conn_free(conn);
+		break;
+	}
+
+	is_socket = !stat(external_signer, &st) && S_ISSOCK(st.st_mode);
+	if (!is_socket && !getenv(SIGNER_PERSISTENT_ENV))
+		return NULL;
+
+	conn = calloc(1, sizeof(*conn));
+	if (!conn || !(conn->path = strdup(external_signer))) {
+		free(conn);
+		*error = 1;
+		return NULL;
+	}
+	conn->owner = getpid();
+	if ((is_socket ? signer_connect_socket(conn) :
+	     signer_start_coprocess(conn))) {
+		free(conn->path);
+		free(conn);
+		*error = 1;
+		return NULL;
+	}
+
+	if (!signer_conns)
+		atexit(vb2_external_signer_close_all);
+	conn->next = signer_conns;
+	signer_conns = conn;
+	VB2_DEBUG("Opened persistent external signer %s\n", external_signer);
+	return conn;
+}
+
+/* Drop a connection after a protocol error, so the next request reopens it. */
+static void signer_drop_conn(struct signer_conn *conn)
+{
+	struct signer_conn **prev;
+
+	for (prev = &signer_conns; *prev; prev = &(*prev)->next) {
+		if (*prev == conn) {
+			*prev = conn->next;
+			break;
+		}
+	}
+	signer_conn_free(conn);
+}
+
+/*
+ * Send one request over a persistent connection.  Same contract as
+ * sign_external().
+ */
+static int sign_persistent(struct signer_conn *conn,
+			   uint32_t size,
+			   const uint8_t *inbuf,
+			   uint8_t *outbuf,
+			   uint32_t outbufsize,
+			   const char *pem_file)
+{
+	struct sigaction ign = {.sa_handler = SIG_IGN}, old;
+	uint32_t key_len = strlen(pem_file);
+	uint32_t status, sig_len;
+	int rv = -1;
+
+	/* A signer that died must fail the signature, not kill futility */
+	sigaction(SIGPIPE, &ign, &old);
+
+	if (signer_write_u32(conn->wfd, key_len) ||
+	    signer_write_all(conn->wfd, pem_file, key_len) ||
+	    signer_write_u32(conn->wfd, size) ||
+	    signer_write_all(conn->wfd, inbuf, size)) {
+		VB2_DEBUG("Error sending request to external signer\n");
+	} else if (signer_read_u32(conn->rfd, &status) ||
+		   signer_read_u32(conn->rfd, &sig_len)) {
+		VB2_DEBUG("Error reading response from external signer\n");
+	} else if (sig_len > SIGNER_MAX_SIG_SIZE) {
+		VB2_DEBUG("External signer returned %u bytes\n", sig_len);
+	} else {
+		/* Always consume the whole response to stay in sync */
+		uint8_t *sig = malloc(sig_len ? sig_len : 1);
+
+		if (sig && !signer_read_all(conn->rfd, sig, sig_len)) {
+			if (status) {
+				VB2_DEBUG("External signer status %u\n",
+					  status);
+				rv = 0;
+			} else if (sig_len > outbufsize) {
+				VB2_DEBUG("Signature too big (%u > %u)\n",
+					  sig_len, outbufsize);
+				rv = 0;
+			} else {
+				memcpy(outbuf, sig, sig_len);
+				rv = 1;
+			}
+		}
+		free(sig);
+	}
+
+	sigaction(SIGPIPE, &old, NULL);
+
+	/* rv: -1 connection broken, 0 request failed, 1 success */
+	if (rv < 0)
+		signer_drop_conn(conn);
+	return rv > 0 ? 0 : -1;
+}
+
+struct vb2_signature *vb2_external_signature_digest(
+		const uint8_t *digest, uint32_t data_size,
+		const char *key_file, uint32_t key_algorithm,
+		const char *external_signer)
 {
 	int vb2_alg = vb2_crypto_to_hash(key_algorithm);
-	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	int digest_size = vb2_digest_size(vb2_alg);
 
 	uint32_t digest_info_size = 0;
@@ -133,13 +445,9 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 	uint8_t *signature_digest;
 	uint64_t signature_digest_len = digest_size + digest_info_size;
 
+	struct signer_conn *conn;
 	int rv;
 
-	/* Calculate the digest */
-	if (VB2_SUCCESS != vb2_digest_buffer(data, size, vb2_alg,
-					     digest, sizeof(digest)))
-		return NULL;
-
 	/* Prepend the digest info to the digest */
 	signature_digest = calloc(signature_digest_len, 1);
 	if (!signature_digest)
@@ -151,14 +459,22 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 	/* Allocate output signature */
 	uint32_t sig_size =
 		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
-	struct vb2_signature *sig = vb2_alloc_signature(sig_size, size);
+	struct vb2_signature *sig = vb2_alloc_signature(sig_size, data_size);
 	if (!sig) {
 		free(signature_digest);
 		return NULL;
 	}
 
 	/* Sign the signature_digest into our output buffer */
-	rv = sign_external(signature_digest_len,    /* Input length */
+	conn = signer_get_conn(external_signer, &rv);
+	if (conn)
+		rv = sign_persistent(conn, signature_digest_len,
+				     signature_digest, vb2_signature_data(sig),
+				     sig_size, key_file);
+	else if (rv)
+		rv = -1;
+	else
+		rv = sign_external(signature_digest_len,    /* Input length */
 			   signature_digest,        /* Input data */
 			   vb2_signature_data(sig), /* Output sig */
 			   sig_size,                /* Max Output sig size */
@@ -175,3 +491,21 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 	/* Return the signature */
 	return sig;
 }
+
+struct vb2_signature *vb2_external_signature(const uint8_t *data,
+					     uint32_t size,
+					     const char *key_file,
+					     uint32_t key_algorithm,
+					     const char *external_signer)
+{
+	int vb2_alg = vb2_crypto_to_hash(key_algorithm);
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+
+	/* Calculate the digest */
+	if (VB2_SUCCESS != vb2_digest_buffer(data, size, vb2_alg,
+					     digest, sizeof(digest)))
+		return NULL;
+
+	return vb2_external_signature_digest(digest, size, key_file,
+					     key_algorithm, external_signer);
+}
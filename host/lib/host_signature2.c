@@ -25,11 +25,26 @@
 #include "vb2_common.h"
 #include "vboot_common.h"
 
-struct vb2_signature *vb2_alloc_signature(uint32_t sig_size,
-					  uint32_t data_size)
+/* Longest DigestInfo prefix vb2_digest_info() returns, with room to spare */
+#define SIGN_DIGEST_INFO_MAX_SIZE 32
+
+/*
+ * Allocates a signature from wb, or from the heap if wb is NULL.  Returns the
+ * signature, or NULL if there is no room.
+ */
+static struct vb2_signature *alloc_signature(uint32_t sig_size,
+					     uint32_t data_size,
+					     struct vb2_workbuf *wb)
 {
-	struct vb2_signature *sig = (struct vb2_signature *)
-		calloc(sizeof(*sig) + sig_size, 1);
+	struct vb2_signature *sig;
+
+	if (wb) {
+		sig = vb2_workbuf_alloc(wb, sizeof(*sig) + sig_size);
+		if (sig)
+			memset(sig, 0, sizeof(*sig) + sig_size);
+	} else {
+		sig = calloc(sizeof(*sig) + sig_size, 1);
+	}
 	if (!sig)
 		return NULL;
 
@@ -40,6 +55,19 @@ struct vb2_signature *vb2_alloc_signature(uint32_t sig_size,
 	return sig;
 }
 
+struct vb2_signature *vb2_alloc_signature(uint32_t sig_size,
+					  uint32_t data_size)
+{
+	return alloc_signature(sig_size, data_size, NULL);
+}
+
+struct vb2_signature *vb2_alloc_signature_wb(uint32_t sig_size,
+					     uint32_t data_size,
+					     struct vb2_workbuf *wb)
+{
+	return alloc_signature(sig_size, data_size, wb);
+}
+
 void vb2_init_signature(struct vb2_signature *sig, uint8_t *sig_data,
 			uint32_t sig_size, uint32_t data_size)
 {
@@ -65,56 +93,44 @@ int vb2_copy_signature(struct vb2_signature *dest,
 	return VB2_SUCCESS;
 }
 
-struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size)
-{
-	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
-	if (VB2_SUCCESS != vb2_digest_buffer(data, size, VB2_HASH_SHA512,
-					     digest, sizeof(digest)))
-		return NULL;
-
-	struct vb2_signature *sig =
-		vb2_alloc_signature(VB2_SHA512_DIGEST_SIZE, size);
-	if (!sig)
-		return NULL;
-
-	memcpy(vb2_signature_data(sig), digest, VB2_SHA512_DIGEST_SIZE);
-	return sig;
-}
-
-struct vb2_signature *vb2_calculate_signature(
-		const uint8_t *data, uint32_t size,
-		const struct vb2_private_key *key)
+/**
+ * Sign a digest with a private key.
+ *
+ * @param digest	Digest of the data
+ * @param data_size	Amount of data signed in bytes
+ * @param key		Private key to use to sign data
+ * @param wb		Work buffer to allocate the signature from, or NULL
+ *			to allocate it from the heap
+ *
+ * @return The signature, or NULL if error.  If wb is NULL, caller must free()
+ * it.
+ */
+static struct vb2_signature *sign_digest(const uint8_t *digest,
+					 uint32_t data_size,
+					 const struct vb2_private_key *key,
+					 struct vb2_workbuf *wb)
 {
-	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+	uint8_t signature_digest[SIGN_DIGEST_INFO_MAX_SIZE +
+				 VB2_MAX_DIGEST_SIZE];
+	struct vb2_signature *sig;
 
 	uint32_t digest_info_size = 0;
 	const uint8_t *digest_info = NULL;
 	if (VB2_SUCCESS != vb2_digest_info(key->hash_alg,
-					   &digest_info, &digest_info_size))
-		return NULL;
-
-	/* Calculate the digest */
-	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
-					     digest, digest_size))
+					   &digest_info, &digest_info_size) ||
+	    digest_info_size > SIGN_DIGEST_INFO_MAX_SIZE)
 		return NULL;
 
 	/* Prepend the digest info to the digest */
 	int signature_digest_len = digest_size + digest_info_size;
-	uint8_t *signature_digest = malloc(signature_digest_len);
-	if (!signature_digest)
-		return NULL;
-
 	memcpy(signature_digest, digest_info, digest_info_size);
 	memcpy(signature_digest + digest_info_size, digest, digest_size);
 
 	/* Allocate output signature */
-	struct vb2_signature *sig = (struct vb2_signature *)
-		vb2_alloc_signature(vb2_rsa_sig_size(key->sig_alg), size);
-	if (!sig) {
-		free(signature_digest);
+	sig = alloc_signature(vb2_rsa_sig_size(key->sig_alg), data_size, wb);
+	if (!sig)
 		return NULL;
-	}
 
 	/* Sign the signature_digest into our output buffer */
 	int rv = RSA_private_encrypt(signature_digest_len,    /* Input length */
@@ -122,14 +138,230 @@ struct vb2_signature *vb2_calculate_signature(
 				     vb2_signature_data(sig), /* Output sig */
 				     key->rsa_private_key,    /* Key to use */
 				     RSA_PKCS1_PADDING);      /* Padding */
-	free(signature_digest);
 
 	if (-1 == rv) {
 		fprintf(stderr, "%s: RSA_private_encrypt() failed\n", __func__);
-		free(sig);
+		/* It was the last thing allocated from wb, so can go back */
+		if (wb)
+			vb2_workbuf_free(wb, sizeof(*sig) + sig->sig_size);
+		else
+			free(sig);
 		return NULL;
 	}
 
 	/* Return the signature */
 	return sig;
 }
+
+int vb2_signature_begin(struct vb2_signature_context *sc,
+			const struct vb2_private_key *key)
+{
+	sc->key = key;
+	sc->data_size = 0;
+	return vb2_digest_init(&sc->dc, key ? key->hash_alg : VB2_HASH_SHA512);
+}
+
+int vb2_signature_update(struct vb2_signature_context *sc,
+			 const uint8_t *data, uint32_t size)
+{
+	/* The signature can't record more than 4 GB of data */
+	if (size > UINT32_MAX - sc->data_size)
+		return VB2_ERROR_SIG_SIZE;
+
+	sc->data_size += size;
+	return vb2_digest_extend(&sc->dc, data, size);
+}
+
+/* Finishes a signature, allocating it from wb or from the heap if NULL */
+static struct vb2_signature *signature_finish(struct vb2_signature_context *sc,
+					      struct vb2_workbuf *wb)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	struct vb2_signature *sig;
+
+	if (!sc->key) {
+		if (VB2_SUCCESS != vb2_digest_finalize(&sc->dc, digest,
+						       VB2_SHA512_DIGEST_SIZE))
+			return NULL;
+
+		sig = alloc_signature(VB2_SHA512_DIGEST_SIZE, sc->data_size,
+				      wb);
+		if (sig)
+			memcpy(vb2_signature_data(sig), digest,
+			       VB2_SHA512_DIGEST_SIZE);
+		return sig;
+	}
+
+	if (VB2_SUCCESS != vb2_digest_finalize(&sc->dc, digest,
+					       vb2_digest_size(sc->key->hash_alg)))
+		return NULL;
+
+	return sign_digest(digest, sc->data_size, sc->key, wb);
+}
+
+struct vb2_signature *vb2_signature_finish(struct vb2_signature_context *sc)
+{
+	return signature_finish(sc, NULL);
+}
+
+struct vb2_signature *vb2_signature_finish_wb(struct vb2_signature_context *sc,
+					      struct vb2_workbuf *wb)
+{
+	return signature_finish(sc, wb);
+}
+
+/* Calculates a signature, allocating it from wb or from the heap if NULL */
+static struct vb2_signature *calculate_signature(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key,
+		struct vb2_workbuf *wb)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+
+	/* Calculate the digest */
+	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
+					     digest,
+					     vb2_digest_size(key->hash_alg)))
+		return NULL;
+
+	return sign_digest(digest, size, key, wb);
+}
+
+/* Same for a SHA-512 digest-only signature */
+static struct vb2_signature *sha512_signature(const uint8_t *data,
+					      uint32_t size,
+					      struct vb2_workbuf *wb)
+{
+	struct vb2_signature_context sc;
+
+	if (VB2_SUCCESS != vb2_signature_begin(&sc, NULL) ||
+	    VB2_SUCCESS != vb2_signature_update(&sc, data, size))
+		return NULL;
+
+	return signature_finish(&sc, wb);
+}
+
+struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size)
+{
+	return sha512_signature(data, size, NULL);
+}
+
+struct vb2_signature *vb2_sha512_signature_wb(const uint8_t *data,
+					      uint32_t size,
+					      struct vb2_workbuf *wb)
+{
+	return sha512_signature(data, size, wb);
+}
+
+struct vb2_signature *vb2_calculate_signature(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key)
+{
+	return calculate_signature(data, size, key, NULL);
+}
+
+struct vb2_signature *vb2_calculate_signature_wb(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key,
+		struct vb2_workbuf *wb)
+{
+	return calculate_signature(data, size, key, wb);
+}
+
+struct vb2_signature *vb2_sign_digest(const uint8_t *digest,
+				      uint32_t data_size,
+				      const struct vb2_private_key *key)
+{
+	return sign_digest(digest, data_size, key, NULL);
+}
+
+struct vb2_signature *vb2_sign_digest_wb(const uint8_t *digest,
+					 uint32_t data_size,
+					 const struct vb2_private_key *key,
+					 struct vb2_workbuf *wb)
+{
+	return sign_digest(digest, data_size, key, wb);
+}
+
+/* Data is hashed this much at a time, with every hash algorithm in turn */
+#define SIGN_HASH_BLOCK_SIZE (64 * 1024)
+
+int vb2_digest_buffer_multiple(const uint8_t *data, uint32_t size,
+			       const enum vb2_hash_algorithm *hash_algs,
+			       int count,
+			       uint8_t (*digests)[VB2_MAX_DIGEST_SIZE])
+{
+	struct vb2_digest_context dc[VB2_HASH_ALG_COUNT];
+	uint32_t offset, block;
+	int i;
+
+	if (count > VB2_HASH_ALG_COUNT)
+		return VB2_SIGN_DATA_DIGEST_ALLOC;
+
+	for (i = 0; i < count; i++) {
+		if (vb2_digest_init(&dc[i], hash_algs[i]))
+			return VB2_SIGN_DATA_DIGEST_INIT;
+	}
+
+	for (offset = 0; offset < size; offset += block) {
+		block = size - offset;
+		if (block > SIGN_HASH_BLOCK_SIZE)
+			block = SIGN_HASH_BLOCK_SIZE;
+		for (i = 0; i < count; i++) {
+			if (vb2_digest_extend(&dc[i], data + offset, block))
+				return VB2_SIGN_DATA_DIGEST_EXTEND;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (vb2_digest_finalize(&dc[i], digests[i],
+					vb2_digest_size(hash_algs[i])))
+			return VB2_SIGN_DATA_DIGEST_FINALIZE;
+	}
+
+	return VB2_SUCCESS;
+}
+
+int vb2_calculate_signatures(struct vb2_signature **sig_list,
+			     const uint8_t *data, uint32_t size,
+			     const struct vb2_private_key * const *key_list,
+			     int key_count)
+{
+	enum vb2_hash_algorithm hash_algs[VB2_HASH_ALG_COUNT];
+	uint8_t digests[VB2_HASH_ALG_COUNT][VB2_MAX_DIGEST_SIZE];
+	int alg_count = 0;
+	int i, j, rv;
+
+	/* Keys with the same hash algorithm share a digest */
+	for (i = 0; i < key_count; i++) {
+		sig_list[i] = NULL;
+		if (!vb2_digest_size(key_list[i]->hash_alg))
+			return VB2_SIGN_DATA_DIGEST_SIZE;
+		for (j = 0; j < alg_count; j++) {
+			if (hash_algs[j] == key_list[i]->hash_alg)
+				break;
+		}
+		if (j == alg_count)
+			hash_algs[alg_count++] = key_list[i]->hash_alg;
+	}
+
+	rv = vb2_digest_buffer_multiple(data, size, hash_algs, alg_count,
+					digests);
+	if (rv)
+		return rv;
+
+	for (i = 0; i < key_count; i++) {
+		for (j = 0; hash_algs[j] != key_list[i]->hash_alg; j++)
+			;
+		sig_list[i] = sign_digest(digests[j], size, key_list[i], NULL);
+		if (!sig_list[i]) {
+			while (i--) {
+				free(sig_list[i]);
+				sig_list[i] = NULL;
+			}
+			return VB2_SIGN_DATA_RSA_ENCRYPT;
+		}
+	}
+
+	return VB2_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Work buffer arenas for multithreaded host tools.
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+
+#include "host_workbuf.h"
+
+int vb2_arena_init(struct vb2_arena *arena, uint8_t *buf, size_t size,
+		   uint32_t slab_size)
+{
+	size_t skip = -(uintptr_t)buf & (VB2_WORKBUF_ALIGN - 1);
+	size_t slabs;
+
+	memset(arena, 0, sizeof(*arena));
+
+	/* Align the buffer and slabs, so workbuf allocations are aligned */
+	slab_size &= ~(VB2_WORKBUF_ALIGN - 1);
+	if (!slab_size || size < skip)
+		return VB2_ERROR_ARENA_INIT_SIZE;
+
+	slabs = (size - skip) / slab_size;
+	if (!slabs)
+		return VB2_ERROR_ARENA_INIT_SIZE;
+
+	arena->buf = buf + skip;
+	arena->slab_size = slab_size;
+	arena->num_slabs = slabs < VB2_ARENA_MAX_SLABS ?
+		slabs : VB2_ARENA_MAX_SLABS;
+
+	return VB2_SUCCESS;
+}
+
+void *vb2_arena_get(struct vb2_arena *arena, struct vb2_workbuf *wb)
+{
+	uint32_t start, i, n;
+	uint64_t *word, bit, old;
+
+	/*
+	 * Start each search at a different slab, so threads claiming at the
+	 * same time usually go straight to different words.
+	 */
+	start = __atomic_fetch_add(&arena->next, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < arena->num_slabs; i++) {
+		n = (start + i) % arena->num_slabs;
+		word = &arena->in_use[n / 64];
+		bit = 1ULL << (n % 64);
+
+		old = __atomic_load_n(word, __ATOMIC_RELAXED);
+		while (!(old & bit)) {
+			if (__atomic_compare_exchange_n(word, &old, old | bit,
+							1, __ATOMIC_ACQUIRE,
+							__ATOMIC_RELAXED)) {
+				uint8_t *slab = arena->buf +
+					(size_t)n * arena->slab_size;
+
+				vb2_workbuf_init(wb, slab, arena->slab_size);
+				return slab;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void vb2_arena_put(struct vb2_arena *arena, void *slab)
+{
+	size_t n = ((uint8_t *)slab - arena->buf) / arena->slab_size;
+
+	__atomic_fetch_and(&arena->in_use[n / 64], ~(1ULL << (n % 64)),
+			   __ATOMIC_RELEASE);
+}
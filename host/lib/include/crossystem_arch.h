@@ -56,6 +56,13 @@ int vb2_read_nv_storage(struct vb2_context *ctx);
  * Returns 0 if success, -1 if error. */
 int vb2_write_nv_storage(struct vb2_context *ctx);
 
+/* Find the file which holds the non-volatile context, so that writes to it
+ * can be watched for.
+ *
+ * Returns 0 and copies the path to dest if success, -1 if the context isn't
+ * in a file (for example, it's behind the EC or mosys). */
+int vb2_get_nv_storage_path(char *dest, size_t size);
+
 /* Read the VbSharedData buffer.
  *
  * Verifies the buffer contains at least enough data for the
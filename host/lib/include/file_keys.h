@@ -10,11 +10,22 @@
 
 #include "2sha.h"
 
+/* Flags for DigestFileFlags() */
+enum digest_file_flags {
+	/* Read around the page cache, where the filesystem allows it */
+	DIGEST_FILE_DIRECT = (1 << 0),
+};
+
 /* Calculates the appropriate digest for the data in [input_file] based on the
  * hash algorithm [alg] and stores it into [digest], which is of size
- * [digest_size].  Returns VB2_SUCCESS, or non-zero on error.
+ * [digest_size].  The file is read through a fixed-size buffer, so it may be
+ * any size.  Returns VB2_SUCCESS, or non-zero on error.
  */
-int DigestFile(char *input_file, enum vb2_hash_algorithm alg,
+int DigestFile(const char *input_file, enum vb2_hash_algorithm alg,
 	       uint8_t *digest, uint32_t digest_size);
 
+/* Like DigestFile(), with [flags] from enum digest_file_flags. */
+int DigestFileFlags(const char *input_file, enum vb2_hash_algorithm alg,
+		    uint8_t *digest, uint32_t digest_size, uint32_t flags);
+
 #endif  /* VBOOT_REFERENCE_FILE_KEYS_H_ */
@@ -43,7 +43,12 @@ typedef struct _FmapAreaHeader {
 } __attribute__((packed)) FmapAreaHeader;
 
 
-/* Find and point to the FMAP header within the buffer */
+/*
+ * Find and point to the FMAP header within the buffer.  The result for the
+ * last buffer searched is remembered, and reused as long as the header is
+ * still there; adding another FMAP elsewhere in the same buffer is not
+ * noticed.
+ */
 FmapHeader *fmap_find(uint8_t *ptr, size_t size);
 
 /* Search for an area by name, return pointer to its beginning */
@@ -17,6 +17,8 @@
 #include "vboot_api.h"
 #include "vboot_struct.h"
 
+struct vb2_workbuf;
+
 /**
  * Create a firmware preamble.
  *
@@ -35,6 +37,54 @@ struct vb2_fw_preamble *vb2_create_fw_preamble(
 	const struct vb2_private_key *signing_key,
 	uint32_t flags);
 
+/**
+ * Create a firmware preamble whose body is hashed in chunks.
+ *
+ * The digest of each chunk_size bytes of the body is stored in a table in the
+ * preamble, and the body signature signs the table, so firmware can check
+ * each chunk of the body on its own.  Firmware which only understands
+ * preamble header version 2.1 can't verify the body.
+ *
+ * @param firmware_version	Firmware version
+ * @param kernel_subkey		Kernel subkey to store in preamble
+ * @param body			Firmware body
+ * @param body_size		Size of firmware body in bytes
+ * @param chunk_size		Size of each chunk in bytes; must be non-zero
+ * @param signing_key		Private key to sign header and body with
+ * @param flags			Firmware preamble flags
+ *
+ * @return The preamble, or NULL if error.  Caller must free() it.
+ */
+struct vb2_fw_preamble *vb2_create_fw_preamble_chunked(
+	uint32_t firmware_version,
+	const struct vb2_packed_key *kernel_subkey,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	const struct vb2_private_key *signing_key,
+	uint32_t flags);
+
+/**
+ * Verify a firmware body against its preamble.
+ *
+ * Handles both bodies signed as a whole and bodies hashed in chunks.  The
+ * preamble must already have been verified with vb2_verify_fw_preamble().
+ *
+ * @param body		Firmware body
+ * @param size		Size of firmware body in bytes; may be more than the
+ *			size the preamble signs.
+ * @param preamble	Verified firmware preamble
+ * @param key		Data key the preamble was verified with
+ * @param wb		Work buffer
+ *
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+int vb2_verify_fw_body(const uint8_t *body,
+		       uint32_t size,
+		       struct vb2_fw_preamble *preamble,
+		       const struct vb2_public_key *key,
+		       const struct vb2_workbuf *wb);
+
 
 /**
  * Create a kernel preamble.
@@ -64,4 +114,88 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	uint32_t desired_size,
 	const struct vb2_private_key *signing_key);
 
+/**
+ * Create a kernel preamble whose body is hashed in chunks.
+ *
+ * The digest of each chunk_size bytes of the body is stored in a table in the
+ * preamble, and the body signature signs the table, so the bootloader can
+ * hash the chunks in parallel or as they arrive.  Firmware which only
+ * understands preamble header version 2.2 can't verify the body.
+ *
+ * @param kernel_version		Kernel version
+ * @param body_load_address		Load address for kernel body
+ * @param bootloader_address		Load address for bootloader
+ * @param bootloader_size		Size of bootloader in bytes
+ * @param body				Kernel body
+ * @param body_size			Size of kernel body in bytes
+ * @param chunk_size			Size of each chunk in bytes; must be
+ *					non-zero
+ * @param vmlinuz_header_address	Load address for 16-bit vmlinuz header
+ * @param vmlinuz_header_size		Size of 16-bit vmlinuz header in bytes
+ * @param flags				Kernel preamble flags
+ * @param desired_size			Minimum size of preamble in bytes
+ * @param signing_key			Private key to sign header and body
+ *					with
+ *
+ * @return The preamble, or NULL if error.  Caller must free() it.
+ */
+struct vb2_kernel_preamble *vb2_create_kernel_preamble_chunked(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key);
+
+/**
+ * Create a kernel preamble for a body which may be compressed.
+ *
+ * The body is signed as it is stored, so the bootloader verifies it before
+ * decompressing it.  Firmware which only understands preamble header version
+ * 2.3 or older can't load a compressed body.
+ *
+ * @param kernel_version		Kernel version
+ * @param body_load_address		Load address for decompressed kernel
+ *					body
+ * @param bootloader_address		Load address for bootloader
+ * @param bootloader_size		Size of bootloader in bytes
+ * @param body				Kernel body, as stored
+ * @param body_size			Size of kernel body as stored, in bytes
+ * @param chunk_size			Size of each chunk in bytes, or 0 to
+ *					sign the body as a whole
+ * @param compression			How the body is compressed (enum
+ *					vb2_kernel_compression)
+ * @param uncompressed_size		Size of decompressed kernel body in
+ *					bytes
+ * @param vmlinuz_header_address	Load address for 16-bit vmlinuz header
+ * @param vmlinuz_header_size		Size of 16-bit vmlinuz header in bytes
+ * @param flags				Kernel preamble flags
+ * @param desired_size			Minimum size of preamble in bytes
+ * @param signing_key			Private key to sign header and body
+ *					with
+ *
+ * @return The preamble, or NULL if error.  Caller must free() it.
+ */
+struct vb2_kernel_preamble *vb2_create_kernel_preamble_compressed(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const uint8_t *body,
+	uint32_t body_size,
+	uint32_t chunk_size,
+	uint32_t compression,
+	uint32_t uncompressed_size,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key);
+
 #endif  /* VBOOT_REFERENCE_HOST_COMMON_H_ */
@@ -66,6 +66,49 @@ int vb2_write_private_key(const char *filename,
  */
 struct vb2_private_key *vb2_read_private_key(const char *filename);
 
+/**
+ * Get a shared private key from a .vbprivk file.
+ *
+ * Like vb2_read_private_key(), but the key is kept in a process-wide cache,
+ * by filename and the file's inode, size and modification time.  Getting the
+ * same unchanged file again returns the same key without parsing it again.
+ * This may be called from several threads at once, and the key may be used
+ * to sign from several threads, but must not be changed.
+ *
+ * @param filename	Filename to read key from.
+ *
+ * @return The private key or NULL if error.  Caller must release it with
+ * vb2_put_private_key(), not free() it.
+ */
+struct vb2_private_key *vb2_get_private_key(const char *filename);
+
+/**
+ * Get a shared private key from a .pem file.
+ *
+ * Like vb2_get_private_key(), for vb2_read_private_key_pem().  The same file
+ * with a different algorithm is a different key.
+ *
+ * @param filename	Filename to read from
+ * @param algorithm	Algorithm to associate with file
+ * 			(enum vb2_crypto_algorithm)
+ *
+ * @return The private key or NULL if error.  Caller must release it with
+ * vb2_put_private_key(), not free() it.
+ */
+struct vb2_private_key *vb2_get_private_key_pem(
+		const char *filename,
+		enum vb2_crypto_algorithm algorithm);
+
+/**
+ * Release a private key from vb2_get_private_key() or
+ * vb2_get_private_key_pem().
+ *
+ * The key stays cached for the next get, unless its file has changed since.
+ *
+ * @param key		Key to release; ok to pass NULL (ignored).
+ */
+void vb2_put_private_key(struct vb2_private_key *key);
+
 /**
  * Allocate a new public key.
  * @param key_size	Size of key data the key can hold
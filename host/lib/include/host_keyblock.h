@@ -47,6 +47,59 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 		uint32_t flags,
 		const char *external_signer);
 
+/**
+ * Create keyblocks for many data keys, all signed with the same key.
+ *
+ * Like calling vb2_create_keyblock() for each data key, but splits them into
+ * runs created in parallel.
+ *
+ * @param data_keys	Data keys to store in the keyblocks
+ * @param count		Number of data keys
+ * @param signing_key	Key to sign the keyblocks with, or NULL
+ * @param flags		Keyblock flags, for all of them
+ * @param threads	Most threads to create them on, counting the caller's
+ * @param keyblocks	Receives the keyblock for each data key, or NULL for
+ *			those which could not be created.  Caller must free()
+ *			each one.
+ *
+ * @return The number of keyblocks which could not be created; 0 if success.
+ */
+int vb2_create_keyblocks(const struct vb2_packed_key *const *data_keys,
+			 uint32_t count,
+			 const struct vb2_private_key *signing_key,
+			 uint32_t flags,
+			 int threads,
+			 struct vb2_keyblock **keyblocks);
+
+/**
+ * Create keyblocks for many data keys, all signed by an external signer with
+ * the same key.
+ *
+ * Like calling vb2_create_keyblock_external() for each data key.  They are
+ * signed one at a time, so that a persistent connection to the signer (see
+ * vb2_external_signature()) is opened once and used for all of them.
+ *
+ * @param data_keys		Data keys to store in the keyblocks
+ * @param count			Number of data keys
+ * @param signing_key_pem_file	Filename of private key
+ * @param algorithm		Signing algorithm index
+ * @param flags			Keyblock flags, for all of them
+ * @param external_signer	Path to external signer program
+ * @param keyblocks		Receives the keyblock for each data key, or
+ *				NULL for those which could not be created.
+ *				Caller must free() each one.
+ *
+ * @return The number of keyblocks which could not be created; 0 if success.
+ */
+int vb2_create_keyblocks_external(
+		const struct vb2_packed_key *const *data_keys,
+		uint32_t count,
+		const char *signing_key_pem_file,
+		uint32_t algorithm,
+		uint32_t flags,
+		const char *external_signer,
+		struct vb2_keyblock **keyblocks);
+
 /**
  * Read a keyblock from a .keyblock file.
  *
@@ -0,0 +1,28 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * LZ4 compression, for kernel bodies which firmware decompresses with 2lz4.h.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_LZ4_H_
+#define VBOOT_REFERENCE_HOST_LZ4_H_
+
+#include "2sysincludes.h"
+
+/**
+ * Compress data as a single LZ4 block.
+ *
+ * The block follows the LZ4 end of block rules, so any LZ4 decoder can
+ * decompress it, including vb2_lz4_decompress().
+ *
+ * @param data		Data to compress
+ * @param size		Size of data in bytes
+ * @param compressed_size	Size of the compressed data stored here
+ * @return Newly allocated compressed data, which the caller must free(), or
+ * NULL if error.
+ */
+uint8_t *vb2_lz4_compress(const uint8_t *data, uint32_t size,
+			  uint32_t *compressed_size);
+
+#endif  /* VBOOT_REFERENCE_HOST_LZ4_H_ */
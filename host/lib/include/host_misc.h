@@ -8,6 +8,7 @@
 #ifndef VBOOT_REFERENCE_HOST_MISC_H_
 #define VBOOT_REFERENCE_HOST_MISC_H_
 
+#include "2crypto.h"
 #include "utility.h"
 #include "vboot_struct.h"
 
@@ -55,6 +56,43 @@ int WriteFile(const char* filename, const void *data, uint64_t size);
  */
 int vb2_read_file(const char *filename, uint8_t **data_ptr, uint32_t *size_ptr);
 
+/**
+ * Map a file into memory, instead of reading it into a buffer.
+ *
+ * Pages are only read from the file as they're used, so this is better than
+ * vb2_read_file() for large files like disk images.  The mapping is private;
+ * the caller may change the data, but the changes aren't written back to the
+ * file.
+ *
+ * @param filename	Name of file to map
+ * @param data_ptr	On exit, pointer to the file data will be stored here,
+ *			or NULL if the file is empty.  Caller must call
+ *			vb2_unmap_file() when done with it.
+ * @param size_ptr	On exit, size of data will be stored here.
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_map_file(const char *filename, uint8_t **data_ptr, uint64_t *size_ptr);
+
+/**
+ * Unmap data mapped by vb2_map_file().
+ *
+ * @param data		Data from vb2_map_file(); may be NULL
+ * @param size		Size from vb2_map_file()
+ */
+void vb2_unmap_file(uint8_t *data, uint64_t size);
+
+/**
+ * Calculate the digest of a file, without reading all of it into memory.
+ *
+ * @param filename	Name of file to digest
+ * @param hash_alg	Hash algorithm
+ * @param digest	Destination for digest
+ * @param digest_size	Size of digest buffer in bytes
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_digest_file(const char *filename, enum vb2_hash_algorithm hash_alg,
+		    uint8_t *digest, uint32_t digest_size);
+
 /**
  * Write data to a file from a buffer.
  *
@@ -8,12 +8,14 @@
 #ifndef VBOOT_REFERENCE_HOST_SIGNATURE_H_
 #define VBOOT_REFERENCE_HOST_SIGNATURE_H_
 
+#include "2sha.h"
 #include "host_key.h"
 #include "utility.h"
 #include "vboot_struct.h"
 
 struct vb2_private_key;
 struct vb2_signature;
+struct vb2_workbuf;
 
 /**
  * Initialize a signature struct.
@@ -38,6 +40,28 @@ void vb2_init_signature(struct vb2_signature *sig, uint8_t *sig_data,
 struct vb2_signature *vb2_alloc_signature(uint32_t sig_size,
 					  uint32_t data_size);
 
+/*
+ * Work buffer versions.
+ *
+ * Each of the functions below which returns a new signature has a _wb
+ * version, which allocates the signature from a work buffer instead of the
+ * heap.  Nothing it returns needs to be freed one at a time: a signing job can
+ * keep everything it makes in one work buffer (for example a slab claimed
+ * with vb2_arena_get()) and let go of all of it at once when the job is done.
+ * Returns NULL if the work buffer is too small.
+ */
+
+/*
+ * Work buffer big enough for any one signature from a _wb function, and for
+ * aligning the start of the buffer.
+ */
+#define VB2_SIGNATURE_WORKBUF_SIZE \
+	(sizeof(struct vb2_signature) + 8192 / 8 + VB2_WORKBUF_ALIGN)
+
+struct vb2_signature *vb2_alloc_signature_wb(uint32_t sig_size,
+					     uint32_t data_size,
+					     struct vb2_workbuf *wb);
+
 /**
  * Copy a signature.
  *
@@ -57,6 +81,9 @@ int vb2_copy_signature(struct vb2_signature *dest,
  * @return The signature, or NULL if error.  Caller must free() it.
  */
 struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size);
+struct vb2_signature *vb2_sha512_signature_wb(const uint8_t *data,
+					      uint32_t size,
+					      struct vb2_workbuf *wb);
 
 /**
  * Calculate a signature for the data using the specified key.
@@ -70,6 +97,119 @@ struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size);
 struct vb2_signature *vb2_calculate_signature(
 		const uint8_t *data, uint32_t size,
 		const struct vb2_private_key *key);
+struct vb2_signature *vb2_calculate_signature_wb(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key,
+		struct vb2_workbuf *wb);
+
+/**
+ * Sign a digest which has already been calculated.
+ *
+ * @param digest	Digest of the data, using the key's hash algorithm
+ * @param data_size	Amount of data the digest was calculated over, in bytes
+ * @param key		Private key to use to sign the digest
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_sign_digest(const uint8_t *digest,
+				      uint32_t data_size,
+				      const struct vb2_private_key *key);
+struct vb2_signature *vb2_sign_digest_wb(const uint8_t *digest,
+					 uint32_t data_size,
+					 const struct vb2_private_key *key,
+					 struct vb2_workbuf *wb);
+
+/**
+ * Calculate digests of the data with several hash algorithms, in one pass.
+ *
+ * Each block of the data is hashed with every algorithm before moving on to
+ * the next, so a large body is only read through once.
+ *
+ * @param data		Pointer to data to hash
+ * @param size		Length of data in bytes
+ * @param hash_algs	Hash algorithms to use
+ * @param count		Number of hash algorithms, at most VB2_HASH_ALG_COUNT
+ * @param digests	Digest for each hash algorithm stored here on exit
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_digest_buffer_multiple(const uint8_t *data, uint32_t size,
+			       const enum vb2_hash_algorithm *hash_algs,
+			       int count,
+			       uint8_t (*digests)[VB2_MAX_DIGEST_SIZE]);
+
+/**
+ * Calculate signatures for the data using several keys.
+ *
+ * The data is hashed once for each hash algorithm the keys use, in one pass,
+ * and each digest is then signed with every key using that algorithm.  Use
+ * this to sign the same body with several keysets.
+ *
+ * @param sig_list	On success, contains key_count newly allocated
+ *			signatures, in the order of key_list.  Caller must
+ *			free() each of them.
+ * @param data		Pointer to data to sign
+ * @param size		Length of data in bytes
+ * @param key_list	Private keys to use to sign data
+ * @param key_count	Number of keys in list
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_calculate_signatures(struct vb2_signature **sig_list,
+			     const uint8_t *data, uint32_t size,
+			     const struct vb2_private_key * const *key_list,
+			     int key_count);
+
+/* Context for calculating a signature a piece at a time */
+struct vb2_signature_context {
+	/* Key to sign with, or NULL for a SHA-512 digest-only signature */
+	const struct vb2_private_key *key;
+	/* Digest of the data so far */
+	struct vb2_digest_context dc;
+	/* Amount of data so far in bytes */
+	uint32_t data_size;
+};
+
+/**
+ * Start calculating a signature.
+ *
+ * Use this instead of vb2_calculate_signature() or vb2_sha512_signature() when
+ * the data doesn't all fit in memory at once, for example because it is being
+ * read from a pipe.
+ *
+ * @param sc		Signature context to initialize
+ * @param key		Private key to sign with, or NULL to calculate a
+ *			SHA-512 digest-only signature.  Must stay valid
+ *			until vb2_signature_finish().
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_signature_begin(struct vb2_signature_context *sc,
+			const struct vb2_private_key *key);
+
+/**
+ * Add more data to a signature.
+ *
+ * @param sc		Signature context
+ * @param data		Pointer to data to sign
+ * @param size		Length of data in bytes
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_signature_update(struct vb2_signature_context *sc,
+			 const uint8_t *data, uint32_t size);
+
+/**
+ * Finish calculating a signature.
+ *
+ * @param sc		Signature context
+ *
+ * @return The signature of all the data passed to vb2_signature_update(), or
+ * NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_signature_finish(struct vb2_signature_context *sc);
+struct vb2_signature *vb2_signature_finish_wb(struct vb2_signature_context *sc,
+					      struct vb2_workbuf *wb);
 
 /**
  * Calculate a signature for the data using an external signer.
@@ -80,6 +220,11 @@ struct vb2_signature *vb2_calculate_signature(
  * @param key_algorithm		Key algorithm
  * @param external_signer	Path to external signer program
  *
+ * By default the signer is run once per signature, with key_file as its only
+ * argument.  If external_signer is a UNIX socket, or the environment variable
+ * VB2_EXTERNAL_SIGNER_PERSISTENT is set, one connection to the signer is kept
+ * open and reused for every signature; see host_signature.c for the protocol.
+ *
  * @return The signature, or NULL if error.  Caller must free() it.
  */
 struct vb2_signature *vb2_external_signature(const uint8_t *data,
@@ -88,4 +233,34 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 					     uint32_t key_algorithm,
 					     const char *external_signer);
 
+/**
+ * Sign a digest which has already been calculated, using an external signer.
+ *
+ * Like vb2_external_signature(), but for a digest from, for example,
+ * vb2_digest_buffer_multiple(), so data signed with several keys is only
+ * hashed once.
+ *
+ * @param digest		Digest of the data, using the hash algorithm
+ *				of key_algorithm
+ * @param data_size		Amount of data the digest was calculated
+ *				over, in bytes
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ * @param external_signer	Path to external signer program
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_external_signature_digest(
+		const uint8_t *digest, uint32_t data_size,
+		const char *key_file, uint32_t key_algorithm,
+		const char *external_signer);
+
+/**
+ * Close any persistent external signer connections.
+ *
+ * This is registered with atexit() when the first connection is opened, but
+ * may be called earlier to release the signer.
+ */
+void vb2_external_signer_close_all(void);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
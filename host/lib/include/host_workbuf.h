@@ -0,0 +1,70 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Work buffer arenas, so host tools can run verifications on several
+ * threads without each one needing its own large buffer.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_WORKBUF_H_
+#define VBOOT_REFERENCE_HOST_WORKBUF_H_
+
+#include "2sysincludes.h"
+#include "2common.h"
+
+/* Most slabs an arena can be split into */
+#define VB2_ARENA_MAX_SLABS 256
+
+/*
+ * One big buffer, split into equal slabs.  Each thread claims a slab with
+ * vb2_arena_get() and uses it as an ordinary struct vb2_workbuf, which stays
+ * single-owner.  Only claiming and returning slabs touches shared state, and
+ * that is done with atomic operations instead of a lock.
+ */
+struct vb2_arena {
+	uint8_t *buf;
+	uint32_t slab_size;
+	uint32_t num_slabs;
+
+	/* Slab to start searching from; bumped on every claim */
+	uint32_t next;
+
+	/* Bit N is set while slab N is claimed */
+	uint64_t in_use[VB2_ARENA_MAX_SLABS / 64];
+};
+
+/**
+ * Initialize an arena.
+ *
+ * @param arena		Arena to init
+ * @param buf		Buffer to split into slabs
+ * @param size		Size of buffer in bytes
+ * @param slab_size	Size of each slab in bytes.  Rounded down to a
+ *			multiple of VB2_WORKBUF_ALIGN.
+ * @return VB2_SUCCESS, or non-zero error code if there isn't room for at
+ * least one slab.  If the buffer is big enough for more than
+ * VB2_ARENA_MAX_SLABS, the rest is not used.
+ */
+int vb2_arena_init(struct vb2_arena *arena, uint8_t *buf, size_t size,
+		   uint32_t slab_size);
+
+/**
+ * Claim a slab of an arena.  Safe to call from several threads at once.
+ *
+ * @param arena		Arena to claim from
+ * @param wb		Work buffer to init over the slab
+ * @return The slab, which must be passed to vb2_arena_put() when the work
+ * buffer is no longer used, or NULL if all slabs are in use.
+ */
+void *vb2_arena_get(struct vb2_arena *arena, struct vb2_workbuf *wb);
+
+/**
+ * Return a slab claimed by vb2_arena_get().  Safe to call from several
+ * threads at once.
+ *
+ * @param arena		Arena the slab was claimed from
+ * @param slab		Slab to return
+ */
+void vb2_arena_put(struct vb2_arena *arena, void *slab);
+
+#endif  /* VBOOT_REFERENCE_HOST_WORKBUF_H_ */
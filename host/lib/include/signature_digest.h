@@ -25,6 +25,13 @@ uint8_t* PrependDigestInfo(enum vb2_hash_algorithm hash_alg, uint8_t* digest);
 uint8_t* SignatureDigest(const uint8_t* buf, uint64_t len,
 			 unsigned int algorithm);
 
+/* Like SignatureDigest(), but for the contents of [input_file], which is
+ * streamed rather than read into memory.  [flags] are from enum
+ * digest_file_flags.
+ */
+uint8_t *SignatureDigestFile(const char *input_file, unsigned int algorithm,
+			     uint32_t flags);
+
 /* Calculates the signature on a buffer [buf] of length [len] using
  * the private RSA key file from [key_file] and signature algorithm
  * [algorithm].
@@ -14,6 +14,7 @@
 #include "2common.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "file_keys.h"
 #include "host_common.h"
 #include "host_signature2.h"
 #include "signature_digest.h"
@@ -57,6 +58,26 @@ uint8_t* SignatureDigest(const uint8_t* buf, uint64_t len,
 	return info_digest;
 }
 
+uint8_t *SignatureDigestFile(const char *input_file, unsigned int algorithm,
+			     uint32_t flags)
+{
+	uint8_t digest[VB2_SHA512_DIGEST_SIZE];  /* Longest digest */
+	enum vb2_hash_algorithm hash_alg;
+
+	if (algorithm >= VB2_ALG_COUNT) {
+		fprintf(stderr,
+			"SignatureDigestFile(): Called with invalid algorithm!\n");
+		return NULL;
+	}
+
+	hash_alg = vb2_crypto_to_hash(algorithm);
+
+	if (VB2_SUCCESS != DigestFileFlags(input_file, hash_alg, digest,
+					   sizeof(digest), flags))
+		return NULL;
+	return PrependDigestInfo(hash_alg, digest);
+}
+
 uint8_t* SignatureBuf(const uint8_t* buf, uint64_t len, const char* key_file,
 		      unsigned int algorithm)
 {
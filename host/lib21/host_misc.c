@@ -6,8 +6,11 @@
  */
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
@@ -61,6 +64,83 @@ int vb2_read_file(const char *filename, uint8_t **data_ptr, uint32_t *size_ptr)
 	return VB2_SUCCESS;
 }
 
+int vb2_map_file(const char *filename, uint8_t **data_ptr, uint64_t *size_ptr)
+{
+	struct stat sb;
+	void *buf;
+	int fd;
+
+	*data_ptr = NULL;
+	*size_ptr = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		VB2_DEBUG("Unable to open file %s\n", filename);
+		return VB2_ERROR_MAP_FILE_OPEN;
+	}
+
+	if (fstat(fd, &sb) || sb.st_size < 0 ||
+	    (uint64_t)sb.st_size > SIZE_MAX) {
+		close(fd);
+		return VB2_ERROR_MAP_FILE_SIZE;
+	}
+
+	/* Can't map nothing, but there's nothing to map */
+	if (!sb.st_size) {
+		close(fd);
+		return VB2_SUCCESS;
+	}
+
+	/* Private, so the caller can scribble on its copy like a buffer */
+	buf = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		   fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED) {
+		VB2_DEBUG("Unable to map file %s\n", filename);
+		return VB2_ERROR_MAP_FILE_DATA;
+	}
+
+	*data_ptr = buf;
+	*size_ptr = sb.st_size;
+	return VB2_SUCCESS;
+}
+
+void vb2_unmap_file(uint8_t *data, uint64_t size)
+{
+	if (data)
+		munmap(data, size);
+}
+
+int vb2_digest_file(const char *filename, enum vb2_hash_algorithm hash_alg,
+		    uint8_t *digest, uint32_t digest_size)
+{
+	/* vb2_digest_extend() takes a 32-bit size */
+	const uint64_t chunk = 64 * 1024 * 1024;
+	struct vb2_digest_context dc;
+	uint8_t *data;
+	uint64_t size, offset;
+	int rv;
+
+	rv = vb2_map_file(filename, &data, &size);
+	if (rv)
+		return rv;
+
+	/* It's only read once, front to back */
+	if (data)
+		madvise(data, size, MADV_SEQUENTIAL);
+
+	rv = vb2_digest_init(&dc, hash_alg);
+	for (offset = 0; !rv && offset < size; offset += chunk)
+		rv = vb2_digest_extend(&dc, data + offset,
+				       size - offset < chunk ?
+				       size - offset : chunk);
+	if (!rv)
+		rv = vb2_digest_finalize(&dc, digest, digest_size);
+
+	vb2_unmap_file(data, size);
+	return rv;
+}
+
 int vb2_write_file(const char *filename, const void *buf, uint32_t size)
 {
 	FILE *f = fopen(filename, "wb");
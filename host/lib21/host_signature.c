@@ -6,6 +6,7 @@
  */
 
 #include <openssl/rsa.h>
+#include <pthread.h>
 
 #include "2sysincludes.h"
 #include "2common.h"
@@ -17,6 +18,9 @@
 #include "host_signature2.h"
 #include "host_misc.h"
 
+/* Most worker threads vb21_verify_data_list_threaded() will start */
+#define VERIFY_MAX_THREADS 16
+
 int vb2_digest_info(enum vb2_hash_algorithm hash_alg,
 		    const uint8_t **buf_ptr,
 		    uint32_t *size_ptr)
@@ -68,11 +72,79 @@ int vb2_digest_info(enum vb2_hash_algorithm hash_alg,
 	}
 }
 
-int vb21_sign_data(struct vb21_signature **sig_ptr,
-		   const uint8_t *data,
-		   uint32_t size,
-		   const struct vb2_private_key *key,
-		   const char *desc)
+/*
+ * Data is hashed this much at a time, so that each block is still in cache
+ * when the next algorithm hashes it.
+ */
+#define SIGN_HASH_BLOCK_SIZE (64 * 1024)
+
+/* A digest of the data being signed, shared by each key with its hash_alg */
+struct sign_digest {
+	enum vb2_hash_algorithm hash_alg;
+	struct vb2_digest_context dc;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+};
+
+/*
+ * Hash data with every algorithm in digests[] in a single pass, feeding each
+ * block of it to all of them before moving on to the next.
+ */
+static int digest_multiple(struct sign_digest *digests, int count,
+			   const uint8_t *data, uint32_t size)
+{
+	uint32_t offset, block;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (vb2_digest_init(&digests[i].dc, digests[i].hash_alg))
+			return VB2_SIGN_DATA_DIGEST_INIT;
+	}
+
+	for (offset = 0; offset < size; offset += block) {
+		block = size - offset;
+		if (block > SIGN_HASH_BLOCK_SIZE)
+			block = SIGN_HASH_BLOCK_SIZE;
+		for (i = 0; i < count; i++) {
+			if (vb2_digest_extend(&digests[i].dc, data + offset,
+					      block))
+				return VB2_SIGN_DATA_DIGEST_EXTEND;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (vb2_digest_finalize(&digests[i].dc, digests[i].digest,
+					vb2_digest_size(digests[i].hash_alg)))
+			return VB2_SIGN_DATA_DIGEST_FINALIZE;
+	}
+
+	return VB2_SUCCESS;
+}
+
+/* Checks a key can sign, before any data is hashed for it. */
+static int check_sign_key(const struct vb2_private_key *key)
+{
+	const uint8_t *info;
+	uint32_t info_size;
+
+	if (!vb2_sig_size(key->sig_alg, key->hash_alg))
+		return VB2_SIGN_DATA_SIG_SIZE;
+
+	if (key->sig_alg != VB2_SIG_NONE &&
+	    vb2_digest_info(key->hash_alg, &info, &info_size))
+		return VB2_SIGN_DATA_DIGEST_INFO;
+
+	if (!vb2_digest_size(key->hash_alg))
+		return VB2_SIGN_DATA_DIGEST_SIZE;
+
+	return VB2_SUCCESS;
+}
+
+/* Makes a signature of size bytes of data, from its digest. */
+static int sign_digest(struct vb21_signature **sig_ptr,
+		       const uint8_t *digest,
+		       uint32_t size,
+		       const struct vb2_private_key *key,
+		       const char *desc)
 {
 	struct vb21_signature s = {
 		.c.magic = VB21_MAGIC_SIGNATURE,
@@ -85,8 +157,7 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 		.id = key->id,
 	};
 
-	struct vb2_digest_context dc;
-	uint32_t digest_size;
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
 	const uint8_t *info = NULL;
 	uint32_t info_size = 0;
 	uint32_t sig_digest_size;
@@ -103,20 +174,11 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 
 	s.sig_offset = s.c.fixed_size + s.c.desc_size;
 	s.sig_size = vb2_sig_size(key->sig_alg, key->hash_alg);
-	if (!s.sig_size)
-		return VB2_SIGN_DATA_SIG_SIZE;
-
 	s.c.total_size = s.sig_offset + s.sig_size;
 
 	/* Determine digest size and allocate buffer */
-	if (s.sig_alg != VB2_SIG_NONE) {
-		if (vb2_digest_info(s.hash_alg, &info, &info_size))
-			return VB2_SIGN_DATA_DIGEST_INFO;
-	}
-
-	digest_size = vb2_digest_size(key->hash_alg);
-	if (!digest_size)
-		return VB2_SIGN_DATA_DIGEST_SIZE;
+	if (s.sig_alg != VB2_SIG_NONE)
+		vb2_digest_info(s.hash_alg, &info, &info_size);
 
 	sig_digest_size = info_size + digest_size;
 	sig_digest = malloc(sig_digest_size);
@@ -126,22 +188,7 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 	/* Prepend digest info, if any */
 	if (info_size)
 		memcpy(sig_digest, info, info_size);
-
-	/* Calculate hash digest */
-	if (vb2_digest_init(&dc, s.hash_alg)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_INIT;
-	}
-
-	if (vb2_digest_extend(&dc, data, size)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_EXTEND;
-	}
-
-	if (vb2_digest_finalize(&dc, sig_digest + info_size, digest_size)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_FINALIZE;
-	}
+	memcpy(sig_digest + info_size, digest, digest_size);
 
 	/* Allocate signature buffer and copy header */
 	buf = calloc(1, s.c.total_size);
@@ -172,6 +219,78 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 	return VB2_SUCCESS;
 }
 
+/*
+ * Signs data with each key in key_list, hashing it only once for each hash
+ * algorithm the keys use.  If desc is NULL, each signature gets its key's
+ * description.
+ */
+static int sign_data_keys(struct vb21_signature **sig_list,
+			  const uint8_t *data,
+			  uint32_t size,
+			  const struct vb2_private_key **key_list,
+			  uint32_t key_count,
+			  const char *desc)
+{
+	struct sign_digest digests[VB2_HASH_ALG_COUNT];
+	int digest_count = 0;
+	int rv, i, j;
+
+	for (i = 0; i < key_count; i++)
+		sig_list[i] = NULL;
+
+	for (i = 0; i < key_count; i++) {
+		rv = check_sign_key(key_list[i]);
+		if (rv)
+			return rv;
+
+		for (j = 0; j < digest_count; j++) {
+			if (digests[j].hash_alg == key_list[i]->hash_alg)
+				break;
+		}
+		if (j == digest_count)
+			digests[digest_count++].hash_alg =
+				key_list[i]->hash_alg;
+	}
+
+	rv = digest_multiple(digests, digest_count, data, size);
+	if (rv)
+		return rv;
+
+	for (i = 0; i < key_count; i++) {
+		for (j = 0; digests[j].hash_alg != key_list[i]->hash_alg; j++)
+			;
+		rv = sign_digest(&sig_list[i], digests[j].digest, size,
+				 key_list[i], desc);
+		if (rv) {
+			while (i--) {
+				free(sig_list[i]);
+				sig_list[i] = NULL;
+			}
+			return rv;
+		}
+	}
+
+	return VB2_SUCCESS;
+}
+
+int vb21_sign_data(struct vb21_signature **sig_ptr,
+		   const uint8_t *data,
+		   uint32_t size,
+		   const struct vb2_private_key *key,
+		   const char *desc)
+{
+	return sign_data_keys(sig_ptr, data, size, &key, 1, desc);
+}
+
+int vb21_sign_data_multiple(struct vb21_signature **sig_list,
+			    const uint8_t *data,
+			    uint32_t size,
+			    const struct vb2_private_key **key_list,
+			    uint32_t key_count)
+{
+	return sign_data_keys(sig_list, data, size, key_list, key_count, NULL);
+}
+
 int vb21_sig_size_for_key(uint32_t *size_ptr,
 			  const struct vb2_private_key *key,
 			  const char *desc)
@@ -238,25 +357,103 @@ int vb21_sign_object_multiple(uint8_t *buf,
 			      uint32_t key_count)
 {
 	struct vb21_struct_common *c = (struct vb21_struct_common *)buf;
+	struct vb21_signature **sig_list;
 	uint32_t sig_next = sig_offset;
 	int rv, i;
 
-	for (i = 0; i < key_count; i++)	{
-		struct vb21_signature *sig = NULL;
+	sig_list = calloc(key_count ? key_count : 1, sizeof(*sig_list));
+	if (!sig_list)
+		return VB2_SIGN_DATA_DIGEST_ALLOC;
 
-		rv = vb21_sign_data(&sig, buf, sig_offset, key_list[i], NULL);
-		if (rv)
-			return rv;
+	/* The object is hashed once for all the keys */
+	rv = vb21_sign_data_multiple(sig_list, buf, sig_offset, key_list,
+				     key_count);
+
+	for (i = 0; i < key_count && !rv; i++)	{
+		struct vb21_signature *sig = sig_list[i];
 
 		if (sig_next + sig->c.total_size > c->total_size) {
-			free(sig);
-			return VB2_SIGN_OBJECT_OVERFLOW;
+			rv = VB2_SIGN_OBJECT_OVERFLOW;
+			break;
 		}
 
 		memcpy(buf + sig_next, sig, sig->c.total_size);
 		sig_next += sig->c.total_size;
-		free(sig);
 	}
 
-	return VB2_SUCCESS;
+	for (i = 0; i < key_count; i++)
+		free(sig_list[i]);
+	free(sig_list);
+	return rv;
+}
+
+/* A run of list entries verified by one thread */
+struct verify_job {
+	struct vb21_signed_data *list;
+	uint32_t count;
+	const struct vb2_public_key *key;
+	pthread_t thread;
+	int started;
+	int rv;
+};
+
+static void *verify_worker(void *arg)
+{
+	struct verify_job *job = arg;
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	job->rv = vb21_verify_data_list(job->list, job->count, job->key, &wb);
+	return NULL;
+}
+
+int vb21_verify_data_list_threaded(struct vb21_signed_data *list,
+				   uint32_t count,
+				   const struct vb21_packed_key *packed_key,
+				   int threads)
+{
+	struct verify_job jobs[VERIFY_MAX_THREADS];
+	struct vb2_public_key key;
+	uint32_t per_job, start = 0;
+	int rv, i;
+
+	rv = vb21_unpack_key(&key, (const uint8_t *)packed_key,
+			     packed_key->c.total_size);
+	if (rv)
+		return rv;
+
+	if (threads > VERIFY_MAX_THREADS)
+		threads = VERIFY_MAX_THREADS;
+	if (threads > count)
+		threads = count;
+	if (threads < 1)
+		threads = 1;
+	per_job = (count + threads - 1) / threads;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].list = list + start;
+		jobs[i].count = count - start < per_job ? count - start :
+			per_job;
+		jobs[i].key = &key;
+		start += jobs[i].count;
+
+		/* The last run goes on this thread, as does any we can't start */
+		jobs[i].started = i + 1 < threads &&
+			!pthread_create(&jobs[i].thread, NULL, verify_worker,
+					&jobs[i]);
+		if (!jobs[i].started)
+			verify_worker(&jobs[i]);
+	}
+
+	rv = VB2_SUCCESS;
+	for (i = 0; i < threads; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		if (jobs[i].rv && !rv)
+			rv = jobs[i].rv;
+	}
+
+	return rv;
 }
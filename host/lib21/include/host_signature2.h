@@ -11,7 +11,9 @@
 #include "2struct.h"
 
 struct vb2_private_key;
+struct vb21_packed_key;
 struct vb21_signature;
+struct vb21_signed_data;
 
 /**
  * Get the digest info for a hash algorithm
@@ -43,6 +45,30 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 		   const struct vb2_private_key *key,
 		   const char *desc);
 
+/**
+ * Sign data buffer with several keys, in one pass over the data
+ *
+ * Each block of the data is hashed with every hash algorithm the keys use
+ * before moving on to the next, and keys with the same hash algorithm share
+ * a digest.  This is how to make the SHA-256 and SHA-512 hash descriptors
+ * for vb21_fw_preamble_create() from hash-only keys (see
+ * vb2_private_key_hash()), without reading a large image more than once.
+ *
+ * @param sig_list	On success, contains key_count newly allocated
+ *			signatures, in the order of key_list.  Caller is
+ *			responsible for calling free() on each of them.
+ * @param data		Pointer to data to sign
+ * @param size		Size of data to sign in bytes
+ * @param key_list	Private keys to use to sign data
+ * @param key_count	Number of keys in list
+ * @return VB2_SUCCESS, or non-zero error code on failure.
+ */
+int vb21_sign_data_multiple(struct vb21_signature **sig_list,
+			    const uint8_t *data,
+			    uint32_t size,
+			    const struct vb2_private_key **key_list,
+			    uint32_t key_count);
+
 /**
  * Calculate the signature size for a private key.
  *
@@ -98,4 +124,22 @@ int vb21_sign_object_multiple(uint8_t *buf,
 			      const struct vb2_private_key **key_list,
 			      uint32_t key_count);
 
+/**
+ * Verify a list of data buffers signed with the same key, using threads.
+ *
+ * Like vb21_verify_data_list(), but unpacks the key itself and splits the
+ * list into runs verified in parallel, each with its own work buffer.
+ *
+ * @param list		Entries to verify; each gets its own result
+ * @param count		Number of entries
+ * @param packed_key	Key to use to validate signatures
+ * @param threads	Most threads to verify on, counting the caller's
+ * @return VB2_SUCCESS if every entry verified, or the error code of the
+ * first entry which did not (or of unpacking the key).
+ */
+int vb21_verify_data_list_threaded(struct vb21_signed_data *list,
+				   uint32_t count,
+				   const struct vb21_packed_key *packed_key,
+				   int threads);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE2_H_ */
@@ -0,0 +1,96 @@
+#!/bin/bash
+#
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Report the per-object text/data/bss sizes and per-function stack usage of
+# a firmware library, as built by "make fwsizereport".
+#
+# Usage:
+#    fwsize_report.sh LIBRARY [BASELINE]
+#
+# The stack usage comes from the .su files that -fstack-usage leaves next to
+# each object, under the directory of LIBRARY.  The report has one record per
+# line, so reports from two builds can be compared; if BASELINE is an earlier
+# report, only the records which changed are printed, with the difference.
+#
+# Set SIZE to the size tool matching the compiler (default: size).
+
+set -e
+
+PROG=$(basename "$0")
+SIZE=${SIZE:-size}
+
+usage() {
+  echo "Usage: ${PROG} LIBRARY [BASELINE]" >&2
+  exit 1
+}
+
+# Print the report for library $1
+report() {
+  local lib="$1"
+  local dir="$(dirname "${lib}")"
+
+  # "size" prints text, data, bss, dec, hex, then the object name
+  "${SIZE}" "${lib}" | awk '
+    NR > 1 && $1 ~ /^[0-9]+$/ {
+      print "size", $6, $1, $2, $3
+      text += $1; data += $2; bss += $3
+    }
+    END { print "size TOTAL", text + 0, data + 0, bss + 0 }'
+
+  # Each line is "file:line:column:function<TAB>bytes<TAB>qualifiers"; drop
+  # the line and column so records survive unrelated edits.
+  find "${dir}" -name '*.su' -print0 | xargs -0 -r cat | awk -F '\t' '
+    {
+      n = split($1, loc, ":")
+      file = loc[1]
+      sub(/.*\//, "", file)
+      print "stack", file ":" loc[n], $2, $3
+    }' | sort -k3,3nr -k2,2
+}
+
+# Print the records in report $2 which differ from baseline $1
+compare() {
+  awk '
+    # Everything after the key is the value
+    function value(   v) {
+      v = $0
+      sub(/^[^ ]+ [^ ]+ /, "", v)
+      return v
+    }
+    NR == FNR { old[$1 " " $2] = value(); next }
+    {
+      key = $1 " " $2
+      seen[key] = 1
+      if (!(key in old)) {
+        print "+", $0
+      } else if (old[key] != value()) {
+        printf "~ %s %s (was %s", key, value(), old[key]
+        if ($1 == "size" || $1 == "stack") {
+          split(old[key], o, " ")
+          printf ", %+d", $3 - o[1]
+        }
+        print ")"
+      }
+    }
+    END {
+      for (key in old)
+        if (!(key in seen))
+          print "-", key, old[key]
+    }' "$1" "$2"
+}
+
+[ $# -ge 1 ] && [ $# -le 2 ] || usage
+[ -f "$1" ] || { echo "${PROG}: Can't find library $1" >&2; exit 1; }
+
+if [ -z "$2" ]; then
+  report "$1"
+else
+  [ -f "$2" ] || { echo "${PROG}: Can't find baseline $2" >&2; exit 1; }
+  tmp=$(mktemp)
+  trap 'rm -f "${tmp}"' EXIT
+  report "$1" > "${tmp}"
+  compare "$2" "${tmp}"
+fi
@@ -44,6 +44,7 @@ static struct bdb_secrets secrets = {
 };
 
 static int vbe_write_nvm_failure = 0;
+static int vbe_read_nvm_count, vbe_write_nvm_count;
 
 static struct bdb_header *create_bdb(const char *key_dir,
 				     struct bdb_hash *hash, int num_hashes)
@@ -278,6 +279,8 @@ static void test_verify_aprw(const char *key_dir)
 
 int vbe_read_nvm(enum nvm_type type, uint8_t *buf, uint32_t size)
 {
+	vbe_read_nvm_count++;
+
 	/* Read NVM-RW contents (from EEPROM for example) */
 	switch (type) {
 	case NVM_TYPE_RW_PRIMARY:
@@ -298,6 +301,8 @@ int vbe_read_nvm(enum nvm_type type, uint8_t *buf, uint32_t size)
 
 int vbe_write_nvm(enum nvm_type type, void *buf, uint32_t size)
 {
+	vbe_write_nvm_count++;
+
 	if (vbe_write_nvm_failure > 0) {
 		fprintf(stderr, "Failed to write NVM (type=%d failure=%d)\n",
 			type, vbe_write_nvm_failure);
@@ -539,6 +544,14 @@ static void verify_kernel_version(uint32_t min_kernel_data_key_version,
 	if (expected_result != BDB_SUCCESS)
 		return;
 
+	/* Nothing is written until the boot is finalized */
+	TEST_EQ(nvm->min_kernel_data_key_version, min_kernel_data_key_version,
+		NULL);
+	TEST_EQ(nvm->min_kernel_version, min_kernel_version, NULL);
+	vbe_write_nvm_count = 0;
+	TEST_SUCC(vba_bdb_finalize(&ctx), NULL);
+	TEST_EQ(vbe_write_nvm_count, should_update ? 2 : 0, NULL);
+
 	/* Check data key version */
 	TEST_EQ(nvm->min_kernel_data_key_version,
 		expected_kernel_data_key_version, NULL);
@@ -599,11 +612,66 @@ static void test_update_buc(void)
 	install_nvm(NVM_TYPE_RW_SECONDARY, 1, 0, 0);
 
 	TEST_SUCC(vba_update_buc(&ctx, new_buc), NULL);
+	TEST_SUCC(vba_bdb_finalize(&ctx), NULL);
 	vbe_aes256_encrypt(new_buc, sizeof(new_buc), ctx.secrets->buc,
 			   enc_buc);
 	TEST_SUCC(memcmp(nvm->buc_enc_digest, enc_buc, sizeof(new_buc)), NULL);
 }
 
+static void test_nvm_session(void)
+{
+	uint8_t new_buc[BUC_ENC_DIGEST_SIZE];
+	uint8_t enc_buc[BUC_ENC_DIGEST_SIZE];
+	struct nvmrw *nvm = (struct nvmrw *)nvmrw1;
+	struct vba_context ctx = {
+		.bdb = NULL,
+		.secrets = &secrets,
+	};
+	struct vb2_hmac_context hc;
+	uint8_t mac[NVM_HMAC_SIZE];
+
+	memset(new_buc, 0x5a, sizeof(new_buc));
+	install_nvm(NVM_TYPE_RW_PRIMARY, 1, 1, 2);
+	install_nvm(NVM_TYPE_RW_SECONDARY, 1, 1, 2);
+	vbe_read_nvm_count = 0;
+	vbe_write_nvm_count = 0;
+
+	/* NVM-RW is read once, and the updates are written together */
+	TEST_SUCC(vba_update_kernel_version(&ctx, 2, 1), NULL);
+	TEST_EQ(vbe_read_nvm_count, 4, "  read both copies");
+	TEST_SUCC(vba_update_buc(&ctx, new_buc), NULL);
+	TEST_SUCC(vba_update_kernel_version(&ctx, 2, 3), NULL);
+	TEST_EQ(vbe_read_nvm_count, 4, "  no more reads");
+	TEST_EQ(vbe_write_nvm_count, 0, "  no writes yet");
+	TEST_EQ(nvm->update_count, 2, NULL);
+
+	TEST_SUCC(vba_bdb_finalize(&ctx), NULL);
+	TEST_EQ(vbe_write_nvm_count, 2, "  one write per copy");
+	TEST_EQ(nvm->update_count, 3, "  one update");
+	TEST_EQ(nvm->min_kernel_data_key_version, 2, NULL);
+	TEST_EQ(nvm->min_kernel_version, 3, NULL);
+	vbe_aes256_encrypt(new_buc, sizeof(new_buc), ctx.secrets->buc,
+			   enc_buc);
+	TEST_SUCC(memcmp(nvm->buc_enc_digest, enc_buc, sizeof(enc_buc)), NULL);
+	TEST_SUCC(memcmp(nvmrw2, nvmrw1, sizeof(nvmrw1)), NULL);
+	TEST_SUCC(vb2_hmac_init(&hc, VB2_HASH_SHA256, secrets.nvm_rw,
+				BDB_SECRET_SIZE), NULL);
+	TEST_SUCC(vb2_hmac_calculate(&hc, nvm,
+				     nvm->struct_size - sizeof(mac),
+				     mac, sizeof(mac)), NULL);
+	TEST_SUCC(memcmp(mac, nvm->hmac, sizeof(mac)), "  HMAC");
+
+	/* Nothing more to write */
+	TEST_SUCC(vba_bdb_finalize(&ctx), NULL);
+	TEST_EQ(vbe_write_nvm_count, 2, "  no more writes");
+
+	/* A failed write asks for recovery */
+	TEST_SUCC(nvmrw_set(&ctx, NVMRW_VAR_FLAG_DOSM, 1), NULL);
+	vbe_write_nvm_failure = 2;
+	TEST_EQ(vba_bdb_finalize(&ctx), BDB_ERROR_RECOVERY_REQUEST, NULL);
+	vbe_write_nvm_failure = 0;
+}
+
 static void test_derive_secrets(void)
 {
 	uint8_t test_key[sizeof(struct bdb_key) + BDB_RSA4096_KEY_DATA_SIZE];
@@ -678,6 +746,7 @@ int main(int argc, char *argv[])
 	test_nvm_write();
 	test_update_kernel_version();
 	test_update_buc();
+	test_nvm_session();
 	test_derive_secrets();
 
 	return gTestSuccess ? 0 : 255;
@@ -179,6 +179,103 @@ static void check_sig_tests(void)
 	TEST_EQ_S(bdb_check_sig(&s, ssize), BDB_ERROR_SIG_ALG);
 }
 
+/* ECDSA-521 public key, signature and SHA-256 digest of a test message */
+static const uint8_t ecdsa521_key[BDB_ECDSA521_KEY_DATA_SIZE] = {
+	0x00, 0x77, 0xaf, 0x2a, 0xeb, 0x5d, 0x68, 0x06,
+	0xb6, 0xa6, 0x6f, 0x3e, 0xfb, 0x8d, 0x34, 0x15,
+	0x79, 0x0e, 0x4b, 0x50, 0x55, 0x00, 0x59, 0xcf,
+	0xa0, 0x90, 0x1d, 0xc5, 0x2e, 0xc5, 0x91, 0x5d,
+	0x62, 0x2d, 0xaf, 0x77, 0x02, 0xf5, 0xca, 0x3c,
+	0xe2, 0x47, 0x3c, 0x96, 0x93, 0x32, 0xa0, 0xac,
+	0x6c, 0x91, 0xe5, 0xc2, 0xdf, 0x05, 0x39, 0xdb,
+	0x25, 0xb1, 0x62, 0x80, 0x0e, 0xc1, 0x04, 0x47,
+	0xd2, 0xf0, 0x00, 0xa9, 0xfb, 0x21, 0x01, 0x4a,
+	0xeb, 0xff, 0x0f, 0xf3, 0x0e, 0xcd, 0x64, 0xcb,
+	0x58, 0x1b, 0x80, 0x63, 0x3d, 0x61, 0xe1, 0xd6,
+	0xc0, 0x84, 0xaa, 0x89, 0x2c, 0x64, 0x7c, 0xa6,
+	0x1c, 0x0c, 0x72, 0x3c, 0x11, 0xfc, 0x56, 0xaa,
+	0xa4, 0x26, 0x4f, 0x10, 0x07, 0x1a, 0x7a, 0x3c,
+	0xed, 0xad, 0x25, 0x6f, 0x1f, 0xae, 0xe4, 0x0a,
+	0xbd, 0x1e, 0xbd, 0xcb, 0x25, 0xd9, 0x25, 0xca,
+	0xbb, 0xd2, 0xaa, 0xb4,
+};
+
+static const uint8_t ecdsa521_sig[BDB_ECDSA521_SIG_SIZE] = {
+	0x01, 0x09, 0x2d, 0xc9, 0x09, 0x98, 0xad, 0x61,
+	0x2e, 0x51, 0xe5, 0x1f, 0x09, 0xe3, 0x49, 0xb1,
+	0x46, 0x7a, 0x8d, 0x26, 0xbb, 0x3a, 0xcb, 0x79,
+	0x94, 0xef, 0x2d, 0xe6, 0xf6, 0xcc, 0xf6, 0xf7,
+	0xdc, 0xe2, 0xe1, 0x5b, 0x74, 0xf9, 0x5b, 0xed,
+	0x6b, 0xaf, 0xe3, 0x45, 0xe2, 0xa1, 0xbc, 0x17,
+	0xd6, 0x2f, 0x4e, 0xbe, 0x71, 0x8a, 0x4c, 0x12,
+	0x3e, 0xab, 0xf1, 0x4e, 0x20, 0x62, 0x95, 0xed,
+	0xef, 0xbb, 0x00, 0x69, 0xd5, 0x59, 0xed, 0xa8,
+	0x7d, 0xab, 0xb8, 0x04, 0xa7, 0xa4, 0xb9, 0x0b,
+	0x1d, 0x3e, 0x36, 0x03, 0x2a, 0x5a, 0x4d, 0xaf,
+	0x52, 0x69, 0x17, 0x8c, 0x82, 0x32, 0xb9, 0x80,
+	0x03, 0x19, 0x54, 0xab, 0x0d, 0xc2, 0x5c, 0x82,
+	0xa0, 0xdb, 0x94, 0x5c, 0x5a, 0x25, 0xa2, 0xeb,
+	0x33, 0x7b, 0xc2, 0xe4, 0xf6, 0x18, 0xe0, 0x21,
+	0xa0, 0x99, 0xdd, 0x6f, 0xfd, 0x7b, 0x7b, 0xa5,
+	0x3c, 0xb5, 0x88, 0xa1,
+};
+
+static const uint8_t ecdsa521_digest[BDB_SHA256_DIGEST_SIZE] = {
+	0x2b, 0x16, 0xf5, 0x77, 0xe4, 0x1a, 0xc3, 0x49,
+	0x1a, 0x99, 0x4e, 0xf2, 0xe7, 0x0b, 0x0f, 0x61,
+	0xf5, 0xde, 0xc3, 0xfc, 0x8e, 0x88, 0x16, 0xfe,
+	0x5d, 0xce, 0x79, 0x19, 0x5e, 0xcb, 0x5a, 0x65,
+};
+
+static void check_ecdsa521_tests(void)
+{
+	uint8_t key[BDB_ECDSA521_KEY_DATA_SIZE];
+	uint8_t sig[BDB_ECDSA521_SIG_SIZE];
+	uint8_t digest[BDB_SHA256_DIGEST_SIZE];
+
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, ecdsa521_sig,
+				      ecdsa521_digest), BDB_SUCCESS);
+
+	memcpy(digest, ecdsa521_digest, sizeof(digest));
+	digest[5] ^= 0x10;
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, ecdsa521_sig, digest),
+		  BDB_ERROR_DIGEST);
+
+	/* Modified r or s */
+	memcpy(sig, ecdsa521_sig, sizeof(sig));
+	sig[40] ^= 0x01;
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+
+	memcpy(sig, ecdsa521_sig, sizeof(sig));
+	sig[sizeof(sig) - 1] ^= 0x01;
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+
+	/* r and s must be in [1, n - 1] */
+	memcpy(sig, ecdsa521_sig, sizeof(sig));
+	memset(sig, 0, BDB_ECDSA521_SIG_SIZE / 2);
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+
+	memcpy(sig, ecdsa521_sig, sizeof(sig));
+	memset(sig + BDB_ECDSA521_SIG_SIZE / 2, 0xff,
+	       BDB_ECDSA521_SIG_SIZE / 2);
+	TEST_EQ_S(bdb_ecdsa521_verify(ecdsa521_key, sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+
+	/* Key must be on the curve */
+	memcpy(key, ecdsa521_key, sizeof(key));
+	key[sizeof(key) - 1] ^= 0x01;
+	TEST_EQ_S(bdb_ecdsa521_verify(key, ecdsa521_sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+
+	memcpy(key, ecdsa521_key, sizeof(key));
+	memset(key, 0xff, BDB_ECDSA521_KEY_DATA_SIZE / 2);
+	TEST_EQ_S(bdb_ecdsa521_verify(key, ecdsa521_sig, ecdsa521_digest),
+		  BDB_ERROR_DIGEST);
+}
+
 static void check_data_tests(void)
 {
 	struct bdb_data sgood = {
@@ -496,6 +593,7 @@ int main(int argc, char *argv[])
 	check_key_tests();
 	check_sig_tests();
 	check_data_tests();
+	check_ecdsa521_tests();
 	check_bdb_verify(argv[1]);
 
 	printf("All tests passed!\n");
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "../cgpt/cgpt.h"
+#include "cgpt_params.h"
 #include "cgptlib_internal.h"
 #include "cgptlib_test.h"
 #include "crc32.h"
@@ -863,6 +864,44 @@ static int OverlappedPartitionTest(void) {
 	return TEST_OK;
 }
 
+/* Test checking a full table, which is sorted rather than compared pairwise */
+static int FullTableTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptHeader *h = (GptHeader *)gpt->primary_header;
+	GptEntry *e = (GptEntry *)gpt->primary_entries;
+	int i;
+
+	/* Every entry used, in reverse order on the disk */
+	BuildTestGptData(gpt);
+	ZeroEntries(gpt);
+	for (i = 0; i < MAX_NUMBER_OF_ENTRIES; i++) {
+		memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+		SetGuid(&e[i].unique, i);
+		e[i].starting_lba = 34 + (MAX_NUMBER_OF_ENTRIES - 1 - i) * 3;
+		e[i].ending_lba = e[i].starting_lba + 2;
+	}
+	RefreshCrc32(gpt);
+	EXPECT(0 == CheckEntries(e, h));
+
+	/* Errors are the same as comparing each pair would find */
+	e[5].ending_lba++;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_START_LBA_OVERLAP == CheckEntries(e, h));
+	e[5].ending_lba--;
+
+	SetGuid(&e[100].unique, 3);
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_DUP_GUID == CheckEntries(e, h));
+	SetGuid(&e[100].unique, 100);
+
+	e[127].starting_lba--;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_OUT_OF_REGION == CheckEntries(e, h));
+
+	return TEST_OK;
+}
+
 /* Test both sanity checking and repair. */
 static int SanityCheckTest(void)
 {
@@ -1468,6 +1507,8 @@ static int GptUpdateTest(void)
 	EXPECT(0 == GetEntryTries(e2 + KERNEL_B));
 	/* And that's caused the GPT to need updating */
 	EXPECT(0x0F == gpt->modified);
+	/* But only the entry sector holding it */
+	EXPECT(0x01 == gpt->dirty_entry_sectors);
 
 	/* Another kernel with tries */
 	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
@@ -1489,6 +1530,19 @@ static int GptUpdateTest(void)
 	EXPECT(0 == GetEntryPriority(e + KERNEL_X));
 	EXPECT(0 == GetEntryTries(e + KERNEL_X));
 
+	/* An entry in a later sector marks that sector too */
+	FillEntry(e + 12, 1, 1, 0, 2);
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelWithEntry(gpt, e + 12, GPT_UPDATE_ENTRY_BAD));
+	EXPECT(0 == GetEntryPriority(e2 + 12));
+	EXPECT(0x09 == gpt->dirty_entry_sectors);
+	/* Other changes mean all the entries need writing, from then on */
+	GptModified(gpt);
+	EXPECT(0 == gpt->dirty_entry_sectors);
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelWithEntry(gpt, e + 12, GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(0 == gpt->dirty_entry_sectors);
+
 	/* Can't update if entry isn't a kernel, or there isn't an entry */
 	memcpy(&e[KERNEL_X].type, &guid_rootfs, sizeof(guid_rootfs));
 	EXPECT(GPT_ERROR_INVALID_UPDATE_TYPE ==
@@ -1526,10 +1580,62 @@ static int GptOverridePriorityTest(void)
 	override_counter = 0;
 	override_priority = 0;
 
+	/* Priorities are only read once, so X is still overridden */
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_X == gpt->current_kernel);
+
 	/* Now, we should get A */
+	GptInit(gpt);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_A == gpt->current_kernel);
+
+	return TEST_OK;
+}
+
+/*
+ * Updating a kernel which hasn't been returned yet changes where it comes in
+ * the order.
+ */
+static int GptUpdateOtherKernelTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e = (GptEntry *)(gpt->primary_entries);
+	uint64_t start, size;
+
+	BuildTestGptData(gpt);
+	FillEntry(e + KERNEL_A, 1, 4, 1, 0);
+	FillEntry(e + KERNEL_B, 1, 3, 0, 2);
+	FillEntry(e + KERNEL_X, 1, 2, 0, 2);
+	FillEntry(e + KERNEL_Y, 1, 3, 0, 2);
+	RefreshCrc32(gpt);
+	GptInit(gpt);
+
 	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
 	EXPECT(KERNEL_A == gpt->current_kernel);
 
+	/* Marking B bad skips it */
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelWithEntry(gpt, e + KERNEL_B,
+					GPT_UPDATE_ENTRY_BAD));
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_Y == gpt->current_kernel);
+
+	/* Marking X active keeps it */
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelWithEntry(gpt, e + KERNEL_X,
+					GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_X == gpt->current_kernel);
+
+	/* And nothing comes after a kernel which was already returned */
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelWithEntry(gpt, e + KERNEL_A,
+					GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+
 	return TEST_OK;
 }
 
@@ -1645,6 +1751,90 @@ static int ErrorTextTest(void)
 	return TEST_OK;
 }
 
+/* Test label conversion, around the ASCII fast paths */
+static int Utf16Utf8Test(void)
+{
+	uint16_t utf16[GPT_PARTNAME_LEN / 2];
+	uint16_t back[GPT_PARTNAME_LEN / 2];
+	uint8_t utf8[GPT_PARTNAME_LEN + 8];
+	uint8_t expect[GPT_PARTNAME_LEN + 8];
+	int len, pos, i, n;
+
+	/* ASCII of each length, with an e-acute at each position (or none) */
+	for (len = 0; len < ARRAY_SIZE(utf16); len++) {
+		for (pos = -1; pos < len; pos++) {
+			memset(utf16, 0, sizeof(utf16));
+			for (i = n = 0; i < len; i++) {
+				if (i == pos) {
+					utf16[i] = 0xe9;
+					expect[n++] = 0xc3;
+					expect[n++] = 0xa9;
+				} else {
+					utf16[i] = 'a' + i % 26;
+					expect[n++] = utf16[i];
+				}
+			}
+			expect[n] = 0;
+
+			EXPECT(CGPT_OK == UTF16ToUTF8(utf16, ARRAY_SIZE(utf16),
+						      utf8, sizeof(utf8)));
+			EXPECT(!strcmp((char *)utf8, (char *)expect));
+
+			memset(back, 0xff, sizeof(back));
+			EXPECT(CGPT_OK == UTF8ToUTF16(utf8, back,
+						      ARRAY_SIZE(back)));
+			EXPECT(!memcmp(back, utf16, (len + 1) * sizeof(back[0])));
+		}
+	}
+
+	/* Input not terminated inside maxinput */
+	for (i = 0; i < ARRAY_SIZE(utf16); i++)
+		utf16[i] = 'A' + i % 26;
+	for (len = 1; len < ARRAY_SIZE(utf16); len++) {
+		EXPECT(CGPT_OK == UTF16ToUTF8(utf16, len, utf8, sizeof(utf8)));
+		EXPECT(strlen((char *)utf8) == len);
+		EXPECT(!memcmp(utf8, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", len < 26 ?
+			       len : 26));
+	}
+
+	/* Output truncated to fit */
+	for (n = 1; n < 12; n++) {
+		memset(utf8, 0xff, sizeof(utf8));
+		EXPECT(CGPT_OK == UTF16ToUTF8(utf16, ARRAY_SIZE(utf16),
+					      utf8, n));
+		EXPECT(strlen((char *)utf8) == n - 1);
+		EXPECT(utf8[n] == 0xff);
+
+		memset(back, 0xff, sizeof(back));
+		EXPECT(CGPT_OK == UTF8ToUTF16((const uint8_t *)"ABCDEFGHIJKLMN",
+					      back, n));
+		EXPECT(back[n - 1] == 0 && back[n] == 0xffff);
+		EXPECT(n == 1 || back[n - 2] == 'A' + n - 2);
+	}
+
+	/* Surrogate pair after ASCII (U+1F600) */
+	memset(utf16, 0, sizeof(utf16));
+	memcpy(utf16, (uint16_t[]){'a', 'b', 'c', 'd', 'e', 0xd83d, 0xde00},
+	       7 * sizeof(uint16_t));
+	EXPECT(CGPT_OK == UTF16ToUTF8(utf16, ARRAY_SIZE(utf16),
+				      utf8, sizeof(utf8)));
+	EXPECT(!strcmp((char *)utf8, "abcde\xf0\x9f\x98\x80"));
+	EXPECT(CGPT_OK == UTF8ToUTF16(utf8, back, ARRAY_SIZE(back)));
+	EXPECT(!memcmp(back, utf16, 8 * sizeof(back[0])));
+
+	/* Bad sequences after ASCII still fail */
+	utf16[5] = 0xd83d;
+	utf16[6] = 'x';
+	EXPECT(CGPT_FAILED == UTF16ToUTF8(utf16, ARRAY_SIZE(utf16),
+					  utf8, sizeof(utf8)));
+	EXPECT(CGPT_FAILED == UTF8ToUTF16((const uint8_t *)"abcdefgh\x80",
+					  back, ARRAY_SIZE(back)));
+	EXPECT(CGPT_FAILED == UTF8ToUTF16((const uint8_t *)"abcdefgh\xc3",
+					  back, ARRAY_SIZE(back)));
+
+	return TEST_OK;
+}
+
 static int CheckHeaderOffDevice(void)
 {
 	GptData* gpt = GetEmptyGptData();
@@ -1706,6 +1896,136 @@ static int CheckHeaderOffDevice(void)
 	return TEST_OK;
 }
 
+#define LARGE_NUMBER_OF_ENTRIES 1024
+#define LARGE_ENTRIES_SECTORS \
+	(LARGE_NUMBER_OF_ENTRIES * sizeof(GptEntry) / DEFAULT_SECTOR_SIZE)
+
+/*
+ * Fill in a GPT with LARGE_NUMBER_OF_ENTRIES entries, each a one-sector
+ * kernel, in buffers big enough for it.
+ */
+static GptData *BuildLargeGptData(void)
+{
+	static uint8_t primary_entries[LARGE_NUMBER_OF_ENTRIES *
+				       sizeof(GptEntry)];
+	static uint8_t secondary_entries[LARGE_NUMBER_OF_ENTRIES *
+					 sizeof(GptEntry)];
+	GptData *gpt = GetEmptyGptData();
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	GptHeader *h2 = (GptHeader *)gpt->secondary_header;
+	GptEntry *e = (GptEntry *)primary_entries;
+	uint64_t drive_sectors = 2 * (2 + LARGE_ENTRIES_SECTORS) +
+		LARGE_NUMBER_OF_ENTRIES;
+	int i;
+
+	gpt->primary_entries = primary_entries;
+	gpt->secondary_entries = secondary_entries;
+	memset(primary_entries, 0, sizeof(primary_entries));
+	gpt->sector_bytes = DEFAULT_SECTOR_SIZE;
+	gpt->streaming_drive_sectors = gpt->gpt_drive_sectors = drive_sectors;
+	gpt->flags = GPT_FLAG_LARGE_TABLE;
+
+	memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h1->revision = GPT_HEADER_REVISION;
+	h1->size = sizeof(GptHeader);
+	h1->my_lba = 1;
+	h1->alternate_lba = drive_sectors - 1;
+	h1->entries_lba = 2;
+	h1->first_usable_lba = 2 + LARGE_ENTRIES_SECTORS;
+	h1->last_usable_lba = drive_sectors - 2 - LARGE_ENTRIES_SECTORS;
+	h1->number_of_entries = LARGE_NUMBER_OF_ENTRIES;
+	h1->size_of_entry = sizeof(GptEntry);
+
+	for (i = 0; i < LARGE_NUMBER_OF_ENTRIES; i++) {
+		memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+		SetGuid(&e[i].unique, i);
+		e[i].starting_lba = e[i].ending_lba = h1->first_usable_lba + i;
+		SetEntryPriority(e + i, i % 15 + 1);
+		SetEntryTries(e + i, 1);
+	}
+
+	memcpy(h2, h1, sizeof(GptHeader));
+	memcpy(secondary_entries, primary_entries, sizeof(primary_entries));
+	h2->my_lba = drive_sectors - 1;
+	h2->alternate_lba = 1;
+	h2->entries_lba = drive_sectors - 1 - LARGE_ENTRIES_SECTORS;
+
+	RefreshCrc32(gpt);
+	return gpt;
+}
+
+/*
+ * Tables bigger than the ChromeOS limit are only allowed with
+ * GPT_FLAG_LARGE_TABLE, and then work like any other.
+ */
+static int LargeTableTest(void)
+{
+	GptData *gpt = BuildLargeGptData();
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	GptEntry *e = (GptEntry *)gpt->primary_entries;
+	uint64_t start, size;
+	int last_prio = 16, last_index = -1;
+	int i;
+
+	EXPECT(1 == CheckHeader(h1, 0, gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
+	EXPECT(0 == CheckHeader(h1, 0, gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, GPT_FLAG_LARGE_TABLE,
+				gpt->sector_bytes));
+	EXPECT(0 == CheckEntries(e, h1));
+
+	/* Internal drives still need at least the usual number */
+	h1->number_of_entries = MAX_NUMBER_OF_ENTRIES / 2;
+	h1->header_crc32 = HeaderCrc(h1);
+	EXPECT(1 == CheckHeader(h1, 0, gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, GPT_FLAG_LARGE_TABLE,
+				gpt->sector_bytes));
+
+	/* Problems are still found past the usual number of entries */
+	gpt = BuildLargeGptData();
+	h1 = (GptHeader *)gpt->primary_header;
+	e = (GptEntry *)gpt->primary_entries;
+	e[LARGE_NUMBER_OF_ENTRIES - 1].starting_lba = e[10].starting_lba;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_START_LBA_OVERLAP == CheckEntries(e, h1));
+	gpt = BuildLargeGptData();
+	h1 = (GptHeader *)gpt->primary_header;
+	e = (GptEntry *)gpt->primary_entries;
+	SetGuid(&e[LARGE_NUMBER_OF_ENTRIES - 1].unique, 10);
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_DUP_GUID == CheckEntries(e, h1));
+
+	/*
+	 * Every kernel comes back, by priority and then table order, even
+	 * though there are more than GPT_MAX_KERNEL_CANDIDATES of them.
+	 */
+	gpt = BuildLargeGptData();
+	EXPECT(GPT_SUCCESS == GptInit(gpt));
+	for (i = 0; i < LARGE_NUMBER_OF_ENTRIES; i++) {
+		int prio;
+
+		EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+		prio = gpt->current_priority;
+		EXPECT(prio < last_prio ||
+		       (prio == last_prio && gpt->current_kernel > last_index));
+		EXPECT(prio == gpt->current_kernel % 15 + 1);
+		last_prio = prio;
+		last_index = gpt->current_kernel;
+	}
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+
+	/* A bad primary is repaired from the secondary */
+	gpt = BuildLargeGptData();
+	((GptEntry *)gpt->primary_entries)[500].starting_lba++;
+	EXPECT(GPT_SUCCESS == GptInit(gpt));
+	EXPECT(GPT_MODIFIED_ENTRIES1 & gpt->modified);
+	EXPECT(0 == memcmp(gpt->primary_entries, gpt->secondary_entries,
+			   LARGE_NUMBER_OF_ENTRIES * sizeof(GptEntry)));
+
+	return TEST_OK;
+}
+
 int main(int argc, char *argv[])
 {
 	int i;
@@ -1732,6 +2052,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(EntriesCrcTest), },
 		{ TEST_CASE(ValidEntryTest), },
 		{ TEST_CASE(OverlappedPartitionTest), },
+		{ TEST_CASE(FullTableTest), },
 		{ TEST_CASE(SanityCheckTest), },
 		{ TEST_CASE(NoValidKernelEntryTest), },
 		{ TEST_CASE(EntryAttributeGetSetTest), },
@@ -1741,12 +2062,17 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextTriesTest), },
 		{ TEST_CASE(GptUpdateTest), },
 		{ TEST_CASE(GptOverridePriorityTest), },
+		{ TEST_CASE(GptUpdateOtherKernelTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+		{ TEST_CASE(TestCrc32Lengths), },
+		{ TEST_CASE(TestCrc32Accel), },
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 		{ TEST_CASE(CheckHeaderOffDevice), },
+		{ TEST_CASE(LargeTableTest), },
+		{ TEST_CASE(Utf16Utf8Test), },
 	};
 
 	for (i = 0; i < sizeof(test_cases)/sizeof(test_cases[0]); ++i) {
@@ -66,3 +66,29 @@ function check_test_keys {
     error 1 "You must run gen_test_keys.sh to generate test keys first."
 }
 
+
+# Print a hash of the contents of files $@, to tell if outputs made from them
+# need regenerating.
+function content_hash {
+  cat "$@" | sha256sum | cut -d' ' -f1
+}
+
+# Succeed if the outputs named $1 were made from inputs with content hash $2,
+# by a run which then called record_content_hash.
+function content_hash_matches {
+  local stamp="${TEST_DIR}/$1.content_hash"
+
+  [ -f "${stamp}" ] && [ "$(cat "${stamp}")" = "$2" ]
+}
+
+# Record that the outputs named $1 were made from inputs with content hash $2,
+# or that they need remaking if $2 is empty.
+function record_content_hash {
+  local stamp="${TEST_DIR}/$1.content_hash"
+
+  if [ -n "$2" ]; then
+    echo "$2" > "${stamp}"
+  else
+    rm -f "${stamp}"
+  fi
+}
@@ -10,6 +10,21 @@
 #include "utility.h"
 
 #define MAX_VECTOR_LEN 256
+#define MAX_BUFFER_LEN 1040
+
+/* Bit-at-a-time reference implementation */
+static uint32_t SlowCrc32(const uint8_t *buf, uint32_t len)
+{
+	uint32_t value = ~0U;
+	int bit;
+
+	while (len--) {
+		value ^= *buf++;
+		for (bit = 0; bit < 8; bit++)
+			value = (value >> 1) ^ (value & 1 ? 0xedb88320U : 0);
+	}
+	return ~value;
+}
 
 int TestCrc32TestVectors(void) {
 	struct {
@@ -43,6 +58,82 @@ int TestCrc32TestVectors(void) {
 
 		crc32 = Crc32(cases[i].vector, cases[i].len);
 		EXPECT(crc32 == cases[i].crc32);
+#if CRC32_ACCEL
+		Crc32AccelEnable(0);
+		crc32 = Crc32(cases[i].vector, cases[i].len);
+		Crc32AccelEnable(1);
+		EXPECT(crc32 == cases[i].crc32);
+#endif
+	}
+	return TEST_OK;
+}
+
+int TestCrc32Lengths(void) {
+	static uint8_t buf[MAX_BUFFER_LEN + 16];
+	uint32_t seed = 0x12345678;
+	uint32_t len, offset;
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+
+	/*
+	 * Cover every tail length of the slicing and folding loops, at every
+	 * alignment.
+	 */
+	for (offset = 0; offset < 16; offset++) {
+		for (len = 0; len <= MAX_BUFFER_LEN; len++) {
+			uint32_t expect = SlowCrc32(buf + offset, len);
+
+			EXPECT(Crc32(buf + offset, len) == expect);
+			/* Same CRC when it is added up in two pieces */
+			EXPECT(Crc32Update(Crc32(buf + offset, len / 3),
+					   buf + offset + len / 3,
+					   len - len / 3) == expect);
+#if CRC32_ACCEL
+			Crc32AccelEnable(0);
+			EXPECT(Crc32(buf + offset, len) == expect);
+			Crc32AccelEnable(1);
+#endif
+		}
+	}
+	return TEST_OK;
+}
+
+int TestCrc32Accel(void) {
+#if CRC32_ACCEL
+	static uint8_t buf[MAX_BUFFER_LEN + 16];
+	uint32_t seed = 0x87654321;
+	uint32_t len, offset, done, value;
+	uint32_t used = 0;
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+
+	/*
+	 * Whatever prefix the accelerated code consumes must have the same
+	 * CRC as the portable table gives for it.
+	 */
+	for (offset = 0; offset < 16; offset++) {
+		for (len = 0; len <= MAX_BUFFER_LEN; len++) {
+			value = ~0U;
+			done = Crc32Accel(&value, buf + offset, len);
+			EXPECT(done <= len);
+			if (!done)
+				continue;
+			used++;
+			Crc32AccelEnable(0);
+			EXPECT(~value == Crc32(buf + offset, done));
+			Crc32AccelEnable(1);
+		}
 	}
+	if (!used)
+		printf("No accelerated CRC32 on this CPU\n");
+#endif
 	return TEST_OK;
 }
@@ -6,5 +6,7 @@
 #define VBOOT_REFERENCE_CRC32_TEST_H_
 
 int TestCrc32TestVectors(void);
+int TestCrc32Lengths(void);
+int TestCrc32Accel(void);
 
 #endif  /* VBOOT_REFERENCE_CRC32_TEST_H_ */
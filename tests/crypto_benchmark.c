@@ -0,0 +1,406 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Microbenchmarks for the firmware crypto primitives.
+ *
+ * Each case is run a few times to warm up, then timed repeatedly.  The
+ * minimum, median and 99th percentile are printed as JSON on stdout, so that
+ * results can be compared across compilers and library changes.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2hmac.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "bdb.h"
+#include "crc32.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_signature.h"
+#include "timer_utils.h"
+#include "vb2_common.h"
+
+/* Smallest and default largest buffer to hash */
+#define MIN_SIZE 64
+#define DEFAULT_MAX_SIZE (64 * 1024 * 1024)
+
+/* Bytes to process per timed sample, so small buffers aren't all overhead */
+#define SAMPLE_BYTES (64 * 1024)
+
+/* Bytes to process per case, which picks the default number of samples */
+#define CASE_BYTES (256 * 1024 * 1024)
+#define MIN_REPEATS 5
+#define MAX_REPEATS 1000
+
+/* Untimed runs before each case */
+#define WARMUP 3
+
+/* Samples for RSA, which doesn't depend on the buffer size */
+#define RSA_REPEATS 100
+
+/* Largest signature, for RSA-8192 */
+#define RSA_MAX_SIG_SIZE (8192 / 8)
+
+static const struct option long_opts[] = {
+	{"repeats",  1, NULL, 'n'},
+	{"max-size", 1, NULL, 'm'},
+	{"cpu",      1, NULL, 'c'},
+	{"help",     0, NULL, 'h'},
+	{NULL,       0, NULL, 0},
+};
+
+/* Set by -n; 0 to pick from the buffer size */
+static int repeats;
+
+/* Separator before the next JSON result */
+static const char *result_sep = "";
+
+/* One thing to time: bench_fn(arg, buf, size) is run for each operation. */
+typedef int (*bench_fn)(void *arg, uint8_t *buf, uint32_t size);
+
+/*
+ * Times fn and prints a JSON result for it.  Each sample runs fn enough times
+ * to cover SAMPLE_BYTES.  If bytes_per_op is zero, only per-operation times
+ * are reported.
+ *
+ * Returns 0 if success, non-zero if fn failed.
+ */
+static int run_case(const char *name, bench_fn fn, void *arg,
+		    uint8_t *buf, uint32_t size, int bytes_per_op, int count)
+{
+	uint32_t batch = 1;
+	uint64_t *samples;
+	uint64_t start;
+	TimerStatsState stats;
+	int i, j;
+
+	if (bytes_per_op && size < SAMPLE_BYTES)
+		batch = SAMPLE_BYTES / size;
+
+	samples = malloc(count * sizeof(*samples));
+	if (!samples)
+		return 1;
+
+	for (i = 0; i < WARMUP; i++) {
+		if (fn(arg, buf, size)) {
+			fprintf(stderr, "%s (%u bytes) failed\n", name, size);
+			free(samples);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		start = ReadCycleCounter();
+		for (j = 0; j < batch; j++)
+			fn(arg, buf, size);
+		samples[i] = (ReadCycleCounter() - start) / batch;
+	}
+
+	GetTimerStats(samples, count, &stats);
+
+	printf("%s    {\"name\": \"%s\", \"size\": %u, \"repeats\": %d, "
+	       "\"min_per_op\": %llu, \"median_per_op\": %llu, "
+	       "\"p99_per_op\": %llu",
+	       result_sep, name, size, count, (unsigned long long)stats.min,
+	       (unsigned long long)stats.median, (unsigned long long)stats.p99);
+	if (bytes_per_op)
+		printf(", \"median_per_byte\": %.3f, \"p99_per_byte\": %.3f",
+		       (double)stats.median / size,
+		       (double)stats.p99 / size);
+	printf("}");
+	fflush(stdout);
+	result_sep = ",\n";
+
+	free(samples);
+	return 0;
+}
+
+/* Number of samples for a buffer of this size */
+static int size_repeats(uint32_t size)
+{
+	int count = CASE_BYTES / size;
+
+	if (repeats)
+		return repeats;
+	if (count < MIN_REPEATS)
+		return MIN_REPEATS;
+	if (count > MAX_REPEATS)
+		return MAX_REPEATS;
+	return count;
+}
+
+static int bench_digest(void *arg, uint8_t *buf, uint32_t size)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+
+	return vb2_digest_buffer(buf, size, *(enum vb2_hash_algorithm *)arg,
+				 digest, sizeof(digest));
+}
+
+static int bench_hmac(void *arg, uint8_t *buf, uint32_t size)
+{
+	static const uint8_t key[32] = "crypto_benchmark hmac key";
+	uint8_t mac[VB2_MAX_DIGEST_SIZE];
+
+	return hmac(*(enum vb2_hash_algorithm *)arg, key, sizeof(key),
+		    buf, size, mac, vb2_digest_size(
+				*(enum vb2_hash_algorithm *)arg));
+}
+
+static int bench_crc32(void *arg, uint8_t *buf, uint32_t size)
+{
+	volatile uint32_t crc = Crc32(buf, size);
+
+	(void)crc;
+	return 0;
+}
+
+/*
+ * Compares buf with a copy, passed as arg.  Should take as long whether the
+ * copy matches or differs in its first or last byte.
+ */
+static int bench_memcmp(void *arg, uint8_t *buf, uint32_t size)
+{
+	volatile int result = vb2_safe_memcmp(buf, arg, size);
+
+	(void)result;
+	return 0;
+}
+
+/* State for timing RSA verification */
+struct rsa_bench {
+	struct vb2_public_key key;
+	const uint8_t *key_data;
+	const uint8_t *sig;
+	uint8_t sig_copy[RSA_MAX_SIG_SIZE];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	struct vb2_workbuf wb;
+};
+
+static int bench_rsa(void *arg, uint8_t *buf, uint32_t size)
+{
+	struct rsa_bench *rb = arg;
+	uint32_t sig_size = vb2_rsa_sig_size(rb->key.sig_alg);
+
+	/* Verification destroys the signature */
+	memcpy(rb->sig_copy, rb->sig, sig_size);
+	return vb2_rsa_verify_digest(&rb->key, rb->sig_copy, rb->digest,
+				     &rb->wb);
+}
+
+/* Same as bench_rsa(), but through the BDB entry points */
+static int bench_bdb_rsa(void *arg, uint8_t *buf, uint32_t size)
+{
+	struct rsa_bench *rb = arg;
+
+	if (rb->key.sig_alg == VB2_SIG_RSA4096)
+		return bdb_rsa4096_verify(rb->key_data, rb->sig, rb->digest);
+	else
+		return bdb_rsa3072b_verify(rb->key_data, rb->sig, rb->digest);
+}
+
+/* Returns the number of algorithms which could not be benchmarked. */
+static int run_rsa(const char *keys_dir, uint8_t *buf)
+{
+	uint8_t workbuf[VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_private_key *private_key;
+	struct vb2_packed_key *packed_key;
+	struct vb2_signature *sig;
+	struct rsa_bench rb;
+	char filename[1024];
+	char name[64];
+	int errorcnt = 0;
+	int alg;
+
+	vb2_workbuf_init(&rb.wb, workbuf, sizeof(workbuf));
+
+	/* One algorithm per signature type, all using SHA-256 */
+	for (alg = 0; alg < VB2_ALG_COUNT; alg++) {
+		if (vb2_crypto_to_hash(alg) != VB2_HASH_SHA256)
+			continue;
+
+		private_key = NULL;
+		packed_key = NULL;
+		sig = NULL;
+
+		snprintf(filename, sizeof(filename), "%s/key_%s.pem",
+			 keys_dir, vb2_get_crypto_algorithm_file(alg));
+		private_key = vb2_read_private_key_pem(filename, alg);
+		snprintf(filename, sizeof(filename), "%s/key_%s.keyb",
+			 keys_dir, vb2_get_crypto_algorithm_file(alg));
+		packed_key = vb2_read_packed_keyb(filename, alg, 1);
+		if (private_key)
+			sig = vb2_calculate_signature(buf, MIN_SIZE,
+						      private_key);
+		if (!packed_key || !sig ||
+		    vb2_unpack_key(&rb.key, packed_key) ||
+		    vb2_digest_buffer(buf, MIN_SIZE, VB2_HASH_SHA256,
+				      rb.digest, sizeof(rb.digest))) {
+			fprintf(stderr, "Can't set up %s with keys in %s\n",
+				vb2_get_crypto_algorithm_name(alg), keys_dir);
+			errorcnt++;
+		} else {
+			rb.sig = vb2_signature_data(sig);
+			snprintf(name, sizeof(name), "rsa_verify_%s",
+				 vb2_get_crypto_algorithm_file(alg));
+			errorcnt += run_case(name, bench_rsa, &rb, buf,
+					     vb2_rsa_sig_size(rb.key.sig_alg),
+					     0, repeats ? repeats :
+					     RSA_REPEATS);
+
+			/* BDB supports two of the key types */
+			rb.key_data = vb2_packed_key_data(packed_key);
+			if (rb.key.sig_alg == VB2_SIG_RSA4096 ||
+			    rb.key.sig_alg == VB2_SIG_RSA3072_EXP3) {
+				snprintf(name, sizeof(name),
+					 "bdb_rsa_verify_%s",
+					 vb2_get_crypto_algorithm_file(alg));
+				errorcnt += run_case(
+					name, bench_bdb_rsa, &rb, buf,
+					vb2_rsa_sig_size(rb.key.sig_alg), 0,
+					repeats ? repeats : RSA_REPEATS);
+			}
+		}
+
+		free(sig);
+		free(packed_key);
+		free(private_key);
+	}
+
+	return errorcnt;
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [-n NUM] [-m SIZE] [-c CPU] KEYS_DIR\n"
+		"\n"
+		"  -n|--repeats  NUM    Timed samples per case (default "
+		"depends on size)\n"
+		"  -m|--max-size SIZE   Largest buffer to hash (default %d)\n"
+		"  -c|--cpu      CPU    Only run on this CPU\n",
+		progname, DEFAULT_MAX_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t max_size = DEFAULT_MAX_SIZE;
+	uint32_t size;
+	enum vb2_hash_algorithm hash_alg;
+	uint8_t *buf, *copy;
+	char name[64];
+	char *e;
+	int errorcnt = 0;
+	int i;
+
+	while ((i = getopt_long(argc, argv, "n:m:c:h", long_opts,
+				NULL)) != -1) {
+		switch (i) {
+		case 'n':
+			repeats = strtol(optarg, &e, 0);
+			if (!*optarg || *e || repeats < 1) {
+				fprintf(stderr, "Invalid --repeats\n");
+				return 1;
+			}
+			break;
+		case 'm':
+			max_size = strtoul(optarg, &e, 0);
+			if (!*optarg || *e || max_size < MIN_SIZE) {
+				fprintf(stderr, "Invalid --max-size\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			i = strtol(optarg, &e, 0);
+			if (!*optarg || *e || PinToCpu(i)) {
+				fprintf(stderr, "Can't run on CPU %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	buf = malloc(max_size);
+	if (!buf) {
+		fprintf(stderr, "Can't allocate %u bytes\n", max_size);
+		return 1;
+	}
+	for (i = 0; i < max_size; i++)
+		buf[i] = i * 131 + (i >> 8);
+
+	printf("{\n  \"unit\": \"%s\",\n  \"results\": [\n",
+	       CYCLE_COUNTER_UNIT);
+
+	for (hash_alg = VB2_HASH_SHA1; hash_alg < VB2_HASH_ALG_COUNT;
+	     hash_alg++) {
+		snprintf(name, sizeof(name), "digest_%s",
+			 vb2_get_hash_algorithm_name(hash_alg));
+		for (size = MIN_SIZE; size && size <= max_size; size *= 4)
+			errorcnt += run_case(name, bench_digest, &hash_alg,
+					     buf, size, 1,
+					     size_repeats(size));
+	}
+
+	for (hash_alg = VB2_HASH_SHA1; hash_alg < VB2_HASH_ALG_COUNT;
+	     hash_alg++) {
+		snprintf(name, sizeof(name), "hmac_%s",
+			 vb2_get_hash_algorithm_name(hash_alg));
+		for (size = MIN_SIZE; size && size <= max_size; size *= 16)
+			errorcnt += run_case(name, bench_hmac, &hash_alg,
+					     buf, size, 1,
+					     size_repeats(size));
+	}
+
+	for (size = MIN_SIZE; size && size <= max_size; size *= 4)
+		errorcnt += run_case("crc32", bench_crc32, NULL, buf, size, 1,
+				     size_repeats(size));
+
+	copy = malloc(max_size);
+	if (copy) {
+		memcpy(copy, buf, max_size);
+		for (size = MIN_SIZE; size && size <= max_size; size *= 4)
+			errorcnt += run_case("safe_memcmp", bench_memcmp, copy,
+					     buf, size, 1, size_repeats(size));
+		copy[0] ^= 1;
+		for (size = MIN_SIZE; size && size <= max_size; size *= 4)
+			errorcnt += run_case("safe_memcmp_first_diff",
+					     bench_memcmp, copy, buf, size, 1,
+					     size_repeats(size));
+		copy[0] ^= 1;
+		for (size = MIN_SIZE; size && size <= max_size; size *= 4) {
+			copy[size - 1] ^= 1;
+			errorcnt += run_case("safe_memcmp_last_diff",
+					     bench_memcmp, copy, buf, size, 1,
+					     size_repeats(size));
+			copy[size - 1] ^= 1;
+		}
+		free(copy);
+	} else {
+		fprintf(stderr, "Can't allocate %u bytes\n", max_size);
+		errorcnt++;
+	}
+
+	errorcnt += run_rsa(argv[optind], buf);
+
+	printf("\n  ]\n}\n");
+
+	free(buf);
+	return errorcnt ? 1 : 0;
+}
@@ -13,6 +13,7 @@
 #include "2common.h"
 #include "2misc.h"
 #include "2nvstorage.h"
+#include "2sha.h"
 #include "ec_sync.h"
 #include "host_common.h"
 #include "load_kernel_fw.h"
@@ -48,6 +49,24 @@ static int mock_ec_rw_hash_size;
 static uint8_t want_ec_hash[32];
 static uint8_t update_hash;
 static int want_ec_hash_size;
+
+static uint8_t fake_image[64] = {5, 6, 7, 8};
+
+/* Block hashes reported by the EC, and the block writes it was sent */
+#define BLOCK_SIZE 16
+#define BLOCK_COUNT (sizeof(fake_image) / BLOCK_SIZE)
+static VbError_t block_hashes_retval;
+static int block_hashes_count;
+static uint8_t block_hashes[BLOCK_COUNT][VB2_SHA256_DIGEST_SIZE];
+static uint32_t block_writes[BLOCK_COUNT][2];
+static int block_writes_count;
+
+/* EC sync nonce, or 0 if the EC doesn't report one */
+static uint32_t mock_sync_nonce;
+
+/* Order of hash starts and collections, as 'S' or 'H' plus R(O) or W */
+static char hash_calls[16];
+static int hash_calls_count;
 static struct vb2_context ctx;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
 static struct vb2_shared_data *sd;
@@ -108,6 +127,16 @@ static void ResetMocks(void)
 
 	update_hash = 42;
 
+	memset(hash_calls, 0, sizeof(hash_calls));
+	hash_calls_count = 0;
+
+	mock_sync_nonce = 0;
+
+	block_hashes_retval = VBERROR_EC_BLOCK_HASHES_UNSUPPORTED;
+	block_hashes_count = BLOCK_COUNT;
+	memset(block_writes, 0, sizeof(block_writes));
+	block_writes_count = 0;
+
 	// TODO: ensure these are actually needed
 
 	memset(screens_displayed, 0, sizeof(screens_displayed));
@@ -168,9 +197,25 @@ VbError_t VbExEcJumpToRW(int devidx)
 	return run_retval;
 }
 
+static void record_hash_call(char call, enum VbSelectFirmware_t select)
+{
+	if (hash_calls_count + 2 < sizeof(hash_calls)) {
+		hash_calls[hash_calls_count++] = call;
+		hash_calls[hash_calls_count++] =
+			select == VB_SELECT_FIRMWARE_READONLY ? 'R' : 'W';
+	}
+}
+
+VbError_t VbExEcHashImageStart(int devidx, enum VbSelectFirmware_t select)
+{
+	record_hash_call('S', select);
+	return VBERROR_SIMULATED;
+}
+
 VbError_t VbExEcHashImage(int devidx, enum VbSelectFirmware_t select,
 			  const uint8_t **hash, int *hash_size)
 {
+	record_hash_call('H', select);
 	*hash = select == VB_SELECT_FIRMWARE_READONLY ?
 		mock_ec_ro_hash : mock_ec_rw_hash;
 	*hash_size = select == VB_SELECT_FIRMWARE_READONLY ?
@@ -178,10 +223,15 @@ VbError_t VbExEcHashImage(int devidx, enum VbSelectFirmware_t select,
 	return *hash_size ? VBERROR_SUCCESS : VBERROR_SIMULATED;
 }
 
+VbError_t VbExEcGetSyncNonce(int devidx, uint32_t *nonce)
+{
+	*nonce = mock_sync_nonce;
+	return mock_sync_nonce ? VBERROR_SUCCESS : VBERROR_SIMULATED;
+}
+
 VbError_t VbExEcGetExpectedImage(int devidx, enum VbSelectFirmware_t select,
 				 const uint8_t **image, int *image_size)
 {
-	static uint8_t fake_image[64] = {5, 6, 7, 8};
 	*image = fake_image;
 	*image_size = sizeof(fake_image);
 	return get_expected_retval;
@@ -209,6 +259,41 @@ VbError_t VbExEcUpdateImage(int devidx, enum VbSelectFirmware_t select,
 	return update_retval;
 }
 
+VbError_t VbExEcGetBlockHashes(int devidx, enum VbSelectFirmware_t select,
+			       uint32_t *block_size, const uint8_t **hashes,
+			       int *count)
+{
+	*block_size = BLOCK_SIZE;
+	*hashes = block_hashes[0];
+	*count = block_hashes_count;
+	return block_hashes_retval;
+}
+
+VbError_t VbExEcUpdateImageBlocks(int devidx, enum VbSelectFirmware_t select,
+				  uint32_t offset, const uint8_t *data,
+				  uint32_t size)
+{
+	if (block_writes_count < BLOCK_COUNT) {
+		block_writes[block_writes_count][0] = offset;
+		block_writes[block_writes_count++][1] = size;
+	}
+	ec_rw_updated = 1;
+	mock_ec_rw_hash[0] = update_hash;
+	return update_retval;
+}
+
+/* Make the EC's block hashes match the expected image */
+static void set_block_hashes(void)
+{
+	int i;
+
+	block_hashes_retval = VBERROR_SUCCESS;
+	for (i = 0; i < BLOCK_COUNT; i++)
+		vb2_digest_buffer(fake_image + i * BLOCK_SIZE, BLOCK_SIZE,
+				  VB2_HASH_SHA256, block_hashes[i],
+				  sizeof(block_hashes[i]));
+}
+
 VbError_t VbDisplayScreen(struct vb2_context *c, uint32_t screen, int force,
 			  const VbScreenData *data)
 {
@@ -283,6 +368,16 @@ static void VbSoftwareSyncTest(void)
 	mock_ec_rw_hash_size = 4;
 	test_ssync(0, 0, "Custom hash size");
 
+	/* Hashes are started before they're collected */
+	ResetMocks();
+	test_ssync(0, 0, "Hash started first");
+	TEST_STR_EQ(hash_calls, "SWHW", "  hash calls");
+
+	ResetMocks();
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 1);
+	test_ssync(0, 0, "RO hash started after RW collected");
+	TEST_STR_EQ(hash_calls, "SWHWSRHR", "  hash calls");
+
 	/* Updates required */
 	ResetMocks();
 	mock_in_rw = 1;
@@ -359,6 +454,100 @@ static void VbSoftwareSyncTest(void)
 	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED,
 		   VB2_RECOVERY_EC_UPDATE, "Update failed");
 
+	/* Only differing blocks are written, if the EC can hash blocks */
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	set_block_hashes();
+	block_hashes[1][0]++;
+	block_hashes[2][0]++;
+	test_ssync(0, 0, "Block update");
+	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+	TEST_EQ(block_writes_count, 1, "  one write");
+	TEST_EQ(block_writes[0][0], BLOCK_SIZE, "  offset");
+	TEST_EQ(block_writes[0][1], 2 * BLOCK_SIZE, "  size");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	set_block_hashes();
+	block_hashes[0][0]++;
+	block_hashes[3][0]++;
+	test_ssync(0, 0, "Block update, two runs");
+	TEST_EQ(block_writes_count, 2, "  two writes");
+	TEST_EQ(block_writes[0][0], 0, "  first offset");
+	TEST_EQ(block_writes[1][0], 3 * BLOCK_SIZE, "  second offset");
+	TEST_EQ(block_writes[1][1], BLOCK_SIZE, "  second size");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	set_block_hashes();
+	block_hashes[1][0]++;
+	update_retval = VBERROR_SIMULATED;
+	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED,
+		   VB2_RECOVERY_EC_UPDATE, "Block update failed");
+
+	/* Blocks which don't cover the image mean a full update */
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	set_block_hashes();
+	block_hashes_count = BLOCK_COUNT - 1;
+	test_ssync(0, 0, "Block count mismatch");
+	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+	TEST_EQ(block_writes_count, 0, "  no block writes");
+
+	/* Cached EC-RW hash from an earlier boot */
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	vb2_nv_init(&ctx);
+	mock_sync_nonce = 0x1234;
+	test_ssync(0, 0, "Save EC-RW hash");
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_EC_SYNC_NONCE), 0x1234, "  nonce");
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_EC_SYNC_HASH), 42, "  hash");
+	TEST_STR_EQ(hash_calls, "SWHW", "  hash calls");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	vb2_nv_init(&ctx);
+	mock_sync_nonce = 0x1234;
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_NONCE, 0x1234);
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_HASH, 42);
+	mock_ec_rw_hash[0]++;
+	test_ssync(0, 0, "Cached EC-RW hash");
+	TEST_STR_EQ(hash_calls, "", "  not hashed");
+	TEST_EQ(ec_rw_updated, 0, "  ec rw not updated");
+	TEST_EQ(ec_rw_protected, 1, "  ec rw protected");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	vb2_nv_init(&ctx);
+	mock_sync_nonce = 0x1235;
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_NONCE, 0x1234);
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_HASH, 42);
+	mock_ec_rw_hash[0]++;
+	test_ssync(0, 0, "EC nonce changed");
+	TEST_STR_EQ(hash_calls, "SWHWHW", "  hashed");
+	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_EC_SYNC_NONCE), 0, "  nonce cleared");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	vb2_nv_init(&ctx);
+	mock_sync_nonce = 0x1234;
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_NONCE, 0x1234);
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_HASH, 42);
+	want_ec_hash[0]++;
+	update_hash++;
+	test_ssync(0, 0, "Expected EC-RW hash changed");
+	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_NVDATA_V2;
+	vb2_nv_init(&ctx);
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_NONCE, 0x1234);
+	vb2_nv_set(&ctx, VB2_NV_EC_SYNC_HASH, 42);
+	test_ssync(0, 0, "No EC nonce");
+	TEST_STR_EQ(hash_calls, "SWHW", "  hashed");
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_EC_SYNC_NONCE), 0, "  nonce cleared");
+
 	ResetMocks();
 	mock_ec_rw_hash[0]++;
 	ctx.flags |= VB2_CONTEXT_EC_SYNC_SLOW;
@@ -1,7 +1,48 @@
 #!/bin/bash
 
+# Read a big-endian u32 from stdin
+read_u32() {
+  local b
+  b=( $(dd bs=1 count=4 2>/dev/null | od -An -tu1) )
+  [ ${#b[@]} -eq 4 ] || return 1
+  echo $(( (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3] ))
+}
+
+# Write a big-endian u32 to stdout
+write_u32() {
+  printf "$(printf '\\%03o\\%03o\\%03o\\%03o' \
+    $(( ($1 >> 24) & 255 )) $(( ($1 >> 16) & 255 )) \
+    $(( ($1 >> 8) & 255 )) $(( $1 & 255 )))"
+}
+
+# Serve length-prefixed requests until stdin is closed
+persistent() {
+  local tmp len key sig status
+  tmp="$(mktemp)"
+  trap 'rm -f "${tmp}" "${tmp}.sig"' EXIT
+  [ -n "${SIGNER_LOG}" ] && echo "started" >> "${SIGNER_LOG}"
+  while len="$(read_u32)"; do
+    key="$(dd bs=1 count="${len}" 2>/dev/null)"
+    len="$(read_u32)" || break
+    dd bs=1 count="${len}" of="${tmp}" 2>/dev/null
+    [ -n "${SIGNER_LOG}" ] && echo "sign ${key}" >> "${SIGNER_LOG}"
+    status=0
+    openssl rsautl -sign -inkey "${key}" -in "${tmp}" -out "${tmp}.sig" \
+      2>/dev/null || { status=1; : > "${tmp}.sig"; }
+    write_u32 "${status}"
+    write_u32 "$(stat -c %s "${tmp}.sig")"
+    cat "${tmp}.sig"
+  done
+}
+
+if [ "$1" = "--persistent" ]; then
+  persistent
+  exit 0
+fi
+
 if [ $# -ne 1 ]; then
   echo "Usage: $0 <private_key_pem_file>"
+  echo "       $0 --persistent"
   echo "Reads data to sign from stdin, encrypted data is output to stdout"
   exit 1
 fi
@@ -0,0 +1,104 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for FMAP lookup
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmap.h"
+#include "test_common.h"
+
+#define BUF_SIZE 0x10000
+
+static uint8_t buf[BUF_SIZE];
+
+static void put_fmap(uint32_t offset, uint8_t major)
+{
+	FmapHeader *h = (FmapHeader *)(buf + offset);
+
+	memcpy(h->fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	h->fmap_ver_major = major;
+	h->fmap_ver_minor = 1;
+	h->fmap_size = BUF_SIZE;
+	h->fmap_nareas = 0;
+}
+
+static FmapHeader *at(uint32_t offset)
+{
+	return (FmapHeader *)(buf + offset);
+}
+
+static void FindTest(void)
+{
+	memset(buf, 0, sizeof(buf));
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), NULL, "No FMAP");
+	TEST_PTR_EQ(fmap_find(buf, sizeof(FmapHeader) - 1), NULL,
+		    "Buffer too small");
+
+	put_fmap(0x1234, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x1234), "Found");
+
+	/* Unaligned signatures are ignored */
+	memset(buf, 0, sizeof(buf));
+	put_fmap(0x1235, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), NULL, "Unaligned");
+
+	/* Larger alignment wins, regardless of position */
+	memset(buf, 0, sizeof(buf));
+	put_fmap(0x1004, FMAP_VER_MAJOR);
+	put_fmap(0x3000, FMAP_VER_MAJOR);
+	put_fmap(0x8000, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x8000),
+		    "Largest alignment");
+
+	/* Then the lowest offset */
+	memset(buf, 0, sizeof(buf));
+	put_fmap(0x3000, FMAP_VER_MAJOR);
+	put_fmap(0x1000, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x1000), "Lowest offset");
+
+	/* Offset 0 always wins */
+	put_fmap(0, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0), "Offset 0");
+
+	/* Bad versions are skipped */
+	memset(buf, 0, sizeof(buf));
+	put_fmap(0x8000, FMAP_VER_MAJOR + 1);
+	put_fmap(0x10, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x10), "Bad version");
+
+	/* Must fit entirely in the buffer */
+	memset(buf, 0, sizeof(buf));
+	put_fmap(BUF_SIZE - sizeof(FmapHeader), FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)),
+		    at(BUF_SIZE - sizeof(FmapHeader)), "At end");
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf) - 4), NULL, "Past end");
+}
+
+static void CacheTest(void)
+{
+	memset(buf, 0, sizeof(buf));
+	put_fmap(0x2000, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x2000), "Cache fill");
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x2000), "Cache hit");
+
+	/* A stale entry is not trusted */
+	memset(at(0x2000), 0, sizeof(FmapHeader));
+	put_fmap(0x4000, FMAP_VER_MAJOR);
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), at(0x4000), "Cache stale");
+	memset(at(0x4000), 0, sizeof(FmapHeader));
+	TEST_PTR_EQ(fmap_find(buf, sizeof(buf)), NULL, "Cache removed");
+}
+
+int main(int argc, char *argv[])
+{
+	FindTest();
+	CacheTest();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -46,17 +46,21 @@ ${SCRIPTDIR}/test_dump_fmap.sh
 ${SCRIPTDIR}/test_gbb_utility.sh
 ${SCRIPTDIR}/test_load_fmap.sh
 ${SCRIPTDIR}/test_main.sh
+${SCRIPTDIR}/test_pcr.sh
 ${SCRIPTDIR}/test_rwsig.sh
 ${SCRIPTDIR}/test_show_contents.sh
 ${SCRIPTDIR}/test_show_kernel.sh
 ${SCRIPTDIR}/test_show_vs_verify.sh
 ${SCRIPTDIR}/test_show_usbpd1.sh
+${SCRIPTDIR}/test_show_recursive.sh
+${SCRIPTDIR}/test_sign_disk_image.sh
 ${SCRIPTDIR}/test_sign_firmware.sh
 ${SCRIPTDIR}/test_sign_fw_main.sh
 ${SCRIPTDIR}/test_sign_kernel.sh
 ${SCRIPTDIR}/test_sign_keyblocks.sh
 ${SCRIPTDIR}/test_sign_usbpd1.sh
 ${SCRIPTDIR}/test_update.sh
+${SCRIPTDIR}/test_validate_rec_mrc.sh
 ${SCRIPTDIR}/test_file_types.sh
 "
 
@@ -91,6 +91,17 @@ ${FUTILITY} bdb --resign ${BDB_FILE} \
 	--bdbkey_pri ${DATAKEY_PRI} --bdbkey_pub ${DATAKEY_PUB}
 verify ${DATAKEY_DIGEST}
 
+# Resigning a BDB whose signatures are still good leaves it as it is
+cp ${BDB_FILE} ${TMP}.orig
+${FUTILITY} bdb --resign ${BDB_FILE}
+cmp ${BDB_FILE} ${TMP}.orig
+
+# Resigning fails without the private key a new signature needs, and leaves
+# the BDB alone
+if ${FUTILITY} bdb --resign ${BDB_FILE} --data_version 3; then false; fi
+cmp ${BDB_FILE} ${TMP}.orig
+check_field "Data Version:" $data_version
+
 # Demonstrate futility bdb --verify can return success when key digest doesn't
 # match but --ignore_key_digest is specified.
 verify ${BDBKEY_DIGEST} --ignore_key_digest
@@ -64,6 +64,44 @@ for sig in rsa1024 rsa2048 rsa4096 rsa8192; do
   done
 done
 
+# Demonstrate that a batch makes the same keys as one at a time, and lists
+# the same sha1sums that show does.
+{
+  echo "# comments and blank lines are skipped"
+  echo
+  for sig in rsa1024 rsa2048 rsa4096 rsa8192; do
+    echo "  ${TESTKEYS}/key_${sig}.pem	${TMP}_batch_${sig}"
+  done
+} > ${TMP}.manifest
+for vb in vb1 vb21; do
+  ${FUTILITY} --${vb} create --hash_alg sha256 -j 3 \
+    --batch ${TMP}.manifest > ${TMP}.batch.out
+  grep -q '^created 4 of 4 keypairs$' ${TMP}.batch.out
+  for sig in rsa1024 rsa2048 rsa4096 rsa8192; do
+    pem_sum=$(${FUTILITY} show "${TESTKEYS}/key_${sig}.pem" |
+      awk '/sha1sum/ {print $3}')
+    grep -q "^${pem_sum}  ${TMP}_batch_${sig}\$" ${TMP}.batch.out
+  done
+done
+for sig in rsa1024 rsa2048 rsa4096 rsa8192; do
+  cmp "${TESTKEYS}/key_${sig}.sha256.vbprivk" "${TMP}_batch_${sig}.vbprivk"
+  cmp "${TESTKEYS}/key_${sig}.sha256.vbpubk" "${TMP}_batch_${sig}.vbpubk"
+  cmp "${TMP}_key_${sig}.sha256.vbpubk2" "${TMP}_batch_${sig}.vbpubk2"
+done
+
+# Without a basename, the outputs are named for the .pem file
+cp ${TESTKEYS}/key_rsa2048.pem ${TMP}_named.pem
+echo "${TMP}_named.pem" > ${TMP}.manifest
+${FUTILITY} create --batch ${TMP}.manifest
+[ -e ${TMP}_named.vbpubk2 ]
+
+# One bad key fails the batch, but not the others
+echo "${TMP}_no_such_key.pem" >> ${TMP}.manifest
+if ${FUTILITY} create --batch ${TMP}.manifest > ${TMP}.batch.out; then false; fi
+grep -q '^FAILED  ' ${TMP}.batch.out
+grep -q '^created 1 of 2 keypairs$' ${TMP}.batch.out
+if ${FUTILITY} create --batch ${TMP}.manifest --id 1234; then false; fi
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
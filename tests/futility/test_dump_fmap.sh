@@ -36,6 +36,27 @@ cmp "${SCRIPTDIR}/data_fmap_expect_x.txt" "$TMP"
 cmp "${SCRIPTDIR}/data_fmap_expect_x2.txt" "$TMP"
 cmp SI_DESC FOO
 
+# Extracting all the sections gives the same files and output, however many
+# are done at once.
+mkdir -p ${TMP}.j1 ${TMP}.j4
+(cd ${TMP}.j1 && "$FUTILITY" dump_fmap -x -j 1 \
+  "${SCRIPTDIR}/data/bios_peppy_mp.bin" > ../${TMP}.j1.out)
+(cd ${TMP}.j4 && "$FUTILITY" dump_fmap -x --jobs 4 \
+  "${SCRIPTDIR}/data/bios_peppy_mp.bin" > ../${TMP}.j4.out)
+cmp ${TMP}.j1.out ${TMP}.j4.out
+diff -r ${TMP}.j1 ${TMP}.j4
+if "$FUTILITY" dump_fmap -x -j 0 "${SCRIPTDIR}/data/bios_peppy_mp.bin"; then
+  false
+fi
+
+# The section digests match what was extracted
+"$FUTILITY" dump_fmap -s "${SCRIPTDIR}/data/bios_peppy_mp.bin" GBB \
+  | awk '/area_sha256:/ {print $2}' > ${TMP}.sha
+sha256sum < ${TMP}.j1/GBB | cut -d' ' -f1 | cmp ${TMP}.sha -
+"$FUTILITY" dump_fmap -p --sha256 "${SCRIPTDIR}/data/bios_peppy_mp.bin" \
+  FW_MAIN_A | cut -d' ' -f4 > ${TMP}.sha
+sha256sum < ${TMP}.j1/FW_MAIN_A | cut -d' ' -f1 | cmp ${TMP}.sha -
+
 # This FMAP has problems, and should fail.
 if "$FUTILITY" dump_fmap -h "${SCRIPTDIR}/data_fmap2.bin" > "$TMP"; then false; fi
 cmp "${SCRIPTDIR}/data_fmap2_expect_h.txt" "$TMP"
@@ -48,5 +69,5 @@ cmp "${SCRIPTDIR}/data_fmap2_expect_hhH.txt" "$TMP"
 
 
 # cleanup
-rm -f ${TMP}* FMAP SI_DESC FOO
+rm -rf ${TMP}* FMAP SI_DESC FOO
 exit 0
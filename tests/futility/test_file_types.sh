@@ -20,6 +20,14 @@ test_case() {
     [ "$1" = "$result" ]
 }
 
+# Same as test_case, but reading the file from a pipe
+stream_case() {
+    local result
+    result=$(cat "${SRCDIR}/$2" | ${FUTILITY} show -t /dev/stdin |
+             awk '{print $NF}')
+    [ "$1" = "$result" ]
+}
+
 # Arg is <file_to_probe>
 fail_case() {
     if ${FUTILITY} show -t "$1" ; then false; else true; fi
@@ -46,6 +54,12 @@ test_case "pem"             "tests/testkeys/key_rsa2048.pem"
 test_case "pem"             "tests/testkeys/key_rsa8192.pub.pem"
 test_case "bdb"             "tests/futility/data/bdb.bin"
 
+# Streams are read whole
+stream_case "bios"          "tests/futility/data/bios_zgb_mp.bin"
+stream_case "keyblock"      "tests/devkeys/kernel.keyblock"
+cat "${SRCDIR}/tests/devkeys/kernel.keyblock" | ${FUTILITY} show /dev/stdin |
+    grep -q "Key block:"
+
 # Expect failure here.
 fail_case "/Sir/Not/Appearing/In/This/Film"
 fail_case "${SRCDIR}"
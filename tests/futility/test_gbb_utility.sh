@@ -204,6 +204,28 @@ ${FUTILITY} gbb -g --digest ${TMP}.blob.bad | grep 'invalid'
 cat ${TMP}.blob | ${REPLACE} 0x84 0x70 0x71 0x72 > ${TMP}.blob.bad
 ${FUTILITY} gbb -g --digest ${TMP}.blob.bad | grep 'invalid'
 
+# Changing a full image in place gives the same result as writing a copy,
+# and only the GBB changes.
+BIOS=${SCRIPTDIR}/data/bios_link_mp.bin
+cp ${BIOS} ${TMP}.bios
+${FUTILITY} gbb -s --hwid="IN PLACE" --flags=0x39 ${TMP}.bios
+${FUTILITY} gbb -s --hwid="IN PLACE" --flags=0x39 ${BIOS} ${TMP}.bios.copy
+cmp ${TMP}.bios ${TMP}.bios.copy
+${FUTILITY} gbb -g --hwid --flags ${TMP}.bios | grep "IN PLACE"
+${FUTILITY} gbb -g --flags ${TMP}.bios | grep 0x00000039
+${FUTILITY} dump_fmap -x ${TMP}.bios RW_SECTION_A
+mv RW_SECTION_A ${TMP}.rw_a.new
+${FUTILITY} dump_fmap -x ${BIOS} RW_SECTION_A
+cmp ${TMP}.rw_a.new RW_SECTION_A
+rm -f RW_SECTION_A
+
+# A failed change leaves the image alone.
+cp ${BIOS} ${TMP}.bios
+if ${FUTILITY} gbb -s --hwid="IN PLACE" --flags=bogus ${TMP}.bios; then
+  false
+fi
+cmp ${BIOS} ${TMP}.bios
+
 # cleanup
 rm -f ${TMP}*
 exit 0
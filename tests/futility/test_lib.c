@@ -0,0 +1,281 @@
+/*
+ * Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for running futility commands in-process, through libvboot_futility
+ * alone.
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_common.h"
+#include "vboot_futility.h"
+
+#define MAX_ARGS 16
+#define NUM_DEVICES 4
+
+static const char *srcdir;
+
+/* Paths in the source directory of the files the tests use */
+static char keyblock[PATH_MAX], subkey[PATH_MAX], subkey_priv[PATH_MAX];
+static char root_key[PATH_MAX], data_key[PATH_MAX];
+static char bios[PATH_MAX], noise[PATH_MAX], missing[PATH_MAX];
+static char peppy_bios[PATH_MAX];
+
+/* Somewhere in RO_UNUSED of peppy_bios, which a full update writes */
+#define PATCH_OFFSET 0x608000
+
+static void src_path(char *buf, const char *name)
+{
+	snprintf(buf, PATH_MAX, "%s/%s", srcdir, name);
+}
+
+/* Runs a command, from a NULL-terminated list of args */
+static int run(const char *arg, ...)
+{
+	char *argv[MAX_ARGS];
+	va_list ap;
+	int argc = 0;
+
+	va_start(ap, arg);
+	for (; arg && argc < MAX_ARGS - 1; arg = va_arg(ap, char *))
+		argv[argc++] = (char *)arg;
+	va_end(ap);
+	argv[argc] = NULL;
+
+	return FutilityRun(argc, argv);
+}
+
+static void file_type_tests(void)
+{
+	TEST_STR_EQ(FutilityFileType(keyblock), "keyblock", "keyblock type");
+	TEST_STR_EQ(FutilityFileType(bios), "bios", "bios type");
+	TEST_STR_EQ(FutilityFileType(noise), "unknown", "unknown type");
+	TEST_PTR_EQ(FutilityFileType(missing), NULL, "missing file");
+}
+
+static void run_tests(void)
+{
+	char outfile[] = "/tmp/test_lib.XXXXXX";
+	int fd;
+
+	TEST_EQ(run("futility", "verify", "--publickey", subkey, keyblock,
+		    NULL), 0, "verify keyblock");
+	TEST_NEQ(run("futility", "verify", "--publickey", root_key, keyblock,
+		     NULL), 0, "verify keyblock with wrong key");
+
+	/* Options don't carry over from one call to the next */
+	TEST_EQ(run("show", keyblock, NULL), 0, "show is not strict");
+	TEST_NEQ(run("verify", keyblock, NULL), 0, "  verify needs a key");
+	TEST_EQ(run("futility", "--debug", "version", NULL), 0,
+		"global options");
+	TEST_EQ(run("futility", "verify", "--publickey", subkey, keyblock,
+		    NULL), 0, "  verify again");
+
+	TEST_NEQ(run("futility", "no_such_command", NULL), 0,
+		 "unknown command");
+
+	/* Sign a new keyblock, and check it */
+	fd = mkstemp(outfile);
+	TEST_NEQ(fd, -1, "temp file");
+	if (fd < 0)
+		return;
+	close(fd);
+	TEST_EQ(run("futility", "sign", "--signprivate", subkey_priv,
+		    data_key, outfile, NULL), 0, "sign keyblock");
+	TEST_STR_EQ(FutilityFileType(outfile), "keyblock", "  new keyblock");
+	TEST_EQ(run("futility", "verify", "--publickey", subkey, outfile,
+		    NULL), 0, "  verify new keyblock");
+	unlink(outfile);
+}
+
+/* Reads a whole file. Returns the contents, or NULL on error. */
+static char *read_file(const char *path, long *size)
+{
+	FILE *f = fopen(path, "rb");
+	char *data = NULL;
+
+	if (!f)
+		return NULL;
+	if (!fseek(f, 0, SEEK_END) && (*size = ftell(f)) > 0 &&
+	    !fseek(f, 0, SEEK_SET)) {
+		data = malloc(*size);
+		if (data && fread(data, *size, 1, f) != 1) {
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(f);
+	return data;
+}
+
+static int copy_file(const char *from, const char *to)
+{
+	long size;
+	char *data = read_file(from, &size);
+	FILE *f;
+	int r = -1;
+
+	if (!data)
+		return -1;
+	f = fopen(to, "wb");
+	if (f) {
+		r = fwrite(data, size, 1, f) == 1 ? 0 : -1;
+		if (fclose(f))
+			r = -1;
+	}
+	free(data);
+	return r;
+}
+
+static int patch_file(const char *path, long offset, int c)
+{
+	FILE *f = fopen(path, "r+b");
+	int r = -1;
+
+	if (!f)
+		return -1;
+	if (!fseek(f, offset, SEEK_SET) && fputc(c, f) == c)
+		r = 0;
+	if (fclose(f))
+		r = -1;
+	return r;
+}
+
+static int same_files(const char *a, const char *b)
+{
+	long size_a, size_b;
+	char *data_a = read_file(a, &size_a), *data_b = read_file(b, &size_b);
+	int r = data_a && data_b && size_a == size_b &&
+		!memcmp(data_a, data_b, size_a);
+
+	free(data_a);
+	free(data_b);
+	return r;
+}
+
+/* One device being updated by a worker thread */
+struct device_update {
+	struct updater_config *cfg;
+	char emulation[PATH_MAX];
+	pthread_t thread;
+	int result;
+};
+
+static void *device_update_worker(void *arg)
+{
+	struct device_update *dev = arg;
+
+	dev->result = update_firmware(dev->cfg);
+	return NULL;
+}
+
+/* Sets up an update of an emulated PEPPY to the image in the archive */
+static int setup_device(struct device_update *dev, char *archive)
+{
+	struct updater_config_arguments args = {
+		.archive = archive,
+		.emulation = dev->emulation,
+		.sys_props = (char *)"0,0x10001,1,3",
+		.write_protection = (char *)"0",
+	};
+	int do_update = 1;
+
+	if (copy_file(peppy_bios, dev->emulation))
+		return -1;
+	if (updater_setup_config(dev->cfg, &args, &do_update) || !do_update)
+		return -1;
+	return 0;
+}
+
+static void update_tests(void)
+{
+	char archive[] = "/tmp/test_lib.XXXXXX";
+	char image[PATH_MAX], expected[PATH_MAX];
+	struct device_update devs[NUM_DEVICES], single = {0};
+	int i;
+
+	if (!mkdtemp(archive)) {
+		TEST_TRUE(0, "archive directory");
+		return;
+	}
+	snprintf(image, sizeof(image), "%s/image.bin", archive);
+	TEST_SUCC(copy_file(peppy_bios, image), "archive image");
+	TEST_SUCC(patch_file(image, PATCH_OFFSET, 0x5a), "  patch image");
+
+	/* What one device alone is updated to */
+	single.cfg = updater_new_config();
+	snprintf(single.emulation, PATH_MAX, "%s/emu.single", archive);
+	TEST_SUCC(setup_device(&single, archive), "set up one device");
+	TEST_EQ(update_firmware(single.cfg), UPDATE_ERR_DONE,
+		"  update one device");
+	updater_delete_config(single.cfg);
+	snprintf(expected, sizeof(expected), "%s", single.emulation);
+	TEST_FALSE(same_files(expected, peppy_bios), "  image changed");
+
+	/* Now several devices at once, sharing the archive */
+	for (i = 0; i < NUM_DEVICES; i++) {
+		devs[i].cfg = updater_new_config();
+		snprintf(devs[i].emulation, PATH_MAX, "%s/emu.%d", archive, i);
+		if (i)
+			TEST_SUCC(updater_share_archive(devs[i].cfg,
+							devs[0].cfg),
+				  "share archive");
+		TEST_SUCC(setup_device(&devs[i], archive), "set up device");
+	}
+	TEST_NEQ(updater_share_archive(devs[1].cfg, devs[0].cfg), 0,
+		 "archive already set");
+	for (i = 0; i < NUM_DEVICES; i++)
+		TEST_SUCC(pthread_create(&devs[i].thread, NULL,
+					 device_update_worker, &devs[i]),
+			  "start update");
+	for (i = 0; i < NUM_DEVICES; i++) {
+		pthread_join(devs[i].thread, NULL);
+		TEST_EQ(devs[i].result, UPDATE_ERR_DONE, "  device updated");
+		TEST_TRUE(same_files(devs[i].emulation, expected),
+			  "  same as one device alone");
+	}
+
+	/* Each config lets go of the shared archive; the last one closes it */
+	for (i = 0; i < NUM_DEVICES; i++) {
+		updater_delete_config(devs[i].cfg);
+		unlink(devs[i].emulation);
+	}
+	unlink(expected);
+	unlink(image);
+	rmdir(archive);
+}
+
+int main(int argc, char *argv[])
+{
+	/* Where's the source directory? */
+	srcdir = getenv("SRCDIR");
+	if (argc > 1)
+		srcdir = argv[1];
+	if (!srcdir)
+		srcdir = ".";
+
+	src_path(keyblock, "tests/devkeys/kernel.keyblock");
+	src_path(subkey, "tests/devkeys/kernel_subkey.vbpubk");
+	src_path(subkey_priv, "tests/devkeys/kernel_subkey.vbprivk");
+	src_path(root_key, "tests/devkeys/root_key.vbpubk");
+	src_path(data_key, "tests/devkeys/kernel_data_key.vbpubk");
+	src_path(bios, "tests/futility/data/bios_zgb_mp.bin");
+	src_path(noise, "tests/futility/data/random_noise.bin");
+	src_path(missing, "tests/futility/data/no_such_file");
+	src_path(peppy_bios, "tests/futility/data/bios_peppy_mp.bin");
+
+	file_type_tests();
+	run_tests();
+	update_tests();
+
+	return !gTestSuccess;
+}
@@ -38,6 +38,25 @@ for a in ${AREAS}; do
   cmp $a $a.rand
 done
 
+# A bad argument anywhere means nothing changes
+cp ${BIOS} ${TMP}.before
+if ${FUTILITY} load_fmap ${BIOS} VBLOCK_B:VBLOCK_B.good NO_SUCH_AREA:/dev/zero
+then false; fi
+cmp ${BIOS} ${TMP}.before
+if ${FUTILITY} load_fmap ${BIOS} VBLOCK_B:VBLOCK_B.good \
+  BOOT_STUB:${TMP}.no_such_file; then false; fi
+cmp ${BIOS} ${TMP}.before
+if ${FUTILITY} load_fmap -o ${TMP}.out ${BIOS} VBLOCK_B:VBLOCK_B.good \
+  NO_SUCH_AREA:/dev/zero; then false; fi
+[ ! -e ${TMP}.out ]
+
+# Putting the good blobs back with -o leaves the input alone
+${FUTILITY} load_fmap -o ${TMP}.out ${BIOS} \
+  RW_SECTION_A:RW_SECTION_A.good VBLOCK_B:VBLOCK_B.good \
+  BOOT_STUB:BOOT_STUB.good
+cmp ${BIOS} ${TMP}.before
+cmp ${IN} ${TMP}.out
+
 # cleanup
 rm -f ${TMP}* ${AREAS} *.rand *.good
 exit 0
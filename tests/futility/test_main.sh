@@ -22,6 +22,16 @@ LOG="/tmp/futility.log"
 touch ${LOG}
 ${FUTILITY} help
 grep ${FUTILITY} ${LOG}
+
+# Records from futilities running at once each land in one piece.
+: > ${LOG}
+for i in $(seq 20); do
+  ${FUTILITY} help "marker$i" > /dev/null &
+done
+wait
+[ $(grep -c '^##### LOG #####$' ${LOG}) = 20 ]
+[ $(awk '/^##### LOG #####$/ { if (n) print n; n = 0 } /^marker/ { n++ }
+     END { print n }' ${LOG} | sort -u) = 1 ]
 rm -f ${LOG}
 [ -f ${LOG}.backup ] && mv ${LOG}.backup ${LOG}
 
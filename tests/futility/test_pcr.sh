@@ -0,0 +1,45 @@
+#!/bin/bash -eux
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+D1=b52791126f96a21a8ba4d511c6f25a1c1eb6dc9e
+D2=0000000000000000000000000000000000000000
+PCR=cef026e13636099f51abbbfffb5f130d4528cf8e
+
+# Digests on the command line
+${FUTILITY} pcr ${D1} ${D2} | tail -1 | grep "PCR: ${PCR}"
+
+# The same digests from text logs, a file and stdin
+printf "# boot log\n${D1}\n\n  ${D2}\n" > ${TMP}.log
+${FUTILITY} pcr -f ${TMP}.log - < ${TMP}.log > ${TMP}.out
+grep "^${TMP}.log: ${PCR}$" ${TMP}.out
+grep "^-: ${PCR}$" ${TMP}.out
+
+# And from a binary log
+printf "$(echo ${D1}${D2} | sed 's/../\\x&/g')" > ${TMP}.bin
+${FUTILITY} pcr -fb ${TMP}.bin | grep "^${TMP}.bin: ${PCR}$"
+
+# SHA-256
+S1=$(printf 'ab%.0s' $(seq 32))
+S2=$(printf '01%.0s' $(seq 32))
+S_PCR=$(${FUTILITY} pcr -2 ${S1} ${S2} | tail -1)
+printf "${S1}\n${S2}\n" | ${FUTILITY} pcr -2 -f - | grep "^-: ${S_PCR#PCR: }$"
+
+# Bad logs
+head -c 30 ${TMP}.bin > ${TMP}.short
+if ${FUTILITY} pcr -fb ${TMP}.short; then false; fi
+echo "${D1}" | cut -c 3- > ${TMP}.badlog
+if ${FUTILITY} pcr -f ${TMP}.badlog; then false; fi
+if ${FUTILITY} pcr -f ${TMP}.nonexistent; then false; fi
+if ${FUTILITY} pcr -i -f ${TMP}.log; then false; fi
+
+# cleanup
+rm -f ${TMP}*
+exit 0
@@ -59,6 +59,14 @@ for s in $SIGS; do
     done
 done
 
+# Data in the padding after the signed part of EC_RW should fail to verify
+outfile=${TMP}.padding.bin
+cp ${infile} ${outfile}
+printf '\x00' | dd of=${outfile} bs=1 seek=$((65536 + 60000)) conv=notrunc
+if ${FUTILITY} show --type rwsig ${outfile}; then
+    exit 1
+fi
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
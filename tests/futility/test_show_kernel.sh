@@ -72,6 +72,25 @@ ${FUTILITY} show ${TMP}.kernel.test \
 
 echo 'Really invalid args are still invalid'
 
+# A whole partition only has to be read as far as the signed body.
+cp ${TMP}.kernel.test ${TMP}.kpart.test
+truncate -s 32M ${TMP}.kpart.test
+${FUTILITY} show ${TMP}.kernel.test > ${TMP}.show.small
+for opt in "" "--direct"; do
+  ${FUTILITY} --debug show ${opt} ${TMP}.kpart.test \
+      --publickey ${DEVKEYS}/kernel_subkey.vbpubk \
+      > ${TMP}.show.kpart 2> ${TMP}.debug
+  grep -q "Read 0x$(printf '%x' $(stat -c %s ${TMP}.kernel.test)) bytes" \
+    ${TMP}.debug
+  grep -q 'Body verification succeeded' ${TMP}.show.kpart
+done
+${FUTILITY} show ${TMP}.kpart.test | sed "s/kpart.test/kernel.test/" \
+  | cmp - ${TMP}.show.small
+${FUTILITY} vbutil_kernel --verify ${TMP}.kpart.test \
+    --signpubkey ${DEVKEYS}/kernel_subkey.vbpubk
+
+echo 'Partitions are read only as far as the body'
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
@@ -0,0 +1,71 @@
+#!/bin/bash -eux
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DEVKEYS=${SRCDIR}/tests/devkeys
+DATADIR=${SCRIPTDIR}/data
+
+set -o pipefail
+
+rm -rf ${TMP}.dir
+mkdir -p ${TMP}.dir/sub
+cp ${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.dir/
+cp ${DEVKEYS}/firmware.keyblock ${TMP}.dir/
+cp ${DATADIR}/bios_link_mp.bin ${TMP}.dir/sub/
+echo 'not "firmware"' > ${TMP}.dir/sub/unknown
+
+# The output must not depend on the number of workers.
+${FUTILITY} show --recursive ${TMP}.dir > ${TMP}.out1
+${FUTILITY} show -r -j 4 ${TMP}.dir > ${TMP}.out4
+cmp ${TMP}.out1 ${TMP}.out4
+
+# One record per file, in sorted order.
+[ "$(grep -c '"file"' ${TMP}.out1)" = "4" ]
+grep '"file"' ${TMP}.out1 | sed -e 's/.*"file": "\([^"]*\)".*/\1/' \
+	> ${TMP}.files
+cat > ${TMP}.expect <<EOT
+${TMP}.dir/firmware.keyblock
+${TMP}.dir/firmware_data_key.vbpubk
+${TMP}.dir/sub/bios_link_mp.bin
+${TMP}.dir/sub/unknown
+EOT
+cmp ${TMP}.expect ${TMP}.files
+
+key_sha1="$(${FUTILITY} show ${DEVKEYS}/firmware_data_key.vbpubk |
+	sed -n -e 's/^ *Key sha1sum: *//p')"
+file_sha1="$(sha1sum ${DEVKEYS}/firmware_data_key.vbpubk | cut -d' ' -f1)"
+
+msg="$(grep firmware_data_key ${TMP}.out1)"
+echo "${msg}" | grep -qF '"type": "pubkey"'
+echo "${msg}" | grep -qF "\"key_sha1\": \"${key_sha1}\""
+echo "${msg}" | grep -qF "\"sha1\": \"${file_sha1}\""
+echo "${msg}" | grep -qF '"verified": true'
+
+msg="$(grep firmware.keyblock ${TMP}.out1)"
+echo "${msg}" | grep -qF "\"data_key_sha1\": \"${key_sha1}\""
+
+msg="$(grep bios_link_mp ${TMP}.out1)"
+echo "${msg}" | grep -qF '"ro_version": "Google_Link.2695.1.133"'
+echo "${msg}" | grep -qF '"verified": true'
+
+msg="$(grep sub/unknown ${TMP}.out1)"
+echo "${msg}" | grep -qF '"type": "unknown"'
+echo "${msg}" | grep -qF '"verified": false'
+
+# Unverified files only fail with --strict.
+if ${FUTILITY} show --strict -r ${TMP}.dir > /dev/null; then false; fi
+
+# Bad job counts are rejected.
+if ${FUTILITY} show -r -j 0 ${TMP}.dir; then false; fi
+if ${FUTILITY} show -r -j 65 ${TMP}.dir; then false; fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
@@ -51,6 +51,28 @@ ${FUTILITY} verify ${TMP}.vblock_a \
   --fv ${TMP}.fw_main_a
 
 
+#### verification cache
+
+# A BIOS verified through the cache shows the same, the second time from
+# the cache.
+mkdir -p ${TMP}.cache
+${FUTILITY} verify --cache-dir ${TMP}.cache \
+  ${SCRIPTDIR}/data/bios_peppy_mp.bin > ${TMP}.verify1
+[ -n "$(ls ${TMP}.cache)" ]
+${FUTILITY} --debug verify --cache-dir ${TMP}.cache \
+  ${SCRIPTDIR}/data/bios_peppy_mp.bin > ${TMP}.debug 2>&1
+grep -q 'Using cached result' ${TMP}.debug
+${FUTILITY} verify --cache-dir ${TMP}.cache \
+  ${SCRIPTDIR}/data/bios_peppy_mp.bin > ${TMP}.verify2
+cmp ${TMP}.verify1 ${TMP}.verify2
+
+# A changed firmware body isn't found in the cache.
+printf '\x5a' | dd of=${TMP}.fw_main_a bs=1 seek=16 conv=notrunc
+cp ${SCRIPTDIR}/data/bios_peppy_mp.bin ${TMP}.bios
+${FUTILITY} load_fmap ${TMP}.bios FW_MAIN_A:${TMP}.fw_main_a
+if ${FUTILITY} verify --cache-dir ${TMP}.cache ${TMP}.bios; then false; fi
+
+
 #### kernel partition
 
 ${FUTILITY} show ${SCRIPTDIR}/data/rec_kernel_part.bin
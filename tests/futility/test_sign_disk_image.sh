@@ -0,0 +1,105 @@
+#!/bin/bash -eux
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DEVKEYS=${SRCDIR}/tests/devkeys
+CGPT="${BINDIR}/cgpt"
+
+# A recovery-signed kernel partition
+echo "hi there" > ${TMP}.config.txt
+dd if=/dev/urandom bs=512 count=1 of=${TMP}.bootloader.bin
+dd if=/dev/urandom bs=1K count=256 of=${TMP}.vmlinuz
+${FUTILITY} vbutil_kernel \
+  --pack ${TMP}.kern \
+  --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --version 1 \
+  --config ${TMP}.config.txt \
+  --bootloader ${TMP}.bootloader.bin \
+  --vmlinuz ${TMP}.vmlinuz \
+  --arch arm
+truncate -s 2M ${TMP}.kern
+
+# A disk image with it in KERN-A and KERN-B, an empty KERN-C, and a rootfs
+truncate -s 8M ${TMP}.disk
+"${CGPT}" create ${TMP}.disk
+"${CGPT}" add -b 64 -s 4096 -t kernel -l KERN-A -P 1 ${TMP}.disk
+"${CGPT}" add -b 4160 -s 4096 -t kernel -l KERN-B ${TMP}.disk
+"${CGPT}" add -b 8256 -s 1 -t kernel -l KERN-C ${TMP}.disk
+"${CGPT}" add -b 8257 -s 2048 -t rootfs -l ROOT-A ${TMP}.disk
+for start in 64 4160; do
+  dd if=${TMP}.kern of=${TMP}.disk bs=512 seek=${start} conv=notrunc
+done
+dd if=/dev/urandom of=${TMP}.disk bs=512 seek=8257 count=2048 conv=notrunc
+
+# What signing each kernel partition on its own gives
+cp ${TMP}.disk ${TMP}.expected
+${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+  --keyblock ${DEVKEYS}/kernel.keyblock \
+  --version 2 \
+  ${TMP}.kern ${TMP}.kern.signed
+for start in 64 4160; do
+  dd if=${TMP}.kern.signed of=${TMP}.expected bs=512 seek=${start} \
+    conv=notrunc
+done
+
+# Sign the image into a new file; nothing but the kernels changes
+${FUTILITY} sign --type disk_img \
+  --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+  --keyblock ${DEVKEYS}/kernel.keyblock \
+  --version 2 \
+  ${TMP}.disk ${TMP}.disk.signed > ${TMP}.out
+cmp ${TMP}.expected ${TMP}.disk.signed
+grep "Signed 2 of 2 kernel partitions" ${TMP}.out
+
+# Each kernel verifies with the new key
+for start in 64 4160; do
+  dd if=${TMP}.disk.signed of=${TMP}.part bs=512 skip=${start} count=4096
+  ${FUTILITY} vbutil_kernel --verify ${TMP}.part \
+    --signpubkey ${DEVKEYS}/kernel_subkey.vbpubk
+done
+
+# The same in place, one at a time, with the type found from the GPT
+${FUTILITY} sign --jobs 1 \
+  --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+  --keyblock ${DEVKEYS}/kernel.keyblock \
+  --version 2 \
+  ${TMP}.disk
+cmp ${TMP}.expected ${TMP}.disk
+
+# Show a failure for each kernel which can't be signed
+cp ${TMP}.disk.signed ${TMP}.disk.bad
+head -c 504 /dev/zero | tr '\0' '\377' |
+  dd of=${TMP}.disk.bad bs=1 seek=$((4160 * 512 + 8)) conv=notrunc
+if ${FUTILITY} sign --type disk_img \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    ${TMP}.disk.bad > ${TMP}.out; then
+  false
+fi
+grep "FAILED  ${TMP}.disk.bad partition 2" ${TMP}.out
+grep "Signed 1 of 2 kernel partitions" ${TMP}.out
+
+# Images without a GPT or without kernels are refused
+if ${FUTILITY} sign --type disk_img \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk ${TMP}.kern; then
+  false
+fi
+truncate -s 1M ${TMP}.nokern
+"${CGPT}" create ${TMP}.nokern
+"${CGPT}" add -b 64 -s 64 -t rootfs -l ROOT-A ${TMP}.nokern
+if ${FUTILITY} sign --type disk_img \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk ${TMP}.nokern; then
+  false
+fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
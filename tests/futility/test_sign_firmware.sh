@@ -127,6 +127,48 @@ for infile in $INFILES; do
 
 done
 
+# Sign all of them again as one batch. The results should be identical.
+: $(( count++ ))
+echo -n "$count " 1>&3
+
+: > ${TMP}.batch
+for infile in $INFILES; do
+  base=${infile##*/}
+  echo "${infile} ${TMP}.${base}.batch" >> ${TMP}.batch
+done
+# And one in place
+cp ${GOOD_VBLOCKS} ${TMP}.inplace
+echo "${TMP}.inplace" >> ${TMP}.batch
+nbatch=$(grep -c . ${TMP}.batch)
+
+${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  ${DEV_FIRMWARE_PARAMS} \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  -v 14 \
+  -f 8 \
+  --batch ${TMP}.batch --jobs 3 > ${TMP}.batch.out
+
+for infile in $INFILES; do
+  base=${infile##*/}
+  cmp ${TMP}.${base}.new ${TMP}.${base}.batch
+done
+cmp ${TMP}.${GOOD_VBLOCKS##*/}.new ${TMP}.inplace
+grep -q "^Signed ${nbatch} of ${nbatch} files" ${TMP}.batch.out
+
+# A bad entry fails the batch, but not the others.
+echo "${TMP}.no_such_file ${TMP}.no_such_file.out" >> ${TMP}.batch
+if ${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  ${DEV_FIRMWARE_PARAMS} \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  --type bios \
+  --batch ${TMP}.batch --jobs 2 > ${TMP}.batch.out; then false; fi
+grep -q "^FAILED  ${TMP}.no_such_file" ${TMP}.batch.out
+grep -q "^Signed ${nbatch} of $(( nbatch + 1 )) files" ${TMP}.batch.out
+
 # Make sure that the BIOS with the good vblocks signed the right size.
 GOOD_OUT=${TMP}.${GOOD_VBLOCKS##*/}.new
 MORE_OUT=${TMP}.${ONEMORE##*/}.new
@@ -164,6 +206,15 @@ m=$(${FUTILITY} verify --publickey ${KEYDIR}/root_key.vbpubk ${MORE_OUT}.2 \
   | egrep 'Firmware version: +1$|Preamble flags: +8$' | wc -l)
 [ "$m" = "4" ]
 
+# The same image can be signed from a pipe.
+cat ${MORE_OUT} | ${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  ${DEV_FIRMWARE_PARAMS} \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  /dev/stdin ${MORE_OUT}.pipe
+cmp ${MORE_OUT}.2 ${MORE_OUT}.pipe
+
 
 # If the original preamble is not present, the preamble flags should be zero.
 : $(( count++ ))
@@ -182,6 +233,36 @@ m=$(${FUTILITY} verify --publickey ${KEYDIR}/root_key.vbpubk ${MORE_OUT}.3 \
 [ "$m" = "4" ]
 
 
+# A and B have the same vblock when their firmware is the same...
+: $(( count++ ))
+echo -n "$count " 1>&3
+
+${FUTILITY} dump_fmap -x ${GOOD_OUT} VBLOCK_A:${TMP}.vblock_a \
+  VBLOCK_B:${TMP}.vblock_b FW_MAIN_B:${TMP}.fw_main_b
+cmp ${TMP}.vblock_a ${TMP}.vblock_b
+
+# ...and are signed with their own keys when it isn't.
+printf '\x5a' | dd of=${TMP}.fw_main_b bs=1 seek=16 conv=notrunc
+cp ${GOOD_OUT} ${TMP}.differ
+${FUTILITY} load_fmap ${TMP}.differ FW_MAIN_B:${TMP}.fw_main_b
+if ${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  ${TMP}.differ ${TMP}.differ.nodev; then false; fi
+${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  -S ${KEYDIR}/firmware_data_key.vbprivk \
+  -B ${KEYDIR}/firmware.keyblock \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  ${TMP}.differ ${TMP}.differ.new
+${FUTILITY} verify --publickey ${KEYDIR}/root_key.vbpubk ${TMP}.differ.new
+${FUTILITY} dump_fmap -x ${TMP}.differ.new VBLOCK_A:${TMP}.vblock_a \
+  VBLOCK_B:${TMP}.vblock_b
+if cmp ${TMP}.vblock_a ${TMP}.vblock_b; then false; fi
+
+
 # cleanup
 rm -rf ${TMP}* ${ONEMORE}
 exit 0
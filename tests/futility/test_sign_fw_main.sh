@@ -41,6 +41,37 @@ ${FUTILITY} --debug sign \
 # They should match
 cmp ${TMP}.vblock.old ${TMP}.vblock.new
 
+# Sign with a second keyset at the same time
+${FUTILITY} --debug sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --keyset ${KEYDIR}/kernel.keyblock:${KEYDIR}/kernel_data_key.vbprivk:${TMP}.vblock.other \
+  --version 12 \
+  --fv ${TMP}.fw_main \
+  --flags 42 \
+  ${TMP}.vblock.multi
+
+# and with just the second keyset
+${FUTILITY} --debug sign \
+  --signprivate ${KEYDIR}/kernel_data_key.vbprivk \
+  --keyblock ${KEYDIR}/kernel.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --fv ${TMP}.fw_main \
+  --flags 42 \
+  ${TMP}.vblock.single
+
+# Each output is the same as signing with its keys alone
+cmp ${TMP}.vblock.new ${TMP}.vblock.multi
+cmp ${TMP}.vblock.single ${TMP}.vblock.other
+
+# --keyset only works for things with a body to sign
+if ${FUTILITY} sign \
+  --signprivate ${KEYDIR}/kernel_subkey.vbprivk \
+  --keyset ${KEYDIR}/kernel.keyblock:${KEYDIR}/kernel_data_key.vbprivk:${TMP}.keyblock.other \
+  ${KEYDIR}/kernel_data_key.vbpubk ${TMP}.keyblock; then false; fi
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
@@ -64,6 +64,40 @@ try_arch () {
   cmp ${TMP}.blob1.${arch} ${TMP}.blob2.${arch}
   diff ${TMP}.verify1 ${TMP}.verify2
 
+  # the same blob signed with a second keyset at the same time
+  ${FUTILITY} --debug sign \
+    --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+    --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+    --keyset ${DEVKEYS}/kernel.keyblock:${DEVKEYS}/kernel_data_key.vbprivk:${TMP}.blob2k.${arch} \
+    --version 1 \
+    --config ${TMP}.config.txt \
+    --bootloader ${TMP}.bootloader.bin \
+    --vmlinuz ${SCRIPTDIR}/data/vmlinuz-${arch}.bin \
+    --arch ${arch} \
+    --pad ${padding} \
+    --kloadaddr 0x11000 \
+    --outfile ${TMP}.blob2m.${arch}
+
+  # and with just the second keyset
+  ${FUTILITY} --debug sign \
+    --keyblock ${DEVKEYS}/kernel.keyblock \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 1 \
+    --config ${TMP}.config.txt \
+    --bootloader ${TMP}.bootloader.bin \
+    --vmlinuz ${SCRIPTDIR}/data/vmlinuz-${arch}.bin \
+    --arch ${arch} \
+    --pad ${padding} \
+    --kloadaddr 0x11000 \
+    --outfile ${TMP}.blob2s.${arch}
+
+  # each output is the same as signing with its keys alone
+  cmp ${TMP}.blob2.${arch} ${TMP}.blob2m.${arch}
+  cmp ${TMP}.blob2s.${arch} ${TMP}.blob2k.${arch}
+  ${FUTILITY} vbutil_kernel --verify ${TMP}.blob2k.${arch} \
+    --pad ${padding} \
+    --signpubkey ${DEVKEYS}/kernel_subkey.vbpubk
+
   echo -n "2 " 1>&3
 
   # repack it the old way
@@ -55,6 +55,12 @@ ${FUTILITY} --debug sign \
 
 cmp ${TMP}.keyblock0 ${TMP}.keyblock1
 
+# from a pipe
+cat ${DEVKEYS}/firmware_data_key.vbpubk |
+  ${FUTILITY} sign --flags 14 /dev/stdin ${TMP}.keyblock2
+
+cmp ${TMP}.keyblock0 ${TMP}.keyblock2
+
 
 # Create one using PEM args
 
@@ -104,6 +110,79 @@ ${FUTILITY} --debug sign \
 
 cmp ${TMP}.keyblock4 ${TMP}.keyblock5
 
+# persistent signer: started once, then reused for every signature
+: > ${TMP}.signer_log
+VB2_EXTERNAL_SIGNER_PERSISTENT=1 SIGNER_LOG=${TMP}.signer_log \
+  ${FUTILITY} vbutil_keyblock --pack ${TMP}.keyblock6 \
+  --datapubkey ${DEVKEYS}/firmware_data_key.vbpubk \
+  --signprivate_pem ${TESTKEYS}/key_rsa4096.pem \
+  --pem_algorithm 8 \
+  --flags 19 \
+  --externalsigner ${SIGNER}
+
+cmp ${TMP}.keyblock4 ${TMP}.keyblock6
+[ "$(grep -c started ${TMP}.signer_log)" = "1" ]
+[ "$(grep -c "sign ${TESTKEYS}/key_rsa4096.pem" ${TMP}.signer_log)" = "1" ]
+
+# a signer failure is reported, not a hang or a crash
+if VB2_EXTERNAL_SIGNER_PERSISTENT=1 ${FUTILITY} vbutil_keyblock \
+  --pack ${TMP}.keyblock7 \
+  --datapubkey ${DEVKEYS}/firmware_data_key.vbpubk \
+  --signprivate_pem ${TMP}.no_such_key.pem \
+  --pem_algorithm 8 \
+  --externalsigner ${SIGNER}; then
+  false
+fi
+
+
+# Pack several keyblocks at once with the same signing key
+DATAKEYS="firmware_data_key kernel_data_key recovery_kernel_data_key"
+: > ${TMP}.batch
+for key in ${DATAKEYS}; do
+  echo "${DEVKEYS}/${key}.vbpubk ${TMP}.batch_${key}" >> ${TMP}.batch
+  ${FUTILITY} vbutil_keyblock --pack ${TMP}.single_${key} \
+    --datapubkey ${DEVKEYS}/${key}.vbpubk \
+    --signprivate_pem ${TESTKEYS}/key_rsa4096.pem \
+    --pem_algorithm 8 \
+    --flags 19
+done
+
+for jobs in 1 2 8; do
+  ${FUTILITY} vbutil_keyblock --batch ${TMP}.batch --jobs ${jobs} \
+    --signprivate_pem ${TESTKEYS}/key_rsa4096.pem \
+    --pem_algorithm 8 \
+    --flags 19
+  for key in ${DATAKEYS}; do
+    cmp ${TMP}.single_${key} ${TMP}.batch_${key}
+  done
+done
+
+# with an external signer, started once for all of them
+: > ${TMP}.signer_log
+VB2_EXTERNAL_SIGNER_PERSISTENT=1 SIGNER_LOG=${TMP}.signer_log \
+  ${FUTILITY} vbutil_keyblock --batch ${TMP}.batch \
+  --signprivate_pem ${TESTKEYS}/key_rsa4096.pem \
+  --pem_algorithm 8 \
+  --flags 19 \
+  --externalsigner ${SIGNER}
+for key in ${DATAKEYS}; do
+  cmp ${TMP}.single_${key} ${TMP}.batch_${key}
+done
+[ "$(grep -c started ${TMP}.signer_log)" = "1" ]
+[ "$(grep -c "sign ${TESTKEYS}/key_rsa4096.pem" ${TMP}.signer_log)" = "3" ]
+
+# and unsigned
+${FUTILITY} vbutil_keyblock --batch ${TMP}.batch --flags 14
+${FUTILITY} vbutil_keyblock --pack ${TMP}.single \
+  --datapubkey ${DEVKEYS}/kernel_data_key.vbpubk \
+  --flags 14
+cmp ${TMP}.single ${TMP}.batch_kernel_data_key
+
+# a missing data key or output file fails the batch
+echo "${DEVKEYS}/kernel_data_key.vbpubk" >> ${TMP}.batch
+if ${FUTILITY} vbutil_keyblock --batch ${TMP}.batch; then false; fi
+echo "${TMP}.no_such_key.vbpubk ${TMP}.out" > ${TMP}.batch
+if ${FUTILITY} vbutil_keyblock --batch ${TMP}.batch; then false; fi
 
 # cleanup
 rm -rf ${TMP}*
@@ -228,6 +228,27 @@ test_update "RW update" \
 	"${FROM_IMAGE}" "${TMP}.expected.rw" \
 	-i "${TO_IMAGE}" --wp=1 --sys_props 0,0x10001,1
 
+# Only changed blocks are written, and --dry_run writes nothing.
+test_update "RW update (no changes)" \
+	"${TMP}.expected.rw" "${TMP}.expected.rw" \
+	-i "${TO_IMAGE}" --wp=1 --sys_props 0,0x10001,1
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=1 \
+	--sys_props 0,0x10001,1 2>&1)"
+echo "${msg}" | grep -qF "No changes in RW_SECTION_A"
+
+test_update "Full update (--dry_run)" \
+	"${FROM_IMAGE}" "${FROM_IMAGE}" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1 --dry_run
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --dry_run 2>&1)"
+echo "${msg}" | grep -qF "(dry run) Would write"
+
+# Images are mapped from their files; writing back to the file being updated
+# from must not corrupt the mapping.
+test_update "Full update (image is also the target)" \
+	"${TO_IMAGE}" "${TO_IMAGE}" \
+	-i "${TMP}.emu" --wp=0 --sys_props 0,0x10001,1 --force
+
 test_update "RW update (incompatible platform)" \
 	"${FROM_IMAGE}" "!platform is not compatible" \
 	-i "${LINK_BIOS}" --wp=1 --sys_props 0,0x10001,1
@@ -285,6 +306,27 @@ test_update "RW update (vboot1, B->B)" \
 	"${FROM_IMAGE}" "${TMP}.expected.b" \
 	-i "${TO_IMAGE}" -t --wp=1 --sys_props 1,0 --sys_props 0,0x10001,0
 
+# Test --flash_cache, for Try-RW updates that have nothing to do.
+rm -f "${TMP}.flash_cache"
+test_update "RW update (no update, save flash cache)" \
+	"${TMP}.expected.full" "${TMP}.expected.full" \
+	-i "${TO_IMAGE}" -t --wp=1 --sys_props 0,0x10001,1 \
+	--flash_cache "${TMP}.flash_cache"
+grep -q "^section VBLOCK_A " "${TMP}.flash_cache"
+cp -f "${TMP}.expected.full" "${TMP}.emu"
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" -t \
+	--wp=1 --sys_props 0,0x10001,1 \
+	--flash_cache "${TMP}.flash_cache" 2>&1)"
+echo "${msg}" | grep -qF "Firmware still matches"
+test_update "RW update (A->B, stale flash cache)" \
+	"${FROM_IMAGE}" "${TMP}.expected.b" \
+	-i "${TO_IMAGE}" -t --wp=1 --sys_props 0,0x10001,1 \
+	--flash_cache "${TMP}.flash_cache"
+test_update "RW update (B->A, flash cache for other slot)" \
+	"${TMP}.expected.full" "${TMP}.expected.full" \
+	-i "${TO_IMAGE}" -t --wp=1 --sys_props 1,0x10001,1 \
+	--flash_cache "${TMP}.flash_cache"
+
 # Test 'factory mode'
 test_update "Factory mode update (WP=0)" \
 	"${FROM_IMAGE}" "${TMP}.expected.full" \
@@ -337,9 +379,15 @@ test_update "Full update (--quirks min_platform_version)" \
 
 # Test archive and manifest.
 A="${TMP}.archive"
-mkdir -p "${A}/bin"
-echo 'echo "${WL_TAG}"' >"${A}/bin/vpd"
-chmod +x "${A}/bin/vpd"
+mkdir -p "${A}"
+
+# Writes a VPD 2.0 blob with one string: make_vpd FILE KEY VALUE
+make_vpd() {
+	local key_len="$(printf '\\%03o' ${#2})"
+	local value_len="$(printf '\\%03o' ${#3})"
+
+	printf "\\001${key_len}%s${value_len}%s\\000" "$2" "$3" >"$1"
+}
 
 cp -f "${LINK_BIOS}" "${A}/bios.bin"
 echo "TEST: Manifest (--manifest, bios.bin)"
@@ -387,16 +435,19 @@ test_update "Full update (--archive, WL, single package)" \
 	"${A}/image.bin" "${LINK_BIOS}" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --signature_id=WL
 
-WL_TAG="WL" PATH="${A}/bin:${PATH}" \
-	test_update "Full update (--archive, WL, fake vpd)" \
-	"${A}/image.bin" "${LINK_BIOS}" \
+make_vpd "${TMP}.vpd.WL" whitelabel_tag WL
+cp -f "${A}/image.bin" "${TMP}.from.WL"
+"${FUTILITY}" load_fmap "${TMP}.from.WL" RO_VPD:"${TMP}.vpd.WL"
+cp -f "${LINK_BIOS}" "${TMP}.expected.WL"
+"${FUTILITY}" load_fmap "${TMP}.expected.WL" RO_VPD:"${TMP}.vpd.WL"
+test_update "Full update (--archive, WL, VPD)" \
+	"${TMP}.from.WL" "${TMP}.expected.WL" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3
 
 echo "TEST: Output (-a, --mode=output)"
 mkdir -p "${TMP}.outa"
-cp -f "${A}/image.bin" "${TMP}.emu"
-WL_TAG="WL" PATH="${A}/bin:${PATH}" \
-	${FUTILITY} update -a "${A}" --mode=output --emu="${TMP}.emu" \
+cp -f "${TMP}.from.WL" "${TMP}.emu"
+${FUTILITY} update -a "${A}" --mode=output --emu="${TMP}.emu" \
 	--output_dir="${TMP}.outa"
 cmp "${LINK_BIOS}" "${TMP}.outa/image.bin"
 
@@ -427,9 +478,13 @@ test_update "Full update (--archive, model=whitetip, signature_id=WL)" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=whitetip \
 	--signature_id=whitetip-wl
 
-WL_TAG="wl" PATH="${A}/bin:${PATH}" \
-	test_update "Full update (-a, model=WL, fake VPD)" \
-	"${FROM_IMAGE}.al" "${LINK_BIOS}" \
+make_vpd "${TMP}.vpd.wl" whitelabel_tag wl
+cp -f "${FROM_IMAGE}.al" "${FROM_IMAGE}.al.wl"
+"${FUTILITY}" load_fmap "${FROM_IMAGE}.al.wl" RO_VPD:"${TMP}.vpd.wl"
+cp -f "${LINK_BIOS}" "${TMP}.expected.wl"
+"${FUTILITY}" load_fmap "${TMP}.expected.wl" RO_VPD:"${TMP}.vpd.wl"
+test_update "Full update (-a, model=WL, VPD)" \
+	"${FROM_IMAGE}.al.wl" "${TMP}.expected.wl" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=whitetip
 
 # WL-Unibuild without default keys
@@ -445,6 +500,13 @@ test_update "Full update (-a, model=WL, no VPD, default keys)" \
 	"${FROM_IMAGE}.al" "${LINK_BIOS}" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=whitetip
 
+# Models sharing an image have it listed the same way
+cp -r "${A}/models/link" "${A}/models/link-clone"
+echo "TEST: Manifest (--manifest, Unified Build)"
+${FUTILITY} update -a "${A}" --manifest >"${TMP}.json.out"
+cmp "${TMP}.json.out" "${SCRIPTDIR}/unibuild.manifest.json"
+rm -rf "${A}/models/link-clone"
+
 # Test special programmer
 if type flashrom >/dev/null 2>&1; then
 	echo "TEST: Full update (dummy programmer)"
@@ -0,0 +1,71 @@
+#!/bin/bash -eux
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+# Little-endian 16 and 32 bit values, as printf escapes
+le16() {
+  printf '\\x%02x\\x%02x' $(( $1 & 0xff )) $(( ($1 >> 8) & 0xff ))
+}
+le32() {
+  le16 $(( $1 & 0xffff ))
+  le16 $(( ($1 >> 16) & 0xffff ))
+}
+
+# IP checksum of a file, the slow way
+ip_checksum() {
+  local sum=0 i=0 v
+  for v in $(od -An -v -tu1 "$1"); do
+    if (( i++ & 1 )); then
+      sum=$(( sum + (v << 8) ))
+    else
+      sum=$(( sum + v ))
+    fi
+  done
+  while (( sum >> 16 )); do
+    sum=$(( (sum & 0xffff) + (sum >> 16) ))
+  done
+  echo $(( ~sum & 0xffff ))
+}
+
+# An odd-sized MRC cache, in a 4-block slot after the metadata block
+DATA_SIZE=37
+dd if=/dev/urandom of=${TMP}.data bs=${DATA_SIZE} count=1
+data_checksum=$(ip_checksum ${TMP}.data)
+
+printf "MRCD$(le32 ${DATA_SIZE})$(le16 ${data_checksum})$(le16 0)$(le32 1)" \
+  > ${TMP}.header
+header_checksum=$(ip_checksum ${TMP}.header)
+
+{
+  printf "$(le16 1)$(le16 5)$(le16 0xffff)"
+  head -c 10 /dev/zero | tr '\0' '\377'
+  printf "MRCD$(le32 ${DATA_SIZE})$(le16 ${data_checksum})"
+  printf "$(le16 ${header_checksum})$(le32 1)"
+  cat ${TMP}.data
+  head -c $(( 64 - 16 - DATA_SIZE )) /dev/zero | tr '\0' '\377'
+} > ${TMP}.mrc
+
+${FUTILITY} validate_rec_mrc ${TMP}.mrc
+
+# And at an offset
+{ head -c 256 /dev/zero; cat ${TMP}.mrc; } > ${TMP}.mrc_offset
+${FUTILITY} validate_rec_mrc --offset 256 ${TMP}.mrc_offset
+if ${FUTILITY} validate_rec_mrc ${TMP}.mrc_offset; then false; fi
+
+# Any change to the data or metadata is caught
+for pos in 16 20 24 32 $(( 32 + DATA_SIZE - 1 )); do
+  cp ${TMP}.mrc ${TMP}.bad
+  printf '\x5a' | dd of=${TMP}.bad bs=1 seek=${pos} conv=notrunc
+  if ${FUTILITY} validate_rec_mrc ${TMP}.bad; then false; fi
+done
+
+# cleanup
+rm -f ${TMP}*
+exit 0
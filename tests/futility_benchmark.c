@@ -0,0 +1,290 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for how long futility takes to start.
+ *
+ * Scripts run futility thousands of times for commands which do very little,
+ * so the time to load and start it matters more than the command itself.
+ * Each command below is run as a new process, with its output thrown away,
+ * and the wall time from fork() to exit is printed as JSON on stdout, along
+ * with its peak RSS and how many bytes it read and wrote.  None of them need
+ * OpenSSL; build with LAZY_CRYPTO=1 to see what loading libcrypto at startup
+ * costs.
+ *
+ * Given a futility command line instead, only that command is run, for
+ * futility_image_benchmark.sh to time real work on large images.  Bytes are
+ * what passed through read() and write(); files futility maps show up in
+ * the peak RSS instead.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "timer_utils.h"
+
+/* Default number of timed runs per command */
+#define DEFAULT_REPEATS 200
+
+/* Untimed runs before each command, to get futility into the page cache */
+#define WARMUP 5
+
+#define MAX_ARGS 4
+
+static const struct option long_opts[] = {
+	{"repeats", 1, NULL, 'n'},
+	{"cpu",     1, NULL, 'c'},
+	{"name",    1, NULL, 'N'},
+	{"setup",   1, NULL, 's'},
+	{"help",    0, NULL, 'h'},
+	{NULL,      0, NULL, 0},
+};
+
+/* Set by -n */
+static int repeats = DEFAULT_REPEATS;
+
+/* Set by -s: shell command to run, untimed, before each run */
+static const char *setup;
+
+/* What one run of a command used */
+struct usage {
+	uint64_t time;		/* Wall time in ns */
+	uint64_t max_rss_kb;	/* Peak resident set size in KiB */
+	uint64_t read_bytes;	/* Bytes read with read() and friends */
+	uint64_t write_bytes;	/* Bytes written with write() and friends */
+};
+
+/* Commands to run, after the path to futility */
+static const struct {
+	const char *name;
+	const char *args[MAX_ARGS];
+} commands[] = {
+	{"version", {"version"}},
+	{"dump_fmap --help", {"dump_fmap", "--help"}},
+	{"gbb_utility --help", {"gbb_utility", "--help"}},
+};
+
+/*
+ * Fills in the bytes read and written by exited process pid, which must not
+ * have been waited for yet.  Leaves them 0 if the kernel doesn't say.
+ */
+static void read_io(pid_t pid, struct usage *u)
+{
+	char line[80];
+	unsigned long long value;
+	FILE *f;
+
+	snprintf(line, sizeof(line), "/proc/%d/io", (int)pid);
+	f = fopen(line, "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "rchar: %llu", &value) == 1)
+			u->read_bytes = value;
+		else if (sscanf(line, "wchar: %llu", &value) == 1)
+			u->write_bytes = value;
+	}
+	fclose(f);
+}
+
+/*
+ * Runs argv once, after any setup, and waits for it.
+ *
+ * Returns 0 if success and fills in u, non-zero if it couldn't be run or
+ * failed.
+ */
+static int run_once(char * const *argv, struct usage *u)
+{
+	struct rusage ru;
+	siginfo_t info;
+	uint64_t start;
+	int status, fd;
+	pid_t pid;
+
+	memset(u, 0, sizeof(*u));
+
+	if (setup && system(setup))
+		return 1;
+
+	start = ReadNsecs();
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0) {
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+
+	/* Leave it a zombie until its I/O counts have been read */
+	if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT))
+		return 1;
+	u->time = ReadNsecs() - start;
+	read_io(pid, u);
+
+	if (wait4(pid, &status, 0, &ru) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return 1;
+	u->max_rss_kb = ru.ru_maxrss;
+
+	return 0;
+}
+
+/*
+ * Times one command and prints a JSON result for it.  Bytes read and written
+ * are from the last run.
+ *
+ * Returns 0 if success, non-zero if the command failed or out of memory.
+ */
+static int run_command(char * const *argv, const char *name, const char *sep)
+{
+	uint64_t *samples;
+	TimerStatsState stats;
+	struct usage u;
+	uint64_t max_rss_kb = 0;
+	int i;
+
+	samples = malloc(repeats * sizeof(*samples));
+	if (!samples)
+		return 1;
+
+	for (i = 0; i < WARMUP; i++)
+		run_once(argv, &u);
+
+	for (i = 0; i < repeats; i++) {
+		if (run_once(argv, &u)) {
+			fprintf(stderr, "Can't run %s %s\n", argv[0], name);
+			free(samples);
+			return 1;
+		}
+		samples[i] = u.time;
+		if (u.max_rss_kb > max_rss_kb)
+			max_rss_kb = u.max_rss_kb;
+	}
+
+	GetTimerStats(samples, repeats, &stats);
+
+	printf("%s    {\"name\": \"%s\", \"repeats\": %d, "
+	       "\"min\": %llu, \"median\": %llu, \"p99\": %llu, "
+	       "\"max_rss_kb\": %llu, \"read_bytes\": %llu, "
+	       "\"write_bytes\": %llu}",
+	       sep, name, repeats,
+	       (unsigned long long)stats.min,
+	       (unsigned long long)stats.median,
+	       (unsigned long long)stats.p99,
+	       (unsigned long long)max_rss_kb,
+	       (unsigned long long)u.read_bytes,
+	       (unsigned long long)u.write_bytes);
+	fflush(stdout);
+
+	free(samples);
+	return 0;
+}
+
+/* Runs one of the commands above.  Returns non-zero if it failed. */
+static int run_listed(const char *futility, int cmd, const char *sep)
+{
+	const char *argv[MAX_ARGS + 2] = {futility};
+	int i;
+
+	for (i = 0; i < MAX_ARGS && commands[cmd].args[i]; i++)
+		argv[i + 1] = commands[cmd].args[i];
+
+	return run_command((char * const *)argv, commands[cmd].name, sep);
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [-n NUM] [-c CPU] [-N NAME] [-s SETUP] "
+		"FUTILITY [ARGS...]\n"
+		"\n"
+		"Times some quick futility commands, or just FUTILITY ARGS "
+		"if given.\n"
+		"\n"
+		"  -n|--repeats  NUM    Timed runs per command "
+		"(default %d)\n"
+		"  -c|--cpu      CPU    Only run on this CPU\n"
+		"  -N|--name     NAME   Name of the result for ARGS "
+		"(default ARGS[0])\n"
+		"  -s|--setup    SETUP  Shell command to run before each run,"
+		" untimed\n",
+		progname, DEFAULT_REPEATS);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sep = "";
+	const char *name = NULL;
+	char *e;
+	int errorcnt = 0;
+	int i;
+
+	while ((i = getopt_long(argc, argv, "+n:c:N:s:h", long_opts,
+				NULL)) != -1) {
+		switch (i) {
+		case 'n':
+			repeats = strtol(optarg, &e, 0);
+			if (!*optarg || *e || repeats < 1) {
+				fprintf(stderr, "Invalid --repeats\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			i = strtol(optarg, &e, 0);
+			if (!*optarg || *e || PinToCpu(i)) {
+				fprintf(stderr, "Can't run on CPU %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'N':
+			name = optarg;
+			break;
+		case 's':
+			setup = optarg;
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc || (name && optind == argc - 1)) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	printf("{\n  \"unit\": \"ns\",\n  \"futility\": \"%s\",\n"
+	       "  \"results\": [\n", argv[optind]);
+
+	if (optind < argc - 1) {
+		errorcnt += run_command(argv + optind,
+					name ? name : argv[optind + 1], sep);
+	} else {
+		for (i = 0; i < ARRAY_SIZE(commands); i++) {
+			if (run_listed(argv[optind], i, sep))
+				errorcnt++;
+			else
+				sep = ",\n";
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	return errorcnt ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+#!/bin/bash
+
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Time the main futility operations on images as big as real ones.
+#
+# 16 and 32 MB BIOS images are made from the 8 MB ones in tests/futility/data
+# by padding them the way a bigger flash chip would be, and a 64 MB kernel
+# partition holds a 32 MB kernel.  Each operation is run by futility_benchmark,
+# which reports its wall time, peak RSS and the bytes it read and wrote, and
+# the results are printed as JSON.
+#
+# With -b, the results are also compared against a baseline from an earlier
+# -u run (tests/futility_image_benchmark.baseline is the committed one), and
+# the script fails if any operation got slower than TIME_LIMIT percent of the
+# baseline, or used more than SIZE_LIMIT percent of its memory or I/O.  Times
+# depend on the machine, so the time limit is loose; memory and I/O don't,
+# though a few KB more for longer paths in the output isn't a regression.
+#
+# Usage:
+#    futility_image_benchmark.sh [-b BASELINE] [-u]
+#
+#    -b BASELINE   Compare the results against BASELINE
+#    -u            Write the results to BASELINE instead
+#
+# Optional environment variables:
+#    REPEATS - timed runs per operation (default 5)
+#    TIME_LIMIT - slowest allowed median time, in percent (default 200)
+#    SIZE_LIMIT - most allowed RSS and I/O, in percent (default 125)
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+REPEATS=${REPEATS:-5}
+TIME_LIMIT=${TIME_LIMIT:-200}
+SIZE_LIMIT=${SIZE_LIMIT:-125}
+# RSS and I/O can always grow by this much, in KB and bytes
+SIZE_SLACK=4096
+DIR="${TEST_DIR}/futility_image_benchmark_dir"
+BENCH="${TEST_DIR}/futility_benchmark"
+DATA="${SCRIPT_DIR}/futility/data"
+KEYS="${SCRIPT_DIR}/devkeys"
+RESULTS="${DIR}/results"
+
+BASELINE=
+UPDATE=
+while getopts "b:u" opt; do
+  case "${opt}" in
+    b) BASELINE="$(readlink -f "${OPTARG}")" ;;
+    u) UPDATE=1 ;;
+    *) error "Usage: $0 [-b BASELINE] [-u]" ;;
+  esac
+done
+[ -z "${UPDATE}" ] || [ -n "${BASELINE}" ] || error "-u needs -b BASELINE"
+
+# Pad 8 MB image $1 with erased flash to $2 MB, into $3
+enlarge() {
+  cp -f "$1" "$3"
+  head -c $(( ($2 << 20) - $(stat -c %s "$1") )) /dev/zero |
+    tr '\0' '\377' >> "$3"
+}
+
+# Rename the platform in image $1 from "Google_" to "Google.", so images for
+# different boards can be updated to each other, as test_update.sh does
+same_platform() {
+  local section offset
+
+  for section in RO_FRID RW_FWID_A RW_FWID_B; do
+    offset=$(${FUTILITY} dump_fmap -p "$1" ${section} | awk '{print $2}')
+    printf Google. | dd of="$1" bs=1 seek=${offset} conv=notrunc 2>/dev/null
+  done
+}
+
+make_inputs() {
+  local size i
+
+  for size in 16 32; do
+    enlarge "${DATA}/bios_link_mp.bin" ${size} link_${size}.bin
+    enlarge "${DATA}/bios_peppy_mp.bin" ${size} peppy_${size}.bin
+    same_platform link_${size}.bin
+    same_platform peppy_${size}.bin
+  done
+
+  for i in 1 2 3 4 5 6 7 8; do
+    cat "${DATA}/vmlinuz-amd64.bin"
+  done > vmlinuz.bin
+  echo 'console=tty0' > config.txt
+  head -c 4096 /dev/zero > bootloader.bin
+  ${FUTILITY} vbutil_kernel --pack kernel_64.bin \
+    --keyblock "${KEYS}/kernel.keyblock" \
+    --signprivate "${KEYS}/kernel_data_key.vbprivk" \
+    --version 1 --config config.txt --bootloader bootloader.bin \
+    --vmlinuz vmlinuz.bin --arch x86
+  truncate -s 64M kernel_64.bin
+}
+
+# Time operation $1, with setup command $2, running futility arguments $3...
+run_op() {
+  local name="$1"
+  local setup="$2"
+  local result
+  shift 2
+
+  result=$("${BENCH}" -n ${REPEATS} -N "${name}" ${setup:+-s "${setup}"} \
+    "${FUTILITY}" "$@" | grep '"name"') ||
+    error "Can't run ${name}"
+  printf '%b%s' "${SEP}" "${result}"
+  echo "${result}" >> "${RESULTS}"
+  SEP=",\\n"
+}
+
+# Print field $2 of the result named $1 in file $3
+field() {
+  grep -F "\"name\": \"$1\"," "$3" |
+    sed -n "s/.*\"$2\": \\([0-9]*\\).*/\\1/p"
+}
+
+# Check the results against ${BASELINE}.  Returns non-zero if any regressed.
+check_baseline() {
+  local errors=0
+  local name key limit slack now was
+
+  while read -r name; do
+    for key in median max_rss_kb read_bytes write_bytes; do
+      limit=${SIZE_LIMIT}
+      slack=${SIZE_SLACK}
+      if [ "${key}" = median ]; then
+        limit=${TIME_LIMIT}
+        slack=0
+      fi
+      now=$(field "${name}" ${key} "${RESULTS}")
+      was=$(field "${name}" ${key} "${BASELINE}")
+      if [ -z "${was}" ]; then
+        warning "${name} isn't in ${BASELINE}"
+        break
+      fi
+      if [ $(( now * 100 )) -gt $(( was * limit )) ] &&
+          [ $(( now - was )) -gt ${slack} ]; then
+        warning "${name}: ${key} is ${now}, was ${was}"
+        errors=$(( errors + 1 ))
+      fi
+    done
+  done < <(sed -n 's/.*"name": "\([^"]*\)".*/\1/p' "${RESULTS}")
+
+  [ ${errors} -eq 0 ]
+}
+
+[ -x "${BENCH}" ] || error "Can't find ${BENCH}; run make tests first"
+[ -d "${DIR}" ] || mkdir -p "${DIR}"
+cd "${DIR}"
+make_inputs >/dev/null
+rm -f "${RESULTS}"
+
+SEP=""
+echo "{"
+echo "  \"unit\": \"ns\","
+echo "  \"results\": ["
+for size in 16 32; do
+  image="${DIR}/link_${size}.bin"
+
+  run_op "sign bios ${size}M" "" sign \
+    -s "${KEYS}/firmware_data_key.vbprivk" \
+    -b "${KEYS}/firmware.keyblock" \
+    -k "${KEYS}/kernel_subkey.vbpubk" \
+    "${image}" "${DIR}/signed_${size}.bin"
+  run_op "show bios ${size}M" "" show "${image}"
+  run_op "update --emulate ${size}M" \
+    "cp -f '${DIR}/peppy_${size}.bin' '${DIR}/emu_${size}.bin'" \
+    update --emulate "${DIR}/emu_${size}.bin" -i "${image}" \
+    --wp=0 --sys_props 0,0x10001,1
+  (mkdir -p "fmap_${size}" && cd "fmap_${size}" &&
+    run_op "dump_fmap -x ${size}M" "" dump_fmap -x "${image}")
+  run_op "gbb_utility -s ${size}M" "" gbb_utility -s \
+    --hwid="X86 LINK TEST 6638" --flags=0x39 "${image}"
+done
+run_op "sign kernel 64M" "" sign \
+  --signprivate "${KEYS}/kernel_data_key.vbprivk" \
+  --keyblock "${KEYS}/kernel.keyblock" \
+  --version 2 "${DIR}/kernel_64.bin" "${DIR}/signed_kernel_64.bin"
+run_op "verify kernel 64M" "" vbutil_kernel \
+  --verify "${DIR}/kernel_64.bin" \
+  --signpubkey "${KEYS}/kernel_subkey.vbpubk"
+echo
+echo "  ]"
+echo "}"
+
+if [ -n "${UPDATE}" ]; then
+  cp -f "${RESULTS}" "${BASELINE}"
+elif [ -n "${BASELINE}" ]; then
+  check_baseline || error "Slower or bigger than ${BASELINE}"
+fi
@@ -0,0 +1,212 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runs the firmware verification path a given number of times, for counting
+ * instructions per verification under QEMU; see qemu_benchmark.sh.
+ *
+ * Everything is read into memory before the first run, so that the runs
+ * themselves only execute firmware library code.  This only needs the
+ * firmware library and libc, so it can be linked with a library built for
+ * any FIRMWARE_ARCH.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2rsa.h"
+#include "vb2_common.h"
+
+/* A file read into memory */
+struct file_data {
+	uint8_t *data;
+	uint32_t size;
+};
+
+static struct file_data gbb, fw_vblock, fw_body;
+static struct file_data kernel_subkey, kernel_vblock;
+
+/* Scratch copy of the kernel vblock, since verifying destroys signatures */
+static uint8_t *kernel_vblock_copy;
+
+static int read_file(const char *filename, struct file_data *f)
+{
+	FILE *fp = fopen(filename, "rb");
+	long size;
+
+	if (!fp) {
+		fprintf(stderr, "Can't open %s\n", filename);
+		return 1;
+	}
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 ||
+	    fseek(fp, 0, SEEK_SET)) {
+		fprintf(stderr, "Can't get size of %s\n", filename);
+		fclose(fp);
+		return 1;
+	}
+
+	f->size = size;
+	f->data = malloc(size ? size : 1);
+	if (!f->data || fread(f->data, 1, size, fp) != size) {
+		fprintf(stderr, "Can't read %s\n", filename);
+		fclose(fp);
+		return 1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+int vb2ex_read_resource(struct vb2_context *c,
+			enum vb2_resource_index index,
+			uint32_t offset,
+			void *buf,
+			uint32_t size)
+{
+	const struct file_data *f;
+
+	switch (index) {
+	case VB2_RES_GBB:
+		f = &gbb;
+		break;
+	case VB2_RES_FW_VBLOCK:
+		f = &fw_vblock;
+		break;
+	default:
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	if (offset > f->size || size > f->size - offset)
+		return VB2_ERROR_UNKNOWN;
+
+	memcpy(buf, f->data + offset, size);
+	return VB2_SUCCESS;
+}
+
+/* Firmware phases 1-3, then the firmware body hash */
+static int verify_fw(void)
+{
+	uint8_t workbuf[16384] __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_context ctx;
+	uint32_t expect_size;
+	int rv;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.workbuf = workbuf;
+	ctx.workbuf_size = sizeof(workbuf);
+
+	rv = vb2api_secdata_create(&ctx);
+	if (!rv)
+		rv = vb2api_fw_phase1(&ctx);
+	if (!rv)
+		rv = vb2api_fw_phase2(&ctx);
+	if (!rv)
+		rv = vb2api_fw_phase3(&ctx);
+	if (!rv)
+		rv = vb2api_init_hash(&ctx, VB2_HASH_TAG_FW_BODY,
+				      &expect_size);
+	if (!rv && expect_size > fw_body.size)
+		rv = VB2_ERROR_UNKNOWN;
+	if (!rv)
+		rv = vb2api_extend_hash(&ctx, fw_body.data, expect_size);
+	if (!rv)
+		rv = vb2api_check_hash(&ctx);
+	return rv;
+}
+
+/* Kernel keyblock and preamble, as LoadKernel() checks them */
+static int verify_kernel(void)
+{
+	uint8_t workbuf[VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+	struct vb2_public_key key;
+	struct vb2_keyblock *keyblock;
+	struct vb2_kernel_preamble *preamble;
+	int rv;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	memcpy(kernel_vblock_copy, kernel_vblock.data, kernel_vblock.size);
+	keyblock = (struct vb2_keyblock *)kernel_vblock_copy;
+
+	rv = vb2_unpack_key_buffer(&key, kernel_subkey.data,
+				   kernel_subkey.size);
+	if (!rv)
+		rv = vb2_verify_keyblock(keyblock, kernel_vblock.size, &key,
+					 &wb);
+	if (!rv)
+		rv = vb2_unpack_key(&key, &keyblock->data_key);
+	if (rv)
+		return rv;
+
+	preamble = (struct vb2_kernel_preamble *)
+		(kernel_vblock_copy + keyblock->keyblock_size);
+	return vb2_verify_kernel_preamble(
+		preamble, kernel_vblock.size - keyblock->keyblock_size, &key,
+		&wb);
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s COUNT fw GBB VBLOCK BODY\n"
+		"       %s COUNT kernel SUBKEY VBLOCK\n"
+		"\n"
+		"Runs firmware phases 1-3 and the body hash, or the kernel\n"
+		"keyblock and preamble checks, COUNT times.\n",
+		progname, progname);
+}
+
+int main(int argc, char *argv[])
+{
+	int (*verify)(void);
+	char *e;
+	long count, i;
+	int rv;
+
+	if (argc < 3) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	count = strtol(argv[1], &e, 0);
+	if (!*argv[1] || *e || count < 0) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	if (!strcmp(argv[2], "fw") && argc == 6) {
+		if (read_file(argv[3], &gbb) ||
+		    read_file(argv[4], &fw_vblock) ||
+		    read_file(argv[5], &fw_body))
+			return 1;
+		verify = verify_fw;
+	} else if (!strcmp(argv[2], "kernel") && argc == 5) {
+		if (read_file(argv[3], &kernel_subkey) ||
+		    read_file(argv[4], &kernel_vblock))
+			return 1;
+		kernel_vblock_copy = malloc(kernel_vblock.size);
+		if (!kernel_vblock_copy)
+			return 1;
+		verify = verify_kernel;
+	} else {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		rv = verify();
+		if (rv) {
+			fprintf(stderr, "%s verification failed (0x%x)\n",
+				argv[2], rv);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -80,7 +80,16 @@ function pre_work {
 }
 
 mkdir -p ${TESTCASE_DIR}
-pre_work
 check_test_keys
+# Only regenerate when the keys or tools change
+inputs_hash=$(content_hash "$0" ${FUTILITY} ${TESTKEY_DIR}/key_rsa4096.* \
+  ${TESTKEY_DIR}/key_rsa8192.*)
+if content_hash_matches fuzz_testcases ${inputs_hash}; then
+  echo "(skipping, fuzzing test cases are up to date)"
+  exit 0
+fi
+record_content_hash fuzz_testcases ""
+pre_work
 generate_fuzzing_images ${TEST_IMAGE_FILE}
+record_content_hash fuzz_testcases ${inputs_hash}
 
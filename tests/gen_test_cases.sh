@@ -45,4 +45,14 @@ function generate_test_file {
 mkdir -p ${TESTCASE_DIR}
 check_test_keys
 generate_test_file
+# Only regenerate when the keys, tools or test file change
+keys=( ${key_lengths[@]/#/${TESTKEY_DIR}/key_rsa} )
+inputs_hash=$(content_hash "$0" ${BIN_DIR}/signature_digest_utility \
+  ${TEST_FILE} ${keys[@]/%/.pem})
+if content_hash_matches testcases ${inputs_hash}; then
+  echo "(skipping, test signatures are up to date)"
+  exit 0
+fi
+record_content_hash testcases ""
 generate_test_signatures
+record_content_hash testcases ${inputs_hash}
@@ -5,6 +5,15 @@
 # found in the LICENSE file.
 #
 # Generate test keys for use by the tests.
+#
+# Usage:
+#    gen_test_keys.sh [-f]
+#
+# Keys which already exist are kept, unless -f is given.  Each key length is
+# generated in parallel.  New RSA keys are saved in KEY_CACHE_DIR (default:
+# ~/.cache/vboot_reference/testkeys; set it empty to disable) under a hash of
+# how they are generated, and reused from there instead of being generated
+# again.
 
 # Load common constants and variables.
 . "$(dirname "$0")/common.sh"
@@ -12,56 +21,106 @@
 set -e
 
 sha_types=( 1 256 512 )
+KEY_CACHE_DIR=${KEY_CACHE_DIR-${HOME}/.cache/vboot_reference/testkeys}
+
+force=
+if [ "$1" = "-f" ]; then
+  force=1
+elif [ -n "$1" ]; then
+  echo "Usage: $(basename "$0") [-f]" >&2
+  exit 1
+fi
+
+# Write a new RSA private key with exponent $1 and $2 bits to $3, from the
+# cache if possible.
+function generate_pem {
+  local exp="$1"
+  local bits="$2"
+  local pem="$3"
+  local cached
+
+  if [ -z "${KEY_CACHE_DIR}" ] || [ -n "${force}" ]; then
+    openssl genrsa -${exp} -out "${pem}" ${bits}
+    return
+  fi
+
+  cached="${KEY_CACHE_DIR}/$(echo "genrsa -${exp} ${bits}" |
+    sha256sum | cut -d' ' -f1).pem"
+  if [ ! -f "${cached}" ]; then
+    mkdir -p "${KEY_CACHE_DIR}"
+    openssl genrsa -${exp} -out "${cached}.$$" ${bits}
+    mv "${cached}.$$" "${cached}"
+  fi
+  cp "${cached}" "${pem}"
+}
+
+# Generate the RSA test key with length $1 and algorithm index $2.
+function generate_key {
+  local i="$1"
+  local key_index="$2"
+  local key_base="${TESTKEY_DIR}/key_rsa${i}"
+  local exp bits alg alg_index sha_type
+
+  if [ -f "${key_base}.keyb" ] && [ -z "${force}" ]; then
+    return
+  fi
+
+  # Extract exponent from key_length name, if necessary
+  exp="F4"
+  bits=$i
+  if [ "${i##*_exp}" != "${i}" ]; then
+      exp="${i##*_exp}"
+      bits="${i%%_exp${exp}}"
+  fi
+
+  generate_pem ${exp} ${bits} ${key_base}.pem
+  # Generate self-signed certificate from key.
+  openssl req -batch -new -x509 -key ${key_base}.pem \
+    -out ${key_base}.crt
 
-# Generate RSA test keys of various lengths.
+  # Generate pre-processed key for use by RSA signature verification code.
+  ${BIN_DIR}/dumpRSAPublicKey -cert ${key_base}.crt \
+    > ${key_base}.keyb
+
+  alg_index=0
+  for sha_type in ${sha_types[@]}
+  do
+    alg=$((${key_index} * 3 + ${alg_index}))
+# wrap the public key
+    ${FUTILITY} vbutil_key \
+      --pack "${key_base}.sha${sha_type}.vbpubk" \
+      --key "${key_base}.keyb" \
+      --version 1 \
+      --algorithm ${alg}
+
+# wrap the private key
+    ${FUTILITY} vbutil_key \
+      --pack "${key_base}.sha${sha_type}.vbprivk" \
+      --key "${key_base}.pem" \
+      --algorithm ${alg}
+    alg_index=$((${alg_index} + 1))
+  done
+}
+
+# Generate RSA test keys of various lengths, all at once.
 function generate_keys {
-  key_index=0
-  key_name_base="${TESTKEY_DIR}/key_rsa"
+  local key_index=0
+  local failed=0
+  local i pid
+  local pids=()
+
   for i in ${key_lengths[@]}
   do
-    key_base="${key_name_base}${i}"
-    if [ -f "${key_base}.keyb" ]; then
-      key_index=$((${key_index} + 1))
-      continue
-    fi
-
-    # Extract exponent from key_length name, if necessary
-    exp="F4"
-    bits=$i
-    if [ "${i##*_exp}" != "${i}" ]; then
-        exp="${i##*_exp}"
-        bits="${i%%_exp${exp}}"
-    fi
-
-    openssl genrsa -${exp} -out ${key_base}.pem ${bits}
-    # Generate self-signed certificate from key.
-    openssl req -batch -new -x509 -key ${key_base}.pem \
-      -out ${key_base}.crt
-
-    # Generate pre-processed key for use by RSA signature verification code.
-    ${BIN_DIR}/dumpRSAPublicKey -cert ${key_base}.crt \
-      > ${key_base}.keyb
-
-    alg_index=0
-    for sha_type in ${sha_types[@]}
-    do
-      alg=$((${key_index} * 3 + ${alg_index}))
-  # wrap the public key
-      ${FUTILITY} vbutil_key \
-        --pack "${key_base}.sha${sha_type}.vbpubk" \
-        --key "${key_base}.keyb" \
-        --version 1 \
-        --algorithm ${alg}
-
-  # wrap the private key
-      ${FUTILITY} vbutil_key \
-        --pack "${key_base}.sha${sha_type}.vbprivk" \
-        --key "${key_base}.pem" \
-        --algorithm ${alg}
-      alg_index=$((${alg_index} + 1))
-    done
+    generate_key ${i} ${key_index} &
+    pids+=($!)
     key_index=$((${key_index} + 1))
   done
+
+  for pid in ${pids[@]}
+  do
+    wait ${pid} || failed=1
+  done
+  [ ${failed} -eq 0 ] || error "Failed to generate test keys"
 }
 
 mkdir -p ${TESTKEY_DIR}
@@ -0,0 +1,336 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for cgptlib on partition tables of different sizes.
+ *
+ * GPTs are built in memory with 128 up to MAX_LARGE_NUMBER_OF_ENTRIES
+ * entries, with one, half or all of the entries in use as kernels.  Each is
+ * run through GptInit(), GptSanityCheck(), CheckEntries(), a walk of every
+ * kernel with GptNextKernelEntry(), and GptRepair() of the secondary, and the
+ * time per call is printed as JSON on stdout.  Time that grows faster than
+ * the number of entries is a regression to look into; firmware only sees 128
+ * entries, but cgpt handles large tables with the same code.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "gpt_misc.h"
+#include "timer_utils.h"
+
+/* Default number of timed samples per operation */
+#define DEFAULT_REPEATS 100
+
+/* Untimed runs before each operation */
+#define WARMUP 3
+
+/* Each sample repeats the operation until it takes at least this long */
+#define MIN_SAMPLE_TICKS 100000
+
+#define SECTOR_BYTES 512
+
+static const struct option long_opts[] = {
+	{"repeats", 1, NULL, 'n'},
+	{"cpu",     1, NULL, 'c'},
+	{"help",    0, NULL, 'h'},
+	{NULL,      0, NULL, 0},
+};
+
+/* Set by -n */
+static int repeats = DEFAULT_REPEATS;
+
+/* Separator before the next JSON result */
+static const char *result_sep = "";
+
+/* Table sizes to run, in entries */
+static const uint32_t table_sizes[] = {
+	MAX_NUMBER_OF_ENTRIES, 256, 512, 1024, 2048,
+	MAX_LARGE_NUMBER_OF_ENTRIES,
+};
+
+/* How many of the entries are used */
+enum population {
+	POP_ONE,
+	POP_HALF,
+	POP_FULL,
+};
+
+static const char * const population_names[] = {
+	"one", "half", "full",
+};
+
+/* Kernel type, for every used entry */
+static const Guid guid_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+
+/* Headers of the table being run; its entries are allocated to fit */
+static uint8_t primary_header[SECTOR_BYTES];
+static uint8_t secondary_header[SECTOR_BYTES];
+
+/* One operation on the table: returns its result */
+typedef int (*op_fn)(GptData *gpt);
+
+static int op_init(GptData *gpt)
+{
+	return GptInit(gpt);
+}
+
+static int op_sanity_check(GptData *gpt)
+{
+	return GptSanityCheck(gpt);
+}
+
+static int op_check_entries(GptData *gpt)
+{
+	return CheckEntries((GptEntry *)gpt->primary_entries,
+			    (GptHeader *)gpt->primary_header);
+}
+
+/* Returns every kernel in turn, as the firmware does until one boots */
+static int op_next_kernel(GptData *gpt)
+{
+	uint64_t start, size;
+	int count = 0;
+
+	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	gpt->current_priority = 999;
+	gpt->kernel_candidates_built = 0;
+	while (GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size))
+		count++;
+	return count;
+}
+
+/* Rewrites the secondary from the primary, as after it was found bad */
+static int op_repair(GptData *gpt)
+{
+	gpt->valid_headers = MASK_PRIMARY;
+	gpt->valid_entries = MASK_PRIMARY;
+	GptRepair(gpt);
+	return gpt->modified;
+}
+
+static const struct {
+	const char *name;
+	op_fn fn;
+} ops[] = {
+	{"GptInit", op_init},
+	{"GptSanityCheck", op_sanity_check},
+	{"CheckEntries", op_check_entries},
+	{"GptNextKernelEntry", op_next_kernel},
+	{"GptRepair", op_repair},
+};
+
+/*
+ * Fills in gpt with a valid table of num_entries entries, allocating its
+ * entry arrays.  Used entries are one-sector kernels with different GUIDs
+ * and priorities.  Returns 0 if success, non-zero if out of memory.
+ */
+static int build_gpt(GptData *gpt, uint32_t num_entries, enum population pop)
+{
+	uint32_t entries_bytes = num_entries * sizeof(GptEntry);
+	uint32_t entries_sectors = entries_bytes / SECTOR_BYTES;
+	uint64_t drive_sectors = 2 * (2 + entries_sectors) + num_entries;
+	GptHeader *h1 = (GptHeader *)primary_header;
+	GptHeader *h2 = (GptHeader *)secondary_header;
+	GptEntry *e;
+	uint32_t i;
+
+	memset(gpt, 0, sizeof(*gpt));
+	memset(primary_header, 0, sizeof(primary_header));
+	memset(secondary_header, 0, sizeof(secondary_header));
+	gpt->primary_header = primary_header;
+	gpt->secondary_header = secondary_header;
+	gpt->primary_entries = calloc(1, entries_bytes);
+	gpt->secondary_entries = calloc(1, entries_bytes);
+	if (!gpt->primary_entries || !gpt->secondary_entries)
+		return 1;
+	gpt->sector_bytes = SECTOR_BYTES;
+	gpt->streaming_drive_sectors = gpt->gpt_drive_sectors = drive_sectors;
+	gpt->flags = GPT_FLAG_LARGE_TABLE;
+
+	memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h1->revision = GPT_HEADER_REVISION;
+	h1->size = sizeof(GptHeader);
+	h1->my_lba = 1;
+	h1->alternate_lba = drive_sectors - 1;
+	h1->entries_lba = 2;
+	h1->first_usable_lba = 2 + entries_sectors;
+	h1->last_usable_lba = drive_sectors - 2 - entries_sectors;
+	h1->number_of_entries = num_entries;
+	h1->size_of_entry = sizeof(GptEntry);
+
+	e = (GptEntry *)gpt->primary_entries;
+	for (i = 0; i < num_entries; i++) {
+		if ((pop == POP_ONE && i) || (pop == POP_HALF && (i & 1)))
+			continue;
+		memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+		/* Spread the GUIDs, so sorting them isn't trivial */
+		e[i].unique.u.Uuid.time_low = i * 0x9e3779b9;
+		e[i].unique.u.Uuid.time_mid = i;
+		e[i].starting_lba = e[i].ending_lba = h1->first_usable_lba + i;
+		SetEntryPriority(e + i, i % 15 + 1);
+		SetEntryTries(e + i, 1);
+	}
+	h1->entries_crc32 = Crc32(gpt->primary_entries, entries_bytes);
+	h1->header_crc32 = HeaderCrc(h1);
+
+	memcpy(h2, h1, sizeof(GptHeader));
+	memcpy(gpt->secondary_entries, gpt->primary_entries, entries_bytes);
+	h2->my_lba = drive_sectors - 1;
+	h2->alternate_lba = 1;
+	h2->entries_lba = drive_sectors - 1 - entries_sectors;
+	h2->header_crc32 = HeaderCrc(h2);
+
+	return 0;
+}
+
+/* Times batch runs of an operation */
+static uint64_t time_op(op_fn fn, GptData *gpt, int batch)
+{
+	uint64_t start = ReadCycleCounter();
+	int j;
+
+	for (j = 0; j < batch; j++)
+		fn(gpt);
+	return ReadCycleCounter() - start;
+}
+
+/*
+ * Times one operation on one table and prints a JSON result for it.
+ *
+ * Returns 0 if success, non-zero if out of memory.
+ */
+static int run_op(int op, GptData *gpt, uint32_t num_entries,
+		  enum population pop)
+{
+	uint64_t *samples;
+	TimerStatsState stats;
+	uint64_t run = 0;
+	uint32_t batch = 1;
+	int rv, i;
+
+	samples = malloc(repeats * sizeof(*samples));
+	if (!samples)
+		return 1;
+
+	rv = ops[op].fn(gpt);
+
+	/* Repeat cheap operations enough to be measured */
+	for (i = 0; i < WARMUP; i++)
+		run = time_op(ops[op].fn, gpt, 1);
+	if (run < MIN_SAMPLE_TICKS)
+		batch = MIN_SAMPLE_TICKS / (run + 1) + 1;
+
+	for (i = 0; i < repeats; i++)
+		samples[i] = time_op(ops[op].fn, gpt, batch);
+
+	GetTimerStats(samples, repeats, &stats);
+
+	printf("%s    {\"name\": \"%s\", \"entries\": %u, \"used\": \"%s\", "
+	       "\"result\": %d, \"repeats\": %d, \"min_per_call\": %llu, "
+	       "\"median_per_call\": %llu, \"p99_per_call\": %llu}",
+	       result_sep, ops[op].name, num_entries, population_names[pop],
+	       rv, repeats,
+	       (unsigned long long)(stats.min / batch),
+	       (unsigned long long)(stats.median / batch),
+	       (unsigned long long)(stats.p99 / batch));
+	fflush(stdout);
+	result_sep = ",\n";
+
+	free(samples);
+	return 0;
+}
+
+/* Runs every operation on one table.  Returns the number of errors. */
+static int run_table(uint32_t num_entries, enum population pop)
+{
+	GptData gpt;
+	int errorcnt = 0;
+	int i;
+
+	if (build_gpt(&gpt, num_entries, pop)) {
+		fprintf(stderr, "Can't allocate %u entries\n", num_entries);
+		errorcnt++;
+		goto done;
+	}
+	if (GPT_SUCCESS != GptInit(&gpt)) {
+		fprintf(stderr, "Table of %u entries is invalid\n",
+			num_entries);
+		errorcnt++;
+		goto done;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ops); i++)
+		errorcnt += run_op(i, &gpt, num_entries, pop);
+
+ done:
+	free(gpt.primary_entries);
+	free(gpt.secondary_entries);
+	return errorcnt;
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [-n NUM] [-c CPU]\n"
+		"\n"
+		"  -n|--repeats  NUM    Timed samples per operation "
+		"(default %d)\n"
+		"  -c|--cpu      CPU    Only run on this CPU\n",
+		progname, DEFAULT_REPEATS);
+}
+
+int main(int argc, char *argv[])
+{
+	char *e;
+	int errorcnt = 0;
+	int i, pop;
+
+	while ((i = getopt_long(argc, argv, "n:c:h", long_opts, NULL)) != -1) {
+		switch (i) {
+		case 'n':
+			repeats = strtol(optarg, &e, 0);
+			if (!*optarg || *e || repeats < 1) {
+				fprintf(stderr, "Invalid --repeats\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			i = strtol(optarg, &e, 0);
+			if (!*optarg || *e || PinToCpu(i)) {
+				fprintf(stderr, "Can't run on CPU %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	printf("{\n  \"unit\": \"%s\",\n  \"results\": [\n",
+	       CYCLE_COUNTER_UNIT);
+
+	for (i = 0; i < ARRAY_SIZE(table_sizes); i++) {
+		for (pop = POP_ONE; pop <= POP_FULL; pop++)
+			errorcnt += run_table(table_sizes[i], pop);
+	}
+
+	printf("\n  ]\n}\n");
+
+	return errorcnt ? 1 : 0;
+}
@@ -73,6 +73,42 @@ static void test_hmac_error(void)
 		  "Invalid algorithm");
 }
 
+static void test_hmac_context(void)
+{
+	struct vb2_hmac_context hc;
+	uint8_t mac[VB2_MAX_DIGEST_SIZE];
+	uint8_t md[VB2_MAX_DIGEST_SIZE];
+	int alg;
+
+	for (alg = 1; alg < VB2_HASH_ALG_COUNT; alg++) {
+		/* One key schedule gives the same MACs as separate calls */
+		TEST_SUCC(vb2_hmac_init(&hc, alg, long_key, strlen(long_key)),
+			  "vb2_hmac_init()");
+		TEST_SUCC(vb2_hmac_calculate(&hc, message, strlen(message),
+					     mac, sizeof(mac)),
+			  "vb2_hmac_calculate()");
+		hmac(alg, long_key, strlen(long_key), message, strlen(message),
+		     md, sizeof(md));
+		TEST_SUCC(memcmp(mac, md, vb2_digest_size(alg)),
+			  "  matches hmac()");
+
+		TEST_SUCC(vb2_hmac_calculate(&hc, short_key, strlen(short_key),
+					     mac, sizeof(mac)),
+			  "vb2_hmac_calculate() reused");
+		hmac(alg, long_key, strlen(long_key), short_key,
+		     strlen(short_key), md, sizeof(md));
+		TEST_SUCC(memcmp(mac, md, vb2_digest_size(alg)),
+			  "  matches hmac()");
+	}
+
+	TEST_TRUE(vb2_hmac_init(&hc, -1, short_key, strlen(short_key)),
+		  "Invalid algorithm");
+	vb2_hmac_init(&hc, VB2_HASH_SHA256, short_key, strlen(short_key));
+	TEST_TRUE(vb2_hmac_calculate(&hc, message, strlen(message),
+				     mac, VB2_SHA256_DIGEST_SIZE - 1),
+		  "Buffer too small");
+}
+
 static void test_hmac(void)
 {
 	int alg;
@@ -92,6 +128,7 @@ static void test_hmac(void)
 int main(void)
 {
 	test_hmac();
+	test_hmac_context();
 	test_hmac_error();
 
 	return gTestSuccess ? 0 : 255;
@@ -73,3 +73,73 @@ ${BUILD_RUN}/tests/verify_kernel disk.test \
     ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
 
 happy 'Image verification succeeded'
+
+# And record the reads LoadKernel() makes from it
+echo 'Loading kernel from test disk image'
+${BUILD_RUN}/utility/load_kernel_test -b 0 -p usb2 disk.test \
+    ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > load_kernel.out
+grep -q '^Reads: [1-9]' load_kernel.out
+grep -q '^Projected usb2 ' load_kernel.out
+
+happy 'Disk image load succeeded'
+
+# Now re-sign the kernel with its body hashed in chunks, and load that
+echo 'Loading chunked kernel from test disk image'
+${FUTILITY} sign \
+    --signprivate ${TESTKEY_DIR}/key_rsa2048.sha256.vbprivk \
+    --chunk_size 0x1000 \
+    kernel.test kernel_chunked.test
+${FUTILITY} show kernel_chunked.test | grep -q 'Body chunk size: *0x1000'
+${FUTILITY} vbutil_kernel \
+    --verify "kernel_chunked.test" \
+    --signpubkey ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+dd if=kernel_chunked.test of=disk.test bs=512 seek=64 conv=notrunc
+${BUILD_RUN}/tests/verify_kernel disk.test \
+    ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+${BUILD_RUN}/utility/load_kernel_test -b 0 disk.test \
+    ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+
+# A corrupt chunk must be caught
+printf '\xff' | dd of=disk.test bs=1 seek=$(( 64 * 512 + 0x10000 + 0x5000 )) \
+    conv=notrunc
+if ${BUILD_RUN}/tests/verify_kernel disk.test \
+    ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk; then
+  error 'Corrupt chunked kernel verified'
+fi
+
+happy 'Chunked kernel load succeeded'
+
+# Now re-sign the kernel with its body compressed, and load that
+echo 'Loading compressed kernel from test disk image'
+for chunk_size in 0 0x1000; do
+  ${FUTILITY} sign \
+      --signprivate ${TESTKEY_DIR}/key_rsa2048.sha256.vbprivk \
+      --chunk_size ${chunk_size} --compress lz4 \
+      kernel.test kernel_compressed.test
+  ${FUTILITY} show kernel_compressed.test | grep -q 'Body compression: *lz4'
+  ${FUTILITY} show kernel_compressed.test | grep -q 'hi there'
+  ${FUTILITY} vbutil_kernel \
+      --verify "kernel_compressed.test" \
+      --signpubkey ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk |
+    grep -q 'hi there'
+  [ $(stat -c %s kernel_compressed.test) -lt $(stat -c %s kernel.test) ] ||
+    error 'Compressed kernel is not smaller'
+  dd if=kernel_compressed.test of=disk.test bs=512 seek=64 conv=notrunc
+  ${BUILD_RUN}/tests/verify_kernel disk.test \
+      ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+  ${BUILD_RUN}/utility/load_kernel_test -b 0 disk.test \
+      ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+done
+
+# Re-signing keeps the compression, and can take it off again
+${FUTILITY} sign \
+    --signprivate ${TESTKEY_DIR}/key_rsa2048.sha256.vbprivk \
+    kernel_compressed.test kernel_resigned.test
+${FUTILITY} show kernel_resigned.test | grep -q 'Body compression: *lz4'
+${FUTILITY} sign \
+    --signprivate ${TESTKEY_DIR}/key_rsa2048.sha256.vbprivk \
+    --chunk_size 0 --compress none \
+    kernel_compressed.test kernel_decompressed.test
+cmp kernel.test kernel_decompressed.test
+
+happy 'Compressed kernel load succeeded'
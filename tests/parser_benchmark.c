@@ -0,0 +1,542 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for the firmware parsers of keyblocks, preambles and headers.
+ *
+ * A corpus of valid and malformed inputs is built from a test key, and any
+ * files given on the command line (for example the fuzz test cases from
+ * gen_fuzz_test_cases.sh) are added to it.  Each input is replayed through
+ * vb2_verify_keyblock(), vb2_verify_kernel_preamble(),
+ * vb21_verify_common_header() and bdb_check_header(), and the time per input
+ * is printed as JSON on stdout.  The rejection path bounds how long a bad
+ * kernel partition can hold up boot, so regressions there matter as much as
+ * on the valid path.
+ *
+ * The verify functions may destroy the signature in the input, so a fresh
+ * copy is passed each time; the time taken by the copy alone is measured and
+ * subtracted.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "bdb.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_keyblock.h"
+#include "host_misc.h"
+#include "host_signature.h"
+#include "timer_utils.h"
+#include "vb21_common.h"
+#include "vb2_common.h"
+
+/* Key which signs the generated keyblock and preamble */
+#define BENCH_ALG VB2_ALG_RSA4096_SHA256
+
+/* Default number of timed samples per input */
+#define DEFAULT_REPEATS 100
+
+/* Untimed runs before each input */
+#define WARMUP 3
+
+/* Each sample repeats the parser until it takes at least this long */
+#define MIN_SAMPLE_TICKS 100000
+
+/* Largest corpus file to read */
+#define MAX_FILE_SIZE (1024 * 1024)
+
+static const struct option long_opts[] = {
+	{"repeats", 1, NULL, 'n'},
+	{"cpu",     1, NULL, 'c'},
+	{"help",    0, NULL, 'h'},
+	{NULL,      0, NULL, 0},
+};
+
+/* Set by -n */
+static int repeats = DEFAULT_REPEATS;
+
+/* Separator before the next JSON result */
+static const char *result_sep = "";
+
+/* Key the keyblock and preamble are verified with */
+static struct vb2_public_key key;
+
+/* Scratch copy of the input, since verifying may change it */
+static uint8_t *scratch;
+
+/* One parser: returns its result for buf, which it may change. */
+typedef int (*parse_fn)(uint8_t *buf, uint32_t size);
+
+static int parse_keyblock(uint8_t *buf, uint32_t size)
+{
+	uint8_t workbuf[VB2_KEY_BLOCK_VERIFY_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	return vb2_verify_keyblock((struct vb2_keyblock *)buf, size, &key,
+				   &wb);
+}
+
+static int parse_kernel_preamble(uint8_t *buf, uint32_t size)
+{
+	uint8_t workbuf[VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	return vb2_verify_kernel_preamble((struct vb2_kernel_preamble *)buf,
+					  size, &key, &wb);
+}
+
+static int parse_vb21_header(uint8_t *buf, uint32_t size)
+{
+	/* The header check reads the fixed fields without checking size */
+	if (size < sizeof(struct vb21_struct_common))
+		return VB2_ERROR_COMMON_TOTAL_SIZE;
+	return vb21_verify_common_header(buf, size);
+}
+
+static int parse_bdb_header(uint8_t *buf, uint32_t size)
+{
+	return bdb_check_header((const struct bdb_header *)buf, size);
+}
+
+static const struct {
+	const char *name;
+	parse_fn fn;
+} parsers[] = {
+	{"keyblock", parse_keyblock},
+	{"kernel_preamble", parse_kernel_preamble},
+	{"vb21_header", parse_vb21_header},
+	{"bdb_header", parse_bdb_header},
+};
+
+/* Times batch copies of the input into scratch, without parsing it */
+static uint64_t time_copies(const uint8_t *buf, uint32_t size, int batch)
+{
+	uint64_t start = ReadCycleCounter();
+	int j;
+
+	for (j = 0; j < batch; j++) {
+		memcpy(scratch, buf, size);
+		/* Keep the copies from being merged or dropped */
+		__asm__ __volatile__("" : : "r" (scratch) : "memory");
+	}
+	return ReadCycleCounter() - start;
+}
+
+/* Times batch copies of the input, each followed by parsing it */
+static uint64_t time_parses(parse_fn fn, const uint8_t *buf, uint32_t size,
+			    int batch)
+{
+	uint64_t start = ReadCycleCounter();
+	int j;
+
+	for (j = 0; j < batch; j++) {
+		memcpy(scratch, buf, size);
+		fn(scratch, size);
+	}
+	return ReadCycleCounter() - start;
+}
+
+/* Time to parse one input, from the time for a sample of batch copies */
+static uint64_t per_input(uint64_t sample, const TimerStatsState *copy_stats,
+			  uint32_t batch)
+{
+	if (sample <= copy_stats->median)
+		return 0;
+	return (sample - copy_stats->median) / batch;
+}
+
+/*
+ * Times one parser on one input and prints a JSON result for it.
+ *
+ * If expect is 0 or 1, the parser must reject or accept the input; -1 means
+ * either is fine, as for corpus files.
+ *
+ * Returns 0 if success, non-zero if the parser gave the wrong answer.
+ */
+static int run_input(int parser, const char *input, const uint8_t *buf,
+		     uint32_t size, int expect)
+{
+	uint64_t *samples, *copies;
+	TimerStatsState stats, copy_stats;
+	uint64_t parse = 0;
+	uint32_t batch = 1;
+	int rv, i;
+
+	memcpy(scratch, buf, size);
+	rv = parsers[parser].fn(scratch, size);
+	if (expect >= 0 && (rv == VB2_SUCCESS) != expect) {
+		fprintf(stderr, "%s %s: expected %s, got 0x%x\n",
+			parsers[parser].name, input,
+			expect ? "success" : "failure", rv);
+		return 1;
+	}
+
+	samples = malloc(repeats * sizeof(*samples));
+	copies = malloc(repeats * sizeof(*copies));
+	if (!samples || !copies) {
+		free(samples);
+		free(copies);
+		return 1;
+	}
+
+	/* Repeat cheap rejections enough to be measured */
+	for (i = 0; i < WARMUP; i++)
+		parse = time_parses(parsers[parser].fn, buf, size, 1);
+	if (parse < MIN_SAMPLE_TICKS)
+		batch = MIN_SAMPLE_TICKS / (parse + 1) + 1;
+
+	for (i = 0; i < repeats; i++) {
+		samples[i] = time_parses(parsers[parser].fn, buf, size, batch);
+		copies[i] = time_copies(buf, size, batch);
+	}
+
+	GetTimerStats(samples, repeats, &stats);
+	GetTimerStats(copies, repeats, &copy_stats);
+
+	printf("%s    {\"name\": \"%s\", \"input\": \"%s\", \"size\": %u, "
+	       "\"result\": %d, \"repeats\": %d, \"min_per_input\": %llu, "
+	       "\"median_per_input\": %llu, \"p99_per_input\": %llu}",
+	       result_sep, parsers[parser].name, input, size, rv, repeats,
+	       (unsigned long long)per_input(stats.min, &copy_stats, batch),
+	       (unsigned long long)per_input(stats.median, &copy_stats, batch),
+	       (unsigned long long)per_input(stats.p99, &copy_stats, batch));
+	fflush(stdout);
+	result_sep = ",\n";
+
+	free(samples);
+	free(copies);
+	return 0;
+}
+
+/*
+ * Turns buf, a copy of a valid input, into malformed variant n of it.  The
+ * size may be made smaller.
+ */
+typedef void (*break_fn)(void *buf, uint32_t *size, int n);
+
+/* Malformed variants of a keyblock */
+static void break_keyblock(void *buf, uint32_t *size, int n)
+{
+	struct vb2_keyblock *kb = buf;
+
+	switch (n) {
+	case 0:
+		*size = sizeof(*kb) - 1;
+		break;
+	case 1:
+		kb->magic[0] ^= 1;
+		break;
+	case 2:
+		kb->header_version_major++;
+		break;
+	case 3:
+		kb->keyblock_size = *size + 1;
+		break;
+	case 4:
+		kb->keyblock_signature.sig_offset = *size;
+		break;
+	case 5:
+		vb2_signature_data(&kb->keyblock_signature)[0] ^= 1;
+		break;
+	case 6:
+		kb->data_key.key_offset = *size;
+		break;
+	}
+}
+
+static const char * const keyblock_breaks[] = {
+	"truncated", "bad_magic", "bad_version", "size_too_big",
+	"sig_outside", "bad_sig", "data_key_outside",
+};
+
+/* Malformed variants of a kernel preamble */
+static void break_preamble(void *buf, uint32_t *size, int n)
+{
+	struct vb2_kernel_preamble *pre = buf;
+
+	switch (n) {
+	case 0:
+		*size = sizeof(*pre) - 1;
+		break;
+	case 1:
+		pre->header_version_major++;
+		break;
+	case 2:
+		pre->preamble_size = *size + 1;
+		break;
+	case 3:
+		pre->preamble_signature.sig_offset = *size;
+		break;
+	case 4:
+		vb2_signature_data(&pre->preamble_signature)[0] ^= 1;
+		break;
+	case 5:
+		pre->body_signature.sig_offset = *size;
+		break;
+	}
+}
+
+static const char * const preamble_breaks[] = {
+	"truncated", "bad_version", "size_too_big", "sig_outside", "bad_sig",
+	"body_sig_changed",
+};
+
+/* Malformed variants of a vb21 struct with a description */
+static void break_vb21(void *buf, uint32_t *size, int n)
+{
+	struct vb21_struct_common *c = buf;
+
+	switch (n) {
+	case 0:
+		c->total_size = *size + 4;
+		break;
+	case 1:
+		c->fixed_size = 4;
+		break;
+	case 2:
+		c->total_size = *size - 1;
+		break;
+	case 3:
+		c->desc_size = 0xfffffffc;
+		break;
+	case 4:
+		((uint8_t *)buf)[c->fixed_size + c->desc_size - 1] = 'x';
+		break;
+	}
+}
+
+static const char * const vb21_breaks[] = {
+	"size_too_big", "fixed_too_small", "unaligned", "desc_wraps",
+	"desc_unterminated",
+};
+
+/* Malformed variants of a BDB header */
+static void break_bdb(void *buf, uint32_t *size, int n)
+{
+	struct bdb_header *h = buf;
+
+	switch (n) {
+	case 0:
+		*size = sizeof(*h) - 1;
+		break;
+	case 1:
+		h->struct_magic ^= 1;
+		break;
+	case 2:
+		h->struct_major_version++;
+		break;
+	case 3:
+		h->oem_area_0_size = 2;
+		break;
+	case 4:
+		h->bdb_size = 4;
+		break;
+	}
+}
+
+static const char * const bdb_breaks[] = {
+	"truncated", "bad_magic", "bad_version", "oem_unaligned",
+	"bdb_too_small",
+};
+
+/* Runs a parser on a valid input and on each malformed variant of it */
+static int run_variants(int parser, const uint8_t *valid, uint32_t size,
+			break_fn breaker,
+			const char * const *names, int count)
+{
+	uint8_t *buf = malloc(size);
+	uint32_t broken_size;
+	int errorcnt = 0;
+	int i;
+
+	if (!buf)
+		return 1;
+
+	errorcnt += run_input(parser, "valid", valid, size, 1);
+	for (i = 0; i < count; i++) {
+		memcpy(buf, valid, size);
+		broken_size = size;
+		breaker(buf, &broken_size, i);
+		errorcnt += run_input(parser, names[i], buf, broken_size, 0);
+	}
+
+	free(buf);
+	return errorcnt;
+}
+
+/* Builds the valid inputs and runs them and their malformed variants. */
+static int run_generated(const char *keys_dir)
+{
+	struct vb2_private_key *private_key = NULL;
+	struct vb2_packed_key *packed_key = NULL;
+	struct vb2_keyblock *kb = NULL;
+	struct vb2_signature *body_sig = NULL;
+	struct vb2_kernel_preamble *pre = NULL;
+	static const char desc[] = "parser benchmark";
+	struct {
+		struct vb21_struct_common c;
+		char desc[(sizeof(desc) + 3) & ~3];
+	} vb21;
+	struct bdb_header bdb;
+	char filename[1024];
+	int errorcnt = 0;
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.pem", keys_dir,
+		 vb2_get_crypto_algorithm_file(BENCH_ALG));
+	private_key = vb2_read_private_key_pem(filename, BENCH_ALG);
+	snprintf(filename, sizeof(filename), "%s/key_%s.keyb", keys_dir,
+		 vb2_get_crypto_algorithm_file(BENCH_ALG));
+	packed_key = vb2_read_packed_keyb(filename, BENCH_ALG, 1);
+	if (private_key && packed_key) {
+		kb = vb2_create_keyblock(packed_key, private_key, 0x0f);
+		body_sig = vb2_alloc_signature(
+			vb2_rsa_sig_size(vb2_crypto_to_signature(BENCH_ALG)),
+			0x214000);
+	}
+	if (body_sig)
+		pre = vb2_create_kernel_preamble(
+			1, 0x100000, 0x300000, 0x4000, body_sig, 0x304000,
+			0x10000, 0, 0, private_key);
+	if (!pre || vb2_unpack_key(&key, packed_key)) {
+		fprintf(stderr, "Can't set up %s with keys in %s\n",
+			vb2_get_crypto_algorithm_name(BENCH_ALG), keys_dir);
+		errorcnt++;
+		goto done;
+	}
+
+	errorcnt += run_variants(0, (uint8_t *)kb, kb->keyblock_size,
+				 break_keyblock, keyblock_breaks,
+				 ARRAY_SIZE(keyblock_breaks));
+	errorcnt += run_variants(1, (uint8_t *)pre, pre->preamble_size,
+				 break_preamble, preamble_breaks,
+				 ARRAY_SIZE(preamble_breaks));
+
+	memset(&vb21, 0, sizeof(vb21));
+	vb21.c.magic = VB21_MAGIC_PACKED_KEY;
+	vb21.c.struct_version_major = VB21_PACKED_KEY_VERSION_MAJOR;
+	vb21.c.fixed_size = sizeof(vb21.c);
+	vb21.c.desc_size = sizeof(vb21.desc);
+	vb21.c.total_size = sizeof(vb21);
+	strcpy(vb21.desc, desc);
+	errorcnt += run_variants(2, (uint8_t *)&vb21, sizeof(vb21),
+				 break_vb21, vb21_breaks,
+				 ARRAY_SIZE(vb21_breaks));
+
+	memset(&bdb, 0, sizeof(bdb));
+	bdb.struct_magic = BDB_HEADER_MAGIC;
+	bdb.struct_major_version = BDB_HEADER_VERSION_MAJOR;
+	bdb.struct_minor_version = BDB_HEADER_VERSION_MINOR;
+	bdb.struct_size = sizeof(bdb);
+	bdb.bdb_size = 4096;
+	errorcnt += run_variants(3, (uint8_t *)&bdb, sizeof(bdb),
+				 break_bdb, bdb_breaks,
+				 ARRAY_SIZE(bdb_breaks));
+
+ done:
+	free(pre);
+	free(body_sig);
+	free(kb);
+	free(packed_key);
+	free(private_key);
+	return errorcnt;
+}
+
+/* Runs every parser on a corpus file, whatever it holds. */
+static int run_file(const char *filename)
+{
+	uint8_t *buf;
+	uint32_t size;
+	int errorcnt = 0;
+	int i;
+
+	if (vb2_read_file(filename, &buf, &size)) {
+		fprintf(stderr, "Can't read %s\n", filename);
+		return 1;
+	}
+	if (size > MAX_FILE_SIZE) {
+		fprintf(stderr, "%s is too big\n", filename);
+		free(buf);
+		return 1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(parsers); i++)
+		errorcnt += run_input(i, filename, buf, size, -1);
+
+	free(buf);
+	return errorcnt;
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [-n NUM] [-c CPU] KEYS_DIR [FILE...]\n"
+		"\n"
+		"  -n|--repeats  NUM    Timed samples per input (default %d)\n"
+		"  -c|--cpu      CPU    Only run on this CPU\n"
+		"\n"
+		"Each FILE is also run through every parser.\n",
+		progname, DEFAULT_REPEATS);
+}
+
+int main(int argc, char *argv[])
+{
+	char *e;
+	int errorcnt = 0;
+	int i;
+
+	while ((i = getopt_long(argc, argv, "n:c:h", long_opts, NULL)) != -1) {
+		switch (i) {
+		case 'n':
+			repeats = strtol(optarg, &e, 0);
+			if (!*optarg || *e || repeats < 1) {
+				fprintf(stderr, "Invalid --repeats\n");
+				return 1;
+			}
+			break;
+		case 'c':
+			i = strtol(optarg, &e, 0);
+			if (!*optarg || *e || PinToCpu(i)) {
+				fprintf(stderr, "Can't run on CPU %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	scratch = malloc(MAX_FILE_SIZE);
+	if (!scratch) {
+		fprintf(stderr, "Can't allocate %u bytes\n", MAX_FILE_SIZE);
+		return 1;
+	}
+
+	printf("{\n  \"unit\": \"%s\",\n  \"results\": [\n",
+	       CYCLE_COUNTER_UNIT);
+
+	errorcnt += run_generated(argv[optind]);
+	for (i = optind + 1; i < argc; i++)
+		errorcnt += run_file(argv[i]);
+
+	printf("\n  ]\n}\n");
+
+	free(scratch);
+	return errorcnt ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+#!/bin/bash
+
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Count the instructions the firmware verification path takes on each
+# firmware architecture, without the hardware.
+#
+# For each architecture, the firmware library is built with FIRMWARE_ARCH set
+# and linked into fw_verify_benchmark, which is run under QEMU user mode with
+# the instruction counting plugin.  Runs with and without the verification
+# are compared, so the counts don't include loading the test files.  Results
+# are printed as JSON, along with the code size of the firmware library.
+#
+# Usage:
+#    qemu_benchmark.sh [ARCH...]    (default: arm x86 mips)
+#
+# Optional environment variables, where ARCH is one of the above:
+#    CC_ARCH - cross compiler (default: a Debian-style cross gcc)
+#    CFLAGS_ARCH - flags for the firmware library
+#    QEMU_ARCH - QEMU user mode binary
+#    QEMU_PLUGIN - path to QEMU's libinsn.so plugin
+#    RUNS - verifications to count (default 10)
+#
+# Architectures without a compiler or QEMU are skipped.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+RUNS=${RUNS:-10}
+DIR="${TEST_DIR}/qemu_benchmark_dir"
+
+# Print the default $1 for architecture $2
+arch_default() {
+  case "$1-$2" in
+    cc-arm) echo arm-linux-gnueabihf-gcc ;;
+    cc-x86) echo i686-linux-gnu-gcc ;;
+    cc-x86_64) echo x86_64-linux-gnu-gcc ;;
+    cc-mips) echo mipsel-linux-gnu-gcc ;;
+    qemu-arm) echo qemu-arm ;;
+    qemu-x86) echo qemu-i386 ;;
+    qemu-x86_64) echo qemu-x86_64 ;;
+    qemu-mips) echo qemu-mipsel ;;
+    # Firmware flags from the Makefile, but using the compiler's own headers
+    cflags-arm) echo -Os -fno-common -ffixed-r8 -marm ;;
+    cflags-x86) echo -Os -ffunction-sections -fomit-frame-pointer ;;
+    cflags-x86_64) echo -Os -fvisibility=hidden -fomit-frame-pointer ;;
+    cflags-mips) echo -Os -fno-common ;;
+  esac
+}
+
+# Print the value of variable $1_$2 in upper case, or its default
+arch_setting() {
+  local var="$(echo "$1_$2" | tr a-z A-Z)"
+
+  if [ -n "${!var}" ]; then
+    echo "${!var}"
+  else
+    arch_default "$1" "$2"
+  fi
+}
+
+# Find the instruction counting plugin
+find_plugin() {
+  local p
+
+  for p in "${QEMU_PLUGIN}" /usr/lib/qemu/plugins/libinsn.so \
+      /usr/lib/*/qemu/plugins/libinsn.so /usr/local/lib/qemu/libinsn.so; do
+    [ -f "${p}" ] && echo "${p}" && return
+  done
+}
+
+# Print the instructions QEMU $1 counts running the rest of the arguments
+count_insns() {
+  local qemu="$1"
+  local log="${DIR}/insns.log"
+  local count
+  shift
+
+  rm -f "${log}"
+  "${qemu}" -plugin "${PLUGIN}" -d plugin -D "${log}" "$@" >/dev/null
+  count=$(sed -n 's/.*insns: *\([0-9][0-9]*\).*/\1/p' "${log}" | tail -1)
+  [ -n "${count}" ] || error "No instruction count from ${qemu} $*"
+  echo "${count}"
+}
+
+# Count one operation $1 for ${arch}, with fw_verify_benchmark arguments $2...
+run_op() {
+  local name="$1"
+  local runs none
+  shift
+
+  runs=$(count_insns "${qemu}" "${bench}" ${RUNS} "$@")
+  none=$(count_insns "${qemu}" "${bench}" 0 "$@")
+  printf '%b    {"arch": "%s", "name": "%s", "repeats": %d, ' \
+    "${SEP}" "${arch}" "${name}" ${RUNS}
+  printf '"insns_per_op": %d, "fwlib_text": %d}' \
+    $(( (runs - none) / RUNS )) ${text}
+  SEP=",\\n"
+}
+
+# Create the firmware and kernel to verify, as vb2_firmware_tests.sh does
+make_inputs() {
+  echo 'This is a test firmware body.  This is only a test.  Lalalalala' \
+    > body.test
+  ${FUTILITY} vbutil_key --pack rootkey.test \
+    --key ${TESTKEY_DIR}/key_rsa8192.keyb --algorithm 11
+  ${FUTILITY} vbutil_key --pack fwsubkey.test \
+    --key ${TESTKEY_DIR}/key_rsa4096.keyb --algorithm 7
+  ${FUTILITY} vbutil_key --pack kernkey.test \
+    --key ${TESTKEY_DIR}/key_rsa2048.keyb --algorithm 4
+  ${FUTILITY} gbb -c 128,2400,0,0 gbb.test
+  ${FUTILITY} gbb gbb.test -s --hwid='Test GBB' --rootkey=rootkey.test
+  ${FUTILITY} vbutil_keyblock --pack keyblock.test \
+    --datapubkey fwsubkey.test \
+    --signprivate ${TESTKEY_DIR}/key_rsa8192.sha512.vbprivk
+  ${FUTILITY} vbutil_firmware --vblock vblock.test \
+    --keyblock keyblock.test \
+    --signprivate ${TESTKEY_DIR}/key_rsa4096.sha256.vbprivk \
+    --fv body.test --version 1 --kernelkey kernkey.test
+
+  # Kernel keyblock is signed by the kernel subkey from the firmware
+  ${FUTILITY} vbutil_keyblock --pack kernel_keyblock.test \
+    --datapubkey ${TESTKEY_DIR}/key_rsa4096.sha256.vbpubk \
+    --signprivate ${TESTKEY_DIR}/key_rsa2048.sha256.vbprivk
+  head -c 500000 /dev/zero > vmlinuz.test
+  head -c 50000 /dev/zero > bootloader.test
+  echo 'console=tty0' > config.test
+  ${FUTILITY} vbutil_kernel --pack kernel.test \
+    --keyblock kernel_keyblock.test \
+    --signprivate ${TESTKEY_DIR}/key_rsa4096.sha256.vbprivk \
+    --version 1 --vmlinuz vmlinuz.test --bootloader bootloader.test \
+    --config config.test --arch x86
+}
+
+[ -d "${DIR}" ] || mkdir -p "${DIR}"
+cd "${DIR}"
+make_inputs >/dev/null
+
+PLUGIN="$(find_plugin)"
+[ -n "${PLUGIN}" ] || error "Can't find QEMU's libinsn.so; set QEMU_PLUGIN"
+
+SEP=""
+echo "{"
+echo "  \"unit\": \"instructions\","
+echo "  \"results\": ["
+for arch in ${*:-arm x86 mips}; do
+  cc="$(arch_setting cc ${arch})"
+  qemu="$(arch_setting qemu ${arch})"
+  if [ -z "${cc}" ] || ! type -p "${cc}" >/dev/null ||
+      ! type -p "${qemu}" >/dev/null; then
+    warning "Skipping ${arch}: need ${cc:-a compiler} and ${qemu:-QEMU}"
+    continue
+  fi
+
+  out="${DIR}/${arch}"
+  CFLAGS="$(arch_setting cflags ${arch})" make -C "${ROOT_DIR}" \
+    BUILD="${out}" FIRMWARE_ARCH="${arch}" CC="${cc}" fwlib \
+    > "${out}.log" 2>&1 || error "Can't build fwlib for ${arch}; see ${out}.log"
+  "${cc}" -static -O2 -I"${ROOT_DIR}/firmware/include" \
+    -I"${ROOT_DIR}/firmware/2lib/include" \
+    -I"${ROOT_DIR}/firmware/lib20/include" \
+    "${ROOT_DIR}/tests/fw_verify_benchmark.c" \
+    "${ROOT_DIR}/firmware/2lib/2stub.c" \
+    "${out}/vboot_fw.a" -o "${out}/fw_verify_benchmark"
+  text=$("${cc%gcc}size" -t "${out}/vboot_fw.a" | awk 'END { print $1 }')
+
+  bench="${out}/fw_verify_benchmark"
+  run_op fw_verify fw gbb.test vblock.test body.test
+  run_op kernel_vblock_verify kernel kernkey.test kernel.test
+done
+echo
+echo "  ]"
+echo "}"
@@ -66,6 +66,13 @@ static void RecalcFwmpCrc(void)
 				  mock_fwmp.fwmp.struct_size - 2);
 }
 
+/* Forget the Tlcl calls made so far, without changing the mock TPM. */
+static void ResetCallLog(void)
+{
+	*mock_calls = 0;
+	mock_cnext = mock_calls;
+}
+
 /* Reset the variables for the Tlcl mock functions. */
 static void ResetMocks(int fail_on_call, uint32_t fail_with_err)
 {
@@ -168,6 +175,21 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	return (++mock_count == fail_at_count) ? fail_with_error : TPM_SUCCESS;
 }
 
+uint32_t TlclReadMultiple(struct tlcl_nv_read *reads, int count)
+{
+	uint32_t result = TPM_SUCCESS;
+	int i;
+
+	mock_cnext += sprintf(mock_cnext, "TlclReadMultiple(%d)\n", count);
+	for (i = 0; i < count; i++) {
+		reads[i].result = TlclRead(reads[i].index, reads[i].data,
+					   reads[i].length);
+		if (result == TPM_SUCCESS)
+			result = reads[i].result;
+	}
+	return result;
+}
+
 uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length)
 {
 	mock_cnext += sprintf(mock_cnext, "TlclWrite(0x%x, %d)\n",
@@ -556,10 +578,49 @@ static void RollbackKernelTest(void)
 		    "TlclRead(0x1008, 13)\n",
 		    "tlcl calls");
 
+	/* Write after read doesn't read the space again first */
+	ResetMocks(0, 0);
+	mock_rsk.uid = ROLLBACK_SPACE_KERNEL_UID;
+	mock_permissions = TPM_NV_PER_PPWRITE;
+	mock_rsk.kernel_versions = 0x87654321;
+	TEST_EQ(RollbackKernelRead(&version), 0, "RollbackKernelRead()");
+	ResetCallLog();
+	TEST_EQ(RollbackKernelWrite(0x87654322), 0,
+		"RollbackKernelWrite() after read");
+	TEST_EQ(mock_rsk.kernel_versions, 0x87654322,
+		"RollbackKernelWrite() version");
+	TEST_EQ(mock_rsk.uid, ROLLBACK_SPACE_KERNEL_UID,
+		"RollbackKernelWrite() uid");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "tlcl calls");
+
+	/* Nor does a second write */
+	ResetCallLog();
+	TEST_EQ(RollbackKernelWrite(0x87654323), 0,
+		"RollbackKernelWrite() again");
+	TEST_EQ(mock_rsk.kernel_versions, 0x87654323,
+		"RollbackKernelWrite() version");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "tlcl calls");
+
 	ResetMocks(1, TPM_E_IOERROR);
 	TEST_EQ(RollbackKernelWrite(123), TPM_E_IOERROR,
 		"RollbackKernelWrite() error");
 
+	/* After a write error, the space is read again */
+	ResetMocks(0, 0);
+	TEST_EQ(RollbackKernelWrite(0xBEAD4321), 0,
+		"RollbackKernelWrite() after error");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclWrite(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "tlcl calls");
+
 	/* Test lock (recovery off) */
 	ResetMocks(1, TPM_E_IOERROR);
 	TEST_EQ(RollbackKernelLock(0), TPM_E_IOERROR,
@@ -670,6 +731,80 @@ static void RollbackFwmpTest(void)
 		"RollbackFwmpRead() major version");
 }
 
+/****************************************************************************/
+/* Tests for RollbackReadAhead() */
+
+static void RollbackReadAheadTest(void)
+{
+	struct RollbackSpaceFwmp fwmp;
+	RollbackSpaceKernel rsk;
+	uint32_t version = 0;
+
+	/* Both spaces are read together, then not read again */
+	ResetMocks(0, 0);
+	mock_rsk.uid = ROLLBACK_SPACE_KERNEL_UID;
+	mock_permissions = TPM_NV_PER_PPWRITE;
+	mock_rsk.kernel_versions = 0x87654321;
+	RollbackReadAhead(1);
+	TEST_EQ(RollbackKernelRead(&version), 0, "ReadAhead kernel");
+	TEST_EQ(version, 0x87654321, "  version");
+	TEST_EQ(RollbackFwmpRead(&fwmp), 0, "ReadAhead fwmp");
+	TEST_EQ(0, memcmp(&fwmp, &mock_fwmp, sizeof(fwmp)), "  data");
+	TEST_STR_EQ(mock_calls,
+		    "TlclReadMultiple(2)\n"
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclRead(0x100a, 40)\n"
+		    "TlclGetPermissions(0x1008)\n",
+		    "  tlcl calls");
+
+	/* What was read ahead is only used once */
+	ResetCallLog();
+	TEST_EQ(RollbackFwmpRead(&fwmp), 0, "ReadAhead fwmp again");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(0x100a, 40)\n",
+		    "  tlcl calls");
+
+	/* Errors are returned by the read which uses the result */
+	ResetMocks(1, TPM_E_IOERROR);
+	RollbackReadAhead(0);
+	TEST_EQ(RollbackKernelRead(&version), TPM_E_IOERROR,
+		"ReadAhead kernel error");
+	TEST_STR_EQ(mock_calls,
+		    "TlclReadMultiple(1)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "  tlcl calls");
+
+	/* A bad CRC is read again */
+	ResetMocks(0, 0);
+	mock_rsk.struct_version = 2;
+	mock_rsk.uid = ROLLBACK_SPACE_KERNEL_UID;
+	mock_rsk.crc8 = vb2_crc8(&mock_rsk,
+				 offsetof(RollbackSpaceKernel, crc8));
+	mock_permissions = TPM_NV_PER_PPWRITE;
+	noise_on[0] = 1;
+	RollbackReadAhead(0);
+	TEST_EQ(RollbackKernelRead(&version), 0, "ReadAhead kernel bad crc");
+	TEST_STR_EQ(mock_calls,
+		    "TlclReadMultiple(1)\n"
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclGetPermissions(0x1008)\n",
+		    "  tlcl calls");
+
+	/* Writing a space forgets what was read ahead */
+	ResetMocks(0, 0);
+	RollbackReadAhead(0);
+	memset(&rsk, 0, sizeof(rsk));
+	rsk.kernel_versions = 0x1234;
+	TEST_EQ(WriteSpaceKernel(&rsk), 0, "ReadAhead then write");
+	TEST_STR_EQ(mock_calls,
+		    "TlclReadMultiple(1)\n"
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclWrite(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "  tlcl calls");
+}
+
 int main(int argc, char* argv[])
 {
 	CrcTestFirmware();
@@ -677,6 +812,7 @@ int main(int argc, char* argv[])
 	MiscTest();
 	RollbackKernelTest();
 	RollbackFwmpTest();
+	RollbackReadAheadTest();
 
 	return gTestSuccess ? 0 : 255;
 }
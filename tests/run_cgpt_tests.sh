@@ -14,8 +14,9 @@ CGPT=$(readlink -f "$1")
 
 MTD="${@:2}"
 
-# Run tests in a dedicated directory for easy cleanup or debugging.
-DIR="${TEST_DIR}/cgpt_test_dir"
+# Run tests in a dedicated directory for easy cleanup or debugging.  Runs
+# with and without -D get their own, so they can run in parallel.
+DIR="${TEST_DIR}/cgpt_test_dir${MTD:+_mtd}"
 [ -d "$DIR" ] || mkdir -p "$DIR"
 warning "testing $CGPT in $DIR"
 cd "$DIR"
@@ -336,6 +337,66 @@ $CGPT create $MTD ${DEV}
 $CGPT legacy $MTD -p ${DEV}
 run_prioritize_tests 2>/dev/null
 
+echo "Test cgpt batch command..."
+$CGPT create $MTD ${DEV}
+$CGPT batch $MTD ${DEV} <<EOF
+# Comments and blank lines are skipped
+
+add -b ${DATA_START} -s ${DATA_SIZE} -t ${DATA_GUID} -l "${DATA_LABEL}"
+add -b ${KERN_START} -s ${KERN_SIZE} -t kernel -l '${KERN_LABEL}' -P 5
+add -b ${ROOTFS_START} -s ${ROOTFS_SIZE} -t rootfs -l "${ROOTFS_LABEL}"
+add -i 2 -S 1 -T 3
+prioritize -i 2 -P 9
+EOF
+[ "$($CGPT show $MTD -b -i 1 ${DEV})" = "${DATA_START}" ] || error
+[ "$($CGPT show $MTD -l -i 1 ${DEV})" = "${DATA_LABEL}" ] || error
+[ "$($CGPT show $MTD -l -i 2 ${DEV})" = "${KERN_LABEL}" ] || error
+[ "$($CGPT show $MTD -s -i 3 ${DEV})" = "${ROOTFS_SIZE}" ] || error
+[ "$($CGPT show $MTD -P -i 2 ${DEV})" = "9" ] || error
+[ "$($CGPT show $MTD -S -i 2 ${DEV})" = "1" ] || error
+($CGPT show $MTD ${DEV} | grep -q INVALID) && error
+[ "$($CGPT show $MTD -j ${DEV} | grep -c '"part"')" = "3" ] || error
+[ "$($CGPT show $MTD -j -F priority,label -i 2 ${DEV})" = \
+  "$(printf '[\n  {"part": 2, "label": "%s", "priority": 9}\n]' \
+     "${KERN_LABEL}")" ] || error
+$CGPT show $MTD -j -F nosuchfield ${DEV} >/dev/null 2>&1 && error
+# A failing command leaves the drive as it was.
+cp ${DEV} batch_before.bin
+$CGPT batch $MTD ${DEV} 2>/dev/null <<EOF && error
+add -i 1 -l "not saved"
+add -i 99 -l "no such partition"
+EOF
+cmp -s ${DEV} batch_before.bin || error
+echo "nosuchcommand" | $CGPT batch $MTD ${DEV} 2>/dev/null && error
+echo "batch" | $CGPT batch $MTD ${DEV} 2>/dev/null && error
+echo "add -i 1 -l 'unterminated" | $CGPT batch $MTD ${DEV} 2>/dev/null && error
+cmp -s ${DEV} batch_before.bin || error
+
+echo "Test cgpt find with an index..."
+rm -f find_cache.bin
+[ "$($CGPT find $MTD -C find_cache.bin -l "${DATA_LABEL}" ${DEV})" = \
+  "$($CGPT find $MTD -l "${DATA_LABEL}" ${DEV})" ] || error
+[ -s find_cache.bin ] || error
+[ "$($CGPT find $MTD -C find_cache.bin -t kernel ${DEV})" = \
+  "$($CGPT find $MTD -t kernel ${DEV})" ] || error
+# Changing the drive makes the index read it again.
+$CGPT add $MTD -i 1 -l "relabeled" ${DEV}
+$CGPT find $MTD -C find_cache.bin -l "relabeled" ${DEV} >/dev/null || error
+$CGPT find $MTD -C find_cache.bin -l "${DATA_LABEL}" ${DEV} && error
+$CGPT add $MTD -i 1 -l "${DATA_LABEL}" ${DEV}
+# Content matching reads the drive even with an index.
+printf "KERNMAGIC" > find_magic.bin
+printf "KERNMAGIC" | dd of=${DEV} bs=512 seek=$((KERN_START + 1)) \
+  conv=notrunc 2>/dev/null
+[ "$($CGPT find $MTD -n -t kernel -M find_magic.bin -O 512 ${DEV})" = \
+  "2" ] || error
+[ "$($CGPT find $MTD -n -C find_cache.bin -j 4 -t kernel \
+  -M find_magic.bin -O 512 ${DEV})" = "2" ] || error
+$CGPT find $MTD -t kernel -M find_magic.bin ${DEV} && error
+# A damaged index is ignored.
+echo "garbage" > find_cache.bin
+$CGPT find $MTD -C find_cache.bin -l "${DATA_LABEL}" ${DEV} >/dev/null || error
+
 # Now make sure that we don't need write access if we're just looking.
 echo "Test read vs read-write access..."
 chmod 0444 ${DEV}
@@ -355,9 +416,24 @@ $CGPT boot $MTD -i 2 ${DEV} 2>/dev/null && error
 $CGPT boot $MTD ${DEV} >/dev/null
 $CGPT show $MTD ${DEV} >/dev/null
 $CGPT find $MTD -t kernel ${DEV} >/dev/null
+[ "$($CGPT find $MTD -j 4 -t kernel ${DEV})" = \
+  "$($CGPT find $MTD -t kernel ${DEV})" ] || error
+$CGPT find $MTD -j 0 -t kernel ${DEV} >/dev/null 2>&1 && error
 
 # Enable write access again to test boundary in off device storage
 chmod 600 ${DEV}
+
+echo "Test tables with more than 128 entries..."
+dd if=/dev/zero of=${DEV} bs=512 count=4000 2>/dev/null
+$CGPT create $MTD -n 1024 ${DEV}
+X=$($CGPT show $MTD -d ${DEV} | grep -c "Number of entries: 1024")
+[ "$X" = "2" ] || error
+$CGPT add $MTD -i 1000 -b 600 -s 10 -t kernel -l "big table" ${DEV}
+[ "$($CGPT find $MTD -l "big table" ${DEV})" = "${DEV}1000" ] || error
+$CGPT repair $MTD ${DEV}
+$CGPT show $MTD -i 1000 -l ${DEV} | grep -q "big table" || error
+assert_fail $CGPT create $MTD -n 4097 ${DEV}
+assert_fail $CGPT create $MTD -n 15 ${DEV}
 # GPT too small
 dd if=/dev/zero of=${DEV} bs=5632 count=1
 assert_fail $CGPT create -D 1024 ${DEV}
@@ -0,0 +1,125 @@
+#!/bin/bash
+
+# Copyright 2019 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Run independent tests in parallel, as "make runparalleltests" does.
+#
+# Usage:
+#    run_parallel_tests.sh [-j JOBS] [-s I/N] [-t TIMES] LIST
+#
+# LIST has one shell command per line; each line is a test, and must not
+# share scratch files with any other line.  Up to JOBS tests (default: one
+# per CPU) run at once, each with its output in a log which is only shown if
+# the test fails.  With -s, only the Ith of N shards of the tests is run, so
+# separate machines can split the list.
+#
+# The wall time of each test is written to TIMES (default: LIST.times),
+# slowest first, and read back on the next run to start the slowest tests
+# first.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+jobs=$(nproc 2>/dev/null || echo 1)
+shard=1
+shards=1
+times=
+
+usage() {
+  echo "Usage: $(basename "$0") [-j JOBS] [-s I/N] [-t TIMES] LIST" >&2
+  exit 1
+}
+
+while getopts "j:s:t:" opt; do
+  case "${opt}" in
+    j) jobs="${OPTARG}" ;;
+    s) shard="${OPTARG%/*}"; shards="${OPTARG#*/}" ;;
+    t) times="${OPTARG}" ;;
+    *) usage ;;
+  esac
+done
+shift $(( OPTIND - 1 ))
+[ $# -eq 1 ] || usage
+list="$1"
+times="${times:-${list}.times}"
+
+[[ "${jobs}" =~ ^[1-9][0-9]*$ ]] || error "Bad job count: ${jobs}"
+[[ "${shard}" =~ ^[1-9][0-9]*$ && "${shards}" =~ ^[1-9][0-9]*$ ]] &&
+  [ "${shard}" -le "${shards}" ] || error "Bad shard: ${shard}/${shards}"
+
+logdir="${list}.logs"
+rm -rf "${logdir}"
+mkdir -p "${logdir}"
+
+# Tests in this shard, in list order
+tests=()
+n=0
+while read -r cmd; do
+  [ -n "${cmd}" ] || continue
+  if [ $(( n % shards + 1 )) -eq "${shard}" ]; then
+    tests+=("${cmd}")
+  fi
+  n=$(( n + 1 ))
+done < "${list}"
+
+# Start order: slowest first by the last recorded times, then the new tests
+order=$(
+  for i in "${!tests[@]}"; do
+    t=$(awk -F '\t' -v cmd="${tests[$i]}" \
+      '$2 == cmd { t = $1 } END { print t + 0 }' "${times}" 2>/dev/null ||
+      echo 0)
+    echo "${t} ${i}"
+  done | sort -k1,1gr -k2,2n | cut -d' ' -f2
+)
+
+# Run test $1, recording its exit status and wall time
+run_one() {
+  local i="$1"
+  local start end rc=0
+
+  start=$(date +%s.%N)
+  bash -c "${tests[$i]}" > "${logdir}/${i}.log" 2>&1 < /dev/null || rc=$?
+  end=$(date +%s.%N)
+  echo "${rc} $(awk "BEGIN { print ${end} - ${start} }")" \
+    > "${logdir}/${i}.result"
+}
+
+running=0
+for i in ${order}; do
+  if [ "${running}" -ge "${jobs}" ]; then
+    wait -n || true
+    running=$(( running - 1 ))
+  fi
+  run_one "${i}" &
+  running=$(( running + 1 ))
+done
+wait
+
+failed=0
+: > "${times}.new"
+for i in "${!tests[@]}"; do
+  read -r rc secs < "${logdir}/${i}.result"
+  printf '%s\t%s\n' "${secs}" "${tests[$i]}" >> "${times}.new"
+  if [ "${rc}" -eq 0 ]; then
+    printf "${COL_GREEN}PASSED${COL_STOP} %7.2fs  %s\n" "${secs}" \
+      "${tests[$i]}"
+  else
+    failed=$(( failed + 1 ))
+    cat "${logdir}/${i}.log"
+    printf "${COL_RED}FAILED${COL_STOP} %7.2fs  %s\n" "${secs}" \
+      "${tests[$i]}"
+  fi
+done
+# Keep the times of tests in other shards
+awk -F '\t' 'NR == FNR { print; ran[$2] = 1; next } !($2 in ran)' \
+  "${times}.new" "${times}" 2>/dev/null > "${times}.all" ||
+  cp "${times}.new" "${times}.all"
+sort -t "$(printf '\t')" -k1,1gr "${times}.all" > "${times}"
+rm -f "${times}.new" "${times}.all"
+
+echo "Ran ${#tests[@]} tests (shard ${shard}/${shards}), ${failed} failed"
+[ "${failed}" -eq 0 ]
@@ -191,6 +191,170 @@ else
   echo -e "${COL_GREEN}PASSED${COL_STOP}"
 fi
 
+# A pipe can't be seeked, so that reads through instead of using pread().
+echo -n "check kernel config from a pipe ..."
+: $(( tests++ ))
+if [ "$(cat "${USB_KERN}" | "${FUTILITY}" dump_kernel_config /dev/stdin)" \
+     = "$orig" ]; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# Several partitions at once get one line each, prefixed with the name.
+echo -n "check kernel config batch mode ..."
+: $(( tests++ ))
+batch=$("${FUTILITY}" dump_kernel_config "${USB_KERN}" "${tempfile}")
+if [ "$batch" = "$(printf '%s: %s\n%s: %s' "${USB_KERN}" "$orig" \
+                   "${tempfile}" "$orig")" ] &&
+   ! "${FUTILITY}" dump_kernel_config "${USB_KERN}" "${CONFIG}" \
+       >/dev/null 2>&1; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# Repack the whole partition with a new command line.  The kernel blob is
+# streamed through rather than read into memory, so check it comes out intact.
+NEW_CONFIG="${TMPDIR}/new_config.txt"
+echo "console=ttyS0 repacked" > "${NEW_CONFIG}"
+REPACKED="${TMPDIR}/repacked.bin"
+echo -n "repack with new config ... "
+: $(( tests++ ))
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${REPACKED}" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${NEW_CONFIG}" \
+     --oldblob "${USB_KERN}" >/dev/null &&
+   "${FUTILITY}" vbutil_kernel \
+     --verify "${REPACKED}" \
+     --signpubkey "${SSD_SIGNPUBKEY}" >/dev/null &&
+   [ "$("${FUTILITY}" dump_kernel_config "${REPACKED}")" = \
+     "$(tr '\012' ' ' < "${NEW_CONFIG}")" ] &&
+   [ "$(stat -c %s "${REPACKED}")" = "$(stat -c %s "${USB_KERN}")" ]; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# The hash cache must give the same result as hashing the whole blob, both
+# when it is first written and when it is used.
+HASH_CACHE="${TMPDIR}/hash_cache.bin"
+rm -f "${HASH_CACHE}"
+echo -n "repack with hash cache ... "
+: $(( tests++ ))
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${TMPDIR}/cached_1.bin" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${CONFIG}" \
+     --hashcache "${HASH_CACHE}" \
+     --oldblob "${USB_KERN}" >/dev/null &&
+   [ -s "${HASH_CACHE}" ] &&
+   "${FUTILITY}" vbutil_kernel \
+     --repack "${TMPDIR}/cached_2.bin" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${NEW_CONFIG}" \
+     --hashcache "${HASH_CACHE}" \
+     --oldblob "${USB_KERN}" >/dev/null &&
+   cmp -s "${TMPDIR}/cached_2.bin" "${REPACKED}"; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# A cache saved for another partition is ignored, and replaced.
+echo -n "ignore hash cache for another blob ... "
+: $(( tests++ ))
+cp "${HASH_CACHE}" "${HASH_CACHE}.old"
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${TMPDIR}/cached_3.bin" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${CONFIG}" \
+     --hashcache "${HASH_CACHE}" \
+     --oldblob "${REPACKED}" >/dev/null &&
+   "${FUTILITY}" vbutil_kernel \
+     --verify "${TMPDIR}/cached_3.bin" \
+     --signpubkey "${SSD_SIGNPUBKEY}" >/dev/null &&
+   ! cmp -s "${HASH_CACHE}" "${HASH_CACHE}.old"; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# A cache saved for the same vblock isn't used once the blob is changed under
+# it; the repacked partition must still verify.
+tempfile="${TMPDIR}/changed_blob.bin"
+cp "${USB_KERN}" "${tempfile}"
+printf 'x' | dd of="${tempfile}" bs=1 seek=$(( 65536 + 4096 )) \
+  conv=notrunc 2>/dev/null
+echo -n "ignore hash cache for a changed blob ... "
+: $(( tests++ ))
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${TMPDIR}/cached_4.bin" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${CONFIG}" \
+     --hashcache "${HASH_CACHE}" \
+     --oldblob "${USB_KERN}" >/dev/null &&
+   "${FUTILITY}" vbutil_kernel \
+     --repack "${TMPDIR}/cached_5.bin" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${CONFIG}" \
+     --hashcache "${HASH_CACHE}" \
+     --oldblob "${tempfile}" >/dev/null &&
+   "${FUTILITY}" vbutil_kernel \
+     --verify "${TMPDIR}/cached_5.bin" \
+     --signpubkey "${SSD_SIGNPUBKEY}" >/dev/null; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# Repack a partition in place, which only rewrites the vblock and config.
+tempfile="${TMPDIR}/in_place.bin"
+cp "${USB_KERN}" "${tempfile}"
+echo -n "repack in place ... "
+: $(( tests++ ))
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${tempfile}" \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --config "${NEW_CONFIG}" \
+     --oldblob "${tempfile}" >/dev/null &&
+   cmp -s "${tempfile}" "${REPACKED}"; then
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+else
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+fi
+
+# Writing only the vblock over the partition being repacked would truncate it.
+echo -n "refuse vblock-only repack in place ... "
+: $(( tests++ ))
+if "${FUTILITY}" vbutil_kernel \
+     --repack "${tempfile}" \
+     --vblockonly \
+     --keyblock "${SSD_KEYBLOCK}" \
+     --signprivate "${SSD_SIGNPRIVATE}" \
+     --oldblob "${tempfile}" >/dev/null 2>&1 ||
+   ! cmp -s "${tempfile}" "${REPACKED}"; then
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+else
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+fi
+
 # Summary
 ME=$(basename "$0")
 if [ "$errs" -ne 0 ]; then
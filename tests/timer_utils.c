@@ -3,22 +3,78 @@
  * found in the LICENSE file.
  */
 
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include "timer_utils.h"
 
+/* Not slewed by NTP, where the OS has it */
+#ifdef CLOCK_MONOTONIC_RAW
+#define TIMER_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define TIMER_CLOCK CLOCK_MONOTONIC
+#endif
+
+static uint64_t TimespecNsecs(const struct timespec* ts) {
+	return (uint64_t) ts->tv_sec * 1000000000 + (uint64_t) ts->tv_nsec;
+}
+
 void StartTimer(ClockTimerState* ct) {
-	clock_gettime(CLOCK_REALTIME, &ct->start_time);
+	clock_gettime(TIMER_CLOCK, &ct->start_time);
 }
 
 void StopTimer(ClockTimerState* ct) {
-	clock_gettime(CLOCK_REALTIME, &ct->end_time);
+	clock_gettime(TIMER_CLOCK, &ct->end_time);
 }
 
 uint32_t GetDurationMsecs(ClockTimerState* ct) {
-	uint64_t start = ((uint64_t) ct->start_time.tv_sec * 1000000000 +
-			  (uint64_t) ct->start_time.tv_nsec);
-	uint64_t end = ((uint64_t) ct->end_time.tv_sec * 1000000000 +
-			(uint64_t) ct->end_time.tv_nsec);
-	uint64_t duration_msecs = (end - start) / 1000000U;  /* Nanoseconds ->
-							      * Milliseconds. */
-	return (uint32_t) duration_msecs;
+	/* Nanoseconds -> Milliseconds. */
+	return (uint32_t) (GetDurationNsecs(ct) / 1000000U);
+}
+
+uint64_t GetDurationNsecs(ClockTimerState* ct) {
+	return TimespecNsecs(&ct->end_time) - TimespecNsecs(&ct->start_time);
+}
+
+uint64_t ReadNsecs(void) {
+	struct timespec ts;
+
+	clock_gettime(TIMER_CLOCK, &ts);
+	return TimespecNsecs(&ts);
+}
+
+static int CompareSamples(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+
+	return x < y ? -1 : x > y;
+}
+
+void GetTimerStats(uint64_t* samples, int count, TimerStatsState* stats) {
+	if (count < 1) {
+		stats->min = stats->median = stats->p99 = 0;
+		return;
+	}
+
+	qsort(samples, count, sizeof(*samples), CompareSamples);
+	stats->min = samples[0];
+	stats->median = count & 1 ? samples[count / 2] :
+		(samples[count / 2 - 1] + samples[count / 2]) / 2;
+	stats->p99 = samples[(count * 99 + 99) / 100 - 1];
+}
+
+int PinToCpu(int cpu) {
+#ifdef __linux__
+	cpu_set_t set;
+
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return 1;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) ? 1 : 0;
+#else
+	return 1;
+#endif
 }
@@ -10,6 +10,15 @@
 
 #include <time.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_COUNTER_UNIT "cycles"
+#elif defined(__aarch64__)
+#define CYCLE_COUNTER_UNIT "ticks"
+#else
+#define CYCLE_COUNTER_UNIT "ns"
+#endif
+
 typedef struct ClockTimer {
 	struct timespec start_time;
 	struct timespec end_time;
@@ -24,4 +33,45 @@ void StopTimer(ClockTimerState* ct);
 /* Get duration in milliseconds. */
 uint32_t GetDurationMsecs(ClockTimerState* ct);
 
+/* Get duration in nanoseconds. */
+uint64_t GetDurationNsecs(ClockTimerState* ct);
+
+/* Read the monotonic clock, in nanoseconds. */
+uint64_t ReadNsecs(void);
+
+/*
+ * Read the CPU's cycle counter: the TSC on x86 or the virtual counter on ARM64,
+ * in CYCLE_COUNTER_UNIT.  Other CPUs fall back to ReadNsecs().  This is inline
+ * so that timing very short operations doesn't also time a call.
+ */
+static inline uint64_t ReadCycleCounter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t count;
+
+	__asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (count));
+	return count;
+#else
+	return ReadNsecs();
+#endif
+}
+
+typedef struct TimerStats {
+	uint64_t min;
+	uint64_t median;
+	uint64_t p99;		/* 99th percentile */
+} TimerStatsState;
+
+/* Sort [count] timing [samples] in place, and update [stats] from them. */
+void GetTimerStats(uint64_t* samples, int count, TimerStatsState* stats);
+
+/*
+ * Run the calling thread only on CPU [cpu], so samples aren't spread across
+ * cores with different clocks or caches.  Returns 0 if success, non-zero if
+ * the CPU can't be used.
+ */
+int PinToCpu(int cpu);
+
 #endif  /* VBOOT_REFERENCE_TIMER_UTILS_H_ */
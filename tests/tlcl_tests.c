@@ -10,6 +10,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2hmac.h"
+#include "2sha.h"
 #include "host_common.h"
 #include "test_common.h"
 #include "tlcl.h"
@@ -24,6 +28,8 @@ static VbError_t mock_retval;
 struct srcall
 {
 	const uint8_t *req;  /* Request */
+	uint8_t req_buf[32];  /* Start of the request, copied */
+	uint8_t req_end[32];  /* End of the request, copied */
 	uint8_t *rsp;  /* Response */
 	uint8_t rsp_buf[32];  /* Default response buffer, if not overridden */
 	int req_size;  /* Request size */
@@ -83,6 +89,12 @@ VbError_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
 
 	c->req = request;
 	c->req_size = request_length;
+	memcpy(c->req_buf, request, request_length < sizeof(c->req_buf) ?
+	       request_length : sizeof(c->req_buf));
+	if (request_length >= sizeof(c->req_end))
+		memcpy(c->req_end,
+		       request + request_length - sizeof(c->req_end),
+		       sizeof(c->req_end));
 
 	/* Parse out the command code */
 	FromTpmUint32(request + 6, &c->req_cmd);
@@ -252,11 +264,57 @@ static void ReadWriteTest(void)
 	ResetMocks();
 	TEST_EQ(TlclWrite(1, buf, 3), 0, "Write");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_WriteValue, "  cmd");
+	TEST_EQ(calls[0].req_size, 25, "  size");
+	TEST_EQ(memcmp(calls[0].req_buf + 10, "\0\0\0\x01\0\0\0\0\0\0\0\x03",
+		       12), 0, "  index, offset and length");
+	TEST_EQ(memcmp(calls[0].req_buf + 22, buf, 3), 0, "  data");
 
 	ResetMocks();
 	TEST_EQ(TlclRead(1, buf, 3), 0, "Read");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
 
+	ResetMocks();
+	{
+		uint8_t buf2[3];
+		struct tlcl_nv_read reads[] = {
+			{ .index = 1, .data = buf, .length = 3 },
+			{ .index = 2, .data = buf2, .length = 3 },
+			{ .index = 3, .data = buf2, .length = 3 },
+		};
+
+		SetResponse(1, TPM_E_BADINDEX, 10);
+		TEST_EQ(TlclReadMultiple(reads, 3), TPM_E_BADINDEX,
+			"ReadMultiple");
+		TEST_EQ(ncalls, 3, "  calls");
+		TEST_EQ(calls[2].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
+		TEST_EQ(reads[0].result, 0, "  result 0");
+		TEST_EQ(reads[1].result, TPM_E_BADINDEX, "  result 1");
+		TEST_EQ(reads[2].result, 0, "  result 2");
+	}
+
+	ResetMocks();
+	{
+		static uint8_t rsp0[256], rsp1[256];
+		uint8_t big[300];
+
+		ToTpmUint32(rsp0 + kTpmResponseHeaderLength, 242);
+		memset(rsp0 + kTpmResponseHeaderLength + 4, 0x11, 242);
+		calls[0].rsp = rsp0;
+		calls[0].rsp_size = sizeof(rsp0);
+		ToTpmUint32(rsp1 + kTpmResponseHeaderLength, 58);
+		memset(rsp1 + kTpmResponseHeaderLength + 4, 0x22, 58);
+		calls[1].rsp = rsp1;
+		calls[1].rsp_size = kTpmResponseHeaderLength + 4 + 58;
+		memset(big, 0, sizeof(big));
+		TEST_EQ(TlclRead(1, big, sizeof(big)), 0, "Read in chunks");
+		TEST_EQ(ncalls, 2, "  calls");
+		TEST_EQ(calls[1].req_buf[17], 242 & 0xff, "  second offset");
+		TEST_EQ(calls[1].req_buf[21], 58, "  second length");
+		TEST_EQ(big[241], 0x11, "  first chunk");
+		TEST_EQ(big[242], 0x22, "  second chunk");
+		TEST_EQ(big[299], 0x22, "  end");
+	}
+
 	ResetMocks();
 	TEST_EQ(TlclWriteLock(1), 0, "WriteLock");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_WriteValue, "  cmd");
@@ -364,6 +422,220 @@ static void DefineSpaceExTest(void) {
 		    sizeof(define_space_response));
 }
 
+/* continueAuthSession of an authorized request, just before its HMAC */
+#define REQ_CONTINUE(c) \
+	((c)->req_end[sizeof((c)->req_end) - TPM_SHA1_160_HASH_LEN - 1])
+
+/**
+ * Fill in a successful DefineSpace response from the owner session with
+ * |shared_secret|, which says whether the TPM kept the session open.
+ */
+static void MakeOwnerResponse(uint8_t *rsp, const uint8_t *shared_secret,
+			      uint8_t continue_session)
+{
+	uint8_t hmac_input[TPM_SHA1_160_HASH_LEN + 2 * sizeof(TPM_NONCE) + 1];
+	uint8_t *auth = rsp + kTpmResponseHeaderLength;
+	struct vb2_sha1_context ctx;
+
+	memset(rsp, 0, kTpmResponseHeaderLength + kTpmResponseAuthBlockLength);
+	ToTpmUint16(rsp, TPM_TAG_RSP_AUTH1_COMMAND);
+	ToTpmUint32(rsp + sizeof(uint16_t),
+		    kTpmResponseHeaderLength + kTpmResponseAuthBlockLength);
+
+	/* Digest of the return code and ordinal; there's no payload */
+	vb2_sha1_init(&ctx);
+	vb2_sha1_update(&ctx, rsp + 6, sizeof(uint32_t));
+	ToTpmUint32(hmac_input, TPM_ORD_NV_DefineSpace);
+	vb2_sha1_update(&ctx, hmac_input, sizeof(uint32_t));
+	vb2_sha1_finalize(&ctx, hmac_input);
+
+	/* New even nonce, the odd nonce from the mock RNG, continue */
+	memset(auth, 0x3c, sizeof(TPM_NONCE));
+	auth[sizeof(TPM_NONCE)] = continue_session;
+	memcpy(hmac_input + TPM_SHA1_160_HASH_LEN, auth, sizeof(TPM_NONCE));
+	memset(hmac_input + TPM_SHA1_160_HASH_LEN + sizeof(TPM_NONCE), 0xa5,
+	       sizeof(TPM_NONCE));
+	hmac_input[sizeof(hmac_input) - 1] = continue_session;
+	hmac(VB2_HASH_SHA1, shared_secret, TPM_AUTH_DATA_LEN,
+	     hmac_input, sizeof(hmac_input),
+	     auth + sizeof(TPM_NONCE) + 1, TPM_SHA1_160_HASH_LEN);
+}
+
+/**
+ * Test reusing the owner OSAP session
+ */
+static void OwnerSessionTest(void) {
+	uint8_t osap_response[kTpmResponseHeaderLength + sizeof(uint32_t) +
+			      2 * sizeof(TPM_NONCE)];
+	uint8_t owner_response[kTpmResponseHeaderLength +
+			       kTpmResponseAuthBlockLength];
+	uint8_t owner_secret[TPM_AUTH_DATA_LEN] = { 0 };
+	uint8_t other_secret[TPM_AUTH_DATA_LEN] = { 1 };
+	uint8_t shared_secret[TPM_AUTH_DATA_LEN];
+	uint8_t nonces[2 * sizeof(TPM_NONCE)];
+
+	/* OSAP response: handle 0x1234, even nonces 0x11 and 0x22 */
+	memset(osap_response, 0, sizeof(osap_response));
+	ToTpmUint16(osap_response, TPM_TAG_RSP_COMMAND);
+	ToTpmUint32(osap_response + sizeof(uint16_t), sizeof(osap_response));
+	ToTpmUint32(osap_response + kTpmResponseHeaderLength, 0x1234);
+	memset(osap_response + kTpmResponseHeaderLength + sizeof(uint32_t),
+	       0x11, sizeof(TPM_NONCE));
+	memset(osap_response + kTpmResponseHeaderLength + sizeof(uint32_t) +
+	       sizeof(TPM_NONCE), 0x22, sizeof(TPM_NONCE));
+
+	/* Shared secret from the even and odd OSAP nonces */
+	memset(nonces, 0x22, sizeof(TPM_NONCE));
+	memset(nonces + sizeof(TPM_NONCE), 0xa5, sizeof(TPM_NONCE));
+	hmac(VB2_HASH_SHA1, owner_secret, sizeof(owner_secret),
+	     nonces, sizeof(nonces), shared_secret, sizeof(shared_secret));
+	MakeOwnerResponse(owner_response, shared_secret, 0);
+
+	/* By default, each command closes its session. */
+	ResetMocks();
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	calls[1].rsp = owner_response;
+	calls[1].rsp_size = sizeof(owner_response);
+	calls[2].rsp = osap_response;
+	calls[2].rsp_size = sizeof(osap_response);
+	calls[3].rsp = owner_response;
+	calls[3].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "One-off owner session DefineSpace");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_OSAP, "  osap cmd");
+	TEST_EQ(REQ_CONTINUE(&calls[1]), 0, "  don't continue session");
+	TEST_EQ(TlclUndefineSpaceEx(owner_secret, sizeof(owner_secret),
+				    0x20000005),
+		TPM_SUCCESS, "  UndefineSpace");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_OSAP, "  new osap");
+	TEST_EQ(REQ_CONTINUE(&calls[3]), 0, "  don't continue session");
+	TEST_EQ(TlclLibClose(), VBERROR_SUCCESS, "  close");
+	TEST_EQ(ncalls, 4, "  nothing to flush");
+
+	TlclKeepOwnerSession(1);
+	MakeOwnerResponse(owner_response, shared_secret, 1);
+
+	/* The second command goes through the same session. */
+	ResetMocks();
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	calls[1].rsp = owner_response;
+	calls[1].rsp_size = sizeof(owner_response);
+	calls[2].rsp = owner_response;
+	calls[2].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "Owner session DefineSpace");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_OSAP, "  osap cmd");
+	TEST_EQ(calls[1].req_cmd, TPM_ORD_NV_DefineSpace, "  definespace cmd");
+	TEST_EQ(REQ_CONTINUE(&calls[1]), 1, "  continue session");
+	TEST_EQ(TlclUndefineSpaceEx(owner_secret, sizeof(owner_secret),
+				    0x20000005),
+		TPM_SUCCESS, "  UndefineSpace");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_NV_DefineSpace, "  no new osap");
+	TEST_EQ(ncalls, 3, "  calls");
+
+	/* A session the TPM has dropped gets started again, once. */
+	ResetMocks();
+	SetResponse(0, TPM_E_INVALID_AUTHHANDLE, kTpmResponseHeaderLength);
+	calls[1].rsp = osap_response;
+	calls[1].rsp_size = sizeof(osap_response);
+	calls[2].rsp = owner_response;
+	calls[2].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "Owner session dropped");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_DefineSpace, "  definespace cmd");
+	TEST_EQ(calls[1].req_cmd, TPM_ORD_OSAP, "  osap cmd");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_NV_DefineSpace, "  retry cmd");
+	TEST_EQ(ncalls, 3, "  calls");
+
+	/* Other errors close the session, without retrying. */
+	ResetMocks();
+	SetResponse(0, TPM_E_AUTHFAIL, kTpmResponseHeaderLength);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_E_AUTHFAIL, "Owner session auth failure");
+	TEST_EQ(calls[1].req_cmd, TPM_ORD_FlushSpecific, "  flush cmd");
+	TEST_EQ(ncalls, 2, "  calls");
+
+	/* Dropped by a failure started at the first command */
+	ResetMocks();
+	SetResponse(1, TPM_E_INVALID_AUTHHANDLE, kTpmResponseHeaderLength);
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_E_INVALID_AUTHHANDLE, "New owner session isn't retried");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_FlushSpecific, "  flush cmd");
+	TEST_EQ(ncalls, 3, "  calls");
+
+	/* A different owner auth needs its own session. */
+	ResetMocks();
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	calls[1].rsp = owner_response;
+	calls[1].rsp_size = sizeof(owner_response);
+	calls[3].rsp = osap_response;
+	calls[3].rsp_size = sizeof(osap_response);
+	calls[4].rsp = owner_response;
+	calls[4].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "Owner session");
+	TEST_EQ(TlclDefineSpaceEx(other_secret, sizeof(other_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_E_AUTHFAIL, "  other owner auth");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_FlushSpecific, "  flush cmd");
+	TEST_EQ(calls[3].req_cmd, TPM_ORD_OSAP, "  osap cmd");
+	TEST_EQ(ncalls, 5, "  calls");
+
+	/* Startup forgets the session, since the TPM has closed it. */
+	ResetMocks();
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	calls[1].rsp = owner_response;
+	calls[1].rsp_size = sizeof(owner_response);
+	calls[3].rsp = osap_response;
+	calls[3].rsp_size = sizeof(osap_response);
+	calls[4].rsp = owner_response;
+	calls[4].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "Owner session");
+	TEST_EQ(TlclStartup(), TPM_SUCCESS, "  Startup");
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "  DefineSpace");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_Startup, "  startup cmd");
+	TEST_EQ(calls[3].req_cmd, TPM_ORD_OSAP, "  osap cmd");
+
+	/* Closing the library flushes the session from the TPM. */
+	ResetMocks();
+	TEST_EQ(TlclLibClose(), VBERROR_SUCCESS, "Close owner session");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_FlushSpecific, "  flush cmd");
+	TEST_EQ(calls[0].req_size, 18, "  flush size");
+	TEST_EQ(memcmp(calls[0].req_buf + kTpmRequestHeaderLength,
+		       "\0\0\x12\x34\0\0\0\x02", 8), 0, "  flush handle");
+	TEST_EQ(TlclLibClose(), VBERROR_SUCCESS, "  close again");
+	TEST_EQ(ncalls, 1, "  calls");
+
+	/* Turning the option off closes an open session too. */
+	ResetMocks();
+	calls[0].rsp = osap_response;
+	calls[0].rsp_size = sizeof(osap_response);
+	calls[1].rsp = owner_response;
+	calls[1].rsp_size = sizeof(owner_response);
+	TEST_EQ(TlclDefineSpaceEx(owner_secret, sizeof(owner_secret),
+				  0x20000005, 0x2000, 0x10, NULL, 0),
+		TPM_SUCCESS, "Owner session");
+	TlclKeepOwnerSession(0);
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_FlushSpecific, "  flushed when off");
+	TEST_EQ(ncalls, 3, "  calls");
+}
+
 /**
  * Test TlclInitNvAuthPolicy.
  */
@@ -1068,6 +1340,25 @@ static void TakeOwnershipTest(void) {
 		    sizeof(take_ownership_response));
 }
 
+/**
+ * Test CreateDelegationFamily
+ */
+static void CreateDelegationFamilyTest(void) {
+	const uint8_t expected[] = {
+		0x00, 0xc1, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00,
+		0x00, 0xd2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x42,
+	};
+
+	ResetMocks();
+	TEST_EQ(TlclCreateDelegationFamily(0x42), TPM_SUCCESS,
+		"CreateDelegationFamily");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_Delegate_Manage, "  cmd");
+	TEST_EQ(calls[0].req_size, sizeof(expected), "  size");
+	TEST_EQ(memcmp(calls[0].req_buf, expected, sizeof(expected)), 0,
+		"  request");
+}
+
 /**
  * Test ReadDelegationFamilyTable
  */
@@ -1153,12 +1444,71 @@ static void ReadDelegationFamilyTableTest(void) {
 	ToTpmUint32(response + kTpmResponseHeaderLength, 0x1e);
 }
 
+/**
+ * Test per-command statistics
+ */
+static void StatsTest(void)
+{
+	const struct vb2_tpm_stat *s;
+	uint32_t count;
+
+	TlclStatsReset();
+	s = TlclGetStats(&count);
+	TEST_EQ(count, 0, "Stats empty");
+
+	ResetMocks();
+	SetResponse(1, TPM_E_BADINDEX, 10);
+	TlclWrite(1, "abc", 3);
+	TlclWrite(1, "abc", 3);
+	TlclForceClear();
+	s = TlclGetStats(&count);
+	TlclStatsDump();
+	TEST_EQ(count, 2, "Stats count");
+	TEST_EQ(s[0].command_code, TPM_ORD_NV_WriteValue, "  command 0");
+	TEST_EQ(s[0].count, 2, "  count 0");
+	TEST_EQ(s[0].errors, 1, "  errors 0");
+	TEST_TRUE(s[0].max_time <= s[0].total_time, "  max time 0");
+	TEST_EQ(s[1].command_code, TPM_ORD_ForceClear, "  command 1");
+	TEST_EQ(s[1].count, 1, "  count 1");
+	TEST_EQ(s[1].errors, 0, "  errors 1");
+
+	/* Communication failures count as errors */
+	ResetMocks();
+	calls[0].retval = VBERROR_SIMULATED;
+	TlclForceClear();
+	s = TlclGetStats(&count);
+	TEST_EQ(s[1].count, 2, "Stats comm failure");
+	TEST_EQ(s[1].errors, 1, "  errors");
+
+	/* Times are accumulated */
+	TlclStatsReset();
+	TlclStatsRecord(1, 0, 10);
+	TlclStatsRecord(1, 0, 30);
+	TlclStatsRecord(1, 0, 20);
+	s = TlclGetStats(&count);
+	TEST_EQ(count, 1, "Stats accumulate");
+	TEST_EQ(s[0].total_time, 60, "  total");
+	TEST_EQ(s[0].max_time, 30, "  max");
+
+	/* New command codes are dropped once the table is full */
+	TlclStatsReset();
+	for (count = 0; count < VB2_TPM_STAT_ENTRIES + 2; count++)
+		TlclStatsRecord(count, 0, 1);
+	s = TlclGetStats(&count);
+	TEST_EQ(count, VB2_TPM_STAT_ENTRIES, "Stats full");
+	TlclStatsRecord(0, 0, 1);
+	TEST_EQ(s[0].count, 2, "  existing still counted");
+
+	TlclStatsReset();
+}
+
 int main(void)
 {
 	TlclTest();
 	SendCommandTest();
 	ReadWriteTest();
 	DefineSpaceExTest();
+	OwnerSessionTest();
 	InitNvAuthPolicyTest();
 	PcrTest();
 	GetSpaceInfoTest();
@@ -1168,7 +1518,9 @@ int main(void)
 	IFXFieldUpgradeInfoTest();
 	ReadPubekTest();
 	TakeOwnershipTest();
+	CreateDelegationFamilyTest();
 	ReadDelegationFamilyTableTest();
+	StatsTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,775 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for the TPM traffic of a boot, against a simulated TPM.
+ *
+ * VbExTpmSendReceive() is replaced by a small TPM which holds the firmware,
+ * kernel and FWMP spaces and answers the commands tlcl sends, in TPM1.2 or
+ * TPM2.0 format to match TPM2_MODE.  Each command takes simulated time from a
+ * latency profile of the bus and the TPM, which VbExGetTimer() returns, so
+ * the time tlcl records for each command is what it would be on that TPM.
+ * The firmware and kernel TPM calls of a normal, developer and recovery boot
+ * are run against each profile, and the TPM time of each boot is printed as
+ * JSON on stdout.
+ *
+ * The profiles are rough figures for each kind of TPM, not measurements; use
+ * -l to try others.  Since the time is simulated, the results are the same on
+ * any machine, so this shows how a change to the TPM calls of a boot moves
+ * its TPM time.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2crc8.h"
+#include "rollback_index.h"
+#include "tlcl.h"
+#include "tss_constants.h"
+#include "vboot_api.h"
+
+#ifndef offsetof
+#define offsetof(A,B) __builtin_offsetof(A,B)
+#endif
+
+/* Kinds of command, which take different times on the TPM */
+enum cmd_class {
+	CMD_STARTUP,
+	CMD_SELFTEST,
+	CMD_NV_READ,
+	CMD_NV_WRITE,
+	CMD_EXTEND,
+	CMD_OTHER,
+	CMD_CLASS_COUNT,
+};
+
+static const char * const cmd_class_names[CMD_CLASS_COUNT] = {
+	"startup", "selftest", "nv_read", "nv_write", "extend", "other",
+};
+
+/* How long a TPM takes to get a command, run it and return its response */
+struct latency_profile {
+	const char *name;
+	/* Fixed cost of each transaction on the bus, in usec */
+	uint32_t transaction_us;
+	/* Cost of each byte of the command and response, in nsec */
+	uint32_t byte_ns;
+	/* Time the TPM takes to run each kind of command, in usec */
+	uint32_t exec_us[CMD_CLASS_COUNT];
+};
+
+static struct latency_profile profiles[] = {
+	{
+		.name = "cr50_spi",
+		.transaction_us = 100,
+		.byte_ns = 5000,
+		.exec_us = {
+			[CMD_STARTUP] = 1000,
+			[CMD_SELFTEST] = 1000,
+			[CMD_NV_READ] = 1500,
+			[CMD_NV_WRITE] = 12000,
+			[CMD_EXTEND] = 1000,
+			[CMD_OTHER] = 500,
+		},
+	},
+	{
+		.name = "cr50_i2c",
+		.transaction_us = 200,
+		.byte_ns = 25000,
+		.exec_us = {
+			[CMD_STARTUP] = 1000,
+			[CMD_SELFTEST] = 1000,
+			[CMD_NV_READ] = 1500,
+			[CMD_NV_WRITE] = 12000,
+			[CMD_EXTEND] = 1000,
+			[CMD_OTHER] = 500,
+		},
+	},
+	{
+		.name = "lpc_tpm12",
+		.transaction_us = 20,
+		.byte_ns = 1000,
+		.exec_us = {
+			[CMD_STARTUP] = 3000,
+			[CMD_SELFTEST] = 40000,
+			[CMD_NV_READ] = 2000,
+			[CMD_NV_WRITE] = 25000,
+			[CMD_EXTEND] = 3000,
+			[CMD_OTHER] = 500,
+		},
+	},
+};
+
+static const struct option long_opts[] = {
+	{"profile", 1, NULL, 'p'},
+	{"latency", 1, NULL, 'l'},
+	{"no-fwmp", 0, NULL, 'f'},
+	{"help",    0, NULL, 'h'},
+	{NULL,      0, NULL, 0},
+};
+
+/* Set by -p; NULL to run every profile */
+static const char *profile_name;
+
+/* Set by -f */
+static int no_fwmp;
+
+/* Separator before the next JSON result */
+static const char *result_sep = "";
+
+/****************************************************************************/
+/* Simulated TPM */
+
+/* Profile of the TPM being simulated */
+static const struct latency_profile *tpm_profile;
+
+/* Simulated time, in nsec */
+static uint64_t sim_time_ns;
+
+/* An NV space, with what it holds */
+struct sim_space {
+	uint32_t index;
+	uint32_t size;
+	int defined;
+	uint8_t data[FWMP_NV_MAX_SIZE];
+};
+
+/* Spaces of the simulated TPM */
+static struct sim_space spaces[] = {
+	{.index = FIRMWARE_NV_INDEX, .size = sizeof(RollbackSpaceFirmware)},
+	{.index = KERNEL_NV_INDEX, .size = sizeof(RollbackSpaceKernel)},
+	{.index = FWMP_NV_INDEX, .size = sizeof(struct RollbackSpaceFwmp)},
+};
+
+static struct sim_space *find_space(uint32_t index)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(spaces); i++) {
+		if (spaces[i].defined && spaces[i].index == index)
+			return spaces + i;
+	}
+	return NULL;
+}
+
+/* Fills in the spaces as the factory leaves them */
+static void define_spaces(void)
+{
+	RollbackSpaceFirmware rsf = {
+		.struct_version = ROLLBACK_SPACE_FIRMWARE_VERSION,
+		.fw_versions = 0x10001,
+	};
+	RollbackSpaceKernel rsk = {
+		.struct_version = ROLLBACK_SPACE_KERNEL_VERSION,
+		.uid = ROLLBACK_SPACE_KERNEL_UID,
+		.kernel_versions = 0x10001,
+	};
+	struct RollbackSpaceFwmp fwmp = {
+		.struct_size = sizeof(fwmp),
+		.struct_version = ROLLBACK_SPACE_FWMP_VERSION,
+	};
+
+	rsf.crc8 = vb2_crc8(&rsf, offsetof(RollbackSpaceFirmware, crc8));
+	rsk.crc8 = vb2_crc8(&rsk, offsetof(RollbackSpaceKernel, crc8));
+	fwmp.crc = vb2_crc8((uint8_t *)&fwmp + 2, sizeof(fwmp) - 2);
+
+	memcpy(spaces[0].data, &rsf, sizeof(rsf));
+	memcpy(spaces[1].data, &rsk, sizeof(rsk));
+	memcpy(spaces[2].data, &fwmp, sizeof(fwmp));
+	spaces[0].defined = spaces[1].defined = 1;
+	spaces[2].defined = !no_fwmp;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+	return p[0] << 8 | p[1];
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+/* Offset of the first thing after the header of a command or response */
+#define SIM_HEADER_SIZE 10
+
+/*
+ * Reads length bytes of a space into out, or returns the TPM1.2 error code
+ * for why not.
+ */
+static uint32_t sim_nv_read(uint32_t index, uint32_t offset, uint32_t length,
+			    uint8_t *out)
+{
+	struct sim_space *s = find_space(index);
+
+	if (!s)
+		return TPM_E_BADINDEX;
+	if (offset > s->size || length > s->size - offset)
+		return TPM_E_IOERROR;
+	memcpy(out, s->data + offset, length);
+	return TPM_SUCCESS;
+}
+
+static uint32_t sim_nv_write(uint32_t index, uint32_t offset, uint32_t length,
+			     const uint8_t *data)
+{
+	struct sim_space *s;
+
+#ifndef TPM2_MODE
+	/* Writing nothing to index 0 is the global lock */
+	if (index == TPM_NV_INDEX0 && !length)
+		return TPM_SUCCESS;
+#endif
+
+	s = find_space(index);
+	if (!s)
+		return TPM_E_BADINDEX;
+	if (offset > s->size || length > s->size - offset)
+		return TPM_E_IOERROR;
+	memcpy(s->data + offset, data, length);
+	return TPM_SUCCESS;
+}
+
+#ifdef TPM2_MODE
+
+#define SIM_TPM_VERSION "2.0"
+#define SIM_BUFFER_SIZE TPM_BUFFER_SIZE
+
+/* Returned by a TPM2.0 for a missing NV index */
+#define SIM_TPM2_RC_HANDLE 0x28b
+
+/*
+ * Runs a TPM2.0 command.  Fills in the body of the response after its header,
+ * and its class and length.  Returns the response code.
+ */
+static uint32_t sim_command(const uint8_t *req, uint32_t req_size,
+			    uint8_t *rsp, uint32_t *rsp_size,
+			    enum cmd_class *class)
+{
+	uint32_t code = get_be32(req + 6);
+	/* Parameters follow the handles and the session, if there is one */
+	uint32_t params = SIM_HEADER_SIZE + 8;
+	uint32_t index, length, offset;
+	uint32_t rv;
+
+	if (req_size >= params + 4)
+		params += 4 + get_be32(req + params);
+	index = req_size >= 18 ? get_be32(req + 14) - HR_NV_INDEX : 0;
+
+	*rsp_size = SIM_HEADER_SIZE;
+	switch (code) {
+	case TPM2_Startup:
+		*class = CMD_STARTUP;
+		return TPM_SUCCESS;
+
+	case TPM2_SelfTest:
+		*class = CMD_SELFTEST;
+		return TPM_SUCCESS;
+
+	case TPM2_NV_Read:
+		*class = CMD_NV_READ;
+		if (req_size < params + 4)
+			return TPM_E_BADTAG;
+		length = get_be16(req + params);
+		offset = get_be16(req + params + 2);
+		rv = sim_nv_read(index, offset, length, rsp + 16);
+		if (rv == TPM_E_BADINDEX)
+			return SIM_TPM2_RC_HANDLE;
+		if (rv)
+			return rv;
+		/* parameterSize, the data, then the session */
+		put_be32(rsp + 10, 2 + length);
+		put_be16(rsp + 14, length);
+		memset(rsp + 16 + length, 0, 5);
+		*rsp_size = 16 + length + 5;
+		return TPM_SUCCESS;
+
+	case TPM2_NV_Write:
+		*class = CMD_NV_WRITE;
+		if (req_size < params + 2)
+			return TPM_E_BADTAG;
+		length = get_be16(req + params);
+		if (req_size < params + 2 + length + 2)
+			return TPM_E_BADTAG;
+		offset = get_be16(req + params + 2 + length);
+		rv = sim_nv_write(index, offset, length, req + params + 2);
+		return rv == TPM_E_BADINDEX ? SIM_TPM2_RC_HANDLE : rv;
+
+	case TPM2_GetCapability: {
+		/* Only one property is asked for at a time */
+		uint32_t property = get_be32(req + 14);
+		TPM_STCLEAR_FLAGS flags = {.phEnable = 1};
+		uint32_t value = 0;
+
+		*class = CMD_OTHER;
+		if (property == TPM_PT_STARTUP_CLEAR)
+			memcpy(&value, &flags, sizeof(value));
+		rsp[10] = 0;
+		put_be32(rsp + 11, TPM_CAP_TPM_PROPERTIES);
+		put_be32(rsp + 15, 1);
+		put_be32(rsp + 19, property);
+		put_be32(rsp + 23, value);
+		*rsp_size = 27;
+		return TPM_SUCCESS;
+	}
+
+	default:
+		/* Locks and the like, which return nothing */
+		*class = CMD_OTHER;
+		return TPM_SUCCESS;
+	}
+}
+
+#else  /* !TPM2_MODE */
+
+#define SIM_TPM_VERSION "1.2"
+#define SIM_BUFFER_SIZE TPM_LARGE_ENOUGH_COMMAND_SIZE
+
+/* Puts the TPM_PCR_INFO_SHORT of a space no PCRs protect at rsp */
+static uint32_t put_pcr_info(uint8_t *rsp)
+{
+	/* sizeOfSelect, pcrSelect, localityAtRelease, digestAtRelease */
+	put_be16(rsp, 3);
+	memset(rsp + 2, 0, 3 + 1 + TPM_PCR_DIGEST);
+	return 2 + 3 + 1 + TPM_PCR_DIGEST;
+}
+
+/*
+ * Runs a TPM1.2 command.  Fills in the body of the response after its header,
+ * and its class and length.  Returns the response code.
+ */
+static uint32_t sim_command(const uint8_t *req, uint32_t req_size,
+			    uint8_t *rsp, uint32_t *rsp_size,
+			    enum cmd_class *class)
+{
+	uint32_t ordinal = get_be32(req + 6);
+	uint32_t index = 0, offset = 0, length = 0;
+	uint32_t rv;
+
+	if (req_size >= SIM_HEADER_SIZE + 12) {
+		index = get_be32(req + SIM_HEADER_SIZE);
+		offset = get_be32(req + SIM_HEADER_SIZE + 4);
+		length = get_be32(req + SIM_HEADER_SIZE + 8);
+	}
+
+	*rsp_size = SIM_HEADER_SIZE;
+	switch (ordinal) {
+	case TPM_ORD_Startup:
+		*class = CMD_STARTUP;
+		return TPM_SUCCESS;
+
+	case TPM_ORD_ContinueSelfTest:
+	case TPM_ORD_SelfTestFull:
+		*class = CMD_SELFTEST;
+		return TPM_SUCCESS;
+
+	case TPM_ORD_NV_ReadValue:
+		*class = CMD_NV_READ;
+		rv = sim_nv_read(index, offset, length, rsp + 14);
+		if (rv)
+			return rv;
+		put_be32(rsp + 10, length);
+		*rsp_size = 14 + length;
+		return TPM_SUCCESS;
+
+	case TPM_ORD_NV_WriteValue:
+		/* The global lock writes nothing, so doesn't touch the NV */
+		*class = index == TPM_NV_INDEX0 && !length ?
+			CMD_OTHER : CMD_NV_WRITE;
+		if (req_size < SIM_HEADER_SIZE + 12 + length)
+			return TPM_E_BADTAG;
+		return sim_nv_write(index, offset, length,
+				    req + SIM_HEADER_SIZE + 12);
+
+	case TPM_ORD_Extend:
+		*class = CMD_EXTEND;
+		memset(rsp + 10, 0, TPM_PCR_DIGEST);
+		*rsp_size = 10 + TPM_PCR_DIGEST;
+		return TPM_SUCCESS;
+
+	case TPM_ORD_GetCapability: {
+		/* Only TPM_NV_DATA_PUBLIC of a space is asked for */
+		struct sim_space *s;
+		uint8_t *p = rsp + 14;
+
+		*class = CMD_OTHER;
+		if (req_size < SIM_HEADER_SIZE + 12 ||
+		    get_be32(req + SIM_HEADER_SIZE) != TPM_CAP_NV_INDEX)
+			return TPM_E_BAD_ORDINAL;
+		s = find_space(get_be32(req + SIM_HEADER_SIZE + 8));
+		if (!s)
+			return TPM_E_BADINDEX;
+		put_be16(p, TPM_TAG_NV_DATA_PUBLIC);
+		put_be32(p + 2, s->index);
+		p += 6;
+		p += put_pcr_info(p);
+		p += put_pcr_info(p);
+		put_be16(p, TPM_TAG_NV_ATTRIBUTES);
+		put_be32(p + 2, s->index == KERNEL_NV_INDEX ?
+			 TPM_NV_PER_PPWRITE : 0);
+		memset(p + 6, 0, 3);
+		put_be32(p + 9, s->size);
+		p += 13;
+		put_be32(rsp + 10, p - (rsp + 14));
+		*rsp_size = p - rsp;
+		return TPM_SUCCESS;
+	}
+
+	default:
+		/* Physical presence and the like, which return nothing */
+		*class = CMD_OTHER;
+		return TPM_SUCCESS;
+	}
+}
+
+#endif  /* TPM2_MODE */
+
+VbError_t VbExTpmInit(void)
+{
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExTpmClose(void)
+{
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExTpmOpen(void)
+{
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
+			     uint8_t *response, uint32_t *response_length)
+{
+	uint8_t rsp[SIM_BUFFER_SIZE];
+	uint32_t rsp_size;
+	enum cmd_class class;
+	uint16_t tag;
+	uint32_t rv;
+
+	if (request_length < SIM_HEADER_SIZE)
+		return VBERROR_SIMULATED;
+
+	memset(rsp, 0, sizeof(rsp));
+	rv = sim_command(request, request_length, rsp, &rsp_size, &class);
+	if (rv)
+		rsp_size = SIM_HEADER_SIZE;
+	if (rsp_size > *response_length)
+		return VBERROR_SIMULATED;
+
+	/* Responses have the tag of their command, or its TPM1.2 reply */
+	tag = get_be16(request);
+#ifndef TPM2_MODE
+	tag += TPM_TAG_RSP_COMMAND - TPM_TAG_RQU_COMMAND;
+#endif
+	put_be16(rsp, tag);
+	put_be32(rsp + 2, rsp_size);
+	put_be32(rsp + 6, rv);
+
+	/* The response may go in the request buffer, so it is copied last */
+	memcpy(response, rsp, rsp_size);
+	*response_length = rsp_size;
+
+	sim_time_ns += (uint64_t)tpm_profile->transaction_us * 1000 +
+		(uint64_t)tpm_profile->byte_ns * (request_length + rsp_size) +
+		(uint64_t)tpm_profile->exec_us[class] * 1000;
+
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExTpmGetRandom(uint8_t *buf, uint32_t length)
+{
+	memset(buf, 0xa5, length);
+	return VBERROR_SUCCESS;
+}
+
+uint64_t VbExGetTimer(void)
+{
+	return sim_time_ns / 1000;
+}
+
+/****************************************************************************/
+/* Boots */
+
+enum boot_mode {
+	BOOT_NORMAL,
+	BOOT_NORMAL_ROLLFORWARD,
+	BOOT_DEV,
+	BOOT_RECOVERY,
+	BOOT_MODE_COUNT,
+};
+
+static const char * const boot_mode_names[BOOT_MODE_COUNT] = {
+	"normal", "normal_rollforward", "dev", "recovery",
+};
+
+#define RETURN_ON_FAILURE(call) do {	\
+		uint32_t rv_ = (call);	\
+		if (rv_)		\
+			return rv_;	\
+	} while (0)
+
+/*
+ * TPM calls the firmware makes before vboot: set up the TPM, read the
+ * firmware space, measure the boot mode and lock the firmware space.  The
+ * first developer mode boot records the new mode in the firmware space.
+ */
+static uint32_t boot_firmware(enum boot_mode mode)
+{
+	RollbackSpaceFirmware rsf;
+	uint8_t digest[TPM_PCR_DIGEST] = {0};
+
+	RETURN_ON_FAILURE(TlclLibInit());
+	RETURN_ON_FAILURE(TlclStartup());
+	RETURN_ON_FAILURE(TlclContinueSelfTest());
+#ifndef TPM2_MODE
+	RETURN_ON_FAILURE(TlclAssertPhysicalPresence());
+#endif
+	RETURN_ON_FAILURE(TlclRead(FIRMWARE_NV_INDEX, &rsf, sizeof(rsf)));
+	if (mode == BOOT_DEV)
+		RETURN_ON_FAILURE(SetVirtualDevMode(1));
+	/* Boot mode and HWID */
+	RETURN_ON_FAILURE(TlclExtend(0, digest, digest));
+	RETURN_ON_FAILURE(TlclExtend(1, digest, digest));
+	RETURN_ON_FAILURE(TlclSetGlobalLock());
+	return TPM_SUCCESS;
+}
+
+/*
+ * TPM calls of VbSelectAndLoadKernel(): read the kernel space and FWMP,
+ * write a newer kernel version if one booted, and lock the kernel space
+ * unless in recovery.  Errors are ignored in recovery, as vboot does.
+ */
+static uint32_t boot_kernel(enum boot_mode mode)
+{
+	struct RollbackSpaceFwmp fwmp;
+	int recovery = mode == BOOT_RECOVERY;
+	uint32_t version;
+	uint32_t rv;
+
+	RollbackReadAhead(1);
+	rv = RollbackKernelRead(&version);
+	if (rv && !recovery)
+		return rv;
+	rv = RollbackFwmpRead(&fwmp);
+	if (rv && !recovery)
+		return rv;
+	if (mode == BOOT_NORMAL_ROLLFORWARD)
+		RETURN_ON_FAILURE(RollbackKernelWrite(version + 1));
+	if (!recovery)
+		RETURN_ON_FAILURE(RollbackKernelLock(0));
+	return TPM_SUCCESS;
+}
+
+/*
+ * Runs one boot, from a freshly reset TPM, and prints its result.  Returns
+ * the error which stopped the boot, or TPM_SUCCESS.
+ */
+static uint32_t run_boot(const struct latency_profile *profile,
+		     enum boot_mode mode)
+{
+	const struct vb2_tpm_stat *stats;
+	uint64_t total = 0;
+	uint32_t count, commands = 0, i;
+	uint32_t rv;
+
+	tpm_profile = profile;
+	sim_time_ns = 0;
+	define_spaces();
+	TlclStatsReset();
+
+	rv = boot_firmware(mode);
+	if (!rv)
+		rv = boot_kernel(mode);
+
+	stats = TlclGetStats(&count);
+	for (i = 0; i < count; i++) {
+		commands += stats[i].count;
+		total += stats[i].total_time;
+	}
+
+	printf("%s    {\"profile\": \"%s\", \"boot\": \"%s\", "
+	       "\"result\": %u, \"commands\": %u, \"total_time\": %" PRIu64
+	       ", \"commands_by_code\": [",
+	       result_sep, profile->name, boot_mode_names[mode], rv,
+	       commands, total);
+	for (i = 0; i < count; i++)
+		printf("%s{\"code\": \"0x%x\", \"count\": %u, "
+		       "\"total_time\": %" PRIu64 "}",
+		       i ? ", " : "", stats[i].command_code, stats[i].count,
+		       stats[i].total_time);
+	printf("]}");
+	return rv;
+}
+
+/*
+ * Runs each boot in its own process, so that it starts with nothing left over
+ * in tlcl and rollback_index from the one before.  Returns 0 if the boot
+ * succeeded.
+ */
+static int run_boot_process(const struct latency_profile *profile,
+			    enum boot_mode mode)
+{
+	uint32_t rv;
+	pid_t pid;
+	int status, errorcnt = 0;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid) {
+		rv = run_boot(profile, mode);
+		fflush(stdout);
+		_exit(rv ? 1 : 0);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		fprintf(stderr, "%s %s boot failed\n", profile->name,
+			boot_mode_names[mode]);
+		errorcnt = 1;
+	}
+	result_sep = ",\n";
+	return errorcnt;
+}
+
+/****************************************************************************/
+
+/* Whether the name before the = of a -l argument is name */
+static int latency_is(const char *arg, const char *eq, const char *name)
+{
+	return strlen(name) == eq - arg && !strncmp(arg, name, eq - arg);
+}
+
+/* Parses CLASS=USEC for -l, and sets that latency in every profile */
+static int set_latency(const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	char *e;
+	long us;
+	int class, i;
+
+	if (!eq)
+		return 1;
+	us = strtol(eq + 1, &e, 0);
+	if (!eq[1] || *e || us < 0)
+		return 1;
+
+	for (class = 0; class < CMD_CLASS_COUNT; class++) {
+		if (latency_is(arg, eq, cmd_class_names[class]))
+			break;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+		if (latency_is(arg, eq, "transaction"))
+			profiles[i].transaction_us = us;
+		else if (latency_is(arg, eq, "byte_ns"))
+			profiles[i].byte_ns = us;
+		else if (class < CMD_CLASS_COUNT)
+			profiles[i].exec_us[class] = us;
+		else
+			return 1;
+	}
+	return 0;
+}
+
+static void print_help(const char *progname)
+{
+	int i;
+
+	fprintf(stderr,
+		"Usage: %s [-p PROFILE] [-l CLASS=USEC]... [-f]\n"
+		"\n"
+		"  -p|--profile  PROFILE     Only simulate this TPM:",
+		progname);
+	for (i = 0; i < ARRAY_SIZE(profiles); i++)
+		fprintf(stderr, " %s", profiles[i].name);
+	fprintf(stderr,
+		"\n"
+		"  -l|--latency  CLASS=USEC  Time to run one command of CLASS:");
+	for (i = 0; i < CMD_CLASS_COUNT; i++)
+		fprintf(stderr, " %s", cmd_class_names[i]);
+	fprintf(stderr,
+		";\n"
+		"                            or transaction (usec) or byte_ns\n"
+		"  -f|--no-fwmp              Simulate a TPM without an FWMP\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int errorcnt = 0;
+	int found = 0;
+	int i, mode;
+
+	while ((i = getopt_long(argc, argv, "p:l:fh", long_opts, NULL)) != -1) {
+		switch (i) {
+		case 'p':
+			profile_name = optarg;
+			break;
+		case 'l':
+			if (set_latency(optarg)) {
+				fprintf(stderr, "Invalid --latency %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'f':
+			no_fwmp = 1;
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+		if (!profile_name || !strcmp(profile_name, profiles[i].name))
+			found++;
+	}
+	if (!found) {
+		fprintf(stderr, "Unknown --profile %s\n", profile_name);
+		return 1;
+	}
+
+	printf("{\n  \"unit\": \"us\",\n  \"tpm\": \"%s\",\n"
+	       "  \"results\": [\n", SIM_TPM_VERSION);
+
+	for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+		if (profile_name && strcmp(profile_name, profiles[i].name))
+			continue;
+		for (mode = 0; mode < BOOT_MODE_COUNT; mode++)
+			errorcnt += run_boot_process(profiles + i, mode);
+	}
+
+	printf("\n  ]\n}\n");
+
+	return errorcnt ? 1 : 0;
+}
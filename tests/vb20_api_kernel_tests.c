@@ -42,6 +42,15 @@ static int mock_read_gbb_header_retval;
 static int mock_load_kernel_keyblock_retval;
 static int mock_load_kernel_preamble_retval;
 
+static enum hwcrypto_state {
+	HWCRYPTO_DISABLED,
+	HWCRYPTO_ENABLED,
+	HWCRYPTO_FORBIDDEN,
+} hwcrypto_state;
+static struct vb2_digest_context hwcrypto_dc;
+static int hwcrypto_used;
+static int mock_allow_hwcrypto;
+
 /* Type of test to reset for */
 enum reset_type {
 	FOR_PHASE1,
@@ -73,6 +82,9 @@ static void reset_common_data(enum reset_type t)
 	mock_read_gbb_header_retval = VB2_SUCCESS;
 	mock_load_kernel_keyblock_retval = VB2_SUCCESS;
 	mock_load_kernel_preamble_retval = VB2_SUCCESS;
+	hwcrypto_state = HWCRYPTO_DISABLED;
+	hwcrypto_used = 0;
+	mock_allow_hwcrypto = -1;
 
 	/* Recovery key in mock GBB */
 	mock_gbb.recovery_key.algorithm = 11;
@@ -124,6 +136,9 @@ static void reset_common_data(enum reset_type t)
 		kpre = (struct vb2_kernel_preamble *)
 			(ctx.workbuf + sd->workbuf_preamble_offset);
 		sdata = (uint8_t *)kpre + sizeof(*kpre);
+		kpre->header_version_minor = KERNEL_PREAMBLE_HEADER_VERSION_MINOR;
+		kpre->flags = 0;
+		kpre->body_chunk_size = 0;
 
 		sig = &kpre->body_signature;
 		sig->data_size = sizeof(kernel_data);
@@ -150,6 +165,40 @@ static void reset_common_data(enum reset_type t)
 	}
 };
 
+/* Make the mock kernel preamble hash the body in chunks */
+static void make_chunked_preamble(uint32_t chunk_size)
+{
+	struct vb2_signature *sig = &kpre->body_signature;
+	uint8_t *table = (uint8_t *)sig + sig->sig_offset + sig->sig_size;
+	uint32_t count = (sizeof(kernel_data) + chunk_size - 1) / chunk_size;
+	uint32_t i, n;
+
+	kpre->body_chunk_size = chunk_size;
+	kpre->body_chunk_digests_offset = vb2_offset_of(kpre, table);
+	kpre->body_chunk_digests_size = count * VB2_SHA256_DIGEST_SIZE;
+
+	for (i = 0; i < count; i++) {
+		n = sizeof(kernel_data) - i * chunk_size;
+		if (n > chunk_size)
+			n = chunk_size;
+		vb2_digest_buffer((const uint8_t *)kernel_data + i * chunk_size,
+				  n, VB2_HASH_SHA256,
+				  table + i * VB2_SHA256_DIGEST_SIZE,
+				  VB2_SHA256_DIGEST_SIZE);
+	}
+
+	/* The body signature signs the table instead of the body */
+	sig->sig_size = VB2_SHA256_DIGEST_SIZE;
+	vb2_digest_buffer(table, kpre->body_chunk_digests_size,
+			  VB2_HASH_SHA256, (uint8_t *)sig + sig->sig_offset,
+			  sig->sig_size);
+
+	sd->workbuf_preamble_size = kpre->body_chunk_digests_offset +
+		kpre->body_chunk_digests_size;
+	vb2_set_workbuf_used(&ctx, sd->workbuf_preamble_offset +
+			     sd->workbuf_preamble_size);
+}
+
 /* Mocked functions */
 
 int vb2ex_read_resource(struct vb2_context *c,
@@ -212,12 +261,44 @@ int vb2_verify_digest(const struct vb2_public_key *key,
 		      const uint8_t *digest,
 		      const struct vb2_workbuf *wb)
 {
+	mock_allow_hwcrypto = key->allow_hwcrypto;
 	if (memcmp(digest, (uint8_t *)sig + sig->sig_offset, sig->sig_size))
 		return VB2_ERROR_VDATA_VERIFY_DIGEST;
 
 	return VB2_SUCCESS;
 }
 
+int vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+			       uint32_t data_size)
+{
+	switch (hwcrypto_state) {
+	case HWCRYPTO_DISABLED:
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	case HWCRYPTO_ENABLED:
+		hwcrypto_used = 1;
+		return vb2_digest_init(&hwcrypto_dc, hash_alg);
+	case HWCRYPTO_FORBIDDEN:
+	default:
+		return VB2_ERROR_UNKNOWN;
+	}
+}
+
+int vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	if (hwcrypto_state != HWCRYPTO_ENABLED)
+		return VB2_ERROR_UNKNOWN;
+
+	return vb2_digest_extend(&hwcrypto_dc, buf, size);
+}
+
+int vb2ex_hwcrypto_digest_finalize(uint8_t *digest, uint32_t digest_size)
+{
+	if (hwcrypto_state != HWCRYPTO_ENABLED)
+		return VB2_ERROR_UNKNOWN;
+
+	return vb2_digest_finalize(&hwcrypto_dc, digest, digest_size);
+}
+
 /* Tests */
 
 static void phase1_tests(void)
@@ -376,7 +457,7 @@ static void verify_kernel_data_tests(void)
 
 	reset_common_data(FOR_PHASE2);
 	ctx.workbuf_used = ctx.workbuf_size + VB2_WORKBUF_ALIGN -
-			vb2_wb_round_up(sizeof(struct vb2_digest_context));
+		vb2_wb_round_up(vb2_digest_context_size(VB2_HASH_SHA256));
 	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
 					  sizeof(kernel_data)),
 		VB2_ERROR_API_VERIFY_KDATA_WORKBUF, "verify workbuf");
@@ -401,7 +482,7 @@ static void verify_kernel_data_tests(void)
 
 	reset_common_data(FOR_PHASE2);
 	ctx.workbuf_used = ctx.workbuf_size -
-			vb2_wb_round_up(sizeof(struct vb2_digest_context));
+		vb2_wb_round_up(vb2_digest_context_size(VB2_HASH_SHA256));
 	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
 					  sizeof(kernel_data)),
 		VB2_ERROR_API_CHECK_HASH_WORKBUF_DIGEST, "verify hash workbuf");
@@ -412,6 +493,132 @@ static void verify_kernel_data_tests(void)
 					  sizeof(kernel_data)),
 		VB2_ERROR_VDATA_VERIFY_DIGEST, "verify hash digest");
 	kernel_data[3] ^= 0xd0;
+
+	/* Hardware crypto */
+	reset_common_data(FOR_PHASE2);
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	TEST_SUCC(vb2api_verify_kernel_data(&ctx, kernel_data,
+					    sizeof(kernel_data)),
+		  "verify data hwcrypto");
+	TEST_EQ(hwcrypto_used, 1, "  used hwcrypto");
+	TEST_EQ(mock_allow_hwcrypto, 1, "  allowed hwcrypto RSA");
+
+	reset_common_data(FOR_PHASE2);
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	kernel_data[3] ^= 0xd0;
+	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
+					  sizeof(kernel_data)),
+		VB2_ERROR_VDATA_VERIFY_DIGEST, "verify hwcrypto digest");
+	kernel_data[3] ^= 0xd0;
+
+	reset_common_data(FOR_PHASE2);
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	kdkey->algorithm = VB2_ALG_COUNT;
+	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
+					  sizeof(kernel_data)),
+		VB2_ERROR_SHA_INIT_ALGORITHM, "verify hwcrypto init");
+
+	reset_common_data(FOR_PHASE2);
+	hwcrypto_state = HWCRYPTO_FORBIDDEN;
+	kpre->header_version_minor = 2;
+	kpre->flags = VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO;
+	TEST_SUCC(vb2api_verify_kernel_data(&ctx, kernel_data,
+					    sizeof(kernel_data)),
+		  "verify data hwcrypto forbidden");
+	TEST_EQ(hwcrypto_used, 0, "  used sw");
+	TEST_EQ(mock_allow_hwcrypto, 0, "  forbade hwcrypto RSA");
+
+	/* Preambles older than 2.2 have no flags */
+	reset_common_data(FOR_PHASE2);
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	kpre->header_version_minor = 1;
+	kpre->flags = VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO;
+	TEST_SUCC(vb2api_verify_kernel_data(&ctx, kernel_data,
+					    sizeof(kernel_data)),
+		  "verify data hwcrypto old preamble");
+	TEST_EQ(hwcrypto_used, 1, "  used hwcrypto");
+	TEST_EQ(mock_allow_hwcrypto, 1, "  allowed hwcrypto RSA");
+
+	/* Bodies hashed in chunks */
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	TEST_SUCC(vb2api_verify_kernel_data(&ctx, kernel_data,
+					    sizeof(kernel_data)),
+		  "verify data chunked");
+	TEST_EQ(hwcrypto_used, 0, "  used sw");
+
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	kernel_data[0x4004] ^= 0xd0;
+	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
+					  sizeof(kernel_data)),
+		VB2_ERROR_API_BODY_CHUNK_DIGEST, "verify chunked digest");
+	kernel_data[0x4004] ^= 0xd0;
+
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	kpre->body_chunk_digests_size -= 1;
+	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
+					  sizeof(kernel_data)),
+		VB2_ERROR_VDATA_VERIFY_DIGEST, "verify chunked table sig");
+
+	/* Preambles older than 2.3 aren't chunked */
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	kpre->header_version_minor = 2;
+	TEST_EQ(vb2api_verify_kernel_data(&ctx, kernel_data,
+					  sizeof(kernel_data)),
+		VB2_ERROR_VDATA_VERIFY_DIGEST, "verify chunked old preamble");
+}
+
+static void body_chunk_tests(void)
+{
+	uint32_t chunk_size, count;
+
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	TEST_SUCC(vb2api_get_kernel_body_chunks(&ctx, &chunk_size, &count),
+		  "get chunks good");
+	TEST_EQ(chunk_size, 0x1000, "  chunk size");
+	TEST_EQ(count, 5, "  count");
+
+	reset_common_data(FOR_PHASE2);
+	TEST_EQ(vb2api_get_kernel_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_BODY_NOT_CHUNKED, "get chunks not chunked");
+
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	sd->workbuf_preamble_size = 0;
+	TEST_EQ(vb2api_get_kernel_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_VERIFY_KDATA_PREAMBLE, "get chunks no preamble");
+
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	sd->workbuf_data_key_size = 0;
+	TEST_EQ(vb2api_get_kernel_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_VERIFY_KDATA_KEY, "get chunks no key");
+
+	/* Chunks can be checked in any order */
+	reset_common_data(FOR_PHASE2);
+	make_chunked_preamble(0x1000);
+	TEST_SUCC(vb2api_check_kernel_body_chunk(&ctx, 4, kernel_data + 0x4000,
+						 8), "check last chunk");
+	TEST_SUCC(vb2api_check_kernel_body_chunk(&ctx, 1, kernel_data + 0x1000,
+						 0x1000), "check chunk 1");
+
+	TEST_EQ(vb2api_check_kernel_body_chunk(&ctx, 5, kernel_data + 0x4000,
+					       8),
+		VB2_ERROR_API_BODY_CHUNK_INDEX, "check chunk index");
+	TEST_EQ(vb2api_check_kernel_body_chunk(&ctx, 4, kernel_data + 0x4000,
+					       0x1000),
+		VB2_ERROR_API_BODY_CHUNK_SIZE, "check chunk size");
+	TEST_EQ(vb2api_check_kernel_body_chunk(&ctx, 2, kernel_data, 0x1000),
+		VB2_ERROR_API_BODY_CHUNK_DIGEST, "check chunk digest");
+
+	reset_common_data(FOR_PHASE2);
+	TEST_EQ(vb2api_check_kernel_body_chunk(&ctx, 0, kernel_data, 0x1000),
+		VB2_ERROR_API_BODY_NOT_CHUNKED, "check chunk not chunked");
 }
 
 static void phase3_tests(void)
@@ -459,6 +666,7 @@ int main(int argc, char* argv[])
 	load_kernel_vblock_tests();
 	get_kernel_size_tests();
 	verify_kernel_data_tests();
+	body_chunk_tests();
 	phase3_tests();
 
 	return gTestSuccess ? 0 : 255;
@@ -42,6 +42,12 @@ static int retval_vb2_load_fw_keyblock;
 static int retval_vb2_load_fw_preamble;
 static int retval_vb2_digest_finalize;
 static int retval_vb2_verify_digest;
+static int mock_hwcrypto_rsa_used;
+static uint32_t mock_chunk_size;
+static uint32_t mock_last_timestamp;
+static int mock_timestamp_count;
+static struct vb2_warm_boot_record mock_record;
+static int mock_record_saved;
 
 /* Type of test to reset for */
 enum reset_type {
@@ -50,6 +56,12 @@ enum reset_type {
 	FOR_CHECK_HASH,
 };
 
+static void fill_digest(uint8_t *digest, uint32_t digest_size)
+{
+	/* Set the result to a known value. */
+	memset(digest, 0x0a, digest_size);
+}
+
 static void reset_common_data(enum reset_type t)
 {
 	struct vb2_fw_preamble *pre;
@@ -73,13 +85,13 @@ static void reset_common_data(enum reset_type t)
 	retval_vb2_load_fw_preamble = VB2_SUCCESS;
 	retval_vb2_digest_finalize = VB2_SUCCESS;
 	retval_vb2_verify_digest = VB2_SUCCESS;
+	mock_hwcrypto_rsa_used = 0;
 
 	sd->workbuf_preamble_offset = ctx.workbuf_used;
 	sd->workbuf_preamble_size = sizeof(*pre);
-	vb2_set_workbuf_used(&ctx, sd->workbuf_preamble_offset
-			     + sd->workbuf_preamble_size);
 	pre = (struct vb2_fw_preamble *)
 		(ctx.workbuf + sd->workbuf_preamble_offset);
+	pre->header_version_minor = FIRMWARE_PREAMBLE_HEADER_VERSION_MINOR;
 	pre->body_signature.data_size = mock_body_size;
 	pre->body_signature.sig_size = mock_sig_size;
 	if (hwcrypto_state == HWCRYPTO_FORBIDDEN)
@@ -87,6 +99,20 @@ static void reset_common_data(enum reset_type t)
 	else
 		pre->flags = 0;
 
+	/* Table of chunk digests follows the preamble, all from the mocks */
+	pre->body_chunk_size = mock_chunk_size;
+	pre->body_chunk_digests_offset = sizeof(*pre);
+	pre->body_chunk_digests_size = 0;
+	if (mock_chunk_size)
+		pre->body_chunk_digests_size = VB2_SHA256_DIGEST_SIZE *
+			((mock_body_size + mock_chunk_size - 1) /
+			 mock_chunk_size);
+	fill_digest((uint8_t *)pre + pre->body_chunk_digests_offset,
+		    pre->body_chunk_digests_size);
+	sd->workbuf_preamble_size += pre->body_chunk_digests_size;
+	vb2_set_workbuf_used(&ctx, sd->workbuf_preamble_offset
+			     + sd->workbuf_preamble_size);
+
 	sd->workbuf_data_key_offset = ctx.workbuf_used;
 	sd->workbuf_data_key_size = sizeof(*k) + 8;
 	vb2_set_workbuf_used(&ctx, sd->workbuf_data_key_offset +
@@ -103,10 +129,20 @@ static void reset_common_data(enum reset_type t)
 
 	/* Always clear out the digest result. */
 	memset(digest_result, 0, digest_result_size);
+
+	/* Only count timestamps from the function being tested */
+	mock_last_timestamp = 0;
+	mock_timestamp_count = 0;
 };
 
 /* Mocked functions */
 
+void vb2ex_timestamp(enum vb2_timestamp_id id)
+{
+	mock_last_timestamp = id;
+	mock_timestamp_count++;
+}
+
 int vb2_load_fw_keyblock(struct vb2_context *c)
 {
 	return retval_vb2_load_fw_keyblock;
@@ -149,6 +185,22 @@ int vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
 	}
 }
 
+int vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+				     const uint8_t *sig,
+				     const uint8_t *digest)
+{
+	switch (hwcrypto_state) {
+	case HWCRYPTO_DISABLED:
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	case HWCRYPTO_ENABLED:
+		mock_hwcrypto_rsa_used = 1;
+		return retval_vb2_verify_digest;
+	case HWCRYPTO_FORBIDDEN:
+	default:
+		return VB2_ERROR_UNKNOWN;
+	}
+}
+
 int vb2ex_hwcrypto_digest_extend(const uint8_t *buf,
 				 uint32_t size)
 {
@@ -158,12 +210,6 @@ int vb2ex_hwcrypto_digest_extend(const uint8_t *buf,
 	return VB2_SUCCESS;
 }
 
-static void fill_digest(uint8_t *digest, uint32_t digest_size)
-{
-	/* Set the result to a known value. */
-	memset(digest, 0x0a, digest_size);
-}
-
 int vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
 				   uint32_t digest_size)
 {
@@ -187,6 +233,9 @@ int vb2_digest_init(struct vb2_digest_context *dc,
 	dc->hash_alg = hash_alg;
 	dc->using_hwcrypto = 0;
 
+	/* Hash sessions extend the SHA-256 context directly */
+	vb2_sha256_init(&dc->sha256);
+
 	return VB2_SUCCESS;
 }
 
@@ -228,12 +277,34 @@ int vb2_rsa_verify_digest(const struct vb2_public_key *key,
 	return retval_vb2_verify_digest;
 }
 
+int vb2ex_warm_boot_state(uint8_t *nonce, uint32_t *flash_write_count)
+{
+	memset(nonce, 0x5a, VB2_WARM_BOOT_NONCE_SIZE);
+	*flash_write_count = 7;
+	return VB2_SUCCESS;
+}
+
+int vb2ex_warm_boot_record_read(struct vb2_warm_boot_record *rec)
+{
+	memcpy(rec, &mock_record, sizeof(*rec));
+	return VB2_SUCCESS;
+}
+
+int vb2ex_warm_boot_record_write(const struct vb2_warm_boot_record *rec)
+{
+	memcpy(&mock_record, rec, sizeof(mock_record));
+	mock_record_saved++;
+	return VB2_SUCCESS;
+}
+
 /* Tests */
 
 static void phase3_tests(void)
 {
 	reset_common_data(FOR_MISC);
 	TEST_SUCC(vb2api_fw_phase3(&ctx), "phase3 good");
+	TEST_EQ(mock_timestamp_count, 2, "  timestamps");
+	TEST_EQ(mock_last_timestamp, VB2_TS_FW_PHASE3_END, "  end");
 
 	reset_common_data(FOR_MISC);
 	retval_vb2_load_fw_keyblock = VB2_ERROR_MOCK;
@@ -261,7 +332,7 @@ static void init_hash_tests(void)
 		  "init hash good");
 	TEST_EQ(sd->workbuf_hash_offset, wb_used_before,
 		"hash context offset");
-	TEST_EQ(sd->workbuf_hash_size, sizeof(struct vb2_digest_context),
+	TEST_EQ(sd->workbuf_hash_size, vb2_digest_context_size(mock_hash_alg),
 		"hash context size");
 	TEST_EQ(ctx.workbuf_used,
 		vb2_wb_round_up(sd->workbuf_hash_offset +
@@ -290,7 +361,7 @@ static void init_hash_tests(void)
 
 	reset_common_data(FOR_MISC);
 	ctx.workbuf_used = ctx.workbuf_size + VB2_WORKBUF_ALIGN -
-			vb2_wb_round_up(sizeof(struct vb2_digest_context));
+			vb2_wb_round_up(vb2_digest_context_size(mock_hash_alg));
 	TEST_EQ(vb2api_init_hash(&ctx, VB2_HASH_TAG_FW_BODY, &size),
 		VB2_ERROR_API_INIT_HASH_WORKBUF, "init hash workbuf");
 
@@ -314,6 +385,7 @@ static void init_hash_tests(void)
 static void extend_hash_tests(void)
 {
 	struct vb2_digest_context *dc;
+	struct vb2_hash_session hs;
 
 	reset_common_data(FOR_EXTEND_HASH);
 	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body, 32),
@@ -345,6 +417,64 @@ static void extend_hash_tests(void)
 		TEST_EQ(vb2api_extend_hash(&ctx, mock_body, mock_body_size),
 			VB2_ERROR_SHA_EXTEND_ALGORITHM, "hash extend fail");
 	}
+
+	/* The same through a hash session */
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_init_hash_session(&ctx, &hs), "hash session");
+	TEST_SUCC(vb2api_extend_hash_session(&hs, mock_body, 32),
+		  "  extend");
+	TEST_EQ(sd->hash_remaining_size, mock_body_size - 32,
+		"  remaining");
+	TEST_EQ(vb2api_extend_hash_session(&hs, mock_body, mock_body_size),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "  extend too much");
+	TEST_EQ(vb2api_extend_hash_session(&hs, mock_body, 0),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "  extend empty");
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body, 16),
+		  "  mixed with vb2api_extend_hash()");
+	TEST_SUCC(vb2api_extend_hash_session(&hs, mock_body,
+					     mock_body_size - 48),
+		  "  extend the rest");
+	TEST_EQ(sd->hash_remaining_size, 0, "  remaining 2");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->workbuf_hash_size = 0;
+	TEST_EQ(vb2api_init_hash_session(&ctx, &hs),
+		VB2_ERROR_API_EXTEND_HASH_WORKBUF, "hash session no workbuf");
+
+	if (hwcrypto_state != HWCRYPTO_ENABLED) {
+		reset_common_data(FOR_EXTEND_HASH);
+		dc = (struct vb2_digest_context *)
+			(ctx.workbuf + sd->workbuf_hash_offset);
+		dc->hash_alg = VB2_HASH_INVALID;
+		TEST_EQ(vb2api_init_hash_session(&ctx, &hs),
+			VB2_ERROR_SHA_EXTEND_ALGORITHM, "hash session bad alg");
+	}
+
+	/* Hashing a mapped region */
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_hash_mapped_region(&ctx, mock_body, mock_body_size),
+		  "hash mapped region");
+	TEST_EQ(sd->hash_remaining_size, 0, "  remaining");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body, 32),
+		  "hash mapped region after extend");
+	TEST_SUCC(vb2api_hash_mapped_region(&ctx, mock_body + 32,
+					    mock_body_size - 32), "  rest");
+	TEST_EQ(sd->hash_remaining_size, 0, "  remaining");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(vb2api_hash_mapped_region(&ctx, mock_body, mock_body_size + 1),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash mapped region too big");
+	TEST_EQ(sd->hash_remaining_size, mock_body_size, "  nothing hashed");
+	TEST_EQ(vb2api_hash_mapped_region(&ctx, mock_body, 0),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash mapped region empty");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->workbuf_hash_size = 0;
+	TEST_EQ(vb2api_hash_mapped_region(&ctx, mock_body, mock_body_size),
+		VB2_ERROR_API_EXTEND_HASH_WORKBUF,
+		"hash mapped region no workbuf");
 }
 
 static void check_hash_tests(void)
@@ -354,6 +484,17 @@ static void check_hash_tests(void)
 
 	reset_common_data(FOR_CHECK_HASH);
 	TEST_SUCC(vb2api_check_hash(&ctx), "check hash good");
+	TEST_EQ(mock_timestamp_count, 2, "  timestamps");
+	TEST_EQ(mock_last_timestamp, VB2_TS_FW_BODY_VERIFIED, "  verified");
+	TEST_EQ(sd->costs[VB2_COST_FW_BODY].count, 1, "  cost count");
+	TEST_EQ(sd->costs[VB2_COST_FW_BODY].hashed_bytes, mock_body_size,
+		"  cost hashed bytes");
+	TEST_EQ(mock_hwcrypto_rsa_used, hwcrypto_state == HWCRYPTO_ENABLED,
+		"  hwcrypto RSA");
+
+	reset_common_data(FOR_CHECK_HASH);
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	TEST_EQ(vb2api_check_hash(&ctx), VB2_ERROR_MOCK, "check hash bad sig");
 
 	reset_common_data(FOR_CHECK_HASH);
 	TEST_SUCC(vb2api_check_hash_get_digest(&ctx, digest_result,
@@ -392,6 +533,7 @@ static void check_hash_tests(void)
 	reset_common_data(FOR_CHECK_HASH);
 	retval_vb2_digest_finalize = VB2_ERROR_MOCK;
 	TEST_EQ(vb2api_check_hash(&ctx),	VB2_ERROR_MOCK, "check hash finalize");
+	TEST_EQ(mock_timestamp_count, 0, "  no timestamps");
 
 	reset_common_data(FOR_CHECK_HASH);
 	sd->hash_tag = VB2_HASH_TAG_INVALID;
@@ -421,6 +563,175 @@ static void check_hash_tests(void)
 		VB2_ERROR_RSA_VERIFY_DIGEST, "check hash finalize");
 }
 
+static void warm_boot_tests(void)
+{
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+
+	fill_digest(digest, sizeof(digest));
+
+	/* A fully verified body is recorded */
+	reset_common_data(FOR_CHECK_HASH);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	mock_record_saved = 0;
+	TEST_SUCC(vb2api_check_hash(&ctx), "warm boot record saved");
+	TEST_EQ(mock_record_saved, 1, "  saved");
+	TEST_SUCC(memcmp(mock_record.body_digest, digest, sizeof(digest)),
+		  "  body digest");
+
+	reset_common_data(FOR_CHECK_HASH);
+	mock_record_saved = 0;
+	TEST_SUCC(vb2api_check_hash(&ctx), "warm boot not enabled");
+	TEST_EQ(mock_record_saved, 0, "  not saved");
+
+	reset_common_data(FOR_CHECK_HASH);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	mock_record_saved = 0;
+	TEST_EQ(vb2api_check_hash(&ctx), VB2_ERROR_MOCK,
+		"warm boot bad body");
+	TEST_EQ(mock_record_saved, 0, "  not saved");
+
+	/* A recorded body skips the signature check */
+	reset_common_data(FOR_CHECK_HASH);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	sd->status |= VB2_SD_STATUS_WARM_BOOT_MATCH;
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	TEST_SUCC(vb2api_check_hash(&ctx), "warm boot skips body sig");
+	TEST_EQ(mock_last_timestamp, VB2_TS_FW_BODY_VERIFIED, "  verified");
+
+	/* Only if the vblock matched too */
+	reset_common_data(FOR_CHECK_HASH);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	TEST_EQ(vb2api_check_hash(&ctx), VB2_ERROR_MOCK,
+		"warm boot vblock didn't match");
+
+	/* And the body matches */
+	reset_common_data(FOR_CHECK_HASH);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	sd->status |= VB2_SD_STATUS_WARM_BOOT_MATCH;
+	mock_record.body_digest[0]++;
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	TEST_EQ(vb2api_check_hash(&ctx), VB2_ERROR_MOCK,
+		"warm boot body changed");
+}
+
+static void body_chunk_tests(void)
+{
+	struct vb2_fw_preamble *pre;
+	struct vb2_hash_session hs;
+	uint8_t *table;
+	uint32_t chunk_size, count;
+
+	mock_chunk_size = 128;
+
+	reset_common_data(FOR_MISC);
+	pre = (struct vb2_fw_preamble *)
+		(ctx.workbuf + sd->workbuf_preamble_offset);
+	table = (uint8_t *)pre + pre->body_chunk_digests_offset;
+	TEST_SUCC(vb2api_get_body_chunks(&ctx, &chunk_size, &count),
+		  "get body chunks");
+	TEST_EQ(chunk_size, mock_chunk_size, "  chunk size");
+	TEST_EQ(count, 3, "  count");
+
+	TEST_SUCC(vb2api_check_body_chunk(&ctx, 0, mock_body, 128),
+		  "check body chunk 0");
+	TEST_SUCC(vb2api_check_body_chunk(&ctx, 2, mock_body + 256, 64),
+		  "check last body chunk");
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 3, mock_body, 64),
+		VB2_ERROR_API_BODY_CHUNK_INDEX, "check body chunk index");
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 2, mock_body + 256, 128),
+		VB2_ERROR_API_BODY_CHUNK_SIZE, "check last body chunk size");
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 1, mock_body + 128, 127),
+		VB2_ERROR_API_BODY_CHUNK_SIZE, "check body chunk size");
+	table[VB2_SHA256_DIGEST_SIZE]++;
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 1, mock_body + 128, 128),
+		VB2_ERROR_API_BODY_CHUNK_DIGEST, "check body chunk digest");
+	TEST_SUCC(vb2api_check_body_chunk(&ctx, 0, mock_body, 128),
+		  "  other chunks still good");
+
+	reset_common_data(FOR_MISC);
+	sd->workbuf_preamble_size = 0;
+	TEST_EQ(vb2api_get_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_INIT_HASH_PREAMBLE, "get body chunks preamble");
+
+	reset_common_data(FOR_MISC);
+	sd->workbuf_data_key_size = 0;
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 0, mock_body, 128),
+		VB2_ERROR_API_INIT_HASH_DATA_KEY, "check body chunk data key");
+
+	reset_common_data(FOR_MISC);
+	pre = (struct vb2_fw_preamble *)
+		(ctx.workbuf + sd->workbuf_preamble_offset);
+	pre->body_chunk_digests_size -= VB2_SHA256_DIGEST_SIZE;
+	TEST_EQ(vb2api_get_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_INIT_HASH_CHUNKS, "get body chunks table size");
+	TEST_EQ(vb2api_init_hash(&ctx, VB2_HASH_TAG_FW_BODY, NULL),
+		VB2_ERROR_API_INIT_HASH_CHUNKS, "init hash table size");
+
+	/* Hash the body in pieces which don't line up with the chunks */
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(sd->hash_chunk_size, mock_chunk_size, "init hash chunked");
+	TEST_EQ(sd->hash_chunk_remaining_size, mock_chunk_size,
+		"  first chunk");
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body, 100), "extend 100");
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body + 100, 200),
+		  "extend 200");
+	TEST_EQ(sd->hash_chunk_index, 2, "  chunk index");
+	TEST_EQ(sd->hash_chunk_remaining_size, 20, "  chunk remaining");
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body + 300, 20), "extend 20");
+	TEST_EQ(sd->hash_remaining_size, 0, "  hash remaining");
+	TEST_SUCC(vb2api_check_hash(&ctx), "check chunked hash");
+
+	/* Chunks are checked through a hash session too */
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_init_hash_session(&ctx, &hs), "chunked session");
+	TEST_SUCC(vb2api_extend_hash_session(&hs, mock_body, 200),
+		  "  extend 200");
+	TEST_SUCC(vb2api_extend_hash_session(&hs, mock_body + 200, 120),
+		  "  extend 120");
+	TEST_EQ(sd->hash_remaining_size, 0, "  hash remaining");
+	TEST_SUCC(vb2api_check_hash(&ctx), "  check chunked hash");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_hash_mapped_region(&ctx, mock_body, mock_body_size),
+		  "chunked mapped region");
+	TEST_SUCC(vb2api_check_hash(&ctx), "  check chunked hash");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	pre = (struct vb2_fw_preamble *)
+		(ctx.workbuf + sd->workbuf_preamble_offset);
+	table = (uint8_t *)pre + pre->body_chunk_digests_offset;
+	table[VB2_SHA256_DIGEST_SIZE * 2]++;
+	TEST_SUCC(vb2api_extend_hash(&ctx, mock_body, 256),
+		  "extend good chunks");
+	TEST_EQ(vb2api_extend_hash(&ctx, mock_body + 256, 64),
+		VB2_ERROR_API_EXTEND_HASH_CHUNK, "extend bad chunk");
+
+	reset_common_data(FOR_CHECK_HASH);
+	retval_vb2_verify_digest = VB2_ERROR_MOCK;
+	TEST_EQ(vb2api_check_hash(&ctx), VB2_ERROR_MOCK,
+		"check chunked hash signature");
+
+	/* Bodies hashed as a whole aren't chunked */
+	mock_chunk_size = 0;
+	reset_common_data(FOR_MISC);
+	TEST_EQ(vb2api_get_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_BODY_NOT_CHUNKED, "get body chunks not chunked");
+	TEST_EQ(vb2api_check_body_chunk(&ctx, 0, mock_body, 128),
+		VB2_ERROR_API_BODY_NOT_CHUNKED, "check chunk not chunked");
+
+	mock_chunk_size = 128;
+	reset_common_data(FOR_MISC);
+	pre = (struct vb2_fw_preamble *)
+		(ctx.workbuf + sd->workbuf_preamble_offset);
+	pre->header_version_minor = 1;
+	TEST_EQ(vb2api_get_body_chunks(&ctx, &chunk_size, &count),
+		VB2_ERROR_API_BODY_NOT_CHUNKED, "get body chunks 2.1 preamble");
+
+	mock_chunk_size = 0;
+}
+
 int main(int argc, char* argv[])
 {
 	phase3_tests();
@@ -430,6 +741,8 @@ int main(int argc, char* argv[])
 	init_hash_tests();
 	extend_hash_tests();
 	check_hash_tests();
+	body_chunk_tests();
+	warm_boot_tests();
 
 	fprintf(stderr, "Running hash API tests with hwcrypto support...\n");
 	hwcrypto_state = HWCRYPTO_ENABLED;
@@ -442,6 +755,7 @@ int main(int argc, char* argv[])
 	init_hash_tests();
 	extend_hash_tests();
 	check_hash_tests();
+	body_chunk_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
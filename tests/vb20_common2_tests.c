@@ -10,6 +10,7 @@
 #include <string.h>
 
 #include "2sysincludes.h"
+#include "2common.h"
 #include "2rsa.h"
 #include "file_keys.h"
 #include "host_common.h"
@@ -22,6 +23,17 @@
 static const uint8_t test_data[] = "This is some test data to sign.";
 static const uint32_t test_size = sizeof(test_data);
 
+static int mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+static int mock_hwcrypto_rsa_calls;
+
+int vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+				     const uint8_t *sig,
+				     const uint8_t *digest)
+{
+	mock_hwcrypto_rsa_calls++;
+	return mock_hwcrypto_rsa_retval;
+}
+
 static void test_unpack_key(const struct vb2_packed_key *key1)
 {
 	struct vb2_public_key pubk;
@@ -138,6 +150,210 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	free(sig2);
 }
 
+static void test_verify_hwcrypto(const struct vb2_packed_key *key1,
+				 const struct vb2_signature *sig)
+{
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	struct vb2_public_key pubk;
+	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
+	struct vb2_signature *sig2;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	sig2 = (struct vb2_signature *)malloc(sig_total_size);
+
+	pubk.allow_hwcrypto = 1;
+	TEST_SUCC(vb2_unpack_key(&pubk, key1), "hwcrypto RSA unpack key");
+	TEST_EQ(pubk.allow_hwcrypto, 0, "  not allowed by default");
+
+	/* Not allowed; the engine isn't asked */
+	mock_hwcrypto_rsa_retval = VB2_SUCCESS;
+	mock_hwcrypto_rsa_calls = 0;
+	memcpy(sig2, sig, sig_total_size);
+	vb2_signature_data(sig2)[0] ^= 0x5A;
+	TEST_NEQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		 0, "hwcrypto RSA not allowed");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 0, "  used sw");
+
+	/* Allowed but unsupported falls back to software */
+	pubk.allow_hwcrypto = 1;
+	mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_SUCC(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		  "hwcrypto RSA unsupported");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 1, "  tried hwcrypto");
+	memcpy(sig2, sig, sig_total_size);
+	vb2_signature_data(sig2)[0] ^= 0x5A;
+	TEST_NEQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		 0, "hwcrypto RSA unsupported wrong sig");
+
+	/* Otherwise the engine's answer is final */
+	mock_hwcrypto_rsa_retval = VB2_SUCCESS;
+	mock_hwcrypto_rsa_calls = 0;
+	TEST_SUCC(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		  "hwcrypto RSA used");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 1, "  used hwcrypto");
+
+	mock_hwcrypto_rsa_retval = VB2_ERROR_RSA_VERIFY_DIGEST;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_EQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		VB2_ERROR_RSA_VERIFY_DIGEST, "hwcrypto RSA failed");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 2, "  used hwcrypto");
+
+	mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	free(sig2);
+}
+
+
+/* Signing in pieces gives the same signatures as signing all at once */
+static void test_signature_context(const struct vb2_private_key *key,
+				   const struct vb2_signature *expect_sig)
+{
+	struct vb2_signature_context sc;
+	struct vb2_signature *sig, *sig2;
+	const uint32_t split = 10;
+
+	TEST_SUCC(vb2_signature_begin(&sc, key), "Signature begin");
+	TEST_SUCC(vb2_signature_update(&sc, test_data, split),
+		  "Signature update");
+	TEST_SUCC(vb2_signature_update(&sc, test_data + split, 0),
+		  "Signature update empty");
+	TEST_SUCC(vb2_signature_update(&sc, test_data + split,
+				       sizeof(test_data) - split),
+		  "Signature update again");
+	sig = vb2_signature_finish(&sc);
+	TEST_PTR_NEQ(sig, NULL, "Signature finish");
+	if (sig) {
+		TEST_EQ(sig->data_size, sizeof(test_data), "  data size");
+		TEST_EQ(sig->sig_size, expect_sig->sig_size, "  sig size");
+		TEST_EQ(memcmp(vb2_signature_data(sig),
+			       vb2_signature_data(
+				       (struct vb2_signature *)expect_sig),
+			       sig->sig_size), 0, "  sig data");
+		free(sig);
+	}
+
+	TEST_SUCC(vb2_signature_begin(&sc, key), "Signature begin");
+	sc.data_size = UINT32_MAX - 1;
+	TEST_EQ(vb2_signature_update(&sc, test_data, 2), VB2_ERROR_SIG_SIZE,
+		"Signature update too big");
+
+	/* With no key, it's a SHA-512 digest */
+	sig = vb2_sha512_signature(test_data, sizeof(test_data));
+	TEST_PTR_NEQ(sig, NULL, "SHA-512 signature");
+	TEST_SUCC(vb2_signature_begin(&sc, NULL), "SHA-512 begin");
+	TEST_SUCC(vb2_signature_update(&sc, test_data, split),
+		  "SHA-512 update");
+	TEST_SUCC(vb2_signature_update(&sc, test_data + split,
+				       sizeof(test_data) - split),
+		  "SHA-512 update again");
+	sig2 = vb2_signature_finish(&sc);
+	TEST_PTR_NEQ(sig2, NULL, "SHA-512 finish");
+	if (sig && sig2) {
+		TEST_EQ(sig2->data_size, sizeof(test_data), "  data size");
+		TEST_EQ(sig2->sig_size, VB2_SHA512_DIGEST_SIZE, "  sig size");
+		TEST_EQ(memcmp(vb2_signature_data(sig2),
+			       vb2_signature_data(sig),
+			       VB2_SHA512_DIGEST_SIZE), 0, "  sig data");
+	}
+	free(sig);
+	free(sig2);
+}
+
+/* Signing into a work buffer gives the same signatures as the heap */
+static void test_signature_workbuf(const struct vb2_private_key *key,
+				   const struct vb2_signature *expect_sig)
+{
+	uint8_t workbuf[VB2_SIGNATURE_WORKBUF_SIZE];
+	struct vb2_workbuf wb;
+	struct vb2_signature *sig, *sig2;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	sig = vb2_calculate_signature_wb(test_data, sizeof(test_data), key,
+					 &wb);
+	TEST_PTR_NEQ(sig, NULL, "Calculate signature in workbuf");
+	if (sig) {
+		TEST_TRUE((uint8_t *)sig >= workbuf &&
+			  (uint8_t *)sig < workbuf + sizeof(workbuf),
+			  "  in workbuf");
+		TEST_EQ(sig->sig_size, expect_sig->sig_size, "  sig size");
+		TEST_EQ(memcmp(vb2_signature_data(sig),
+			       vb2_signature_data(
+				       (struct vb2_signature *)expect_sig),
+			       sig->sig_size), 0, "  sig data");
+	}
+
+	/* A SHA-512 digest fits after it only for the small keys */
+	sig2 = vb2_sha512_signature_wb(test_data, sizeof(test_data), &wb);
+	if (sig2)
+		TEST_EQ(sig2->sig_size, VB2_SHA512_DIGEST_SIZE,
+			"  SHA-512 sig size");
+
+	/* Fails cleanly if the work buffer is too small */
+	vb2_workbuf_init(&wb, workbuf, sizeof(struct vb2_signature));
+	TEST_PTR_EQ(vb2_calculate_signature_wb(test_data, sizeof(test_data),
+					       key, &wb), NULL,
+		    "Calculate signature in small workbuf");
+	TEST_PTR_EQ(vb2_sha512_signature_wb(test_data, sizeof(test_data),
+					    &wb), NULL,
+		    "SHA-512 signature in small workbuf");
+}
+
+static void test_signature_multiple(const struct vb2_private_key *key,
+				    const struct vb2_signature *expect_sig)
+{
+	struct vb2_private_key other_key = *key;
+	const struct vb2_private_key *keys[3] = {key, &other_key, key};
+	struct vb2_signature *sigs[3], *other_sig;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	int i;
+
+	/* Same RSA key, different hash algorithm */
+	other_key.hash_alg = key->hash_alg == VB2_HASH_SHA1 ?
+		VB2_HASH_SHA256 : VB2_HASH_SHA1;
+	other_sig = vb2_calculate_signature(test_data, sizeof(test_data),
+					    &other_key);
+
+	TEST_SUCC(vb2_calculate_signatures(sigs, test_data, sizeof(test_data),
+					   keys, 3),
+		  "Calculate signatures");
+	for (i = 0; i < 3; i++) {
+		const struct vb2_signature *expect =
+			keys[i] == key ? expect_sig : other_sig;
+
+		TEST_EQ(sigs[i]->data_size, sizeof(test_data),
+			"  data size");
+		TEST_EQ(sigs[i]->sig_size, expect->sig_size, "  sig size");
+		TEST_EQ(memcmp(vb2_signature_data(sigs[i]),
+			       vb2_signature_data(
+				       (struct vb2_signature *)expect),
+			       sigs[i]->sig_size), 0, "  sig data");
+		free(sigs[i]);
+	}
+	free(other_sig);
+
+	/* Signing a digest is the same as signing the data */
+	TEST_SUCC(vb2_digest_buffer(test_data, sizeof(test_data),
+				    key->hash_alg, digest, sizeof(digest)),
+		  "Digest data");
+	sigs[0] = vb2_sign_digest(digest, sizeof(test_data), key);
+	TEST_PTR_NEQ(sigs[0], NULL, "Sign digest");
+	if (sigs[0]) {
+		TEST_EQ(memcmp(vb2_signature_data(sigs[0]),
+			       vb2_signature_data(
+				       (struct vb2_signature *)expect_sig),
+			       sigs[0]->sig_size), 0, "  sig data");
+		free(sigs[0]);
+	}
+
+	/* Keys must have a hash algorithm */
+	other_key.hash_alg = VB2_HASH_INVALID;
+	TEST_EQ(vb2_calculate_signatures(sigs, test_data, sizeof(test_data),
+					 keys, 3), VB2_SIGN_DATA_DIGEST_SIZE,
+		"Calculate signatures bad hash");
+}
 
 static int test_algorithm(int key_algorithm, const char *keys_dir)
 {
@@ -178,6 +394,10 @@ static int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	test_unpack_key(key1);
 	test_verify_data(key1, sig);
+	test_verify_hwcrypto(key1, sig);
+	test_signature_context(private_key, sig);
+	test_signature_workbuf(private_key, sig);
+	test_signature_multiple(private_key, sig);
 
 	retval = 0;
 
@@ -189,6 +189,106 @@ static void test_verify_keyblock(const struct vb2_public_key *public_key,
 	free(hdr);
 }
 
+static void test_verify_mapped_keyblock(
+		const struct vb2_public_key *public_key,
+		const struct vb2_private_key *private_key,
+		const struct vb2_packed_key *data_key)
+{
+	uint8_t workbuf[VB2_MAPPED_KEY_BLOCK_VERIFY_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+	struct vb2_keyblock *hdr;
+	struct vb2_keyblock *h;
+	uint32_t hsize;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	hdr = vb2_create_keyblock(data_key, private_key, 0x1234);
+	TEST_NEQ((size_t)hdr, 0, "vb2_verify_mapped_keyblock() prerequisites");
+	if (!hdr)
+		return;
+	hsize = hdr->keyblock_size;
+	h = (struct vb2_keyblock *)malloc(hsize);
+
+	memcpy(h, hdr, hsize);
+	TEST_SUCC(vb2_verify_mapped_keyblock(h, hsize, public_key, &wb),
+		  "vb2_verify_mapped_keyblock() ok");
+	TEST_SUCC(memcmp(h, hdr, hsize), "  keyblock unchanged");
+	TEST_SUCC(vb2_verify_mapped_keyblock(h, hsize, public_key, &wb),
+		  "  verifies again");
+
+	TEST_EQ(vb2_verify_mapped_keyblock(h, hsize - 1, public_key, &wb),
+		VB2_ERROR_KEYBLOCK_SIZE, "vb2_verify_mapped_keyblock() check");
+
+	((uint8_t *)vb2_packed_key_data(&h->data_key))[0] ^= 0x34;
+	TEST_EQ(vb2_verify_mapped_keyblock(h, hsize, public_key, &wb),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"vb2_verify_mapped_keyblock() sig mismatch");
+	((uint8_t *)vb2_packed_key_data(&h->data_key))[0] ^= 0x34;
+	TEST_SUCC(memcmp(h, hdr, hsize), "  keyblock unchanged");
+
+	vb2_workbuf_init(&wb, workbuf, h->keyblock_signature.sig_size);
+	TEST_EQ(vb2_verify_mapped_keyblock(h, hsize, public_key, &wb),
+		VB2_ERROR_KEYBLOCK_WORKBUF_SIG,
+		"vb2_verify_mapped_keyblock() no room for signature");
+
+	free(h);
+	free(hdr);
+}
+
+static void test_create_keyblocks(const struct vb2_public_key *public_key,
+				  const struct vb2_private_key *private_key,
+				  const struct vb2_packed_key *data_key)
+{
+	uint8_t workbuf[VB2_KEY_BLOCK_VERIFY_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+	const struct vb2_packed_key *data_keys[5];
+	struct vb2_keyblock *blocks[ARRAY_SIZE(data_keys)];
+	struct vb2_keyblock *hdr;
+	int threads[] = {0, 1, 3, 100};
+	int i, j, same, verified;
+
+	hdr = vb2_create_keyblock(data_key, private_key, 0x1234);
+	TEST_NEQ((size_t)hdr, 0, "vb2_create_keyblocks() prerequisites");
+	if (!hdr)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(data_keys); i++)
+		data_keys[i] = data_key;
+
+	for (i = 0; i < ARRAY_SIZE(threads); i++) {
+		memset(blocks, 0, sizeof(blocks));
+		TEST_EQ(vb2_create_keyblocks(data_keys, ARRAY_SIZE(data_keys),
+					     private_key, 0x1234, threads[i],
+					     blocks), 0,
+			"vb2_create_keyblocks()");
+
+		/* Each is the same as one created by itself */
+		same = verified = 0;
+		for (j = 0; j < ARRAY_SIZE(blocks); j++) {
+			if (!blocks[j])
+				continue;
+			vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+			if (blocks[j]->keyblock_size == hdr->keyblock_size &&
+			    !memcmp(blocks[j], hdr, hdr->keyblock_size))
+				same++;
+			if (!vb2_verify_keyblock(blocks[j],
+						 blocks[j]->keyblock_size,
+						 public_key, &wb))
+				verified++;
+			free(blocks[j]);
+		}
+		TEST_EQ(same, ARRAY_SIZE(blocks), "  same keyblocks");
+		TEST_EQ(verified, ARRAY_SIZE(blocks), "  verified");
+	}
+
+	TEST_EQ(vb2_create_keyblocks(data_keys, 0, private_key, 0x1234, 4,
+				     blocks), 0, "vb2_create_keyblocks() none");
+
+	free(hdr);
+}
+
 static void resign_fw_preamble(struct vb2_fw_preamble *h,
 			       struct vb2_private_key *key)
 {
@@ -272,7 +372,15 @@ static void test_verify_fw_preamble(struct vb2_packed_key *public_key,
 		  "vb2_verify_fw_preamble() minor++");
 
 	memcpy(h, hdr, hsize);
-	h->header_version_minor--;
+	h->header_version_minor = 1;
+	h->body_chunk_size = 16;
+	h->body_chunk_digests_offset = hsize;
+	resign_fw_preamble(h, private_key);
+	TEST_SUCC(vb2_verify_fw_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_fw_preamble() 2.1 ignores chunks");
+
+	memcpy(h, hdr, hsize);
+	h->header_version_minor = 0;
 	resign_fw_preamble(h, private_key);
 	TEST_EQ(vb2_verify_fw_preamble(h, hsize, &rsa, &wb),
 		VB2_ERROR_PREAMBLE_HEADER_OLD,
@@ -327,6 +435,63 @@ static void test_verify_fw_preamble(struct vb2_packed_key *public_key,
 
 	/* TODO: verify with extra padding at end of header. */
 
+	free(h);
+	free(hdr);
+
+	/* Table of body chunk digests must be signed too */
+	hdr = vb2_create_fw_preamble_chunked(0x1234, kernel_subkey,
+					     (const uint8_t *)body_sig,
+					     56, 16, private_key, 0);
+	TEST_PTR_NEQ(hdr, NULL,
+		     "vb2_verify_fw_preamble() prereq chunked preamble");
+	if (!hdr) {
+		free(body_sig);
+		return;
+	}
+
+	hsize = (uint32_t) hdr->preamble_size;
+	h = (struct vb2_fw_preamble *)malloc(hsize + 16384);
+
+	memcpy(h, hdr, hsize);
+	TEST_SUCC(vb2_verify_fw_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_fw_preamble() chunked");
+	TEST_EQ(vb2_fw_get_body_chunk_size(h), 16, "  chunk size");
+	TEST_EQ(h->body_signature.data_size, 56, "  body size");
+	TEST_EQ(h->body_chunk_digests_size,
+		4 * vb2_digest_size(private_key->hash_alg), "  table size");
+
+	memcpy(h, hdr, hsize);
+	TEST_EQ(vb2_verify_fw_body((const uint8_t *)body_sig, 56, h,
+				   &rsa, &wb),
+		0, "vb2_verify_fw_body() chunked");
+
+	memcpy(h, hdr, hsize);
+	((uint8_t *)body_sig)[40] ^= 0x12;
+	TEST_EQ(vb2_verify_fw_body((const uint8_t *)body_sig, 56, h,
+				   &rsa, &wb),
+		VB2_ERROR_API_BODY_CHUNK_DIGEST,
+		"vb2_verify_fw_body() chunk mismatch");
+	((uint8_t *)body_sig)[40] ^= 0x12;
+
+	memcpy(h, hdr, hsize);
+	TEST_EQ(vb2_verify_fw_body((const uint8_t *)body_sig, 55, h,
+				   &rsa, &wb),
+		VB2_ERROR_VDATA_SIZE, "vb2_verify_fw_body() body too small");
+
+	memcpy(h, hdr, hsize);
+	h->body_chunk_digests_offset = hsize;
+	resign_fw_preamble(h, private_key);
+	TEST_EQ(vb2_verify_fw_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE,
+		"vb2_verify_fw_preamble() chunk digests off end");
+
+	memcpy(h, hdr, hsize);
+	h->preamble_signature.data_size = h->body_chunk_digests_offset;
+	resign_fw_preamble(h, private_key);
+	TEST_EQ(vb2_verify_fw_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE,
+		"vb2_verify_fw_preamble() chunk digests not signed");
+
 	free(h);
 	free(hdr);
 	free(body_sig);
@@ -502,8 +667,167 @@ static void test_verify_kernel_preamble(
 	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
 		  "vb2_verify_kernel_preamble() no vmlinuz_header");
 
+	memcpy(h, hdr, hsize);
+	h->header_version_minor = 2;
+	h->body_chunk_size = 16;
+	h->body_chunk_digests_offset = hsize;
+	resign_kernel_preamble(h, private_key);
+	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_kernel_preamble() 2.2 ignores chunks");
+
+	/* Check body compression */
+	memcpy(h, hdr, hsize);
+	TEST_EQ(vb2_kernel_get_body_compression(h),
+		VB2_KERNEL_COMPRESSION_NONE, "Body not compressed");
+	TEST_EQ(vb2_kernel_get_body_size(h), h->body_signature.data_size,
+		"  body size");
+
+	memcpy(h, hdr, hsize);
+	h->body_compression = 99;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_COMPRESSION,
+		"vb2_verify_kernel_preamble() unknown compression");
+
+	memcpy(h, hdr, hsize);
+	h->header_version_minor = 3;
+	h->body_compression = 99;
+	resign_kernel_preamble(h, private_key);
+	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_kernel_preamble() 2.3 ignores compression");
+	TEST_EQ(vb2_kernel_get_body_compression(h),
+		VB2_KERNEL_COMPRESSION_NONE, "  not compressed");
+
+	/* Bootloader and vmlinuz header are in the decompressed body */
+	memcpy(h, hdr, hsize);
+	h->body_compression = VB2_KERNEL_COMPRESSION_LZ4;
+	h->body_uncompressed_size = 0x400000;
+	h->bootloader_address = h->body_load_address +
+		h->body_signature.data_size + 1;
+	h->vmlinuz_header_address = h->bootloader_address + 0x4000;
+	resign_kernel_preamble(h, private_key);
+	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_kernel_preamble() compressed");
+	TEST_EQ(vb2_kernel_get_body_compression(h),
+		VB2_KERNEL_COMPRESSION_LZ4, "  compression");
+	TEST_EQ(vb2_kernel_get_body_size(h), 0x400000, "  body size");
+
+	memcpy(h, hdr, hsize);
+	h->body_compression = VB2_KERNEL_COMPRESSION_LZ4;
+	h->body_uncompressed_size = 0x203fff;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BOOTLOADER_OUTSIDE,
+		"vb2_verify_kernel_preamble() bootloader off end of "
+		"decompressed body");
+
+	memcpy(h, hdr, hsize);
+	h->body_compression = VB2_KERNEL_COMPRESSION_LZ4;
+	h->body_uncompressed_size = 0x213fff;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_VMLINUZ_HEADER_OUTSIDE,
+		"vb2_verify_kernel_preamble() vmlinuz_header off end of "
+		"decompressed body");
+
 	/* TODO: verify with extra padding at end of header. */
 
+	free(h);
+	free(hdr);
+
+	/* Table of body chunk digests must be signed too */
+	hdr = vb2_create_kernel_preamble_chunked(0x1234, 0x100000, 0x100000,
+						 0, (const uint8_t *)body_sig,
+						 56, 16, 0, 0, 0, 0,
+						 private_key);
+	TEST_PTR_NEQ(hdr, NULL,
+		     "vb2_verify_kernel_preamble() prereq chunked preamble");
+	if (!hdr) {
+		free(body_sig);
+		return;
+	}
+
+	hsize = (uint32_t) hdr->preamble_size;
+	h = (struct vb2_kernel_preamble *)malloc(hsize + 16384);
+
+	memcpy(h, hdr, hsize);
+	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_kernel_preamble() chunked");
+	TEST_EQ(vb2_kernel_get_body_chunk_size(h), 16, "  chunk size");
+	TEST_EQ(vb2_kernel_get_body_chunk_count(h), 4, "  chunk count");
+	TEST_EQ(h->body_signature.data_size, 56, "  body size");
+
+	memcpy(h, hdr, hsize);
+	TEST_SUCC(vb2_verify_kernel_body((const uint8_t *)body_sig, 56, h,
+					 &rsa, &wb),
+		  "vb2_verify_kernel_body() chunked");
+
+	memcpy(h, hdr, hsize);
+	((uint8_t *)body_sig)[40] ^= 0x12;
+	TEST_EQ(vb2_verify_kernel_body((const uint8_t *)body_sig, 56, h,
+				       &rsa, &wb),
+		VB2_ERROR_API_BODY_CHUNK_DIGEST,
+		"vb2_verify_kernel_body() chunk mismatch");
+	((uint8_t *)body_sig)[40] ^= 0x12;
+
+	memcpy(h, hdr, hsize);
+	TEST_EQ(vb2_verify_kernel_body((const uint8_t *)body_sig, 55, h,
+				       &rsa, &wb),
+		VB2_ERROR_VDATA_NOT_ENOUGH_DATA,
+		"vb2_verify_kernel_body() body too small");
+
+	memcpy(h, hdr, hsize);
+	h->body_chunk_digests_offset = hsize;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE,
+		"vb2_verify_kernel_preamble() chunk digests off end");
+
+	memcpy(h, hdr, hsize);
+	h->preamble_signature.data_size = h->body_chunk_digests_offset;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_CHUNKS_OUTSIDE,
+		"vb2_verify_kernel_preamble() chunk digests not signed");
+
+	memcpy(h, hdr, hsize);
+	h->body_chunk_size = 8;
+	resign_kernel_preamble(h, private_key);
+	TEST_EQ(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		VB2_ERROR_PREAMBLE_BODY_CHUNKS_SIZE,
+		"vb2_verify_kernel_preamble() wrong chunk digest count");
+
+	free(h);
+	free(hdr);
+
+	/* Compressed body is signed as it is stored */
+	hdr = vb2_create_kernel_preamble_compressed(
+			0x1234, 0x100000, 0x100000, 0,
+			(const uint8_t *)body_sig, 56, 0,
+			VB2_KERNEL_COMPRESSION_LZ4, 0x1000, 0, 0, 0, 0,
+			private_key);
+	TEST_PTR_NEQ(hdr, NULL,
+		     "vb2_verify_kernel_preamble() prereq compressed preamble");
+	if (!hdr) {
+		free(body_sig);
+		return;
+	}
+
+	hsize = (uint32_t) hdr->preamble_size;
+	h = (struct vb2_kernel_preamble *)malloc(hsize);
+
+	memcpy(h, hdr, hsize);
+	TEST_SUCC(vb2_verify_kernel_preamble(h, hsize, &rsa, &wb),
+		  "vb2_verify_kernel_preamble() compressed");
+	TEST_EQ(vb2_kernel_get_body_compression(h),
+		VB2_KERNEL_COMPRESSION_LZ4, "  compression");
+	TEST_EQ(vb2_kernel_get_body_size(h), 0x1000, "  body size");
+	TEST_EQ(vb2_kernel_get_body_chunk_size(h), 0, "  not chunked");
+	TEST_EQ(h->body_signature.data_size, 56, "  compressed size");
+	TEST_SUCC(vb2_verify_kernel_body((const uint8_t *)body_sig, 56, h,
+					 &rsa, &wb),
+		  "vb2_verify_kernel_body() compressed");
+
 	free(h);
 	free(hdr);
 	free(body_sig);
@@ -573,6 +897,10 @@ static int test_permutation(int signing_key_algorithm, int data_key_algorithm,
 			    data_public_key);
 	test_verify_keyblock(&signing_public_key2, signing_private_key,
 			     data_public_key);
+	test_verify_mapped_keyblock(&signing_public_key2, signing_private_key,
+				    data_public_key);
+	test_create_keyblocks(&signing_public_key2, signing_private_key,
+			      data_public_key);
 	test_verify_fw_preamble(signing_public_key, signing_private_key,
 				data_public_key);
 	test_verify_kernel_preamble(signing_public_key, signing_private_key);
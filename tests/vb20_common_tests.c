@@ -26,6 +26,9 @@ static void test_struct_packing(void)
 	TEST_EQ(EXPECTED_VB2_FW_PREAMBLE_SIZE,
 		sizeof(struct vb2_fw_preamble),
 		"sizeof(vb2_fw_preamble)");
+	TEST_EQ(EXPECTED_VB2_KERNEL_PREAMBLE_2_4_SIZE,
+		sizeof(struct vb2_kernel_preamble),
+		"sizeof(vb2_kernel_preamble)");
 
 	/* And make sure they're the same as their vboot1 equivalents */
 	TEST_EQ(EXPECTED_VB2_SIGNATURE_SIZE,
@@ -34,6 +37,9 @@ static void test_struct_packing(void)
 	TEST_EQ(EXPECTED_VB2_KEYBLOCK_SIZE,
 		EXPECTED_VBKEYBLOCKHEADER_SIZE,
 		"vboot1->2 keyblock sizes same");
+	TEST_EQ(EXPECTED_VB2_KERNEL_PREAMBLE_2_4_SIZE,
+		EXPECTED_VBKERNELPREAMBLEHEADER2_4_SIZE,
+		"vboot1->2 kernel preamble sizes same");
 }
 
 /**
@@ -248,6 +248,8 @@ static void load_kernel_keyblock_tests(void)
 	reset_common_data(FOR_KEYBLOCK);
 	wb_used_before = ctx.workbuf_used;
 	TEST_SUCC(vb2_load_kernel_keyblock(&ctx), "Kernel keyblock good");
+	TEST_EQ(sd->costs[VB2_COST_KERNEL_KEYBLOCK].count, 1,
+		"  keyblock cost");
 	TEST_NEQ(sd->flags & VB2_SD_FLAG_KERNEL_SIGNED, 0, "  Kernel signed");
 	TEST_EQ(sd->kernel_version, 0x20000, "keyblock version");
 	TEST_EQ(sd->vblock_preamble_offset, sizeof(mock_vblock.k),
@@ -316,6 +318,8 @@ static void load_kernel_keyblock_tests(void)
 	mock_verify_keyblock_retval = VB2_ERROR_MOCK;
 	TEST_SUCC(vb2_load_kernel_keyblock(&ctx), "Kernel keyblock hash good");
 	TEST_EQ(sd->flags & VB2_SD_FLAG_KERNEL_SIGNED, 0, "  Kernel signed");
+	TEST_EQ(sd->costs[VB2_COST_KERNEL_KEYBLOCK].count, 1,
+		"  keyblock cost");
 
 	/* But we do in dev+rec mode */
 	reset_common_data(FOR_KEYBLOCK);
@@ -406,6 +410,8 @@ static void load_kernel_preamble_tests(void)
 	reset_common_data(FOR_PREAMBLE);
 	wb_used_before = ctx.workbuf_used;
 	TEST_SUCC(vb2_load_kernel_preamble(&ctx), "preamble good");
+	TEST_EQ(sd->costs[VB2_COST_KERNEL_PREAMBLE].count, 1,
+		"  preamble cost");
 	TEST_EQ(sd->kernel_version, 0x20002, "combined version");
 	TEST_EQ(sd->workbuf_preamble_offset, wb_used_before,
 		"preamble offset");
@@ -48,9 +48,16 @@ static struct {
 } mock_vblock;
 
 static int mock_read_res_fail_on_call;
+static int mock_map_vblock;
+static int mock_vblock_reads;
 static int mock_unpack_key_retval;
 static int mock_verify_keyblock_retval;
+static const struct vb2_keyblock *mock_verified_mapped_keyblock;
 static int mock_verify_preamble_retval;
+static struct vb2_warm_boot_record mock_record;
+static int mock_record_retval = VB2_ERROR_EX_UNIMPLEMENTED;
+static uint8_t mock_nonce[VB2_WARM_BOOT_NONCE_SIZE] = {1, 2, 3};
+static uint32_t mock_flash_write_count = 5;
 
 /* Type of test to reset for */
 enum reset_type {
@@ -80,8 +87,11 @@ static void reset_common_data(enum reset_type t)
 	vb2_secdata_init(&ctx);
 
 	mock_read_res_fail_on_call = 0;
+	mock_map_vblock = 0;
+	mock_vblock_reads = 0;
 	mock_unpack_key_retval = VB2_SUCCESS;
 	mock_verify_keyblock_retval = VB2_SUCCESS;
+	mock_verified_mapped_keyblock = NULL;
 	mock_verify_preamble_retval = VB2_SUCCESS;
 
 	/* Set up mock data for verifying keyblock */
@@ -141,6 +151,7 @@ int vb2ex_read_resource(struct vb2_context *c,
 	case VB2_RES_FW_VBLOCK:
 		rptr = (uint8_t *)&mock_vblock;
 		rsize = sizeof(mock_vblock);
+		mock_vblock_reads++;
 		break;
 	default:
 		return VB2_ERROR_EX_READ_RESOURCE_INDEX;
@@ -153,6 +164,23 @@ int vb2ex_read_resource(struct vb2_context *c,
 	return VB2_SUCCESS;
 }
 
+int vb2ex_map_resource(struct vb2_context *c,
+		       enum vb2_resource_index index,
+		       uint32_t offset,
+		       uint32_t size,
+		       const void **buf)
+{
+	if (!mock_map_vblock || index != VB2_RES_FW_VBLOCK)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	if (offset > sizeof(mock_vblock) ||
+	    offset + size > sizeof(mock_vblock))
+		return VB2_ERROR_EX_READ_RESOURCE_SIZE;
+
+	*buf = (uint8_t *)&mock_vblock + offset;
+	return VB2_SUCCESS;
+}
+
 int vb2_unpack_key_buffer(struct vb2_public_key *key,
 		   const uint8_t *buf,
 		   uint32_t size)
@@ -169,6 +197,15 @@ int vb2_verify_keyblock(struct vb2_keyblock *block,
 	return mock_verify_keyblock_retval;
 }
 
+int vb2_verify_mapped_keyblock(const struct vb2_keyblock *block,
+			       uint32_t size,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb)
+{
+	mock_verified_mapped_keyblock = block;
+	return mock_verify_keyblock_retval;
+}
+
 int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 			   uint32_t size,
 			   const struct vb2_public_key *key,
@@ -177,6 +214,26 @@ int vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 	return mock_verify_preamble_retval;
 }
 
+int vb2ex_warm_boot_state(uint8_t *nonce, uint32_t *flash_write_count)
+{
+	memcpy(nonce, mock_nonce, sizeof(mock_nonce));
+	*flash_write_count = mock_flash_write_count;
+	return VB2_SUCCESS;
+}
+
+int vb2ex_warm_boot_record_read(struct vb2_warm_boot_record *rec)
+{
+	memcpy(rec, &mock_record, sizeof(*rec));
+	return mock_record_retval;
+}
+
+int vb2ex_warm_boot_record_write(const struct vb2_warm_boot_record *rec)
+{
+	memcpy(&mock_record, rec, sizeof(mock_record));
+	mock_record_retval = VB2_SUCCESS;
+	return VB2_SUCCESS;
+}
+
 /* Tests */
 
 static void verify_keyblock_tests(void)
@@ -190,6 +247,9 @@ static void verify_keyblock_tests(void)
 	wb_used_before = ctx.workbuf_used;
 	TEST_SUCC(vb2_load_fw_keyblock(&ctx), "keyblock verify");
 	TEST_EQ(sd->fw_version, 0x20000, "keyblock version");
+	TEST_EQ(sd->costs[VB2_COST_FW_KEYBLOCK].count, 1, "keyblock cost");
+	TEST_EQ(sd->costs[VB2_COST_FW_KEYBLOCK].hashed_bytes,
+		kb->keyblock_signature.data_size, "  hashed bytes");
 	TEST_EQ(sd->vblock_preamble_offset, sizeof(mock_vblock.k),
 		"preamble offset");
 	TEST_EQ(sd->workbuf_data_key_offset, wb_used_before,
@@ -296,6 +356,9 @@ static void verify_preamble_tests(void)
 	wb_used_before = ctx.workbuf_used;
 	TEST_SUCC(vb2_load_fw_preamble(&ctx), "preamble good");
 	TEST_EQ(sd->fw_version, 0x20002, "combined version");
+	TEST_EQ(sd->costs[VB2_COST_FW_PREAMBLE].count, 1, "preamble cost");
+	TEST_EQ(sd->costs[VB2_COST_FW_PREAMBLE].hashed_bytes,
+		pre->preamble_signature.data_size, "  hashed bytes");
 	TEST_EQ(sd->workbuf_preamble_offset, wb_used_before,
 		"preamble offset");
 	TEST_EQ(sd->workbuf_preamble_size, pre->preamble_size, "preamble size");
@@ -392,10 +455,205 @@ static void verify_preamble_tests(void)
 	TEST_EQ(v, 0x20002, "no roll forward");
 }
 
+static void mapped_vblock_tests(void)
+{
+	struct vb2_keyblock *kb = &mock_vblock.k.kb;
+	struct vb2_fw_preamble *pre;
+	struct vb2_packed_key *k;
+	int wb_used_before;
+
+	/* Keyblock is used in place; only the data key is copied out */
+	reset_common_data(FOR_KEYBLOCK);
+	mock_map_vblock = 1;
+	wb_used_before = ctx.workbuf_used;
+	TEST_SUCC(vb2_load_fw_keyblock(&ctx), "mapped keyblock");
+	TEST_EQ(mock_vblock_reads, 0, "  not read");
+	TEST_PTR_EQ(mock_verified_mapped_keyblock, kb,
+		    "  verified where it is mapped");
+	TEST_EQ(sd->fw_version, 0x20000, "  version");
+	TEST_EQ(sd->workbuf_data_key_offset, wb_used_before,
+		"  data key offset");
+	k = (struct vb2_packed_key *)(ctx.workbuf + sd->workbuf_data_key_offset);
+	TEST_EQ(k->algorithm, 7, "  data key algorithm");
+	TEST_EQ(k->key_size, sizeof(mock_vblock.k.data_key_data),
+		"  data key size");
+	TEST_SUCC(memcmp(ctx.workbuf + sd->workbuf_data_key_offset +
+			 k->key_offset, mock_vblock.k.data_key_data,
+			 sizeof(mock_vblock.k.data_key_data)),
+		  "  data key data");
+	TEST_EQ(ctx.workbuf_used,
+		vb2_wb_round_up(sd->workbuf_data_key_offset +
+				sd->workbuf_data_key_size),
+		"  workbuf used");
+
+	reset_common_data(FOR_KEYBLOCK);
+	mock_map_vblock = 1;
+	mock_verify_keyblock_retval = VB2_ERROR_KEYBLOCK_WORKBUF_SIG;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_WORKBUF_SIG,
+		"mapped keyblock verify fail");
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_RECOVERY_REQUEST),
+		VB2_RECOVERY_FW_KEYBLOCK, "  recovery reason");
+
+	/* Data key is bigger than the root key, and there's no room for it */
+	reset_common_data(FOR_KEYBLOCK);
+	mock_map_vblock = 1;
+	ctx.workbuf_used = ctx.workbuf_size -
+			vb2_wb_round_up(gbb.rootkey_size);
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_FW_KEYBLOCK_WORKBUF,
+		"mapped keyblock no room for data key");
+
+	/* Falls back to reading a keyblock which can't be mapped */
+	reset_common_data(FOR_KEYBLOCK);
+	mock_map_vblock = 1;
+	kb->keyblock_size = sizeof(mock_vblock) + 1;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_EX_READ_RESOURCE_SIZE,
+		"mapped keyblock too big");
+	TEST_EQ(mock_vblock_reads, 2, "  read instead");
+	TEST_PTR_EQ(mock_verified_mapped_keyblock, NULL, "  not verified");
+
+	/* Preamble is copied into the work buffer from the mapping */
+	reset_common_data(FOR_PREAMBLE);
+	mock_map_vblock = 1;
+	mock_vblock_reads = 0;
+	wb_used_before = ctx.workbuf_used;
+	TEST_SUCC(vb2_load_fw_preamble(&ctx), "mapped preamble");
+	TEST_EQ(mock_vblock_reads, 0, "  not read");
+	TEST_EQ(sd->workbuf_preamble_offset, wb_used_before,
+		"  preamble offset");
+	pre = (struct vb2_fw_preamble *)
+		(ctx.workbuf + sd->workbuf_preamble_offset);
+	TEST_PTR_NEQ(pre, &mock_vblock.p.pre, "  copied");
+	TEST_SUCC(memcmp(pre, &mock_vblock.p, sizeof(mock_vblock.p)),
+		  "  contents");
+	TEST_EQ(sd->fw_version, 0x20002, "  version");
+
+	reset_common_data(FOR_PREAMBLE);
+	mock_map_vblock = 1;
+	ctx.workbuf_used = ctx.workbuf_size -
+			vb2_wb_round_up(sizeof(struct vb2_fw_preamble));
+	TEST_EQ(vb2_load_fw_preamble(&ctx), VB2_ERROR_FW_PREAMBLE2_WORKBUF,
+		"mapped preamble no room");
+}
+
+static void reset_warm_boot(void)
+{
+	reset_common_data(FOR_KEYBLOCK);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	mock_verify_keyblock_retval = VB2_ERROR_KEYBLOCK_SIG_INVALID;
+	mock_verify_preamble_retval = VB2_ERROR_PREAMBLE_SIG_INVALID;
+}
+
+static void warm_boot_tests(void)
+{
+	struct vb2_warm_boot_record rec;
+	uint8_t body[VB2_SHA256_DIGEST_SIZE];
+
+	memset(body, 0x42, sizeof(body));
+
+	/* Without a record, the signatures are checked */
+	reset_warm_boot();
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot no record");
+
+	/* A full boot saves a record */
+	reset_common_data(FOR_KEYBLOCK);
+	ctx.flags |= VB2_CONTEXT_WARM_BOOT_RECORD;
+	TEST_SUCC(vb2_load_fw_keyblock(&ctx), "warm boot keyblock");
+	TEST_SUCC(vb2_load_fw_preamble(&ctx), "  preamble");
+	TEST_EQ(sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH, 0,
+		"  no match");
+	TEST_SUCC(vb2_save_warm_boot_record(&ctx, body, sizeof(body)),
+		  "  save record");
+	TEST_EQ(mock_record.magic, VB2_WARM_BOOT_RECORD_MAGIC, "  magic");
+	TEST_EQ(mock_record.flash_write_count, mock_flash_write_count,
+		"  flash write count");
+	TEST_SUCC(memcmp(mock_record.boot_nonce, mock_nonce,
+			 sizeof(mock_nonce)), "  nonce");
+	TEST_SUCC(memcmp(mock_record.body_digest, body, sizeof(body)),
+		  "  body digest");
+	memcpy(&rec, &mock_record, sizeof(rec));
+
+	/* The next boot skips the signature checks */
+	reset_warm_boot();
+	TEST_SUCC(vb2_load_fw_keyblock(&ctx), "warm boot skips keyblock sig");
+	TEST_SUCC(vb2_load_fw_preamble(&ctx), "  and preamble sig");
+	TEST_NEQ(sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH, 0, "  match");
+	TEST_EQ(sd->fw_version, 0x20002, "  version");
+	TEST_SUCC(vb2_check_warm_boot_body(&ctx, body, sizeof(body)),
+		  "  body matches");
+	body[0]++;
+	TEST_EQ(vb2_check_warm_boot_body(&ctx, body, sizeof(body)),
+		VB2_ERROR_FW_WARM_BOOT_MISMATCH, "  other body");
+	body[0]--;
+
+	/* Versions are still checked */
+	reset_warm_boot();
+	sd->fw_version_secdata = 0x30000;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx),
+		VB2_ERROR_FW_KEYBLOCK_VERSION_ROLLBACK, "warm boot rollback");
+
+	/* Anything different means checking the signatures again */
+	reset_warm_boot();
+	ctx.flags &= ~VB2_CONTEXT_WARM_BOOT_RECORD;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot not enabled");
+
+	reset_warm_boot();
+	mock_nonce[0]++;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot new nonce");
+	mock_nonce[0]--;
+
+	reset_warm_boot();
+	mock_flash_write_count++;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot flash written");
+	mock_flash_write_count--;
+
+	reset_warm_boot();
+	sd->fw_slot = 1;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot other slot");
+
+	reset_warm_boot();
+	mock_record.magic++;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot bad magic");
+	memcpy(&mock_record, &rec, sizeof(rec));
+
+	reset_warm_boot();
+	mock_gbb.rootkey.key_version++;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot root key changed");
+	mock_gbb.rootkey.key_version--;
+
+	reset_warm_boot();
+	mock_vblock.k.kbdata[0]++;
+	TEST_EQ(vb2_load_fw_keyblock(&ctx), VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"warm boot keyblock changed");
+	mock_vblock.k.kbdata[0]--;
+
+	reset_warm_boot();
+	mock_vblock.p.predata[0]++;
+	TEST_SUCC(vb2_load_fw_keyblock(&ctx), "warm boot keyblock matches");
+	TEST_EQ(vb2_load_fw_preamble(&ctx), VB2_ERROR_PREAMBLE_SIG_INVALID,
+		"  preamble changed");
+	TEST_EQ(sd->status & VB2_SD_STATUS_WARM_BOOT_MATCH, 0,
+		"  no match");
+	mock_vblock.p.predata[0]--;
+
+	reset_warm_boot();
+	mock_record_retval = VB2_ERROR_EX_UNIMPLEMENTED;
+	TEST_EQ(vb2_check_warm_boot_body(&ctx, body, sizeof(body)),
+		VB2_ERROR_EX_UNIMPLEMENTED, "warm boot body no record");
+}
+
 int main(int argc, char* argv[])
 {
 	verify_keyblock_tests();
 	verify_preamble_tests();
+	mapped_vblock_tests();
+	warm_boot_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
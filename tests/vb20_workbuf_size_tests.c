@@ -0,0 +1,392 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Work buffer sizing for firmware and kernel verification with real keys.
+ *
+ * For each combination of key sizes, this runs the verification phases on
+ * signed test data, reports the work buffer high-water mark of each phase,
+ * and checks that exactly that much work buffer is enough.
+ */
+
+#include <stdio.h>
+
+#include "2sysincludes.h"
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2nvstorage.h"
+#include "2rsa.h"
+#include "2secdata.h"
+#include "file_keys.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_keyblock.h"
+#include "host_signature.h"
+#include "vb2_common.h"
+#include "test_common.h"
+
+/* Big enough that no configuration runs out */
+#define TEST_WORKBUF_SIZE (64 * 1024)
+
+static uint8_t workbuf[TEST_WORKBUF_SIZE]
+	__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+static struct vb2_context ctx;
+
+static uint8_t body[0x4000];
+
+/* Test data served by vb2ex_read_resource() */
+static uint8_t *gbb_data;
+static uint32_t gbb_size;
+static uint8_t *vblock_data;
+static uint32_t vblock_size;
+
+/* Key sizes in active use, as (signing key, data key) */
+struct test_perm {
+	int signing_algorithm;
+	int data_key_algorithm;
+};
+
+static const struct test_perm test_perms[] = {
+	{VB2_ALG_RSA4096_SHA256, VB2_ALG_RSA2048_SHA256},
+	{VB2_ALG_RSA8192_SHA512, VB2_ALG_RSA2048_SHA256},
+	{VB2_ALG_RSA8192_SHA512, VB2_ALG_RSA4096_SHA256},
+};
+
+/* Keys for one permutation */
+struct test_keys {
+	struct vb2_private_key *signing_private_key;
+	struct vb2_packed_key *signing_public_key;
+	struct vb2_private_key *data_private_key;
+	struct vb2_packed_key *data_public_key;
+};
+
+int vb2ex_read_resource(struct vb2_context *c,
+			enum vb2_resource_index index,
+			uint32_t offset,
+			void *buf,
+			uint32_t size)
+{
+	const uint8_t *data;
+	uint32_t data_size;
+
+	switch (index) {
+	case VB2_RES_GBB:
+		data = gbb_data;
+		data_size = gbb_size;
+		break;
+	case VB2_RES_FW_VBLOCK:
+	case VB2_RES_KERNEL_VBLOCK:
+		data = vblock_data;
+		data_size = vblock_size;
+		break;
+	default:
+		return VB2_ERROR_EX_READ_RESOURCE_INDEX;
+	}
+
+	if (offset > data_size || size > data_size - offset)
+		return VB2_ERROR_EX_READ_RESOURCE_SIZE;
+
+	memcpy(buf, data + offset, size);
+	return VB2_SUCCESS;
+}
+
+static void *read_key(const char *keys_dir, int alg, int private)
+{
+	char filename[1024];
+	void *key;
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.%s", keys_dir,
+		 vb2_get_crypto_algorithm_file(alg), private ? "pem" : "keyb");
+	if (private)
+		key = vb2_read_private_key_pem(filename, alg);
+	else
+		key = vb2_read_packed_keyb(filename, alg, 1);
+	if (!key)
+		fprintf(stderr, "Error reading %s\n", filename);
+	return key;
+}
+
+static int read_keys(struct test_keys *keys, const struct test_perm *perm,
+		     const char *keys_dir)
+{
+	memset(keys, 0, sizeof(*keys));
+	keys->signing_private_key =
+		read_key(keys_dir, perm->signing_algorithm, 1);
+	keys->signing_public_key =
+		read_key(keys_dir, perm->signing_algorithm, 0);
+	keys->data_private_key =
+		read_key(keys_dir, perm->data_key_algorithm, 1);
+	keys->data_public_key =
+		read_key(keys_dir, perm->data_key_algorithm, 0);
+
+	return keys->signing_private_key && keys->signing_public_key &&
+		keys->data_private_key && keys->data_public_key ? 0 : 1;
+}
+
+static void free_keys(struct test_keys *keys)
+{
+	free(keys->signing_private_key);
+	free(keys->signing_public_key);
+	free(keys->data_private_key);
+	free(keys->data_public_key);
+}
+
+/* Put the keyblock and preamble one after the other as the vblock */
+static void set_vblock(const struct vb2_keyblock *kb, const void *pre,
+		       uint32_t pre_size)
+{
+	free(vblock_data);
+	vblock_size = kb->keyblock_size + pre_size;
+	vblock_data = malloc(vblock_size);
+	memcpy(vblock_data, kb, kb->keyblock_size);
+	memcpy(vblock_data + kb->keyblock_size, pre, pre_size);
+}
+
+static void reset_ctx(uint32_t workbuf_size)
+{
+	memset(workbuf, 0xaa, sizeof(workbuf));
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.workbuf = workbuf;
+	ctx.workbuf_size = workbuf_size;
+	vb2_init_context(&ctx);
+	vb2_nv_init(&ctx);
+	vb2api_secdata_create(&ctx);
+	vb2_secdata_init(&ctx);
+}
+
+/* Firmware verification as done by vb2api_fw_phase1() through check_hash */
+static int run_fw(uint32_t workbuf_size)
+{
+	uint32_t size;
+	int rv;
+
+	reset_ctx(workbuf_size);
+
+	if ((rv = vb2_fw_parse_gbb(&ctx)) ||
+	    (rv = vb2_load_fw_keyblock(&ctx)) ||
+	    (rv = vb2_load_fw_preamble(&ctx)) ||
+	    (rv = vb2api_init_hash(&ctx, VB2_HASH_TAG_FW_BODY, &size)) ||
+	    (rv = vb2api_extend_hash(&ctx, body, size)))
+		return rv;
+
+	return vb2api_check_hash(&ctx);
+}
+
+/* Kernel vblock verification, after vb2api_kernel_phase1() kept the key */
+static int run_kernel(uint32_t workbuf_size,
+		      const struct vb2_packed_key *kernel_key)
+{
+	struct vb2_shared_data *sd;
+	uint32_t key_size = kernel_key->key_offset + kernel_key->key_size;
+	struct vb2_workbuf wb;
+	uint8_t *key_data;
+	int rv;
+
+	reset_ctx(workbuf_size);
+	sd = vb2_get_sd(&ctx);
+	vb2_workbuf_from_ctx(&ctx, &wb);
+	key_data = vb2_workbuf_alloc(&wb, key_size);
+	if (!key_data)
+		return VB2_ERROR_API_KPHASE1_WORKBUF_REC_KEY;
+	memcpy(key_data, kernel_key, key_size);
+	sd->workbuf_kernel_key_offset = vb2_offset_of(ctx.workbuf, key_data);
+	sd->workbuf_kernel_key_size = key_size;
+	vb2_set_workbuf_used(&ctx, sd->workbuf_kernel_key_offset + key_size);
+
+	if ((rv = vb2_load_kernel_keyblock(&ctx)))
+		return rv;
+
+	return vb2_load_kernel_preamble(&ctx);
+}
+
+static void fw_size_test(const struct test_perm *perm, const char *keys_dir)
+{
+	struct vb2_workbuf_stats *stats;
+	struct vb2_gbb_header *gbb;
+	struct vb2_keyblock *kb;
+	struct vb2_signature *body_sig;
+	struct vb2_fw_preamble *pre;
+	struct test_keys keys;
+	uint32_t root_size, peak;
+
+	if (read_keys(&keys, perm, keys_dir)) {
+		TEST_TRUE(0, "read firmware keys");
+		goto out;
+	}
+
+	/* GBB header followed by the root key */
+	root_size = keys.signing_public_key->key_offset +
+		keys.signing_public_key->key_size;
+	free(gbb_data);
+	gbb_size = sizeof(*gbb) + root_size;
+	gbb_data = calloc(1, gbb_size);
+	gbb = (struct vb2_gbb_header *)gbb_data;
+	memcpy(gbb->signature, VB2_GBB_SIGNATURE, VB2_GBB_SIGNATURE_SIZE);
+	gbb->major_version = VB2_GBB_MAJOR_VER;
+	gbb->minor_version = VB2_GBB_MINOR_VER;
+	gbb->header_size = sizeof(*gbb);
+	gbb->rootkey_offset = sizeof(*gbb);
+	gbb->rootkey_size = root_size;
+	gbb->recovery_key_offset = sizeof(*gbb);
+	gbb->recovery_key_size = root_size;
+	memcpy(gbb_data + sizeof(*gbb), keys.signing_public_key, root_size);
+
+	kb = vb2_create_keyblock(keys.data_public_key,
+				 keys.signing_private_key, 0);
+	body_sig = vb2_calculate_signature(body, sizeof(body),
+					   keys.data_private_key);
+	pre = vb2_create_fw_preamble(1, keys.data_public_key, body_sig,
+				     keys.data_private_key, 0);
+	set_vblock(kb, pre, pre->preamble_size);
+
+	TEST_SUCC(run_fw(TEST_WORKBUF_SIZE), "firmware verification");
+	stats = &vb2_get_sd(&ctx)->workbuf_stats;
+	peak = stats->peak;
+	printf("firmware root %-14s data %-14s: keyblock %5u  "
+	       "preamble %5u  hash %5u  minimum %5u\n",
+	       vb2_get_crypto_algorithm_name(perm->signing_algorithm),
+	       vb2_get_crypto_algorithm_name(perm->data_key_algorithm),
+	       stats->phase_peak[VB2_WORKBUF_PHASE_FW_KEYBLOCK],
+	       stats->phase_peak[VB2_WORKBUF_PHASE_FW_PREAMBLE],
+	       stats->phase_peak[VB2_WORKBUF_PHASE_FW_HASH], peak);
+	TEST_TRUE(peak <= VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE,
+		  "  fits in recommended size");
+
+	TEST_SUCC(run_fw(peak), "  enough at peak");
+	TEST_EQ(vb2_get_sd(&ctx)->workbuf_stats.peak, peak, "  same peak");
+	TEST_NEQ(run_fw(peak - VB2_WORKBUF_ALIGN), VB2_SUCCESS,
+		 "  not enough below peak");
+
+	free(kb);
+	free(body_sig);
+	free(pre);
+ out:
+	free_keys(&keys);
+}
+
+static void kernel_size_test(const struct test_perm *perm,
+			     const char *keys_dir)
+{
+	struct vb2_workbuf_stats *stats;
+	struct vb2_keyblock *kb;
+	struct vb2_signature *body_sig;
+	struct vb2_kernel_preamble *pre;
+	struct test_keys keys;
+	uint32_t peak;
+
+	if (read_keys(&keys, perm, keys_dir)) {
+		TEST_TRUE(0, "read kernel keys");
+		goto out;
+	}
+
+	kb = vb2_create_keyblock(keys.data_public_key,
+				 keys.signing_private_key,
+				 VB2_KEY_BLOCK_FLAG_DEVELOPER_0 |
+				 VB2_KEY_BLOCK_FLAG_RECOVERY_0);
+	body_sig = vb2_calculate_signature(body, sizeof(body),
+					   keys.data_private_key);
+	pre = vb2_create_kernel_preamble(1, 0x100000, 0x101000, 0x1000,
+					 body_sig, 0, 0, 0, 0,
+					 keys.data_private_key);
+	set_vblock(kb, pre, pre->preamble_size);
+
+	TEST_SUCC(run_kernel(TEST_WORKBUF_SIZE, keys.signing_public_key),
+		  "kernel vblock verification");
+	stats = &vb2_get_sd(&ctx)->workbuf_stats;
+	peak = stats->peak;
+	printf("kernel subkey %-14s data %-14s: vblock %5u  minimum %5u\n",
+	       vb2_get_crypto_algorithm_name(perm->signing_algorithm),
+	       vb2_get_crypto_algorithm_name(perm->data_key_algorithm),
+	       stats->phase_peak[VB2_WORKBUF_PHASE_KERNEL_VBLOCK], peak);
+	TEST_TRUE(peak <= VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE,
+		  "  fits in recommended size");
+
+	TEST_SUCC(run_kernel(peak, keys.signing_public_key),
+		  "  enough at peak");
+	TEST_NEQ(run_kernel(peak - VB2_WORKBUF_ALIGN,
+			    keys.signing_public_key), VB2_SUCCESS,
+		 "  not enough below peak");
+
+	free(kb);
+	free(body_sig);
+	free(pre);
+ out:
+	free_keys(&keys);
+}
+
+/* The high-water marks themselves */
+static void stats_tests(void)
+{
+	struct vb2_workbuf_stats *stats;
+	struct vb2_context job;
+	struct vb2_workbuf wb;
+	uint32_t base;
+
+	reset_ctx(TEST_WORKBUF_SIZE);
+	stats = &vb2_get_sd(&ctx)->workbuf_stats;
+	base = ctx.workbuf_used;
+	TEST_EQ(stats->peak, base, "init counts shared data");
+	TEST_EQ(stats->phase, VB2_WORKBUF_PHASE_OTHER, "  phase");
+
+	vb2_set_workbuf_phase(&ctx, VB2_WORKBUF_PHASE_FW_KEYBLOCK);
+	TEST_EQ(stats->phase_peak[VB2_WORKBUF_PHASE_FW_KEYBLOCK], base,
+		"phase counts data already kept");
+
+	vb2_workbuf_from_ctx(&ctx, &wb);
+	vb2_workbuf_alloc(&wb, 100);
+	vb2_workbuf_alloc(&wb, 200);
+	vb2_workbuf_free(&wb, 200);
+	TEST_EQ(stats->peak, base + vb2_wb_round_up(100) +
+		vb2_wb_round_up(200), "alloc peak");
+	TEST_EQ(stats->phase_peak[VB2_WORKBUF_PHASE_FW_KEYBLOCK],
+		stats->peak, "  phase peak");
+	TEST_EQ(stats->phase_peak[VB2_WORKBUF_PHASE_OTHER], base,
+		"  other phase untouched");
+
+	vb2_set_workbuf_phase(&ctx, VB2_WORKBUF_PHASE_FW_PREAMBLE);
+	vb2_workbuf_alloc(&wb, 8);
+	TEST_EQ(stats->phase_peak[VB2_WORKBUF_PHASE_FW_PREAMBLE],
+		base + vb2_wb_round_up(100) + vb2_wb_round_up(8),
+		"phase switch redirects existing work buffer");
+	vb2_set_workbuf_used(&ctx, base + 1000);
+	TEST_EQ(stats->phase_peak[VB2_WORKBUF_PHASE_FW_PREAMBLE],
+		vb2_wb_round_up(base + 1000), "workbuf used counts");
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	vb2_workbuf_alloc(&wb, sizeof(workbuf));
+	TEST_EQ(stats->peak, vb2_wb_round_up(base + 1000),
+		"other work buffers not counted");
+
+	/* A vblock prefetch job shares the work buffer but not the stats */
+	job = ctx;
+	job.workbuf_used = 0;
+	vb2_set_workbuf_phase(&job, VB2_WORKBUF_PHASE_KERNEL_VBLOCK);
+	TEST_EQ(stats->phase, VB2_WORKBUF_PHASE_FW_PREAMBLE,
+		"no shared data, phase untouched");
+}
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <keys_dir>\n", argv[0]);
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(body); i++)
+		body[i] = i * 7;
+
+	stats_tests();
+
+	for (i = 0; i < ARRAY_SIZE(test_perms); i++) {
+		fw_size_test(&test_perms[i], argv[1]);
+		kernel_size_test(&test_perms[i], argv[1]);
+	}
+
+	free(gbb_data);
+	free(vblock_data);
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -212,7 +212,7 @@ static void init_hash_tests(void)
 		  "init hash good");
 	TEST_EQ(sd->workbuf_hash_offset, wb_used_before,
 		"hash context offset");
-	TEST_EQ(sd->workbuf_hash_size, sizeof(struct vb2_digest_context),
+	TEST_EQ(sd->workbuf_hash_size, vb2_digest_context_size(mock_hash_alg),
 		"hash context size");
 	TEST_EQ(ctx.workbuf_used,
 		vb2_wb_round_up(sd->workbuf_hash_offset +
@@ -243,7 +243,7 @@ static void init_hash_tests(void)
 
 	reset_common_data(FOR_MISC);
 	ctx.workbuf_used = ctx.workbuf_size + VB2_WORKBUF_ALIGN -
-			vb2_wb_round_up(sizeof(struct vb2_digest_context));
+			vb2_wb_round_up(vb2_digest_context_size(mock_hash_alg));
 	TEST_EQ(vb21api_init_hash(&ctx, test_id, &size),
 		VB2_ERROR_API_INIT_HASH_WORKBUF, "init hash workbuf");
 
@@ -23,6 +23,17 @@
 static const uint8_t test_data[] = "This is some test data to sign.";
 static const uint32_t test_size = sizeof(test_data);
 
+static int mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+static int mock_hwcrypto_rsa_calls;
+
+int vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+				     const uint8_t *sig,
+				     const uint8_t *digest)
+{
+	mock_hwcrypto_rsa_calls++;
+	return mock_hwcrypto_rsa_retval;
+}
+
 static void test_unpack_key(const struct vb21_packed_key *key)
 {
 	struct vb2_public_key pubk;
@@ -237,6 +248,61 @@ static void test_verify_data(const struct vb2_public_key *pubk_orig,
 	free(buf2);
 }
 
+static void test_verify_hwcrypto(const struct vb2_public_key *pubk_orig,
+				 const struct vb21_packed_key *key,
+				 const struct vb21_signature *sig)
+{
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	struct vb2_public_key pubk;
+	struct vb21_signature *sig2;
+	uint8_t *buf2;
+	uint32_t size = sig->c.total_size;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	buf2 = malloc(size);
+	sig2 = (struct vb21_signature *)buf2;
+
+	pubk.allow_hwcrypto = 1;
+	TEST_SUCC(vb21_unpack_key(&pubk, (const uint8_t *)key,
+				  key->c.total_size),
+		  "hwcrypto RSA unpack key");
+	TEST_EQ(pubk.allow_hwcrypto, 0, "  not allowed by default");
+
+	/* Not allowed; the engine isn't asked */
+	pubk = *pubk_orig;
+	mock_hwcrypto_rsa_retval = VB2_SUCCESS;
+	mock_hwcrypto_rsa_calls = 0;
+	memcpy(buf2, sig, size);
+	buf2[sig2->sig_offset] ^= 0x5A;
+	TEST_EQ(vb21_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		VB2_ERROR_RSA_PADDING, "hwcrypto RSA not allowed");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 0, "  used sw");
+
+	/* Allowed but unsupported falls back to software */
+	pubk.allow_hwcrypto = 1;
+	mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	TEST_EQ(vb21_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		VB2_ERROR_RSA_PADDING, "hwcrypto RSA unsupported");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 1, "  tried hwcrypto");
+
+	/* Otherwise the engine's answer is final */
+	mock_hwcrypto_rsa_retval = VB2_SUCCESS;
+	TEST_SUCC(vb21_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		  "hwcrypto RSA used");
+	TEST_EQ(mock_hwcrypto_rsa_calls, 2, "  used hwcrypto");
+
+	mock_hwcrypto_rsa_retval = VB2_ERROR_RSA_VERIFY_DIGEST;
+	memcpy(buf2, sig, size);
+	TEST_EQ(vb21_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		VB2_ERROR_RSA_VERIFY_DIGEST, "hwcrypto RSA failed");
+
+	mock_hwcrypto_rsa_retval = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	free(buf2);
+}
+
 static int test_algorithm(int key_algorithm, const char *keys_dir)
 {
 	char filename[1024];
@@ -295,6 +361,7 @@ static int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	test_unpack_key(key2);
 	test_verify_data(pubk, sig2);
+	test_verify_hwcrypto(pubk, key2, sig2);
 	test_verify_signature(sig2);
 
 	free(keyb_data);
@@ -5,7 +5,10 @@
  * Tests for host library vboot2 key functions
  */
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
@@ -13,6 +16,7 @@
 #include "2rsa.h"
 #include "vb21_common.h"
 #include "host_common.h"
+#include "host_key.h"
 #include "host_key2.h"
 
 #include "test_common.h"
@@ -280,6 +284,106 @@ static void public_key_tests(const struct alg_combo *combo,
 	free(pkey);
 }
 
+struct key_cache_job {
+	const char *pemfile;
+	enum vb2_crypto_algorithm alg;
+	struct vb2_private_key *want;
+	int same;
+};
+
+static void *key_cache_worker(void *arg)
+{
+	struct key_cache_job *job = arg;
+	struct vb2_private_key *key;
+	int i;
+
+	for (i = 0; i < 50; i++) {
+		key = vb2_get_private_key_pem(job->pemfile, job->alg);
+		job->same += key == job->want;
+		vb2_put_private_key(key);
+	}
+	return NULL;
+}
+
+static void key_cache_tests(const struct alg_combo *combo,
+			    const char *pemfile, const char *temp_dir)
+{
+	enum vb2_crypto_algorithm alg =
+		vb2_get_crypto_algorithm(combo->hash_alg, combo->sig_alg);
+	enum vb2_crypto_algorithm other_alg =
+		vb2_get_crypto_algorithm(combo->hash_alg == VB2_HASH_SHA1 ?
+					 VB2_HASH_SHA256 : VB2_HASH_SHA1,
+					 combo->sig_alg);
+	struct vb2_private_key *key, *k2, *k3;
+	struct key_cache_job jobs[4];
+	pthread_t threads[ARRAY_SIZE(jobs)];
+	struct timespec times[2] = {{1, 0}, {1, 0}};
+	char *testfile;
+	int i;
+
+	xasprintf(&testfile, "%s/test.vbprivk", temp_dir);
+
+	/* The same .pem file and algorithm are shared, even after a put */
+	key = vb2_get_private_key_pem(pemfile, alg);
+	TEST_PTR_NEQ(key, NULL, "Get pem key");
+	TEST_EQ(key->hash_alg, combo->hash_alg, "  hash_alg");
+	TEST_EQ(key->sig_alg, combo->sig_alg, "  sig_alg");
+	k2 = vb2_get_private_key_pem(pemfile, alg);
+	TEST_PTR_EQ(k2, key, "  same key again");
+	k3 = vb2_get_private_key_pem(pemfile, other_alg);
+	TEST_PTR_NEQ(k3, NULL, "  other algorithm");
+	TEST_PTR_NEQ(k3, key, "  is another key");
+	TEST_EQ(k3->hash_alg, combo->hash_alg == VB2_HASH_SHA1 ?
+		VB2_HASH_SHA256 : VB2_HASH_SHA1, "  with its hash_alg");
+	vb2_put_private_key(k3);
+	vb2_put_private_key(k2);
+	vb2_put_private_key(key);
+	k2 = vb2_get_private_key_pem(pemfile, alg);
+	TEST_PTR_EQ(k2, key, "  still cached");
+
+	/* From several threads at once */
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		jobs[i].pemfile = pemfile;
+		jobs[i].alg = alg;
+		jobs[i].want = k2;
+		jobs[i].same = 0;
+		TEST_SUCC(pthread_create(&threads[i], NULL, key_cache_worker,
+					 &jobs[i]), "  start thread");
+	}
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		pthread_join(threads[i], NULL);
+		TEST_EQ(jobs[i].same, 50, "  same key on thread");
+	}
+	vb2_put_private_key(k2);
+
+	/* A changed .vbprivk file is read again */
+	TEST_SUCC(vb2_write_private_key(testfile, key), "Write vbprivk");
+	key = vb2_get_private_key(testfile);
+	TEST_PTR_NEQ(key, NULL, "Get vbprivk key");
+	k2 = vb2_get_private_key(testfile);
+	TEST_PTR_EQ(k2, key, "  same key again");
+	vb2_put_private_key(k2);
+	TEST_SUCC(utimensat(AT_FDCWD, testfile, times, 0), "  touch file");
+	k2 = vb2_get_private_key(testfile);
+	TEST_PTR_NEQ(k2, NULL, "  get changed file");
+	TEST_PTR_NEQ(k2, key, "  is another key");
+	TEST_EQ(k2->sig_alg, combo->sig_alg, "  with the same sig_alg");
+	vb2_put_private_key(key);
+	vb2_put_private_key(k2);
+	k3 = vb2_get_private_key(testfile);
+	TEST_PTR_EQ(k3, k2, "  which is cached");
+	vb2_put_private_key(k3);
+
+	unlink(testfile);
+	TEST_PTR_EQ(vb2_get_private_key_pem(testfile, alg), NULL,
+		    "Get missing file");
+	TEST_PTR_EQ(vb2_get_private_key_pem(pemfile, VB2_ALG_COUNT), NULL,
+		    "Get pem with bad algorithm");
+	vb2_put_private_key(NULL);
+
+	free(testfile);
+}
+
 static int test_algorithm(const struct alg_combo *combo, const char *keys_dir,
 			  const char *temp_dir)
 {
@@ -294,6 +398,7 @@ static int test_algorithm(const struct alg_combo *combo, const char *keys_dir,
 
 	private_key_tests(combo, pemfile, temp_dir);
 	public_key_tests(combo, keybfile, temp_dir);
+	key_cache_tests(combo, pemfile, temp_dir);
 
 	free(pemfile);
 	free(keybfile);
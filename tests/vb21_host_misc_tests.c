@@ -10,6 +10,7 @@
 
 #include "2sysincludes.h"
 #include "2common.h"
+#include "2sha.h"
 #include "vb21_common.h"
 #include "host_common.h"
 #include "host_misc.h"
@@ -34,6 +35,10 @@ static void file_tests(const char *temp_dir)
 	const uint8_t test_data[] = "Some test data";
 	uint8_t *read_data;
 	uint32_t read_size;
+	uint64_t map_size;
+	FILE *f;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	uint8_t expect_digest[VB2_SHA256_DIGEST_SIZE];
 
 	uint8_t cbuf[sizeof(struct vb21_struct_common) + 12];
 	struct vb21_struct_common *c = (struct vb21_struct_common *)cbuf;
@@ -54,6 +59,50 @@ static void file_tests(const char *temp_dir)
 	TEST_EQ(read_size, sizeof(test_data), "  data size");
 	TEST_EQ(memcmp(read_data, test_data, read_size), 0, "  data");
 	free(read_data);
+
+	TEST_SUCC(vb2_map_file(testfile, &read_data, &map_size),
+		  "vb2_map_file() good");
+	TEST_EQ(map_size, sizeof(test_data), "  data size");
+	TEST_EQ(memcmp(read_data, test_data, map_size), 0, "  data");
+	read_data[0]++;
+	vb2_unmap_file(read_data, map_size);
+	TEST_SUCC(vb2_map_file(testfile, &read_data, &map_size),
+		  "vb2_map_file() again");
+	TEST_EQ(memcmp(read_data, test_data, map_size), 0,
+		"  changes not written back");
+	vb2_unmap_file(read_data, map_size);
+
+	TEST_SUCC(vb2_digest_buffer(test_data, sizeof(test_data),
+				    VB2_HASH_SHA256, expect_digest,
+				    sizeof(expect_digest)), "digest buffer");
+	TEST_SUCC(vb2_digest_file(testfile, VB2_HASH_SHA256, digest,
+				  sizeof(digest)), "vb2_digest_file() good");
+	TEST_EQ(memcmp(digest, expect_digest, sizeof(digest)), 0, "  digest");
+	TEST_EQ(vb2_digest_file(testfile, VB2_HASH_SHA256, digest, 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_file() digest size");
+	unlink(testfile);
+
+	TEST_EQ(vb2_map_file(testfile, &read_data, &map_size),
+		VB2_ERROR_MAP_FILE_OPEN, "vb2_map_file() missing");
+	TEST_EQ(vb2_digest_file(testfile, VB2_HASH_SHA256, digest,
+				sizeof(digest)),
+		VB2_ERROR_MAP_FILE_OPEN, "vb2_digest_file() missing");
+
+	f = fopen(testfile, "wb");
+	TEST_PTR_NEQ(f, NULL, "empty file");
+	fclose(f);
+	TEST_SUCC(vb2_map_file(testfile, &read_data, &map_size),
+		  "vb2_map_file() empty");
+	TEST_PTR_EQ(read_data, NULL, "  no data");
+	TEST_EQ(map_size, 0, "  data size");
+	vb2_unmap_file(read_data, map_size);
+	TEST_SUCC(vb2_digest_buffer(test_data, 0, VB2_HASH_SHA256,
+				    expect_digest, sizeof(expect_digest)),
+		  "digest empty buffer");
+	TEST_SUCC(vb2_digest_file(testfile, VB2_HASH_SHA256, digest,
+				  sizeof(digest)), "vb2_digest_file() empty");
+	TEST_EQ(memcmp(digest, expect_digest, sizeof(digest)), 0, "  digest");
 	unlink(testfile);
 
 	memset(cbuf, 0, sizeof(cbuf));
@@ -36,6 +36,63 @@ const char *test_sig_desc = "The test signature";
 const uint8_t test_data[] = "Some test data";
 const uint32_t test_size = sizeof(test_data);
 
+#define LIST_SIZE 5
+
+static void list_tests(const struct vb2_private_key *prik,
+		       const struct vb2_public_key *pubk)
+{
+	static const int thread_counts[] = {0, 1, 2, LIST_SIZE, 64};
+	struct vb21_signed_data list[LIST_SIZE];
+	struct vb21_signature *sig, *sigs[LIST_SIZE];
+	struct vb21_packed_key *packed;
+	int i, t;
+
+	TEST_SUCC(vb21_public_key_pack(&packed, pubk), "Pack pub key");
+	TEST_SUCC(vb21_sign_data(&sig, test_data, test_size, prik, NULL),
+		  "Sign for list");
+	for (i = 0; i < LIST_SIZE; i++)
+		sigs[i] = malloc(sig->c.total_size);
+
+	for (t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+		for (i = 0; i < LIST_SIZE; i++) {
+			memcpy(sigs[i], sig, sig->c.total_size);
+			list[i].data = test_data;
+			list[i].size = test_size;
+			list[i].sig = sigs[i];
+			list[i].result = -1;
+		}
+		TEST_SUCC(vb21_verify_data_list_threaded(list, LIST_SIZE,
+							 packed,
+							 thread_counts[t]),
+			  "Verify list");
+		for (i = 0; i < LIST_SIZE; i++)
+			TEST_SUCC(list[i].result, "  entry verified");
+
+		for (i = 0; i < LIST_SIZE; i++)
+			memcpy(sigs[i], sig, sig->c.total_size);
+		list[3].size--;
+		((uint8_t *)sigs[4])[sig->sig_offset] ^= 0x5a;
+		TEST_EQ(vb21_verify_data_list_threaded(list, LIST_SIZE,
+						       packed,
+						       thread_counts[t]),
+			VB2_ERROR_VDATA_SIZE, "Verify list with bad entries");
+		TEST_SUCC(list[2].result, "  good entry");
+		TEST_EQ(list[3].result, VB2_ERROR_VDATA_SIZE, "  wrong size");
+		TEST_EQ(list[4].result, VB2_ERROR_RSA_PADDING, "  wrong sig");
+	}
+
+	TEST_SUCC(vb21_verify_data_list_threaded(list, 0, packed, 4),
+		  "Verify empty list");
+	packed->c.magic++;
+	TEST_EQ(vb21_verify_data_list_threaded(list, LIST_SIZE, packed, 4),
+		VB2_ERROR_UNPACK_KEY_MAGIC, "Verify list with bad key");
+
+	for (i = 0; i < LIST_SIZE; i++)
+		free(sigs[i]);
+	free(sig);
+	free(packed);
+}
+
 static void sig_tests(const struct alg_combo *combo,
 		      const char *pemfile,
 		      const char *keybfile)
@@ -115,6 +172,38 @@ static void sig_tests(const struct alg_combo *combo,
 	TEST_EQ(vb21_sign_data(&sig, test_data, test_size, &prik2, NULL),
 		VB2_SIGN_DATA_SIG_SIZE, "Sign bad sig alg");
 
+	/* Signing with several keys at once matches signing with each */
+	{
+		const struct vb2_private_key *multi[3];
+		struct vb21_signature *sigs[3];
+		int i;
+
+		TEST_SUCC(vb2_private_key_hash(&multi[2], VB2_HASH_SHA512),
+			  "Private SHA-512 hash key");
+		multi[0] = prihash;
+		multi[1] = prik;
+		TEST_SUCC(vb21_sign_data_multiple(sigs, test_data, test_size,
+						  multi, 3),
+			  "Sign multiple");
+		for (i = 0; i < 3; i++) {
+			TEST_SUCC(vb21_sign_data(&sig, test_data, test_size,
+						 multi[i], NULL),
+				  "  sign alone");
+			TEST_EQ(sigs[i]->c.total_size, sig->c.total_size,
+				"  same size");
+			TEST_SUCC(memcmp(sigs[i], sig, sig->c.total_size),
+				  "  same signature");
+			free(sig);
+			free(sigs[i]);
+		}
+
+		multi[1] = &prik2;
+		TEST_EQ(vb21_sign_data_multiple(sigs, test_data, test_size,
+						multi, 3),
+			VB2_SIGN_DATA_SIG_SIZE, "Sign multiple bad sig alg");
+		TEST_PTR_EQ(sigs[0], NULL, "  no sigs");
+	}
+
 	/* Sign an object with a little (24 bytes) data */
 	c_sig_offs = sizeof(*c) + 24;
 	TEST_SUCC(vb21_sig_size_for_key(&size, prik, NULL), "Sig size");
@@ -159,6 +248,8 @@ static void sig_tests(const struct alg_combo *combo,
 
 	free(buf);
 
+	list_tests(prik, pubk);
+
 	vb2_private_key_free(prik);
 	vb2_public_key_free(pubk);
 }
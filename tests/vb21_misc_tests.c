@@ -49,6 +49,7 @@ static struct {
 } mock_vblock;
 
 static int mock_read_res_fail_on_call;
+static uint32_t mock_vblock_bytes_read;
 static int mock_unpack_key_retval;
 static int mock_verify_keyblock_retval;
 static int mock_verify_preamble_retval;
@@ -82,6 +83,7 @@ static void reset_common_data(enum reset_type t)
 	vb2_secdata_init(&ctx);
 
 	mock_read_res_fail_on_call = 0;
+	mock_vblock_bytes_read = 0;
 	mock_unpack_key_retval = VB2_SUCCESS;
 	mock_verify_keyblock_retval = VB2_SUCCESS;
 	mock_verify_preamble_retval = VB2_SUCCESS;
@@ -154,6 +156,9 @@ int vb2ex_read_resource(struct vb2_context *c,
 	if (offset > rsize || offset + size > rsize)
 		return VB2_ERROR_EX_READ_RESOURCE_SIZE;
 
+	if (index == VB2_RES_FW_VBLOCK)
+		mock_vblock_bytes_read += size;
+
 	memcpy(buf, rptr + offset, size);
 	return VB2_SUCCESS;
 }
@@ -194,6 +199,8 @@ static void load_keyblock_tests(void)
 	reset_common_data(FOR_KEYBLOCK);
 	wb_used_before = ctx.workbuf_used;
 	TEST_SUCC(vb21_load_fw_keyblock(&ctx), "keyblock verify");
+	TEST_EQ(mock_vblock_bytes_read, sizeof(mock_vblock.k),
+		"keyblock read once");
 	TEST_EQ(sd->fw_version, 0x20000, "keyblock version");
 	TEST_EQ(sd->vblock_preamble_offset, sizeof(mock_vblock.k),
 		"preamble offset");
@@ -300,7 +307,9 @@ static void load_preamble_tests(void)
 	/* Test successful call */
 	reset_common_data(FOR_PREAMBLE);
 	data_key_offset_before = sd->workbuf_data_key_offset;
+	mock_vblock_bytes_read = 0;
 	TEST_SUCC(vb21_load_fw_preamble(&ctx), "preamble good");
+	TEST_EQ(mock_vblock_bytes_read, pre->c.total_size, "preamble read once");
 	TEST_EQ(sd->fw_version, 0x20002, "combined version");
 	TEST_EQ(sd->workbuf_preamble_offset, data_key_offset_before,
 		"preamble offset");
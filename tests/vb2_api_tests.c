@@ -40,6 +40,8 @@ static int retval_vb2_fw_parse_gbb;
 static int retval_vb2_check_dev_switch;
 static int retval_vb2_check_tpm_clear;
 static int retval_vb2_select_fw_slot;
+static uint32_t mock_timestamps[8];
+static int mock_timestamp_count;
 
 /* Type of test to reset for */
 enum reset_type {
@@ -67,6 +69,8 @@ static void reset_common_data(enum reset_type t)
 	retval_vb2_check_dev_switch = VB2_SUCCESS;
 	retval_vb2_check_tpm_clear = VB2_SUCCESS;
 	retval_vb2_select_fw_slot = VB2_SUCCESS;
+	memset(mock_timestamps, 0, sizeof(mock_timestamps));
+	mock_timestamp_count = 0;
 
 	memcpy(&gbb.hwid_digest, mock_hwid_digest,
 	       sizeof(gbb.hwid_digest));
@@ -100,6 +104,13 @@ int vb2_select_fw_slot(struct vb2_context *c)
 	return retval_vb2_select_fw_slot;
 }
 
+void vb2ex_timestamp(enum vb2_timestamp_id id)
+{
+	if (mock_timestamp_count < ARRAY_SIZE(mock_timestamps))
+		mock_timestamps[mock_timestamp_count] = id;
+	mock_timestamp_count++;
+}
+
 /* Tests */
 
 static void misc_tests(void)
@@ -128,6 +139,9 @@ static void phase1_tests(void)
 	TEST_SUCC(vb2api_fw_phase1(&ctx), "phase1 good");
 	TEST_EQ(sd->recovery_reason, 0, "  not recovery");
 	TEST_EQ(ctx.flags & VB2_CONTEXT_RECOVERY_MODE, 0, "  recovery flag");
+	TEST_EQ(mock_timestamp_count, 2, "  timestamps");
+	TEST_EQ(mock_timestamps[0], VB2_TS_FW_PHASE1_START, "  start");
+	TEST_EQ(mock_timestamps[1], VB2_TS_FW_PHASE1_END, "  end");
 	TEST_EQ(ctx.flags & VB2_CONTEXT_CLEAR_RAM, 0, "  clear ram flag");
 	TEST_EQ(ctx.flags & VB2_CONTEXT_DISPLAY_INIT,
 		0, "  display init context flag");
@@ -285,6 +299,9 @@ static void phase2_tests(void)
 	TEST_SUCC(vb2api_fw_phase2(&ctx), "phase2 good");
 	TEST_EQ(ctx.flags & VB2_CONTEXT_CLEAR_RAM, 0, "  clear ram flag");
 	TEST_EQ(ctx.flags & VB2_CONTEXT_FW_SLOT_B, 0, "  slot b flag");
+	TEST_EQ(mock_timestamp_count, 2, "  timestamps");
+	TEST_EQ(mock_timestamps[0], VB2_TS_FW_PHASE2_START, "  start");
+	TEST_EQ(mock_timestamps[1], VB2_TS_FW_PHASE2_END, "  end");
 
 	reset_common_data(FOR_MISC);
 	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
@@ -302,6 +319,7 @@ static void phase2_tests(void)
 	TEST_EQ(vb2api_fw_phase2(&ctx), VB2_ERROR_MOCK, "phase2 slot");
 	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_RECOVERY_REQUEST),
 		VB2_RECOVERY_FW_SLOT, "  recovery reason");
+	TEST_EQ(mock_timestamp_count, 1, "  no end timestamp");
 
 	/* S3 resume exits before clearing RAM */
 	reset_common_data(FOR_MISC);
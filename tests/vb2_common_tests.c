@@ -40,6 +40,88 @@ static void test_memcmp(void)
 	TEST_EQ(vb2_safe_memcmp("foo1", "foo2", 0), 0, "memcmp 0-size");
 }
 
+/**
+ * Test memory compare over every alignment, size and mismatch position the
+ * word and vector loops care about
+ */
+static void test_memcmp_alignment(void)
+{
+	uint8_t a[96], b[96];
+	int offs1, offs2, size, i, diff;
+	int errors = 0;
+
+	for (i = 0; i < sizeof(a); i++)
+		a[i] = b[i] = i * 37 + 1;
+
+	for (offs1 = 0; offs1 < 8; offs1++) {
+		for (offs2 = 0; offs2 < 8; offs2++) {
+			for (size = 0; size <= 80; size++) {
+				if (vb2_safe_memcmp(a + offs1, b + offs1, size))
+					errors++;
+				if (!size)
+					continue;
+				for (i = 0; i < size; i++) {
+					b[offs2 + i] ^= 0x80;
+					diff = vb2_safe_memcmp(a + offs2,
+							       b + offs2, size);
+					b[offs2 + i] ^= 0x80;
+					if (!diff)
+						errors++;
+				}
+				/* The bytes just outside don't matter */
+				a[offs1 + size] ^= 0x01;
+				if (offs1)
+					a[offs1 - 1] ^= 0x01;
+				if (vb2_safe_memcmp(a + offs1, b + offs1, size))
+					errors++;
+				a[offs1 + size] ^= 0x01;
+				if (offs1)
+					a[offs1 - 1] ^= 0x01;
+				/* Different alignments, so no word compares */
+				if (vb2_safe_memcmp(a + offs1, a + offs2, size) !=
+				    (offs1 != offs2))
+					errors++;
+			}
+		}
+	}
+	TEST_EQ(errors, 0, "memcmp alignments");
+}
+
+/**
+ * Test memory compare on a buffer big enough for the vector loop to do most
+ * of the work.  How long it takes for each mismatch position is measured by
+ * crypto_benchmark instead.
+ */
+static void test_memcmp_large(void)
+{
+	const size_t size = 256 * 1024;
+	uint8_t *a = malloc(size);
+	uint8_t *b = malloc(size);
+
+	TEST_PTR_NEQ(a, NULL, "memcmp large alloc");
+	TEST_PTR_NEQ(b, NULL, "memcmp large alloc");
+	if (!a || !b) {
+		free(a);
+		free(b);
+		return;
+	}
+
+	memset(a, 0x5a, size);
+	memset(b, 0x5a, size);
+	TEST_EQ(vb2_safe_memcmp(a, b, size), 0, "memcmp large equal");
+	b[0] ^= 1;
+	TEST_NEQ(vb2_safe_memcmp(a, b, size), 0, "memcmp large first byte");
+	b[0] ^= 1;
+	b[size / 2] ^= 1;
+	TEST_NEQ(vb2_safe_memcmp(a, b, size), 0, "memcmp large middle byte");
+	b[size / 2] ^= 1;
+	b[size - 1] ^= 1;
+	TEST_NEQ(vb2_safe_memcmp(a, b, size), 0, "memcmp large last byte");
+
+	free(a);
+	free(b);
+}
+
 /**
  * Test alignment functions
  */
@@ -218,6 +300,8 @@ int main(int argc, char* argv[])
 {
 	test_struct_packing();
 	test_memcmp();
+	test_memcmp_alignment();
+	test_memcmp_large();
 	test_align();
 	test_workbuf();
 	test_helper_functions();
@@ -0,0 +1,73 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for CRC-8, whichever way VB2_CRC8_TABLE has it computed
+ */
+
+#include "2sysincludes.h"
+#include "2crc8.h"
+
+#include "test_common.h"
+
+/* CRC-8 a bit at a time, to check the table-driven versions against */
+static uint8_t crc8_bitwise(const uint8_t *data, uint32_t size)
+{
+	uint8_t crc = 0;
+	int i;
+
+	for (; size; size--, data++) {
+		crc ^= *data;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+
+	return crc;
+}
+
+static void known_value_tests(void)
+{
+	const uint8_t zeroes[16] = {0};
+	const uint8_t ones[4] = {0xff, 0xff, 0xff, 0xff};
+
+	TEST_EQ(vb2_crc8("123456789", 9), 0xf4, "check value");
+	TEST_EQ(vb2_crc8("", 0), 0, "empty");
+	TEST_EQ(vb2_crc8(zeroes, sizeof(zeroes)), 0, "zeroes");
+	TEST_EQ(vb2_crc8(ones, 1), 0xf3, "0xff");
+	TEST_EQ(vb2_crc8(ones, sizeof(ones)), 0xde, "0xffffffff");
+}
+
+static void reference_tests(void)
+{
+	uint8_t data[1024];
+	uint32_t seed = 1;
+	int i, mismatches = 0;
+
+	/* Every single byte value */
+	for (i = 0; i < 256; i++) {
+		data[0] = i;
+		if (vb2_crc8(data, 1) != crc8_bitwise(data, 1))
+			mismatches++;
+	}
+	TEST_EQ(mismatches, 0, "single bytes");
+
+	for (i = 0; i < sizeof(data); i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 24;
+	}
+
+	mismatches = 0;
+	for (i = 0; i <= sizeof(data); i++) {
+		if (vb2_crc8(data, i) != crc8_bitwise(data, i))
+			mismatches++;
+	}
+	TEST_EQ(mismatches, 0, "random data");
+}
+
+int main(int argc, char* argv[])
+{
+	known_value_tests();
+	reference_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
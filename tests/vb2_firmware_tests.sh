@@ -56,3 +56,28 @@ echo 'Verifying test firmware using vb2_verify_fw'
 ${BUILD_RUN}/tests/vb20_verify_fw gbb.test vblock.test body.test
 
 happy 'vb2_verify_fw succeeded'
+
+echo 'Verifying test firmware hashed in chunks'
+
+# Same firmware, with the body hashed in 16-byte chunks
+${FUTILITY} vbutil_firmware \
+    --vblock vblock_chunked.test \
+    --keyblock keyblock.test \
+    --signprivate ${TESTKEY_DIR}/key_rsa4096.sha256.vbprivk \
+    --fv body.test \
+    --version 1 \
+    --kernelkey kernkey.test \
+    --chunk_size 16
+
+${FUTILITY} vbutil_firmware --verify vblock_chunked.test \
+    --signpubkey rootkey.test --fv body.test | grep -q 'Body chunk size: *16'
+${BUILD_RUN}/tests/vb20_verify_fw gbb.test vblock_chunked.test body.test
+
+# A change to any chunk is caught
+sed 's/only/ONLY/' body.test > body_bad.test
+if ${BUILD_RUN}/tests/vb20_verify_fw gbb.test vblock_chunked.test \
+    body_bad.test; then
+  error 'vb2_verify_fw accepted a bad chunk'
+fi
+
+happy 'vb2_verify_fw succeeded with chunks'
@@ -16,6 +16,7 @@ static struct vb2_packed_key *rootkey;
 static struct vb2_context ctx;
 static struct vb2_workbuf wb;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
+static int read_resource_calls;
 
 static void set_gbb_hwid(const char *hwid, size_t size)
 {
@@ -48,6 +49,8 @@ static void reset_common_data(void)
 	const char hwid_src[] = "Test HWID";
 	set_gbb_hwid(hwid_src, sizeof(hwid_src));
 
+	read_resource_calls = 0;
+
 	memset(workbuf, 0, sizeof(workbuf));
 	memset(&ctx, 0, sizeof(ctx));
 	ctx.workbuf = workbuf;
@@ -71,6 +74,8 @@ int vb2ex_read_resource(struct vb2_context *c,
 	uint8_t *rptr;
 	uint32_t rsize;
 
+	read_resource_calls++;
+
 	switch(index) {
 	case VB2_RES_GBB:
 		rptr = (uint8_t *)&gbb_data;
@@ -205,6 +210,25 @@ static void key_tests(void)
 		0, "  copied key data successfully");
 	TEST_EQ(size, rootkey->key_offset + rootkey->key_size,
 		"  correct size returned");
+	TEST_EQ(read_resource_calls, 1, "  key read in one go");
+
+	/* Padded key doesn't fit in workbuf, but the key itself does */
+	reset_common_data();
+	rootkey->key_size = sizeof(key_data);
+	memcpy((void *)rootkey + rootkey->key_offset,
+	       key_data, sizeof(key_data));
+	gbb->rootkey_size = sizeof(gbb_data) - gbb->rootkey_offset;
+	wb.size = rootkey->key_offset + rootkey->key_size + VB2_WORKBUF_ALIGN;
+	wborig = wb;
+	TEST_SUCC(vb2_gbb_read_root_key(&ctx, &keyp, &size, &wb),
+		  "succeeds when only the unpadded key fits in workbuf");
+	TEST_TRUE(wb.size < wborig.size,
+		  "  workbuf shrank on success");
+	TEST_EQ(memcmp(rootkey, keyp, rootkey->key_offset + rootkey->key_size),
+		0, "  copied key data successfully");
+	TEST_EQ(size, rootkey->key_offset + rootkey->key_size,
+		"  correct size returned");
+	TEST_EQ(read_resource_calls, 2, "  header read first");
 
 	/* gbb.size > sizeof(vb2_packed_key) + packed_key.size
 	   packed_key.offset = +0 */
@@ -0,0 +1,127 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for extracting a vmlinuz from a kernel partition
+ */
+
+#include <sys/uio.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "vb2_struct.h"
+#include "vboot_host.h"
+
+#include "test_common.h"
+
+#define KEYBLOCK_SIZE 0x100
+#define PREAMBLE_SIZE 0x200
+#define BODY_SIZE 0x400
+#define HEADER_SIZE 0x40
+#define LOAD_ADDR 0x100000
+/* Offset of the vmlinuz header inside the kernel body */
+#define HEADER_OFFSET 0x300
+
+static uint8_t kpart[KEYBLOCK_SIZE + PREAMBLE_SIZE + BODY_SIZE]
+	__attribute__ ((aligned (8)));
+static struct vb2_keyblock *kb;
+static struct vb2_kernel_preamble *pre;
+
+static void reset_common_data(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(kpart); i++)
+		kpart[i] = i * 7;
+
+	kb = (struct vb2_keyblock *)kpart;
+	memset(kb, 0, sizeof(*kb));
+	kb->keyblock_size = KEYBLOCK_SIZE;
+
+	pre = (struct vb2_kernel_preamble *)(kpart + KEYBLOCK_SIZE);
+	memset(pre, 0, sizeof(*pre));
+	pre->preamble_size = PREAMBLE_SIZE;
+	pre->header_version_major = 2;
+	pre->header_version_minor = 2;
+	pre->body_load_address = LOAD_ADDR;
+	pre->body_signature.data_size = BODY_SIZE;
+	pre->vmlinuz_header_address = LOAD_ADDR + HEADER_OFFSET;
+	pre->vmlinuz_header_size = HEADER_SIZE;
+}
+
+static void segments_tests(void)
+{
+	struct iovec seg[VMLINUZ_SEGMENTS];
+	uint8_t *body = kpart + KEYBLOCK_SIZE + PREAMBLE_SIZE;
+
+	reset_common_data();
+	TEST_SUCC(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg),
+		  "ExtractVmlinuzSegments()");
+	TEST_PTR_EQ(seg[0].iov_base, body + HEADER_OFFSET, "  header ptr");
+	TEST_EQ(seg[0].iov_len, HEADER_SIZE, "  header size");
+	TEST_PTR_EQ(seg[1].iov_base, body, "  body ptr");
+	TEST_EQ(seg[1].iov_len, BODY_SIZE, "  body size");
+
+	reset_common_data();
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart) - 1, seg), 0,
+		 "  body past end");
+
+	reset_common_data();
+	kb->keyblock_size = sizeof(kpart);
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  keyblock too big");
+
+	reset_common_data();
+	pre->preamble_size = PREAMBLE_SIZE + BODY_SIZE + 1;
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  preamble too big");
+
+	reset_common_data();
+	pre->header_version_minor = 0;
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  old preamble has no vmlinuz header");
+
+	reset_common_data();
+	pre->vmlinuz_header_size = 0;
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  no vmlinuz header");
+
+	reset_common_data();
+	pre->vmlinuz_header_address = LOAD_ADDR - 1;
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  vmlinuz header before body");
+
+	reset_common_data();
+	pre->vmlinuz_header_address = LOAD_ADDR + BODY_SIZE - HEADER_SIZE + 1;
+	TEST_NEQ(ExtractVmlinuzSegments(kpart, sizeof(kpart), seg), 0,
+		 "  vmlinuz header past end");
+}
+
+static void extract_tests(void)
+{
+	uint8_t *body = kpart + KEYBLOCK_SIZE + PREAMBLE_SIZE;
+	void *vmlinuz = NULL;
+	size_t size = 0;
+
+	reset_common_data();
+	TEST_SUCC(ExtractVmlinuz(kpart, sizeof(kpart), &vmlinuz, &size),
+		  "ExtractVmlinuz()");
+	TEST_EQ(size, HEADER_SIZE + BODY_SIZE, "  size");
+	TEST_SUCC(memcmp(vmlinuz, body + HEADER_OFFSET, HEADER_SIZE),
+		  "  header");
+	TEST_SUCC(memcmp(vmlinuz + HEADER_SIZE, body, BODY_SIZE), "  body");
+	free(vmlinuz);
+
+	reset_common_data();
+	pre->vmlinuz_header_size = 0;
+	TEST_NEQ(ExtractVmlinuz(kpart, sizeof(kpart), &vmlinuz, &size), 0,
+		 "  no vmlinuz header");
+}
+
+int main(int argc, char* argv[])
+{
+	segments_tests();
+	extract_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,131 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host work buffer arenas
+ */
+
+#include <pthread.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "host_workbuf.h"
+
+#include "test_common.h"
+
+#define SLAB_SIZE 1024
+#define THREADS 8
+#define ROUNDS 2000
+
+static uint8_t arena_buf[SLAB_SIZE * 4 + VB2_WORKBUF_ALIGN]
+	__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+
+static struct vb2_arena arena;
+
+/* Set by a thread if it saw another thread's data in its slab */
+static int thread_collision;
+
+static void init_tests(void)
+{
+	struct vb2_workbuf wb;
+	uint8_t big[VB2_ARENA_MAX_SLABS * VB2_WORKBUF_ALIGN * 2];
+
+	TEST_EQ(vb2_arena_init(&arena, arena_buf, 4 * SLAB_SIZE, 0),
+		VB2_ERROR_ARENA_INIT_SIZE, "init zero slab");
+	TEST_EQ(vb2_arena_init(&arena, arena_buf, SLAB_SIZE - 1, SLAB_SIZE),
+		VB2_ERROR_ARENA_INIT_SIZE, "init too small");
+
+	TEST_SUCC(vb2_arena_init(&arena, arena_buf + 1, 4 * SLAB_SIZE,
+				 SLAB_SIZE + 1), "init unaligned");
+	TEST_EQ(arena.num_slabs, 3, "  slabs");
+	TEST_EQ(arena.slab_size, SLAB_SIZE, "  slab size");
+	TEST_PTR_EQ(arena.buf, arena_buf + VB2_WORKBUF_ALIGN, "  aligned buf");
+
+	TEST_SUCC(vb2_arena_init(&arena, big, sizeof(big), VB2_WORKBUF_ALIGN),
+		  "init big");
+	TEST_EQ(arena.num_slabs, VB2_ARENA_MAX_SLABS, "  slabs capped");
+	TEST_PTR_NEQ(vb2_arena_get(&arena, &wb), NULL, "  get");
+}
+
+static void get_put_tests(void)
+{
+	struct vb2_workbuf wb[4];
+	void *slab[4];
+	int i;
+
+	vb2_arena_init(&arena, arena_buf, 4 * SLAB_SIZE, SLAB_SIZE);
+
+	for (i = 0; i < 4; i++) {
+		slab[i] = vb2_arena_get(&arena, &wb[i]);
+		TEST_PTR_NEQ(slab[i], NULL, "get");
+		TEST_PTR_EQ(wb[i].buf, slab[i], "  workbuf buf");
+		TEST_EQ(wb[i].size, SLAB_SIZE, "  workbuf size");
+	}
+	TEST_PTR_NEQ(slab[0], slab[1], "slabs differ");
+	TEST_PTR_NEQ(slab[1], slab[2], "slabs differ");
+	TEST_PTR_NEQ(slab[2], slab[3], "slabs differ");
+	TEST_PTR_EQ(vb2_arena_get(&arena, &wb[0]), NULL, "get when full");
+
+	/* Allocating from a workbuf doesn't affect returning its slab */
+	vb2_workbuf_alloc(&wb[2], SLAB_SIZE);
+	vb2_arena_put(&arena, slab[2]);
+	TEST_PTR_EQ(vb2_arena_get(&arena, &wb[0]), slab[2], "get after put");
+	TEST_PTR_EQ(vb2_arena_get(&arena, &wb[0]), NULL, "  full again");
+}
+
+static void *thread_func(void *arg)
+{
+	uint8_t id = (uintptr_t)arg;
+	struct vb2_workbuf wb;
+	uint8_t *p, *slab;
+	int i, j;
+
+	for (i = 0; i < ROUNDS; i++) {
+		slab = vb2_arena_get(&arena, &wb);
+		if (!slab) {
+			sched_yield();
+			continue;
+		}
+
+		p = vb2_workbuf_alloc(&wb, 64);
+		memset(p, id, 64);
+		for (j = 0; j < 64; j++) {
+			if (p[j] != id)
+				thread_collision = 1;
+		}
+
+		vb2_arena_put(&arena, slab);
+	}
+
+	return NULL;
+}
+
+static void thread_tests(void)
+{
+	pthread_t threads[THREADS];
+	struct vb2_workbuf wb;
+	uintptr_t i;
+
+	vb2_arena_init(&arena, arena_buf, 4 * SLAB_SIZE, SLAB_SIZE);
+
+	for (i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_func, (void *)(i + 1));
+	for (i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	TEST_EQ(thread_collision, 0, "threads never share a slab");
+
+	/* Everything was returned */
+	for (i = 0; i < 4; i++)
+		TEST_PTR_NEQ(vb2_arena_get(&arena, &wb), NULL,
+			     "get after threads");
+}
+
+int main(int argc, char* argv[])
+{
+	init_tests();
+	get_put_tests();
+	thread_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,187 @@
+/* Copyright 2019 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for LZ4 compression and streaming decompression
+ */
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2lz4.h"
+#include "host_lz4.h"
+
+#include "test_common.h"
+
+#define DATA_SIZE (256 * 1024)
+
+static uint8_t data[DATA_SIZE];
+static uint8_t out[DATA_SIZE + VB2_LZ4_INPLACE_MARGIN(DATA_SIZE)];
+
+/*
+ * Fill data with something which compresses, but not too well: 16-byte pieces
+ * which are either random or copied from somewhere in the last 4 KB.
+ */
+static void fill_data(void)
+{
+	uint32_t seed = 1;
+	uint32_t i, j, from;
+
+	for (i = 0; i < DATA_SIZE; i += 16) {
+		seed = seed * 1103515245 + 12345;
+		from = i - 16 - (seed >> 20) % 4080;
+		for (j = i; j < i + 16; j++) {
+			if (i >= 4096 && (seed >> 16) % 4) {
+				data[j] = data[from + j - i];
+			} else {
+				seed = seed * 1103515245 + 12345;
+				data[j] = seed >> 24;
+			}
+		}
+	}
+}
+
+static void round_trip_tests(void)
+{
+	uint8_t *c;
+	uint32_t csize;
+	uint32_t sizes[] = {0, 1, 11, 12, 13, 100, 65536, DATA_SIZE};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		c = vb2_lz4_compress(data, sizes[i], &csize);
+		TEST_PTR_NEQ(c, NULL, "compress");
+		if (!c)
+			continue;
+		memset(out, 0, sizeof(out));
+		TEST_SUCC(vb2_lz4_decompress(c, csize, out, sizes[i]),
+			  "  decompress");
+		TEST_SUCC(memcmp(out, data, sizes[i]), "  same data");
+		free(c);
+	}
+
+	/* Runs compress to almost nothing */
+	memset(out, 'x', DATA_SIZE);
+	c = vb2_lz4_compress(out, DATA_SIZE, &csize);
+	TEST_TRUE(csize < DATA_SIZE / 100, "compress run");
+	memset(out, 0, DATA_SIZE);
+	TEST_SUCC(vb2_lz4_decompress(c, csize, out, DATA_SIZE),
+		  "  decompress");
+	TEST_EQ(out[DATA_SIZE - 1], 'x', "  last byte");
+	free(c);
+
+	c = vb2_lz4_compress(data, DATA_SIZE, &csize);
+	TEST_TRUE(csize < DATA_SIZE * 3 / 4, "compress data");
+	free(c);
+}
+
+static void streaming_tests(void)
+{
+	struct vb2_lz4_context lc;
+	uint8_t *c;
+	uint32_t csize, i;
+	int rv = VB2_SUCCESS;
+
+	c = vb2_lz4_compress(data, DATA_SIZE, &csize);
+
+	/* One byte at a time */
+	memset(out, 0, sizeof(out));
+	vb2_lz4_init(&lc, out, DATA_SIZE);
+	for (i = 0; i < csize && !rv; i++)
+		rv = vb2_lz4_extend(&lc, c + i, 1);
+	TEST_SUCC(rv, "extend byte at a time");
+	TEST_SUCC(vb2_lz4_finalize(&lc), "  finalize");
+	TEST_SUCC(memcmp(out, data, DATA_SIZE), "  same data");
+
+	/* Odd-sized pieces */
+	memset(out, 0, sizeof(out));
+	vb2_lz4_init(&lc, out, DATA_SIZE);
+	for (i = 0; i < csize && !rv; i += 777)
+		rv = vb2_lz4_extend(&lc, c + i,
+				    csize - i < 777 ? csize - i : 777);
+	TEST_SUCC(rv, "extend pieces");
+	TEST_SUCC(vb2_lz4_finalize(&lc), "  finalize");
+	TEST_SUCC(memcmp(out, data, DATA_SIZE), "  same data");
+
+	/* Stopping early */
+	vb2_lz4_init(&lc, out, DATA_SIZE);
+	TEST_SUCC(vb2_lz4_extend(&lc, c, csize - 1), "extend truncated");
+	TEST_EQ(vb2_lz4_finalize(&lc), VB2_ERROR_LZ4_TRUNCATED,
+		"  finalize");
+
+	free(c);
+}
+
+static void in_place_tests(void)
+{
+	uint32_t size = sizeof(out);
+	uint8_t *c;
+	uint32_t csize;
+
+	c = vb2_lz4_compress(data, DATA_SIZE, &csize);
+
+	/* Compressed data at the end of the buffer, with the margin */
+	memcpy(out + size - csize, c, csize);
+	TEST_SUCC(vb2_lz4_decompress(out + size - csize, csize, out,
+				     DATA_SIZE), "in place");
+	TEST_SUCC(memcmp(out, data, DATA_SIZE), "  same data");
+
+	/* Not enough room to stay behind the input */
+	memcpy(out + 100, c, csize);
+	TEST_EQ(vb2_lz4_decompress(out + 100, csize, out, DATA_SIZE),
+		VB2_ERROR_LZ4_OVERLAP, "in place overlap");
+
+	free(c);
+}
+
+static void error_tests(void)
+{
+	/* 4 literals "abcd", match offset 4 size 4, then 5 more literals */
+	uint8_t good[] = {0x40, 'a', 'b', 'c', 'd', 0x04, 0x00,
+			  0x50, 'e', 'f', 'g', 'h', 'i'};
+	uint8_t bad[sizeof(good)];
+
+	TEST_SUCC(vb2_lz4_decompress(good, sizeof(good), out, 13), "good");
+	TEST_SUCC(memcmp(out, "abcdabcdefghi", 13), "  data");
+
+	TEST_EQ(vb2_lz4_decompress(good, sizeof(good), out, 12),
+		VB2_ERROR_LZ4_OUTPUT_SIZE, "output too small");
+	TEST_EQ(vb2_lz4_decompress(good, sizeof(good), out, 14),
+		VB2_ERROR_LZ4_SIZE, "output too big");
+	TEST_EQ(vb2_lz4_decompress(good, 6, out, 13),
+		VB2_ERROR_LZ4_TRUNCATED, "truncated in offset");
+	TEST_EQ(vb2_lz4_decompress(good, 0, out, 0),
+		VB2_ERROR_LZ4_TRUNCATED, "empty");
+
+	memcpy(bad, good, sizeof(bad));
+	bad[5] = 0;
+	TEST_EQ(vb2_lz4_decompress(bad, sizeof(bad), out, 13),
+		VB2_ERROR_LZ4_OFFSET, "zero offset");
+	bad[5] = 5;
+	TEST_EQ(vb2_lz4_decompress(bad, sizeof(bad), out, 13),
+		VB2_ERROR_LZ4_OFFSET, "offset before start");
+
+	/* Extra size bytes can't grow the output past the buffer */
+	memcpy(bad, good, sizeof(bad));
+	bad[0] = 0xf0;
+	bad[1] = 0xff;
+	TEST_EQ(vb2_lz4_decompress(bad, sizeof(bad), out, 13),
+		VB2_ERROR_LZ4_OUTPUT_SIZE, "literal size too big");
+
+	memcpy(bad, good, sizeof(bad));
+	bad[0] = 0x4f;
+	bad[7] = 0xff;
+	TEST_EQ(vb2_lz4_decompress(bad, sizeof(bad), out, 13),
+		VB2_ERROR_LZ4_OUTPUT_SIZE, "match size too big");
+}
+
+int main(int argc, char* argv[])
+{
+	fill_data();
+
+	round_trip_tests();
+	streaming_tests();
+	in_place_tests();
+	error_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
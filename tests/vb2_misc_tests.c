@@ -27,6 +27,7 @@ void *mock_resource_ptr;
 uint32_t mock_resource_size;
 int mock_tpm_clear_called;
 int mock_tpm_clear_retval;
+uint32_t mock_utime;
 
 
 static void reset_common_data(void)
@@ -49,6 +50,7 @@ static void reset_common_data(void)
 
 	mock_tpm_clear_called = 0;
 	mock_tpm_clear_retval = VB2_SUCCESS;
+	mock_utime = 1000;
 };
 
 /* Mocked functions */
@@ -73,6 +75,11 @@ int vb2ex_read_resource(struct vb2_context *c,
 	return VB2_SUCCESS;
 }
 
+uint32_t vb2ex_utime(void)
+{
+	return mock_utime;
+}
+
 int vb2ex_tpm_clear_owner(struct vb2_context *c)
 {
 	mock_tpm_clear_called++;
@@ -617,6 +624,90 @@ static void select_slot_tests(void)
 		"prev failure");
 }
 
+static void trace_tests(void)
+{
+#if VB2_BOOT_TRACE
+	int i;
+
+	reset_common_data();
+	TEST_EQ(sd->trace_count, 0, "trace empty");
+	vb2_trace(&ctx, VB2_TRACE_RSA, VB2_TRACE_BEGIN);
+	mock_utime = 1234;
+	vb2_trace(&ctx, VB2_TRACE_RSA, VB2_TRACE_END);
+	TEST_EQ(sd->trace_count, 2, "trace count");
+	TEST_EQ(sd->trace[0].time_us, 1000, "  begin time");
+	TEST_EQ(sd->trace[0].event, VB2_TRACE_RSA, "  begin event");
+	TEST_EQ(sd->trace[0].type, VB2_TRACE_BEGIN, "  begin type");
+	TEST_EQ(sd->trace[1].time_us, 1234, "  end time");
+	TEST_EQ(sd->trace[1].event, VB2_TRACE_RSA, "  end event");
+	TEST_EQ(sd->trace[1].type, VB2_TRACE_END, "  end type");
+
+	/* Oldest entries are overwritten when the ring fills up */
+	reset_common_data();
+	for (i = 0; i < VB2_TRACE_ENTRIES + 3; i++) {
+		mock_utime = i;
+		vb2_trace(&ctx, VB2_TRACE_DISK_READ, VB2_TRACE_BEGIN);
+	}
+	TEST_EQ(sd->trace_count, VB2_TRACE_ENTRIES + 3, "trace wrap count");
+	TEST_EQ(sd->trace[2].time_us, VB2_TRACE_ENTRIES + 2, "  newest");
+	TEST_EQ(sd->trace[3].time_us, 3, "  oldest");
+
+	/* Nothing is recorded before the shared data exists */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.workbuf = workbuf;
+	ctx.workbuf_size = sizeof(workbuf);
+	memset(workbuf, 0, sizeof(workbuf));
+	vb2_trace(&ctx, VB2_TRACE_RSA, VB2_TRACE_BEGIN);
+	TEST_EQ(sd->trace_count, 0, "trace before init");
+
+	/* Reading the GBB is traced */
+	reset_common_data();
+	mock_resource_index = VB2_RES_GBB;
+	mock_resource_ptr = &gbb;
+	mock_resource_size = sizeof(gbb);
+	memcpy(gbb.signature, VB2_GBB_SIGNATURE, VB2_GBB_SIGNATURE_SIZE);
+	gbb.major_version = VB2_GBB_MAJOR_VER;
+	gbb.minor_version = VB2_GBB_MINOR_VER;
+	gbb.header_size = sizeof(gbb);
+	TEST_SUCC(vb2_fw_parse_gbb(&ctx), "parse gbb");
+	TEST_EQ(sd->trace_count, 2, "  traced");
+	TEST_EQ(sd->trace[0].event, VB2_TRACE_GBB_READ, "  begin event");
+	TEST_EQ(sd->trace[1].type, VB2_TRACE_END, "  end type");
+#endif
+}
+
+static void cost_tests(void)
+{
+	struct vb2_cost *c;
+
+	reset_common_data();
+	c = &sd->costs[VB2_COST_FW_PREAMBLE];
+	mock_utime = 1500;
+	vb2_cost_hash(&ctx, VB2_COST_FW_PREAMBLE, 1200, 100);
+	TEST_EQ(c->count, 0, "cost hash count");
+	TEST_EQ(c->crypto_us, 300, "  crypto time");
+	TEST_EQ(c->total_us, 0, "  total time");
+	TEST_EQ(c->hashed_bytes, 100, "  bytes");
+
+	mock_utime = 2000;
+	vb2_cost_add(&ctx, VB2_COST_FW_PREAMBLE, 1000, 1800, 28);
+	TEST_EQ(c->count, 1, "cost add count");
+	TEST_EQ(c->crypto_us, 500, "  crypto time");
+	TEST_EQ(c->total_us, 1000, "  total time");
+	TEST_EQ(c->hashed_bytes, 128, "  bytes");
+	TEST_EQ(sd->costs[VB2_COST_FW_KEYBLOCK].count, 0, "  other step");
+
+	/* Nothing is recorded before the shared data exists */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.workbuf = workbuf;
+	ctx.workbuf_size = sizeof(workbuf);
+	memset(workbuf, 0, sizeof(workbuf));
+	vb2_cost_add(&ctx, VB2_COST_FW_PREAMBLE, 1000, 1800, 28);
+	vb2_cost_hash(&ctx, VB2_COST_FW_PREAMBLE, 1000, 28);
+	TEST_EQ(c->count, 0, "cost before init");
+	TEST_EQ(c->hashed_bytes, 0, "  bytes");
+}
+
 int main(int argc, char* argv[])
 {
 	init_context_tests();
@@ -627,6 +718,8 @@ int main(int argc, char* argv[])
 	dev_switch_tests();
 	tpm_clear_tests();
 	select_slot_tests();
+	trace_tests();
+	cost_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
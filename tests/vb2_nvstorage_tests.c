@@ -70,6 +70,8 @@ static struct nv_field nvfields[] = {
 static struct nv_field nv2fields[] = {
 	{VB2_NV_FW_MAX_ROLLFORWARD, 0, VB2_FW_MAX_ROLLFORWARD_V1_DEFAULT,
 	 0x87654321, "firmware max rollforward"},
+	{VB2_NV_EC_SYNC_NONCE, 0, 0, 0x13579bdf, "ec sync nonce"},
+	{VB2_NV_EC_SYNC_HASH, 0, 0, 0x2468ace0, "ec sync hash"},
 	{0, 0, 0, 0, NULL}
 };
 
@@ -244,6 +246,53 @@ static void nv_storage_test(uint32_t ctxflags)
 		vb2_nv_set(&c, vnf->param, vnf->test_value2);
 	test_changed(&c, 0, "No regen CRC if V2 data not changed");
 
+	/* Writing several settings at once regenerates the CRC once */
+	{
+		struct vb2_nv_setting batch[] = {
+			{VB2_NV_TRY_COUNT, 3},
+			{VB2_NV_KERNEL_FIELD, 0x4321},
+			{VB2_NV_DEV_BOOT_USB, 1},
+			{VB2_NV_RECOVERY_REQUEST, 0x101},
+		};
+		uint8_t expect_nvdata[VB2_NVDATA_SIZE_V2];
+		int i;
+
+		c.flags = ctxflags;
+		vb2_nv_init(&c);
+		for (vnf = nvfields; vnf->desc; vnf++)
+			vb2_nv_set(&c, vnf->param, vnf->test_value2);
+		TEST_EQ(vb2_nv_set_many(&c, batch, 0), 0,
+			"vb2_nv_set_many() none");
+		test_changed(&c, 0, "vb2_nv_set_many() none no change");
+		TEST_EQ(vb2_nv_set_many(&c, batch, ARRAY_SIZE(batch)), 1,
+			"vb2_nv_set_many()");
+		test_changed(&c, 1, "vb2_nv_set_many() changed");
+		TEST_SUCC(vb2_nv_check_crc(&c), "vb2_nv_set_many() CRC");
+		TEST_EQ(vb2_nv_get(&c, VB2_NV_TRY_COUNT), 3,
+			"vb2_nv_set_many() try count");
+		TEST_EQ(vb2_nv_get(&c, VB2_NV_KERNEL_FIELD), 0x4321,
+			"vb2_nv_set_many() kernel field");
+		TEST_EQ(vb2_nv_get(&c, VB2_NV_DEV_BOOT_USB), 1,
+			"vb2_nv_set_many() dev boot usb");
+		TEST_EQ(vb2_nv_get(&c, VB2_NV_RECOVERY_REQUEST),
+			VB2_RECOVERY_LEGACY,
+			"vb2_nv_set_many() maps out of range");
+		memcpy(expect_nvdata, c.nvdata, sizeof(expect_nvdata));
+
+		/* Same result as setting them one at a time */
+		for (vnf = nvfields; vnf->desc; vnf++)
+			vb2_nv_set(&c, vnf->param, vnf->test_value2);
+		for (i = 0; i < ARRAY_SIZE(batch); i++)
+			vb2_nv_set(&c, batch[i].param, batch[i].value);
+		TEST_EQ(memcmp(c.nvdata, expect_nvdata, sizeof(expect_nvdata)),
+			0, "vb2_nv_set_many() matches vb2_nv_set()");
+
+		c.flags = ctxflags;
+		TEST_EQ(vb2_nv_set_many(&c, batch, ARRAY_SIZE(batch)), 0,
+			"vb2_nv_set_many() again");
+		test_changed(&c, 0, "vb2_nv_set_many() no change");
+	}
+
 	/* Test out-of-range fields mapping to defaults or failing */
 	vb2_nv_init(&c);
 	vb2_nv_set(&c, VB2_NV_TRY_COUNT, 16);
@@ -40,5 +40,14 @@ check_test_keys
 echo "Testing signature verification..."
 test_signatures
 
+echo "Testing signature verification with direct I/O..."
+keylen=${key_lengths[0]}
+hashalgo=${hash_algos[0]}
+${BIN_DIR}/verify_data --direct 0 ${TESTKEY_DIR}/key_rsa${keylen}.keyb \
+  ${TEST_FILE}.rsa${keylen}_${hashalgo}.sig ${TEST_FILE} || return_code=255
+cmp <(${BIN_DIR}/signature_digest_utility 0 ${TEST_FILE}) \
+  <(${BIN_DIR}/signature_digest_utility --direct 0 ${TEST_FILE}) ||
+  return_code=255
+
 exit $return_code
 
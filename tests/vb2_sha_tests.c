@@ -15,6 +15,35 @@
 #include "sha_test_vectors.h"
 #include "test_common.h"
 
+/*
+ * Check a known answer with the message copied to each offset in a buffer,
+ * since the accelerated transforms read blocks straight from the caller.
+ */
+static void kat_at_offsets(const char *msg, enum vb2_hash_algorithm hash_alg,
+			   const uint8_t *expect, const char *test_name)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t len = strlen(msg);
+	uint8_t *buf = malloc(len + 16);
+	int errors = 0;
+	int offset;
+
+	TEST_TRUE(buf != NULL, "KAT buffer alloc");
+	if (!buf)
+		return;
+
+	for (offset = 0; offset < 16; offset++) {
+		memcpy(buf + offset, msg, len);
+		if (vb2_digest_buffer(buf + offset, len, hash_alg,
+				      digest, sizeof(digest)) ||
+		    memcmp(digest, expect, vb2_digest_size(hash_alg)))
+			errors++;
+	}
+	TEST_EQ(errors, 0, test_name);
+
+	free(buf);
+}
+
 static void sha1_tests(void)
 {
 	uint8_t digest[VB2_SHA1_DIGEST_SIZE];
@@ -34,6 +63,8 @@ static void sha1_tests(void)
 		TEST_EQ(memcmp(digest, sha1_results[i], sizeof(digest)),
 			0, "SHA1 digest");
 	}
+	kat_at_offsets(multiblock_msg1, VB2_HASH_SHA1, sha1_results[1],
+		       "SHA1 digest at each alignment");
 
 	TEST_EQ(vb2_digest_buffer(test_inputs[0],
 				  strlen((char *)test_inputs[0]),
@@ -77,6 +108,8 @@ static void sha256_tests(void)
 		TEST_EQ(memcmp(digest, sha256_results[i], sizeof(digest)),
 			0, "SHA-256 digest");
 	}
+	kat_at_offsets(multiblock_msg1, VB2_HASH_SHA256, sha256_results[1],
+		       "SHA-256 digest at each alignment");
 
 	TEST_EQ(vb2_digest_buffer(test_inputs[0],
 				  strlen((char *)test_inputs[0]),
@@ -101,6 +134,27 @@ static void sha256_tests(void)
 	TEST_SUCC(memcmp(digest, expected_extend, sizeof(digest)), NULL);
 }
 
+/*
+ * Hash a buffer in uneven pieces, so that the block transform sees every
+ * combination of partial and multi-block input.
+ */
+static void digest_in_pieces(const uint8_t *buf, uint32_t size,
+			     enum vb2_hash_algorithm hash_alg,
+			     uint8_t *digest, uint32_t digest_size)
+{
+	struct vb2_digest_context dc;
+	uint32_t chunk = 1;
+	uint32_t offset;
+
+	vb2_digest_init(&dc, hash_alg);
+	for (offset = 0; offset < size; offset += chunk, chunk = chunk * 3 + 1) {
+		if (chunk > size - offset)
+			chunk = size - offset;
+		vb2_digest_extend(&dc, buf + offset, chunk);
+	}
+	vb2_digest_finalize(&dc, digest, digest_size);
+}
+
 static void sha512_tests(void)
 {
 	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
@@ -131,10 +185,205 @@ static void sha512_tests(void)
 		"vb2_hash_block_size(VB2_HASH_SHA512)");
 }
 
+/*
+ * Run the known answer tests on each implementation of an algorithm the CPU
+ * supports, and check they agree with the portable code on a larger input.
+ */
+static void impl_tests(enum vb2_hash_algorithm hash_alg,
+		       const char * const *names,
+		       void (*kat)(void))
+{
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	char test_name[256];
+	int size = vb2_digest_size(hash_alg);
+	uint8_t *buf;
+	int i;
+
+	buf = malloc(65537);
+	for (i = 0; i < 65537; i++)
+		buf[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	TEST_SUCC(vb2_sha_impl_select(hash_alg, "portable"),
+		  "Select portable implementation");
+	digest_in_pieces(buf, 65537, hash_alg, expect, sizeof(expect));
+
+	for (; *names; names++) {
+		if (vb2_sha_impl_select(hash_alg, *names)) {
+			printf("%s: %s not supported on this CPU\n",
+			       vb2_get_hash_algorithm_name(hash_alg), *names);
+			continue;
+		}
+
+		sprintf(test_name, "%s implementation %s",
+			vb2_get_hash_algorithm_name(hash_alg), *names);
+		TEST_STR_EQ(vb2_sha_impl_name(hash_alg), *names, test_name);
+
+		kat();
+
+		digest_in_pieces(buf, 65537, hash_alg, digest, sizeof(digest));
+		sprintf(test_name, "%s %s matches portable",
+			vb2_get_hash_algorithm_name(hash_alg), *names);
+		TEST_EQ(memcmp(digest, expect, size), 0, test_name);
+	}
+
+	/* Disabling acceleration always falls back to the portable code */
+	vb2_sha_accel_enable(0);
+	TEST_STR_EQ(vb2_sha_impl_name(hash_alg), "portable",
+		    "Acceleration disabled");
+	vb2_sha_accel_enable(1);
+
+	TEST_EQ(vb2_sha_impl_select(hash_alg, "bogus"),
+		VB2_ERROR_SHA_IMPL_UNSUPPORTED, "Select unknown implementation");
+	TEST_SUCC(vb2_sha_impl_select(hash_alg, NULL),
+		  "Select default implementation");
+
+	free(buf);
+}
+
+static void accel_tests(void)
+{
+	static const char * const sha1_impls[] = {
+		"SHA-NI", "ARMv8-CE", "portable", NULL
+	};
+	static const char * const sha256_impls[] = {
+		"SHA-NI", "ARMv8-CE", "portable", NULL
+	};
+	static const char * const sha512_impls[] = {
+		"AVX-512", "AVX2", "NEON", "portable", NULL
+	};
+
+	impl_tests(VB2_HASH_SHA1, sha1_impls, sha1_tests);
+	impl_tests(VB2_HASH_SHA256, sha256_impls, sha256_tests);
+	impl_tests(VB2_HASH_SHA512, sha512_impls, sha512_tests);
+
+	TEST_EQ(vb2_sha_impl_select(VB2_HASH_SHA512, "SHA-NI"),
+		VB2_ERROR_SHA_IMPL_UNSUPPORTED, "SHA512 has no SHA-NI code");
+}
+
+/*
+ * Check vb2_digest_buffers() against vb2_digest_buffer() with each
+ * multi-buffer implementation the CPU supports.  The buffers are different
+ * sizes around the block and padding boundaries, so lanes finish at
+ * different times, and there are more of them than any code has lanes.
+ */
+#define MULTI_BUFS 40
+
+static void multi_tests(void)
+{
+	static const char * const names[] = {
+		"AVX-512", "AVX2", "portable", NULL
+	};
+	const char * const *name;
+	const uint8_t *bufs[MULTI_BUFS];
+	uint32_t sizes[MULTI_BUFS];
+	uint8_t *digests[MULTI_BUFS];
+	uint8_t expect[MULTI_BUFS][VB2_SHA256_DIGEST_SIZE];
+	uint8_t out[MULTI_BUFS][VB2_SHA512_DIGEST_SIZE];
+	char test_name[256];
+	uint8_t *buf;
+	int i, same;
+
+	buf = malloc(65537);
+	for (i = 0; i < 65537; i++)
+		buf[i] = (uint8_t)(i * 13 + (i >> 7));
+
+	for (i = 0; i < MULTI_BUFS; i++) {
+		bufs[i] = buf + i * 97;
+		sizes[i] = (i % 8 == 7) ? 55 + i : (i * i * 23) % 9000;
+		digests[i] = out[i];
+		vb2_digest_buffer(bufs[i], sizes[i], VB2_HASH_SHA256,
+				  expect[i], sizeof(expect[i]));
+	}
+	/* One big buffer, which outlasts all the others */
+	sizes[3] = 65537 - 3 * 97;
+
+	vb2_digest_buffer(bufs[3], sizes[3], VB2_HASH_SHA256, expect[3],
+			  sizeof(expect[3]));
+
+	for (name = names; *name; name++) {
+		if (vb2_sha_multi_impl_select(VB2_HASH_SHA256, *name)) {
+			printf("SHA256: multi-buffer %s not supported on this "
+			       "CPU\n", *name);
+			continue;
+		}
+		sprintf(test_name, "SHA256 multi-buffer %s", *name);
+		TEST_STR_EQ(vb2_sha_multi_impl_name(VB2_HASH_SHA256), *name,
+			    test_name);
+
+		memset(out, 0, sizeof(out));
+		TEST_SUCC(vb2_digest_buffers(MULTI_BUFS, bufs, sizes,
+					     VB2_HASH_SHA256, digests,
+					     VB2_SHA256_DIGEST_SIZE),
+			  "  vb2_digest_buffers()");
+		for (i = 0, same = 1; i < MULTI_BUFS; i++)
+			if (memcmp(out[i], expect[i], sizeof(expect[i])))
+				same = 0;
+		TEST_TRUE(same, "  digests match");
+
+		/* A few buffers leave most lanes idle */
+		memset(out, 0, sizeof(out));
+		TEST_SUCC(vb2_digest_buffers(3, bufs + 2, sizes + 2,
+					     VB2_HASH_SHA256, digests,
+					     VB2_SHA256_DIGEST_SIZE),
+			  "  three buffers");
+		TEST_SUCC(memcmp(out[1], expect[3], sizeof(expect[3])),
+			  "  big buffer digest");
+	}
+
+	vb2_sha_accel_enable(0);
+	TEST_STR_EQ(vb2_sha_multi_impl_name(VB2_HASH_SHA256), "portable",
+		    "Multi-buffer acceleration disabled");
+	vb2_sha_accel_enable(1);
+
+	TEST_EQ(vb2_sha_multi_impl_select(VB2_HASH_SHA256, "bogus"),
+		VB2_ERROR_SHA_IMPL_UNSUPPORTED,
+		"Select unknown multi-buffer implementation");
+	TEST_SUCC(vb2_sha_multi_impl_select(VB2_HASH_SHA256, NULL),
+		  "Select default multi-buffer implementation");
+	TEST_EQ(vb2_sha_multi_impl_select(VB2_HASH_SHA512, "AVX2"),
+		VB2_ERROR_SHA_IMPL_UNSUPPORTED,
+		"SHA512 has no multi-buffer code");
+
+	/* Other algorithms go one at a time */
+	TEST_SUCC(vb2_digest_buffers(2, bufs, sizes, VB2_HASH_SHA512,
+				     digests, VB2_SHA512_DIGEST_SIZE),
+		  "vb2_digest_buffers() SHA512");
+	digest_in_pieces(bufs[1], sizes[1], VB2_HASH_SHA512, out[2],
+			 VB2_SHA512_DIGEST_SIZE);
+	TEST_SUCC(memcmp(out[1], out[2], VB2_SHA512_DIGEST_SIZE),
+		  "  digest");
+	TEST_EQ(vb2_digest_buffers(2, bufs, sizes, VB2_HASH_SHA256,
+				   digests, VB2_SHA256_DIGEST_SIZE - 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_buffers() too small");
+	TEST_EQ(vb2_digest_buffers(2, bufs, sizes, VB2_HASH_INVALID,
+				   digests, VB2_SHA256_DIGEST_SIZE),
+		VB2_ERROR_SHA_INIT_ALGORITHM,
+		"vb2_digest_buffers() invalid alg");
+
+	free(buf);
+}
+
 static void misc_tests(void)
 {
 	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
 	struct vb2_digest_context dc;
+	uint8_t expect[VB2_SHA512_DIGEST_SIZE];
+	const uint8_t *odd = (const uint8_t *)long_msg + 3;
+
+	/*
+	 * Extending in odd-sized pieces from an unaligned start mixes whole
+	 * blocks hashed in place with partial blocks which are staged.
+	 */
+	vb2_digest_buffer(odd, 20000, VB2_HASH_SHA256, expect, sizeof(expect));
+	digest_in_pieces(odd, 20000, VB2_HASH_SHA256, digest, sizeof(digest));
+	TEST_SUCC(memcmp(digest, expect, VB2_SHA256_DIGEST_SIZE),
+		  "SHA256 unaligned pieces");
+	vb2_digest_buffer(odd, 20000, VB2_HASH_SHA512, expect, sizeof(expect));
+	digest_in_pieces(odd, 20000, VB2_HASH_SHA512, digest, sizeof(digest));
+	TEST_SUCC(memcmp(digest, expect, VB2_SHA512_DIGEST_SIZE),
+		  "SHA512 unaligned pieces");
 
 	/* Crypto algorithm to hash algorithm mapping */
 	TEST_EQ(vb2_crypto_to_hash(VB2_ALG_RSA1024_SHA1), VB2_HASH_SHA1,
@@ -170,6 +419,48 @@ static void misc_tests(void)
 		"vb2_digest_finalize() invalid alg");
 }
 
+static void context_size_tests(void)
+{
+	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
+	uint8_t expect[VB2_SHA512_DIGEST_SIZE];
+	struct vb2_digest_context *dc;
+	enum vb2_hash_algorithm alg;
+	uint32_t size;
+	char test_name[256];
+
+	TEST_EQ(vb2_digest_context_size(VB2_HASH_SHA512),
+		sizeof(struct vb2_digest_context), "SHA512 context is biggest");
+	TEST_TRUE(vb2_digest_context_size(VB2_HASH_SHA256) <
+		  vb2_digest_context_size(VB2_HASH_SHA512),
+		  "SHA256 context is smaller");
+	TEST_TRUE(vb2_digest_context_size(VB2_HASH_INVALID) <
+		  vb2_digest_context_size(VB2_HASH_SHA1),
+		  "invalid alg context is smallest");
+
+	/* A context allocated only as big as its algorithm needs still works */
+	for (alg = 1; alg < VB2_HASH_ALG_COUNT; alg++) {
+		size = vb2_digest_context_size(alg);
+		dc = malloc(size);
+		vb2_digest_buffer((const uint8_t *)long_msg, 10000, alg,
+				  expect, sizeof(expect));
+		sprintf(test_name, "%s: %s (size=%d)", __func__,
+			vb2_get_hash_algorithm_name(alg), size);
+		TEST_SUCC(vb2_digest_init(dc, alg), test_name);
+		TEST_SUCC(vb2_digest_extend(dc, (const uint8_t *)long_msg,
+					    10000), test_name);
+		TEST_SUCC(vb2_digest_finalize(dc, digest, sizeof(digest)),
+			  test_name);
+		TEST_SUCC(memcmp(digest, expect, vb2_digest_size(alg)),
+			  test_name);
+		free(dc);
+	}
+
+	dc = malloc(vb2_digest_context_size(VB2_HASH_INVALID));
+	TEST_EQ(vb2_digest_init(dc, VB2_HASH_INVALID),
+		VB2_ERROR_SHA_INIT_ALGORITHM, "init invalid alg in small ctx");
+	free(dc);
+}
+
 static void hash_algorithm_name_tests(void)
 {
 	enum vb2_hash_algorithm alg;
@@ -196,7 +487,10 @@ int main(int argc, char *argv[])
 	sha1_tests();
 	sha256_tests();
 	sha512_tests();
+	accel_tests();
+	multi_tests();
 	misc_tests();
+	context_size_tests();
 	hash_algorithm_name_tests();
 
 	free(long_msg);
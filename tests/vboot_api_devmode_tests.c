@@ -89,6 +89,29 @@ test_case_t test[] = {
 		{250, 400, 20510},	// starts second beep
 		{0, 0, 30020},	// returns at 30 seconds + 360ms
 	  }},
+
+	// Now with beeps in the background
+
+	{ "VbBootDeveloperSoundTest( background )",
+	  0, VBERROR_SUCCESS,
+	  0, 0,
+	  4,
+	  {
+		{250, 400, 20000},	// first beep at 20 seconds
+		{250, 400, 20500},	// second beep at 20.5 seconds
+		{0, 0, 30000},	// sound off at 30 seconds
+		{0, 0, 30000},	// and return
+	  }},
+
+	{ "VbBootDeveloperSoundTest( background, Ctrl-D )",
+	  0, VBERROR_SUCCESS,
+	  4, 20100,			// Ctrl-D during first beep
+	  3,
+	  {
+		{250, 400, 20000},	// first beep at 20 seconds
+		{0, 0, 20100},	// sees Ctrl-D, sound off
+		{0, 0, 20100},	// and return
+	  }},
 };
 
 /* Mock data */
@@ -240,6 +263,31 @@ VbError_t VbExBeep(uint32_t msec, uint32_t frequency)
 	return beep_return;
 }
 
+VbError_t VbExBeepStart(uint32_t msec, uint32_t frequency)
+{
+	if (beep_return != VBERROR_SUCCESS)
+		return VBERROR_NO_BACKGROUND_SOUND;
+
+	VB2_DEBUG("VbExBeepStart(%d, %d) at %d msec\n",
+		  msec, frequency, current_time);
+
+	if (current_event < max_events &&
+	    msec == expected_event[current_event].msec &&
+	    frequency == expected_event[current_event].freq &&
+	    abs(current_time - expected_event[current_event].time)
+	    < TIME_FUZZ ) {
+		matched_events++;
+	}
+
+	current_event++;
+	return VBERROR_SUCCESS;
+}
+
+void VbExBeepStop(void)
+{
+	VbExBeep(0, 0);
+}
+
 VbError_t VbExDisplayScreen(uint32_t screen_type, uint32_t locale,
 			    const VbScreenData *data)
 {
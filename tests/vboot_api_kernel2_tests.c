@@ -22,6 +22,7 @@
 #include "vboot_kernel.h"
 #include "vboot_struct.h"
 #include "vboot_test.h"
+#include "vboot_ui_common.h"
 
 /* Mock data */
 static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE];
@@ -34,6 +35,7 @@ static struct vb2_gbb_header gbb;
 
 static int audio_looping_calls_left;
 static uint32_t vbtlk_retval;
+static int vbtlk_calls;
 static int vbexlegacy_called;
 static enum VbAltFwIndex_t altfw_num;
 static uint64_t current_ticks;
@@ -58,6 +60,9 @@ static uint32_t screens_displayed[8];
 static uint32_t screens_count = 0;
 static uint32_t mock_num_disks[8];
 static uint32_t mock_num_disks_count;
+static uint32_t mock_events;
+static uint32_t mock_events_mask;
+static int mock_hotplug;
 static int tpm_set_mode_called;
 static enum vb2_tpm_mode tpm_mode;
 
@@ -103,6 +108,7 @@ static void ResetMocks(void)
 
 	audio_looping_calls_left = 30;
 	vbtlk_retval = 1000;
+	vbtlk_calls = 0;
 	vbexlegacy_called = 0;
 	altfw_num = -100;
 	current_ticks = 0;
@@ -121,6 +127,9 @@ static void ResetMocks(void)
 	mock_gpio_count = 0;
 	memset(mock_num_disks, 0, sizeof(mock_num_disks));
 	mock_num_disks_count = 0;
+	mock_events = 0;
+	mock_events_mask = 0;
+	mock_hotplug = 0;
 
 	tpm_set_mode_called = 0;
 	tpm_mode = VB2_TPM_MODE_ENABLED_TENTATIVE;
@@ -194,6 +203,23 @@ void VbExSleepMs(uint32_t msec)
 	current_ticks += (uint64_t)msec * VB_USEC_PER_MSEC;
 }
 
+uint32_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t event_mask)
+{
+	uint32_t events = mock_events & event_mask;
+
+	/* Each queued event is only reported once */
+	mock_events &= ~events;
+	mock_events_mask = event_mask;
+	if (!events)
+		VbExSleepMs(timeout_ms);
+	return events;
+}
+
+int VbExDiskHasHotplugEvents(void)
+{
+	return mock_hotplug;
+}
+
 uint64_t VbExGetTimer(void)
 {
 	return current_ticks;
@@ -236,6 +262,7 @@ int vb2_audio_looping(void)
 
 uint32_t VbTryLoadKernel(struct vb2_context *c, uint32_t get_info_flags)
 {
+	vbtlk_calls++;
 	return vbtlk_retval + get_info_flags;
 }
 
@@ -569,6 +596,7 @@ static void VbBootDevTest(void)
 		VBERROR_SHUTDOWN_REQUESTED,
 		"Shutdown requested");
 	TEST_NEQ(audio_looping_calls_left, 0, "  aborts audio");
+	TEST_EQ(mock_events_mask, VB_UI_EVENTS, "  waiting for keys");
 
 	/* Shutdown requested by keyboard in loop */
 	ResetMocks();
@@ -1171,6 +1199,44 @@ static void VbBootRecTest(void)
 	TEST_EQ(screens_displayed[0], VB_SCREEN_OS_BROKEN,
 		"  broken screen");
 
+	/* Inserting a disk is looked at without waiting out the delay */
+	ResetMocks();
+	shared->flags = VBSD_BOOT_REC_SWITCH_ON;
+	trust_ec = 1;
+	mock_keypress[10] = VB_BUTTON_POWER_SHORT_PRESS;
+	mock_events = VB_EVENT_DISK;
+	vbtlk_retval = VBERROR_NO_DISK_FOUND - VB_DISK_FLAG_REMOVABLE;
+	TEST_EQ(VbBootRecovery(&ctx),
+		VBERROR_SHUTDOWN_REQUESTED,
+		"Disk event");
+	TEST_EQ(screens_displayed[0], VB_SCREEN_RECOVERY_INSERT,
+		"  insert screen");
+	TEST_EQ(vbtlk_calls, 2, "  disks scanned again at once");
+	TEST_EQ(mock_events_mask, VB_UI_EVENTS | VB_EVENT_DISK,
+		"  waiting for keys and disks");
+
+	/* With hotplug events, disks are only scanned again when told to */
+	ResetMocks();
+	MockGpioAfter(120, GPIO_LID_CLOSED);
+	shared->flags = VBSD_BOOT_REC_SWITCH_ON;
+	trust_ec = 1;
+	vbtlk_retval = VBERROR_NO_DISK_FOUND - VB_DISK_FLAG_REMOVABLE;
+	TEST_EQ(VbBootRecovery(&ctx),
+		VBERROR_SHUTDOWN_REQUESTED,
+		"No hotplug events");
+	TEST_EQ(vbtlk_calls, 3, "  disks scanned every second");
+
+	ResetMocks();
+	MockGpioAfter(120, GPIO_LID_CLOSED);
+	shared->flags = VBSD_BOOT_REC_SWITCH_ON;
+	trust_ec = 1;
+	mock_hotplug = 1;
+	vbtlk_retval = VBERROR_NO_DISK_FOUND - VB_DISK_FLAG_REMOVABLE;
+	TEST_EQ(VbBootRecovery(&ctx),
+		VBERROR_SHUTDOWN_REQUESTED,
+		"Hotplug events");
+	TEST_EQ(vbtlk_calls, 1, "  disks scanned once");
+
 	/* Bad disk count doesn't require removal */
 	ResetMocks();
 	MockGpioAfter(10, GPIO_SHUTDOWN);
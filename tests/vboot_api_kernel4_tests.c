@@ -14,14 +14,17 @@
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "ec_sync.h"
+#include "gpt_misc.h"
 #include "host_common.h"
 #include "load_kernel_fw.h"
 #include "rollback_index.h"
 #include "test_common.h"
+#include "tlcl.h"
 #include "vboot_audio.h"
 #include "vboot_common.h"
 #include "vboot_kernel.h"
 #include "vboot_struct.h"
+#include "vboot_test.h"
 
 /* Mock data */
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
@@ -42,6 +45,7 @@ static VbError_t vbboot_retval;
 static uint32_t mock_switches[8];
 static uint32_t mock_switches_count;
 static int mock_switches_are_stuck;
+static int nv_write_count;
 
 /* Reset mock data (for use before each test) */
 static void ResetMocks(void)
@@ -85,6 +89,7 @@ static void ResetMocks(void)
 	memset(mock_switches, 0, sizeof(mock_switches));
 	mock_switches_count = 0;
 	mock_switches_are_stuck = 0;
+	nv_write_count = 0;
 }
 
 /* Mock functions */
@@ -98,11 +103,16 @@ VbError_t VbExNvStorageRead(uint8_t *buf)
 
 VbError_t VbExNvStorageWrite(const uint8_t *buf)
 {
+	nv_write_count++;
 	memcpy(ctx_nvram_backend.nvdata, buf,
 	       vb2_nv_get_size(&ctx_nvram_backend));
 	return VBERROR_SUCCESS;
 }
 
+void RollbackReadAhead(int read_fwmp)
+{
+}
+
 uint32_t RollbackKernelRead(uint32_t *version)
 {
 	*version = rkr_version;
@@ -190,10 +200,114 @@ int vb2ex_tpm_set_mode(enum vb2_tpm_mode mode_val)
 
 static void VbSlkTest(void)
 {
+	int i;
+
 	ResetMocks();
 	test_slk(0, 0, "Normal");
 	TEST_EQ(rkr_version, 0x10002, "  version");
 
+#if VB2_BOOT_TRACE
+	/* TPM read, FWMP read and lock are passed up in the trace */
+	TEST_EQ(shared->trace_count, 6, "  trace count");
+	TEST_EQ(shared->trace[0].event, VB2_TRACE_TPM_COMMAND, "  trace event");
+	TEST_EQ(shared->trace[0].type, VB2_TRACE_BEGIN, "  trace begin");
+	TEST_EQ(shared->trace[5].type, VB2_TRACE_END, "  trace end");
+#else
+	TEST_EQ(shared->trace_count, 0, "  no trace");
+#endif
+
+	/* Older headers have no room for the trace */
+	ResetMocks();
+	shared->struct_version = 2;
+	test_slk(0, 0, "Normal, header v2");
+	TEST_EQ(shared->trace_count, 0, "  no trace");
+
+	/* TPM statistics are passed up too */
+	ResetMocks();
+	TlclStatsReset();
+	TlclStatsRecord(0x65, 0, 100);
+	TlclStatsRecord(0xcf, 0, 300);
+	test_slk(0, 0, "Normal, TPM stats");
+	TEST_EQ(shared->tpm_stats_count, 2, "  stats count");
+	TEST_EQ(shared->tpm_stats[1].command_code, 0xcf, "  stats command");
+	TEST_EQ(shared->tpm_stats[1].total_time, 300, "  stats time");
+
+	ResetMocks();
+	shared->struct_version = 3;
+	test_slk(0, 0, "Normal, header v3");
+	TEST_EQ(shared->tpm_stats_count, 0, "  no stats");
+	TlclStatsReset();
+
+	/* So are disk reads, with contiguous ones merged */
+	ResetMocks();
+	VbDiskReadReset();
+	VbDiskReadStartCall(0);
+	VbDiskReadRecord(1, 1, VB2_DISK_READ_GPT_PRIMARY);
+	VbDiskReadRecord(2, 32, VB2_DISK_READ_GPT_PRIMARY);
+	VbDiskReadRecord(4096, 128, VB2_DISK_READ_VBLOCK);
+	VbDiskReadRecord(4224, 1024, VB2_DISK_READ_BODY);
+	VbDiskReadRecord(5248, 1024, VB2_DISK_READ_BODY);
+	test_slk(0, 0, "Normal, disk reads");
+	TEST_EQ(shared->disk_reads_count, 3, "  reads count");
+	TEST_EQ(shared->disk_reads_dropped, 0, "  none dropped");
+	TEST_EQ(shared->disk_reads[0].lba_count, 33, "  gpt sectors");
+	TEST_EQ(shared->disk_reads[0].requests, 2, "  gpt requests");
+	TEST_EQ(shared->disk_reads[2].purpose, VB2_DISK_READ_BODY,
+		"  body purpose");
+	TEST_EQ(shared->disk_reads[2].lba_start, 4224, "  body start");
+	TEST_EQ(shared->disk_reads[2].lba_count, 2048, "  body sectors");
+
+	/* A new call with the same index replaces the old reads */
+	VbDiskReadStartCall(1);
+	VbDiskReadRecord(1, 1, VB2_DISK_READ_GPT_PRIMARY);
+	VbDiskReadStartCall(0);
+	VbDiskReadRecord(1, 1, VB2_DISK_READ_GPT_PRIMARY);
+	ResetMocks();
+	test_slk(0, 0, "Normal, disk reads for reused call");
+	TEST_EQ(shared->disk_reads_count, 2, "  reads count");
+	TEST_EQ(shared->disk_reads[0].lk_call, 1, "  other call kept");
+	TEST_EQ(shared->disk_reads[1].lk_call, 0, "  reused call");
+
+	ResetMocks();
+	for (i = 0; i < VB2_DISK_READ_ENTRIES + 2; i++)
+		VbDiskReadRecord(i * 2, 1, VB2_DISK_READ_OTHER);
+	test_slk(0, 0, "Normal, disk read trace full");
+	TEST_EQ(shared->disk_reads_count, VB2_DISK_READ_ENTRIES,
+		"  reads count");
+	TEST_EQ(shared->disk_reads_dropped, 4, "  dropped");
+
+	ResetMocks();
+	shared->struct_version = 4;
+	test_slk(0, 0, "Normal, header v4");
+	TEST_EQ(shared->disk_reads_count, 0, "  no reads");
+	VbDiskReadReset();
+
+	/* And verification costs */
+	ResetMocks();
+	sd->costs[VB2_COST_FW_BODY].count = 1;
+	sd->costs[VB2_COST_FW_BODY].hashed_bytes = 0x1000;
+	test_slk(0, 0, "Normal, costs");
+	TEST_EQ(shared->costs[VB2_COST_FW_BODY].count, 1, "  count");
+	TEST_EQ(shared->costs[VB2_COST_FW_BODY].hashed_bytes, 0x1000,
+		"  hashed bytes");
+
+	ResetMocks();
+	sd->costs[VB2_COST_FW_BODY].count = 1;
+	shared->struct_version = 5;
+	test_slk(0, 0, "Normal, header v5");
+	TEST_EQ(shared->costs[VB2_COST_FW_BODY].count, 0, "  no costs");
+
+	ResetMocks();
+	test_slk(0, 0, "Vblock read into workbuf");
+	TEST_EQ(VbApiKernelGetParams()->boot_flags &
+		BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER, 0, "  boot flag");
+
+	ResetMocks();
+	kparams.inflags = VB_SALK_INFLAGS_VBLOCK_IN_KERNEL_BUFFER;
+	test_slk(0, 0, "Vblock read into kernel buffer");
+	TEST_NEQ(VbApiKernelGetParams()->boot_flags &
+		 BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER, 0, "  boot flag");
+
 	/*
 	 * If shared->flags doesn't ask for software sync, we won't notice
 	 * that error.
@@ -311,9 +425,42 @@ static void VbSlkTest(void)
 
 }
 
+static void VbNvCommitTest(void)
+{
+	ResetMocks();
+	test_slk(0, 0, "Normal boot");
+	TEST_EQ(nv_write_count, 0, "  no NV write");
+
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 1);
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 0);
+	vb2_nv_commit(&ctx);
+	TEST_EQ(nv_write_count, 0, "Undone change not written");
+	TEST_EQ(ctx.flags & VB2_CONTEXT_NVDATA_CHANGED, 0, "  flag cleared");
+
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 1);
+	vb2_nv_commit(&ctx);
+	TEST_EQ(nv_write_count, 1, "Change written");
+	TEST_EQ(vb2_nv_get(&ctx_nvram_backend, VB2_NV_TRY_RO_SYNC), 1,
+		"  to storage");
+	vb2_nv_commit(&ctx);
+	TEST_EQ(nv_write_count, 1, "  only once");
+
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 0);
+	vb2_nv_set(&ctx, VB2_NV_TRY_RO_SYNC, 1);
+	vb2_nv_commit(&ctx);
+	TEST_EQ(nv_write_count, 1, "Undone change after write not written");
+
+	ResetMocks();
+	rkl_retval = 123;
+	test_slk(VBERROR_TPM_LOCK_KERNEL,
+		 VB2_RECOVERY_RW_TPM_L_ERROR, "Recovery request");
+	TEST_EQ(nv_write_count, 1, "  commits NV once");
+}
+
 int main(void)
 {
 	VbSlkTest();
+	VbNvCommitTest();
 
 	return gTestSuccess ? 0 : 255;
 }
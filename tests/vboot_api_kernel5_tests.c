@@ -40,6 +40,7 @@ static uint8_t kernel_buffer[80000];
 static int key_block_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
+static uint8_t verified_digest[VB2_SHA256_DIGEST_SIZE];
 static int unpack_key_fail;
 
 static VbKeyBlockHeader kbh;
@@ -101,6 +102,7 @@ static void ResetMocks(void)
 	memcpy((kernel_buffer + kbh.key_block_size), &kph, sizeof(kph));
 
 	hash_only_check = -1;
+	memset(verified_digest, 0, sizeof(verified_digest));
 }
 
 static void copy_kbh(void)
@@ -149,6 +151,8 @@ int vb2_unpack_key_buffer(struct vb2_public_key *key,
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	memset(key, 0, sizeof(*key));
+	key->hash_alg = VB2_HASH_SHA256;
 	return VB2_SUCCESS;
 }
 
@@ -194,12 +198,13 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 	return VB2_SUCCESS;
 }
 
-int vb2_verify_data(const uint8_t *data,
-		    uint32_t size,
-		    struct vb2_signature *sig,
-		    const struct vb2_public_key *key,
-		    const struct vb2_workbuf *wb)
+int vb2_verify_digest(const struct vb2_public_key *key,
+		      struct vb2_signature *sig,
+		      const uint8_t *digest,
+		      const struct vb2_workbuf *wb)
 {
+	memcpy(verified_digest, digest, sizeof(verified_digest));
+
 	if (verify_data_fail)
 		return VB2_ERROR_MOCK;
 
@@ -349,9 +354,105 @@ static void VerifyMemoryBootImageTest(void)
 		VBERROR_INVALID_KERNEL_FOUND, "Data verification");
 }
 
+static void VerifyMemoryBootImageStreamTest(void)
+{
+	uint8_t expect[VB2_SHA256_DIGEST_SIZE];
+	size_t image_size = sizeof(kernel_buffer);
+	uint32_t body_offset, body_size;
+	size_t received;
+	int i;
+
+	ResetMocks();
+	body_offset = kbh.key_block_size + kph.preamble_size;
+	body_size = kph.body_signature.data_size;
+	for (i = body_offset; i < image_size; i++)
+		kernel_buffer[i] = i * 7 + (i >> 8);
+	vb2_digest_buffer(kernel_buffer + body_offset, body_size,
+			  VB2_HASH_SHA256, expect, sizeof(expect));
+
+	/* The body is hashed a piece at a time as it arrives */
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     body_offset),
+		VBERROR_SUCCESS, "Stream vblock good");
+	for (received = body_offset; received < image_size; received += 999)
+		TEST_EQ(VbVerifyMemoryBootImageExtend(&ctx, received),
+			VBERROR_SUCCESS, "  extend");
+	TEST_EQ(VbVerifyMemoryBootImageExtend(&ctx, image_size),
+		VBERROR_SUCCESS, "  extend to the end");
+	TEST_EQ(VbVerifyMemoryBootImageFinish(&ctx, &kparams),
+		VBERROR_SUCCESS, "  image good");
+	TEST_EQ(memcmp(verified_digest, expect, sizeof(expect)), 0,
+		"  body digest");
+	TEST_PTR_EQ(kparams.kernel_buffer, kernel_buffer + body_offset,
+		    "  kernel buffer");
+	TEST_EQ(kparams.kernel_buffer_size, image_size - body_offset,
+		"  kernel buffer size");
+	TEST_EQ(kparams.bootloader_address, 0xbeadd008, "  bootloader addr");
+
+	/* The whole image at once hashes the same */
+	ResetMocks();
+	TEST_EQ(VbVerifyMemoryBootImage(&ctx, shared, &kparams, kernel_buffer,
+					image_size),
+		VBERROR_SUCCESS, "Whole image good");
+	TEST_EQ(memcmp(verified_digest, expect, sizeof(expect)), 0,
+		"  same body digest");
+
+	/* The vblock has to be there to start */
+	ResetMocks();
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     body_offset - 1),
+		VBERROR_INVALID_KERNEL_FOUND, "Stream without whole vblock");
+	TEST_EQ(VbVerifyMemoryBootImageExtend(&ctx, image_size),
+		VBERROR_INVALID_PARAMETER, "  not verifying");
+	TEST_EQ(VbVerifyMemoryBootImageFinish(&ctx, &kparams),
+		VBERROR_INVALID_PARAMETER, "  nothing to finish");
+
+	ResetMocks();
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     image_size + 1),
+		VBERROR_INVALID_PARAMETER, "Stream received too much");
+
+	/* The body has to fit in the image */
+	ResetMocks();
+	kph.body_signature.data_size = image_size - body_offset + 1;
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     image_size),
+		VBERROR_INVALID_KERNEL_FOUND, "Stream body too big");
+
+	/* And all of it has to arrive */
+	ResetMocks();
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     body_offset),
+		VBERROR_SUCCESS, "Stream vblock good");
+	TEST_EQ(VbVerifyMemoryBootImageExtend(&ctx, image_size + 1),
+		VBERROR_INVALID_PARAMETER, "  extend past the end");
+	TEST_EQ(VbVerifyMemoryBootImageExtend(&ctx,
+					      body_offset + body_size - 1),
+		VBERROR_SUCCESS, "  extend");
+	TEST_EQ(VbVerifyMemoryBootImageFinish(&ctx, &kparams),
+		VBERROR_INVALID_KERNEL_FOUND, "  body incomplete");
+	TEST_PTR_EQ(kparams.kernel_buffer, NULL, "  no kernel buffer");
+
+	/* Bad body */
+	ResetMocks();
+	verify_data_fail = 1;
+	TEST_EQ(VbVerifyMemoryBootImageStart(&ctx, shared, &kparams,
+					     kernel_buffer, image_size,
+					     image_size),
+		VBERROR_SUCCESS, "Stream whole image");
+	TEST_EQ(VbVerifyMemoryBootImageFinish(&ctx, &kparams),
+		VBERROR_INVALID_KERNEL_FOUND, "  data verification");
+}
+
 int main(void)
 {
 	VerifyMemoryBootImageTest();
+	VerifyMemoryBootImageStreamTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -214,6 +214,21 @@ test_case_t test[] = {
 	},
 };
 
+/* Disks come and go between calls; see VbTryLoadKernelHotplugTest() */
+static test_case_t hotplug_test = {
+	.want_flags = VB_DISK_FLAG_REMOVABLE,
+	.disk_count_to_return = DEFAULT_COUNT,
+	.diskgetinfo_return_val = VBERROR_SUCCESS,
+	.loadkernel_return_val = {VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_SUCCESS,
+				  VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_INVALID_KERNEL_FOUND,
+				  VBERROR_INVALID_KERNEL_FOUND},
+};
+
 /****************************************************************************/
 
 /* Mock data */
@@ -226,6 +241,17 @@ static const char *got_load_disk;
 static uint32_t got_return_val;
 static uint32_t got_external_mismatch;
 static struct vb2_context ctx;
+static int mock_hotplug;
+
+/* VbExDiskPrefetch() calls, and how many LoadKernel() calls came before */
+#define MAX_PREFETCHES (2 * MAX_TEST_DISKS)
+static struct {
+	VbExDiskHandle_t handle;
+	uint64_t lba_start;
+	uint64_t lba_count;
+	int load_kernel_calls;
+} prefetches[MAX_PREFETCHES];
+static int prefetch_count;
 
 /**
  * Reset mock data (for use before each test)
@@ -243,6 +269,8 @@ static void ResetMocks(int i)
 	got_find_disk = 0;
 	got_load_disk = 0;
 	got_return_val = 0xdeadbeef;
+	mock_hotplug = 0;
+	prefetch_count = 0;
 
 	t = test + i;
 }
@@ -317,6 +345,23 @@ VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
 	return VBERROR_SUCCESS;
 }
 
+int VbExDiskHasHotplugEvents(void)
+{
+	return mock_hotplug;
+}
+
+void VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+		      uint64_t lba_count)
+{
+	if (prefetch_count == MAX_PREFETCHES)
+		return;
+	prefetches[prefetch_count].handle = handle;
+	prefetches[prefetch_count].lba_start = lba_start;
+	prefetches[prefetch_count].lba_count = lba_count;
+	prefetches[prefetch_count].load_kernel_calls = load_kernel_calls;
+	prefetch_count++;
+}
+
 VbError_t LoadKernel(struct vb2_context *c, LoadKernelParams *params)
 {
 	got_find_disk = (const char *)params->disk_handle;
@@ -362,9 +407,110 @@ static void VbTryLoadKernelTest(void)
 	}
 }
 
+static void TestPrefetch(int i, VbExDiskHandle_t handle, uint64_t lba_start,
+			 uint64_t lba_count)
+{
+	TEST_PTR_EQ(prefetches[i].handle, handle, "  prefetch disk");
+	TEST_EQ(prefetches[i].lba_start, lba_start, "  prefetch start");
+	TEST_EQ(prefetches[i].lba_count, lba_count, "  prefetch count");
+	TEST_EQ(prefetches[i].load_kernel_calls, 0,
+		"  prefetch before LoadKernel()");
+}
+
+static void VbTryLoadKernelPrefetchTest(void)
+{
+	printf("Test case: prefetch ...\n");
+
+	/* Both usable disks, in order, though the first one has a kernel */
+	ResetMocks(0);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_SUCCESS, "  return value");
+	TEST_EQ(prefetch_count, 4, "  prefetches");
+	TEST_PTR_EQ(got_load_disk, pickme, "  load disk");
+	/* 4096-byte sectors: PMBR, header and 4 sectors of entries */
+	TestPrefetch(0, (VbExDiskHandle_t)pickme, 0, 6);
+	TestPrefetch(1, (VbExDiskHandle_t)pickme, 95, 5);
+	/* 512-byte sectors: 32 sectors of entries */
+	TestPrefetch(2, (VbExDiskHandle_t)"holygrail", 0, 34);
+	TestPrefetch(3, (VbExDiskHandle_t)"holygrail", 67, 33);
+
+	/* The GPT of a disk with an external GPT isn't on the disk */
+	ResetMocks(1);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_SUCCESS, "  external GPT");
+	TEST_EQ(prefetch_count, 2, "  prefetches");
+	TestPrefetch(0, (VbExDiskHandle_t)"holygrail", 0, 34);
+}
+
+static void SetHotplugDisks(const char *first, const char *second)
+{
+	static const disk_desc_t none;
+	const disk_desc_t disk = {512, 100, VB_DISK_FLAG_REMOVABLE, 0};
+
+	hotplug_test.disks_to_provide[0] = first ? disk : none;
+	hotplug_test.disks_to_provide[0].diskname = first;
+	hotplug_test.disks_to_provide[1] = second ? disk : none;
+	hotplug_test.disks_to_provide[1].diskname = second;
+}
+
+static void VbTryLoadKernelHotplugTest(void)
+{
+	static const char bad[] = "bad";
+	static const char good[] = "good";
+
+	printf("Test case: hotplug ...\n");
+	ResetMocks(0);
+	t = &hotplug_test;
+	mock_hotplug = 1;
+
+	SetHotplugDisks(bad, NULL);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_INVALID_KERNEL_FOUND, "  bad disk");
+	TEST_EQ(load_kernel_calls, 1, "  bad disk read");
+	prefetch_count = 0;
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_INVALID_KERNEL_FOUND, "  bad disk again");
+	TEST_EQ(load_kernel_calls, 1, "  bad disk not read again");
+	TEST_EQ(prefetch_count, 0, "  bad disk not prefetched");
+
+	SetHotplugDisks(bad, good);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_SUCCESS, "  good disk inserted");
+	TEST_EQ(load_kernel_calls, 2, "  only good disk read");
+	TEST_PTR_EQ(got_load_disk, good, "  good disk loaded");
+
+	/* A disk removed and inserted again is read again */
+	SetHotplugDisks(NULL, NULL);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_NO_DISK_FOUND, "  disks removed");
+	SetHotplugDisks(bad, NULL);
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_INVALID_KERNEL_FOUND, "  bad disk reinserted");
+	TEST_EQ(load_kernel_calls, 3, "  bad disk read again");
+
+	/* Fixed disks are read every time, even with hotplug events */
+	hotplug_test.disks_to_provide[0].flags = VB_DISK_FLAG_FIXED;
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_FIXED),
+		VBERROR_INVALID_KERNEL_FOUND, "  bad fixed disk");
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_FIXED),
+		VBERROR_INVALID_KERNEL_FOUND, "  bad fixed disk again");
+	TEST_EQ(load_kernel_calls, 5, "  bad fixed disk read again");
+
+	/* Without hotplug events, every scan reads every disk */
+	SetHotplugDisks(bad, NULL);
+	mock_hotplug = 0;
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_INVALID_KERNEL_FOUND, "  no hotplug events");
+	TEST_EQ(VbTryLoadKernel(&ctx, VB_DISK_FLAG_REMOVABLE),
+		VBERROR_INVALID_KERNEL_FOUND, "  no hotplug events again");
+	TEST_EQ(load_kernel_calls, 7, "  bad disk read without events");
+}
+
 int main(void)
 {
 	VbTryLoadKernelTest();
+	VbTryLoadKernelPrefetchTest();
+	VbTryLoadKernelHotplugTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -26,7 +26,7 @@ static void StructPackingTest(void)
 		"sizeof(VbSignature)");
 	TEST_EQ(EXPECTED_VBKEYBLOCKHEADER_SIZE, sizeof(VbKeyBlockHeader),
 		"sizeof(VbKeyBlockHeader)");
-	TEST_EQ(EXPECTED_VBKERNELPREAMBLEHEADER2_2_SIZE,
+	TEST_EQ(EXPECTED_VBKERNELPREAMBLEHEADER2_4_SIZE,
 		sizeof(VbKernelPreambleHeader),
 		"sizeof(VbKernelPreambleHeader)");
 
@@ -35,8 +35,24 @@ static void StructPackingTest(void)
 		"sizeof(VbSharedDataHeader) V1");
 
 	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V2,
-		sizeof(VbSharedDataHeader),
+		(long)&((VbSharedDataHeader*)NULL)->trace_count,
 		"sizeof(VbSharedDataHeader) V2");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V3,
+		(long)&((VbSharedDataHeader*)NULL)->tpm_stats_count,
+		"sizeof(VbSharedDataHeader) V3");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V4,
+		(long)&((VbSharedDataHeader*)NULL)->disk_reads_count,
+		"sizeof(VbSharedDataHeader) V4");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V5,
+		(long)&((VbSharedDataHeader*)NULL)->costs,
+		"sizeof(VbSharedDataHeader) V5");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V6,
+		sizeof(VbSharedDataHeader),
+		"sizeof(VbSharedDataHeader) V6");
 }
 
 /* Test array size macro */
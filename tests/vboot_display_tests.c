@@ -30,6 +30,10 @@ static struct vb2_shared_data *sd;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
 static uint32_t mock_localization_count;
 static uint32_t mock_altfw_mask;
+static int mock_screen_calls;
+static int mock_menu_calls;
+static uint32_t mock_menu_locale;
+static uint32_t mock_menu_redraw_base;
 
 /* Reset mock data (for use before each test) */
 static void ResetMocks(void)
@@ -50,6 +54,11 @@ static void ResetMocks(void)
 	VbSharedDataInit(shared, sizeof(shared_data));
 
 	*debug_info = 0;
+
+	mock_screen_calls = 0;
+	mock_menu_calls = 0;
+	mock_menu_locale = 0xffffffff;
+	mock_menu_redraw_base = 0xffffffff;
 }
 
 /* Mocks */
@@ -66,6 +75,23 @@ uint32_t VbExGetAltFwIdxMask() {
 	return mock_altfw_mask;
 }
 
+VbError_t VbExDisplayScreen(uint32_t screen_type, uint32_t locale,
+			    const VbScreenData *data)
+{
+	mock_screen_calls++;
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDisplayMenu(uint32_t screen_type, uint32_t locale,
+			  uint32_t selected_index, uint32_t disabled_idx_mask,
+			  uint32_t redraw_base)
+{
+	mock_menu_calls++;
+	mock_menu_locale = locale;
+	mock_menu_redraw_base = redraw_base;
+	return VBERROR_SUCCESS;
+}
+
 VbError_t VbExDisplayDebugInfo(const char *info_str, int full_info)
 {
 	strncpy(debug_info, info_str, sizeof(debug_info));
@@ -76,6 +102,7 @@ VbError_t VbExDisplayDebugInfo(const char *info_str, int full_info)
 /* Test displaying debug info */
 static void DebugInfoTest(void)
 {
+	char first[sizeof(debug_info)];
 	int i;
 
 	/* Recovery string should be non-null for any code */
@@ -87,6 +114,17 @@ static void DebugInfoTest(void)
 	TEST_SUCC(VbDisplayDebugInfo(&ctx),
 		  "Display debug info");
 	TEST_NEQ(*debug_info, '\0', "  Some debug info was displayed");
+
+	/* Parts which can change are shown fresh the next time */
+	strcpy(first, debug_info);
+	TEST_SUCC(VbDisplayDebugInfo(&ctx), "Display debug info again");
+	TEST_STR_EQ(debug_info, first, "  Same debug info");
+	vb2_nv_set(&ctx, VB2_NV_DEV_BOOT_USB, 1);
+	TEST_SUCC(VbDisplayDebugInfo(&ctx), "Display changed debug info");
+	TEST_PTR_NEQ(strstr(debug_info, "dev_boot_usb: 1"), NULL,
+		     "  NV change shown");
+	TEST_PTR_EQ(strstr(first, "dev_boot_usb: 1"), NULL,
+		    "  not before the change");
 }
 
 /* Test display key checking */
@@ -126,12 +164,70 @@ static void DisplayKeyTest(void)
 	VbCheckDisplayKey(&ctx, VB_KEY_UP, NULL);
 	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_LOCALIZATION_INDEX), 0,
 		"DisplayKey invalid");
+
+	/* Changing localization redraws the screen */
+	ResetMocks();
+	VbCheckDisplayKey(&ctx, VB_KEY_UP, NULL);
+	TEST_EQ(mock_screen_calls, 1, "DisplayKey up redraws");
+
+	/* With only one localization there's nothing to redraw */
+	ResetMocks();
+	mock_localization_count = 1;
+	VbCheckDisplayKey(&ctx, VB_KEY_UP, NULL);
+	TEST_EQ(vb2_nv_get(&ctx, VB2_NV_LOCALIZATION_INDEX), 0,
+		"DisplayKey one locale");
+	TEST_EQ(mock_screen_calls, 0, "  no redraw");
+}
+
+/* Test that menus are only redrawn as much as they need to be */
+static void DisplayMenuTest(void)
+{
+	uint32_t screen = VB_SCREEN_OPTIONS_MENU;
+
+	ResetMocks();
+	TEST_SUCC(VbDisplayMenu(&ctx, screen, 0, 1, 0), "Menu first draw");
+	TEST_EQ(mock_menu_calls, 1, "  drawn");
+	TEST_EQ(mock_menu_redraw_base, 1, "  with base");
+
+	ResetMocks();
+	VbDisplayMenu(&ctx, screen, 0, 1, 0);
+	TEST_EQ(mock_menu_calls, 0, "Menu unchanged not drawn");
+
+	ResetMocks();
+	VbDisplayMenu(&ctx, screen, 0, 2, 0);
+	TEST_EQ(mock_menu_calls, 1, "Menu new selection drawn");
+	TEST_EQ(mock_menu_redraw_base, 0, "  without base");
+
+	ResetMocks();
+	VbDisplayMenu(&ctx, screen, 0, 2, 0x4);
+	TEST_EQ(mock_menu_calls, 1, "Menu new disabled mask drawn");
+	TEST_EQ(mock_menu_redraw_base, 0, "  without base");
+
+	ResetMocks();
+	vb2_nv_set(&ctx, VB2_NV_LOCALIZATION_INDEX, 2);
+	VbDisplayMenu(&ctx, screen, 0, 2, 0x4);
+	TEST_EQ(mock_menu_calls, 1, "Menu new locale drawn");
+	TEST_EQ(mock_menu_locale, 2, "  in new locale");
+	TEST_EQ(mock_menu_redraw_base, 1, "  with base");
+
+	ResetMocks();
+	vb2_nv_set(&ctx, VB2_NV_LOCALIZATION_INDEX, 2);
+	VbDisplayMenu(&ctx, screen, 1, 2, 0x4);
+	TEST_EQ(mock_menu_calls, 1, "Menu forced drawn");
+	TEST_EQ(mock_menu_redraw_base, 1, "  with base");
+
+	ResetMocks();
+	vb2_nv_set(&ctx, VB2_NV_LOCALIZATION_INDEX, 2);
+	VbDisplayMenu(&ctx, VB_SCREEN_LANGUAGES_MENU, 0, 2, 0x4);
+	TEST_EQ(mock_menu_calls, 1, "Menu new screen drawn");
+	TEST_EQ(mock_menu_redraw_base, 1, "  with base");
 }
 
 int main(void)
 {
 	DebugInfoTest();
 	DisplayKeyTest();
+	DisplayMenuTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -13,14 +13,18 @@
 #include "2sysincludes.h"
 #include "2api.h"
 #include "2common.h"
+#include "2lz4.h"
 #include "2misc.h"
 #include "2nvstorage.h"
+#include "2rsa.h"
 #include "2sha.h"
 #include "cgptlib.h"
 #include "cgptlib_internal.h"
 #include "crc32.h"
 #include "gpt.h"
+#include "gpt_misc.h"
 #include "host_common.h"
+#include "host_lz4.h"
 #include "load_kernel_fw.h"
 #include "rollback_index.h"
 #include "test_common.h"
@@ -40,6 +44,7 @@
 struct mock_part {
 	uint32_t start;
 	uint32_t size;
+	int vblock_written;
 };
 
 /* Partition list; ends with a 0-size partition. */
@@ -50,6 +55,7 @@ static int mock_part_next;
 /* Mock data */
 static char call_log[4096];
 static uint8_t kernel_buffer[80000];
+static uint8_t uncompressed_body[70144];
 static int disk_read_to_fail;
 static int disk_write_to_fail;
 static int gpt_init_fail;
@@ -57,6 +63,15 @@ static int key_block_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
 static int unpack_key_fail;
+static int unpack_key_calls;
+static int keyblock_verify_calls;
+static int preamble_verify_calls;
+static int parallel_enabled;
+static int parallel_jobs;
+static void (*parallel_func)(void *arg);
+static void *parallel_arg;
+static int hwcrypto_enabled;
+static int hwcrypto_used;
 static int gpt_flag_external;
 
 static struct vb2_gbb_header gbb;
@@ -73,7 +88,8 @@ static GptHeader *mock_gpt_primary =
 static GptHeader *mock_gpt_secondary =
 	(GptHeader*)&mock_disk[MOCK_SECTOR_SIZE * (MOCK_SECTOR_COUNT - 1)];
 static uint8_t mock_digest[VB2_SHA256_DIGEST_SIZE] = {12, 34, 56, 78};
-static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
+/* Twice the usual size, so there is room for a parallel vblock check */
+static uint8_t workbuf[2 * VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
 static struct vb2_context ctx;
 static struct vb2_packed_key mock_key;
 
@@ -134,6 +150,15 @@ static void ResetMocks(void)
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
 	unpack_key_fail = 0;
+	unpack_key_calls = 0;
+	keyblock_verify_calls = 0;
+	preamble_verify_calls = 0;
+	parallel_enabled = 0;
+	parallel_jobs = 0;
+	parallel_func = NULL;
+	parallel_arg = NULL;
+	hwcrypto_enabled = 0;
+	hwcrypto_used = 0;
 
 	gpt_flag_external = 0;
 
@@ -176,7 +201,7 @@ static void ResetMocks(void)
 
 	memset(&ctx, 0, sizeof(ctx));
 	ctx.workbuf = workbuf;
-	ctx.workbuf_size = sizeof(workbuf);
+	ctx.workbuf_size = VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE;
 	vb2_nv_init(&ctx);
 
 	memset(&mock_key, 0, sizeof(mock_key));
@@ -251,12 +276,15 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t h, uint64_t lba_start,
 
 int GptInit(GptData *gpt)
 {
+	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	return gpt_init_fail;
 }
 
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 {
-	struct mock_part *p = mock_parts + mock_part_next;
+	/* Continue from gpt, so looking ahead on a copy works */
+	int next = gpt->current_kernel + 1;
+	struct mock_part *p = mock_parts + next;
 
 	if (!p->size)
 		return GPT_ERROR_NO_VALID_KERNEL;
@@ -264,10 +292,11 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 	if (gpt->flags & GPT_FLAG_EXTERNAL)
 		gpt_flag_external++;
 
-	gpt->current_kernel = mock_part_next;
+	gpt->current_kernel = next;
 	*start_sector = p->start;
 	*size = p->size;
-	mock_part_next++;
+	if (mock_part_next <= next)
+		mock_part_next = next + 1;
 	return GPT_SUCCESS;
 }
 
@@ -282,9 +311,11 @@ int vb2_unpack_key_buffer(struct vb2_public_key *key,
 		   const uint8_t *buf,
 		   uint32_t size)
 {
+	unpack_key_calls++;
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	key->hash_alg = VB2_HASH_SHA256;
 	return VB2_SUCCESS;
 }
 
@@ -293,6 +324,7 @@ int vb2_verify_keyblock(struct vb2_keyblock *block,
 			const struct vb2_public_key *key,
 			const struct vb2_workbuf *wb)
 {
+	keyblock_verify_calls++;
 	if (key_block_verify_fail >= 1)
 		return VB2_ERROR_MOCK;
 
@@ -318,6 +350,7 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 			       const struct vb2_public_key *key,
 			       const struct vb2_workbuf *wb)
 {
+	preamble_verify_calls++;
 	if (preamble_verify_fail)
 		return VB2_ERROR_MOCK;
 
@@ -326,11 +359,10 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 	return VB2_SUCCESS;
 }
 
-int vb2_verify_data(const uint8_t *data,
-		    uint32_t size,
-		    struct vb2_signature *sig,
-		    const struct vb2_public_key *key,
-		    const struct vb2_workbuf *wb)
+int vb2_verify_digest(const struct vb2_public_key *key,
+		      struct vb2_signature *sig,
+		      const uint8_t *digest,
+		      const struct vb2_workbuf *wb)
 {
 	if (verify_data_fail)
 		return VB2_ERROR_MOCK;
@@ -338,6 +370,27 @@ int vb2_verify_data(const uint8_t *data,
 	return VB2_SUCCESS;
 }
 
+int vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+			       uint32_t data_size)
+{
+	if (!hwcrypto_enabled)
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+
+	hwcrypto_used = 1;
+	return VB2_SUCCESS;
+}
+
+int vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	return VB2_SUCCESS;
+}
+
+int vb2ex_hwcrypto_digest_finalize(uint8_t *digest, uint32_t digest_size)
+{
+	memset(digest, 0, digest_size);
+	return VB2_SUCCESS;
+}
+
 int vb2_digest_buffer(const uint8_t *buf,
 		      uint32_t size,
 		      enum vb2_hash_algorithm hash_alg,
@@ -348,6 +401,72 @@ int vb2_digest_buffer(const uint8_t *buf,
 	return VB2_SUCCESS;
 }
 
+int vb2ex_parallel_start(void (*func)(void *arg), void *arg, void **job)
+{
+	if (!parallel_enabled)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	/* Run the job when it's waited for, as late as a real one could */
+	parallel_jobs++;
+	parallel_func = func;
+	parallel_arg = arg;
+	*job = &parallel_func;
+	return VB2_SUCCESS;
+}
+
+void vb2ex_parallel_wait(void *job)
+{
+	TEST_PTR_EQ(job, &parallel_func, "  wait for started job");
+	parallel_func(parallel_arg);
+	parallel_func = NULL;
+}
+
+/* Put the mock vblock at the start of a partition */
+static void WriteMockVblock(int part)
+{
+	uint8_t *vblock = mock_disk + mock_parts[part].start * MOCK_SECTOR_SIZE;
+
+	memcpy(vblock, &kbh, sizeof(kbh));
+	memcpy(vblock + kbh.key_block_size, &kph, sizeof(kph));
+	mock_parts[part].vblock_written = 1;
+}
+
+/*
+ * Put an LZ4-compressed body after the mock vblock of the first partition,
+ * and describe it in the preamble.
+ */
+static void SetupCompressedBody(void)
+{
+	uint8_t *body = mock_disk + mock_parts[0].start * MOCK_SECTOR_SIZE +
+		4096;
+	uint8_t *compressed;
+	uint32_t compressed_size;
+	int i;
+
+	for (i = 0; i < sizeof(uncompressed_body); i++)
+		uncompressed_body[i] = (i / 100) ^ (i % 7);
+	compressed = vb2_lz4_compress(uncompressed_body,
+				      sizeof(uncompressed_body),
+				      &compressed_size);
+	memcpy(body, compressed, compressed_size);
+	free(compressed);
+
+	kph.header_version_minor = 4;
+	kph.body_signature.data_size = compressed_size;
+	kph.body_compression = VB2_KERNEL_COMPRESSION_LZ4;
+	kph.body_uncompressed_size = sizeof(uncompressed_body);
+}
+
+/* Give the primary GPT a good entries CRC, so it is valid on its own */
+static void SetupGoodPrimaryGpt(void)
+{
+	GptHeader *h = mock_gpt_primary;
+
+	h->entries_crc32 = Crc32(&mock_disk[MOCK_SECTOR_SIZE * h->entries_lba],
+				 h->number_of_entries * h->size_of_entry);
+	h->header_crc32 = HeaderCrc(h);
+}
+
 /**
  * Test reading/writing GPT
  */
@@ -375,6 +494,49 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree");
 	TEST_CALLS("");
 
+	/* Secondary GPT isn't read if the primary GPT is good */
+	ResetMocks();
+	SetupGoodPrimaryGpt();
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead primary good");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n");
+	TEST_EQ(g.secondary_copied, 1, "  secondary copied");
+	TEST_EQ(CheckHeader((GptHeader *)g.secondary_header, 1,
+			    g.streaming_drive_sectors, g.gpt_drive_sectors, 0,
+			    g.sector_bytes), 0, "  secondary header valid");
+	TEST_EQ(GptSanityCheck(&g), GPT_SUCCESS, "  sanity check");
+	TEST_EQ(g.valid_headers, MASK_BOTH, "  both headers valid");
+	TEST_EQ(g.valid_entries, MASK_BOTH, "  both entries valid");
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "  WriteAndFree");
+	TEST_CALLS("");
+
+	/* Copied secondary is written if it's modified */
+	ResetMocks();
+	SetupGoodPrimaryGpt();
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
+		"WriteAndFree copied secondary");
+	TEST_CALLS("VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 991, 32)\n");
+
+	/* Unless the secondary on the drive is being ignored */
+	ResetMocks();
+	SetupGoodPrimaryGpt();
+	memcpy(mock_gpt_secondary->signature, GPT_HEADER_SIGNATURE_IGNORED,
+	       GPT_HEADER_SIGNATURE_SIZE);
+	AllocAndReadGptData(handle, &g);
+	g.modified = -1;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
+		"WriteAndFree ignored secondary");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
+		   "VbExDiskWrite(h, 2, 32)\n"
+		   "VbExDiskRead(h, 1023, 1)\n");
+
 	/*
 	 * Invalidate primary GPT header,
 	 * check that AllocAndReadGptData still succeeds
@@ -514,6 +676,42 @@ static void ReadWriteGptTest(void)
 		   "VbExDiskWrite(h, 1023, 1)\n"
 		   "VbExDiskWrite(h, 991, 32)\n");
 
+	/* Only the dirty entry sectors are written, in contiguous runs */
+	ResetMocks();
+	AllocAndReadGptData(handle, &g);
+	g.modified = -1;
+	g.dirty_entry_sectors = 0x80000006;
+	ResetCallLog();
+	memset(g.primary_header, '\0', g.sector_bytes);
+	h = (GptHeader*)g.primary_header;
+	h->entries_lba = 2;
+	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h->size_of_entry = sizeof(GptEntry);
+	h = (GptHeader*)g.secondary_header;
+	h->entries_lba = 991;
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree dirty");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
+		   "VbExDiskWrite(h, 3, 2)\n"
+		   "VbExDiskWrite(h, 33, 1)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 992, 2)\n"
+		   "VbExDiskWrite(h, 1022, 1)\n");
+
+	/* But all of a copied secondary is written */
+	ResetMocks();
+	SetupGoodPrimaryGpt();
+	AllocAndReadGptData(handle, &g);
+	g.modified = -1;
+	g.dirty_entry_sectors = 0x00000001;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
+		"WriteAndFree dirty copied secondary");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
+		   "VbExDiskWrite(h, 2, 1)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 991, 32)\n");
+
 	/* If legacy signature, don't modify GPT header/entries 1 */
 	ResetMocks();
 	AllocAndReadGptData(handle, &g);
@@ -601,6 +799,17 @@ static void ReadWriteGptTest(void)
 
 static void TestLoadKernel(int expect_retval, const char *test_name)
 {
+	int i;
+
+	/*
+	 * The verify mocks replace the headers with kbh and kph, but they're
+	 * checked before that too, so put them on the disk.
+	 */
+	for (i = 0; i < MOCK_PART_COUNT && mock_parts[i].size; i++) {
+		if (!mock_parts[i].vblock_written)
+			WriteMockVblock(i);
+	}
+
 	TEST_EQ(LoadKernel(&ctx, &lkp), expect_retval, test_name);
 }
 
@@ -621,6 +830,9 @@ static void InvalidParamsTest(void)
 
 static void LoadKernelTest(void)
 {
+	const struct vb2_disk_read *reads;
+	uint32_t reads_count, reads_dropped;
+
 	ResetMocks();
 
 	TestLoadKernel(0, "First kernel good");
@@ -689,6 +901,42 @@ static void LoadKernelTest(void)
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
 		       "Fail key block dev sig fwmp");
 
+	/* In dev mode, a key block which can't be valid is only hashed */
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	kbh.key_block_flags =
+		KEY_BLOCK_FLAG_RECOVERY_0 | KEY_BLOCK_FLAG_DEVELOPER_0;
+	WriteMockVblock(0);
+	TestLoadKernel(0, "Key block dev flag mismatch hash only");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags,
+		VBSD_LKP_FLAG_KEY_BLOCK_HASH_ONLY, "  hash only flag");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	kbh.data_key.key_version = 1;
+	WriteMockVblock(0);
+	TestLoadKernel(0, "Key block dev rollback hash only");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	WriteMockVblock(0);
+	TestLoadKernel(0, "Key block dev usable checks signature");
+	TEST_EQ(keyblock_verify_calls, 1, "  signature checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags,
+		VBSD_LKP_FLAG_KEY_BLOCK_VALID, "  key block valid");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	vb2_nv_set(&ctx, VB2_NV_DEV_BOOT_SIGNED_ONLY, 1);
+	kbh.key_block_flags =
+		KEY_BLOCK_FLAG_RECOVERY_0 | KEY_BLOCK_FLAG_DEVELOPER_0;
+	WriteMockVblock(0);
+	TestLoadKernel(0, "Key block dev signed only checks signature");
+	TEST_EQ(keyblock_verify_calls, 1, "  signature checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags, 0, "  not hash only");
+
 	/* Check key block flag mismatches */
 	ResetMocks();
 	kbh.key_block_flags =
@@ -726,6 +974,54 @@ static void LoadKernelTest(void)
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
 		       "Key block kernel key version too big");
 
+	/* Vblocks which can't be used are rejected before any verification */
+	ResetMocks();
+	kbh.key_block_flags =
+		KEY_BLOCK_FLAG_RECOVERY_0 | KEY_BLOCK_FLAG_DEVELOPER_1;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Early reject dev flag");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_DEV_MISMATCH, "  check result");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags,
+		VBSD_LKP_FLAG_EARLY_REJECT, "  early reject flag");
+
+	ResetMocks();
+	kbh.data_key.key_version = 1;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Early reject key version");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_KEY_ROLLBACK, "  check result");
+
+	ResetMocks();
+	kph.kernel_version = 0;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Early reject kernel version");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+	TEST_EQ(preamble_verify_calls, 0, "  preamble not checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_KERNEL_ROLLBACK, "  check result");
+
+	ResetMocks();
+	ctx.flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	kbh.data_key.algorithm = VB2_ALG_COUNT;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Early reject data key algorithm");
+	TEST_EQ(keyblock_verify_calls, 0, "  signature not checked");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_DATA_KEY_PARSE, "  check result");
+
+	ResetMocks();
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	kph.kernel_version = 0;
+	WriteMockVblock(0);
+	kph.kernel_version = 1;
+	TestLoadKernel(0, "Early reject stale partition");
+	TEST_EQ(keyblock_verify_calls, 1, "  only good keyblock verified");
+	TEST_EQ(lkp.partition_number, 2, "  part num");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags,
+		VBSD_LKP_FLAG_EARLY_REJECT, "  stale rejected early");
+
 	ResetMocks();
 	kbh.data_key.key_version = 3;
 	TestLoadKernel(0, "Key block version roll forward");
@@ -738,6 +1034,95 @@ static void LoadKernelTest(void)
 	TestLoadKernel(0, "Two kernels roll forward");
 	TEST_EQ(mock_part_next, 2, "  read both");
 	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+	/* Kernel subkey once, then the data key once per partition */
+	TEST_EQ(unpack_key_calls, 3, "  unpacked each key once");
+
+	ResetMocks();
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	WriteMockVblock(0);
+	WriteMockVblock(1);
+	TestLoadKernel(0, "Two identical vblocks");
+	TEST_EQ(mock_part_next, 2, "  read both");
+	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+	TEST_EQ(keyblock_verify_calls, 1, "  keyblock verified once");
+	TEST_EQ(preamble_verify_calls, 1, "  preamble verified once");
+	TEST_NEQ(shared->lk_calls[0].parts[1].flags &
+		 VBSD_LKP_FLAG_KEY_BLOCK_VALID, 0, "  second keyblock valid");
+
+	ResetMocks();
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	WriteMockVblock(0);
+	kph.kernel_version = 2;
+	WriteMockVblock(1);
+	kph.kernel_version = 1;
+	TestLoadKernel(0, "Two different vblocks");
+	TEST_EQ(keyblock_verify_calls, 2, "  keyblock verified twice");
+	TEST_EQ(preamble_verify_calls, 2, "  preamble verified twice");
+
+	ResetMocks();
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	parallel_enabled = 1;
+	ctx.workbuf_size = sizeof(workbuf);
+	TestLoadKernel(0, "Second vblock verified in parallel");
+	TEST_EQ(parallel_jobs, 1, "  one job");
+	TEST_EQ(mock_part_next, 2, "  read both");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+	TEST_EQ(shared->lk_calls[0].parts[1].check_result,
+		VBSD_LKP_CHECK_PREAMBLE_VALID, "  second preamble valid");
+	TEST_EQ(shared->lk_calls[0].parts[1].gpt_index, 2, "  second index");
+	TEST_EQ(keyblock_verify_calls, 1, "  identical keyblock cached");
+
+	ResetMocks();
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	WriteMockVblock(0);
+	kph.kernel_version = 2;
+	WriteMockVblock(1);
+	kph.kernel_version = 1;
+	parallel_enabled = 1;
+	ctx.workbuf_size = sizeof(workbuf);
+	TestLoadKernel(0, "Different vblock verified in parallel");
+	TEST_EQ(parallel_jobs, 1, "  one job");
+	TEST_EQ(shared->lk_calls[0].parts[1].check_result,
+		VBSD_LKP_CHECK_PREAMBLE_VALID, "  second preamble valid");
+	TEST_EQ(keyblock_verify_calls, 2, "  keyblock verified twice");
+	TEST_EQ(preamble_verify_calls, 2, "  preamble verified twice");
+
+	ResetMocks();
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	parallel_enabled = 1;
+	TestLoadKernel(0, "No workbuf for parallel vblock");
+	TEST_EQ(parallel_jobs, 0, "  no job");
+	TEST_EQ(mock_part_next, 2, "  read both");
+	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+
+	ResetMocks();
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	parallel_enabled = 1;
+	ctx.workbuf_size = sizeof(workbuf);
+	disk_read_to_fail = 228;
+	TestLoadKernel(0, "Parallel vblock unused after bad body");
+	TEST_EQ(parallel_jobs, 1, "  one job");
+	TEST_EQ(lkp.partition_number, 2, "  part num");
+	TEST_EQ(shared->lk_calls[0].parts[1].check_result,
+		VBSD_LKP_CHECK_KERNEL_GOOD, "  second kernel loaded");
+
+	ResetMocks();
+	parallel_enabled = 1;
+	ctx.workbuf_size = sizeof(workbuf);
+	TestLoadKernel(0, "No second partition for parallel vblock");
+	TEST_EQ(parallel_jobs, 0, "  no job");
 
 	ResetMocks();
 	kbh.data_key.key_version = 1;
@@ -749,6 +1134,10 @@ static void LoadKernelTest(void)
 	ctx.flags |= VB2_CONTEXT_RECOVERY_MODE;
 	TestLoadKernel(0, "Key version ignored in rec mode");
 
+	ResetMocks();
+	unpack_key_fail = 1;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Bad kernel subkey");
+
 	ResetMocks();
 	unpack_key_fail = 2;
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Bad data key");
@@ -795,6 +1184,40 @@ static void LoadKernelTest(void)
 	kph.preamble_size += 65536;
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Kernel body offset huge");
 
+	ResetMocks();
+	kph.preamble_size += 65536;
+	lkp.vblock_read_size = 128 * 1024 + 100;
+	mock_parts[0].size = 400;
+	ctx.workbuf_size = sizeof(workbuf);
+	TestLoadKernel(0, "Kernel body offset with bigger vblock read");
+
+	/* Check reading the vblock into the kernel buffer */
+	ResetMocks();
+	mock_disk[100 * MOCK_SECTOR_SIZE + 4096] = 0xa5;
+	TestLoadKernel(0, "Vblock read into workbuf");
+	TEST_PTR_EQ(lkp.kernel_buffer, kernel_buffer, "  address");
+	TEST_EQ(kernel_buffer[0], 0xa5, "  body copied");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER;
+	mock_disk[100 * MOCK_SECTOR_SIZE + 4096] = 0xa5;
+	TestLoadKernel(0, "Vblock read into kernel buffer");
+	TEST_PTR_EQ(lkp.kernel_buffer, kernel_buffer + 4096, "  body address");
+	TEST_EQ(lkp.kernel_buffer_size, sizeof(kernel_buffer) - 4096,
+		"  body size");
+	TEST_EQ(kernel_buffer[4096], 0xa5, "  body in place");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER;
+	kbh.data_key.key_version = 3;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	mock_disk[100 * MOCK_SECTOR_SIZE + 4096] = 0xa5;
+	mock_disk[300 * MOCK_SECTOR_SIZE + 4096] = 0x5a;
+	TestLoadKernel(0, "Second vblock not read into kernel buffer");
+	TEST_EQ(mock_part_next, 2, "  read both");
+	TEST_EQ(kernel_buffer[4096], 0xa5, "  first body kept");
+
 	/* Check getting kernel load address from header */
 	ResetMocks();
 	kph.body_load_address = (size_t)kernel_buffer;
@@ -818,6 +1241,18 @@ static void LoadKernelTest(void)
 	kph.body_signature.data_size = 8192;
 	TestLoadKernel(0, "Kernel tiny");
 
+	/* Only the signed data is read for an uncompressed body */
+	ResetMocks();
+	lkp.kernel_buffer_size = kph.body_signature.data_size;
+	TestLoadKernel(0, "Kernel body fills buffer");
+
+	ResetMocks();
+	kph.body_load_address = (size_t)kernel_buffer;
+	lkp.kernel_buffer = NULL;
+	TestLoadKernel(0, "Kernel body at preamble address");
+	TEST_EQ(lkp.kernel_buffer_size, kph.body_signature.data_size,
+		"  size");
+
 	ResetMocks();
 	disk_read_to_fail = 228;
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
@@ -827,6 +1262,134 @@ static void LoadKernelTest(void)
 	verify_data_fail = 1;
 	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Bad data");
 
+	/* Read and hash the kernel body in chunks */
+	ResetMocks();
+	lkp.body_chunk_size = 4096;
+	TestLoadKernel(0, "Kernel body in chunks");
+
+	/* The GPT, vblock and body reads are traced, with chunks merged */
+	ResetMocks();
+	lkp.body_chunk_size = 4096;
+	ctx.workbuf_used = vb2_wb_round_up(sizeof(struct vb2_shared_data));
+	VbDiskReadReset();
+	TestLoadKernel(0, "Kernel body in chunks, traced");
+	reads = VbDiskReadGetTrace(&reads_count, &reads_dropped);
+	TEST_EQ(reads_count, 5, "  reads count");
+	TEST_EQ(reads[0].purpose, VB2_DISK_READ_GPT_PRIMARY, "  gpt read");
+	TEST_EQ(reads[0].lba_start, 1, "  gpt start");
+	TEST_EQ(reads[1].purpose, VB2_DISK_READ_GPT_SECONDARY,
+		"  secondary gpt read");
+	TEST_EQ(reads[3].purpose, VB2_DISK_READ_VBLOCK, "  vblock read");
+	TEST_EQ(reads[3].lba_start, 100, "  vblock start");
+	TEST_EQ(reads[4].purpose, VB2_DISK_READ_BODY, "  body read");
+	TEST_EQ(reads[4].lba_start, 100 + reads[3].lba_count, "  body start");
+	TEST_EQ(reads[4].requests > 1, 1, "  body chunks merged");
+	VbDiskReadReset();
+
+	ResetMocks();
+	lkp.body_chunk_size = 4096 + 100;
+	TestLoadKernel(0, "Kernel body in unaligned chunks");
+
+	ResetMocks();
+	lkp.body_chunk_size = 100;
+	TestLoadKernel(0, "Kernel body chunk smaller than sector");
+
+	ResetMocks();
+	lkp.body_chunk_size = 4096;
+	kph.body_signature.data_size = 8192;
+	TestLoadKernel(0, "Kernel tiny in chunks");
+
+	ResetMocks();
+	lkp.body_chunk_size = 4096;
+	disk_read_to_fail = 236;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Fail reading kernel data chunk");
+
+	ResetMocks();
+	lkp.body_chunk_size = 4096;
+	verify_data_fail = 1;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND, "Bad data in chunks");
+
+	/* Hash the kernel body with the hardware crypto engine */
+	ResetMocks();
+	hwcrypto_enabled = 1;
+	TestLoadKernel(0, "Kernel body hwcrypto");
+	TEST_EQ(hwcrypto_used, 1, "  used hwcrypto");
+
+	ResetMocks();
+	hwcrypto_enabled = 1;
+	lkp.body_chunk_size = 4096;
+	TestLoadKernel(0, "Kernel body hwcrypto in chunks");
+	TEST_EQ(hwcrypto_used, 1, "  used hwcrypto");
+
+	ResetMocks();
+	hwcrypto_enabled = 1;
+	kph.header_version_minor = 2;
+	kph.flags = VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO;
+	TestLoadKernel(0, "Kernel body hwcrypto forbidden");
+	TEST_EQ(hwcrypto_used, 0, "  used sw");
+
+	/* Decompress the kernel body as it is read */
+	ResetMocks();
+	SetupCompressedBody();
+	TestLoadKernel(0, "Compressed kernel body");
+	TEST_PTR_EQ(lkp.kernel_buffer, kernel_buffer, "  address");
+	TEST_SUCC(memcmp(kernel_buffer, uncompressed_body,
+			 sizeof(uncompressed_body)), "  decompressed");
+
+	ResetMocks();
+	SetupCompressedBody();
+	lkp.body_chunk_size = 4096;
+	TestLoadKernel(0, "Compressed kernel body in chunks");
+	TEST_SUCC(memcmp(kernel_buffer, uncompressed_body,
+			 sizeof(uncompressed_body)), "  decompressed");
+
+	ResetMocks();
+	SetupCompressedBody();
+	lkp.body_chunk_size = 4096;
+	lkp.boot_flags |= BOOT_FLAG_VBLOCK_IN_KERNEL_BUFFER;
+	TestLoadKernel(0, "Compressed kernel body, vblock in kernel buffer");
+	TEST_PTR_EQ(lkp.kernel_buffer, kernel_buffer + 4096, "  address");
+	TEST_SUCC(memcmp(kernel_buffer + 4096, uncompressed_body,
+			 sizeof(uncompressed_body)), "  decompressed");
+
+	ResetMocks();
+	SetupCompressedBody();
+	kph.body_load_address = (size_t)kernel_buffer;
+	lkp.kernel_buffer = NULL;
+	TestLoadKernel(0, "Compressed kernel body at preamble address");
+	/* Room to decompress in place, after reading whole sectors */
+	TEST_EQ(lkp.kernel_buffer_size, sizeof(uncompressed_body) +
+		VB2_LZ4_INPLACE_MARGIN(kph.body_signature.data_size) +
+		511 - (kph.body_signature.data_size + 511) % 512,
+		"  size");
+	TEST_SUCC(memcmp(kernel_buffer, uncompressed_body,
+			 sizeof(uncompressed_body)), "  decompressed");
+
+	ResetMocks();
+	SetupCompressedBody();
+	lkp.kernel_buffer_size = sizeof(uncompressed_body);
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Compressed kernel body without room to decompress");
+
+	ResetMocks();
+	SetupCompressedBody();
+	kph.body_uncompressed_size++;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Compressed kernel body wrong size");
+
+	ResetMocks();
+	SetupCompressedBody();
+	mock_disk[100 * MOCK_SECTOR_SIZE + 4096] = 0xff;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Compressed kernel body corrupt");
+
+	ResetMocks();
+	SetupCompressedBody();
+	verify_data_fail = 1;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Compressed kernel body bad data");
+
 	/* Check that EXTERNAL_GPT flag makes it down */
 	ResetMocks();
 	lkp.boot_flags |= BOOT_FLAG_EXTERNAL_GPT;
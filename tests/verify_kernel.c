@@ -71,10 +71,8 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	/* Load disk file */
-	/* TODO: is it better to mmap() in the long run? */
-	diskbuf = ReadFile(argv[1], &disk_bytes);
-	if (!diskbuf) {
+	/* Map disk file, so only the parts LoadKernel() uses are read */
+	if (vb2_map_file(argv[1], &diskbuf, &disk_bytes) || !diskbuf) {
 		fprintf(stderr, "Can't read disk file %s\n", argv[1]);
 		return 1;
 	}
@@ -95,6 +95,14 @@ const Param sys_param_list[] = {
   {"tpm_rebooted", 0, "TPM requesting repeated reboot (vboot2)"},
   {"tried_fwb", 0, "Tried firmware B before A this boot"},
   {"try_ro_sync", 0, "try read only software sync"},
+  {"vboot_costs", IS_STRING|NO_PRINT_ALL,
+   "Time and bytes hashed by each verification step (not in print-all)"},
+  {"vboot_disk_reads", IS_STRING|NO_PRINT_ALL,
+   "Disk reads made looking for a kernel (not in print-all)"},
+  {"vboot_tpm_stats", IS_STRING|NO_PRINT_ALL,
+   "TPM commands sent by firmware, and their timing (not in print-all)"},
+  {"vboot_trace", IS_STRING|NO_PRINT_ALL,
+   "Boot-time trace of verified boot (not in print-all)"},
   {"vdat_flags", 0, "Flags from VbSharedData", "0x%08x"},
   {"vdat_lfdebug", IS_STRING|NO_PRINT_ALL,
    "LoadFirmware() debug data (not in print-all)"},
@@ -111,6 +119,9 @@ const Param sys_param_list[] = {
 /* Longest Param name. */
 static const int kNameWidth = 23;
 
+/* How often --watch checks properties it isn't told about, in ms */
+static const int kWatchIntervalMs = 5000;
+
 
 /* Print help */
 static void PrintHelp(const char *progname) {
@@ -126,9 +137,15 @@ static void PrintHelp(const char *progname) {
          "    Sets the parameter(s) to the specified value(s).\n"
          "  %s [param1?value1] [param2?value2 [...]]]\n"
          "    Checks if the parameter(s) all contain the specified value(s).\n"
-         "Stops at the first error."
+         "Stops at the first error.\n"
+         "  %s --watch param1[,param2[...]] [interval_ms]\n"
+         "    Prints param=value for each parameter, then again each time\n"
+         "    its value changes.  Writes to NV storage are seen at once where\n"
+         "    possible; otherwise values are checked every interval_ms\n"
+         "    (default %d).\n"
          "\n"
-         "Valid parameters:\n", progname, progname, progname, progname);
+         "Valid parameters:\n", progname, progname, progname, progname,
+         progname, kWatchIntervalMs);
   for (p = sys_param_list; p->name; p++) {
     printf("  %-*s  [%s/%s] %s\n", kNameWidth, p->name,
            (p->flags & CAN_WRITE) ? "RW" : "RO",
@@ -194,6 +211,22 @@ static int CheckParam(const Param* p, const char* expect) {
 }
 
 
+/* Read the specified parameter into a buffer, formatted for printing.
+ *
+ * Returns the buffer, or NULL if error. */
+static const char* GetParamValue(const Param* p, char* buf, size_t size) {
+  if (p->flags & IS_STRING) {
+    return VbGetSystemPropertyString(p->name, buf, size);
+  } else {
+    int v = VbGetSystemPropertyInt(p->name);
+    if (v == -1)
+      return NULL;
+    snprintf(buf, size, p->format ? p->format : "%d", v);
+    return buf;
+  }
+}
+
+
 /* Print the specified parameter.
  *
  * Returns 0 if success, non-zero if error. */
@@ -224,26 +257,88 @@ static int PrintAllParams(int force_all) {
   char buf[VB_MAX_STRING_PROPERTY];
   const char* value;
 
+  /* Read the firmware data once, rather than once per param */
+  VbSnapshotSystemProperties();
+
   for (p = sys_param_list; p->name; p++) {
     if (0 == force_all && (p->flags & NO_PRINT_ALL))
       continue;
-    if (p->flags & IS_STRING) {
-      value = VbGetSystemPropertyString(p->name, buf, sizeof(buf));
-    } else {
-      int v = VbGetSystemPropertyInt(p->name);
-      if (v == -1)
-        value = NULL;
-      else {
-        snprintf(buf, sizeof(buf), p->format ? p->format : "%d", v);
-        value = buf;
-      }
-    }
+    value = GetParamValue(p, buf, sizeof(buf));
     printf("%-*s = %-30s # [%s/%s] %s\n", kNameWidth, p->name,
            (value ? value : "(error)"),
            (p->flags & CAN_WRITE) ? "RW" : "RO",
            (p->flags & IS_STRING) ? "str" : "int",
            p->desc);
   }
+
+  VbReleaseSystemPropertySnapshot();
+  return retval;
+}
+
+
+/* Print the parameters named in a comma-separated list, then print each one
+ * again whenever its value changes.  Only returns on error.
+ *
+ * The firmware data behind the parameters is kept between checks, except
+ * for NV storage, which is read again after it's written or interval_ms
+ * passes; VbSharedData doesn't change until the next boot anyway.
+ *
+ * Returns non-zero if error. */
+static int WatchParams(char* names, int interval_ms) {
+  const Param* params[sizeof(sys_param_list) / sizeof(sys_param_list[0])];
+  char* values[sizeof(sys_param_list) / sizeof(sys_param_list[0])];
+  char buf[VB_MAX_STRING_PROPERTY];
+  const char* value;
+  char* name;
+  int count = 0;
+  int retval = 0;
+  int i;
+
+  for (name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+    const Param* p = FindParam(name);
+    if (!p) {
+      fprintf(stderr, "Invalid parameter name: %s\n", name);
+      return 1;
+    }
+    for (i = 0; i < count && params[i] != p; i++)
+      ;
+    if (i < count)
+      continue;  /* Already watched */
+    params[count] = p;
+    values[count++] = NULL;
+  }
+  if (!count) {
+    fprintf(stderr, "No parameters to watch\n");
+    return 1;
+  }
+
+  VbSnapshotSystemProperties();
+  for (;;) {
+    for (i = 0; i < count; i++) {
+      value = GetParamValue(params[i], buf, sizeof(buf));
+      if (!value)
+        value = "(error)";
+      if (values[i] && !strcmp(values[i], value))
+        continue;
+      free(values[i]);
+      values[i] = strdup(value);
+      if (!values[i]) {
+        retval = 1;
+        goto out;
+      }
+      printf("%s=%s\n", params[i]->name, value);
+    }
+    if (fflush(stdout)) {
+      retval = 1;
+      goto out;
+    }
+    VbWaitForSystemPropertyChange(interval_ms);
+  }
+
+out:
+  for (i = 0; i < count; i++)
+    free(values[i]);
+  VbReleaseSystemPropertySnapshot();
   return retval;
 }
 
@@ -265,6 +360,25 @@ int main(int argc, char* argv[]) {
   if (!strcasecmp(argv[1], "--all") || !strcmp(argv[1], "-a"))
     return PrintAllParams(1);
 
+  /* --watch prints params as they change */
+  if (!strcasecmp(argv[1], "--watch") || !strcmp(argv[1], "-w")) {
+    int interval_ms = kWatchIntervalMs;
+    char* e;
+
+    if (argc < 3 || argc > 4) {
+      PrintHelp(progname);
+      return 1;
+    }
+    if (argc == 4) {
+      interval_ms = (int)strtol(argv[3], &e, 0);
+      if (!*argv[3] || *e || interval_ms <= 0) {
+        fprintf(stderr, "Invalid interval: %s\n", argv[3]);
+        return 1;
+      }
+    }
+    return WatchParams(argv[2], interval_ms);
+  }
+
   /* Print help if needed */
   if (!strcasecmp(argv[1], "-h") || !strcmp(argv[1], "-?") ||
       !strcmp(argv[1], "--help")) {
@@ -272,7 +386,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  /* Otherwise, loop through params and get/set them */
+  /* Otherwise, loop through params and get/set them.  NV storage is written
+   * once at the end, for all the params set. */
+  VbBeginSystemPropertyWrites();
   for (i = 1; i < argc && retval == 0; i++) {
     char* has_set = strchr(argv[i], '=');
     char* has_expect = strchr(argv[i], '?');
@@ -284,14 +400,16 @@ int main(int argc, char* argv[]) {
     if (!name || has_set == argv[i] || has_expect == argv[i]) {
       fprintf(stderr, "Poorly formed parameter\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
     if (!value)
       value=""; /* Allow setting/checking an empty string ('foo=' or 'foo?') */
     if (has_set && has_expect) {
       fprintf(stderr, "Use either = or ? in a parameter, but not both.\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     /* Find the parameter */
@@ -299,7 +417,8 @@ int main(int argc, char* argv[]) {
     if (!p) {
       fprintf(stderr, "Invalid parameter name: %s\n", name);
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     if (i > 1)
@@ -315,5 +434,11 @@ int main(int argc, char* argv[]) {
       retval = PrintParam(p);
   }
 
+  /* Params set before an error are still written */
+  if (0 != VbCommitSystemPropertyWrites() && retval == 0) {
+    fprintf(stderr, "Failed to write NV storage\n");
+    retval = 1;
+  }
+
   return retval;
 }
@@ -3,14 +3,17 @@
  * found in the LICENSE file.
  */
 
-/* Routines for verifying a file's signature. Useful in testing the core
- * RSA verification implementation.
+/* Runs LoadKernel() on a disk image, recording every read it makes, and
+ * projects how long those reads would take on different boot devices.
  */
 
+#include <fcntl.h>
 #include <inttypes.h>  /* For PRIu64 macro */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -28,14 +31,36 @@
 
 /* Global variables for stub functions */
 static LoadKernelParams lkp;
-static FILE *image_file = NULL;
+static const uint8_t *image_data;
+static uint64_t read_start_ts;
+
+/* One VbExDiskRead() call made by LoadKernel() */
+struct read_record {
+  uint64_t lba_start;
+  uint64_t lba_count;
+  uint64_t time_us;                     /* Since LoadKernel() was called */
+};
+static struct read_record *reads;
+static int num_reads;
+static int max_reads;
+
+/* Cost of reads on a kind of boot device */
+struct device_profile {
+  const char *name;
+  uint32_t latency_us;                  /* Per read request */
+  uint32_t mb_per_sec;                  /* Sustained throughput */
+};
+
+static const struct device_profile profiles[] = {
+  {"emmc", 150, 150},
+  {"usb2", 1000, 30},
+  {"nvme", 20, 1500},
+};
 
 
 /* Boot device stub implementations to read from the image file */
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
                        uint64_t lba_count, void *buffer) {
-  printf("Read(%" PRIu64 ", %" PRIu64 ")\n", lba_start, lba_count);
-
   if (lba_start >= lkp.streaming_lba_count ||
       lba_start + lba_count > lkp.streaming_lba_count) {
     fprintf(stderr, "Read overrun: %" PRIu64 " + %" PRIu64 " > %" PRIu64 "\n",
@@ -43,11 +68,23 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
     return 1;
   }
 
-  if (0 != fseek(image_file, lba_start * lkp.bytes_per_lba, SEEK_SET) ||
-      1 != fread(buffer, lba_count * lkp.bytes_per_lba, 1, image_file)) {
-    fprintf(stderr, "Read error.");
-    return 1;
+  if (num_reads == max_reads) {
+    int new_max = max_reads ? max_reads * 2 : 64;
+    struct read_record *new_reads = realloc(reads, new_max * sizeof(*reads));
+    if (!new_reads) {
+      fprintf(stderr, "Out of memory recording reads\n");
+      return 1;
+    }
+    reads = new_reads;
+    max_reads = new_max;
   }
+  reads[num_reads].lba_start = lba_start;
+  reads[num_reads].lba_count = lba_count;
+  reads[num_reads].time_us = VbExGetTimer() - read_start_ts;
+  num_reads++;
+
+  memcpy(buffer, image_data + lba_start * lkp.bytes_per_lba,
+         lba_count * lkp.bytes_per_lba);
   return VBERROR_SUCCESS;
 }
 
@@ -63,15 +100,46 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
     return 1;
   }
 
-  /* TODO: enable writes, once we're sure it won't trash our example file */
+  /* Writes are dropped, so the image is never changed */
   return VBERROR_SUCCESS;
+}
+
+
+/* Parse "LATENCY_US,MB_PER_SEC" or the name of a built-in profile. */
+static int parse_profile(const char *arg, struct device_profile *profile) {
+  char *e;
+  int i;
 
-  fseek(image_file, lba_start * lkp.bytes_per_lba, SEEK_SET);
-  if (1 != fwrite(buffer, lba_count * lkp.bytes_per_lba, 1, image_file)) {
-    fprintf(stderr, "Read error.");
+  for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+    if (!strcmp(arg, profiles[i].name)) {
+      *profile = profiles[i];
+      return 0;
+    }
+  }
+
+  profile->name = "custom";
+  profile->latency_us = strtoul(arg, &e, 0);
+  if (e == arg || *e != ',')
+    return 1;
+  arg = e + 1;
+  profile->mb_per_sec = strtoul(arg, &e, 0);
+  if (e == arg || *e || !profile->mb_per_sec)
     return 1;
+  return 0;
+}
+
+/* Print how long the recorded reads would take on a device. */
+static void print_projection(const struct device_profile *profile) {
+  uint64_t total_us = 0;
+  int i;
+
+  for (i = 0; i < num_reads; i++) {
+    uint64_t bytes = reads[i].lba_count * lkp.bytes_per_lba;
+    total_us += profile->latency_us +
+        bytes * 1000000 / ((uint64_t)profile->mb_per_sec * 1024 * 1024);
   }
-  return VBERROR_SUCCESS;
+  printf("Projected %-6s (%u us/read, %u MB/s): %" PRIu64 " us\n",
+         profile->name, profile->latency_us, profile->mb_per_sec, total_us);
 }
 
 
@@ -90,14 +158,21 @@ int main(int argc, char* argv[]) {
   int c, argsleft;
   int errorcnt = 0;
   char *e = 0;
+  struct device_profile profile = {0};
+  int verbose = 0;
+  struct stat sb;
+  int image_fd;
+  int i;
 
   memset(&lkp, 0, sizeof(LoadKernelParams));
+  /* The stream stub needs a non-NULL handle; the disk stubs ignore it */
+  lkp.disk_handle = (VbExDiskHandle_t)1;
   lkp.bytes_per_lba = LBA_BYTES;
   int boot_flags = BOOT_FLAG_RECOVERY;
 
   /* Parse options */
   opterr = 0;
-  while ((c=getopt(argc, argv, ":b:")) != -1)
+  while ((c=getopt(argc, argv, ":b:c:p:v")) != -1)
   {
     switch (c)
     {
@@ -109,6 +184,23 @@ int main(int argc, char* argv[]) {
         errorcnt++;
       }
       break;
+    case 'c':
+      lkp.body_chunk_size = strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        fprintf(stderr, "Invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'p':
+      if (parse_profile(optarg, &profile)) {
+        fprintf(stderr, "Invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'v':
+      verbose = 1;
+      break;
     case '?':
       fprintf(stderr, "Unrecognized switch: -%c\n", optopt);
       errorcnt++;
@@ -138,6 +230,13 @@ int main(int argc, char* argv[]) {
             BOOT_FLAG_DEVELOPER);
     fprintf(stderr, "               %d = recovery mode on\n",
 	    BOOT_FLAG_RECOVERY);
+    fprintf(stderr, "  -c NUM     read and hash the kernel body NUM bytes at a\n"
+            "             time, overlapping reads with hashing (default 0 =\n"
+            "             read the whole body, then hash it)\n");
+    fprintf(stderr, "  -p DEVICE  project read time only for DEVICE: emmc, usb2,\n"
+            "             nvme, or LATENCY_US,MB_PER_SEC (default all\n"
+            "             built-in devices)\n");
+    fprintf(stderr, "  -v         list every read\n");
     return 1;
   }
 
@@ -198,15 +297,19 @@ int main(int argc, char* argv[]) {
 
   /* Get image size */
   printf("Reading from image: %s\n", image_name);
-  image_file = fopen(image_name, "rb");
-  if (!image_file) {
+  image_fd = open(image_name, O_RDONLY);
+  if (image_fd < 0 || fstat(image_fd, &sb) || sb.st_size < LBA_BYTES) {
     fprintf(stderr, "Unable to open image file %s\n", image_name);
     return 1;
   }
-  fseek(image_file, 0, SEEK_END);
-  lkp.streaming_lba_count = (ftell(image_file) / LBA_BYTES);
+  image_data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, image_fd, 0);
+  close(image_fd);
+  if (image_data == MAP_FAILED) {
+    fprintf(stderr, "Unable to map image file %s\n", image_name);
+    return 1;
+  }
+  lkp.streaming_lba_count = sb.st_size / LBA_BYTES;
   lkp.gpt_lba_count = lkp.streaming_lba_count;
-  rewind(image_file);
   printf("Streaming LBA count: %" PRIu64 "\n", lkp.streaming_lba_count);
 
   /* Allocate a buffer for the kernel */
@@ -246,8 +349,27 @@ int main(int argc, char* argv[]) {
   sd->vbsd = shared;
 
   /* Call LoadKernel() */
+  read_start_ts = VbExGetTimer();
   rv = LoadKernel(&ctx, &lkp);
-  printf("LoadKernel() returned %d\n", rv);
+  printf("LoadKernel() returned %d in %" PRIu64 " us\n", rv,
+         VbExGetTimer() - read_start_ts);
+
+  /* Report the reads afterwards, so printing doesn't skew their times */
+  uint64_t sectors = 0;
+  for (i = 0; i < num_reads; i++) {
+    if (verbose)
+      printf("Read(%" PRIu64 ", %" PRIu64 ") at %" PRIu64 " us\n",
+             reads[i].lba_start, reads[i].lba_count, reads[i].time_us);
+    sectors += reads[i].lba_count;
+  }
+  printf("Reads: %d, %" PRIu64 " sectors (%" PRIu64 " bytes)\n",
+         num_reads, sectors, sectors * lkp.bytes_per_lba);
+  if (profile.name) {
+    print_projection(&profile);
+  } else {
+    for (i = 0; i < ARRAY_SIZE(profiles); i++)
+      print_projection(&profiles[i]);
+  }
 
   if (VBERROR_SUCCESS == rv) {
     printf("Partition number:   %u\n", lkp.partition_number);
@@ -274,7 +396,8 @@ int main(int argc, char* argv[]) {
            lkp.partition_guid[15]);
   }
 
-  fclose(image_file);
+  munmap((void *)image_data, sb.st_size);
+  free(reads);
   free(lkp.kernel_buffer);
   return rv != VBERROR_SUCCESS;
 }
@@ -10,9 +10,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "2sysincludes.h"
 #include "2common.h"
+#include "file_keys.h"
 #include "host_common.h"
 #include "host_signature2.h"
 #include "signature_digest.h"
@@ -20,12 +22,20 @@
 int main(int argc, char* argv[])
 {
 	int error_code = -1;
-	uint8_t *buf = NULL;
 	uint8_t *signature_digest = NULL;
-	uint32_t len;
+	uint32_t flags = 0;
+
+	/* --direct reads the file around the page cache */
+	if (argc > 1 && !strcmp(argv[1], "--direct")) {
+		flags |= DIGEST_FILE_DIRECT;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
 
 	if (argc != 3) {
-		fprintf(stderr, "Usage: %s <alg_id> <file>", argv[0]);
+		fprintf(stderr, "Usage: %s [--direct] <alg_id> <file>",
+			argv[0]);
 		goto cleanup;
 	}
 
@@ -35,11 +45,6 @@ int main(int argc, char* argv[])
 		goto cleanup;
 	}
 
-	if (VB2_SUCCESS != vb2_read_file(argv[2], &buf, &len)) {
-		fprintf(stderr, "Could not read file: %s\n", argv[2]);
-		goto cleanup;
-	}
-
 	enum vb2_hash_algorithm hash_alg = vb2_crypto_to_hash(algorithm);
 	uint32_t digest_size = vb2_digest_size(hash_alg);
 	uint32_t digestinfo_size = 0;
@@ -49,13 +54,15 @@ int main(int argc, char* argv[])
 		goto cleanup;
 
 	uint32_t signature_digest_len = digest_size + digestinfo_size;
-	signature_digest = SignatureDigest(buf, len, algorithm);
-	if(signature_digest &&
-	   fwrite(signature_digest, signature_digest_len, 1, stdout) == 1)
+	signature_digest = SignatureDigestFile(argv[2], algorithm, flags);
+	if (!signature_digest) {
+		fprintf(stderr, "Could not read file: %s\n", argv[2]);
+		goto cleanup;
+	}
+	if (fwrite(signature_digest, signature_digest_len, 1, stdout) == 1)
 		error_code = 0;
 
 cleanup:
 	free(signature_digest);
-	free(buf);
 	return error_code;
 }
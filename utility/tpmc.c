@@ -7,6 +7,9 @@
  *
  * The exit code is 0 for success, the TPM error code for TPM errors, and 255
  * for other errors.
+ *
+ * "tpmc batch" reads commands from stdin, one per line, and runs them all
+ * with the TPM opened once.
  */
 
 #include <inttypes.h>
@@ -16,12 +19,16 @@
 #include <string.h>
 #include <syslog.h>
 
+#include "crossystem.h"
 #include "tlcl.h"
 #include "tpm_error_messages.h"
 #include "tss_constants.h"
 
 #define OTHER_ERROR 255  /* OTHER_ERROR must be the largest uint8_t value. */
 
+/* Most words a batch line can have, including the command name. */
+#define MAX_BATCH_ARGS 64
+
 #ifdef TPM2_MODE
 #define TPM_MODE_SELECT(_, tpm20_ver) tpm20_ver
 #else
@@ -521,6 +528,20 @@ static uint32_t HandlerGetVersion(void) {
   return result;
 }
 
+/* Firmware's TPM statistics can be a line per command code, plus a header */
+#define STATS_SIZE 2048
+
+static uint32_t HandlerStats(void) {
+  char buf[STATS_SIZE];
+
+  if (!VbGetSystemPropertyString("vboot_tpm_stats", buf, sizeof(buf))) {
+    fprintf(stderr, "firmware did not record TPM statistics\n");
+    exit(OTHER_ERROR);
+  }
+  printf("%s", buf);
+  return 0;
+}
+
 #ifndef TPM2_MODE
 static void PrintIFXFirmwarePackage(TPM_IFX_FIRMWAREPACKAGE* firmware_package,
                                     const char* prefix) {
@@ -651,6 +672,8 @@ command_record command_table[] = {
     HandlerSendRaw },
   { "getversion", "getver", "get TPM vendor and firmware version",
     HandlerGetVersion },
+  { "stats", "stats", "print TPM commands sent by firmware, and their timing",
+    HandlerStats },
   { "ifxfieldupgradeinfo", "ifxfui",
     TPM20_NOT_IMPLEMENTED("read and print IFX field upgrade info",
       HandlerIFXFieldUpgradeInfo) },
@@ -661,9 +684,72 @@ command_record command_table[] = {
 
 static int n_commands = sizeof(command_table) / sizeof(command_table[0]);
 
+static command_record* FindCommand(const char* cmd) {
+  command_record* c;
+  for (c = command_table; c < command_table + n_commands; c++) {
+    if (strcmp(cmd, c->name) == 0 || strcmp(cmd, c->abbr) == 0) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+/* Runs the commands on stdin, one per line, after the TPM has been opened.
+ * Blank lines and lines starting with '#' are skipped.  Stops at the first
+ * command which fails, and returns its exit code.  Commands with bad
+ * arguments exit with OTHER_ERROR, as they do when run on their own.
+ */
+static int RunBatch(char* progname) {
+  char* line = NULL;
+  size_t line_size = 0;
+  int line_number = 0;
+  uint8_t exit_code = 0;
+
+  while (!exit_code && getline(&line, &line_size, stdin) != -1) {
+    /* As in argv, words[0] is the program and words[1] the command. */
+    char* words[MAX_BATCH_ARGS + 2];
+    command_record* c;
+    char* word;
+    int count = 1;
+
+    line_number++;
+    words[0] = progname;
+    for (word = strtok(line, " \t\r\n"); word;
+         word = strtok(NULL, " \t\r\n")) {
+      if (count == MAX_BATCH_ARGS + 1) {
+        fprintf(stderr, "line %d: too many arguments\n", line_number);
+        exit_code = OTHER_ERROR;
+        break;
+      }
+      words[count++] = word;
+    }
+    if (exit_code || count == 1 || words[1][0] == '#') {
+      continue;
+    }
+    words[count] = NULL;
+
+    c = FindCommand(words[1]);
+    if (!c) {
+      fprintf(stderr, "line %d: unknown command: %s\n", line_number, words[1]);
+      exit_code = OTHER_ERROR;
+      break;
+    }
+    nargs = count;
+    args = words;
+    exit_code = ErrorCheck(c->handler(), words[1]);
+    if (exit_code) {
+      fprintf(stderr, "line %d: %s failed\n", line_number, words[1]);
+    }
+    fflush(stdout);
+  }
+  free(line);
+  return exit_code;
+}
+
 int main(int argc, char* argv[]) {
   char *progname;
   uint32_t result;
+  int exit_code;
 
   progname = strrchr(argv[0], '/');
   if (progname)
@@ -672,8 +758,9 @@ int main(int argc, char* argv[]) {
     progname = argv[0];
 
   if (argc < 2) {
-    fprintf(stderr, "usage: %s <TPM command> [args]\n   or: %s help\n",
-            progname, progname);
+    fprintf(stderr, "usage: %s <TPM command> [args]\n"
+            "   or: %s batch < COMMANDS\n   or: %s help\n",
+            progname, progname, progname);
     return OTHER_ERROR;
   } else {
     command_record* c;
@@ -687,11 +774,23 @@ int main(int argc, char* argv[]) {
       for (c = command_table; c < command_table + n_commands; c++) {
         printf("%26s %7s  %s\n", c->name, c->abbr, c->description);
       }
+      printf("%26s %7s  %s\n", "batch", "batch",
+             "run commands from stdin, one per line, with the TPM opened once");
       return 0;
     }
     if (!strcmp(cmd, "tpmversion") || !strcmp(cmd, "tpmver")) {
       return HandlerTpmVersion();
     }
+    /* Firmware's statistics don't need the TPM */
+    if (!strcmp(cmd, "stats")) {
+      return HandlerStats();
+    }
+
+    c = FindCommand(cmd);
+    if (!c && strcmp(cmd, "batch") != 0) {
+      fprintf(stderr, "%s: unknown command: %s\n", progname, cmd);
+      return OTHER_ERROR;
+    }
 
     result = TlclLibInit();
     if (result) {
@@ -699,14 +798,16 @@ int main(int argc, char* argv[]) {
       return result > OTHER_ERROR ? OTHER_ERROR : result;
     }
 
-    for (c = command_table; c < command_table + n_commands; c++) {
-      if (strcmp(cmd, c->name) == 0 || strcmp(cmd, c->abbr) == 0) {
-        return ErrorCheck(c->handler(), cmd);
-      }
+    if (!c) {
+#ifndef TPM2_MODE
+      /* Owner-authorized commands in a batch share one session. */
+      TlclKeepOwnerSession(1);
+#endif
+      exit_code = RunBatch(progname);
+    } else {
+      exit_code = ErrorCheck(c->handler(), cmd);
     }
-
-    /* No command matched. */
-    fprintf(stderr, "%s: unknown command: %s\n", progname, cmd);
-    return OTHER_ERROR;
+    TlclLibClose();
+    return exit_code;
   }
 }
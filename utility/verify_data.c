@@ -41,12 +41,21 @@ int main(int argc, char* argv[])
 	struct vb2_packed_key *pk = NULL;
 	uint8_t *signature = NULL;
 	uint32_t sig_len = 0;
+	uint32_t flags = 0;
+
+	/* --direct reads the input around the page cache */
+	if (argc > 1 && !strcmp(argv[1], "--direct")) {
+		flags |= DIGEST_FILE_DIRECT;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
 
 	if (argc != 5) {
 		int i;
 		fprintf(stderr,
-			"Usage: %s <algorithm> <key file> <signature file>"
-			" <input file>\n\n", argv[0]);
+			"Usage: %s [--direct] <algorithm> <key file>"
+			" <signature file> <input file>\n\n", argv[0]);
 		fprintf(stderr,
 			"where <algorithm> depends on the signature algorithm"
 			" used:\n");
@@ -87,8 +96,9 @@ int main(int argc, char* argv[])
 		goto error;
 	}
 
-	if (VB2_SUCCESS != DigestFile(argv[4], vb2_crypto_to_hash(algorithm),
-				       digest, sizeof(digest))) {
+	if (VB2_SUCCESS != DigestFileFlags(argv[4],
+					   vb2_crypto_to_hash(algorithm),
+					   digest, sizeof(digest), flags)) {
 		fprintf(stderr, "Error calculating digest.\n");
 		goto error;
 	}